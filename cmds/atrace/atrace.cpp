@@ -20,18 +20,23 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <time.h>
 #include <unistd.h>
 #include <zlib.h>
 
+#include <atomic>
 #include <fstream>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include <binder/IBinder.h>
 #include <binder/IServiceManager.h>
@@ -50,6 +55,7 @@
 #include <android-base/macros.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
 
 using namespace android;
 using pdx::default_transport::ServiceUtility;
@@ -65,6 +71,7 @@ using std::string;
 #define MAX_SYS_FILES 11
 
 const char* k_traceTagsProperty = "debug.atrace.tags.enableflags";
+const char* k_traceSamplePeriodProperty = "debug.atrace.tags.sample_period";
 const char* k_userInitiatedTraceProperty = "debug.atrace.user_initiated";
 
 const char* k_traceAppsNumberProperty = "debug.atrace.app_number";
@@ -268,7 +275,9 @@ static int g_initialSleepSecs = 0;
 static const char* g_categoriesFile = nullptr;
 static const char* g_kernelTraceFuncs = nullptr;
 static const char* g_debugAppCmdLine = "";
+static int g_samplePeriodFrames = 0;
 static const char* g_outputFile = nullptr;
+static bool g_streamRaw = false;
 
 /* Global state */
 static bool g_tracePdx = false;
@@ -278,6 +287,11 @@ static std::string g_traceFolder;
 static sp<IAtraceDevice> g_atraceHal;
 static std::vector<TracingVendorCategory> g_vendorCategories;
 
+/* --stream_raw tuning */
+static const size_t k_rawTraceSpliceSize = 64 * 1024;
+static const int k_rawTracePipeSize = 1024 * 1024;
+static const int k_rawTracePollMs = 100;
+
 /* Sys file paths */
 static const char* k_traceClockPath =
     "trace_clock";
@@ -327,6 +341,9 @@ static const char* k_tracePath =
 static const char* k_traceStreamPath =
     "trace_pipe";
 
+static const char* k_traceRawStreamPath =
+    "per_cpu/cpu%u/trace_pipe_raw";
+
 static const char* k_traceMarkerPath =
     "trace_marker";
 
@@ -585,6 +602,18 @@ static bool setTagsProperty(uint64_t tags)
     return true;
 }
 
+// Set how many frames userland tracing covers one of, so that light tracing
+// can be left on. Processes that do not count frames trace every one.
+static bool setSamplePeriodProperty(int frames)
+{
+    std::string value = frames > 1 ? android::base::StringPrintf("%d", frames) : "";
+    if (!android::base::SetProperty(k_traceSamplePeriodProperty, value)) {
+        fprintf(stderr, "error setting trace sample period system property\n");
+        return false;
+    }
+    return true;
+}
+
 static void clearAppProperties()
 {
     if (!android::base::SetProperty(k_traceAppsNumberProperty, "")) {
@@ -802,6 +831,7 @@ static bool setUpUserspaceTracing()
         packageList += android::base::GetProperty(k_coreServicesProp, "");
     }
     ok &= setAppCmdlineProperty(&packageList[0]);
+    ok &= setSamplePeriodProperty(g_samplePeriodFrames);
     ok &= setTagsProperty(tags);
     if (g_tracePdx) {
         ok &= ServiceUtility::PokeServices();
@@ -813,6 +843,7 @@ static bool setUpUserspaceTracing()
 static void cleanUpUserspaceTracing()
 {
     setTagsProperty(0);
+    setSamplePeriodProperty(0);
     clearAppProperties();
 
     if (g_tracePdx) {
@@ -916,6 +947,236 @@ static void streamTrace()
     }
 }
 
+// Header written in front of every chunk of --stream_raw output. Concatenating
+// the chunks of one CPU gives the pages of its ring buffer, as read from
+// per_cpu/cpuN/trace_pipe_raw.
+struct RawTraceChunkHeader {
+    uint32_t cpu;
+    uint32_t size;
+};
+
+// The pages of one CPU's ring buffer, on their way to the output file.
+struct RawTraceCpu {
+    uint32_t cpu;
+    android::base::unique_fd traceFd;
+    android::base::unique_fd pipeRead;
+    android::base::unique_fd pipeWrite;
+};
+
+// Moves the pages of one CPU's ring buffer into its pipe until stop is set,
+// then flushes the page the kernel is still filling.
+static void readRawTrace(RawTraceCpu* cpu, const std::atomic<bool>* stop)
+{
+    const size_t pageSize = getpagesize();
+    while (!stop->load()) {
+        // The pages are moved without being copied. The trace file is
+        // non-blocking, so this returns EAGAIN until a page is full.
+        ssize_t rc = splice(cpu->traceFd.get(), nullptr, cpu->pipeWrite.get(), nullptr,
+                            k_rawTraceSpliceSize, SPLICE_F_MOVE);
+        if (rc > 0) {
+            continue;
+        }
+        if (rc < 0 && errno != EAGAIN && errno != EINTR) {
+            fprintf(stderr, "error splicing trace of cpu%u: %s (%d)\n", cpu->cpu,
+                    strerror(errno), errno);
+            cpu->pipeWrite.reset();
+            return;
+        }
+        struct pollfd pfd = { cpu->traceFd.get(), POLLIN, 0 };
+        poll(&pfd, 1, k_rawTracePollMs);
+    }
+
+    std::unique_ptr<char[]> page(new char[pageSize]);
+    ssize_t rc;
+    while ((rc = TEMP_FAILURE_RETRY(read(cpu->traceFd.get(), page.get(), pageSize))) > 0) {
+        if (!android::base::WriteFully(cpu->pipeWrite.get(), page.get(), rc)) {
+            break;
+        }
+    }
+    // Tells writeRawTrace that this CPU is done.
+    cpu->pipeWrite.reset();
+}
+
+// Feeds size bytes of data to the deflate stream, writing out full buffers.
+static bool deflateToFd(z_stream* zs, const void* data, size_t size, int flush,
+                        uint8_t* out, size_t outSize, int outFd)
+{
+    zs->next_in = reinterpret_cast<Bytef*>(const_cast<void*>(data));
+    zs->avail_in = size;
+    do {
+        zs->next_out = reinterpret_cast<Bytef*>(out);
+        zs->avail_out = outSize;
+        int result = deflate(zs, flush);
+        if (result == Z_STREAM_ERROR) {
+            fprintf(stderr, "error deflating trace: %s\n", zs->msg);
+            return false;
+        }
+        size_t bytes = outSize - zs->avail_out;
+        if (bytes > 0 && !android::base::WriteFully(outFd, out, bytes)) {
+            fprintf(stderr, "error writing deflated trace: %s (%d)\n",
+                    strerror(errno), errno);
+            return false;
+        }
+    } while (zs->avail_out == 0);
+    return true;
+}
+
+// Copies the pages of all the CPUs to outFd, compressing them if requested,
+// until every reader is done.
+static void writeRawTrace(std::vector<RawTraceCpu>* cpus, int outFd)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    std::unique_ptr<uint8_t[]> in;
+    std::unique_ptr<uint8_t[]> out;
+    constexpr size_t bufSize = 64*1024;
+    bool ok = true;
+    if (g_compress) {
+        int result = deflateInit(&zs, Z_DEFAULT_COMPRESSION);
+        if (result != Z_OK) {
+            fprintf(stderr, "error initializing zlib: %d\n", result);
+            ok = false;
+        }
+        in.reset(new uint8_t[bufSize]);
+        out.reset(new uint8_t[bufSize]);
+    }
+
+    std::vector<struct pollfd> pfds;
+    for (const auto& cpu : *cpus) {
+        pfds.push_back({ cpu.pipeRead.get(), POLLIN, 0 });
+    }
+    size_t remaining = pfds.size();
+    while (remaining > 0) {
+        if (poll(pfds.data(), pfds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "error polling trace pipes: %s (%d)\n", strerror(errno), errno);
+            break;
+        }
+        for (size_t i = 0; i < pfds.size(); i++) {
+            if (pfds[i].fd < 0 || pfds[i].revents == 0) {
+                continue;
+            }
+            int available = 0;
+            if (ioctl(pfds[i].fd, FIONREAD, &available) < 0 || available <= 0) {
+                if (pfds[i].revents & (POLLHUP | POLLERR)) {
+                    // The reader is done and its pipe is drained.
+                    pfds[i].fd = -1;
+                    remaining--;
+                }
+                continue;
+            }
+            if (!ok) {
+                // Keep draining the pipes so that the readers do not block.
+                std::unique_ptr<char[]> discard(new char[available]);
+                TEMP_FAILURE_RETRY(read(pfds[i].fd, discard.get(), available));
+                continue;
+            }
+            RawTraceChunkHeader header = { (*cpus)[i].cpu, 0 };
+            if (g_compress) {
+                ssize_t rc = TEMP_FAILURE_RETRY(read(pfds[i].fd, in.get(),
+                        std::min(bufSize, static_cast<size_t>(available))));
+                if (rc <= 0) {
+                    continue;
+                }
+                header.size = rc;
+                ok = deflateToFd(&zs, &header, sizeof(header), Z_NO_FLUSH, out.get(), bufSize,
+                                 outFd) &&
+                     deflateToFd(&zs, in.get(), rc, Z_NO_FLUSH, out.get(), bufSize, outFd);
+            } else {
+                header.size = available;
+                ok = android::base::WriteFully(outFd, &header, sizeof(header));
+                size_t left = available;
+                while (ok && left > 0) {
+                    ssize_t rc = splice(pfds[i].fd, nullptr, outFd, nullptr, left,
+                                        SPLICE_F_MOVE);
+                    if (rc <= 0 && errno != EINTR) {
+                        ok = false;
+                    } else if (rc > 0) {
+                        left -= rc;
+                    }
+                }
+                if (!ok) {
+                    fprintf(stderr, "error writing trace: %s (%d)\n", strerror(errno), errno);
+                }
+            }
+        }
+    }
+
+    if (g_compress) {
+        if (ok) {
+            deflateToFd(&zs, nullptr, 0, Z_FINISH, out.get(), bufSize, outFd);
+        }
+        deflateEnd(&zs);
+    }
+}
+
+// Stream the binary per-CPU ring buffers to the output file until tracing is
+// aborted. Pages are spliced into pipes on one thread per CPU, so that tracing
+// keeps up with the kernel while another thread writes them out, and
+// compresses them with -z. The kernel buffers only need to absorb the time it
+// takes to move a page, so long captures work with the default buffer size.
+static void streamRawTrace()
+{
+    std::vector<RawTraceCpu> cpus;
+    for (uint32_t i = 0;; i++) {
+        std::string path = g_traceFolder +
+                android::base::StringPrintf(k_traceRawStreamPath, i);
+        int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd == -1) {
+            break;
+        }
+        int pipeFds[2];
+        if (pipe2(pipeFds, O_CLOEXEC) == -1) {
+            fprintf(stderr, "error creating pipe: %s (%d)\n", strerror(errno), errno);
+            close(fd);
+            return;
+        }
+        // Best effort; a bigger pipe gives the writer more slack.
+        fcntl(pipeFds[1], F_SETPIPE_SZ, k_rawTracePipeSize);
+        cpus.push_back({ i, android::base::unique_fd(fd), android::base::unique_fd(pipeFds[0]),
+                         android::base::unique_fd(pipeFds[1]) });
+    }
+    if (cpus.empty()) {
+        fprintf(stderr, "error opening %s: %s (%d)\n", k_traceRawStreamPath,
+                strerror(errno), errno);
+        return;
+    }
+
+    int outFd = STDOUT_FILENO;
+    if (g_outputFile) {
+        outFd = open(g_outputFile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (outFd == -1) {
+            fprintf(stderr, "error opening %s: %s (%d)\n", g_outputFile,
+                    strerror(errno), errno);
+            return;
+        }
+    }
+
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> readers;
+    for (auto& cpu : cpus) {
+        readers.emplace_back(readRawTrace, &cpu, &stop);
+    }
+    std::thread writer(writeRawTrace, &cpus, outFd);
+
+    while (!g_traceAborted) {
+        usleep(k_rawTracePollMs * 1000);
+    }
+    // Stop the trace first, so that the readers can flush the last pages.
+    stopTrace();
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    writer.join();
+
+    if (g_outputFile) {
+        close(outFd);
+    }
+}
+
 // Read the current kernel trace and write it to stdout.
 static void dumpTrace(int outFd)
 {
@@ -1068,6 +1329,8 @@ static void showHelp(const char *cmd)
                     "  -s N            sleep for N seconds before tracing [default 0]\n"
                     "  -t N            trace for N seconds [default 5]\n"
                     "  -z              compress the trace dump\n"
+                    "  --sample N      only trace userspace during one frame in every N,\n"
+                    "                    in the processes that count frames\n"
                     "  --async_start   start circular trace and return immediately\n"
                     "  --async_dump    dump the current contents of circular trace buffer\n"
                     "  --async_stop    stop tracing and dump the current contents of circular\n"
@@ -1076,6 +1339,10 @@ static void showHelp(const char *cmd)
                     "                    Note: this can take significant CPU time, and is best\n"
                     "                    used for measuring things that are not affected by\n"
                     "                    CPU performance, like pagecache usage.\n"
+                    "  --stream_raw    stream the binary per-CPU ring buffers until interrupted;\n"
+                    "                    each chunk is prefixed with its CPU and size (two\n"
+                    "                    32-bit words), the whole output is deflated with -z\n"
+                    "                    and goes to the file given with -o, if any.\n"
                     "  --list_categories\n"
                     "                  list the available tracing categories\n"
                     " -o filename      write the trace to the specified file instead\n"
@@ -1210,6 +1477,8 @@ int main(int argc, char **argv)
             {"only_userspace",    no_argument, nullptr,  0 },
             {"list_categories",   no_argument, nullptr,  0 },
             {"stream",            no_argument, nullptr,  0 },
+            {"stream_raw",        no_argument, nullptr,  0 },
+            {"sample",      required_argument, nullptr,  0 },
             {nullptr,                       0, nullptr,  0 }
         };
 
@@ -1285,6 +1554,16 @@ int main(int argc, char **argv)
                 } else if (!strcmp(long_options[option_index].name, "stream")) {
                     traceStream = true;
                     traceDump = false;
+                } else if (!strcmp(long_options[option_index].name, "stream_raw")) {
+                    traceStream = true;
+                    traceDump = false;
+                    g_streamRaw = true;
+                } else if (!strcmp(long_options[option_index].name, "sample")) {
+                    g_samplePeriodFrames = atoi(optarg);
+                    if (g_samplePeriodFrames < 1) {
+                        fprintf(stderr, "--sample needs a period of at least 1 frame\n");
+                        exit(1);
+                    }
                 } else if (!strcmp(long_options[option_index].name, "list_categories")) {
                     listSupportedCategories();
                     exit(0);
@@ -1354,7 +1633,11 @@ int main(int argc, char **argv)
         }
 
         if (traceStream) {
-            streamTrace();
+            if (g_streamRaw) {
+                streamRawTrace();
+            } else {
+                streamTrace();
+            }
         }
     }
 
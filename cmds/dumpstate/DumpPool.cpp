@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "dumpstate"
+
+#include "DumpPool.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <array>
+
+#include <android-base/file.h>
+#include <log/log.h>
+
+#include "DumpstateInternal.h"
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+DumpPool::DumpPool(const std::string& tmp_root) : tmp_root_(tmp_root) {
+}
+
+DumpPool::~DumpPool() {
+    shutdown();
+}
+
+void DumpPool::start(int thread_counts) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!threads_.empty()) {
+        return;
+    }
+    shutdown_ = false;
+    for (int i = 0; i < thread_counts; i++) {
+        threads_.emplace_back(&DumpPool::loop, this);
+    }
+}
+
+void DumpPool::shutdown() {
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        shutdown_ = true;
+        while (!queue_.empty()) {
+            queue_.front()->cancelled = true;
+            queue_.front()->finished = true;
+            queue_.pop();
+        }
+        threads.swap(threads_);
+    }
+    condition_.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void DumpPool::loop() {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true) {
+        condition_.wait(lock, [this] { return shutdown_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return;
+        }
+        std::shared_ptr<Task> task = queue_.front();
+        queue_.pop();
+
+        lock.unlock();
+        task->func(task->output.get());
+        lock.lock();
+
+        task->finished = true;
+        condition_.notify_all();
+    }
+}
+
+void DumpPool::enqueueTask(const std::string& task_name, std::function<void(int)> func) {
+    auto task = std::make_shared<Task>();
+    task->func = std::move(func);
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!threads_.empty() && !shutdown_) {
+        std::string path = tmp_root_ + "/dumptask_XXXXXX";
+        task->output.reset(TEMP_FAILURE_RETRY(mkostemp(&path[0], O_CLOEXEC)));
+        if (task->output.get() < 0) {
+            MYLOGE("Could not create a file for section %s: %s\n", task_name.c_str(),
+                   strerror(errno));
+        } else {
+            // The output is only read through the file descriptor.
+            unlink(path.c_str());
+            task->queued = true;
+            queue_.push(task);
+            condition_.notify_one();
+        }
+    }
+    if (!tasks_.emplace(task_name, task).second) {
+        MYLOGE("Section %s was already enqueued\n", task_name.c_str());
+    }
+}
+
+bool DumpPool::waitForTask(const std::string& task_name, int out_fd,
+                           std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(lock_);
+    auto it = tasks_.find(task_name);
+    if (it == tasks_.end()) {
+        MYLOGE("Section %s was not enqueued\n", task_name.c_str());
+        return false;
+    }
+    std::shared_ptr<Task> task = it->second;
+    tasks_.erase(it);
+
+    if (!task->queued) {
+        lock.unlock();
+        task->func(out_fd);
+        return true;
+    }
+    if (!condition_.wait_for(lock, timeout, [&task] { return task->finished; })) {
+        // The section keeps running in the background, but its output is dropped.
+        dprintf(out_fd, "*** section %s timed out after %.3fs\n", task_name.c_str(),
+                static_cast<float>(timeout.count()) / 1000);
+        MYLOGE("Section %s timed out after %.3fs\n", task_name.c_str(),
+               static_cast<float>(timeout.count()) / 1000);
+        return false;
+    }
+    if (task->cancelled) {
+        dprintf(out_fd, "*** section %s was cancelled\n", task_name.c_str());
+        return false;
+    }
+    lock.unlock();
+
+    std::array<char, 65536> buffer;
+    off_t offset = 0;
+    ssize_t bytes_read;
+    while ((bytes_read = TEMP_FAILURE_RETRY(
+                    pread(task->output.get(), buffer.data(), buffer.size(), offset))) > 0) {
+        if (!android::base::WriteFully(out_fd, buffer.data(), bytes_read)) {
+            MYLOGE("Could not copy the output of section %s: %s\n", task_name.c_str(),
+                   strerror(errno));
+            return false;
+        }
+        offset += bytes_read;
+    }
+    if (bytes_read < 0) {
+        MYLOGE("Could not read the output of section %s: %s\n", task_name.c_str(),
+               strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
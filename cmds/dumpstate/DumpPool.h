@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef FRAMEWORK_NATIVE_CMD_DUMPPOOL_H_
+#define FRAMEWORK_NATIVE_CMD_DUMPPOOL_H_
+
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+
+namespace android {
+namespace os {
+namespace dumpstate {
+
+/*
+ * Runs independent bugreport sections on a few worker threads.
+ *
+ * Each section writes to its own temporary file, and its output is only copied to the bugreport
+ * when the main thread waits for it, so that the bugreport looks the same as when the sections
+ * run one after another.
+ *
+ * Typical usage:
+ *
+ *    pool.enqueueTask("DUMP HALS", [](int out_fd) { DumpHals(out_fd); });
+ *    ... other sections ...
+ *    pool.waitForTask("DUMP HALS");
+ */
+class DumpPool {
+  public:
+    static const int MAX_THREAD_COUNT = 4;
+
+    /* |tmp_root| is the directory in which the sections write their output. */
+    explicit DumpPool(const std::string& tmp_root);
+    ~DumpPool();
+
+    /*
+     * Starts the worker threads. Sections enqueued while the pool is not running are run by
+     * waitForTask instead.
+     */
+    void start(int thread_counts = MAX_THREAD_COUNT);
+
+    /* Drops the sections that did not start yet, and waits for the others to finish. */
+    void shutdown();
+
+    /*
+     * Queues a section. |func| is called with the file descriptor its output should go to, and
+     * must not write to `stdout`.
+     */
+    void enqueueTask(const std::string& task_name, std::function<void(int)> func);
+
+    /*
+     * Waits for a section to finish and copies its output to |out_fd|. Gives up after |timeout|,
+     * leaving a note in |out_fd| instead; returns false in that case, or when there is no such
+     * section.
+     */
+    bool waitForTask(const std::string& task_name, int out_fd = STDOUT_FILENO,
+                     std::chrono::milliseconds timeout = std::chrono::minutes(5));
+
+  private:
+    struct Task {
+        std::function<void(int)> func;
+        // Where the section writes its output when it runs on a worker thread.
+        android::base::unique_fd output;
+        // Guarded by lock_.
+        bool queued = false;
+        bool finished = false;
+        bool cancelled = false;
+    };
+
+    void loop();
+
+    const std::string tmp_root_;
+
+    std::mutex lock_;
+    std::condition_variable condition_;
+    bool shutdown_ = false;
+    std::queue<std::shared_ptr<Task>> queue_;
+    std::vector<std::thread> threads_;
+    std::map<std::string, std::shared_ptr<Task>> tasks_;
+
+    DISALLOW_COPY_AND_ASSIGN(DumpPool);
+};
+
+}  // namespace dumpstate
+}  // namespace os
+}  // namespace android
+
+#endif  // FRAMEWORK_NATIVE_CMD_DUMPPOOL_H_
@@ -24,6 +24,7 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <vector>
 
 #include <android-base/file.h>
@@ -53,16 +54,36 @@ static bool waitpid_with_timeout(pid_t pid, int timeout_ms, int* status) {
         return false;
     }
 
-    timespec ts;
-    ts.tv_sec = MSEC_TO_SEC(timeout_ms);
-    ts.tv_nsec = (timeout_ms % 1000) * 1000000;
-    int ret = TEMP_FAILURE_RETRY(sigtimedwait(&child_mask, nullptr, &ts));
-    int saved_errno = errno;
+    // Sections may run commands on several threads at once, and any of them can accept the
+    // SIGCHLD of another one's child. So the signal only tells that some child exited: check for
+    // ours, and do not wait for it for long at a time since the signal may never come.
+    const uint64_t deadline = Nanotime() + timeout_ms * NANOS_PER_MILLI;
+    pid_t child_pid;
+    int ret = 0;
+    int saved_errno = 0;
+    while ((child_pid = waitpid(pid, status, WNOHANG)) == 0) {
+        const uint64_t now = Nanotime();
+        if (now >= deadline) {
+            ret = -1;
+            saved_errno = EAGAIN;
+            break;
+        }
+        const uint64_t wait_ns = std::min(deadline - now, 100 * NANOS_PER_MILLI);
+        timespec ts;
+        ts.tv_sec = wait_ns / NANOS_PER_SEC;
+        ts.tv_nsec = wait_ns % NANOS_PER_SEC;
+        if (TEMP_FAILURE_RETRY(sigtimedwait(&child_mask, nullptr, &ts)) == -1 &&
+            errno != EAGAIN) {
+            ret = -1;
+            saved_errno = errno;
+            break;
+        }
+    }
 
     // Set the signals back the way they were.
     if (sigprocmask(SIG_SETMASK, &old_mask, nullptr) == -1) {
         printf("*** sigprocmask failed: %s\n", strerror(errno));
-        if (ret == 0) {
+        if (ret == 0 && child_pid != pid) {
             return false;
         }
     }
@@ -76,7 +97,6 @@ static bool waitpid_with_timeout(pid_t pid, int timeout_ms, int* status) {
         return false;
     }
 
-    pid_t child_pid = waitpid(pid, status, WNOHANG);
     if (child_pid != pid) {
         if (child_pid != -1) {
             printf("*** Waiting for pid %d, got pid %d instead\n", pid, child_pid);
@@ -48,11 +48,13 @@
 #include <fstream>
 #include <functional>
 #include <future>
+#include <map>
 #include <memory>
 #include <numeric>
 #include <regex>
 #include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -83,6 +85,7 @@
 #include <private/android_logger.h>
 #include <serviceutils/PriorityDumper.h>
 #include <utils/StrongPointer.h>
+#include "DumpPool.h"
 #include "DumpstateInternal.h"
 #include "DumpstateService.h"
 #include "dumpstate.h"
@@ -112,6 +115,7 @@ using android::base::StringPrintf;
 using android::os::IDumpstateListener;
 using android::os::dumpstate::CommandOptions;
 using android::os::dumpstate::DumpFileToFd;
+using android::os::dumpstate::DumpPool;
 using android::os::dumpstate::PropertiesHelper;
 
 // Keep in sync with
@@ -121,12 +125,20 @@ static const int TRACE_DUMP_TIMEOUT_MS = 10000; // 10 seconds
 /* Most simple commands have 10 as timeout, so 5 is a good estimate */
 static const int32_t WEIGHT_FILE = 5;
 
+// Sections run on a DumpPool, and how long to wait for them when the default is not enough.
+static const std::string DUMP_HALS_TASK = "DUMP HALS";
+static const std::string DUMP_CHECKINS_TASK = "DUMP CHECKINS";
+static const std::string DUMP_APP_INFOS_TASK = "DUMP APP INFOS";
+static const std::string DUMP_INCIDENT_REPORT_TASK = "INCIDENT REPORT";
+static const std::chrono::milliseconds DUMP_APP_INFOS_TIMEOUT = std::chrono::minutes(6);
+static const std::chrono::milliseconds DUMP_INCIDENT_REPORT_TIMEOUT = std::chrono::minutes(3);
+
 // TODO: temporary variables and functions used during C++ refactoring
 static Dumpstate& ds = Dumpstate::GetInstance();
 static int RunCommand(const std::string& title, const std::vector<std::string>& full_command,
                       const CommandOptions& options = CommandOptions::DEFAULT,
-                      bool verbose_duration = false) {
-    return ds.RunCommand(title, full_command, options, verbose_duration);
+                      bool verbose_duration = false, int out_fd = STDOUT_FILENO) {
+    return ds.RunCommand(title, full_command, options, verbose_duration, out_fd);
 }
 
 // Reasonable value for max stats.
@@ -305,8 +317,8 @@ static bool CopyFileToFile(const std::string& input_file, const std::string& out
 
 static void RunDumpsys(const std::string& title, const std::vector<std::string>& dumpsysArgs,
                        const CommandOptions& options = Dumpstate::DEFAULT_DUMPSYS,
-                       long dumpsysTimeoutMs = 0) {
-    return ds.RunDumpsys(title, dumpsysArgs, options, dumpsysTimeoutMs);
+                       long dumpsysTimeoutMs = 0, int out_fd = STDOUT_FILENO) {
+    return ds.RunDumpsys(title, dumpsysArgs, options, dumpsysTimeoutMs, out_fd);
 }
 static int DumpFile(const std::string& title, const std::string& path) {
     return ds.DumpFile(title, path);
@@ -786,6 +798,7 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
 
     // Logging statement  below is useful to time how long each entry takes, but it's too verbose.
     // MYLOGD("Adding zip entry %s\n", entry_name.c_str());
+    std::lock_guard<std::recursive_mutex> lock(zip_lock_);
     int32_t err = zip_writer_->StartEntryWithTime(valid_name.c_str(), ZipWriter::kCompress,
                                                   get_mtime(fd, ds.now_));
     if (err != 0) {
@@ -865,6 +878,47 @@ bool Dumpstate::AddZipEntry(const std::string& entry_name, const std::string& en
     return (AddZipEntryFromFd(entry_name, fd.get()) == OK);
 }
 
+bool Dumpstate::AddZipEntryFromCommand(const std::string& entry_name,
+                                       const std::vector<std::string>& full_command,
+                                       const CommandOptions& options) {
+    if (!IsZipping()) {
+        MYLOGD("Not adding zip entry %s from command because it's not a zipped bugreport\n",
+               entry_name.c_str());
+        return false;
+    }
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) != 0) {
+        MYLOGE("pipe2(%s): %s\n", entry_name.c_str(), strerror(errno));
+        return false;
+    }
+    android::base::unique_fd read_fd(pipe_fds[0]);
+    android::base::unique_fd write_fd(pipe_fds[1]);
+
+    // The command writes into the pipe while this thread compresses what it read so far; closing
+    // the write end once the command is done ends the entry.
+    std::thread command_thread(
+            [&full_command, &options, write_fd = std::move(write_fd)]() mutable {
+                RunCommandToFd(write_fd.get(), "", full_command, options);
+                write_fd.reset();
+            });
+
+    // Only take the zip over once there is something to add to it.
+    bool added = false;
+    struct pollfd pfd = {read_fd.get(), POLLIN};
+    int rc = TEMP_FAILURE_RETRY(poll(&pfd, 1, -1));
+    if (rc < 0) {
+        MYLOGE("Error in poll while adding the output of a command to zip entry %s: %s\n",
+               entry_name.c_str(), strerror(errno));
+    } else if (pfd.revents & POLLIN) {
+        added = AddZipEntryFromFd(entry_name, read_fd.get()) == OK;
+    }
+
+    // Lets the command fail on a broken pipe if the entry could not be written.
+    read_fd.reset();
+    command_thread.join();
+    return added;
+}
+
 /* adds a file to the existing zipped bugreport */
 static int _add_file_from_fd(const char* title __attribute__((unused)), const char* path, int fd) {
     return (ds.AddZipEntryFromFd(ZIP_ROOT_DIR + path, fd) == OK) ? 0 : 1;
@@ -887,6 +941,7 @@ bool Dumpstate::AddTextZipEntry(const std::string& entry_name, const std::string
         return false;
     }
     MYLOGD("Adding zip text entry %s\n", entry_name.c_str());
+    std::lock_guard<std::recursive_mutex> lock(zip_lock_);
     int32_t err = zip_writer_->StartEntryWithTime(entry_name.c_str(), ZipWriter::kCompress, ds.now_);
     if (err != 0) {
         MYLOGE("zip_writer_->StartEntryWithTime(%s): %s\n", entry_name.c_str(),
@@ -1008,23 +1063,11 @@ static void DumpVisibleWindowViews() {
         return;
     }
     DurationReporter duration_reporter("VISIBLE WINDOW VIEWS");
-    const std::string path = ds.bugreport_internal_dir_ + "/tmp_visible_window_views";
-    auto fd = android::base::unique_fd(TEMP_FAILURE_RETRY(open(path.c_str(),
-                O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW,
-                S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)));
-    if (fd < 0) {
-        MYLOGE("Could not open %s to dump visible views.\n", path.c_str());
-        return;
-    }
-    RunCommandToFd(fd, "", {"cmd", "window", "dump-visible-window-views"},
-                   CommandOptions::WithTimeout(120).Build());
-    bool empty = 0 == lseek(fd, 0, SEEK_END);
-    if (!empty) {
-        ds.AddZipEntry("visible_windows.zip", path);
-    } else {
+    if (!ds.AddZipEntryFromCommand("visible_windows.zip",
+                                   {"cmd", "window", "dump-visible-window-views"},
+                                   CommandOptions::WithTimeout(120).Build())) {
         MYLOGW("Failed to dump visible windows\n");
     }
-    unlink(path.c_str());
 }
 
 static void DumpIpTablesAsRoot() {
@@ -1239,6 +1282,7 @@ static Dumpstate::RunStatus RunDumpsysProto(const std::string& title, int priori
             path.append("_HIGH");
         }
         path.append(kProtoExt);
+        std::lock_guard<std::recursive_mutex> lock(ds.zip_lock_);
         status_t status = dumpsys.startDumpThread(Dumpsys::Type::DUMP, service, args);
         if (status == OK) {
             status = ds.AddZipEntryFromFd(path, dumpsys.getDumpFd(), service_timeout);
@@ -1294,15 +1338,18 @@ static Dumpstate::RunStatus RunDumpsysNormal() {
                            /* timeout= */ 90s, /* service_timeout= */ 10s);
 }
 
-static void DumpHals() {
+static void DumpHals(int out_fd = STDOUT_FILENO) {
     if (!ds.IsZipping()) {
         RunCommand("HARDWARE HALS", {"lshal", "-lVSietrpc", "--types=b,c,l,z", "--debug"},
-                   CommandOptions::WithTimeout(10).AsRootIfAvailable().Build());
+                   CommandOptions::WithTimeout(10).AsRootIfAvailable().Build(),
+                   false /* verbose_duration */, out_fd);
         return;
     }
-    DurationReporter duration_reporter("DUMP HALS");
+    DurationReporter duration_reporter("DUMP HALS", false /* logcat_only */, false /* verbose */,
+                                       out_fd);
     RunCommand("HARDWARE HALS", {"lshal", "-lVSietrpc", "--types=b,c,l,z"},
-               CommandOptions::WithTimeout(10).AsRootIfAvailable().Build());
+               CommandOptions::WithTimeout(10).AsRootIfAvailable().Build(),
+               false /* verbose_duration */, out_fd);
 
     using android::hidl::manager::V1_0::IServiceManager;
     using android::hardware::defaultServiceManager;
@@ -1322,29 +1369,9 @@ static void DumpHals() {
                                 return !isalnum(c) &&
                                     std::string("@-_:.").find(c) == std::string::npos;
                             }, '_');
-            const std::string path = ds.bugreport_internal_dir_ + "/lshal_debug_" + cleanName;
-
-            {
-                auto fd = android::base::unique_fd(
-                    TEMP_FAILURE_RETRY(open(path.c_str(),
-                    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW,
-                    S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)));
-                if (fd < 0) {
-                    MYLOGE("Could not open %s to dump additional hal information.\n", path.c_str());
-                    continue;
-                }
-                RunCommandToFd(fd,
-                        "",
-                        {"lshal", "debug", "-E", interface},
-                        CommandOptions::WithTimeout(2).AsRootIfAvailable().Build());
-
-                bool empty = 0 == lseek(fd, 0, SEEK_END);
-                if (!empty) {
-                    ds.AddZipEntry("lshal-debug/" + cleanName + ".txt", path);
-                }
-            }
-
-            unlink(path.c_str());
+            ds.AddZipEntryFromCommand("lshal-debug/" + cleanName + ".txt",
+                                      {"lshal", "debug", "-E", interface},
+                                      CommandOptions::WithTimeout(2).AsRootIfAvailable().Build());
         }
     });
 
@@ -1353,6 +1380,69 @@ static void DumpHals() {
     }
 }
 
+static void DumpCheckins(int out_fd = STDOUT_FILENO) {
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== Checkins\n");
+    dprintf(out_fd, "========================================================\n");
+
+    RunDumpsys("CHECKIN BATTERYSTATS", {"batterystats", "-c"}, Dumpstate::DEFAULT_DUMPSYS, 0,
+               out_fd);
+
+    // Slow, so not worth running once the user denied consent; the caller checks it again.
+    if (!ds.IsUserConsentDenied()) {
+        RunDumpsys("CHECKIN MEMINFO", {"meminfo", "--checkin"}, Dumpstate::DEFAULT_DUMPSYS, 0,
+                   out_fd);
+    }
+
+    RunDumpsys("CHECKIN NETSTATS", {"netstats", "--checkin"}, Dumpstate::DEFAULT_DUMPSYS, 0,
+               out_fd);
+    RunDumpsys("CHECKIN PROCSTATS", {"procstats", "-c"}, Dumpstate::DEFAULT_DUMPSYS, 0, out_fd);
+    RunDumpsys("CHECKIN USAGESTATS", {"usagestats", "-c"}, Dumpstate::DEFAULT_DUMPSYS, 0, out_fd);
+    RunDumpsys("CHECKIN PACKAGE", {"package", "--checkin"}, Dumpstate::DEFAULT_DUMPSYS, 0,
+               out_fd);
+}
+
+static void DumpAppInfos(int out_fd = STDOUT_FILENO) {
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== Running Application Activities\n");
+    dprintf(out_fd, "========================================================\n");
+
+    // The following dumpsys internally collects output from running apps, so it can take a long
+    // time. So let's extend the timeout.
+
+    const CommandOptions DUMPSYS_COMPONENTS_OPTIONS = CommandOptions::WithTimeout(60).Build();
+
+    RunDumpsys("APP ACTIVITIES", {"activity", "-v", "all"}, DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== Running Application Services (platform)\n");
+    dprintf(out_fd, "========================================================\n");
+
+    RunDumpsys("APP SERVICES PLATFORM", {"activity", "service", "all-platform-non-critical"},
+               DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== Running Application Services (non-platform)\n");
+    dprintf(out_fd, "========================================================\n");
+
+    RunDumpsys("APP SERVICES NON-PLATFORM", {"activity", "service", "all-non-platform"},
+               DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== Running Application Providers (platform)\n");
+    dprintf(out_fd, "========================================================\n");
+
+    RunDumpsys("APP PROVIDERS PLATFORM", {"activity", "provider", "all-platform"},
+               DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+
+    dprintf(out_fd, "========================================================\n");
+    dprintf(out_fd, "== Running Application Providers (non-platform)\n");
+    dprintf(out_fd, "========================================================\n");
+
+    RunDumpsys("APP PROVIDERS NON-PLATFORM", {"activity", "provider", "all-non-platform"},
+               DUMPSYS_COMPONENTS_OPTIONS, 0, out_fd);
+}
+
 static void DumpExternalFragmentationInfo() {
     struct stat st;
     if (stat("/proc/buddyinfo", &st) != 0) {
@@ -1432,6 +1522,161 @@ static void DumpstateLimitedOnly() {
     printf("========================================================\n");
 }
 
+// What a snapshot needs from the previous one: when its logs were read, and the digest of
+// each section that is only dumped when it changes, by title.
+struct SnapshotState {
+    std::string logcat_since;
+    std::map<std::string, std::string> digests;
+};
+
+static std::string GetSnapshotStatePath() {
+    return ds.bugreport_internal_dir_ + "/snapshot_state.txt";
+}
+
+static SnapshotState LoadSnapshotState() {
+    SnapshotState state;
+    std::string content;
+    if (!android::base::ReadFileToString(GetSnapshotStatePath(), &content)) {
+        MYLOGI("No previous snapshot state; taking a full snapshot\n");
+        return state;
+    }
+    for (const std::string& line : android::base::Split(content, "\n")) {
+        // Lines are "logcat_since <time>" or "digest <sha256> <title>".
+        std::vector<std::string> fields = android::base::Split(line, " ");
+        if (fields.size() == 2 && fields[0] == "logcat_since") {
+            state.logcat_since = fields[1];
+        } else if (fields.size() >= 3 && fields[0] == "digest") {
+            const size_t title_start = fields[0].size() + fields[1].size() + 2;
+            state.digests[line.substr(title_start)] = fields[1];
+        }
+    }
+    return state;
+}
+
+static void SaveSnapshotState(const SnapshotState& state) {
+    std::string content = "logcat_since " + state.logcat_since + "\n";
+    for (const auto& [title, digest] : state.digests) {
+        content += "digest " + digest + " " + title + "\n";
+    }
+    if (!android::base::WriteStringToFile(content, GetSnapshotStatePath())) {
+        MYLOGE("Could not save snapshot state to %s: %s\n", GetSnapshotStatePath().c_str(),
+               strerror(errno));
+    }
+}
+
+// Digest of a section's output, leaving out the "------" lines around it, which hold timings.
+static std::string SectionDigest(const std::string& output) {
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    for (const std::string& line : android::base::Split(output, "\n")) {
+        if (!android::base::StartsWith(line, "------ ")) {
+            SHA256_Update(&ctx, line.data(), line.size());
+            SHA256_Update(&ctx, "\n", 1);
+        }
+    }
+    uint8_t hash[SHA256_DIGEST_LENGTH];
+    SHA256_Final(hash, &ctx);
+    std::string digest;
+    for (uint8_t byte : hash) {
+        digest += StringPrintf("%02x", byte);
+    }
+    return digest;
+}
+
+// Runs |dump_section| into a temporary file, and only copies what it wrote to the bugreport if
+// it differs from what it wrote in the previous snapshot.
+static void DumpSectionIfChanged(const std::string& title, SnapshotState* state,
+                                 const std::function<void(int)>& dump_section) {
+    std::string path = ds.bugreport_internal_dir_ + "/snapshot_XXXXXX";
+    android::base::unique_fd fd(TEMP_FAILURE_RETRY(mkostemp(&path[0], O_CLOEXEC)));
+    if (fd.get() < 0) {
+        MYLOGE("Could not create a file for section %s: %s\n", title.c_str(), strerror(errno));
+        return;
+    }
+    unlink(path.c_str());
+
+    dump_section(fd.get());
+    std::string output;
+    if (lseek(fd.get(), 0, SEEK_SET) == -1 || !android::base::ReadFdToString(fd.get(), &output)) {
+        MYLOGE("Could not read section %s: %s\n", title.c_str(), strerror(errno));
+        return;
+    }
+
+    std::string digest = SectionDigest(output);
+    std::string& last_digest = state->digests[title];
+    if (digest == last_digest) {
+        printf("------ %s: unchanged since the last snapshot ------\n", title.c_str());
+        return;
+    }
+    last_digest = std::move(digest);
+    android::base::WriteStringToFd(output, STDOUT_FILENO);
+}
+
+static void DumpstateSnapshotOnly() {
+    // Meant to be taken every few minutes: logs only since the previous snapshot, sections that
+    // are cheap to collect, and sections that are cheap to collect but large only if they
+    // changed. Expensive sections, such as most of dumpsys, are left to full bugreports.
+    DurationReporter duration_reporter("DUMPSTATE");
+    SnapshotState state = LoadSnapshotState();
+
+    // The next snapshot reads the logs from when this one started reading them, so that lines
+    // logged in between are repeated rather than missed.
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    std::vector<std::string> logcat_since;
+    if (!state.logcat_since.empty()) {
+        printf("== Logs since %s\n", state.logcat_since.c_str());
+        logcat_since = {"-T", state.logcat_since};
+    }
+    state.logcat_since = StringPrintf("%ld.%03ld", static_cast<long>(now.tv_sec),
+                                      static_cast<long>(now.tv_nsec / 1000000));
+
+    const auto logcat = [&logcat_since](std::vector<std::string> args) {
+        std::vector<std::string> command = {"logcat", "-v", "threadtime", "-v", "printable",
+                                            "-v", "uid", "-d", "*:v"};
+        command.insert(command.end(), args.begin(), args.end());
+        command.insert(command.end(), logcat_since.begin(), logcat_since.end());
+        return command;
+    };
+    RunCommand("SYSTEM LOG", logcat({}),
+               CommandOptions::WithTimeoutInMs(logcat_timeout({"main", "system", "crash"}))
+                       .Build());
+    RunCommand("EVENT LOG", logcat({"-b", "events"}),
+               CommandOptions::WithTimeoutInMs(logcat_timeout({"events"})).Build());
+
+    RunCommand("UPTIME", {"uptime"});
+    DumpFile("MEMORY INFO", "/proc/meminfo");
+    DumpFile("VIRTUAL MEMORY STATS", "/proc/vmstat");
+    DumpFile("CPU PRESSURE", "/proc/pressure/cpu");
+    DumpFile("MEMORY PRESSURE", "/proc/pressure/memory");
+    DumpFile("IO PRESSURE", "/proc/pressure/io");
+
+    DumpSectionIfChanged("PROCESSES", &state, [](int out_fd) {
+        RunCommand("PROCESSES", {"ps", "-A", "-o", "PID,PPID,USER,NAME"},
+                   CommandOptions::DEFAULT, false, out_fd);
+    });
+    DumpSectionIfChanged("MOUNTS", &state, [](int out_fd) {
+        DumpFileToFd(out_fd, "MOUNTS", "/proc/mounts");
+    });
+    DumpSectionIfChanged("DUMPSYS BATTERY", &state, [](int out_fd) {
+        RunDumpsys("DUMPSYS BATTERY", {"battery"}, Dumpstate::DEFAULT_DUMPSYS, 0, out_fd);
+    });
+    DumpSectionIfChanged("DROPBOX SYSTEM SERVER CRASHES", &state, [](int out_fd) {
+        RunDumpsys("DROPBOX SYSTEM SERVER CRASHES", {"dropbox", "-p", "system_server_crash"},
+                   Dumpstate::DEFAULT_DUMPSYS, 0, out_fd);
+    });
+    DumpSectionIfChanged("DROPBOX SYSTEM APP CRASHES", &state, [](int out_fd) {
+        RunDumpsys("DROPBOX SYSTEM APP CRASHES", {"dropbox", "-p", "system_app_crash"},
+                   Dumpstate::DEFAULT_DUMPSYS, 0, out_fd);
+    });
+
+    SaveSnapshotState(state);
+
+    printf("========================================================\n");
+    printf("== dumpstate: done (id %d)\n", ds.id_);
+    printf("========================================================\n");
+}
+
 // Dumps various things. Returns early with status USER_CONSENT_DENIED if user denies consent
 // via the consent they are shown. Ignores other errors that occur while running various
 // commands. The consent checking is currently done around long running tasks, which happen to
@@ -1439,6 +1684,19 @@ static void DumpstateLimitedOnly() {
 static Dumpstate::RunStatus dumpstate() {
     DurationReporter duration_reporter("DUMPSTATE");
 
+    // Slow sections that do not depend on the others run in the background; their output is
+    // copied to the report where they used to run, so that it reads the same.
+    DumpPool dump_pool(ds.bugreport_internal_dir_);
+    dump_pool.start();
+    dump_pool.enqueueTask(DUMP_HALS_TASK, [](int out_fd) { DumpHals(out_fd); });
+    dump_pool.enqueueTask(DUMP_CHECKINS_TASK, [](int out_fd) { DumpCheckins(out_fd); });
+    dump_pool.enqueueTask(DUMP_APP_INFOS_TASK, [](int out_fd) { DumpAppInfos(out_fd); });
+    dump_pool.enqueueTask(DUMP_INCIDENT_REPORT_TASK, [](int) {
+        if (!ds.IsUserConsentDenied()) {
+            DumpIncidentReport();
+        }
+    });
+
     // Dump various things. Note that anything that takes "long" (i.e. several seconds) should
     // check intermittently (if it's intrerruptable like a foreach on pids) and/or should be wrapped
     // in a consent check (via RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK).
@@ -1470,7 +1728,7 @@ static Dumpstate::RunStatus dumpstate() {
     RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunCommand, "LIBRANK", {"librank"},
                                          CommandOptions::AS_ROOT);
 
-    DumpHals();
+    dump_pool.waitForTask(DUMP_HALS_TASK);
 
     RunCommand("PRINTENV", {"printenv"});
     RunCommand("NETSTAT", {"netstat", "-nW"});
@@ -1574,57 +1832,11 @@ static Dumpstate::RunStatus dumpstate() {
 
     RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsysNormal);
 
-    printf("========================================================\n");
-    printf("== Checkins\n");
-    printf("========================================================\n");
-
-    RunDumpsys("CHECKIN BATTERYSTATS", {"batterystats", "-c"});
-
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunDumpsys, "CHECKIN MEMINFO", {"meminfo", "--checkin"});
-
-    RunDumpsys("CHECKIN NETSTATS", {"netstats", "--checkin"});
-    RunDumpsys("CHECKIN PROCSTATS", {"procstats", "-c"});
-    RunDumpsys("CHECKIN USAGESTATS", {"usagestats", "-c"});
-    RunDumpsys("CHECKIN PACKAGE", {"package", "--checkin"});
-
-    printf("========================================================\n");
-    printf("== Running Application Activities\n");
-    printf("========================================================\n");
-
-    // The following dumpsys internally collects output from running apps, so it can take a long
-    // time. So let's extend the timeout.
-
-    const CommandOptions DUMPSYS_COMPONENTS_OPTIONS = CommandOptions::WithTimeout(60).Build();
-
-    RunDumpsys("APP ACTIVITIES", {"activity", "-v", "all"}, DUMPSYS_COMPONENTS_OPTIONS);
-
-    printf("========================================================\n");
-    printf("== Running Application Services (platform)\n");
-    printf("========================================================\n");
-
-    RunDumpsys("APP SERVICES PLATFORM", {"activity", "service", "all-platform-non-critical"},
-            DUMPSYS_COMPONENTS_OPTIONS);
-
-    printf("========================================================\n");
-    printf("== Running Application Services (non-platform)\n");
-    printf("========================================================\n");
-
-    RunDumpsys("APP SERVICES NON-PLATFORM", {"activity", "service", "all-non-platform"},
-            DUMPSYS_COMPONENTS_OPTIONS);
-
-    printf("========================================================\n");
-    printf("== Running Application Providers (platform)\n");
-    printf("========================================================\n");
-
-    RunDumpsys("APP PROVIDERS PLATFORM", {"activity", "provider", "all-platform"},
-            DUMPSYS_COMPONENTS_OPTIONS);
-
-    printf("========================================================\n");
-    printf("== Running Application Providers (non-platform)\n");
-    printf("========================================================\n");
+    RETURN_IF_USER_DENIED_CONSENT();
+    dump_pool.waitForTask(DUMP_CHECKINS_TASK);
+    RETURN_IF_USER_DENIED_CONSENT();
 
-    RunDumpsys("APP PROVIDERS NON-PLATFORM", {"activity", "provider", "all-non-platform"},
-            DUMPSYS_COMPONENTS_OPTIONS);
+    dump_pool.waitForTask(DUMP_APP_INFOS_TASK, STDOUT_FILENO, DUMP_APP_INFOS_TIMEOUT);
 
     printf("========================================================\n");
     printf("== Dropbox crashes\n");
@@ -1649,7 +1861,9 @@ static Dumpstate::RunStatus dumpstate() {
     // Add linker configuration directory
     ds.AddDir(LINKERCONFIG_DIR, true);
 
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(DumpIncidentReport);
+    RETURN_IF_USER_DENIED_CONSENT();
+    dump_pool.waitForTask(DUMP_INCIDENT_REPORT_TASK, STDOUT_FILENO, DUMP_INCIDENT_REPORT_TIMEOUT);
+    RETURN_IF_USER_DENIED_CONSENT();
 
     return Dumpstate::RunStatus::OK;
 }
@@ -2118,7 +2332,7 @@ void Dumpstate::DumpstateBoard() {
 static void ShowUsage() {
     fprintf(stderr,
             "usage: dumpstate [-h] [-b soundfile] [-e soundfile] [-o directory] [-d] [-p] "
-            "[-z] [-s] [-S] [-q] [-P] [-R] [-L] [-V version]\n"
+            "[-z] [-s] [-S] [-q] [-P] [-R] [-L] [-I] [-V version]\n"
             "  -h: display this help message\n"
             "  -b: play sound file instead of vibrate, at beginning of job\n"
             "  -e: play sound file instead of vibrate, at end of job\n"
@@ -2133,6 +2347,7 @@ static void ShowUsage() {
             "  -R: take bugreport in remote mode (requires -z and -d, shouldn't be used with -P)\n"
             "  -w: start binder service and make it wait for a call to startBugreport\n"
             "  -L: output limited information that is safe for submission in feedback reports\n"
+            "  -I: output a small snapshot of what changed since the previous one\n"
             "  -v: prints the dumpstate header and exit\n");
 }
 
@@ -2244,6 +2459,8 @@ static void PrepareToWriteToFile() {
         ds.base_name_ += "-telephony";
     } else if (ds.options_->wifi_only) {
         ds.base_name_ += "-wifi";
+    } else if (ds.options_->snapshot_only) {
+        ds.base_name_ += "-snapshot";
     }
 
     if (ds.options_->do_screenshot) {
@@ -2385,12 +2602,13 @@ static void LogDumpOptions(const Dumpstate::DumpOptions& options) {
         "do_zip_file: %d do_vibrate: %d use_socket: %d use_control_socket: %d do_screenshot: %d "
         "is_remote_mode: %d show_header_only: %d do_start_service: %d telephony_only: %d "
         "wifi_only: %d do_progress_updates: %d fd: %d bugreport_mode: %s dumpstate_hal_mode: %s "
-        "limited_only: %d args: %s\n",
+        "limited_only: %d snapshot_only: %d args: %s\n",
         options.do_zip_file, options.do_vibrate, options.use_socket, options.use_control_socket,
         options.do_screenshot, options.is_remote_mode, options.show_header_only,
         options.do_start_service, options.telephony_only, options.wifi_only,
         options.do_progress_updates, options.bugreport_fd.get(), options.bugreport_mode.c_str(),
-        toString(options.dumpstate_hal_mode).c_str(), options.limited_only, options.args.c_str());
+        toString(options.dumpstate_hal_mode).c_str(), options.limited_only, options.snapshot_only,
+        options.args.c_str());
 }
 
 void Dumpstate::DumpOptions::Initialize(BugreportMode bugreport_mode,
@@ -2412,7 +2630,7 @@ void Dumpstate::DumpOptions::Initialize(BugreportMode bugreport_mode,
 Dumpstate::RunStatus Dumpstate::DumpOptions::Initialize(int argc, char* argv[]) {
     RunStatus status = RunStatus::OK;
     int c;
-    while ((c = getopt(argc, argv, "dho:svqzpLPBRSV:w")) != -1) {
+    while ((c = getopt(argc, argv, "dho:svqzpLIPBRSV:w")) != -1) {
         switch (c) {
             // clang-format off
             case 'd': do_add_date = true;            break;
@@ -2426,6 +2644,7 @@ Dumpstate::RunStatus Dumpstate::DumpOptions::Initialize(int argc, char* argv[])
             case 'P': do_progress_updates = true;    break;
             case 'R': is_remote_mode = true;         break;
             case 'L': limited_only = true;           break;
+            case 'I': snapshot_only = true;          break;
             case 'V':                                break;  // compatibility no-op
             case 'w':
                 // This was already processed
@@ -2470,6 +2689,10 @@ bool Dumpstate::DumpOptions::ValidateOptions() const {
     if (is_remote_mode && (do_progress_updates || !do_zip_file || !do_add_date)) {
         return false;
     }
+
+    if (snapshot_only && (limited_only || telephony_only || wifi_only)) {
+        return false;
+    }
     return true;
 }
 
@@ -2727,6 +2950,10 @@ Dumpstate::RunStatus Dumpstate::RunInternal(int32_t calling_uid,
         onUiIntensiveBugreportDumpsFinished(calling_uid, calling_package);
         MaybeCheckUserConsent(calling_uid, calling_package);
         DumpstateLimitedOnly();
+    } else if (options_->snapshot_only) {
+        onUiIntensiveBugreportDumpsFinished(calling_uid, calling_package);
+        MaybeCheckUserConsent(calling_uid, calling_package);
+        DumpstateSnapshotOnly();
     } else {
         // Invoke critical dumpsys first to preserve system state, before doing anything else.
         RunDumpsysCritical();
@@ -2989,8 +3216,9 @@ Dumpstate& Dumpstate::GetInstance() {
     return singleton_;
 }
 
-DurationReporter::DurationReporter(const std::string& title, bool logcat_only, bool verbose)
-    : title_(title), logcat_only_(logcat_only), verbose_(verbose) {
+DurationReporter::DurationReporter(const std::string& title, bool logcat_only, bool verbose,
+                                   int duration_fd)
+    : title_(title), logcat_only_(logcat_only), verbose_(verbose), duration_fd_(duration_fd) {
     if (!title_.empty()) {
         started_ = Nanotime();
     }
@@ -3004,7 +3232,8 @@ DurationReporter::~DurationReporter() {
         }
         if (!logcat_only_) {
             // Use "Yoda grammar" to make it easier to grep|sort sections.
-            printf("------ %.3fs was the duration of '%s' ------\n", elapsed, title_.c_str());
+            dprintf(duration_fd_, "------ %.3fs was the duration of '%s' ------\n", elapsed,
+                    title_.c_str());
         }
     }
 }
@@ -3590,10 +3819,10 @@ int dump_file_from_fd(const char *title, const char *path, int fd) {
 }
 
 int Dumpstate::RunCommand(const std::string& title, const std::vector<std::string>& full_command,
-                          const CommandOptions& options, bool verbose_duration) {
-    DurationReporter duration_reporter(title, false /* logcat_only */, verbose_duration);
+                          const CommandOptions& options, bool verbose_duration, int out_fd) {
+    DurationReporter duration_reporter(title, false /* logcat_only */, verbose_duration, out_fd);
 
-    int status = RunCommandToFd(STDOUT_FILENO, title, full_command, options);
+    int status = RunCommandToFd(out_fd, title, full_command, options);
 
     /* TODO: for now we're simplifying the progress calculation by using the
      * timeout as the weight. It's a good approximation for most cases, except when calling dumpsys,
@@ -3605,11 +3834,11 @@ int Dumpstate::RunCommand(const std::string& title, const std::vector<std::strin
 }
 
 void Dumpstate::RunDumpsys(const std::string& title, const std::vector<std::string>& dumpsys_args,
-                           const CommandOptions& options, long dumpsysTimeoutMs) {
+                           const CommandOptions& options, long dumpsysTimeoutMs, int out_fd) {
     long timeout_ms = dumpsysTimeoutMs > 0 ? dumpsysTimeoutMs : options.TimeoutInMs();
     std::vector<std::string> dumpsys = {"/system/bin/dumpsys", "-T", std::to_string(timeout_ms)};
     dumpsys.insert(dumpsys.end(), dumpsys_args.begin(), dumpsys_args.end());
-    RunCommand(title, dumpsys, options);
+    RunCommand(title, dumpsys, options, false /* verbose_duration */, out_fd);
 }
 
 int open_socket(const char *service) {
@@ -3734,6 +3963,7 @@ void dump_route_tables() {
 
 // TODO: make this function thread safe if sections are generated in parallel.
 void Dumpstate::UpdateProgress(int32_t delta_sec) {
+    std::lock_guard<std::mutex> lock(progress_lock_);
     if (progress_ == nullptr) {
         MYLOGE("UpdateProgress: progress_ not set\n");
         return;
@@ -22,6 +22,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -75,7 +76,7 @@ extern "C" {
 class DurationReporter {
   public:
     explicit DurationReporter(const std::string& title, bool logcat_only = false,
-                              bool verbose = false);
+                              bool verbose = false, int duration_fd = STDOUT_FILENO);
 
     ~DurationReporter();
 
@@ -83,6 +84,7 @@ class DurationReporter {
     std::string title_;
     bool logcat_only_;
     bool verbose_;
+    int duration_fd_;
     uint64_t started_;
 
     DISALLOW_COPY_AND_ASSIGN(DurationReporter);
@@ -227,11 +229,12 @@ class Dumpstate {
      * |full_command| array containing the command (first entry) and its arguments.
      * Must contain at least one element.
      * |options| optional argument defining the command's behavior.
+     * |out_fd| where the output goes; sections running on a DumpPool must not use `stdout`.
      */
     int RunCommand(const std::string& title, const std::vector<std::string>& fullCommand,
                    const android::os::dumpstate::CommandOptions& options =
                        android::os::dumpstate::CommandOptions::DEFAULT,
-                   bool verbose_duration = false);
+                   bool verbose_duration = false, int out_fd = STDOUT_FILENO);
 
     /*
      * Runs `dumpsys` with the given arguments, automatically setting its timeout
@@ -244,10 +247,11 @@ class Dumpstate {
      * |options| optional argument defining the command's behavior.
      * |dumpsys_timeout| when > 0, defines the value passed to `dumpsys -T` (otherwise it uses the
      * timeout from `options`)
+     * |out_fd| where the output goes, as for RunCommand.
      */
     void RunDumpsys(const std::string& title, const std::vector<std::string>& dumpsys_args,
                     const android::os::dumpstate::CommandOptions& options = DEFAULT_DUMPSYS,
-                    long dumpsys_timeout_ms = 0);
+                    long dumpsys_timeout_ms = 0, int out_fd = STDOUT_FILENO);
 
     /*
      * Prints the contents of a file.
@@ -274,6 +278,15 @@ class Dumpstate {
     android::status_t AddZipEntryFromFd(const std::string& entry_name, int fd,
                                         std::chrono::milliseconds timeout);
 
+    /*
+     * Runs a command and streams its output into a new entry of the existing zip file, without
+     * going through a temporary file. Returns false, without adding the entry, when the command
+     * prints nothing.
+     */
+    bool AddZipEntryFromCommand(const std::string& entry_name,
+                                const std::vector<std::string>& full_command,
+                                const android::os::dumpstate::CommandOptions& options);
+
     /*
      * Adds a text entry to the existing zip file.
      */
@@ -379,6 +392,8 @@ class Dumpstate {
         bool wifi_only = false;
         // Trimmed-down version of dumpstate to only include whitelisted logs.
         bool limited_only = false;
+        // Small report of what changed since the previous snapshot, for taking often.
+        bool snapshot_only = false;
         // Whether progress updates should be published.
         bool do_progress_updates = false;
         // The mode we'll use when calling IDumpstateDevice::dumpstateBoard.
@@ -481,6 +496,9 @@ class Dumpstate {
     // Pointer to the zip structure.
     std::unique_ptr<ZipWriter> zip_writer_;
 
+    // Serializes the entries added by sections running on a DumpPool.
+    std::recursive_mutex zip_lock_;
+
     // Binder object listening to progress.
     android::sp<android::os::IDumpstateListener> listener_;
 
@@ -539,6 +557,9 @@ class Dumpstate {
 
     android::sp<ConsentCallback> consent_callback_;
 
+    // Guards the progress updates of sections running on a DumpPool.
+    std::mutex progress_lock_;
+
     DISALLOW_COPY_AND_ASSIGN(Dumpstate);
 };
 
@@ -17,6 +17,7 @@
 #define LOG_TAG "dumpstate"
 #include <cutils/log.h>
 
+#include "DumpPool.h"
 #include "DumpstateInternal.h"
 #include "DumpstateService.h"
 #include "android/os/BnDumpstate.h"
@@ -39,6 +40,7 @@
 #include <android-base/unique_fd.h>
 #include <android/hardware/dumpstate/1.1/types.h>
 #include <cutils/properties.h>
+#include <ziparchive/zip_archive.h>
 
 namespace android {
 namespace os {
@@ -49,6 +51,7 @@ using ::testing::EndsWith;
 using ::testing::HasSubstr;
 using ::testing::IsEmpty;
 using ::testing::IsNull;
+using ::testing::Not;
 using ::testing::NotNull;
 using ::testing::StartsWith;
 using ::testing::StrEq;
@@ -377,6 +380,37 @@ TEST_F(DumpOptionsTest, InitializeLimitedOnlyBugreport) {
     EXPECT_EQ(options_.dumpstate_hal_mode, DumpstateMode::DEFAULT);
 }
 
+TEST_F(DumpOptionsTest, InitializeSnapshotOnlyBugreport) {
+    // clang-format off
+    char* argv[] = {
+        const_cast<char*>("dumpstatez"),
+        const_cast<char*>("-S"),
+        const_cast<char*>("-d"),
+        const_cast<char*>("-z"),
+        const_cast<char*>("-q"),
+        const_cast<char*>("-I"),
+    };
+    // clang-format on
+
+    Dumpstate::RunStatus status = options_.Initialize(ARRAY_SIZE(argv), argv);
+
+    EXPECT_EQ(status, Dumpstate::RunStatus::OK);
+    EXPECT_TRUE(options_.do_add_date);
+    EXPECT_TRUE(options_.do_zip_file);
+    EXPECT_TRUE(options_.use_control_socket);
+    EXPECT_FALSE(options_.do_vibrate);
+    EXPECT_TRUE(options_.snapshot_only);
+
+    // Other options retain default values
+    EXPECT_FALSE(options_.show_header_only);
+    EXPECT_FALSE(options_.do_screenshot);
+    EXPECT_FALSE(options_.do_progress_updates);
+    EXPECT_FALSE(options_.is_remote_mode);
+    EXPECT_FALSE(options_.use_socket);
+    EXPECT_FALSE(options_.limited_only);
+    EXPECT_EQ(options_.dumpstate_hal_mode, DumpstateMode::DEFAULT);
+}
+
 TEST_F(DumpOptionsTest, InitializeDefaultBugReport) {
     // default: commandline options are not overridden
     // clang-format off
@@ -532,6 +566,14 @@ TEST_F(DumpOptionsTest, ValidateOptionsRemoteMode) {
     EXPECT_TRUE(options_.ValidateOptions());
 }
 
+TEST_F(DumpOptionsTest, ValidateOptionsSnapshotMode) {
+    options_.snapshot_only = true;
+    EXPECT_TRUE(options_.ValidateOptions());
+
+    options_.limited_only = true;
+    EXPECT_FALSE(options_.ValidateOptions());
+}
+
 class DumpstateTest : public DumpstateBaseTest {
   public:
     void SetUp() {
@@ -1007,6 +1049,34 @@ TEST_F(DumpstateTest, DumpFileUpdateProgress) {
     ds.listener_.clear();
 }
 
+TEST_F(DumpstateTest, AddZipEntryFromCommand) {
+    TemporaryFile zip_file;
+    ds.zip_file.reset(fdopen(dup(zip_file.fd), "wb"));
+    ASSERT_THAT(ds.zip_file.get(), NotNull());
+    ds.zip_writer_.reset(new ZipWriter(ds.zip_file.get()));
+
+    EXPECT_TRUE(ds.AddZipEntryFromCommand("echo.txt", {kEchoCommand, "streamed"},
+                                          CommandOptions::DEFAULT));
+    // Nothing to stream, so no entry either.
+    EXPECT_FALSE(ds.AddZipEntryFromCommand("empty.txt", {kEchoCommand, "-n"},
+                                           CommandOptions::DEFAULT));
+
+    EXPECT_EQ(0, ds.zip_writer_->Finish());
+    ds.zip_writer_.reset();
+    ds.zip_file.reset();
+
+    ZipArchiveHandle handle;
+    ASSERT_EQ(0, OpenArchive(zip_file.path, &handle));
+    ZipEntry entry;
+    ASSERT_EQ(0, FindEntry(handle, "echo.txt", &entry));
+    std::string content(entry.uncompressed_length, '\0');
+    ASSERT_EQ(0, ExtractToMemory(handle, &entry, reinterpret_cast<uint8_t*>(&content[0]),
+                                 content.size()));
+    EXPECT_THAT(content, StrEq("streamed\n"));
+    EXPECT_NE(0, FindEntry(handle, "empty.txt", &entry));
+    CloseArchive(handle);
+}
+
 class DumpstateServiceTest : public DumpstateBaseTest {
   public:
     DumpstateService dss;
@@ -1618,6 +1688,94 @@ TEST_F(DumpstateUtilTest, DumpFileOnDryRun) {
     EXPECT_THAT(out, EndsWith("skipped on dry run\n"));
 }
 
+class DumpPoolTest : public DumpstateBaseTest {
+  public:
+    void SetUp() {
+        DumpstateBaseTest::SetUp();
+        out_fd_.reset(TEMP_FAILURE_RETRY(open(out_file_.path, O_RDWR | O_TRUNC | O_CLOEXEC)));
+        ASSERT_GE(out_fd_.get(), 0) << "could not open " << out_file_.path;
+    }
+
+    std::string GetOutput() {
+        std::string content;
+        EXPECT_TRUE(android::base::ReadFileToString(out_file_.path, &content));
+        return content;
+    }
+
+    TemporaryDir tmp_dir_;
+    TemporaryFile out_file_;
+    android::base::unique_fd out_fd_;
+};
+
+TEST_F(DumpPoolTest, KeepsTheOrderOfTheSections) {
+    DumpPool pool(tmp_dir_.path);
+    pool.start(2);
+    // The first section finishes last.
+    pool.enqueueTask("slow", [](int out_fd) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        dprintf(out_fd, "slow\n");
+    });
+    pool.enqueueTask("fast", [](int out_fd) { dprintf(out_fd, "fast\n"); });
+
+    EXPECT_TRUE(pool.waitForTask("slow", out_fd_.get()));
+    dprintf(out_fd_.get(), "main\n");
+    EXPECT_TRUE(pool.waitForTask("fast", out_fd_.get()));
+    pool.shutdown();
+
+    EXPECT_THAT(GetOutput(), StrEq("slow\nmain\nfast\n"));
+}
+
+TEST_F(DumpPoolTest, RunsSectionsWhenNotStarted) {
+    DumpPool pool(tmp_dir_.path);
+    pool.enqueueTask("section", [](int out_fd) { dprintf(out_fd, "section\n"); });
+    dprintf(out_fd_.get(), "main\n");
+
+    EXPECT_TRUE(pool.waitForTask("section", out_fd_.get()));
+
+    EXPECT_THAT(GetOutput(), StrEq("main\nsection\n"));
+}
+
+TEST_F(DumpPoolTest, WaitTimesOut) {
+    DumpPool pool(tmp_dir_.path);
+    pool.start(1);
+    pool.enqueueTask("stuck", [](int out_fd) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        dprintf(out_fd, "too late\n");
+    });
+
+    EXPECT_FALSE(pool.waitForTask("stuck", out_fd_.get(), std::chrono::milliseconds(10)));
+    pool.shutdown();
+
+    EXPECT_THAT(GetOutput(), StartsWith("*** section stuck timed out"));
+    EXPECT_THAT(GetOutput(), Not(HasSubstr("too late")));
+}
+
+TEST_F(DumpPoolTest, UnknownSection) {
+    DumpPool pool(tmp_dir_.path);
+    pool.start(1);
+
+    EXPECT_FALSE(pool.waitForTask("unknown", out_fd_.get()));
+    EXPECT_THAT(GetOutput(), IsEmpty());
+}
+
+TEST_F(DumpPoolTest, RunCommandsInParallel) {
+    DumpPool pool(tmp_dir_.path);
+    pool.start(2);
+    // Each command reaps only its own child, even though either thread may get the SIGCHLD.
+    pool.enqueueTask("first", [this](int out_fd) {
+        RunCommandToFd(out_fd, "", {kEchoCommand, "first"}, CommandOptions::WithTimeout(5).Build());
+    });
+    pool.enqueueTask("second", [this](int out_fd) {
+        RunCommandToFd(out_fd, "", {kEchoCommand, "second"},
+                       CommandOptions::WithTimeout(5).Build());
+    });
+
+    EXPECT_TRUE(pool.waitForTask("first", out_fd_.get()));
+    EXPECT_TRUE(pool.waitForTask("second", out_fd_.get()));
+
+    EXPECT_THAT(GetOutput(), StrEq("first\nsecond\n"));
+}
+
 }  // namespace dumpstate
 }  // namespace os
 }  // namespace android
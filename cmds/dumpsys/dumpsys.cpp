@@ -15,9 +15,13 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <iomanip>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
@@ -35,6 +39,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -60,13 +65,15 @@ static void usage() {
             "usage: dumpsys\n"
             "         To dump all services.\n"
             "or:\n"
-            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--pid] [--help | -l | --skip SERVICES "
-            "| SERVICE [ARGS]]\n"
+            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--pid] [--parallel N] [--help | -l | "
+            "--skip SERVICES | SERVICE [ARGS]]\n"
             "         --help: shows this help\n"
             "         -l: only list services, do not dump them\n"
             "         -t TIMEOUT_SEC: TIMEOUT to use in seconds instead of default 10 seconds\n"
             "         -T TIMEOUT_MS: TIMEOUT to use in milliseconds instead of default 10 seconds\n"
             "         --pid: dump PID instead of usual dump\n"
+            "         --parallel N: dump up to N services at once, still printing them in order,\n"
+            "               followed by how long each of them took\n"
             "         --proto: filter services that support dumping data in proto format. Dumps\n"
             "               will be in proto format.\n"
             "         --priority LEVEL: filter services based on specified priority\n"
@@ -124,12 +131,14 @@ int Dumpsys::main(int argc, char* const argv[]) {
     bool asProto = false;
     Type type = Type::DUMP;
     int timeoutArgMs = 10000;
+    int parallelism = 1;
     int priorityFlags = IServiceManager::DUMP_FLAG_PRIORITY_ALL;
     static struct option longOptions[] = {{"pid", no_argument, 0, 0},
                                           {"priority", required_argument, 0, 0},
                                           {"proto", no_argument, 0, 0},
                                           {"skip", no_argument, 0, 0},
                                           {"help", no_argument, 0, 0},
+                                          {"parallel", required_argument, 0, 0},
                                           {0, 0, 0, 0}};
 
     // Must reset optind, otherwise subsequent calls will fail (wouldn't happen on main.cpp, but
@@ -163,6 +172,13 @@ int Dumpsys::main(int argc, char* const argv[]) {
                 }
             } else if (!strcmp(longOptions[optionIndex].name, "pid")) {
                 type = Type::PID;
+            } else if (!strcmp(longOptions[optionIndex].name, "parallel")) {
+                char* endptr;
+                parallelism = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || parallelism <= 0) {
+                    fprintf(stderr, "Error: invalid number of parallel dumps: '%s'\n", optarg);
+                    return -1;
+                }
             }
             break;
 
@@ -248,6 +264,18 @@ int Dumpsys::main(int argc, char* const argv[]) {
         return 0;
     }
 
+    if (parallelism > 1 && N > 1) {
+        Vector<String16> servicesToDump;
+        for (const String16& serviceName : services) {
+            if (!IsSkipped(skippedServices, serviceName)) {
+                servicesToDump.add(serviceName);
+            }
+        }
+        dumpServicesInParallel(STDOUT_FILENO, servicesToDump, args, type, priorityFlags, asProto,
+                               std::chrono::milliseconds(timeoutArgMs), parallelism);
+        return 0;
+    }
+
     for (size_t i = 0; i < N; i++) {
         const String16& serviceName = services[i];
         if (IsSkipped(skippedServices, serviceName)) continue;
@@ -281,6 +309,100 @@ int Dumpsys::main(int argc, char* const argv[]) {
     return 0;
 }
 
+void Dumpsys::dumpServicesInParallel(int fd, const Vector<String16>& services,
+                                     const Vector<String16>& args, Type type, int priorityFlags,
+                                     bool asProto, std::chrono::milliseconds timeout,
+                                     int parallelism) const {
+    struct ServiceDump {
+        unique_fd output;
+        status_t status = NAME_NOT_FOUND;
+        std::chrono::duration<double> elapsedDuration{0};
+        size_t bytesWritten = 0;
+        bool done = false;
+    };
+    std::vector<ServiceDump> dumps(services.size());
+    std::mutex lock;
+    std::condition_variable condition;
+    std::atomic<size_t> nextService(0);
+
+    // Each service is dumped into its own in-memory file, so that a slow service only holds up
+    // the output of the services after it, not their dumps.
+    auto dumpServices = [&]() {
+        size_t i;
+        while ((i = nextService++) < services.size()) {
+            const String16& serviceName = services[i];
+            ServiceDump dump;
+            Dumpsys dumpsys(sm_);
+            if (dumpsys.startDumpThread(type, serviceName, args) == OK) {
+                dump.output.reset(memfd_create("dumpsys", MFD_CLOEXEC));
+                if (dump.output.get() < 0) {
+                    std::cerr << "Failed to create a buffer to dump service " << serviceName
+                              << ": " << strerror(errno) << std::endl;
+                    dump.status = -errno;
+                    dumpsys.stopDumpThread(false);
+                } else {
+                    dumpsys.writeDumpHeader(dump.output.get(), serviceName, priorityFlags);
+                    dump.status = dumpsys.writeDump(dump.output.get(), serviceName, timeout,
+                                                    asProto, dump.elapsedDuration,
+                                                    dump.bytesWritten);
+                    if (dump.status == TIMED_OUT) {
+                        WriteStringToFd(StringPrintf("\n*** SERVICE '%s' DUMP TIMEOUT (%llums) "
+                                                     "EXPIRED ***\n\n",
+                                                     String8(serviceName).c_str(),
+                                                     timeout.count()),
+                                        dump.output.get());
+                    }
+                    dumpsys.writeDumpFooter(dump.output.get(), serviceName,
+                                            dump.elapsedDuration);
+                    dumpsys.stopDumpThread(dump.status == OK);
+                }
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            dump.done = true;
+            dumps[i] = std::move(dump);
+            condition.notify_all();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < parallelism && i < static_cast<int>(services.size()); i++) {
+        threads.emplace_back(dumpServices);
+    }
+
+    for (ServiceDump& dump : dumps) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            condition.wait(guard, [&dump] { return dump.done; });
+        }
+        if (dump.output.get() < 0) {
+            continue;
+        }
+        char buf[4096];
+        off_t offset = 0;
+        ssize_t rc;
+        while ((rc = TEMP_FAILURE_RETRY(pread(dump.output.get(), buf, sizeof(buf), offset))) > 0) {
+            if (!WriteFully(fd, buf, rc)) {
+                break;
+            }
+            offset += rc;
+        }
+        dump.output.reset();
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::string summary(
+        "----------------------------------------"
+        "---------------------------------------\n"
+        "DUMPSYS TIMING SUMMARY (service,status,duration_s,bytes):\n");
+    for (size_t i = 0; i < services.size(); i++) {
+        StringAppendF(&summary, "%s,%s,%.3f,%zu\n", String8(services[i]).c_str(),
+                      statusToString(dumps[i].status).c_str(), dumps[i].elapsedDuration.count(),
+                      dumps[i].bytesWritten);
+    }
+    WriteStringToFd(summary, fd);
+}
+
 Vector<String16> Dumpsys::listServices(int priorityFilterFlags, bool filterByProto) const {
     Vector<String16> services = sm_->listServices(priorityFilterFlags);
     services.sort(sort_func);
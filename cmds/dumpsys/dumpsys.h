@@ -122,6 +122,16 @@ class Dumpsys {
     }
 
   private:
+    /**
+     * Dumps services on up to {@code parallelism} threads at once. Each dump goes to its own
+     * buffer, which is written to {@code fd} in the order of {@code services}, followed by a
+     * summary of each service's status, duration and size.
+     */
+    void dumpServicesInParallel(int fd, const Vector<String16>& services,
+                                const Vector<String16>& args, Type type, int priorityFlags,
+                                bool asProto, std::chrono::milliseconds timeout,
+                                int parallelism) const;
+
     android::IServiceManager* sm_;
     std::thread activeThread_;
     mutable android::base::unique_fd redirectFd_;
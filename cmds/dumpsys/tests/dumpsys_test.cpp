@@ -224,6 +224,18 @@ class DumpsysTest : public Test {
         EXPECT_THAT(stdout_, HasSubstr(expected));
     }
 
+    void AssertOutputInOrder(const std::vector<std::string>& expected) {
+        size_t pos = 0;
+        for (const std::string& part : expected) {
+            size_t found = stdout_.find(part, pos);
+            EXPECT_NE(found, std::string::npos) << "'" << part << "' missing or out of order";
+            if (found == std::string::npos) {
+                return;
+            }
+            pos = found + part.size();
+        }
+    }
+
     void AssertDumped(const std::string& service, const std::string& dump) {
         EXPECT_THAT(stdout_, HasSubstr("DUMP OF SERVICE " + service + ":\n" + dump));
         EXPECT_THAT(stdout_, HasSubstr("was the duration of dumpsys " + service + ", ending at: "));
@@ -426,6 +438,36 @@ TEST_F(DumpsysTest, DumpMultipleServices) {
     AssertDumped("running3", "dump3");
 }
 
+// Tests 'dumpsys --parallel 3', where the first service is the slowest one
+TEST_F(DumpsysTest, DumpMultipleServicesInParallel) {
+    ExpectListServices({"running1", "stopped2", "running3", "skipped4"});
+    ExpectDumpAndHang("running1", 1, "dump1");
+    ExpectCheckService("stopped2", false);
+    ExpectDump("running3", "dump3");
+    ExpectDump("skipped4", "dump4");
+
+    CallMain({"--parallel", "3", "--skip", "skipped4"});
+
+    AssertRunningServices({"running1", "running3", "skipped4 (skipped)"});
+    AssertDumped("running1", "dump1");
+    AssertStopped("stopped2");
+    AssertDumped("running3", "dump3");
+    AssertNotDumped("dump4");
+    AssertOutputInOrder({"DUMP OF SERVICE running1:\n", "DUMP OF SERVICE running3:\n",
+                         "DUMPSYS TIMING SUMMARY (service,status,duration_s,bytes):\n",
+                         "running1,OK,", "stopped2,NAME_NOT_FOUND,", "running3,OK,"});
+}
+
+// Tests 'dumpsys --parallel 0', which is not a valid number of dumps
+TEST_F(DumpsysTest, DumpInParallelWithInvalidNumber) {
+    const char* argv[] = {"/some/virtual/dir/dumpsys", "--parallel", "0"};
+    CaptureStderr();
+    int status = dump_.main(3, const_cast<char**>(argv));
+    std::string err = GetCapturedStderr();
+    EXPECT_THAT(status, Eq(-1));
+    EXPECT_THAT(err, HasSubstr("invalid number of parallel dumps: '0'"));
+}
+
 // Tests 'dumpsys --skip skipped3 skipped5', which should skip these services
 TEST_F(DumpsysTest, DumpWithSkip) {
     ExpectListServices({"running1", "stopped2", "skipped3", "running4", "skipped5"});
@@ -6,6 +6,7 @@ LOCAL_SRC_FILES:=   \
     Composers.cpp   \
     GLHelper.cpp    \
     Renderers.cpp   \
+    RenderEngineScenarios.cpp \
     Main.cpp        \
 
 LOCAL_CFLAGS := -Wall -Werror
@@ -18,11 +19,20 @@ LOCAL_MODULE_PATH := $(local_target_dir)
 LOCAL_MULTILIB := both
 LOCAL_MODULE_STEM_32 := flatland
 LOCAL_MODULE_STEM_64 := flatland64
+LOCAL_STATIC_LIBRARIES := \
+    librenderengine \
+
 LOCAL_SHARED_LIBRARIES := \
     libEGL      \
+    libGLESv1_CM \
     libGLESv2   \
+    libbase     \
     libcutils   \
     libgui      \
+    liblog      \
+    libnativewindow \
+    libprocessgroup \
+    libsync     \
     libui       \
     libutils    \
 
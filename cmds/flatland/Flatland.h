@@ -68,4 +68,8 @@ public:
 
 Renderer* staticGradient();
 
+// Runs the scenarios composed through RenderEngine rather than the Composers
+// above, and prints their results.
+bool runRenderEngineScenarios(uint32_t sleepBetweenSamplesMs);
+
 } // namespace android
@@ -36,6 +36,7 @@ using namespace ::android;
 
 static uint32_t g_SleepBetweenSamplesMs = 0;
 static bool     g_PresentToWindow       = false;
+static bool     g_UseRenderEngine       = false;
 static size_t   g_BenchmarkNameLen      = 0;
 
 struct BenchmarkDesc {
@@ -723,6 +724,7 @@ static void showHelp(const char *cmd) {
     fprintf(stderr, "options include:\n"
                     "  -s N            sleep for N ms between samples\n"
                     "  -d              display the test frame to a window\n"
+                    "  -r              run the RenderEngine composition scenarios\n"
                     "  --help          print this helpful message and exit\n"
             );
 }
@@ -741,7 +743,7 @@ int main(int argc, char** argv) {
             {     0,               0, 0,  0 }
         };
 
-        ret = getopt_long(argc, argv, "ds:",
+        ret = getopt_long(argc, argv, "drs:",
                           long_options, &option_index);
 
         if (ret < 0) {
@@ -753,6 +755,10 @@ int main(int argc, char** argv) {
                 g_PresentToWindow = true;
             break;
 
+            case 'r':
+                g_UseRenderEngine = true;
+            break;
+
             case 's':
                 g_SleepBetweenSamplesMs = atoi(optarg);
             break;
@@ -778,6 +784,14 @@ int main(int argc, char** argv) {
     }
     printf("\n");
 
+    if (g_UseRenderEngine) {
+        if (!runRenderEngineScenarios(g_SleepBetweenSamplesMs)) {
+            fprintf(stderr, "exiting due to error.\n");
+            return 1;
+        }
+        return 0;
+    }
+
     if (!runTests()) {
         fprintf(stderr, "exiting due to error.\n");
         return 1;
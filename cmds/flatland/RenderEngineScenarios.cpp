@@ -0,0 +1,431 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_ALWAYS
+
+#include <android-base/unique_fd.h>
+#include <renderengine/DisplaySettings.h>
+#include <renderengine/LayerSettings.h>
+#include <renderengine/RenderEngine.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+#include <utils/Timers.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Flatland.h"
+
+namespace android {
+
+using renderengine::DisplaySettings;
+using renderengine::LayerSettings;
+using renderengine::RenderEngine;
+using renderengine::RenderEngineCreationArgs;
+
+// The refresh rates at which each scenario is paced.
+static const uint32_t kRefreshRates[] = { 60, 90, 120 };
+
+// The number of frames drawn at each refresh rate.
+static const uint32_t kPacedFrames = 120;
+
+// The frames drawn before the measured ones, so that the shaders are compiled
+// and the buffers are bound.
+static const uint32_t kWarmUpFrames = 10;
+
+class SceneBuilder;
+
+struct SceneDesc {
+    // The name of the scenario.
+    const char* name;
+
+    // The size of the display.
+    uint32_t width;
+    uint32_t height;
+
+    // Adds the layers of the scenario, from bottom to top.
+    void (*build)(SceneBuilder& b);
+};
+
+// Holds the display settings and the layers of a scenario, along with the
+// buffers the layers sample from.
+class SceneBuilder {
+
+public:
+
+    SceneBuilder(RenderEngine& re, uint32_t width, uint32_t height) :
+        mRE(re),
+        mWidth(width),
+        mHeight(height) {
+        mDisplay.physicalDisplay = Rect(width, height);
+        mDisplay.clip = Rect(width, height);
+        mDisplay.maxLuminance = 500.0f;
+        mDisplay.outputDataspace = ui::Dataspace::SRGB;
+    }
+
+    ~SceneBuilder() {
+        for (const sp<GraphicBuffer>& buffer : mBuffers) {
+            mRE.unbindExternalTextureBuffer(buffer->getId());
+        }
+        if (!mTextures.empty()) {
+            mRE.deleteTextures(mTextures.size(), mTextures.data());
+        }
+    }
+
+    uint32_t width() const { return mWidth; }
+    uint32_t height() const { return mHeight; }
+
+    DisplaySettings& display() { return mDisplay; }
+
+    // Adds a layer sampling from a buffer filled with a gradient. The
+    // fractions are of the display size.
+    LayerSettings& bufferLayer(float l, float t, float r, float b,
+            ui::Dataspace dataspace = ui::Dataspace::SRGB) {
+        LayerSettings& layer = addLayer(l, t, r, b);
+        const uint32_t w = std::max(1u, uint32_t((r - l) * mWidth));
+        const uint32_t h = std::max(1u, uint32_t((b - t) * mHeight));
+        sp<GraphicBuffer> buffer = new GraphicBuffer(w, h, HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                GRALLOC_USAGE_SW_WRITE_OFTEN | GRALLOC_USAGE_HW_TEXTURE, "flatland-source");
+        fillGradient(buffer);
+        uint32_t texName;
+        mRE.genTextures(1, &texName);
+        mTextures.push_back(texName);
+        mBuffers.push_back(buffer);
+
+        layer.source.buffer.buffer = buffer;
+        layer.source.buffer.textureName = texName;
+        layer.source.buffer.isOpaque = true;
+        layer.sourceDataspace = dataspace;
+        return layer;
+    }
+
+    // Adds a layer filled with a solid color.
+    LayerSettings& colorLayer(float l, float t, float r, float b, half3 color,
+            float alpha = 1.0f) {
+        LayerSettings& layer = addLayer(l, t, r, b);
+        layer.source.solidColor = color;
+        layer.alpha = alpha;
+        return layer;
+    }
+
+    // Gives a layer a material design shadow.
+    void addShadow(LayerSettings& layer, float length) {
+        layer.shadow.ambientColor = vec4(0.0f, 0.0f, 0.0f, 0.039f);
+        layer.shadow.spotColor = vec4(0.0f, 0.0f, 0.0f, 0.19f);
+        layer.shadow.lightPos = vec3(mWidth / 2.0f, 0.0f, mHeight);
+        layer.shadow.lightRadius = mWidth;
+        layer.shadow.length = length;
+    }
+
+    bool valid() const {
+        for (const sp<GraphicBuffer>& buffer : mBuffers) {
+            if (buffer->initCheck() != NO_ERROR) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<const LayerSettings*> layers() const {
+        std::vector<const LayerSettings*> layers;
+        for (const std::unique_ptr<LayerSettings>& layer : mLayers) {
+            layers.push_back(layer.get());
+        }
+        return layers;
+    }
+
+private:
+
+    LayerSettings& addLayer(float l, float t, float r, float b) {
+        mLayers.push_back(std::make_unique<LayerSettings>());
+        LayerSettings& layer = *mLayers.back();
+        layer.geometry.boundaries = FloatRect(l * mWidth, t * mHeight, r * mWidth, b * mHeight);
+        layer.alpha = 1.0f;
+        return layer;
+    }
+
+    static void fillGradient(const sp<GraphicBuffer>& buffer) {
+        uint8_t* pixels;
+        if (buffer->initCheck() != NO_ERROR ||
+                buffer->lock(GRALLOC_USAGE_SW_WRITE_OFTEN,
+                        reinterpret_cast<void**>(&pixels)) != NO_ERROR) {
+            return;
+        }
+        const uint32_t w = buffer->getWidth();
+        const uint32_t h = buffer->getHeight();
+        for (uint32_t y = 0; y < h; y++) {
+            uint8_t* row = pixels + y * buffer->getStride() * 4;
+            for (uint32_t x = 0; x < w; x++) {
+                row[x * 4 + 0] = uint8_t(255 * x / w);
+                row[x * 4 + 1] = uint8_t(255 * y / h);
+                row[x * 4 + 2] = 128;
+                row[x * 4 + 3] = 255;
+            }
+        }
+        buffer->unlock();
+    }
+
+    RenderEngine& mRE;
+    const uint32_t mWidth;
+    const uint32_t mHeight;
+
+    DisplaySettings mDisplay;
+    std::vector<std::unique_ptr<LayerSettings>> mLayers;
+    std::vector<sp<GraphicBuffer>> mBuffers;
+    std::vector<uint32_t> mTextures;
+};
+
+static const half3 kBlack = half3(0.0f, 0.0f, 0.0f);
+static const half3 kWhite = half3(1.0f, 1.0f, 1.0f);
+
+// The status and navigation bars drawn over most of the scenarios.
+static void addSystemBars(SceneBuilder& b) {
+    b.colorLayer(0.0f, 0.0f, 1.0f, 0.03f, kBlack, 0.5f);
+    b.colorLayer(0.0f, 0.95f, 1.0f, 1.0f, kBlack, 0.5f);
+}
+
+static void roundedCornerApp(SceneBuilder& b) {
+    b.bufferLayer(0.0f, 0.0f, 1.0f, 1.0f);
+    LayerSettings& app = b.bufferLayer(0.0f, 0.0f, 1.0f, 1.0f);
+    app.geometry.roundedCornersRadius = 0.04f * b.width();
+    app.geometry.roundedCornersCrop = app.geometry.boundaries;
+    addSystemBars(b);
+}
+
+static void appToHomeTransition(SceneBuilder& b) {
+    b.bufferLayer(0.0f, 0.0f, 1.0f, 1.0f);
+    LayerSettings& launcher = b.bufferLayer(0.0f, 0.0f, 1.0f, 1.0f);
+    launcher.source.buffer.isOpaque = false;
+    launcher.alpha = 0.5f;
+    LayerSettings& app = b.bufferLayer(0.1f, 0.1f, 0.9f, 0.9f);
+    app.geometry.roundedCornersRadius = 0.06f * b.width();
+    app.geometry.roundedCornersCrop = app.geometry.boundaries;
+    b.addShadow(app, 0.03f * b.width());
+    addSystemBars(b);
+}
+
+static void shadowedDialog(SceneBuilder& b) {
+    b.bufferLayer(0.0f, 0.0f, 1.0f, 1.0f);
+    b.colorLayer(0.0f, 0.0f, 1.0f, 1.0f, kBlack, 0.6f);
+    LayerSettings& dialog = b.colorLayer(0.1f, 0.35f, 0.9f, 0.65f, kWhite);
+    dialog.geometry.roundedCornersRadius = 0.03f * b.width();
+    dialog.geometry.roundedCornersCrop = dialog.geometry.boundaries;
+    b.addShadow(dialog, 0.02f * b.width());
+    addSystemBars(b);
+}
+
+static void blurredNotificationShade(SceneBuilder& b) {
+    b.bufferLayer(0.0f, 0.0f, 1.0f, 1.0f);
+    LayerSettings& shade = b.colorLayer(0.0f, 0.0f, 1.0f, 1.0f, kBlack, 0.4f);
+    shade.backgroundBlurRadius = 150;
+    for (int i = 0; i < 3; i++) {
+        const float top = 0.1f + 0.12f * i;
+        LayerSettings& notification = b.colorLayer(0.03f, top, 0.97f, top + 0.1f, kWhite);
+        notification.geometry.roundedCornersRadius = 0.03f * b.width();
+        notification.geometry.roundedCornersCrop = notification.geometry.boundaries;
+    }
+    addSystemBars(b);
+}
+
+static void hdrVideo(SceneBuilder& b) {
+    b.display().outputDataspace = ui::Dataspace::DISPLAY_P3;
+    LayerSettings& video = b.bufferLayer(0.0f, 0.0f, 1.0f, 1.0f, ui::Dataspace::BT2020_ITU_PQ);
+    video.source.buffer.maxMasteringLuminance = 1000.0f;
+    video.source.buffer.maxContentLuminance = 1000.0f;
+    // Playback controls
+    b.bufferLayer(0.0f, 0.85f, 1.0f, 1.0f).source.buffer.isOpaque = false;
+}
+
+static void wideColorGallery(SceneBuilder& b) {
+    b.display().outputDataspace = ui::Dataspace::DISPLAY_P3;
+    b.bufferLayer(0.0f, 0.0f, 1.0f, 1.0f);
+    for (int i = 0; i < 4; i++) {
+        const float left = 0.5f * (i % 2);
+        const float top = 0.1f + 0.4f * (i / 2);
+        b.bufferLayer(left, top, left + 0.5f, top + 0.4f, ui::Dataspace::DISPLAY_P3);
+    }
+    addSystemBars(b);
+}
+
+static const SceneDesc scenes[] = {
+    { "Rounded Corner App",             1080, 2340, roundedCornerApp },
+    { "Rounded Corner App",             1440, 3120, roundedCornerApp },
+    { "App -> Home Transition",         1080, 2340, appToHomeTransition },
+    { "App -> Home Transition",         1440, 3120, appToHomeTransition },
+    { "Shadowed Dialog",                1080, 2340, shadowedDialog },
+    { "Blurred Notification Shade",     1080, 2340, blurredNotificationShade },
+    { "Blurred Notification Shade",     1440, 3120, blurredNotificationShade },
+    { "HDR Video",                      1080, 2340, hdrVideo },
+    { "Wide Color Gallery",             1080, 2340, wideColorGallery },
+};
+
+struct PacedResult {
+    // The time from submitting each frame to its draw fence signaling.
+    std::vector<nsecs_t> frameTimes;
+    // The frames that completed after the end of their refresh period.
+    uint32_t missedFrames = 0;
+};
+
+// Draws one frame and returns the time at which it completed, or -1.
+static nsecs_t drawFrame(RenderEngine& re, SceneBuilder& scene,
+        const sp<GraphicBuffer>& target) {
+    ATRACE_CALL();
+
+    base::unique_fd drawFence;
+    status_t err = re.drawLayers(scene.display(), scene.layers(), target->getNativeBuffer(),
+            true, base::unique_fd(), &drawFence);
+    if (err != NO_ERROR) {
+        fprintf(stderr, "RenderEngine::drawLayers error: %d\n", err);
+        return -1;
+    }
+
+    nsecs_t endTime;
+    if (drawFence.ok()) {
+        sp<Fence> fence = new Fence(drawFence.release());
+        fence->wait(Fence::TIMEOUT_NEVER);
+        endTime = fence->getSignalTime();
+    } else {
+        // Without native fences, drawLayers waits for the GPU itself.
+        endTime = systemTime();
+    }
+    re.cleanupPostRender();
+    return endTime;
+}
+
+// Draws frames at the start of each refresh period, like SurfaceFlinger does
+// when it falls back to GPU composition every frame.
+static bool runPaced(RenderEngine& re, SceneBuilder& scene, const sp<GraphicBuffer>& target,
+        uint32_t refreshRate, PacedResult* result) {
+    const nsecs_t period = s2ns(1) / refreshRate;
+    nsecs_t frameStart = systemTime();
+    for (uint32_t i = 0; i < kPacedFrames; i++) {
+        const nsecs_t now = systemTime();
+        if (now < frameStart) {
+            usleep(ns2us(frameStart - now));
+        } else {
+            // A missed frame delays the next one to the following period.
+            frameStart = now;
+        }
+
+        const nsecs_t submitTime = systemTime();
+        const nsecs_t endTime = drawFrame(re, scene, target);
+        if (endTime < 0) {
+            return false;
+        }
+        result->frameTimes.push_back(endTime - submitTime);
+        if (endTime - frameStart > period) {
+            result->missedFrames++;
+        }
+        frameStart += period;
+    }
+    return true;
+}
+
+static double percentileMs(std::vector<nsecs_t> times, size_t percentile) {
+    std::sort(times.begin(), times.end());
+    return double(times[(times.size() - 1) * percentile / 100]) / 1e6;
+}
+
+// Run a single scenario and print the result.
+static bool runScene(RenderEngine& re, const SceneDesc& desc, size_t nameLen,
+        uint32_t sleepBetweenSamplesMs) {
+    printf(" %-*s | %4d x %4d | ", static_cast<int>(nameLen), desc.name, desc.width,
+            desc.height);
+    fflush(stdout);
+
+    sp<GraphicBuffer> target = new GraphicBuffer(desc.width, desc.height,
+            HAL_PIXEL_FORMAT_RGBA_8888, 1,
+            GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE, "flatland-target");
+    SceneBuilder scene(re, desc.width, desc.height);
+    desc.build(scene);
+    if (target->initCheck() != NO_ERROR || !scene.valid()) {
+        fprintf(stderr, "error allocating buffers.\n");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < kWarmUpFrames; i++) {
+        if (drawFrame(re, scene, target) < 0) {
+            return false;
+        }
+    }
+
+    std::vector<nsecs_t> frameTimes;
+    for (uint32_t refreshRate : kRefreshRates) {
+        PacedResult result;
+        if (!runPaced(re, scene, target, refreshRate, &result)) {
+            return false;
+        }
+        printf("%3u/%3u | ", result.missedFrames, kPacedFrames);
+        fflush(stdout);
+        frameTimes.insert(frameTimes.end(), result.frameTimes.begin(), result.frameTimes.end());
+
+        if (sleepBetweenSamplesMs > 0) {
+            usleep(sleepBetweenSamplesMs * 1000);
+        }
+    }
+
+    printf("%6.3f | %6.3f\n", percentileMs(frameTimes, 50), percentileMs(frameTimes, 95));
+    fflush(stdout);
+    return true;
+}
+
+bool runRenderEngineScenarios(uint32_t sleepBetweenSamplesMs) {
+    std::unique_ptr<RenderEngine> re = RenderEngine::create(
+            RenderEngineCreationArgs::Builder()
+                .setPixelFormat(static_cast<int>(ui::PixelFormat::RGBA_8888))
+                .setImageCacheSize(NELEMS(scenes) * 6)
+                .setUseColorManagerment(true)
+                .setEnableProtectedContext(false)
+                .setPrecacheToneMapperShaderOnly(false)
+                .setSupportsBackgroundBlur(true)
+                .setContextPriority(RenderEngine::ContextPriority::MEDIUM)
+                .build());
+    if (re == nullptr) {
+        fprintf(stderr, "error creating RenderEngine.\n");
+        return false;
+    }
+
+    size_t nameLen = strlen("Scenario");
+    for (size_t i = 0; i < NELEMS(scenes); i++) {
+        nameLen = std::max(nameLen, strlen(scenes[i].name));
+    }
+
+    const char* scenario = "Scenario";
+    size_t leftPad = (nameLen - strlen(scenario)) / 2;
+    size_t rightPad = nameLen - strlen(scenario) - leftPad;
+    printf(" %*s%s%*s | Resolution  | Missed frames at          | Frame time (ms)\n",
+            static_cast<int>(leftPad), "", scenario, static_cast<int>(rightPad), "");
+    printf(" %*s | %*s | ", static_cast<int>(nameLen), "", 11, "");
+    for (uint32_t refreshRate : kRefreshRates) {
+        printf("%5uHz | ", refreshRate);
+    }
+    printf("   p50 |    p95\n");
+
+    for (size_t i = 0; i < NELEMS(scenes); i++) {
+        if (!runScene(*re, scenes[i], nameLen, sleepBetweenSamplesMs)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace android
@@ -18,6 +18,7 @@
 
 #include "CacheTracker.h"
 
+#include <algorithm>
 #include <fts.h>
 #include <sys/xattr.h>
 #include <utils/Trace.h>
@@ -26,6 +27,7 @@
 #include <android-base/stringprintf.h>
 
 #include "QuotaUtils.h"
+#include "TreeSizeCache.h"
 #include "utils.h"
 
 using android::base::StringPrintf;
@@ -67,8 +69,8 @@ void CacheTracker::loadStats() {
     for (const auto& path : mDataPaths) {
         auto cachePath = read_path_inode(path, "cache", kXattrInodeCache);
         auto codeCachePath = read_path_inode(path, "code_cache", kXattrInodeCodeCache);
-        calculate_tree_size(cachePath, &cacheUsed);
-        calculate_tree_size(codeCachePath, &cacheUsed);
+        calculate_tree_size_cached(cachePath, &cacheUsed);
+        calculate_tree_size_cached(codeCachePath, &cacheUsed);
     }
     ATRACE_END();
 }
@@ -187,15 +189,40 @@ void CacheTracker::loadItems() {
     ATRACE_END();
 }
 
+std::vector<uint64_t> CacheTracker::getGenerations() {
+    std::vector<uint64_t> generations;
+    for (const auto& path : mDataPaths) {
+        generations.push_back(get_tree_generation(
+                read_path_inode(path, "cache", kXattrInodeCache)));
+        generations.push_back(get_tree_generation(
+                read_path_inode(path, "code_cache", kXattrInodeCodeCache)));
+    }
+    return generations;
+}
+
 void CacheTracker::ensureItems() {
     if (mItemsLoaded) {
         return;
     } else {
+        // Taken before loading, so that changes made while loading show up in revalidateItems.
+        mItemsGenerations = getGenerations();
         loadItems();
         mItemsLoaded = true;
     }
 }
 
+void CacheTracker::revalidateItems() {
+    if (!mItemsLoaded) {
+        return;
+    }
+    auto generations = getGenerations();
+    if (generations != mItemsGenerations
+            || std::find(generations.begin(), generations.end(), 0) != generations.end()) {
+        items.clear();
+        mItemsLoaded = false;
+    }
+}
+
 int CacheTracker::getCacheRatio() {
     if (cacheQuota == 0) {
         return 0;
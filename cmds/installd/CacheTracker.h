@@ -50,6 +50,10 @@ public:
     void loadItems();
 
     void ensureItems();
+    // Drops the loaded items if any of the cache directories changed since
+    void revalidateItems();
+
+    const std::vector<std::string>& getDataPaths() const { return mDataPaths; }
 
     int getCacheRatio();
 
@@ -62,11 +66,14 @@ private:
     userid_t mUserId;
     appid_t mAppId;
     bool mItemsLoaded;
-    const std::string& mUuid;
+    const std::string mUuid;
 
     std::vector<std::string> mDataPaths;
+    // Generations of the cache directories when the items were loaded
+    std::vector<uint64_t> mItemsGenerations;
 
     bool loadQuotaStats();
+    std::vector<uint64_t> getGenerations();
     void loadItemsFrom(const std::string& path);
 
     DISALLOW_COPY_AND_ASSIGN(CacheTracker);
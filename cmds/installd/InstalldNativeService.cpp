@@ -38,6 +38,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
+#include <thread>
 #include <unistd.h>
 
 #include <android-base/file.h>
@@ -71,6 +72,7 @@
 #include "CrateManager.h"
 #include "MatchExtensionGen.h"
 #include "QuotaUtils.h"
+#include "TreeSizeCache.h"
 
 #ifndef LOG_TAG
 #define LOG_TAG "installd"
@@ -96,6 +98,10 @@ static constexpr const char* kDataMirrorDePath = "/data_mirror/data_de";
 
 static constexpr const int MIN_RESTRICTED_HOME_SDK_VERSION = 24; // > M
 
+// Most of the work of preparing app data is waiting for the file system, so a few threads are
+// enough to keep it busy; more would mostly contend on the same directories.
+static constexpr const size_t kCreateAppDataMaxThreads = 4;
+
 static constexpr const char* PKG_LIB_POSTFIX = "/lib";
 static constexpr const char* CACHE_DIR_POSTFIX = "/cache";
 static constexpr const char* CODE_CACHE_DIR_POSTFIX = "/code_cache";
@@ -264,6 +270,75 @@ binder::Status checkArgumentPath(const std::unique_ptr<std::string>& path) {
     }                                                       \
 }
 
+/**
+ * Holds on to the lock of one key of a lock map, creating it on first use and removing it from
+ * the map again once its last holder goes away. The map itself is guarded by mapLock, which is
+ * only held while looking up or dropping the lock, never while waiting for it.
+ */
+template <class Key, class Mutex>
+class LocalLockHolder {
+public:
+    LocalLockHolder(const Key& key, std::unordered_map<Key, std::weak_ptr<Mutex>>& map,
+            std::recursive_mutex& mapLock)
+          : mKey(key), mMap(map), mMapLock(mapLock) {
+        std::lock_guard<std::recursive_mutex> lock(mMapLock);
+        auto& weakPtr = mMap[mKey];
+        mRefCount = weakPtr.lock();
+        if (!mRefCount) {
+            mRefCount = std::make_shared<Mutex>();
+            weakPtr = mRefCount;
+        }
+    }
+
+    ~LocalLockHolder() {
+        std::lock_guard<std::recursive_mutex> lock(mMapLock);
+        mRefCount.reset();
+        auto it = mMap.find(mKey);
+        if (it != mMap.end() && it->second.expired()) {
+            mMap.erase(it);
+        }
+    }
+
+    void lock() { mRefCount->lock(); }
+    void unlock() { mRefCount->unlock(); }
+    void lock_shared() { mRefCount->lock_shared(); }
+    void unlock_shared() { mRefCount->unlock_shared(); }
+
+private:
+    const Key mKey;
+    std::unordered_map<Key, std::weak_ptr<Mutex>>& mMap;
+    std::recursive_mutex& mMapLock;
+    std::shared_ptr<Mutex> mRefCount;
+
+    DISALLOW_COPY_AND_ASSIGN(LocalLockHolder);
+};
+
+using UserLock = LocalLockHolder<userid_t, std::shared_mutex>;
+using PackageLock = LocalLockHolder<std::string, std::recursive_mutex>;
+
+// Locks are always taken in the order package or path, then user. Operations on a whole user
+// take its lock exclusively and no other one, so that they can't deadlock with operations on
+// the data of that user's packages, which share it.
+#define LOCK_USER(userId)                                               \
+    UserLock localUserLock((userId), mUserIdLock, mLock);               \
+    std::lock_guard<UserLock> userLock(localUserLock)
+
+#define LOCK_USER_READ(userId)                                          \
+    UserLock localUserLock((userId), mUserIdLock, mLock);               \
+    std::shared_lock<UserLock> userLock(localUserLock)
+
+#define LOCK_PACKAGE(packageName)                                       \
+    PackageLock localPackageLock((packageName), mPackageNameLock, mLock); \
+    std::lock_guard<PackageLock> packageLock(localPackageLock)
+
+#define LOCK_PACKAGE_USER(packageName, userId)                          \
+    LOCK_PACKAGE(packageName);                                          \
+    LOCK_USER_READ(userId)
+
+#define LOCK_PATH(path)                                                 \
+    PackageLock localPathLock((path), mPathLock, mLock);                \
+    std::lock_guard<PackageLock> pathLock(localPathLock)
+
 }  // namespace
 
 status_t InstalldNativeService::start() {
@@ -307,6 +382,13 @@ status_t InstalldNativeService::dump(int fd, const Vector<String16> & /* args */
         }
     }
 
+    {
+        std::lock_guard<std::mutex> lock(mDexoptLock);
+        out << endl << "Dexopt: " << mRunningDexopts << " running, " << mWaitingDexopts
+                << " waiting, at most " << mMaxConcurrentDexopts << " at once (0 = unlimited)"
+                << endl;
+    }
+
     out << endl;
     out.flush();
 
@@ -369,6 +451,29 @@ static int restorecon_app_data_lazy(const std::string& parent, const char* name,
             existing);
 }
 
+/**
+ * Labels a package data directory along with its cache and code_cache directories. A directory
+ * that did not exist before holds nothing but those, so the whole tree is labeled in a single
+ * recursive pass instead of checking each of them for a label change.
+ */
+static int restorecon_app_data_dirs(const std::string& path, const std::string& seInfo, uid_t uid,
+        bool existing) {
+    if (!existing) {
+        if (selinux_android_restorecon_pkgdir(path.c_str(), seInfo.c_str(), uid,
+                SELINUX_ANDROID_RESTORECON_RECURSE) < 0) {
+            PLOG(ERROR) << "Failed restorecon for " << path;
+            return -1;
+        }
+        return 0;
+    }
+    if (restorecon_app_data_lazy(path, seInfo, uid, existing) ||
+            restorecon_app_data_lazy(path, "cache", seInfo, uid, existing) ||
+            restorecon_app_data_lazy(path, "code_cache", seInfo, uid, existing)) {
+        return -1;
+    }
+    return 0;
+}
+
 static int prepare_app_dir(const std::string& path, mode_t target_mode, uid_t uid) {
     if (fs_prepare_dir_strict(path.c_str(), target_mode, uid, uid) != 0) {
         PLOG(ERROR) << "Failed to prepare " << path;
@@ -427,22 +532,55 @@ binder::Status InstalldNativeService::createAppDataBatched(
         const std::vector<std::string>& seInfos, const std::vector<int32_t>& targetSdkVersions,
         int64_t* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    const size_t count = uuids->size();
+    for (size_t i = 0; i < count; i++) {
+        CHECK_ARGUMENT_UUID(uuids->at(i));
+        if (packageNames->at(i)) {
+            CHECK_ARGUMENT_PACKAGE_NAME(*packageNames->at(i));
+        }
+    }
 
     ATRACE_BEGIN("createAppDataBatched");
-    binder::Status ret;
-    for (size_t i = 0; i < uuids->size(); i++) {
-        if (!packageNames->at(i)) {
-            continue;
-        }
-        ret = createAppData(uuids->at(i), *packageNames->at(i), userId, flags, appIds[i],
-                seInfos[i], targetSdkVersions[i], _aidl_return);
-        if (!ret.isOk()) {
-            ATRACE_END();
-            return ret;
+    // The packages are independent of each other, so prepare them on a few threads at once. The
+    // workers stop picking up new packages once one of them failed.
+    std::vector<binder::Status> results(count);
+    std::vector<int64_t> ceDataInodes(count, -1);
+    std::atomic<size_t> nextIndex(0);
+    std::atomic<bool> failed(false);
+    auto createNextAppData = [&]() {
+        for (size_t i = nextIndex++; i < count && !failed; i = nextIndex++) {
+            if (!packageNames->at(i)) {
+                continue;
+            }
+            const std::string& packageName = *packageNames->at(i);
+            LOCK_PACKAGE_USER(packageName, userId);
+            results[i] = createAppDataLocked(uuids->at(i), packageName, userId, flags, appIds[i],
+                    seInfos[i], targetSdkVersions[i], &ceDataInodes[i]);
+            if (!results[i].isOk()) {
+                failed = true;
+            }
         }
+    };
+    const size_t threadCount = std::min({count, kCreateAppDataMaxThreads,
+            static_cast<size_t>(std::max(1u, std::thread::hardware_concurrency()))});
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(createNextAppData);
+    }
+    createNextAppData();
+    for (std::thread& thread : threads) {
+        thread.join();
     }
     ATRACE_END();
+
+    for (size_t i = 0; i < count; i++) {
+        if (!results[i].isOk()) {
+            return results[i];
+        }
+        if (packageNames->at(i)) {
+            *_aidl_return = ceDataInodes[i];
+        }
+    }
     return ok();
 }
 
@@ -452,8 +590,15 @@ binder::Status InstalldNativeService::createAppData(const std::unique_ptr<std::s
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE_USER(packageName, userId);
+    return createAppDataLocked(uuid, packageName, userId, flags, appId, seInfo,
+            targetSdkVersion, _aidl_return);
+}
 
+binder::Status InstalldNativeService::createAppDataLocked(
+        const std::unique_ptr<std::string>& uuid, const std::string& packageName, int32_t userId,
+        int32_t flags, int32_t appId, const std::string& seInfo, int32_t targetSdkVersion,
+        int64_t* _aidl_return) {
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
 
@@ -480,9 +625,7 @@ binder::Status InstalldNativeService::createAppData(const std::unique_ptr<std::s
         }
 
         // Consider restorecon over contents if label changed
-        if (restorecon_app_data_lazy(path, seInfo, uid, existing) ||
-                restorecon_app_data_lazy(path, "cache", seInfo, uid, existing) ||
-                restorecon_app_data_lazy(path, "code_cache", seInfo, uid, existing)) {
+        if (restorecon_app_data_dirs(path, seInfo, uid, existing)) {
             return error("Failed to restorecon " + path);
         }
 
@@ -514,9 +657,7 @@ binder::Status InstalldNativeService::createAppData(const std::unique_ptr<std::s
         }
 
         // Consider restorecon over contents if label changed
-        if (restorecon_app_data_lazy(path, seInfo, uid, existing) ||
-                restorecon_app_data_lazy(path, "cache", seInfo, uid, existing) ||
-                restorecon_app_data_lazy(path, "code_cache", seInfo, uid, existing)) {
+        if (restorecon_app_data_dirs(path, seInfo, uid, existing)) {
             return error("Failed to restorecon " + path);
         }
 
@@ -532,7 +673,7 @@ binder::Status InstalldNativeService::migrateAppData(const std::unique_ptr<std::
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE_USER(packageName, userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -576,7 +717,7 @@ binder::Status InstalldNativeService::clearAppProfiles(const std::string& packag
         const std::string& profileName) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     binder::Status res = ok();
     if (!clear_primary_reference_profile(packageName, profileName)) {
@@ -593,8 +734,13 @@ binder::Status InstalldNativeService::clearAppData(const std::unique_ptr<std::st
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE_USER(packageName, userId);
+    return clearAppDataLocked(uuid, packageName, userId, flags, ceDataInode);
+}
 
+binder::Status InstalldNativeService::clearAppDataLocked(
+        const std::unique_ptr<std::string>& uuid, const std::string& packageName, int32_t userId,
+        int32_t flags, int64_t ceDataInode) {
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
 
@@ -693,7 +839,7 @@ static int destroy_app_current_profiles(const std::string& pkgname, userid_t use
 binder::Status InstalldNativeService::destroyAppProfiles(const std::string& packageName) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     binder::Status res = ok();
     std::vector<userid_t> users = get_known_users(/*volume_uuid*/ nullptr);
@@ -713,7 +859,7 @@ binder::Status InstalldNativeService::destroyAppData(const std::unique_ptr<std::
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE_USER(packageName, userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -906,7 +1052,7 @@ binder::Status InstalldNativeService::snapshotAppData(
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID_IS_TEST_OR_NULL(volumeUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE_USER(packageName, user);
 
     const char* volume_uuid = volumeUuid ? volumeUuid->c_str() : nullptr;
     const char* package_name = packageName.c_str();
@@ -975,7 +1121,7 @@ binder::Status InstalldNativeService::snapshotAppData(
     }
 
     // ce_data_inode is not needed when FLAG_CLEAR_CACHE_ONLY is set.
-    binder::Status clear_cache_result = clearAppData(volumeUuid, packageName, user,
+    binder::Status clear_cache_result = clearAppDataLocked(volumeUuid, packageName, user,
             storageFlags | FLAG_CLEAR_CACHE_ONLY, 0);
     if (!clear_cache_result.isOk()) {
         // It should be fine to continue snapshot if we for some reason failed
@@ -984,7 +1130,7 @@ binder::Status InstalldNativeService::snapshotAppData(
     }
 
     // ce_data_inode is not needed when FLAG_CLEAR_CODE_CACHE_ONLY is set.
-    binder::Status clear_code_cache_result = clearAppData(volumeUuid, packageName, user,
+    binder::Status clear_code_cache_result = clearAppDataLocked(volumeUuid, packageName, user,
             storageFlags | FLAG_CLEAR_CODE_CACHE_ONLY, 0);
     if (!clear_code_cache_result.isOk()) {
         // It should be fine to continue snapshot if we for some reason failed
@@ -1036,7 +1182,7 @@ binder::Status InstalldNativeService::restoreAppDataSnapshot(
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID_IS_TEST_OR_NULL(volumeUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE_USER(packageName, user);
 
     const char* volume_uuid = volumeUuid ? volumeUuid->c_str() : nullptr;
     const char* package_name = packageName.c_str();
@@ -1064,7 +1210,7 @@ binder::Status InstalldNativeService::restoreAppDataSnapshot(
     // It's fine to pass 0 as ceDataInode here, because restoreAppDataSnapshot
     // can only be called when user unlocks the phone, meaning that CE user data
     // is decrypted.
-    binder::Status res = clearAppData(volumeUuid, packageName, user, storageFlags,
+    binder::Status res = clearAppDataLocked(volumeUuid, packageName, user, storageFlags,
             0 /* ceDataInode */);
     if (!res.isOk()) {
         return res;
@@ -1098,7 +1244,7 @@ binder::Status InstalldNativeService::restoreAppDataSnapshot(
     }
 
     // Finally, restore the SELinux label on the app data.
-    return restoreconAppData(volumeUuid, packageName, user, storageFlags, appId, seInfo);
+    return restoreconAppDataLocked(volumeUuid, packageName, user, storageFlags, appId, seInfo);
 }
 
 binder::Status InstalldNativeService::destroyAppDataSnapshot(
@@ -1108,7 +1254,7 @@ binder::Status InstalldNativeService::destroyAppDataSnapshot(
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID_IS_TEST_OR_NULL(volumeUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE_USER(packageName, user);
 
     const char* volume_uuid = volumeUuid ? volumeUuid->c_str() : nullptr;
     const char* package_name = packageName.c_str();
@@ -1139,7 +1285,7 @@ binder::Status InstalldNativeService::destroyCeSnapshotsNotSpecified(
         const std::vector<int32_t>& retainSnapshotIds) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID_IS_TEST_OR_NULL(volumeUuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_USER(userId);
 
     const char* volume_uuid = volumeUuid ? volumeUuid->c_str() : nullptr;
 
@@ -1180,7 +1326,7 @@ binder::Status InstalldNativeService::moveCompleteApp(const std::unique_ptr<std:
     CHECK_ARGUMENT_UUID(fromUuid);
     CHECK_ARGUMENT_UUID(toUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     const char* from_uuid = fromUuid ? fromUuid->c_str() : nullptr;
     const char* to_uuid = toUuid ? toUuid->c_str() : nullptr;
@@ -1209,6 +1355,7 @@ binder::Status InstalldNativeService::moveCompleteApp(const std::unique_ptr<std:
 
     // Copy private data for all known users
     for (auto user : users) {
+        LOCK_USER_READ(user);
 
         // Data source may not exist for all users; that's okay
         auto from_ce = create_data_user_ce_package_path(from_uuid, user, package_name);
@@ -1217,8 +1364,8 @@ binder::Status InstalldNativeService::moveCompleteApp(const std::unique_ptr<std:
             continue;
         }
 
-        if (!createAppData(toUuid, packageName, user, FLAG_STORAGE_CE | FLAG_STORAGE_DE, appId,
-                seInfo, targetSdkVersion, nullptr).isOk()) {
+        if (!createAppDataLocked(toUuid, packageName, user, FLAG_STORAGE_CE | FLAG_STORAGE_DE,
+                appId, seInfo, targetSdkVersion, nullptr).isOk()) {
             res = error("Failed to create package target");
             goto fail;
         }
@@ -1244,7 +1391,7 @@ binder::Status InstalldNativeService::moveCompleteApp(const std::unique_ptr<std:
             }
         }
 
-        if (!restoreconAppData(toUuid, packageName, user, FLAG_STORAGE_CE | FLAG_STORAGE_DE,
+        if (!restoreconAppDataLocked(toUuid, packageName, user, FLAG_STORAGE_CE | FLAG_STORAGE_DE,
                 appId, seInfo).isOk()) {
             res = error("Failed to restorecon");
             goto fail;
@@ -1284,7 +1431,7 @@ binder::Status InstalldNativeService::createUserData(const std::unique_ptr<std::
         int32_t userId, int32_t userSerial ATTRIBUTE_UNUSED, int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_USER(userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     if (flags & FLAG_STORAGE_DE) {
@@ -1302,7 +1449,7 @@ binder::Status InstalldNativeService::destroyUserData(const std::unique_ptr<std:
         int32_t userId, int32_t flags) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_USER(userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     binder::Status res = ok();
@@ -1411,6 +1558,20 @@ binder::Status InstalldNativeService::freeCache(const std::unique_ptr<std::strin
         }
         ATRACE_END();
 
+        // Trackers of apps whose cache directories did not change since the last call keep
+        // their items, so that only the apps that changed are scanned again.
+        auto& previousTrackers = mCacheTrackers[uuidString];
+        for (auto& it : trackers) {
+            auto previous = previousTrackers.find(it.first);
+            if (previous != previousTrackers.end()
+                    && previous->second->getDataPaths() == it.second->getDataPaths()) {
+                previous->second->cacheQuota = it.second->cacheQuota;
+                previous->second->revalidateItems();
+                it.second = previous->second;
+            }
+        }
+        previousTrackers = trackers;
+
         // 2. Populate tracker stats and insert into priority queue
         ATRACE_BEGIN("populate");
         int64_t cacheTotal = 0;
@@ -1508,7 +1669,7 @@ binder::Status InstalldNativeService::rmdex(const std::string& codePath,
         const std::string& instructionSet) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(codePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PATH(codePath);
 
     char dex_path[PKG_PATH_MAX];
 
@@ -1652,7 +1813,7 @@ static void collectManualStats(const std::string& path, struct stats* stats) {
             } else {
                 // Measure all children nodes
                 size = 0;
-                calculate_tree_size(StringPrintf("%s/%s", path.c_str(), name), &size);
+                calculate_tree_size_cached(StringPrintf("%s/%s", path.c_str(), name), &size);
             }
 
             if (!strcmp(name, "cache") || !strcmp(name, "code_cache")) {
@@ -1790,14 +1951,14 @@ binder::Status InstalldNativeService::getAppSize(const std::unique_ptr<std::stri
     for (const auto& packageName : packageNames) {
         auto obbCodePath = create_data_media_package_path(uuid_, userId,
                 "obb", packageName.c_str());
-        calculate_tree_size(obbCodePath, &extStats.codeSize);
+        calculate_tree_size_cached(obbCodePath, &extStats.codeSize);
     }
     ATRACE_END();
 
     if (flags & FLAG_USE_QUOTA && appId >= AID_APP_START) {
         ATRACE_BEGIN("code");
         for (const auto& codePath : codePaths) {
-            calculate_tree_size(codePath, &stats.codeSize, -1,
+            calculate_tree_size_cached(codePath, &stats.codeSize, -1,
                     multiuser_get_shared_gid(0, appId));
         }
         ATRACE_END();
@@ -1808,7 +1969,7 @@ binder::Status InstalldNativeService::getAppSize(const std::unique_ptr<std::stri
     } else {
         ATRACE_BEGIN("code");
         for (const auto& codePath : codePaths) {
-            calculate_tree_size(codePath, &stats.codeSize);
+            calculate_tree_size_cached(codePath, &stats.codeSize);
         }
         ATRACE_END();
 
@@ -1824,10 +1985,10 @@ binder::Status InstalldNativeService::getAppSize(const std::unique_ptr<std::stri
 
             if (!uuid) {
                 ATRACE_BEGIN("profiles");
-                calculate_tree_size(
+                calculate_tree_size_cached(
                         create_primary_current_profile_package_dir_path(userId, pkgname),
                         &stats.dataSize);
-                calculate_tree_size(
+                calculate_tree_size_cached(
                         create_primary_reference_profile_package_dir_path(pkgname),
                         &stats.codeSize);
                 ATRACE_END();
@@ -1837,7 +1998,7 @@ binder::Status InstalldNativeService::getAppSize(const std::unique_ptr<std::stri
             auto extPath = create_data_media_package_path(uuid_, userId, "data", pkgname);
             collectManualStats(extPath, &extStats);
             auto mediaPath = create_data_media_package_path(uuid_, userId, "media", pkgname);
-            calculate_tree_size(mediaPath, &extStats.dataSize);
+            calculate_tree_size_cached(mediaPath, &extStats.dataSize);
             ATRACE_END();
         }
 
@@ -1845,7 +2006,7 @@ binder::Status InstalldNativeService::getAppSize(const std::unique_ptr<std::stri
             ATRACE_BEGIN("dalvik");
             int32_t sharedGid = multiuser_get_shared_gid(0, appId);
             if (sharedGid != -1) {
-                calculate_tree_size(create_data_dalvik_cache_path(), &stats.codeSize,
+                calculate_tree_size_cached(create_data_dalvik_cache_path(), &stats.codeSize,
                         sharedGid, -1);
             }
             ATRACE_END();
@@ -1995,7 +2156,7 @@ binder::Status InstalldNativeService::getUserSize(const std::unique_ptr<std::str
 
     if (flags & FLAG_USE_QUOTA) {
         ATRACE_BEGIN("code");
-        calculate_tree_size(create_data_app_path(uuid_), &stats.codeSize, -1, -1, true);
+        calculate_tree_size_cached(create_data_app_path(uuid_), &stats.codeSize, -1, -1, true);
         ATRACE_END();
 
         ATRACE_BEGIN("data");
@@ -2008,9 +2169,9 @@ binder::Status InstalldNativeService::getUserSize(const std::unique_ptr<std::str
         if (!uuid) {
             ATRACE_BEGIN("profile");
             auto userProfilePath = create_primary_cur_profile_dir_path(userId);
-            calculate_tree_size(userProfilePath, &stats.dataSize, -1, -1, true);
+            calculate_tree_size_cached(userProfilePath, &stats.dataSize, -1, -1, true);
             auto refProfilePath = create_primary_ref_profile_dir_path();
-            calculate_tree_size(refProfilePath, &stats.codeSize, -1, -1, true);
+            calculate_tree_size_cached(refProfilePath, &stats.codeSize, -1, -1, true);
             ATRACE_END();
         }
 
@@ -2022,9 +2183,9 @@ binder::Status InstalldNativeService::getUserSize(const std::unique_ptr<std::str
 
         if (!uuid) {
             ATRACE_BEGIN("dalvik");
-            calculate_tree_size(create_data_dalvik_cache_path(), &stats.codeSize,
+            calculate_tree_size_cached(create_data_dalvik_cache_path(), &stats.codeSize,
                     -1, -1, true);
-            calculate_tree_size(create_primary_cur_profile_dir_path(userId), &stats.dataSize,
+            calculate_tree_size_cached(create_primary_cur_profile_dir_path(userId), &stats.dataSize,
                     -1, -1, true);
             ATRACE_END();
         }
@@ -2044,11 +2205,11 @@ binder::Status InstalldNativeService::getUserSize(const std::unique_ptr<std::str
     } else {
         ATRACE_BEGIN("obb");
         auto obbPath = create_data_path(uuid_) + "/media/obb";
-        calculate_tree_size(obbPath, &extStats.codeSize);
+        calculate_tree_size_cached(obbPath, &extStats.codeSize);
         ATRACE_END();
 
         ATRACE_BEGIN("code");
-        calculate_tree_size(create_data_app_path(uuid_), &stats.codeSize);
+        calculate_tree_size_cached(create_data_app_path(uuid_), &stats.codeSize);
         ATRACE_END();
 
         ATRACE_BEGIN("data");
@@ -2061,9 +2222,9 @@ binder::Status InstalldNativeService::getUserSize(const std::unique_ptr<std::str
         if (!uuid) {
             ATRACE_BEGIN("profile");
             auto userProfilePath = create_primary_cur_profile_dir_path(userId);
-            calculate_tree_size(userProfilePath, &stats.dataSize);
+            calculate_tree_size_cached(userProfilePath, &stats.dataSize);
             auto refProfilePath = create_primary_ref_profile_dir_path();
-            calculate_tree_size(refProfilePath, &stats.codeSize);
+            calculate_tree_size_cached(refProfilePath, &stats.codeSize);
             ATRACE_END();
         }
 
@@ -2078,8 +2239,8 @@ binder::Status InstalldNativeService::getUserSize(const std::unique_ptr<std::str
 
         if (!uuid) {
             ATRACE_BEGIN("dalvik");
-            calculate_tree_size(create_data_dalvik_cache_path(), &stats.codeSize);
-            calculate_tree_size(create_primary_cur_profile_dir_path(userId), &stats.dataSize);
+            calculate_tree_size_cached(create_data_dalvik_cache_path(), &stats.codeSize);
+            calculate_tree_size_cached(create_primary_cur_profile_dir_path(userId), &stats.dataSize);
             ATRACE_END();
         }
     }
@@ -2224,7 +2385,7 @@ binder::Status InstalldNativeService::getAppCrates(
         CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     }
 #ifdef ENABLE_STORAGE_CRATES
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_USER_READ(userId);
 
     auto retVector = std::make_unique<std::vector<std::unique_ptr<CrateMetadata>>>();
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
@@ -2270,7 +2431,7 @@ binder::Status InstalldNativeService::getUserCrates(
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
 #ifdef ENABLE_STORAGE_CRATES
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_USER_READ(userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     auto retVector = std::make_unique<std::vector<std::unique_ptr<CrateMetadata>>>();
@@ -2327,7 +2488,7 @@ binder::Status InstalldNativeService::dumpProfiles(int32_t uid, const std::strin
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     CHECK_ARGUMENT_PATH(codePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     *_aidl_return = dump_profiles(uid, packageName, profileName, codePath);
     return ok();
@@ -2339,7 +2500,7 @@ binder::Status InstalldNativeService::copySystemProfile(const std::string& syste
         bool* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
     *_aidl_return = copy_system_profile(systemProfile, packageUid, packageName, profileName);
     return ok();
 }
@@ -2349,7 +2510,7 @@ binder::Status InstalldNativeService::mergeProfiles(int32_t uid, const std::stri
         const std::string& profileName, bool* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     *_aidl_return = analyze_primary_profiles(uid, packageName, profileName);
     return ok();
@@ -2360,7 +2521,7 @@ binder::Status InstalldNativeService::createProfileSnapshot(int32_t appId,
         const std::string& classpath, bool* _aidl_return) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     *_aidl_return = create_profile_snapshot(appId, packageName, profileName, classpath);
     return ok();
@@ -2370,7 +2531,7 @@ binder::Status InstalldNativeService::destroyProfileSnapshot(const std::string&
         const std::string& profileName) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE(packageName);
 
     std::string snapshot = create_snapshot_profile_path(packageName, profileName);
     if ((unlink(snapshot.c_str()) != 0) && (errno != ENOENT)) {
@@ -2400,7 +2561,17 @@ binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t
     }
     CHECK_ARGUMENT_PATH(outputPath);
     CHECK_ARGUMENT_PATH(dexMetadataPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    // Wait for a turn before taking any lock, so that waiting holds up nothing else.
+    binder::Status slot = acquireDexoptSlot(apkPath);
+    if (!slot.isOk()) {
+        return slot;
+    }
+    auto releaseSlot = android::base::make_scope_guard([this]() { releaseDexoptSlot(); });
+    // Compiling for no package in particular only has to keep other calls off the APK.
+    const bool hasPackageName = packageName && *packageName != "*";
+    PackageLock localPackageLock(hasPackageName ? *packageName : apkPath,
+            hasPackageName ? mPackageNameLock : mPathLock, mLock);
+    std::lock_guard<PackageLock> packageLock(localPackageLock);
 
     const char* oat_dir = getCStr(outputPath);
     const char* instruction_set = instructionSet.c_str();
@@ -2425,6 +2596,52 @@ binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t
     return res ? error(res, error_msg) : ok();
 }
 
+binder::Status InstalldNativeService::acquireDexoptSlot(const std::string& apkPath) {
+    std::unique_lock<std::mutex> lock(mDexoptLock);
+    const uint64_t cancellations = mDexoptCancellations;
+    mWaitingDexopts++;
+    mDexoptCondition.wait(lock, [&]() {
+        return mDexoptCancellations != cancellations || mMaxConcurrentDexopts <= 0 ||
+                mRunningDexopts < mMaxConcurrentDexopts;
+    });
+    mWaitingDexopts--;
+    if (mDexoptCancellations != cancellations) {
+        return error(ECANCELED, "Cancelled dexopt of " + apkPath);
+    }
+    mRunningDexopts++;
+    return ok();
+}
+
+void InstalldNativeService::releaseDexoptSlot() {
+    std::lock_guard<std::mutex> lock(mDexoptLock);
+    mRunningDexopts--;
+    mDexoptCondition.notify_all();
+}
+
+binder::Status InstalldNativeService::setDexoptBudget(int32_t maxConcurrentDexopts,
+        int32_t dex2oatThreads) {
+    ENFORCE_UID(AID_SYSTEM);
+    if (maxConcurrentDexopts < 0 || dex2oatThreads < 0) {
+        return exception(binder::Status::EX_ILLEGAL_ARGUMENT,
+                StringPrintf("Invalid dexopt budget %d x %d", maxConcurrentDexopts,
+                        dex2oatThreads));
+    }
+    std::lock_guard<std::mutex> lock(mDexoptLock);
+    // A smaller budget lets the dexopts already running finish, and only holds back new ones.
+    mMaxConcurrentDexopts = maxConcurrentDexopts;
+    set_dex2oat_threads(dex2oatThreads);
+    mDexoptCondition.notify_all();
+    return ok();
+}
+
+binder::Status InstalldNativeService::cancelPendingDexopts() {
+    ENFORCE_UID(AID_SYSTEM);
+    std::lock_guard<std::mutex> lock(mDexoptLock);
+    mDexoptCancellations++;
+    mDexoptCondition.notify_all();
+    return ok();
+}
+
 binder::Status InstalldNativeService::compileLayouts(const std::string& apkPath,
                                                      const std::string& packageName,
                                                      const std ::string& outDexFile, int uid,
@@ -2443,7 +2660,7 @@ binder::Status InstalldNativeService::linkNativeLibraryDirectory(
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     CHECK_ARGUMENT_PATH(nativeLibPath32);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE_USER(packageName, userId);
 
     const char* uuid_ = uuid ? uuid->c_str() : nullptr;
     const char* pkgname = packageName.c_str();
@@ -2534,8 +2751,13 @@ binder::Status InstalldNativeService::restoreconAppData(const std::unique_ptr<st
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE_USER(packageName, userId);
+    return restoreconAppDataLocked(uuid, packageName, userId, flags, appId, seInfo);
+}
 
+binder::Status InstalldNativeService::restoreconAppDataLocked(
+        const std::unique_ptr<std::string>& uuid, const std::string& packageName, int32_t userId,
+        int32_t flags, int32_t appId, const std::string& seInfo) {
     binder::Status res = ok();
 
     // SELINUX_ANDROID_RESTORECON_DATADATA flag is set by libselinux. Not needed here.
@@ -2564,7 +2786,7 @@ binder::Status InstalldNativeService::createOatDir(const std::string& oatDir,
         const std::string& instructionSet) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(oatDir);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PATH(oatDir);
 
     const char* oat_dir = oatDir.c_str();
     const char* instruction_set = instructionSet.c_str();
@@ -2589,7 +2811,7 @@ binder::Status InstalldNativeService::createOatDir(const std::string& oatDir,
 binder::Status InstalldNativeService::rmPackageDir(const std::string& packageDir) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(packageDir);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PATH(packageDir);
 
     if (validate_apk_path(packageDir.c_str())) {
         return error("Invalid path " + packageDir);
@@ -2605,7 +2827,7 @@ binder::Status InstalldNativeService::linkFile(const std::string& relativePath,
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(fromBase);
     CHECK_ARGUMENT_PATH(toBase);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PATH(toBase);
 
     const char* relative_path = relativePath.c_str();
     const char* from_base = fromBase.c_str();
@@ -2635,7 +2857,7 @@ binder::Status InstalldNativeService::moveAb(const std::string& apkPath,
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(apkPath);
     CHECK_ARGUMENT_PATH(outputPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PATH(apkPath);
 
     const char* apk_path = apkPath.c_str();
     const char* instruction_set = instructionSet.c_str();
@@ -2650,7 +2872,7 @@ binder::Status InstalldNativeService::deleteOdex(const std::string& apkPath,
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(apkPath);
     CHECK_ARGUMENT_PATH(outputPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PATH(apkPath);
 
     const char* apk_path = apkPath.c_str();
     const char* instruction_set = instructionSet.c_str();
@@ -2683,7 +2905,7 @@ binder::Status InstalldNativeService::installApkVerity(const std::string& filePa
         android::base::unique_fd verityInputAshmem, int32_t contentSize) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(filePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PATH(filePath);
 
     if (!android::base::GetBoolProperty(kPropApkVerityMode, false)) {
         return ok();
@@ -2765,7 +2987,7 @@ binder::Status InstalldNativeService::assertFsverityRootHashMatches(const std::s
         const std::vector<uint8_t>& expectedHash) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PATH(filePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PATH(filePath);
 
     if (!android::base::GetBoolProperty(kPropApkVerityMode, false)) {
         return ok();
@@ -2804,7 +3026,7 @@ binder::Status InstalldNativeService::reconcileSecondaryDexFile(
     CHECK_ARGUMENT_UUID(volumeUuid);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     CHECK_ARGUMENT_PATH(dexPath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE_USER(packageName, multiuser_get_user_id(uid));
 
     bool result = android::installd::reconcile_secondary_dex_file(
             dexPath, packageName, uid, isas, volumeUuid, storage_flag, _aidl_return);
@@ -2939,6 +3161,10 @@ binder::Status InstalldNativeService::onPrivateVolumeRemoved(
         const std::unique_ptr<std::string>& uuid) {
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
+    if (uuid) {
+        std::lock_guard<std::recursive_mutex> lock(mLock);
+        mCacheTrackers.erase(*uuid);
+    }
     if (!sAppDataIsolationEnabled) {
         return ok();
     }
@@ -3005,7 +3231,7 @@ binder::Status InstalldNativeService::prepareAppProfile(const std::string& packa
     ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_PACKAGE_NAME(packageName);
     CHECK_ARGUMENT_PATH(codePath);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+    LOCK_PACKAGE_USER(packageName, userId);
 
     *_aidl_return = prepare_app_profile(packageName, userId, appId, profileName, codePath,
         dexMetadata);
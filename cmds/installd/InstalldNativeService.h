@@ -21,6 +21,10 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <vector>
 #include <unordered_map>
 
@@ -34,6 +38,8 @@
 namespace android {
 namespace installd {
 
+class CacheTracker;
+
 class InstalldNativeService : public BinderService<InstalldNativeService>, public os::BnInstalld {
 public:
     static status_t start();
@@ -115,6 +121,8 @@ public:
             int32_t targetSdkVersion, const std::unique_ptr<std::string>& profileName,
             const std::unique_ptr<std::string>& dexMetadataPath,
             const std::unique_ptr<std::string>& compilationReason);
+    binder::Status setDexoptBudget(int32_t maxConcurrentDexopts, int32_t dex2oatThreads);
+    binder::Status cancelPendingDexopts();
 
     binder::Status compileLayouts(const std::string& apkPath, const std::string& packageName,
                                   const std::string& outDexFile, int uid, bool* _aidl_return);
@@ -173,18 +181,55 @@ public:
     binder::Status migrateLegacyObbData();
 
 private:
+    // Taken for the whole of the few operations that span users or packages, and briefly to look
+    // up the locks below, so that no per-user or per-package operation starts while it is held.
     std::recursive_mutex mLock;
 
+    // Per-user locks, held exclusively while a user's data is created or destroyed and shared by
+    // operations on the data of one of their packages. Entries go away with their last holder.
+    std::unordered_map<userid_t, std::weak_ptr<std::shared_mutex>> mUserIdLock;
+    // Per-package locks, taken before the user lock.
+    std::unordered_map<std::string, std::weak_ptr<std::recursive_mutex>> mPackageNameLock;
+    // Per-path locks for the operations that only know the code or oat path they work on.
+    std::unordered_map<std::string, std::weak_ptr<std::recursive_mutex>> mPathLock;
+
     std::recursive_mutex mMountsLock;
     std::recursive_mutex mQuotasLock;
 
+    // Limits how many dexopt calls run dex2oat at once. The others wait for their turn in
+    // acquireDexoptSlot, unless they are cancelled first.
+    std::mutex mDexoptLock;
+    std::condition_variable mDexoptCondition;
+    int32_t mMaxConcurrentDexopts = 0;
+    int32_t mRunningDexopts = 0;
+    int32_t mWaitingDexopts = 0;
+    uint64_t mDexoptCancellations = 0;
+
     /* Map of all storage mounts from source to target */
     std::unordered_map<std::string, std::string> mStorageMounts;
 
     /* Map from UID to cache quota size */
     std::unordered_map<uid_t, int64_t> mCacheQuotas;
 
+    /* Map from volume UUID and UID to the cache tracker freeCache last used */
+    std::unordered_map<std::string, std::unordered_map<uid_t, std::shared_ptr<CacheTracker>>>
+            mCacheTrackers;
+
     std::string findDataMediaPath(const std::unique_ptr<std::string>& uuid, userid_t userid);
+
+    binder::Status acquireDexoptSlot(const std::string& apkPath);
+    void releaseDexoptSlot();
+
+    // Variants of the binder calls for callers that already checked the arguments and hold the
+    // package and user locks.
+    binder::Status createAppDataLocked(const std::unique_ptr<std::string>& uuid,
+            const std::string& packageName, int32_t userId, int32_t flags, int32_t appId,
+            const std::string& seInfo, int32_t targetSdkVersion, int64_t* _aidl_return);
+    binder::Status clearAppDataLocked(const std::unique_ptr<std::string>& uuid,
+            const std::string& packageName, int32_t userId, int32_t flags, int64_t ceDataInode);
+    binder::Status restoreconAppDataLocked(const std::unique_ptr<std::string>& uuid,
+            const std::string& packageName, int32_t userId, int32_t flags, int32_t appId,
+            const std::string& seInfo);
 };
 
 }  // namespace installd
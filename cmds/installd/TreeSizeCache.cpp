@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TreeSizeCache.h"
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <errno.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+
+#include "utils.h"
+
+namespace android {
+namespace installd {
+
+namespace {
+
+// Everything that changes the size or the ownership of a directory's entries.
+constexpr uint32_t kWatchMask = IN_ATTRIB | IN_CREATE | IN_DELETE | IN_DELETE_SELF | IN_MODIFY
+        | IN_MOVE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_DONT_FOLLOW | IN_ONLYDIR;
+
+struct Key {
+    std::string path;
+    int32_t includeGid;
+    int32_t excludeGid;
+    bool excludeApps;
+
+    bool operator<(const Key& other) const {
+        return std::tie(path, includeGid, excludeGid, excludeApps)
+                < std::tie(other.path, other.includeGid, other.excludeGid, other.excludeApps);
+    }
+};
+
+struct Entry {
+    int64_t size;
+    // Unique to this measurement of the tree
+    uint64_t generation;
+    // Sequence number of the last event seen before the tree was walked
+    uint64_t seq;
+    // Watches of all the directories in the tree
+    std::vector<int> wds;
+};
+
+struct Watch {
+    // Number of entries and walks in progress that use the watch
+    int refs;
+    // Sequence number of the last event reported for the directory
+    uint64_t lastEventSeq;
+    // Whether the kernel dropped the watch, as it does when the directory is deleted
+    bool removed;
+};
+
+std::mutex sLock;
+android::base::unique_fd sInotifyFd;
+// Bumped whenever the inotify instance is replaced, which drops all the watches
+uint32_t sGeneration = 0;
+uint64_t sSeq = 0;
+uint64_t sNextGeneration = 1;
+std::map<Key, Entry> sEntries;
+std::unordered_map<int, Watch> sWatches;
+bool sWarnedOutOfWatches = false;
+
+void resetLocked() {
+    sInotifyFd.reset();
+    sEntries.clear();
+    sWatches.clear();
+    sGeneration++;
+}
+
+void releaseWatchLocked(int wd) {
+    auto it = sWatches.find(wd);
+    if (it == sWatches.end() || --it->second.refs > 0) {
+        return;
+    }
+    if (!it->second.removed) {
+        inotify_rm_watch(sInotifyFd.get(), wd);
+    }
+    sWatches.erase(it);
+}
+
+void releaseEntryLocked(const Entry& entry) {
+    for (int wd : entry.wds) {
+        releaseWatchLocked(wd);
+    }
+}
+
+bool isUnchangedLocked(const std::vector<int>& wds, uint64_t seq) {
+    for (int wd : wds) {
+        auto it = sWatches.find(wd);
+        if (it == sWatches.end() || it->second.lastEventSeq > seq) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void readEventsLocked() {
+    if (sInotifyFd == -1) {
+        return;
+    }
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = TEMP_FAILURE_RETRY(read(sInotifyFd.get(), buffer, sizeof(buffer)))) > 0) {
+        for (char* p = buffer; p < buffer + len;) {
+            const auto* event = reinterpret_cast<const struct inotify_event*>(p);
+            p += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Some changes are lost, so none of the sizes can be trusted anymore.
+                LOG(WARNING) << "inotify queue overflowed, dropping all cached tree sizes";
+                resetLocked();
+                return;
+            }
+            auto it = sWatches.find(event->wd);
+            if (it == sWatches.end()) {
+                continue;
+            }
+            it->second.lastEventSeq = ++sSeq;
+            if (event->mask & IN_IGNORED) {
+                it->second.removed = true;
+            }
+        }
+    }
+}
+
+// Returns the watch of the given directory, or -1 if it can't be watched.
+int addWatchLocked(const char* path) {
+    int wd = inotify_add_watch(sInotifyFd.get(), path, kWatchMask);
+    if (wd < 0) {
+        if (errno == ENOSPC && !sWarnedOutOfWatches) {
+            LOG(WARNING) << "Out of inotify watches, not caching the size of trees like " << path;
+            sWarnedOutOfWatches = true;
+        }
+        return -1;
+    }
+    // The kernel hands out the same watch for a directory that is already watched. A watch it
+    // dropped may be handed out again for another directory, but must keep invalidating the
+    // entries that used it before.
+    Watch& watch = sWatches[wd];
+    if (watch.removed) {
+        watch.lastEventSeq = sSeq;
+        watch.removed = false;
+    }
+    watch.refs++;
+    return wd;
+}
+
+} // namespace
+
+int calculate_tree_size_cached(const std::string& path, int64_t* size,
+        int32_t include_gid, int32_t exclude_gid, bool exclude_apps) {
+    const Key key{path, include_gid, exclude_gid, exclude_apps};
+    uint32_t generation;
+    uint64_t startSeq;
+    {
+        std::lock_guard<std::mutex> lock(sLock);
+        readEventsLocked();
+        auto it = sEntries.find(key);
+        if (it != sEntries.end()) {
+            if (isUnchangedLocked(it->second.wds, it->second.seq)) {
+                *size += it->second.size;
+                return 0;
+            }
+            releaseEntryLocked(it->second);
+            sEntries.erase(it);
+        }
+        if (sInotifyFd == -1) {
+            sInotifyFd.reset(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+            if (sInotifyFd == -1) {
+                PLOG(WARNING) << "Failed to create inotify instance";
+                return calculate_tree_size(path, size, include_gid, exclude_gid, exclude_apps);
+            }
+        }
+        generation = sGeneration;
+        startSeq = sSeq;
+    }
+
+    // Each directory is watched before its contents are measured, so that any change that the
+    // walk could have missed shows up as an event.
+    std::vector<int> wds;
+    bool watched = true;
+    auto watchDir = [&](const char* dirPath) {
+        if (!watched) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(sLock);
+        int wd = generation == sGeneration ? addWatchLocked(dirPath) : -1;
+        if (wd < 0) {
+            watched = false;
+        } else {
+            wds.push_back(wd);
+        }
+    };
+    int64_t treeSize = 0;
+    int res = calculate_tree_size(path, &treeSize, include_gid, exclude_gid, exclude_apps,
+            watchDir);
+
+    std::lock_guard<std::mutex> lock(sLock);
+    readEventsLocked();
+    if (generation == sGeneration) {
+        // A tree without any directory, like a missing one, can't be watched for changes.
+        if (res == 0 && watched && !wds.empty() && isUnchangedLocked(wds, startSeq)) {
+            auto it = sEntries.find(key);
+            if (it != sEntries.end()) {
+                // Measured by another thread at the same time.
+                releaseEntryLocked(it->second);
+                sEntries.erase(it);
+            }
+            sEntries.emplace(key, Entry{treeSize, sNextGeneration++, startSeq, std::move(wds)});
+        } else {
+            for (int wd : wds) {
+                releaseWatchLocked(wd);
+            }
+        }
+    }
+    *size += treeSize;
+    return res;
+}
+
+uint64_t get_tree_generation(const std::string& path) {
+    int64_t size = 0;
+    if (calculate_tree_size_cached(path, &size) != 0) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(sLock);
+    auto it = sEntries.find(Key{path, -1, -1, false});
+    return it != sEntries.end() ? it->second.generation : 0;
+}
+
+}  // namespace installd
+}  // namespace android
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_INSTALLD_TREE_SIZE_CACHE_H_
+#define ANDROID_INSTALLD_TREE_SIZE_CACHE_H_
+
+#include <inttypes.h>
+#include <string>
+
+namespace android {
+namespace installd {
+
+/*
+ * Like calculate_tree_size, but remembers the size of the tree and only walks it again once
+ * inotify reported a change to one of its directories or to a file in them. Used to measure app
+ * and user storage without quota support, where every query would otherwise walk all the trees.
+ */
+int calculate_tree_size_cached(const std::string& path, int64_t* size,
+        int32_t include_gid = -1, int32_t exclude_gid = -1, bool exclude_apps = false);
+
+/*
+ * Returns a number that stays the same for as long as the tree at path is unchanged, or 0 when
+ * changes to the tree can't be tracked. Measures the tree like calculate_tree_size_cached.
+ */
+uint64_t get_tree_generation(const std::string& path);
+
+}  // namespace installd
+}  // namespace android
+
+#endif  // ANDROID_INSTALLD_TREE_SIZE_CACHE_H_
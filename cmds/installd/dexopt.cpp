@@ -16,6 +16,7 @@
 #define LOG_TAG "installd"
 
 #include <array>
+#include <atomic>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,6 +30,8 @@
 #include <unistd.h>
 
 #include <iomanip>
+#include <mutex>
+#include <unordered_map>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -73,6 +76,13 @@ namespace installd {
 static constexpr bool kEnableMinidebugInfo = true;
 
 static constexpr const char* kMinidebugInfoSystemProperty = "dalvik.vm.dex2oat-minidebuginfo";
+
+// Number of threads dex2oat compiles with, when set by the framework.
+static std::atomic<int> sDex2oatThreads(0);
+
+void set_dex2oat_threads(int threads) {
+    sDex2oatThreads = threads;
+}
 static constexpr bool kMinidebugInfoSystemPropertyDefault = false;
 static constexpr const char* kMinidebugDex2oatFlag = "--generate-mini-debug-info";
 static constexpr const char* kDisableCompactDexFlag = "--compact-dex-level=none";
@@ -367,6 +377,10 @@ class RunDex2Oat : public ExecVHelper {
                             threads_format)
                     : MapPropertyToArg("dalvik.vm.dex2oat-threads", threads_format))
                 : MapPropertyToArg("dalvik.vm.boot-dex2oat-threads", threads_format);
+        const int dex2oat_threads = sDex2oatThreads;
+        if (dex2oat_threads > 0) {
+            dex2oat_threads_arg = StringPrintf("-j%d", dex2oat_threads);
+        }
         std::string cpu_set_format = "--cpu-set=%s";
         std::string dex2oat_cpu_set_arg = post_bootcomplete
                 ? (for_restore
@@ -886,6 +900,46 @@ class RunProfman : public ExecVHelper {
 // worth to recompile the given location.
 // If the return value is true all the current profiles would have been merged into
 // the reference profiles accessible with open_reference_profile().
+// Hashes of the profiles profman last found not worth compiling, by package and location. As
+// profman leaves such profiles untouched, it would come to the same decision for the same input.
+static std::mutex sSkippedProfilesLock;
+static std::unordered_map<std::string, std::string> sSkippedProfiles;
+
+// Hashes the contents of the given profiles, without moving their file offsets.
+static bool hash_profiles(const std::vector<unique_fd>& profiles_fd,
+        const unique_fd& reference_profile_fd, bool boot_class_path_profiling,
+        std::string* out_hash) {
+    SHA256_CTX ctx;
+    SHA256_Init(&ctx);
+    std::vector<uint8_t> buffer(65536);
+    auto hash_fd = [&](int fd) {
+        off_t offset = 0;
+        ssize_t bytes_read;
+        while ((bytes_read = TEMP_FAILURE_RETRY(
+                pread(fd, buffer.data(), buffer.size(), offset))) > 0) {
+            SHA256_Update(&ctx, buffer.data(), bytes_read);
+            offset += bytes_read;
+        }
+        // Also hash the length, so that moving data from one profile to the next counts.
+        SHA256_Update(&ctx, &offset, sizeof(offset));
+        return bytes_read == 0;
+    };
+    for (const unique_fd& fd : profiles_fd) {
+        if (!hash_fd(fd.get())) {
+            return false;
+        }
+    }
+    if (!hash_fd(reference_profile_fd.get())) {
+        return false;
+    }
+    SHA256_Update(&ctx, &boot_class_path_profiling, sizeof(boot_class_path_profiling));
+
+    std::array<uint8_t, SHA256_DIGEST_LENGTH> hash;
+    SHA256_Final(hash.data(), &ctx);
+    out_hash->assign(reinterpret_cast<const char*>(hash.data()), hash.size());
+    return true;
+}
+
 static bool analyze_profiles(uid_t uid, const std::string& package_name,
         const std::string& location, bool is_secondary_dex) {
     std::vector<unique_fd> profiles_fd;
@@ -898,6 +952,23 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
         return false;
     }
 
+    const bool boot_class_path_profiling = IsBootClassPathProfilingEnable();
+    const std::string skipped_key = StringPrintf("%d:%s:%s:%d", uid, package_name.c_str(),
+            location.c_str(), is_secondary_dex);
+    std::string profiles_hash;
+    if (hash_profiles(profiles_fd, reference_profile_fd, boot_class_path_profiling,
+            &profiles_hash)) {
+        std::lock_guard<std::mutex> lock(sSkippedProfilesLock);
+        auto it = sSkippedProfiles.find(skipped_key);
+        if (it != sSkippedProfiles.end() && it->second == profiles_hash) {
+            LOG(DEBUG) << "Profiles for location " << location << " did not change since "
+                    << "profman last skipped compilation";
+            return false;
+        }
+    } else {
+        profiles_hash.clear();
+    }
+
     RunProfman profman_merge;
     const std::vector<unique_fd>& apk_fds = std::vector<unique_fd>();
     const std::vector<std::string>& dex_locations = std::vector<std::string>();
@@ -907,7 +978,7 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
             apk_fds,
             dex_locations,
             /* for_snapshot= */ false,
-            IsBootClassPathProfilingEnable());
+            boot_class_path_profiling);
     pid_t pid = fork();
     if (pid == 0) {
         /* child -- drop privileges before continuing */
@@ -917,6 +988,7 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
     /* parent */
     int return_code = wait_child(pid);
     bool need_to_compile = false;
+    bool skipped_compilation = false;
     bool should_clear_current_profiles = false;
     bool should_clear_reference_profile = false;
     if (!WIFEXITED(return_code)) {
@@ -933,6 +1005,7 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
                 need_to_compile = false;
                 should_clear_current_profiles = false;
                 should_clear_reference_profile = false;
+                skipped_compilation = true;
                 break;
             case PROFMAN_BIN_RETURN_CODE_BAD_PROFILES:
                 LOG(WARNING) << "Bad profiles for location " << location;
@@ -976,6 +1049,15 @@ static bool analyze_profiles(uid_t uid, const std::string& package_name,
     if (should_clear_reference_profile) {
         clear_reference_profile(package_name, location, is_secondary_dex);
     }
+
+    {
+        std::lock_guard<std::mutex> lock(sSkippedProfilesLock);
+        if (skipped_compilation && !profiles_hash.empty()) {
+            sSkippedProfiles[skipped_key] = profiles_hash;
+        } else {
+            sSkippedProfiles.erase(skipped_key);
+        }
+    }
     return need_to_compile;
 }
 
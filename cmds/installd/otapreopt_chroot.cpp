@@ -20,11 +20,16 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 
+#include <algorithm>
+#include <map>
 #include <sstream>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/macros.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <libdm/dm.h>
 #include <selinux/android.h>
 
@@ -37,6 +42,7 @@
 #define LOG_TAG "otapreopt"
 #endif
 
+using android::base::Join;
 using android::base::StringPrintf;
 
 namespace android {
@@ -115,8 +121,136 @@ static void TryExtraMount(const char* name, const char* slot, const char* target
     UNUSED(mount_result);
 }
 
+// Returns the fingerprint of the build in the chroot, which is the one being preopted for.
+static std::string GetTargetFingerprint() {
+    std::string build_prop;
+    if (!base::ReadFileToString("/system/build.prop", &build_prop)) {
+        return "";
+    }
+    for (const std::string& line : base::Split(build_prop, "\n")) {
+        if (base::StartsWith(line, "ro.build.fingerprint=")) {
+            return line.substr(strlen("ro.build.fingerprint="));
+        }
+    }
+    return "";
+}
+
+// Runs the dexopt commands of a batch, each being a list of otapreopt parameters ended by
+// kBatchSeparator, with at most max_jobs otapreopt processes at a time.
+//
+// The commands that complete are recorded in a state file next to the OTA artifacts, along
+// with the target build fingerprint. Commands already recorded are skipped, so that a run
+// interrupted by a reboot resumes where it stopped. The state goes away with the artifacts
+// once the OTA is applied or cleaned up.
+static bool RunBatch(const char* target_slot, int argc, char** arg) {
+    constexpr const char* kBatchSeparator = ";";
+
+    int max_jobs = argc > 0 ? atoi(arg[0]) : 0;
+    if (max_jobs < 1) {
+        LOG(ERROR) << "Invalid number of batch jobs.";
+        return false;
+    }
+
+    std::vector<std::vector<std::string>> commands(1);
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(arg[i], kBatchSeparator) == 0) {
+            commands.emplace_back();
+        } else {
+            commands.back().push_back(arg[i]);
+        }
+    }
+
+    // Like otapreopt, which creates the same directory for the artifacts.
+    const std::string state_dir = StringPrintf("/data/ota/%s", target_slot);
+    const std::string state_path = state_dir + "/otapreopt.done";
+    if (mkdir(state_dir.c_str(), 0711) != 0 && errno != EEXIST) {
+        PLOG(WARNING) << "Could not create " << state_dir;
+    }
+    const std::string fingerprint = GetTargetFingerprint();
+    std::string state;
+    std::vector<std::string> completed;
+    if (!fingerprint.empty() && base::ReadFileToString(state_path, &state)) {
+        completed = base::Split(state, "\n");
+        if (completed[0] != fingerprint) {
+            completed.clear();
+        }
+    }
+    if (completed.empty()) {
+        // Nothing recorded for this build yet (or the fingerprint is unknown, in which case
+        // nothing will be).
+        completed.push_back(fingerprint);
+        state = fingerprint + "\n";
+        if (fingerprint.empty() || !base::WriteStringToFile(state, state_path)) {
+            state.clear();
+        }
+    }
+
+    bool result = true;
+    std::map<pid_t, std::string> running;
+    auto wait_for_job = [&]() {
+        int status;
+        pid_t pid = TEMP_FAILURE_RETRY(waitpid(-1, &status, 0));
+        auto it = running.find(pid);
+        if (it == running.end()) {
+            PLOG(ERROR) << "Failed to wait for otapreopt";
+            running.clear();
+            result = false;
+            return;
+        }
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            if (!state.empty()) {
+                base::unique_fd fd(open(state_path.c_str(),
+                                        O_WRONLY | O_APPEND | O_CLOEXEC | O_NOFOLLOW));
+                std::string line = it->second + "\n";
+                if (fd == -1 || !base::WriteStringToFd(line, fd) || fsync(fd) != 0) {
+                    PLOG(ERROR) << "Failed to record progress in " << state_path;
+                }
+            }
+        } else {
+            LOG(ERROR) << "Failed running otapreopt " << it->second;
+            result = false;
+        }
+        running.erase(it);
+    };
+
+    for (const std::vector<std::string>& params : commands) {
+        if (params.empty()) {
+            continue;
+        }
+        std::string key = Join(params, ' ');
+        if (std::find(completed.begin() + 1, completed.end(), key) != completed.end()) {
+            continue;
+        }
+
+        if (running.size() >= static_cast<size_t>(max_jobs)) {
+            wait_for_job();
+        }
+
+        std::vector<std::string> cmd;
+        cmd.reserve(params.size() + 2);
+        cmd.push_back("/system/bin/otapreopt");
+        cmd.push_back(target_slot);
+        cmd.insert(cmd.end(), params.begin(), params.end());
+
+        std::string error_msg;
+        pid_t pid = ExecAsync(cmd, &error_msg);
+        if (pid == -1) {
+            LOG(ERROR) << "Running otapreopt failed: " << error_msg;
+            result = false;
+            continue;
+        }
+        running.emplace(pid, std::move(key));
+    }
+    while (!running.empty()) {
+        wait_for_job();
+    }
+    return result;
+}
+
 // Entry for otapreopt_chroot. Expected parameters are:
 //   [cmd] [status-fd] [target-slot] "dexopt" [dexopt-params]
+// or, to run several dexopt commands at a time:
+//   [cmd] [status-fd] [target-slot] "batch" [max-jobs] [dexopt-params] ";" [dexopt-params]...
 // The file descriptor denoted by status-fd will be closed. The rest of the parameters will
 // be passed on to otapreopt in the chroot.
 static int otapreopt_chroot(const int argc, char **arg) {
@@ -253,23 +387,27 @@ static int otapreopt_chroot(const int argc, char **arg) {
     }
 
     // Now go on and run otapreopt.
+    bool exec_result;
+    if (argc > 3 && strcmp(arg[3], "batch") == 0) {
+        exec_result = RunBatch(arg[2], argc - 4, arg + 4);
+    } else {
+        // Incoming:  cmd + status-fd + target-slot + cmd...      | Incoming | = argc
+        // Outgoing:  cmd             + target-slot + cmd...      | Outgoing | = argc - 1
+        std::vector<std::string> cmd;
+        cmd.reserve(argc);
+        cmd.push_back("/system/bin/otapreopt");
+
+        // The first parameter is the status file descriptor, skip.
+        for (size_t i = 2; i < static_cast<size_t>(argc); ++i) {
+            cmd.push_back(arg[i]);
+        }
 
-    // Incoming:  cmd + status-fd + target-slot + cmd...      | Incoming | = argc
-    // Outgoing:  cmd             + target-slot + cmd...      | Outgoing | = argc - 1
-    std::vector<std::string> cmd;
-    cmd.reserve(argc);
-    cmd.push_back("/system/bin/otapreopt");
-
-    // The first parameter is the status file descriptor, skip.
-    for (size_t i = 2; i < static_cast<size_t>(argc); ++i) {
-        cmd.push_back(arg[i]);
-    }
-
-    // Fork and execute otapreopt in its own process.
-    std::string error_msg;
-    bool exec_result = Exec(cmd, &error_msg);
-    if (!exec_result) {
-        LOG(ERROR) << "Running otapreopt failed: " << error_msg;
+        // Fork and execute otapreopt in its own process.
+        std::string error_msg;
+        exec_result = Exec(cmd, &error_msg);
+        if (!exec_result) {
+            LOG(ERROR) << "Running otapreopt failed: " << error_msg;
+        }
     }
 
     // Tear down the work down by the apexd logic. (i.e. deactivate packages).
@@ -24,6 +24,17 @@ STATUS_FD="$2"
 # Maximum number of packages/steps.
 MAXIMUM_PACKAGES=1000
 
+# Number of packages compiled at a time, by default half of the CPUs so that the device
+# stays responsive. otapreopt_chroot is run once per batch of packages.
+JOBS=$(getprop ro.otapreopt.jobs)
+if [ -z "$JOBS" ] ; then
+  JOBS=$(($(nproc) / 2))
+fi
+if ((JOBS < 1)) ; then
+  JOBS=1
+fi
+BATCH_SIZE=$((JOBS * 4))
+
 # First ensure the system is booted. This is to work around issues when cmd would
 # infinitely loop trying to get a service manager (which will never come up in that
 # mode). b/30797145
@@ -58,22 +69,31 @@ PREPARE=$(cmd otadexopt prepare)
 PROGRESS=$(cmd otadexopt progress)
 print -u${STATUS_FD} "global_progress $PROGRESS"
 
+# The packages are handed out by the OTA service in priority order. Packages compiled before
+# an interrupted run are recorded by otapreopt_chroot and skipped.
 i=0
 while ((i<MAXIMUM_PACKAGES)) ; do
-  DEXOPT_PARAMS=$(cmd otadexopt next)
+  BATCH_PARAMS=""
+  n=0
+  while ((n<BATCH_SIZE && i<MAXIMUM_PACKAGES)) ; do
+    DONE=$(cmd otadexopt done)
+    if [ "$DONE" != "OTA incomplete." ] ; then
+      break
+    fi
+    DEXOPT_PARAMS=$(cmd otadexopt next)
+    BATCH_PARAMS="$BATCH_PARAMS $DEXOPT_PARAMS ;"
+    n=$((n+1))
+    i=$((i+1))
+  done
 
-  /system/bin/otapreopt_chroot $STATUS_FD $TARGET_SLOT_SUFFIX $DEXOPT_PARAMS >&- 2>&-
+  if ((n == 0)) ; then
+    break
+  fi
+
+  /system/bin/otapreopt_chroot $STATUS_FD $TARGET_SLOT_SUFFIX batch $JOBS $BATCH_PARAMS >&- 2>&-
 
   PROGRESS=$(cmd otadexopt progress)
   print -u${STATUS_FD} "global_progress $PROGRESS"
-
-  DONE=$(cmd otadexopt done)
-  if [ "$DONE" = "OTA incomplete." ] ; then
-    sleep 1
-    i=$((i+1))
-    continue
-  fi
-  break
 done
 
 DONE=$(cmd otadexopt done)
@@ -27,6 +27,7 @@ if test -n "$SLOT_SUFFIX" ; then
     NEW_SIZE=$(du -h -s /data/ota/$SLOT_SUFFIX/dalvik-cache)
     mv /data/ota/$SLOT_SUFFIX/dalvik-cache/* /data/dalvik-cache/
     rmdir /data/ota/$SLOT_SUFFIX/dalvik-cache
+    rm -f /data/ota/$SLOT_SUFFIX/otapreopt.done
     rmdir /data/ota/$SLOT_SUFFIX
     log -p i -t otapreopt_slot "Moved ${NEW_SIZE} over ${OLD_SIZE}"
   else
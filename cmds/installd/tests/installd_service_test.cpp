@@ -249,6 +249,15 @@ TEST_F(ServiceTest, CalculateCache) {
     EXPECT_EQ("/data/dalvik-cache/isa/path@to@file.apk@classes.dex", std::string(buf));
 }
 
+TEST_F(ServiceTest, SetDexoptBudget) {
+    EXPECT_BINDER_SUCCESS(service->setDexoptBudget(2, 4));
+    EXPECT_BINDER_SUCCESS(service->setDexoptBudget(0, 0));
+    EXPECT_BINDER_FAIL(service->setDexoptBudget(-1, 0));
+    EXPECT_BINDER_FAIL(service->setDexoptBudget(1, -4));
+    // Nothing waiting, nothing to cancel.
+    EXPECT_BINDER_SUCCESS(service->cancelPendingDexopts());
+}
+
 static bool mkdirs(const std::string& path, mode_t mode) {
     struct stat sb;
     if (stat(path.c_str(), &sb) != -1 && S_ISDIR(sb.st_mode)) {
@@ -17,12 +17,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/scopeguard.h>
 #include <gtest/gtest.h>
 
 #include "InstalldNativeService.h"
 #include "MatchExtensionGen.h"
+#include "TreeSizeCache.h"
 #include "globals.h"
 #include "utils.h"
 
@@ -638,5 +640,47 @@ TEST_F(UtilsTest, TestCreateDirIfNeeded) {
     ASSERT_NE(0, create_dir_if_needed("/data/local/tmp/user/0/bar/baz", 0700));
 }
 
+TEST_F(UtilsTest, TestCalculateTreeSizeCached) {
+    const std::string root = "/data/local/tmp/tree_size";
+    system(("mkdir -p " + root + "/foo").c_str());
+
+    auto deleter = [&]() {
+        delete_dir_contents_and_dir(root, true /* ignore_if_missing */);
+    };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+
+    auto expectSameSize = [&]() {
+        int64_t expected = 0;
+        ASSERT_EQ(0, calculate_tree_size(root, &expected));
+        int64_t size = 0;
+        ASSERT_EQ(0, calculate_tree_size_cached(root, &size));
+        EXPECT_EQ(expected, size);
+    };
+
+    ASSERT_TRUE(android::base::WriteStringToFile(std::string(8192, 'a'), root + "/foo/file"));
+    expectSameSize();
+    // Measured again from the cache.
+    expectSameSize();
+
+    // Files growing in place, new directories and removed ones all have to be noticed.
+    ASSERT_TRUE(android::base::WriteStringToFile(std::string(65536, 'b'), root + "/foo/file"));
+    expectSameSize();
+    ASSERT_EQ(0, create_dir_if_needed(root + "/bar", 0700));
+    ASSERT_TRUE(android::base::WriteStringToFile(std::string(16384, 'c'), root + "/bar/file"));
+    expectSameSize();
+    ASSERT_EQ(0, delete_dir_contents_and_dir(root + "/foo"));
+    expectSameSize();
+
+    // Missing trees measure as nothing, and are measured again once they exist.
+    int64_t size = 0;
+    calculate_tree_size_cached(root + "/baz", &size);
+    EXPECT_EQ(0, size);
+    ASSERT_EQ(0, create_dir_if_needed(root + "/baz", 0700));
+    int64_t expected = 0;
+    ASSERT_EQ(0, calculate_tree_size(root + "/baz", &expected));
+    ASSERT_EQ(0, calculate_tree_size_cached(root + "/baz", &size));
+    EXPECT_EQ(expected, size);
+}
+
 }  // namespace installd
 }  // namespace android
@@ -377,7 +377,8 @@ std::vector<userid_t> get_known_users(const char* volume_uuid) {
 }
 
 int calculate_tree_size(const std::string& path, int64_t* size,
-        int32_t include_gid, int32_t exclude_gid, bool exclude_apps) {
+        int32_t include_gid, int32_t exclude_gid, bool exclude_apps,
+        const std::function<void(const char*)>& visit_dir) {
     FTS *fts;
     FTSENT *p;
     int64_t matchedSize = 0;
@@ -406,6 +407,9 @@ int calculate_tree_size(const std::string& path, int64_t* size,
                 fts_set(fts, p, FTS_SKIP);
                 break;
             }
+            if (p->fts_info == FTS_D && visit_dir) {
+                visit_dir(p->fts_path);
+            }
             if (include_gid != -1 && gid != include_gid) {
                 break;
             }
@@ -18,6 +18,7 @@
 #ifndef UTILS_H_
 #define UTILS_H_
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -107,8 +108,13 @@ std::string create_snapshot_profile_path(
 
 std::vector<userid_t> get_known_users(const char* volume_uuid);
 
+/*
+ * Adds the size of the tree at path to *size. When given, visit_dir is called for every directory
+ * that is traversed, before its contents are measured.
+ */
 int calculate_tree_size(const std::string& path, int64_t* size,
-        int32_t include_gid = -1, int32_t exclude_gid = -1, bool exclude_apps = false);
+        int32_t include_gid = -1, int32_t exclude_gid = -1, bool exclude_apps = false,
+        const std::function<void(const char*)>& visit_dir = nullptr);
 
 int create_user_config_path(char path[PKG_PATH_MAX], userid_t userid);
 
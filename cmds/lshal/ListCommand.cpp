@@ -19,13 +19,17 @@
 #include <getopt.h>
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <sstream>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -70,6 +74,28 @@ std::string getPackageAndVersion(const std::string& fqInstance) {
     return splitFirst(fqInstance, ':').first;
 }
 
+// Most of the time spent on a HAL goes into waiting for it to answer, so a few of them are
+// queried at once.
+static constexpr size_t MAX_FETCH_THREADS = 8;
+
+// Call f(0) ... f(count - 1) on up to MAX_FETCH_THREADS threads, including the calling one.
+static void forEachInParallel(size_t count, const std::function<void(size_t)>& f) {
+    std::atomic<size_t> next{0};
+    const auto loop = [&] {
+        for (size_t i = next++; i < count; i = next++) {
+            f(i);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(MAX_FETCH_THREADS, count); ++i) {
+        threads.emplace_back(loop);
+    }
+    loop();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
 NullableOStream<std::ostream> ListCommand::out() const {
     return mLshal.out();
 }
@@ -293,6 +319,7 @@ bool ListCommand::getPidInfo(
 }
 
 const PidInfo* ListCommand::getPidInfoCached(pid_t serverPid) {
+    std::lock_guard<std::mutex> lock(mCachedPidInfosLock);
     auto pair = mCachedPidInfos.insert({serverPid, PidInfo{}});
     if (pair.second /* did insertion take place? */) {
         if (!getPidInfo(serverPid, &pair.first->second)) {
@@ -551,13 +578,27 @@ void ListCommand::dumpTable(const NullableOStream<std::ostream>& out) const {
         // on the "mServicesTable".
         std::function<std::string(const std::string&)> emitDebugInfo = nullptr;
         if (mEmitDebugInfo && &table == &mServicesTable) {
-            emitDebugInfo = [this](const auto& iName) {
+            // Each HAL can take a while to dump, so ask all of them up front.
+            std::vector<const TableEntry*> entries;
+            for (const TableEntry& entry : table) {
+                entries.push_back(&entry);
+            }
+            std::vector<std::string> debugInfos(entries.size());
+            forEachInParallel(entries.size(), [&](size_t i) {
                 std::stringstream ss;
-                auto pair = splitFirst(iName, '/');
+                auto pair = splitFirst(entries[i]->interfaceName, '/');
                 mLshal.emitDebugInfo(pair.first, pair.second, {},
                                      false /* excludesParentInstances */, ss,
                                      NullableOStream<std::ostream>(nullptr));
-                return ss.str();
+                debugInfos[i] = ss.str();
+            });
+            auto allDebugInfos = std::make_shared<std::map<std::string, std::string>>();
+            for (size_t i = 0; i < entries.size(); ++i) {
+                allDebugInfos->emplace(entries[i]->interfaceName, std::move(debugInfos[i]));
+            }
+            emitDebugInfo = [allDebugInfos](const auto& iName) {
+                auto it = allDebugInfos->find(iName);
+                return it == allDebugInfos->end() ? std::string() : it->second;
             };
         }
         table.createTextTable(mNeat, emitDebugInfo).dump(out.buf());
@@ -669,16 +710,27 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
         return DUMP_BINDERIZED_ERROR;
     }
 
-    Status status = OK;
-    std::map<std::string, TableEntry> allTableEntries;
-    for (const auto &fqInstanceName : fqInstanceNames) {
+    std::vector<TableEntry> entries(fqInstanceNames.size());
+    std::vector<std::stringstream> warnings(fqInstanceNames.size());
+    std::vector<Status> statuses(fqInstanceNames.size(), OK);
+    for (size_t i = 0; i < fqInstanceNames.size(); ++i) {
         // create entry and default assign all fields.
-        TableEntry& entry = allTableEntries[fqInstanceName];
-        entry.interfaceName = fqInstanceName;
-        entry.transport = mode;
-        entry.serviceStatus = ServiceStatus::NON_RESPONSIVE;
+        entries[i].interfaceName = fqInstanceNames[i];
+        entries[i].transport = mode;
+        entries[i].serviceStatus = ServiceStatus::NON_RESPONSIVE;
+    }
 
-        status |= fetchBinderizedEntry(manager, &entry);
+    // Warnings are collected per entry and printed in the original order afterwards.
+    forEachInParallel(entries.size(), [&](size_t i) {
+        statuses[i] = fetchBinderizedEntry(manager, &entries[i], warnings[i]);
+    });
+
+    Status status = OK;
+    std::map<std::string, TableEntry> allTableEntries;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        err() << warnings[i].str();
+        status |= statuses[i];
+        allTableEntries[entries[i].interfaceName] = std::move(entries[i]);
     }
 
     for (auto& pair : allTableEntries) {
@@ -688,10 +740,10 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
 }
 
 Status ListCommand::fetchBinderizedEntry(const sp<IServiceManager> &manager,
-                                         TableEntry *entry) {
+                                         TableEntry *entry, std::ostream &warnings) {
     Status status = OK;
     const auto handleError = [&](Status additionalError, const std::string& msg) {
-        err() << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg << std::endl;
+        warnings << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg << std::endl;
         status |= DUMP_BINDERIZED_ERROR | additionalError;
     };
 
@@ -119,6 +119,7 @@ bool Access::canAdd(const CallingContext& ctx, const std::string& name) {
 }
 
 bool Access::canList(const CallingContext& ctx) {
+    std::lock_guard<std::mutex> lock(mSelinuxLock);
     return actionAllowed(ctx, mThisProcessContext, "list", "service_manager");
 }
 
@@ -136,6 +137,7 @@ bool Access::actionAllowed(const CallingContext& sctx, const char* tctx, const c
 }
 
 bool Access::actionAllowedFromLookup(const CallingContext& sctx, const std::string& name, const char *perm) {
+    std::lock_guard<std::mutex> lock(mSelinuxLock);
     char *tctx = nullptr;
     if (selabel_lookup(getSehandle(), &tctx, name.c_str(), SELABEL_CTX_ANDROID_SERVICE) != 0) {
         LOG(ERROR) << "SELinux: No match for " << name << " in service_contexts.\n";
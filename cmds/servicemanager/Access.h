@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <mutex>
 #include <string>
 #include <sys/types.h>
 
@@ -51,6 +52,9 @@ private:
             const char *perm);
 
     char* mThisProcessContext = nullptr;
+
+    // libselinux's label handle and access vector cache are not thread-safe.
+    std::mutex mSelinuxLock;
 };
 
 };
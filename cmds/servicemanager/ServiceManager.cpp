@@ -24,6 +24,8 @@
 #include <binder/Stability.h>
 #include <cutils/android_filesystem_config.h>
 #include <cutils/multiuser.h>
+#include <algorithm>
+#include <mutex>
 #include <thread>
 
 #ifndef VENDORSERVICEMANAGER
@@ -132,19 +134,24 @@ sp<IBinder> ServiceManager::tryGetService(const std::string& name, bool startIfN
     auto ctx = mAccess->getCallingContext();
 
     sp<IBinder> out;
-    Service* service = nullptr;
-    if (auto it = mNameToService.find(name); it != mNameToService.end()) {
-        service = &(it->second);
-
-        if (!service->allowIsolated) {
-            uid_t appid = multiuser_get_app_id(ctx.uid);
-            bool isIsolated = appid >= AID_ISOLATED_START && appid <= AID_ISOLATED_END;
-
-            if (isIsolated) {
-                return nullptr;
+    bool needsGuarantee = false;
+    {
+        std::shared_lock<std::shared_mutex> lock(mLock);
+        if (auto it = mNameToService.find(name); it != mNameToService.end()) {
+            const Service& service = it->second;
+
+            if (!service.allowIsolated) {
+                uid_t appid = multiuser_get_app_id(ctx.uid);
+                bool isIsolated = appid >= AID_ISOLATED_START && appid <= AID_ISOLATED_END;
+
+                if (isIsolated) {
+                    return nullptr;
+                }
             }
+            out = service.binder;
+            // The guarantee is only ever cleared for services with client callbacks.
+            needsGuarantee = !service.guaranteeClient || mNameToClientCallback.count(name) > 0;
         }
-        out = service->binder;
     }
 
     if (!mAccess->canFind(ctx, name)) {
@@ -155,10 +162,14 @@ sp<IBinder> ServiceManager::tryGetService(const std::string& name, bool startIfN
         tryStartService(name);
     }
 
-    if (out) {
+    if (out && needsGuarantee) {
         // Setting this guarantee each time we hand out a binder ensures that the client-checking
         // loop knows about the event even if the client immediately drops the service
-        service->guaranteeClient = true;
+        std::unique_lock<std::shared_mutex> lock(mLock);
+        if (auto it = mNameToService.find(name);
+                it != mNameToService.end() && it->second.binder == out) {
+            it->second.guaranteeClient = true;
+        }
     }
 
     return out;
@@ -213,6 +224,8 @@ Status ServiceManager::addService(const std::string& name, const sp<IBinder>& bi
         return Status::fromExceptionCode(Status::EX_ILLEGAL_STATE);
     }
 
+    std::unique_lock<std::shared_mutex> lock(mLock);
+
     // Overwrite the old service if it exists
     mNameToService[name] = Service {
         .binder = binder,
@@ -238,6 +251,8 @@ Status ServiceManager::listServices(int32_t dumpPriority, std::vector<std::strin
         return Status::fromExceptionCode(Status::EX_SECURITY);
     }
 
+    std::shared_lock<std::shared_mutex> lock(mLock);
+
     size_t toReserve = 0;
     for (auto const& [name, service] : mNameToService) {
         (void) name;
@@ -256,6 +271,9 @@ Status ServiceManager::listServices(int32_t dumpPriority, std::vector<std::strin
         }
     }
 
+    // callers rely on the services being sorted
+    std::sort(outList->begin(), outList->end());
+
     return Status::ok();
 }
 
@@ -281,6 +299,8 @@ Status ServiceManager::registerForNotifications(
         return Status::fromExceptionCode(Status::EX_ILLEGAL_STATE);
     }
 
+    std::unique_lock<std::shared_mutex> lock(mLock);
+
     mNameToRegistrationCallback[name].push_back(callback);
 
     if (auto it = mNameToService.find(name); it != mNameToService.end()) {
@@ -303,6 +323,7 @@ Status ServiceManager::unregisterForNotifications(
 
     bool found = false;
 
+    std::unique_lock<std::shared_mutex> lock(mLock);
     auto it = mNameToRegistrationCallback.find(name);
     if (it != mNameToRegistrationCallback.end()) {
         removeRegistrationCallback(IInterface::asBinder(callback), &it, &found);
@@ -353,6 +374,8 @@ void ServiceManager::removeRegistrationCallback(const wp<IBinder>& who,
 }
 
 void ServiceManager::binderDied(const wp<IBinder>& who) {
+    std::unique_lock<std::shared_mutex> lock(mLock);
+
     for (auto it = mNameToService.begin(); it != mNameToService.end();) {
         if (who == it->second.binder) {
             it = mNameToService.erase(it);
@@ -390,6 +413,8 @@ Status ServiceManager::registerClientCallback(const std::string& name, const sp<
         return Status::fromExceptionCode(Status::EX_SECURITY);
     }
 
+    std::unique_lock<std::shared_mutex> lock(mLock);
+
     auto serviceIt = mNameToService.find(name);
     if (serviceIt == mNameToService.end()) {
         LOG(ERROR) << "Could not add callback for nonexistent service: " << name;
@@ -444,6 +469,8 @@ ssize_t ServiceManager::Service::getNodeStrongRefCount() {
 }
 
 void ServiceManager::handleClientCallbacks() {
+    std::unique_lock<std::shared_mutex> lock(mLock);
+
     for (const auto& [name, service] : mNameToService) {
         handleServiceClientCallback(name, true);
     }
@@ -524,6 +551,8 @@ Status ServiceManager::tryUnregisterService(const std::string& name, const sp<IB
         return Status::fromExceptionCode(Status::EX_SECURITY);
     }
 
+    std::unique_lock<std::shared_mutex> lock(mLock);
+
     auto serviceIt = mNameToService.find(name);
     if (serviceIt == mNameToService.end()) {
         LOG(WARNING) << "Tried to unregister " << name
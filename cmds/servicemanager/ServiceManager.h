@@ -20,6 +20,10 @@
 #include <android/os/IClientCallback.h>
 #include <android/os/IServiceCallback.h>
 
+#include <map>
+#include <shared_mutex>
+#include <unordered_map>
+
 #include "Access.h"
 
 namespace android {
@@ -68,7 +72,9 @@ private:
 
     using ServiceCallbackMap = std::map<std::string, std::vector<sp<IServiceCallback>>>;
     using ClientCallbackMap = std::map<std::string, std::vector<sp<IClientCallback>>>;
-    using ServiceMap = std::map<std::string, Service>;
+    using ServiceMap = std::unordered_map<std::string, Service>;
+
+    // The helpers below must be called with mLock held exclusively.
 
     // removes a callback from mNameToRegistrationCallback, removing it if the vector is empty
     // this updates iterator to the next location
@@ -84,6 +90,9 @@ private:
 
     sp<IBinder> tryGetService(const std::string& name, bool startIfNotFound);
 
+    // Lookups only take this lock shared, so that they can be served by several binder threads
+    // at once; everything that changes the maps below takes it exclusively.
+    std::shared_mutex mLock;
     ServiceMap mNameToService;
     ServiceCallbackMap mNameToRegistrationCallback;
     ClientCallbackMap mNameToClientCallback;
@@ -36,6 +36,8 @@ using ::android::ServiceManager;
 using ::android::os::IServiceManager;
 using ::android::sp;
 
+static constexpr size_t kLookupThreadCount = 3;
+
 class BinderCallback : public LooperCallback {
 public:
     static sp<BinderCallback> setupTo(const sp<Looper>& looper) {
@@ -121,7 +123,9 @@ int main(int argc, char** argv) {
     const char* driver = argc == 2 ? argv[1] : "/dev/binder";
 
     sp<ProcessState> ps = ProcessState::initWithDriver(driver);
-    ps->setThreadPoolMaxThreadCount(0);
+    // Lookups storm in during boot, so a small binder thread pool serves them
+    // alongside the main thread, which keeps handling the looper.
+    ps->setThreadPoolMaxThreadCount(kLookupThreadCount);
     ps->setCallRestriction(ProcessState::CallRestriction::FATAL_IF_NOT_ONEWAY);
 
     sp<ServiceManager> manager = new ServiceManager(std::make_unique<Access>());
@@ -137,6 +141,8 @@ int main(int argc, char** argv) {
     BinderCallback::setupTo(looper);
     ClientCallbackCallback::setupTo(looper, manager);
 
+    ps->startThreadPool();
+
     while(true) {
         looper->pollAll(-1);
     }
@@ -22,6 +22,8 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include <thread>
+
 #include "Access.h"
 #include "ServiceManager.h"
 
@@ -255,6 +257,36 @@ TEST(GetService, NotAllowedFromIsolated) {
     EXPECT_EQ(nullptr, out.get());
 }
 
+TEST(GetService, ConcurrentLookupsWhileAdding) {
+    auto sm = getPermissiveServiceManager();
+    sp<IBinder> service = getBinder();
+
+    EXPECT_TRUE(sm->addService("foo", service, false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+
+    std::vector<std::thread> lookups;
+    for (int i = 0; i < 4; i++) {
+        lookups.emplace_back([&] {
+            for (int j = 0; j < 1000; j++) {
+                sp<IBinder> out;
+                EXPECT_TRUE(sm->checkService("foo", &out).isOk());
+                EXPECT_EQ(service, out);
+            }
+        });
+    }
+    for (int i = 0; i < 100; i++) {
+        EXPECT_TRUE(sm->addService("bar" + std::to_string(i), getBinder(),
+            false /*allowIsolated*/, IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+    }
+    for (auto& lookup : lookups) {
+        lookup.join();
+    }
+
+    std::vector<std::string> out;
+    EXPECT_TRUE(sm->listServices(IServiceManager::DUMP_FLAG_PRIORITY_ALL, &out).isOk());
+    EXPECT_EQ(101u, out.size());
+}
+
 TEST(ListServices, NoPermissions) {
     std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
 
@@ -28,11 +28,15 @@
 #include <gui/Surface.h>
 #include <private/gui/ComposerService.h>
 
+#include <binder/IBinder.h>
+
 #include <ui/DisplayInfo.h>
 #include <utils/Log.h>
+#include <utils/String16.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <condition_variable>
@@ -46,19 +50,22 @@
 #include <thread>
 #include <vector>
 
+#include <unistd.h>
+
 using namespace android;
 
 std::atomic_bool Replayer::sReplayingManually(false);
 
 Replayer::Replayer(const std::string& filename, bool replayManually, int numThreads, bool wait,
-        nsecs_t stopHere)
+        nsecs_t stopHere, bool benchmark)
       : mTrace(),
         mLoaded(false),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mBenchmark(benchmark) {
     srand(RAND_COLOR_SEED);
 
     std::string input;
@@ -82,14 +89,16 @@ Replayer::Replayer(const std::string& filename, bool replayManually, int numThre
     }
 }
 
-Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere)
+Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere,
+        bool benchmark)
       : mTrace(t),
         mLoaded(true),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mBenchmark(benchmark) {
     srand(RAND_COLOR_SEED);
     mCurrentTime = mTrace.increment(0).time_stamp();
 
@@ -114,6 +123,11 @@ status_t Replayer::replay() {
 
     SurfaceComposerClient::enableVSyncInjections(true);
 
+    if (mBenchmark) {
+        setTimeStats({"-clear", "-enable"});
+        mReplayStartTime = systemTime();
+    }
+
     initReplay();
 
     ALOGV("Starting actual Replay!");
@@ -128,7 +142,11 @@ status_t Replayer::replay() {
         waitForConsoleCommmand();
 
         if (mWaitForTimeStamps) {
-            waitUntilTimestamp(mCurrentIncrement.time_stamp());
+            if (mBenchmark) {
+                waitUntilTraceTime(mCurrentIncrement.time_stamp());
+            } else {
+                waitUntilTimestamp(mCurrentIncrement.time_stamp());
+            }
         }
 
         auto event = mPendingIncrements.front();
@@ -153,6 +171,16 @@ status_t Replayer::replay() {
         mCurrentTime = mCurrentIncrement.time_stamp();
     }
 
+    if (mBenchmark) {
+        // The last transactions may still be applying.
+        std::unique_lock<std::mutex> lock(mStatsLock);
+        mStatsCond.wait(lock, [this] {
+            return mApplyLatencies.size() == static_cast<size_t>(mTransactionsDispatched);
+        });
+        lock.unlock();
+        printBenchmarkReport(systemTime() - mReplayStartTime);
+    }
+
     SurfaceComposerClient::enableVSyncInjections(false);
 
     return status;
@@ -280,6 +308,10 @@ status_t Replayer::dispatchEvent(int index) {
     status_t status = NO_ERROR;
     switch (increment.increment_case()) {
         case increment.kTransaction: {
+            if (mBenchmark) {
+                std::lock_guard<std::mutex> lock(mStatsLock);
+                mTransactionsDispatched++;
+            }
             std::thread(&Replayer::doTransaction, this, increment.transaction(), event).detach();
         } break;
         case increment.kSurfaceCreation: {
@@ -347,7 +379,11 @@ status_t Replayer::doTransaction(const Transaction& t, const std::shared_ptr<Eve
 
     event->readyToExecute();
 
+    const nsecs_t applyStart = systemTime();
     liveTransaction.apply(t.synchronous());
+    if (mBenchmark) {
+        recordApplyLatency(systemTime() - applyStart);
+    }
 
     ALOGV("Ended Transaction");
 
@@ -692,6 +728,72 @@ void Replayer::waitUntilTimestamp(int64_t timestamp) {
     std::this_thread::sleep_for(std::chrono::nanoseconds(timestamp - mCurrentTime));
 }
 
+void Replayer::waitUntilTraceTime(int64_t timestamp) {
+    // Unlike waitUntilTimestamp, follow the recorded schedule from the start of
+    // the replay, so that time spent replaying doesn't add up.
+    const nsecs_t target = mReplayStartTime + (timestamp - mTrace.increment(0).time_stamp());
+    const nsecs_t now = systemTime();
+    if (now < target) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(target - now));
+        return;
+    }
+    mTotalLateness += now - target;
+    mMaxLateness = std::max(mMaxLateness, now - target);
+}
+
+void Replayer::setTimeStats(const std::vector<const char*>& args) {
+    sp<IBinder> surfaceFlinger = IInterface::asBinder(ComposerService::getComposerService());
+    Vector<String16> dumpArgs;
+    dumpArgs.add(String16("--timestats"));
+    for (const char* arg : args) {
+        dumpArgs.add(String16(arg));
+    }
+    status_t status = surfaceFlinger->dump(STDOUT_FILENO, dumpArgs);
+    if (status != NO_ERROR) {
+        ALOGE("Couldn't update TimeStats (%d)", status);
+    }
+}
+
+void Replayer::recordApplyLatency(nsecs_t latency) {
+    std::lock_guard<std::mutex> lock(mStatsLock);
+    mApplyLatencies.push_back(latency);
+    mStatsCond.notify_one();
+}
+
+void Replayer::printBenchmarkReport(nsecs_t replayTime) {
+    std::vector<nsecs_t> latencies;
+    {
+        std::lock_guard<std::mutex> lock(mStatsLock);
+        latencies = mApplyLatencies;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](size_t p) {
+        return latencies.empty() ? 0 : latencies[(latencies.size() - 1) * p / 100];
+    };
+    nsecs_t total = 0;
+    for (nsecs_t latency : latencies) {
+        total += latency;
+    }
+
+    std::cout << "Benchmark results:\n";
+    std::cout << "  Replay time: " << ns2us(replayTime) << " us for "
+              << mTrace.increment_size() << " increments\n";
+    if (mWaitForTimeStamps) {
+        std::cout << "  Schedule lateness: total " << ns2us(mTotalLateness) << " us, max "
+                  << ns2us(mMaxLateness) << " us\n";
+    }
+    std::cout << "  Transactions: " << latencies.size() << "\n";
+    if (!latencies.empty()) {
+        std::cout << "  Apply latency (us): avg " << ns2us(total / latencies.size()) << ", p50 "
+                  << ns2us(percentile(50)) << ", p90 " << ns2us(percentile(90)) << ", p99 "
+                  << ns2us(percentile(99)) << ", max " << ns2us(latencies.back()) << "\n";
+    }
+    std::cout << std::endl;
+
+    // Frame durations and missed frames, as seen by SurfaceFlinger.
+    setTimeStats({"-dump", "-maxlayers", "0", "-disable"});
+}
+
 void Replayer::waitUntilDeferredTransactionLayerExists(
         const DeferredTransactionChange& dtc, std::unique_lock<std::mutex>& lock) {
     if (mLayers.count(dtc.layer_id()) == 0 || mLayers[dtc.layer_id()] == nullptr) {
@@ -55,9 +55,10 @@ typedef google::protobuf::RepeatedPtrField<DisplayChange> DisplayChanges;
 class Replayer {
   public:
     Replayer(const std::string& filename, bool replayManually = false,
-            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1);
+            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1,
+            bool benchmark = false);
     Replayer(const Trace& trace, bool replayManually = false, int numThreads = DEFAULT_THREADS,
-            bool wait = true, nsecs_t stopHere = -1);
+            bool wait = true, nsecs_t stopHere = -1, bool benchmark = false);
 
     status_t replay();
 
@@ -133,6 +134,14 @@ class Replayer {
             display_id id, const ProjectionChange& pc);
 
     void waitUntilTimestamp(int64_t timestamp);
+    void waitUntilTraceTime(int64_t timestamp);
+
+    // Benchmark mode: transaction apply latencies and schedule lateness are
+    // measured by the replayer, and frame statistics come from
+    // SurfaceFlinger's TimeStats, which is cleared when the replay starts.
+    void setTimeStats(const std::vector<const char*>& args);
+    void recordApplyLatency(nsecs_t latency);
+    void printBenchmarkReport(nsecs_t replayTime);
     void waitUntilDeferredTransactionLayerExists(
             const DeferredTransactionChange& dtc, std::unique_lock<std::mutex>& lock);
     status_t loadSurfaceComposerClient();
@@ -153,6 +162,16 @@ class Replayer {
     nsecs_t mStopTimeStamp;
     bool mHasStopped;
 
+    bool mBenchmark;
+    nsecs_t mReplayStartTime = 0;
+    nsecs_t mTotalLateness = 0;
+    nsecs_t mMaxLateness = 0;
+    int32_t mTransactionsDispatched = 0;
+
+    std::mutex mStatsLock;
+    std::condition_variable mStatsCond;
+    std::vector<nsecs_t> mApplyLatencies;
+
     std::mutex mLayerLock;
     std::condition_variable mLayerCond;
     std::unordered_map<layer_id, sp<SurfaceControl>> mLayers;
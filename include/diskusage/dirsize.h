@@ -25,6 +25,21 @@ __BEGIN_DECLS
 int64_t stat_size(struct stat *s);
 int64_t calculate_dir_size(int dfd);
 
+/*
+ * Remembers the entries of the directories walked by calculate_dir_size_parallel,
+ * so that the entries of a directory whose mtime did not change are not read
+ * again. The entries are still stat'ed on every walk. Thread-safe.
+ */
+struct dir_size_cache;
+struct dir_size_cache *dir_size_cache_create(void);
+void dir_size_cache_destroy(struct dir_size_cache *cache);
+
+/*
+ * Same as calculate_dir_size, but walks the subdirectories on up to |threads|
+ * threads, including the calling one. |cache| may be NULL.
+ */
+int64_t calculate_dir_size_parallel(int dfd, int threads, struct dir_size_cache *cache);
+
 __END_DECLS
 
 #endif /* __LIBDISKUSAGE_DIRSIZE_H */
@@ -37,6 +37,13 @@ public:
 
     virtual void setInputWindows(const std::vector<InputWindowInfo>& inputHandles,
             const sp<ISetInputWindowsListener>& setInputWindowsListener) = 0;
+    // Like setInputWindows(), but only sends what changed since the last call.
+    // windowIds lists the id of every window, in the same order setInputWindows()
+    // takes them, and changedWindows holds the windows that are new or changed.
+    // Windows whose id is left out of windowIds are removed.
+    virtual void updateInputWindows(const std::vector<InputWindowInfo>& changedWindows,
+            const std::vector<int32_t>& windowIds,
+            const sp<ISetInputWindowsListener>& setInputWindowsListener) = 0;
     virtual void registerInputChannel(const sp<InputChannel>& channel) = 0;
     virtual void unregisterInputChannel(const sp<InputChannel>& channel) = 0;
 };
@@ -50,7 +57,8 @@ public:
     enum {
         SET_INPUT_WINDOWS_TRANSACTION = IBinder::FIRST_CALL_TRANSACTION,
         REGISTER_INPUT_CHANNEL_TRANSACTION,
-        UNREGISTER_INPUT_CHANNEL_TRANSACTION
+        UNREGISTER_INPUT_CHANNEL_TRANSACTION,
+        UPDATE_INPUT_WINDOWS_TRANSACTION
     };
 
     virtual status_t onTransact(uint32_t code, const Parcel& data,
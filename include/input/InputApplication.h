@@ -34,7 +34,7 @@ namespace android {
 struct InputApplicationInfo {
     sp<IBinder> token;
     std::string name;
-    nsecs_t dispatchingTimeout;
+    nsecs_t dispatchingTimeout = -1;
 
     status_t write(Parcel& output) const;
     static InputApplicationInfo read(const Parcel& from);
@@ -29,12 +29,15 @@
  * The InputConsumer is used by the application to receive events from the input dispatcher.
  */
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <android-base/chrono_utils.h>
 
 #include <binder/IBinder.h>
 #include <input/Input.h>
+#include <input/VelocityTracker.h>
 #include <utils/BitSet.h>
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
@@ -172,6 +175,18 @@ struct InputMessage {
     bool isValid(size_t actualSize) const;
     size_t size() const;
     void getSanitizedCopy(InputMessage* msg) const;
+
+    /**
+     * Writes a sanitized copy of this message into 'msg' in the form that is sent over the socket,
+     * and returns its length. A motion pointer only takes up as much space as the axes it has
+     * values for, which is its properties, bits and populated values: a prefix of struct Pointer.
+     */
+    size_t pack(InputMessage* msg) const;
+    /**
+     * Expands a message of 'packedLength' bytes received from the socket back into the layout
+     * described by this struct. Returns false if the message is malformed.
+     */
+    bool unpack(size_t packedLength);
 };
 
 /*
@@ -228,6 +243,23 @@ public:
      */
     status_t receiveMessage(InputMessage* msg);
 
+    /* Send several messages to the other endpoint with a single system call.
+     *
+     * Messages are sent in order, and *outSent is set to how many of them were. If that is
+     * fewer than count, the return value is the error that stopped the next message from being
+     * sent, as sendMessage would have returned it.
+     */
+    status_t sendMessages(const InputMessage* msgs, size_t count, size_t* outSent);
+
+    /* Receive up to count messages sent by the other endpoint with a single system call.
+     *
+     * On success *outCount is set to the number of messages received, which is at least one.
+     * Return values are as for receiveMessage. If a message other than the first turns out to
+     * be invalid or the peer has closed, the messages before it are returned and the error is
+     * reported by the next receive call instead.
+     */
+    status_t receiveMessages(InputMessage* msgs, size_t count, size_t* outCount);
+
     /* Return a new object that has a duplicate of this channel's fd. */
     sp<InputChannel> dup() const;
 
@@ -254,6 +286,11 @@ private:
     android::base::unique_fd mFd;
 
     sp<IBinder> mToken;
+
+    // An error found by receiveMessages after it had already read some good messages.
+    status_t mPendingReceiveStatus = OK;
+
+    status_t checkReceivedMessage(InputMessage* msg, size_t length) const;
 };
 
 /*
@@ -415,6 +452,10 @@ private:
     // True if touch resampling is enabled.
     const bool mResampleTouch;
 
+    // The VelocityTracker strategy used to predict touch positions when resampling, or empty
+    // if resampled positions are extrapolated from the last two samples.
+    const std::string mTouchPredictor;
+
     // The input channel.
     sp<InputChannel> mChannel;
 
@@ -425,6 +466,14 @@ private:
     // call to consume and that still needs to be handled.
     bool mMsgDeferred;
 
+    // Messages read from the channel in one go but not handled yet. High-rate devices can
+    // queue several samples between two calls to consume, and reading them all at once saves
+    // a system call for each. Allocated on the first receive.
+    std::vector<InputMessage> mReceivedMsgs;
+    size_t mReceivedMsgCount;
+    size_t mNextReceivedMsg;
+    status_t receiveMessage(InputMessage* msg);
+
     // Batched motion events per device and source.
     struct Batch {
         Vector<InputMessage> samples;
@@ -476,6 +525,8 @@ private:
         size_t historySize;
         History history[2];
         History lastResample;
+        // Fit of the recent samples of each pointer, if there is a touch predictor.
+        std::shared_ptr<VelocityTracker> predictor;
 
         void initialize(int32_t deviceId, int32_t source) {
             this->deviceId = deviceId;
@@ -541,7 +592,9 @@ private:
     ssize_t findTouchState(int32_t deviceId, int32_t source) const;
 
     status_t sendUnchainedFinishedSignal(uint32_t seq, bool handled);
+    static void initializeFinishedMessage(InputMessage* msg, uint32_t seq, bool handled);
 
+    static void addPredictorMovement(VelocityTracker& predictor, const InputMessage& msg);
     static void rewriteMessage(TouchState& state, InputMessage& msg);
     static void initializeKeyEvent(KeyEvent* event, const InputMessage* msg);
     static void initializeMotionEvent(MotionEvent* event, const InputMessage* msg);
@@ -552,6 +605,7 @@ private:
     static bool shouldResampleTool(int32_t toolType);
 
     static bool isTouchResamplingEnabled();
+    static std::string getTouchPredictor();
 };
 
 } // namespace android
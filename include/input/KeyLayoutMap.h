@@ -62,6 +62,8 @@ struct AxisInfo {
  */
 class KeyLayoutMap : public RefBase {
 public:
+    /* Loads a key layout map from a file.
+     * Maps are cached by the process and shared by all callers until the file changes. */
     static status_t load(const std::string& filename, sp<KeyLayoutMap>* outMap);
 
     status_t mapKey(int32_t scanCode, int32_t usageCode,
@@ -94,6 +96,8 @@ private:
 
     KeyLayoutMap();
 
+    static status_t loadFile(const std::string& filename, sp<KeyLayoutMap>* outMap);
+
     const Key* getKey(int32_t scanCode, int32_t usageCode) const;
 
     class Parser {
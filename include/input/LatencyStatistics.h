@@ -20,10 +20,17 @@
 #include <android-base/chrono_utils.h>
 
 #include <stddef.h>
+#include <array>
+#include <string>
 
 namespace android {
 
 class LatencyStatistics {
+public:
+    /* Number of histogram buckets. Bucket 0 holds samples below 1, and bucket i > 0 holds samples
+     * in [2^(i-1), 2^i), except for the last one, which also holds everything larger. */
+    static constexpr size_t NUM_BUCKETS = 24;
+
 private:
     /* Minimum sample recorded */
     float mMin;
@@ -35,6 +42,8 @@ private:
     float mSum2;
     /* Count of all samples recorded */
     size_t mCount;
+    /* Count of samples recorded in each bucket */
+    std::array<size_t, NUM_BUCKETS> mHistogram;
     /* The last time statistics were reported */
     std::chrono::steady_clock::time_point mLastReportTime;
     /* Statistics Report Frequency */
@@ -52,6 +61,14 @@ public:
     float getMax();
     float getStDev();
     size_t getCount();
+
+    const std::array<size_t, NUM_BUCKETS>& getHistogram() const { return mHistogram; }
+    /* Estimate the value below which the given fraction of the samples fall, from the bucket
+     * bounds. Should not be called if no samples have been added. */
+    float getPercentile(float fraction);
+
+    /* One line summary of the samples, for dumpsys. */
+    std::string dump();
 };
 
 } // namespace android
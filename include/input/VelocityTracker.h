@@ -191,6 +191,70 @@ private:
 };
 
 
+/*
+ * Velocity tracker algorithm based on unweighted least-squares linear regression, like
+ * LeastSquaresVelocityTrackerStrategy with WEIGHTING_NONE, that keeps running sums over the
+ * samples of each pointer so neither adding a movement nor getting an estimate walks the history.
+ */
+class StreamingLeastSquaresVelocityTrackerStrategy : public VelocityTrackerStrategy {
+public:
+    // Degree must be 1 or 2.
+    StreamingLeastSquaresVelocityTrackerStrategy(uint32_t degree);
+    virtual ~StreamingLeastSquaresVelocityTrackerStrategy();
+
+    virtual void clear();
+    virtual void clearPointers(BitSet32 idBits);
+    virtual void addMovement(nsecs_t eventTime, BitSet32 idBits,
+            const VelocityTracker::Position* positions);
+    virtual bool getEstimator(uint32_t id, VelocityTracker::Estimator* outEstimator) const;
+
+private:
+    // Sample horizon, same as LeastSquaresVelocityTrackerStrategy.
+    static constexpr nsecs_t HORIZON = 100 * 1000000; // 100 ms
+
+    // Number of samples to keep, same as LeastSquaresVelocityTrackerStrategy.
+    static constexpr size_t HISTORY_SIZE = 20;
+
+    struct Sample {
+        nsecs_t eventTime;
+        VelocityTracker::Position position;
+    };
+
+    // Sums of the powers of the sample times, and of the positions multiplied by them.
+    struct Sums {
+        double t, t2, t3, t4;
+        double x, tx, t2x;
+        double y, ty, t2y;
+    };
+
+    // Samples of a particular pointer within the horizon, and their sums.
+    struct State {
+        // Ring of samples, oldest first.
+        Sample samples[HISTORY_SIZE];
+        size_t first;
+        size_t count;
+
+        // Time that the sample times in the sums are relative to, so they stay small.
+        nsecs_t baseTime;
+        Sums sums;
+
+        inline const Sample& sampleAt(size_t i) const {
+            return samples[(first + i) % HISTORY_SIZE];
+        }
+    };
+
+    const uint32_t mDegree;
+    BitSet32 mPointerIdBits;
+    State mPointerState[MAX_POINTER_ID + 1];
+
+    void addSample(State& state, nsecs_t eventTime,
+            const VelocityTracker::Position& position) const;
+    void rebase(State& state, nsecs_t baseTime) const;
+    static void accumulateSample(Sums& sums, double t, const VelocityTracker::Position& position,
+            double sign);
+};
+
+
 /*
  * Velocity tracker algorithm that uses an IIR filter.
  */
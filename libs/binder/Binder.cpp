@@ -23,6 +23,7 @@
 #include <binder/IResultReceiver.h>
 #include <binder/IShellCallback.h>
 #include <binder/Parcel.h>
+#include <binder/TransactionStats.h>
 
 #include <linux/sched.h>
 #include <stdio.h>
@@ -173,6 +174,9 @@ status_t BBinder::transact(
 {
     data.setDataPosition(0);
 
+    const bool recordStats = TransactionStats::isEnabled();
+    const nsecs_t start = recordStats ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
+
     status_t err = NO_ERROR;
     switch (code) {
         case PING_TRANSACTION:
@@ -194,6 +198,11 @@ status_t BBinder::transact(
         reply->setDataPosition(0);
     }
 
+    if (recordStats) {
+        TransactionStats::record(getInterfaceDescriptor(), code, false, data.dataSize(),
+                                 systemTime(SYSTEM_TIME_MONOTONIC) - start);
+    }
+
     return err;
 }
 
@@ -355,6 +364,10 @@ status_t BBinder::onTransact(
             for (int i = 0; i < argc && data.dataAvail() > 0; i++) {
                args.add(data.readString16());
             }
+            if (args.size() > 0 && args[0] == String16("--binder-transaction-stats")) {
+                TransactionStats::dump(fd);
+                return NO_ERROR;
+            }
             return dump(fd, args);
         }
 
@@ -22,6 +22,7 @@
 #include <binder/IPCThreadState.h>
 #include <binder/IResultReceiver.h>
 #include <binder/Stability.h>
+#include <binder/TransactionStats.h>
 #include <cutils/compiler.h>
 #include <utils/Log.h>
 
@@ -234,10 +235,18 @@ status_t BpBinder::transact(
             }
         }
 
+        const bool recordStats = TransactionStats::isEnabled();
+        const nsecs_t start = recordStats ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
+
         status_t status = IPCThreadState::self()->transact(
             mHandle, code, data, reply, flags);
         if (status == DEAD_OBJECT) mAlive = 0;
 
+        if (recordStats) {
+            TransactionStats::recordOutgoing(data, code,
+                                             systemTime(SYSTEM_TIME_MONOTONIC) - start);
+        }
+
         return status;
     }
 
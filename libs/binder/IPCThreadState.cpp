@@ -507,9 +507,17 @@ status_t IPCThreadState::getAndExecuteCommand()
 
         pthread_mutex_lock(&mProcess->mThreadCountLock);
         mProcess->mExecutingThreadsCount++;
+        if (mProcess->mExecutingThreadsCount > mProcess->mPeakExecutingThreadsCount) {
+            mProcess->mPeakExecutingThreadsCount = mProcess->mExecutingThreadsCount;
+        }
         if (mProcess->mExecutingThreadsCount >= mProcess->mMaxThreads &&
                 mProcess->mStarvationStartTimeMs == 0) {
             mProcess->mStarvationStartTimeMs = uptimeMillis();
+            mProcess->mStarvationCount++;
+            if (mProcess->mMaxThreads < mProcess->mAdaptiveMaxThreads) {
+                // Every looper is busy: let the driver spawn one more.
+                mProcess->setThreadPoolMaxThreadCount(mProcess->mMaxThreads + 1);
+            }
         }
         pthread_mutex_unlock(&mProcess->mThreadCountLock);
 
@@ -589,6 +597,10 @@ void IPCThreadState::joinThreadPool(bool isMain)
 
     mOut.writeInt32(isMain ? BC_ENTER_LOOPER : BC_REGISTER_LOOPER);
 
+    pthread_mutex_lock(&mProcess->mThreadCountLock);
+    mProcess->mStartedThreadsCount++;
+    pthread_mutex_unlock(&mProcess->mThreadCountLock);
+
     status_t result;
     do {
         processPendingDerefs();
@@ -610,6 +622,10 @@ void IPCThreadState::joinThreadPool(bool isMain)
     LOG_THREADPOOL("**** THREAD %p (PID %d) IS LEAVING THE THREAD POOL err=%d\n",
         (void*)pthread_self(), getpid(), result);
 
+    pthread_mutex_lock(&mProcess->mThreadCountLock);
+    mProcess->mStartedThreadsCount--;
+    pthread_mutex_unlock(&mProcess->mThreadCountLock);
+
     mOut.writeInt32(BC_EXIT_LOOPER);
     talkWithDriver(false);
 }
@@ -665,6 +681,30 @@ status_t IPCThreadState::transact(int32_t handle,
 
     LOG_ONEWAY(">>>> SEND from pid %d uid %d %s", getpid(), getuid(),
         (flags & TF_ONE_WAY) == 0 ? "READ REPLY" : "ONE WAY");
+
+    if (mOnewayBatchDepth > 0) {
+        if ((flags & TF_ONE_WAY) != 0) {
+            // The driver only reads the data when mOut is flushed, so keep a
+            // copy alive until then.
+            err = data.errorCheck();
+            if (err == NO_ERROR) {
+                auto copy = std::make_unique<Parcel>();
+                err = copy->appendFrom(&data, 0, data.dataSize());
+                if (err == NO_ERROR) {
+                    err = writeTransactionData(BC_TRANSACTION, flags, handle, code, *copy,
+                            nullptr);
+                }
+                if (err == NO_ERROR) {
+                    mOnewayBatch.push_back(std::move(copy));
+                    return NO_ERROR;
+                }
+            }
+            return (mLastError = err);
+        }
+        // Keep queued oneway calls ahead of this one.
+        flushOnewayBatch();
+    }
+
     err = writeTransactionData(BC_TRANSACTION, flags, handle, code, data, nullptr);
 
     if (err != NO_ERROR) {
@@ -718,6 +758,34 @@ status_t IPCThreadState::transact(int32_t handle,
     return err;
 }
 
+void IPCThreadState::beginOnewayBatch()
+{
+    mOnewayBatchDepth++;
+}
+
+status_t IPCThreadState::endOnewayBatch()
+{
+    LOG_ALWAYS_FATAL_IF(mOnewayBatchDepth <= 0, "endOnewayBatch() without beginOnewayBatch()");
+    if (--mOnewayBatchDepth > 0) {
+        return NO_ERROR;
+    }
+    return flushOnewayBatch();
+}
+
+status_t IPCThreadState::flushOnewayBatch()
+{
+    status_t result = NO_ERROR;
+    // The first wait submits every queued BC_TRANSACTION in one write; the
+    // rest only consume the BR_TRANSACTION_COMPLETE that each one returns,
+    // normally already sitting in mIn.
+    for (size_t i = 0; i < mOnewayBatch.size(); i++) {
+        const status_t err = waitForResponse(nullptr, nullptr);
+        if (result == NO_ERROR) result = err;
+    }
+    mOnewayBatch.clear();
+    return result;
+}
+
 void IPCThreadState::incStrongHandle(int32_t handle, BpBinder *proxy)
 {
     LOG_REMOTEREFS("IPCThreadState::incStrongHandle(%d)\n", handle);
@@ -803,11 +871,14 @@ status_t IPCThreadState::clearDeathNotification(int32_t handle, BpBinder* proxy)
 IPCThreadState::IPCThreadState()
     : mProcess(ProcessState::self()),
       mServingStackPointer(nullptr),
+      mServingCall{},
+      mServingCallValid(false),
       mWorkSource(kUnsetWorkSource),
       mPropagateWorkSource(false),
       mStrictModePolicy(0),
       mLastTransactionBinderFlags(0),
-      mCallRestriction(mProcess->mCallRestriction)
+      mCallRestriction(mProcess->mCallRestriction),
+      mOnewayBatchDepth(0)
 {
     pthread_setspecific(gTLS, this);
     clearCaller();
@@ -1180,6 +1251,19 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
             const void* origServingStackPointer = mServingStackPointer;
             mServingStackPointer = &origServingStackPointer; // anything on the stack
 
+            const ServingCall origServingCall = mServingCall;
+            const bool origServingCallValid = mServingCallValid;
+            mServingCallValid = false;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            mServingCall.target = tr.target.ptr ? reinterpret_cast<BBinder*>(tr.cookie)
+                                                : the_context_object.get();
+            mServingCall.code = tr.code;
+            mServingCall.callingUid = tr.sender_euid;
+            mServingCall.callingPid = tr.sender_pid;
+            mServingCall.startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            mServingCallValid = true;
+
             const pid_t origPid = mCallingPid;
             const char* origSid = mCallingSid;
             const uid_t origUid = mCallingUid;
@@ -1247,6 +1331,11 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
             }
 
             mServingStackPointer = origServingStackPointer;
+            mServingCallValid = false;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            mServingCall = origServingCall;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            mServingCallValid = origServingCallValid;
             mCallingPid = origPid;
             mCallingSid = origSid;
             mCallingUid = origUid;
@@ -1306,6 +1395,13 @@ const void* IPCThreadState::getServingStackPointer() const {
      return mServingStackPointer;
 }
 
+bool IPCThreadState::getServingCall(ServingCall* outCall) const {
+    if (!mServingCallValid) return false;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    *outCall = mServingCall;
+    return true;
+}
+
 void IPCThreadState::threadDestructor(void *st)
 {
         IPCThreadState* const self = static_cast<IPCThreadState*>(st);
@@ -36,6 +36,10 @@
 
 #include "Static.h"
 
+#include <atomic>
+#include <map>
+#include <mutex>
+
 #include <unistd.h>
 
 namespace android {
@@ -82,9 +86,32 @@ public:
         return IInterface::asBinder(mTheRealServiceManager).get();
     }
 private:
+    class CacheInvalidator : public IBinder::DeathRecipient {
+    public:
+        explicit CacheInvalidator(const ServiceManagerShim* shim) : mShim(shim) {}
+        void binderDied(const wp<IBinder>& who) override { mShim->evictCachedService(who); }
+    private:
+        // The shim owns this recipient and outlives it.
+        const ServiceManagerShim* mShim;
+    };
+
+    sp<IBinder> getCachedService(const String16& name) const;
+    void cacheService(const String16& name, const sp<IBinder>& service) const;
+    void evictCachedService(const wp<IBinder>& service) const;
+
     sp<AidlServiceManager> mTheRealServiceManager;
+
+    mutable std::mutex mCacheLock;
+    mutable std::map<String16, wp<IBinder>> mServiceCache;
+    sp<CacheInvalidator> mCacheInvalidator;
 };
 
+static std::atomic_bool gServiceLookupCacheEnabled(false);
+
+void setServiceLookupCacheEnabled(bool enabled) {
+    gServiceLookupCacheEnabled.store(enabled, std::memory_order_relaxed);
+}
+
 [[clang::no_destroy]] static std::once_flag gSmOnce;
 [[clang::no_destroy]] static sp<IServiceManager> gDefaultServiceManager;
 
@@ -203,9 +230,52 @@ bool checkPermission(const String16& permission, pid_t pid, uid_t uid)
 // ----------------------------------------------------------------------
 
 ServiceManagerShim::ServiceManagerShim(const sp<AidlServiceManager>& impl)
- : mTheRealServiceManager(impl)
+ : mTheRealServiceManager(impl),
+   mCacheInvalidator(new CacheInvalidator(this))
 {}
 
+sp<IBinder> ServiceManagerShim::getCachedService(const String16& name) const
+{
+    std::lock_guard<std::mutex> lock(mCacheLock);
+    auto it = mServiceCache.find(name);
+    if (it == mServiceCache.end()) return nullptr;
+
+    sp<IBinder> service = it->second.promote();
+    if (service == nullptr || !service->isBinderAlive()) {
+        mServiceCache.erase(it);
+        return nullptr;
+    }
+    return service;
+}
+
+void ServiceManagerShim::cacheService(const String16& name, const sp<IBinder>& service) const
+{
+    {
+        std::lock_guard<std::mutex> lock(mCacheLock);
+        auto it = mServiceCache.find(name);
+        if (it != mServiceCache.end() && it->second == service) return;
+    }
+    // Local services can't die, so only remote ones need watching.
+    if (service->remoteBinder() != nullptr &&
+            service->linkToDeath(mCacheInvalidator) != NO_ERROR) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mCacheLock);
+    mServiceCache[name] = service;
+}
+
+void ServiceManagerShim::evictCachedService(const wp<IBinder>& service) const
+{
+    std::lock_guard<std::mutex> lock(mCacheLock);
+    for (auto it = mServiceCache.begin(); it != mServiceCache.end();) {
+        if (it->second == service) {
+            it = mServiceCache.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
 sp<IBinder> ServiceManagerShim::getService(const String16& name) const
 {
     static bool gSystemBootCompleted = false;
@@ -246,16 +316,29 @@ sp<IBinder> ServiceManagerShim::getService(const String16& name) const
 
 sp<IBinder> ServiceManagerShim::checkService(const String16& name) const
 {
+    const bool useCache = gServiceLookupCacheEnabled.load(std::memory_order_relaxed);
     sp<IBinder> ret;
+    if (useCache) {
+        ret = getCachedService(name);
+        if (ret != nullptr) return ret;
+    }
+
     if (!mTheRealServiceManager->checkService(String8(name).c_str(), &ret).isOk()) {
         return nullptr;
     }
+    if (useCache && ret != nullptr) {
+        cacheService(name, ret);
+    }
     return ret;
 }
 
 status_t ServiceManagerShim::addService(const String16& name, const sp<IBinder>& service,
                                         bool allowIsolated, int dumpsysPriority)
 {
+    {
+        std::lock_guard<std::mutex> lock(mCacheLock);
+        mServiceCache.erase(name);
+    }
     Status status = mTheRealServiceManager->addService(
         String8(name).c_str(), service, allowIsolated, dumpsysPriority);
     return status.exceptionCode();
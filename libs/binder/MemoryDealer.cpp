@@ -38,6 +38,8 @@
 #include <sys/mman.h>
 #include <sys/file.h>
 
+#include <unordered_map>
+
 namespace android {
 // ----------------------------------------------------------------------------
 
@@ -120,6 +122,15 @@ private:
 
 // ----------------------------------------------------------------------------
 
+/*
+ * Chunks are kept in address order so that freed chunks can be merged with
+ * their neighbours. Free chunks are also linked into one list per power-of-two
+ * size class, so an allocation only looks at chunks that are about the right
+ * size: the best fit in the class of the requested size if there is one, or
+ * else the first chunk of the next non-empty class, which is large enough.
+ * Allocated chunks are indexed by offset for deallocate().
+ */
+
 class SimpleBestFitAllocator
 {
     enum {
@@ -141,24 +152,40 @@ private:
 
     struct chunk_t {
         chunk_t(size_t start, size_t size)
-        : start(start), size(size), free(1), prev(nullptr), next(nullptr) {
+        : start(start), size(size), free(1), prev(nullptr), next(nullptr),
+          freePrev(nullptr), freeNext(nullptr) {
         }
         size_t              start;
         size_t              size : 28;
         int                 free : 4;
         mutable chunk_t*    prev;
         mutable chunk_t*    next;
+        // links in the free list of the chunk's size class
+        chunk_t*            freePrev;
+        chunk_t*            freeNext;
     };
 
+    // one size class per bit of chunk_t::size
+    enum { kNumSizeClasses = 28 };
+
     ssize_t  alloc(size_t size, uint32_t flags);
     chunk_t* dealloc(size_t start);
+    chunk_t* findFree(size_t size, uint32_t flags) const;
+    void     insertFree(chunk_t* chunk);
+    void     removeFree(chunk_t* chunk);
     void     dump_l(const char* what) const;
     void     dump_l(String8& res, const char* what) const;
 
+    static int sizeClass(size_t size) { return 31 - __builtin_clz(uint32_t(size)); }
+
     static const int    kMemoryAlign;
     mutable Mutex       mLock;
     LinkedList<chunk_t> mList;
     size_t              mHeapSize;
+    chunk_t*            mFreeLists[kNumSizeClasses];
+    // bit n is set when mFreeLists[n] isn't empty
+    uint32_t            mFreeListMask;
+    std::unordered_map<size_t, chunk_t*> mAllocated;
 };
 
 // ----------------------------------------------------------------------------
@@ -278,12 +305,14 @@ size_t MemoryDealer::getAllocationAlignment()
 const int SimpleBestFitAllocator::kMemoryAlign = 32;
 
 SimpleBestFitAllocator::SimpleBestFitAllocator(size_t size)
+    : mFreeLists(), mFreeListMask(0)
 {
     size_t pagesize = getpagesize();
     mHeapSize = ((size + pagesize-1) & ~(pagesize-1));
 
     chunk_t* node = new chunk_t(0, mHeapSize / kMemoryAlign);
     mList.insertHead(node);
+    insertFree(node);
 }
 
 SimpleBestFitAllocator::~SimpleBestFitAllocator()
@@ -329,28 +358,14 @@ ssize_t SimpleBestFitAllocator::alloc(size_t size, uint32_t flags)
         return 0;
     }
     size = (size + kMemoryAlign-1) / kMemoryAlign;
-    chunk_t* free_chunk = nullptr;
-    chunk_t* cur = mList.head();
-
-    size_t pagesize = getpagesize();
-    while (cur) {
-        int extra = 0;
-        if (flags & PAGE_ALIGNED)
-            extra = ( -cur->start & ((pagesize/kMemoryAlign)-1) ) ;
-
-        // best fit
-        if (cur->free && (cur->size >= (size+extra))) {
-            if ((!free_chunk) || (cur->size < free_chunk->size)) {
-                free_chunk = cur;
-            }
-            if (cur->size == size) {
-                break;
-            }
-        }
-        cur = cur->next;
+    if (size >= (size_t(1) << kNumSizeClasses)) {
+        return NO_MEMORY;
     }
 
+    chunk_t* free_chunk = findFree(size, flags);
     if (free_chunk) {
+        removeFree(free_chunk);
+        size_t pagesize = getpagesize();
         const size_t free_size = free_chunk->size;
         free_chunk->free = 0;
         free_chunk->size = size;
@@ -362,6 +377,7 @@ ssize_t SimpleBestFitAllocator::alloc(size_t size, uint32_t flags)
                 chunk_t* split = new chunk_t(free_chunk->start, extra);
                 free_chunk->start += extra;
                 mList.insertBefore(free_chunk, split);
+                insertFree(split);
             }
 
             ALOGE_IF((flags&PAGE_ALIGNED) && 
@@ -373,54 +389,119 @@ ssize_t SimpleBestFitAllocator::alloc(size_t size, uint32_t flags)
                 chunk_t* split = new chunk_t(
                         free_chunk->start + free_chunk->size, tail_free);
                 mList.insertAfter(free_chunk, split);
+                insertFree(split);
             }
         }
+        mAllocated[free_chunk->start] = free_chunk;
         return (free_chunk->start)*kMemoryAlign;
     }
     return NO_MEMORY;
 }
 
-SimpleBestFitAllocator::chunk_t* SimpleBestFitAllocator::dealloc(size_t start)
+SimpleBestFitAllocator::chunk_t* SimpleBestFitAllocator::findFree(
+        size_t size, uint32_t flags) const
 {
-    start = start / kMemoryAlign;
-    chunk_t* cur = mList.head();
-    while (cur) {
-        if (cur->start == start) {
-            LOG_FATAL_IF(cur->free,
-                "block at offset 0x%08lX of size 0x%08lX already freed",
-                cur->start*kMemoryAlign, cur->size*kMemoryAlign);
-
-            // merge freed blocks together
-            chunk_t* freed = cur;
-            cur->free = 1;
-            do {
-                chunk_t* const p = cur->prev;
-                chunk_t* const n = cur->next;
-                if (p && (p->free || !cur->size)) {
-                    freed = p;
-                    p->size += cur->size;
-                    mList.remove(cur);
-                    delete cur;
-                }
-                cur = n;
-            } while (cur && cur->free);
-
-            #ifndef NDEBUG
-                if (!freed->free) {
-                    dump_l("dealloc (!freed->free)");
-                }
-            #endif
-            LOG_FATAL_IF(!freed->free,
-                "freed block at offset 0x%08lX of size 0x%08lX is not free!",
-                freed->start * kMemoryAlign, freed->size * kMemoryAlign);
-
-            return freed;
+    size_t pagesize = getpagesize();
+    auto fits = [&](chunk_t const* cur) {
+        int extra = 0;
+        if (flags & PAGE_ALIGNED)
+            extra = ( -cur->start & ((pagesize/kMemoryAlign)-1) ) ;
+        return cur->size >= (size+extra);
+    };
+
+    // chunks of the same class may be smaller than what is asked for: take
+    // the best fit among them
+    const int first = sizeClass(size);
+    chunk_t* free_chunk = nullptr;
+    for (chunk_t* cur = mFreeLists[first]; cur; cur = cur->freeNext) {
+        if (fits(cur) && ((!free_chunk) || (cur->size < free_chunk->size))) {
+            free_chunk = cur;
+            if (cur->size == size) {
+                break;
+            }
         }
-        cur = cur->next;
+    }
+    if (free_chunk) {
+        return free_chunk;
+    }
+
+    // chunks of the larger classes are all large enough, unless they can't
+    // be page aligned
+    uint32_t mask = mFreeListMask & ~((2u << first) - 1);
+    while (mask) {
+        for (chunk_t* cur = mFreeLists[__builtin_ctz(mask)]; cur; cur = cur->freeNext) {
+            if (fits(cur)) {
+                return cur;
+            }
+        }
+        mask &= mask - 1;
     }
     return nullptr;
 }
 
+void SimpleBestFitAllocator::insertFree(chunk_t* chunk)
+{
+    const int c = sizeClass(chunk->size);
+    chunk->freePrev = nullptr;
+    chunk->freeNext = mFreeLists[c];
+    if (chunk->freeNext) {
+        chunk->freeNext->freePrev = chunk;
+    }
+    mFreeLists[c] = chunk;
+    mFreeListMask |= 1u << c;
+}
+
+void SimpleBestFitAllocator::removeFree(chunk_t* chunk)
+{
+    const int c = sizeClass(chunk->size);
+    if (chunk->freePrev) {
+        chunk->freePrev->freeNext = chunk->freeNext;
+    } else {
+        mFreeLists[c] = chunk->freeNext;
+        if (!mFreeLists[c]) {
+            mFreeListMask &= ~(1u << c);
+        }
+    }
+    if (chunk->freeNext) {
+        chunk->freeNext->freePrev = chunk->freePrev;
+    }
+    chunk->freePrev = chunk->freeNext = nullptr;
+}
+
+SimpleBestFitAllocator::chunk_t* SimpleBestFitAllocator::dealloc(size_t start)
+{
+    start = start / kMemoryAlign;
+    auto it = mAllocated.find(start);
+    if (it == mAllocated.end()) {
+        return nullptr;
+    }
+    chunk_t* freed = it->second;
+    mAllocated.erase(it);
+    LOG_FATAL_IF(freed->free,
+        "block at offset 0x%08lX of size 0x%08lX already freed",
+        freed->start*kMemoryAlign, freed->size*kMemoryAlign);
+
+    // merge freed blocks together
+    freed->free = 1;
+    chunk_t* const n = freed->next;
+    if (n && n->free) {
+        removeFree(n);
+        freed->size += n->size;
+        mList.remove(n);
+        delete n;
+    }
+    chunk_t* const p = freed->prev;
+    if (p && p->free) {
+        removeFree(p);
+        p->size += freed->size;
+        mList.remove(freed);
+        delete freed;
+        freed = p;
+    }
+    insertFree(freed);
+    return freed;
+}
+
 void SimpleBestFitAllocator::dump(const char* what) const
 {
     Mutex::Autolock _l(mLock);
@@ -445,6 +526,9 @@ void SimpleBestFitAllocator::dump_l(String8& result,
         const char* what) const
 {
     size_t size = 0;
+    size_t freeSize = 0;
+    size_t largestFree = 0;
+    size_t freeChunks = 0;
     int32_t i = 0;
     chunk_t const* cur = mList.head();
     
@@ -469,8 +553,14 @@ void SimpleBestFitAllocator::dump_l(String8& result,
         
         result.append(buffer);
 
-        if (!cur->free)
+        if (!cur->free) {
             size += cur->size*kMemoryAlign;
+        } else {
+            freeSize += cur->size*kMemoryAlign;
+            if (cur->size*kMemoryAlign > largestFree)
+                largestFree = cur->size*kMemoryAlign;
+            freeChunks++;
+        }
 
         i++;
         cur = cur->next;
@@ -478,6 +568,16 @@ void SimpleBestFitAllocator::dump_l(String8& result,
     snprintf(buffer, SIZE,
             "  size allocated: %u (%u KB)\n", int(size), int(size/1024));
     result.append(buffer);
+
+    // the share of the free memory that can't be handed out in one allocation
+    const unsigned int fragmentation = freeSize ?
+            (unsigned int)(100 - largestFree * 100 / freeSize) : 0;
+    snprintf(buffer, SIZE,
+            "  size free: %u (%u KB) in %u chunks, largest %u (%u KB), "
+            "fragmentation %u%%\n",
+            int(freeSize), int(freeSize/1024), (unsigned int)freeChunks,
+            int(largestFree), int(largestFree/1024), fragmentation);
+    result.append(buffer);
 }
 
 
@@ -22,6 +22,7 @@
 #include <inttypes.h>
 #include <linux/sched.h>
 #include <pthread.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -70,6 +71,11 @@ static size_t pad_size(size_t s) {
     return PAD_SIZE_UNSAFE(s);
 }
 
+// Parcels whose next capacity would be at least this big grow by doubling to
+// a page boundary instead of by 1.5x.
+static constexpr size_t kLargeParcelGrowThreshold = 64 * 1024;
+static constexpr size_t kPageSize = 4096;
+
 // Note: must be kept in sync with android/os/StrictMode.java's PENALTY_GATHER
 #define STRICT_MODE_PENALTY_GATHER (1 << 31)
 
@@ -81,6 +87,98 @@ static_assert(sizeof(Parcel) == 60 || sizeof(Parcel) == 120);
 static pthread_mutex_t gParcelGlobalAllocSizeLock = PTHREAD_MUTEX_INITIALIZER;
 static size_t gParcelGlobalAllocSize = 0;
 static size_t gParcelGlobalAllocCount = 0;
+static size_t gParcelGlobalPooledSize = 0;
+static size_t gParcelGlobalPooledCount = 0;
+
+// Per-thread cache of recently freed Parcel data buffers. Transactions
+// build and drop Parcels of similar size over and over on the same binder
+// thread, so handing those buffers straight back out avoids a malloc/free
+// pair per Parcel in steady state. Large buffers still go back to malloc.
+class ParcelBufferPool {
+public:
+    static constexpr size_t kMaxBuffers = 4;
+    static constexpr size_t kMaxBufferSize = 16 * 1024;
+
+    ~ParcelBufferPool() {
+        for (size_t i = 0; i < mCount; i++) {
+            free(mBuffers[i].data);
+        }
+        pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
+        gParcelGlobalPooledSize -= std::min(gParcelGlobalPooledSize, mSize);
+        gParcelGlobalPooledCount -= std::min(gParcelGlobalPooledCount, mCount);
+        pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
+        mCount = mSize = 0;
+        // Parcels with static storage may still be freed on this thread.
+        mClosed = true;
+    }
+
+    // Returns a pooled buffer of at least |desired| bytes and its real
+    // capacity, or nullptr if none fits.
+    uint8_t* take(size_t desired, size_t* outCapacity) {
+        for (size_t i = mCount; i > 0; i--) {
+            Buffer& buffer = mBuffers[i - 1];
+            if (buffer.capacity >= desired) {
+                uint8_t* data = buffer.data;
+                *outCapacity = buffer.capacity;
+                mSize -= buffer.capacity;
+                buffer = mBuffers[--mCount];
+                return data;
+            }
+        }
+        return nullptr;
+    }
+
+    // Takes ownership of |data| if there is room for it.
+    bool give(uint8_t* data, size_t capacity) {
+        if (mClosed || capacity == 0 || capacity > kMaxBufferSize || mCount == kMaxBuffers) {
+            return false;
+        }
+        mBuffers[mCount++] = { data, capacity };
+        mSize += capacity;
+        return true;
+    }
+
+private:
+    struct Buffer {
+        uint8_t* data;
+        size_t capacity;
+    };
+    Buffer mBuffers[kMaxBuffers];
+    size_t mCount = 0;
+    size_t mSize = 0;
+    bool mClosed = false;
+};
+
+static thread_local ParcelBufferPool gParcelBufferPool;
+
+// Allocates a data buffer of at least |desired| bytes, preferring this
+// thread's pool. The real capacity is returned through |outCapacity|.
+static uint8_t* allocParcelData(size_t desired, size_t* outCapacity)
+{
+    uint8_t* data = gParcelBufferPool.take(desired, outCapacity);
+    if (data) {
+        pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
+        gParcelGlobalPooledSize -= *outCapacity;
+        gParcelGlobalPooledCount--;
+        pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
+        return data;
+    }
+    *outCapacity = desired;
+    return (uint8_t*)malloc(desired);
+}
+
+// Releases a data buffer, keeping it in this thread's pool when possible.
+static void freeParcelData(uint8_t* data, size_t capacity)
+{
+    if (gParcelBufferPool.give(data, capacity)) {
+        pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
+        gParcelGlobalPooledSize += capacity;
+        gParcelGlobalPooledCount++;
+        pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
+        return;
+    }
+    free(data);
+}
 
 static size_t gMaxFds = 0;
 
@@ -289,6 +387,20 @@ size_t Parcel::getGlobalAllocCount() {
     return count;
 }
 
+size_t Parcel::getGlobalPooledSize() {
+    pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
+    size_t size = gParcelGlobalPooledSize;
+    pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
+    return size;
+}
+
+size_t Parcel::getGlobalPooledCount() {
+    pthread_mutex_lock(&gParcelGlobalAllocSizeLock);
+    size_t count = gParcelGlobalPooledCount;
+    pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
+    return count;
+}
+
 const uint8_t* Parcel::data() const
 {
     return mData;
@@ -579,11 +691,45 @@ bool Parcel::enforceInterface(const char16_t* interface,
                               size_t len,
                               IPCThreadState* threadState) const
 {
-    // StrictModePolicy.
-    int32_t strictPolicy = readInt32();
     if (threadState == nullptr) {
         threadState = IPCThreadState::self();
     }
+
+    // Fast path for the common case of a parcel without objects: the whole
+    // token is bounds checked once and compared in place, instead of going
+    // through five separately validated reads. Anything unexpected falls
+    // back to the full path below so that it reports the error.
+    struct InterfaceTokenHeader {
+        int32_t strictPolicy;
+        int32_t workSource;
+        int32_t header;
+        int32_t length;
+    };
+    const size_t start = mDataPos;
+    if (mObjectsSize == 0 && len < INT32_MAX / sizeof(char16_t) && start <= mDataSize) {
+        const size_t tokenSize =
+                sizeof(InterfaceTokenHeader) + pad_size((len + 1) * sizeof(char16_t));
+        if (tokenSize <= mDataSize - start) {
+            const InterfaceTokenHeader* token =
+                    reinterpret_cast<const InterfaceTokenHeader*>(mData + start);
+            const char16_t* parcel_interface = reinterpret_cast<const char16_t*>(token + 1);
+            if (token->header == kHeader && token->length == static_cast<int32_t>(len) &&
+                    parcel_interface[len] == u'\0' &&
+                    (!len || !memcmp(parcel_interface, interface, len * sizeof(char16_t)))) {
+                threadState->setStrictModePolicy(
+                        (threadState->getLastTransactionBinderFlags() & IBinder::FLAG_ONEWAY)
+                                ? 0 : token->strictPolicy);
+                mDataPos = start + offsetof(InterfaceTokenHeader, workSource);
+                updateWorkSourceRequestHeaderPosition();
+                threadState->setCallingWorkSourceUidWithoutPropagation(token->workSource);
+                mDataPos = start + tokenSize;
+                return true;
+            }
+        }
+    }
+
+    // StrictModePolicy.
+    int32_t strictPolicy = readInt32();
     if ((threadState->getLastTransactionBinderFlags() &
          IBinder::FLAG_ONEWAY) != 0) {
       // For one-way calls, the callee is running entirely
@@ -775,7 +921,12 @@ status_t Parcel::writeByteVectorInternal(const int8_t* data, size_t size) {
         return BAD_VALUE;
     }
 
-    status_t status = writeInt32(size);
+    status_t status = reserveWrite(sizeof(int32_t) + pad_size(size));
+    if (status != OK) {
+        return status;
+    }
+
+    status = writeInt32(size);
     if (status != OK) {
         return status;
     }
@@ -1497,6 +1648,19 @@ status_t Parcel::readByteVector(std::vector<uint8_t>* val) const {
     return readByteVectorInternal(val, size);
 }
 
+const uint8_t* Parcel::readByteVectorInplace(size_t* outLen) const {
+    int32_t size = readInt32();
+    if (size >= 0) {
+        const uint8_t* data = static_cast<const uint8_t*>(readInplace(size));
+        if (data != nullptr) {
+            *outLen = size;
+            return data;
+        }
+    }
+    *outLen = 0;
+    return nullptr;
+}
+
 status_t Parcel::readByteVector(std::unique_ptr<std::vector<int8_t>>* val) const {
     size_t size;
     if (status_t status = reserveOutVector(val, &size); status != OK) return status;
@@ -1892,6 +2056,18 @@ const char* Parcel::readString8Inplace(size_t* outLen) const
     return nullptr;
 }
 
+status_t Parcel::readString8View(std::string_view* val) const
+{
+    size_t len;
+    const char* str = readString8Inplace(&len);
+    if (str) {
+        *val = std::string_view(str, len);
+        return OK;
+    }
+    *val = std::string_view();
+    return UNEXPECTED_NULL;
+}
+
 String16 Parcel::readString16() const
 {
     size_t len;
@@ -1955,6 +2131,18 @@ const char16_t* Parcel::readString16Inplace(size_t* outLen) const
     return nullptr;
 }
 
+status_t Parcel::readString16View(std::u16string_view* val) const
+{
+    size_t len;
+    const char16_t* str = readString16Inplace(&len);
+    if (str) {
+        *val = std::u16string_view(str, len);
+        return OK;
+    }
+    *val = std::u16string_view();
+    return UNEXPECTED_NULL;
+}
+
 status_t Parcel::readStrongBinder(sp<IBinder>* val) const
 {
     status_t status = readNullableStrongBinder(val);
@@ -2435,7 +2623,7 @@ void Parcel::freeDataNoInit()
               gParcelGlobalAllocCount--;
             }
             pthread_mutex_unlock(&gParcelGlobalAllocSizeLock);
-            free(mData);
+            freeParcelData(mData, mDataCapacity);
         }
         if (mObjects) free(mObjects);
     }
@@ -2452,11 +2640,37 @@ status_t Parcel::growData(size_t len)
     if (len > SIZE_MAX - mDataSize) return NO_MEMORY; // overflow
     if (mDataSize + len > SIZE_MAX / 3) return NO_MEMORY; // overflow
     size_t newSize = ((mDataSize+len)*3)/2;
+    if (newSize >= kLargeParcelGrowThreshold) {
+        // Large parcels (bitmaps, long parcelable lists) double and stay
+        // page aligned, so they go through far fewer realloc-and-copy
+        // rounds on their way to the final size.
+        if (mDataSize + len > SIZE_MAX / 2 - kPageSize) return NO_MEMORY; // overflow
+        newSize = ((mDataSize + len) * 2 + kPageSize - 1) & ~(kPageSize - 1);
+        if (newSize > INT32_MAX) newSize = INT32_MAX;
+    }
     return (newSize <= mDataSize)
             ? (status_t) NO_MEMORY
             : continueWrite(newSize);
 }
 
+status_t Parcel::reserveWrite(size_t len)
+{
+    if (len > INT32_MAX) {
+        // don't accept size_t values which may have come from an
+        // inadvertent conversion from a negative int.
+        return BAD_VALUE;
+    }
+
+    if (len > SIZE_MAX - mDataPos) return NO_MEMORY; // overflow
+    const size_t desired = mDataPos + len;
+    if (desired <= mDataCapacity) return NO_ERROR;
+    if (desired > INT32_MAX) return BAD_VALUE;
+
+    // The caller knows exactly how much is about to be written; grow once
+    // to that size rather than repeatedly through growData().
+    return continueWrite(desired);
+}
+
 status_t Parcel::restartWrite(size_t desired)
 {
     if (desired > INT32_MAX) {
@@ -2470,7 +2684,12 @@ status_t Parcel::restartWrite(size_t desired)
         return continueWrite(desired);
     }
 
-    uint8_t* data = (uint8_t*)realloc(mData, desired);
+    uint8_t* data;
+    if (mData == nullptr && desired > 0) {
+        data = allocParcelData(desired, &desired);
+    } else {
+        data = (uint8_t*)realloc(mData, desired);
+    }
     if (!data && desired > mDataCapacity) {
         mError = NO_MEMORY;
         return NO_MEMORY;
@@ -2648,7 +2867,7 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
+        uint8_t* data = allocParcelData(desired, &desired);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
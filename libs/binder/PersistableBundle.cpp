@@ -19,6 +19,7 @@
 #include <binder/PersistableBundle.h>
 
 #include <limits>
+#include <mutex>
 
 #include <binder/IBinder.h>
 #include <binder/Parcel.h>
@@ -30,6 +31,7 @@
 using android::BAD_TYPE;
 using android::BAD_VALUE;
 using android::NO_ERROR;
+using android::NOT_ENOUGH_DATA;
 using android::Parcel;
 using android::sp;
 using android::status_t;
@@ -87,6 +89,143 @@ namespace os {
          }                                                               \
     }
 
+struct PersistableBundle::ParcelledData {
+    Parcel parcel;
+    // Decoding a value moves the position of the parcel.
+    std::mutex mutex;
+};
+
+namespace {
+status_t readValue(const Parcel& parcel, bool* out) {
+    return parcel.readBool(out);
+}
+
+status_t readValue(const Parcel& parcel, int32_t* out) {
+    return parcel.readInt32(out);
+}
+
+status_t readValue(const Parcel& parcel, int64_t* out) {
+    return parcel.readInt64(out);
+}
+
+status_t readValue(const Parcel& parcel, double* out) {
+    return parcel.readDouble(out);
+}
+
+status_t readValue(const Parcel& parcel, String16* out) {
+    return parcel.readString16(out);
+}
+
+status_t readValue(const Parcel& parcel, vector<bool>* out) {
+    return parcel.readBoolVector(out);
+}
+
+status_t readValue(const Parcel& parcel, vector<int32_t>* out) {
+    return parcel.readInt32Vector(out);
+}
+
+status_t readValue(const Parcel& parcel, vector<int64_t>* out) {
+    return parcel.readInt64Vector(out);
+}
+
+status_t readValue(const Parcel& parcel, vector<double>* out) {
+    return parcel.readDoubleVector(out);
+}
+
+status_t readValue(const Parcel& parcel, vector<String16>* out) {
+    return parcel.readString16Vector(out);
+}
+
+status_t readValue(const Parcel& parcel, PersistableBundle* out) {
+    return out->readFromParcel(&parcel);
+}
+
+status_t skipBytes(const Parcel& parcel, size_t size) {
+    if (size > parcel.dataAvail()) return NOT_ENOUGH_DATA;
+    parcel.setDataPosition(parcel.dataPosition() + size);
+    return NO_ERROR;
+}
+
+status_t skipString16(const Parcel& parcel) {
+    size_t length;
+    return parcel.readString16Inplace(&length) ? NO_ERROR : BAD_VALUE;
+}
+
+status_t skipArray(const Parcel& parcel, size_t elementSize) {
+    int32_t size;
+    RETURN_IF_FAILED(parcel.readInt32(&size));
+    if (size < 0) return UNEXPECTED_NULL;
+    if (static_cast<size_t>(size) > parcel.dataAvail() / elementSize) return NOT_ENOUGH_DATA;
+    return skipBytes(parcel, size * elementSize);
+}
+
+status_t skipBundle(const Parcel& parcel);
+
+/*
+ * Moves past the value of |type| at the position of |parcel|, failing if
+ * reading it would fail.
+ */
+status_t skipValue(const Parcel& parcel, int32_t type) {
+    switch (type) {
+        case VAL_STRING:
+            return skipString16(parcel);
+        case VAL_INTEGER:
+        case VAL_BOOLEAN:
+            return skipBytes(parcel, sizeof(int32_t));
+        case VAL_LONG:
+            return skipBytes(parcel, sizeof(int64_t));
+        case VAL_DOUBLE:
+            return skipBytes(parcel, sizeof(double));
+        case VAL_STRINGARRAY: {
+            int32_t size;
+            RETURN_IF_FAILED(parcel.readInt32(&size));
+            if (size < 0) return UNEXPECTED_NULL;
+            for (; size > 0; --size) {
+                RETURN_IF_FAILED(skipString16(parcel));
+            }
+            return NO_ERROR;
+        }
+        case VAL_INTARRAY:
+        case VAL_BOOLEANARRAY:
+            return skipArray(parcel, sizeof(int32_t));
+        case VAL_LONGARRAY:
+            return skipArray(parcel, sizeof(int64_t));
+        case VAL_DOUBLEARRAY:
+            return skipArray(parcel, sizeof(double));
+        case VAL_PERSISTABLEBUNDLE:
+            return skipBundle(parcel);
+        default:
+            ALOGE("Unrecognized type: %d", type);
+            return BAD_TYPE;
+    }
+}
+
+status_t skipBundle(const Parcel& parcel) {
+    int32_t length;
+    RETURN_IF_FAILED(parcel.readInt32(&length));
+    if (length < 0) return UNEXPECTED_NULL;
+    if (length == 0) return NO_ERROR;
+
+    int32_t magic;
+    RETURN_IF_FAILED(parcel.readInt32(&magic));
+    if (magic != BUNDLE_MAGIC && magic != BUNDLE_MAGIC_NATIVE) return BAD_VALUE;
+    const size_t start = parcel.dataPosition();
+    if (static_cast<size_t>(length) > parcel.dataAvail()) return BAD_VALUE;
+
+    int32_t num_entries;
+    RETURN_IF_FAILED(parcel.readInt32(&num_entries));
+    for (; num_entries > 0; --num_entries) {
+        int32_t value_type;
+        RETURN_IF_FAILED(skipString16(parcel));
+        RETURN_IF_FAILED(parcel.readInt32(&value_type));
+        RETURN_IF_FAILED(skipValue(parcel, value_type));
+    }
+    // Reading the bundle moves past its length, not past its last entry.
+    parcel.setDataPosition(start + length);
+    return NO_ERROR;
+}
+}  // namespace
+
 status_t PersistableBundle::writeToParcel(Parcel* parcel) const {
     /*
      * Keep implementation in sync with writeToParcelInner() in
@@ -138,7 +277,8 @@ bool PersistableBundle::empty() const {
 }
 
 size_t PersistableBundle::size() const {
-    return (mBoolMap.size() +
+    return (mParcelledValues.size() +
+            mBoolMap.size() +
             mIntMap.size() +
             mLongMap.size() +
             mDoubleMap.size() +
@@ -162,6 +302,7 @@ size_t PersistableBundle::erase(const String16& key) {
     RETURN_IF_ENTRY_ERASED(mLongVectorMap, key);
     RETURN_IF_ENTRY_ERASED(mDoubleVectorMap, key);
     RETURN_IF_ENTRY_ERASED(mStringVectorMap, key);
+    RETURN_IF_ENTRY_ERASED(mParcelledValues, key);
     return mPersistableBundleMap.erase(key);
 }
 
@@ -221,91 +362,91 @@ void PersistableBundle::putPersistableBundle(const String16& key, const Persista
 }
 
 bool PersistableBundle::getBoolean(const String16& key, bool* out) const {
-    return getValue(key, out, mBoolMap);
+    return getValue(key, out, mBoolMap) || getParcelledValue(key, VAL_BOOLEAN, out);
 }
 
 bool PersistableBundle::getInt(const String16& key, int32_t* out) const {
-    return getValue(key, out, mIntMap);
+    return getValue(key, out, mIntMap) || getParcelledValue(key, VAL_INTEGER, out);
 }
 
 bool PersistableBundle::getLong(const String16& key, int64_t* out) const {
-    return getValue(key, out, mLongMap);
+    return getValue(key, out, mLongMap) || getParcelledValue(key, VAL_LONG, out);
 }
 
 bool PersistableBundle::getDouble(const String16& key, double* out) const {
-    return getValue(key, out, mDoubleMap);
+    return getValue(key, out, mDoubleMap) || getParcelledValue(key, VAL_DOUBLE, out);
 }
 
 bool PersistableBundle::getString(const String16& key, String16* out) const {
-    return getValue(key, out, mStringMap);
+    return getValue(key, out, mStringMap) || getParcelledValue(key, VAL_STRING, out);
 }
 
 bool PersistableBundle::getBooleanVector(const String16& key, vector<bool>* out) const {
-    return getValue(key, out, mBoolVectorMap);
+    return getValue(key, out, mBoolVectorMap) || getParcelledValue(key, VAL_BOOLEANARRAY, out);
 }
 
 bool PersistableBundle::getIntVector(const String16& key, vector<int32_t>* out) const {
-    return getValue(key, out, mIntVectorMap);
+    return getValue(key, out, mIntVectorMap) || getParcelledValue(key, VAL_INTARRAY, out);
 }
 
 bool PersistableBundle::getLongVector(const String16& key, vector<int64_t>* out) const {
-    return getValue(key, out, mLongVectorMap);
+    return getValue(key, out, mLongVectorMap) || getParcelledValue(key, VAL_LONGARRAY, out);
 }
 
 bool PersistableBundle::getDoubleVector(const String16& key, vector<double>* out) const {
-    return getValue(key, out, mDoubleVectorMap);
+    return getValue(key, out, mDoubleVectorMap) || getParcelledValue(key, VAL_DOUBLEARRAY, out);
 }
 
 bool PersistableBundle::getStringVector(const String16& key, vector<String16>* out) const {
-    return getValue(key, out, mStringVectorMap);
+    return getValue(key, out, mStringVectorMap) || getParcelledValue(key, VAL_STRINGARRAY, out);
 }
 
 bool PersistableBundle::getPersistableBundle(const String16& key, PersistableBundle* out) const {
-    return getValue(key, out, mPersistableBundleMap);
+    return getValue(key, out, mPersistableBundleMap) || getParcelledValue(key, VAL_PERSISTABLEBUNDLE, out);
 }
 
 set<String16> PersistableBundle::getBooleanKeys() const {
-    return getKeys(mBoolMap);
+    return addParcelledKeys(VAL_BOOLEAN, getKeys(mBoolMap));
 }
 
 set<String16> PersistableBundle::getIntKeys() const {
-    return getKeys(mIntMap);
+    return addParcelledKeys(VAL_INTEGER, getKeys(mIntMap));
 }
 
 set<String16> PersistableBundle::getLongKeys() const {
-    return getKeys(mLongMap);
+    return addParcelledKeys(VAL_LONG, getKeys(mLongMap));
 }
 
 set<String16> PersistableBundle::getDoubleKeys() const {
-    return getKeys(mDoubleMap);
+    return addParcelledKeys(VAL_DOUBLE, getKeys(mDoubleMap));
 }
 
 set<String16> PersistableBundle::getStringKeys() const {
-    return getKeys(mStringMap);
+    return addParcelledKeys(VAL_STRING, getKeys(mStringMap));
 }
 
 set<String16> PersistableBundle::getBooleanVectorKeys() const {
-    return getKeys(mBoolVectorMap);
+    return addParcelledKeys(VAL_BOOLEANARRAY, getKeys(mBoolVectorMap));
 }
 
 set<String16> PersistableBundle::getIntVectorKeys() const {
-    return getKeys(mIntVectorMap);
+    return addParcelledKeys(VAL_INTARRAY, getKeys(mIntVectorMap));
 }
 
 set<String16> PersistableBundle::getLongVectorKeys() const {
-    return getKeys(mLongVectorMap);
+    return addParcelledKeys(VAL_LONGARRAY, getKeys(mLongVectorMap));
 }
 
 set<String16> PersistableBundle::getDoubleVectorKeys() const {
-    return getKeys(mDoubleVectorMap);
+    return addParcelledKeys(VAL_DOUBLEARRAY, getKeys(mDoubleVectorMap));
 }
 
 set<String16> PersistableBundle::getStringVectorKeys() const {
-    return getKeys(mStringVectorMap);
+    return addParcelledKeys(VAL_STRINGARRAY, getKeys(mStringVectorMap));
 }
 
 set<String16> PersistableBundle::getPersistableBundleKeys() const {
-    return getKeys(mPersistableBundleMap);
+    return addParcelledKeys(VAL_PERSISTABLEBUNDLE, getKeys(mPersistableBundleMap));
 }
 
 status_t PersistableBundle::writeToParcelInner(Parcel* parcel) const {
@@ -378,14 +519,20 @@ status_t PersistableBundle::writeToParcelInner(Parcel* parcel) const {
         RETURN_IF_FAILED(parcel->writeInt32(VAL_PERSISTABLEBUNDLE));
         RETURN_IF_FAILED(key_val_pair.second.writeToParcel(parcel));
     }
+    // The values that were not decoded are copied as they were read.
+    for (const auto& key_val_pair : mParcelledValues) {
+        const ParcelledValue& value = key_val_pair.second;
+        RETURN_IF_FAILED(parcel->appendFrom(&mParcelledData->parcel, value.begin,
+                                            value.end - value.begin));
+    }
     return NO_ERROR;
 }
 
 status_t PersistableBundle::readFromParcelInner(const Parcel* parcel, size_t length) {
     /*
-     * Note: we don't actually use length for anything other than an empty PersistableBundle
-     * check, since we do not actually need to copy in an entire Parcel, unlike in the Java
-     * implementation.
+     * Like in the Java implementation, length is the size of the parcelled
+     * data after the magic number, which is kept as it is until the values are
+     * asked for.
      */
     if (length == 0) {
         // Empty PersistableBundle or end of data.
@@ -398,6 +545,30 @@ status_t PersistableBundle::readFromParcelInner(const Parcel* parcel, size_t len
         ALOGE("Bad magic number for PersistableBundle: 0x%08x", magic);
         return BAD_VALUE;
     }
+    if (length > parcel->dataAvail()) {
+        ALOGE("Bad length in parcel: %zu with %zu bytes left", length, parcel->dataAvail());
+        return BAD_VALUE;
+    }
+
+    // The values parcelled before would no longer be found.
+    unparcel();
+
+    const size_t start = parcel->dataPosition();
+    mParcelledData = std::make_shared<ParcelledData>();
+    RETURN_IF_FAILED(mParcelledData->parcel.appendFrom(parcel, start, length));
+    mParcelledData->parcel.setDataPosition(0);
+    parcel->setDataPosition(start + length);
+
+    status_t status = indexParcelledData();
+    if (status != NO_ERROR) {
+        mParcelledValues.clear();
+        mParcelledData.reset();
+    }
+    return status;
+}
+
+status_t PersistableBundle::indexParcelledData() {
+    const Parcel& parcel = mParcelledData->parcel;
 
     /*
      * To keep this implementation in sync with unparcel() in
@@ -406,72 +577,123 @@ status_t PersistableBundle::readFromParcelInner(const Parcel* parcel, size_t len
      * pairs themselves.
      */
     int32_t num_entries;
-    RETURN_IF_FAILED(parcel->readInt32(&num_entries));
+    RETURN_IF_FAILED(parcel.readInt32(&num_entries));
 
     for (; num_entries > 0; --num_entries) {
+        ParcelledValue value;
         String16 key;
-        int32_t value_type;
-        RETURN_IF_FAILED(parcel->readString16(&key));
-        RETURN_IF_FAILED(parcel->readInt32(&value_type));
+        value.begin = parcel.dataPosition();
+        RETURN_IF_FAILED(parcel.readString16(&key));
+        RETURN_IF_FAILED(parcel.readInt32(&value.type));
+        value.value = parcel.dataPosition();
+        RETURN_IF_FAILED(skipValue(parcel, value.type));
+        value.end = parcel.dataPosition();
 
         /*
          * We assume that both the C++ and Java APIs ensure that all keys in a PersistableBundle
          * are unique.
          */
-        switch (value_type) {
-            case VAL_STRING: {
-                RETURN_IF_FAILED(parcel->readString16(&mStringMap[key]));
+        mParcelledValues[key] = value;
+    }
+
+    return NO_ERROR;
+}
+
+template <typename T>
+bool PersistableBundle::getParcelledValue(const String16& key, int32_t type, T* out) const {
+    const auto it = mParcelledValues.find(key);
+    if (it == mParcelledValues.end() || it->second.type != type) return false;
+
+    T value;
+    {
+        std::lock_guard<std::mutex> lock(mParcelledData->mutex);
+        mParcelledData->parcel.setDataPosition(it->second.value);
+        if (readValue(mParcelledData->parcel, &value) != NO_ERROR) {
+            ALOGE("Failed to read the value of type %d at %zu", type, it->second.value);
+            return false;
+        }
+    }
+    *out = std::move(value);
+    return true;
+}
+
+set<String16> PersistableBundle::addParcelledKeys(int32_t type, set<String16> keys) const {
+    for (const auto& key_value_pair : mParcelledValues) {
+        if (key_value_pair.second.type == type) {
+            keys.emplace(key_value_pair.first);
+        }
+    }
+    return keys;
+}
+
+void PersistableBundle::unparcel() {
+    if (mParcelledValues.empty()) return;
+
+    std::lock_guard<std::mutex> lock(mParcelledData->mutex);
+    const Parcel& parcel = mParcelledData->parcel;
+    for (const auto& [key, value] : mParcelledValues) {
+        parcel.setDataPosition(value.value);
+        status_t status;
+        switch (value.type) {
+            case VAL_STRING:
+                status = readValue(parcel, &mStringMap[key]);
                 break;
-            }
-            case VAL_INTEGER: {
-                RETURN_IF_FAILED(parcel->readInt32(&mIntMap[key]));
+            case VAL_INTEGER:
+                status = readValue(parcel, &mIntMap[key]);
                 break;
-            }
-            case VAL_LONG: {
-                RETURN_IF_FAILED(parcel->readInt64(&mLongMap[key]));
+            case VAL_LONG:
+                status = readValue(parcel, &mLongMap[key]);
                 break;
-            }
-            case VAL_DOUBLE: {
-                RETURN_IF_FAILED(parcel->readDouble(&mDoubleMap[key]));
+            case VAL_DOUBLE:
+                status = readValue(parcel, &mDoubleMap[key]);
                 break;
-            }
-            case VAL_BOOLEAN: {
-                RETURN_IF_FAILED(parcel->readBool(&mBoolMap[key]));
+            case VAL_BOOLEAN:
+                status = readValue(parcel, &mBoolMap[key]);
                 break;
-            }
-            case VAL_STRINGARRAY: {
-                RETURN_IF_FAILED(parcel->readString16Vector(&mStringVectorMap[key]));
+            case VAL_STRINGARRAY:
+                status = readValue(parcel, &mStringVectorMap[key]);
                 break;
-            }
-            case VAL_INTARRAY: {
-                RETURN_IF_FAILED(parcel->readInt32Vector(&mIntVectorMap[key]));
+            case VAL_INTARRAY:
+                status = readValue(parcel, &mIntVectorMap[key]);
                 break;
-            }
-            case VAL_LONGARRAY: {
-                RETURN_IF_FAILED(parcel->readInt64Vector(&mLongVectorMap[key]));
+            case VAL_LONGARRAY:
+                status = readValue(parcel, &mLongVectorMap[key]);
                 break;
-            }
-            case VAL_BOOLEANARRAY: {
-                RETURN_IF_FAILED(parcel->readBoolVector(&mBoolVectorMap[key]));
+            case VAL_BOOLEANARRAY:
+                status = readValue(parcel, &mBoolVectorMap[key]);
                 break;
-            }
-            case VAL_PERSISTABLEBUNDLE: {
-                RETURN_IF_FAILED(mPersistableBundleMap[key].readFromParcel(parcel));
+            case VAL_PERSISTABLEBUNDLE:
+                status = readValue(parcel, &mPersistableBundleMap[key]);
                 break;
-            }
-            case VAL_DOUBLEARRAY: {
-                RETURN_IF_FAILED(parcel->readDoubleVector(&mDoubleVectorMap[key]));
+            case VAL_DOUBLEARRAY:
+                status = readValue(parcel, &mDoubleVectorMap[key]);
                 break;
-            }
-            default: {
-                ALOGE("Unrecognized type: %d", value_type);
-                return BAD_TYPE;
+            default:
+                status = BAD_TYPE;
                 break;
-            }
         }
+        ALOGE_IF(status != NO_ERROR, "Failed to read the value of type %d at %zu", value.type,
+                 value.value);
     }
+    mParcelledValues.clear();
+    mParcelledData.reset();
+}
 
-    return NO_ERROR;
+bool operator==(const PersistableBundle& lhs, const PersistableBundle& rhs) {
+    if (!lhs.mParcelledValues.empty() || !rhs.mParcelledValues.empty()) {
+        PersistableBundle lhsValues(lhs);
+        PersistableBundle rhsValues(rhs);
+        lhsValues.unparcel();
+        rhsValues.unparcel();
+        return lhsValues == rhsValues;
+    }
+    return (lhs.mBoolMap == rhs.mBoolMap && lhs.mIntMap == rhs.mIntMap &&
+            lhs.mLongMap == rhs.mLongMap && lhs.mDoubleMap == rhs.mDoubleMap &&
+            lhs.mStringMap == rhs.mStringMap && lhs.mBoolVectorMap == rhs.mBoolVectorMap &&
+            lhs.mIntVectorMap == rhs.mIntVectorMap && lhs.mLongVectorMap == rhs.mLongVectorMap &&
+            lhs.mDoubleVectorMap == rhs.mDoubleVectorMap &&
+            lhs.mStringVectorMap == rhs.mStringVectorMap &&
+            lhs.mPersistableBundleMap == rhs.mPersistableBundleMap);
 }
 
 }  // namespace os
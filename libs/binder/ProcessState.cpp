@@ -223,32 +223,39 @@ void ProcessState::setCallRestriction(CallRestriction restriction) {
     mCallRestriction = restriction;
 }
 
-ProcessState::handle_entry* ProcessState::lookupHandleLocked(int32_t handle)
+ProcessState::handle_shard& ProcessState::shardForHandle(int32_t handle)
 {
-    const size_t N=mHandleToObject.size();
-    if (N <= (size_t)handle) {
+    return mHandleShards[(uint32_t)handle % kHandleShards];
+}
+
+ProcessState::handle_entry* ProcessState::lookupHandleLocked(handle_shard& shard, int32_t handle)
+{
+    const size_t index = (uint32_t)handle / kHandleShards;
+    const size_t N=shard.entries.size();
+    if (N <= index) {
         handle_entry e;
         e.binder = nullptr;
         e.refs = nullptr;
-        status_t err = mHandleToObject.insertAt(e, N, handle+1-N);
+        status_t err = shard.entries.insertAt(e, N, index+1-N);
         if (err < NO_ERROR) return nullptr;
     }
-    return &mHandleToObject.editItemAt(handle);
+    return &shard.entries.editItemAt(index);
 }
 
 sp<IBinder> ProcessState::getStrongProxyForHandle(int32_t handle)
 {
     sp<IBinder> result;
 
-    AutoMutex _l(mLock);
+    handle_shard& shard = shardForHandle(handle);
+    AutoMutex _l(shard.lock);
 
-    handle_entry* e = lookupHandleLocked(handle);
+    handle_entry* e = lookupHandleLocked(shard, handle);
 
     if (e != nullptr) {
         // We need to create a new BpBinder if there isn't currently one, OR we
         // are unable to acquire a weak reference on this current one.  The
         // attemptIncWeak() is safe because we know the BpBinder destructor will always
-        // call expungeHandle(), which acquires the same lock we are holding now.
+        // call expungeHandle(), which acquires the same shard lock we are holding now.
         // We need to do this because there is a race condition between someone
         // releasing a reference on this BpBinder, and a new reference on its handle
         // arriving from the driver.
@@ -299,9 +306,10 @@ sp<IBinder> ProcessState::getStrongProxyForHandle(int32_t handle)
 
 void ProcessState::expungeHandle(int32_t handle, IBinder* binder)
 {
-    AutoMutex _l(mLock);
+    handle_shard& shard = shardForHandle(handle);
+    AutoMutex _l(shard.lock);
 
-    handle_entry* e = lookupHandleLocked(handle);
+    handle_entry* e = lookupHandleLocked(shard, handle);
 
     // This handle may have already been replaced with a new BpBinder
     // (if someone failed the AttemptIncWeak() above); we don't want
@@ -338,6 +346,35 @@ status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
     return result;
 }
 
+status_t ProcessState::setThreadPoolAdaptiveMaxThreadCount(size_t minThreads,
+                                                            size_t maxThreads) {
+    if (minThreads > maxThreads) {
+        return BAD_VALUE;
+    }
+
+    pthread_mutex_lock(&mThreadCountLock);
+    status_t result = setThreadPoolMaxThreadCount(minThreads);
+    if (result == NO_ERROR) {
+        mAdaptiveMaxThreads = maxThreads;
+    }
+    pthread_mutex_unlock(&mThreadCountLock);
+    return result;
+}
+
+ProcessState::ThreadPoolStats ProcessState::getThreadPoolStats() {
+    pthread_mutex_lock(&mThreadCountLock);
+    ThreadPoolStats stats = {
+        .maxThreads = mMaxThreads,
+        .adaptiveMaxThreads = mAdaptiveMaxThreads,
+        .startedThreads = mStartedThreadsCount,
+        .executingThreads = mExecutingThreadsCount,
+        .peakExecutingThreads = mPeakExecutingThreadsCount,
+        .starvationCount = mStarvationCount,
+    };
+    pthread_mutex_unlock(&mThreadCountLock);
+    return stats;
+}
+
 void ProcessState::giveThreadPoolName() {
     androidSetThreadName( makeBinderThreadName().string() );
 }
@@ -383,6 +420,10 @@ ProcessState::ProcessState(const char *driver)
     , mExecutingThreadsCount(0)
     , mMaxThreads(DEFAULT_MAX_BINDER_THREADS)
     , mStarvationStartTimeMs(0)
+    , mAdaptiveMaxThreads(0)
+    , mStartedThreadsCount(0)
+    , mPeakExecutingThreadsCount(0)
+    , mStarvationCount(0)
     , mBinderContextCheckFunc(nullptr)
     , mBinderContextUserData(nullptr)
     , mThreadPoolStarted(false)
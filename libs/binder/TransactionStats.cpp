@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransactionStats"
+
+#include <binder/TransactionStats.h>
+
+#include <binder/IBinder.h>
+#include <binder/Parcel.h>
+#include <utils/String8.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+namespace android {
+
+namespace {
+
+struct Key {
+    std::u16string descriptor;
+    uint32_t code;
+    bool outgoing;
+};
+
+struct KeyView {
+    std::u16string_view descriptor;
+    uint32_t code;
+    bool outgoing;
+};
+
+template <typename K>
+std::tuple<uint32_t, bool, std::u16string_view> asTuple(const K& key) {
+    return {key.code, key.outgoing, key.descriptor};
+}
+
+// Lets lookups use a KeyView so the hot path never allocates.
+struct KeyLess {
+    using is_transparent = void;
+    template <typename A, typename B>
+    bool operator()(const A& a, const B& b) const {
+        return asTuple(a) < asTuple(b);
+    }
+};
+
+using Table = std::map<Key, TransactionStats::Entry, KeyLess>;
+
+size_t bucketFor(uint64_t value, size_t buckets) {
+    size_t bucket = 0;
+    while (value > 1 && bucket < buckets - 1) {
+        value >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void mergeEntry(TransactionStats::Entry* into, const TransactionStats::Entry& from) {
+    into->count += from.count;
+    into->totalLatencyNs += from.totalLatencyNs;
+    into->maxLatencyNs = std::max(into->maxLatencyNs, from.maxLatencyNs);
+    for (size_t i = 0; i < TransactionStats::kLatencyBuckets; i++) {
+        into->latencyHistogram[i] += from.latencyHistogram[i];
+    }
+    for (size_t i = 0; i < TransactionStats::kSizeBuckets; i++) {
+        into->sizeHistogram[i] += from.sizeHistogram[i];
+    }
+}
+
+void mergeTable(Table* into, const Table& from) {
+    for (const auto& [key, entry] : from) {
+        auto it = into->find(key);
+        if (it == into->end()) {
+            into->emplace(key, entry);
+        } else {
+            mergeEntry(&it->second, entry);
+        }
+    }
+}
+
+struct ThreadTable;
+
+std::atomic_bool gEnabled(false);
+
+// Intentionally leaked so that threads exiting during process teardown can
+// still retire their tables safely.
+struct Registry {
+    std::mutex lock;
+    std::set<ThreadTable*> tables;
+    // Totals left behind by threads that have exited.
+    Table retired;
+};
+
+Registry& registry() {
+    static Registry* registry = new Registry();
+    return *registry;
+}
+
+// Only the owning thread writes to |entries|, so |lock| is uncontended
+// except while a snapshot is being taken.
+struct ThreadTable {
+    std::mutex lock;
+    Table entries;
+
+    ThreadTable() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> _l(r.lock);
+        r.tables.insert(this);
+    }
+
+    ~ThreadTable() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> _l(r.lock);
+        r.tables.erase(this);
+        mergeTable(&r.retired, entries);
+    }
+};
+
+ThreadTable& threadTable() {
+    static thread_local ThreadTable table;
+    return table;
+}
+
+void recordEntry(std::u16string_view descriptor, uint32_t code, bool outgoing, size_t dataSize,
+                 nsecs_t latency) {
+    const uint64_t latencyNs = latency > 0 ? static_cast<uint64_t>(latency) : 0;
+    const KeyView view{descriptor, code, outgoing};
+
+    ThreadTable& table = threadTable();
+    std::lock_guard<std::mutex> _l(table.lock);
+    auto it = table.entries.find(view);
+    if (it == table.entries.end()) {
+        TransactionStats::Entry entry;
+        entry.descriptor = String16(descriptor.data(), descriptor.size());
+        entry.code = code;
+        entry.outgoing = outgoing;
+        it = table.entries.emplace(Key{std::u16string(descriptor), code, outgoing},
+                                   std::move(entry)).first;
+    }
+
+    TransactionStats::Entry& entry = it->second;
+    entry.count++;
+    entry.totalLatencyNs += latencyNs;
+    entry.maxLatencyNs = std::max(entry.maxLatencyNs, latencyNs);
+    entry.latencyHistogram[bucketFor(latencyNs / 1000, TransactionStats::kLatencyBuckets)]++;
+    entry.sizeHistogram[bucketFor(dataSize, TransactionStats::kSizeBuckets)]++;
+}
+
+} // namespace
+
+void TransactionStats::setEnabled(bool enabled) {
+    gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool TransactionStats::isEnabled() {
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+void TransactionStats::record(const String16& descriptor, uint32_t code, bool outgoing,
+                              size_t dataSize, nsecs_t latency) {
+    recordEntry(std::u16string_view(descriptor.string(), descriptor.size()), code, outgoing,
+                dataSize, latency);
+}
+
+void TransactionStats::recordOutgoing(const Parcel& data, uint32_t code, nsecs_t latency) {
+    // Outgoing calls only know their interface through the token written by
+    // Parcel::writeInterfaceToken(); asking the proxy would be another
+    // transaction.
+    std::u16string_view descriptor = u"<unknown>";
+
+    const size_t pos = data.dataPosition();
+    data.setDataPosition(0);
+    data.readInt32(); // strict mode policy
+    data.readInt32(); // work source
+    const int32_t header = data.readInt32();
+    if (header == B_PACK_CHARS('S', 'Y', 'S', 'T') ||
+        header == B_PACK_CHARS('V', 'N', 'D', 'R')) {
+        size_t len = 0;
+        const char16_t* str = data.readString16Inplace(&len);
+        if (str != nullptr) {
+            descriptor = std::u16string_view(str, len);
+        }
+    }
+    data.setDataPosition(pos);
+
+    recordEntry(descriptor, code, true, data.dataSize(), latency);
+}
+
+std::vector<TransactionStats::Entry> TransactionStats::snapshot() {
+    Table merged;
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> _l(r.lock);
+        merged = r.retired;
+        for (ThreadTable* table : r.tables) {
+            std::lock_guard<std::mutex> _tl(table->lock);
+            mergeTable(&merged, table->entries);
+        }
+    }
+
+    std::vector<Entry> entries;
+    entries.reserve(merged.size());
+    for (auto& [key, entry] : merged) {
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+void TransactionStats::reset() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> _l(r.lock);
+    r.retired.clear();
+    for (ThreadTable* table : r.tables) {
+        std::lock_guard<std::mutex> _tl(table->lock);
+        table->entries.clear();
+    }
+}
+
+void TransactionStats::dump(int fd) {
+    dprintf(fd, "Binder transaction stats (%s):\n", isEnabled() ? "enabled" : "disabled");
+    for (const Entry& entry : snapshot()) {
+        dprintf(fd, "  %s %s code=%u count=%" PRIu64 " avg=%" PRIu64 "us max=%" PRIu64 "us\n",
+                entry.outgoing ? "out" : "in ", String8(entry.descriptor).c_str(), entry.code,
+                entry.count, entry.count ? entry.totalLatencyNs / entry.count / 1000 : 0,
+                entry.maxLatencyNs / 1000);
+        dprintf(fd, "    latency(us, log2):");
+        for (size_t i = 0; i < kLatencyBuckets; i++) {
+            dprintf(fd, " %" PRIu64, entry.latencyHistogram[i]);
+        }
+        dprintf(fd, "\n    size(bytes, log2):");
+        for (size_t i = 0; i < kSizeBuckets; i++) {
+            dprintf(fd, " %" PRIu64, entry.sizeHistogram[i]);
+        }
+        dprintf(fd, "\n");
+    }
+}
+
+} // namespace android
@@ -20,8 +20,12 @@
 #include <utils/Errors.h>
 #include <binder/Parcel.h>
 #include <binder/ProcessState.h>
+#include <utils/Timers.h>
 #include <utils/Vector.h>
 
+#include <memory>
+#include <vector>
+
 #if defined(_WIN32)
 typedef  int  uid_t;
 #endif
@@ -102,6 +106,16 @@ public:
                                          uint32_t code, const Parcel& data,
                                          Parcel* reply, uint32_t flags);
 
+            // Oneway transactions made on this thread between these calls are
+            // queued instead of each paying a separate driver round trip, and
+            // are submitted together in a single BINDER_WRITE_READ by the
+            // outermost endOnewayBatch(). Ordering is preserved. Calls nest;
+            // a non-oneway transaction inside a batch flushes it first.
+            //
+            // returns: the first error reported for any queued transaction
+            void                beginOnewayBatch();
+            status_t            endOnewayBatch();
+
             void                incStrongHandle(int32_t handle, BpBinder *proxy);
             void                decStrongHandle(int32_t handle);
             void                incWeakHandle(int32_t handle, BpBinder *proxy);
@@ -137,6 +151,24 @@ public:
             // calls between multiple different transports.
             const void*         getServingStackPointer() const;
 
+            // The incoming transaction a thread is serving, for attributing the
+            // time the thread is busy to the caller and method.
+            struct ServingCall {
+                // The local object being called. Only to be dereferenced by the
+                // serving thread, and only before the transaction returns.
+                const BBinder*  target;
+                uint32_t        code;
+                uid_t           callingUid;
+                pid_t           callingPid;
+                // When the transaction started being served, in SYSTEM_TIME_MONOTONIC.
+                nsecs_t         startTime;
+            };
+
+            // Returns the innermost transaction this thread is serving, or false if
+            // there is none. Neither allocates nor locks, so a signal handler running
+            // on this thread, such as a sampling profiler's, may call it.
+            bool                getServingCall(ServingCall* outCall) const;
+
             // The work source represents the UID of the process we should attribute the transaction
             // to. We use -1 to specify that the work source was not set using #setWorkSource.
             //
@@ -158,6 +190,7 @@ private:
                                                      uint32_t code,
                                                      const Parcel& data,
                                                      status_t* statusBuffer);
+            status_t            flushOnewayBatch();
             status_t            getAndExecuteCommand();
             status_t            executeCommand(int32_t command);
             void                processPendingDerefs();
@@ -180,6 +213,10 @@ private:
             Parcel              mOut;
             status_t            mLastError;
             const void*         mServingStackPointer;
+            // Only read while mServingCallValid is set, which is cleared while
+            // mServingCall is written so that signal handlers never see it torn.
+            ServingCall         mServingCall;
+            volatile bool       mServingCallValid;
             pid_t               mCallingPid;
             const char*         mCallingSid;
             uid_t               mCallingUid;
@@ -192,6 +229,23 @@ private:
             int32_t             mLastTransactionBinderFlags;
 
             ProcessState::CallRestriction mCallRestriction;
+
+            // Nesting depth of beginOnewayBatch() and copies of the data for
+            // queued transactions, which must outlive their trip to the driver.
+            int32_t             mOnewayBatchDepth;
+            std::vector<std::unique_ptr<Parcel>> mOnewayBatch;
+};
+
+// Queues oneway transactions made on the current thread for the lifetime
+// of the object. See IPCThreadState::beginOnewayBatch().
+class ScopedOnewayBatch
+{
+public:
+    ScopedOnewayBatch() { IPCThreadState::self()->beginOnewayBatch(); }
+    ~ScopedOnewayBatch() { IPCThreadState::self()->endOnewayBatch(); }
+
+    ScopedOnewayBatch(const ScopedOnewayBatch&) = delete;
+    ScopedOnewayBatch& operator=(const ScopedOnewayBatch&) = delete;
 };
 
 } // namespace android
@@ -108,6 +108,18 @@ sp<IServiceManager> defaultServiceManager();
  */
 void setDefaultServiceManager(const sp<IServiceManager>& sm);
 
+/**
+ * Caches the results of getService() and checkService() made through
+ * defaultServiceManager() in this process, so repeated lookups of the same
+ * service skip the round trip to servicemanager. Only weak references are
+ * kept, so lazy services can still shut down once every client lets go, and
+ * an entry is dropped as soon as its service dies or is re-added from this
+ * process. Dropping entries on death requires a binder thread pool.
+ *
+ * Disabled by default.
+ */
+void setServiceLookupCacheEnabled(bool enabled);
+
 template<typename INTERFACE>
 sp<INTERFACE> waitForService(const String16& name) {
     const sp<IServiceManager> sm = defaultServiceManager();
@@ -17,8 +17,10 @@
 #ifndef ANDROID_PARCEL_H
 #define ANDROID_PARCEL_H
 
+#include <algorithm>
 #include <map> // for legacy reasons
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -289,6 +291,12 @@ public:
     status_t            readString16(String16* pArg) const;
     status_t            readString16(std::unique_ptr<String16>* pArg) const;
     const char16_t*     readString16Inplace(size_t* outLen) const;
+
+    // Read a string without copying it. The view points into this Parcel's
+    // data and is only valid until the Parcel is modified or destroyed.
+    // Reading a null string returns UNEXPECTED_NULL.
+    status_t            readString8View(std::string_view* val) const;
+    status_t            readString16View(std::u16string_view* val) const;
     sp<IBinder>         readStrongBinder() const;
     status_t            readStrongBinder(sp<IBinder>* val) const;
     status_t            readNullableStrongBinder(sp<IBinder>* val) const;
@@ -330,6 +338,9 @@ public:
     status_t            readByteVector(std::vector<int8_t>* val) const;
     status_t            readByteVector(std::unique_ptr<std::vector<uint8_t>>* val) const;
     status_t            readByteVector(std::vector<uint8_t>* val) const;
+    // Like readString16Inplace for byte vectors: returns the bytes in this
+    // Parcel's data, or nullptr for a null vector or on error.
+    const uint8_t*      readByteVectorInplace(size_t* outLen) const;
     status_t            readInt32Vector(std::unique_ptr<std::vector<int32_t>>* val) const;
     status_t            readInt32Vector(std::vector<int32_t>* val) const;
     status_t            readInt64Vector(std::unique_ptr<std::vector<int64_t>>* val) const;
@@ -415,6 +426,10 @@ public:
     // Debugging: get metrics on current allocations.
     static size_t       getGlobalAllocSize();
     static size_t       getGlobalAllocCount();
+    // Debugging: get metrics on freed buffers held by per-thread pools for
+    // reuse. These are not included in the allocation metrics above.
+    static size_t       getGlobalPooledSize();
+    static size_t       getGlobalPooledCount();
 
     bool                replaceCallingWorkSourceUid(uid_t uid);
     // Returns the work source provided by the caller. This can only be trusted for trusted calling
@@ -446,6 +461,7 @@ private:
     void                releaseObjects();
     void                acquireObjects();
     status_t            growData(size_t len);
+    status_t            reserveWrite(size_t len);
     status_t            restartWrite(size_t desired);
     status_t            continueWrite(size_t desired);
     status_t            writePointer(uintptr_t val);
@@ -871,6 +887,20 @@ status_t Parcel::unsafeWriteTypedVector(const std::vector<T>& val,
         return BAD_VALUE;
     }
 
+    if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+        // Fixed-size elements: size the buffer once up front instead of
+        // letting each element write trigger another growData() copy.
+        // Every primitive is written as at least an int32.
+        const size_t elemSize = std::max(sizeof(T), sizeof(int32_t));
+        if (val.size() > (std::numeric_limits<int32_t>::max() - sizeof(int32_t)) / elemSize) {
+            return BAD_VALUE;
+        }
+        status_t status = reserveWrite(sizeof(int32_t) + val.size() * elemSize);
+        if (status != OK) {
+            return status;
+        }
+    }
+
     status_t status = this->writeInt32(static_cast<int32_t>(val.size()));
 
     if (status != OK) {
@@ -18,6 +18,7 @@
 #define ANDROID_PERSISTABLE_BUNDLE_H
 
 #include <map>
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -32,6 +33,11 @@ namespace os {
 /*
  * C++ implementation of PersistableBundle, a mapping from String values to
  * various types that can be saved to persistent and later restored.
+ *
+ * Like the Java implementation, a bundle read from a parcel keeps the parcelled
+ * data instead of decoding it all: only the keys are read, and each value is
+ * decoded when it is asked for. Values that are never asked for are written
+ * back to parcels as they were read.
  */
 class PersistableBundle : public Parcelable {
 public:
@@ -93,25 +99,42 @@ public:
     std::set<String16> getStringVectorKeys() const;
     std::set<String16> getPersistableBundleKeys() const;
 
-    friend bool operator==(const PersistableBundle& lhs, const PersistableBundle& rhs) {
-        return (lhs.mBoolMap == rhs.mBoolMap && lhs.mIntMap == rhs.mIntMap &&
-                lhs.mLongMap == rhs.mLongMap && lhs.mDoubleMap == rhs.mDoubleMap &&
-                lhs.mStringMap == rhs.mStringMap && lhs.mBoolVectorMap == rhs.mBoolVectorMap &&
-                lhs.mIntVectorMap == rhs.mIntVectorMap &&
-                lhs.mLongVectorMap == rhs.mLongVectorMap &&
-                lhs.mDoubleVectorMap == rhs.mDoubleVectorMap &&
-                lhs.mStringVectorMap == rhs.mStringVectorMap &&
-                lhs.mPersistableBundleMap == rhs.mPersistableBundleMap);
-    }
+    friend bool operator==(const PersistableBundle& lhs, const PersistableBundle& rhs);
 
     friend bool operator!=(const PersistableBundle& lhs, const PersistableBundle& rhs) {
         return !(lhs == rhs);
     }
 
 private:
+    // The parcelled data of the bundle, shared by its copies.
+    struct ParcelledData;
+
+    // Where the key, the type and the value of a parcelled entry start in
+    // the parcelled data, and where the entry ends.
+    struct ParcelledValue {
+        int32_t type;
+        size_t begin;
+        size_t value;
+        size_t end;
+    };
+
     status_t writeToParcelInner(Parcel* parcel) const;
     status_t readFromParcelInner(const Parcel* parcel, size_t length);
 
+    // Reads the keys of the parcelled data into mParcelledValues, checking
+    // that the values are well formed without decoding them.
+    status_t indexParcelledData();
+
+    // Decodes the parcelled value of |key| into |out|, if it has |type|.
+    template <typename T>
+    bool getParcelledValue(const String16& key, int32_t type, T* out) const;
+
+    // Adds the keys of the parcelled values of |type| to |keys|.
+    std::set<String16> addParcelledKeys(int32_t type, std::set<String16> keys) const;
+
+    // Decodes all the parcelled values into the maps below.
+    void unparcel();
+
     std::map<String16, bool> mBoolMap;
     std::map<String16, int32_t> mIntMap;
     std::map<String16, int64_t> mLongMap;
@@ -123,6 +146,11 @@ private:
     std::map<String16, std::vector<double>> mDoubleVectorMap;
     std::map<String16, std::vector<String16>> mStringVectorMap;
     std::map<String16, PersistableBundle> mPersistableBundleMap;
+
+    // The values read from a parcel that were not decoded, which are in none
+    // of the maps above.
+    std::shared_ptr<ParcelledData> mParcelledData;
+    std::map<String16, ParcelledValue> mParcelledValues;
 };
 
 }  // namespace os
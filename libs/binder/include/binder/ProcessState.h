@@ -63,6 +63,31 @@ public:
             void                spawnPooledThread(bool isMain);
             
             status_t            setThreadPoolMaxThreadCount(size_t maxThreads);
+
+                                // Starts the pool with a driver cap of |minThreads| and raises
+                                // it one thread at a time, up to |maxThreads|, whenever every
+                                // looper is busy executing a command. The driver then spawns
+                                // the extra looper through BR_SPAWN_LOOPER as usual. Loopers
+                                // are never retired: the driver does not give back a thread
+                                // slot when a looper exits, so the cap only grows.
+            status_t            setThreadPoolAdaptiveMaxThreadCount(size_t minThreads,
+                                                                    size_t maxThreads);
+
+            struct ThreadPoolStats {
+                // Current driver cap on spawned loopers.
+                size_t maxThreads;
+                // Upper bound for adaptive growth, or 0 if the cap is static.
+                size_t adaptiveMaxThreads;
+                // Loopers currently in joinThreadPool(), including the main one.
+                size_t startedThreads;
+                // Loopers currently executing a command, and the highest that
+                // has been seen.
+                size_t executingThreads;
+                size_t peakExecutingThreads;
+                // Number of times every looper was busy at once.
+                size_t starvationCount;
+            };
+            ThreadPoolStats     getThreadPoolStats();
             void                giveThreadPoolName();
 
             String8             getDriverName();
@@ -104,7 +129,19 @@ private:
                 RefBase::weakref_type* refs;
             };
 
-            handle_entry*       lookupHandleLocked(int32_t handle);
+            // Every binder object unflattened from a Parcel goes through the
+            // handle table, so it is striped by handle to keep binder threads
+            // from serializing on a single lock. Handle h lives at index
+            // h / kHandleShards of shard h % kHandleShards.
+            static constexpr size_t kHandleShards = 16;
+
+            struct handle_shard {
+                Mutex lock;  // protects entries.
+                Vector<handle_entry> entries;
+            };
+
+            handle_shard&       shardForHandle(int32_t handle);
+            handle_entry*       lookupHandleLocked(handle_shard& shard, int32_t handle);
 
             String8             mDriverName;
             int                 mDriverFD;
@@ -119,10 +156,15 @@ private:
             size_t              mMaxThreads;
             // Time when thread pool was emptied
             int64_t             mStarvationStartTimeMs;
+            // Ceiling for adaptive growth of mMaxThreads, 0 when disabled.
+            size_t              mAdaptiveMaxThreads;
+            size_t              mStartedThreadsCount;
+            size_t              mPeakExecutingThreadsCount;
+            size_t              mStarvationCount;
 
-    mutable Mutex               mLock;  // protects everything below.
+            handle_shard        mHandleShards[kHandleShards];
 
-            Vector<handle_entry>mHandleToObject;
+    mutable Mutex               mLock;  // protects everything below.
 
             context_check_func  mBinderContextCheckFunc;
             void*               mBinderContextUserData;
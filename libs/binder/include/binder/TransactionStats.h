@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/String16.h>
+#include <utils/Timers.h>
+
+#include <stdint.h>
+#include <vector>
+
+namespace android {
+
+class Parcel;
+
+// Opt-in latency and payload size histograms for binder transactions, keyed
+// by interface descriptor, transaction code and direction.
+//
+// Each thread accumulates into its own table, so recording never contends
+// with other binder threads; the tables are only merged when a snapshot is
+// taken. Recording is disabled by default and costs a single relaxed atomic
+// load per transaction while off.
+//
+// The dump is also available for any service through
+//     dumpsys <service> --binder-transaction-stats
+class TransactionStats final {
+public:
+    // Bucket i holds samples in [2^i, 2^(i+1)) microseconds; the last bucket
+    // is open ended.
+    static constexpr size_t kLatencyBuckets = 20;
+    // Bucket i holds payloads in [2^i, 2^(i+1)) bytes; the last bucket is
+    // open ended.
+    static constexpr size_t kSizeBuckets = 20;
+
+    struct Entry {
+        String16 descriptor;
+        uint32_t code = 0;
+        // true for calls made through a BpBinder, false for calls served by
+        // a BBinder in this process.
+        bool outgoing = false;
+        uint64_t count = 0;
+        uint64_t totalLatencyNs = 0;
+        uint64_t maxLatencyNs = 0;
+        uint64_t latencyHistogram[kLatencyBuckets] = {};
+        uint64_t sizeHistogram[kSizeBuckets] = {};
+    };
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    // Returns the merged totals of every thread since the last reset().
+    static std::vector<Entry> snapshot();
+    static void reset();
+    static void dump(int fd);
+
+    // Called by BpBinder and BBinder around each transaction.
+    static void record(const String16& descriptor, uint32_t code, bool outgoing,
+                       size_t dataSize, nsecs_t latency);
+    static void recordOutgoing(const Parcel& data, uint32_t code, nsecs_t latency);
+
+private:
+    TransactionStats() = delete;
+};
+
+} // namespace android
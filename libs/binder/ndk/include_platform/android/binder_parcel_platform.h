@@ -29,4 +29,38 @@ __BEGIN_DECLS
  */
 bool AParcel_getAllowFds(const AParcel*);
 
+/**
+ * Writes an array of int8_t to the next location in a non-null parcel as a blob. Arrays larger
+ * than a few KB (and only if FDs are allowed) are placed in a shared memory region which is sent
+ * as a file descriptor, so they neither get copied through the binder buffer nor count against
+ * its size limit. Smaller arrays are written inline.
+ *
+ * This is not wire compatible with AParcel_writeByteArray. It must be read with
+ * AParcel_readByteBlob.
+ *
+ * \param parcel the parcel to write to.
+ * \param arrayData an array of size 'length' (or null if length is -1, may be null if length is 0).
+ * \param length the length of arrayData or -1 if this represents a null array.
+ *
+ * \return STATUS_OK on successful write.
+ */
+binder_status_t AParcel_writeByteBlob(AParcel* parcel, const int8_t* arrayData, int32_t length);
+
+/**
+ * Reads an array of int8_t written by AParcel_writeByteBlob from the next location in a non-null
+ * parcel.
+ *
+ * First, allocator will be called with the length of the array. If the allocation succeeds and the
+ * length is greater than zero, the buffer returned by the allocator will be filled with the
+ * corresponding data, directly from the shared memory region if one was used.
+ *
+ * \param parcel the parcel to read from.
+ * \param arrayData some external representation of an array.
+ * \param allocator the callback that will be called to allocate the array.
+ *
+ * \return STATUS_OK on successful read.
+ */
+binder_status_t AParcel_readByteBlob(const AParcel* parcel, void* arrayData,
+                                     AParcel_byteArrayAllocator allocator);
+
 __END_DECLS
\ No newline at end of file
@@ -647,4 +647,45 @@ bool AParcel_getAllowFds(const AParcel* parcel) {
     return parcel->get()->allowFds();
 }
 
+binder_status_t AParcel_writeByteBlob(AParcel* parcel, const int8_t* arrayData, int32_t length) {
+    binder_status_t status = WriteAndValidateArraySize(parcel, arrayData == nullptr, length);
+    if (status != STATUS_OK) return status;
+    if (length <= 0) return STATUS_OK;
+
+    Parcel::WritableBlob blob;
+    status_t err = parcel->get()->writeBlob(length, false /*mutableCopy*/, &blob);
+    if (err != ::android::OK) return PruneStatusT(err);
+
+    memcpy(blob.data(), arrayData, length);
+    blob.release();
+
+    return STATUS_OK;
+}
+
+binder_status_t AParcel_readByteBlob(const AParcel* parcel, void* arrayData,
+                                     AParcel_byteArrayAllocator allocator) {
+    const Parcel* rawParcel = parcel->get();
+
+    int32_t length;
+    status_t err = rawParcel->readInt32(&length);
+
+    if (err != ::android::OK) return PruneStatusT(err);
+    if (length < -1) return STATUS_BAD_VALUE;
+
+    int8_t* array;
+    if (!allocator(arrayData, length, &array)) return STATUS_NO_MEMORY;
+
+    if (length <= 0) return STATUS_OK;
+    if (array == nullptr) return STATUS_NO_MEMORY;
+
+    Parcel::ReadableBlob blob;
+    err = rawParcel->readBlob(length, &blob);
+    if (err != ::android::OK) return PruneStatusT(err);
+
+    memcpy(array, blob.data(), length);
+    blob.release();
+
+    return STATUS_OK;
+}
+
 // @END
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <binder/Binder.h>
+#include <binder/IBinder.h>
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
+#include <binder/ProcessState.h>
+#include <utils/String8.h>
+
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace android {
+
+static const String16 kServiceName("binderBenchmark");
+static const String16 kDescriptor("android.binder.IBinderBenchmark");
+
+enum BenchmarkCode : uint32_t {
+    // Replies with nothing.
+    BENCHMARK_NOP = IBinder::FIRST_CALL_TRANSACTION,
+    // Replies with a copy of the byte vector it was sent.
+    BENCHMARK_ECHO_BYTES,
+};
+
+class BenchmarkService : public BBinder {
+public:
+    status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
+                        uint32_t flags) override {
+        switch (code) {
+            case BENCHMARK_NOP:
+                if (!data.enforceInterface(kDescriptor)) return PERMISSION_DENIED;
+                return NO_ERROR;
+            case BENCHMARK_ECHO_BYTES: {
+                if (!data.enforceInterface(kDescriptor)) return PERMISSION_DENIED;
+                std::vector<uint8_t> bytes;
+                status_t status = data.readByteVector(&bytes);
+                if (status != NO_ERROR) return status;
+                return reply->writeByteVector(bytes);
+            }
+            default:
+                return BBinder::onTransact(code, data, reply, flags);
+        }
+    }
+};
+
+static sp<IBinder> gService;
+
+// Payload sizes in bytes, from a small parcelable up to a large bitmap.
+#define PAYLOAD_SIZES ->Arg(64)->Arg(1024)->Arg(16 * 1024)->Arg(256 * 1024)
+
+// --- Parcel only, no driver involved ---
+
+static void BM_ParcelWriteByteVector(benchmark::State& state) {
+    std::vector<uint8_t> bytes(state.range(0), 0xa5);
+    for (auto _ : state) {
+        Parcel data;
+        benchmark::DoNotOptimize(data.writeByteVector(bytes));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParcelWriteByteVector) PAYLOAD_SIZES;
+
+static void BM_ParcelReadByteVector(benchmark::State& state) {
+    Parcel data;
+    data.writeByteVector(std::vector<uint8_t>(state.range(0), 0xa5));
+    for (auto _ : state) {
+        std::vector<uint8_t> bytes;
+        data.setDataPosition(0);
+        benchmark::DoNotOptimize(data.readByteVector(&bytes));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParcelReadByteVector) PAYLOAD_SIZES;
+
+static void BM_ParcelReadByteVectorInplace(benchmark::State& state) {
+    Parcel data;
+    data.writeByteVector(std::vector<uint8_t>(state.range(0), 0xa5));
+    for (auto _ : state) {
+        size_t len;
+        data.setDataPosition(0);
+        benchmark::DoNotOptimize(data.readByteVectorInplace(&len));
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParcelReadByteVectorInplace) PAYLOAD_SIZES;
+
+static void BM_ParcelWriteInt32Vector(benchmark::State& state) {
+    std::vector<int32_t> values(state.range(0), 7);
+    for (auto _ : state) {
+        Parcel data;
+        benchmark::DoNotOptimize(data.writeInt32Vector(values));
+    }
+}
+BENCHMARK(BM_ParcelWriteInt32Vector)->Arg(16)->Arg(1024)->Arg(64 * 1024);
+
+static void BM_ParcelWriteInt32s(benchmark::State& state) {
+    for (auto _ : state) {
+        Parcel data;
+        for (int64_t i = 0; i < state.range(0); i++) {
+            data.writeInt32(i);
+        }
+        benchmark::DoNotOptimize(data.data());
+    }
+}
+BENCHMARK(BM_ParcelWriteInt32s)->Arg(16)->Arg(1024)->Arg(64 * 1024);
+
+static void BM_ParcelEnforceInterface(benchmark::State& state) {
+    Parcel data;
+    data.writeInterfaceToken(kDescriptor);
+    for (auto _ : state) {
+        data.setDataPosition(0);
+        benchmark::DoNotOptimize(data.enforceInterface(kDescriptor));
+    }
+}
+BENCHMARK(BM_ParcelEnforceInterface);
+
+// --- Round trips through the driver ---
+
+static void BM_TransactNop(benchmark::State& state) {
+    for (auto _ : state) {
+        Parcel data, reply;
+        data.writeInterfaceToken(kDescriptor);
+        gService->transact(BENCHMARK_NOP, data, &reply);
+    }
+}
+BENCHMARK(BM_TransactNop);
+
+static void BM_TransactEchoBytes(benchmark::State& state) {
+    std::vector<uint8_t> bytes(state.range(0), 0xa5);
+    for (auto _ : state) {
+        Parcel data, reply;
+        data.writeInterfaceToken(kDescriptor);
+        data.writeByteVector(bytes);
+        gService->transact(BENCHMARK_ECHO_BYTES, data, &reply);
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * 2);
+}
+BENCHMARK(BM_TransactEchoBytes) PAYLOAD_SIZES;
+
+static void BM_TransactOneway(benchmark::State& state) {
+    for (auto _ : state) {
+        for (int64_t i = 0; i < state.range(0); i++) {
+            Parcel data;
+            data.writeInterfaceToken(kDescriptor);
+            gService->transact(BENCHMARK_NOP, data, nullptr, IBinder::FLAG_ONEWAY);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransactOneway)->Arg(1)->Arg(16)->Arg(128);
+
+static void BM_TransactOnewayBatched(benchmark::State& state) {
+    for (auto _ : state) {
+        ScopedOnewayBatch batch;
+        for (int64_t i = 0; i < state.range(0); i++) {
+            Parcel data;
+            data.writeInterfaceToken(kDescriptor);
+            gService->transact(BENCHMARK_NOP, data, nullptr, IBinder::FLAG_ONEWAY);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TransactOnewayBatched)->Arg(1)->Arg(16)->Arg(128);
+
+static void BM_GetService(benchmark::State& state) {
+    sp<IServiceManager> sm = defaultServiceManager();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sm->checkService(kServiceName));
+    }
+}
+BENCHMARK(BM_GetService);
+
+static void runService() {
+    // Don't outlive the benchmark process.
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    sp<IServiceManager> sm = defaultServiceManager();
+    if (sm->addService(kServiceName, new BenchmarkService()) != NO_ERROR) {
+        exit(EXIT_FAILURE);
+    }
+    ProcessState::self()->startThreadPool();
+    IPCThreadState::self()->joinThreadPool();
+    exit(EXIT_FAILURE);
+}
+
+} // namespace android
+
+int main(int argc, char** argv) {
+    using namespace android;
+
+    // The service runs in a child so every transaction really goes through
+    // the driver; fork before this process touches binder.
+    pid_t pid = fork();
+    if (pid == 0) {
+        runService();
+    }
+
+    gService = defaultServiceManager()->getService(kServiceName);
+    if (gService == nullptr) {
+        fprintf(stderr, "Failed to find %s\n", String8(kServiceName).c_str());
+        kill(pid, SIGKILL);
+        return EXIT_FAILURE;
+    }
+
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+
+    gService.clear();
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    return 0;
+}
@@ -28,6 +28,7 @@
 #include <binder/IBinder.h>
 #include <binder/IPCThreadState.h>
 #include <binder/IServiceManager.h>
+#include <binder/TransactionStats.h>
 
 #include <private/binder/binder_module.h>
 #include <sys/epoll.h>
@@ -445,6 +446,27 @@ TEST_F(BinderLibTest, Freeze) {
     EXPECT_EQ(NO_ERROR, m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply));
 }
 
+TEST_F(BinderLibTest, TransactionStats) {
+    TransactionStats::reset();
+    TransactionStats::setEnabled(true);
+
+    Parcel data, reply;
+    data.writeInterfaceToken(binderLibTestServiceName);
+    EXPECT_EQ(NO_ERROR, m_server->transact(BINDER_LIB_TEST_GET_ID_TRANSACTION, data, &reply));
+    TransactionStats::setEnabled(false);
+
+    bool found = false;
+    for (const auto& entry : TransactionStats::snapshot()) {
+        if (entry.outgoing && entry.code == BINDER_LIB_TEST_GET_ID_TRANSACTION) {
+            EXPECT_EQ(binderLibTestServiceName, entry.descriptor);
+            EXPECT_EQ(1u, entry.count);
+            found = true;
+        }
+    }
+    EXPECT_TRUE(found);
+    TransactionStats::reset();
+}
+
 TEST_F(BinderLibTest, SetError) {
     int32_t testValue[] = { 0, -123, 123 };
     for (size_t i = 0; i < ARRAY_SIZE(testValue); i++) {
@@ -602,6 +624,68 @@ TEST_F(BinderLibTest, CallBack)
     EXPECT_EQ(NO_ERROR, ret);
 }
 
+TEST_F(BinderLibTest, OnewayBatch)
+{
+    const int kCallBackCount = 8;
+    std::vector<sp<BinderLibTestCallBack>> callBacks;
+    {
+        ScopedOnewayBatch batch;
+        for (int i = 0; i < kCallBackCount; i++) {
+            // The data Parcel goes away before the batch is submitted.
+            Parcel data, reply;
+            sp<BinderLibTestCallBack> callBack = new BinderLibTestCallBack();
+            data.writeStrongBinder(callBack);
+            EXPECT_EQ(NO_ERROR, m_server->transact(BINDER_LIB_TEST_NOP_CALL_BACK, data, &reply,
+                                                   TF_ONE_WAY));
+            callBacks.push_back(callBack);
+        }
+    }
+    for (const auto& callBack : callBacks) {
+        EXPECT_EQ(NO_ERROR, callBack->waitEvent(5));
+        EXPECT_EQ(NO_ERROR, callBack->getResult());
+    }
+}
+
+TEST_F(BinderLibTest, OnewayBatchFlushedBySyncCall)
+{
+    Parcel data, reply;
+    sp<BinderLibTestCallBack> callBack = new BinderLibTestCallBack();
+    data.writeStrongBinder(callBack);
+
+    IPCThreadState::self()->beginOnewayBatch();
+    EXPECT_EQ(NO_ERROR, m_server->transact(BINDER_LIB_TEST_NOP_CALL_BACK, data, &reply,
+                                           TF_ONE_WAY));
+    Parcel data2, reply2;
+    EXPECT_EQ(NO_ERROR, m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data2, &reply2));
+    EXPECT_EQ(NO_ERROR, callBack->waitEvent(5));
+    EXPECT_EQ(NO_ERROR, IPCThreadState::self()->endOnewayBatch());
+}
+
+TEST_F(BinderLibTest, AdaptiveThreadPoolRejectsInvertedRange)
+{
+    sp<ProcessState> proc = ProcessState::self();
+    ProcessState::ThreadPoolStats before = proc->getThreadPoolStats();
+    EXPECT_EQ(BAD_VALUE, proc->setThreadPoolAdaptiveMaxThreadCount(4, 2));
+
+    ProcessState::ThreadPoolStats after = proc->getThreadPoolStats();
+    EXPECT_EQ(before.maxThreads, after.maxThreads);
+    EXPECT_EQ(before.adaptiveMaxThreads, after.adaptiveMaxThreads);
+    EXPECT_LE(after.executingThreads, after.peakExecutingThreads);
+}
+
+TEST_F(BinderLibTest, ServiceLookupCache)
+{
+    sp<IServiceManager> sm = defaultServiceManager();
+    setServiceLookupCacheEnabled(true);
+    sp<IBinder> first = sm->checkService(binderLibTestServiceName);
+    sp<IBinder> second = sm->checkService(binderLibTestServiceName);
+    setServiceLookupCacheEnabled(false);
+
+    ASSERT_NE(nullptr, first);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(nullptr, sm->checkService(String16("test.binderLib.doesNotExist")));
+}
+
 TEST_F(BinderLibTest, AddServer)
 {
     sp<IBinder> server = addServer();
@@ -1096,6 +1180,61 @@ TEST_F(BinderLibTest, VectorSent) {
     EXPECT_EQ(readValue, testValue);
 }
 
+TEST_F(BinderLibTest, VectorWriteReservesOnce) {
+    Parcel data;
+    std::vector<int32_t> const testValue(100000, 7);
+    EXPECT_EQ(NO_ERROR, data.writeInt32Vector(testValue));
+    // The whole vector is sized up front, so no slack is left behind by
+    // intermediate growth steps.
+    EXPECT_EQ(data.dataSize(), data.dataCapacity());
+
+    data.setDataPosition(0);
+    std::vector<int32_t> readValue;
+    EXPECT_EQ(NO_ERROR, data.readInt32Vector(&readValue));
+    EXPECT_EQ(readValue, testValue);
+}
+
+TEST_F(BinderLibTest, LargeParcelGrowsPageAligned) {
+    Parcel data;
+    std::vector<uint8_t> const chunk(16 * 1024, 0xa5);
+    for (int i = 0; i < 16; i++) {
+        ASSERT_EQ(NO_ERROR, data.write(chunk.data(), chunk.size()));
+    }
+    EXPECT_EQ(0u, data.dataCapacity() % 4096);
+    EXPECT_GE(data.dataCapacity(), data.dataSize());
+}
+
+TEST_F(BinderLibTest, ParcelBufferReused) {
+    {
+        Parcel data;
+        data.writeInt32(1);
+    }
+    size_t pooled = Parcel::getGlobalPooledCount();
+    ASSERT_GT(pooled, 0u);
+
+    size_t allocCount = Parcel::getGlobalAllocCount();
+    Parcel data;
+    data.writeInt32(1);
+    EXPECT_EQ(pooled - 1, Parcel::getGlobalPooledCount());
+    EXPECT_EQ(allocCount + 1, Parcel::getGlobalAllocCount());
+}
+
+TEST_F(BinderLibTest, EnforceInterface) {
+    Parcel data;
+    data.writeInterfaceToken(binderLibTestServiceName);
+    data.writeInt32(42);
+
+    data.setDataPosition(0);
+    EXPECT_TRUE(data.enforceInterface(binderLibTestServiceName));
+    EXPECT_EQ(42, data.readInt32());
+
+    data.setDataPosition(0);
+    EXPECT_FALSE(data.enforceInterface(String16("test.binderLib.other")));
+
+    data.setDataPosition(0);
+    EXPECT_FALSE(data.enforceInterface(String16("test.binderLi")));
+}
+
 TEST_F(BinderLibTest, BufRejected) {
     Parcel data, reply;
     uint32_t buf;
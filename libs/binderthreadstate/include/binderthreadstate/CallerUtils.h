@@ -47,4 +47,23 @@ inline static BinderCallType getCurrentServingCall() {
     return BinderCallType::BINDER;
 }
 
+// Same as getCurrentServingCall(), but also returns which transaction is being
+// served when it is a binder call. Unlike getCurrentServingCall(), this never
+// creates the thread state, so that profilers and debuggers may call it from a
+// signal handler on the thread they sample.
+inline static BinderCallType getCurrentServingCall(
+        android::IPCThreadState::ServingCall* outCall) {
+    const android::hardware::IPCThreadState* hwbinderState =
+            android::hardware::IPCThreadState::selfOrNull();
+    const android::IPCThreadState* binderState = android::IPCThreadState::selfOrNull();
+    const void* hwbinderSp = hwbinderState ? hwbinderState->getServingStackPointer() : nullptr;
+    const void* binderSp = binderState ? binderState->getServingStackPointer() : nullptr;
+
+    if (binderSp == nullptr || (hwbinderSp != nullptr && hwbinderSp < binderSp)) {
+        return hwbinderSp == nullptr ? BinderCallType::NONE : BinderCallType::HWBINDER;
+    }
+    if (!binderState->getServingCall(outCall)) return BinderCallType::NONE;
+    return BinderCallType::BINDER;
+}
+
 } // namespace android
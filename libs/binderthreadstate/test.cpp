@@ -28,6 +28,7 @@ using android::BinderCallType;
 using android::defaultServiceManager;
 using android::getCurrentServingCall;
 using android::getService;
+using android::IPCThreadState;
 using android::OK;
 using android::sp;
 using android::String16;
@@ -86,6 +87,8 @@ public:
         LOG(INFO) << "HidlServer CALL " << thisId << " to " << otherId << " at idx: " << idx
                   << " with tid: " << gettid();
         CHECK(BinderCallType::HWBINDER == getCurrentServingCall());
+        IPCThreadState::ServingCall servingCall;
+        CHECK(BinderCallType::HWBINDER == getCurrentServingCall(&servingCall));
         if (idx > 0) {
             if (thisId == kP1Id && idx % 4 < 2) {
                 callHidl(otherId, idx - 1);
@@ -105,12 +108,20 @@ public:
 
     Status callLocal() {
         CHECK(BinderCallType::NONE == getCurrentServingCall());
+        IPCThreadState::ServingCall servingCall;
+        CHECK(BinderCallType::NONE == getCurrentServingCall(&servingCall));
         return Status::ok();
     }
     Status call(int32_t idx) {
         LOG(INFO) << "AidlServer CALL " << thisId << " to " << otherId << " at idx: " << idx
                   << " with tid: " << gettid();
         CHECK(BinderCallType::BINDER == getCurrentServingCall());
+        IPCThreadState::ServingCall servingCall;
+        CHECK(BinderCallType::BINDER == getCurrentServingCall(&servingCall));
+        CHECK(this == servingCall.target);
+        CHECK(android::IBinder::FIRST_CALL_TRANSACTION + 1 == servingCall.code);
+        CHECK(getuid() == servingCall.callingUid);
+        CHECK(servingCall.startTime <= systemTime(SYSTEM_TIME_MONOTONIC));
         if (idx > 0) {
             if (thisId == kP2Id && idx % 4 < 2) {
                 callHidl(otherId, idx - 1);
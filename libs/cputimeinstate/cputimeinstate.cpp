@@ -24,6 +24,7 @@
 #include <inttypes.h>
 #include <sys/sysinfo.h>
 
+#include <algorithm>
 #include <mutex>
 #include <numeric>
 #include <optional>
@@ -60,6 +61,22 @@ static unique_fd gTisMapFd;
 static unique_fd gConcurrentMapFd;
 static unique_fd gUidLastUpdateMapFd;
 
+// Per-process times are only recorded for the thread groups in the pid_tracked map, so that the
+// BPF program does no extra work for processes nobody asked about. The pid_time_in_state map is an
+// LRU map, so that the entries of processes that exited without being untracked age out instead of
+// filling it up. Both maps are optional, since older BPF programs don't have them.
+//
+// The key of the pid_time_in_state map; its values are tis_val_t's, like the uid_time_in_state
+// map's.
+struct pid_time_key_t {
+    uint32_t tgid;
+    uint32_t bucket;
+};
+static std::mutex gPidMapsMutex;
+static bool gPidMapsInitialized = false;
+static unique_fd gPidTrackedMapFd;
+static unique_fd gPidTisMapFd;
+
 static std::optional<std::vector<uint32_t>> readNumbersFromFile(const std::string &path) {
     std::string data;
 
@@ -231,14 +248,9 @@ std::optional<std::vector<std::vector<uint32_t>>> getCpuFreqs() {
     return gPolicyFreqs;
 }
 
-// Retrieve the times in ns that uid spent running at each CPU frequency.
-// Return contains no value on error, otherwise it contains a vector of vectors using the format:
-// [[t0_0, t0_1, ...],
-//  [t1_0, t1_1, ...], ...]
-// where ti_j is the ns that uid spent running on the ith cluster at that cluster's jth lowest freq.
-std::optional<std::vector<std::vector<uint64_t>>> getUidCpuFreqTimes(uint32_t uid) {
-    if (!gInitialized && !initGlobals()) return {};
-
+// Sum the per-cpu times of every bucket of key in mapFd, which holds tis_val_t's.
+template <typename Key>
+static std::optional<std::vector<std::vector<uint64_t>>> readCpuFreqTimes(const unique_fd &mapFd, Key key) {
     std::vector<std::vector<uint64_t>> out;
     uint32_t maxFreqCount = 0;
     for (const auto &freqList : gPolicyFreqs) {
@@ -247,10 +259,9 @@ std::optional<std::vector<std::vector<uint64_t>>> getUidCpuFreqTimes(uint32_t ui
     }
 
     std::vector<tis_val_t> vals(gNCpus);
-    time_key_t key = {.uid = uid};
     for (uint32_t i = 0; i <= (maxFreqCount - 1) / FREQS_PER_ENTRY; ++i) {
         key.bucket = i;
-        if (findMapEntry(gTisMapFd, &key, vals.data())) {
+        if (findMapEntry(mapFd, &key, vals.data())) {
             if (errno != ENOENT) return {};
             continue;
         }
@@ -271,6 +282,16 @@ std::optional<std::vector<std::vector<uint64_t>>> getUidCpuFreqTimes(uint32_t ui
     return out;
 }
 
+// Retrieve the times in ns that uid spent running at each CPU frequency.
+// Return contains no value on error, otherwise it contains a vector of vectors using the format:
+// [[t0_0, t0_1, ...],
+//  [t1_0, t1_1, ...], ...]
+// where ti_j is the ns that uid spent running on the ith cluster at that cluster's jth lowest freq.
+std::optional<std::vector<std::vector<uint64_t>>> getUidCpuFreqTimes(uint32_t uid) {
+    if (!gInitialized && !initGlobals()) return {};
+    return readCpuFreqTimes(gTisMapFd, time_key_t{.uid = uid});
+}
+
 static std::optional<bool> uidUpdatedSince(uint32_t uid, uint64_t lastUpdate,
                                            uint64_t *newLastUpdate) {
     uint64_t uidLastUpdate;
@@ -467,6 +488,225 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsUpdatedCon
     return ret;
 }
 
+// Collect the sorted uids that have entries in mapFd, excluding those that have not run since
+// before *lastUpdate if lastUpdate is not null.
+static bool collectUpdatedUids(const unique_fd &mapFd, uint64_t *lastUpdate,
+                               uint64_t *newLastUpdate, std::vector<uint32_t> *uids) {
+    uids->clear();
+    time_key_t key, prevKey;
+    if (getFirstMapKey(mapFd, &key)) return errno == ENOENT;
+    do {
+        // Most uids only have one bucket, so this usually skips other buckets of the same uid.
+        if (!uids->empty() && uids->back() == key.uid) continue;
+        if (lastUpdate) {
+            auto uidUpdated = uidUpdatedSince(key.uid, *lastUpdate, newLastUpdate);
+            if (!uidUpdated.has_value()) return false;
+            if (!*uidUpdated) continue;
+        }
+        uids->push_back(key.uid);
+    } while (prevKey = key, !getNextMapKey(mapFd, &prevKey, &key));
+    if (errno != ENOENT) return false;
+    std::sort(uids->begin(), uids->end());
+    uids->erase(std::unique(uids->begin(), uids->end()), uids->end());
+    return true;
+}
+
+static std::optional<size_t> findUidSlot(const std::vector<uint32_t> &uids, uint32_t uid) {
+    auto it = std::lower_bound(uids.begin(), uids.end(), uid);
+    if (it == uids.end() || *it != uid) return {};
+    return it - uids.begin();
+}
+
+// Like getUidsUpdatedCpuFreqTimes, but writes to a flat buffer that can be reused across calls so
+// that periodic reads don't allocate. The map is walked twice: once to find the uids, and once to
+// read their times. Uids that show up in between are left for the next read.
+// Returns false on error.
+bool readUidsUpdatedCpuFreqTimes(uint64_t *lastUpdate, uid_cpu_freq_times_t *out) {
+    if (!gInitialized && !initGlobals()) return false;
+
+    uint64_t newLastUpdate = lastUpdate ? *lastUpdate : 0;
+    if (!collectUpdatedUids(gTisMapFd, lastUpdate, &newLastUpdate, &out->uids)) return false;
+
+    out->stride = 0;
+    for (const auto &freqList : gPolicyFreqs) out->stride += freqList.size();
+    out->times.assign(out->uids.size() * out->stride, 0);
+    if (out->uids.empty()) return true;
+
+    time_key_t key, prevKey;
+    if (getFirstMapKey(gTisMapFd, &key)) return errno == ENOENT;
+    std::vector<tis_val_t> vals(gNCpus);
+    do {
+        auto slot = findUidSlot(out->uids, key.uid);
+        if (!slot.has_value()) continue;
+        if (findMapEntry(gTisMapFd, &key, vals.data())) {
+            if (errno == ENOENT) continue;
+            return false;
+        }
+
+        auto uidTimes = out->times.begin() + *slot * out->stride;
+        auto offset = key.bucket * FREQS_PER_ENTRY;
+        auto nextOffset = (key.bucket + 1) * FREQS_PER_ENTRY;
+        for (uint32_t i = 0; i < gNPolicies; ++i) {
+            auto policyTimes = uidTimes;
+            uidTimes += gPolicyFreqs[i].size();
+            if (offset >= gPolicyFreqs[i].size()) continue;
+            auto begin = policyTimes + offset;
+            auto end = nextOffset < gPolicyFreqs[i].size() ? begin + FREQS_PER_ENTRY : uidTimes;
+            for (const auto &cpu : gPolicyCpus[i]) {
+                std::transform(begin, end, std::begin(vals[cpu].ar), begin, std::plus<uint64_t>());
+            }
+        }
+    } while (prevKey = key, !getNextMapKey(gTisMapFd, &prevKey, &key));
+    if (errno != ENOENT) return false;
+    if (lastUpdate && newLastUpdate > *lastUpdate) *lastUpdate = newLastUpdate;
+    return true;
+}
+
+// Like getUidsUpdatedConcurrentTimes, but writes to a flat buffer that can be reused across calls.
+// See readUidsUpdatedCpuFreqTimes. Returns false on error.
+bool readUidsUpdatedConcurrentTimes(uint64_t *lastUpdate, uid_concurrent_times_t *out) {
+    if (!gInitialized && !initGlobals()) return false;
+
+    uint64_t newLastUpdate = lastUpdate ? *lastUpdate : 0;
+    if (!collectUpdatedUids(gConcurrentMapFd, lastUpdate, &newLastUpdate, &out->uids)) {
+        return false;
+    }
+
+    out->activeStride = gNCpus;
+    out->policyStride = 0;
+    for (const auto &cpuList : gPolicyCpus) out->policyStride += cpuList.size();
+    out->active.assign(out->uids.size() * out->activeStride, 0);
+    out->policy.assign(out->uids.size() * out->policyStride, 0);
+    if (out->uids.empty()) return true;
+
+    time_key_t key, prevKey;
+    if (getFirstMapKey(gConcurrentMapFd, &key)) return errno == ENOENT;
+    std::vector<concurrent_val_t> vals(gNCpus);
+    do {
+        auto slot = findUidSlot(out->uids, key.uid);
+        if (!slot.has_value()) continue;
+        if (findMapEntry(gConcurrentMapFd, &key, vals.data())) {
+            if (errno == ENOENT) continue;
+            return false;
+        }
+
+        auto offset = key.bucket * CPUS_PER_ENTRY;
+        auto nextOffset = (key.bucket + 1) * CPUS_PER_ENTRY;
+
+        auto uidActive = out->active.begin() + *slot * out->activeStride;
+        if (offset < gNCpus) {
+            auto activeBegin = uidActive + offset;
+            auto activeEnd = nextOffset < gNCpus ? activeBegin + CPUS_PER_ENTRY
+                                                 : uidActive + out->activeStride;
+            for (uint32_t cpu = 0; cpu < gNCpus; ++cpu) {
+                std::transform(activeBegin, activeEnd, std::begin(vals[cpu].active), activeBegin,
+                               std::plus<uint64_t>());
+            }
+        }
+
+        auto uidPolicy = out->policy.begin() + *slot * out->policyStride;
+        for (uint32_t policy = 0; policy < gNPolicies; ++policy) {
+            auto policyTimes = uidPolicy;
+            uidPolicy += gPolicyCpus[policy].size();
+            if (offset >= gPolicyCpus[policy].size()) continue;
+            auto policyBegin = policyTimes + offset;
+            auto policyEnd = nextOffset < gPolicyCpus[policy].size() ? policyBegin + CPUS_PER_ENTRY
+                                                                     : uidPolicy;
+            for (const auto &cpu : gPolicyCpus[policy]) {
+                std::transform(policyBegin, policyEnd, std::begin(vals[cpu].policy), policyBegin,
+                               std::plus<uint64_t>());
+            }
+        }
+    } while (prevKey = key, !getNextMapKey(gConcurrentMapFd, &prevKey, &key));
+    if (errno != ENOENT) return false;
+
+    // As in getUidsUpdatedConcurrentTimes, reread the uids whose times were caught mid-update.
+    for (size_t slot = 0; slot < out->uids.size(); ++slot) {
+        auto active = out->active.begin() + slot * out->activeStride;
+        auto policy = out->policy.begin() + slot * out->policyStride;
+        uint64_t activeSum = std::accumulate(active, active + out->activeStride, (uint64_t)0);
+        uint64_t policySum = std::accumulate(policy, policy + out->policyStride, (uint64_t)0);
+        if (activeSum == policySum) continue;
+
+        auto val = getUidConcurrentTimes(out->uids[slot], false);
+        if (!val.has_value()) continue;
+        std::copy(val->active.begin(), val->active.end(), active);
+        for (const auto &vec : val->policy) policy = std::copy(vec.begin(), vec.end(), policy);
+    }
+    if (lastUpdate && newLastUpdate > *lastUpdate) *lastUpdate = newLastUpdate;
+    return true;
+}
+
+static bool initPidMaps() {
+    std::lock_guard<std::mutex> guard(gPidMapsMutex);
+    if (gPidMapsInitialized) return true;
+
+    gPidTrackedMapFd = unique_fd{bpf_obj_get(BPF_FS_PATH "map_time_in_state_pid_tracked_map")};
+    if (gPidTrackedMapFd < 0) return false;
+
+    gPidTisMapFd = unique_fd{bpf_obj_get(BPF_FS_PATH "map_time_in_state_pid_time_in_state_map")};
+    if (gPidTisMapFd < 0) return false;
+
+    gPidMapsInitialized = true;
+    return true;
+}
+
+// Start recording the times the thread group of pid spends at each CPU frequency, to be reported
+// by getPidsCpuFreqTimes. startTrackingUidTimes must have been called.
+// Returns false on error, or if the BPF program doesn't support per-process tracking.
+bool startTrackingProcessCpuTimes(pid_t pid) {
+    if (!gInitialized && !initGlobals()) return false;
+    if (!gPidMapsInitialized && !initPidMaps()) return false;
+
+    uint32_t tgid = pid;
+    uint8_t tracked = 1;
+    return writeToMapEntry(gPidTrackedMapFd, &tgid, &tracked, BPF_ANY) == 0;
+}
+
+// Stop recording the times of the thread group of pid, and drop the times recorded so far.
+// Returns false on error.
+bool stopTrackingProcessCpuTimes(pid_t pid) {
+    if (!gInitialized && !initGlobals()) return false;
+    if (!gPidMapsInitialized && !initPidMaps()) return false;
+
+    uint32_t tgid = pid;
+    if (deleteMapEntry(gPidTrackedMapFd, &tgid) && errno != ENOENT) return false;
+
+    uint32_t maxFreqCount = 0;
+    for (const auto &freqList : gPolicyFreqs) {
+        if (freqList.size() > maxFreqCount) maxFreqCount = freqList.size();
+    }
+    pid_time_key_t key = {.tgid = tgid};
+    for (key.bucket = 0; key.bucket <= (maxFreqCount - 1) / FREQS_PER_ENTRY; ++key.bucket) {
+        if (deleteMapEntry(gPidTisMapFd, &key) && errno != ENOENT) return false;
+    }
+    return true;
+}
+
+// Retrieve the times in ns that each of the tracked thread groups in pids spent running at each
+// CPU freq.
+// Return contains no value on error, otherwise it contains a map from pids to vectors of vectors,
+// in the same format as getUidsCpuFreqTimes(). Pids that are not tracked are left out.
+std::optional<std::unordered_map<pid_t, std::vector<std::vector<uint64_t>>>>
+getPidsCpuFreqTimes(const std::vector<pid_t> &pids) {
+    if (!gInitialized && !initGlobals()) return {};
+    if (!gPidMapsInitialized && !initPidMaps()) return {};
+
+    std::unordered_map<pid_t, std::vector<std::vector<uint64_t>>> map;
+    for (pid_t pid : pids) {
+        uint32_t tgid = pid;
+        uint8_t tracked;
+        if (findMapEntry(gPidTrackedMapFd, &tgid, &tracked)) {
+            if (errno != ENOENT) return {};
+            continue;
+        }
+        auto times = readCpuFreqTimes(gPidTisMapFd, pid_time_key_t{.tgid = tgid});
+        if (!times.has_value()) return {};
+        map.emplace(pid, std::move(*times));
+    }
+    return map;
+}
+
 // Clear all time in state data for a given uid. Returns false on error, true otherwise.
 // This is only suitable for clearing data when an app is uninstalled; if called on a UID with
 // running tasks it will cause time in state vs. concurrent time totals to be inconsistent for that
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <sys/types.h>
+
 #include <unordered_map>
 #include <vector>
 
@@ -41,5 +43,31 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>>
     getUidsUpdatedConcurrentTimes(uint64_t *lastUpdate);
 bool clearUidTimes(unsigned int uid);
 
+bool startTrackingProcessCpuTimes(pid_t pid);
+bool stopTrackingProcessCpuTimes(pid_t pid);
+std::optional<std::unordered_map<pid_t, std::vector<std::vector<uint64_t>>>>
+    getPidsCpuFreqTimes(const std::vector<pid_t> &pids);
+
+// Flat outputs for reading the times of all uids periodically. uids is sorted, and the times of
+// uids[i] start at index i * stride. Reading into the same struct again reuses its storage.
+struct uid_cpu_freq_times_t {
+    std::vector<uint32_t> uids;
+    // The times at each frequency of policy 0, then of policy 1, ...
+    std::vector<uint64_t> times;
+    size_t stride = 0;
+};
+
+struct uid_concurrent_times_t {
+    std::vector<uint32_t> uids;
+    std::vector<uint64_t> active;
+    size_t activeStride = 0;
+    // The times of policy 0, then of policy 1, ...
+    std::vector<uint64_t> policy;
+    size_t policyStride = 0;
+};
+
+bool readUidsUpdatedCpuFreqTimes(uint64_t *lastUpdate, uid_cpu_freq_times_t *out);
+bool readUidsUpdatedConcurrentTimes(uint64_t *lastUpdate, uid_concurrent_times_t *out);
+
 } // namespace bpf
 } // namespace android
@@ -18,7 +18,9 @@
 #include <bpf_timeinstate.h>
 
 #include <sys/sysinfo.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <numeric>
 #include <unordered_map>
 #include <vector>
@@ -261,6 +263,60 @@ TEST(TimeInStateTest, AllUidUpdatedConcurrentTimes) {
     }
 }
 
+TEST(TimeInStateTest, FlatAllUidTimeInStateConsistent) {
+    auto map = getUidsCpuFreqTimes();
+    ASSERT_TRUE(map.has_value());
+
+    uid_cpu_freq_times_t flat;
+    ASSERT_TRUE(readUidsUpdatedCpuFreqTimes(nullptr, &flat));
+    ASSERT_FALSE(flat.uids.empty());
+    ASSERT_TRUE(std::is_sorted(flat.uids.begin(), flat.uids.end()));
+    ASSERT_EQ(flat.uids.size() * flat.stride, flat.times.size());
+
+    for (size_t slot = 0; slot < flat.uids.size(); ++slot) {
+        auto it = map->find(flat.uids[slot]);
+        // The uid may have started running after the first read.
+        if (it == map->end()) continue;
+        vector<vector<uint64_t>> times;
+        auto begin = flat.times.begin() + slot * flat.stride;
+        for (const auto &policyTimes : it->second) {
+            times.emplace_back(begin, begin + policyTimes.size());
+            begin += policyTimes.size();
+        }
+        ASSERT_NO_FATAL_FAILURE(TestCheckUpdate(it->second, times));
+    }
+}
+
+TEST(TimeInStateTest, FlatAllUidUpdatedConcurrentTimes) {
+    uint64_t lastUpdate = 0;
+    uid_concurrent_times_t flat;
+    ASSERT_TRUE(readUidsUpdatedConcurrentTimes(&lastUpdate, &flat));
+    ASSERT_FALSE(flat.uids.empty());
+    ASSERT_NE(lastUpdate, (uint64_t)0);
+    size_t allUids = flat.uids.size();
+
+    for (size_t slot = 0; slot < flat.uids.size(); ++slot) {
+        auto active = flat.active.begin() + slot * flat.activeStride;
+        auto policy = flat.policy.begin() + slot * flat.policyStride;
+        ASSERT_EQ(std::accumulate(active, active + flat.activeStride, (uint64_t)0),
+                  std::accumulate(policy, policy + flat.policyStride, (uint64_t)0));
+    }
+
+    // Sleep briefly to trigger a context switch, ensuring we see at least one update.
+    struct timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = 1000000;
+    nanosleep (&ts, NULL);
+
+    uint64_t oldLastUpdate = lastUpdate;
+    ASSERT_TRUE(readUidsUpdatedConcurrentTimes(&lastUpdate, &flat));
+    ASSERT_FALSE(flat.uids.empty());
+    ASSERT_LT(flat.uids.size(), allUids);
+    ASSERT_NE(lastUpdate, oldLastUpdate);
+    ASSERT_EQ(flat.uids.size() * flat.activeStride, flat.active.size());
+    ASSERT_EQ(flat.uids.size() * flat.policyStride, flat.policy.size());
+}
+
 TEST(TimeInStateTest, SingleAndAllUidConcurrentTimesConsistent) {
     uint64_t zero = 0;
     auto maps = {getUidsConcurrentTimes(), getUidsUpdatedConcurrentTimes(&zero)};
@@ -471,6 +527,36 @@ TEST(TimeInStateTest, RemoveUid) {
     ASSERT_EQ(allConcurrentTimes->find(uid), allConcurrentTimes->end());
 }
 
+TEST(TimeInStateTest, TrackedProcessTimeInState) {
+    pid_t pid = getpid();
+    ASSERT_TRUE(startTrackingProcessCpuTimes(pid));
+
+    // Spin briefly so that the process has some time to report.
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * NSEC_PER_SEC + now.tv_nsec - start.tv_nsec <
+             NSEC_PER_SEC / 10);
+    // Switch out, so that the time spinning gets recorded.
+    usleep(1000);
+
+    auto map = getPidsCpuFreqTimes({pid, 0});
+    ASSERT_TRUE(map.has_value());
+    ASSERT_EQ(map->size(), 1u);
+    ASSERT_NE(map->find(pid), map->end());
+    uint64_t total = 0;
+    for (const auto &policyTimes : (*map)[pid]) {
+        total += std::accumulate(policyTimes.begin(), policyTimes.end(), (uint64_t)0);
+    }
+    ASSERT_GT(total, (uint64_t)0);
+
+    ASSERT_TRUE(stopTrackingProcessCpuTimes(pid));
+    map = getPidsCpuFreqTimes({pid});
+    ASSERT_TRUE(map.has_value());
+    ASSERT_TRUE(map->empty());
+}
+
 TEST(TimeInStateTest, GetCpuFreqs) {
     auto freqs = getCpuFreqs();
     ASSERT_TRUE(freqs.has_value());
@@ -17,7 +17,13 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <diskusage/dirsize.h>
@@ -69,3 +75,450 @@ int64_t calculate_dir_size(int dfd)
     closedir(d);
     return size;
 }
+
+/*
+ * Parallel variant.
+ *
+ * Every worker owns a deque of open directories. It pushes the subdirectories
+ * it finds to the back of its own deque and takes work from the back too, so
+ * that it mostly walks depth first, and idle workers steal from the front of
+ * the other deques. Once MAX_QUEUED_DIRS directories are queued, subdirectories
+ * are walked in place instead, which bounds the number of open descriptors.
+ */
+
+#define MAX_QUEUED_DIRS 256
+#define DIRENT_BUFFER_SIZE (32 * 1024)
+#define CACHE_INITIAL_BUCKETS 256
+
+struct dirsize_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+struct dir_size_cache_entry {
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    /* The getdents64 records of the directory, back to back. */
+    char *records;
+    size_t length;
+    struct dir_size_cache_entry *next;
+};
+
+struct dir_size_cache {
+    pthread_mutex_t lock;
+    struct dir_size_cache_entry **buckets;
+    size_t bucket_count;
+    size_t entry_count;
+};
+
+struct dir_walk;
+
+struct dir_worker {
+    struct dir_walk *walk;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int fds[MAX_QUEUED_DIRS];
+    size_t head;
+    size_t count;
+    int64_t size;
+};
+
+struct dir_walk {
+    struct dir_worker *workers;
+    int worker_count;
+    struct dir_size_cache *cache;
+    /* Directories sitting in a deque. */
+    atomic_int queued;
+    /* Directories queued or being walked; the walk is done when it drops to 0. */
+    atomic_int pending;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+struct dir_size_cache *dir_size_cache_create(void)
+{
+    struct dir_size_cache *cache = calloc(1, sizeof(*cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->buckets = calloc(CACHE_INITIAL_BUCKETS, sizeof(*cache->buckets));
+    if (cache->buckets == NULL) {
+        free(cache);
+        return NULL;
+    }
+    cache->bucket_count = CACHE_INITIAL_BUCKETS;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void dir_size_cache_destroy(struct dir_size_cache *cache)
+{
+    size_t i;
+    if (cache == NULL) {
+        return;
+    }
+    for (i = 0; i < cache->bucket_count; i++) {
+        struct dir_size_cache_entry *entry = cache->buckets[i];
+        while (entry != NULL) {
+            struct dir_size_cache_entry *next = entry->next;
+            free(entry->records);
+            free(entry);
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+static size_t cache_bucket(size_t bucket_count, dev_t dev, ino_t ino)
+{
+    uint64_t hash = ((uint64_t) dev * 0x9e3779b97f4a7c15ULL) ^ (uint64_t) ino;
+    hash ^= hash >> 29;
+    return (size_t) (hash % bucket_count);
+}
+
+static void cache_grow(struct dir_size_cache *cache)
+{
+    size_t new_count = cache->bucket_count * 2;
+    struct dir_size_cache_entry **buckets = calloc(new_count, sizeof(*buckets));
+    size_t i;
+    if (buckets == NULL) {
+        return;
+    }
+    for (i = 0; i < cache->bucket_count; i++) {
+        struct dir_size_cache_entry *entry = cache->buckets[i];
+        while (entry != NULL) {
+            struct dir_size_cache_entry *next = entry->next;
+            size_t b = cache_bucket(new_count, entry->dev, entry->ino);
+            entry->next = buckets[b];
+            buckets[b] = entry;
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_count = new_count;
+}
+
+/* Returns a copy of the cached records of a directory if it did not change. */
+static char *cache_lookup(struct dir_size_cache *cache, const struct stat *s, size_t *length)
+{
+    struct dir_size_cache_entry *entry;
+    char *records = NULL;
+
+    pthread_mutex_lock(&cache->lock);
+    for (entry = cache->buckets[cache_bucket(cache->bucket_count, s->st_dev, s->st_ino)];
+            entry != NULL; entry = entry->next) {
+        if (entry->dev == s->st_dev && entry->ino == s->st_ino) {
+            if (entry->mtime.tv_sec == s->st_mtim.tv_sec
+                    && entry->mtime.tv_nsec == s->st_mtim.tv_nsec) {
+                records = malloc(entry->length ? entry->length : 1);
+                if (records != NULL) {
+                    memcpy(records, entry->records, entry->length);
+                    *length = entry->length;
+                }
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return records;
+}
+
+/* Takes ownership of records. */
+static void cache_store(struct dir_size_cache *cache, const struct stat *s, char *records,
+        size_t length)
+{
+    struct dir_size_cache_entry *entry;
+    size_t b;
+
+    pthread_mutex_lock(&cache->lock);
+    b = cache_bucket(cache->bucket_count, s->st_dev, s->st_ino);
+    for (entry = cache->buckets[b]; entry != NULL; entry = entry->next) {
+        if (entry->dev == s->st_dev && entry->ino == s->st_ino) {
+            break;
+        }
+    }
+    if (entry == NULL) {
+        entry = calloc(1, sizeof(*entry));
+        if (entry == NULL) {
+            pthread_mutex_unlock(&cache->lock);
+            free(records);
+            return;
+        }
+        entry->dev = s->st_dev;
+        entry->ino = s->st_ino;
+        entry->next = cache->buckets[b];
+        cache->buckets[b] = entry;
+        if (++cache->entry_count > cache->bucket_count * 2) {
+            cache_grow(cache);
+        }
+    }
+    free(entry->records);
+    entry->records = records;
+    entry->length = length;
+    entry->mtime = s->st_mtim;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/*
+ * A directory changed less than this long ago may change again within the
+ * same timestamp tick, and is not cached.
+ */
+static int is_settled(const struct stat *s)
+{
+    struct timespec now;
+    if (clock_gettime(CLOCK_REALTIME, &now) != 0) {
+        return 0;
+    }
+    return now.tv_sec - s->st_mtim.tv_sec > 1;
+}
+
+static int push_dir(struct dir_worker *w, int fd)
+{
+    struct dir_walk *walk = w->walk;
+    if (atomic_load(&walk->queued) >= MAX_QUEUED_DIRS) {
+        return 0;
+    }
+    pthread_mutex_lock(&w->lock);
+    if (w->count == MAX_QUEUED_DIRS) {
+        pthread_mutex_unlock(&w->lock);
+        return 0;
+    }
+    atomic_fetch_add(&walk->pending, 1);
+    w->fds[(w->head + w->count) % MAX_QUEUED_DIRS] = fd;
+    w->count++;
+    pthread_mutex_unlock(&w->lock);
+
+    atomic_fetch_add(&walk->queued, 1);
+    pthread_mutex_lock(&walk->lock);
+    pthread_cond_signal(&walk->cond);
+    pthread_mutex_unlock(&walk->lock);
+    return 1;
+}
+
+static int pop_dir(struct dir_worker *w)
+{
+    int fd = -1;
+    pthread_mutex_lock(&w->lock);
+    if (w->count > 0) {
+        w->count--;
+        fd = w->fds[(w->head + w->count) % MAX_QUEUED_DIRS];
+    }
+    pthread_mutex_unlock(&w->lock);
+    return fd;
+}
+
+static int steal_dir(struct dir_worker *thief)
+{
+    struct dir_walk *walk = thief->walk;
+    int start = (int) (thief - walk->workers);
+    int i;
+    for (i = 1; i < walk->worker_count; i++) {
+        struct dir_worker *victim = &walk->workers[(start + i) % walk->worker_count];
+        int fd = -1;
+        pthread_mutex_lock(&victim->lock);
+        if (victim->count > 0) {
+            fd = victim->fds[victim->head];
+            victim->head = (victim->head + 1) % MAX_QUEUED_DIRS;
+            victim->count--;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if (fd >= 0) {
+            return fd;
+        }
+    }
+    return -1;
+}
+
+static void walk_dir(struct dir_worker *w, int dfd);
+
+static void walk_records(struct dir_worker *w, int dfd, const char *records, size_t length)
+{
+    size_t offset = 0;
+    struct stat s;
+
+    while (offset < length) {
+        const struct dirsize_dirent64 *de =
+                (const struct dirsize_dirent64 *) (records + offset);
+        const char *name = de->d_name;
+        offset += de->d_reclen;
+
+        if (de->d_type == DT_DIR) {
+            int subfd;
+
+            /* always skip "." and ".." */
+            if (name[0] == '.') {
+                if (name[1] == 0)
+                    continue;
+                if ((name[1] == '.') && (name[2] == 0))
+                    continue;
+            }
+
+            if (fstatat(dfd, name, &s, AT_SYMLINK_NOFOLLOW) == 0) {
+                w->size += stat_size(&s);
+            }
+            subfd = openat(dfd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (subfd >= 0 && !push_dir(w, subfd)) {
+                walk_dir(w, subfd);
+            }
+        } else {
+            if (fstatat(dfd, name, &s, AT_SYMLINK_NOFOLLOW) == 0) {
+                w->size += stat_size(&s);
+            }
+        }
+    }
+}
+
+/* Adds the size of everything under dfd to the worker, and closes dfd. */
+static void walk_dir(struct dir_worker *w, int dfd)
+{
+    struct dir_size_cache *cache = w->walk->cache;
+    struct stat s;
+    char *records = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    char *buffer;
+    int cacheable = 0;
+    long n;
+
+    if (cache != NULL && fstat(dfd, &s) == 0) {
+        records = cache_lookup(cache, &s, &length);
+        if (records != NULL) {
+            walk_records(w, dfd, records, length);
+            free(records);
+            close(dfd);
+            return;
+        }
+        cacheable = is_settled(&s);
+    }
+
+    buffer = malloc(DIRENT_BUFFER_SIZE);
+    if (buffer == NULL) {
+        close(dfd);
+        return;
+    }
+    while ((n = syscall(SYS_getdents64, dfd, buffer, DIRENT_BUFFER_SIZE)) > 0) {
+        if (cacheable) {
+            if (length + n > capacity) {
+                size_t new_capacity = capacity ? capacity * 2 : DIRENT_BUFFER_SIZE;
+                char *grown;
+                while (new_capacity < length + n) {
+                    new_capacity *= 2;
+                }
+                grown = realloc(records, new_capacity);
+                if (grown == NULL) {
+                    free(records);
+                    records = NULL;
+                    cacheable = 0;
+                } else {
+                    records = grown;
+                    capacity = new_capacity;
+                }
+            }
+            if (cacheable) {
+                memcpy(records + length, buffer, n);
+                length += n;
+            }
+        }
+        walk_records(w, dfd, buffer, n);
+    }
+    free(buffer);
+    if (cacheable && n == 0) {
+        cache_store(cache, &s, records, length);
+    } else {
+        free(records);
+    }
+    close(dfd);
+}
+
+static void *worker_loop(void *arg)
+{
+    struct dir_worker *w = arg;
+    struct dir_walk *walk = w->walk;
+
+    for (;;) {
+        int fd = pop_dir(w);
+        int done;
+        if (fd < 0) {
+            fd = steal_dir(w);
+        }
+        if (fd >= 0) {
+            atomic_fetch_sub(&walk->queued, 1);
+            walk_dir(w, fd);
+            if (atomic_fetch_sub(&walk->pending, 1) == 1) {
+                pthread_mutex_lock(&walk->lock);
+                pthread_cond_broadcast(&walk->cond);
+                pthread_mutex_unlock(&walk->lock);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&walk->lock);
+        while (atomic_load(&walk->queued) <= 0 && atomic_load(&walk->pending) > 0) {
+            pthread_cond_wait(&walk->cond, &walk->lock);
+        }
+        done = atomic_load(&walk->pending) == 0;
+        pthread_mutex_unlock(&walk->lock);
+        if (done) {
+            return NULL;
+        }
+    }
+}
+
+int64_t calculate_dir_size_parallel(int dfd, int threads, struct dir_size_cache *cache)
+{
+    struct dir_walk walk;
+    int64_t size = 0;
+    int started;
+    int i;
+
+    if (threads < 1) {
+        threads = 1;
+    }
+    memset(&walk, 0, sizeof(walk));
+    walk.workers = calloc(threads, sizeof(*walk.workers));
+    if (walk.workers == NULL) {
+        close(dfd);
+        return 0;
+    }
+    walk.worker_count = threads;
+    walk.cache = cache;
+    atomic_init(&walk.queued, 0);
+    atomic_init(&walk.pending, 1);
+    pthread_mutex_init(&walk.lock, NULL);
+    pthread_cond_init(&walk.cond, NULL);
+    for (i = 0; i < threads; i++) {
+        walk.workers[i].walk = &walk;
+        pthread_mutex_init(&walk.workers[i].lock, NULL);
+    }
+
+    /* The calling thread is the first worker, and starts with dfd. */
+    walk.workers[0].fds[0] = dfd;
+    walk.workers[0].count = 1;
+    atomic_store(&walk.queued, 1);
+    for (started = 1; started < threads; started++) {
+        if (pthread_create(&walk.workers[started].thread, NULL, worker_loop,
+                &walk.workers[started]) != 0) {
+            break;
+        }
+    }
+    worker_loop(&walk.workers[0]);
+    for (i = 1; i < started; i++) {
+        pthread_join(walk.workers[i].thread, NULL);
+    }
+
+    for (i = 0; i < threads; i++) {
+        size += walk.workers[i].size;
+        pthread_mutex_destroy(&walk.workers[i].lock);
+    }
+    pthread_cond_destroy(&walk.cond);
+    pthread_mutex_destroy(&walk.lock);
+    free(walk.workers);
+    return size;
+}
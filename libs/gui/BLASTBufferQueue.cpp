@@ -25,6 +25,7 @@
 
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 
 using namespace std::chrono_literals;
@@ -153,21 +154,31 @@ void BLASTBufferQueue::transactionCallback(nsecs_t /*latchTime*/, const sp<Fence
     std::unique_lock _lock{mMutex};
     ATRACE_CALL();
 
-    if (!stats.empty()) {
-        mTransformHint = stats[0].transformHint;
+    // A batched transaction reports every surface in the batch; only ours
+    // matters here. Fall back to the first entry if our surface isn't listed.
+    const SurfaceControlStats* ours = stats.empty() ? nullptr : &stats[0];
+    for (const auto& stat : stats) {
+        if (SurfaceControl::isSameSurface(stat.surfaceControl, mSurfaceControl)) {
+            ours = &stat;
+            break;
+        }
+    }
+
+    if (ours != nullptr) {
+        mTransformHint = ours->transformHint;
         mBufferItemConsumer->setTransformHint(mTransformHint);
-        mBufferItemConsumer->updateFrameTimestamps(stats[0].frameEventStats.frameNumber,
-                                                   stats[0].frameEventStats.refreshStartTime,
-                                                   stats[0].frameEventStats.gpuCompositionDoneFence,
-                                                   stats[0].presentFence,
-                                                   stats[0].previousReleaseFence,
-                                                   stats[0].frameEventStats.compositorTiming,
-                                                   stats[0].latchTime,
-                                                   stats[0].frameEventStats.dequeueReadyTime);
+        mBufferItemConsumer->updateFrameTimestamps(ours->frameEventStats.frameNumber,
+                                                   ours->frameEventStats.refreshStartTime,
+                                                   ours->frameEventStats.gpuCompositionDoneFence,
+                                                   ours->presentFence,
+                                                   ours->previousReleaseFence,
+                                                   ours->frameEventStats.compositorTiming,
+                                                   ours->latchTime,
+                                                   ours->frameEventStats.dequeueReadyTime);
     }
     if (mPendingReleaseItem.item.mGraphicBuffer != nullptr) {
-        if (!stats.empty()) {
-            mPendingReleaseItem.releaseFence = stats[0].previousReleaseFence;
+        if (ours != nullptr) {
+            mPendingReleaseItem.releaseFence = ours->previousReleaseFence;
         } else {
             ALOGE("Warning: no SurfaceControlStats returned in BLASTBufferQueue callback");
             mPendingReleaseItem.releaseFence = nullptr;
@@ -253,7 +264,11 @@ void BLASTBufferQueue::processNextBufferLocked(bool useNextTransaction) {
     t->setDesiredPresentTime(bufferItem.mTimestamp);
 
     if (applyTransaction) {
-        t->apply();
+        if (mTransactionBatcher != nullptr) {
+            mTransactionBatcher->submit(t, bufferItem.mTimestamp);
+        } else {
+            t->apply();
+        }
     }
 }
 
@@ -283,4 +298,76 @@ void BLASTBufferQueue::setNextTransaction(SurfaceComposerClient::Transaction* t)
     mNextTransaction = t;
 }
 
+void BLASTBufferQueue::setTransactionBatcher(const sp<BLASTTransactionBatcher>& batcher) {
+    std::lock_guard _lock{mMutex};
+    mTransactionBatcher = batcher;
+}
+
+BLASTTransactionBatcher::BLASTTransactionBatcher(nsecs_t window)
+      : mWindow(window), mThread(&BLASTTransactionBatcher::threadMain, this) {}
+
+BLASTTransactionBatcher::~BLASTTransactionBatcher() {
+    {
+        std::lock_guard _lock{mMutex};
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    mThread.join();
+}
+
+void BLASTTransactionBatcher::submit(SurfaceComposerClient::Transaction* t,
+                                     nsecs_t desiredPresentTime) {
+    {
+        std::lock_guard _lock{mMutex};
+        mPending.merge(std::move(*t));
+        mPendingPresentTime = std::max(mPendingPresentTime, desiredPresentTime);
+        if (mHasPending) {
+            return;
+        }
+        mHasPending = true;
+        mPendingDeadline = systemTime(SYSTEM_TIME_MONOTONIC) + mWindow;
+    }
+    mCondition.notify_all();
+}
+
+void BLASTTransactionBatcher::flush() {
+    std::unique_lock _lock{mMutex};
+    flushLocked(_lock);
+}
+
+void BLASTTransactionBatcher::flushLocked(std::unique_lock<std::mutex>& lock) {
+    if (!mHasPending) {
+        return;
+    }
+    ATRACE_CALL();
+    SurfaceComposerClient::Transaction t;
+    t.merge(std::move(mPending));
+    t.setDesiredPresentTime(mPendingPresentTime);
+    mHasPending = false;
+    mPendingPresentTime = -1;
+
+    // Apply without the lock so other queues can start the next batch, and so
+    // a transaction callback that submits again can't deadlock against us.
+    lock.unlock();
+    t.apply();
+    lock.lock();
+}
+
+void BLASTTransactionBatcher::threadMain() {
+    std::unique_lock _lock{mMutex};
+    while (!mStopping) {
+        if (!mHasPending) {
+            mCondition.wait(_lock);
+            continue;
+        }
+        const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        if (now < mPendingDeadline) {
+            mCondition.wait_for(_lock, std::chrono::nanoseconds(mPendingDeadline - now));
+            continue;
+        }
+        flushLocked(_lock);
+    }
+    flushLocked(_lock);
+}
+
 } // namespace android
@@ -42,6 +42,8 @@
 
 #include <system/window.h>
 
+#include <ui/GraphicBufferMapper.h>
+
 namespace android {
 
 // Macros for include BufferQueueCore information in log messages
@@ -81,6 +83,8 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
 
     int numDroppedBuffers = 0;
     sp<IProducerListener> listener;
+    String8 traceName;
+    size_t traceQueueSize = 0;
     {
         std::unique_lock<std::mutex> lock(mCore->mMutex);
 
@@ -286,19 +290,24 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
 
         mCore->mQueue.erase(front);
 
-        // We might have freed a slot while dropping old buffers, or the producer
-        // may be blocked waiting for the number of buffers in the queue to
-        // decrease.
-        mCore->mDequeueCondition.notify_all();
-
-        ATRACE_INT(mCore->mConsumerName.string(),
-                static_cast<int32_t>(mCore->mQueue.size()));
+        if (ATRACE_ENABLED()) {
+            traceName = mCore->mConsumerName;
+            traceQueueSize = mCore->mQueue.size();
+        }
 #ifndef NO_BINDER
         mCore->mOccupancyTracker.registerOccupancyChange(mCore->mQueue.size());
 #endif
         VALIDATE_CONSISTENCY();
     }
 
+    // We might have freed a slot while dropping old buffers, or the producer
+    // may be blocked waiting for the number of buffers in the queue to
+    // decrease. Wake it without the lock held so it doesn't block on it again.
+    mCore->mDequeueCondition.notify_all();
+    if (!traceName.isEmpty()) {
+        ATRACE_INT(traceName.string(), static_cast<int32_t>(traceQueueSize));
+    }
+
     if (listener != nullptr) {
         for (int i = 0; i < numDroppedBuffers; ++i) {
             listener->onBufferReleased();
@@ -489,11 +498,11 @@ status_t BufferQueueConsumer::releaseBuffer(int slot, uint64_t frameNumber,
         }
         BQ_LOGV("releaseBuffer: releasing slot %d", slot);
 
-        mCore->mDequeueCondition.notify_all();
         VALIDATE_CONSISTENCY();
     } // Autolock scope
 
-    // Call back without lock held
+    // Wake producers and call back without lock held
+    mCore->mDequeueCondition.notify_all();
     if (listener != nullptr) {
         listener->onBufferReleased();
     }
@@ -531,6 +540,8 @@ status_t BufferQueueConsumer::disconnect() {
 
     BQ_LOGV("disconnect");
 
+    // Free the buffers after mMutex is released.
+    GraphicBufferMapper::ScopedFreeBatch freeBatch;
     std::lock_guard<std::mutex> lock(mCore->mMutex);
 
     if (mCore->mConsumerListener == nullptr) {
@@ -778,6 +789,7 @@ status_t BufferQueueConsumer::getOccupancyHistory(bool forceFlush,
 }
 
 status_t BufferQueueConsumer::discardFreeBuffers() {
+    GraphicBufferMapper::ScopedFreeBatch freeBatch;
     std::lock_guard<std::mutex> lock(mCore->mMutex);
     mCore->discardFreeBuffersLocked();
     return NO_ERROR;
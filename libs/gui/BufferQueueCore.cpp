@@ -28,6 +28,7 @@
 
 #include <inttypes.h>
 
+#include <android-base/properties.h>
 #include <cutils/atomic.h>
 
 #include <gui/BufferItem.h>
@@ -70,6 +71,14 @@ static uint64_t getUniqueId() {
     return id | counter++;
 }
 
+// Bytes of buffers each queue may keep for reuse; 0 disables pooling.
+static size_t getBufferPoolBudget() {
+    static const size_t budget =
+            static_cast<size_t>(std::max(base::GetIntProperty("debug.bq.buffer_pool_kb", 0), 0)) *
+            1024;
+    return budget;
+}
+
 static status_t getProcessName(int pid, String8& name) {
     FILE* fp = fopen(String8::format("/proc/%d/cmdline", pid), "r");
     if (NULL != fp) {
@@ -129,6 +138,8 @@ BufferQueueCore::BufferQueueCore()
         mSharedBufferCache(Rect::INVALID_RECT, 0, NATIVE_WINDOW_SCALING_MODE_FREEZE,
                            HAL_DATASPACE_UNKNOWN),
         mLastQueuedSlot(INVALID_BUFFER_SLOT),
+        mReallocationCount(0),
+        mBufferPool(getBufferPoolBudget()),
         mUniqueId(getUniqueId()),
         mAutoPrerotation(false),
         mTransformHintInUse(0) {
@@ -220,6 +231,41 @@ void BufferQueueCore::dumpState(const String8& prefix, String8* outResult) const
         outResult->appendFormat("%s  [%02d:%p] state=%-8s\n", prefix.string(), s, buffer.get(),
                                 mSlots[s].mBufferState.string());
     }
+
+    outResult->appendFormat("%sProducer stalls (reallocations=%" PRIu64 "):\n", prefix.string(),
+                            mReallocationCount);
+    mFreeSlotWaitStats.dump(prefix, "free-slot-wait", outResult);
+    mAllocationStats.dump(prefix, "allocation", outResult);
+    mFenceWaitStats.dump(prefix, "fence-wait", outResult);
+
+    std::string pool;
+    mBufferPool.dump(pool);
+    outResult->appendFormat("%s%s", prefix.string(), pool.c_str());
+}
+
+void BufferQueueCore::StallStats::record(nsecs_t duration) {
+    if (duration < 0) {
+        duration = 0;
+    }
+    count++;
+    totalTime += duration;
+    maxTime = std::max(maxTime, duration);
+
+    size_t bucket = 0;
+    for (nsecs_t us = ns2us(duration); us > 1 && bucket < kBuckets - 1; us >>= 1) {
+        bucket++;
+    }
+    histogram[bucket]++;
+}
+
+void BufferQueueCore::StallStats::dump(const String8& prefix, const char* name,
+                                       String8* outResult) const {
+    outResult->appendFormat("%s  %s: count=%" PRIu64 " total=%.3fms max=%.3fms us(log2):",
+                            prefix.string(), name, count, totalTime / 1e6, maxTime / 1e6);
+    for (uint64_t bucketCount : histogram) {
+        outResult->appendFormat(" %" PRIu64, bucketCount);
+    }
+    outResult->append("\n");
 }
 
 int BufferQueueCore::getMinUndequeuedBufferCountLocked() const {
@@ -293,6 +339,7 @@ void BufferQueueCore::freeAllBuffersLocked() {
         clearBufferSlotLocked(s);
     }
     mActiveBuffers.clear();
+    mBufferPool.clear();
 
     for (auto& b : mQueue) {
         b.mIsStale = true;
@@ -320,6 +367,7 @@ void BufferQueueCore::discardFreeBuffersLocked() {
         clearBufferSlotLocked(s);
     }
     mFreeBuffers.clear();
+    mBufferPool.clear();
 
     VALIDATE_CONSISTENCY();
 }
@@ -372,6 +420,11 @@ void BufferQueueCore::waitWhileAllocatingLocked(std::unique_lock<std::mutex>& lo
     }
 }
 
+void BufferQueueCore::recordFreeSlotWaitLocked(nsecs_t duration) {
+    mFreeSlotWaitStats.record(duration);
+    mOccupancyTracker.registerDequeueBlocked(duration);
+}
+
 #if DEBUG_ONLY_CODE
 void BufferQueueCore::validateConsistencyLocked() const {
     static const useconds_t PAUSE_TIME = 0;
@@ -42,6 +42,11 @@
 
 #include <system/window.h>
 
+#include <ui/GraphicBufferMapper.h>
+
+#include <thread>
+#include <vector>
+
 namespace android {
 
 // Macros for include BufferQueueCore information in log messages
@@ -361,15 +366,18 @@ status_t BufferQueueProducer::waitForFreeSlotThenRelock(FreeSlotCaller caller,
                     (acquiredCount <= mCore->mMaxAcquiredBufferCount)) {
                 return WOULD_BLOCK;
             }
+            const nsecs_t waitStart = systemTime();
+            std::cv_status result = std::cv_status::no_timeout;
             if (mDequeueTimeout >= 0) {
-                std::cv_status result = mCore->mDequeueCondition.wait_for(lock,
+                result = mCore->mDequeueCondition.wait_for(lock,
                         std::chrono::nanoseconds(mDequeueTimeout));
-                if (result == std::cv_status::timeout) {
-                    return TIMED_OUT;
-                }
             } else {
                 mCore->mDequeueCondition.wait(lock);
             }
+            mCore->recordFreeSlotWaitLocked(systemTime() - waitStart);
+            if (result == std::cv_status::timeout) {
+                return TIMED_OUT;
+            }
         }
     } // while (tryAgain)
 
@@ -493,6 +501,12 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
         if ((buffer == nullptr) ||
                 buffer->needsReallocation(width, height, format, BQ_LAYER_COUNT, usage))
         {
+            // |buffer| refers to the slot, so this has to come first.
+            if (buffer != nullptr) {
+                mCore->mReallocationCount++;
+                // Keep the buffer in case the producer goes back to its size.
+                mCore->mBufferPool.recycle(buffer, mSlots[found].mFence);
+            }
             mSlots[found].mAcquireCalled = false;
             mSlots[found].mGraphicBuffer = nullptr;
             mSlots[found].mRequestBufferCalled = false;
@@ -545,18 +559,30 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
 
     if (returnFlags & BUFFER_NEEDS_REALLOCATION) {
         BQ_LOGV("dequeueBuffer: allocating a new buffer for slot %d", *outSlot);
-        sp<GraphicBuffer> graphicBuffer = new GraphicBuffer(
-                width, height, format, BQ_LAYER_COUNT, usage,
-                {mConsumerName.string(), mConsumerName.size()});
+        const nsecs_t allocStart = systemTime();
+        sp<Fence> pooledFence;
+        sp<GraphicBuffer> graphicBuffer = mCore->mBufferPool.take(width, height, format,
+                                                                  BQ_LAYER_COUNT, usage,
+                                                                  &pooledFence);
+        if (graphicBuffer == nullptr) {
+            graphicBuffer = new GraphicBuffer(width, height, format, BQ_LAYER_COUNT, usage,
+                                              {mConsumerName.string(), mConsumerName.size()});
+        }
 
         status_t error = graphicBuffer->initCheck();
+        const nsecs_t allocDuration = systemTime() - allocStart;
 
         { // Autolock scope
             std::lock_guard<std::mutex> lock(mCore->mMutex);
+            mCore->mAllocationStats.record(allocDuration);
 
             if (error == NO_ERROR && !mCore->mIsAbandoned) {
                 graphicBuffer->setGenerationNumber(mCore->mGenerationNumber);
                 mSlots[*outSlot].mGraphicBuffer = graphicBuffer;
+                if (pooledFence != nullptr) {
+                    // The buffer may still be read from since it was pooled.
+                    *outFence = pooledFence;
+                }
                 if (mCore->mConsumerListener != nullptr) {
                     mCore->mConsumerListener->onFrameDequeued(
                             mSlots[*outSlot].mGraphicBuffer->getId());
@@ -589,8 +615,14 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
     }
 
     if (eglFence != EGL_NO_SYNC_KHR) {
+        const nsecs_t waitStart = systemTime();
         EGLint result = eglClientWaitSyncKHR(eglDisplay, eglFence, 0,
                 1000000000);
+        const nsecs_t waitDuration = systemTime() - waitStart;
+        {
+            std::lock_guard<std::mutex> lock(mCore->mMutex);
+            mCore->mFenceWaitStats.record(waitDuration);
+        }
         // If something goes wrong, log the error, but return the buffer without
         // synchronizing access to it. It's too late at this point to abort the
         // dequeue operation.
@@ -843,7 +875,27 @@ status_t BufferQueueProducer::queueBuffer(int slot,
     sp<IConsumerListener> frameReplacedListener;
     int callbackTicket = 0;
     uint64_t currentFrameNumber = 0;
+    String8 traceName;
+    size_t traceQueueSize = 0;
+
+    // Fill in everything that doesn't depend on the core state before taking
+    // mCore->mMutex, so that the consumer's acquireBuffer isn't held up by it.
     BufferItem item;
+    item.mCrop = crop;
+    item.mTransform = transform &
+            ~static_cast<uint32_t>(NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY);
+    item.mTransformToDisplayInverse =
+            (transform & NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY) != 0;
+    item.mScalingMode = static_cast<uint32_t>(scalingMode);
+    item.mTimestamp = requestedPresentTimestamp;
+    item.mIsAutoTimestamp = isAutoTimestamp;
+    item.mHdrMetadata = hdrMetadata;
+    item.mSlot = slot;
+    item.mFence = acquireFence;
+    item.mFenceTime = acquireFenceTime;
+    item.mSurfaceDamage = surfaceDamage;
+    item.mQueuedBuffer = true;
+
     { // Autolock scope
         std::lock_guard<std::mutex> lock(mCore->mMutex);
 
@@ -912,26 +964,12 @@ status_t BufferQueueProducer::queueBuffer(int slot,
 
         item.mAcquireCalled = mSlots[slot].mAcquireCalled;
         item.mGraphicBuffer = mSlots[slot].mGraphicBuffer;
-        item.mCrop = crop;
-        item.mTransform = transform &
-                ~static_cast<uint32_t>(NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY);
-        item.mTransformToDisplayInverse =
-                (transform & NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY) != 0;
-        item.mScalingMode = static_cast<uint32_t>(scalingMode);
-        item.mTimestamp = requestedPresentTimestamp;
-        item.mIsAutoTimestamp = isAutoTimestamp;
         item.mDataSpace = dataSpace;
-        item.mHdrMetadata = hdrMetadata;
         item.mFrameNumber = currentFrameNumber;
-        item.mSlot = slot;
-        item.mFence = acquireFence;
-        item.mFenceTime = acquireFenceTime;
         item.mIsDroppable = mCore->mAsyncMode ||
                 (mConsumerIsSurfaceFlinger && mCore->mQueueBufferCanDrop) ||
                 (mCore->mLegacyBufferDrop && mCore->mQueueBufferCanDrop) ||
                 (mCore->mSharedBufferMode && mCore->mSharedBufferSlot == slot);
-        item.mSurfaceDamage = surfaceDamage;
-        item.mQueuedBuffer = true;
         item.mAutoRefresh = mCore->mSharedBufferMode && mCore->mAutoRefresh;
         item.mApi = mCore->mConnectedApi;
 
@@ -996,7 +1034,6 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         }
 
         mCore->mBufferHasBeenQueued = true;
-        mCore->mDequeueCondition.notify_all();
         mCore->mLastQueuedSlot = slot;
 
         output->width = mCore->mDefaultWidth;
@@ -1004,9 +1041,12 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         output->transformHint = mCore->mTransformHintInUse = mCore->mTransformHint;
         output->numPendingBuffers = static_cast<uint32_t>(mCore->mQueue.size());
         output->nextFrameNumber = mCore->mFrameCounter + 1;
+        output->minUndequeuedBuffers = mCore->getMinUndequeuedBufferCountLocked();
 
-        ATRACE_INT(mCore->mConsumerName.string(),
-                static_cast<int32_t>(mCore->mQueue.size()));
+        if (ATRACE_ENABLED()) {
+            traceName = mCore->mConsumerName;
+            traceQueueSize = mCore->mQueue.size();
+        }
 #ifndef NO_BINDER
         mCore->mOccupancyTracker.registerOccupancyChange(mCore->mQueue.size());
 #endif
@@ -1016,6 +1056,13 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         VALIDATE_CONSISTENCY();
     } // Autolock scope
 
+    // Waiters re-check their condition under mCore->mMutex, so wake them only
+    // once it has been released rather than having them block on it again.
+    mCore->mDequeueCondition.notify_all();
+    if (!traceName.isEmpty()) {
+        ATRACE_INT(traceName.string(), static_cast<int32_t>(traceQueueSize));
+    }
+
     // It is okay not to clear the GraphicBuffer when the consumer is SurfaceFlinger because
     // it is guaranteed that the BufferQueue is inside SurfaceFlinger's process and
     // there will be no Binder call
@@ -1068,7 +1115,11 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         // Waiting here allows for two full buffers to be queued but not a
         // third. In the event that frames take varying time, this makes a
         // small trade-off in favor of latency rather than throughput.
+        const nsecs_t waitStart = systemTime();
         lastQueuedFence->waitForever("Throttling EGL Production");
+        const nsecs_t waitDuration = systemTime() - waitStart;
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        mCore->mFenceWaitStats.record(waitDuration);
     }
 
     return NO_ERROR;
@@ -1285,6 +1336,9 @@ status_t BufferQueueProducer::connect(const sp<IProducerListener>& listener,
         mCore->mDequeueBufferCannotBlock = mDequeueTimeout < 0;
         mCore->mQueueBufferCanDrop = mDequeueTimeout <= 0;
     }
+    if (status == NO_ERROR) {
+        output->minUndequeuedBuffers = mCore->getMinUndequeuedBufferCountLocked();
+    }
 
     mCore->mAllowAllocation = true;
     VALIDATE_CONSISTENCY();
@@ -1298,6 +1352,8 @@ status_t BufferQueueProducer::disconnect(int api, DisconnectMode mode) {
     int status = NO_ERROR;
     sp<IConsumerListener> listener;
     { // Autolock scope
+        // Free the buffers after mMutex is released.
+        GraphicBufferMapper::ScopedFreeBatch freeBatch;
         std::unique_lock<std::mutex> lock(mCore->mMutex);
 
         if (mode == DisconnectMode::AllLocal) {
@@ -1417,9 +1473,11 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 return;
             }
 
-            // Only allocate one buffer at a time to reduce risks of overlapping an allocation from
-            // both allocateBuffers and dequeueBuffer.
-            newBufferCount = mCore->mFreeSlots.empty() ? 0 : 1;
+            // Fill every free slot in one batch. dequeueBuffer waits on
+            // mIsAllocating rather than allocating on its own, and since the
+            // batch is allocated in parallel it waits for about as long as a
+            // single allocation takes.
+            newBufferCount = mCore->mFreeSlots.size();
             if (newBufferCount == 0) {
                 return;
             }
@@ -1438,12 +1496,32 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
             mCore->mIsAllocating = true;
         } // Autolock scope
 
-        Vector<sp<GraphicBuffer>> buffers;
-        for (size_t i = 0; i < newBufferCount; ++i) {
-            sp<GraphicBuffer> graphicBuffer = new GraphicBuffer(
-                    allocWidth, allocHeight, allocFormat, BQ_LAYER_COUNT,
-                    allocUsage, allocName);
+        const nsecs_t allocStart = systemTime();
+        std::vector<sp<GraphicBuffer>> buffers(newBufferCount);
+        std::vector<sp<Fence>> fences(newBufferCount, Fence::NO_FENCE);
+        auto allocate = [&](size_t i) {
+            buffers[i] = mCore->mBufferPool.take(allocWidth, allocHeight, allocFormat,
+                                                 BQ_LAYER_COUNT, allocUsage, &fences[i]);
+            if (buffers[i] == nullptr) {
+                buffers[i] = new GraphicBuffer(allocWidth, allocHeight, allocFormat,
+                                               BQ_LAYER_COUNT, allocUsage, allocName);
+            }
+        };
+        {
+            // Gralloc allocations are independent of each other, so issue all
+            // but the first from helper threads and do the first one here.
+            std::vector<std::thread> workers;
+            workers.reserve(newBufferCount - 1);
+            for (size_t i = 1; i < newBufferCount; ++i) {
+                workers.emplace_back(allocate, i);
+            }
+            allocate(0);
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+        }
 
+        for (const sp<GraphicBuffer>& graphicBuffer : buffers) {
             status_t result = graphicBuffer->initCheck();
 
             if (result != NO_ERROR) {
@@ -1454,11 +1532,13 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
                 mCore->mIsAllocatingCondition.notify_all();
                 return;
             }
-            buffers.push_back(graphicBuffer);
         }
 
+        const nsecs_t allocDuration = systemTime() - allocStart;
+
         { // Autolock scope
             std::unique_lock<std::mutex> lock(mCore->mMutex);
+            mCore->mAllocationStats.record(allocDuration);
             uint32_t checkWidth = width > 0 ? width : mCore->mDefaultWidth;
             uint32_t checkHeight = height > 0 ? height : mCore->mDefaultHeight;
             if (useDefaultSize && mCore->mAutoPrerotation &&
@@ -1481,13 +1561,14 @@ void BufferQueueProducer::allocateBuffers(uint32_t width, uint32_t height,
             for (size_t i = 0; i < newBufferCount; ++i) {
                 if (mCore->mFreeSlots.empty()) {
                     BQ_LOGV("allocateBuffers: a slot was occupied while "
-                            "allocating. Dropping allocated buffer.");
+                            "allocating. Pooling allocated buffer.");
+                    mCore->mBufferPool.recycle(buffers[i], fences[i]);
                     continue;
                 }
                 auto slot = mCore->mFreeSlots.begin();
                 mCore->clearBufferSlotLocked(*slot); // Clean up the slot first
                 mSlots[*slot].mGraphicBuffer = buffers[i];
-                mSlots[*slot].mFence = Fence::NO_FENCE;
+                mSlots[*slot].mFence = fences[i];
 
                 // freeBufferLocked puts this slot on the free slots list. Since
                 // we then attached a buffer, move the slot to free buffer list.
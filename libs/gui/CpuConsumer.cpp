@@ -21,6 +21,7 @@
 #include <gui/CpuConsumer.h>
 
 #include <gui/BufferItem.h>
+#include <ui/GraphicBufferMapper.h>
 #include <utils/Log.h>
 
 #define CC_LOGV(x, ...) ALOGV("[%s] " x, mName.string(), ##__VA_ARGS__)
@@ -44,6 +45,17 @@ CpuConsumer::CpuConsumer(const sp<IGraphicBufferConsumer>& bq,
     mConsumer->setMaxAcquiredBufferCount(static_cast<int32_t>(maxLockedBuffers));
 }
 
+CpuConsumer::~CpuConsumer() {
+    {
+        std::lock_guard<std::mutex> lock(mLockMutex);
+        mStopLockThread = true;
+    }
+    mLockCondition.notify_all();
+    if (mLockThread.joinable()) {
+        mLockThread.join();
+    }
+}
+
 size_t CpuConsumer::findAcquiredBufferLocked(uintptr_t id) const {
     for (size_t i = 0; i < mMaxLockedBuffers; i++) {
         const auto& ab = mAcquiredBuffers[i];
@@ -195,12 +207,141 @@ status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
     return OK;
 }
 
+status_t CpuConsumer::lockNextBufferAsync(const LockedBufferCallback& callback) {
+    if (!callback) return BAD_VALUE;
+
+    PendingLock pending;
+    { // Autolock scope
+        Mutex::Autolock _l(mMutex);
+
+        if (mCurrentLockedBuffers == mMaxLockedBuffers) {
+            CC_LOGW("Max buffers have been locked (%zd), cannot lock anymore.",
+                    mMaxLockedBuffers);
+            return NOT_ENOUGH_DATA;
+        }
+
+        status_t err = acquireBufferLocked(&pending.item, 0);
+        if (err != OK) {
+            if (err == BufferQueue::NO_BUFFER_AVAILABLE) {
+                return BAD_VALUE;
+            } else {
+                CC_LOGE("Error acquiring buffer: %s (%d)", strerror(err), err);
+                return err;
+            }
+        }
+
+        if (pending.item.mGraphicBuffer == nullptr) {
+            pending.item.mGraphicBuffer = mSlots[pending.item.mSlot].mGraphicBuffer;
+        }
+
+        pending.acquiredIndex = findAcquiredBufferLocked(AcquiredBuffer::kUnusedId);
+        ALOG_ASSERT(pending.acquiredIndex < mMaxLockedBuffers);
+        AcquiredBuffer& ab = mAcquiredBuffers.editItemAt(pending.acquiredIndex);
+
+        ab.mSlot = pending.item.mSlot;
+        ab.mGraphicBuffer = pending.item.mGraphicBuffer;
+        ab.mLockedBufferId = AcquiredBuffer::kPendingId;
+
+        mCurrentLockedBuffers++;
+    }
+
+    pending.callback = callback;
+    {
+        std::lock_guard<std::mutex> lock(mLockMutex);
+        mPendingLocks.push_back(std::move(pending));
+        if (!mLockThread.joinable()) {
+            mLockThread = std::thread(&CpuConsumer::lockThreadMain, this);
+        }
+    }
+    mLockCondition.notify_one();
+    return OK;
+}
+
+void CpuConsumer::lockThreadMain() {
+    std::unique_lock<std::mutex> lock(mLockMutex);
+    while (true) {
+        mLockCondition.wait(lock, [this] { return mStopLockThread || !mPendingLocks.empty(); });
+        if (mStopLockThread) {
+            return;
+        }
+        PendingLock pending = std::move(mPendingLocks.front());
+        mPendingLocks.pop_front();
+        lock.unlock();
+
+        // Wait here rather than in the mapper, which may hold locks of its
+        // own while it waits for the fence.
+        if (pending.item.mFence != nullptr && pending.item.mFence->isValid()) {
+            pending.item.mFence->waitForever("CpuConsumer::lockNextBufferAsync");
+            pending.item.mFence = Fence::NO_FENCE;
+        }
+
+        LockedBuffer nativeBuffer;
+        status_t err = lockBufferItem(pending.item, &nativeBuffer);
+        { // Autolock scope
+            Mutex::Autolock _l(mMutex);
+            AcquiredBuffer& ab = mAcquiredBuffers.editItemAt(pending.acquiredIndex);
+            if (err == OK) {
+                ab.mLockedBufferId = getLockedBufferId(nativeBuffer);
+            } else {
+                releaseBufferLocked(ab.mSlot, ab.mGraphicBuffer);
+                ab.reset();
+                mCurrentLockedBuffers--;
+            }
+        }
+        pending.callback(err, nativeBuffer);
+
+        lock.lock();
+    }
+}
+
+status_t CpuConsumer::getPlaneLayouts(const LockedBuffer& nativeBuffer,
+        std::vector<ui::PlaneLayout>* outPlaneLayouts) {
+    if (!outPlaneLayouts) return BAD_VALUE;
+
+    Mutex::Autolock _l(mMutex);
+
+    uintptr_t id = getLockedBufferId(nativeBuffer);
+    size_t lockedIdx = (id != AcquiredBuffer::kUnusedId && id != AcquiredBuffer::kPendingId)
+            ? findAcquiredBufferLocked(id)
+            : mMaxLockedBuffers;
+    if (lockedIdx == mMaxLockedBuffers) {
+        CC_LOGE("%s: Can't find locked buffer", __FUNCTION__);
+        return BAD_VALUE;
+    }
+
+    const AcquiredBuffer& ab = mAcquiredBuffers[lockedIdx];
+    // The slot may hold another buffer by now, in which case the layouts are
+    // not cached.
+    const bool inSlot = mSlots[ab.mSlot].mGraphicBuffer == ab.mGraphicBuffer;
+    if (inSlot && !mPlaneLayouts[ab.mSlot].empty()) {
+        *outPlaneLayouts = mPlaneLayouts[ab.mSlot];
+        return OK;
+    }
+
+    status_t err = GraphicBufferMapper::get().getPlaneLayouts(ab.mGraphicBuffer->handle,
+                                                              outPlaneLayouts);
+    if (err != OK) {
+        return err;
+    }
+    if (inSlot) {
+        mPlaneLayouts[ab.mSlot] = *outPlaneLayouts;
+    }
+    return OK;
+}
+
+void CpuConsumer::freeBufferLocked(int slotIndex) {
+    mPlaneLayouts[slotIndex].clear();
+    ConsumerBase::freeBufferLocked(slotIndex);
+}
+
 status_t CpuConsumer::unlockBuffer(const LockedBuffer &nativeBuffer) {
     Mutex::Autolock _l(mMutex);
 
     uintptr_t id = getLockedBufferId(nativeBuffer);
     size_t lockedIdx =
-        (id != AcquiredBuffer::kUnusedId) ? findAcquiredBufferLocked(id) : mMaxLockedBuffers;
+        (id != AcquiredBuffer::kUnusedId && id != AcquiredBuffer::kPendingId)
+                ? findAcquiredBufferLocked(id)
+                : mMaxLockedBuffers;
     if (lockedIdx == mMaxLockedBuffers) {
         CC_LOGE("%s: Can't find buffer to free", __FUNCTION__);
         return BAD_VALUE;
@@ -79,6 +79,21 @@ status_t DisplayEventReceiver::requestNextVsync() {
     return NO_INIT;
 }
 
+status_t DisplayEventReceiver::getVsyncTimeline(gui::VsyncTimeline::Snapshot* outSnapshot) {
+    if (mEventConnection == nullptr) {
+        return NO_INIT;
+    }
+    if (mVsyncTimeline == nullptr) {
+        auto timeline = std::make_unique<gui::VsyncTimeline>();
+        status_t result = mEventConnection->getVsyncTimeline(timeline.get());
+        if (result != NO_ERROR) {
+            return result;
+        }
+        mVsyncTimeline = std::move(timeline);
+    }
+    return mVsyncTimeline->read(outSnapshot);
+}
+
 ssize_t DisplayEventReceiver::getEvents(DisplayEventReceiver::Event* events,
         size_t count) {
     return DisplayEventReceiver::getEvents(mDataChannel.get(), events, count);
@@ -521,23 +521,85 @@ FrameEventsDelta::FrameEventsDelta(
     }
 }
 
+// Timestamps are sent as a bitmask of the ones that aren't pending followed
+// by ZigZag varints of each one's difference from the previous one sent.
+// Timestamps in a frame are all close to each other, so most of them only
+// take two or three bytes instead of eight.
+namespace {
+
+size_t varintSize(uint64_t value) {
+    size_t bytes = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        bytes++;
+    }
+    return bytes;
+}
+
+void writeVarint(void*& buffer, size_t& size, uint64_t value) {
+    while (value >= 0x80) {
+        FlattenableUtils::write(buffer, size, static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    FlattenableUtils::write(buffer, size, static_cast<uint8_t>(value));
+}
+
+bool readVarint(void const*& buffer, size_t& size, uint64_t* outValue) {
+    uint64_t value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        if (size < sizeof(uint8_t)) {
+            return false;
+        }
+        uint8_t byte = 0;
+        FlattenableUtils::read(buffer, size, byte);
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *outValue = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t encodeTimestampDelta(nsecs_t timestamp, nsecs_t previous) {
+    // Wraps instead of overflowing for timestamps far apart.
+    const int64_t delta = static_cast<int64_t>(
+            static_cast<uint64_t>(timestamp) - static_cast<uint64_t>(previous));
+    return (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+}
+
+nsecs_t decodeTimestampDelta(uint64_t encoded, nsecs_t previous) {
+    const uint64_t delta = (encoded >> 1) ^ (~(encoded & 1) + 1);
+    return static_cast<nsecs_t>(static_cast<uint64_t>(previous) + delta);
+}
+
+enum : uint8_t {
+    ADD_POST_COMPOSITE_CALLED = 1 << 0,
+    ADD_RELEASE_CALLED = 1 << 1,
+};
+
+} // namespace
+
 constexpr size_t FrameEventsDelta::minFlattenedSize() {
-    return sizeof(FrameEventsDelta::mFrameNumber) +
-            sizeof(uint16_t) + // mIndex
-            sizeof(uint8_t) + // mAddPostCompositeCalled
-            sizeof(uint8_t) + // mAddReleaseCalled
-            sizeof(FrameEventsDelta::mPostedTime) +
-            sizeof(FrameEventsDelta::mRequestedPresentTime) +
-            sizeof(FrameEventsDelta::mLatchTime) +
-            sizeof(FrameEventsDelta::mFirstRefreshStartTime) +
-            sizeof(FrameEventsDelta::mLastRefreshStartTime) +
-            sizeof(FrameEventsDelta::mDequeueReadyTime);
+    return sizeof(uint16_t) + // mIndex
+            sizeof(uint8_t) + // mAddPostCompositeCalled, mAddReleaseCalled
+            sizeof(uint8_t) + // Mask of timestamps that follow.
+            sizeof(uint8_t); // Smallest mFrameNumber varint.
 }
 
 // Flattenable implementation
 size_t FrameEventsDelta::getFlattenedSize() const {
+    size_t size = minFlattenedSize() - sizeof(uint8_t) + varintSize(mFrameNumber);
+    nsecs_t previous = 0;
+    for (auto timestamp : allTimestamps(this)) {
+        if (*timestamp != FrameEvents::TIMESTAMP_PENDING) {
+            size += varintSize(encodeTimestampDelta(*timestamp, previous));
+            previous = *timestamp;
+        }
+    }
+
     auto fences = allFences(this);
-    return minFlattenedSize() +
+    return size +
             std::accumulate(fences.begin(), fences.end(), size_t(0),
                     [](size_t a, const FenceTime::Snapshot* fence) {
                             return a + fence->getFlattenedSize();
@@ -563,21 +625,29 @@ status_t FrameEventsDelta::flatten(void*& buffer, size_t& size, int*& fds,
         return BAD_VALUE;
     }
 
-    FlattenableUtils::write(buffer, size, mFrameNumber);
-
-    // These are static_cast to uint16_t/uint8_t for alignment.
     FlattenableUtils::write(buffer, size, static_cast<uint16_t>(mIndex));
-    FlattenableUtils::write(
-            buffer, size, static_cast<uint8_t>(mAddPostCompositeCalled));
-    FlattenableUtils::write(
-            buffer, size, static_cast<uint8_t>(mAddReleaseCalled));
+    uint8_t flags = 0;
+    if (mAddPostCompositeCalled) flags |= ADD_POST_COMPOSITE_CALLED;
+    if (mAddReleaseCalled) flags |= ADD_RELEASE_CALLED;
+    FlattenableUtils::write(buffer, size, flags);
+
+    auto timestamps = allTimestamps(this);
+    uint8_t mask = 0;
+    for (size_t i = 0; i < timestamps.size(); i++) {
+        if (*timestamps[i] != FrameEvents::TIMESTAMP_PENDING) {
+            mask |= 1 << i;
+        }
+    }
+    FlattenableUtils::write(buffer, size, mask);
 
-    FlattenableUtils::write(buffer, size, mPostedTime);
-    FlattenableUtils::write(buffer, size, mRequestedPresentTime);
-    FlattenableUtils::write(buffer, size, mLatchTime);
-    FlattenableUtils::write(buffer, size, mFirstRefreshStartTime);
-    FlattenableUtils::write(buffer, size, mLastRefreshStartTime);
-    FlattenableUtils::write(buffer, size, mDequeueReadyTime);
+    writeVarint(buffer, size, mFrameNumber);
+    nsecs_t previous = 0;
+    for (auto timestamp : timestamps) {
+        if (*timestamp != FrameEvents::TIMESTAMP_PENDING) {
+            writeVarint(buffer, size, encodeTimestampDelta(*timestamp, previous));
+            previous = *timestamp;
+        }
+    }
 
     // Fences
     for (auto fence : allFences(this)) {
@@ -595,27 +665,40 @@ status_t FrameEventsDelta::unflatten(void const*& buffer, size_t& size,
         return NO_MEMORY;
     }
 
-    FlattenableUtils::read(buffer, size, mFrameNumber);
-
-    // These were written as uint16_t/uint8_t for alignment.
     uint16_t temp16 = 0;
     FlattenableUtils::read(buffer, size, temp16);
     mIndex = temp16;
     if (mIndex >= FrameEventHistory::MAX_FRAME_HISTORY) {
         return BAD_VALUE;
     }
-    uint8_t temp8 = 0;
-    FlattenableUtils::read(buffer, size, temp8);
-    mAddPostCompositeCalled = static_cast<bool>(temp8);
-    FlattenableUtils::read(buffer, size, temp8);
-    mAddReleaseCalled = static_cast<bool>(temp8);
-
-    FlattenableUtils::read(buffer, size, mPostedTime);
-    FlattenableUtils::read(buffer, size, mRequestedPresentTime);
-    FlattenableUtils::read(buffer, size, mLatchTime);
-    FlattenableUtils::read(buffer, size, mFirstRefreshStartTime);
-    FlattenableUtils::read(buffer, size, mLastRefreshStartTime);
-    FlattenableUtils::read(buffer, size, mDequeueReadyTime);
+    uint8_t flags = 0;
+    FlattenableUtils::read(buffer, size, flags);
+    mAddPostCompositeCalled = (flags & ADD_POST_COMPOSITE_CALLED) != 0;
+    mAddReleaseCalled = (flags & ADD_RELEASE_CALLED) != 0;
+
+    auto timestamps = allTimestamps(this);
+    uint8_t mask = 0;
+    FlattenableUtils::read(buffer, size, mask);
+    if (mask >> timestamps.size() != 0) {
+        return BAD_VALUE;
+    }
+
+    if (!readVarint(buffer, size, &mFrameNumber)) {
+        return NO_MEMORY;
+    }
+    nsecs_t previous = 0;
+    for (size_t i = 0; i < timestamps.size(); i++) {
+        if ((mask & (1 << i)) == 0) {
+            *timestamps[i] = FrameEvents::TIMESTAMP_PENDING;
+            continue;
+        }
+        uint64_t encoded = 0;
+        if (!readVarint(buffer, size, &encoded)) {
+            return NO_MEMORY;
+        }
+        *timestamps[i] = decodeTimestampDelta(encoded, previous);
+        previous = *timestamps[i];
+    }
 
     // Fences
     for (auto fence : allFences(this)) {
@@ -101,7 +101,13 @@ public:
             }
         }
 
-        remote()->transact(BnSurfaceComposer::SET_TRANSACTION_STATE, data, &reply);
+        const bool oneway = (flags & eOneway) && !(flags & (eSynchronous | eAnimation));
+        if (oneway) {
+            remote()->transact(BnSurfaceComposer::SET_TRANSACTION_STATE, data, nullptr,
+                               IBinder::FLAG_ONEWAY);
+        } else {
+            remote()->transact(BnSurfaceComposer::SET_TRANSACTION_STATE, data, &reply);
+        }
     }
 
     virtual void bootFinished()
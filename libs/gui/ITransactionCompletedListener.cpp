@@ -30,18 +30,103 @@ enum class Tag : uint32_t {
 
 } // Anonymous namespace
 
+status_t FenceTable::writeToParcel(Parcel* output) const {
+    status_t err = output->writeInt32(static_cast<int32_t>(mFences.size()));
+    if (err != NO_ERROR) {
+        return err;
+    }
+    for (const auto& fence : mFences) {
+        err = output->write(*fence);
+        if (err != NO_ERROR) {
+            return err;
+        }
+    }
+    return NO_ERROR;
+}
+
+status_t FenceTable::readFromParcel(const Parcel* input) {
+    int32_t size = 0;
+    status_t err = input->readInt32(&size);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    if (size < 0 || static_cast<size_t>(size) > input->dataAvail()) {
+        return BAD_VALUE;
+    }
+    mFences.clear();
+    mIndices.clear();
+    mFences.reserve(size);
+    for (int32_t i = 0; i < size; i++) {
+        sp<Fence> fence = new Fence();
+        err = input->read(*fence);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        mFences.push_back(fence);
+    }
+    return NO_ERROR;
+}
+
+void FenceTable::add(const sp<Fence>& fence) {
+    if (fence && mIndices.emplace(fence.get(), static_cast<int32_t>(mFences.size())).second) {
+        mFences.push_back(fence);
+    }
+}
+
+status_t FenceTable::writeFence(Parcel* output, const sp<Fence>& fence) const {
+    if (!fence) {
+        return output->writeInt32(-1);
+    }
+    auto it = mIndices.find(fence.get());
+    if (it == mIndices.end()) {
+        return BAD_VALUE;
+    }
+    return output->writeInt32(it->second);
+}
+
+status_t FenceTable::readFence(const Parcel* input, sp<Fence>* outFence) const {
+    int32_t index = -1;
+    status_t err = input->readInt32(&index);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    if (index == -1) {
+        outFence->clear();
+        return NO_ERROR;
+    }
+    if (index < 0 || static_cast<size_t>(index) >= mFences.size()) {
+        return BAD_VALUE;
+    }
+    *outFence = mFences[index];
+    return NO_ERROR;
+}
+
 status_t FrameEventHistoryStats::writeToParcel(Parcel* output) const {
-    status_t err = output->writeUint64(frameNumber);
+    FenceTable fences;
+    addFences(&fences);
+    status_t err = fences.writeToParcel(output);
     if (err != NO_ERROR) return err;
 
-    if (gpuCompositionDoneFence) {
-        err = output->writeBool(true);
-        if (err != NO_ERROR) return err;
+    return writeToParcel(output, fences);
+}
 
-        err = output->write(*gpuCompositionDoneFence);
-    } else {
-        err = output->writeBool(false);
-    }
+status_t FrameEventHistoryStats::readFromParcel(const Parcel* input) {
+    FenceTable fences;
+    status_t err = fences.readFromParcel(input);
+    if (err != NO_ERROR) return err;
+
+    return readFromParcel(input, fences);
+}
+
+void FrameEventHistoryStats::addFences(FenceTable* fences) const {
+    fences->add(gpuCompositionDoneFence);
+}
+
+status_t FrameEventHistoryStats::writeToParcel(Parcel* output, const FenceTable& fences) const {
+    status_t err = output->writeUint64(frameNumber);
+    if (err != NO_ERROR) return err;
+
+    err = fences.writeFence(output, gpuCompositionDoneFence);
     if (err != NO_ERROR) return err;
 
     err = output->writeInt64(compositorTiming.deadline);
@@ -60,20 +145,13 @@ status_t FrameEventHistoryStats::writeToParcel(Parcel* output) const {
     return err;
 }
 
-status_t FrameEventHistoryStats::readFromParcel(const Parcel* input) {
+status_t FrameEventHistoryStats::readFromParcel(const Parcel* input, const FenceTable& fences) {
     status_t err = input->readUint64(&frameNumber);
     if (err != NO_ERROR) return err;
 
-    bool hasFence = false;
-    err = input->readBool(&hasFence);
+    err = fences.readFence(input, &gpuCompositionDoneFence);
     if (err != NO_ERROR) return err;
 
-    if (hasFence) {
-        gpuCompositionDoneFence = new Fence();
-        err = input->read(*gpuCompositionDoneFence);
-        if (err != NO_ERROR) return err;
-    }
-
     err = input->readInt64(&(compositorTiming.deadline));
     if (err != NO_ERROR) return err;
 
@@ -91,6 +169,30 @@ status_t FrameEventHistoryStats::readFromParcel(const Parcel* input) {
 }
 
 status_t SurfaceStats::writeToParcel(Parcel* output) const {
+    FenceTable fences;
+    addFences(&fences);
+    status_t err = fences.writeToParcel(output);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    return writeToParcel(output, fences);
+}
+
+status_t SurfaceStats::readFromParcel(const Parcel* input) {
+    FenceTable fences;
+    status_t err = fences.readFromParcel(input);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    return readFromParcel(input, fences);
+}
+
+void SurfaceStats::addFences(FenceTable* fences) const {
+    fences->add(previousReleaseFence);
+    eventStats.addFences(fences);
+}
+
+status_t SurfaceStats::writeToParcel(Parcel* output, const FenceTable& fences) const {
     status_t err = output->writeStrongBinder(surfaceControl);
     if (err != NO_ERROR) {
         return err;
@@ -99,25 +201,19 @@ status_t SurfaceStats::writeToParcel(Parcel* output) const {
     if (err != NO_ERROR) {
         return err;
     }
-    if (previousReleaseFence) {
-        err = output->writeBool(true);
-        if (err != NO_ERROR) {
-            return err;
-        }
-        err = output->write(*previousReleaseFence);
-    } else {
-        err = output->writeBool(false);
+    err = fences.writeFence(output, previousReleaseFence);
+    if (err != NO_ERROR) {
+        return err;
     }
     err = output->writeUint32(transformHint);
     if (err != NO_ERROR) {
         return err;
     }
 
-    err = output->writeParcelable(eventStats);
-    return err;
+    return eventStats.writeToParcel(output, fences);
 }
 
-status_t SurfaceStats::readFromParcel(const Parcel* input) {
+status_t SurfaceStats::readFromParcel(const Parcel* input, const FenceTable& fences) {
     status_t err = input->readStrongBinder(&surfaceControl);
     if (err != NO_ERROR) {
         return err;
@@ -126,28 +222,45 @@ status_t SurfaceStats::readFromParcel(const Parcel* input) {
     if (err != NO_ERROR) {
         return err;
     }
-    bool hasFence = false;
-    err = input->readBool(&hasFence);
+    err = fences.readFence(input, &previousReleaseFence);
     if (err != NO_ERROR) {
         return err;
     }
-    if (hasFence) {
-        previousReleaseFence = new Fence();
-        err = input->read(*previousReleaseFence);
-        if (err != NO_ERROR) {
-            return err;
-        }
-    }
     err = input->readUint32(&transformHint);
     if (err != NO_ERROR) {
         return err;
     }
 
-    err = input->readParcelable(&eventStats);
-    return err;
+    return eventStats.readFromParcel(input, fences);
 }
 
 status_t TransactionStats::writeToParcel(Parcel* output) const {
+    FenceTable fences;
+    addFences(&fences);
+    status_t err = fences.writeToParcel(output);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    return writeToParcel(output, fences);
+}
+
+status_t TransactionStats::readFromParcel(const Parcel* input) {
+    FenceTable fences;
+    status_t err = fences.readFromParcel(input);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    return readFromParcel(input, fences);
+}
+
+void TransactionStats::addFences(FenceTable* fences) const {
+    fences->add(presentFence);
+    for (const auto& stats : surfaceStats) {
+        stats.addFences(fences);
+    }
+}
+
+status_t TransactionStats::writeToParcel(Parcel* output, const FenceTable& fences) const {
     status_t err = output->writeInt64Vector(callbackIds);
     if (err != NO_ERROR) {
         return err;
@@ -156,22 +269,24 @@ status_t TransactionStats::writeToParcel(Parcel* output) const {
     if (err != NO_ERROR) {
         return err;
     }
-    if (presentFence) {
-        err = output->writeBool(true);
-        if (err != NO_ERROR) {
-            return err;
-        }
-        err = output->write(*presentFence);
-    } else {
-        err = output->writeBool(false);
+    err = fences.writeFence(output, presentFence);
+    if (err != NO_ERROR) {
+        return err;
     }
+    err = output->writeInt32(static_cast<int32_t>(surfaceStats.size()));
     if (err != NO_ERROR) {
         return err;
     }
-    return output->writeParcelableVector(surfaceStats);
+    for (const auto& stats : surfaceStats) {
+        err = stats.writeToParcel(output, fences);
+        if (err != NO_ERROR) {
+            return err;
+        }
+    }
+    return NO_ERROR;
 }
 
-status_t TransactionStats::readFromParcel(const Parcel* input) {
+status_t TransactionStats::readFromParcel(const Parcel* input, const FenceTable& fences) {
     status_t err = input->readInt64Vector(&callbackIds);
     if (err != NO_ERROR) {
         return err;
@@ -180,28 +295,44 @@ status_t TransactionStats::readFromParcel(const Parcel* input) {
     if (err != NO_ERROR) {
         return err;
     }
-    bool hasFence = false;
-    err = input->readBool(&hasFence);
+    err = fences.readFence(input, &presentFence);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    int32_t surfaceStats_size = 0;
+    err = input->readInt32(&surfaceStats_size);
     if (err != NO_ERROR) {
         return err;
     }
-    if (hasFence) {
-        presentFence = new Fence();
-        err = input->read(*presentFence);
+    if (surfaceStats_size < 0 || static_cast<size_t>(surfaceStats_size) > input->dataAvail()) {
+        return BAD_VALUE;
+    }
+    surfaceStats.clear();
+    surfaceStats.resize(surfaceStats_size);
+    for (auto& stats : surfaceStats) {
+        err = stats.readFromParcel(input, fences);
         if (err != NO_ERROR) {
             return err;
         }
     }
-    return input->readParcelableVector(&surfaceStats);
+    return NO_ERROR;
 }
 
 status_t ListenerStats::writeToParcel(Parcel* output) const {
-    status_t err = output->writeInt32(static_cast<int32_t>(transactionStats.size()));
+    FenceTable fences;
+    for (const auto& stats : transactionStats) {
+        stats.addFences(&fences);
+    }
+    status_t err = fences.writeToParcel(output);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    err = output->writeInt32(static_cast<int32_t>(transactionStats.size()));
     if (err != NO_ERROR) {
         return err;
     }
     for (const auto& stats : transactionStats) {
-        err = output->writeParcelable(stats);
+        err = stats.writeToParcel(output, fences);
         if (err != NO_ERROR) {
             return err;
         }
@@ -210,11 +341,16 @@ status_t ListenerStats::writeToParcel(Parcel* output) const {
 }
 
 status_t ListenerStats::readFromParcel(const Parcel* input) {
+    FenceTable fences;
+    status_t err = fences.readFromParcel(input);
+    if (err != NO_ERROR) {
+        return err;
+    }
     int32_t transactionStats_size = input->readInt32();
 
     for (int i = 0; i < transactionStats_size; i++) {
         TransactionStats stats;
-        status_t err = input->readParcelable(&stats);
+        err = stats.readFromParcel(input, fences);
         if (err != NO_ERROR) {
             return err;
         }
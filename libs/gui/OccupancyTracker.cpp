@@ -39,7 +39,15 @@ status_t OccupancyTracker::Segment::writeToParcel(Parcel* parcel) const {
     if (result != OK) {
         return result;
     }
-    return parcel->writeBool(usedThirdBuffer);
+    result = parcel->writeBool(usedThirdBuffer);
+    if (result != OK) {
+        return result;
+    }
+    result = parcel->writeInt64(dequeueBlockedTime);
+    if (result != OK) {
+        return result;
+    }
+    return parcel->writeUint64(static_cast<uint64_t>(numBlockedDequeues));
 }
 
 status_t OccupancyTracker::Segment::readFromParcel(const Parcel* parcel) {
@@ -57,7 +65,21 @@ status_t OccupancyTracker::Segment::readFromParcel(const Parcel* parcel) {
     if (result != OK) {
         return result;
     }
-    return parcel->readBool(&usedThirdBuffer);
+    result = parcel->readBool(&usedThirdBuffer);
+    if (result != OK) {
+        return result;
+    }
+    result = parcel->readInt64(&dequeueBlockedTime);
+    if (result != OK) {
+        return result;
+    }
+    uint64_t uintNumBlockedDequeues = 0;
+    result = parcel->readUint64(&uintNumBlockedDequeues);
+    if (result != OK) {
+        return result;
+    }
+    numBlockedDequeues = static_cast<size_t>(uintNumBlockedDequeues);
+    return OK;
 }
 
 void OccupancyTracker::registerOccupancyChange(size_t occupancy) {
@@ -81,6 +103,11 @@ void OccupancyTracker::registerOccupancyChange(size_t occupancy) {
     mLastOccupancy = occupancy;
 }
 
+void OccupancyTracker::registerDequeueBlocked(nsecs_t blockedTime) {
+    mPendingSegment.dequeueBlockedTime += blockedTime;
+    ++mPendingSegment.numBlockedDequeues;
+}
+
 std::vector<OccupancyTracker::Segment> OccupancyTracker::getSegmentHistory(
         bool forceFlush) {
     if (forceFlush) {
@@ -106,7 +133,9 @@ void OccupancyTracker::recordPendingSegment() {
             usedThirdBuffer = usedThirdBuffer || (occupancy > 1);
         }
         mSegmentHistory.push_front({mPendingSegment.totalTime,
-                mPendingSegment.numFrames, occupancyAverage, usedThirdBuffer});
+                mPendingSegment.numFrames, occupancyAverage, usedThirdBuffer,
+                mPendingSegment.dequeueBlockedTime,
+                mPendingSegment.numBlockedDequeues});
         if (mSegmentHistory.size() > MAX_HISTORY_SIZE) {
             mSegmentHistory.pop_back();
         }
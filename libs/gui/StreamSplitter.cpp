@@ -58,13 +58,14 @@ status_t StreamSplitter::createSplitter(
 
 StreamSplitter::StreamSplitter(const sp<IGraphicBufferConsumer>& inputQueue)
       : mIsAbandoned(false), mMutex(), mReleaseCondition(),
-        mOutstandingBuffers(0), mInput(inputQueue), mOutputs(), mBuffers() {}
+        mOutstandingBuffers(0), mInput(inputQueue), mOutputs(), mBuffers(),
+        mMaxOutstandingBuffers(MAX_OUTSTANDING_BUFFERS) {}
 
 StreamSplitter::~StreamSplitter() {
     mInput->consumerDisconnect();
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
+    Vector<Output>::iterator output = mOutputs.begin();
     for (; output != mOutputs.end(); ++output) {
-        (*output)->disconnect(NATIVE_WINDOW_API_CPU);
+        output->queue->disconnect(NATIVE_WINDOW_API_CPU);
     }
 
     if (mBuffers.size() > 0) {
@@ -73,7 +74,7 @@ StreamSplitter::~StreamSplitter() {
 }
 
 status_t StreamSplitter::addOutput(
-        const sp<IGraphicBufferProducer>& outputQueue) {
+        const sp<IGraphicBufferProducer>& outputQueue, size_t maxBuffers) {
     if (outputQueue == nullptr) {
         ALOGE("addOutput: outputQueue must not be NULL");
         return BAD_VALUE;
@@ -91,7 +92,18 @@ status_t StreamSplitter::addOutput(
         return status;
     }
 
-    mOutputs.push_back(outputQueue);
+    if (maxBuffers != 0) {
+        status = outputQueue->setAsyncMode(true);
+        if (status != NO_ERROR) {
+            ALOGE("addOutput: failed to set async mode (%d)", status);
+            outputQueue->disconnect(NATIVE_WINDOW_API_CPU);
+            return status;
+        }
+        // The acquired buffers, the one queued, and the one that replaces it
+        mMaxOutstandingBuffers += static_cast<int>(maxBuffers) + 2;
+    }
+
+    mOutputs.push_back(Output{outputQueue, maxBuffers, 0});
 
     return NO_ERROR;
 }
@@ -112,7 +124,7 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
 
     // If there are too many outstanding buffers, we block until a buffer is
     // released back to the input in onBufferReleased
-    while (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
+    while (mOutstandingBuffers >= mMaxOutstandingBuffers) {
         mReleaseCondition.wait(mMutex);
 
         // If the splitter is abandoned while we are waiting, the release
@@ -139,8 +151,8 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             "detaching buffer from input failed (%d)", status);
 
     // Initialize our reference count for this buffer
-    mBuffers.add(bufferItem.mGraphicBuffer->getId(),
-            new BufferTracker(bufferItem.mGraphicBuffer));
+    sp<BufferTracker> tracker(new BufferTracker(bufferItem.mGraphicBuffer));
+    mBuffers.add(bufferItem.mGraphicBuffer->getId(), tracker);
 
     IGraphicBufferProducer::QueueBufferInput queueInput(
             bufferItem.mTimestamp, bufferItem.mIsAutoTimestamp,
@@ -149,17 +161,25 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
             bufferItem.mTransform, bufferItem.mFence);
 
     // Attach and queue the buffer to each of the outputs
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
+    Vector<Output>::iterator output = mOutputs.begin();
     for (; output != mOutputs.end(); ++output) {
+        if (output->maxBuffers != 0 && output->buffers > output->maxBuffers + 1) {
+            // The output's consumer holds more buffers than it should, so it
+            // does not get this one
+            ALOGV("dropped buffer %#" PRIx64 " for output %p",
+                    bufferItem.mGraphicBuffer->getId(), output->queue.get());
+            tracker->incrementReleaseCountLocked();
+            continue;
+        }
+
         int slot;
-        status = (*output)->attachBuffer(&slot, bufferItem.mGraphicBuffer);
+        status = output->queue->attachBuffer(&slot, bufferItem.mGraphicBuffer);
         if (status == NO_INIT) {
             // If we just discovered that this output has been abandoned, note
             // that, increment the release count so that we still release this
             // buffer eventually, and move on to the next output
             onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
+            tracker->incrementReleaseCountLocked();
             continue;
         } else {
             LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
@@ -167,22 +187,37 @@ void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
         }
 
         IGraphicBufferProducer::QueueBufferOutput queueOutput;
-        status = (*output)->queueBuffer(slot, queueInput, &queueOutput);
+        status = output->queue->queueBuffer(slot, queueInput, &queueOutput);
         if (status == NO_INIT) {
             // If we just discovered that this output has been abandoned, note
             // that, increment the release count so that we still release this
             // buffer eventually, and move on to the next output
             onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
+            tracker->incrementReleaseCountLocked();
             continue;
         } else {
             LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
                     "queueing buffer to output failed (%d)", status);
         }
+        ++output->buffers;
 
         ALOGV("queued buffer %#" PRIx64 " to output %p",
-                bufferItem.mGraphicBuffer->getId(), output->get());
+                bufferItem.mGraphicBuffer->getId(), output->queue.get());
+
+        // The buffer took the place of one that the output's consumer had not
+        // acquired yet, which the output now holds as a free buffer
+        if (queueOutput.bufferReplaced) {
+            detachBufferFromOutputLocked(*output);
+        }
+    }
+
+    // Every output may have dropped the buffer
+    if (tracker->getReleaseCount() == mOutputs.size()) {
+        if (mIsAbandoned) {
+            mBuffers.removeItem(bufferItem.mGraphicBuffer->getId());
+        } else {
+            releaseToInputLocked(tracker->getBuffer());
+        }
     }
 }
 
@@ -191,6 +226,17 @@ void StreamSplitter::onBufferReleasedByOutput(
     ATRACE_CALL();
     Mutex::Autolock lock(mMutex);
 
+    for (size_t i = 0; i < mOutputs.size(); ++i) {
+        if (mOutputs[i].queue == from) {
+            detachBufferFromOutputLocked(mOutputs.editItemAt(i));
+            return;
+        }
+    }
+}
+
+void StreamSplitter::detachBufferFromOutputLocked(Output& output) {
+    const sp<IGraphicBufferProducer>& from = output.queue;
+
     sp<GraphicBuffer> buffer;
     sp<Fence> fence;
     status_t status = from->detachNextBuffer(&buffer, &fence);
@@ -206,6 +252,7 @@ void StreamSplitter::onBufferReleasedByOutput(
 
     ALOGV("detached buffer %#" PRIx64 " from output %p",
           buffer->getId(), from.get());
+    --output.buffers;
 
     const sp<BufferTracker>& tracker = mBuffers.editValueFor(buffer->getId());
 
@@ -228,9 +275,15 @@ void StreamSplitter::onBufferReleasedByOutput(
         return;
     }
 
+    releaseToInputLocked(buffer);
+}
+
+void StreamSplitter::releaseToInputLocked(const sp<GraphicBuffer>& buffer) {
+    const sp<BufferTracker> tracker = mBuffers.valueFor(buffer->getId());
+
     // Attach and release the buffer back to the input
     int consumerSlot;
-    status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
+    status_t status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "attaching buffer to input failed (%d)", status);
 
@@ -20,6 +20,7 @@
 
 #include <gui/Surface.h>
 
+#include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <mutex>
@@ -160,7 +161,19 @@ String8 Surface::getConsumerName() const {
 }
 
 status_t Surface::setDequeueTimeout(nsecs_t timeout) {
-    return mGraphicBufferProducer->setDequeueTimeout(timeout);
+    Mutex::Autolock lock(mMutex);
+    if (mDequeueTimeout == timeout) {
+        return NO_ERROR;
+    }
+    status_t err = mGraphicBufferProducer->setDequeueTimeout(timeout);
+    // Whether dequeueBuffer can block changes the minimum undequeued count.
+    mMinUndequeuedBuffers = 0;
+    if (err == NO_ERROR) {
+        mDequeueTimeout = timeout;
+    } else {
+        mDequeueTimeout.reset();
+    }
+    return err;
 }
 
 status_t Surface::getLastQueuedBuffer(sp<GraphicBuffer>* outBuffer,
@@ -217,6 +230,52 @@ status_t Surface::getCompositorTiming(
     return NO_ERROR;
 }
 
+void Surface::setFramePacingEnabled(bool enabled) {
+    if (enabled) {
+        enableFrameTimestamps(true);
+    }
+    Mutex::Autolock lock(mMutex);
+    mFramePacingEnabled = enabled;
+    mPacingLastDeadline = 0;
+    mPacingPresentTime = 0;
+}
+
+status_t Surface::waitForNextFrame(nsecs_t* outExpectedPresentTime) {
+    ATRACE_CALL();
+    nsecs_t renderStart;
+    {
+        Mutex::Autolock lock(mMutex);
+        if (!mFramePacingEnabled) {
+            return INVALID_OPERATION;
+        }
+
+        const nsecs_t start = now();
+        const nsecs_t interval = mFrameEventHistory->getCompositeInterval();
+        const nsecs_t renderDuration = mPacingRenderDuration;
+
+        // Target the first composition that the frame can still make if it
+        // starts now, but never one that an earlier frame already targets.
+        nsecs_t deadline = mFrameEventHistory->getNextCompositeDeadline(start);
+        while (deadline - renderDuration < start || deadline <= mPacingLastDeadline) {
+            deadline += interval;
+        }
+
+        mPacingLastDeadline = deadline;
+        mPacingPresentTime = deadline + mFrameEventHistory->getCompositeToPresentLatency();
+        renderStart = deadline - renderDuration;
+        if (outExpectedPresentTime != nullptr) {
+            *outExpectedPresentTime = mPacingPresentTime;
+        }
+    }
+
+    // Sleep without the lock so the previous frame can still be queued.
+    const nsecs_t sleepTime = renderStart - now();
+    if (sleepTime > 0) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(sleepTime));
+    }
+    return NO_ERROR;
+}
+
 static bool checkConsumerForUpdates(
         const FrameEvents* e, const uint64_t lastFrameNumber,
         const nsecs_t* outLatchTime,
@@ -495,6 +554,70 @@ int Surface::hook_perform(ANativeWindow* window, int operation, ...) {
     return result;
 }
 
+// The perform table hooks go through hook_perform when a perform interceptor
+// is registered, so that it still sees every operation.
+
+int Surface::hook_setBuffersTimestamp(ANativeWindow* window, int64_t timestamp) {
+    Surface* c = getSelf(window);
+    if (c->mHasPerformInterceptor.load(std::memory_order_relaxed)) {
+        return window->perform(window, NATIVE_WINDOW_SET_BUFFERS_TIMESTAMP, timestamp);
+    }
+    return c->setBuffersTimestamp(timestamp);
+}
+
+int Surface::hook_setSurfaceDamage(ANativeWindow* window, const android_native_rect_t* rects,
+                                   size_t numRects) {
+    Surface* c = getSelf(window);
+    if (c->mHasPerformInterceptor.load(std::memory_order_relaxed)) {
+        return window->perform(window, NATIVE_WINDOW_SET_SURFACE_DAMAGE, rects, numRects);
+    }
+    c->setSurfaceDamage(const_cast<android_native_rect_t*>(rects), numRects);
+    return NO_ERROR;
+}
+
+int Surface::hook_setBuffersDataSpace(ANativeWindow* window, int32_t dataSpace) {
+    Surface* c = getSelf(window);
+    if (c->mHasPerformInterceptor.load(std::memory_order_relaxed)) {
+        return window->perform(window, NATIVE_WINDOW_SET_BUFFERS_DATASPACE, dataSpace);
+    }
+    return c->setBuffersDataSpace(static_cast<Dataspace>(dataSpace));
+}
+
+int Surface::hook_setUsage(ANativeWindow* window, uint64_t usage) {
+    Surface* c = getSelf(window);
+    if (c->mHasPerformInterceptor.load(std::memory_order_relaxed)) {
+        return window->perform(window, NATIVE_WINDOW_SET_USAGE64, usage);
+    }
+    return c->setUsage(usage);
+}
+
+int Surface::hook_setDequeueTimeout(ANativeWindow* window, int64_t timeout) {
+    Surface* c = getSelf(window);
+    if (c->mHasPerformInterceptor.load(std::memory_order_relaxed)) {
+        return window->perform(window, NATIVE_WINDOW_SET_DEQUEUE_TIMEOUT, timeout);
+    }
+    return c->setDequeueTimeout(timeout);
+}
+
+int Surface::hook_getNextFrameId(ANativeWindow* window, uint64_t* frameId) {
+    Surface* c = getSelf(window);
+    if (c->mHasPerformInterceptor.load(std::memory_order_relaxed)) {
+        return window->perform(window, NATIVE_WINDOW_GET_NEXT_FRAME_ID, frameId);
+    }
+    *frameId = c->getNextFrameNumber();
+    return NO_ERROR;
+}
+
+const ANativeWindowPerformTable Surface::sPerformTable = {
+        .size = sizeof(ANativeWindowPerformTable),
+        .setBuffersTimestamp = Surface::hook_setBuffersTimestamp,
+        .setSurfaceDamage = Surface::hook_setSurfaceDamage,
+        .setBuffersDataSpace = Surface::hook_setBuffersDataSpace,
+        .setUsage = Surface::hook_setUsage,
+        .setDequeueTimeout = Surface::hook_setDequeueTimeout,
+        .getNextFrameId = Surface::hook_getNextFrameId,
+};
+
 int Surface::performInternal(ANativeWindow* window, int operation, va_list args) {
     Surface* c = getSelf(window);
     return c->perform(operation, args);
@@ -534,7 +657,8 @@ int Surface::setSwapInterval(int interval) {
     mSwapIntervalZero = (interval == 0);
 
     if (mSwapIntervalZero != wasSwapIntervalZero) {
-        mGraphicBufferProducer->setAsyncMode(mSwapIntervalZero);
+        Mutex::Autolock lock(mMutex);
+        setAsyncModeLocked(mSwapIntervalZero);
     }
 
     return NO_ERROR;
@@ -792,7 +916,9 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
     int64_t timestamp;
     bool isAutoTimestamp = false;
 
-    if (mTimestamp == NATIVE_WINDOW_TIMESTAMP_AUTO) {
+    if (mTimestamp == NATIVE_WINDOW_TIMESTAMP_AUTO && mPacingPresentTime != 0) {
+        timestamp = mPacingPresentTime;
+    } else if (mTimestamp == NATIVE_WINDOW_TIMESTAMP_AUTO) {
         timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
         isAutoTimestamp = true;
         ALOGV("Surface::queueBuffer making up timestamp: %.2f ms",
@@ -800,6 +926,15 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
     } else {
         timestamp = mTimestamp;
     }
+    mPacingPresentTime = 0;
+    if (mFramePacingEnabled && mLastDequeueStartTime != 0) {
+        // Weigh the latest frame by 1/4 so the estimate follows load changes
+        // within a few frames without reacting to every outlier.
+        const nsecs_t sample = systemTime() - mLastDequeueStartTime - mLastDequeueDuration;
+        mPacingRenderDuration = mPacingRenderDuration == 0
+                ? sample
+                : (3 * mPacingRenderDuration + sample) / 4;
+    }
     int i = getSlotFromBufferLocked(buffer);
     if (i < 0) {
         if (fenceFd >= 0) {
@@ -927,6 +1062,7 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
     }
 
     mConsumerRunningBehind = (output.numPendingBuffers >= 2);
+    mMinUndequeuedBuffers = output.minUndequeuedBuffers;
 
     if (!mConnectedToCpu) {
         // Clear surface damage back to full-buffer
@@ -1056,6 +1192,17 @@ int Surface::query(int what, int* value) const {
                 *value = mMaxBufferCount;
                 return NO_ERROR;
             }
+            case NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS: {
+                if (mMinUndequeuedBuffers > 0) {
+                    *value = mMinUndequeuedBuffers;
+                    return NO_ERROR;
+                }
+                status_t err = mGraphicBufferProducer->query(what, value);
+                if (err == NO_ERROR) {
+                    mMinUndequeuedBuffers = *value;
+                }
+                return err;
+            }
         }
     }
     return mGraphicBufferProducer->query(what, value);
@@ -1207,6 +1354,9 @@ int Surface::perform(int operation, va_list args)
     case NATIVE_WINDOW_GET_LAST_QUEUED_BUFFER:
         res = dispatchGetLastQueuedBuffer(args);
         break;
+    case NATIVE_WINDOW_GET_PERFORM_TABLE:
+        res = dispatchGetPerformTable(args);
+        break;
     default:
         res = NAME_NOT_FOUND;
         break;
@@ -1467,6 +1617,7 @@ int Surface::dispatchAddPerformInterceptor(va_list args) {
     std::lock_guard<std::shared_mutex> lock(mInterceptorMutex);
     mPerformInterceptor = interceptor;
     mPerformInterceptorData = data;
+    mHasPerformInterceptor = interceptor != nullptr;
     return NO_ERROR;
 }
 
@@ -1489,6 +1640,12 @@ int Surface::dispatchAddQueryInterceptor(va_list args) {
     return NO_ERROR;
 }
 
+int Surface::dispatchGetPerformTable(va_list args) {
+    const ANativeWindowPerformTable** table = va_arg(args, const ANativeWindowPerformTable**);
+    *table = &sPerformTable;
+    return NO_ERROR;
+}
+
 int Surface::dispatchGetLastQueuedBuffer(va_list args) {
     AHardwareBuffer** buffer = va_arg(args, AHardwareBuffer**);
     int* fence = va_arg(args, int*);
@@ -1543,6 +1700,7 @@ int Surface::connect(
     IGraphicBufferProducer::QueueBufferOutput output;
     mReportRemovedBuffers = reportBufferRemoval;
     int err = mGraphicBufferProducer->connect(listener, api, mProducerControlledByApp, &output);
+    resetProducerStateLocked();
     if (err == NO_ERROR) {
         mDefaultWidth = output.width;
         mDefaultHeight = output.height;
@@ -1557,6 +1715,7 @@ int Surface::connect(
         }
 
         mConsumerRunningBehind = (output.numPendingBuffers >= 2);
+        mMinUndequeuedBuffers = output.minUndequeuedBuffers;
     }
     if (!err && api == NATIVE_WINDOW_API_CPU) {
         mConnectedToCpu = true;
@@ -1580,6 +1739,7 @@ int Surface::disconnect(int api, IGraphicBufferProducer::DisconnectMode mode) {
     mSharedBufferHasBeenQueued = false;
     freeAllBuffers();
     int err = mGraphicBufferProducer->disconnect(api, mode);
+    resetProducerStateLocked();
     if (!err) {
         mReqFormat = 0;
         mReqWidth = 0;
@@ -1709,13 +1869,16 @@ int Surface::setBufferCount(int bufferCount)
 
     status_t err = NO_ERROR;
     if (bufferCount == 0) {
-        err = mGraphicBufferProducer->setMaxDequeuedBufferCount(1);
+        err = setMaxDequeuedBufferCountLocked(1);
     } else {
-        int minUndequeuedBuffers = 0;
-        err = mGraphicBufferProducer->query(
-                NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS, &minUndequeuedBuffers);
+        int minUndequeuedBuffers = mMinUndequeuedBuffers;
+        if (minUndequeuedBuffers == 0) {
+            err = mGraphicBufferProducer->query(
+                    NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS, &minUndequeuedBuffers);
+        }
         if (err == NO_ERROR) {
-            err = mGraphicBufferProducer->setMaxDequeuedBufferCount(
+            mMinUndequeuedBuffers = minUndequeuedBuffers;
+            err = setMaxDequeuedBufferCountLocked(
                     bufferCount - minUndequeuedBuffers);
         }
     }
@@ -1731,26 +1894,60 @@ int Surface::setMaxDequeuedBufferCount(int maxDequeuedBuffers) {
     ALOGV("Surface::setMaxDequeuedBufferCount");
     Mutex::Autolock lock(mMutex);
 
-    status_t err = mGraphicBufferProducer->setMaxDequeuedBufferCount(
-            maxDequeuedBuffers);
+    status_t err = setMaxDequeuedBufferCountLocked(maxDequeuedBuffers);
     ALOGE_IF(err, "IGraphicBufferProducer::setMaxDequeuedBufferCount(%d) "
             "returned %s", maxDequeuedBuffers, strerror(-err));
 
     return err;
 }
 
+int Surface::setMaxDequeuedBufferCountLocked(int maxDequeuedBuffers) {
+    if (mMaxDequeuedBufferCount == maxDequeuedBuffers) {
+        return NO_ERROR;
+    }
+    status_t err = mGraphicBufferProducer->setMaxDequeuedBufferCount(maxDequeuedBuffers);
+    if (err == NO_ERROR) {
+        mMaxDequeuedBufferCount = maxDequeuedBuffers;
+    } else {
+        mMaxDequeuedBufferCount.reset();
+    }
+    return err;
+}
+
 int Surface::setAsyncMode(bool async) {
     ATRACE_CALL();
     ALOGV("Surface::setAsyncMode");
     Mutex::Autolock lock(mMutex);
 
-    status_t err = mGraphicBufferProducer->setAsyncMode(async);
+    status_t err = setAsyncModeLocked(async);
     ALOGE_IF(err, "IGraphicBufferProducer::setAsyncMode(%d) returned %s",
             async, strerror(-err));
 
     return err;
 }
 
+int Surface::setAsyncModeLocked(bool async) {
+    if (mAsyncMode == async) {
+        return NO_ERROR;
+    }
+    status_t err = mGraphicBufferProducer->setAsyncMode(async);
+    // The minimum undequeued count depends on the async mode.
+    mMinUndequeuedBuffers = 0;
+    if (err == NO_ERROR) {
+        mAsyncMode = async;
+    } else {
+        mAsyncMode.reset();
+    }
+    return err;
+}
+
+void Surface::resetProducerStateLocked() {
+    mMinUndequeuedBuffers = 0;
+    mMaxDequeuedBufferCount.reset();
+    mAsyncMode.reset();
+    mDequeueTimeout.reset();
+}
+
 int Surface::setSharedBufferMode(bool sharedBufferMode) {
     ATRACE_CALL();
     ALOGV("Surface::setSharedBufferMode (%d)", sharedBufferMode);
@@ -19,6 +19,10 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <atomic>
+#include <list>
+#include <unordered_map>
+
 #include <utils/Errors.h>
 #include <utils/Log.h>
 #include <utils/SortedVector.h>
@@ -281,7 +285,7 @@ public:
         if (itr == mBuffers.end()) {
             return BAD_VALUE;
         }
-        itr->second = getCounter();
+        mLruList.splice(mLruList.begin(), mLruList, itr->second);
         *cacheId = buffer->getId();
         return NO_ERROR;
     }
@@ -295,7 +299,8 @@ public:
 
         buffer->addDeathCallback(removeDeadBufferCallback, nullptr);
 
-        mBuffers[buffer->getId()] = getCounter();
+        mLruList.push_front(buffer->getId());
+        mBuffers[buffer->getId()] = mLruList.begin();
         return buffer->getId();
     }
 
@@ -305,35 +310,24 @@ public:
     }
 
     void uncacheLocked(uint64_t cacheId) REQUIRES(mMutex) {
-        mBuffers.erase(cacheId);
+        auto itr = mBuffers.find(cacheId);
+        if (itr != mBuffers.end()) {
+            mLruList.erase(itr->second);
+            mBuffers.erase(itr);
+        }
         SurfaceComposerClient::doUncacheBufferTransaction(cacheId);
     }
 
 private:
     void evictLeastRecentlyUsedBuffer() REQUIRES(mMutex) {
-        auto itr = mBuffers.begin();
-        uint64_t minCounter = itr->second;
-        auto minBuffer = itr;
-        itr++;
-
-        while (itr != mBuffers.end()) {
-            uint64_t counter = itr->second;
-            if (counter < minCounter) {
-                minCounter = counter;
-                minBuffer = itr;
-            }
-            itr++;
-        }
-        uncacheLocked(minBuffer->first);
-    }
-
-    uint64_t getCounter() REQUIRES(mMutex) {
-        static uint64_t counter = 0;
-        return counter++;
+        uncacheLocked(mLruList.back());
     }
 
     std::mutex mMutex;
-    std::map<uint64_t /*Cache id*/, uint64_t /*counter*/> mBuffers GUARDED_BY(mMutex);
+    // Most recently used first, so eviction takes the back in constant time.
+    std::list<uint64_t /*Cache id*/> mLruList GUARDED_BY(mMutex);
+    std::unordered_map<uint64_t /*Cache id*/, std::list<uint64_t>::iterator> mBuffers
+            GUARDED_BY(mMutex);
 
     // Used by ISurfaceComposer to identify which process is sending the cached buffer.
     sp<IBinder> token;
@@ -631,6 +625,12 @@ void SurfaceComposerClient::Transaction::cacheBuffers() {
     }
 }
 
+static std::atomic_bool sOnewayApplyEnabled(false);
+
+void SurfaceComposerClient::Transaction::setOnewayApplyEnabled(bool enabled) {
+    sOnewayApplyEnabled.store(enabled, std::memory_order_relaxed);
+}
+
 status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
     if (mStatus != NO_ERROR) {
         return mStatus;
@@ -702,6 +702,9 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
     if (mExplicitEarlyWakeupEnd && !mExplicitEarlyWakeupStart) {
         flags |= ISurfaceComposer::eExplicitEarlyWakeupEnd;
     }
+    if (sOnewayApplyEnabled.load(std::memory_order_relaxed)) {
+        flags |= ISurfaceComposer::eOneway;
+    }
 
     mForceSynchronous = false;
     mAnimation = false;
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "VsyncTimeline"
+
+#include <gui/VsyncTimeline.h>
+
+#include <binder/Parcel.h>
+#include <cutils/ashmem.h>
+#include <log/log.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+
+namespace android {
+namespace gui {
+
+// Every field is atomic so that a reader racing with the writer is well defined; the sequence
+// number tells the reader whether the fields it loaded belong to the same update.
+struct VsyncTimeline::Shared {
+    // Odd while an update is in progress, zero until the first one.
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> count;
+    std::atomic<int64_t> timestamp;
+    std::atomic<int64_t> expectedVsyncTimestamp;
+    std::atomic<int64_t> vsyncPeriod;
+    std::atomic<uint32_t> predictionCount;
+    std::atomic<int64_t> predictions[kMaxPredictions];
+};
+
+static_assert(std::atomic<int64_t>::is_always_lock_free,
+              "VsyncTimeline is shared across processes and needs lock-free atomics");
+
+// A reader only retries while the writer is in the middle of an update, which takes a few
+// stores, so this is never reached in practice.
+static constexpr int kMaxReadAttempts = 16;
+
+VsyncTimeline::~VsyncTimeline() {
+    if (mShared != nullptr) {
+        munmap(mShared, sizeof(Shared));
+    }
+}
+
+std::unique_ptr<VsyncTimeline> VsyncTimeline::create(const char* name) {
+    base::unique_fd fd(ashmem_create_region(name, sizeof(Shared)));
+    if (fd < 0) {
+        ALOGE("create: failed to allocate %s (%s)", name, strerror(errno));
+        return nullptr;
+    }
+
+    auto timeline = std::make_unique<VsyncTimeline>();
+    if (timeline->map(std::move(fd), true) != NO_ERROR) {
+        return nullptr;
+    }
+    // Our mapping stays writable, but clients can only map it read-only.
+    if (ashmem_set_prot_region(timeline->mFd, PROT_READ) < 0) {
+        ALOGE("create: failed to write-protect %s (%s)", name, strerror(errno));
+        return nullptr;
+    }
+    return timeline;
+}
+
+status_t VsyncTimeline::map(base::unique_fd fd, bool writable) {
+    const int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* addr = mmap(nullptr, sizeof(Shared), prot, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        const int error = errno;
+        ALOGE("map: mmap failed (%s)", strerror(error));
+        return -error;
+    }
+    if (mShared != nullptr) {
+        munmap(mShared, sizeof(Shared));
+    }
+    mFd = std::move(fd);
+    mShared = static_cast<Shared*>(addr);
+    mWritable = writable;
+    return NO_ERROR;
+}
+
+status_t VsyncTimeline::share(VsyncTimeline* outTimeline) const {
+    if (mFd < 0) {
+        return NO_INIT;
+    }
+    base::unique_fd fd(dup(mFd));
+    if (fd < 0) {
+        return -errno;
+    }
+    // The copy is only ever parceled, so don't bother mapping it.
+    outTimeline->mFd = std::move(fd);
+    return NO_ERROR;
+}
+
+void VsyncTimeline::publish(const Snapshot& snapshot) {
+    if (!mWritable) {
+        ALOGE("publish: timeline is read-only");
+        return;
+    }
+
+    const uint32_t sequence = mShared->sequence.load(std::memory_order_relaxed);
+    mShared->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const size_t predictionCount = std::min(snapshot.predictionCount, kMaxPredictions);
+    mShared->count.store(snapshot.count, std::memory_order_relaxed);
+    mShared->timestamp.store(snapshot.timestamp, std::memory_order_relaxed);
+    mShared->expectedVsyncTimestamp.store(snapshot.expectedVsyncTimestamp,
+                                          std::memory_order_relaxed);
+    mShared->vsyncPeriod.store(snapshot.vsyncPeriod, std::memory_order_relaxed);
+    mShared->predictionCount.store(static_cast<uint32_t>(predictionCount),
+                                   std::memory_order_relaxed);
+    for (size_t i = 0; i < predictionCount; i++) {
+        mShared->predictions[i].store(snapshot.predictions[i], std::memory_order_relaxed);
+    }
+
+    mShared->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+status_t VsyncTimeline::read(Snapshot* outSnapshot) const {
+    if (mShared == nullptr) {
+        return NO_INIT;
+    }
+
+    for (int attempt = 0; attempt < kMaxReadAttempts; attempt++) {
+        const uint32_t sequence = mShared->sequence.load(std::memory_order_acquire);
+        if (sequence == 0) {
+            return NOT_ENOUGH_DATA;
+        }
+        if (sequence & 1) {
+            continue;
+        }
+
+        Snapshot snapshot;
+        snapshot.count = mShared->count.load(std::memory_order_relaxed);
+        snapshot.timestamp = mShared->timestamp.load(std::memory_order_relaxed);
+        snapshot.expectedVsyncTimestamp =
+                mShared->expectedVsyncTimestamp.load(std::memory_order_relaxed);
+        snapshot.vsyncPeriod = mShared->vsyncPeriod.load(std::memory_order_relaxed);
+        snapshot.predictionCount = std::min<size_t>(mShared->predictionCount.load(
+                                                            std::memory_order_relaxed),
+                                                    kMaxPredictions);
+        for (size_t i = 0; i < snapshot.predictionCount; i++) {
+            snapshot.predictions[i] = mShared->predictions[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mShared->sequence.load(std::memory_order_relaxed) == sequence) {
+            *outSnapshot = snapshot;
+            return NO_ERROR;
+        }
+    }
+    return WOULD_BLOCK;
+}
+
+status_t VsyncTimeline::writeToParcel(Parcel* parcel) const {
+    if (mFd < 0) {
+        return NO_INIT;
+    }
+    return parcel->writeDupFileDescriptor(mFd);
+}
+
+status_t VsyncTimeline::readFromParcel(const Parcel* parcel) {
+    base::unique_fd fd;
+    status_t result = parcel->readUniqueFileDescriptor(&fd);
+    if (result != NO_ERROR) {
+        return result;
+    }
+    return map(std::move(fd), false);
+}
+
+} // namespace gui
+} // namespace android
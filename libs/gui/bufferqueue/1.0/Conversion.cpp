@@ -16,6 +16,9 @@
 
 #include <gui/bufferqueue/1.0/Conversion.h>
 
+#include <memory>
+#include <new>
+
 namespace android {
 namespace conversion {
 
@@ -65,6 +68,32 @@ int native_handle_read_fd(native_handle_t const* nh, int index) {
             -1 : nh->data[index];
 }
 
+namespace {
+
+/**
+ * \brief A flat buffer for the conversions made on every frame, which lives
+ * on the stack unless it needs more than \p N elements.
+ */
+template <typename T, size_t N>
+class FlatBuffer {
+public:
+    explicit FlatBuffer(size_t size)
+          : mHeap(size > N ? new (std::nothrow) T[size] : nullptr),
+            mData(size > N ? mHeap.get() : mInline) {}
+
+    T* get() { return mData; }
+
+private:
+    T mInline[N];
+    std::unique_ptr<T[]> mHeap;
+    T* const mData;
+};
+
+// Room for the non-fd part of a QueueBufferInput with a few damage rects.
+constexpr size_t kInlineFlatBufferSize = 256;
+
+} // namespace
+
 /**
  * Conversion functions
  * ====================
@@ -430,37 +459,19 @@ status_t flattenFence(hidl_handle const& fence,
  */
 // wrap: Fence -> hidl_handle
 bool wrapAs(hidl_handle* t, native_handle_t** nh, Fence const& l) {
-    size_t const baseSize = l.getFlattenedSize();
-    std::unique_ptr<uint8_t[]> baseBuffer(
-            new (std::nothrow) uint8_t[baseSize]);
-    if (!baseBuffer) {
-        return false;
-    }
-
-    size_t const baseNumFds = l.getFdCount();
-    std::unique_ptr<int[]> baseFds(
-            new (std::nothrow) int[baseNumFds]);
-    if (!baseFds) {
-        return false;
-    }
-
-    void* buffer = static_cast<void*>(baseBuffer.get());
-    size_t size = baseSize;
-    int* fds = static_cast<int*>(baseFds.get());
-    size_t numFds = baseNumFds;
-    if (l.flatten(buffer, size, fds, numFds) != NO_ERROR) {
-        return false;
+    // Same result as flattening l and unflattening it with unflattenFence(),
+    // without the flat buffers.
+    int const fd = l.get();
+    if (fd == -1) {
+        *nh = nullptr;
+        *t = hidl_handle();
+        return true;
     }
-
-    void const* constBuffer = static_cast<void const*>(baseBuffer.get());
-    size = baseSize;
-    int const* constFds = static_cast<int const*>(baseFds.get());
-    numFds = baseNumFds;
-    if (unflattenFence(t, nh, constBuffer, size, constFds, numFds)
-            != NO_ERROR) {
+    *nh = native_handle_create_from_fd(fd);
+    if (*nh == nullptr) {
         return false;
     }
-
+    *t = *nh;
     return true;
 }
 
@@ -482,48 +493,21 @@ bool convertTo(Fence* l, hidl_handle const& t) {
             return false;
         }
     }
-    native_handle_t* nh = native_handle_create_from_fd(fd);
-    if (nh == nullptr) {
+
+    // A flattened Fence is its number of file descriptors, followed by the
+    // file descriptor itself in the fd buffer.
+    uint32_t const flatNumFds = fd == -1 ? 0 : 1;
+    void const* buffer = &flatNumFds;
+    size_t size = sizeof(flatNumFds);
+    int const* fds = &fd;
+    size_t numFds = flatNumFds;
+    if (l->unflatten(buffer, size, fds, numFds) != NO_ERROR) {
         if (fd != -1) {
             close(fd);
         }
         return false;
     }
 
-    size_t const baseSize = getFenceFlattenedSize(t);
-    std::unique_ptr<uint8_t[]> baseBuffer(
-            new (std::nothrow) uint8_t[baseSize]);
-    if (!baseBuffer) {
-        native_handle_delete(nh);
-        return false;
-    }
-
-    size_t const baseNumFds = getFenceFdCount(t);
-    std::unique_ptr<int[]> baseFds(
-            new (std::nothrow) int[baseNumFds]);
-    if (!baseFds) {
-        native_handle_delete(nh);
-        return false;
-    }
-
-    void* buffer = static_cast<void*>(baseBuffer.get());
-    size_t size = baseSize;
-    int* fds = static_cast<int*>(baseFds.get());
-    size_t numFds = baseNumFds;
-    if (flattenFence(hidl_handle(nh), buffer, size, fds, numFds) != NO_ERROR) {
-        native_handle_delete(nh);
-        return false;
-    }
-    native_handle_delete(nh);
-
-    void const* constBuffer = static_cast<void const*>(baseBuffer.get());
-    size = baseSize;
-    int const* constFds = static_cast<int const*>(baseFds.get());
-    numFds = baseNumFds;
-    if (l->unflatten(constBuffer, size, constFds, numFds) != NO_ERROR) {
-        return false;
-    }
-
     return true;
 }
 
@@ -1123,25 +1107,17 @@ status_t flatten(Region const& t, void*& buffer, size_t& size) {
  */
 // convert: ::android::Region -> Region
 bool convertTo(Region* t, ::android::Region const& l) {
-    size_t const baseSize = l.getFlattenedSize();
-    std::unique_ptr<uint8_t[]> baseBuffer(
-            new (std::nothrow) uint8_t[baseSize]);
-    if (!baseBuffer) {
-        return false;
-    }
-
-    void* buffer = static_cast<void*>(baseBuffer.get());
-    size_t size = baseSize;
-    if (l.flatten(buffer, size) != NO_ERROR) {
-        return false;
-    }
-
-    void const* constBuffer = static_cast<void const*>(baseBuffer.get());
-    size = baseSize;
-    if (unflatten(t, constBuffer, size) != NO_ERROR) {
-        return false;
+    // The rects of l, as l.flatten() would write them.
+    size_t numRects;
+    ::android::Rect const* rects = l.getArray(&numRects);
+    t->resize(numRects);
+    for (size_t r = 0; r < numRects; ++r) {
+        (*t)[r] = Rect{
+                static_cast<int32_t>(rects[r].left),
+                static_cast<int32_t>(rects[r].top),
+                static_cast<int32_t>(rects[r].right),
+                static_cast<int32_t>(rects[r].bottom)};
     }
-
     return true;
 }
 
@@ -1153,10 +1129,11 @@ bool convertTo(Region* t, ::android::Region const& l) {
  */
 // convert: Region -> ::android::Region
 bool convertTo(::android::Region* l, Region const& t) {
+    // Still goes through ::android::Region::unflatten(), which checks that
+    // the rects received make a valid region.
     size_t const baseSize = getFlattenedSize(t);
-    std::unique_ptr<uint8_t[]> baseBuffer(
-            new (std::nothrow) uint8_t[baseSize]);
-    if (!baseBuffer) {
+    FlatBuffer<uint8_t, kInlineFlatBufferSize> baseBuffer(baseSize);
+    if (!baseBuffer.get()) {
         return false;
     }
 
@@ -1338,16 +1315,14 @@ bool convertTo(
         HGraphicBufferProducer::QueueBufferInput const& t) {
 
     size_t const baseSize = getFlattenedSize(t);
-    std::unique_ptr<uint8_t[]> baseBuffer(
-            new (std::nothrow) uint8_t[baseSize]);
-    if (!baseBuffer) {
+    FlatBuffer<uint8_t, kInlineFlatBufferSize> baseBuffer(baseSize);
+    if (!baseBuffer.get()) {
         return false;
     }
 
     size_t const baseNumFds = getFdCount(t);
-    std::unique_ptr<int[]> baseFds(
-            new (std::nothrow) int[baseNumFds]);
-    if (!baseFds) {
+    FlatBuffer<int, 1> baseFds(baseNumFds);
+    if (!baseFds.get()) {
         return false;
     }
 
@@ -105,15 +105,23 @@ HFenceWrapper::HFenceWrapper(native_handle_t* h) : mHandle{h} {
 }
 
 HFenceWrapper::~HFenceWrapper() {
-    native_handle_delete(mHandle);
+    set(nullptr);
 }
 
 HFenceWrapper& HFenceWrapper::set(native_handle_t* h) {
-    native_handle_delete(mHandle);
+    if (mHandle != reinterpret_cast<native_handle_t*>(mStorage)) {
+        native_handle_delete(mHandle);
+    }
     mHandle = h;
     return *this;
 }
 
+HFenceWrapper& HFenceWrapper::setFd(int fd) {
+    native_handle_t* nh = native_handle_init(mStorage, 1, 0);
+    nh->data[0] = fd;
+    return set(nh);
+}
+
 HFenceWrapper& HFenceWrapper::operator=(native_handle_t* h) {
     return set(h);
 }
@@ -136,18 +144,13 @@ bool b2h(sp<BFence> const& from, HFenceWrapper* to) {
         to->set(nullptr);
         return true;
     }
-    native_handle_t* nh = native_handle_create(1, 0);
-    if (!nh) {
-        return false;
-    }
-    nh->data[0] = fenceFd;
-    to->set(nh);
+    to->setFd(fenceFd);
     return true;
 }
 
 bool h2b(native_handle_t const* from, sp<BFence>* to) {
     if (!from || from->numFds == 0) {
-        *to = new ::android::Fence();
+        *to = BFence::NO_FENCE;
         return true;
     }
     if (from->numFds != 1 || from->numInts != 0) {
@@ -27,6 +27,8 @@
 #include <utils/RefBase.h>
 
 #include <system/window.h>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 
 namespace android {
@@ -62,6 +64,42 @@ private:
     bool mPreviouslyConnected GUARDED_BY(mFrameEventHistoryMutex);
 };
 
+// Coalesces the buffer transactions of several BLASTBufferQueues into one
+// transaction per window, so a client updating many surfaces every frame makes
+// one binder call and wakes SurfaceFlinger once instead of once per surface.
+//
+// The first transaction submitted after a flush starts the window; everything
+// submitted before it closes is merged and applied together. The window should
+// be well under a vsync period, since it adds to each buffer's latency.
+class BLASTTransactionBatcher : public RefBase {
+public:
+    explicit BLASTTransactionBatcher(nsecs_t window);
+    ~BLASTTransactionBatcher() override;
+
+    // Takes over the contents of |t|. The merged transaction is presented no
+    // earlier than the latest |desiredPresentTime| in the batch.
+    void submit(SurfaceComposerClient::Transaction* t, nsecs_t desiredPresentTime);
+
+    // Applies whatever is batched right away.
+    void flush();
+
+private:
+    void threadMain();
+    void flushLocked(std::unique_lock<std::mutex>& lock) REQUIRES(mMutex);
+
+    const nsecs_t mWindow;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    SurfaceComposerClient::Transaction mPending GUARDED_BY(mMutex);
+    bool mHasPending GUARDED_BY(mMutex) = false;
+    nsecs_t mPendingDeadline GUARDED_BY(mMutex) = 0;
+    nsecs_t mPendingPresentTime GUARDED_BY(mMutex) = -1;
+    bool mStopping GUARDED_BY(mMutex) = false;
+
+    std::thread mThread;
+};
+
 class BLASTBufferQueue
     : public ConsumerBase::FrameAvailableListener, public BufferItemConsumer::BufferFreedListener
 {
@@ -83,6 +121,11 @@ public:
 
     void update(const sp<SurfaceControl>& surface, int width, int height);
 
+    // Hands buffer transactions to |batcher| instead of applying them one at
+    // a time; pass nullptr to go back to applying them directly. Transactions
+    // given through setNextTransaction() are never batched.
+    void setTransactionBatcher(const sp<BLASTTransactionBatcher>& batcher);
+
     virtual ~BLASTBufferQueue() = default;
 
 private:
@@ -125,6 +168,8 @@ private:
     sp<BLASTBufferItemConsumer> mBufferItemConsumer;
 
     SurfaceComposerClient::Transaction* mNextTransaction GUARDED_BY(mMutex);
+
+    sp<BLASTTransactionBatcher> mTransactionBatcher GUARDED_BY(mMutex);
 };
 
 } // namespace android
@@ -22,6 +22,8 @@
 #include <gui/BufferSlot.h>
 #include <gui/OccupancyTracker.h>
 
+#include <ui/GraphicBufferPool.h>
+
 #include <utils/NativeHandle.h>
 #include <utils/RefBase.h>
 #include <utils/String8.h>
@@ -130,6 +132,26 @@ private:
     // waitWhileAllocatingLocked blocks until mIsAllocating is false.
     void waitWhileAllocatingLocked(std::unique_lock<std::mutex>& lock) const;
 
+    // recordFreeSlotWaitLocked records time a producer spent blocked in
+    // waitForFreeSlotThenRelock, both in mFreeSlotWaitStats and in the
+    // current occupancy segment.
+    void recordFreeSlotWaitLocked(nsecs_t duration);
+
+    // StallStats is a histogram of how long one kind of producer stall took.
+    struct StallStats {
+        // Bucket i counts stalls in [2^i, 2^(i+1)) microseconds; the last
+        // bucket is open ended.
+        static constexpr size_t kBuckets = 16;
+
+        void record(nsecs_t duration);
+        void dump(const String8& prefix, const char* name, String8* outResult) const;
+
+        uint64_t count = 0;
+        nsecs_t totalTime = 0;
+        nsecs_t maxTime = 0;
+        uint64_t histogram[kBuckets] = {};
+    };
+
 #if DEBUG_ONLY_CODE
     // validateConsistencyLocked ensures that the free lists are in sync with
     // the information stored in mSlots
@@ -344,6 +366,22 @@ private:
 
     OccupancyTracker mOccupancyTracker;
 
+    // Where the producer spent its time blocked, so that dropped frames can
+    // be attributed to buffer starvation: waiting in dequeueBuffer for a free
+    // slot, allocating buffers in dequeueBuffer or allocateBuffers, and
+    // waiting on fences in dequeueBuffer or queueBuffer. mReallocationCount
+    // counts buffers that dequeueBuffer had to replace because their size,
+    // format or usage no longer matched.
+    StallStats mFreeSlotWaitStats;
+    StallStats mAllocationStats;
+    StallStats mFenceWaitStats;
+    uint64_t mReallocationCount;
+
+    // Buffers dequeueBuffer replaced, kept for when the producer asks for
+    // their size again. Only this queue reuses them, so no other producer
+    // sees what was drawn into them.
+    GraphicBufferPool mBufferPool;
+
     const uint64_t mUniqueId;
 
     // When buffer size is driven by the consumer and mTransformHint specifies
@@ -22,8 +22,17 @@
 #include <gui/ConsumerBase.h>
 #include <gui/BufferQueue.h>
 
+#include <ui/GraphicTypes.h>
+
 #include <utils/Vector.h>
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 
 namespace android {
 
@@ -93,6 +102,7 @@ class CpuConsumer : public ConsumerBase
     // how many buffers can be locked for user access at the same time.
     CpuConsumer(const sp<IGraphicBufferConsumer>& bq,
             size_t maxLockedBuffers, bool controlledByApp = false);
+    ~CpuConsumer() override;
 
     // Gets the next graphics buffer from the producer and locks it for CPU use,
     // filling out the passed-in locked buffer structure with the native pointer
@@ -111,6 +121,33 @@ class CpuConsumer : public ConsumerBase
     // lockNextBuffer.
     status_t unlockBuffer(const LockedBuffer &nativeBuffer);
 
+    // Called by lockNextBufferAsync once the buffer is locked, or could not
+    // be. On success the buffer must be returned with unlockBuffer, like the
+    // buffers locked by lockNextBuffer.
+    typedef std::function<void(status_t err, const LockedBuffer& nativeBuffer)>
+            LockedBufferCallback;
+
+    // Like lockNextBuffer, but does not wait for the producer to be done with
+    // the buffer. The buffer is acquired right away and counts against
+    // maxLockedBuffers from then on, but it is only locked once its acquire
+    // fence has signaled, on a thread of the CpuConsumer that then calls
+    // callback. Returns the same errors as lockNextBuffer for the acquire;
+    // if the lock fails, callback gets the error and the buffer is released.
+    // Buffers still waiting for their fence when the CpuConsumer is destroyed
+    // are dropped without calling callback.
+    status_t lockNextBufferAsync(const LockedBufferCallback& callback);
+
+    // Gets the gralloc plane layouts of a locked buffer, which describe every
+    // plane, including for the formats that LockedBuffer can not describe
+    // such as 10-bit YUV. They are cached for as long as the buffer stays in
+    // its slot. Returns BAD_VALUE if the buffer is not locked, or the error
+    // from the mapper, such as if it predates gralloc 4.
+    status_t getPlaneLayouts(const LockedBuffer& nativeBuffer,
+            std::vector<ui::PlaneLayout>* outPlaneLayouts);
+
+  protected:
+    void freeBufferLocked(int slotIndex) override;
+
   private:
     // Maximum number of buffers that can be locked at a time
     const size_t mMaxLockedBuffers;
@@ -118,6 +155,8 @@ class CpuConsumer : public ConsumerBase
     // Tracking for buffers acquired by the user
     struct AcquiredBuffer {
         static constexpr uintptr_t kUnusedId = 0;
+        // For buffers acquired by lockNextBufferAsync that are not locked yet.
+        static constexpr uintptr_t kPendingId = 1;
 
         // Need to track the original mSlot index and the buffer itself because
         // the mSlot entry may be freed/reused before the acquired buffer is
@@ -146,6 +185,28 @@ class CpuConsumer : public ConsumerBase
 
     // Count of currently locked buffers
     size_t mCurrentLockedBuffers;
+
+    // The plane layouts of the buffers in mSlots, empty until queried.
+    std::vector<ui::PlaneLayout> mPlaneLayouts[BufferQueueDefs::NUM_BUFFER_SLOTS];
+
+    // A buffer acquired by lockNextBufferAsync, with the index of the entry
+    // of mAcquiredBuffers reserved for it.
+    struct PendingLock {
+        BufferItem item;
+        size_t acquiredIndex;
+        LockedBufferCallback callback;
+    };
+
+    // Locks the buffers of mPendingLocks as their fences signal.
+    void lockThreadMain();
+
+    // mLockMutex guards mPendingLocks, mStopLockThread and mLockThread, which
+    // is started by the first lockNextBufferAsync.
+    std::mutex mLockMutex;
+    std::condition_variable mLockCondition;
+    std::deque<PendingLock> mPendingLocks;
+    bool mStopLockThread = false;
+    std::thread mLockThread;
 };
 
 } // namespace android
@@ -36,12 +36,22 @@ public:
     virtual int handleEvent(int receiveFd, int events, void* data);
 
 protected:
+    // The frame timeline of the vsync last dispatched through dispatchVsync().
+    struct VsyncEventData {
+        int64_t id = 0;
+        nsecs_t deadlineTimestamp = 0;
+        nsecs_t expectedPresentTimestamp = 0;
+    };
+
     virtual ~DisplayEventDispatcher() = default;
 
+    const VsyncEventData& getLastVsyncEventData() const { return mLastVsyncEventData; }
+
 private:
     sp<Looper> mLooper;
     DisplayEventReceiver mReceiver;
     bool mWaitingForVsync;
+    VsyncEventData mLastVsyncEventData;
 
     virtual void dispatchVsync(nsecs_t timestamp, PhysicalDisplayId displayId, uint32_t count) = 0;
     virtual void dispatchHotplug(nsecs_t timestamp, PhysicalDisplayId displayId,
@@ -53,6 +63,6 @@ private:
     virtual void dispatchNullEvent(nsecs_t timestamp, PhysicalDisplayId displayId) = 0;
 
     bool processPendingEvents(nsecs_t* outTimestamp, PhysicalDisplayId* outDisplayId,
-                              uint32_t* outCount);
+                              uint32_t* outCount, VsyncEventData* outVsyncEventData);
 };
 } // namespace android
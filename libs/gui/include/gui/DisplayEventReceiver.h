@@ -26,6 +26,9 @@
 
 #include <binder/IInterface.h>
 #include <gui/ISurfaceComposer.h>
+#include <gui/VsyncTimeline.h>
+
+#include <memory>
 
 // ----------------------------------------------------------------------------
 
@@ -67,6 +70,12 @@ public:
         struct VSync {
             uint32_t count;
             nsecs_t expectedVSyncTimestamp;
+            // When a frame started on this event is expected to be presented, if its buffer
+            // is queued before deadlineTimestamp.
+            nsecs_t expectedPresentTimestamp;
+            nsecs_t deadlineTimestamp;
+            // Identifies the frame to SurfaceFlinger. Never reused, 0 if unknown.
+            int64_t vsyncId;
         };
 
         struct Hotplug {
@@ -148,9 +157,21 @@ public:
      */
     status_t requestNextVsync();
 
+    /*
+     * getVsyncTimeline() reads the latest VSYNC timing SurfaceFlinger published to shared
+     * memory, along with predictions of the next few VSYNCs. It neither requests nor waits for
+     * a VSYNC event, so clients that only need to schedule work against the display can call
+     * it instead of waking up every frame. The timeline only advances while some client of the
+     * same event thread receives VSYNC events. Returns NOT_ENOUGH_DATA until the first VSYNC
+     * has been published.
+     */
+    status_t getVsyncTimeline(gui::VsyncTimeline::Snapshot* outSnapshot);
+
 private:
     sp<IDisplayEventConnection> mEventConnection;
     std::unique_ptr<gui::BitTube> mDataChannel;
+    // Fetched from the connection the first time getVsyncTimeline() is called.
+    std::unique_ptr<gui::VsyncTimeline> mVsyncTimeline;
 };
 
 // ----------------------------------------------------------------------------
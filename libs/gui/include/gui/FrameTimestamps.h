@@ -296,6 +296,16 @@ private:
             &fed->mReleaseFence
         }};
     }
+
+    template <typename ThisT>
+    static inline auto allTimestamps(ThisT fed) ->
+            std::array<decltype(&fed->mPostedTime), 6> {
+        return {{
+            &fed->mPostedTime, &fed->mRequestedPresentTime, &fed->mLatchTime,
+            &fed->mFirstRefreshStartTime, &fed->mLastRefreshStartTime,
+            &fed->mDequeueReadyTime
+        }};
+    }
 };
 
 
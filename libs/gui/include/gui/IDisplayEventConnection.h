@@ -27,6 +27,7 @@ namespace android {
 
 namespace gui {
 class BitTube;
+class VsyncTimeline;
 } // namespace gui
 
 class IDisplayEventConnection : public IInterface {
@@ -51,6 +52,13 @@ public:
      * requestNextVsync() schedules the next vsync event. It has no effect if the vsync rate is > 0.
      */
     virtual void requestNextVsync() = 0; // Asynchronous
+
+    /*
+     * getVsyncTimeline() returns a read-only view of the shared-memory VsyncTimeline that is
+     * updated whenever this connection's event thread dispatches a VSYNC, whether or not this
+     * connection asked for it.
+     */
+    virtual status_t getVsyncTimeline(gui::VsyncTimeline* outTimeline) = 0;
 };
 
 class BnDisplayEventConnection : public SafeBnInterface<IDisplayEventConnection> {
@@ -385,6 +385,8 @@ public:
         FrameEventHistoryDelta frameTimestamps;
         bool bufferReplaced{false};
         int maxBufferCount{0};
+        // The value of NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS, or 0 if unknown.
+        int minUndequeuedBuffers{0};
     };
 
     // queueBuffer indicates that the client has finished filling in the
@@ -95,6 +95,11 @@ public:
         // android.permission.ACCESS_SURFACE_FLINGER
         eExplicitEarlyWakeupStart = 0x08,
         eExplicitEarlyWakeupEnd = 0x10,
+
+        // Send the transaction as a oneway binder call, so the caller doesn't
+        // wait for SurfaceFlinger to queue it. Has no effect together with
+        // eSynchronous or eAnimation, which rely on the caller blocking.
+        eOneway = 0x20,
     };
 
     enum VsyncSource {
@@ -28,6 +28,7 @@
 #include <cstdint>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace android {
 
@@ -36,11 +37,38 @@ class ListenerCallbacks;
 
 using CallbackId = int64_t;
 
+// The stats sent in one callback often share their fences: every transaction has the same present
+// fence, and every surface composited in the same frame has the same GPU composition fence.
+// Instead of sending a file descriptor per use, each fence is written to the parcel once, ahead of
+// the stats, which then refer to it by index.
+class FenceTable {
+public:
+    status_t writeToParcel(Parcel* output) const;
+    status_t readFromParcel(const Parcel* input);
+
+    // Adds a fence to the table, unless it is null or already there.
+    void add(const sp<Fence>& fence);
+
+    // Writes a reference to a fence that was added to the table.
+    status_t writeFence(Parcel* output, const sp<Fence>& fence) const;
+    // Reads a reference written by writeFence.
+    status_t readFence(const Parcel* input, sp<Fence>* outFence) const;
+
+private:
+    std::vector<sp<Fence>> mFences;
+    std::unordered_map<const Fence*, int32_t> mIndices;
+};
+
 class FrameEventHistoryStats : public Parcelable {
 public:
     status_t writeToParcel(Parcel* output) const override;
     status_t readFromParcel(const Parcel* input) override;
 
+    // Like the above, with the fences in a shared table.
+    void addFences(FenceTable* fences) const;
+    status_t writeToParcel(Parcel* output, const FenceTable& fences) const;
+    status_t readFromParcel(const Parcel* input, const FenceTable& fences);
+
     FrameEventHistoryStats() = default;
     FrameEventHistoryStats(uint64_t fn, const sp<Fence>& gpuCompFence, CompositorTiming compTiming,
                            nsecs_t refreshTime, nsecs_t dequeueReadyTime)
@@ -62,6 +90,11 @@ public:
     status_t writeToParcel(Parcel* output) const override;
     status_t readFromParcel(const Parcel* input) override;
 
+    // Like the above, with the fences in a shared table.
+    void addFences(FenceTable* fences) const;
+    status_t writeToParcel(Parcel* output, const FenceTable& fences) const;
+    status_t readFromParcel(const Parcel* input, const FenceTable& fences);
+
     SurfaceStats() = default;
     SurfaceStats(const sp<IBinder>& sc, nsecs_t time, const sp<Fence>& prevReleaseFence,
                  uint32_t hint, FrameEventHistoryStats frameEventStats)
@@ -83,6 +116,11 @@ public:
     status_t writeToParcel(Parcel* output) const override;
     status_t readFromParcel(const Parcel* input) override;
 
+    // Like the above, with the fences in a shared table.
+    void addFences(FenceTable* fences) const;
+    status_t writeToParcel(Parcel* output, const FenceTable& fences) const;
+    status_t readFromParcel(const Parcel* input, const FenceTable& fences);
+
     TransactionStats() = default;
     TransactionStats(const std::vector<CallbackId>& ids) : callbackIds(ids) {}
     TransactionStats(const std::unordered_set<CallbackId>& ids)
@@ -43,14 +43,19 @@ public:
           : totalTime(0),
             numFrames(0),
             occupancyAverage(0.0f),
-            usedThirdBuffer(false) {}
+            usedThirdBuffer(false),
+            dequeueBlockedTime(0),
+            numBlockedDequeues(0) {}
 
         Segment(nsecs_t _totalTime, size_t _numFrames, float _occupancyAverage,
-                bool _usedThirdBuffer)
+                bool _usedThirdBuffer, nsecs_t _dequeueBlockedTime = 0,
+                size_t _numBlockedDequeues = 0)
           : totalTime(_totalTime),
             numFrames(_numFrames),
             occupancyAverage(_occupancyAverage),
-            usedThirdBuffer(_usedThirdBuffer) {}
+            usedThirdBuffer(_usedThirdBuffer),
+            dequeueBlockedTime(_dequeueBlockedTime),
+            numBlockedDequeues(_numBlockedDequeues) {}
 
         // Parcelable interface
         virtual status_t writeToParcel(Parcel* parcel) const override;
@@ -67,9 +72,17 @@ public:
         // segment could read as double-buffered on average, but still require a
         // third buffer to avoid jank for some smaller portion)
         bool usedThirdBuffer;
+
+        // Total time the producer spent blocked waiting for a free slot
+        // during this segment, and how many dequeues had to wait at all. A
+        // segment with frame drops and a large blocked time was starved of
+        // buffers rather than slow to render.
+        nsecs_t dequeueBlockedTime;
+        size_t numBlockedDequeues;
     };
 
     void registerOccupancyChange(size_t occupancy);
+    void registerDequeueBlocked(nsecs_t blockedTime);
     std::vector<Segment> getSegmentHistory(bool forceFlush);
 
 private:
@@ -81,11 +94,15 @@ private:
         void clear() {
             totalTime = 0;
             numFrames = 0;
+            dequeueBlockedTime = 0;
+            numBlockedDequeues = 0;
             mOccupancyTimes.clear();
         }
 
         nsecs_t totalTime;
         size_t numFrames;
+        nsecs_t dequeueBlockedTime;
+        size_t numBlockedDequeues;
         std::unordered_map<size_t, nsecs_t> mOccupancyTimes;
     };
 
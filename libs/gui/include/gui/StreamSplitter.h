@@ -61,7 +61,18 @@ public:
     // outputQueue has not been added to the splitter. BAD_VALUE is returned if
     // outputQueue is NULL. See IGraphicBufferProducer::connect for explanations
     // of other error codes.
-    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue);
+    //
+    // By default, the splitter waits for an output to release its buffers
+    // before sending it more, so a slow output slows down the input and every
+    // other output with it. A nonzero maxBuffers lets the output fall behind
+    // instead, dropping its oldest frames. It should be the number of buffers
+    // the output's consumer acquires at once. The output is put in async mode,
+    // so that a new frame replaces a queued frame that its consumer has not
+    // acquired yet, and the splitter lets the output hold maxBuffers + 1
+    // buffers without stalling the input. If the consumer holds more, the
+    // splitter skips frames for the output rather than wait for it.
+    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue,
+            size_t maxBuffers = 0);
 
     // setName sets the consumer name of the input queue
     void setName(const String8& name);
@@ -86,6 +97,8 @@ private:
     // We don't care about sideband streams, since we won't be splitting them
     virtual void onSidebandStreamChanged() {}
 
+    struct Output;
+
     // This is the implementation of the onBufferReleased callback from
     // IProducerListener. It gets called from an OutputListener (see below), and
     // 'from' is which producer interface from which the callback was received.
@@ -97,6 +110,15 @@ private:
     // onFrameAvailable call to proceed.
     void onBufferReleasedByOutput(const sp<IGraphicBufferProducer>& from);
 
+    // Detaches the next released buffer from output and counts the release,
+    // returning the buffer to the input if it was the last output holding it.
+    // This must be called with mMutex locked.
+    void detachBufferFromOutputLocked(Output& output);
+
+    // Releases a buffer that no output holds anymore back to the input. This
+    // must be called with mMutex locked.
+    void releaseToInputLocked(const sp<GraphicBuffer>& buffer);
+
     // When this is called, the splitter disconnects from (i.e., abandons) its
     // input queue and signals any waiting onFrameAvailable calls to wake up.
     // It still processes callbacks from other outputs, but only detaches their
@@ -138,6 +160,7 @@ private:
         // Returns the new value
         // Only called while mMutex is held
         size_t incrementReleaseCountLocked() { return ++mReleaseCount; }
+        size_t getReleaseCount() const { return mReleaseCount; }
 
     private:
         // Only destroy through LightRefBase
@@ -161,6 +184,10 @@ private:
 
     static const int MAX_OUTSTANDING_BUFFERS = 2;
 
+    // mMaxOutstandingBuffers is MAX_OUTSTANDING_BUFFERS plus the buffers that
+    // the outputs with a maxBuffers may hold.
+    int mMaxOutstandingBuffers;
+
     // mIsAbandoned is set to true when an output dies. Once the StreamSplitter
     // has been abandoned, it will continue to detach buffers from other
     // outputs, but it will disconnect from the input and not attempt to
@@ -171,7 +198,15 @@ private:
     Condition mReleaseCondition;
     int mOutstandingBuffers;
     sp<IGraphicBufferConsumer> mInput;
-    Vector<sp<IGraphicBufferProducer> > mOutputs;
+
+    struct Output {
+        sp<IGraphicBufferProducer> queue;
+        // The most buffers the output may hold, or 0 for no limit.
+        size_t maxBuffers;
+        // The buffers queued to the output that it has not released yet.
+        size_t buffers;
+    };
+    Vector<Output> mOutputs;
 
     // Map of GraphicBuffer IDs (GraphicBuffer::getId()) to buffer tracking
     // objects (which are mostly for counting how many outputs have released the
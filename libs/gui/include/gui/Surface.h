@@ -29,6 +29,8 @@
 #include <utils/Mutex.h>
 #include <utils/RefBase.h>
 
+#include <atomic>
+#include <optional>
 #include <shared_mutex>
 #include <unordered_set>
 
@@ -165,6 +167,22 @@ public:
             nsecs_t* compositeDeadline, nsecs_t* compositeInterval,
             nsecs_t* compositeToPresentLatency);
 
+    /* Enables or disables frame pacing. While enabled, frame timestamps are
+     * tracked and waitForNextFrame() can be used to start each frame just in
+     * time for the next composition that it can still make, so that frames
+     * neither miss their vsync nor queue up behind each other.
+     */
+    void setFramePacingEnabled(bool enabled);
+
+    /* Blocks until the producer should start rendering its next frame and
+     * returns the time that frame is expected to be presented at. Unless the
+     * producer sets its own timestamp, that time is also used as the desired
+     * present time of the next queued buffer. The render duration is estimated
+     * from the time between recent dequeueBuffer and queueBuffer calls.
+     * Returns INVALID_OPERATION unless frame pacing is enabled.
+     */
+    status_t waitForNextFrame(nsecs_t* outExpectedPresentTime);
+
     // See IGraphicBufferProducer::getFrameTimestamps
     status_t getFrameTimestamps(uint64_t frameNumber,
             nsecs_t* outRequestedPresentTime, nsecs_t* outAcquireTime,
@@ -204,6 +222,16 @@ private:
             ANativeWindowBuffer* buffer, int fenceFd);
     static int hook_setSwapInterval(ANativeWindow* window, int interval);
 
+    // ANativeWindowPerformTable hooks
+    static int hook_setBuffersTimestamp(ANativeWindow* window, int64_t timestamp);
+    static int hook_setSurfaceDamage(ANativeWindow* window, const android_native_rect_t* rects,
+                                     size_t numRects);
+    static int hook_setBuffersDataSpace(ANativeWindow* window, int32_t dataSpace);
+    static int hook_setUsage(ANativeWindow* window, uint64_t usage);
+    static int hook_setDequeueTimeout(ANativeWindow* window, int64_t timeout);
+    static int hook_getNextFrameId(ANativeWindow* window, uint64_t* frameId);
+    static const ANativeWindowPerformTable sPerformTable;
+
     static int cancelBufferInternal(ANativeWindow* window, ANativeWindowBuffer* buffer,
                                     int fenceFd);
     static int dequeueBufferInternal(ANativeWindow* window, ANativeWindowBuffer** buffer,
@@ -265,6 +293,7 @@ private:
     int dispatchAddQueueInterceptor(va_list args);
     int dispatchAddQueryInterceptor(va_list args);
     int dispatchGetLastQueuedBuffer(va_list args);
+    int dispatchGetPerformTable(va_list args);
     bool transformToDisplayInverse();
 
 protected:
@@ -361,6 +390,18 @@ protected:
 
     void querySupportedTimestampsLocked() const;
 
+    // Calls IGraphicBufferProducer::setMaxDequeuedBufferCount unless the
+    // count is already set to |maxDequeuedBuffers|. Must be called with mMutex
+    // locked.
+    int setMaxDequeuedBufferCountLocked(int maxDequeuedBuffers);
+
+    // Calls IGraphicBufferProducer::setAsyncMode unless the async mode is
+    // already set to |async|. Must be called with mMutex locked.
+    int setAsyncModeLocked(bool async);
+
+    // Forgets the producer state cached for the current connection.
+    void resetProducerStateLocked();
+
     void freeAllBuffers();
     int getSlotFromBufferLocked(android_native_buffer_t* buffer) const;
 
@@ -479,6 +520,9 @@ protected:
     void* mDequeueInterceptorData = nullptr;
     ANativeWindow_performInterceptor mPerformInterceptor = nullptr;
     void* mPerformInterceptorData = nullptr;
+    // Whether mPerformInterceptor is set, so that the perform table hooks
+    // can check it without taking mInterceptorMutex.
+    std::atomic<bool> mHasPerformInterceptor = false;
     ANativeWindow_queueBufferInterceptor mQueueInterceptor = nullptr;
     void* mQueueInterceptorData = nullptr;
     ANativeWindow_queryInterceptor mQueryInterceptor = nullptr;
@@ -539,10 +583,29 @@ protected:
     bool mEnableFrameTimestamps = false;
     std::unique_ptr<ProducerFrameEventHistory> mFrameEventHistory;
 
+    // Frame pacing state, see waitForNextFrame().
+    bool mFramePacingEnabled = false;
+    // Smoothed time from dequeueBuffer to queueBuffer.
+    nsecs_t mPacingRenderDuration = 0;
+    // Composite deadline targeted by the last frame handed out, so that two
+    // frames are never paced for the same composition.
+    nsecs_t mPacingLastDeadline = 0;
+    // Present time for the next queued buffer, or 0 if none was handed out.
+    nsecs_t mPacingPresentTime = 0;
+
     bool mReportRemovedBuffers = false;
     std::vector<sp<GraphicBuffer>> mRemovedBuffers;
     int mMaxBufferCount;
 
+    // Producer state cached to save IGraphicBufferProducer calls that would
+    // not change or return anything new. mMinUndequeuedBuffers is updated
+    // by connect and queueBuffer, and is 0 when unknown. The values below it
+    // are the last ones set through this Surface since it connected.
+    mutable int mMinUndequeuedBuffers = 0;
+    std::optional<int> mMaxDequeuedBufferCount;
+    std::optional<bool> mAsyncMode;
+    std::optional<nsecs_t> mDequeueTimeout;
+
     sp<IProducerListener> mListenerProxy;
 
     // Get and flush the buffers of given slots, if the buffer in the slot
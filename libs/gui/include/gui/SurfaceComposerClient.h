@@ -394,6 +394,18 @@ public:
         void clear();
 
         status_t apply(bool synchronous = false);
+
+        // Makes apply() in this process hand asynchronous transactions to
+        // SurfaceFlinger with a oneway binder call instead of waiting for it
+        // to queue them. Synchronous and animation transactions still block.
+        //
+        // Oneway calls from this process are delivered in the order they were
+        // made, but a later blocking call into SurfaceFlinger may be handled
+        // before them. Only enable this in processes that don't depend on that
+        // ordering, e.g. that don't follow a plain apply() with
+        // apply(true) expecting the second to land last.
+        static void setOnewayApplyEnabled(bool enabled);
+
         // Merge another transaction in to this one, clearing other
         // as if it had been applied.
         Transaction& merge(Transaction&& other);
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <binder/Parcelable.h>
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace android {
+
+class Parcel;
+
+namespace gui {
+
+// VsyncTimeline is a small shared-memory region that SurfaceFlinger updates on every VSYNC it
+// dispatches. Clients that only need to know when the next frames will be presented can read it
+// at any time without asking for, or waking up for, VSYNC events.
+//
+// There is a single writer, which publishes with a sequence lock; readers never block it.
+class VsyncTimeline : public Parcelable {
+public:
+    static constexpr size_t kMaxPredictions = 4;
+
+    struct Snapshot {
+        // Number of VSYNC events since the display was connected.
+        uint32_t count = 0;
+        // When the latest VSYNC event was dispatched and when that VSYNC was expected to happen.
+        nsecs_t timestamp = 0;
+        nsecs_t expectedVsyncTimestamp = 0;
+        nsecs_t vsyncPeriod = 0;
+        // Expected timestamps of the VSYNCs following expectedVsyncTimestamp.
+        size_t predictionCount = 0;
+        nsecs_t predictions[kMaxPredictions] = {};
+    };
+
+    // Creates an unmapped VsyncTimeline to unparcel into.
+    VsyncTimeline() = default;
+    ~VsyncTimeline() override;
+
+    VsyncTimeline(const VsyncTimeline&) = delete;
+    VsyncTimeline& operator=(const VsyncTimeline&) = delete;
+
+    // Creates a writable timeline. Returns nullptr if the shared memory can't be allocated.
+    static std::unique_ptr<VsyncTimeline> create(const char* name);
+
+    bool isValid() const { return mShared != nullptr; }
+
+    // Makes outTimeline refer to the same shared memory, so that it can be sent to a client.
+    status_t share(VsyncTimeline* outTimeline) const;
+
+    // Only valid on a timeline returned by create().
+    void publish(const Snapshot& snapshot);
+
+    // Returns NO_INIT if the timeline isn't mapped, NOT_ENOUGH_DATA if nothing has been published
+    // yet and WOULD_BLOCK if the writer kept updating it while reading.
+    status_t read(Snapshot* outSnapshot) const;
+
+    // Parcelable interface. Only the file descriptor is sent; the receiver maps it read-only.
+    status_t writeToParcel(Parcel* parcel) const override;
+    status_t readFromParcel(const Parcel* parcel) override;
+
+private:
+    struct Shared;
+
+    status_t map(base::unique_fd fd, bool writable);
+
+    base::unique_fd mFd;
+    Shared* mShared = nullptr;
+    bool mWritable = false;
+};
+
+} // namespace gui
+} // namespace android
@@ -19,6 +19,7 @@
 
 #include <android/hardware/graphics/bufferqueue/2.0/types.h>
 #include <android/hardware/graphics/common/1.2/types.h>
+#include <cutils/native_handle.h>
 #include <hidl/HidlSupport.h>
 #include <ui/Fence.h>
 #include <ui/GraphicBuffer.h>
@@ -60,11 +61,15 @@ struct HFenceWrapper {
     // Deletes mHandle without closing, then sets mHandle to a new value.
     HFenceWrapper& set(native_handle_t* h);
     HFenceWrapper& operator=(native_handle_t* h);
+    // Deletes mHandle without closing, then sets mHandle to a handle holding
+    // only fd, kept in the wrapper itself so that nothing is allocated.
+    HFenceWrapper& setFd(int fd);
     // Returns a non-owning hidl_handle pointing to mHandle.
     hidl_handle getHandle() const;
     operator hidl_handle() const;
 protected:
     native_handle_t* mHandle{nullptr};
+    NATIVE_HANDLE_DECLARE_STORAGE(mStorage, 1, 0);
 };
 
 // Does not clone the fd---only copy the fd. The returned HFenceWrapper should
@@ -524,6 +524,60 @@ TEST_F(BufferQueueTest, TestDisallowingAllocation) {
                                        GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr));
 }
 
+TEST_F(BufferQueueTest, AllocateBuffersFillsEveryFreeSlot) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, true));
+    ASSERT_EQ(OK, mProducer->setMaxDequeuedBufferCount(3));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, true, &output));
+
+    static const uint32_t WIDTH = 320;
+    static const uint32_t HEIGHT = 240;
+    ASSERT_EQ(OK, mConsumer->setDefaultBufferSize(WIDTH, HEIGHT));
+
+    mProducer->allocateBuffers(0, 0, 0, GRALLOC_USAGE_SW_WRITE_OFTEN);
+
+    // With allocation disallowed, each dequeue can only succeed if
+    // allocateBuffers already put a matching buffer in the slot.
+    ASSERT_EQ(OK, mProducer->allowAllocation(false));
+    for (int i = 0; i < 3; i++) {
+        int slot;
+        sp<Fence> fence;
+        ASSERT_LE(0,
+                  mProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                           nullptr, nullptr));
+    }
+}
+
+TEST_F(BufferQueueTest, DumpReportsProducerStalls) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, true));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, true, &output));
+
+    int slot;
+    sp<Fence> fence;
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              mProducer->dequeueBuffer(&slot, &fence, 1, 1, 0, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                       nullptr, nullptr));
+    ASSERT_EQ(OK, mProducer->cancelBuffer(slot, Fence::NO_FENCE));
+
+    // The same buffer comes back, but at a new size it has to be replaced.
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              mProducer->dequeueBuffer(&slot, &fence, 2, 2, 0, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                       nullptr, nullptr));
+
+    String8 dumpString;
+    mConsumer->dumpState(String8{}, &dumpString);
+    EXPECT_NE(-1, dumpString.find("reallocations=1"));
+    EXPECT_NE(-1, dumpString.find("allocation: count=2"));
+    EXPECT_NE(-1, dumpString.find("free-slot-wait: count=0"));
+}
+
 TEST_F(BufferQueueTest, TestGenerationNumbers) {
     createBufferQueue();
     sp<DummyConsumer> dc(new DummyConsumer);
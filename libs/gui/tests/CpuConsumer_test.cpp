@@ -682,6 +682,65 @@ TEST_P(CpuConsumerTest, FromCpuLockMax) {
     }
 }
 
+TEST_P(CpuConsumerTest, FromCpuAsync) {
+    CpuConsumerTestParams params = GetParam();
+    ASSERT_NO_FATAL_FAILURE(configureANW(mANW, params, params.maxLockedBuffers + 1));
+
+    const int64_t time = 1234L;
+    uint32_t stride;
+    for (int i = 0; i < params.maxLockedBuffers + 1; i++) {
+        ASSERT_NO_FATAL_FAILURE(produceOneFrame(mANW, params, time + i, &stride));
+    }
+
+    Mutex mutex;
+    Condition condition;
+    std::vector<CpuConsumer::LockedBuffer> locked;
+    auto callback = [&](status_t err, const CpuConsumer::LockedBuffer& b) {
+        EXPECT_EQ(OK, err);
+        Mutex::Autolock lock(mutex);
+        locked.push_back(b);
+        condition.signal();
+    };
+
+    for (int i = 0; i < params.maxLockedBuffers; i++) {
+        ASSERT_EQ(OK, mCC->lockNextBufferAsync(callback));
+    }
+    ASSERT_EQ(NOT_ENOUGH_DATA, mCC->lockNextBufferAsync(callback))
+            << "Allowing too many locks";
+
+    {
+        Mutex::Autolock lock(mutex);
+        while (locked.size() < static_cast<size_t>(params.maxLockedBuffers)) {
+            ASSERT_EQ(OK, condition.waitRelative(mutex, ms2ns(1000)));
+        }
+    }
+    for (int i = 0; i < params.maxLockedBuffers; i++) {
+        const CpuConsumer::LockedBuffer& b = locked[i];
+        ASSERT_TRUE(b.data != nullptr);
+        EXPECT_EQ(params.width, b.width);
+        EXPECT_EQ(params.height, b.height);
+        EXPECT_EQ(params.format, b.format);
+        EXPECT_EQ(stride, b.stride);
+        EXPECT_EQ(time + i, b.timestamp);
+        checkAnyBuffer(b, GetParam().format);
+
+        std::vector<ui::PlaneLayout> planeLayouts;
+        if (mCC->getPlaneLayouts(b, &planeLayouts) == OK) {
+            EXPECT_FALSE(planeLayouts.empty());
+        }
+    }
+
+    // Buffers locked asynchronously are unlocked like any other.
+    ASSERT_EQ(OK, mCC->unlockBuffer(locked[0]));
+    CpuConsumer::LockedBuffer b;
+    ASSERT_EQ(OK, mCC->lockNextBuffer(&b));
+    EXPECT_EQ(time + params.maxLockedBuffers, b.timestamp);
+    ASSERT_EQ(OK, mCC->unlockBuffer(b));
+    for (int i = 1; i < params.maxLockedBuffers; i++) {
+        ASSERT_EQ(OK, mCC->unlockBuffer(locked[i]));
+    }
+}
+
 TEST_P(CpuConsumerTest, FromCpuInvalid) {
     status_t err = mCC->lockNextBuffer(nullptr);
     ASSERT_EQ(BAD_VALUE, err) << "lockNextBuffer did not fail";
@@ -689,6 +748,10 @@ TEST_P(CpuConsumerTest, FromCpuInvalid) {
     CpuConsumer::LockedBuffer b;
     err = mCC->unlockBuffer(b);
     ASSERT_EQ(BAD_VALUE, err) << "unlockBuffer did not fail";
+
+    std::vector<ui::PlaneLayout> planeLayouts;
+    err = mCC->getPlaneLayouts(b, &planeLayouts);
+    ASSERT_EQ(BAD_VALUE, err) << "getPlaneLayouts did not fail";
 }
 
 TEST_P(CpuConsumerTest, FromCpuMultiThread) {
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FrameTimestamps_test"
+
+#include <gtest/gtest.h>
+
+#include <gui/FrameTimestamps.h>
+
+#include <vector>
+
+namespace android {
+namespace test {
+
+static void roundTrip(const FrameEventHistoryDelta& in, FrameEventHistoryDelta* out,
+                      size_t* outSize) {
+    std::vector<uint8_t> data(in.getFlattenedSize());
+    std::vector<int> fds(in.getFdCount());
+    *outSize = data.size();
+
+    void* buffer = data.data();
+    size_t size = data.size();
+    int* fdPtr = fds.data();
+    size_t count = fds.size();
+    ASSERT_EQ(NO_ERROR, in.flatten(buffer, size, fdPtr, count));
+    EXPECT_EQ(0u, size);
+
+    void const* constBuffer = data.data();
+    size = data.size();
+    int const* constFdPtr = fds.data();
+    count = fds.size();
+    ASSERT_EQ(NO_ERROR, out->unflatten(constBuffer, size, constFdPtr, count));
+    EXPECT_EQ(0u, size);
+}
+
+TEST(FrameTimestampsTest, DeltaRoundTripsTimestamps) {
+    constexpr nsecs_t kPosted = 123456789012345;
+    ConsumerFrameEventHistory consumer;
+    NewFrameEventsEntry entry;
+    entry.frameNumber = 7;
+    entry.postedTime = kPosted;
+    entry.requestedPresentTime = kPosted + 16'000'000;
+    consumer.addQueue(entry);
+    consumer.addLatch(7, kPosted + 2'000'000);
+    consumer.addPreComposition(7, kPosted - 500);
+
+    FrameEventHistoryDelta delta;
+    consumer.getAndResetDelta(&delta);
+    FrameEventHistoryDelta received;
+    size_t flattenedSize = 0;
+    roundTrip(delta, &received, &flattenedSize);
+
+    // Far less than six raw nsecs_t timestamps and a frame number.
+    EXPECT_LT(flattenedSize, sizeof(CompositorTiming) + 7 * sizeof(nsecs_t));
+
+    ProducerFrameEventHistory producer;
+    producer.applyDelta(received);
+    FrameEvents* frame = producer.getFrame(7);
+    ASSERT_NE(nullptr, frame);
+    EXPECT_EQ(kPosted, frame->postedTime);
+    EXPECT_EQ(kPosted + 16'000'000, frame->requestedPresentTime);
+    EXPECT_EQ(kPosted + 2'000'000, frame->latchTime);
+    EXPECT_EQ(kPosted - 500, frame->firstRefreshStartTime);
+    EXPECT_EQ(kPosted - 500, frame->lastRefreshStartTime);
+    EXPECT_EQ(FrameEvents::TIMESTAMP_PENDING, frame->dequeueReadyTime);
+}
+
+} // namespace test
+} // namespace android
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "LayerState_test"
+
+#include <gtest/gtest.h>
+
+#include <android/native_window.h>
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <gui/LayerState.h>
+
+namespace android {
+namespace test {
+
+static layer_state_t roundTrip(const layer_state_t& in, size_t* outSize = nullptr) {
+    Parcel p;
+    EXPECT_EQ(NO_ERROR, in.write(p));
+    if (outSize) *outSize = p.dataSize();
+    p.setDataPosition(0);
+
+    layer_state_t out;
+    EXPECT_EQ(NO_ERROR, out.read(p));
+    EXPECT_EQ(p.dataSize(), p.dataPosition());
+    return out;
+}
+
+TEST(LayerStateTest, OnlyChangedFieldsAreSent) {
+    layer_state_t position;
+    position.what = layer_state_t::ePositionChanged;
+    position.x = 12.5f;
+    position.y = -3.0f;
+    // Not flagged, so it must not travel.
+    position.alpha = 0.25f;
+
+    size_t positionSize;
+    layer_state_t out = roundTrip(position, &positionSize);
+    EXPECT_EQ(layer_state_t::ePositionChanged, out.what);
+    EXPECT_EQ(12.5f, out.x);
+    EXPECT_EQ(-3.0f, out.y);
+    EXPECT_EQ(layer_state_t().alpha, out.alpha);
+
+    layer_state_t everything = position;
+    everything.what |= layer_state_t::eAlphaChanged | layer_state_t::eMatrixChanged |
+            layer_state_t::eColorTransformChanged | layer_state_t::eTransparentRegionChanged;
+    size_t everythingSize;
+    roundTrip(everything, &everythingSize);
+    EXPECT_LT(positionSize, everythingSize);
+}
+
+TEST(LayerStateTest, RoundTripsFlaggedFields) {
+    sp<IBinder> relative = new BBinder();
+    sp<IBinder> listener = new BBinder();
+
+    layer_state_t in;
+    in.what = layer_state_t::eRelativeLayerChanged | layer_state_t::eFlagsChanged |
+            layer_state_t::eBackgroundColorChanged | layer_state_t::eCropChanged |
+            layer_state_t::eHasListenerCallbacksChanged | layer_state_t::eFrameRateChanged |
+            layer_state_t::eDestroySurface;
+    in.z = 7;
+    in.relativeLayerHandle = relative;
+    in.flags = layer_state_t::eLayerHidden;
+    in.mask = layer_state_t::eLayerHidden | layer_state_t::eLayerOpaque;
+    in.color = half3(0.5f, 0.25f, 1.0f);
+    in.bgColorAlpha = 0.75f;
+    in.bgColorDataspace = ui::Dataspace::SRGB;
+    in.crop = Rect(1, 2, 3, 4);
+    in.listeners.emplace_back(listener, std::vector<CallbackId>{1, 2, 3});
+    in.frameRate = 60.0f;
+    in.frameRateCompatibility = ANATIVEWINDOW_FRAME_RATE_COMPATIBILITY_FIXED_SOURCE;
+
+    layer_state_t out = roundTrip(in);
+    EXPECT_EQ(in.what, out.what);
+    EXPECT_EQ(7, out.z);
+    EXPECT_EQ(relative, out.relativeLayerHandle);
+    EXPECT_EQ(in.flags, out.flags);
+    EXPECT_EQ(in.mask, out.mask);
+    EXPECT_EQ(in.color, out.color);
+    EXPECT_EQ(0.75f, out.bgColorAlpha);
+    EXPECT_EQ(ui::Dataspace::SRGB, out.bgColorDataspace);
+    EXPECT_EQ(Rect(1, 2, 3, 4), out.crop);
+    ASSERT_EQ(1u, out.listeners.size());
+    EXPECT_EQ(listener, out.listeners[0].transactionCompletedListener);
+    EXPECT_EQ(in.listeners[0].callbackIds, out.listeners[0].callbackIds);
+    EXPECT_EQ(60.0f, out.frameRate);
+    EXPECT_EQ(in.frameRateCompatibility, out.frameRateCompatibility);
+}
+
+} // namespace test
+} // namespace android
@@ -236,4 +236,80 @@ TEST_F(StreamSplitterTest, OutputAbandonment) {
                                            nullptr, nullptr));
 }
 
+TEST_F(StreamSplitterTest, SlowOutputDoesNotStallInput) {
+    sp<IGraphicBufferProducer> inputProducer;
+    sp<IGraphicBufferConsumer> inputConsumer;
+    BufferQueue::createBufferQueue(&inputProducer, &inputConsumer);
+
+    sp<IGraphicBufferProducer> fastProducer;
+    sp<IGraphicBufferConsumer> fastConsumer;
+    BufferQueue::createBufferQueue(&fastProducer, &fastConsumer);
+    ASSERT_EQ(OK, fastConsumer->consumerConnect(new DummyListener, false));
+
+    sp<IGraphicBufferProducer> slowProducer;
+    sp<IGraphicBufferConsumer> slowConsumer;
+    BufferQueue::createBufferQueue(&slowProducer, &slowConsumer);
+    ASSERT_EQ(OK, slowConsumer->consumerConnect(new DummyListener, false));
+
+    sp<StreamSplitter> splitter;
+    status_t status = StreamSplitter::createSplitter(inputConsumer, &splitter);
+    ASSERT_EQ(OK, status);
+    ASSERT_EQ(OK, splitter->addOutput(fastProducer));
+    ASSERT_EQ(OK, splitter->addOutput(slowProducer, /* maxBuffers */ 1));
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    ASSERT_EQ(OK, inputProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &qbOutput));
+
+    // Queues a frame to the input, and consumes it from the fast output only
+    auto produceFrame = [&](int64_t timestamp) {
+        int slot;
+        sp<Fence> fence;
+        status_t result = inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0,
+                GRALLOC_USAGE_SW_WRITE_OFTEN, nullptr, nullptr);
+        ASSERT_LE(OK, result);
+        if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            sp<GraphicBuffer> buffer;
+            ASSERT_EQ(OK, inputProducer->requestBuffer(slot, &buffer));
+        }
+
+        IGraphicBufferProducer::QueueBufferInput qbInput(timestamp, false,
+                HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+                NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+        ASSERT_EQ(OK, inputProducer->queueBuffer(slot, qbInput, &qbOutput));
+
+        BufferItem item;
+        ASSERT_EQ(OK, fastConsumer->acquireBuffer(&item, 0));
+        ASSERT_EQ(timestamp, item.mTimestamp);
+        ASSERT_EQ(OK, fastConsumer->releaseBuffer(item.mSlot,
+                item.mFrameNumber, EGL_NO_DISPLAY, EGL_NO_SYNC_KHR,
+                Fence::NO_FENCE));
+    };
+
+    // The slow output's consumer does not acquire anything, so each frame
+    // replaces the one before it
+    for (int64_t timestamp = 1; timestamp <= 5; ++timestamp) {
+        ASSERT_NO_FATAL_FAILURE(produceFrame(timestamp));
+    }
+
+    BufferItem slowItem;
+    ASSERT_EQ(OK, slowConsumer->acquireBuffer(&slowItem, 0));
+    ASSERT_EQ(5, slowItem.mTimestamp);
+
+    // While the slow output's consumer holds a buffer, the frames still
+    // replace each other
+    for (int64_t timestamp = 6; timestamp <= 10; ++timestamp) {
+        ASSERT_NO_FATAL_FAILURE(produceFrame(timestamp));
+    }
+
+    ASSERT_EQ(OK, slowConsumer->releaseBuffer(slowItem.mSlot,
+            slowItem.mFrameNumber, EGL_NO_DISPLAY, EGL_NO_SYNC_KHR,
+            Fence::NO_FENCE));
+    BufferItem item;
+    ASSERT_EQ(OK, slowConsumer->acquireBuffer(&item, 0));
+    ASSERT_EQ(10, item.mTimestamp);
+    ASSERT_EQ(OK, slowConsumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+            EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+}
+
 } // namespace android
@@ -621,6 +621,161 @@ TEST_F(SurfaceTest, TestGetLastDequeueStartTime) {
     ASSERT_GE(after, lastDequeueTime);
 }
 
+TEST_F(SurfaceTest, CachedProducerStateMatchesProducer) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+
+    sp<DummyConsumer> dummyConsumer(new DummyConsumer);
+    consumer->consumerConnect(dummyConsumer, false);
+
+    sp<Surface> surface = new Surface(producer);
+    sp<ANativeWindow> window(surface);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+
+    auto expectMinUndequeuedBuffers = [&]() {
+        int expected = 0;
+        int cached = 0;
+        ASSERT_EQ(NO_ERROR, producer->query(NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS, &expected));
+        ASSERT_EQ(NO_ERROR, window->query(window.get(), NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS,
+                                          &cached));
+        EXPECT_EQ(expected, cached);
+    };
+
+    expectMinUndequeuedBuffers();
+    ASSERT_EQ(NO_ERROR, surface->setAsyncMode(true));
+    expectMinUndequeuedBuffers();
+    ASSERT_EQ(NO_ERROR, surface->setAsyncMode(true));
+    expectMinUndequeuedBuffers();
+    ASSERT_EQ(NO_ERROR, surface->setAsyncMode(false));
+    expectMinUndequeuedBuffers();
+
+    // The buffer count is set from the cached count, once per value.
+    int minUndequeuedBuffers = 0;
+    ASSERT_EQ(NO_ERROR, producer->query(NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS,
+                                        &minUndequeuedBuffers));
+    ASSERT_EQ(NO_ERROR, native_window_set_buffer_count(window.get(), minUndequeuedBuffers + 2));
+    ASSERT_EQ(NO_ERROR, native_window_set_buffer_count(window.get(), minUndequeuedBuffers + 2));
+    ANativeWindowBuffer* buffers[2];
+    int fences[2];
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(NO_ERROR, window->dequeueBuffer(window.get(), &buffers[i], &fences[i]));
+    }
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(NO_ERROR, window->queueBuffer(window.get(), buffers[i], fences[i]));
+        expectMinUndequeuedBuffers();
+    }
+
+    // Reconnecting starts over from the producer's state.
+    ASSERT_EQ(NO_ERROR, native_window_api_disconnect(window.get(), NATIVE_WINDOW_API_CPU));
+    ASSERT_EQ(NO_ERROR, producer->setAsyncMode(true));
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+    expectMinUndequeuedBuffers();
+    ASSERT_EQ(NO_ERROR, surface->setAsyncMode(false));
+    expectMinUndequeuedBuffers();
+}
+
+TEST_F(SurfaceTest, PerformTableMatchesPerform) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+
+    sp<DummyConsumer> dummyConsumer(new DummyConsumer);
+    consumer->consumerConnect(dummyConsumer, false);
+
+    sp<Surface> surface = new Surface(producer);
+    sp<ANativeWindow> window(surface);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+
+    const ANativeWindowPerformTable* table = nullptr;
+    ASSERT_EQ(NO_ERROR, native_window_get_perform_table(window.get(), &table));
+    ASSERT_NE(nullptr, table);
+    ASSERT_EQ(sizeof(ANativeWindowPerformTable), table->size);
+
+    uint64_t frameId = 0;
+    uint64_t expectedFrameId = 0;
+    ASSERT_EQ(NO_ERROR, table->getNextFrameId(window.get(), &frameId));
+    ASSERT_EQ(NO_ERROR, native_window_get_next_frame_id(window.get(), &expectedFrameId));
+    EXPECT_EQ(expectedFrameId, frameId);
+
+    ASSERT_EQ(NO_ERROR, table->setUsage(window.get(), GRALLOC_USAGE_SW_READ_OFTEN));
+    ASSERT_EQ(NO_ERROR, table->setBuffersTimestamp(window.get(), 1234));
+    ASSERT_EQ(NO_ERROR, table->setDequeueTimeout(window.get(), -1));
+    const android_native_rect_t damage = {0, 1, 1, 0};
+    ASSERT_EQ(NO_ERROR, table->setSurfaceDamage(window.get(), &damage, 1));
+
+    ANativeWindowBuffer* buffer;
+    int fence;
+    ASSERT_EQ(NO_ERROR, window->dequeueBuffer(window.get(), &buffer, &fence));
+    ASSERT_EQ(NO_ERROR, window->queueBuffer(window.get(), buffer, fence));
+
+    BufferItem item;
+    ASSERT_EQ(NO_ERROR, consumer->acquireBuffer(&item, 0));
+    EXPECT_EQ(1234, item.mTimestamp);
+    EXPECT_EQ(frameId, item.mFrameNumber);
+    EXPECT_NE(0u, item.mGraphicBuffer->getUsage() & GRALLOC_USAGE_SW_READ_OFTEN);
+
+    ASSERT_EQ(NO_ERROR, table->getNextFrameId(window.get(), &frameId));
+    EXPECT_EQ(expectedFrameId + 1, frameId);
+}
+
+TEST_F(SurfaceTest, PerformTableGoesThroughPerformInterceptor) {
+    sp<ANativeWindow> window(mSurface);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+
+    const ANativeWindowPerformTable* table = nullptr;
+    ASSERT_EQ(NO_ERROR, native_window_get_perform_table(window.get(), &table));
+    ASSERT_NE(nullptr, table);
+
+    std::vector<int> operations;
+    ANativeWindow_performInterceptor interceptor = [](ANativeWindow* w,
+                                                      ANativeWindow_performFn perform, void* data,
+                                                      int operation, va_list args) {
+        static_cast<std::vector<int>*>(data)->push_back(operation);
+        return perform(w, operation, args);
+    };
+    ASSERT_EQ(NO_ERROR, ANativeWindow_setPerformInterceptor(window.get(), interceptor, &operations));
+
+    uint64_t frameId = 0;
+    ASSERT_EQ(NO_ERROR, table->setBuffersTimestamp(window.get(), 1234));
+    ASSERT_EQ(NO_ERROR, table->getNextFrameId(window.get(), &frameId));
+    ASSERT_EQ(2u, operations.size());
+    EXPECT_EQ(NATIVE_WINDOW_SET_BUFFERS_TIMESTAMP, operations[0]);
+    EXPECT_EQ(NATIVE_WINDOW_GET_NEXT_FRAME_ID, operations[1]);
+
+    ASSERT_EQ(NO_ERROR, ANativeWindow_setPerformInterceptor(window.get(), nullptr, nullptr));
+}
+
+TEST_F(SurfaceTest, FramePacingTargetsDistinctCompositions) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+
+    sp<DummyConsumer> dummyConsumer(new DummyConsumer);
+    consumer->consumerConnect(dummyConsumer, false);
+
+    sp<Surface> surface = new Surface(producer);
+    sp<ANativeWindow> window(surface);
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+
+    nsecs_t first = 0;
+    EXPECT_EQ(INVALID_OPERATION, surface->waitForNextFrame(&first));
+
+    surface->setFramePacingEnabled(true);
+    nsecs_t compositeInterval = 0;
+    ASSERT_EQ(NO_ERROR, surface->getCompositorTiming(nullptr, &compositeInterval, nullptr));
+
+    const nsecs_t before = systemTime();
+    ASSERT_EQ(NO_ERROR, surface->waitForNextFrame(&first));
+    EXPECT_GT(first, before);
+
+    // Nothing was queued in between, so the next frame must not be paced for
+    // the same composition.
+    nsecs_t second = 0;
+    ASSERT_EQ(NO_ERROR, surface->waitForNextFrame(&second));
+    EXPECT_GE(second, first + compositeInterval);
+}
+
 class FakeConsumer : public BnConsumerListener {
 public:
     void onFrameAvailable(const BufferItem& /*item*/) override {}
@@ -45,6 +45,25 @@ public:
                 IBinder::FLAG_ONEWAY);
     }
 
+    virtual void updateInputWindows(const std::vector<InputWindowInfo>& changedWindows,
+            const std::vector<int32_t>& windowIds,
+            const sp<ISetInputWindowsListener>& setInputWindowsListener) {
+        Parcel data, reply;
+        data.writeInterfaceToken(IInputFlinger::getInterfaceDescriptor());
+
+        // The id goes first, as windows without a name are written without it.
+        data.writeUint32(static_cast<uint32_t>(changedWindows.size()));
+        for (const auto& info : changedWindows) {
+            data.writeInt32(info.id);
+            info.write(data);
+        }
+        data.writeInt32Vector(windowIds);
+        data.writeStrongBinder(IInterface::asBinder(setInputWindowsListener));
+
+        remote()->transact(BnInputFlinger::UPDATE_INPUT_WINDOWS_TRANSACTION, data, &reply,
+                IBinder::FLAG_ONEWAY);
+    }
+
     virtual void registerInputChannel(const sp<InputChannel>& channel) {
         Parcel data, reply;
         data.writeInterfaceToken(IInputFlinger::getInterfaceDescriptor());
@@ -80,6 +99,28 @@ status_t BnInputFlinger::onTransact(
         setInputWindows(handles, setInputWindowsListener);
         break;
     }
+    case UPDATE_INPUT_WINDOWS_TRANSACTION: {
+        CHECK_INTERFACE(IInputFlinger, data, reply);
+        size_t count = data.readUint32();
+        if (count > data.dataSize()) {
+            return BAD_VALUE;
+        }
+        std::vector<InputWindowInfo> changedWindows;
+        for (size_t i = 0; i < count; i++) {
+            const int32_t id = data.readInt32();
+            changedWindows.push_back(InputWindowInfo::read(data));
+            changedWindows.back().id = id;
+        }
+        std::vector<int32_t> windowIds;
+        status_t status = data.readInt32Vector(&windowIds);
+        if (status != NO_ERROR) {
+            return status;
+        }
+        const sp<ISetInputWindowsListener> setInputWindowsListener =
+                ISetInputWindowsListener::asInterface(data.readStrongBinder());
+        updateInputWindows(changedWindows, windowIds, setInputWindowsListener);
+        break;
+    }
     case REGISTER_INPUT_CHANNEL_TRANSACTION: {
         CHECK_INTERFACE(IInputFlinger, data, reply);
         sp<InputChannel> channel = InputChannel::read(data);
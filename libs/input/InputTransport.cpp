@@ -26,6 +26,8 @@ static constexpr bool DEBUG_TRANSPORT_ACTIONS = false;
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <utility>
+#include <vector>
 
 #include <android-base/stringprintf.h>
 #include <binder/Parcel.h>
@@ -45,6 +47,9 @@ namespace android {
 // behind processing touches.
 static const size_t SOCKET_BUFFER_SIZE = 32 * 1024;
 
+// Most messages InputConsumer reads from the channel with a single system call.
+static constexpr size_t RECEIVE_BATCH_SIZE = 8;
+
 // Nanoseconds per milliseconds.
 static const nsecs_t NANOS_PER_MS = 1000000;
 
@@ -63,6 +68,11 @@ static const nsecs_t RESAMPLE_MAX_DELTA = 20 * NANOS_PER_MS;
 // far into the future.  This time is further bounded by 50% of the last time delta.
 static const nsecs_t RESAMPLE_MAX_PREDICTION = 8 * NANOS_PER_MS;
 
+// Maximum time to predict forward from the last known state when a touch predictor is
+// configured.  The predictor fits the recent motion rather than extending the last segment,
+// so it can be trusted about one 60Hz frame ahead.
+static const nsecs_t RESAMPLE_MAX_MODEL_PREDICTION = 16 * NANOS_PER_MS;
+
 /**
  * System property for enabling / disabling touch resampling.
  * Resampling extrapolates / interpolates the reported touch event coordinates to better
@@ -75,6 +85,17 @@ static const nsecs_t RESAMPLE_MAX_PREDICTION = 8 * NANOS_PER_MS;
  */
 static const char* PROPERTY_RESAMPLING_ENABLED = "ro.input.resampling";
 
+/**
+ * System property for predicting touch positions when resampling.
+ * Set to the name of a VelocityTracker strategy, such as "lsq2" or "slsq2", to predict the
+ * touch coordinates at the frame time from a fit of the recent samples of each pointer,
+ * instead of extrapolating the last two samples to 5ms before the frame time.  This reduces
+ * the latency of dragging and drawing by the latency added during resampling and the time
+ * until the frame time.
+ * Prediction is disabled by default.
+ */
+static const char* PROPERTY_RESAMPLING_PREDICTOR = "ro.input.resampling.predictor";
+
 template<typename T>
 inline static T min(const T& a, const T& b) {
     return a < b ? a : b;
@@ -84,6 +105,14 @@ inline static float lerp(float a, float b, float alpha) {
     return a + alpha * (b - a);
 }
 
+inline static float evaluatePolynomial(const float* coeff, uint32_t degree, float t) {
+    float result = coeff[degree];
+    for (uint32_t i = degree; i > 0; i--) {
+        result = result * t + coeff[i - 1];
+    }
+    return result;
+}
+
 inline static bool isPointerEvent(int32_t source) {
     return (source & AINPUT_SOURCE_CLASS_POINTER) == AINPUT_SOURCE_CLASS_POINTER;
 }
@@ -124,6 +153,72 @@ size_t InputMessage::size() const {
     return sizeof(Header);
 }
 
+// The packed form of a motion pointer is the start of InputMessage::Body::Motion::Pointer.
+static_assert(offsetof(InputMessage::Body::Motion::Pointer, coords) == sizeof(PointerProperties));
+static_assert(offsetof(PointerCoords, values) == sizeof(PointerCoords::bits));
+
+static constexpr size_t MOTION_POINTERS_OFFSET =
+        sizeof(InputMessage::Header) + offsetof(InputMessage::Body::Motion, pointers);
+
+static size_t getPackedPointerSize(uint64_t bits) {
+    return sizeof(PointerProperties) + sizeof(bits) + BitSet64::count(bits) * sizeof(float);
+}
+
+size_t InputMessage::pack(InputMessage* msg) const {
+    getSanitizedCopy(msg);
+    if (header.type != Type::MOTION) {
+        return size();
+    }
+
+    // Each pointer moves towards the front, so it never overlaps one that has yet to be moved.
+    uint8_t* const start = reinterpret_cast<uint8_t*>(msg);
+    size_t length = MOTION_POINTERS_OFFSET;
+    for (uint32_t i = 0; i < msg->body.motion.pointerCount; i++) {
+        const Body::Motion::Pointer& pointer = msg->body.motion.pointers[i];
+        const size_t pointerSize = getPackedPointerSize(pointer.coords.bits);
+        memmove(start + length, &pointer, pointerSize);
+        length += pointerSize;
+    }
+    return length;
+}
+
+bool InputMessage::unpack(size_t packedLength) {
+    if (header.type != Type::MOTION) {
+        return isValid(packedLength);
+    }
+    if (packedLength < MOTION_POINTERS_OFFSET || body.motion.pointerCount == 0 ||
+        body.motion.pointerCount > MAX_POINTERS) {
+        return false;
+    }
+
+    uint8_t* const start = reinterpret_cast<uint8_t*>(this);
+    size_t packedOffsets[MAX_POINTERS];
+    size_t packedSizes[MAX_POINTERS];
+    size_t offset = MOTION_POINTERS_OFFSET;
+    for (uint32_t i = 0; i < body.motion.pointerCount; i++) {
+        uint64_t bits;
+        if (offset + sizeof(PointerProperties) + sizeof(bits) > packedLength) {
+            return false;
+        }
+        memcpy(&bits, start + offset + sizeof(PointerProperties), sizeof(bits));
+        if (BitSet64::count(bits) > PointerCoords::MAX_AXES) {
+            return false;
+        }
+        packedOffsets[i] = offset;
+        packedSizes[i] = getPackedPointerSize(bits);
+        offset += packedSizes[i];
+    }
+    if (offset != packedLength) {
+        return false;
+    }
+
+    // Expand from the back, so that no pointer is overwritten before it has been moved.
+    for (uint32_t i = body.motion.pointerCount; i-- > 0;) {
+        memmove(&body.motion.pointers[i], start + packedOffsets[i], packedSizes[i]);
+    }
+    return isValid(size());
+}
+
 /**
  * There could be non-zero bytes in-between InputMessage fields. Force-initialize the entire
  * memory to zero, then only copy the valid bytes on a per-field basis.
@@ -303,9 +398,8 @@ status_t InputChannel::openInputChannelPair(const std::string& name,
 }
 
 status_t InputChannel::sendMessage(const InputMessage* msg) {
-    const size_t msgLength = msg->size();
     InputMessage cleanMsg;
-    msg->getSanitizedCopy(&cleanMsg);
+    const size_t msgLength = msg->pack(&cleanMsg);
     ssize_t nWrite;
     do {
         nWrite = ::send(mFd.get(), &cleanMsg, msgLength, MSG_DONTWAIT | MSG_NOSIGNAL);
@@ -340,7 +434,64 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
     return OK;
 }
 
+status_t InputChannel::sendMessages(const InputMessage* msgs, size_t count, size_t* outSent) {
+    *outSent = 0;
+    std::vector<InputMessage> cleanMsgs(count);
+    std::vector<iovec> iovs(count);
+    std::vector<mmsghdr> mmsgs(count);
+    for (size_t i = 0; i < count; i++) {
+        iovs[i].iov_base = &cleanMsgs[i];
+        iovs[i].iov_len = msgs[i].pack(&cleanMsgs[i]);
+        mmsgs[i] = {};
+        mmsgs[i].msg_hdr.msg_iov = &iovs[i];
+        mmsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (*outSent < count) {
+        int nSent;
+        do {
+            nSent = ::sendmmsg(mFd.get(), &mmsgs[*outSent], count - *outSent,
+                               MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (nSent == -1 && errno == EINTR);
+
+        if (nSent < 0) {
+            int error = errno;
+#if DEBUG_CHANNEL_MESSAGES
+            ALOGD("channel '%s' ~ error sending message of type %d, %s", mName.c_str(),
+                  msgs[*outSent].header.type, strerror(error));
+#endif
+            if (error == EAGAIN || error == EWOULDBLOCK) {
+                return WOULD_BLOCK;
+            }
+            if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED ||
+                error == ECONNRESET) {
+                return DEAD_OBJECT;
+            }
+            return -error;
+        }
+
+        for (int i = 0; i < nSent; i++, (*outSent)++) {
+            if (mmsgs[*outSent].msg_len != iovs[*outSent].iov_len) {
+#if DEBUG_CHANNEL_MESSAGES
+                ALOGD("channel '%s' ~ error sending message type %d, send was incomplete",
+                      mName.c_str(), msgs[*outSent].header.type);
+#endif
+                return DEAD_OBJECT;
+            }
+#if DEBUG_CHANNEL_MESSAGES
+            ALOGD("channel '%s' ~ sent message of type %d", mName.c_str(),
+                  msgs[*outSent].header.type);
+#endif
+        }
+    }
+    return OK;
+}
+
 status_t InputChannel::receiveMessage(InputMessage* msg) {
+    if (mPendingReceiveStatus != OK) {
+        return std::exchange(mPendingReceiveStatus, OK);
+    }
+
     ssize_t nRead;
     do {
         nRead = ::recv(mFd.get(), msg, sizeof(InputMessage), MSG_DONTWAIT);
@@ -360,14 +511,68 @@ status_t InputChannel::receiveMessage(InputMessage* msg) {
         return -error;
     }
 
-    if (nRead == 0) { // check for EOF
+    return checkReceivedMessage(msg, nRead);
+}
+
+status_t InputChannel::receiveMessages(InputMessage* msgs, size_t count, size_t* outCount) {
+    *outCount = 0;
+    if (mPendingReceiveStatus != OK) {
+        return std::exchange(mPendingReceiveStatus, OK);
+    }
+
+    std::vector<iovec> iovs(count);
+    std::vector<mmsghdr> mmsgs(count);
+    for (size_t i = 0; i < count; i++) {
+        iovs[i].iov_base = &msgs[i];
+        iovs[i].iov_len = sizeof(InputMessage);
+        mmsgs[i] = {};
+        mmsgs[i].msg_hdr.msg_iov = &iovs[i];
+        mmsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int nRead;
+    do {
+        nRead = ::recvmmsg(mFd.get(), mmsgs.data(), count, MSG_DONTWAIT, nullptr);
+    } while (nRead == -1 && errno == EINTR);
+
+    if (nRead < 0) {
+        int error = errno;
+#if DEBUG_CHANNEL_MESSAGES
+        ALOGD("channel '%s' ~ receive message failed, errno=%d", mName.c_str(), errno);
+#endif
+        if (error == EAGAIN || error == EWOULDBLOCK) {
+            return WOULD_BLOCK;
+        }
+        if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED) {
+            return DEAD_OBJECT;
+        }
+        return -error;
+    }
+
+    for (int i = 0; i < nRead; i++) {
+        status_t status = checkReceivedMessage(&msgs[i], mmsgs[i].msg_len);
+        if (status != OK) {
+            // The rest of this batch is dropped, as the channel is broken either way.
+            if (i == 0) {
+                return status;
+            }
+            mPendingReceiveStatus = status;
+            break;
+        }
+        (*outCount)++;
+    }
+    return OK;
+}
+
+status_t InputChannel::checkReceivedMessage(InputMessage* msg, size_t length) const {
+    if (length == 0) { // check for EOF
 #if DEBUG_CHANNEL_MESSAGES
         ALOGD("channel '%s' ~ receive message failed because peer was closed", mName.c_str());
 #endif
         return DEAD_OBJECT;
     }
 
-    if (!msg->isValid(nRead)) {
+    if (!msg->unpack(length)) {
 #if DEBUG_CHANNEL_MESSAGES
         ALOGD("channel '%s' ~ received invalid message", mName.c_str());
 #endif
@@ -598,7 +803,11 @@ status_t InputPublisher::receiveFinishedSignal(uint32_t* outSeq, bool* outHandle
 
 InputConsumer::InputConsumer(const sp<InputChannel>& channel) :
         mResampleTouch(isTouchResamplingEnabled()),
-        mChannel(channel), mMsgDeferred(false) {
+        mTouchPredictor(mResampleTouch ? getTouchPredictor() : ""),
+        mChannel(channel),
+        mMsgDeferred(false),
+        mReceivedMsgCount(0),
+        mNextReceivedMsg(0) {
 }
 
 InputConsumer::~InputConsumer() {
@@ -608,6 +817,12 @@ bool InputConsumer::isTouchResamplingEnabled() {
     return property_get_bool(PROPERTY_RESAMPLING_ENABLED, true);
 }
 
+std::string InputConsumer::getTouchPredictor() {
+    char value[PROPERTY_VALUE_MAX];
+    property_get(PROPERTY_RESAMPLING_PREDICTOR, value, "");
+    return value;
+}
+
 status_t InputConsumer::consume(InputEventFactoryInterface* factory, bool consumeBatches,
                                 nsecs_t frameTime, uint32_t* outSeq, InputEvent** outEvent) {
     if (DEBUG_TRANSPORT_ACTIONS) {
@@ -627,7 +842,7 @@ status_t InputConsumer::consume(InputEventFactoryInterface* factory, bool consum
             mMsgDeferred = false;
         } else {
             // Receive a fresh message.
-            status_t result = mChannel->receiveMessage(&mMsg);
+            status_t result = receiveMessage(&mMsg);
             if (result) {
                 // Consume the next batched event unless batches are being held for later.
                 if (consumeBatches || result != WOULD_BLOCK) {
@@ -760,7 +975,7 @@ status_t InputConsumer::consumeBatch(InputEventFactoryInterface* factory,
         }
 
         nsecs_t sampleTime = frameTime;
-        if (mResampleTouch) {
+        if (mResampleTouch && mTouchPredictor.empty()) {
             sampleTime -= RESAMPLE_LATENCY;
         }
         ssize_t split = findSampleNoLaterThan(batch, sampleTime);
@@ -833,6 +1048,14 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
         TouchState& touchState = mTouchStates.editItemAt(index);
         touchState.initialize(deviceId, source);
         touchState.addHistory(msg);
+        if (!mTouchPredictor.empty()) {
+            if (touchState.predictor == nullptr) {
+                touchState.predictor = std::make_shared<VelocityTracker>(mTouchPredictor.c_str());
+            } else {
+                touchState.predictor->clear();
+            }
+            addPredictorMovement(*touchState.predictor, msg);
+        }
         break;
     }
 
@@ -841,6 +1064,9 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
         if (index >= 0) {
             TouchState& touchState = mTouchStates.editItemAt(index);
             touchState.addHistory(msg);
+            if (touchState.predictor != nullptr) {
+                addPredictorMovement(*touchState.predictor, msg);
+            }
             rewriteMessage(touchState, msg);
         }
         break;
@@ -851,6 +1077,14 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
         if (index >= 0) {
             TouchState& touchState = mTouchStates.editItemAt(index);
             touchState.lastResample.idBits.clearBit(msg.body.motion.getActionId());
+            if (touchState.predictor != nullptr) {
+                // Start a new trace for the pointer that went down, like VelocityTracker does
+                // for MotionEvents.
+                BitSet32 downIdBits;
+                downIdBits.markBit(msg.body.motion.getActionId());
+                touchState.predictor->clearPointers(downIdBits);
+                addPredictorMovement(*touchState.predictor, msg);
+            }
             rewriteMessage(touchState, msg);
         }
         break;
@@ -888,6 +1122,24 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
     }
 }
 
+/**
+ * Add the raw coordinates of all pointers in msg to the touch predictor.
+ */
+void InputConsumer::addPredictorMovement(VelocityTracker& predictor, const InputMessage& msg) {
+    const uint32_t pointerCount = msg.body.motion.pointerCount;
+    BitSet32 idBits;
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        idBits.markBit(msg.body.motion.pointers[i].properties.id);
+    }
+    VelocityTracker::Position positions[MAX_POINTERS];
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        const uint32_t index = idBits.getIndexOfBit(msg.body.motion.pointers[i].properties.id);
+        positions[index].x = msg.body.motion.pointers[i].coords.getX();
+        positions[index].y = msg.body.motion.pointers[i].coords.getY();
+    }
+    predictor.addMovement(msg.body.motion.eventTime, idBits, positions);
+}
+
 /**
  * Replace the coordinates in msg with the coordinates in lastResample, if necessary.
  *
@@ -963,6 +1215,8 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
     const History* other;
     History future;
     float alpha;
+    // Whether to extrapolate with the touch predictor rather than along the last segment.
+    bool predict = false;
     if (next) {
         // Interpolate between current sample and future sample.
         // So current->eventTime <= sampleTime <= future.eventTime.
@@ -992,7 +1246,9 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
 #endif
             return;
         }
-        nsecs_t maxPredict = current->eventTime + min(delta / 2, RESAMPLE_MAX_PREDICTION);
+        predict = touchState.predictor != nullptr;
+        nsecs_t maxPredict = current->eventTime +
+                (predict ? RESAMPLE_MAX_MODEL_PREDICTION : min(delta / 2, RESAMPLE_MAX_PREDICTION));
         if (sampleTime > maxPredict) {
 #if DEBUG_RESAMPLING
             ALOGD("Sample time is too far in the future, adjusting prediction "
@@ -1033,7 +1289,22 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
         PointerCoords& resampledCoords = touchState.lastResample.pointers[i];
         const PointerCoords& currentCoords = current->getPointerById(id);
         resampledCoords.copyFrom(currentCoords);
-        if (other->idBits.hasBit(id)
+        VelocityTracker::Estimator estimator;
+        if (predict && other->idBits.hasBit(id) && shouldResampleTool(event->getToolType(i))
+                && touchState.predictor->getEstimator(id, &estimator)
+                && estimator.degree >= 1) {
+            const float t = (sampleTime - estimator.time) * 0.000000001f;
+            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
+                    evaluatePolynomial(estimator.xCoeff, estimator.degree, t));
+            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y,
+                    evaluatePolynomial(estimator.yCoeff, estimator.degree, t));
+#if DEBUG_RESAMPLING
+            ALOGD("[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f), predicted %0.3f ms ahead",
+                    id, resampledCoords.getX(), resampledCoords.getY(),
+                    currentCoords.getX(), currentCoords.getY(),
+                    (sampleTime - estimator.time) * 0.000001f);
+#endif
+        } else if (other->idBits.hasBit(id)
                 && shouldResampleTool(event->getToolType(i))) {
             const PointerCoords& otherCoords = other->getPointerById(id);
             resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
@@ -1091,12 +1362,24 @@ status_t InputConsumer::sendFinishedSignal(uint32_t seq, bool handled) {
                  mSeqChains.removeAt(i);
              }
         }
-        status_t status = OK;
-        while (!status && chainIndex > 0) {
-            chainIndex--;
-            status = sendUnchainedFinishedSignal(chainSeqs[chainIndex], handled);
+        if (chainIndex == 0) {
+            return sendUnchainedFinishedSignal(seq, handled);
+        }
+        // Send the chain, oldest first, along with the last message in a single call.
+        std::vector<InputMessage> msgs(chainIndex + 1);
+        for (size_t i = 0; i < chainIndex; i++) {
+            initializeFinishedMessage(&msgs[i], chainSeqs[chainIndex - 1 - i], handled);
+        }
+        initializeFinishedMessage(&msgs[chainIndex], seq, handled);
+        size_t sent;
+        status_t status = mChannel->sendMessages(msgs.data(), msgs.size(), &sent);
+        if (status && sent == chainIndex) {
+            // Only the signal for the last message failed, as if it had been sent on its own.
+            return status;
         }
         if (status) {
+            // Point at the first signal of the chain that was not sent.
+            chainIndex -= sent + 1;
             // An error occurred so at least one signal was not sent, reconstruct the chain.
             for (;;) {
                 SeqChain seqChain;
@@ -1108,6 +1391,7 @@ status_t InputConsumer::sendFinishedSignal(uint32_t seq, bool handled) {
             }
             return status;
         }
+        return OK;
     }
 
     // Send finished signal for the last message in the batch.
@@ -1116,14 +1400,40 @@ status_t InputConsumer::sendFinishedSignal(uint32_t seq, bool handled) {
 
 status_t InputConsumer::sendUnchainedFinishedSignal(uint32_t seq, bool handled) {
     InputMessage msg;
-    msg.header.type = InputMessage::Type::FINISHED;
-    msg.body.finished.seq = seq;
-    msg.body.finished.handled = handled ? 1 : 0;
+    initializeFinishedMessage(&msg, seq, handled);
     return mChannel->sendMessage(&msg);
 }
 
+void InputConsumer::initializeFinishedMessage(InputMessage* msg, uint32_t seq, bool handled) {
+    msg->header.type = InputMessage::Type::FINISHED;
+    msg->body.finished.seq = seq;
+    msg->body.finished.handled = handled ? 1 : 0;
+}
+
+/**
+ * Take the next message, reading as many as are already queued on the channel whenever the
+ * ones read earlier have run out.
+ */
+status_t InputConsumer::receiveMessage(InputMessage* msg) {
+    if (mNextReceivedMsg == mReceivedMsgCount) {
+        if (mReceivedMsgs.empty()) {
+            mReceivedMsgs.resize(RECEIVE_BATCH_SIZE);
+        }
+        mNextReceivedMsg = 0;
+        status_t status =
+                mChannel->receiveMessages(mReceivedMsgs.data(), RECEIVE_BATCH_SIZE,
+                                          &mReceivedMsgCount);
+        if (status) {
+            return status;
+        }
+    }
+    *msg = mReceivedMsgs[mNextReceivedMsg++];
+    return OK;
+}
+
 bool InputConsumer::hasDeferredEvent() const {
-    return mMsgDeferred;
+    // Messages already read from the channel won't make its fd readable again.
+    return mMsgDeferred || mNextReceivedMsg != mReceivedMsgCount;
 }
 
 bool InputConsumer::hasPendingBatch() const {
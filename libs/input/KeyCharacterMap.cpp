@@ -18,6 +18,10 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+
+#include <map>
+#include <mutex>
 
 #ifdef __ANDROID__
 #include <binder/Parcel.h>
@@ -106,10 +110,45 @@ KeyCharacterMap::~KeyCharacterMap() {
     }
 }
 
+// Key character maps already parsed by this process, indexed by file name and format.
+// An entry is only reused while the file it was parsed from is unchanged.
+struct CachedKeyCharacterMap {
+    struct stat fileStat;
+    sp<KeyCharacterMap> map;
+};
+static std::mutex gCacheLock;
+
+static std::map<std::pair<std::string, KeyCharacterMap::Format>, CachedKeyCharacterMap>&
+getCacheLocked() {
+    static std::map<std::pair<std::string, KeyCharacterMap::Format>, CachedKeyCharacterMap> cache;
+    return cache;
+}
+
+static bool isSameFile(const struct stat& a, const struct stat& b) {
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size
+            && a.st_mtime == b.st_mtime;
+}
+
 status_t KeyCharacterMap::load(const std::string& filename,
         Format format, sp<KeyCharacterMap>* outMap) {
     outMap->clear();
 
+    const auto cacheKey = std::make_pair(filename, format);
+    struct stat fileStat;
+    bool haveFileStat = stat(filename.c_str(), &fileStat) == 0;
+    if (haveFileStat) {
+        std::scoped_lock lock(gCacheLock);
+        auto& cache = getCacheLocked();
+        auto it = cache.find(cacheKey);
+        if (it != cache.end()) {
+            if (isSameFile(it->second.fileStat, fileStat)) {
+                *outMap = it->second.map;
+                return NO_ERROR;
+            }
+            cache.erase(it);
+        }
+    }
+
     Tokenizer* tokenizer;
     status_t status = Tokenizer::open(String8(filename.c_str()), &tokenizer);
     if (status) {
@@ -118,6 +157,10 @@ status_t KeyCharacterMap::load(const std::string& filename,
         status = load(tokenizer, format, outMap);
         delete tokenizer;
     }
+    if (!status && haveFileStat) {
+        std::scoped_lock lock(gCacheLock);
+        getCacheLocked()[cacheKey] = {fileStat, *outMap};
+    }
     return status;
 }
 
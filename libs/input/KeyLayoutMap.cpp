@@ -17,6 +17,10 @@
 #define LOG_TAG "KeyLayoutMap"
 
 #include <stdlib.h>
+#include <sys/stat.h>
+
+#include <mutex>
+#include <unordered_map>
 
 #include <android/keycodes.h>
 #include <input/InputEventLabels.h>
@@ -49,9 +53,51 @@ KeyLayoutMap::KeyLayoutMap() {
 KeyLayoutMap::~KeyLayoutMap() {
 }
 
+// Key layout maps already parsed by this process, indexed by file name.
+// An entry is only reused while the file it was parsed from is unchanged.
+struct CachedKeyLayoutMap {
+    struct stat fileStat;
+    sp<KeyLayoutMap> map;
+};
+static std::mutex gCacheLock;
+
+static std::unordered_map<std::string, CachedKeyLayoutMap>& getCacheLocked() {
+    static std::unordered_map<std::string, CachedKeyLayoutMap> cache;
+    return cache;
+}
+
+static bool isSameFile(const struct stat& a, const struct stat& b) {
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size
+            && a.st_mtime == b.st_mtime;
+}
+
 status_t KeyLayoutMap::load(const std::string& filename, sp<KeyLayoutMap>* outMap) {
     outMap->clear();
 
+    struct stat fileStat;
+    bool haveFileStat = stat(filename.c_str(), &fileStat) == 0;
+    if (haveFileStat) {
+        std::scoped_lock lock(gCacheLock);
+        auto& cache = getCacheLocked();
+        auto it = cache.find(filename);
+        if (it != cache.end()) {
+            if (isSameFile(it->second.fileStat, fileStat)) {
+                *outMap = it->second.map;
+                return NO_ERROR;
+            }
+            cache.erase(it);
+        }
+    }
+
+    status_t status = loadFile(filename, outMap);
+    if (!status && haveFileStat) {
+        std::scoped_lock lock(gCacheLock);
+        getCacheLocked()[filename] = {fileStat, *outMap};
+    }
+    return status;
+}
+
+status_t KeyLayoutMap::loadFile(const std::string& filename, sp<KeyLayoutMap>* outMap) {
     Tokenizer* tokenizer;
     status_t status = Tokenizer::open(String8(filename.c_str()), &tokenizer);
     if (status) {
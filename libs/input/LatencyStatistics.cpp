@@ -17,7 +17,9 @@
 #include <input/LatencyStatistics.h>
 
 #include <android-base/chrono_utils.h>
+#include <android-base/stringprintf.h>
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
 
@@ -40,6 +42,12 @@ void LatencyStatistics::addValue(float value) {
     mSum += value;
     mSum2 += value * value;
     mCount++;
+
+    size_t bucket = 0;
+    for (float bound = 1; bucket < NUM_BUCKETS - 1 && value >= bound; bound *= 2) {
+        bucket++;
+    }
+    mHistogram[bucket]++;
 }
 
 /**
@@ -69,6 +77,33 @@ size_t LatencyStatistics::getCount() {
     return mCount;
 }
 
+/**
+ * Get the upper bound of the bucket holding the requested percentile, clamped to the samples
+ * actually seen. Should not be called if no samples have been added.
+ */
+float LatencyStatistics::getPercentile(float fraction) {
+    const float target = fraction * mCount;
+    size_t seen = 0;
+    float bound = 1;
+    for (size_t bucket = 0; bucket < NUM_BUCKETS - 1; bucket++, bound *= 2) {
+        seen += mHistogram[bucket];
+        if (seen >= target) {
+            return std::clamp(bound, mMin, mMax);
+        }
+    }
+    return mMax;
+}
+
+std::string LatencyStatistics::dump() {
+    if (mCount == 0) {
+        return "<none>";
+    }
+    return android::base::StringPrintf("count=%zu, mean=%.0f, p50=%.0f, p90=%.0f, p99=%.0f, "
+                                       "max=%.0f",
+                                       mCount, getMean(), getPercentile(0.5), getPercentile(0.9),
+                                       getPercentile(0.99), mMax);
+}
+
 /**
  * Reset internal state. The variable 'when' is the time when the data collection started.
  * Call this to start a new data collection window.
@@ -79,6 +114,7 @@ void LatencyStatistics::reset() {
     mSum = 0;
     mSum2 = 0;
     mCount = 0;
+    mHistogram.fill(0);
     mLastReportTime = std::chrono::steady_clock::now();
 }
 
@@ -170,6 +170,17 @@ VelocityTrackerStrategy* VelocityTracker::createStrategy(const char* strategy) {
         // of the velocity when the finger is released.
         return new LeastSquaresVelocityTrackerStrategy(3);
     }
+    if (!strcmp("slsq1", strategy)) {
+        // 1st order least squares from running sums.  Quality: POOR.
+        // Same fit as 'lsq1'.
+        return new StreamingLeastSquaresVelocityTrackerStrategy(1);
+    }
+    if (!strcmp("slsq2", strategy)) {
+        // 2nd order least squares from running sums.  Quality: VERY GOOD.
+        // Same fit as 'lsq2', but the cost of adding a movement and of getting the
+        // velocity doesn't depend on the number of samples within the horizon.
+        return new StreamingLeastSquaresVelocityTrackerStrategy(2);
+    }
     if (!strcmp("wlsq2-delta", strategy)) {
         // 2nd order weighted least squares, delta weighting.  Quality: EXPERIMENTAL
         return new LeastSquaresVelocityTrackerStrategy(2,
@@ -775,6 +786,189 @@ float LeastSquaresVelocityTrackerStrategy::chooseWeight(uint32_t index) const {
 }
 
 
+// --- StreamingLeastSquaresVelocityTrackerStrategy ---
+
+// Rebase the sums on the newest sample this often, so the sample times in them stay within
+// twice the horizon and removing old samples from them doesn't accumulate rounding errors.
+// Rebasing revisits the samples within the horizon, so this also bounds the amortized cost.
+static const nsecs_t STREAMING_REBASE_INTERVAL = 100 * NANOS_PER_MS;
+
+/*
+ * Solve y = a*t^2 + b*t + c from the sums, the same way as solveUnweightedLeastSquaresDeg2,
+ * then shift the polynomial so that t = 0 is at the given offset from the base time.
+ */
+static bool solveStreamingDeg2(double n, double st, double st2, double st3, double st4,
+        double sy, double sty, double st2y, double offset, float* outCoeff) {
+    const double Sxx = st2 - st * st / n;
+    const double Sxx2 = st3 - st * st2 / n;
+    const double Sx2x2 = st4 - st2 * st2 / n;
+    const double denominator = Sxx * Sx2x2 - Sxx2 * Sxx2;
+    if (denominator == 0) {
+        return false;
+    }
+    const double Sxy = sty - st * sy / n;
+    const double Sx2y = st2y - st2 * sy / n;
+    const double a = (Sx2y * Sxx - Sxy * Sxx2) / denominator;
+    const double b = (Sxy * Sx2x2 - Sx2y * Sxx2) / denominator;
+    const double c = sy / n - b * st / n - a * st2 / n;
+
+    outCoeff[0] = c + b * offset + a * offset * offset;
+    outCoeff[1] = b + 2 * a * offset;
+    outCoeff[2] = a;
+    return true;
+}
+
+/*
+ * Solve y = b*t + c from the sums, then shift it like solveStreamingDeg2.
+ */
+static bool solveStreamingDeg1(double n, double st, double st2, double sy, double sty,
+        double offset, float* outCoeff) {
+    const double Sxx = st2 - st * st / n;
+    if (Sxx == 0) {
+        return false;
+    }
+    const double b = (sty - st * sy / n) / Sxx;
+    const double c = sy / n - b * st / n;
+
+    outCoeff[0] = c + b * offset;
+    outCoeff[1] = b;
+    return true;
+}
+
+StreamingLeastSquaresVelocityTrackerStrategy::StreamingLeastSquaresVelocityTrackerStrategy(
+        uint32_t degree) : mDegree(degree) {
+}
+
+StreamingLeastSquaresVelocityTrackerStrategy::~StreamingLeastSquaresVelocityTrackerStrategy() {
+}
+
+void StreamingLeastSquaresVelocityTrackerStrategy::clear() {
+    mPointerIdBits.clear();
+}
+
+void StreamingLeastSquaresVelocityTrackerStrategy::clearPointers(BitSet32 idBits) {
+    mPointerIdBits.value &= ~idBits.value;
+}
+
+void StreamingLeastSquaresVelocityTrackerStrategy::addMovement(nsecs_t eventTime, BitSet32 idBits,
+        const VelocityTracker::Position* positions) {
+    // Like LeastSquaresVelocityTrackerStrategy, a pointer missing from a movement starts a new
+    // trace when it comes back.
+    BitSet32 trackedIdBits(mPointerIdBits.value & idBits.value);
+    mPointerIdBits = idBits;
+
+    for (BitSet32 iterBits(idBits); !iterBits.isEmpty(); ) {
+        uint32_t id = iterBits.clearFirstMarkedBit();
+        State& state = mPointerState[id];
+        if (!trackedIdBits.hasBit(id)) {
+            state.first = 0;
+            state.count = 0;
+            rebase(state, eventTime);
+        }
+        addSample(state, eventTime, positions[idBits.getIndexOfBit(id)]);
+    }
+}
+
+void StreamingLeastSquaresVelocityTrackerStrategy::addSample(State& state, nsecs_t eventTime,
+        const VelocityTracker::Position& position) const {
+    if (state.count != 0) {
+        const Sample& newest = state.sampleAt(state.count - 1);
+        if (newest.eventTime == eventTime) {
+            // A movement with the same time as the last one replaces it.
+            accumulateSample(state.sums, (newest.eventTime - state.baseTime) * 0.000000001,
+                    newest.position, -1);
+            state.count--;
+        }
+    }
+
+    while (state.count != 0) {
+        const Sample& oldest = state.sampleAt(0);
+        if (state.count < HISTORY_SIZE && eventTime - oldest.eventTime <= HORIZON) {
+            break;
+        }
+        accumulateSample(state.sums, (oldest.eventTime - state.baseTime) * 0.000000001,
+                oldest.position, -1);
+        state.first = (state.first + 1) % HISTORY_SIZE;
+        state.count--;
+    }
+
+    if (eventTime - state.baseTime > STREAMING_REBASE_INTERVAL) {
+        rebase(state, eventTime);
+    }
+
+    Sample& sample = state.samples[(state.first + state.count) % HISTORY_SIZE];
+    sample.eventTime = eventTime;
+    sample.position = position;
+    state.count++;
+    accumulateSample(state.sums, (eventTime - state.baseTime) * 0.000000001, position, 1);
+}
+
+void StreamingLeastSquaresVelocityTrackerStrategy::rebase(State& state, nsecs_t baseTime) const {
+    state.baseTime = baseTime;
+    state.sums = {};
+    for (size_t i = 0; i < state.count; i++) {
+        const Sample& sample = state.sampleAt(i);
+        accumulateSample(state.sums, (sample.eventTime - baseTime) * 0.000000001,
+                sample.position, 1);
+    }
+}
+
+void StreamingLeastSquaresVelocityTrackerStrategy::accumulateSample(Sums& sums, double t,
+        const VelocityTracker::Position& position, double sign) {
+    const double t2 = t * t;
+    sums.t += sign * t;
+    sums.t2 += sign * t2;
+    sums.t3 += sign * t2 * t;
+    sums.t4 += sign * t2 * t2;
+    sums.x += sign * position.x;
+    sums.tx += sign * t * position.x;
+    sums.t2x += sign * t2 * position.x;
+    sums.y += sign * position.y;
+    sums.ty += sign * t * position.y;
+    sums.t2y += sign * t2 * position.y;
+}
+
+bool StreamingLeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
+        VelocityTracker::Estimator* outEstimator) const {
+    outEstimator->clear();
+
+    if (!mPointerIdBits.hasBit(id)) {
+        return false;
+    }
+    const State& state = mPointerState[id];
+    const Sums& sums = state.sums;
+    const Sample& newest = state.sampleAt(state.count - 1);
+    const double n = state.count;
+    // The fit is relative to the newest sample, like LeastSquaresVelocityTrackerStrategy.
+    const double offset = (newest.eventTime - state.baseTime) * 0.000000001;
+
+    outEstimator->time = newest.eventTime;
+    outEstimator->confidence = 1;
+    if (mDegree >= 2 && state.count >= 3
+            && solveStreamingDeg2(n, sums.t, sums.t2, sums.t3, sums.t4, sums.x, sums.tx,
+                    sums.t2x, offset, outEstimator->xCoeff)
+            && solveStreamingDeg2(n, sums.t, sums.t2, sums.t3, sums.t4, sums.y, sums.ty,
+                    sums.t2y, offset, outEstimator->yCoeff)) {
+        outEstimator->degree = 2;
+        return true;
+    }
+    if (state.count >= 2
+            && solveStreamingDeg1(n, sums.t, sums.t2, sums.x, sums.tx, offset,
+                    outEstimator->xCoeff)
+            && solveStreamingDeg1(n, sums.t, sums.t2, sums.y, sums.ty, offset,
+                    outEstimator->yCoeff)) {
+        outEstimator->degree = 1;
+        return true;
+    }
+
+    // No velocity data available for this pointer, but we do have its current position.
+    outEstimator->xCoeff[0] = newest.position.x;
+    outEstimator->yCoeff[0] = newest.position.y;
+    outEstimator->degree = 0;
+    return true;
+}
+
+
 // --- IntegratingVelocityTrackerStrategy ---
 
 IntegratingVelocityTrackerStrategy::IntegratingVelocityTrackerStrategy(uint32_t degree) :
@@ -165,6 +165,115 @@ TEST_F(InputChannelTest, SendSignal_WhenPeerClosed_ReturnsAnError) {
             << "sendMessage should have returned DEAD_OBJECT";
 }
 
+TEST_F(InputChannelTest, SendAndReceive_MotionPointersWithDifferentAxes) {
+    sp<InputChannel> serverChannel, clientChannel;
+    status_t result = InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel);
+    ASSERT_EQ(OK, result)
+            << "should have successfully opened a channel pair";
+
+    InputMessage serverMsg = {}, clientMsg;
+    serverMsg.header.type = InputMessage::Type::MOTION;
+    serverMsg.body.motion.seq = 1;
+    serverMsg.body.motion.pointerCount = 3;
+    for (uint32_t i = 0; i < serverMsg.body.motion.pointerCount; i++) {
+        serverMsg.body.motion.pointers[i].properties.id = i;
+        serverMsg.body.motion.pointers[i].properties.toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+        PointerCoords& coords = serverMsg.body.motion.pointers[i].coords;
+        coords.clear();
+        coords.setAxisValue(AMOTION_EVENT_AXIS_X, 10 * i);
+        coords.setAxisValue(AMOTION_EVENT_AXIS_Y, 20 * i);
+    }
+    // Give the pointer in the middle more axes than the others.
+    PointerCoords& middleCoords = serverMsg.body.motion.pointers[1].coords;
+    middleCoords.setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, 0.5);
+    middleCoords.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MAJOR, 7);
+    middleCoords.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_1, 3);
+
+    ASSERT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+    ASSERT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+    ASSERT_EQ(InputMessage::Type::MOTION, clientMsg.header.type);
+    ASSERT_EQ(serverMsg.body.motion.pointerCount, clientMsg.body.motion.pointerCount);
+    for (uint32_t i = 0; i < serverMsg.body.motion.pointerCount; i++) {
+        EXPECT_EQ(serverMsg.body.motion.pointers[i].properties,
+                  clientMsg.body.motion.pointers[i].properties);
+        EXPECT_EQ(serverMsg.body.motion.pointers[i].coords,
+                  clientMsg.body.motion.pointers[i].coords);
+    }
+}
+
+TEST_F(InputChannelTest, Pack_MotionOnlySendsPopulatedAxes) {
+    InputMessage msg = {}, packedMsg;
+    msg.header.type = InputMessage::Type::MOTION;
+    msg.body.motion.pointerCount = 2;
+    msg.body.motion.pointers[0].coords.setAxisValue(AMOTION_EVENT_AXIS_X, 1);
+    msg.body.motion.pointers[0].coords.setAxisValue(AMOTION_EVENT_AXIS_Y, 2);
+
+    const size_t packedLength = msg.pack(&packedMsg);
+    EXPECT_EQ(msg.size() - 2 * sizeof(PointerCoords::values) + 2 * sizeof(float), packedLength);
+
+    EXPECT_TRUE(packedMsg.unpack(packedLength));
+    EXPECT_EQ(msg.body.motion.pointers[0].coords, packedMsg.body.motion.pointers[0].coords);
+    EXPECT_EQ(msg.body.motion.pointers[1].coords, packedMsg.body.motion.pointers[1].coords);
+
+    InputMessage truncatedMsg;
+    msg.pack(&truncatedMsg);
+    EXPECT_FALSE(truncatedMsg.unpack(packedLength - sizeof(float)));
+}
+
+TEST_F(InputChannelTest, SendMessagesAndReceiveMessages_BatchesKeepOrder) {
+    sp<InputChannel> serverChannel, clientChannel;
+    status_t result = InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel);
+    ASSERT_EQ(OK, result)
+            << "should have successfully opened a channel pair";
+
+    InputMessage serverMsgs[3] = {};
+    for (uint32_t i = 0; i < 3; i++) {
+        serverMsgs[i].header.type = InputMessage::Type::FINISHED;
+        serverMsgs[i].body.finished.seq = i + 1;
+    }
+    size_t sent;
+    EXPECT_EQ(OK, serverChannel->sendMessages(serverMsgs, 3, &sent))
+            << "server channel should be able to send messages to client channel";
+    EXPECT_EQ(3u, sent);
+
+    InputMessage clientMsgs[8];
+    size_t received;
+    EXPECT_EQ(OK, clientChannel->receiveMessages(clientMsgs, 8, &received))
+            << "client channel should be able to receive messages from server channel";
+    ASSERT_EQ(3u, received);
+    for (uint32_t i = 0; i < 3; i++) {
+        EXPECT_EQ(InputMessage::Type::FINISHED, clientMsgs[i].header.type);
+        EXPECT_EQ(i + 1, clientMsgs[i].body.finished.seq);
+    }
+
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessages(clientMsgs, 8, &received))
+            << "receiveMessages should have returned WOULD_BLOCK";
+    EXPECT_EQ(0u, received);
+}
+
+TEST_F(InputChannelTest, ReceiveMessages_WhenPeerClosedAfterMessage_ReportsErrorNextCall) {
+    sp<InputChannel> serverChannel, clientChannel;
+    status_t result = InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel);
+    ASSERT_EQ(OK, result)
+            << "should have successfully opened a channel pair";
+
+    InputMessage serverMsg = {};
+    serverMsg.header.type = InputMessage::Type::FINISHED;
+    serverMsg.body.finished.seq = 1;
+    EXPECT_EQ(OK, serverChannel->sendMessage(&serverMsg));
+    serverChannel.clear(); // close server channel
+
+    InputMessage clientMsgs[8];
+    size_t received;
+    EXPECT_EQ(OK, clientChannel->receiveMessages(clientMsgs, 8, &received));
+    EXPECT_EQ(1u, received);
+    EXPECT_EQ(DEAD_OBJECT, clientChannel->receiveMessages(clientMsgs, 8, &received))
+            << "receiveMessages should have returned DEAD_OBJECT";
+}
+
 TEST_F(InputChannelTest, SendAndReceive_MotionClassification) {
     sp<InputChannel> serverChannel, clientChannel;
     status_t result = InputChannel::openInputChannelPair("channel name",
@@ -97,6 +97,24 @@ TEST(InputWindowInfo, Parcelling) {
     ASSERT_EQ(i.portalToDisplayId, i2.portalToDisplayId);
     ASSERT_EQ(i.replaceTouchableRegionWithCrop, i2.replaceTouchableRegionWithCrop);
     ASSERT_EQ(i.touchableRegionCropHandle, i2.touchableRegionCropHandle);
+    ASSERT_TRUE(i == i2);
+}
+
+TEST(InputWindowInfo, Equality) {
+    InputWindowInfo i;
+    i.id = 1;
+    i.name = "Foobar";
+    i.addTouchableRegion(Rect(0, 0, 10, 10));
+
+    InputWindowInfo i2 = i;
+    ASSERT_TRUE(i == i2);
+
+    i2.touchableRegion = Region(Rect(0, 0, 10, 20));
+    ASSERT_TRUE(i != i2);
+
+    i2 = i;
+    i2.applicationInfo.name = "Barfoo";
+    ASSERT_TRUE(i != i2);
 }
 
 } // namespace test
@@ -62,6 +62,47 @@ TEST(LatencyStatisticsTest, AddMultipleStatsValue) {
     ASSERT_EQ(stdev * stdev, 5.0);
 }
 
+TEST(LatencyStatisticsTest, Histogram) {
+    LatencyStatistics stats{5min};
+    stats.addValue(0.5);
+    stats.addValue(1.0);
+    stats.addValue(3.0);
+    stats.addValue(3.5);
+    stats.addValue(1e9);
+
+    const auto& histogram = stats.getHistogram();
+    ASSERT_EQ(histogram[0], 1u);
+    ASSERT_EQ(histogram[1], 1u);
+    ASSERT_EQ(histogram[2], 2u);
+    ASSERT_EQ(histogram[LatencyStatistics::NUM_BUCKETS - 1], 1u);
+
+    stats.reset();
+    ASSERT_EQ(stats.getHistogram()[2], 0u);
+}
+
+TEST(LatencyStatisticsTest, Percentile) {
+    LatencyStatistics stats{5min};
+    for (int i = 0; i < 90; i++) {
+        stats.addValue(100.0);
+    }
+    for (int i = 0; i < 10; i++) {
+        stats.addValue(5000.0);
+    }
+
+    // Bucket bounds, clamped to the largest sample.
+    ASSERT_EQ(stats.getPercentile(0.5), 128.0);
+    ASSERT_EQ(stats.getPercentile(0.9), 128.0);
+    ASSERT_EQ(stats.getPercentile(0.99), 5000.0);
+}
+
+TEST(LatencyStatisticsTest, Dump) {
+    LatencyStatistics stats{5min};
+    ASSERT_EQ(stats.dump(), "<none>");
+
+    stats.addValue(100.0);
+    ASSERT_EQ(stats.dump(), "count=1, mean=100, p50=100, p90=100, p99=100, max=100");
+}
+
 TEST(LatencyStatisticsTest, ShouldReportStats) {
     LatencyStatistics stats{0min};
     stats.addValue(5.0);
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <input/VelocityTracker.h>
+
+#include <math.h>
+
+#include <vector>
+
+namespace android {
+
+// A one finger fling sampled at 120Hz, long enough that most samples are added to a full
+// horizon, which is where the strategies spend their time on the UI thread.
+static constexpr size_t FLING_SAMPLES = 240;
+static constexpr nsecs_t FLING_SAMPLE_INTERVAL = 8333333; // 8.3 ms
+
+static std::vector<VelocityTracker::Position> createFling() {
+    std::vector<VelocityTracker::Position> positions;
+    for (size_t i = 0; i < FLING_SAMPLES; i++) {
+        const float t = i * FLING_SAMPLE_INTERVAL * 0.000000001f;
+        positions.push_back({540 + 40 * sinf(t * 5), 2000 - 3000 * t + 600 * t * t});
+    }
+    return positions;
+}
+
+static void addFling(benchmark::State& state, const char* strategy, bool getVelocityPerSample) {
+    const std::vector<VelocityTracker::Position> positions = createFling();
+    BitSet32 idBits;
+    idBits.markBit(0);
+    VelocityTracker tracker(strategy);
+    float vx, vy;
+
+    for (auto _ : state) {
+        tracker.clear();
+        nsecs_t eventTime = 0;
+        for (const VelocityTracker::Position& position : positions) {
+            eventTime += FLING_SAMPLE_INTERVAL;
+            tracker.addMovement(eventTime, idBits, &position);
+            if (getVelocityPerSample) {
+                tracker.getVelocity(0, &vx, &vy);
+                benchmark::DoNotOptimize(vx);
+            }
+        }
+        tracker.getVelocity(0, &vx, &vy);
+        benchmark::DoNotOptimize(vx);
+    }
+    state.SetItemsProcessed(state.iterations() * positions.size());
+}
+
+// Like an app that only asks for the velocity when the finger lifts.
+static void BM_AddMovement(benchmark::State& state, const char* strategy) {
+    addFling(state, strategy, false /*getVelocityPerSample*/);
+}
+BENCHMARK_CAPTURE(BM_AddMovement, impulse, "impulse");
+BENCHMARK_CAPTURE(BM_AddMovement, lsq2, "lsq2");
+BENCHMARK_CAPTURE(BM_AddMovement, slsq2, "slsq2");
+
+// Like an app that drives an animation from the velocity of every move event.
+static void BM_AddMovementAndGetVelocity(benchmark::State& state, const char* strategy) {
+    addFling(state, strategy, true /*getVelocityPerSample*/);
+}
+BENCHMARK_CAPTURE(BM_AddMovementAndGetVelocity, impulse, "impulse");
+BENCHMARK_CAPTURE(BM_AddMovementAndGetVelocity, lsq2, "lsq2");
+BENCHMARK_CAPTURE(BM_AddMovementAndGetVelocity, slsq2, "slsq2");
+
+} // namespace android
+
+BENCHMARK_MAIN();
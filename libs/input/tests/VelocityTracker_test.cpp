@@ -217,16 +217,19 @@ static void computeAndCheckVelocity(const char* strategy,
 
 static void computeAndCheckQuadraticEstimate(const std::vector<MotionEventEntry>& motions,
         const std::array<float, 3>& coefficients) {
-    VelocityTracker vt("lsq2");
     std::vector<MotionEvent> events = createMotionEventStream(motions);
-    for (MotionEvent event : events) {
-        vt.addMovement(&event);
-    }
-    VelocityTracker::Estimator estimator;
-    EXPECT_TRUE(vt.getEstimator(0, &estimator));
-    for (size_t i = 0; i< coefficients.size(); i++) {
-        checkCoefficient(estimator.xCoeff[i], coefficients[i]);
-        checkCoefficient(estimator.yCoeff[i], coefficients[i]);
+    for (const char* strategy : {"lsq2", "slsq2"}) {
+        SCOPED_TRACE(strategy);
+        VelocityTracker vt(strategy);
+        for (MotionEvent event : events) {
+            vt.addMovement(&event);
+        }
+        VelocityTracker::Estimator estimator;
+        EXPECT_TRUE(vt.getEstimator(0, &estimator));
+        for (size_t i = 0; i< coefficients.size(); i++) {
+            checkCoefficient(estimator.xCoeff[i], coefficients[i]);
+            checkCoefficient(estimator.yCoeff[i], coefficients[i]);
+        }
     }
 }
 
@@ -256,6 +259,7 @@ TEST_F(VelocityTrackerTest, ThreePointsZeroVelocityTest) {
     };
     computeAndCheckVelocity("impulse", motions, AMOTION_EVENT_AXIS_X, 0);
     computeAndCheckVelocity("lsq2", motions, AMOTION_EVENT_AXIS_X, 0);
+    computeAndCheckVelocity("slsq2", motions, AMOTION_EVENT_AXIS_X, 0);
 }
 
 TEST_F(VelocityTrackerTest, ThreePointsLinearVelocityTest) {
@@ -268,6 +272,7 @@ TEST_F(VelocityTrackerTest, ThreePointsLinearVelocityTest) {
     };
     computeAndCheckVelocity("impulse", motions, AMOTION_EVENT_AXIS_X, 500);
     computeAndCheckVelocity("lsq2", motions, AMOTION_EVENT_AXIS_X, 500);
+    computeAndCheckVelocity("slsq2", motions, AMOTION_EVENT_AXIS_X, 500);
 }
 
 
@@ -907,4 +912,40 @@ TEST_F(VelocityTrackerTest, LeastSquaresVelocityTrackerStrategyEstimator_Parabol
     computeAndCheckQuadraticEstimate(motions, std::array<float, 3>({0, 0E3, 1E6}));
 }
 
+/**
+ * ================== Tests for streaming least squares ============================================
+ *
+ * The streaming strategies keep running sums instead of refitting the history, and should agree
+ * with the least squares strategies they replace over long streams, where old samples fall out of
+ * the horizon and the sums get rebased.
+ */
+TEST_F(VelocityTrackerTest, StreamingLeastSquaresVelocityTrackerStrategy_MatchesLeastSquares) {
+    const std::pair<const char*, const char*> strategies[] = {{"lsq1", "slsq1"},
+                                                               {"lsq2", "slsq2"}};
+    for (const auto& [leastSquaresStrategy, streamingStrategy] : strategies) {
+        SCOPED_TRACE(streamingStrategy);
+        VelocityTracker leastSquares(leastSquaresStrategy);
+        VelocityTracker streaming(streamingStrategy);
+        BitSet32 idBits;
+        idBits.markBit(DEFAULT_POINTER_ID);
+
+        nsecs_t eventTime = 235089067457000;
+        for (size_t i = 0; i < 500; i++) {
+            // Uneven intervals, with every 7th movement repeated at the same time.
+            eventTime += (i % 7 == 0) ? 0 : (4 + i % 5) * 1000000;
+            const float t = i * 0.006f;
+            const VelocityTracker::Position position = {500 + 1200 * t - 400 * t * t,
+                                                        900 - 300 * sinf(t * 3)};
+            leastSquares.addMovement(eventTime, idBits, &position);
+            streaming.addMovement(eventTime, idBits, &position);
+
+            float expectedVx, expectedVy, vx, vy;
+            ASSERT_EQ(leastSquares.getVelocity(DEFAULT_POINTER_ID, &expectedVx, &expectedVy),
+                      streaming.getVelocity(DEFAULT_POINTER_ID, &vx, &vy));
+            EXPECT_NEAR(expectedVx, vx, 0.01f * fabsf(expectedVx) + 1) << "sample " << i;
+            EXPECT_NEAR(expectedVy, vy, 0.01f * fabsf(expectedVy) + 1) << "sample " << i;
+        }
+    }
+}
+
 } // namespace android
@@ -26,6 +26,7 @@
 #include <stdexcept>
 
 #include <math/quat.h>
+#include <math/TSimdHelpers.h>
 #include <math/TVecHelpers.h>
 
 #include  <utils/String8.h>
@@ -224,6 +225,64 @@ CONSTEXPR MATRIX PURE fastInverse3(const MATRIX& x) {
     return inverted;
 }
 
+//------------------------------------------------------------------------------
+// Analytic 4x4 inverse by cofactor expansion, which unlike Gauss-Jordan has no
+// pivoting branches and lends itself to vectorization.
+template <typename MATRIX>
+CONSTEXPR MATRIX PURE fastInverse4(const MATRIX& x) {
+    typedef typename MATRIX::value_type T;
+
+    // The 2x2 determinants of the top two rows (s) and of the bottom two
+    // rows (c), from which all the 3x3 cofactors are built.
+    //
+    // Importantly, our matrices are column-major!
+
+    const T s0 = x[0][0] * x[1][1] - x[0][1] * x[1][0];
+    const T s1 = x[0][0] * x[2][1] - x[0][1] * x[2][0];
+    const T s2 = x[0][0] * x[3][1] - x[0][1] * x[3][0];
+    const T s3 = x[1][0] * x[2][1] - x[1][1] * x[2][0];
+    const T s4 = x[1][0] * x[3][1] - x[1][1] * x[3][0];
+    const T s5 = x[2][0] * x[3][1] - x[2][1] * x[3][0];
+
+    const T c5 = x[2][2] * x[3][3] - x[2][3] * x[3][2];
+    const T c4 = x[1][2] * x[3][3] - x[1][3] * x[3][2];
+    const T c3 = x[1][2] * x[2][3] - x[1][3] * x[2][2];
+    const T c2 = x[0][2] * x[3][3] - x[0][3] * x[3][2];
+    const T c1 = x[0][2] * x[2][3] - x[0][3] * x[2][2];
+    const T c0 = x[0][2] * x[1][3] - x[0][3] * x[1][2];
+
+    MATRIX inverted(MATRIX::NO_INIT);
+
+    inverted[0][0] =  x[1][1] * c5 - x[2][1] * c4 + x[3][1] * c3;
+    inverted[1][0] = -x[1][0] * c5 + x[2][0] * c4 - x[3][0] * c3;
+    inverted[2][0] =  x[1][3] * s5 - x[2][3] * s4 + x[3][3] * s3;
+    inverted[3][0] = -x[1][2] * s5 + x[2][2] * s4 - x[3][2] * s3;
+
+    inverted[0][1] = -x[0][1] * c5 + x[2][1] * c2 - x[3][1] * c1;
+    inverted[1][1] =  x[0][0] * c5 - x[2][0] * c2 + x[3][0] * c1;
+    inverted[2][1] = -x[0][3] * s5 + x[2][3] * s2 - x[3][3] * s1;
+    inverted[3][1] =  x[0][2] * s5 - x[2][2] * s2 + x[3][2] * s1;
+
+    inverted[0][2] =  x[0][1] * c4 - x[1][1] * c2 + x[3][1] * c0;
+    inverted[1][2] = -x[0][0] * c4 + x[1][0] * c2 - x[3][0] * c0;
+    inverted[2][2] =  x[0][3] * s4 - x[1][3] * s2 + x[3][3] * s0;
+    inverted[3][2] = -x[0][2] * s4 + x[1][2] * s2 - x[3][2] * s0;
+
+    inverted[0][3] = -x[0][1] * c3 + x[1][1] * c1 - x[2][1] * c0;
+    inverted[1][3] =  x[0][0] * c3 - x[1][0] * c1 + x[2][0] * c0;
+    inverted[2][3] = -x[0][3] * s3 + x[1][3] * s1 - x[2][3] * s0;
+    inverted[3][3] =  x[0][2] * s3 - x[1][2] * s1 + x[2][2] * s0;
+
+    const T det(s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+    for (size_t col = 0; col < 4; ++col) {
+        for (size_t row = 0; row < 4; ++row) {
+            inverted[col][row] /= det;
+        }
+    }
+
+    return inverted;
+}
+
 /**
  * Inversion function which switches on the matrix size.
  * @warning This function assumes the matrix is invertible. The result is
@@ -235,7 +294,8 @@ inline constexpr MATRIX PURE inverse(const MATRIX& matrix) {
     static_assert(MATRIX::NUM_ROWS == MATRIX::NUM_COLS, "only square matrices can be inverted");
     return (MATRIX::NUM_ROWS == 2) ? fastInverse2<MATRIX>(matrix) :
           ((MATRIX::NUM_ROWS == 3) ? fastInverse3<MATRIX>(matrix) :
-                    gaussJordanInverse<MATRIX>(matrix));
+          ((MATRIX::NUM_ROWS == 4) ? fastInverse4<MATRIX>(matrix) :
+                    gaussJordanInverse<MATRIX>(matrix)));
 }
 
 template<typename MATRIX_R, typename MATRIX_A, typename MATRIX_B>
@@ -253,6 +313,11 @@ CONSTEXPR MATRIX_R PURE multiply(const MATRIX_A& lhs, const MATRIX_B& rhs) {
             "invalid dimension of matrix multiply result.");
 
     MATRIX_R res(MATRIX_R::NO_INIT);
+#if MATH_SIMD
+    if (!__builtin_is_constant_evaluated() && simd::multiply(res, lhs, rhs)) {
+        return res;
+    }
+#endif
     for (size_t col = 0; col < MATRIX_R::NUM_COLS; ++col) {
         res[col] = lhs * rhs[col];
     }
@@ -265,6 +330,11 @@ CONSTEXPR MATRIX PURE transpose(const MATRIX& m) {
     // for now we only handle square matrix transpose
     static_assert(MATRIX::NUM_COLS == MATRIX::NUM_ROWS, "transpose only supports square matrices");
     MATRIX result(MATRIX::NO_INIT);
+#if MATH_SIMD
+    if (!__builtin_is_constant_evaluated() && simd::transpose(result, m)) {
+        return result;
+    }
+#endif
     for (size_t col = 0; col < MATRIX::NUM_COLS; ++col) {
         for (size_t row = 0; row < MATRIX::NUM_ROWS; ++row) {
             result[col][row] = transpose(m[row][col]);
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include <type_traits>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+// The kernels are only used outside of constant evaluation, so they need a way
+// to tell the two apart from within a constexpr function.
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated) && (defined(__ARM_NEON) || defined(__SSE__))
+#define MATH_SIMD 1
+#endif
+#endif
+
+namespace android {
+namespace details {
+// -------------------------------------------------------------------------------------
+
+/*
+ * No user serviceable parts here.
+ *
+ * Don't use this file directly, instead include ui/mat*.h
+ */
+
+namespace simd {
+
+// Float matrices are stored as contiguous columns of floats, and float vectors
+// as contiguous floats, so the kernels below can work on plain arrays.
+template <typename MATRIX, size_t N>
+struct is_matf : std::integral_constant<bool,
+        std::is_same<typename MATRIX::value_type, float>::value &&
+        MATRIX::NUM_ROWS == N && MATRIX::NUM_COLS == N> {};
+
+template <typename VEC, size_t N>
+struct is_vecf : std::integral_constant<bool,
+        std::is_same<typename VEC::value_type, float>::value && VEC::SIZE == N> {};
+
+template <typename MATRIX_R, typename MATRIX_A, typename MATRIX_B>
+struct has_multiply_kernel : std::integral_constant<bool,
+        (is_matf<MATRIX_R, 4>::value && is_matf<MATRIX_A, 4>::value &&
+         is_matf<MATRIX_B, 4>::value) ||
+        (is_matf<MATRIX_R, 3>::value && is_matf<MATRIX_A, 3>::value &&
+         is_matf<MATRIX_B, 3>::value)> {};
+
+template <typename VEC_R, typename MATRIX, typename VEC>
+struct has_multiply_vector_kernel : std::integral_constant<bool,
+        (is_vecf<VEC_R, 4>::value && is_matf<MATRIX, 4>::value && is_vecf<VEC, 4>::value) ||
+        (is_vecf<VEC_R, 3>::value && is_matf<MATRIX, 3>::value && is_vecf<VEC, 3>::value)> {};
+
+template <size_t N>
+using size_tag = std::integral_constant<size_t, N>;
+
+#if MATH_SIMD
+
+/*
+ * Kernels on column-major float arrays. The output must not alias the inputs.
+ *
+ * Each column is accumulated in the same order as the generic code.
+ */
+
+// out = m * v
+inline void mul4x4By4(float* out, const float* m, const float* v) {
+#if defined(__ARM_NEON)
+    float32x4_t r = vmulq_n_f32(vld1q_f32(m), v[0]);
+    r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(m + 4), v[1]));
+    r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(m + 8), v[2]));
+    r = vaddq_f32(r, vmulq_n_f32(vld1q_f32(m + 12), v[3]));
+    vst1q_f32(out, r);
+#else
+    __m128 r = _mm_mul_ps(_mm_loadu_ps(m), _mm_set1_ps(v[0]));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 4), _mm_set1_ps(v[1])));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 8), _mm_set1_ps(v[2])));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(m + 12), _mm_set1_ps(v[3])));
+    _mm_storeu_ps(out, r);
+#endif
+}
+
+// out = a * b, keeping the columns of a in registers.
+inline void mul4x4(float* out, const float* a, const float* b) {
+#if defined(__ARM_NEON)
+    const float32x4_t a0 = vld1q_f32(a);
+    const float32x4_t a1 = vld1q_f32(a + 4);
+    const float32x4_t a2 = vld1q_f32(a + 8);
+    const float32x4_t a3 = vld1q_f32(a + 12);
+    for (int col = 0; col < 4; ++col) {
+        const float* v = b + 4 * col;
+        float32x4_t r = vmulq_n_f32(a0, v[0]);
+        r = vaddq_f32(r, vmulq_n_f32(a1, v[1]));
+        r = vaddq_f32(r, vmulq_n_f32(a2, v[2]));
+        r = vaddq_f32(r, vmulq_n_f32(a3, v[3]));
+        vst1q_f32(out + 4 * col, r);
+    }
+#else
+    const __m128 a0 = _mm_loadu_ps(a);
+    const __m128 a1 = _mm_loadu_ps(a + 4);
+    const __m128 a2 = _mm_loadu_ps(a + 8);
+    const __m128 a3 = _mm_loadu_ps(a + 12);
+    for (int col = 0; col < 4; ++col) {
+        const float* v = b + 4 * col;
+        __m128 r = _mm_mul_ps(a0, _mm_set1_ps(v[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(v[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(v[2])));
+        r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(v[3])));
+        _mm_storeu_ps(out + 4 * col, r);
+    }
+#endif
+}
+
+// out = transpose(m)
+inline void transpose4x4(float* out, const float* m) {
+#if defined(__ARM_NEON)
+    // A de-interleaving load gathers every fourth element, i.e. one row.
+    const float32x4x4_t rows = vld4q_f32(m);
+    vst1q_f32(out, rows.val[0]);
+    vst1q_f32(out + 4, rows.val[1]);
+    vst1q_f32(out + 8, rows.val[2]);
+    vst1q_f32(out + 12, rows.val[3]);
+#else
+    __m128 c0 = _mm_loadu_ps(m);
+    __m128 c1 = _mm_loadu_ps(m + 4);
+    __m128 c2 = _mm_loadu_ps(m + 8);
+    __m128 c3 = _mm_loadu_ps(m + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_storeu_ps(out, c0);
+    _mm_storeu_ps(out + 4, c1);
+    _mm_storeu_ps(out + 8, c2);
+    _mm_storeu_ps(out + 12, c3);
+#endif
+}
+
+// The columns of a 3x3 matrix are 12 bytes, so a 128-bit load of the last one
+// would read past the matrix. Writing the products out in full instead of
+// looping over the columns is enough for the compiler to vectorize them.
+
+// out = m * v
+inline void mul3x3By3(float* out, const float* m, const float* v) {
+    out[0] = m[0] * v[0] + m[3] * v[1] + m[6] * v[2];
+    out[1] = m[1] * v[0] + m[4] * v[1] + m[7] * v[2];
+    out[2] = m[2] * v[0] + m[5] * v[1] + m[8] * v[2];
+}
+
+// out = a * b
+inline void mul3x3(float* out, const float* a, const float* b) {
+    mul3x3By3(out, a, b);
+    mul3x3By3(out + 3, a, b + 3);
+    mul3x3By3(out + 6, a, b + 6);
+}
+
+inline void mul(float* out, const float* a, const float* b, size_tag<4>) {
+    mul4x4(out, a, b);
+}
+
+inline void mul(float* out, const float* a, const float* b, size_tag<3>) {
+    mul3x3(out, a, b);
+}
+
+inline void mulVector(float* out, const float* m, const float* v, size_tag<4>) {
+    mul4x4By4(out, m, v);
+}
+
+inline void mulVector(float* out, const float* m, const float* v, size_tag<3>) {
+    mul3x3By3(out, m, v);
+}
+
+/*
+ * Dispatch from the generic code. These return false when the types have no
+ * kernel, in which case the caller falls back to the generic implementation.
+ */
+
+template <typename MATRIX_R, typename MATRIX_A, typename MATRIX_B>
+inline typename std::enable_if<has_multiply_kernel<MATRIX_R, MATRIX_A, MATRIX_B>::value,
+        bool>::type
+multiply(MATRIX_R& res, const MATRIX_A& lhs, const MATRIX_B& rhs) {
+    mul(&res[0][0], &lhs[0][0], &rhs[0][0], size_tag<MATRIX_R::NUM_ROWS>());
+    return true;
+}
+
+template <typename MATRIX_R, typename MATRIX_A, typename MATRIX_B>
+inline typename std::enable_if<!has_multiply_kernel<MATRIX_R, MATRIX_A, MATRIX_B>::value,
+        bool>::type
+multiply(MATRIX_R&, const MATRIX_A&, const MATRIX_B&) {
+    return false;
+}
+
+template <typename VEC_R, typename MATRIX, typename VEC>
+inline typename std::enable_if<has_multiply_vector_kernel<VEC_R, MATRIX, VEC>::value, bool>::type
+multiplyVector(VEC_R& res, const MATRIX& lhs, const VEC& rhs) {
+    mulVector(&res[0], &lhs[0][0], &rhs[0], size_tag<MATRIX::NUM_ROWS>());
+    return true;
+}
+
+template <typename VEC_R, typename MATRIX, typename VEC>
+inline typename std::enable_if<!has_multiply_vector_kernel<VEC_R, MATRIX, VEC>::value,
+        bool>::type
+multiplyVector(VEC_R&, const MATRIX&, const VEC&) {
+    return false;
+}
+
+template <typename MATRIX>
+inline typename std::enable_if<is_matf<MATRIX, 4>::value, bool>::type
+transpose(MATRIX& res, const MATRIX& m) {
+    transpose4x4(&res[0][0], &m[0][0]);
+    return true;
+}
+
+template <typename MATRIX>
+inline typename std::enable_if<!is_matf<MATRIX, 4>::value, bool>::type
+transpose(MATRIX&, const MATRIX&) {
+    return false;
+}
+
+#endif // MATH_SIMD
+
+}  // namespace simd
+
+// -------------------------------------------------------------------------------------
+}  // namespace details
+}  // namespace android
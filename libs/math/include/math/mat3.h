@@ -375,6 +375,11 @@ template <typename T, typename U>
 CONSTEXPR typename TMat33<U>::col_type PURE operator *(const TMat33<T>& lhs, const TVec3<U>& rhs) {
     // Result is initialized to zero.
     typename TMat33<U>::col_type result;
+#if MATH_SIMD
+    if (!__builtin_is_constant_evaluated() && simd::multiplyVector(result, lhs, rhs)) {
+        return result;
+    }
+#endif
     for (size_t col = 0; col < TMat33<T>::NUM_COLS; ++col) {
         result += lhs[col] * rhs[col];
     }
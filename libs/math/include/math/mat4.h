@@ -524,6 +524,11 @@ template <typename T, typename U>
 CONSTEXPR typename TMat44<T>::col_type PURE operator *(const TMat44<T>& lhs, const TVec4<U>& rhs) {
     // Result is initialized to zero.
     typename TMat44<T>::col_type result;
+#if MATH_SIMD
+    if (!__builtin_is_constant_evaluated() && simd::multiplyVector(result, lhs, rhs)) {
+        return result;
+    }
+#endif
     for (size_t col = 0; col < TMat44<T>::NUM_COLS; ++col) {
         result += lhs[col] * rhs[col];
     }
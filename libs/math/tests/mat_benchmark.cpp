@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <math/mat3.h>
+#include <math/mat4.h>
+
+namespace android {
+
+namespace {
+
+const mat4 kMat4 = mat4::translate(vec4(1.5f, -2.0f, 3.0f, 1.0f)) *
+        mat4::eulerZYX(0.3f, 0.2f, 0.1f) * mat4::scale(vec4(2.0f, 3.0f, 4.0f, 1.0f));
+const mat3 kMat3 = mat3::eulerZYX(0.3f, 0.2f, 0.1f) * mat3(2.0f);
+const vec4 kVec4(1.0f, -2.0f, 3.0f, 1.0f);
+
+// The products the SIMD kernels replaced, written out as the generic code
+// does them, so the gap between the two shows up in the same run.
+mat4 scalarMultiply(const mat4& lhs, const mat4& rhs) {
+    mat4 res(mat4::NO_INIT);
+    for (size_t col = 0; col < 4; ++col) {
+        vec4 v(0);
+        for (size_t k = 0; k < 4; ++k) {
+            v += lhs[k] * rhs[col][k];
+        }
+        res[col] = v;
+    }
+    return res;
+}
+
+} // namespace
+
+static void BM_Mat4Multiply(benchmark::State& state) {
+    mat4 m = kMat4;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(m);
+        mat4 r = m * kMat4;
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(BM_Mat4Multiply);
+
+static void BM_Mat4MultiplyScalar(benchmark::State& state) {
+    mat4 m = kMat4;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(m);
+        mat4 r = scalarMultiply(m, kMat4);
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(BM_Mat4MultiplyScalar);
+
+static void BM_Mat4MultiplyVec4(benchmark::State& state) {
+    vec4 v = kVec4;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(v);
+        vec4 r = kMat4 * v;
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(BM_Mat4MultiplyVec4);
+
+static void BM_Mat4Transpose(benchmark::State& state) {
+    mat4 m = kMat4;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(m);
+        mat4 r = transpose(m);
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(BM_Mat4Transpose);
+
+static void BM_Mat4Inverse(benchmark::State& state) {
+    mat4 m = kMat4;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(m);
+        mat4 r = inverse(m);
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(BM_Mat4Inverse);
+
+static void BM_Mat4InverseGaussJordan(benchmark::State& state) {
+    mat4 m = kMat4;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(m);
+        mat4 r = details::matrix::gaussJordanInverse(m);
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(BM_Mat4InverseGaussJordan);
+
+static void BM_Mat3Multiply(benchmark::State& state) {
+    mat3 m = kMat3;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(m);
+        mat3 r = m * kMat3;
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(BM_Mat3Multiply);
+
+static void BM_Mat3Inverse(benchmark::State& state) {
+    mat3 m = kMat3;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(m);
+        mat3 r = inverse(m);
+        benchmark::DoNotOptimize(r);
+    }
+}
+BENCHMARK(BM_Mat3Inverse);
+
+} // namespace android
+
+BENCHMARK_MAIN();
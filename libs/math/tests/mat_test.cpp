@@ -18,6 +18,7 @@
 
 #include <stdlib.h>
 
+#include <algorithm>
 #include <limits>
 #include <random>
 #include <functional>
@@ -163,6 +164,59 @@ TEST_F(MatTest, ElementAccess) {
     EXPECT_FLOAT_EQ(m(3, 2), 100);
 }
 
+TEST_F(MatTest, ProductsMatchScalar) {
+    const mat4 a(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16);
+    const mat4 b(0, -1, 0, 0, 1, 0, 0, 0, 0, 0, 2, 0, 3, 4, 5, 1);
+    const vec4 v(1, -2, 3, -4);
+
+    const mat4 ab = a * b;
+    const vec4 av = a * v;
+    const mat4 at = transpose(a);
+    for (size_t c = 0; c < 4; ++c) {
+        for (size_t r = 0; r < 4; ++r) {
+            float expected = 0;
+            for (size_t k = 0; k < 4; ++k) {
+                expected += a[k][r] * b[c][k];
+            }
+            EXPECT_FLOAT_EQ(expected, ab[c][r]);
+            EXPECT_FLOAT_EQ(a[r][c], at[c][r]);
+        }
+        EXPECT_FLOAT_EQ(a[0][c] * v[0] + a[1][c] * v[1] + a[2][c] * v[2] + a[3][c] * v[3],
+                        av[c]);
+    }
+
+    const mat3 a3(a.upperLeft());
+    const mat3 b3(b.upperLeft());
+    const mat3 ab3 = a3 * b3;
+    for (size_t c = 0; c < 3; ++c) {
+        for (size_t r = 0; r < 3; ++r) {
+            EXPECT_FLOAT_EQ(a3[0][r] * b3[c][0] + a3[1][r] * b3[c][1] + a3[2][r] * b3[c][2],
+                            ab3[c][r]);
+        }
+    }
+}
+
+TEST_F(MatTest, InverseMatchesGaussJordan) {
+    std::default_random_engine generator(171717);
+    std::uniform_real_distribution<float> distribution(-10.0, 10.0);
+    auto rand_gen = std::bind(distribution, generator);
+
+    for (size_t i = 0; i < 100; ++i) {
+        mat4 m;
+        for (size_t c = 0; c < 4; ++c) {
+            m[c] = vec4(rand_gen(), rand_gen(), rand_gen(), rand_gen());
+        }
+        const mat4 expected = details::matrix::gaussJordanInverse(m);
+        const mat4 actual = inverse(m);
+        for (size_t c = 0; c < 4; ++c) {
+            for (size_t r = 0; r < 4; ++r) {
+                EXPECT_NEAR(expected[c][r], actual[c][r],
+                            1e-3f * std::max(1.0f, std::abs(expected[c][r])));
+            }
+        }
+    }
+}
+
 //------------------------------------------------------------------------------
 // MAT 3
 //------------------------------------------------------------------------------
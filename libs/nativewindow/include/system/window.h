@@ -255,6 +255,7 @@ enum {
     NATIVE_WINDOW_ALLOCATE_BUFFERS                = 45,    /* private */
     NATIVE_WINDOW_GET_LAST_QUEUED_BUFFER          = 46,    /* private */
     NATIVE_WINDOW_SET_QUERY_INTERCEPTOR           = 47,    /* private */
+    NATIVE_WINDOW_GET_PERFORM_TABLE               = 48,    /* private */
     // clang-format on
 };
 
@@ -1097,4 +1098,49 @@ static inline int ANativeWindow_setQueryInterceptor(ANativeWindow* window,
     return window->perform(window, NATIVE_WINDOW_SET_QUERY_INTERCEPTOR, interceptor, data);
 }
 
+/**
+ * Functions that perform the operations a producer typically calls every
+ * frame, without going through ANativeWindow::perform and the decoding of its
+ * variable arguments. Each of them behaves like the perform operation it is
+ * named after, including when a perform interceptor is registered.
+ *
+ * New functions may only be added at the end; |size| is the size of the table
+ * the window provides, and callers must check it before using any function
+ * added after the ones below.
+ */
+typedef struct ANativeWindowPerformTable {
+    size_t size;
+    /* NATIVE_WINDOW_SET_BUFFERS_TIMESTAMP */
+    int (*setBuffersTimestamp)(ANativeWindow* window, int64_t timestamp);
+    /* NATIVE_WINDOW_SET_SURFACE_DAMAGE */
+    int (*setSurfaceDamage)(ANativeWindow* window, const android_native_rect_t* rects,
+                            size_t numRects);
+    /* NATIVE_WINDOW_SET_BUFFERS_DATASPACE */
+    int (*setBuffersDataSpace)(ANativeWindow* window, int32_t dataSpace);
+    /* NATIVE_WINDOW_SET_USAGE64 */
+    int (*setUsage)(ANativeWindow* window, uint64_t usage);
+    /* NATIVE_WINDOW_SET_DEQUEUE_TIMEOUT */
+    int (*setDequeueTimeout)(ANativeWindow* window, int64_t timeout);
+    /* NATIVE_WINDOW_GET_NEXT_FRAME_ID */
+    int (*getNextFrameId)(ANativeWindow* window, uint64_t* frameId);
+} ANativeWindowPerformTable;
+
+/**
+ * Retrieves the perform table of a window. The table stays valid for as long
+ * as the window, so callers should look it up once and keep it.
+ *
+ * Returns NO_ERROR on success. Windows that have no such table return an
+ * error and set |outTable| to NULL, in which case the operations must go
+ * through ANativeWindow::perform.
+ */
+static inline int native_window_get_perform_table(struct ANativeWindow* window,
+                                                  const ANativeWindowPerformTable** outTable) {
+    *outTable = NULL;
+    int err = window->perform(window, NATIVE_WINDOW_GET_PERFORM_TABLE, outTable);
+    if (err != 0) {
+        *outTable = NULL;
+    }
+    return err;
+}
+
 __END_DECLS
@@ -20,7 +20,9 @@
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
 #include <sched.h>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <unordered_set>
@@ -50,6 +52,7 @@
 #include "Program.h"
 #include "ProgramCache.h"
 #include "filters/BlurFilter.h"
+#include "filters/DualKawaseBlurFilter.h"
 
 extern "C" EGLAPI const char* eglQueryStringImplementationANDROID(EGLDisplay dpy, EGLint name);
 
@@ -402,10 +405,19 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
     }
 
     if (args.supportsBackgroundBlur) {
-        mBlurFilter = new BlurFilter(*this);
+        property_get(PROPERTY_DEBUG_RENDERENGINE_BLUR_ALGORITHM, value, "kawase");
+        if (strcmp(value, "dual_kawase") == 0) {
+            mBlurFilter = new DualKawaseBlurFilter(*this);
+        } else {
+            mBlurFilter = new BlurFilter(*this);
+        }
         checkErrors("BlurFilter creation");
     }
 
+    mVertexBuffer.bind();
+    mVertexBuffer.allocateStreamBuffer(kVertexBufferSize);
+    mVertexBuffer.unbind();
+
     mImageManager = std::make_unique<ImageManager>(this);
     mImageManager->initThread();
     mDrawingBuffer = createFramebuffer();
@@ -594,11 +606,20 @@ void GLESRenderEngine::fillRegionWithColor(const Region& region, float red, floa
 }
 
 void GLESRenderEngine::setScissor(const Rect& region) {
-    glScissor(region.left, region.top, region.getWidth(), region.getHeight());
+    Rect scissor = region;
+    if (mDamageRect.isValid() && !region.intersect(mDamageRect, &scissor)) {
+        scissor = Rect::EMPTY_RECT;
+    }
+    glScissor(scissor.left, scissor.top, scissor.getWidth(), scissor.getHeight());
     glEnable(GL_SCISSOR_TEST);
 }
 
 void GLESRenderEngine::disableScissor() {
+    if (mDamageRect.isValid()) {
+        glScissor(mDamageRect.left, mDamageRect.top, mDamageRect.getWidth(),
+                  mDamageRect.getHeight());
+        return;
+    }
     glDisable(GL_SCISSOR_TEST);
 }
 
@@ -642,9 +663,12 @@ status_t GLESRenderEngine::bindExternalTextureBuffer(uint32_t texName,
 
     // If we couldn't find the image in the cache at this time, then either
     // SurfaceFlinger messed up registering the buffer ahead of time or we got
-    // backed up creating other EGLImages.
+    // backed up creating other EGLImages. Either way, create the image right
+    // here rather than wait for the ImageManager to get through its queue: if
+    // it gets to this buffer later, it will find the image already cached.
     if (!found) {
-        status_t cacheResult = mImageManager->cache(buffer);
+        ATRACE_NAME("cacheExternalTextureBuffer on bind");
+        status_t cacheResult = cacheExternalTextureBufferInternal(buffer);
         if (cacheResult != NO_ERROR) {
             return cacheResult;
         }
@@ -1064,7 +1088,24 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
     }
     const auto blurLayersSize = blurLayers.size();
 
-    if (blurLayersSize == 0) {
+    // When a single layer is blurred and nothing below it changed since the
+    // last frame, the blur from then is still in the filter: skip drawing the
+    // background and go straight to the native buffer.
+    std::vector<const LayerSettings*> blurBackground;
+    uint32_t blurRadius = 0;
+    bool reuseBlur = false;
+    if (blurLayersSize == 1 && !mInProtectedContext) {
+        blurBackground.assign(layers.begin(),
+                              std::find(layers.begin(), layers.end(), blurLayers.front()));
+        blurRadius = blurLayers.front()->backgroundBlurRadius;
+        reuseBlur = mBlurFilter->isBackgroundUnchanged(display, blurBackground, blurRadius);
+    }
+    if (blurLayersSize > 0 && !reuseBlur) {
+        // Remembered again once the new blur is drawn.
+        mBlurFilter->clearBackground();
+    }
+
+    if (blurLayersSize == 0 || reuseBlur) {
         fbo = std::make_unique<BindNativeBufferAsFramebuffer>(*this, buffer, useFramebufferCache);
         if (fbo->getStatus() != NO_ERROR) {
             ALOGE("Failed to bind framebuffer! Aborting GPU composition for buffer (%p).",
@@ -1085,6 +1126,16 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         }
     }
 
+    // If the caller knows the rest of the buffer is already up to date, only
+    // redraw the damaged part of it. Blurs sample outside of the area they
+    // draw to, so they always redraw everything.
+    mDamageRect = blurLayersSize == 0 ? display.damageRect : Rect::INVALID_RECT;
+    if (mDamageRect.isValid()) {
+        setScissor(mDamageRect);
+    } else {
+        disableScissor();
+    }
+
     // clear the entire buffer, sometimes when we reuse buffers we'd persist
     // ghost images otherwise.
     // we also require a full transparent framebuffer for overlays. This is
@@ -1109,7 +1160,18 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
                         .setCropCoords(2 /* size */)
                         .build();
     for (auto const layer : layers) {
-        if (blurLayers.size() > 0 && blurLayers.front() == layer) {
+        if (reuseBlur && blurLayers.size() > 0) {
+            if (blurLayers.front() != layer) {
+                continue;
+            }
+            blurLayers.pop_front();
+            if (status_t status = mBlurFilter->render(false); status != NO_ERROR) {
+                ALOGE("Failed to render blur effect! Aborting GPU composition for buffer (%p).",
+                      buffer->handle);
+                checkErrors("Can't render cached blur filter");
+                return status;
+            }
+        } else if (blurLayers.size() > 0 && blurLayers.front() == layer) {
             blurLayers.pop_front();
 
             auto status = mBlurFilter->prepare();
@@ -1223,6 +1285,15 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         }
     }
 
+    if (mDamageRect.isValid()) {
+        mDamageRect = Rect::INVALID_RECT;
+        disableScissor();
+    }
+
+    if (blurLayersSize == 1 && !mInProtectedContext && !reuseBlur) {
+        mBlurFilter->setBackground(display, blurBackground, blurRadius);
+    }
+
     if (drawFence != nullptr) {
         *drawFence = flush();
     }
@@ -1338,29 +1409,50 @@ void GLESRenderEngine::setupCornerRadiusCropSize(float width, float height) {
 
 void GLESRenderEngine::drawMesh(const Mesh& mesh) {
     ATRACE_CALL();
+    // The attribute pointers are offsets from the start of the vertices,
+    // either in mVertexBuffer or in client memory. The buffer belongs to
+    // mEGLContext, which the protected context doesn't share objects with.
+    const uintptr_t vertices = reinterpret_cast<uintptr_t>(mesh.getPositions());
+    uintptr_t base = vertices;
+    const bool useVertexBuffer = !mInProtectedContext && mesh.getVertexCount() > 0;
+    if (useVertexBuffer) {
+        mVertexBuffer.bind();
+        base = mVertexBuffer.append(mesh.getPositions(),
+                                    mesh.getVertexCount() * mesh.getByteStride());
+    }
+    const auto attribute = [vertices, base](const float* data) {
+        const uintptr_t offset = reinterpret_cast<uintptr_t>(data) - vertices;
+        return reinterpret_cast<const GLvoid*>(base + offset);
+    };
+
     if (mesh.getTexCoordsSize()) {
         glEnableVertexAttribArray(Program::texCoords);
         glVertexAttribPointer(Program::texCoords, mesh.getTexCoordsSize(), GL_FLOAT, GL_FALSE,
-                              mesh.getByteStride(), mesh.getTexCoords());
+                              mesh.getByteStride(), attribute(mesh.getTexCoords()));
     }
 
     glVertexAttribPointer(Program::position, mesh.getVertexSize(), GL_FLOAT, GL_FALSE,
-                          mesh.getByteStride(), mesh.getPositions());
+                          mesh.getByteStride(), attribute(mesh.getPositions()));
 
     if (mState.cornerRadius > 0.0f) {
         glEnableVertexAttribArray(Program::cropCoords);
         glVertexAttribPointer(Program::cropCoords, mesh.getVertexSize(), GL_FLOAT, GL_FALSE,
-                              mesh.getByteStride(), mesh.getCropCoords());
+                              mesh.getByteStride(), attribute(mesh.getCropCoords()));
     }
 
     if (mState.drawShadows) {
         glEnableVertexAttribArray(Program::shadowColor);
         glVertexAttribPointer(Program::shadowColor, mesh.getShadowColorSize(), GL_FLOAT, GL_FALSE,
-                              mesh.getByteStride(), mesh.getShadowColor());
+                              mesh.getByteStride(), attribute(mesh.getShadowColor()));
 
         glEnableVertexAttribArray(Program::shadowParams);
         glVertexAttribPointer(Program::shadowParams, mesh.getShadowParamsSize(), GL_FLOAT, GL_FALSE,
-                              mesh.getByteStride(), mesh.getShadowParams());
+                              mesh.getByteStride(), attribute(mesh.getShadowParams()));
+    }
+
+    if (useVertexBuffer) {
+        // The attributes keep reading from the buffer they were set up with.
+        mVertexBuffer.unbind();
     }
 
     Description managedState = mState;
@@ -1517,6 +1609,8 @@ void GLESRenderEngine::dump(std::string& result) {
                   cache.getSize(mEGLContext));
     StringAppendF(&result, "RenderEngine program cache size for protected context: %zu\n",
                   cache.getSize(mProtectedEGLContext));
+    StringAppendF(&result, "RenderEngine program binaries stored on disk: %zu\n",
+                  cache.getBinaryCount());
     StringAppendF(&result, "RenderEngine last dataspace conversion: (%s) to (%s)\n",
                   dataspaceDetails(static_cast<android_dataspace>(mDataSpace)).c_str(),
                   dataspaceDetails(static_cast<android_dataspace>(mOutputDataSpace)).c_str());
@@ -1738,6 +1832,33 @@ void GLESRenderEngine::FlushTracer::loop() {
 void GLESRenderEngine::handleShadow(const FloatRect& casterRect, float casterCornerRadius,
                                     const ShadowSettings& settings) {
     ATRACE_CALL();
+    const Mesh& mesh = getShadowMesh(casterRect, casterCornerRadius, settings);
+
+    mState.cornerRadius = 0.0f;
+    mState.drawShadows = true;
+    setupLayerTexturing(mShadowTexture.getTexture());
+    drawMesh(mesh);
+    mState.drawShadows = false;
+}
+
+const Mesh& GLESRenderEngine::getShadowMesh(const FloatRect& casterRect, float casterCornerRadius,
+                                            const ShadowSettings& settings) {
+    auto found = std::find_if(mShadowMeshCache.begin(), mShadowMeshCache.end(),
+                              [&](const ShadowMeshEntry& entry) {
+                                  return entry.casterRect == casterRect &&
+                                          entry.casterCornerRadius == casterCornerRadius &&
+                                          entry.settings == settings;
+                              });
+    if (found != mShadowMeshCache.end()) {
+        if (found != mShadowMeshCache.end() - 1) {
+            ShadowMeshEntry entry = std::move(*found);
+            mShadowMeshCache.erase(found);
+            mShadowMeshCache.push_back(std::move(entry));
+        }
+        return *mShadowMeshCache.back().mesh;
+    }
+
+    ATRACE_NAME("generateShadowMesh");
     const float casterZ = settings.length / 2.0f;
     const GLShadowVertexGenerator shadows(casterRect, casterCornerRadius, casterZ,
                                           settings.casterIsTranslucent, settings.ambientColor,
@@ -1745,24 +1866,25 @@ void GLESRenderEngine::handleShadow(const FloatRect& casterRect, float casterCor
                                           settings.lightRadius);
 
     // setup mesh for both shadows
-    Mesh mesh = Mesh::Builder()
-                        .setPrimitive(Mesh::TRIANGLES)
-                        .setVertices(shadows.getVertexCount(), 2 /* size */)
-                        .setShadowAttrs()
-                        .setIndices(shadows.getIndexCount())
-                        .build();
-
-    Mesh::VertexArray<vec2> position = mesh.getPositionArray<vec2>();
-    Mesh::VertexArray<vec4> shadowColor = mesh.getShadowColorArray<vec4>();
-    Mesh::VertexArray<vec3> shadowParams = mesh.getShadowParamsArray<vec3>();
+    std::unique_ptr<Mesh> mesh(new Mesh(Mesh::Builder()
+                                                .setPrimitive(Mesh::TRIANGLES)
+                                                .setVertices(shadows.getVertexCount(),
+                                                             2 /* size */)
+                                                .setShadowAttrs()
+                                                .setIndices(shadows.getIndexCount())
+                                                .build()));
+
+    Mesh::VertexArray<vec2> position = mesh->getPositionArray<vec2>();
+    Mesh::VertexArray<vec4> shadowColor = mesh->getShadowColorArray<vec4>();
+    Mesh::VertexArray<vec3> shadowParams = mesh->getShadowParamsArray<vec3>();
     shadows.fillVertices(position, shadowColor, shadowParams);
-    shadows.fillIndices(mesh.getIndicesArray());
+    shadows.fillIndices(mesh->getIndicesArray());
 
-    mState.cornerRadius = 0.0f;
-    mState.drawShadows = true;
-    setupLayerTexturing(mShadowTexture.getTexture());
-    drawMesh(mesh);
-    mState.drawShadows = false;
+    if (mShadowMeshCache.size() >= kShadowMeshCacheSize) {
+        mShadowMeshCache.pop_front();
+    }
+    mShadowMeshCache.push_back({casterRect, casterCornerRadius, settings, std::move(mesh)});
+    return *mShadowMeshCache.back().mesh;
 }
 
 } // namespace gl
@@ -19,6 +19,7 @@
 
 #include <condition_variable>
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
@@ -32,6 +33,7 @@
 #include <renderengine/private/Description.h>
 #include <sys/types.h>
 #include "GLShadowTexture.h"
+#include "GLVertexBuffer.h"
 #include "ImageManager.h"
 
 #define EGL_NO_CONFIG ((EGLConfig)0)
@@ -71,6 +73,7 @@ public:
     bool isProtected() const override { return mInProtectedContext; }
     bool supportsProtectedContent() const override;
     bool useProtectedContext(bool useProtectedContext) override;
+    bool canDrawFromAnyThread() const override { return false; }
     status_t drawLayers(const DisplaySettings& display,
                         const std::vector<const LayerSettings*>& layers,
                         ANativeWindowBuffer* buffer, const bool useFramebufferCache,
@@ -160,6 +163,10 @@ private:
     void fillRegionWithColor(const Region& region, float red, float green, float blue, float alpha);
     void handleShadow(const FloatRect& casterRect, float casterCornerRadius,
                       const ShadowSettings& shadowSettings);
+    // Returns the mesh drawing the shadows of the given caster, generating it
+    // if it is not in mShadowMeshCache.
+    const Mesh& getShadowMesh(const FloatRect& casterRect, float casterCornerRadius,
+                              const ShadowSettings& shadowSettings);
     void setupLayerBlending(bool premultipliedAlpha, bool opaque, bool disableTexture,
                             const half4& color, float cornerRadius);
     void setupLayerTexturing(const Texture& texture);
@@ -188,8 +195,27 @@ private:
     GLint mMaxTextureSize;
     GLuint mVpWidth;
     GLuint mVpHeight;
+    // The only part of the buffer the current drawLayers call draws to, or
+    // invalid to draw to all of it. The scissor never leaves it.
+    Rect mDamageRect = Rect::INVALID_RECT;
     Description mState;
     GLShadowTexture mShadowTexture;
+    // The vertices of the meshes drawn in mEGLContext are streamed into this
+    // buffer instead of being read from client memory by each draw call.
+    GLVertexBuffer mVertexBuffer;
+    static constexpr GLsizeiptr kVertexBufferSize = 64 * 1024;
+
+    // Shadows are usually drawn again with the same caster and settings from
+    // one frame to the next, so the last few meshes are kept around instead of
+    // tessellating them every time. The most recently used mesh is at the back.
+    struct ShadowMeshEntry {
+        FloatRect casterRect;
+        float casterCornerRadius;
+        ShadowSettings settings;
+        std::unique_ptr<Mesh> mesh;
+    };
+    static constexpr size_t kShadowMeshCacheSize = 8;
+    std::deque<ShadowMeshEntry> mShadowMeshCache;
 
     mat4 mSrgbToXyz;
     mat4 mDisplayP3ToXyz;
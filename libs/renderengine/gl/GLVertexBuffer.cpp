@@ -23,6 +23,8 @@
 #include <nativebase/nativebase.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
+
 namespace android {
 namespace renderengine {
 namespace gl {
@@ -42,6 +44,32 @@ void GLVertexBuffer::allocateBuffers(const GLfloat data[], const GLuint size) {
     unbind();
 }
 
+void GLVertexBuffer::allocateStreamBuffer(GLsizeiptr size) {
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    mStreamSize = size;
+    mStreamOffset = 0;
+}
+
+GLintptr GLVertexBuffer::append(const void* data, GLsizeiptr size) {
+    // Keep every range aligned for the attributes read from it.
+    constexpr GLsizeiptr kAlignment = 16;
+    const GLsizeiptr alignedSize = (size + kAlignment - 1) & ~(kAlignment - 1);
+    if (alignedSize > mStreamSize) {
+        GLsizeiptr newSize = std::max(mStreamSize, kAlignment);
+        while (newSize < alignedSize) {
+            newSize *= 2;
+        }
+        allocateStreamBuffer(newSize);
+    } else if (mStreamOffset + alignedSize > mStreamSize) {
+        ATRACE_NAME("GLVertexBuffer::orphan");
+        allocateStreamBuffer(mStreamSize);
+    }
+    const GLintptr offset = mStreamOffset;
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+    mStreamOffset += alignedSize;
+    return offset;
+}
+
 void GLVertexBuffer::bind() const {
     glBindBuffer(GL_ARRAY_BUFFER, mBufferName);
 }
@@ -40,8 +40,20 @@ public:
     void bind() const;
     void unbind() const;
 
+    // Uses the buffer as a ring of |size| bytes that data is streamed into
+    // with append. The buffer must be bound.
+    void allocateStreamBuffer(GLsizeiptr size);
+    // Copies |size| bytes of |data| past the data appended before and returns
+    // their offset in the buffer. Once the buffer is full, its storage is
+    // orphaned and appending starts over at the beginning, so that the data
+    // of draws the GPU has not executed yet is never overwritten. The buffer
+    // grows if |size| does not fit in it. The buffer must be bound.
+    GLintptr append(const void* data, GLsizeiptr size);
+
 private:
     uint32_t mBufferName;
+    GLsizeiptr mStreamSize = 0;
+    GLintptr mStreamOffset = 0;
 };
 
 } // namespace gl
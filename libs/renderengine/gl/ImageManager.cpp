@@ -70,16 +70,6 @@ void ImageManager::cacheAsync(const sp<GraphicBuffer>& buffer,
     queueOperation(std::move(entry));
 }
 
-status_t ImageManager::cache(const sp<GraphicBuffer>& buffer) {
-    ATRACE_CALL();
-    auto barrier = std::make_shared<Barrier>();
-    cacheAsync(buffer, barrier);
-    std::lock_guard<std::mutex> lock(barrier->mutex);
-    barrier->condition.wait(barrier->mutex,
-                            [&]() REQUIRES(barrier->mutex) { return barrier->isOpen; });
-    return barrier->result;
-}
-
 void ImageManager::releaseAsync(uint64_t bufferId, const std::shared_ptr<Barrier>& barrier) {
     ATRACE_CALL();
     QueueEntry entry = {QueueEntry::Operation::Delete, nullptr, bufferId, barrier};
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "ProgramBinaryCache.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <cstring>
+
+#include <android-base/file.h>
+#include <log/log.h>
+#include <utils/Trace.h>
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+namespace {
+
+constexpr uint32_t kMagic = 0x52455042; // 'REPB'
+constexpr uint32_t kVersion = 1;
+// Anything larger is assumed to be a corrupt file.
+constexpr uint32_t kMaxBinarySize = 4 * 1024 * 1024;
+
+class Reader {
+public:
+    explicit Reader(const std::string& data) : mData(data) {}
+
+    bool read(void* out, size_t size) {
+        if (mData.size() - mOffset < size) {
+            return false;
+        }
+        memcpy(out, mData.data() + mOffset, size);
+        mOffset += size;
+        return true;
+    }
+
+    template <typename T>
+    bool read(T* out) {
+        return read(out, sizeof(T));
+    }
+
+    bool atEnd() const { return mOffset == mData.size(); }
+
+private:
+    const std::string& mData;
+    size_t mOffset = 0;
+};
+
+template <typename T>
+void append(std::string* out, const T& value) {
+    out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+void ProgramBinaryCache::load(const std::string& path, const std::string& fingerprint) {
+    ATRACE_CALL();
+    mPath = path;
+    mFingerprint = fingerprint;
+    mEntries.clear();
+    mBinaryCount = 0;
+    mDirty = false;
+    if (mPath.empty()) {
+        return;
+    }
+
+    std::string data;
+    if (!base::ReadFileToString(mPath, &data)) {
+        return;
+    }
+
+    // Layout: magic, version, fingerprint length and bytes, entry count, then
+    // per entry the key, whether it was used, binary format, length and bytes.
+    Reader reader(data);
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t fingerprintLength = 0;
+    if (!reader.read(&magic) || magic != kMagic || !reader.read(&version) ||
+        version != kVersion || !reader.read(&fingerprintLength) ||
+        fingerprintLength != mFingerprint.size()) {
+        ALOGI("Ignoring program binary cache written by another version");
+        return;
+    }
+    std::string storedFingerprint(fingerprintLength, '\0');
+    if (!reader.read(storedFingerprint.data(), fingerprintLength) ||
+        storedFingerprint != mFingerprint) {
+        ALOGI("Ignoring program binary cache written for another driver");
+        return;
+    }
+
+    uint32_t count = 0;
+    if (!reader.read(&count)) {
+        return;
+    }
+    std::unordered_map<uint32_t, Entry> entries;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t key = 0;
+        uint8_t used = 0;
+        uint32_t format = 0;
+        uint32_t length = 0;
+        if (!reader.read(&key) || !reader.read(&used) || !reader.read(&format) ||
+            !reader.read(&length) || length > kMaxBinarySize) {
+            ALOGE("Program binary cache %s is corrupt", mPath.c_str());
+            return;
+        }
+        Entry entry;
+        entry.used = used != 0;
+        entry.binary.format = format;
+        entry.binary.data.resize(length);
+        if (!reader.read(entry.binary.data.data(), length)) {
+            ALOGE("Program binary cache %s is truncated", mPath.c_str());
+            return;
+        }
+        entries[key] = std::move(entry);
+    }
+
+    mEntries = std::move(entries);
+    for (const auto& [key, entry] : mEntries) {
+        if (!entry.binary.data.empty()) {
+            mBinaryCount++;
+        }
+    }
+    ALOGD("Loaded %zu program binaries from %s", mBinaryCount, mPath.c_str());
+}
+
+const ProgramBinaryCache::Binary* ProgramBinaryCache::find(uint32_t key) const {
+    auto it = mEntries.find(key);
+    if (it == mEntries.end() || it->second.binary.data.empty()) {
+        return nullptr;
+    }
+    return &it->second.binary;
+}
+
+void ProgramBinaryCache::store(uint32_t key, Binary&& binary) {
+    if (!isEnabled() || binary.data.empty() || binary.data.size() > kMaxBinarySize) {
+        return;
+    }
+    auto& entry = mEntries[key];
+    if (entry.binary.data.empty()) {
+        mBinaryCount++;
+    }
+    entry.binary = std::move(binary);
+    mDirty = true;
+}
+
+void ProgramBinaryCache::erase(uint32_t key) {
+    auto it = mEntries.find(key);
+    if (it == mEntries.end() || it->second.binary.data.empty()) {
+        return;
+    }
+    it->second.binary = Binary();
+    mBinaryCount--;
+    mDirty = true;
+}
+
+bool ProgramBinaryCache::markUsed(uint32_t key) {
+    if (!isEnabled()) {
+        return false;
+    }
+    auto& entry = mEntries[key];
+    if (entry.used) {
+        return false;
+    }
+    entry.used = true;
+    mDirty = true;
+    return true;
+}
+
+std::vector<uint32_t> ProgramBinaryCache::getUsedKeys() const {
+    std::vector<uint32_t> keys;
+    for (const auto& [key, entry] : mEntries) {
+        if (entry.used) {
+            keys.push_back(key);
+        }
+    }
+    return keys;
+}
+
+void ProgramBinaryCache::saveIfDirty() {
+    if (!isEnabled() || !mDirty) {
+        return;
+    }
+    ATRACE_CALL();
+
+    std::string data;
+    append(&data, kMagic);
+    append(&data, kVersion);
+    append(&data, static_cast<uint32_t>(mFingerprint.size()));
+    data.append(mFingerprint);
+    append(&data, static_cast<uint32_t>(mEntries.size()));
+    for (const auto& [key, entry] : mEntries) {
+        append(&data, key);
+        append(&data, static_cast<uint8_t>(entry.used ? 1 : 0));
+        append(&data, static_cast<uint32_t>(entry.binary.format));
+        append(&data, static_cast<uint32_t>(entry.binary.data.size()));
+        data.append(reinterpret_cast<const char*>(entry.binary.data.data()),
+                    entry.binary.data.size());
+    }
+
+    // Write to a temporary file first so a crash never leaves a partial cache.
+    const std::string tmpPath = mPath + ".tmp";
+    if (!base::WriteStringToFile(data, tmpPath) || rename(tmpPath.c_str(), mPath.c_str()) != 0) {
+        ALOGE("Failed to write program binary cache %s", mPath.c_str());
+        unlink(tmpPath.c_str());
+    }
+    mDirty = false;
+}
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <GLES2/gl2.h>
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+/*
+ * Keeps the linked binaries of the programs in the ProgramCache on disk, so
+ * they don't have to be compiled again on the next boot, and remembers which
+ * keys were actually drawn with so only those are primed.
+ *
+ * The file is tied to the build and the GL driver it was written with, and is
+ * ignored if either changed.
+ */
+class ProgramBinaryCache {
+public:
+    struct Binary {
+        GLenum format = 0;
+        std::vector<uint8_t> data;
+    };
+
+    // Reads the cache at path if it was written for fingerprint. An empty path
+    // disables the cache.
+    void load(const std::string& path, const std::string& fingerprint);
+    bool isEnabled() const { return !mPath.empty(); }
+
+    // Returns the binary stored for key, or nullptr.
+    const Binary* find(uint32_t key) const;
+    void store(uint32_t key, Binary&& binary);
+    // Drops a binary the driver rejected.
+    void erase(uint32_t key);
+
+    // Records that key was drawn with, returning true if it was not known to
+    // be used before. This is called for every draw, so it returns quickly
+    // once the key is known.
+    bool markUsed(uint32_t key);
+    std::vector<uint32_t> getUsedKeys() const;
+
+    // Writes the cache back if anything changed since it was loaded.
+    void saveIfDirty();
+
+    size_t getBinaryCount() const { return mBinaryCount; }
+
+private:
+    struct Entry {
+        Binary binary;
+        bool used = false;
+    };
+
+    std::string mPath;
+    std::string mFingerprint;
+    std::unordered_map<uint32_t, Entry> mEntries;
+    size_t mBinaryCount = 0;
+    bool mDirty = false;
+};
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
@@ -20,10 +20,13 @@
 
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <cutils/properties.h>
 #include <log/log.h>
+#include <renderengine/RenderEngine.h>
 #include <renderengine/private/Description.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
+#include "GLExtensions.h"
 #include "Program.h"
 
 ANDROID_SINGLETON_STATIC_INSTANCE(android::renderengine::gl::ProgramCache)
@@ -79,9 +82,29 @@ Formatter& dedent(Formatter& f) {
 
 void ProgramCache::primeCache(
         EGLContext context, bool useColorManagement, bool toneMapperShaderOnly) {
+    initBinaryCache();
     auto& cache = mCaches[context];
     uint32_t shaderCount = 0;
 
+    // Once we know which programs are drawn with on this device, prime just
+    // those. They are usually loaded from their binaries, so this is quick.
+    if (const std::vector<uint32_t> usedKeys = mBinaryCache.getUsedKeys(); !usedKeys.empty()) {
+        nsecs_t timeBefore = systemTime();
+        for (uint32_t keyVal : usedKeys) {
+            Key shaderKey;
+            shaderKey.mKey = keyVal;
+            if (cache.count(shaderKey) == 0) {
+                cache.emplace(shaderKey, createProgram(shaderKey));
+                shaderCount++;
+            }
+        }
+        mBinaryCache.saveIfDirty();
+        nsecs_t timeAfter = systemTime();
+        float primeTimeMs = static_cast<float>(timeAfter - timeBefore) / 1.0E6;
+        ALOGD("shader cache primed from usage - %u shaders in %f ms\n", shaderCount, primeTimeMs);
+        return;
+    }
+
     if (toneMapperShaderOnly) {
         Key shaderKey;
         // base settings used by HDR->SDR tonemap only
@@ -102,10 +125,11 @@ void ProgramCache::primeCache(
             shaderKey.set(Key::Y410_BT2020_MASK, (i & 2) ?
                     Key::Y410_BT2020_ON : Key::Y410_BT2020_OFF);
             if (cache.count(shaderKey) == 0) {
-                cache.emplace(shaderKey, generateProgram(shaderKey));
+                cache.emplace(shaderKey, createProgram(shaderKey));
                 shaderCount++;
             }
         }
+        mBinaryCache.saveIfDirty();
         return;
     }
 
@@ -123,7 +147,7 @@ void ProgramCache::primeCache(
             continue;
         }
         if (cache.count(shaderKey) == 0) {
-            cache.emplace(shaderKey, generateProgram(shaderKey));
+            cache.emplace(shaderKey, createProgram(shaderKey));
             shaderCount++;
         }
     }
@@ -147,12 +171,14 @@ void ProgramCache::primeCache(
             // Cache texture off option for window transition
             shaderKey.set(Key::TEXTURE_MASK, (i & 8) ? Key::TEXTURE_EXT : Key::TEXTURE_OFF);
             if (cache.count(shaderKey) == 0) {
-                cache.emplace(shaderKey, generateProgram(shaderKey));
+                cache.emplace(shaderKey, createProgram(shaderKey));
                 shaderCount++;
             }
         }
     }
 
+    mBinaryCache.saveIfDirty();
+
     nsecs_t timeAfter = systemTime();
     float compileTimeMs = static_cast<float>(timeAfter - timeBefore) / 1.0E6;
     ALOGD("shader cache generated - %u shaders in %f ms\n", shaderCount, compileTimeMs);
@@ -770,6 +796,51 @@ std::unique_ptr<Program> ProgramCache::generateProgram(const Key& needs) {
     return std::make_unique<Program>(needs, vs.string(), fs.string());
 }
 
+void ProgramCache::initBinaryCache() {
+    if (mBinaryCacheInitialized) {
+        return;
+    }
+    mBinaryCacheInitialized = true;
+
+    const GLExtensions& extensions = GLExtensions::getInstance();
+    if (!extensions.hasProgramBinary()) {
+        return;
+    }
+
+    char path[PROPERTY_VALUE_MAX];
+    property_get(PROPERTY_DEBUG_RENDERENGINE_PROGRAM_CACHE_PATH, path,
+                 "/data/misc/gpu/renderengine_program_cache");
+    char buildFingerprint[PROPERTY_VALUE_MAX];
+    property_get("ro.build.fingerprint", buildFingerprint, "");
+
+    // Binaries are only valid for the driver that produced them.
+    std::string fingerprint = buildFingerprint;
+    fingerprint.append("|").append(extensions.getVendor());
+    fingerprint.append("|").append(extensions.getRenderer());
+    fingerprint.append("|").append(extensions.getVersion());
+    mBinaryCache.load(path, fingerprint);
+}
+
+std::unique_ptr<Program> ProgramCache::createProgram(const Key& needs) {
+    if (const ProgramBinaryCache::Binary* binary = mBinaryCache.find(needs.mKey)) {
+        auto program = std::make_unique<Program>(needs, binary->format, binary->data.data(),
+                                                 static_cast<GLsizei>(binary->data.size()));
+        if (program->isValid()) {
+            return program;
+        }
+        mBinaryCache.erase(needs.mKey);
+    }
+
+    std::unique_ptr<Program> program = generateProgram(needs);
+    if (mBinaryCache.isEnabled()) {
+        ProgramBinaryCache::Binary binary;
+        if (program->getBinary(&binary.format, &binary.data)) {
+            mBinaryCache.store(needs.mKey, std::move(binary));
+        }
+    }
+    return program;
+}
+
 void ProgramCache::useProgram(EGLContext context, const Description& description) {
     // generate the key for the shader based on the description
     Key needs(computeKey(description));
@@ -779,14 +850,21 @@ void ProgramCache::useProgram(EGLContext context, const Description& description
     auto it = cache.find(needs);
     if (it == cache.end()) {
         // we didn't find our program, so generate one...
+        initBinaryCache();
         nsecs_t time = systemTime();
-        it = cache.emplace(needs, generateProgram(needs)).first;
+        it = cache.emplace(needs, createProgram(needs)).first;
         time = systemTime() - time;
 
         ALOGV(">>> generated new program for context %p: needs=%08X, time=%u ms (%zu programs)",
               context, needs.mKey, uint32_t(ns2ms(time)), cache.size());
     }
 
+    // Remember the keys actually drawn with, so the next boot primes only
+    // those. This only writes to disk the first time a key is seen.
+    if (mBinaryCache.markUsed(needs.mKey)) {
+        mBinaryCache.saveIfDirty();
+    }
+
     // here we have a suitable program for this description
     std::unique_ptr<Program>& program = it->second;
     if (program->isValid()) {
@@ -24,6 +24,7 @@
 #include <GLES2/gl2.h>
 #include <renderengine/private/Description.h>
 #include <utils/Singleton.h>
+#include "ProgramBinaryCache.h"
 #include <utils/TypeHelpers.h>
 
 namespace android {
@@ -189,6 +190,7 @@ public:
     void primeCache(const EGLContext context, bool useColorManagement, bool toneMapperShaderOnly);
 
     size_t getSize(const EGLContext context) { return mCaches[context].size(); }
+    size_t getBinaryCount() const { return mBinaryCache.getBinaryCount(); }
 
     // useProgram lookup a suitable program in the cache or generates one
     // if none can be found.
@@ -207,6 +209,11 @@ private:
     static void generateOETF(Formatter& fs, const Key& needs);
     // generates a program from the Key
     static std::unique_ptr<Program> generateProgram(const Key& needs);
+    // loads the on-disk program binaries the first time they are needed
+    void initBinaryCache();
+    // creates a program from its stored binary if there is one, or else
+    // generates it and stores its binary
+    std::unique_ptr<Program> createProgram(const Key& needs);
     // generates the vertex shader from the Key
     static String8 generateVertexShader(const Key& needs);
     // generates the fragment shader from the Key
@@ -216,6 +223,9 @@ private:
     // is never shrunk (and the GL program objects are never deleted).
     std::unordered_map<EGLContext, std::unordered_map<Key, std::unique_ptr<Program>, Key::Hash>>
             mCaches;
+
+    ProgramBinaryCache mBinaryCache;
+    bool mBinaryCacheInitialized = false;
 };
 
 } // namespace gl
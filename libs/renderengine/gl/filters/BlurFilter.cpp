@@ -78,27 +78,16 @@ status_t BlurFilter::setAsDrawTarget(const DisplaySettings& display, uint32_t ra
         mDisplayWidth = display.physicalDisplay.width();
         mDisplayHeight = display.physicalDisplay.height();
         mCompositionFbo.allocateBuffers(mDisplayWidth, mDisplayHeight);
+        // Whatever was blurred before is gone.
+        clearBackground();
 
-        const uint32_t fboWidth = floorf(mDisplayWidth * kFboScale);
-        const uint32_t fboHeight = floorf(mDisplayHeight * kFboScale);
-        mPingFbo.allocateBuffers(fboWidth, fboHeight);
-        mPongFbo.allocateBuffers(fboWidth, fboHeight);
-
-        if (mPingFbo.getStatus() != GL_FRAMEBUFFER_COMPLETE) {
-            ALOGE("Invalid ping buffer");
-            return mPingFbo.getStatus();
-        }
-        if (mPongFbo.getStatus() != GL_FRAMEBUFFER_COMPLETE) {
-            ALOGE("Invalid pong buffer");
-            return mPongFbo.getStatus();
-        }
         if (mCompositionFbo.getStatus() != GL_FRAMEBUFFER_COMPLETE) {
             ALOGE("Invalid composition buffer");
             return mCompositionFbo.getStatus();
         }
-        if (!mBlurProgram.isValid()) {
-            ALOGE("Invalid shader");
-            return GL_INVALID_OPERATION;
+        if (status_t status = allocateBlurBuffers(mDisplayWidth, mDisplayHeight);
+            status != NO_ERROR) {
+            return status;
         }
     }
 
@@ -107,6 +96,61 @@ status_t BlurFilter::setAsDrawTarget(const DisplaySettings& display, uint32_t ra
     return NO_ERROR;
 }
 
+status_t BlurFilter::allocateBlurBuffers(uint32_t width, uint32_t height) {
+    const uint32_t fboWidth = floorf(width * kFboScale);
+    const uint32_t fboHeight = floorf(height * kFboScale);
+    mPingFbo.allocateBuffers(fboWidth, fboHeight);
+    mPongFbo.allocateBuffers(fboWidth, fboHeight);
+
+    if (mPingFbo.getStatus() != GL_FRAMEBUFFER_COMPLETE) {
+        ALOGE("Invalid ping buffer");
+        return mPingFbo.getStatus();
+    }
+    if (mPongFbo.getStatus() != GL_FRAMEBUFFER_COMPLETE) {
+        ALOGE("Invalid pong buffer");
+        return mPongFbo.getStatus();
+    }
+    if (!mBlurProgram.isValid()) {
+        ALOGE("Invalid shader");
+        return GL_INVALID_OPERATION;
+    }
+    return NO_ERROR;
+}
+
+bool BlurFilter::isBackgroundUnchanged(const DisplaySettings& display,
+                                       const std::vector<const LayerSettings*>& background,
+                                       uint32_t radius) const {
+    if (!mHasBackground || radius != mBackgroundRadius || !(display == mBackgroundDisplay) ||
+        background.size() != mBackgroundLayers.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < background.size(); i++) {
+        if (!(*background[i] == mBackgroundLayers[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BlurFilter::setBackground(const DisplaySettings& display,
+                               const std::vector<const LayerSettings*>& background,
+                               uint32_t radius) {
+    mHasBackground = true;
+    mBackgroundDisplay = display;
+    mBackgroundRadius = radius;
+    mBackgroundLayers.clear();
+    mBackgroundLayers.reserve(background.size());
+    for (const auto* layer : background) {
+        mBackgroundLayers.push_back(*layer);
+    }
+}
+
+void BlurFilter::clearBackground() {
+    mHasBackground = false;
+    // Don't keep the buffers of the background alive.
+    mBackgroundLayers.clear();
+}
+
 void BlurFilter::drawMesh(GLuint uv, GLuint position) {
 
     glEnableVertexAttribArray(uv);
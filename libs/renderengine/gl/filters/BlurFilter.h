@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <renderengine/DisplaySettings.h>
+#include <renderengine/LayerSettings.h>
 #include <ui/GraphicTypes.h>
+#include <vector>
 #include "../GLESRenderEngine.h"
 #include "../GLFramebuffer.h"
 #include "../GLVertexBuffer.h"
@@ -49,20 +52,39 @@ public:
     // Set up render targets, redirecting output to offscreen texture.
     status_t setAsDrawTarget(const DisplaySettings&, uint32_t radius);
     // Execute blur passes, rendering to offscreen texture.
-    status_t prepare();
+    virtual status_t prepare();
     // Render blur to the bound framebuffer (screen).
     status_t render(bool multiPass);
 
-private:
-    uint32_t mRadius;
+    // Whether the layers below the blur, and how they are blurred, are the
+    // same as when the last blur was prepared. If so its result can be
+    // rendered again without drawing the background or running the passes.
+    bool isBackgroundUnchanged(const DisplaySettings&,
+                               const std::vector<const LayerSettings*>& background,
+                               uint32_t radius) const;
+    // Remembers what the blur that was just prepared was computed from.
+    void setBackground(const DisplaySettings&, const std::vector<const LayerSettings*>& background,
+                       uint32_t radius);
+    void clearBackground();
+
+protected:
+    // Allocates the buffers the blur passes render to, given the size of the
+    // composited background.
+    virtual status_t allocateBlurBuffers(uint32_t width, uint32_t height);
     void drawMesh(GLuint uv, GLuint position);
     string getVertexShader() const;
-    string getFragmentShader() const;
-    string getMixFragShader() const;
 
+    uint32_t mRadius;
     GLESRenderEngine& mEngine;
     // Frame buffer holding the composited background.
     GLFramebuffer mCompositionFbo;
+    // Buffer holding the final blur pass.
+    GLFramebuffer* mLastDrawTarget;
+
+private:
+    string getFragmentShader() const;
+    string getMixFragShader() const;
+
     // Frame buffers holding the blur passes.
     GLFramebuffer mPingFbo;
     GLFramebuffer mPongFbo;
@@ -70,8 +92,6 @@ private:
     uint32_t mDisplayHeight = 0;
     uint32_t mDisplayX = 0;
     uint32_t mDisplayY = 0;
-    // Buffer holding the final blur pass.
-    GLFramebuffer* mLastDrawTarget;
 
     // VBO containing vertex and uv data of a fullscreen triangle.
     GLVertexBuffer mMeshBuffer;
@@ -88,6 +108,12 @@ private:
     GLuint mBUvLoc;
     GLuint mBTextureLoc;
     GLuint mBOffsetLoc;
+
+    // What the last prepared blur was computed from.
+    bool mHasBackground = false;
+    DisplaySettings mBackgroundDisplay;
+    std::vector<LayerSettings> mBackgroundLayers;
+    uint32_t mBackgroundRadius = 0;
 };
 
 } // namespace gl
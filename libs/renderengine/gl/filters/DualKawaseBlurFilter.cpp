@@ -0,0 +1,159 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "DualKawaseBlurFilter.h"
+#include <GLES3/gl3.h>
+#include <GLES3/gl3ext.h>
+#include <algorithm>
+#include <cmath>
+
+#include <utils/Trace.h>
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+DualKawaseBlurFilter::DualKawaseBlurFilter(GLESRenderEngine& engine)
+      : BlurFilter(engine), mDownsampleProgram(engine), mUpsampleProgram(engine) {
+    mDownsampleProgram.compile(getVertexShader(), getDownsampleFragShader());
+    mDPosLoc = mDownsampleProgram.getAttributeLocation("aPosition");
+    mDUvLoc = mDownsampleProgram.getAttributeLocation("aUV");
+    mDTextureLoc = mDownsampleProgram.getUniformLocation("uTexture");
+    mDOffsetLoc = mDownsampleProgram.getUniformLocation("uOffset");
+
+    mUpsampleProgram.compile(getVertexShader(), getUpsampleFragShader());
+    mUPosLoc = mUpsampleProgram.getAttributeLocation("aPosition");
+    mUUvLoc = mUpsampleProgram.getAttributeLocation("aUV");
+    mUTextureLoc = mUpsampleProgram.getUniformLocation("uTexture");
+    mUOffsetLoc = mUpsampleProgram.getUniformLocation("uOffset");
+}
+
+status_t DualKawaseBlurFilter::allocateBlurBuffers(uint32_t width, uint32_t height) {
+    mLevels.clear();
+    for (uint32_t i = 0; i < kMaxLevels; i++) {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+        auto level = std::make_unique<GLFramebuffer>(mEngine);
+        level->allocateBuffers(width, height);
+        if (level->getStatus() != GL_FRAMEBUFFER_COMPLETE) {
+            ALOGE("Invalid blur buffer for level %u", i);
+            return level->getStatus();
+        }
+        mLevels.push_back(std::move(level));
+    }
+
+    if (!mDownsampleProgram.isValid() || !mUpsampleProgram.isValid()) {
+        ALOGE("Invalid shader");
+        return GL_INVALID_OPERATION;
+    }
+    return NO_ERROR;
+}
+
+void DualKawaseBlurFilter::drawPass(const GenericProgram& program, GLuint textureLoc,
+                                    GLuint offsetLoc, GLuint uvLoc, GLuint posLoc,
+                                    const GLFramebuffer& read, GLFramebuffer& draw, float offset) {
+    ATRACE_NAME("DualKawaseBlurFilter::renderPass");
+    program.useProgram();
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(textureLoc, 0);
+    glBindTexture(GL_TEXTURE_2D, read.getTextureName());
+    // Half a texel of the buffer being read, scaled by the offset.
+    glUniform2f(offsetLoc, offset * 0.5f / read.getBufferWidth(),
+                offset * 0.5f / read.getBufferHeight());
+    glViewport(0, 0, draw.getBufferWidth(), draw.getBufferHeight());
+    draw.bind();
+    drawMesh(uvLoc, posLoc);
+}
+
+status_t DualKawaseBlurFilter::prepare() {
+    ATRACE_NAME("DualKawaseBlurFilter::prepare");
+
+    // Every level roughly doubles the radius covered by a unit offset. Pick
+    // the fewest levels that keep the offset small enough not to leave
+    // sampling gaps, and let the offset take up the rest of the radius so
+    // that it still grows smoothly between levels.
+    const float radius = std::max(mRadius / 2.0f, 1.0f);
+    const uint32_t levels =
+            std::clamp(static_cast<uint32_t>(std::ceil(std::log2(radius))), 1u, kMaxLevels);
+    const float offset = radius / static_cast<float>(1u << levels);
+
+    drawPass(mDownsampleProgram, mDTextureLoc, mDOffsetLoc, mDUvLoc, mDPosLoc, mCompositionFbo,
+             *mLevels[0], offset);
+    for (uint32_t i = 1; i < levels; i++) {
+        drawPass(mDownsampleProgram, mDTextureLoc, mDOffsetLoc, mDUvLoc, mDPosLoc,
+                 *mLevels[i - 1], *mLevels[i], offset);
+    }
+    for (uint32_t i = levels - 1; i > 0; i--) {
+        drawPass(mUpsampleProgram, mUTextureLoc, mUOffsetLoc, mUUvLoc, mUPosLoc, *mLevels[i],
+                 *mLevels[i - 1], offset);
+    }
+    mLastDrawTarget = mLevels[0].get();
+
+    glUseProgram(0);
+    mEngine.checkErrors("Preparing dual Kawase blur");
+    return NO_ERROR;
+}
+
+string DualKawaseBlurFilter::getDownsampleFragShader() const {
+    return R"SHADER(#version 310 es
+        precision mediump float;
+
+        uniform sampler2D uTexture;
+        uniform vec2 uOffset;
+
+        in highp vec2 vUV;
+        out vec4 fragColor;
+
+        void main() {
+            vec4 sum = texture(uTexture, vUV) * 4.0;
+            sum += texture(uTexture, vUV - uOffset);
+            sum += texture(uTexture, vUV + uOffset);
+            sum += texture(uTexture, vUV + vec2(uOffset.x, -uOffset.y));
+            sum += texture(uTexture, vUV - vec2(uOffset.x, -uOffset.y));
+            fragColor = vec4(sum.rgb * 0.125, 1.0);
+        }
+    )SHADER";
+}
+
+string DualKawaseBlurFilter::getUpsampleFragShader() const {
+    return R"SHADER(#version 310 es
+        precision mediump float;
+
+        uniform sampler2D uTexture;
+        uniform vec2 uOffset;
+
+        in highp vec2 vUV;
+        out vec4 fragColor;
+
+        void main() {
+            vec4 sum = texture(uTexture, vUV + vec2(-uOffset.x * 2.0, 0.0));
+            sum += texture(uTexture, vUV + vec2(-uOffset.x, uOffset.y)) * 2.0;
+            sum += texture(uTexture, vUV + vec2(0.0, uOffset.y * 2.0));
+            sum += texture(uTexture, vUV + vec2(uOffset.x, uOffset.y)) * 2.0;
+            sum += texture(uTexture, vUV + vec2(uOffset.x * 2.0, 0.0));
+            sum += texture(uTexture, vUV + vec2(uOffset.x, -uOffset.y)) * 2.0;
+            sum += texture(uTexture, vUV + vec2(0.0, -uOffset.y * 2.0));
+            sum += texture(uTexture, vUV + vec2(-uOffset.x, -uOffset.y)) * 2.0;
+            fragColor = vec4(sum.rgb / 12.0, 1.0);
+        }
+    )SHADER";
+}
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "BlurFilter.h"
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+/**
+ * The dual filter variant of the Kawase blur, from the same notes as
+ * BlurFilter. Each pass halves the size of the image on the way down and
+ * doubles it on the way back up, so large radii cost a few passes over ever
+ * smaller buffers instead of several passes at a fixed scale.
+ */
+class DualKawaseBlurFilter : public BlurFilter {
+public:
+    // Maximum number of times the background is halved.
+    static constexpr uint32_t kMaxLevels = 5;
+
+    explicit DualKawaseBlurFilter(GLESRenderEngine& engine);
+
+    status_t prepare() override;
+
+protected:
+    status_t allocateBlurBuffers(uint32_t width, uint32_t height) override;
+
+private:
+    string getDownsampleFragShader() const;
+    string getUpsampleFragShader() const;
+    void drawPass(const GenericProgram& program, GLuint textureLoc, GLuint offsetLoc,
+                  GLuint uvLoc, GLuint posLoc, const GLFramebuffer& read, GLFramebuffer& draw,
+                  float offset);
+
+    // mLevels[i] is (1 / 2^(i + 1)) the size of the background.
+    std::vector<std::unique_ptr<GLFramebuffer>> mLevels;
+
+    GenericProgram mDownsampleProgram;
+    GLuint mDPosLoc;
+    GLuint mDUvLoc;
+    GLuint mDTextureLoc;
+    GLuint mDOffsetLoc;
+
+    GenericProgram mUpsampleProgram;
+    GLuint mUPosLoc;
+    GLuint mUUvLoc;
+    GLuint mUTextureLoc;
+    GLuint mUOffsetLoc;
+};
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
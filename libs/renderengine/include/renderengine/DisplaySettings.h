@@ -60,6 +60,13 @@ struct DisplaySettings {
     // capture of a device in landscape while the buffer is in portrait
     // orientation.
     uint32_t orientation = ui::Transform::ROT_0;
+
+    // If valid, only this part of the output buffer, in physical display
+    // space, is redrawn and the rest of its contents are kept. The caller is
+    // responsible for the rest of the buffer already holding the right
+    // contents. It is not part of the equality below, since it doesn't change
+    // what the buffer holds once drawn.
+    Rect damageRect = Rect::INVALID_RECT;
 };
 
 static inline bool operator==(const DisplaySettings& lhs, const DisplaySettings& rhs) {
@@ -83,6 +90,8 @@ static inline void PrintTo(const DisplaySettings& settings, ::std::ostream* os)
     *os << "\n    .clearRegion = ";
     PrintTo(settings.clearRegion, os);
     *os << "\n    .orientation = " << settings.orientation;
+    *os << "\n    .damageRect = ";
+    PrintTo(settings.damageRect, os);
     *os << "\n}";
 }
 
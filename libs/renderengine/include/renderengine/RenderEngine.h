@@ -31,10 +31,24 @@
 #include <ui/Transform.h>
 
 /**
- * Allows to set RenderEngine backend to GLES (default) or Vulkan (NOT yet supported).
+ * Allows to set RenderEngine backend to GLES (default), GLES on a dedicated
+ * thread ("threaded") or Vulkan (NOT yet supported).
  */
 #define PROPERTY_DEBUG_RENDERENGINE_BACKEND "debug.renderengine.backend"
 
+/**
+ * Where the GLES backend keeps linked program binaries across boots. Set to an
+ * empty string to always compile programs from source.
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_PROGRAM_CACHE_PATH "debug.renderengine.program_cache_path"
+
+/**
+ * Which background blur the GLES backend uses: "kawase" (default), or
+ * "dual_kawase" for devices where the downsampling passes of the dual filter
+ * are cheaper at large radii.
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_BLUR_ALGORITHM "debug.renderengine.blur_algorithm"
+
 struct ANativeWindowBuffer;
 
 namespace android {
@@ -54,6 +68,10 @@ namespace impl {
 class RenderEngine;
 }
 
+namespace threaded {
+class RenderEngineThreaded;
+}
+
 enum class Protection {
     UNPROTECTED = 1,
     PROTECTED = 2,
@@ -143,6 +161,11 @@ public:
     virtual bool supportsProtectedContent() const = 0;
     virtual bool useProtectedContext(bool useProtectedContext) = 0;
 
+    // Whether drawLayers may be called from threads other than the one that
+    // created this RenderEngine, with calls from different threads serialized
+    // by the implementation.
+    virtual bool canDrawFromAnyThread() const = 0;
+
     // Renders layers for a particular display via GPU composition. This method
     // should be called for every display that needs to be rendered via the GPU.
     // @param display The display-wide settings that should be applied prior to
@@ -185,6 +208,7 @@ protected:
     // live longer than RenderEngine.
     virtual Framebuffer* getFramebufferForDrawing() = 0;
     friend class BindNativeBufferAsFramebuffer;
+    friend class threaded::RenderEngineThreaded;
 };
 
 struct RenderEngineCreationArgs {
@@ -1339,6 +1339,36 @@ TEST_F(RenderEngineTest, drawLayers_fillShadow_casterColorLayer) {
     expectShadowColor(castingLayer, settings, casterColor, backgroundColor);
 }
 
+TEST_F(RenderEngineTest, drawLayers_fillShadow_redrawnAfterOtherCaster) {
+    const ubyte4 casterColor(255, 0, 0, 255);
+    const ubyte4 backgroundColor(255, 255, 255, 255);
+    const float shadowLength = 5.0f;
+    Rect casterBounds(DEFAULT_DISPLAY_WIDTH / 3.0f, DEFAULT_DISPLAY_HEIGHT / 3.0f);
+    casterBounds.offsetBy(shadowLength + 1, shadowLength + 1);
+    renderengine::LayerSettings castingLayer;
+    castingLayer.geometry.boundaries = casterBounds.toFloatRect();
+    castingLayer.alpha = 1.0f;
+    renderengine::ShadowSettings settings =
+            getShadowSettings(vec2(casterBounds.left, casterBounds.top), shadowLength,
+                              false /* casterIsTranslucent */);
+
+    Rect otherBounds(casterBounds);
+    otherBounds.offsetBy(DEFAULT_DISPLAY_WIDTH / 3.0f, DEFAULT_DISPLAY_HEIGHT / 3.0f);
+    renderengine::LayerSettings otherLayer;
+    otherLayer.geometry.boundaries = otherBounds.toFloatRect();
+    otherLayer.alpha = 1.0f;
+    renderengine::ShadowSettings otherSettings =
+            getShadowSettings(vec2(otherBounds.left, otherBounds.top), shadowLength,
+                              false /* casterIsTranslucent */);
+
+    // The shadow drawn again must not be mistaken for the one drawn in between.
+    drawShadow<ColorSourceVariant>(castingLayer, settings, casterColor, backgroundColor);
+    drawShadow<ColorSourceVariant>(otherLayer, otherSettings, casterColor, backgroundColor);
+    expectShadowColor(otherLayer, otherSettings, casterColor, backgroundColor);
+    drawShadow<ColorSourceVariant>(castingLayer, settings, casterColor, backgroundColor);
+    expectShadowColor(castingLayer, settings, casterColor, backgroundColor);
+}
+
 TEST_F(RenderEngineTest, drawLayers_fillShadow_casterOpaqueBufferLayer) {
     const ubyte4 casterColor(255, 0, 0, 255);
     const ubyte4 backgroundColor(255, 255, 255, 255);
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "RenderEngineThreaded.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <future>
+
+#include <android-base/stringprintf.h>
+#include <log/log.h>
+#include <utils/Trace.h>
+
+namespace android {
+namespace renderengine {
+namespace threaded {
+
+std::unique_ptr<RenderEngineThreaded> RenderEngineThreaded::create(
+        CreateInstanceFactory factory, const RenderEngineCreationArgs& args) {
+    return std::make_unique<RenderEngineThreaded>(std::move(factory), args);
+}
+
+RenderEngineThreaded::RenderEngineThreaded(CreateInstanceFactory factory,
+                                           const RenderEngineCreationArgs& args)
+      : impl::RenderEngine(args) {
+    ATRACE_CALL();
+
+    std::lock_guard lockThread(mThreadMutex);
+    mThread = std::thread(&RenderEngineThreaded::threadMain, this, std::move(factory));
+}
+
+RenderEngineThreaded::~RenderEngineThreaded() {
+    {
+        std::lock_guard lock(mThreadMutex);
+        mRunning = false;
+    }
+    mCondition.notify_one();
+
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+// NO_THREAD_SAFETY_ANALYSIS is because std::unique_lock presently lacks thread safety annotations.
+void RenderEngineThreaded::threadMain(CreateInstanceFactory factory) NO_THREAD_SAFETY_ANALYSIS {
+    ATRACE_CALL();
+
+    // Composition is on the critical path of every frame, so this thread runs
+    // at the same priority as the SurfaceFlinger main thread.
+    struct sched_param param = {0};
+    param.sched_priority = 2;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+        ALOGE("Couldn't set SCHED_FIFO");
+    }
+    pthread_setname_np(pthread_self(), mThreadName);
+
+    // The backend makes its context current on the thread that creates it.
+    mRenderEngine = factory();
+
+    std::unique_lock<std::mutex> lock(mThreadMutex);
+    while (mRunning || !mFunctionCalls.empty()) {
+        if (!mFunctionCalls.empty()) {
+            auto task = std::move(mFunctionCalls.front());
+            mFunctionCalls.pop();
+            lock.unlock();
+            task(*mRenderEngine);
+            lock.lock();
+        }
+        mCondition.wait(lock, [this]() REQUIRES(mThreadMutex) {
+            return !mRunning || !mFunctionCalls.empty();
+        });
+    }
+
+    // Destroy the backend on the thread its context is current on.
+    lock.unlock();
+    mRenderEngine.reset();
+}
+
+void RenderEngineThreaded::queueWork(Work work) const {
+    {
+        std::lock_guard lock(mThreadMutex);
+        mFunctionCalls.push(std::move(work));
+    }
+    mCondition.notify_one();
+}
+
+template <typename F>
+auto RenderEngineThreaded::runOnThread(F&& f) const
+        -> decltype(f(std::declval<renderengine::RenderEngine&>())) {
+    using Result = decltype(f(std::declval<renderengine::RenderEngine&>()));
+    std::promise<Result> resultPromise;
+    std::future<Result> resultFuture = resultPromise.get_future();
+    queueWork([&resultPromise, &f](renderengine::RenderEngine& instance) {
+        if constexpr (std::is_void_v<Result>) {
+            f(instance);
+            resultPromise.set_value();
+        } else {
+            resultPromise.set_value(f(instance));
+        }
+    });
+    return resultFuture.get();
+}
+
+void RenderEngineThreaded::primeCache() const {
+    runOnThread([](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::primeCache");
+        instance.primeCache();
+    });
+}
+
+void RenderEngineThreaded::dump(std::string& result) {
+    result += runOnThread([](renderengine::RenderEngine& instance) {
+        std::string output;
+        instance.dump(output);
+        return output;
+    });
+    base::StringAppendF(&result, "RenderEngine is running on the \"%s\" thread\n", mThreadName);
+}
+
+bool RenderEngineThreaded::useNativeFenceSync() const {
+    return runOnThread([](renderengine::RenderEngine& instance) {
+        return instance.useNativeFenceSync();
+    });
+}
+
+bool RenderEngineThreaded::useWaitSync() const {
+    return runOnThread(
+            [](renderengine::RenderEngine& instance) { return instance.useWaitSync(); });
+}
+
+void RenderEngineThreaded::genTextures(size_t count, uint32_t* names) {
+    runOnThread([count, names](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::genTextures");
+        instance.genTextures(count, names);
+    });
+}
+
+void RenderEngineThreaded::deleteTextures(size_t count, uint32_t const* names) {
+    runOnThread([count, names](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::deleteTextures");
+        instance.deleteTextures(count, names);
+    });
+}
+
+void RenderEngineThreaded::bindExternalTextureImage(uint32_t texName, const Image& image) {
+    runOnThread([texName, &image](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::bindExternalTextureImage");
+        instance.bindExternalTextureImage(texName, image);
+    });
+}
+
+status_t RenderEngineThreaded::bindExternalTextureBuffer(uint32_t texName,
+                                                         const sp<GraphicBuffer>& buffer,
+                                                         const sp<Fence>& fence) {
+    return runOnThread([texName, &buffer, &fence](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::bindExternalTextureBuffer");
+        return instance.bindExternalTextureBuffer(texName, buffer, fence);
+    });
+}
+
+void RenderEngineThreaded::cacheExternalTextureBuffer(const sp<GraphicBuffer>& buffer) {
+    // This is already asynchronous in the backend, so don't wait for it here.
+    // Queueing keeps it ordered with the other calls made on this thread.
+    queueWork([buffer](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::cacheExternalTextureBuffer");
+        instance.cacheExternalTextureBuffer(buffer);
+    });
+}
+
+void RenderEngineThreaded::unbindExternalTextureBuffer(uint64_t bufferId) {
+    queueWork([bufferId](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::unbindExternalTextureBuffer");
+        instance.unbindExternalTextureBuffer(bufferId);
+    });
+}
+
+status_t RenderEngineThreaded::bindFrameBuffer(Framebuffer* framebuffer) {
+    return runOnThread([framebuffer](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::bindFrameBuffer");
+        return instance.bindFrameBuffer(framebuffer);
+    });
+}
+
+void RenderEngineThreaded::unbindFrameBuffer(Framebuffer* framebuffer) {
+    runOnThread([framebuffer](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::unbindFrameBuffer");
+        instance.unbindFrameBuffer(framebuffer);
+    });
+}
+
+size_t RenderEngineThreaded::getMaxTextureSize() const {
+    return runOnThread(
+            [](renderengine::RenderEngine& instance) { return instance.getMaxTextureSize(); });
+}
+
+size_t RenderEngineThreaded::getMaxViewportDims() const {
+    return runOnThread(
+            [](renderengine::RenderEngine& instance) { return instance.getMaxViewportDims(); });
+}
+
+bool RenderEngineThreaded::isProtected() const {
+    return runOnThread(
+            [](renderengine::RenderEngine& instance) { return instance.isProtected(); });
+}
+
+bool RenderEngineThreaded::supportsProtectedContent() const {
+    return runOnThread([](renderengine::RenderEngine& instance) {
+        return instance.supportsProtectedContent();
+    });
+}
+
+bool RenderEngineThreaded::useProtectedContext(bool useProtectedContext) {
+    return runOnThread([useProtectedContext](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::useProtectedContext");
+        return instance.useProtectedContext(useProtectedContext);
+    });
+}
+
+Framebuffer* RenderEngineThreaded::getFramebufferForDrawing() {
+    return runOnThread([](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::getFramebufferForDrawing");
+        return instance.getFramebufferForDrawing();
+    });
+}
+
+bool RenderEngineThreaded::cleanupPostRender(CleanupMode mode) {
+    return runOnThread([mode](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::cleanupPostRender");
+        return instance.cleanupPostRender(mode);
+    });
+}
+
+status_t RenderEngineThreaded::drawLayers(const DisplaySettings& display,
+                                          const std::vector<const LayerSettings*>& layers,
+                                          ANativeWindowBuffer* buffer,
+                                          const bool useFramebufferCache,
+                                          base::unique_fd&& bufferFence,
+                                          base::unique_fd* drawFence) {
+    ATRACE_CALL();
+    // Only the GL commands are submitted on the render thread; the GPU work
+    // itself completes asynchronously and is signalled through drawFence.
+    return runOnThread([&](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::drawLayers");
+        return instance.drawLayers(display, layers, buffer, useFramebufferCache,
+                                   std::move(bufferFence), drawFence);
+    });
+}
+
+} // namespace threaded
+} // namespace renderengine
+} // namespace android
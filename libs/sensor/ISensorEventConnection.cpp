@@ -27,6 +27,7 @@
 #include <binder/IInterface.h>
 
 #include <sensor/BitTube.h>
+#include <sensor/SensorEventRing.h>
 
 namespace android {
 // ----------------------------------------------------------------------------
@@ -38,6 +39,7 @@ enum {
     FLUSH_SENSOR,
     CONFIGURE_CHANNEL,
     DESTROY,
+    ENABLE_EVENT_RING,
 };
 
 class BpSensorEventConnection : public BpInterface<ISensorEventConnection>
@@ -98,6 +100,16 @@ public:
         return reply.readInt32();
     }
 
+    virtual sp<SensorEventRing> enableEventRing() {
+        Parcel data, reply;
+        data.writeInterfaceToken(ISensorEventConnection::getInterfaceDescriptor());
+        status_t result = remote()->transact(ENABLE_EVENT_RING, data, &reply);
+        if (result != NO_ERROR || reply.readInt32() != NO_ERROR) {
+            return nullptr;
+        }
+        return SensorEventRing::readFromParcel(reply);
+    }
+
     virtual void onLastStrongRef(const void* id) {
         destroy();
         BpInterface<ISensorEventConnection>::onLastStrongRef(id);
@@ -166,6 +178,16 @@ status_t BnSensorEventConnection::onTransact(
             destroy();
             return NO_ERROR;
         }
+        case ENABLE_EVENT_RING: {
+            CHECK_INTERFACE(ISensorEventConnection, data, reply);
+            sp<SensorEventRing> ring(enableEventRing());
+            if (ring == nullptr) {
+                reply->writeInt32(INVALID_OPERATION);
+                return NO_ERROR;
+            }
+            reply->writeInt32(NO_ERROR);
+            return ring->writeToParcel(reply);
+        }
 
     }
     return BBinder::onTransact(code, data, reply, flags);
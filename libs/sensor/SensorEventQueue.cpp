@@ -27,6 +27,7 @@
 #include <sensor/Sensor.h>
 #include <sensor/BitTube.h>
 #include <sensor/ISensorEventConnection.h>
+#include <sensor/SensorEventRing.h>
 
 #include <android/sensor.h>
 #include <hardware/sensors-base.h>
@@ -64,6 +65,9 @@ ssize_t SensorEventQueue::write(const sp<BitTube>& tube,
 }
 
 ssize_t SensorEventQueue::read(ASensorEvent* events, size_t numEvents) {
+    if (mEventRing != nullptr) {
+        return readFromEventRing(events, numEvents);
+    }
     if (mAvailable == 0) {
         ssize_t err = BitTube::recvObjects(mSensorChannel,
                 mRecBuffer, MAX_RECEIVE_BUFFER_EVENT_COUNT);
@@ -80,6 +84,39 @@ ssize_t SensorEventQueue::read(ASensorEvent* events, size_t numEvents) {
     return static_cast<ssize_t>(count);
 }
 
+ssize_t SensorEventQueue::readFromEventRing(ASensorEvent* events, size_t numEvents) {
+    bool writerWasBlocked = false;
+    size_t count = mEventRing->read(events, numEvents, &writerWasBlocked);
+    if (count < numEvents) {
+        // Caught up, so the doorbells received so far are all accounted for. Drop them, then look
+        // again for events whose doorbell was just dropped.
+        ASensorEvent doorbells[8];
+        while (BitTube::recvObjects(mSensorChannel, doorbells, 8) > 0) {
+        }
+        bool blocked = false;
+        count += mEventRing->read(events + count, numEvents - count, &blocked);
+        writerWasBlocked |= blocked;
+    }
+    if (writerWasBlocked) {
+        SensorEventRing::RoomAvailableMessage message = 0;
+        ssize_t size = ::send(mSensorChannel->getFd(), &message, sizeof(message),
+                MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (size < 0) {
+            ALOGE("readFromEventRing: can't signal room in the ring %zd %d", size, errno);
+        }
+    }
+    return static_cast<ssize_t>(count);
+}
+
+status_t SensorEventQueue::enableEventRing() {
+    sp<SensorEventRing> ring = mSensorEventConnection->enableEventRing();
+    if (ring == nullptr) {
+        return INVALID_OPERATION;
+    }
+    mEventRing = ring;
+    return NO_ERROR;
+}
+
 sp<Looper> SensorEventQueue::getLooper() const
 {
     Mutex::Autolock _l(mLock);
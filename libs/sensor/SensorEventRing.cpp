@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Sensors"
+
+#include <sensor/SensorEventRing.h>
+
+#include <algorithm>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cutils/ashmem.h>
+#include <log/log.h>
+
+#include <binder/Parcel.h>
+
+#include <android/sensor.h>
+
+namespace android {
+// ----------------------------------------------------------------------------
+
+// The events start on their own cache line, away from the indices.
+static const size_t HEADER_SIZE = 64;
+
+// Largest ring accepted from a parcel, so that a bogus capacity cannot make us map a huge region.
+static const uint32_t MAX_CAPACITY = 64 * 1024;
+
+sp<SensorEventRing> SensorEventRing::create(size_t capacity) {
+    uint32_t roundedCapacity = 1;
+    while (roundedCapacity < capacity && roundedCapacity < MAX_CAPACITY) {
+        roundedCapacity <<= 1;
+    }
+    const size_t size = getRegionSize(roundedCapacity);
+    int fd = ashmem_create_region("SensorEventRing", size);
+    if (fd < 0) {
+        ALOGE("SensorEventRing: can't create shared memory (%s)", strerror(errno));
+        return nullptr;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        ALOGE("SensorEventRing: can't map shared memory (%s)", strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+    memset(base, 0, HEADER_SIZE);
+    return new SensorEventRing(fd, base, size, roundedCapacity);
+}
+
+sp<SensorEventRing> SensorEventRing::readFromParcel(const Parcel& data) {
+    const uint32_t capacity = data.readUint32();
+    if (capacity == 0 || capacity > MAX_CAPACITY || (capacity & (capacity - 1)) != 0) {
+        ALOGE("SensorEventRing(Parcel): invalid capacity %" PRIu32, capacity);
+        return nullptr;
+    }
+    const size_t size = getRegionSize(capacity);
+    int fd = dup(data.readFileDescriptor());
+    if (fd < 0) {
+        ALOGE("SensorEventRing(Parcel): can't dup file descriptor (%s)", strerror(errno));
+        return nullptr;
+    }
+    const int regionSize = ashmem_get_size_region(fd);
+    if (regionSize < 0 || static_cast<size_t>(regionSize) < size) {
+        ALOGE("SensorEventRing(Parcel): region of %d bytes is too small", regionSize);
+        close(fd);
+        return nullptr;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        ALOGE("SensorEventRing(Parcel): can't map shared memory (%s)", strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+    return new SensorEventRing(fd, base, size, capacity);
+}
+
+SensorEventRing::SensorEventRing(int fd, void* base, size_t size, uint32_t capacity)
+    : mFd(fd), mBase(base), mSize(size), mCapacity(capacity),
+      mHeader(reinterpret_cast<Header*>(base)),
+      mWriteIndex(mHeader->writeIndex.load(std::memory_order_relaxed)) {
+    static_assert(sizeof(Header) <= HEADER_SIZE, "SensorEventRing header is too large");
+}
+
+SensorEventRing::~SensorEventRing() {
+    munmap(mBase, mSize);
+    close(mFd);
+}
+
+size_t SensorEventRing::getRegionSize(uint32_t capacity) {
+    return HEADER_SIZE + capacity * sizeof(ASensorEvent);
+}
+
+ASensorEvent* SensorEventRing::getSlots() const {
+    return reinterpret_cast<ASensorEvent*>(reinterpret_cast<uint8_t*>(mBase) + HEADER_SIZE);
+}
+
+status_t SensorEventRing::writeToParcel(Parcel* reply) const {
+    status_t result = reply->writeUint32(mCapacity);
+    if (result != NO_ERROR) {
+        return result;
+    }
+    return reply->writeDupFileDescriptor(mFd);
+}
+
+ssize_t SensorEventRing::write(ASensorEvent const* events, size_t count, bool* outNeedsDoorbell) {
+    *outNeedsDoorbell = false;
+    // Indices only ever grow; as the capacity is a power of two, they can wrap around freely.
+    auto hasRoom = [this, count](uint32_t readIndex) {
+        const uint32_t used = mWriteIndex - readIndex;
+        return used <= mCapacity && mCapacity - used >= count;
+    };
+    if (!hasRoom(mHeader->readIndex.load())) {
+        // Ask the reader to tell us once it has made room, then check again in case it already
+        // did so before seeing the request.
+        mHeader->writerBlocked.store(1);
+        if (!hasRoom(mHeader->readIndex.load())) {
+            return -EAGAIN;
+        }
+    }
+
+    ASensorEvent* slots = getSlots();
+    const uint32_t mask = mCapacity - 1;
+    for (size_t i = 0; i < count; i++) {
+        slots[(mWriteIndex + i) & mask] = events[i];
+    }
+    const uint32_t previousWriteIndex = mWriteIndex;
+    mWriteIndex += count;
+    mHeader->writeIndex.store(mWriteIndex);
+    // The reader only goes back to polling the doorbell after it caught up with the write index,
+    // so the doorbell is only needed when it had read everything written before.
+    *outNeedsDoorbell = mHeader->readIndex.load() == previousWriteIndex;
+    return count;
+}
+
+size_t SensorEventRing::read(ASensorEvent* events, size_t count, bool* outWriterWasBlocked) {
+    const ASensorEvent* slots = getSlots();
+    const uint32_t mask = mCapacity - 1;
+    uint32_t readIndex = mHeader->readIndex.load(std::memory_order_relaxed);
+    size_t numRead = 0;
+    while (numRead < count) {
+        const uint32_t available = mHeader->writeIndex.load() - readIndex;
+        if (available == 0 || available > mCapacity) {
+            // Either up to date or the indices were corrupted, in which case there is nothing
+            // sensible to hand out.
+            break;
+        }
+        const size_t n = std::min(count - numRead, static_cast<size_t>(available));
+        for (size_t i = 0; i < n; i++) {
+            events[numRead + i] = slots[(readIndex + i) & mask];
+        }
+        numRead += n;
+        readIndex += n;
+        // Publishing the read index before checking the write index again makes sure that the
+        // writer either sees the ring drained, and rings the doorbell, or the loop picks up its
+        // events.
+        mHeader->readIndex.store(readIndex);
+    }
+    *outWriterWasBlocked = mHeader->writerBlocked.exchange(0) != 0;
+    return numRead;
+}
+
+// ----------------------------------------------------------------------------
+}; // namespace android
@@ -30,6 +30,7 @@ namespace android {
 
 class BitTube;
 class Parcel;
+class SensorEventRing;
 
 class ISensorEventConnection : public IInterface
 {
@@ -42,6 +43,9 @@ public:
     virtual status_t setEventRate(int handle, nsecs_t ns) = 0;
     virtual status_t flush() = 0;
     virtual int32_t configureChannel(int32_t handle, int32_t rateLevel) = 0;
+    // Delivers events through a shared memory ring from now on, see SensorEventRing. Only
+    // possible before any sensor is enabled. Returns nullptr if the ring can't be used.
+    virtual sp<SensorEventRing> enableEventRing() = 0;
 protected:
     virtual void destroy() = 0; // synchronously release resource hold by remote object
 };
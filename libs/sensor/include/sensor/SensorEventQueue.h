@@ -43,6 +43,7 @@ namespace android {
 
 class ISensorEventConnection;
 class Sensor;
+class SensorEventRing;
 class Looper;
 
 // ----------------------------------------------------------------------------
@@ -94,6 +95,12 @@ public:
 
     status_t injectSensorEvent(const ASensorEvent& event);
 
+    // Has SensorService deliver the events through shared memory, with the file descriptor only
+    // signalling that there are new events, which saves a copy and a system call per batch. Must
+    // be called before any sensor is enabled. As before, read() has to be called until it returns
+    // 0 once the file descriptor signals events.
+    status_t enableEventRing();
+
     // Filters the given sensor events in place and returns the new number of events.
     //
     // The filtering is controlled by ASensorEventQueue.requestAdditionalInfo, and if this value is
@@ -103,7 +110,9 @@ public:
 private:
     sp<Looper> getLooper() const;
     sp<ISensorEventConnection> mSensorEventConnection;
+    ssize_t readFromEventRing(ASensorEvent* events, size_t numEvents);
     sp<BitTube> mSensorChannel;
+    sp<SensorEventRing> mEventRing;
     mutable Mutex mLock;
     mutable sp<Looper> mLooper;
     ASensorEvent* mRecBuffer;
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+
+struct ASensorEvent;
+
+namespace android {
+// ----------------------------------------------------------------------------
+class Parcel;
+
+/*
+ * A single producer, single consumer ring of sensor events in shared memory. SensorService writes
+ * the events of a SensorEventConnection into it, and the connection's BitTube only carries a
+ * doorbell message when the ring goes from empty to non-empty, so that an app reading a fast
+ * sensor does not pay for one socket write and two copies per batch.
+ *
+ * The reader tells the writer that it made room in a ring the writer found full by sending a
+ * RoomAvailableMessage over the BitTube.
+ */
+class SensorEventRing : public RefBase
+{
+public:
+    enum { DEFAULT_CAPACITY = 512 };
+
+    typedef uint64_t RoomAvailableMessage;
+
+    // creates a ring for the given number of events, rounded up to a power of two
+    static sp<SensorEventRing> create(size_t capacity = DEFAULT_CAPACITY);
+
+    // maps the ring parceled by writeToParcel, returns nullptr on error
+    static sp<SensorEventRing> readFromParcel(const Parcel& data);
+
+    // parcels this ring
+    status_t writeToParcel(Parcel* reply) const;
+
+    // Writer side. Writes all the events or none of them, in which case it returns -EAGAIN.
+    // outNeedsDoorbell is set when the reader may be waiting for these events.
+    ssize_t write(ASensorEvent const* events, size_t count, bool* outNeedsDoorbell);
+
+    // Reader side. Reads up to count events and returns how many were read.
+    // outWriterWasBlocked is set when the writer found the ring full since the last read.
+    size_t read(ASensorEvent* events, size_t count, bool* outWriterWasBlocked);
+
+    size_t getCapacity() const { return mCapacity; }
+
+private:
+    struct Header {
+        std::atomic<uint32_t> writeIndex;
+        std::atomic<uint32_t> readIndex;
+        std::atomic<uint32_t> writerBlocked;
+    };
+
+    SensorEventRing(int fd, void* base, size_t size, uint32_t capacity);
+    virtual ~SensorEventRing();
+
+    static size_t getRegionSize(uint32_t capacity);
+    ASensorEvent* getSlots() const;
+
+    const int mFd;
+    void* const mBase;
+    const size_t mSize;
+    const uint32_t mCapacity;
+    Header* const mHeader;
+    // The writer keeps its own index, since the reader could scribble over the shared one.
+    uint32_t mWriteIndex;
+};
+
+// ----------------------------------------------------------------------------
+}; // namespace android
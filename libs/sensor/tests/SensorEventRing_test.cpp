@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+
+#include <gtest/gtest.h>
+
+#include <android/sensor.h>
+#include <sensor/SensorEventRing.h>
+
+namespace android {
+
+static ASensorEvent makeEvent(int64_t timestamp) {
+    ASensorEvent event = {};
+    event.timestamp = timestamp;
+    return event;
+}
+
+TEST(SensorEventRingTest, Read_ReturnsWrittenEventsInOrder) {
+    sp<SensorEventRing> ring = SensorEventRing::create(4);
+    ASSERT_NE(nullptr, ring.get());
+    ASSERT_EQ(4u, ring->getCapacity());
+
+    ASensorEvent events[] = {makeEvent(1), makeEvent(2), makeEvent(3)};
+    bool needsDoorbell = false;
+    ASSERT_EQ(3, ring->write(events, 3, &needsDoorbell));
+    // The reader had caught up, so it has to be told about these.
+    EXPECT_TRUE(needsDoorbell);
+    ASSERT_EQ(1, ring->write(events, 1, &needsDoorbell));
+    // The reader has yet to read the first batch.
+    EXPECT_FALSE(needsDoorbell);
+
+    ASensorEvent received[8];
+    bool writerWasBlocked = true;
+    ASSERT_EQ(4u, ring->read(received, 8, &writerWasBlocked));
+    EXPECT_FALSE(writerWasBlocked);
+    EXPECT_EQ(1, received[0].timestamp);
+    EXPECT_EQ(2, received[1].timestamp);
+    EXPECT_EQ(3, received[2].timestamp);
+    EXPECT_EQ(1, received[3].timestamp);
+    EXPECT_EQ(0u, ring->read(received, 8, &writerWasBlocked));
+}
+
+TEST(SensorEventRingTest, Write_FailsWhenFullUntilReaderMakesRoom) {
+    sp<SensorEventRing> ring = SensorEventRing::create(4);
+    ASSERT_NE(nullptr, ring.get());
+
+    ASensorEvent events[] = {makeEvent(1), makeEvent(2), makeEvent(3), makeEvent(4)};
+    bool needsDoorbell = false;
+    ASSERT_EQ(4, ring->write(events, 4, &needsDoorbell));
+    ASSERT_EQ(-EAGAIN, ring->write(events, 1, &needsDoorbell));
+
+    ASensorEvent received[2];
+    bool writerWasBlocked = false;
+    ASSERT_EQ(2u, ring->read(received, 2, &writerWasBlocked));
+    // The reader is asked to say that there is room again.
+    EXPECT_TRUE(writerWasBlocked);
+    EXPECT_EQ(2, ring->write(events, 2, &needsDoorbell));
+    EXPECT_FALSE(needsDoorbell);
+}
+
+TEST(SensorEventRingTest, ReadAndWrite_WrapAround) {
+    sp<SensorEventRing> ring = SensorEventRing::create(4);
+    ASSERT_NE(nullptr, ring.get());
+
+    int64_t timestamp = 0;
+    for (int i = 0; i < 10; i++) {
+        ASensorEvent events[] = {makeEvent(timestamp + 1), makeEvent(timestamp + 2),
+                                 makeEvent(timestamp + 3)};
+        bool needsDoorbell = false;
+        ASSERT_EQ(3, ring->write(events, 3, &needsDoorbell));
+        EXPECT_TRUE(needsDoorbell);
+
+        ASensorEvent received[3];
+        bool writerWasBlocked = false;
+        ASSERT_EQ(3u, ring->read(received, 3, &writerWasBlocked));
+        for (int j = 0; j < 3; j++) {
+            EXPECT_EQ(++timestamp, received[j].timestamp);
+        }
+    }
+}
+
+} // namespace android
@@ -16,6 +16,10 @@
 
 #include <ui/ColorSpace.h>
 
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
 using namespace std::placeholders;
 
 namespace android {
@@ -231,124 +235,137 @@ constexpr mat3 ColorSpace::computeXYZMatrix(
 }
 
 const ColorSpace ColorSpace::sRGB() {
-    return {
-        "sRGB IEC61966-2.1",
-        {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
-        {0.3127f, 0.3290f},
-        {2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.04045f, 0.0f, 0.0f}
+    static const ColorSpace colorSpace{
+            "sRGB IEC61966-2.1",
+            {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
+            {0.3127f, 0.3290f},
+            {2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.04045f, 0.0f, 0.0f}
     };
+    return colorSpace;
 }
 
 const ColorSpace ColorSpace::linearSRGB() {
-    return {
-        "sRGB IEC61966-2.1 (Linear)",
-        {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
-        {0.3127f, 0.3290f}
+    static const ColorSpace colorSpace{
+            "sRGB IEC61966-2.1 (Linear)",
+            {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
+            {0.3127f, 0.3290f}
     };
+    return colorSpace;
 }
 
 const ColorSpace ColorSpace::extendedSRGB() {
-    return {
-        "scRGB-nl IEC 61966-2-2:2003",
-        {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
-        {0.3127f, 0.3290f},
-        std::bind(absRcpResponse, _1, 2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.04045f),
-        std::bind(absResponse,    _1, 2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.04045f),
-        std::bind(clamp<float>, _1, -0.799f, 2.399f)
+    static const ColorSpace colorSpace{
+            "scRGB-nl IEC 61966-2-2:2003",
+            {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
+            {0.3127f, 0.3290f},
+            std::bind(absRcpResponse, _1, 2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.04045f),
+            std::bind(absResponse,    _1, 2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.04045f),
+            std::bind(clamp<float>, _1, -0.799f, 2.399f)
     };
+    return colorSpace;
 }
 
 const ColorSpace ColorSpace::linearExtendedSRGB() {
-    return {
-        "scRGB IEC 61966-2-2:2003",
-        {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
-        {0.3127f, 0.3290f},
-        1.0f,
-        std::bind(clamp<float>, _1, -0.5f, 7.499f)
+    static const ColorSpace colorSpace{
+            "scRGB IEC 61966-2-2:2003",
+            {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
+            {0.3127f, 0.3290f},
+            1.0f,
+            std::bind(clamp<float>, _1, -0.5f, 7.499f)
     };
+    return colorSpace;
 }
 
 const ColorSpace ColorSpace::NTSC() {
-    return {
-        "NTSC (1953)",
-        {{float2{0.67f, 0.33f}, {0.21f, 0.71f}, {0.14f, 0.08f}}},
-        {0.310f, 0.316f},
-        {1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f}
+    static const ColorSpace colorSpace{
+            "NTSC (1953)",
+            {{float2{0.67f, 0.33f}, {0.21f, 0.71f}, {0.14f, 0.08f}}},
+            {0.310f, 0.316f},
+            {1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f}
     };
+    return colorSpace;
 }
 
 const ColorSpace ColorSpace::BT709() {
-    return {
-        "Rec. ITU-R BT.709-5",
-        {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
-        {0.3127f, 0.3290f},
-        {1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f}
+    static const ColorSpace colorSpace{
+            "Rec. ITU-R BT.709-5",
+            {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
+            {0.3127f, 0.3290f},
+            {1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f}
     };
+    return colorSpace;
 }
 
 const ColorSpace ColorSpace::BT2020() {
-    return {
-        "Rec. ITU-R BT.2020-1",
-        {{float2{0.708f, 0.292f}, {0.170f, 0.797f}, {0.131f, 0.046f}}},
-        {0.3127f, 0.3290f},
-        {1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f}
+    static const ColorSpace colorSpace{
+            "Rec. ITU-R BT.2020-1",
+            {{float2{0.708f, 0.292f}, {0.170f, 0.797f}, {0.131f, 0.046f}}},
+            {0.3127f, 0.3290f},
+            {1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f}
     };
+    return colorSpace;
 }
 
 const ColorSpace ColorSpace::AdobeRGB() {
-    return {
-        "Adobe RGB (1998)",
-        {{float2{0.64f, 0.33f}, {0.21f, 0.71f}, {0.15f, 0.06f}}},
-        {0.3127f, 0.3290f},
-        2.2f
+    static const ColorSpace colorSpace{
+            "Adobe RGB (1998)",
+            {{float2{0.64f, 0.33f}, {0.21f, 0.71f}, {0.15f, 0.06f}}},
+            {0.3127f, 0.3290f},
+            2.2f
     };
+    return colorSpace;
 }
 
 const ColorSpace ColorSpace::ProPhotoRGB() {
-    return {
-        "ROMM RGB ISO 22028-2:2013",
-        {{float2{0.7347f, 0.2653f}, {0.1596f, 0.8404f}, {0.0366f, 0.0001f}}},
-        {0.34567f, 0.35850f},
-        {1.8f, 1.0f, 0.0f, 1 / 16.0f, 0.031248f, 0.0f, 0.0f}
+    static const ColorSpace colorSpace{
+            "ROMM RGB ISO 22028-2:2013",
+            {{float2{0.7347f, 0.2653f}, {0.1596f, 0.8404f}, {0.0366f, 0.0001f}}},
+            {0.34567f, 0.35850f},
+            {1.8f, 1.0f, 0.0f, 1 / 16.0f, 0.031248f, 0.0f, 0.0f}
     };
+    return colorSpace;
 }
 
 const ColorSpace ColorSpace::DisplayP3() {
-    return {
-        "Display P3",
-        {{float2{0.680f, 0.320f}, {0.265f, 0.690f}, {0.150f, 0.060f}}},
-        {0.3127f, 0.3290f},
-        {2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.039f, 0.0f, 0.0f}
+    static const ColorSpace colorSpace{
+            "Display P3",
+            {{float2{0.680f, 0.320f}, {0.265f, 0.690f}, {0.150f, 0.060f}}},
+            {0.3127f, 0.3290f},
+            {2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.039f, 0.0f, 0.0f}
     };
+    return colorSpace;
 }
 
 const ColorSpace ColorSpace::DCIP3() {
-    return {
-        "SMPTE RP 431-2-2007 DCI (P3)",
-        {{float2{0.680f, 0.320f}, {0.265f, 0.690f}, {0.150f, 0.060f}}},
-        {0.314f, 0.351f},
-        2.6f
+    static const ColorSpace colorSpace{
+            "SMPTE RP 431-2-2007 DCI (P3)",
+            {{float2{0.680f, 0.320f}, {0.265f, 0.690f}, {0.150f, 0.060f}}},
+            {0.314f, 0.351f},
+            2.6f
     };
+    return colorSpace;
 }
 
 const ColorSpace ColorSpace::ACES() {
-    return {
-        "SMPTE ST 2065-1:2012 ACES",
-        {{float2{0.73470f, 0.26530f}, {0.0f, 1.0f}, {0.00010f, -0.0770f}}},
-        {0.32168f, 0.33767f},
-        1.0f,
-        std::bind(clamp<float>, _1, -65504.0f, 65504.0f)
+    static const ColorSpace colorSpace{
+            "SMPTE ST 2065-1:2012 ACES",
+            {{float2{0.73470f, 0.26530f}, {0.0f, 1.0f}, {0.00010f, -0.0770f}}},
+            {0.32168f, 0.33767f},
+            1.0f,
+            std::bind(clamp<float>, _1, -65504.0f, 65504.0f)
     };
+    return colorSpace;
 }
 
 const ColorSpace ColorSpace::ACEScg() {
-    return {
-        "Academy S-2014-004 ACEScg",
-        {{float2{0.713f, 0.293f}, {0.165f, 0.830f}, {0.128f, 0.044f}}},
-        {0.32168f, 0.33767f},
-        1.0f,
-        std::bind(clamp<float>, _1, -65504.0f, 65504.0f)
+    static const ColorSpace colorSpace{
+            "Academy S-2014-004 ACEScg",
+            {{float2{0.713f, 0.293f}, {0.165f, 0.830f}, {0.128f, 0.044f}}},
+            {0.32168f, 0.33767f},
+            1.0f,
+            std::bind(clamp<float>, _1, -65504.0f, 65504.0f)
     };
+    return colorSpace;
 }
 
 std::unique_ptr<float3[]> ColorSpace::createLUT(uint32_t size, const ColorSpace& src,
@@ -376,6 +393,60 @@ std::unique_ptr<float3[]> ColorSpace::createLUT(uint32_t size, const ColorSpace&
     return lut;
 }
 
+static bool isSameColorSpace(const ColorSpace& lhs, const ColorSpace& rhs) {
+    const ColorSpace::TransferParameters& l = lhs.getTransferParameters();
+    const ColorSpace::TransferParameters& r = rhs.getTransferParameters();
+    return lhs.getName() == rhs.getName() &&
+            lhs.getPrimaries() == rhs.getPrimaries() &&
+            lhs.getWhitePoint() == rhs.getWhitePoint() &&
+            l.g == r.g && l.a == r.a && l.b == r.b && l.c == r.c && l.d == r.d &&
+            l.e == r.e && l.f == r.f;
+}
+
+std::shared_ptr<const float3[]> ColorSpace::getLUT(uint32_t size, const ColorSpace& src,
+                                                   const ColorSpace& dst) {
+    struct Entry {
+        uint32_t size;
+        ColorSpace src;
+        ColorSpace dst;
+        std::shared_ptr<const float3[]> lut;
+    };
+
+    // Each LUT is up to 256^3 entries, so only keep the few most recent ones.
+    static constexpr size_t MAX_CACHED_LUTS = 4;
+    static std::mutex sMutex;
+    static std::vector<Entry> sEntries; // most recently used last
+
+    size = clamp(size, 2u, 256u);
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        for (auto it = sEntries.begin(); it != sEntries.end(); ++it) {
+            if (it->size == size && isSameColorSpace(it->src, src) &&
+                isSameColorSpace(it->dst, dst)) {
+                std::rotate(it, it + 1, sEntries.end());
+                return sEntries.back().lut;
+            }
+        }
+    }
+
+    // Built outside the lock, it takes a while. Two threads racing for the
+    // same LUT both build it, and the second one to finish is dropped.
+    std::shared_ptr<const float3[]> lut(createLUT(size, src, dst));
+
+    std::lock_guard<std::mutex> lock(sMutex);
+    for (const Entry& entry : sEntries) {
+        if (entry.size == size && isSameColorSpace(entry.src, src) &&
+            isSameColorSpace(entry.dst, dst)) {
+            return entry.lut;
+        }
+    }
+    if (sEntries.size() == MAX_CACHED_LUTS) {
+        sEntries.erase(sEntries.begin());
+    }
+    sEntries.push_back({size, src, dst, lut});
+    return lut;
+}
+
 static const float2 ILLUMINANT_D50_XY = {0.34567f, 0.35850f};
 static const float3 ILLUMINANT_D50_XYZ = {0.964212f, 1.0f, 0.825188f};
 static const mat3 BRADFORD = mat3{
@@ -18,6 +18,8 @@
 
 #define LOG_TAG "FenceTime"
 
+#include <ui/FenceWatcher.h>
+
 #include <cutils/compiler.h>  // For CC_[UN]LIKELY
 #include <utils/Log.h>
 #include <inttypes.h>
@@ -104,6 +106,11 @@ nsecs_t FenceTime::getSignalTime() {
         return signalTime;
     }
 
+    // The watcher stores the signal time as soon as the fence signals.
+    if (mWatched.load(std::memory_order_relaxed)) {
+        return mSignalTime.load(std::memory_order_relaxed);
+    }
+
     // Hold a reference to the fence on the stack in case the class'
     // reference is removed by another thread. This prevents the
     // fence from being destroyed until the end of this method, where
@@ -143,6 +150,17 @@ nsecs_t FenceTime::getSignalTime() {
     return signalTime;
 }
 
+void FenceTime::setWatchedSignalTime(nsecs_t signalTime) {
+    if (signalTime == Fence::SIGNAL_TIME_PENDING) {
+        mWatched.store(false, std::memory_order_relaxed);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFence.clear();
+    mSignalTime.store(signalTime, std::memory_order_relaxed);
+}
+
 nsecs_t FenceTime::getCachedSignalTime() const {
     // memory_order_acquire since we don't have a lock fallback path
     // that will do an acquire.
@@ -276,6 +294,14 @@ void FenceTimeline::push(const std::shared_ptr<FenceTime>& fence) {
         mQueue.pop();
     }
     mQueue.push(fence);
+    if (mWatcher) {
+        mWatcher->watch(fence);
+    }
+}
+
+void FenceTimeline::setWatcher(std::shared_ptr<FenceWatcher> watcher) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mWatcher = std::move(watcher);
 }
 
 void FenceTimeline::updateSignalTimes() {
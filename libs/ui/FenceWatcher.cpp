@@ -0,0 +1,163 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ui/FenceWatcher.h>
+
+#define LOG_TAG "FenceWatcher"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <ui/FenceTime.h>
+#include <utils/Log.h>
+
+namespace android {
+
+FenceWatcher::FenceWatcher()
+      : mEpollFd(epoll_create1(EPOLL_CLOEXEC)), mEventFd(eventfd(0, EFD_CLOEXEC)) {
+    if (mEpollFd < 0 || mEventFd < 0) {
+        ALOGE("Failed to create the epoll or event fd: %s", strerror(errno));
+        mEpollFd.reset();
+        return;
+    }
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mEventFd, &event) != 0) {
+        ALOGE("Failed to watch the event fd: %s", strerror(errno));
+        mEpollFd.reset();
+        return;
+    }
+
+    mThread = std::thread(&FenceWatcher::threadMain, this);
+    pthread_setname_np(mThread.native_handle(), "FenceWatcher");
+}
+
+FenceWatcher::~FenceWatcher() {
+    if (mThread.joinable()) {
+        const uint64_t value = 1;
+        write(mEventFd, &value, sizeof(value));
+        mThread.join();
+    }
+
+    // Whatever is still watched goes back to being polled.
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto& [fence, entry] : mEntries) {
+        for (const auto& weakFenceTime : entry.fenceTimes) {
+            if (auto fenceTime = weakFenceTime.lock()) {
+                fenceTime->mWatched.store(false, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+void FenceWatcher::watch(const std::shared_ptr<FenceTime>& fenceTime) {
+    if (mEpollFd < 0 || !fenceTime ||
+        fenceTime->getCachedSignalTime() != Fence::SIGNAL_TIME_PENDING) {
+        return;
+    }
+
+    sp<Fence> fence;
+    {
+        std::lock_guard<std::mutex> lock(fenceTime->mMutex);
+        fence = fenceTime->mFence;
+    }
+    if (!fence || !fence->isValid()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mEntries.find(fence.get());
+    if (it != mEntries.end()) {
+        fenceTime->mWatched.store(true, std::memory_order_relaxed);
+        it->second.fenceTimes.push_back(fenceTime);
+        return;
+    }
+    if (mEntries.size() >= MAX_FENCES) {
+        return;
+    }
+
+    // Marked before the fence is registered, so a signal recorded right
+    // away isn't followed by the FenceTime ignoring its fence for good.
+    fenceTime->mWatched.store(true, std::memory_order_relaxed);
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = fence.get();
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fence->get(), &event) != 0) {
+        ALOGE("Failed to watch fence %d: %s", fence->get(), strerror(errno));
+        fenceTime->mWatched.store(false, std::memory_order_relaxed);
+        return;
+    }
+
+    Entry& entry = mEntries[fence.get()];
+    entry.fence = fence;
+    entry.fenceTimes.push_back(fenceTime);
+}
+
+size_t FenceWatcher::getWatchedCount() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEntries.size();
+}
+
+void FenceWatcher::threadMain() {
+    constexpr int kMaxEvents = 16;
+    epoll_event events[kMaxEvents];
+    while (true) {
+        const int count = epoll_wait(mEpollFd, events, kMaxEvents, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            ALOGE("epoll_wait failed: %s", strerror(errno));
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.ptr == nullptr) {
+                return;
+            }
+            onFenceReady(static_cast<Fence*>(events[i].data.ptr));
+        }
+    }
+}
+
+void FenceWatcher::onFenceReady(Fence* key) {
+    Entry entry;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mEntries.find(key);
+        if (it == mEntries.end()) {
+            return;
+        }
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, it->second.fence->get(), nullptr);
+        entry = std::move(it->second);
+        mEntries.erase(it);
+    }
+
+    // One ioctl records the time for every FenceTime of the fence. If the
+    // fence somehow is still pending, they go back to polling it.
+    const nsecs_t signalTime = entry.fence->getSignalTime();
+    for (const auto& weakFenceTime : entry.fenceTimes) {
+        if (auto fenceTime = weakFenceTime.lock()) {
+            fenceTime->setWatchedSignalTime(signalTime);
+        }
+    }
+}
+
+}; // namespace android
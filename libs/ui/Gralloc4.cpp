@@ -48,6 +48,34 @@ namespace {
 
 static constexpr Error kTransactionError = Error::NO_RESOURCES;
 
+// Whether the metadata is fixed when the buffer is allocated, and so can be
+// cached for as long as it is imported. Dataspace, blend mode and HDR
+// metadata can be set by any process the buffer is shared with.
+bool isImmutableMetadataType(const MetadataType& metadataType) {
+    if (metadataType.name != GRALLOC4_STANDARD_METADATA_TYPE) {
+        return false;
+    }
+    switch (static_cast<StandardMetadataType>(metadataType.value)) {
+        case StandardMetadataType::BUFFER_ID:
+        case StandardMetadataType::NAME:
+        case StandardMetadataType::WIDTH:
+        case StandardMetadataType::HEIGHT:
+        case StandardMetadataType::LAYER_COUNT:
+        case StandardMetadataType::PIXEL_FORMAT_REQUESTED:
+        case StandardMetadataType::PIXEL_FORMAT_FOURCC:
+        case StandardMetadataType::PIXEL_FORMAT_MODIFIER:
+        case StandardMetadataType::USAGE:
+        case StandardMetadataType::ALLOCATION_SIZE:
+        case StandardMetadataType::COMPRESSION:
+        case StandardMetadataType::INTERLACED:
+        case StandardMetadataType::CHROMA_SITING:
+        case StandardMetadataType::PLANE_LAYOUTS:
+            return true;
+        default:
+            return false;
+    }
+}
+
 uint64_t getValidUsageBits() {
     static const uint64_t validUsageBits = []() -> uint64_t {
         uint64_t bits = 0;
@@ -160,6 +188,12 @@ status_t Gralloc4Mapper::importBuffer(const hardware::hidl_handle& rawHandle,
 }
 
 void Gralloc4Mapper::freeBuffer(buffer_handle_t bufferHandle) const {
+    {
+        // Before the handle can be reused by another import.
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        mMetadataCache.erase(bufferHandle);
+    }
+
     auto buffer = const_cast<native_handle_t*>(bufferHandle);
     auto ret = mMapper->freeBuffer(buffer);
 
@@ -167,6 +201,23 @@ void Gralloc4Mapper::freeBuffer(buffer_handle_t bufferHandle) const {
     ALOGE_IF(error != Error::NONE, "freeBuffer(%p) failed with %d", buffer, error);
 }
 
+void Gralloc4Mapper::freeBuffers(const std::vector<buffer_handle_t>& bufferHandles) const {
+    {
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        for (buffer_handle_t bufferHandle : bufferHandles) {
+            mMetadataCache.erase(bufferHandle);
+        }
+    }
+
+    for (buffer_handle_t bufferHandle : bufferHandles) {
+        auto buffer = const_cast<native_handle_t*>(bufferHandle);
+        auto ret = mMapper->freeBuffer(buffer);
+
+        auto error = (ret.isOk()) ? static_cast<Error>(ret) : kTransactionError;
+        ALOGE_IF(error != Error::NONE, "freeBuffer(%p) failed with %d", buffer, error);
+    }
+}
+
 status_t Gralloc4Mapper::validateBufferSize(buffer_handle_t bufferHandle, uint32_t width,
                                             uint32_t height, PixelFormat format,
                                             uint32_t layerCount, uint64_t usage,
@@ -446,6 +497,18 @@ status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& m
         return BAD_VALUE;
     }
 
+    const bool cacheable = isImmutableMetadataType(metadataType);
+    if (cacheable) {
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        auto buffer = mMetadataCache.find(bufferHandle);
+        if (buffer != mMetadataCache.end()) {
+            auto entry = buffer->second.find(metadataType.value);
+            if (entry != buffer->second.end()) {
+                return decodeFunction(entry->second, outMetadata);
+            }
+        }
+    }
+
     hidl_vec<uint8_t> vec;
     Error error;
     auto ret = mMapper->get(const_cast<native_handle_t*>(bufferHandle), metadataType,
@@ -464,6 +527,11 @@ status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& m
         return static_cast<status_t>(error);
     }
 
+    if (cacheable) {
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        mMetadataCache[bufferHandle][metadataType.value] = vec;
+    }
+
     return decodeFunction(vec, outMetadata);
 }
 
@@ -115,8 +115,20 @@ void GraphicBufferMapper::getTransportSize(buffer_handle_t handle,
     mMapper->getTransportSize(handle, outTransportNumFds, outTransportNumInts);
 }
 
+namespace {
+
+thread_local int sFreeBatchDepth = 0;
+thread_local std::vector<buffer_handle_t> sPendingFrees;
+
+} // namespace
+
 status_t GraphicBufferMapper::freeBuffer(buffer_handle_t handle)
 {
+    if (sFreeBatchDepth > 0) {
+        sPendingFrees.push_back(handle);
+        return NO_ERROR;
+    }
+
     ATRACE_CALL();
 
     mMapper->freeBuffer(handle);
@@ -124,6 +136,29 @@ status_t GraphicBufferMapper::freeBuffer(buffer_handle_t handle)
     return NO_ERROR;
 }
 
+status_t GraphicBufferMapper::freeBuffers(const std::vector<buffer_handle_t>& handles)
+{
+    ATRACE_CALL();
+
+    mMapper->freeBuffers(handles);
+
+    return NO_ERROR;
+}
+
+GraphicBufferMapper::ScopedFreeBatch::ScopedFreeBatch() {
+    sFreeBatchDepth++;
+}
+
+GraphicBufferMapper::ScopedFreeBatch::~ScopedFreeBatch() {
+    if (--sFreeBatchDepth > 0 || sPendingFrees.empty()) {
+        return;
+    }
+
+    std::vector<buffer_handle_t> handles;
+    handles.swap(sPendingFrees);
+    GraphicBufferMapper::get().freeBuffers(handles);
+}
+
 status_t GraphicBufferMapper::lock(buffer_handle_t handle, uint32_t usage, const Rect& bounds,
                                    void** vaddr, int32_t* outBytesPerPixel,
                                    int32_t* outBytesPerStride) {
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "GraphicBufferPool"
+
+#include <ui/GraphicBufferPool.h>
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <iterator>
+
+#include <android-base/stringprintf.h>
+
+namespace android {
+
+GraphicBufferPool::GraphicBufferPool(size_t budgetBytes) : mBudgetBytes(budgetBytes) {}
+
+GraphicBufferPool::~GraphicBufferPool() = default;
+
+void GraphicBufferPool::setBudget(size_t budgetBytes) {
+    std::list<Entry> evicted;
+    std::lock_guard<std::mutex> lock(mMutex);
+    mBudgetBytes = budgetBytes;
+    evictLocked(&evicted);
+}
+
+sp<GraphicBuffer> GraphicBufferPool::take(uint32_t width, uint32_t height, PixelFormat format,
+                                          uint32_t layerCount, uint64_t usage,
+                                          sp<Fence>* outFence) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+        const GraphicBuffer& buffer = *it->buffer;
+        if (buffer.getWidth() == width && buffer.getHeight() == height &&
+            buffer.getPixelFormat() == format && buffer.getLayerCount() == layerCount &&
+            buffer.getUsage() == usage) {
+            sp<GraphicBuffer> result = std::move(it->buffer);
+            *outFence = std::move(it->fence);
+            mPooledBytes -= it->size;
+            mEntries.erase(it);
+            mReuseCount++;
+            return result;
+        }
+    }
+    return nullptr;
+}
+
+void GraphicBufferPool::recycle(const sp<GraphicBuffer>& buffer, const sp<Fence>& fence) {
+    if (buffer == nullptr || buffer->initCheck() != NO_ERROR) {
+        return;
+    }
+
+    std::list<Entry> evicted;
+    std::lock_guard<std::mutex> lock(mMutex);
+    const size_t size = getBufferSize(*buffer);
+    if (size > mBudgetBytes) {
+        return;
+    }
+    mEntries.push_front({buffer, fence != nullptr ? fence : Fence::NO_FENCE, size});
+    mPooledBytes += size;
+    evictLocked(&evicted);
+}
+
+void GraphicBufferPool::clear() {
+    std::list<Entry> evicted;
+    std::lock_guard<std::mutex> lock(mMutex);
+    evicted.swap(mEntries);
+    mPooledBytes = 0;
+}
+
+size_t GraphicBufferPool::getPooledCount() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEntries.size();
+}
+
+size_t GraphicBufferPool::getPooledBytes() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mPooledBytes;
+}
+
+void GraphicBufferPool::dump(std::string& result) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    base::StringAppendF(&result,
+                        "Buffer pool: %zu buffers, %zu of %zu KiB, reused=%" PRIu64
+                        " evicted=%" PRIu64 "\n",
+                        mEntries.size(), mPooledBytes / 1024, mBudgetBytes / 1024, mReuseCount,
+                        mEvictionCount);
+}
+
+size_t GraphicBufferPool::getBufferSize(const GraphicBuffer& buffer) {
+    // YUV formats report no bytes per pixel; count them at the 2 bytes the
+    // common 4:2:2 and 4:2:0 formats round up to.
+    const uint32_t bpp = bytesPerPixel(buffer.getPixelFormat());
+    const size_t width = std::max(buffer.getStride(), buffer.getWidth());
+    return width * buffer.getHeight() * buffer.getLayerCount() * (bpp ? bpp : 2);
+}
+
+void GraphicBufferPool::evictLocked(std::list<Entry>* evicted) {
+    while (mPooledBytes > mBudgetBytes && !mEntries.empty()) {
+        mPooledBytes -= mEntries.back().size;
+        evicted->splice(evicted->begin(), mEntries, std::prev(mEntries.end()));
+        mEvictionCount++;
+    }
+}
+
+}; // namespace android
@@ -19,6 +19,8 @@
 #include <inttypes.h>
 #include <limits.h>
 
+#include <algorithm>
+
 #include <android-base/stringprintf.h>
 
 #include <utils/Log.h>
@@ -62,6 +64,54 @@ enum {
     direction_RTL
 };
 
+// What the bounds of both sides of a boolean operation say of the result.
+enum class BoundsResult {
+    unknown,
+    empty,
+    lhs,
+    rhs
+};
+
+static bool containsRect(const Rect& outer, const Rect& inner) {
+    return inner.left >= outer.left && inner.top >= outer.top &&
+            inner.right <= outer.right && inner.bottom <= outer.bottom;
+}
+
+// Decides the result from the bounds alone when they don't overlap, when
+// one side is empty, or when one side is a rect enclosing the other, so no
+// rect has to be visited.
+static BoundsResult bounds_boolean_operation(uint32_t op,
+        const Rect& lhs, bool lhsIsRect, const Rect& rhs, bool rhsIsRect)
+{
+    if (!lhs.isValid() || !rhs.isValid()) {
+        return BoundsResult::unknown;
+    }
+
+    if (lhs.isEmpty() || rhs.isEmpty()) {
+        if (op == op_and) return BoundsResult::empty;
+        if (lhs.isEmpty()) {
+            return op == op_nand ? BoundsResult::empty : BoundsResult::rhs;
+        }
+        return BoundsResult::lhs;
+    }
+
+    Rect intersection;
+    if (!lhs.intersect(rhs, &intersection)) {
+        if (op == op_and) return BoundsResult::empty;
+        if (op == op_nand) return BoundsResult::lhs;
+        return BoundsResult::unknown;
+    }
+
+    if (rhsIsRect && containsRect(rhs, lhs)) {
+        if (op == op_and) return BoundsResult::lhs;
+        if (op == op_nand) return BoundsResult::empty;
+    }
+    if (lhsIsRect && containsRect(lhs, rhs) && op == op_and) {
+        return BoundsResult::rhs;
+    }
+    return BoundsResult::unknown;
+}
+
 const Region Region::INVALID_REGION(Rect::INVALID_RECT);
 
 // ----------------------------------------------------------------------------
@@ -249,6 +299,10 @@ bool Region::contains(const Point& point) const {
 }
 
 bool Region::contains(int x, int y) const {
+    const Rect bounds(getBounds());
+    if (y < bounds.top || y >= bounds.bottom || x < bounds.left || x >= bounds.right) {
+        return false;
+    }
     const_iterator cur = begin();
     const_iterator const tail = end();
     while (cur != tail) {
@@ -643,6 +697,91 @@ bool Region::validate(const Region& reg, const char* name, bool silent)
     return result;
 }
 
+bool Region::rect_boolean_operation(uint32_t op, Region& dst,
+        const Rect& lhs, const Rect& rhs)
+{
+    // The results must match what the rasterizer would produce: a single
+    // rect on its own, or an empty rect at the origin. |r| is taken by value
+    // as |lhs| may live in |dst|.
+    const auto setRect = [&dst](Rect r) {
+        dst.mStorage.clear();
+        dst.mStorage.push_back(r.isEmpty() ? Rect(0, 0) : r);
+        return true;
+    };
+    const auto bounds = [&lhs, &rhs]() {
+        return Rect(std::min(lhs.left, rhs.left), std::min(lhs.top, rhs.top),
+                std::max(lhs.right, rhs.right), std::max(lhs.bottom, rhs.bottom));
+    };
+
+    // Inverted rects are left to the general algorithm, whatever it makes of
+    // them.
+    if (!lhs.isValid() || !rhs.isValid()) {
+        return false;
+    }
+
+    if (lhs.isEmpty() || rhs.isEmpty()) {
+        switch (op) {
+            case op_and:
+                return setRect(Rect::EMPTY_RECT);
+            case op_nand:
+                return setRect(lhs);
+            default:
+                return setRect(lhs.isEmpty() ? rhs : lhs);
+        }
+    }
+
+    Rect intersection;
+    const bool intersects = lhs.intersect(rhs, &intersection);
+
+    switch (op) {
+        case op_and:
+            return setRect(intersects ? intersection : Rect::EMPTY_RECT);
+
+        case op_nand: {
+            if (!intersects) return setRect(lhs);
+            const bool coversWidth = rhs.left <= lhs.left && rhs.right >= lhs.right;
+            const bool coversHeight = rhs.top <= lhs.top && rhs.bottom >= lhs.bottom;
+            if (coversWidth && coversHeight) return setRect(Rect::EMPTY_RECT);
+            if (coversWidth && rhs.top <= lhs.top) {
+                return setRect(Rect(lhs.left, rhs.bottom, lhs.right, lhs.bottom));
+            }
+            if (coversWidth && rhs.bottom >= lhs.bottom) {
+                return setRect(Rect(lhs.left, lhs.top, lhs.right, rhs.top));
+            }
+            if (coversHeight && rhs.left <= lhs.left) {
+                return setRect(Rect(rhs.right, lhs.top, lhs.right, lhs.bottom));
+            }
+            if (coversHeight && rhs.right >= lhs.right) {
+                return setRect(Rect(lhs.left, lhs.top, rhs.left, lhs.bottom));
+            }
+            return false;
+        }
+
+        case op_or:
+        case op_xor: {
+            // Rects that only touch along whole edges have the same union and
+            // exclusive union, and those merge into a single rect.
+            const bool sameRows = lhs.top == rhs.top && lhs.bottom == rhs.bottom;
+            const bool sameColumns = lhs.left == rhs.left && lhs.right == rhs.right;
+            const bool touchesRows = sameRows && (lhs.right == rhs.left || rhs.right == lhs.left);
+            const bool touchesColumns =
+                    sameColumns && (lhs.bottom == rhs.top || rhs.bottom == lhs.top);
+            if (touchesRows || touchesColumns) {
+                return setRect(bounds());
+            }
+            if (op == op_xor) return false;
+
+            if (intersection == rhs) return setRect(lhs);
+            if (intersection == lhs) return setRect(rhs);
+            if ((sameRows || sameColumns) && intersects) {
+                return setRect(bounds());
+            }
+            return false;
+        }
+    }
+    return false;
+}
+
 void Region::boolean_operation(uint32_t op, Region& dst,
         const Region& lhs,
         const Region& rhs, int dx, int dy)
@@ -653,6 +792,28 @@ void Region::boolean_operation(uint32_t op, Region& dst,
     validate(dst, "boolean_operation (before): dst");
 #endif
 
+#if !VALIDATE_WITH_CORECG && !defined(VALIDATE_REGIONS)
+    if (lhs.mStorage.size() == 1 && rhs.mStorage.size() == 1 &&
+            rect_boolean_operation(op, dst, lhs.mStorage[0], rhs.mStorage[0] + Point(dx, dy))) {
+        return;
+    }
+
+    switch (bounds_boolean_operation(op, lhs.getBounds(), lhs.isRect(),
+            rhs.getBounds() + Point(dx, dy), rhs.isRect())) {
+        case BoundsResult::empty:
+            dst.clear();
+            return;
+        case BoundsResult::lhs:
+            dst = lhs;
+            return;
+        case BoundsResult::rhs:
+            translate(dst, rhs, dx, dy);
+            return;
+        case BoundsResult::unknown:
+            break;
+    }
+#endif
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -767,6 +928,30 @@ void Region::boolean_operation(uint32_t op, Region& dst,
 #if VALIDATE_WITH_CORECG || defined(VALIDATE_REGIONS)
     boolean_operation(op, dst, lhs, Region(rhs), dx, dy);
 #else
+    if (lhs.mStorage.size() == 1 &&
+            rect_boolean_operation(op, dst, lhs.mStorage[0], rhs + Point(dx, dy))) {
+        return;
+    }
+
+    const Rect translated(rhs + Point(dx, dy));
+    switch (bounds_boolean_operation(op, lhs.getBounds(), lhs.isRect(), translated, true)) {
+        case BoundsResult::empty:
+            dst.clear();
+            return;
+        case BoundsResult::lhs:
+            dst = lhs;
+            return;
+        case BoundsResult::rhs:
+            if (translated.isEmpty()) {
+                dst.clear();
+            } else {
+                dst.set(translated);
+            }
+            return;
+        case BoundsResult::unknown:
+            break;
+    }
+
     size_t lhs_count;
     Rect const * const lhs_rects = lhs.getArray(&lhs_count);
 
@@ -16,6 +16,8 @@
 
 #include <math.h>
 
+#include <vector>
+
 #include <android-base/stringprintf.h>
 #include <cutils/compiler.h>
 #include <ui/Region.h>
@@ -214,40 +216,89 @@ Rect Transform::makeBounds(int w, int h) const
     return transform( Rect(w, h) );
 }
 
-Rect Transform::transform(const Rect& bounds, bool roundOutwards) const
-{
-    Rect r;
-    vec2 lt( bounds.left,  bounds.top    );
-    vec2 rt( bounds.right, bounds.top    );
-    vec2 lb( bounds.left,  bounds.bottom );
-    vec2 rb( bounds.right, bounds.bottom );
+namespace {
 
-    lt = transform(lt);
-    rt = transform(rt);
-    lb = transform(lb);
-    rb = transform(rb);
+// Kernels for the rect preserving transforms. Knowing which of the matrix
+// coefficients are zero, they only compute the two edges that end up as each
+// side of the result, rather than transforming all four corners.
 
+// x' = sx * x + tx, y' = sy * y + ty, for translations, scales and flips.
+struct AxisAlignedKernel {
+    float sx, sy, tx, ty;
+
+    FloatRect operator()(float left, float top, float right, float bottom) const {
+        const float x0 = sx * left + tx;
+        const float x1 = sx * right + tx;
+        const float y0 = sy * top + ty;
+        const float y1 = sy * bottom + ty;
+        return FloatRect(std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1));
+    }
+};
+
+// x' = b * y + tx, y' = c * x + ty, for the 90 and 270 degree rotations.
+struct Rotate90Kernel {
+    float b, c, tx, ty;
+
+    FloatRect operator()(float left, float top, float right, float bottom) const {
+        const float x0 = b * top + tx;
+        const float x1 = b * bottom + tx;
+        const float y0 = c * left + ty;
+        const float y1 = c * right + ty;
+        return FloatRect(std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1));
+    }
+};
+
+Rect roundBounds(const FloatRect& r, bool roundOutwards) {
     if (roundOutwards) {
-        r.left   = static_cast<int32_t>(floorf(std::min({lt[0], rt[0], lb[0], rb[0]})));
-        r.top    = static_cast<int32_t>(floorf(std::min({lt[1], rt[1], lb[1], rb[1]})));
-        r.right  = static_cast<int32_t>(ceilf(std::max({lt[0], rt[0], lb[0], rb[0]})));
-        r.bottom = static_cast<int32_t>(ceilf(std::max({lt[1], rt[1], lb[1], rb[1]})));
-    } else {
-        r.left   = static_cast<int32_t>(floorf(std::min({lt[0], rt[0], lb[0], rb[0]}) + 0.5f));
-        r.top    = static_cast<int32_t>(floorf(std::min({lt[1], rt[1], lb[1], rb[1]}) + 0.5f));
-        r.right  = static_cast<int32_t>(floorf(std::max({lt[0], rt[0], lb[0], rb[0]}) + 0.5f));
-        r.bottom = static_cast<int32_t>(floorf(std::max({lt[1], rt[1], lb[1], rb[1]}) + 0.5f));
+        return Rect(static_cast<int32_t>(floorf(r.left)), static_cast<int32_t>(floorf(r.top)),
+                    static_cast<int32_t>(ceilf(r.right)), static_cast<int32_t>(ceilf(r.bottom)));
+    }
+    return Rect(static_cast<int32_t>(floorf(r.left + 0.5f)),
+                static_cast<int32_t>(floorf(r.top + 0.5f)),
+                static_cast<int32_t>(floorf(r.right + 0.5f)),
+                static_cast<int32_t>(floorf(r.bottom + 0.5f)));
+}
+
+template <typename Kernel>
+void transformRects(const Kernel& kernel, const Region& reg, std::vector<Rect>* outRects) {
+    outRects->reserve(reg.end() - reg.begin());
+    for (const Rect& rect : reg) {
+        const Rect r = roundBounds(kernel(rect.left, rect.top, rect.right, rect.bottom), false);
+        if (!r.isEmpty()) {
+            outRects->push_back(r);
+        }
     }
+}
 
-    return r;
+// Unions the rects pairwise, like a merge sort, so that each step joins two
+// regions of similar size instead of growing one region a rect at a time.
+Region unionOf(const Rect* rects, size_t count) {
+    if (count == 0) {
+        return Region();
+    }
+    if (count == 1) {
+        return Region(rects[0]);
+    }
+    const size_t half = count / 2;
+    return unionOf(rects, half).merge(unionOf(rects + half, count - half));
 }
 
-FloatRect Transform::transform(const FloatRect& bounds) const
-{
-    vec2 lt(bounds.left, bounds.top);
-    vec2 rt(bounds.right, bounds.top);
-    vec2 lb(bounds.left, bounds.bottom);
-    vec2 rb(bounds.right, bounds.bottom);
+} // namespace
+
+FloatRect Transform::transformBounds(float left, float top, float right, float bottom) const {
+    const mat33& M(mMatrix);
+    const uint32_t orientation = getOrientation();
+    if (CC_LIKELY(!(orientation & ROT_INVALID))) {
+        if (orientation & ROT_90) {
+            return Rotate90Kernel{M[1][0], M[0][1], M[2][0], M[2][1]}(left, top, right, bottom);
+        }
+        return AxisAlignedKernel{M[0][0], M[1][1], M[2][0], M[2][1]}(left, top, right, bottom);
+    }
+
+    vec2 lt(left, top);
+    vec2 rt(right, top);
+    vec2 lb(left, bottom);
+    vec2 rb(right, bottom);
 
     lt = transform(lt);
     rt = transform(rt);
@@ -263,16 +314,33 @@ FloatRect Transform::transform(const FloatRect& bounds) const
     return r;
 }
 
+Rect Transform::transform(const Rect& bounds, bool roundOutwards) const
+{
+    return roundBounds(transformBounds(bounds.left, bounds.top, bounds.right, bounds.bottom),
+                       roundOutwards);
+}
+
+FloatRect Transform::transform(const FloatRect& bounds) const
+{
+    return transformBounds(bounds.left, bounds.top, bounds.right, bounds.bottom);
+}
+
 Region Transform::transform(const Region& reg) const
 {
     Region out;
     if (CC_UNLIKELY(type() > TRANSLATE)) {
         if (CC_LIKELY(preserveRects())) {
-            Region::const_iterator it = reg.begin();
-            Region::const_iterator const end = reg.end();
-            while (it != end) {
-                out.orSelf(transform(*it++));
+            // Transform every rect with the kernel for this orientation,
+            // then join them all at once.
+            const mat33& M(mMatrix);
+            std::vector<Rect> rects;
+            if (getOrientation() & ROT_90) {
+                transformRects(Rotate90Kernel{M[1][0], M[0][1], M[2][0], M[2][1]}, reg, &rects);
+            } else {
+                transformRects(AxisAlignedKernel{M[0][0], M[1][1], M[2][0], M[2][1]}, reg,
+                               &rects);
             }
+            out = unionOf(rects.data(), rects.size());
         } else {
             out.set(transform(reg.bounds()));
         }
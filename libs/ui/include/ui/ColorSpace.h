@@ -253,6 +253,13 @@ public:
     static std::unique_ptr<float3[]> createLUT(uint32_t size, const ColorSpace& src,
                                                const ColorSpace& dst);
 
+    // Returns the same LUT as createLUT(), from a small process-wide cache so
+    // that switching back and forth between dataspaces does not rebuild it.
+    // Color spaces are told apart by name, primaries, white point and
+    // transfer parameters.
+    static std::shared_ptr<const float3[]> getLUT(uint32_t size, const ColorSpace& src,
+                                                  const ColorSpace& dst);
+
 private:
     static constexpr mat3 computeXYZMatrix(
             const std::array<float2, 3>& primaries, const float2& whitePoint);
@@ -30,12 +30,14 @@
 namespace android {
 
 class FenceToFenceTimeMap;
+class FenceWatcher;
 
 // A wrapper around fence that only implements isValid and getSignalTime.
 // It automatically closes the fence in a thread-safe manner once the signal
 // time is known.
 class FenceTime {
 friend class FenceToFenceTimeMap;
+friend class FenceWatcher;
 public:
     // An atomic snapshot of the FenceTime that is flattenable.
     //
@@ -103,7 +105,8 @@ public:
     bool isValid() const;
 
     // Attempts to get the timestamp from the Fence if the timestamp isn't
-    // already cached. Otherwise, it returns the cached value.
+    // already cached. Otherwise, it returns the cached value. While a
+    // FenceWatcher watches the fence, only the cached value is returned.
     nsecs_t getSignalTime();
 
     // Gets the cached timestamp without attempting to query the Fence.
@@ -125,6 +128,9 @@ private:
         FORCED_VALID_FOR_TEST,
     };
 
+    // Called by FenceWatcher once the fence is ready.
+    void setWatchedSignalTime(nsecs_t signalTime);
+
     const State mState{State::INVALID};
 
     // mMutex guards mFence and mSignalTime.
@@ -133,6 +139,9 @@ private:
     mutable std::mutex mMutex;
     sp<Fence> mFence{Fence::NO_FENCE};
     std::atomic<nsecs_t> mSignalTime{Fence::SIGNAL_TIME_INVALID};
+
+    // Set while a FenceWatcher records the signal time.
+    std::atomic<bool> mWatched{false};
 };
 
 // A queue of FenceTimes that are expected to signal in FIFO order.
@@ -158,9 +167,14 @@ public:
     void push(const std::shared_ptr<FenceTime>& fence);
     void updateSignalTimes();
 
+    // Has |watcher| watch every fence pushed from now on, so
+    // updateSignalTimes() makes no syscalls for them.
+    void setWatcher(std::shared_ptr<FenceWatcher> watcher);
+
 private:
     mutable std::mutex mMutex;
     std::queue<std::weak_ptr<FenceTime>> mQueue GUARDED_BY(mMutex);
+    std::shared_ptr<FenceWatcher> mWatcher GUARDED_BY(mMutex);
 };
 
 // Used by test code to create or get FenceTimes for a given Fence.
@@ -25,6 +25,7 @@
 #include <utils/StrongPointer.h>
 
 #include <string>
+#include <vector>
 
 namespace android {
 
@@ -51,6 +52,13 @@ public:
 
     virtual void freeBuffer(buffer_handle_t bufferHandle) const = 0;
 
+    // Frees several imported buffers at once.
+    virtual void freeBuffers(const std::vector<buffer_handle_t>& bufferHandles) const {
+        for (buffer_handle_t bufferHandle : bufferHandles) {
+            freeBuffer(bufferHandle);
+        }
+    }
+
     virtual status_t validateBufferSize(buffer_handle_t bufferHandle, uint32_t width,
                                         uint32_t height, android::PixelFormat format,
                                         uint32_t layerCount, uint64_t usage,
@@ -26,7 +26,9 @@
 #include <ui/Rect.h>
 #include <utils/StrongPointer.h>
 
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 namespace android {
 
@@ -48,6 +50,8 @@ public:
 
     void freeBuffer(buffer_handle_t bufferHandle) const override;
 
+    void freeBuffers(const std::vector<buffer_handle_t>& bufferHandles) const override;
+
     status_t validateBufferSize(buffer_handle_t bufferHandle, uint32_t width, uint32_t height,
                                 PixelFormat format, uint32_t layerCount, uint64_t usage,
                                 uint32_t stride) const override;
@@ -182,6 +186,15 @@ private:
             std::ostringstream* outDump, uint64_t* outAllocationSize, bool less) const;
 
     sp<hardware::graphics::mapper::V4_0::IMapper> mMapper;
+
+    // The encoded metadata of imported buffers, by standard metadata type,
+    // for the types that can't change after allocation. Plane layouts are
+    // needed by every lock, and the rest are queried on every frame by
+    // SurfaceFlinger and codecs; a get is a HIDL call each time.
+    mutable std::mutex mMetadataCacheMutex;
+    mutable std::unordered_map<buffer_handle_t,
+                               std::unordered_map<int64_t, hardware::hidl_vec<uint8_t>>>
+            mMetadataCache;
 };
 
 class Gralloc4Allocator : public GrallocAllocator {
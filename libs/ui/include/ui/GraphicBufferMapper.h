@@ -21,6 +21,7 @@
 #include <sys/types.h>
 
 #include <memory>
+#include <vector>
 
 #include <ui/GraphicTypes.h>
 #include <ui/PixelFormat.h>
@@ -59,8 +60,24 @@ public:
             PixelFormat format, uint64_t usage, uint32_t stride,
             buffer_handle_t* outHandle);
 
+    // While a ScopedFreeBatch is alive on the calling thread, the handle is
+    // queued and only freed once the outermost batch ends.
     status_t freeBuffer(buffer_handle_t handle);
 
+    status_t freeBuffers(const std::vector<buffer_handle_t>& handles);
+
+    // Defers every freeBuffer call made on this thread until it goes out of
+    // scope, then frees the queued handles together. Declaring one before
+    // taking a lock keeps the gralloc frees out of the critical section.
+    class ScopedFreeBatch {
+    public:
+        ScopedFreeBatch();
+        ~ScopedFreeBatch();
+
+        ScopedFreeBatch(const ScopedFreeBatch&) = delete;
+        ScopedFreeBatch& operator=(const ScopedFreeBatch&) = delete;
+    };
+
     void getTransportSize(buffer_handle_t handle,
             uint32_t* outTransportNumFds, uint32_t* outTransportNumInts);
 
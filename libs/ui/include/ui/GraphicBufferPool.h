@@ -0,0 +1,96 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UI_GRAPHIC_BUFFER_POOL_H
+#define ANDROID_UI_GRAPHIC_BUFFER_POOL_H
+
+#include <stdint.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+
+#include <android-base/thread_annotations.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+#include <ui/PixelFormat.h>
+
+namespace android {
+
+// Keeps buffers that are no longer needed so that a later request for the
+// same width, height, format, layer count and usage can reuse one instead of
+// allocating from gralloc. Sizes cycled through by rotation, picture in
+// picture or multi window resizes then only allocate the first time.
+//
+// Buffers are evicted least recently pooled first to stay within a budget
+// of bytes; a budget of 0 disables the pool.
+//
+// Pooled buffers keep whatever was last drawn into them, so a pool must not
+// be shared between clients that must not see each other's content.
+//
+// Thread safe.
+class GraphicBufferPool {
+public:
+    explicit GraphicBufferPool(size_t budgetBytes = 0);
+    ~GraphicBufferPool();
+
+    GraphicBufferPool(const GraphicBufferPool&) = delete;
+    GraphicBufferPool& operator=(const GraphicBufferPool&) = delete;
+
+    // Evicts whatever doesn't fit the new budget.
+    void setBudget(size_t budgetBytes);
+
+    // Returns a pooled buffer matching the request exactly, or nullptr.
+    // |outFence| is set to the fence that must be waited on before the
+    // buffer is written to.
+    sp<GraphicBuffer> take(uint32_t width, uint32_t height, PixelFormat format,
+                           uint32_t layerCount, uint64_t usage, sp<Fence>* outFence);
+
+    // Pools |buffer|, which may still be read until |fence| signals.
+    void recycle(const sp<GraphicBuffer>& buffer, const sp<Fence>& fence);
+
+    // Releases every pooled buffer.
+    void clear();
+
+    size_t getPooledCount() const;
+    size_t getPooledBytes() const;
+    void dump(std::string& result) const;
+
+private:
+    struct Entry {
+        sp<GraphicBuffer> buffer;
+        sp<Fence> fence;
+        size_t size;
+    };
+
+    static size_t getBufferSize(const GraphicBuffer& buffer);
+
+    // Moves the entries over budget into |evicted|, to be released without
+    // the lock held.
+    void evictLocked(std::list<Entry>* evicted) REQUIRES(mMutex);
+
+    mutable std::mutex mMutex;
+    size_t mBudgetBytes GUARDED_BY(mMutex);
+    size_t mPooledBytes GUARDED_BY(mMutex) = 0;
+    // Most recently pooled first.
+    std::list<Entry> mEntries GUARDED_BY(mMutex);
+    uint64_t mReuseCount GUARDED_BY(mMutex) = 0;
+    uint64_t mEvictionCount GUARDED_BY(mMutex) = 0;
+};
+
+}; // namespace android
+
+#endif // ANDROID_UI_GRAPHIC_BUFFER_POOL_H
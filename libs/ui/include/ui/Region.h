@@ -170,6 +170,12 @@ private:
     static void boolean_operation(uint32_t op, Region& dst,
             const Region& lhs, const Rect& rhs);
 
+    // Computes the operation directly when both sides are single rects and
+    // so is the result, which covers most of the regions SurfaceFlinger
+    // handles. Returns false when the general algorithm is needed.
+    static bool rect_boolean_operation(uint32_t op, Region& dst,
+            const Rect& lhs, const Rect& rhs);
+
     static void translate(Region& reg, int dx, int dy);
     static void translate(Region& dst, const Region& reg, int dx, int dy);
 
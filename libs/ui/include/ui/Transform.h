@@ -112,6 +112,7 @@ private:
     enum { UNKNOWN_TYPE = 0x80000000 };
 
     uint32_t type() const;
+    FloatRect transformBounds(float left, float top, float right, float bottom) const;
     static bool absIsOne(float f);
     static bool isZero(float f);
 
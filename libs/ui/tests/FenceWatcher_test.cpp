@@ -0,0 +1,130 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FenceWatcherTest"
+
+#include <ui/FenceTime.h>
+#include <ui/FenceWatcher.h>
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+
+namespace android {
+
+// A pipe stands in for a sync file: epoll sees it become readable once
+// written to, while the sync_file_info ioctl always fails on it. So a
+// polled FenceTime reads SIGNAL_TIME_INVALID straight away, and a watched
+// one stays pending until the watcher records the result.
+class FenceWatcherTest : public testing::Test {
+protected:
+    void SetUp() override {
+        int fds[2];
+        ASSERT_EQ(0, pipe(fds));
+        mReadFd = fds[0];
+        mWriteFd.reset(fds[1]);
+    }
+
+    sp<Fence> makeFence() { return new Fence(base::unique_fd(dup(mReadFd))); }
+
+    void signal() {
+        const char byte = 0;
+        ASSERT_EQ(1, write(mWriteFd, &byte, 1));
+    }
+
+    static bool waitForSignalTime(FenceTime& fenceTime) {
+        for (int i = 0; i < 1000; i++) {
+            if (fenceTime.getCachedSignalTime() != Fence::SIGNAL_TIME_PENDING) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    }
+
+    void TearDown() override { close(mReadFd); }
+
+    int mReadFd = -1;
+    base::unique_fd mWriteFd;
+};
+
+TEST_F(FenceWatcherTest, unwatchedFenceIsPolled) {
+    auto fenceTime = std::make_shared<FenceTime>(makeFence());
+    EXPECT_EQ(Fence::SIGNAL_TIME_INVALID, fenceTime->getSignalTime());
+}
+
+TEST_F(FenceWatcherTest, watchedFenceIsNotPolledUntilReady) {
+    FenceWatcher watcher;
+    auto fenceTime = std::make_shared<FenceTime>(makeFence());
+    watcher.watch(fenceTime);
+    EXPECT_EQ(1u, watcher.getWatchedCount());
+    EXPECT_EQ(Fence::SIGNAL_TIME_PENDING, fenceTime->getSignalTime());
+
+    signal();
+    ASSERT_TRUE(waitForSignalTime(*fenceTime));
+    EXPECT_EQ(Fence::SIGNAL_TIME_INVALID, fenceTime->getSignalTime());
+    EXPECT_EQ(0u, watcher.getWatchedCount());
+}
+
+TEST_F(FenceWatcherTest, fenceTimesShareAFence) {
+    FenceWatcher watcher;
+    const sp<Fence> fence = makeFence();
+    auto first = std::make_shared<FenceTime>(fence);
+    auto second = std::make_shared<FenceTime>(fence);
+    watcher.watch(first);
+    watcher.watch(second);
+    EXPECT_EQ(1u, watcher.getWatchedCount());
+
+    signal();
+    EXPECT_TRUE(waitForSignalTime(*first));
+    EXPECT_TRUE(waitForSignalTime(*second));
+}
+
+TEST_F(FenceWatcherTest, fencesWithoutFdsAreNotWatched) {
+    FenceWatcher watcher;
+    watcher.watch(FenceTime::NO_FENCE);
+    watcher.watch(std::make_shared<FenceTime>(nsecs_t(1)));
+    EXPECT_EQ(0u, watcher.getWatchedCount());
+}
+
+TEST_F(FenceWatcherTest, destroyingTheWatcherFallsBackToPolling) {
+    auto fenceTime = std::make_shared<FenceTime>(makeFence());
+    {
+        FenceWatcher watcher;
+        watcher.watch(fenceTime);
+        EXPECT_EQ(Fence::SIGNAL_TIME_PENDING, fenceTime->getSignalTime());
+    }
+    EXPECT_EQ(Fence::SIGNAL_TIME_INVALID, fenceTime->getSignalTime());
+}
+
+TEST_F(FenceWatcherTest, timelineHandsFencesToItsWatcher) {
+    auto watcher = std::make_shared<FenceWatcher>();
+    FenceTimeline timeline;
+    timeline.setWatcher(watcher);
+    auto fenceTime = std::make_shared<FenceTime>(makeFence());
+    timeline.push(fenceTime);
+    EXPECT_EQ(1u, watcher->getWatchedCount());
+
+    timeline.updateSignalTimes();
+    EXPECT_EQ(Fence::SIGNAL_TIME_PENDING, fenceTime->getCachedSignalTime());
+
+    signal();
+    EXPECT_TRUE(waitForSignalTime(*fenceTime));
+}
+
+} // namespace android
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "GraphicBufferPoolTest"
+
+#include <ui/GraphicBufferPool.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+namespace {
+
+constexpr uint32_t kTestWidth = 64;
+constexpr uint32_t kTestHeight = 32;
+constexpr PixelFormat kTestFormat = PIXEL_FORMAT_RGBA_8888;
+constexpr uint32_t kTestLayerCount = 1;
+constexpr uint64_t kTestUsage = GraphicBuffer::USAGE_SW_WRITE_OFTEN;
+
+// Enough for a few test buffers, whatever stride gralloc picks.
+constexpr size_t kTestBudget = 1024 * 1024;
+
+sp<GraphicBuffer> allocate(uint32_t width = kTestWidth, uint32_t height = kTestHeight) {
+    return new GraphicBuffer(width, height, kTestFormat, kTestLayerCount, kTestUsage,
+                             std::string("GraphicBufferPoolTest"));
+}
+
+} // namespace
+
+class GraphicBufferPoolTest : public testing::Test {
+protected:
+    sp<GraphicBuffer> take(GraphicBufferPool& pool, uint32_t width = kTestWidth,
+                           uint32_t height = kTestHeight) {
+        sp<Fence> fence;
+        return pool.take(width, height, kTestFormat, kTestLayerCount, kTestUsage, &fence);
+    }
+};
+
+TEST_F(GraphicBufferPoolTest, ReusesMatchingBuffer) {
+    GraphicBufferPool pool(kTestBudget);
+    sp<GraphicBuffer> buffer = allocate();
+    ASSERT_EQ(NO_ERROR, buffer->initCheck());
+
+    const sp<Fence> fence = new Fence(-1);
+    pool.recycle(buffer, fence);
+    EXPECT_EQ(1u, pool.getPooledCount());
+
+    sp<Fence> outFence;
+    EXPECT_EQ(buffer, pool.take(kTestWidth, kTestHeight, kTestFormat, kTestLayerCount,
+                                kTestUsage, &outFence));
+    EXPECT_EQ(fence, outFence);
+    EXPECT_EQ(0u, pool.getPooledCount());
+    EXPECT_EQ(0u, pool.getPooledBytes());
+}
+
+TEST_F(GraphicBufferPoolTest, OnlyReusesExactMatches) {
+    GraphicBufferPool pool(kTestBudget);
+    sp<GraphicBuffer> buffer = allocate();
+    ASSERT_EQ(NO_ERROR, buffer->initCheck());
+    pool.recycle(buffer, Fence::NO_FENCE);
+
+    sp<Fence> fence;
+    EXPECT_EQ(nullptr, take(pool, kTestHeight, kTestWidth));
+    EXPECT_EQ(nullptr, pool.take(kTestWidth, kTestHeight, PIXEL_FORMAT_RGB_565,
+                                 kTestLayerCount, kTestUsage, &fence));
+    EXPECT_EQ(nullptr, pool.take(kTestWidth, kTestHeight, kTestFormat, kTestLayerCount,
+                                 kTestUsage | GraphicBuffer::USAGE_HW_TEXTURE, &fence));
+    EXPECT_EQ(1u, pool.getPooledCount());
+}
+
+TEST_F(GraphicBufferPoolTest, ZeroBudgetDisablesPool) {
+    GraphicBufferPool pool;
+    sp<GraphicBuffer> buffer = allocate();
+    ASSERT_EQ(NO_ERROR, buffer->initCheck());
+    pool.recycle(buffer, Fence::NO_FENCE);
+    EXPECT_EQ(0u, pool.getPooledCount());
+    EXPECT_EQ(nullptr, take(pool));
+}
+
+TEST_F(GraphicBufferPoolTest, EvictsLeastRecentlyPooled) {
+    GraphicBufferPool pool(kTestBudget);
+    sp<GraphicBuffer> first = allocate(kTestWidth, kTestHeight);
+    sp<GraphicBuffer> second = allocate(kTestHeight, kTestWidth);
+    ASSERT_EQ(NO_ERROR, first->initCheck());
+    ASSERT_EQ(NO_ERROR, second->initCheck());
+    pool.recycle(first, Fence::NO_FENCE);
+    const size_t firstBytes = pool.getPooledBytes();
+    pool.recycle(second, Fence::NO_FENCE);
+    ASSERT_EQ(2u, pool.getPooledCount());
+
+    // Only room for the second buffer is left.
+    pool.setBudget(pool.getPooledBytes() - firstBytes);
+    EXPECT_EQ(1u, pool.getPooledCount());
+    EXPECT_EQ(nullptr, take(pool, kTestWidth, kTestHeight));
+    EXPECT_EQ(second, take(pool, kTestHeight, kTestWidth));
+}
+
+TEST_F(GraphicBufferPoolTest, ClearReleasesEverything) {
+    GraphicBufferPool pool(kTestBudget);
+    sp<GraphicBuffer> buffer = allocate();
+    ASSERT_EQ(NO_ERROR, buffer->initCheck());
+    pool.recycle(buffer, Fence::NO_FENCE);
+    pool.clear();
+    EXPECT_EQ(0u, pool.getPooledCount());
+    EXPECT_EQ(0u, pool.getPooledBytes());
+}
+
+} // namespace android
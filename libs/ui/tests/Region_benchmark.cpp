@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+#include <ui/Transform.h>
+
+#include <dlfcn.h>
+
+#include <atomic>
+#include <vector>
+
+// Counts heap allocations so benchmarks can report them next to the time,
+// which is where FatVector sizing changes show up. FatVector goes straight
+// to malloc() when it outgrows its inline storage, so that is what gets
+// interposed rather than operator new, which ends up in malloc() anyway.
+static std::atomic<uint64_t> gAllocations(0);
+
+extern "C" void* malloc(size_t size) {
+    using Malloc = void* (*)(size_t);
+    static Malloc realMalloc = reinterpret_cast<Malloc>(dlsym(RTLD_NEXT, "malloc"));
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    return realMalloc(size);
+}
+
+namespace android {
+
+// Reports the mallocs made since |start| as a per iteration average.
+static void reportAllocations(benchmark::State& state, uint64_t start) {
+    state.counters["mallocs"] =
+            benchmark::Counter(static_cast<double>(gAllocations.load() - start),
+                               benchmark::Counter::kAvgIterations);
+}
+
+static const Rect kDisplay(0, 0, 1080, 2340);
+static const Rect kStatusBar(0, 0, 1080, 96);
+static const Rect kNavigationBar(0, 2214, 1080, 2340);
+static const Rect kDialog(90, 800, 990, 1540);
+
+// --- One rect against another, as for most layers ---
+
+static void BM_RectIntersect(benchmark::State& state) {
+    const Region display(kDisplay);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(display.intersect(kDialog));
+    }
+}
+BENCHMARK(BM_RectIntersect);
+
+static void BM_RectMerge(benchmark::State& state) {
+    const Region statusBar(kStatusBar);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(statusBar.merge(Rect(0, 96, 1080, 2214)));
+    }
+}
+BENCHMARK(BM_RectMerge);
+
+static void BM_RectSubtractEdge(benchmark::State& state) {
+    const Region display(kDisplay);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(display.subtract(kNavigationBar));
+    }
+}
+BENCHMARK(BM_RectSubtractEdge);
+
+static void BM_RectSubtractHole(benchmark::State& state) {
+    const Region display(kDisplay);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(display.subtract(kDialog));
+    }
+}
+BENCHMARK(BM_RectSubtractHole);
+
+// --- A stack of windows, as in computeVisibleRegions() ---
+
+static void BM_OcclusionStack(benchmark::State& state) {
+    std::vector<Rect> windows;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        const int inset = static_cast<int>(i % 16) * 24;
+        windows.emplace_back(inset, 96 + inset, 1080 - inset, 2214 - inset);
+    }
+    const uint64_t allocations = gAllocations.load();
+    for (auto _ : state) {
+        Region aboveOpaque;
+        for (const Rect& window : windows) {
+            Region visible(window);
+            visible.subtractSelf(aboveOpaque);
+            aboveOpaque.orSelf(window);
+            benchmark::DoNotOptimize(visible);
+        }
+    }
+    reportAllocations(state, allocations);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_OcclusionStack)->Arg(4)->Arg(16)->Arg(64);
+
+// --- Regions of many rects, e.g. dirty or transparent regions ---
+
+static void BM_MultiRectMerge(benchmark::State& state) {
+    Region lhs, rhs;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        const int y = static_cast<int>(i) * 32;
+        lhs.orSelf(Rect(0, y, 540, y + 16));
+        rhs.orSelf(Rect(270, y + 8, 1080, y + 24));
+    }
+    const uint64_t allocations = gAllocations.load();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(lhs.merge(rhs));
+    }
+    reportAllocations(state, allocations);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MultiRectMerge)->Arg(4)->Arg(16)->Arg(64);
+
+static void BM_MultiRectTranslate(benchmark::State& state) {
+    Region region;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        const int y = static_cast<int>(i) * 32;
+        region.orSelf(Rect(0, y, 540, y + 16));
+    }
+    const uint64_t allocations = gAllocations.load();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(region.translate(12, -34));
+    }
+    reportAllocations(state, allocations);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MultiRectTranslate)->Arg(4)->Arg(16)->Arg(64);
+
+static void BM_MultiRectRotate90(benchmark::State& state) {
+    // A checkerboard, so no two rects coalesce once rotated.
+    Region region;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        const int x = static_cast<int>(i % 8) * 64;
+        const int y = static_cast<int>(i / 8) * 32;
+        region.orSelf(Rect(x, y, x + 32, y + 16));
+    }
+    const ui::Transform rotation(ui::Transform::ROT_90, kDisplay.width(), kDisplay.height());
+    const uint64_t allocations = gAllocations.load();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(rotation.transform(region));
+    }
+    reportAllocations(state, allocations);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MultiRectRotate90)->Arg(4)->Arg(16)->Arg(64);
+
+// --- Whole frames replayed ---
+
+// One layer of a frame, as SurfaceFlinger sees it when computing visible
+// regions: its bounds in layer space, where it sits on the display, and
+// the parts of it that are transparent.
+struct FrameLayer {
+    Rect bounds;
+    int x;
+    int y;
+    bool opaque;
+    std::vector<Rect> transparent;
+};
+
+// Frames modelled on common phone scenes, front to back.
+static const std::vector<std::vector<FrameLayer>> kFrames = {
+        // Launcher: status and navigation bars over a wallpaper, with the
+        // icons and widgets of the home screen on a transparent window.
+        {
+                {Rect(0, 0, 1080, 96), 0, 0, false, {}},
+                {Rect(0, 0, 1080, 126), 0, 2214, false, {}},
+                {Rect(0, 0, 1080, 2340),
+                 0,
+                 0,
+                 false,
+                 {Rect(0, 96, 1080, 400), Rect(0, 720, 1080, 1200), Rect(0, 1400, 1080, 1900)}},
+                {Rect(0, 0, 2160, 2340), -540, 0, true, {}},
+        },
+        // An app with a keyboard up and a toast above it.
+        {
+                {Rect(0, 0, 1080, 96), 0, 0, false, {}},
+                {Rect(0, 0, 560, 120), 260, 1300, false, {}},
+                {Rect(0, 0, 1080, 900), 0, 1440, true, {}},
+                {Rect(0, 0, 1080, 2244), 0, 96, true, {}},
+        },
+        // A dialog with rounded corners over a dimmed app.
+        {
+                {Rect(0, 0, 1080, 96), 0, 0, false, {}},
+                {Rect(0, 0, 900, 740),
+                 90,
+                 800,
+                 true,
+                 {Rect(0, 0, 24, 24), Rect(876, 0, 900, 24), Rect(0, 716, 24, 740),
+                  Rect(876, 716, 900, 740)}},
+                {Rect(0, 0, 1080, 2340), 0, 0, false, {}},
+                {Rect(0, 0, 1080, 2340), 0, 0, true, {}},
+        },
+};
+
+// The region work computeVisibleRegions() and the dirty region tracking do
+// for each layer of a frame, followed by the T-junction free region the
+// renderer is given.
+static void replayFrame(const std::vector<FrameLayer>& layers) {
+    Region aboveOpaque;
+    Region aboveCovered;
+    Region dirty;
+    for (const FrameLayer& layer : layers) {
+        Region visible(layer.bounds);
+        visible.translateSelf(layer.x, layer.y);
+        visible.andSelf(kDisplay);
+        const Region covered(aboveCovered.intersect(visible));
+        aboveCovered.orSelf(visible);
+        visible.subtractSelf(aboveOpaque);
+        if (layer.opaque) {
+            aboveOpaque.orSelf(visible);
+        }
+        for (const Rect& transparent : layer.transparent) {
+            visible.subtractSelf(transparent + Point(layer.x, layer.y));
+        }
+        dirty.orSelf(visible);
+        benchmark::DoNotOptimize(covered);
+    }
+    benchmark::DoNotOptimize(Region::createTJunctionFreeRegion(dirty));
+}
+
+static void BM_ReplayFrame(benchmark::State& state) {
+    const auto& layers = kFrames[state.range(0)];
+    const uint64_t allocations = gAllocations.load();
+    for (auto _ : state) {
+        replayFrame(layers);
+    }
+    reportAllocations(state, allocations);
+    state.SetItemsProcessed(state.iterations() * layers.size());
+}
+BENCHMARK(BM_ReplayFrame)->DenseRange(0, 2);
+
+static void BM_TJunctionFree(benchmark::State& state) {
+    // A staircase has a T-junction at every step.
+    Region region;
+    for (int64_t i = 0; i < state.range(0); i++) {
+        const int step = static_cast<int>(i) * 16;
+        region.orSelf(Rect(step, step, step + 256, step + 32));
+    }
+    const uint64_t allocations = gAllocations.load();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Region::createTJunctionFreeRegion(region));
+    }
+    reportAllocations(state, allocations);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TJunctionFree)->Arg(4)->Arg(16)->Arg(64);
+
+} // namespace android
+
+BENCHMARK_MAIN();
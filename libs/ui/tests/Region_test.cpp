@@ -17,6 +17,7 @@
 #define LOG_TAG "RegionTest"
 
 #include <stdlib.h>
+#include <vector>
 #include <ui/Region.h>
 #include <ui/Rect.h>
 #include <gtest/gtest.h>
@@ -167,5 +168,71 @@ TEST_F(RegionTest, EqualsToSelf) {
     ASSERT_TRUE(touchableRegion.contains(50, 50));
 }
 
+TEST_F(RegionTest, SingleRectOperationsMatchGeneralAlgorithm) {
+    // Every rect with corners on a small grid, including empty ones.
+    std::vector<Rect> rects;
+    for (int left = 0; left < 4; left++) {
+        for (int right = left; right < 4; right++) {
+            for (int top = 0; top < 4; top++) {
+                for (int bottom = top; bottom < 4; bottom++) {
+                    rects.emplace_back(left, top, right, bottom);
+                }
+            }
+        }
+    }
+
+    // Adding a far away rect, and taking it away again afterwards, sends the
+    // same operation through the general algorithm.
+    const Rect far(100, 100, 101, 101);
+    for (const Rect& a : rects) {
+        for (const Rect& b : rects) {
+            const Region general(Region(a).merge(far));
+            EXPECT_TRUE(Region(a).merge(b).hasSameRects(general.merge(b).subtract(far)));
+            EXPECT_TRUE(Region(a).mergeExclusive(b).hasSameRects(
+                    general.mergeExclusive(b).subtract(far)));
+            EXPECT_TRUE(Region(a).intersect(b).hasSameRects(general.intersect(b)));
+            EXPECT_TRUE(Region(a).subtract(b).hasSameRects(general.subtract(b).subtract(far)));
+            EXPECT_TRUE(Region(a).subtract(Region(b)).hasSameRects(Region(a).subtract(b)));
+        }
+    }
+}
+
+TEST_F(RegionTest, BoundsDecidedOperationsMatchPixels) {
+    Region lShape(Rect(2, 2, 6, 4));
+    lShape.orSelf(Rect(2, 4, 4, 6));
+    Region twoSquares(Rect(2, 2, 4, 4));
+    twoSquares.orSelf(Rect(6, 6, 8, 8));
+    const std::vector<Region> regions = {lShape, twoSquares};
+
+    const std::vector<Rect> rects = {
+            Rect(0, 0, 10, 10), // contains both regions
+            Rect(9, 9, 10, 10), // disjoint from both
+            Rect(0, 0, 2, 10),  // touches the left edge of both
+            Rect(3, 3, 7, 7),   // overlaps both
+            Rect(4, 4),         // empty
+    };
+
+    for (const Region& region : regions) {
+        for (const Rect& rect : rects) {
+            const Region andRegion(region.intersect(rect));
+            const Region nandRegion(region.subtract(rect));
+            const Region rectAndRegion(Region(rect).intersect(region));
+            const Region rectNandRegion(Region(rect).subtract(region));
+            EXPECT_TRUE(andRegion.hasSameRects(region.intersect(Region(rect))));
+            EXPECT_TRUE(nandRegion.hasSameRects(region.subtract(Region(rect))));
+            for (int y = 0; y < 10; y++) {
+                for (int x = 0; x < 10; x++) {
+                    const bool inRegion = region.contains(x, y);
+                    const bool inRect = Region(rect).contains(x, y);
+                    EXPECT_EQ(inRegion && inRect, andRegion.contains(x, y));
+                    EXPECT_EQ(inRegion && !inRect, nandRegion.contains(x, y));
+                    EXPECT_EQ(inRegion && inRect, rectAndRegion.contains(x, y));
+                    EXPECT_EQ(inRect && !inRegion, rectNandRegion.contains(x, y));
+                }
+            }
+        }
+    }
+}
+
 }; // namespace android
 
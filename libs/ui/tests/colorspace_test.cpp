@@ -180,4 +180,17 @@ TEST_F(ColorSpaceTest, LUT) {
 
 }
 
+TEST_F(ColorSpaceTest, CachedLUT) {
+    auto lut = ColorSpace::getLUT(17, ColorSpace::sRGB(), ColorSpace::AdobeRGB());
+    ASSERT_TRUE(lut != nullptr);
+    EXPECT_EQ(lut, ColorSpace::getLUT(17, ColorSpace::sRGB(), ColorSpace::AdobeRGB()));
+    EXPECT_NE(lut, ColorSpace::getLUT(17, ColorSpace::sRGB(), ColorSpace::ProPhotoRGB()));
+    EXPECT_NE(lut, ColorSpace::getLUT(9, ColorSpace::sRGB(), ColorSpace::AdobeRGB()));
+
+    auto expected = ColorSpace::createLUT(17, ColorSpace::sRGB(), ColorSpace::AdobeRGB());
+    for (size_t i = 0; i < 17 * 17 * 17; i++) {
+        EXPECT_EQ(expected[i], lut[i]);
+    }
+}
+
 }; // namespace android
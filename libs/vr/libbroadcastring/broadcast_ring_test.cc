@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <memory>
 #include <thread>  // NOLINT
+#include <vector>
 #include <sys/mman.h>
 
 #include <gtest/gtest.h>
@@ -69,6 +70,7 @@ struct Traits {
   static constexpr uint32_t kMaxReservedRecords = MaxReserved;
   static constexpr uint32_t kMinAvailableRecords = MinAvailable;
   static constexpr uint32_t kMinRecordCount = MaxReserved + MinAvailable;
+  static uint32_t SlotSize() { return sizeof(RecordType); }
 };
 
 template <typename Record, bool StaticSize = false, uint32_t MaxReserved = 1,
@@ -87,6 +89,15 @@ struct TraitsStatic
   static uint32_t MinCount() { return StaticCount; }
 };
 
+template <typename Record, uint32_t SlotAlignment, bool StaticSize = false>
+struct TraitsPadded : public TraitsDynamic<Record, StaticSize> {
+  using Ring = BroadcastRing<Record, TraitsPadded>;
+  static constexpr uint32_t kSlotAlignment = SlotAlignment;
+  static uint32_t SlotSize() {
+    return (sizeof(Record) + SlotAlignment - 1) & ~(SlotAlignment - 1);
+  }
+};
+
 using Dynamic_8_NxM = TraitsDynamic<Sized<8>>;
 using Dynamic_16_NxM = TraitsDynamic<Sized<16>>;
 using Dynamic_32_NxM = TraitsDynamic<Sized<32>>;
@@ -103,6 +114,10 @@ using Static_16_16x16 = TraitsStatic<Sized<16>, 16>;
 using Static_16_16x32 = TraitsStatic<Sized<16>, 32>;
 using Static_32_Nx8 = TraitsStatic<Sized<32>, 8, false>;
 
+using Padded_16_64_NxM = TraitsPadded<Sized<16>, 64>;
+using Padded_16_64_64xM = TraitsPadded<Sized<16>, 64, true>;
+using Padded_96_64_NxM = TraitsPadded<Sized<96>, 64>;
+
 using TraitsList = ::testing::Types<Dynamic_8_NxM,           //
                                     Dynamic_16_NxM,          //
                                     Dynamic_32_NxM,          //
@@ -116,7 +131,10 @@ using TraitsList = ::testing::Types<Dynamic_8_NxM,           //
                                     Static_16_16x8,          //
                                     Static_16_16x16,         //
                                     Static_16_16x32,         //
-                                    Static_32_Nx8>;
+                                    Static_32_Nx8,           //
+                                    Padded_16_64_NxM,        //
+                                    Padded_16_64_64xM,       //
+                                    Padded_96_64_NxM>;
 
 }  // namespace
 
@@ -131,7 +149,8 @@ TYPED_TEST(BroadcastRingTest, Geometry) {
   Ring ring;
   auto mmap = CreateRing(&ring, Ring::Traits::MinCount());
   EXPECT_EQ(Ring::Traits::MinCount(), ring.record_count());
-  EXPECT_EQ(sizeof(Record), ring.record_size());
+  EXPECT_EQ(Ring::Traits::SlotSize(), ring.record_size());
+  EXPECT_LE(sizeof(Record), ring.record_size());
 }
 
 TYPED_TEST(BroadcastRingTest, PutGet) {
@@ -286,6 +305,42 @@ TYPED_TEST(BroadcastRingTest, FillTwice) {
   }
 }
 
+TYPED_TEST(BroadcastRingTest, GetNewestBatch) {
+  using Record = typename TypeParam::Record;
+  using Ring = typename TypeParam::Ring;
+  Ring ring;
+  auto mmap = CreateRing(&ring, Ring::Traits::MinCount());
+  const uint32_t next_sequence_at_start = ring.GetNextSequence();
+  std::vector<Record> records(ring.record_count() + 1);
+  {
+    uint32_t sequence = next_sequence_at_start;
+    EXPECT_EQ(0U, ring.GetNewest(&sequence, records.data(), records.size()));
+    EXPECT_EQ(next_sequence_at_start, sequence);
+  }
+  for (uint32_t i = 0; i < 2 * ring.record_count(); ++i) {
+    ring.Put(Record(FillChar(i)));
+
+    const uint32_t newest_sequence = next_sequence_at_start + i;
+    const uint32_t records_available = std::min(i + 1, ring.record_count());
+    for (uint32_t max_count = 1; max_count <= records.size(); ++max_count) {
+      const uint32_t expected_count = std::min(max_count, records_available);
+      uint32_t sequence = next_sequence_at_start;
+      EXPECT_EQ(expected_count,
+                ring.GetNewest(&sequence, records.data(), max_count));
+      EXPECT_EQ(newest_sequence - expected_count + 1, sequence);
+      for (uint32_t j = 0; j < expected_count; ++j) {
+        EXPECT_EQ(Record(FillChar(i - expected_count + 1 + j)), records[j]);
+      }
+    }
+
+    {
+      uint32_t sequence = newest_sequence + 1;
+      EXPECT_EQ(0U, ring.GetNewest(&sequence, records.data(), records.size()));
+      EXPECT_EQ(newest_sequence + 1, sequence);
+    }
+  }
+}
+
 TYPED_TEST(BroadcastRingTest, Import) {
   using Record = typename TypeParam::Record;
   using Ring = typename TypeParam::Ring;
@@ -854,6 +909,44 @@ void ThreadedOverwriteTorture() {
   }
 }
 
+TEST(BroadcastRingTest, ThreadedGetNewestBatch) {
+  using Ring = Padded_16_64_NxM::Ring;
+  using Record = Ring::Record;
+  constexpr uint32_t kRecordCount = 8;
+  Ring out_ring;
+  auto out_mmap = CreateRing(&out_ring, kRecordCount);
+
+  std::atomic<bool> quit(false);
+  std::thread check_task([&quit, &out_mmap]() {
+    bool import_ok;
+    Ring in_ring;
+    std::tie(in_ring, import_ok) = Ring::Import(out_mmap.mmap(), out_mmap.size);
+    ASSERT_TRUE(import_ok);
+
+    Record records[kRecordCount / 2];
+    uint32_t sequence = in_ring.GetOldestSequence();
+    while (!std::atomic_load_explicit(&quit, std::memory_order_relaxed)) {
+      uint32_t count =
+          in_ring.GetNewest(&sequence, records, kRecordCount / 2);
+      for (uint32_t i = 0; i < count; ++i) {
+        // Each record is whole, and the batch has consecutive records.
+        ASSERT_EQ(Record(records[i].v[0]), records[i]);
+        ASSERT_EQ(FillChar(records[0].v[0] + i), records[i].v[0]);
+      }
+      sequence += count;
+    }
+  });
+
+  constexpr int kIterations = 100000;
+  for (int i = 0; i < kIterations; ++i) {
+    const Record record(FillChar(i));
+    out_ring.Put(record);
+  }
+
+  std::atomic_store_explicit(&quit, true, std::memory_order_relaxed);
+  check_task.join();
+}
+
 TEST(BroadcastRingTest, ThreadedOverwriteTortureSmall) {
   ThreadedOverwriteTorture<Dynamic_16_NxM_1plus0::Ring>();
 }
@@ -31,8 +31,23 @@ struct DefaultRingTraits {
 
   // Set this to the min number of records that must be readable.
   static constexpr uint32_t kMinAvailableRecords = 1;
+
+  // Set this to the cache line size to pad the header and each record to a
+  // multiple of it, so that readers of one record don't share a cache line
+  // with the writer updating the next one or the header. This changes the
+  // layout of the ring, so writers and readers must agree on it.
+  static constexpr uint32_t kSlotAlignment = 8;
 };
 
+// Gets BaseTraits::kSlotAlignment, defaulting to the packed layout for traits
+// that don't define it.
+template <typename BaseTraits, typename = void>
+struct RingSlotAlignment : std::integral_constant<uint32_t, 8> {};
+template <typename BaseTraits>
+struct RingSlotAlignment<BaseTraits,
+                         decltype(void(BaseTraits::kSlotAlignment))>
+    : std::integral_constant<uint32_t, BaseTraits::kSlotAlignment> {};
+
 // Nonblocking ring suitable for concurrent single-writer, multi-reader access.
 //
 // Readers never block the writer and thus this is a nondeterministically lossy
@@ -128,6 +143,12 @@ struct DefaultRingTraits {
 //         ProcessRecord(sequence, record);
 //         sequence++;
 //       }
+//     } else if (you_want_the_newest_few_records) {
+//       Record records[kMyBatchSize];
+//       uint32_t count = ring.GetNewest(&sequence, records, kMyBatchSize);
+//       for (uint32_t i = 0; i < count; ++i)
+//         ProcessRecord(sequence + i, records[i]);
+//       sequence += count;
 //     }
 //
 //     DoSomethingExpensiveOrBlocking();
@@ -151,6 +172,9 @@ class BroadcastRing {
     // If both record size and count are static then the overall size is too.
     static constexpr bool kIsStaticSize =
         BaseTraits::kUseStaticRecordSize && kUseStaticRecordCount;
+
+    static constexpr uint32_t kSlotAlignment =
+        RingSlotAlignment<BaseTraits>::value;
   };
 
   static constexpr bool IsPowerOfTwo(uint32_t size) {
@@ -167,6 +191,9 @@ class BroadcastRing {
                 "Static record count is not a power of two");
   static_assert(std::is_standard_layout<Record>::value,
                 "Record type must be standard layout");
+  static_assert(Traits::kSlotAlignment >= 8 &&
+                    IsPowerOfTwo(Traits::kSlotAlignment),
+                "Slot alignment is not a power of two of at least 8");
 
   BroadcastRing() {}
 
@@ -177,8 +204,8 @@ class BroadcastRing {
   static BroadcastRing Create(void* mmap, size_t mmap_size,
                               uint32_t record_count) {
     BroadcastRing ring(mmap);
-    CHECK(ring.ValidateGeometry(mmap_size, sizeof(Record), record_count));
-    ring.InitializeHeader(sizeof(Record), record_count);
+    CHECK(ring.ValidateGeometry(mmap_size, kSlotSize, record_count));
+    ring.InitializeHeader(kSlotSize, record_count);
     return ring;
   }
 
@@ -217,7 +244,7 @@ class BroadcastRing {
   //
   // Use this function for dynamically sized rings.
   static constexpr size_t MemorySize(uint32_t record_count) {
-    return sizeof(Header) + sizeof(Record) * record_count;
+    return kHeaderSize + kSlotSize * record_count;
   }
 
   // Calculates the space necessary for a statically sized ring.
@@ -246,11 +273,11 @@ class BroadcastRing {
   //
   // The header size has been taken into account.
   static uint32_t GetRecordCount(size_t mmap_size) {
-    if (mmap_size <= sizeof(Header)) {
+    if (mmap_size <= kHeaderSize) {
       return 0;
     }
     uint32_t count =
-        static_cast<uint32_t>((mmap_size - sizeof(Header)) / sizeof(Record));
+        static_cast<uint32_t>((mmap_size - kHeaderSize) / kSlotSize);
     return IsPowerOfTwo(count) ? count : (NextPowerOf2(count) / 2);
   }
 
@@ -369,6 +396,60 @@ class BroadcastRing {
     return Get(sequence, record);
   }
 
+  // Copies up to |max_count| of the newest available records with sequence at
+  // least |*sequence| to |records|, oldest first.
+  //
+  // Returns the number of records copied, which is zero if there is no recent
+  // enough record available.
+  //
+  // Updates |*sequence| with the sequence number of the first record returned.
+  // To get the record following the batch, add the returned count to it.
+  //
+  // The whole batch is checked for concurrent modification at once, with the
+  // same synchronization as Get().
+  uint32_t GetNewest(uint32_t* sequence /*inout*/, Record* records /*out*/,
+                     uint32_t max_count) const {
+    if (max_count == 0) return 0;
+
+    for (;;) {
+      uint32_t tail = std::atomic_load_explicit(&header_mmap()->tail,
+                                                std::memory_order_acquire);
+      uint32_t head = std::atomic_load_explicit(&header_mmap()->head,
+                                                std::memory_order_relaxed);
+
+      if (tail - head > record_count())
+        continue;  // Concurrent modification; re-try.
+
+      uint32_t first = *sequence;
+      if (first - head > tail - head)
+        first = head;  // Out of window, skip forward to first available.
+
+      if (tail - first > max_count)
+        first = tail - max_count;  // Only keep the newest records.
+
+      if (first == tail) return 0;  // No new records available.
+
+      const uint32_t count = tail - first;
+      for (uint32_t i = 0; i < count; ++i) {
+        GetRecordInternal(
+            record_mmap_reader(SequenceToIndex(first + i, record_count())),
+            &records[i]);
+      }
+
+      // NB: It is not sufficient to change this to a load-acquire of |head|.
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      uint32_t final_head = std::atomic_load_explicit(
+          &header_mmap()->head, std::memory_order_relaxed);
+
+      if (final_head - head > first - head)
+        continue;  // Concurrent modification; re-try.
+
+      *sequence = first;
+      return count;
+    }
+  }
+
   // Returns true if this instance has been created or imported.
   bool is_valid() const { return !!data_.mmap; }
 
@@ -412,6 +493,15 @@ class BroadcastRing {
   static_assert(kRecordAlignment % sizeof(StorageType) == 0,
                 "Bad record alignment");
 
+  static constexpr size_t AlignToSlot(size_t size) {
+    return (size + Traits::kSlotAlignment - 1) & ~(Traits::kSlotAlignment - 1);
+  }
+
+  // The space taken by the header and by each record, which are the sizes of
+  // Header and Record unless the traits pad them.
+  static constexpr size_t kHeaderSize = AlignToSlot(sizeof(Header));
+  static constexpr uint32_t kSlotSize = AlignToSlot(sizeof(Record));
+
   struct RecordStorage {
     // This is accessed with relaxed atomics to prevent data races on the
     // contained data, which would be undefined behavior.
@@ -448,7 +538,8 @@ class BroadcastRing {
   // Mmap area layout.
   //
   // Readers should not index directly into |records| as this is not valid when
-  // dynamic record sizes are used; use record_mmap_reader() instead.
+  // dynamic record sizes are used; use record_mmap_reader() instead. Records
+  // start at kHeaderSize, which is past |records| when the header is padded.
   struct Mmap {
     Header header;
     RecordStorage records[];
@@ -498,8 +589,8 @@ class BroadcastRing {
 
     size_t memory_size = record_count() * record_size();
     if (memory_size / record_size() != record_count()) return false;
-    if (memory_size + sizeof(Header) < memory_size) return false;
-    if (memory_size + sizeof(Header) > mmap_size) return false;
+    if (memory_size + kHeaderSize < memory_size) return false;
+    if (memory_size + kHeaderSize > mmap_size) return false;
 
     return true;
   }
@@ -599,18 +690,22 @@ class BroadcastRing {
   // Helpers to compute addresses in mmap area.
   Mmap* mmap() const { return data_.mmap; }
   Header* header_mmap() const { return &data_.mmap->header; }
+  char* records_mmap() const {
+    return reinterpret_cast<char*>(data_.mmap) + kHeaderSize;
+  }
   RecordStorage* record_mmap_writer(uint32_t index) const {
-    DCHECK_EQ(sizeof(Record), record_size());
-    return &data_.mmap->records[index];
+    DCHECK_EQ(kSlotSize, record_size());
+    return reinterpret_cast<RecordStorage*>(records_mmap() + index * kSlotSize);
   }
   RecordStorage* record_mmap_reader(uint32_t index) const {
     if (Traits::kUseStaticRecordSize) {
-      return &data_.mmap->records[index];
+      return reinterpret_cast<RecordStorage*>(records_mmap() +
+                                              index * kSlotSize);
     } else {
       // Calculate the location of a record in the ring without assuming that
-      // sizeof(Record) == record_size.
-      return reinterpret_cast<RecordStorage*>(
-          reinterpret_cast<char*>(data_.mmap->records) + index * record_size());
+      // kSlotSize == record_size.
+      return reinterpret_cast<RecordStorage*>(records_mmap() +
+                                              index * record_size());
     }
   }
 
@@ -623,7 +718,7 @@ class BroadcastRing {
   template <typename T = Traits>
   typename std::enable_if<T::kUseStaticRecordSize, uint32_t>::type
   record_size_internal() const {
-    return sizeof(Record);
+    return kSlotSize;
   }
 
   template <typename T = Traits>
@@ -4,14 +4,19 @@
 #include <binder/IPCThreadState.h>
 #include <binder/IServiceManager.h>
 #include <dvr/dvr_api.h>
+#include <gui/BLASTBufferQueue.h>
 #include <gui/BufferItem.h>
 #include <gui/BufferItemConsumer.h>
 #include <gui/Surface.h>
+#include <gui/SurfaceComposerClient.h>
+#include <gui/SurfaceControl.h>
 #include <private/dvr/epoll_file_descriptor.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <functional>
+#include <limits>
 #include <iostream>
 #include <thread>
 #include <vector>
@@ -43,6 +48,20 @@ static const int kQueueDepth = 2;  // We are double buffering for this test.
 static const size_t kMaxQueueCounts = 128;
 static const int kInvalidFence = -1;
 
+// Buffer counts and sizes (width and height, in pixels) exercised by the
+// RoundTrip benchmark.
+static const int kRoundTripBufferCounts[] = {2, 3, 4};
+static const int kRoundTripBufferSizes[] = {64, 512, 1024};
+
+// Describes the buffers of a Surface created by a BufferTransport. A zero
+// |buffer_count| leaves the number of buffers to the transport.
+struct SurfaceConfig {
+  uint32_t width = kBufferWidth;
+  uint32_t height = kBufferHeight;
+  uint32_t format = kBufferFormat;
+  size_t buffer_count = 0;
+};
+
 enum BufferTransportServiceCode {
   CREATE_BUFFER_QUEUE = IBinder::FIRST_CALL_TRANSACTION,
 };
@@ -139,9 +158,20 @@ class BufferTransport {
   virtual ~BufferTransport() {}
 
   virtual int Start() = 0;
-  virtual sp<Surface> CreateSurface() = 0;
+  virtual sp<Surface> CreateSurface(const SurfaceConfig& config) = 0;
 };
 
+// Applies |config| to the producer end of a Surface.
+static int ConfigureSurface(ANativeWindow* window,
+                            const SurfaceConfig& config) {
+  int ret = ANativeWindow_setBuffersGeometry(window, config.width,
+                                             config.height, config.format);
+  if (ret != 0 || config.buffer_count == 0) {
+    return ret;
+  }
+  return native_window_set_buffer_count(window, config.buffer_count);
+}
+
 // Binder-based buffer transport backend.
 //
 // On Start() a new process will be swapned to run a Binder server that
@@ -167,7 +197,7 @@ class BinderBufferTransport : public BufferTransport {
     return 0;
   }
 
-  sp<Surface> CreateSurface() override {
+  sp<Surface> CreateSurface(const SurfaceConfig& config) override {
     Parcel data;
     Parcel reply;
     int error = service_->transact(CREATE_BUFFER_QUEUE, data, &reply);
@@ -193,8 +223,10 @@ class BinderBufferTransport : public BufferTransport {
 
     // Set buffer dimension.
     ANativeWindow* window = static_cast<ANativeWindow*>(surface.get());
-    ANativeWindow_setBuffersGeometry(window, kBufferWidth, kBufferHeight,
-                                     kBufferFormat);
+    if (ConfigureSurface(window, config) != 0) {
+      LOG(ERROR) << "Failed to configure Binder-based Surface.";
+      return nullptr;
+    }
 
     return surface;
   }
@@ -203,6 +235,77 @@ class BinderBufferTransport : public BufferTransport {
   sp<IBinder> service_;
 };
 
+// BLAST-based buffer transport.
+//
+// On CreateSurface() a BufferState layer is created on the internal display,
+// and a BLASTBufferQueue is attached to it. The BLASTBufferQueue acquires the
+// buffers queued to the Surface in the benchmark process and hands them to
+// SurfaceFlinger in transactions; they are released once SurfaceFlinger is
+// done with them, which is paced by the display refresh.
+class BLASTBufferTransport : public BufferTransport {
+ public:
+  BLASTBufferTransport() {}
+
+  int Start() override {
+    client_ = new SurfaceComposerClient;
+    if (client_->initCheck() != NO_ERROR) {
+      LOG(ERROR) << "Failed to connect to SurfaceFlinger.";
+      return -EIO;
+    }
+
+    display_ = SurfaceComposerClient::getInternalDisplayToken();
+    if (display_ == nullptr) {
+      LOG(ERROR) << "Failed to get the internal display.";
+      return -ENODEV;
+    }
+
+    SurfaceComposerClient::Transaction()
+        .setDisplayLayerStack(display_, 0)
+        .apply();
+
+    LOG(INFO) << "Connected to SurfaceFlinger.";
+    return 0;
+  }
+
+  sp<Surface> CreateSurface(const SurfaceConfig& config) override {
+    sp<SurfaceControl> surface_control = client_->createSurface(
+        String8("BLASTBufferTransport"), config.width, config.height,
+        config.format, ISurfaceComposerClient::eFXSurfaceBufferState,
+        /*parent=*/nullptr);
+    if (surface_control == nullptr || !surface_control->isValid()) {
+      LOG(ERROR) << "Failed to create BufferState layer.";
+      return nullptr;
+    }
+
+    SurfaceComposerClient::Transaction()
+        .setLayerStack(surface_control, 0)
+        .setLayer(surface_control, std::numeric_limits<int32_t>::max())
+        .show(surface_control)
+        .apply();
+
+    sp<BLASTBufferQueue> queue =
+        new BLASTBufferQueue(surface_control, config.width, config.height);
+    sp<Surface> surface = new Surface(queue->getIGraphicBufferProducer(),
+                                      /*controlledByApp=*/true);
+
+    ANativeWindow* window = static_cast<ANativeWindow*>(surface.get());
+    if (ConfigureSurface(window, config) != 0) {
+      LOG(ERROR) << "Failed to configure BLAST-based Surface.";
+      return nullptr;
+    }
+
+    surface_controls_.push_back(surface_control);
+    buffer_queues_.push_back(queue);
+    return surface;
+  }
+
+ private:
+  sp<SurfaceComposerClient> client_;
+  sp<IBinder> display_;
+  std::vector<sp<SurfaceControl>> surface_controls_;
+  std::vector<sp<BLASTBufferQueue>> buffer_queues_;
+};
+
 class DvrApi {
  public:
   DvrApi() {
@@ -290,16 +393,17 @@ class BufferHubTransport : public BufferTransport {
     return 0;
   }
 
-  sp<Surface> CreateSurface() override {
-    auto new_queue = std::make_shared<BufferQueueHolder>();
+  sp<Surface> CreateSurface(const SurfaceConfig& config) override {
+    auto new_queue = std::make_shared<BufferQueueHolder>(config);
     if (!new_queue->IsReady()) {
       LOG(ERROR) << "Failed to create BufferHub-based BufferQueue.";
       return nullptr;
     }
 
-    // Set buffer dimension.
-    ANativeWindow_setBuffersGeometry(new_queue->GetSurface(), kBufferWidth,
-                                     kBufferHeight, kBufferFormat);
+    // Set buffer dimension. The number of buffers is the capacity the queue
+    // was created with.
+    ANativeWindow_setBuffersGeometry(new_queue->GetSurface(), config.width,
+                                     config.height, config.format);
 
     // Use the next position as buffer_queue index.
     uint32_t index = buffer_queues_.size();
@@ -320,11 +424,12 @@ class BufferHubTransport : public BufferTransport {
 
  private:
   struct BufferQueueHolder {
-    BufferQueueHolder() {
+    explicit BufferQueueHolder(const SurfaceConfig& config) {
       int ret = 0;
       ret = dvr_.Api().WriteBufferQueueCreate(
-          kBufferWidth, kBufferHeight, kBufferFormat, kBufferLayer,
-          kBufferUsage, 0, sizeof(DvrNativeBufferMetadata), &write_queue_);
+          config.width, config.height, config.format, kBufferLayer,
+          kBufferUsage, config.buffer_count, sizeof(DvrNativeBufferMetadata),
+          &write_queue_);
       if (ret < 0) {
         LOG(ERROR) << "Failed to create write buffer queue, ret=" << ret;
         return;
@@ -412,11 +517,13 @@ DvrApi BufferHubTransport::dvr_ = {};
 enum TransportType {
   kBinderBufferTransport,
   kBufferHubTransport,
+  kBLASTBufferTransport,
 };
 
-// Main test suite, which supports two transport backend: 1) BinderBufferQueue,
-// 2) BufferHubQueue. The test case drives the producer end of both transport
-// backend by queuing buffers into the buffer queue by using ANativeWindow API.
+// Main test suite, which supports three transport backends: 1)
+// BinderBufferQueue, 2) BufferHubQueue, 3) BLASTBufferQueue. The test case
+// drives the producer end of the transport backend by queuing buffers into the
+// buffer queue by using ANativeWindow API.
 class BufferTransportBenchmark : public ::benchmark::Fixture {
  public:
   void SetUp(State& state) override {
@@ -429,6 +536,9 @@ class BufferTransportBenchmark : public ::benchmark::Fixture {
         case kBufferHubTransport:
           transport_.reset(new BufferHubTransport);
           break;
+        case kBLASTBufferTransport:
+          transport_.reset(new BLASTBufferTransport);
+          break;
         default:
           CHECK(false) << "Unknown test case.";
           break;
@@ -441,10 +551,11 @@ class BufferTransportBenchmark : public ::benchmark::Fixture {
       LOG(INFO) << "Transport backend running, transport=" << transport << ".";
 
       // Create surfaces for each thread.
+      const SurfaceConfig config = GetSurfaceConfig(state);
       surfaces_.resize(state.threads);
       for (int i = 0; i < state.threads; i++) {
         // Common setup every thread needs.
-        surfaces_[i] = transport_->CreateSurface();
+        surfaces_[i] = transport_->CreateSurface(config);
         CHECK(surfaces_[i]);
 
         LOG(INFO) << "Surface initialized on thread " << i << ".";
@@ -461,6 +572,10 @@ class BufferTransportBenchmark : public ::benchmark::Fixture {
   }
 
  protected:
+  virtual SurfaceConfig GetSurfaceConfig(const State& /*state*/) {
+    return SurfaceConfig();
+  }
+
   std::unique_ptr<BufferTransport> transport_;
   std::vector<sp<Surface>> surfaces_;
 };
@@ -527,6 +642,125 @@ BENCHMARK_REGISTER_F(BufferTransportBenchmark, Producers)
     ->Ranges({{kBinderBufferTransport, kBufferHubTransport}})
     ->ThreadRange(1, 32);
 
+// Measures the dequeue->post->acquire->release round trip of each transport,
+// for a few buffer counts and buffer sizes.
+//
+// The consumer end releases every buffer as soon as it can, and the producer
+// keeps all the buffers of the queue in flight: once the queue is full,
+// dequeuing a buffer waits for the consumer to release the oldest one. The
+// round trip of a buffer is then the time between its dequeue and the dequeue
+// |buffer_count| frames later, which hands the same buffer back. The
+// distribution of these round trips is reported as counters, in microseconds.
+class BufferRoundTripBenchmark : public BufferTransportBenchmark {
+ protected:
+  SurfaceConfig GetSurfaceConfig(const State& state) override {
+    SurfaceConfig config;
+    config.buffer_count = state.range(1);
+    config.width = state.range(2);
+    config.height = state.range(2);
+    config.format = HAL_PIXEL_FORMAT_RGBA_8888;
+    return config;
+  }
+};
+
+// Returns the |percentile|th percentile of |samples|, which is reordered.
+static double Percentile(std::vector<double>* samples, double percentile) {
+  if (samples->empty()) {
+    return 0;
+  }
+  const size_t index = std::min(
+      samples->size() - 1,
+      static_cast<size_t>(percentile / 100 * samples->size()));
+  std::nth_element(samples->begin(), samples->begin() + index,
+                   samples->end());
+  return (*samples)[index];
+}
+
+BENCHMARK_DEFINE_F(BufferRoundTripBenchmark, RoundTrip)(State& state) {
+  CHECK(surfaces_[state.thread_index]);
+  ANativeWindow* window =
+      static_cast<ANativeWindow*>(surfaces_[state.thread_index].get());
+  ANativeWindow_Buffer buffer;
+  int32_t error = 0;
+
+  // Cycle through all the buffers once, so that they are allocated before the
+  // measurements start.
+  const int buffer_count = state.range(1);
+  for (int i = 0; i < buffer_count; i++) {
+    error = ANativeWindow_lock(window, &buffer, /*inOutDirtyBounds=*/nullptr);
+    CHECK_EQ(error, 0);
+    error = ANativeWindow_unlockAndPost(window);
+    CHECK_EQ(error, 0);
+  }
+
+  // The last |buffer_count| dequeue times, indexed by frame modulo
+  // |buffer_count|.
+  std::vector<std::chrono::steady_clock::time_point> dequeue_times(
+      buffer_count);
+  std::vector<double> round_trip_us;
+  double total_dequeue_us = 0;
+  double total_post_us = 0;
+  size_t frame = 0;
+
+  while (state.KeepRunning()) {
+    auto t1 = std::chrono::steady_clock::now();
+    {
+      ATRACE_NAME("GainBuffer");
+      error = ANativeWindow_lock(window, &buffer,
+                                 /*inOutDirtyBounds=*/nullptr);
+    }
+    CHECK_EQ(error, 0);
+    auto t2 = std::chrono::steady_clock::now();
+    {
+      ATRACE_NAME("PostBuffer");
+      error = ANativeWindow_unlockAndPost(window);
+    }
+    CHECK_EQ(error, 0);
+    auto t3 = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double, std::micro> dequeue = t2 - t1;
+    std::chrono::duration<double, std::micro> post = t3 - t2;
+    total_dequeue_us += dequeue.count();
+    total_post_us += post.count();
+
+    auto& dequeue_time = dequeue_times[frame % buffer_count];
+    if (frame >= static_cast<size_t>(buffer_count)) {
+      std::chrono::duration<double, std::micro> round_trip = t2 - dequeue_time;
+      round_trip_us.push_back(round_trip.count());
+    }
+    dequeue_time = t2;
+    frame++;
+  }
+  const double iterations = std::max<size_t>(state.iterations(), 1);
+  state.counters["dequeue_us"] = ::benchmark::Counter(
+      total_dequeue_us / iterations, ::benchmark::Counter::kAvgThreads);
+  state.counters["post_us"] = ::benchmark::Counter(
+      total_post_us / iterations, ::benchmark::Counter::kAvgThreads);
+  state.counters["round_trip_p50_us"] = ::benchmark::Counter(
+      Percentile(&round_trip_us, 50), ::benchmark::Counter::kAvgThreads);
+  state.counters["round_trip_p90_us"] = ::benchmark::Counter(
+      Percentile(&round_trip_us, 90), ::benchmark::Counter::kAvgThreads);
+  state.counters["round_trip_p99_us"] = ::benchmark::Counter(
+      Percentile(&round_trip_us, 99), ::benchmark::Counter::kAvgThreads);
+  state.counters["round_trip_max_us"] = ::benchmark::Counter(
+      Percentile(&round_trip_us, 100), ::benchmark::Counter::kAvgThreads);
+}
+
+static void RoundTripArguments(::benchmark::internal::Benchmark* benchmark) {
+  for (int transport :
+       {kBinderBufferTransport, kBufferHubTransport, kBLASTBufferTransport}) {
+    for (int buffer_count : kRoundTripBufferCounts) {
+      for (int buffer_size : kRoundTripBufferSizes) {
+        benchmark->Args({transport, buffer_count, buffer_size});
+      }
+    }
+  }
+}
+
+BENCHMARK_REGISTER_F(BufferRoundTripBenchmark, RoundTrip)
+    ->Unit(::benchmark::kMicrosecond)
+    ->Apply(RoundTripArguments);
+
 static void runBinderServer() {
   ProcessState::self()->setThreadPoolMaxThreadCount(0);
   ProcessState::self()->startThreadPool();
@@ -555,6 +789,11 @@ static void runBinderServer() {
 // To run bufferhub-based benchmark, use:
 // adb shell buffer_transport_benchmark \
 //   --benchmark_filter="BufferTransportBenchmark/ContinuousLoad/1/"
+//
+// To compare the round trips of the binder (0), bufferhub (1) and BLAST (2)
+// transports with 3 buffers of 512x512 pixels, use:
+// adb shell buffer_transport_benchmark \
+//   --benchmark_filter="BufferRoundTripBenchmark/RoundTrip/.*/3/512"
 int main(int argc, char** argv) {
   bool tracing_enabled = false;
 
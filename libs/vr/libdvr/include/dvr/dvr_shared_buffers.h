@@ -88,12 +88,40 @@ struct __attribute__((packed, aligned(16))) DvrVsyncPoseBuffer {
 static_assert(sizeof(DvrVsyncPoseBuffer) == 1152,
               "Unexpected size for DvrVsyncPoseBuffer");
 
+// This is a shared memory buffer holding the pose late latched by vrflinger.
+//
+// Right before it hands the layers of a frame to the hardware composer,
+// vrflinger copies the pose predicted for the vsync that frame will be
+// displayed at from the DvrVsyncPoseBuffer into this buffer. It is meant to be
+// bound as a uniform buffer by shaders that run at scanout, such as EDS, so
+// that they use a pose read as close to vsync as possible.
+//
+// Like DvrVsyncPoseBuffer, this buffer is unsynchronized: readers must check
+// that vsync_count is the vsync they expect.
+struct __attribute__((packed, aligned(16))) DvrLateLatchPoseBuffer {
+  // The pose predicted for vsync_count.
+  DvrPoseAsync pose;
+
+  // The vsync the pose was latched for.
+  uint32_t vsync_count;
+
+  // For 8 byte alignment.
+  uint32_t padding;
+
+  // When the pose was latched, in CLOCK_MONOTONIC nanoseconds.
+  int64_t latch_timestamp_ns;
+};
+
+static_assert(sizeof(DvrLateLatchPoseBuffer) == 144,
+              "Unexpected size for DvrLateLatchPoseBuffer");
+
 // The keys for the dvr global buffers.
 enum DvrGlobalBuffers : int32_t {
   kVsyncPoseBuffer = 1,
   kVsyncBuffer = 2,
   kSensorPoseBuffer = 3,
-  kVrFlingerConfigBufferKey = 4
+  kVrFlingerConfigBufferKey = 4,
+  kLateLatchPoseBuffer = 5
 };
 
 }  // namespace dvr
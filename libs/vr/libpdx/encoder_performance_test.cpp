@@ -3,6 +3,7 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <array>
 #include <chrono>
 #include <iomanip>
 #include <iostream>
@@ -447,6 +448,23 @@ int main(int /*argc*/, char** /*argv*/) {
                         std::move(int_vector));
   }
 
+  // Containers of types with a fixed serialized size compute their size
+  // without visiting the elements.
+  for (size_t len : {0, 1, 8, 64, 256}) {
+    std::vector<float> float_vector(len);
+    std::iota(float_vector.begin(), float_vector.end(), 0.5f);
+    test_runner.AddTest(GenerateContainerName("vector<float>", len),
+                        std::move(float_vector));
+    std::vector<double> double_vector(len);
+    std::iota(double_vector.begin(), double_vector.end(), 0.5);
+    test_runner.AddTest(GenerateContainerName("vector<double>", len),
+                        std::move(double_vector));
+  }
+  std::array<float, 64> float_array;
+  std::iota(float_array.begin(), float_array.end(), 0.5f);
+  test_runner.AddTest(GenerateContainerName("array<float>", float_array.size()),
+                      std::move(float_array));
+
   std::vector<std::string> vector_of_strings = {
       "012345678901234567890123456789", "012345678901234567890123456789",
       "012345678901234567890123456789", "012345678901234567890123456789",
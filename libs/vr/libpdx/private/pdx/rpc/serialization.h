@@ -199,6 +199,41 @@ class ErrorType {
 // Object Size //
 ///////////////////////////////////////////////////////////////////////////////
 
+// Determines whether every value of type T serializes to the same number of
+// bytes. |value| is that number, or zero when the size depends on the value.
+// Containers of these types compute their size without visiting each element,
+// and fixed size std::array and std::pair types have a compile-time size.
+template <typename T, typename = void>
+struct FixedSerializedSize : std::integral_constant<std::size_t, 0> {};
+template <>
+struct FixedSerializedSize<bool> : std::integral_constant<std::size_t, 1> {};
+template <>
+struct FixedSerializedSize<float>
+    : std::integral_constant<std::size_t, 1 + sizeof(float)> {};
+template <>
+struct FixedSerializedSize<double>
+    : std::integral_constant<std::size_t, 1 + sizeof(double)> {};
+template <typename T, std::size_t Size>
+struct FixedSerializedSize<
+    std::array<T, Size>,
+    typename std::enable_if<FixedSerializedSize<T>::value != 0>::type>
+    : std::integral_constant<std::size_t,
+                             GetEncodingSize(EncodeArrayType(Size)) +
+                                 Size * FixedSerializedSize<T>::value> {};
+template <typename T, typename U>
+struct FixedSerializedSize<
+    std::pair<T, U>,
+    typename std::enable_if<FixedSerializedSize<T>::value != 0 &&
+                            FixedSerializedSize<U>::value != 0>::type>
+    : std::integral_constant<std::size_t,
+                             GetEncodingSize(EncodeArrayType(2)) +
+                                 FixedSerializedSize<T>::value +
+                                 FixedSerializedSize<U>::value> {};
+
+template <typename T>
+using HasFixedSerializedSize =
+    std::integral_constant<bool, FixedSerializedSize<T>::value != 0>;
+
 inline constexpr std::size_t GetSerializedSize(const bool& b) {
   return GetEncodingSize(EncodeType(b));
 }
@@ -343,15 +378,38 @@ inline constexpr std::size_t GetSerializedSize(
   return GetEncodingSize(EncodeType(channel_handle)) + sizeof(std::int32_t);
 }
 
-// Overload for standard vector types.
-template <typename T, typename Allocator>
-inline std::size_t GetSerializedSize(const std::vector<T, Allocator>& v) {
+// Gets the size of array types by visiting each element.
+template <typename ArrayType>
+inline std::size_t GetArraySerializedSize(const ArrayType& v,
+                                          std::false_type) {
+  using T = typename ArrayType::value_type;
   return std::accumulate(v.begin(), v.end(), GetEncodingSize(EncodeType(v)),
                          [](const std::size_t& sum, const T& object) {
                            return sum + GetSerializedSize(object);
                          });
 }
 
+// Gets the size of array types with elements of fixed size in constant time.
+template <typename ArrayType>
+inline std::size_t GetArraySerializedSize(const ArrayType& v,
+                                          std::true_type) {
+  using T = typename ArrayType::value_type;
+  return GetEncodingSize(EncodeType(v)) +
+         v.size() * FixedSerializedSize<T>::value;
+}
+
+template <typename ArrayType>
+inline std::size_t GetArraySerializedSize(const ArrayType& v) {
+  return GetArraySerializedSize(
+      v, HasFixedSerializedSize<typename ArrayType::value_type>{});
+}
+
+// Overload for standard vector types.
+template <typename T, typename Allocator>
+inline std::size_t GetSerializedSize(const std::vector<T, Allocator>& v) {
+  return GetArraySerializedSize(v);
+}
+
 // Overload for standard map types.
 template <typename Key, typename T, typename Compare, typename Allocator>
 inline std::size_t GetSerializedSize(
@@ -380,19 +438,13 @@ inline std::size_t GetSerializedSize(
 // Overload for ArrayWrapper types.
 template <typename T>
 inline std::size_t GetSerializedSize(const ArrayWrapper<T>& v) {
-  return std::accumulate(v.begin(), v.end(), GetEncodingSize(EncodeType(v)),
-                         [](const std::size_t& sum, const T& object) {
-                           return sum + GetSerializedSize(object);
-                         });
+  return GetArraySerializedSize(v);
 }
 
 // Overload for std::array types.
 template <typename T, std::size_t Size>
 inline std::size_t GetSerializedSize(const std::array<T, Size>& v) {
-  return std::accumulate(v.begin(), v.end(), GetEncodingSize(EncodeType(v)),
-                         [](const std::size_t& sum, const T& object) {
-                           return sum + GetSerializedSize(object);
-                         });
+  return GetArraySerializedSize(v);
 }
 
 // Overload for std::pair.
@@ -1283,6 +1283,42 @@ TEST(SerializationTest, Variant) {
   // TODO(eieio): Add more serialization tests for Variant.
 }
 
+TEST(SerializationTest, FixedSerializedSize) {
+  Payload result;
+
+  static_assert(FixedSerializedSize<std::array<float, 4>>::value == 21,
+                "Unexpected size for std::array<float, 4>");
+  static_assert(
+      FixedSerializedSize<std::array<std::pair<bool, double>, 16>>::value ==
+          3 + 16 * 11,
+      "Unexpected size for std::array<std::pair<bool, double>, 16>");
+  static_assert(FixedSerializedSize<std::array<int, 4>>::value == 0,
+                "Integers don't have a fixed size");
+  static_assert(FixedSerializedSize<std::vector<float>>::value == 0,
+                "Vectors don't have a fixed size");
+
+  std::vector<float> v1((1 << 4), 1.0f);
+  Serialize(v1, &result);
+  EXPECT_EQ(result.Size(), GetSerializedSize(v1));
+  result.Clear();
+
+  std::vector<bool> v2((1 << 16), true);
+  Serialize(v2, &result);
+  EXPECT_EQ(result.Size(), GetSerializedSize(v2));
+  result.Clear();
+
+  std::array<std::pair<bool, double>, 16> a1{};
+  Serialize(a1, &result);
+  EXPECT_EQ(result.Size(), GetSerializedSize(a1));
+  result.Clear();
+
+  double d[] = {1.0, 2.0, 3.0};
+  ArrayWrapper<double> w1(d, 3);
+  Serialize(w1, &result);
+  EXPECT_EQ(result.Size(), GetSerializedSize(w1));
+  result.Clear();
+}
+
 TEST(DeserializationTest, bool) {
   Payload buffer;
   bool result = false;
@@ -86,13 +86,29 @@ Status<void> ReadAndDiscardData(const BorrowedHandle& socket_fd, size_t size) {
   return ErrorStatus(EIO);
 }
 
+void CopyToArena(PayloadArena* arena, const iovec* vector, size_t count) {
+  uint8_t* dest = arena->data();
+  for (size_t i = 0; i < count; i++) {
+    memcpy(dest, vector[i].iov_base, vector[i].iov_len);
+    dest += vector[i].iov_len;
+  }
+}
+
 Status<void> SendRequest(const BorrowedHandle& socket_fd,
                          TransactionState* transaction_state, int opcode,
                          const iovec* send_vector, size_t send_count,
-                         size_t max_recv_len) {
+                         size_t max_recv_len, PayloadArena* arena,
+                         bool send_arena) {
   size_t send_len = CountVectorSize(send_vector, send_count);
   InitRequest(&transaction_state->request, opcode, send_len, max_recv_len,
               false);
+  if (arena && send_arena)
+    transaction_state->request.payload_arena.push_back(arena->fd());
+  if (arena && arena->CanHold(send_len)) {
+    CopyToArena(arena, send_vector, send_count);
+    transaction_state->request.payload_in_arena = true;
+    send_len = 0;
+  }
   if (send_len == 0) {
     send_vector = nullptr;
     send_count = 0;
@@ -104,12 +120,27 @@ Status<void> SendRequest(const BorrowedHandle& socket_fd,
 Status<void> ReceiveResponse(const BorrowedHandle& socket_fd,
                              TransactionState* transaction_state,
                              const iovec* receive_vector, size_t receive_count,
-                             size_t max_recv_len) {
+                             size_t max_recv_len, const PayloadArena* arena) {
   auto status = ReceiveData(socket_fd, &transaction_state->response);
   if (!status)
     return status;
 
-  if (transaction_state->response.recv_len > 0) {
+  if (transaction_state->response.payload_in_arena) {
+    size_t recv_len = transaction_state->response.recv_len;
+    if (!arena || recv_len > arena->size())
+      return ErrorStatus(EIO);
+    const uint8_t* src = arena->data();
+    size_t size_remaining = recv_len;
+    for (size_t i = 0; i < receive_count && size_remaining > 0; i++) {
+      size_t size_to_copy = std::min(size_remaining, receive_vector[i].iov_len);
+      memcpy(receive_vector[i].iov_base, src, size_to_copy);
+      src += size_to_copy;
+      size_remaining -= size_to_copy;
+    }
+    // Same as when the extra data is read and discarded from the socket.
+    if (size_remaining > 0)
+      status = ErrorStatus(EIO);
+  } else if (transaction_state->response.recv_len > 0) {
     std::vector<iovec> read_buffers;
     size_t size_remaining = 0;
     if (transaction_state->response.recv_len != max_recv_len) {
@@ -189,13 +220,27 @@ Status<int> ClientChannel::SendAndReceive(void* transaction_state, int opcode,
   }
 
   auto* state = static_cast<TransactionState*>(transaction_state);
+  size_t send_len = CountVectorSize(send_vector, send_count);
   size_t max_recv_len = CountVectorSize(receive_vector, receive_count);
 
+  if (!payload_arena_ && !payload_arena_failed_ &&
+      std::max(send_len, max_recv_len) >= PayloadArena::kMinPayloadSize) {
+    auto arena = PayloadArena::Create();
+    if (arena)
+      payload_arena_ = arena.take();
+    else
+      payload_arena_failed_ = true;  // Keep using the socket only.
+  }
+
   auto status = SendRequest(BorrowedHandle{channel_handle_.value()}, state,
-                            opcode, send_vector, send_count, max_recv_len);
+                            opcode, send_vector, send_count, max_recv_len,
+                            payload_arena_.get(), !payload_arena_sent_);
   if (status) {
+    if (payload_arena_)
+      payload_arena_sent_ = true;
     status = ReceiveResponse(BorrowedHandle{channel_handle_.value()}, state,
-                             receive_vector, receive_count, max_recv_len);
+                             receive_vector, receive_count, max_recv_len,
+                             payload_arena_.get());
   }
   if (!result.PropagateError(status)) {
     const int return_code = state->response.ret_code;
@@ -28,10 +28,12 @@ using android::pdx::Message;
 using android::pdx::ServiceBase;
 using android::pdx::ServiceDispatcher;
 using android::pdx::Status;
+using android::pdx::Transaction;
 using android::pdx::rpc::DispatchRemoteMethod;
 using android::pdx::uds::ClientChannel;
 using android::pdx::uds::ClientChannelFactory;
 using android::pdx::uds::Endpoint;
+using android::pdx::uds::PayloadArena;
 
 namespace {
 
@@ -39,6 +41,7 @@ struct TestProtocol {
   using DataType = int8_t;
   enum {
     kOpSum = 0,
+    kOpEcho,
   };
   PDX_REMOTE_METHOD(Sum, kOpSum, int64_t(const std::vector<DataType>&));
 };
@@ -55,6 +58,9 @@ class TestService : public ServiceBase<TestService> {
                                                 message);
         return {};
 
+      case TestProtocol::kOpEcho:
+        return OnEcho(message);
+
       default:
         return Service::HandleMessage(message);
     }
@@ -64,6 +70,17 @@ class TestService : public ServiceBase<TestService> {
                 const std::vector<TestProtocol::DataType>& data) {
     return std::accumulate(data.begin(), data.end(), int64_t{0});
   }
+
+  Status<void> OnEcho(Message& message) {
+    std::vector<uint8_t> data(message.GetSendLength());
+    auto read_status = message.Read(data.data(), data.size());
+    if (!read_status)
+      return message.ReplyError(read_status.error());
+    auto write_status = message.Write(data.data(), read_status.get());
+    if (!write_status)
+      return message.ReplyError(write_status.error());
+    return message.Reply(0);
+  }
 };
 
 class TestClient : public ClientBase<TestClient> {
@@ -74,6 +91,13 @@ class TestClient : public ClientBase<TestClient> {
     auto status = InvokeRemoteMethod<TestProtocol::Sum>(data);
     return status ? status.get() : -1;
   }
+
+  Status<int> Echo(const std::vector<uint8_t>& data,
+                   std::vector<uint8_t>* reply) {
+    Transaction trans{*this};
+    return trans.Send<int>(TestProtocol::kOpEcho, data.data(), data.size(),
+                           reply->data(), reply->size());
+  }
 };
 
 class TestServiceRunner {
@@ -160,4 +184,24 @@ TEST_F(ClientChannelTest, MultithreadedClient) {
     thread.join();
 }
 
+TEST_F(ClientChannelTest, LargePayloads) {
+  // Payloads on both sides of the arena threshold, and one too large for the
+  // arena, which still goes through the socket.
+  const size_t kSizes[] = {1000,
+                           PayloadArena::kMinPayloadSize - 1,
+                           PayloadArena::kMinPayloadSize,
+                           256 * 1024,
+                           1000,
+                           PayloadArena::kDefaultSize + 1};
+
+  std::mt19937 gen{0};
+  for (size_t size : kSizes) {
+    std::vector<uint8_t> data(size);
+    std::generate(data.begin(), data.end(), [&gen]() { return gen(); });
+    std::vector<uint8_t> reply(size);
+    ASSERT_TRUE(client_->Echo(data, &reply)) << "size=" << size;
+    EXPECT_EQ(data, reply) << "size=" << size;
+  }
+}
+
 }  // namespace
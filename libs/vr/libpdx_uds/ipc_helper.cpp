@@ -5,9 +5,12 @@
 #include <log/log.h>
 #include <poll.h>
 #include <string.h>
+#include <fcntl.h>
 #include <sys/inotify.h>
+#include <sys/mman.h>
 #include <sys/param.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 
 #include <algorithm>
 
@@ -397,6 +400,55 @@ size_t CountVectorSize(const iovec* vector, size_t count) {
       [](size_t size, const iovec& vec) { return size + vec.iov_len; });
 }
 
+PayloadArena::~PayloadArena() { munmap(data_, size_); }
+
+Status<std::shared_ptr<PayloadArena>> PayloadArena::Create(size_t size) {
+  LocalHandle fd{
+      memfd_create("pdx_payload_arena", MFD_CLOEXEC | MFD_ALLOW_SEALING)};
+  if (!fd) {
+    ALOGE("PayloadArena::Create: Failed to create memfd: %s", strerror(errno));
+    return ErrorStatus(errno);
+  }
+  if (ftruncate(fd.Get(), size) < 0 ||
+      fcntl(fd.Get(), F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+    ALOGE("PayloadArena::Create: Failed to size memfd: %s", strerror(errno));
+    return ErrorStatus(errno);
+  }
+  void* data =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.Get(), 0);
+  if (data == MAP_FAILED) {
+    ALOGE("PayloadArena::Create: Failed to map memfd: %s", strerror(errno));
+    return ErrorStatus(errno);
+  }
+  return {std::shared_ptr<PayloadArena>{new PayloadArena{
+      std::move(fd), static_cast<uint8_t*>(data), size}}};
+}
+
+Status<std::shared_ptr<PayloadArena>> PayloadArena::Import(LocalHandle fd) {
+  int seals = fcntl(fd.Get(), F_GET_SEALS);
+  if (seals < 0 || !(seals & F_SEAL_SHRINK)) {
+    ALOGE("PayloadArena::Import: Arena can be shrunk, seals=%d", seals);
+    return ErrorStatus(EINVAL);
+  }
+  struct stat st;
+  if (fstat(fd.Get(), &st) < 0) {
+    ALOGE("PayloadArena::Import: Failed to stat arena: %s", strerror(errno));
+    return ErrorStatus(errno);
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  if (size == 0)
+    return ErrorStatus(EINVAL);
+  void* data =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.Get(), 0);
+  if (data == MAP_FAILED) {
+    ALOGE("PayloadArena::Import: Failed to map arena: %s", strerror(errno));
+    return ErrorStatus(errno);
+  }
+  return {std::shared_ptr<PayloadArena>{
+      new PayloadArena{std::move(fd), static_cast<uint8_t*>(data), size}}};
+}
+
 void InitRequest(android::pdx::uds::RequestHeader<BorrowedHandle>* request,
                  int opcode, uint32_t send_len, uint32_t max_recv_len,
                  bool is_impulse) {
@@ -407,6 +459,8 @@ void InitRequest(android::pdx::uds::RequestHeader<BorrowedHandle>* request,
   request->send_len = send_len;
   request->max_recv_len = max_recv_len;
   request->is_impulse = is_impulse;
+  request->payload_arena.clear();
+  request->payload_in_arena = false;
 }
 
 Status<void> WaitForEndpoint(const std::string& endpoint_path,
@@ -7,6 +7,7 @@
 
 #include <uds/channel_event_set.h>
 #include <uds/channel_manager.h>
+#include <uds/ipc_helper.h>
 #include <uds/service_endpoint.h>
 
 namespace android {
@@ -89,6 +90,10 @@ class ClientChannel : public pdx::ClientChannel {
   LocalChannelHandle channel_handle_;
   ChannelEventReceiver* channel_data_;
   std::mutex socket_mutex_;
+  // Created with the first large transaction. Guarded by socket_mutex_.
+  std::shared_ptr<PayloadArena> payload_arena_;
+  bool payload_arena_sent_{false};
+  bool payload_arena_failed_{false};
 };
 
 }  // namespace uds
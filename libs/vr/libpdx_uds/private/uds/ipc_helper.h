@@ -2,6 +2,7 @@
 #define ANDROID_PDX_UDS_IPC_HELPER_H_
 
 #include <sys/socket.h>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -107,6 +108,46 @@ class ReceivePayload : public MessageReader, public InputResourceMapper {
   size_t read_pos_{0};
 };
 
+// A shared memory region that carries the large payloads of a channel, so that
+// only the headers go through the socket. The client creates it and hands it to
+// the service with the first request that uses it. Since a channel runs one
+// transaction at a time, the request and then the response take turns in it.
+class PayloadArena {
+ public:
+  // Payloads smaller than this go through the socket.
+  static constexpr size_t kMinPayloadSize = 16 * 1024;
+  static constexpr size_t kDefaultSize = 1024 * 1024;
+
+  ~PayloadArena();
+
+  // Creates a new arena of |size| bytes, sealed so that it can't be resized.
+  static Status<std::shared_ptr<PayloadArena>> Create(
+      size_t size = kDefaultSize);
+  // Maps an arena received from the other side of a channel. Fails unless the
+  // arena is sealed against shrinking, so that the peer can't make accessing it
+  // fault.
+  static Status<std::shared_ptr<PayloadArena>> Import(LocalHandle fd);
+
+  bool CanHold(size_t size) const {
+    return size >= kMinPayloadSize && size <= size_;
+  }
+
+  uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+  BorrowedHandle fd() const { return fd_.Borrow(); }
+
+ private:
+  PayloadArena(LocalHandle fd, uint8_t* data, size_t size)
+      : fd_{std::move(fd)}, data_{data}, size_{size} {}
+
+  PayloadArena(const PayloadArena&) = delete;
+  void operator=(const PayloadArena&) = delete;
+
+  LocalHandle fd_;
+  uint8_t* data_;
+  size_t size_;
+};
+
 template <typename FileHandleType>
 class ChannelInfo {
  public:
@@ -139,11 +180,16 @@ class RequestHeader {
   std::vector<ChannelInfo<FileHandleType>> channels;
   std::array<uint8_t, 32> impulse_payload;
   bool is_impulse{false};
+  // The channel's PayloadArena, the first time the client uses it. Holds at
+  // most one handle.
+  std::vector<FileHandleType> payload_arena;
+  // Whether the payload is in the arena rather than after the header.
+  bool payload_in_arena{false};
 
  private:
   PDX_SERIALIZABLE_MEMBERS(RequestHeader, op, send_len, max_recv_len,
                            file_descriptors, channels, impulse_payload,
-                           is_impulse);
+                           is_impulse, payload_arena, payload_in_arena);
 };
 
 template <typename FileHandleType>
@@ -153,10 +199,11 @@ class ResponseHeader {
   uint32_t recv_len{0};
   std::vector<FileHandleType> file_descriptors;
   std::vector<ChannelInfo<FileHandleType>> channels;
+  bool payload_in_arena{false};
 
  private:
   PDX_SERIALIZABLE_MEMBERS(ResponseHeader, ret_code, recv_len, file_descriptors,
-                           channels);
+                           channels, payload_in_arena);
 };
 
 template <typename T>
@@ -13,6 +13,7 @@
 #include <pdx/service.h>
 #include <pdx/service_endpoint.h>
 #include <uds/channel_event_set.h>
+#include <uds/ipc_helper.h>
 
 namespace android {
 namespace pdx {
@@ -112,6 +113,8 @@ class Endpoint : public pdx::Endpoint {
     LocalHandle data_fd;
     ChannelEventSet event_set;
     Channel* channel_state{nullptr};
+    // Set once the client hands over its PayloadArena.
+    std::shared_ptr<PayloadArena> payload_arena;
   };
 
   // This class must be instantiated using Create() static methods above.
@@ -143,6 +146,9 @@ class Endpoint : public pdx::Endpoint {
   Status<std::pair<BorrowedHandle, BorrowedHandle>> GetChannelEventFd(
       int32_t channel_id);
   int32_t GetChannelId(const BorrowedHandle& channel_fd);
+  std::shared_ptr<PayloadArena> GetChannelPayloadArena(int32_t channel_id);
+  Status<void> SetChannelPayloadArena(int32_t channel_id,
+                                      LocalHandle arena_fd);
   Status<void> CreateChannelSocketPair(LocalHandle* local_socket,
                                        LocalHandle* remote_socket);
 
@@ -30,6 +30,7 @@ using android::pdx::LocalHandle;
 using android::pdx::Status;
 using android::pdx::uds::ChannelInfo;
 using android::pdx::uds::ChannelManager;
+using android::pdx::uds::PayloadArena;
 
 struct MessageState {
   bool GetLocalFileHandle(int index, LocalHandle* handle) {
@@ -104,11 +105,16 @@ struct MessageState {
   }
 
   Status<size_t> ReadData(const iovec* vector, size_t vector_length) {
-    size_t size_remaining = request_data.size() - request_data_read_pos;
+    // Large payloads are read straight from the channel's arena.
+    const uint8_t* payload =
+        request.payload_in_arena ? payload_arena->data() : request_data.data();
+    size_t payload_size =
+        request.payload_in_arena ? request.send_len : request_data.size();
+    size_t size_remaining = payload_size - request_data_read_pos;
     size_t size = 0;
     for (size_t i = 0; i < vector_length && size_remaining > 0; i++) {
       size_t size_to_copy = std::min(size_remaining, vector[i].iov_len);
-      memcpy(vector[i].iov_base, request_data.data() + request_data_read_pos,
+      memcpy(vector[i].iov_base, payload + request_data_read_pos,
              size_to_copy);
       size += size_to_copy;
       request_data_read_pos += size_to_copy;
@@ -123,6 +129,7 @@ struct MessageState {
   std::vector<uint8_t> request_data;
   size_t request_data_read_pos{0};
   std::vector<uint8_t> response_data;
+  std::shared_ptr<PayloadArena> payload_arena;
 };
 
 }  // anonymous namespace
@@ -494,6 +501,27 @@ int32_t Endpoint::GetChannelId(const BorrowedHandle& channel_fd) {
   return (iter != channel_fd_to_id_.end()) ? iter->second : -1;
 }
 
+std::shared_ptr<PayloadArena> Endpoint::GetChannelPayloadArena(
+    int32_t channel_id) {
+  std::lock_guard<std::mutex> autolock(channel_mutex_);
+  auto channel_data = channels_.find(channel_id);
+  return (channel_data != channels_.end()) ? channel_data->second.payload_arena
+                                           : nullptr;
+}
+
+Status<void> Endpoint::SetChannelPayloadArena(int32_t channel_id,
+                                              LocalHandle arena_fd) {
+  auto arena = PayloadArena::Import(std::move(arena_fd));
+  if (!arena)
+    return arena.error_status();
+  std::lock_guard<std::mutex> autolock(channel_mutex_);
+  auto channel_data = channels_.find(channel_id);
+  if (channel_data == channels_.end())
+    return ErrorStatus{ENOENT};
+  channel_data->second.payload_arena = arena.take();
+  return {};
+}
+
 Status<void> Endpoint::ReceiveMessageForChannel(
     const BorrowedHandle& channel_fd, Message* message) {
   RequestHeader<LocalHandle> request;
@@ -509,6 +537,32 @@ Status<void> Endpoint::ReceiveMessageForChannel(
     }
   }
 
+  if (request.payload_arena.size() > 1) {
+    CloseChannel(channel_id);
+    return ErrorStatus{EINVAL};
+  } else if (!request.payload_arena.empty()) {
+    status = SetChannelPayloadArena(channel_id,
+                                    std::move(request.payload_arena.front()));
+    request.payload_arena.clear();
+    if (!status) {
+      CloseChannel(channel_id);
+      return status;
+    }
+  }
+
+  std::shared_ptr<PayloadArena> payload_arena =
+      GetChannelPayloadArena(channel_id);
+  if (request.payload_in_arena &&
+      (request.is_impulse || !payload_arena ||
+       request.send_len > payload_arena->size())) {
+    ALOGE(
+        "Endpoint::ReceiveMessageForChannel: Invalid payload in arena: "
+        "channel_id=%d send_len=%zu",
+        channel_id, static_cast<size_t>(request.send_len));
+    CloseChannel(channel_id);
+    return ErrorStatus{EINVAL};
+  }
+
   MessageInfo info;
   info.pid = request.cred.pid;
   info.tid = -1;
@@ -535,7 +589,9 @@ Status<void> Endpoint::ReceiveMessageForChannel(
   *message = Message{info};
   auto* state = static_cast<MessageState*>(message->GetState());
   state->request = std::move(request);
-  if (state->request.send_len > 0 && !state->request.is_impulse) {
+  state->payload_arena = std::move(payload_arena);
+  if (state->request.send_len > 0 && !state->request.is_impulse &&
+      !state->request.payload_in_arena) {
     state->request_data.resize(state->request.send_len);
     status = ReceiveData(channel_fd, state->request_data.data(),
                          state->request_data.size());
@@ -645,8 +701,18 @@ Status<void> Endpoint::MessageReply(Message* message, int return_code) {
 
   state->response.ret_code = return_code;
   state->response.recv_len = state->response_data.size();
+  // The client is blocked until the reply arrives, and the request payload is
+  // no longer needed, so a large response can take its place in the arena.
+  state->response.payload_in_arena =
+      state->payload_arena &&
+      state->payload_arena->CanHold(state->response_data.size());
+  if (state->response.payload_in_arena) {
+    memcpy(state->payload_arena->data(), state->response_data.data(),
+           state->response_data.size());
+  }
   auto status = SendData(channel_socket, state->response);
-  if (status && !state->response_data.empty()) {
+  if (status && !state->response_data.empty() &&
+      !state->response.payload_in_arena) {
     status = SendData(channel_socket, state->response_data.data(),
                       state->response_data.size());
   }
@@ -1,5 +1,6 @@
 #include "epoll_event_dispatcher.h"
 
+#include <cutils/properties.h>
 #include <log/log.h>
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
@@ -7,6 +8,15 @@
 
 #include <dvr/performance_client_api.h>
 
+namespace {
+
+const char kSchedulerClassProperty[] = "dvr.event_thread.scheduler_class";
+const char kCpuPartitionProperty[] = "dvr.event_thread.cpu_partition";
+
+const char kDefaultSchedulerClass[] = "graphics";
+
+}  // anonymous namespace
+
 namespace android {
 namespace dvr {
 
@@ -77,6 +87,7 @@ pdx::Status<void> EpollEventDispatcher::RemoveEventHandler(int fd) {
 
   // If the fd was valid above, add it to the list of ids to remove.
   removed_handlers_.push_back(fd);
+  handlers_removed_.store(true, std::memory_order_release);
 
   // Wake up the event thread to clean up.
   eventfd_write(event_fd_.Get(), 1);
@@ -87,11 +98,25 @@ pdx::Status<void> EpollEventDispatcher::RemoveEventHandler(int fd) {
 void EpollEventDispatcher::EventThread() {
   prctl(PR_SET_NAME, reinterpret_cast<unsigned long>("VrEvent"), 0, 0, 0);
 
-  const int error = dvrSetSchedulerClass(0, "graphics");
+  char scheduler_class[PROPERTY_VALUE_MAX];
+  property_get(kSchedulerClassProperty, scheduler_class,
+               kDefaultSchedulerClass);
+  int error = dvrSetSchedulerClass(0, scheduler_class);
   LOG_ALWAYS_FATAL_IF(
       error < 0,
-      "EpollEventDispatcher::EventThread: Failed to set scheduler class: %s",
-      strerror(-error));
+      "EpollEventDispatcher::EventThread: Failed to set scheduler class "
+      "\"%s\": %s",
+      scheduler_class, strerror(-error));
+
+  char cpu_partition[PROPERTY_VALUE_MAX];
+  if (property_get(kCpuPartitionProperty, cpu_partition, "") > 0) {
+    // Not fatal: the thread still works from the default partition.
+    error = dvrSetCpuPartition(0, cpu_partition);
+    ALOGE_IF(error < 0,
+             "EpollEventDispatcher::EventThread: Failed to set cpu partition "
+             "\"%s\": %s",
+             cpu_partition, strerror(-error));
+  }
 
   const size_t kMaxNumEvents = 128;
   epoll_event events[kMaxNumEvents];
@@ -127,6 +152,9 @@ void EpollEventDispatcher::EventThread() {
     // instead of in RemoveEventHandler() to prevent races between the dispatch
     // thread and the code requesting the removal. Handlers are guaranteed to
     // stay alive between exiting epoll_wait() and the dispatch loop above.
+    if (!handlers_removed_.exchange(false, std::memory_order_acquire))
+      continue;
+
     std::lock_guard<std::mutex> lock(lock_);
     for (auto handler_fd : removed_handlers_) {
       ALOGD_IF(TRACE,
@@ -16,6 +16,14 @@
 namespace android {
 namespace dvr {
 
+// Dispatches epoll events to handlers on an internal thread.
+//
+// The thread drains up to 128 events per epoll_wait() and finds their handlers
+// through the epoll data pointer, so dispatching does not take any lock. Its
+// scheduler class and cpu partition default to "graphics" and no partition,
+// and may be overridden with the dvr.event_thread.scheduler_class and
+// dvr.event_thread.cpu_partition properties, to keep display service wakeups
+// away from the rendering threads.
 class EpollEventDispatcher {
  public:
   // Function type for event handlers. The handler receives a bitmask of the
@@ -53,6 +61,10 @@ class EpollEventDispatcher {
   // by the event dispatch thread to avoid races.
   std::vector<int> removed_handlers_;
 
+  // Set when removed_handlers_ is not empty, so that the event thread only
+  // takes lock_ after a handler was removed.
+  std::atomic<bool> handlers_removed_{false};
+
   pdx::LocalHandle epoll_fd_;
   pdx::LocalHandle event_fd_;
 };
@@ -610,6 +610,32 @@ int HardwareComposer::OnNewGlobalBuffer(DvrGlobalBufferKey key,
     return MapConfigBuffer(ion_buffer);
   }
 
+  if (key == DvrGlobalBuffers::kVsyncPoseBuffer ||
+      key == DvrGlobalBuffers::kLateLatchPoseBuffer) {
+    const bool is_vsync_pose_buffer =
+        key == DvrGlobalBuffers::kVsyncPoseBuffer;
+    const size_t min_size = is_vsync_pose_buffer
+                                ? sizeof(DvrVsyncPoseBuffer)
+                                : sizeof(DvrLateLatchPoseBuffer);
+    if (static_cast<size_t>(ion_buffer.width()) < min_size) {
+      ALOGE("HardwareComposer::OnNewGlobalBuffer: invalid pose buffer size.");
+      return -EINVAL;
+    }
+
+    auto buffer = std::make_unique<CPUMappedBuffer>(
+        &ion_buffer, is_vsync_pose_buffer ? CPUUsageMode::READ_OFTEN
+                                          : CPUUsageMode::WRITE_OFTEN);
+    if (buffer->IsMapped() == false) {
+      return -EPERM;
+    }
+
+    std::lock_guard<std::mutex> lock(late_latch_mutex_);
+    if (is_vsync_pose_buffer)
+      vsync_pose_buffer_ = std::move(buffer);
+    else
+      late_latch_pose_buffer_ = std::move(buffer);
+  }
+
   return 0;
 }
 
@@ -617,6 +643,16 @@ void HardwareComposer::OnDeletedGlobalBuffer(DvrGlobalBufferKey key) {
   if (key == DvrGlobalBuffers::kVrFlingerConfigBufferKey) {
     ConfigBufferDeleted();
   }
+
+  if (key == DvrGlobalBuffers::kVsyncPoseBuffer) {
+    std::lock_guard<std::mutex> lock(late_latch_mutex_);
+    vsync_pose_buffer_ = nullptr;
+  }
+
+  if (key == DvrGlobalBuffers::kLateLatchPoseBuffer) {
+    std::lock_guard<std::mutex> lock(late_latch_mutex_);
+    late_latch_pose_buffer_ = nullptr;
+  }
 }
 
 int HardwareComposer::MapConfigBuffer(IonBuffer& ion_buffer) {
@@ -734,6 +770,24 @@ int HardwareComposer::SleepUntil(int64_t wakeup_timestamp) {
                                      /*timeout_ms*/ -1);
 }
 
+void HardwareComposer::LateLatchPose(uint32_t vsync_count) {
+  std::lock_guard<std::mutex> lock(late_latch_mutex_);
+  if (!vsync_pose_buffer_ || !late_latch_pose_buffer_)
+    return;
+
+  ATRACE_NAME("late_latch_pose");
+  const auto* vsync_poses =
+      static_cast<const DvrVsyncPoseBuffer*>(vsync_pose_buffer_->Address());
+  auto* late_latch =
+      static_cast<DvrLateLatchPoseBuffer*>(late_latch_pose_buffer_->Address());
+
+  // The sensor service may be updating this pose; see DvrVsyncPoseBuffer.
+  late_latch->pose =
+      vsync_poses->vsync_poses[vsync_count & DvrVsyncPoseBuffer::kIndexMask];
+  late_latch->vsync_count = vsync_count;
+  late_latch->latch_timestamp_ns = GetSystemClockNs();
+}
+
 void HardwareComposer::PostThread() {
   // NOLINTNEXTLINE(runtime/int)
   prctl(PR_SET_NAME, reinterpret_cast<unsigned long>("VrHwcPost"), 0, 0, 0);
@@ -958,6 +1012,10 @@ void HardwareComposer::PostThread() {
       }
     }
 
+    // The frame posted below is displayed at the vsync following the one this
+    // iteration woke up for.
+    LateLatchPose(vsync_count_ + 1);
+
     PostLayers(target_display_->id);
   }
 }
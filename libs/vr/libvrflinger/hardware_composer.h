@@ -485,6 +485,11 @@ class HardwareComposer {
   // Poll for config udpates.
   void UpdateConfigBuffer();
 
+  // Copies the pose predicted for |vsync_count| from the vsync pose buffer to
+  // the late latch pose buffer, if both exist. Called by the post thread right
+  // before it posts the layers of a frame.
+  void LateLatchPose(uint32_t vsync_count);
+
   bool initialized_;
   bool is_standalone_device_;
 
@@ -557,6 +562,14 @@ class HardwareComposer {
   DvrConfig post_thread_config_;
   std::mutex shared_config_mutex_;
 
+  // The vsync predicted poses written by the sensor service, and the buffer
+  // the post thread latches the pose of each frame into. Guarded by
+  // late_latch_mutex_, since the display service may delete them while the
+  // post thread runs.
+  std::unique_ptr<CPUMappedBuffer> vsync_pose_buffer_;
+  std::unique_ptr<CPUMappedBuffer> late_latch_pose_buffer_;
+  std::mutex late_latch_mutex_;
+
   bool vsync_trace_parity_ = false;
   sp<VsyncService> vsync_service_;
 
@@ -22,6 +22,10 @@
 
 namespace android {
 
+// crc32c returns the CRC-32C checksum of len bytes at buf, as used in the
+// cache files.
+uint32_t crc32c(const uint8_t* buf, size_t len);
+
 class FileBlobCache : public BlobCache {
 public:
     // FileBlobCache attempts to load the saved cache contents from disk into
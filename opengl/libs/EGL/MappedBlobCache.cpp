@@ -0,0 +1,504 @@
+/*
+ ** Copyright 2020, The Android Open Source Project
+ **
+ ** Licensed under the Apache License, Version 2.0 (the "License");
+ ** you may not use this file except in compliance with the License.
+ ** You may obtain a copy of the License at
+ **
+ **     http://www.apache.org/licenses/LICENSE-2.0
+ **
+ ** Unless required by applicable law or agreed to in writing, software
+ ** distributed under the License is distributed on an "AS IS" BASIS,
+ ** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ ** See the License for the specific language governing permissions and
+ ** limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+
+#include "MappedBlobCache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+#include <android-base/file.h>
+#include <android-base/properties.h>
+#include <log/log.h>
+
+#include "FileBlobCache.h"
+
+namespace android {
+
+// FileHeader::mMagicNumber value
+static const uint32_t mappedCacheMagic = ('m' << 24) + ('L' << 16) + ('G' << 8) + 'E';
+
+// FileHeader::mVersion value
+static const uint32_t mappedCacheVersion = 1;
+
+// FileHeader::mDeviceVersion value
+static const uint32_t mappedCacheDeviceVersion = 1;
+
+static const size_t maxBuildIdLength = 92;
+
+// The header at the start of the cache file. No need to make this portable, so
+// we simply write the struct out.
+struct FileHeader {
+    uint32_t mMagicNumber;
+    uint32_t mVersion;
+    uint32_t mDeviceVersion;
+    uint32_t mBuildIdLength;
+    char mBuildId[maxBuildIdLength];
+};
+
+// The file header is followed by records, each made of a RecordHeader, the key
+// and the value, padded to 4 bytes. A record with an empty value removes the
+// entry with its key. Later records win over earlier ones.
+struct RecordHeader {
+    uint32_t mKeySize;
+    uint32_t mValueSize;
+    // mCrc is the crc32c of the key and value.
+    uint32_t mCrc;
+};
+
+static inline size_t align4(size_t size) {
+    return (size + 3) & ~3;
+}
+
+static inline size_t recordSize(size_t keySize, size_t valueSize) {
+    return align4(sizeof(RecordHeader) + keySize + valueSize);
+}
+
+static FileHeader makeFileHeader(const std::string& fingerprint) {
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.mMagicNumber = mappedCacheMagic;
+    header.mVersion = mappedCacheVersion;
+    header.mDeviceVersion = mappedCacheDeviceVersion;
+    header.mBuildIdLength = std::min(fingerprint.size(), maxBuildIdLength);
+    memcpy(header.mBuildId, fingerprint.c_str(), header.mBuildIdLength);
+    return header;
+}
+
+// Appends a record to buffer.
+static void appendRecord(std::vector<uint8_t>* buffer, std::string_view key,
+        const uint8_t* value, size_t valueSize) {
+    size_t offset = buffer->size();
+    buffer->resize(offset + recordSize(key.size(), valueSize), 0);
+    uint8_t* record = buffer->data() + offset;
+    uint8_t* data = record + sizeof(RecordHeader);
+    memcpy(data, key.data(), key.size());
+    if (valueSize > 0) {
+        memcpy(data + key.size(), value, valueSize);
+    }
+    RecordHeader header = {
+        .mKeySize = static_cast<uint32_t>(key.size()),
+        .mValueSize = static_cast<uint32_t>(valueSize),
+        .mCrc = crc32c(data, key.size() + valueSize),
+    };
+    memcpy(record, &header, sizeof(header));
+}
+
+MappedBlobCache::MappedBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
+        const std::string& filename, const std::string& fingerprint, bool readOnly)
+        : mMaxKeySize(maxKeySize),
+          mMaxValueSize(maxValueSize),
+          mMaxTotalSize(maxTotalSize),
+          mFilename(filename),
+          mFingerprint(fingerprint.empty() ? base::GetProperty("ro.build.id", "") : fingerprint),
+          mReadOnly(readOnly),
+          mRandom(std::chrono::steady_clock::now().time_since_epoch().count()) {
+    if (mFilename.empty()) {
+        return;
+    }
+    const char* fname = mFilename.c_str();
+
+    if (mReadOnly) {
+        mFd = open(fname, O_RDONLY | O_CLOEXEC);
+        if (mFd == -1) {
+            ALOGV("error opening cache file %s: %s (%d)", fname, strerror(errno), errno);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mFileMutex);
+        if (!load()) {
+            close(mFd);
+            mFd = -1;
+        }
+        return;
+    }
+
+    mFd = open(fname, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (mFd == -1 && errno == EACCES) {
+        // A read-only file left by FileBlobCache; it is in a different format anyway.
+        unlink(fname);
+        mFd = open(fname, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    }
+    if (mFd == -1) {
+        ALOGE("error opening cache file %s: %s (%d)", fname, strerror(errno), errno);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mFileMutex);
+    // Start over with an empty file if it cannot be used. It is replaced rather
+    // than truncated, in case another process has it mapped.
+    if (!load() && !rewriteFileLocked()) {
+        close(mFd);
+        mFd = -1;
+    }
+    if (mTotalSize > mMaxTotalSize) {
+        clean();
+    }
+}
+
+MappedBlobCache::~MappedBlobCache() {
+    for (Shard& shard : mShards) {
+        shard.entries.clear();
+    }
+    for (const auto& mapping : mMappings) {
+        munmap(mapping.first, mapping.second);
+    }
+    if (mFd != -1) {
+        close(mFd);
+    }
+}
+
+MappedBlobCache::Shard& MappedBlobCache::shardFor(std::string_view key) {
+    return mShards[std::hash<std::string_view>()(key) % kShardCount];
+}
+
+bool MappedBlobCache::load() {
+    // Do not look at the file while another process appends to it.
+    flock(mFd, LOCK_SH);
+    struct stat statBuf;
+    if (fstat(mFd, &statBuf) == -1) {
+        ALOGE("error stat'ing cache file: %s (%d)", strerror(errno), errno);
+        flock(mFd, LOCK_UN);
+        return false;
+    }
+    size_t fileSize = statBuf.st_size;
+    if (fileSize < sizeof(FileHeader)) {
+        flock(mFd, LOCK_UN);
+        return false;
+    }
+    // Sanity check the size before trying to mmap it.
+    if (fileSize > mMaxTotalSize * 4) {
+        ALOGE("cache file is too large: %#" PRIx64, static_cast<uint64_t>(statBuf.st_size));
+        flock(mFd, LOCK_UN);
+        return false;
+    }
+
+    void* map = mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, mFd, 0);
+    flock(mFd, LOCK_UN);
+    if (map == MAP_FAILED) {
+        ALOGE("error mmaping cache file: %s (%d)", strerror(errno), errno);
+        return false;
+    }
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(map);
+
+    FileHeader expected = makeFileHeader(mFingerprint);
+    if (memcmp(bytes, &expected, sizeof(expected)) != 0) {
+        // We treat bad magic numbers, version and build mismatches as an empty cache.
+        ALOGV("load: discarding cache file from another version");
+        munmap(map, fileSize);
+        return false;
+    }
+    mMappings.emplace_back(map, fileSize);
+
+    // Only the record headers are read here; the values are left in the page
+    // cache until someone asks for them.
+    size_t offset = sizeof(FileHeader);
+    while (offset + sizeof(RecordHeader) <= fileSize) {
+        RecordHeader header;
+        memcpy(&header, bytes + offset, sizeof(header));
+        size_t size = recordSize(header.mKeySize, header.mValueSize);
+        if (header.mKeySize == 0 || mMaxKeySize < header.mKeySize ||
+                mMaxValueSize < header.mValueSize || offset + size > fileSize) {
+            // Most likely a write that did not complete.
+            ALOGV("load: ignoring the cache file after offset %zu", offset);
+            break;
+        }
+
+        const char* keyData = reinterpret_cast<const char*>(bytes + offset + sizeof(header));
+        std::string_view key(keyData, header.mKeySize);
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (header.mValueSize == 0) {
+            auto it = shard.entries.find(key);
+            if (it != shard.entries.end()) {
+                mTotalSize -= it->first.size() + it->second.valueSize;
+                mStaleSize += recordSize(it->first.size(), it->second.valueSize);
+                shard.entries.erase(it);
+            }
+            mStaleSize += size;
+        } else {
+            Entry entry;
+            entry.value = reinterpret_cast<const uint8_t*>(keyData) + header.mKeySize;
+            entry.valueSize = header.mValueSize;
+            entry.crc = header.mCrc;
+            entry.persisted = true;
+            insertLocked(shard, key, std::move(entry));
+        }
+        offset += size;
+    }
+    mFileSize = offset;
+    return true;
+}
+
+void MappedBlobCache::insertLocked(Shard& shard, std::string_view key, Entry&& entry) {
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end()) {
+        mTotalSize -= it->first.size() + it->second.valueSize;
+        if (it->second.persisted) {
+            mStaleSize += recordSize(it->first.size(), it->second.valueSize);
+        }
+        shard.entries.erase(it);
+    }
+    mTotalSize += key.size() + entry.valueSize;
+    shard.entries.emplace(key, std::move(entry));
+}
+
+void MappedBlobCache::eraseLocked(Shard& shard, EntryMap::iterator it) {
+    mTotalSize -= it->first.size() + it->second.valueSize;
+    if (it->second.persisted) {
+        mStaleSize += recordSize(it->first.size(), it->second.valueSize);
+        std::lock_guard<std::mutex> lock(mRemovalMutex);
+        mPendingRemovals.emplace_back(it->first);
+    }
+    shard.entries.erase(it);
+}
+
+void MappedBlobCache::set(const void* key, size_t keySize, const void* value,
+        size_t valueSize) {
+    if (mReadOnly) {
+        return;
+    }
+    if (mMaxKeySize < keySize) {
+        ALOGV("set: not caching because the key is too large: %zu (limit: %zu)",
+                keySize, mMaxKeySize);
+        return;
+    }
+    if (mMaxValueSize < valueSize) {
+        ALOGV("set: not caching because the value is too large: %zu (limit: %zu)",
+                valueSize, mMaxValueSize);
+        return;
+    }
+    if (mMaxTotalSize < keySize + valueSize) {
+        ALOGV("set: not caching because the combined key/value size is too "
+                "large: %zu (limit: %zu)", keySize + valueSize, mMaxTotalSize);
+        return;
+    }
+    if (keySize == 0) {
+        ALOGW("set: not caching because keySize is 0");
+        return;
+    }
+    if (valueSize == 0) {
+        ALOGW("set: not caching because valueSize is 0");
+        return;
+    }
+
+    Entry entry;
+    entry.data.reset(new uint8_t[keySize + valueSize], std::default_delete<uint8_t[]>());
+    memcpy(entry.data.get(), key, keySize);
+    memcpy(entry.data.get() + keySize, value, valueSize);
+    entry.value = entry.data.get() + keySize;
+    entry.valueSize = valueSize;
+    entry.verified = true;
+    std::string_view keyView(reinterpret_cast<const char*>(entry.data.get()), keySize);
+
+    Shard& shard = shardFor(keyView);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        insertLocked(shard, keyView, std::move(entry));
+    }
+    ALOGV("set: cached %zu byte key and %zu byte value", keySize, valueSize);
+
+    if (mTotalSize > mMaxTotalSize) {
+        clean();
+    }
+}
+
+size_t MappedBlobCache::get(const void* key, size_t keySize, void* value, size_t valueSize) {
+    if (mMaxKeySize < keySize) {
+        ALOGV("get: not searching because the key is too large: %zu (limit %zu)",
+                keySize, mMaxKeySize);
+        return 0;
+    }
+    std::string_view keyView(reinterpret_cast<const char*>(key), keySize);
+    Shard& shard = shardFor(keyView);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(keyView);
+    if (it == shard.entries.end()) {
+        ALOGV("get: no cache entry found for key of size %zu", keySize);
+        return 0;
+    }
+
+    Entry& entry = it->second;
+    if (!entry.verified) {
+        // A mapped record: the value follows the key in the file.
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(it->first.data());
+        if (crc32c(data, keySize + entry.valueSize) != entry.crc) {
+            ALOGE("get: cache entry failed CRC check");
+            eraseLocked(shard, it);
+            return 0;
+        }
+        entry.verified = true;
+    }
+
+    if (entry.valueSize <= valueSize) {
+        ALOGV("get: copying %zu bytes to caller's buffer", entry.valueSize);
+        memcpy(value, entry.value, entry.valueSize);
+    } else {
+        ALOGV("get: caller's buffer is too small for value: %zu (needs %zu)",
+                valueSize, entry.valueSize);
+    }
+    return entry.valueSize;
+}
+
+void MappedBlobCache::clean() {
+    std::lock_guard<std::mutex> lock(mCleanMutex);
+    while (mTotalSize > mMaxTotalSize / 2) {
+        Shard& shard = mShards[mRandom() % kShardCount];
+        std::lock_guard<std::mutex> shardLock(shard.mutex);
+        if (shard.entries.empty()) {
+            continue;
+        }
+        auto it = shard.entries.begin();
+        std::advance(it, mRandom() % shard.entries.size());
+        eraseLocked(shard, it);
+    }
+}
+
+// Returns the end of the last complete record between offset and fileSize.
+static size_t findValidEnd(int fd, size_t offset, size_t fileSize, size_t maxKeySize,
+        size_t maxValueSize) {
+    while (offset + sizeof(RecordHeader) <= fileSize) {
+        RecordHeader header;
+        if (TEMP_FAILURE_RETRY(pread(fd, &header, sizeof(header), offset)) !=
+                sizeof(header)) {
+            break;
+        }
+        size_t size = recordSize(header.mKeySize, header.mValueSize);
+        if (header.mKeySize == 0 || maxKeySize < header.mKeySize ||
+                maxValueSize < header.mValueSize || offset + size > fileSize) {
+            break;
+        }
+        offset += size;
+    }
+    return offset;
+}
+
+void MappedBlobCache::writeToFile() {
+    std::lock_guard<std::mutex> lock(mFileMutex);
+    if (mFd == -1 || mReadOnly) {
+        return;
+    }
+
+    // Another process sharing the cache may have replaced the file.
+    struct stat fdStat, fileStat;
+    bool replaced = fstat(mFd, &fdStat) == -1 || stat(mFilename.c_str(), &fileStat) == -1 ||
+            fdStat.st_ino != fileStat.st_ino || fdStat.st_dev != fileStat.st_dev ||
+            static_cast<size_t>(fdStat.st_size) < mFileSize;
+    if (replaced || (mStaleSize > mMaxTotalSize / 2 && mStaleSize > mTotalSize)) {
+        rewriteFileLocked();
+        return;
+    }
+
+    std::vector<uint8_t> buffer;
+    {
+        std::lock_guard<std::mutex> removalLock(mRemovalMutex);
+        for (const std::string& key : mPendingRemovals) {
+            appendRecord(&buffer, key, nullptr, 0);
+        }
+        mPendingRemovals.clear();
+    }
+    for (Shard& shard : mShards) {
+        std::lock_guard<std::mutex> shardLock(shard.mutex);
+        for (auto& [key, entry] : shard.entries) {
+            if (!entry.persisted) {
+                appendRecord(&buffer, key, entry.value, entry.valueSize);
+                entry.persisted = true;
+            }
+        }
+    }
+    if (buffer.empty()) {
+        return;
+    }
+
+    flock(mFd, LOCK_EX);
+    // Keep the records other processes appended, but drop a tail left by a
+    // write that did not complete.
+    off_t fileEnd = lseek(mFd, 0, SEEK_END);
+    size_t end = fileEnd < 0 ? mFileSize :
+            findValidEnd(mFd, mFileSize, fileEnd, mMaxKeySize, mMaxValueSize);
+    bool ok = (static_cast<off_t>(end) == fileEnd || ftruncate(mFd, end) == 0) &&
+            lseek(mFd, end, SEEK_SET) == static_cast<off_t>(end) &&
+            base::WriteFully(mFd, buffer.data(), buffer.size());
+    if (ok) {
+        mFileSize = end + buffer.size();
+        ALOGV("writeToFile: appended %zu bytes", buffer.size());
+    } else {
+        ALOGE("error appending to cache file: %s (%d)", strerror(errno), errno);
+        ftruncate(mFd, end);
+        mFileSize = end;
+    }
+    flock(mFd, LOCK_UN);
+    if (!ok) {
+        // The entries were marked as persisted; put them all back in the file.
+        rewriteFileLocked();
+    }
+}
+
+bool MappedBlobCache::rewriteFileLocked() {
+    std::string tmpName = mFilename + ".tmp";
+    const char* fname = tmpName.c_str();
+
+    std::vector<uint8_t> buffer;
+    FileHeader header = makeFileHeader(mFingerprint);
+    buffer.insert(buffer.end(), reinterpret_cast<const uint8_t*>(&header),
+            reinterpret_cast<const uint8_t*>(&header) + sizeof(header));
+    {
+        std::lock_guard<std::mutex> removalLock(mRemovalMutex);
+        mPendingRemovals.clear();
+    }
+    // Stale bytes counted while serializing belong to the new file.
+    mStaleSize = 0;
+    for (Shard& shard : mShards) {
+        std::lock_guard<std::mutex> shardLock(shard.mutex);
+        for (auto& [key, entry] : shard.entries) {
+            appendRecord(&buffer, key, entry.value, entry.valueSize);
+            entry.persisted = true;
+        }
+    }
+
+    int fd = open(fname, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        ALOGE("error creating cache file %s: %s (%d)", fname, strerror(errno), errno);
+        return false;
+    }
+    if (!base::WriteFully(fd, buffer.data(), buffer.size()) ||
+            rename(fname, mFilename.c_str()) == -1) {
+        ALOGE("error writing cache file %s: %s (%d)", fname, strerror(errno), errno);
+        close(fd);
+        unlink(fname);
+        return false;
+    }
+    ALOGV("writeToFile: rewrote %zu bytes", buffer.size());
+
+    // Mapped entries keep pointing into the previous file, which stays valid
+    // as long as it is mapped.
+    close(mFd);
+    mFd = fd;
+    mFileSize = buffer.size();
+    return true;
+}
+
+} // namespace android
@@ -0,0 +1,167 @@
+/*
+ ** Copyright 2020, The Android Open Source Project
+ **
+ ** Licensed under the Apache License, Version 2.0 (the "License");
+ ** you may not use this file except in compliance with the License.
+ ** You may obtain a copy of the License at
+ **
+ **     http://www.apache.org/licenses/LICENSE-2.0
+ **
+ ** Unless required by applicable law or agreed to in writing, software
+ ** distributed under the License is distributed on an "AS IS" BASIS,
+ ** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ ** See the License for the specific language governing permissions and
+ ** limitations under the License.
+ */
+
+#ifndef ANDROID_MAPPED_BLOB_CACHE_H
+#define ANDROID_MAPPED_BLOB_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+
+// A MappedBlobCache is a thread-safe cache for binary key/value pairs that is
+// backed by an append-only file.
+//
+// The file is mmap'd when the cache is created, and only the record headers
+// are read to build the index: values stay in the page cache until they are
+// asked for. Entries inserted later are kept in memory, and writeToFile
+// appends them to the file instead of rewriting it. The file is only rewritten
+// once most of it is made of overwritten or evicted entries.
+//
+// The index is split into shards with their own lock, so that threads setting
+// or getting different keys rarely wait for each other.
+//
+// Like BlobCache, the file format is non-portable and the data should only be
+// used by the device that generated it.
+class MappedBlobCache {
+public:
+    // Create a blob cache, loading the contents of filename if it exists. The
+    // size limits are the same as BlobCache's. An empty filename gives a cache
+    // that is never saved.
+    //
+    // The file is only loaded if it was written with the same fingerprint,
+    // which defaults to the build id. A read-only cache never changes the file,
+    // and ignores set.
+    MappedBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
+            const std::string& filename, const std::string& fingerprint = "",
+            bool readOnly = false);
+    ~MappedBlobCache();
+
+    // set and get behave like BlobCache::set and BlobCache::get.
+    void set(const void* key, size_t keySize, const void* value, size_t valueSize);
+    size_t get(const void* key, size_t keySize, void* value, size_t valueSize);
+
+    // writeToFile appends the entries set since the last call to the file, or
+    // rewrites it if it grew too large.
+    void writeToFile();
+
+    // getTotalSize returns the combined size of all keys and values in the
+    // cache.
+    size_t getTotalSize() const { return mTotalSize; }
+
+private:
+    // Copying is disallowed.
+    MappedBlobCache(const MappedBlobCache&);
+    void operator=(const MappedBlobCache&);
+
+    struct Entry {
+        // The value, either in one of mMappings or in data.
+        const uint8_t* value = nullptr;
+        size_t valueSize = 0;
+        // The key followed by the value, for entries that are not mapped.
+        std::shared_ptr<uint8_t> data;
+        // crc32c of the key and value, as stored in the file.
+        uint32_t crc = 0;
+        // Whether the entry is in the file.
+        bool persisted = false;
+        // Whether the entry was checked against its crc.
+        bool verified = false;
+    };
+
+    // The keys point into the entries' data or into a mapping of the file.
+    using EntryMap = std::unordered_map<std::string_view, Entry>;
+
+    struct Shard {
+        std::mutex mutex;
+        EntryMap entries;
+    };
+
+    static constexpr size_t kShardCount = 16;
+
+    Shard& shardFor(std::string_view key);
+
+    // load maps the file and indexes the entries it contains, returning false
+    // if it is missing or unusable.
+    bool load();
+
+    // insertLocked adds an entry to a locked shard, replacing the entry with
+    // the same key.
+    void insertLocked(Shard& shard, std::string_view key, Entry&& entry);
+
+    // eraseLocked removes an entry from a locked shard. If it is in the file,
+    // a removal is queued for the next writeToFile.
+    void eraseLocked(Shard& shard, EntryMap::iterator it);
+
+    // clean evicts randomly chosen entries until the total size is less than
+    // mMaxTotalSize/2.
+    void clean();
+
+    // rewriteFileLocked writes all the entries to a new file that replaces the
+    // current one. Must be called with mFileMutex held.
+    bool rewriteFileLocked();
+
+    const size_t mMaxKeySize;
+    const size_t mMaxValueSize;
+    const size_t mMaxTotalSize;
+    const std::string mFilename;
+    const std::string mFingerprint;
+    const bool mReadOnly;
+
+    Shard mShards[kShardCount];
+
+    // mTotalSize is the combined size of all keys and values in the cache.
+    std::atomic<size_t> mTotalSize{0};
+
+    // mStaleSize is the number of bytes of the file taken by entries that were
+    // overwritten or evicted since.
+    std::atomic<size_t> mStaleSize{0};
+
+    // mRemovalMutex guards mPendingRemovals, the keys of the persisted entries
+    // that were evicted since the last writeToFile.
+    std::mutex mRemovalMutex;
+    std::vector<std::string> mPendingRemovals;
+
+    // mCleanMutex guards mRandom, and makes sure only one thread cleans.
+    std::mutex mCleanMutex;
+    std::minstd_rand mRandom;
+
+    // mFileMutex guards the members below.
+    std::mutex mFileMutex;
+
+    // mFd is the cache file, or -1.
+    int mFd = -1;
+
+    // mFileSize is the size of the valid part of the file.
+    size_t mFileSize = 0;
+
+    // mMappings are the regions of the file mapped by this cache. They are
+    // only unmapped when the cache is destroyed, since entries point into them
+    // even after the file was rewritten.
+    std::vector<std::pair<void*, size_t>> mMappings;
+};
+
+} // namespace android
+
+#endif // ANDROID_MAPPED_BLOB_CACHE_H
@@ -0,0 +1,254 @@
+/*
+ ** Copyright 2020, The Android Open Source Project
+ **
+ ** Licensed under the Apache License, Version 2.0 (the "License");
+ ** you may not use this file except in compliance with the License.
+ ** You may obtain a copy of the License at
+ **
+ **     http://www.apache.org/licenses/LICENSE-2.0
+ **
+ ** Unless required by applicable law or agreed to in writing, software
+ ** distributed under the License is distributed on an "AS IS" BASIS,
+ ** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ ** See the License for the specific language governing permissions and
+ ** limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "MappedBlobCache.h"
+
+namespace android {
+
+class MappedBlobCacheTest : public ::testing::Test {
+protected:
+    enum {
+        MAX_KEY_SIZE = 8,
+        MAX_VALUE_SIZE = 16,
+        MAX_TOTAL_SIZE = 256,
+    };
+
+    virtual void SetUp() {
+        mFilename = std::string(mTempDir.path) + "/blob_cache";
+        reload();
+    }
+
+    virtual void TearDown() {
+        mBC.reset();
+    }
+
+    void reload() {
+        mBC.reset();
+        mBC.reset(new MappedBlobCache(MAX_KEY_SIZE, MAX_VALUE_SIZE, MAX_TOTAL_SIZE, mFilename));
+    }
+
+    TemporaryDir mTempDir;
+    std::string mFilename;
+    std::unique_ptr<MappedBlobCache> mBC;
+};
+
+TEST_F(MappedBlobCacheTest, CacheSingleValueSucceeds) {
+    char buf[4] = {};
+    mBC->set("abcd", 4, "efgh", 4);
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "efgh", 4));
+}
+
+TEST_F(MappedBlobCacheTest, GetOnlySizeSucceeds) {
+    mBC->set("abcd", 4, "efgh", 4);
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, nullptr, 0));
+}
+
+TEST_F(MappedBlobCacheTest, ValuesSurviveReload) {
+    char buf[4] = {};
+    mBC->set("abcd", 4, "efgh", 4);
+    mBC->set("ijkl", 4, "mnop", 4);
+    mBC->writeToFile();
+    reload();
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "efgh", 4));
+    ASSERT_EQ(size_t(4), mBC->get("ijkl", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "mnop", 4));
+}
+
+TEST_F(MappedBlobCacheTest, AppendedValuesSurviveReload) {
+    char buf[4] = {};
+    mBC->set("abcd", 4, "efgh", 4);
+    mBC->writeToFile();
+    reload();
+    mBC->set("ijkl", 4, "mnop", 4);
+    mBC->writeToFile();
+    reload();
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "efgh", 4));
+    ASSERT_EQ(size_t(4), mBC->get("ijkl", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "mnop", 4));
+}
+
+TEST_F(MappedBlobCacheTest, ReplacedValueSurvivesReload) {
+    char buf[5] = {};
+    mBC->set("abcd", 4, "efgh", 4);
+    mBC->writeToFile();
+    mBC->set("abcd", 4, "ijklm", 5);
+    mBC->writeToFile();
+    reload();
+    ASSERT_EQ(size_t(5), mBC->get("abcd", 4, buf, 5));
+    ASSERT_EQ(0, memcmp(buf, "ijklm", 5));
+}
+
+TEST_F(MappedBlobCacheTest, FillingCacheStaysUnderLimit) {
+    for (int i = 0; i < 100; i++) {
+        std::string key = std::to_string(i);
+        mBC->set(key.data(), key.size(), "0123456789abcdef", 16);
+        ASSERT_LE(mBC->getTotalSize(), size_t(MAX_TOTAL_SIZE));
+    }
+    mBC->writeToFile();
+    reload();
+    ASSERT_LE(mBC->getTotalSize(), size_t(MAX_TOTAL_SIZE));
+}
+
+TEST_F(MappedBlobCacheTest, EvictedValuesStayEvictedAfterReload) {
+    for (int i = 0; i < 100; i++) {
+        std::string key = std::to_string(i);
+        mBC->set(key.data(), key.size(), "0123456789abcdef", 16);
+        mBC->writeToFile();
+    }
+    std::vector<std::string> present;
+    for (int i = 0; i < 100; i++) {
+        std::string key = std::to_string(i);
+        if (mBC->get(key.data(), key.size(), nullptr, 0) != 0) {
+            present.push_back(key);
+        }
+    }
+    size_t totalSize = mBC->getTotalSize();
+    reload();
+    ASSERT_EQ(totalSize, mBC->getTotalSize());
+    for (const std::string& key : present) {
+        ASSERT_EQ(size_t(16), mBC->get(key.data(), key.size(), nullptr, 0)) << key;
+    }
+}
+
+TEST_F(MappedBlobCacheTest, TruncatedFileKeepsCompleteRecords) {
+    char buf[4] = {};
+    mBC->set("abcd", 4, "efgh", 4);
+    mBC->writeToFile();
+    mBC.reset();
+
+    struct stat statBuf;
+    ASSERT_EQ(0, stat(mFilename.c_str(), &statBuf));
+    // A record that was only partially written before a crash.
+    int fd = open(mFilename.c_str(), O_WRONLY | O_APPEND);
+    ASSERT_NE(-1, fd);
+    ASSERT_EQ(6, write(fd, "\x04\x00\x00\x00\x04\x00", 6));
+    close(fd);
+
+    reload();
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "efgh", 4));
+    mBC->set("ijkl", 4, "mnop", 4);
+    mBC->writeToFile();
+    reload();
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(size_t(4), mBC->get("ijkl", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "mnop", 4));
+}
+
+TEST_F(MappedBlobCacheTest, CorruptValueIsNotReturned) {
+    char buf[4] = {};
+    mBC->set("abcd", 4, "efgh", 4);
+    mBC->writeToFile();
+    mBC.reset();
+
+    std::string contents;
+    ASSERT_TRUE(base::ReadFileToString(mFilename, &contents));
+    size_t pos = contents.rfind("efgh");
+    ASSERT_NE(std::string::npos, pos);
+    contents[pos] = 'x';
+    ASSERT_TRUE(base::WriteStringToFile(contents, mFilename));
+
+    reload();
+    ASSERT_EQ(size_t(0), mBC->get("abcd", 4, buf, 4));
+}
+
+TEST_F(MappedBlobCacheTest, ReadOnlyCacheLoadsMatchingFingerprint) {
+    char buf[4] = {};
+    mBC.reset(new MappedBlobCache(MAX_KEY_SIZE, MAX_VALUE_SIZE, MAX_TOTAL_SIZE, mFilename,
+                                  "driver1"));
+    mBC->set("abcd", 4, "efgh", 4);
+    mBC->writeToFile();
+
+    mBC.reset(new MappedBlobCache(MAX_KEY_SIZE, MAX_VALUE_SIZE, MAX_TOTAL_SIZE, mFilename,
+                                  "driver1", true));
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, buf, 4));
+    ASSERT_EQ(0, memcmp(buf, "efgh", 4));
+
+    mBC.reset(new MappedBlobCache(MAX_KEY_SIZE, MAX_VALUE_SIZE, MAX_TOTAL_SIZE, mFilename,
+                                  "driver2", true));
+    ASSERT_EQ(size_t(0), mBC->get("abcd", 4, buf, 4));
+}
+
+TEST_F(MappedBlobCacheTest, ReadOnlyCacheLeavesFileAlone) {
+    char buf[4] = {};
+    mBC->set("abcd", 4, "efgh", 4);
+    mBC->writeToFile();
+    std::string before;
+    ASSERT_TRUE(base::ReadFileToString(mFilename, &before));
+
+    mBC.reset(new MappedBlobCache(MAX_KEY_SIZE, MAX_VALUE_SIZE, MAX_TOTAL_SIZE, mFilename, "",
+                                  true));
+    mBC->set("ijkl", 4, "mnop", 4);
+    ASSERT_EQ(size_t(0), mBC->get("ijkl", 4, buf, 4));
+    mBC->writeToFile();
+    mBC.reset();
+
+    std::string after;
+    ASSERT_TRUE(base::ReadFileToString(mFilename, &after));
+    ASSERT_EQ(before, after);
+}
+
+TEST_F(MappedBlobCacheTest, ReadOnlyCacheDoesNotCreateFile) {
+    std::string filename = std::string(mTempDir.path) + "/missing";
+    MappedBlobCache cache(MAX_KEY_SIZE, MAX_VALUE_SIZE, MAX_TOTAL_SIZE, filename, "", true);
+    ASSERT_EQ(size_t(0), cache.getTotalSize());
+    ASSERT_EQ(-1, access(filename.c_str(), F_OK));
+}
+
+TEST_F(MappedBlobCacheTest, ConcurrentSetAndGet) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([this, t]() {
+            for (int i = 0; i < 1000; i++) {
+                char key[2] = {static_cast<char>('a' + t), static_cast<char>(i % 16)};
+                char value[4] = {key[0], key[1], 0, 0};
+                char buf[4] = {};
+                mBC->set(key, 2, value, 4);
+                size_t size = mBC->get(key, 2, buf, 4);
+                // Another thread may have evicted the entry since.
+                if (size != 0) {
+                    ASSERT_EQ(size_t(4), size);
+                    ASSERT_EQ(0, memcmp(buf, value, 4));
+                }
+                if (i % 100 == 0) {
+                    mBC->writeToFile();
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    ASSERT_LE(mBC->getTotalSize(), size_t(MAX_TOTAL_SIZE));
+}
+
+} // namespace android
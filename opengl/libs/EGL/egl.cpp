@@ -21,6 +21,7 @@
 #include <android-base/properties.h>
 
 #include <log/log.h>
+#include <private/EGL/drivers.h>
 
 #include "../egl_impl.h"
 
@@ -207,6 +208,11 @@ EGLBoolean egl_init_drivers() {
     return res;
 }
 
+// called from the zygote before forking apps
+bool egl_preload_drivers() {
+    return egl_init_drivers() == EGL_TRUE;
+}
+
 static pthread_mutex_t sLogPrintMutex = PTHREAD_MUTEX_INITIALIZER;
 static std::chrono::steady_clock::time_point sLogPrintTime;
 static constexpr std::chrono::seconds DURATION(1);
@@ -22,12 +22,17 @@
 
 #include <private/EGL/cache.h>
 
+#include <inttypes.h>
 #include <unistd.h>
 
 #include <thread>
 
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 #include <log/log.h>
 
+#include "FileBlobCache.h"
+
 // Cache size limits.
 static const size_t maxKeySize = 12 * 1024;
 static const size_t maxValueSize = 64 * 1024;
@@ -36,6 +41,11 @@ static const size_t maxTotalSize = 2 * 1024 * 1024;
 // The time in seconds to wait before saving newly inserted cache entries.
 static const unsigned int deferredSaveDelay = 4;
 
+// The property naming an optional cache file shared by all processes, which is
+// consulted before their own cache. It is never written to, and is typically a
+// per-app cache file warmed up with the system UI on the same build.
+static const char* sharedCacheProperty = "ro.egl.shared_blob_cache";
+
 // ----------------------------------------------------------------------------
 namespace android {
 // ----------------------------------------------------------------------------
@@ -64,7 +74,8 @@ static EGLsizeiANDROID getBlob(const void* key, EGLsizeiANDROID keySize,
 // egl_cache_t definition
 //
 egl_cache_t::egl_cache_t() :
-        mInitialized(false) {
+        mInitialized(false),
+        mSharedBlobCacheLoaded(false) {
 }
 
 egl_cache_t::~egl_cache_t() {
@@ -81,6 +92,14 @@ void egl_cache_t::initialize(egl_display_t *display) {
 
     egl_connection_t* const cnx = &gEGLImpl;
     if (cnx->dso && cnx->major >= 0 && cnx->minor >= 0) {
+        // Entries are only reused with the driver that created them.
+        const char* vendor = display->disp.queryString.vendor;
+        const char* version = display->disp.queryString.version;
+        std::string driver = std::string(vendor ? vendor : "") + "\n" + (version ? version : "");
+        mFingerprint = base::StringPrintf("%s/%08" PRIx32,
+                base::GetProperty("ro.build.id", "").c_str(),
+                crc32c(reinterpret_cast<const uint8_t*>(driver.data()), driver.size()));
+
         const char* exts = display->disp.queryString.extensions;
         size_t bcExtLen = strlen(BC_EXT_STR);
         size_t extsLen = strlen(exts);
@@ -115,55 +134,82 @@ void egl_cache_t::initialize(egl_display_t *display) {
 }
 
 void egl_cache_t::terminate() {
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (mBlobCache) {
-        mBlobCache->writeToFile();
+    std::shared_ptr<MappedBlobCache> bc;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        bc = std::move(mBlobCache);
+        mBlobCache = nullptr;
+        mSharedBlobCache = nullptr;
+        mSharedBlobCacheLoaded = false;
+    }
+    if (bc) {
+        bc->writeToFile();
     }
-    mBlobCache = nullptr;
 }
 
 void egl_cache_t::setBlob(const void* key, EGLsizeiANDROID keySize,
         const void* value, EGLsizeiANDROID valueSize) {
-    std::lock_guard<std::mutex> lock(mMutex);
-
     if (keySize < 0 || valueSize < 0) {
         ALOGW("EGL_ANDROID_blob_cache set: negative sizes are not allowed");
         return;
     }
 
-    if (mInitialized) {
-        BlobCache* bc = getBlobCacheLocked();
-        bc->set(key, keySize, value, valueSize);
+    std::shared_ptr<MappedBlobCache> bc;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mInitialized) {
+            return;
+        }
+        bc = getBlobCacheLocked();
 
         if (!mSavePending) {
             mSavePending = true;
             std::thread deferredSaveThread([this]() {
                 sleep(deferredSaveDelay);
-                std::lock_guard<std::mutex> lock(mMutex);
-                if (mInitialized && mBlobCache) {
-                    mBlobCache->writeToFile();
+                std::shared_ptr<MappedBlobCache> bc;
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    if (mInitialized) {
+                        bc = mBlobCache;
+                    }
+                    mSavePending = false;
+                }
+                if (bc) {
+                    bc->writeToFile();
                 }
-                mSavePending = false;
             });
             deferredSaveThread.detach();
         }
     }
+    // The cache does its own locking, so that threads compiling shaders do not
+    // wait for each other here.
+    bc->set(key, keySize, value, valueSize);
 }
 
 EGLsizeiANDROID egl_cache_t::getBlob(const void* key, EGLsizeiANDROID keySize,
         void* value, EGLsizeiANDROID valueSize) {
-    std::lock_guard<std::mutex> lock(mMutex);
-
     if (keySize < 0 || valueSize < 0) {
         ALOGW("EGL_ANDROID_blob_cache set: negative sizes are not allowed");
         return 0;
     }
 
-    if (mInitialized) {
-        BlobCache* bc = getBlobCacheLocked();
-        return bc->get(key, keySize, value, valueSize);
+    std::shared_ptr<MappedBlobCache> bc;
+    std::shared_ptr<MappedBlobCache> shared;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mInitialized) {
+            return 0;
+        }
+        bc = getBlobCacheLocked();
+        shared = getSharedBlobCacheLocked();
     }
-    return 0;
+    if (shared) {
+        EGLsizeiANDROID size = shared->get(key, keySize, value, valueSize);
+        if (size != 0) {
+            return size;
+        }
+    }
+    return bc->get(key, keySize, value, valueSize);
 }
 
 void egl_cache_t::setCacheFilename(const char* filename) {
@@ -171,11 +217,28 @@ void egl_cache_t::setCacheFilename(const char* filename) {
     mFilename = filename;
 }
 
-BlobCache* egl_cache_t::getBlobCacheLocked() {
+std::shared_ptr<MappedBlobCache> egl_cache_t::getBlobCacheLocked() {
     if (mBlobCache == nullptr) {
-        mBlobCache.reset(new FileBlobCache(maxKeySize, maxValueSize, maxTotalSize, mFilename));
+        mBlobCache = std::make_shared<MappedBlobCache>(maxKeySize, maxValueSize, maxTotalSize,
+                                                       mFilename, mFingerprint);
+    }
+    return mBlobCache;
+}
+
+std::shared_ptr<MappedBlobCache> egl_cache_t::getSharedBlobCacheLocked() {
+    if (!mSharedBlobCacheLoaded) {
+        mSharedBlobCacheLoaded = true;
+        std::string filename = base::GetProperty(sharedCacheProperty, "");
+        if (!filename.empty()) {
+            mSharedBlobCache = std::make_shared<MappedBlobCache>(maxKeySize, maxValueSize,
+                    maxTotalSize, filename, mFingerprint, true /* readOnly */);
+            if (mSharedBlobCache->getTotalSize() == 0) {
+                // Missing, or made for another build or driver.
+                mSharedBlobCache = nullptr;
+            }
+        }
     }
-    return mBlobCache.get();
+    return mSharedBlobCache;
 }
 
 // ----------------------------------------------------------------------------
@@ -20,7 +20,7 @@
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 
-#include "FileBlobCache.h"
+#include "MappedBlobCache.h"
 
 #include <memory>
 #include <mutex>
@@ -76,11 +76,15 @@ private:
     egl_cache_t(const egl_cache_t&); // not implemented
     void operator=(const egl_cache_t&); // not implemented
 
-    // getBlobCacheLocked returns the BlobCache object being used to store the
-    // key/value blob pairs.  If the BlobCache object has not yet been created,
-    // this will do so, loading the serialized cache contents from disk if
-    // possible.
-    BlobCache* getBlobCacheLocked();
+    // getBlobCacheLocked returns the MappedBlobCache object being used to
+    // store the key/value blob pairs.  If the MappedBlobCache object has not
+    // yet been created, this will do so, indexing the cache file if possible.
+    // The returned reference keeps the cache alive after mMutex is released.
+    std::shared_ptr<MappedBlobCache> getBlobCacheLocked();
+
+    // getSharedBlobCacheLocked returns the read-only cache shared by all
+    // processes, or NULL if there is none for this build and driver.
+    std::shared_ptr<MappedBlobCache> getSharedBlobCacheLocked();
 
     // mInitialized indicates whether the egl_cache_t is in the initialized
     // state.  It is initialized to false at construction time, and gets set to
@@ -92,8 +96,19 @@ private:
 
     // mBlobCache is the cache in which the key/value blob pairs are stored.  It
     // is initially NULL, and will be initialized by getBlobCacheLocked the
-    // first time it's needed.
-    std::unique_ptr<FileBlobCache> mBlobCache;
+    // first time it's needed.  It does its own locking, so getBlob and setBlob
+    // only hold mMutex long enough to get a reference to it.
+    std::shared_ptr<MappedBlobCache> mBlobCache;
+
+    // mSharedBlobCache is the pre-populated cache that getBlob looks into
+    // before mBlobCache.  It is loaded by getSharedBlobCacheLocked the first
+    // time it's needed, which sets mSharedBlobCacheLoaded.
+    std::shared_ptr<MappedBlobCache> mSharedBlobCache;
+    bool mSharedBlobCacheLoaded;
+
+    // mFingerprint identifies the build and the driver, set by initialize.  The
+    // cache files are discarded when it changes.
+    std::string mFingerprint;
 
     // mFilename is the name of the file for storing cache contents in between
     // program invocations.  It is initialized to an empty string at
@@ -107,15 +107,31 @@ egl_display_t* egl_display_t::get(EGLDisplay dpy) {
 
 void egl_display_t::addObject(egl_object_t* object) {
     std::lock_guard<std::mutex> _l(lock);
-    objects.insert(object);
+    if (!objectTable.insert(object)) {
+        objects.insert(object);
+    }
 }
 
 void egl_display_t::removeObject(egl_object_t* object) {
     std::lock_guard<std::mutex> _l(lock);
-    objects.erase(object);
+    if (!objectTable.remove(object)) {
+        objects.erase(object);
+    }
 }
 
 bool egl_display_t::getObject(egl_object_t* object) const {
+    bool found = false;
+    // Objects in the table are checked without the lock.
+    if (objectTable.acquire(object, [this, &found](egl_object_t* o) {
+            found = true;
+            return o->getDisplay() == this;
+        })) {
+        return true;
+    }
+    if (found) {
+        return false;
+    }
+
     std::lock_guard<std::mutex> _l(lock);
     if (objects.find(object) != objects.end()) {
         if (object->getDisplay() == this) {
@@ -438,8 +454,9 @@ EGLBoolean egl_display_t::terminate() {
         // Mark all objects remaining in the list as terminated, unless
         // there are no reference to them, it which case, we're free to
         // delete them.
-        size_t count = objects.size();
+        size_t count = objectTable.size() + objects.size();
         ALOGW_IF(count, "eglTerminate() called w/ %zu objects remaining", count);
+        objectTable.clear([](egl_object_t* o) { o->destroy(); });
         for (auto o : objects) {
             o->destroy();
         }
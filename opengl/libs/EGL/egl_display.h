@@ -32,6 +32,7 @@
 #include <cutils/compiler.h>
 
 #include "egldefs.h"
+#include "egl_object_table.h"
 #include "../hooks.h"
 
 // ----------------------------------------------------------------------------
@@ -125,6 +126,10 @@ private:
     mutable std::mutex                  lock;
     mutable std::mutex                  refLock;
     mutable std::condition_variable     refCond;
+            // The objects of this display. Most of them are in objectTable,
+            // which getObject reads without the lock; objects holds the ones
+            // that did not fit. Both are written with the lock held.
+            egl_object_table_t<egl_object_t> objectTable;
             std::unordered_set<egl_object_t*> objects;
             std::string mVendorString;
             std::string mVersionString;
@@ -65,7 +65,8 @@ egl_surface_t::egl_surface_t(egl_display_t* dpy, EGLConfig config, EGLNativeWind
         connected(true),
         colorSpace(colorSpace),
         egl_smpte2086_dirty(false),
-        egl_cta861_3_dirty(false) {
+        egl_cta861_3_dirty(false),
+        performTable(nullptr) {
     egl_smpte2086_metadata.displayPrimaryRed = { EGL_DONT_CARE, EGL_DONT_CARE };
     egl_smpte2086_metadata.displayPrimaryGreen = { EGL_DONT_CARE, EGL_DONT_CARE };
     egl_smpte2086_metadata.displayPrimaryBlue = { EGL_DONT_CARE, EGL_DONT_CARE };
@@ -77,6 +78,7 @@ egl_surface_t::egl_surface_t(egl_display_t* dpy, EGLConfig config, EGLNativeWind
 
     if (win) {
         win->incStrong(this);
+        native_window_get_perform_table(win, &performTable);
     }
 }
 
@@ -97,6 +99,27 @@ void egl_surface_t::disconnect() {
     }
 }
 
+int egl_surface_t::setBuffersTimestamp(int64_t timestamp) const {
+    if (performTable) {
+        return performTable->setBuffersTimestamp(win, timestamp);
+    }
+    return native_window_set_buffers_timestamp(win, timestamp);
+}
+
+int egl_surface_t::setSurfaceDamage(const android_native_rect_t* rects, size_t numRects) const {
+    if (performTable) {
+        return performTable->setSurfaceDamage(win, rects, numRects);
+    }
+    return native_window_set_surface_damage(win, rects, numRects);
+}
+
+int egl_surface_t::getNextFrameId(uint64_t* frameId) const {
+    if (performTable) {
+        return performTable->getNextFrameId(win, frameId);
+    }
+    return native_window_get_next_frame_id(win, frameId);
+}
+
 EGLBoolean egl_surface_t::setSmpte2086Attribute(EGLint attribute, EGLint value) {
     switch (attribute) {
         case EGL_SMPTE2086_DISPLAY_PRIMARY_RX_EXT:
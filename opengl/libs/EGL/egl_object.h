@@ -147,6 +147,12 @@ public:
     void resetSmpte2086Metadata() { egl_smpte2086_dirty = false; }
     void resetCta8613Metadata() { egl_cta861_3_dirty = false; }
 
+    // Per-frame window operations. They use the window's perform table when it
+    // has one, and ANativeWindow::perform otherwise.
+    int setBuffersTimestamp(int64_t timestamp) const;
+    int setSurfaceDamage(const android_native_rect_t* rects, size_t numRects) const;
+    int getNextFrameId(uint64_t* frameId) const;
+
     // Try to keep the order of these fields and size unchanged. It's not public API, but
     // it's not hard to imagine native games accessing them.
     EGLSurface surface;
@@ -184,6 +190,9 @@ private:
 
     egl_smpte2086_metadata egl_smpte2086_metadata;
     egl_cta861_3_metadata egl_cta861_3_metadata;
+
+    // The perform table of win, or nullptr.
+    const ANativeWindowPerformTable* performTable;
 };
 
 class egl_context_t: public egl_object_t {
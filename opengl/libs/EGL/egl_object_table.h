@@ -0,0 +1,187 @@
+/*
+ ** Copyright 2020, The Android Open Source Project
+ **
+ ** Licensed under the Apache License, Version 2.0 (the "License");
+ ** you may not use this file except in compliance with the License.
+ ** You may obtain a copy of the License at
+ **
+ **     http://www.apache.org/licenses/LICENSE-2.0
+ **
+ ** Unless required by applicable law or agreed to in writing, software
+ ** distributed under the License is distributed on an "AS IS" BASIS,
+ ** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ ** See the License for the specific language governing permissions and
+ ** limitations under the License.
+ */
+
+#ifndef ANDROID_EGL_OBJECT_TABLE_H
+#define ANDROID_EGL_OBJECT_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+
+// ----------------------------------------------------------------------------
+namespace android {
+// ----------------------------------------------------------------------------
+
+// A fixed size set of object pointers that can be looked up without a lock.
+//
+// EGL handles are the addresses of the egl_object_t they stand for, and
+// applications may pass handles of objects that were destroyed since. This
+// table lets egl_display_t check a handle and take a reference to its object
+// without locking the display, which every EGL call taking a surface or a
+// context does.
+//
+// insert, remove and clear must be serialized by the caller. acquire may be
+// called concurrently with them from any thread: each slot counts the readers
+// looking at it, and remove waits for them to leave before returning, so an
+// object is never destroyed while a reader is taking a reference to it.
+//
+// Objects are hashed by address into kSize slots, and only kMaxProbes slots
+// are ever looked at per object. insert fails when they are all taken, in
+// which case the caller keeps the object somewhere else.
+template <typename T>
+class egl_object_table_t {
+public:
+    enum {
+        kSize = 512,
+        kMaxProbes = 16,
+    };
+
+    egl_object_table_t() = default;
+    egl_object_table_t(const egl_object_table_t&) = delete;
+    egl_object_table_t& operator=(const egl_object_table_t&) = delete;
+
+    // Adds an object to the table, returning false if there is no room for it.
+    bool insert(T* object) {
+        const uintptr_t value = reinterpret_cast<uintptr_t>(object);
+        const size_t first = hash(value);
+        for (size_t i = 0; i < kMaxProbes; i++) {
+            Slot& slot = mSlots[(first + i) & kMask];
+            const uintptr_t current = slot.object.load(std::memory_order_relaxed);
+            if (current == kEmpty || current == kRemoved) {
+                slot.object.store(value);
+                mCount++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Removes an object from the table, returning false if it was not in it.
+    // Once this returns, acquire can no longer return the object.
+    bool remove(T* object) {
+        Slot* slot = find(reinterpret_cast<uintptr_t>(object));
+        if (!slot) {
+            return false;
+        }
+        evict(*slot);
+        mCount--;
+        return true;
+    }
+
+    // Removes all the objects from the table, calling |func| on each of them
+    // once acquire can no longer return it.
+    template <typename Func>
+    void clear(Func func) {
+        for (Slot& slot : mSlots) {
+            const uintptr_t value = slot.object.load(std::memory_order_relaxed);
+            if (value != kEmpty && value != kRemoved) {
+                evict(slot);
+                func(reinterpret_cast<T*>(value));
+            }
+            // No object is reachable past this slot anymore, so the probes
+            // can stop here.
+            slot.object.store(kEmpty);
+        }
+        mCount = 0;
+    }
+
+    // If |object| is in the table and |pred| accepts it, takes a reference
+    // to it with T::incRef and returns true.
+    template <typename Pred>
+    bool acquire(T* object, Pred pred) const {
+        const uintptr_t value = reinterpret_cast<uintptr_t>(object);
+        const size_t first = hash(value);
+        for (size_t i = 0; i < kMaxProbes; i++) {
+            Slot& slot = mSlots[(first + i) & kMask];
+            const uintptr_t current = slot.object.load(std::memory_order_relaxed);
+            if (current == kEmpty) {
+                return false;
+            }
+            if (current != value) {
+                continue;
+            }
+            // Check the slot again once the reader is counted: if the object
+            // is still there, remove is waiting for this reader to leave.
+            slot.readers.fetch_add(1);
+            bool acquired = false;
+            if (slot.object.load() == value && pred(object)) {
+                object->incRef();
+                acquired = true;
+            }
+            slot.readers.fetch_sub(1, std::memory_order_release);
+            return acquired;
+        }
+        return false;
+    }
+
+    // Returns the number of objects in the table. Must be serialized with the
+    // writers.
+    size_t size() const { return mCount; }
+
+private:
+    enum : size_t { kMask = kSize - 1 };
+    static_assert((kSize & kMask) == 0, "kSize must be a power of 2");
+
+    // Slot values that are not objects. kRemoved, unlike kEmpty, does not
+    // stop the probes, since some object may have been inserted past it.
+    static constexpr uintptr_t kEmpty = 0;
+    static constexpr uintptr_t kRemoved = 1;
+
+    struct Slot {
+        std::atomic<uintptr_t> object{kEmpty};
+        std::atomic<uint32_t> readers{0};
+    };
+
+    static size_t hash(uintptr_t value) {
+        // Objects are at least 8-byte aligned.
+        return static_cast<size_t>((value >> 3) * 0x9E3779B97F4A7C15ULL >> 32) & kMask;
+    }
+
+    Slot* find(uintptr_t value) {
+        const size_t first = hash(value);
+        for (size_t i = 0; i < kMaxProbes; i++) {
+            Slot& slot = mSlots[(first + i) & kMask];
+            const uintptr_t current = slot.object.load(std::memory_order_relaxed);
+            if (current == kEmpty) {
+                return nullptr;
+            }
+            if (current == value) {
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    // Takes the object out of |slot| and waits for the readers that may have
+    // seen it.
+    static void evict(Slot& slot) {
+        slot.object.store(kRemoved);
+        while (slot.readers.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+
+    mutable Slot mSlots[kSize];
+    size_t mCount = 0;
+};
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+// ----------------------------------------------------------------------------
+
+#endif // ANDROID_EGL_OBJECT_TABLE_H
@@ -0,0 +1,163 @@
+/*
+ ** Copyright 2020, The Android Open Source Project
+ **
+ ** Licensed under the Apache License, Version 2.0 (the "License");
+ ** you may not use this file except in compliance with the License.
+ ** You may obtain a copy of the License at
+ **
+ **     http://www.apache.org/licenses/LICENSE-2.0
+ **
+ ** Unless required by applicable law or agreed to in writing, software
+ ** distributed under the License is distributed on an "AS IS" BASIS,
+ ** WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ ** See the License for the specific language governing permissions and
+ ** limitations under the License.
+ */
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "egl_object_table.h"
+
+namespace android {
+
+struct TestObject {
+    void incRef() { refs++; }
+    std::atomic<int> refs{0};
+    std::atomic<bool> alive{true};
+};
+
+using TestTable = egl_object_table_t<TestObject>;
+
+static bool any(TestObject*) {
+    return true;
+}
+
+TEST(EGLObjectTableTest, AcquireInsertedObject) {
+    TestTable table;
+    TestObject object;
+    ASSERT_TRUE(table.insert(&object));
+    ASSERT_EQ(size_t(1), table.size());
+    ASSERT_TRUE(table.acquire(&object, any));
+    ASSERT_EQ(1, object.refs);
+}
+
+TEST(EGLObjectTableTest, AcquireUnknownObjectFails) {
+    TestTable table;
+    TestObject object, other;
+    ASSERT_TRUE(table.insert(&object));
+    ASSERT_FALSE(table.acquire(&other, any));
+    ASSERT_EQ(0, other.refs);
+}
+
+TEST(EGLObjectTableTest, AcquireRejectedObjectFails) {
+    TestTable table;
+    TestObject object;
+    ASSERT_TRUE(table.insert(&object));
+    ASSERT_FALSE(table.acquire(&object, [](TestObject*) { return false; }));
+    ASSERT_EQ(0, object.refs);
+}
+
+TEST(EGLObjectTableTest, AcquireRemovedObjectFails) {
+    TestTable table;
+    TestObject object;
+    ASSERT_TRUE(table.insert(&object));
+    ASSERT_TRUE(table.remove(&object));
+    ASSERT_FALSE(table.remove(&object));
+    ASSERT_EQ(size_t(0), table.size());
+    ASSERT_FALSE(table.acquire(&object, any));
+    ASSERT_EQ(0, object.refs);
+}
+
+TEST(EGLObjectTableTest, FullTableRejectsObjects) {
+    TestTable table;
+    std::vector<TestObject> objects(TestTable::kSize * 2);
+    std::vector<TestObject*> inserted;
+    for (TestObject& object : objects) {
+        if (table.insert(&object)) {
+            inserted.push_back(&object);
+        }
+    }
+    ASSERT_LE(inserted.size(), size_t(TestTable::kSize));
+    ASSERT_LT(inserted.size(), objects.size());
+    ASSERT_EQ(inserted.size(), table.size());
+    for (TestObject* object : inserted) {
+        ASSERT_TRUE(table.acquire(object, any));
+    }
+}
+
+TEST(EGLObjectTableTest, ObjectsSurviveRemovalOfOthers) {
+    TestTable table;
+    std::vector<TestObject> objects(TestTable::kSize / 2);
+    for (TestObject& object : objects) {
+        ASSERT_TRUE(table.insert(&object));
+    }
+    for (size_t i = 0; i < objects.size(); i += 2) {
+        ASSERT_TRUE(table.remove(&objects[i]));
+    }
+    for (size_t i = 0; i < objects.size(); i++) {
+        ASSERT_EQ(i % 2 == 1, table.acquire(&objects[i], any)) << i;
+    }
+}
+
+TEST(EGLObjectTableTest, ClearVisitsEachObjectOnce) {
+    TestTable table;
+    std::vector<TestObject> objects(64);
+    for (TestObject& object : objects) {
+        ASSERT_TRUE(table.insert(&object));
+    }
+    std::set<TestObject*> cleared;
+    table.clear([&cleared](TestObject* object) { ASSERT_TRUE(cleared.insert(object).second); });
+    ASSERT_EQ(objects.size(), cleared.size());
+    ASSERT_EQ(size_t(0), table.size());
+    for (TestObject& object : objects) {
+        ASSERT_FALSE(table.acquire(&object, any));
+    }
+    ASSERT_TRUE(table.insert(&objects[0]));
+    ASSERT_TRUE(table.acquire(&objects[0], any));
+}
+
+TEST(EGLObjectTableTest, RemoveWaitsForReaders) {
+    TestTable table;
+    std::vector<std::unique_ptr<TestObject>> objects(8);
+    for (auto& object : objects) {
+        object.reset(new TestObject);
+        ASSERT_TRUE(table.insert(object.get()));
+    }
+
+    std::atomic<bool> done(false);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 2; t++) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                for (auto& object : objects) {
+                    // A removed object is marked dead only after remove returns,
+                    // so a reader must never see it dead.
+                    table.acquire(object.get(), [](TestObject* o) {
+                        EXPECT_TRUE(o->alive);
+                        return true;
+                    });
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        TestObject* object = objects[i % objects.size()].get();
+        ASSERT_TRUE(table.remove(object));
+        object->alive = false;
+        object->alive = true;
+        ASSERT_TRUE(table.insert(object));
+    }
+    done = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+}
+
+} // namespace android
@@ -1440,8 +1440,7 @@ EGLBoolean eglSwapBuffersWithDamageKHRImpl(EGLDisplay dpy, EGLSurface draw,
         androidRects.push_back(androidRect);
     }
     if (!s->cnx->useAngle) {
-        native_window_set_surface_damage(s->getNativeWindow(), androidRects.data(),
-                                         androidRects.size());
+        s->setSurfaceDamage(androidRects.data(), androidRects.size());
     }
 
     if (s->cnx->egl.eglSwapBuffersWithDamageKHR) {
@@ -2242,7 +2241,7 @@ EGLBoolean eglPresentationTimeANDROIDImpl(EGLDisplay dpy, EGLSurface surface,
     }
 
     egl_surface_t const * const s = get_surface(surface);
-    native_window_set_buffers_timestamp(s->getNativeWindow(), time);
+    s->setBuffersTimestamp(time);
 
     return EGL_TRUE;
 }
@@ -2332,7 +2331,7 @@ EGLBoolean eglGetNextFrameIdANDROIDImpl(EGLDisplay dpy, EGLSurface surface,
     }
 
     uint64_t nextFrameId = 0;
-    int ret = native_window_get_next_frame_id(s->getNativeWindow(), &nextFrameId);
+    int ret = s->getNextFrameId(&nextFrameId);
 
     if (ret != 0) {
         // This should not happen. Return an error that is not in the spec
@@ -0,0 +1,29 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cutils/compiler.h>
+
+namespace android {
+
+// Loads the GLES driver and resolves its entry points without initializing a display, so that
+// processes forked afterwards, i.e. apps forked from the zygote, find the dispatch tables ready
+// at eglGetDisplay. Processes that are set up with an updated driver or ANGLE still unload it
+// and load their own. Returns false if no driver could be loaded.
+ANDROID_API bool egl_preload_drivers();
+
+} // namespace android
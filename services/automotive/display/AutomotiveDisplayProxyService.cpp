@@ -31,68 +31,72 @@ namespace implementation {
 Return<sp<IGraphicBufferProducer>>
 AutomotiveDisplayProxyService::getIGraphicBufferProducer(uint64_t id) {
     auto it = mDisplays.find(id);
-    sp<IBinder> displayToken = nullptr;
-    sp<SurfaceControl> surfaceControl = nullptr;
-    if (it == mDisplays.end()) {
-        displayToken = SurfaceComposerClient::getPhysicalDisplayToken(id);
-        if (displayToken == nullptr) {
-            ALOGE("Given display id, 0x%lX, is invalid.", (unsigned long)id);
-            return nullptr;
-        }
+    if (it != mDisplays.end()) {
+        return it->second.producer;
+    }
 
-        // Get the resolution from stored display state.
-        DisplayConfig displayConfig = {};
-        auto err = SurfaceComposerClient::getActiveDisplayConfig(displayToken, &displayConfig);
-        if (err != NO_ERROR) {
-            ALOGE("Failed to get display configuration of %lX.  "
-                  "This display will be ignored.", (unsigned long)id);
-            return nullptr;
-        }
+    sp<IBinder> displayToken = SurfaceComposerClient::getPhysicalDisplayToken(id);
+    if (displayToken == nullptr) {
+        ALOGE("Given display id, 0x%lX, is invalid.", (unsigned long)id);
+        return nullptr;
+    }
 
-        ui::DisplayState displayState = {};
-        err = SurfaceComposerClient::getDisplayState(displayToken, &displayState);
-        if (err != NO_ERROR) {
-            ALOGE("Failed to get current display status of %lX.  "
-                  "This display will be ignored.", (unsigned long)id);
-            return nullptr;
-        }
+    // Get the resolution from stored display state.
+    DisplayConfig displayConfig = {};
+    auto err = SurfaceComposerClient::getActiveDisplayConfig(displayToken, &displayConfig);
+    if (err != NO_ERROR) {
+        ALOGE("Failed to get display configuration of %lX.  "
+              "This display will be ignored.", (unsigned long)id);
+        return nullptr;
+    }
 
-        auto displayWidth  = displayConfig.resolution.getWidth();
-        auto displayHeight = displayConfig.resolution.getHeight();
-        if ((displayState.orientation != ui::ROTATION_0) &&
-            (displayState.orientation != ui::ROTATION_180)) {
-            std::swap(displayWidth, displayHeight);
-        }
+    ui::DisplayState displayState = {};
+    err = SurfaceComposerClient::getDisplayState(displayToken, &displayState);
+    if (err != NO_ERROR) {
+        ALOGE("Failed to get current display status of %lX.  "
+              "This display will be ignored.", (unsigned long)id);
+        return nullptr;
+    }
 
-        sp<android::SurfaceComposerClient> surfaceClient = new SurfaceComposerClient();
-        err = surfaceClient->initCheck();
-        if (err != NO_ERROR) {
-            ALOGE("SurfaceComposerClient::initCheck error: %#x", err);
-            return nullptr;
-        }
+    auto displayWidth  = displayConfig.resolution.getWidth();
+    auto displayHeight = displayConfig.resolution.getHeight();
+    if ((displayState.orientation != ui::ROTATION_0) &&
+        (displayState.orientation != ui::ROTATION_180)) {
+        std::swap(displayWidth, displayHeight);
+    }
 
-        // Create a SurfaceControl instance
-        surfaceControl = surfaceClient->createSurface(
-                String8::format("AutomotiveDisplay::%lX", (unsigned long)id),
-                displayWidth, displayHeight,
-                PIXEL_FORMAT_RGBX_8888, ISurfaceComposerClient::eOpaque);
-        if (surfaceControl == nullptr || !surfaceControl->isValid()) {
-            ALOGE("Failed to create SurfaceControl.");
-            return nullptr;
-        }
+    sp<android::SurfaceComposerClient> surfaceClient = new SurfaceComposerClient();
+    err = surfaceClient->initCheck();
+    if (err != NO_ERROR) {
+        ALOGE("SurfaceComposerClient::initCheck error: %#x", err);
+        return nullptr;
+    }
 
-        // Store
-        DisplayDesc descriptor = {displayToken, surfaceControl};
-        mDisplays.insert_or_assign(id, std::move(descriptor));
-    } else {
-        displayToken = it->second.token;
-        surfaceControl = it->second.surfaceControl;
+    // Create a SurfaceControl instance
+    sp<SurfaceControl> surfaceControl = surfaceClient->createSurface(
+            String8::format("AutomotiveDisplay::%lX", (unsigned long)id),
+            displayWidth, displayHeight,
+            PIXEL_FORMAT_RGBX_8888,
+            ISurfaceComposerClient::eOpaque | ISurfaceComposerClient::eFXSurfaceBufferState);
+    if (surfaceControl == nullptr || !surfaceControl->isValid()) {
+        ALOGE("Failed to create SurfaceControl.");
+        return nullptr;
     }
 
-    // SurfaceControl::getSurface is guaranteed to be not null.
-    auto targetSurface = surfaceControl->getSurface();
-    return new ::android::hardware::graphics::bufferqueue::V2_0::utils::
-               B2HGraphicBufferProducer(targetSurface->getIGraphicBufferProducer());
+    // The buffer queue lives in this process, and queued buffers are sent
+    // to SurfaceFlinger in transactions.  This way, dequeueBuffer() and
+    // queueBuffer() from the client do not make a second binder call
+    // into SurfaceFlinger behind every HIDL call.
+    sp<BLASTBufferQueue> bufferQueue =
+            new BLASTBufferQueue(surfaceControl, displayWidth, displayHeight);
+    sp<IGraphicBufferProducer> producer =
+            new ::android::hardware::graphics::bufferqueue::V2_0::utils::
+                    B2HGraphicBufferProducer(bufferQueue->getIGraphicBufferProducer());
+
+    // Store
+    DisplayDesc descriptor = {displayToken, surfaceControl, bufferQueue, producer};
+    mDisplays.insert_or_assign(id, std::move(descriptor));
+    return producer;
 }
 
 
@@ -16,6 +16,7 @@
 #pragma once
 
 #include <android/frameworks/automotive/display/1.0/IAutomotiveDisplayProxyService.h>
+#include <gui/BLASTBufferQueue.h>
 #include <gui/IGraphicBufferProducer.h>
 #include <gui/ISurfaceComposer.h>
 #include <gui/Surface.h>
@@ -38,8 +39,10 @@ using ::android::sp;
 
 
 typedef struct DisplayDesc {
-    sp<IBinder>        token;
-    sp<SurfaceControl> surfaceControl;
+    sp<IBinder>                 token;
+    sp<SurfaceControl>          surfaceControl;
+    sp<BLASTBufferQueue>        bufferQueue;
+    sp<IGraphicBufferProducer>  producer;
 } DisplayDesc;
 
 
@@ -16,6 +16,7 @@
 
 #include <unistd.h>
 
+#include <binder/ProcessState.h>
 #include <hidl/HidlTransportSupport.h>
 #include <log/log.h>
 #include <utils/Errors.h>
@@ -42,6 +43,10 @@ int main() {
     android::sp<IAutomotiveDisplayProxyService> service =
         new AutomotiveDisplayProxyService();
 
+    // SurfaceFlinger releases the buffers of the display windows through
+    // binder callbacks.
+    android::ProcessState::self()->startThreadPool();
+
     configureRpcThreadpool(1, true /* callerWillJoin */);
 
     // Register our service -- if somebody is already registered by our name,
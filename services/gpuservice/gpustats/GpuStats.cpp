@@ -26,6 +26,7 @@
 #include <statslog.h>
 #include <utils/Trace.h>
 
+#include <thread>
 #include <unordered_set>
 
 namespace android {
@@ -37,22 +38,27 @@ GpuStats::~GpuStats() {
     }
 }
 
-static void addLoadingCount(GpuStatsInfo::Driver driver, bool isDriverLoaded,
-                            GpuStatsGlobalInfo* const outGlobalInfo) {
+// PendingGlobalInfo::state and PendingAppInfo::state values.
+static const uint32_t SLOT_EMPTY = 0;
+static const uint32_t SLOT_CLAIMING = 1;
+static const uint32_t SLOT_READY = 2;
+
+static void addLoadingCount(GpuStatsInfo::Driver driver, int32_t loadingCount,
+                            int32_t loadingFailureCount, GpuStatsGlobalInfo* const outGlobalInfo) {
     switch (driver) {
         case GpuStatsInfo::Driver::GL:
         case GpuStatsInfo::Driver::GL_UPDATED:
-            outGlobalInfo->glLoadingCount++;
-            if (!isDriverLoaded) outGlobalInfo->glLoadingFailureCount++;
+            outGlobalInfo->glLoadingCount += loadingCount;
+            outGlobalInfo->glLoadingFailureCount += loadingFailureCount;
             break;
         case GpuStatsInfo::Driver::VULKAN:
         case GpuStatsInfo::Driver::VULKAN_UPDATED:
-            outGlobalInfo->vkLoadingCount++;
-            if (!isDriverLoaded) outGlobalInfo->vkLoadingFailureCount++;
+            outGlobalInfo->vkLoadingCount += loadingCount;
+            outGlobalInfo->vkLoadingFailureCount += loadingFailureCount;
             break;
         case GpuStatsInfo::Driver::ANGLE:
-            outGlobalInfo->angleLoadingCount++;
-            if (!isDriverLoaded) outGlobalInfo->angleLoadingFailureCount++;
+            outGlobalInfo->angleLoadingCount += loadingCount;
+            outGlobalInfo->angleLoadingFailureCount += loadingFailureCount;
             break;
         default:
             break;
@@ -84,6 +90,84 @@ static void addLoadingTime(GpuStatsInfo::Driver driver, int64_t driverLoadingTim
     }
 }
 
+// Returns the slot found by |matches| with open addressing from |hash|, or claims an empty one and
+// sets it up with |init|. Returns nullptr if all the slots are taken.
+template <typename Slot, typename Matches, typename Init>
+static Slot* findOrClaimSlot(Slot* slots, size_t numSlots, size_t hash, Matches matches,
+                             Init init) {
+    for (size_t i = 0; i < numSlots; i++) {
+        Slot* slot = &slots[(hash + i) % numSlots];
+        uint32_t state = slot->state.load(std::memory_order_acquire);
+        if (state == SLOT_EMPTY &&
+            slot->state.compare_exchange_strong(state, SLOT_CLAIMING, std::memory_order_acq_rel)) {
+            init(slot);
+            slot->state.store(SLOT_READY, std::memory_order_release);
+            return slot;
+        }
+        // Another thread is writing the key of this slot, which only takes a moment.
+        while (state == SLOT_CLAIMING) {
+            std::this_thread::yield();
+            state = slot->state.load(std::memory_order_acquire);
+        }
+        if (matches(slot)) {
+            return slot;
+        }
+    }
+    return nullptr;
+}
+
+GpuStats::PendingStats* GpuStats::beginWrite() {
+    while (true) {
+        PendingStats* pending = mPending[mActivePending.load()].get();
+        pending->writers.fetch_add(1);
+        // flushLocked switches mActivePending before waiting for the writers, so this either
+        // sees the switch or holds the flush back until endWrite.
+        if (pending == mPending[mActivePending.load()].get()) {
+            return pending;
+        }
+        pending->writers.fetch_sub(1);
+    }
+}
+
+void GpuStats::endWrite(PendingStats* pending) {
+    pending->writers.fetch_sub(1, std::memory_order_release);
+}
+
+GpuStats::PendingGlobalInfo* GpuStats::getPendingGlobalInfo(
+        PendingStats* pending, const std::string& driverPackageName,
+        const std::string& driverVersionName, uint64_t driverVersionCode, int64_t driverBuildTime,
+        int32_t vulkanVersion) {
+    return findOrClaimSlot(
+            pending->globalInfos, MAX_NUM_PENDING_DRIVERS, std::hash<uint64_t>()(driverVersionCode),
+            [&](const PendingGlobalInfo* slot) {
+                return slot->driverVersionCode == driverVersionCode;
+            },
+            [&](PendingGlobalInfo* slot) {
+                slot->driverPackageName = driverPackageName;
+                slot->driverVersionName = driverVersionName;
+                slot->driverVersionCode = driverVersionCode;
+                slot->driverBuildTime = driverBuildTime;
+                slot->vulkanVersion = vulkanVersion;
+            });
+}
+
+GpuStats::PendingAppInfo* GpuStats::getPendingAppInfo(PendingStats* pending,
+                                                      const std::string& appPackageName,
+                                                      uint64_t driverVersionCode) {
+    const size_t hash =
+            std::hash<std::string>()(appPackageName) * 31 + std::hash<uint64_t>()(driverVersionCode);
+    return findOrClaimSlot(
+            pending->appInfos, MAX_NUM_PENDING_APPS, hash,
+            [&](const PendingAppInfo* slot) {
+                return slot->driverVersionCode == driverVersionCode &&
+                        slot->appPackageName == appPackageName;
+            },
+            [&](PendingAppInfo* slot) {
+                slot->appPackageName = appPackageName;
+                slot->driverVersionCode = driverVersionCode;
+            });
+}
+
 void GpuStats::insertDriverStats(const std::string& driverPackageName,
                                  const std::string& driverVersionName, uint64_t driverVersionCode,
                                  int64_t driverBuildTime, const std::string& appPackageName,
@@ -91,7 +175,6 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
                                  bool isDriverLoaded, int64_t driverLoadingTime) {
     ATRACE_CALL();
 
-    std::lock_guard<std::mutex> lock(mLock);
     registerStatsdCallbacksIfNeeded();
     ALOGV("Received:\n"
           "\tdriverPackageName[%s]\n"
@@ -107,35 +190,33 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
           appPackageName.c_str(), vulkanVersion, static_cast<int32_t>(driver), isDriverLoaded,
           driverLoadingTime);
 
-    if (!mGlobalStats.count(driverVersionCode)) {
-        GpuStatsGlobalInfo globalInfo;
-        addLoadingCount(driver, isDriverLoaded, &globalInfo);
-        globalInfo.driverPackageName = driverPackageName;
-        globalInfo.driverVersionName = driverVersionName;
-        globalInfo.driverVersionCode = driverVersionCode;
-        globalInfo.driverBuildTime = driverBuildTime;
-        globalInfo.vulkanVersion = vulkanVersion;
-        mGlobalStats.insert({driverVersionCode, globalInfo});
-    } else {
-        addLoadingCount(driver, isDriverLoaded, &mGlobalStats[driverVersionCode]);
+    PendingStats* pending = beginWrite();
+
+    PendingGlobalInfo* globalInfo =
+            getPendingGlobalInfo(pending, driverPackageName, driverVersionName, driverVersionCode,
+                                 driverBuildTime, vulkanVersion);
+    if (!globalInfo) {
+        ALOGV("Too many drivers since the last flush. Ignore new stats.");
+    } else if (static_cast<size_t>(driver) < NUM_DRIVERS) {
+        globalInfo->loadingCount[driver].fetch_add(1, std::memory_order_relaxed);
+        if (!isDriverLoaded) {
+            globalInfo->loadingFailureCount[driver].fetch_add(1, std::memory_order_relaxed);
+        }
     }
 
-    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
-    if (!mAppStats.count(appStatsKey)) {
-        if (mAppStats.size() >= MAX_NUM_APP_RECORDS) {
-            ALOGV("GpuStatsAppInfo has reached maximum size. Ignore new stats.");
-            return;
+    PendingAppInfo* appInfo = getPendingAppInfo(pending, appPackageName, driverVersionCode);
+    if (!appInfo) {
+        ALOGV("Too many apps since the last flush. Ignore new stats.");
+    } else {
+        appInfo->hasDriverStats.store(true, std::memory_order_relaxed);
+        const uint32_t index = appInfo->numLoadingTimes.fetch_add(1, std::memory_order_relaxed);
+        if (index < MAX_NUM_LOADING_TIMES) {
+            appInfo->loadingDrivers[index] = driver;
+            appInfo->loadingTimes[index] = driverLoadingTime;
         }
-
-        GpuStatsAppInfo appInfo;
-        addLoadingTime(driver, driverLoadingTime, &appInfo);
-        appInfo.appPackageName = appPackageName;
-        appInfo.driverVersionCode = driverVersionCode;
-        mAppStats.insert({appStatsKey, appInfo});
-        return;
     }
 
-    addLoadingTime(driver, driverLoadingTime, &mAppStats[appStatsKey]);
+    endWrite(pending);
 }
 
 void GpuStats::insertTargetStats(const std::string& appPackageName,
@@ -143,26 +224,101 @@ void GpuStats::insertTargetStats(const std::string& appPackageName,
                                  const uint64_t /*value*/) {
     ATRACE_CALL();
 
-    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
-
-    std::lock_guard<std::mutex> lock(mLock);
     registerStatsdCallbacksIfNeeded();
-    if (!mAppStats.count(appStatsKey)) {
-        return;
+
+    // The stats are dropped by flushLocked if the app has no driver stats.
+    PendingStats* pending = beginWrite();
+    PendingAppInfo* appInfo = getPendingAppInfo(pending, appPackageName, driverVersionCode);
+    if (appInfo) {
+        switch (stats) {
+            case GpuStatsInfo::Stats::CPU_VULKAN_IN_USE:
+                appInfo->cpuVulkanInUse.store(true, std::memory_order_relaxed);
+                break;
+            case GpuStatsInfo::Stats::FALSE_PREROTATION:
+                appInfo->falsePrerotation.store(true, std::memory_order_relaxed);
+                break;
+            case GpuStatsInfo::Stats::GLES_1_IN_USE:
+                appInfo->gles1InUse.store(true, std::memory_order_relaxed);
+                break;
+            default:
+                break;
+        }
     }
+    endWrite(pending);
+}
 
-    switch (stats) {
-        case GpuStatsInfo::Stats::CPU_VULKAN_IN_USE:
-            mAppStats[appStatsKey].cpuVulkanInUse = true;
-            break;
-        case GpuStatsInfo::Stats::FALSE_PREROTATION:
-            mAppStats[appStatsKey].falsePrerotation = true;
-            break;
-        case GpuStatsInfo::Stats::GLES_1_IN_USE:
-            mAppStats[appStatsKey].gles1InUse = true;
-            break;
-        default:
-            break;
+void GpuStats::flushLocked() {
+    const uint32_t index = mActivePending.load();
+    mActivePending.store(index ^ 1);
+    PendingStats* pending = mPending[index].get();
+    // Writers are short, and cannot start on this PendingStats anymore.
+    while (pending->writers.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+    }
+
+    for (PendingGlobalInfo& slot : pending->globalInfos) {
+        if (slot.state.load(std::memory_order_relaxed) != SLOT_READY) {
+            continue;
+        }
+        if (!mGlobalStats.count(slot.driverVersionCode)) {
+            GpuStatsGlobalInfo globalInfo;
+            globalInfo.driverPackageName = slot.driverPackageName;
+            globalInfo.driverVersionName = slot.driverVersionName;
+            globalInfo.driverVersionCode = slot.driverVersionCode;
+            globalInfo.driverBuildTime = slot.driverBuildTime;
+            globalInfo.vulkanVersion = slot.vulkanVersion;
+            mGlobalStats.insert({slot.driverVersionCode, globalInfo});
+        }
+        GpuStatsGlobalInfo& globalInfo = mGlobalStats[slot.driverVersionCode];
+        for (size_t driver = 0; driver < NUM_DRIVERS; driver++) {
+            addLoadingCount(static_cast<GpuStatsInfo::Driver>(driver),
+                            slot.loadingCount[driver].exchange(0, std::memory_order_relaxed),
+                            slot.loadingFailureCount[driver].exchange(0,
+                                                                      std::memory_order_relaxed),
+                            &globalInfo);
+        }
+        slot.driverPackageName.clear();
+        slot.driverVersionName.clear();
+        slot.state.store(SLOT_EMPTY, std::memory_order_relaxed);
+    }
+
+    for (PendingAppInfo& slot : pending->appInfos) {
+        if (slot.state.load(std::memory_order_relaxed) != SLOT_READY) {
+            continue;
+        }
+        const std::string appStatsKey =
+                slot.appPackageName + std::to_string(slot.driverVersionCode);
+        const bool hasDriverStats = slot.hasDriverStats.exchange(false, std::memory_order_relaxed);
+        const uint32_t numRecorded = slot.numLoadingTimes.exchange(0, std::memory_order_relaxed);
+        const size_t numLoadingTimes =
+                numRecorded < MAX_NUM_LOADING_TIMES ? numRecorded : MAX_NUM_LOADING_TIMES;
+        const bool cpuVulkanInUse = slot.cpuVulkanInUse.exchange(false, std::memory_order_relaxed);
+        const bool falsePrerotation =
+                slot.falsePrerotation.exchange(false, std::memory_order_relaxed);
+        const bool gles1InUse = slot.gles1InUse.exchange(false, std::memory_order_relaxed);
+
+        // Target stats are only kept for apps that reported their driver.
+        if (hasDriverStats && !mAppStats.count(appStatsKey)) {
+            if (mAppStats.size() >= MAX_NUM_APP_RECORDS) {
+                ALOGV("GpuStatsAppInfo has reached maximum size. Ignore new stats.");
+            } else {
+                GpuStatsAppInfo appInfo;
+                appInfo.appPackageName = slot.appPackageName;
+                appInfo.driverVersionCode = slot.driverVersionCode;
+                mAppStats.insert({appStatsKey, appInfo});
+            }
+        }
+        auto it = mAppStats.find(appStatsKey);
+        if (it != mAppStats.end()) {
+            for (size_t i = 0; i < numLoadingTimes; i++) {
+                addLoadingTime(slot.loadingDrivers[i], slot.loadingTimes[i], &it->second);
+            }
+            it->second.cpuVulkanInUse |= cpuVulkanInUse;
+            it->second.falsePrerotation |= falsePrerotation;
+            it->second.gles1InUse |= gles1InUse;
+        }
+        slot.appPackageName.clear();
+        slot.state.store(SLOT_EMPTY, std::memory_order_relaxed);
     }
 }
 
@@ -177,13 +333,13 @@ void GpuStats::interceptSystemDriverStatsLocked() {
 }
 
 void GpuStats::registerStatsdCallbacksIfNeeded() {
-    if (!mStatsdRegistered) {
+    std::call_once(mStatsdRegisterOnce, [this] {
         AStatsManager_setPullAtomCallback(android::util::GPU_STATS_GLOBAL_INFO, nullptr,
                                          GpuStats::pullAtomCallback, this);
         AStatsManager_setPullAtomCallback(android::util::GPU_STATS_APP_INFO, nullptr,
                                          GpuStats::pullAtomCallback, this);
         mStatsdRegistered = true;
-    }
+    });
 }
 
 void GpuStats::dump(const Vector<String16>& args, std::string* result) {
@@ -195,6 +351,7 @@ void GpuStats::dump(const Vector<String16>& args, std::string* result) {
     }
 
     std::lock_guard<std::mutex> lock(mLock);
+    flushLocked();
     bool dumpAll = true;
 
     std::unordered_set<std::string> argsSet;
@@ -288,6 +445,7 @@ AStatsManager_PullAtomCallbackReturn GpuStats::pullAppInfoAtom(AStatsEventList*
     ATRACE_CALL();
 
     std::lock_guard<std::mutex> lock(mLock);
+    flushLocked();
 
     if (data) {
         for (const auto& ele : mAppStats) {
@@ -321,6 +479,7 @@ AStatsManager_PullAtomCallbackReturn GpuStats::pullGlobalInfoAtom(AStatsEventLis
     ATRACE_CALL();
 
     std::lock_guard<std::mutex> lock(mLock);
+    flushLocked();
     // flush cpuVulkanVersion and glesVersion to builtin driver stats
     interceptSystemDriverStatsLocked();
 
@@ -22,6 +22,8 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -68,13 +70,74 @@ private:
     // Registers statsd callbacks if they have not already been registered
     void registerStatsdCallbacksIfNeeded();
 
+    // Stats inserted since the last flush. insertDriverStats and insertTargetStats only update
+    // them with atomic operations, so that apps loading their drivers at the same time do not
+    // wait for each other. Slots are claimed by the first thread that moves their state away
+    // from empty, and can be looked up once it marks them as ready.
+    static const size_t NUM_DRIVERS = GpuStatsInfo::Driver::ANGLE + 1;
+    struct PendingGlobalInfo {
+        std::atomic<uint32_t> state{0};
+        // Written once by the thread that claimed the slot.
+        std::string driverPackageName;
+        std::string driverVersionName;
+        uint64_t driverVersionCode = 0;
+        int64_t driverBuildTime = 0;
+        int32_t vulkanVersion = 0;
+        // Indexed by GpuStatsInfo::Driver.
+        std::atomic<int32_t> loadingCount[NUM_DRIVERS] = {};
+        std::atomic<int32_t> loadingFailureCount[NUM_DRIVERS] = {};
+    };
+    struct PendingAppInfo {
+        std::atomic<uint32_t> state{0};
+        // Written once by the thread that claimed the slot.
+        std::string appPackageName;
+        uint64_t driverVersionCode = 0;
+        // Each writer gets its own index in loadingTimes.
+        std::atomic<uint32_t> numLoadingTimes{0};
+        GpuStatsInfo::Driver loadingDrivers[MAX_NUM_LOADING_TIMES];
+        int64_t loadingTimes[MAX_NUM_LOADING_TIMES];
+        std::atomic<bool> hasDriverStats{false};
+        std::atomic<bool> cpuVulkanInUse{false};
+        std::atomic<bool> falsePrerotation{false};
+        std::atomic<bool> gles1InUse{false};
+    };
+    // Number of drivers and apps that can be tracked between two flushes.
+    static const size_t MAX_NUM_PENDING_DRIVERS = 16;
+    static const size_t MAX_NUM_PENDING_APPS = 128;
+    struct PendingStats {
+        // Number of threads updating these stats.
+        std::atomic<uint32_t> writers{0};
+        PendingGlobalInfo globalInfos[MAX_NUM_PENDING_DRIVERS];
+        PendingAppInfo appInfos[MAX_NUM_PENDING_APPS];
+    };
+    // Returns the pending stats new stats go to, which cannot be flushed until endWrite.
+    PendingStats* beginWrite();
+    void endWrite(PendingStats* pending);
+    // Finds or claims the slot for a driver or an app, returning nullptr if they are all taken.
+    PendingGlobalInfo* getPendingGlobalInfo(PendingStats* pending,
+                                            const std::string& driverPackageName,
+                                            const std::string& driverVersionName,
+                                            uint64_t driverVersionCode, int64_t driverBuildTime,
+                                            int32_t vulkanVersion);
+    PendingAppInfo* getPendingAppInfo(PendingStats* pending, const std::string& appPackageName,
+                                      uint64_t driverVersionCode);
+    // Moves the pending stats into mGlobalStats and mAppStats.
+    void flushLocked();
+
     // Below limits the memory usage of GpuStats to be less than 10KB. This is
     // the preferred number for statsd while maintaining nice data quality.
     static const size_t MAX_NUM_APP_RECORDS = 100;
-    // GpuStats access should be guarded by mLock.
-    std::mutex mLock;
+    // Inserted stats alternate between two PendingStats, so that one can be flushed while the
+    // other is written to. mActivePending is the index of the one being written to.
+    std::unique_ptr<PendingStats> mPending[2] = {std::make_unique<PendingStats>(),
+                                                 std::make_unique<PendingStats>()};
+    std::atomic<uint32_t> mActivePending{0};
+    // Registers the statsd callbacks from the first insert.
+    std::once_flag mStatsdRegisterOnce;
     // True if statsd callbacks have been registered.
-    bool mStatsdRegistered = false;
+    std::atomic<bool> mStatsdRegistered{false};
+    // Access to the members below should be guarded by mLock.
+    std::mutex mLock;
     // Key is driver version code.
     std::unordered_map<uint64_t, GpuStatsGlobalInfo> mGlobalStats;
     // Key is <app package name>+<driver version code>.
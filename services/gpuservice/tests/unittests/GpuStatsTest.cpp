@@ -26,6 +26,10 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include "TestableGpuStats.h"
 
 namespace android {
@@ -303,5 +307,49 @@ TEST_F(GpuStatsTest, canPullAppAtom) {
     EXPECT_TRUE(inputCommand(InputCommand::DUMP_APP).empty());
 }
 
+TEST_F(GpuStatsTest, canInsertDriverStatsConcurrently) {
+    constexpr int kThreads = 4;
+    constexpr int kInsertsPerThread = 1000;
+    std::atomic<bool> done = false;
+    std::thread dumper([&]() {
+        while (!done) {
+            inputCommand(InputCommand::DUMP_ALL);
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&, t]() {
+            const std::string appPackageName = APP_PKG_NAME_1 + std::to_string(t);
+            for (int i = 0; i < kInsertsPerThread; i++) {
+                mGpuStats->insertDriverStats(BUILTIN_DRIVER_PKG_NAME, BUILTIN_DRIVER_VER_NAME,
+                                             BUILTIN_DRIVER_VER_CODE, BUILTIN_DRIVER_BUILD_TIME,
+                                             appPackageName, VULKAN_VERSION,
+                                             GpuStatsInfo::Driver::GL, i % 2 == 0,
+                                             DRIVER_LOADING_TIME_1);
+                mGpuStats->insertTargetStats(appPackageName, BUILTIN_DRIVER_VER_CODE,
+                                             GpuStatsInfo::Stats::GLES_1_IN_USE, 0);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    done = true;
+    dumper.join();
+
+    std::string expectedResult = "glLoadingCount = " + std::to_string(kThreads * kInsertsPerThread);
+    EXPECT_THAT(inputCommand(InputCommand::DUMP_GLOBAL), HasSubstr(expectedResult));
+    expectedResult =
+            "glLoadingFailureCount = " + std::to_string(kThreads * kInsertsPerThread / 2);
+    EXPECT_THAT(inputCommand(InputCommand::DUMP_GLOBAL), HasSubstr(expectedResult));
+    const std::string appResult = inputCommand(InputCommand::DUMP_APP);
+    for (int t = 0; t < kThreads; t++) {
+        expectedResult = "appPackageName = " + std::string(APP_PKG_NAME_1) + std::to_string(t);
+        EXPECT_THAT(appResult, HasSubstr(expectedResult));
+    }
+    EXPECT_THAT(appResult, HasSubstr("gles1InUse = 1"));
+    EXPECT_THAT(appResult, ::testing::Not(HasSubstr("gles1InUse = 0")));
+}
+
 } // namespace
 } // namespace android
@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <android-base/stringprintf.h>
 #include <cmath>
+#include <cutils/properties.h>
 #include <inttypes.h>
 #include <log/log.h>
 #if defined(__linux__)
@@ -48,6 +49,14 @@ namespace android {
 //Max number of elements to store in mEvents.
 static constexpr size_t MAX_EVENTS = 5;
 
+/**
+ * System property for how long, in milliseconds, MotionClassifier may hold a motion event back
+ * while waiting for the HAL to classify it. Events that the HAL hasn't classified in time are
+ * sent on with the classification of the previous events of the gesture.
+ * Classification never delays events by default.
+ */
+static const char* PROPERTY_CLASSIFICATION_BUDGET_MS = "ro.input.classifier.budget_ms";
+
 template<class K, class V>
 static V getValueForKey(const std::unordered_map<K, V>& map, K key, V defaultValue) {
     auto it = map.find(key);
@@ -121,7 +130,17 @@ std::optional<int32_t> ClassifierEvent::getDeviceId() const {
 
 MotionClassifier::MotionClassifier(
         sp<android::hardware::input::classifier::V1_0::IInputClassifier> service)
-      : mEvents(MAX_EVENTS), mService(service) {
+      : MotionClassifier(service,
+                         std::chrono::milliseconds(
+                                 property_get_int32(PROPERTY_CLASSIFICATION_BUDGET_MS, 0))) {}
+
+MotionClassifier::MotionClassifier(
+        sp<android::hardware::input::classifier::V1_0::IInputClassifier> service,
+        std::chrono::nanoseconds classificationBudget)
+      : mClassificationBudget(classificationBudget),
+        mEvents(MAX_EVENTS),
+        mService(service),
+        mHalThreadExited(false) {
     // Under normal operation, we do not need to reset the HAL here. But in the case where system
     // crashed, but HAL didn't, we may be connecting to an existing HAL process that might already
     // have received events in the past. That means, that HAL could be in an inconsistent state
@@ -201,6 +220,7 @@ void MotionClassifier::processEvents() {
             }
             case ClassifierEventType::EXIT: {
                 clearClassifications();
+                setHalThreadExited();
                 return;
             }
         }
@@ -208,6 +228,7 @@ void MotionClassifier::processEvents() {
             ALOGE("Error communicating with InputClassifier HAL. "
                     "Exiting MotionClassifier HAL thread");
             clearClassifications();
+            setHalThreadExited();
             return;
         }
     }
@@ -230,6 +251,11 @@ void MotionClassifier::requestExit() {
 void MotionClassifier::updateClassification(int32_t deviceId, nsecs_t eventTime,
         MotionClassification classification) {
     std::scoped_lock lock(mLock);
+    if (mClassificationBudget > std::chrono::nanoseconds::zero()) {
+        nsecs_t& lastClassifiedEventTime = mLastClassifiedEventTimes[deviceId];
+        lastClassifiedEventTime = std::max(lastClassifiedEventTime, eventTime);
+        mClassificationReceived.notify_all();
+    }
     const nsecs_t lastDownTime = getValueForKey(mLastDownTimes, deviceId, static_cast<nsecs_t>(0));
     if (eventTime < lastDownTime) {
         // HAL just finished processing an event that belonged to an earlier gesture,
@@ -266,6 +292,23 @@ void MotionClassifier::clearDeviceState(int32_t deviceId) {
     std::scoped_lock lock(mLock);
     mClassifications.erase(deviceId);
     mLastDownTimes.erase(deviceId);
+    mLastClassifiedEventTimes.erase(deviceId);
+}
+
+void MotionClassifier::setHalThreadExited() {
+    std::scoped_lock lock(mLock);
+    mHalThreadExited = true;
+    mClassificationReceived.notify_all();
+}
+
+void MotionClassifier::waitForClassification(int32_t deviceId, nsecs_t eventTime) {
+    std::unique_lock lock(mLock);
+    android::base::ScopedLockAssertion assumeLock(mLock);
+    mClassificationReceived.wait_for(lock, mClassificationBudget, [&]() REQUIRES(mLock) {
+        return mHalThreadExited ||
+                getValueForKey(mLastClassifiedEventTimes, deviceId, static_cast<nsecs_t>(0)) >=
+                eventTime;
+    });
 }
 
 MotionClassification MotionClassifier::classify(const NotifyMotionArgs& args) {
@@ -275,6 +318,9 @@ MotionClassification MotionClassifier::classify(const NotifyMotionArgs& args) {
 
     ClassifierEvent event(std::make_unique<NotifyMotionArgs>(args));
     enqueueEvent(std::move(event));
+    if (mClassificationBudget > std::chrono::nanoseconds::zero()) {
+        waitForClassification(args.deviceId, args.eventTime);
+    }
     return getClassification(args.deviceId);
 }
 
@@ -297,7 +343,7 @@ void MotionClassifier::reset(const NotifyDeviceResetArgs& args) {
     enqueueEvent(std::make_unique<NotifyDeviceResetArgs>(args));
 }
 
-const char* MotionClassifier::getServiceStatus() REQUIRES(mLock) {
+const char* MotionClassifier::getServiceStatus() EXCLUDES(mLock) {
     if (!mService) {
         return "null";
     }
@@ -308,10 +354,12 @@ const char* MotionClassifier::getServiceStatus() REQUIRES(mLock) {
 }
 
 void MotionClassifier::dump(std::string& dump) {
-    std::scoped_lock lock(mLock);
     dump += StringPrintf(INDENT2 "mService status: %s\n", getServiceStatus());
+    std::scoped_lock lock(mLock);
     dump += StringPrintf(INDENT2 "mEvents: %zu element(s) (max=%zu)\n",
             mEvents.size(), MAX_EVENTS);
+    dump += StringPrintf(INDENT2 "mClassificationBudget: %" PRId64 "ms\n",
+            nanoseconds_to_milliseconds(mClassificationBudget.count()));
     dump += INDENT2 "mClassifications, mLastDownTimes:\n";
     dump += INDENT3 "Device Id\tClassification\tLast down time";
     // Combine mClassifications and mLastDownTimes into a single table.
@@ -19,6 +19,8 @@
 
 #include <android-base/thread_annotations.h>
 #include <utils/RefBase.h>
+#include <chrono>
+#include <condition_variable>
 #include <thread>
 #include <unordered_map>
 
@@ -145,6 +147,22 @@ private:
     friend class MotionClassifierTest; // to create MotionClassifier with a test HAL implementation
     explicit MotionClassifier(
             sp<android::hardware::input::classifier::V1_0::IInputClassifier> service);
+    MotionClassifier(sp<android::hardware::input::classifier::V1_0::IInputClassifier> service,
+                     std::chrono::nanoseconds classificationBudget);
+
+    /**
+     * How long classify may wait for the HAL to classify the event it was given. If the HAL
+     * doesn't answer in time, the event gets the classification of the previous events of the
+     * gesture, and the answer is applied to later events.
+     * Zero, the default, means classify never waits.
+     */
+    const std::chrono::nanoseconds mClassificationBudget;
+    std::condition_variable mClassificationReceived;
+    /**
+     * Wait until the HAL has classified the event with the given time for the device, up to
+     * mClassificationBudget.
+     */
+    void waitForClassification(int32_t deviceId, nsecs_t eventTime);
 
     // The events that need to be sent to the HAL.
     BlockingQueue<ClassifierEvent> mEvents;
@@ -199,6 +217,18 @@ private:
      * Accessed indirectly by both InputClassifier thread and the thread that receives notifyMotion.
      */
     std::unordered_map<int32_t /*deviceId*/, nsecs_t /*downTime*/> mLastDownTimes GUARDED_BY(mLock);
+    /**
+     * Per-device time of the latest event that the HAL classified, so classify knows when the
+     * event it is waiting for has been classified.
+     */
+    std::unordered_map<int32_t /*deviceId*/, nsecs_t /*eventTime*/> mLastClassifiedEventTimes
+            GUARDED_BY(mLock);
+    /**
+     * True once the InputClassifier thread has exited, after which no more classifications will
+     * be received.
+     */
+    bool mHalThreadExited GUARDED_BY(mLock);
+    void setHalThreadExited();
 
     void updateLastDownTime(int32_t deviceId, nsecs_t downTime);
 
@@ -210,9 +240,11 @@ private:
      */
     void requestExit();
     /**
-     * Return string status of mService
+     * Return string status of mService.
+     * Pings the HAL, so this must not be called with mLock held, or a HAL that is slow to
+     * answer would block classify.
      */
-    const char* getServiceStatus() REQUIRES(mLock);
+    const char* getServiceStatus() EXCLUDES(mLock);
 };
 
 /**
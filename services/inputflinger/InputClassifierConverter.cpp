@@ -17,6 +17,7 @@
 #include "InputClassifierConverter.h"
 
 using android::hardware::hidl_bitfield;
+using android::hardware::hidl_vec;
 using namespace android::hardware::input;
 
 namespace android {
@@ -305,22 +306,27 @@ static_assert(static_cast<common::V1_0::Axis>(AMOTION_EVENT_AXIS_GENERIC_15) ==
 static_assert(static_cast<common::V1_0::Axis>(AMOTION_EVENT_AXIS_GENERIC_16) ==
         common::V1_0::Axis::GENERIC_16);
 
-static common::V1_0::VideoFrame getHalVideoFrame(const TouchVideoFrame& frame) {
-    common::V1_0::VideoFrame out;
-    out.width = frame.getWidth();
-    out.height = frame.getHeight();
-    out.data = frame.getData();
+/**
+ * The HAL frame refers to the data of 'frame' rather than copying it, so 'frame' must outlive
+ * the returned value. The HAL only reads the data.
+ */
+static void getHalVideoFrame(const TouchVideoFrame& frame, common::V1_0::VideoFrame* out) {
+    out->width = frame.getWidth();
+    out->height = frame.getHeight();
+    const std::vector<int16_t>& data = frame.getData();
+    out->data.setToExternal(const_cast<int16_t*>(data.data()), data.size(),
+                            false /*shouldOwn*/);
     struct timeval timestamp = frame.getTimestamp();
-    out.timestamp = seconds_to_nanoseconds(timestamp.tv_sec) +
+    out->timestamp = seconds_to_nanoseconds(timestamp.tv_sec) +
              microseconds_to_nanoseconds(timestamp.tv_usec);
-    return out;
 }
 
-static std::vector<common::V1_0::VideoFrame> convertVideoFrames(
+static hidl_vec<common::V1_0::VideoFrame> convertVideoFrames(
         const std::vector<TouchVideoFrame>& frames) {
-    std::vector<common::V1_0::VideoFrame> out;
-    for (const TouchVideoFrame& frame : frames) {
-        out.push_back(getHalVideoFrame(frame));
+    hidl_vec<common::V1_0::VideoFrame> out;
+    out.resize(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        getHalVideoFrame(frames[i], &out[i]);
     }
     return out;
 }
@@ -25,6 +25,7 @@ namespace android {
 
 /**
  * Convert from framework's NotifyMotionArgs to hidl's common::V1_0::MotionEvent
+ * The video frames of the event refer to the data in 'args', which must outlive the event.
  */
 ::android::hardware::input::common::V1_0::MotionEvent notifyMotionArgsToHalMotionEvent(
         const NotifyMotionArgs& args);
@@ -24,6 +24,7 @@
 
 #include <binder/IPCThreadState.h>
 
+#include <inttypes.h>
 #include <log/log.h>
 #include <unordered_map>
 
@@ -107,9 +108,17 @@ void InputManager::setInputWindows(const std::vector<InputWindowInfo>& infos,
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> handlesPerDisplay;
 
     std::vector<sp<InputWindowHandle>> handles;
+    std::unordered_map<int32_t, sp<InputWindowHandle>> windowHandles;
     for (const auto& info : infos) {
+        sp<InputWindowHandle> handle = new BinderWindowHandle(info);
         handlesPerDisplay.emplace(info.displayId, std::vector<sp<InputWindowHandle>>());
-        handlesPerDisplay[info.displayId].push_back(new BinderWindowHandle(info));
+        handlesPerDisplay[info.displayId].push_back(handle);
+        windowHandles.emplace(info.id, handle);
+    }
+    {
+        std::scoped_lock lock(mWindowHandlesLock);
+        mWindowHandles = std::move(windowHandles);
+        mWindowHandlesByDisplay = handlesPerDisplay;
     }
     mDispatcher->setInputWindows(handlesPerDisplay);
 
@@ -118,6 +127,55 @@ void InputManager::setInputWindows(const std::vector<InputWindowInfo>& infos,
     }
 }
 
+void InputManager::updateInputWindows(const std::vector<InputWindowInfo>& changedWindows,
+        const std::vector<int32_t>& windowIds,
+        const sp<ISetInputWindowsListener>& setInputWindowsListener) {
+    std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> changedDisplays;
+    {
+        std::scoped_lock lock(mWindowHandlesLock);
+        for (const auto& info : changedWindows) {
+            mWindowHandles[info.id] = new BinderWindowHandle(info);
+        }
+
+        std::unordered_map<int32_t, sp<InputWindowHandle>> windowHandles;
+        std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> handlesPerDisplay;
+        for (const int32_t id : windowIds) {
+            auto it = mWindowHandles.find(id);
+            if (it == mWindowHandles.end()) {
+                ALOGW("updateInputWindows: window %" PRId32 " was never sent", id);
+                continue;
+            }
+            const sp<InputWindowHandle>& handle = it->second;
+            handlesPerDisplay[handle->getInfo()->displayId].push_back(handle);
+            windowHandles.emplace(id, handle);
+        }
+
+        // Only pass on the displays whose windows changed, and clear those
+        // left without any.
+        for (auto& [displayId, handles] : handlesPerDisplay) {
+            auto previous = mWindowHandlesByDisplay.find(displayId);
+            if (previous == mWindowHandlesByDisplay.end() || previous->second != handles) {
+                changedDisplays.emplace(displayId, handles);
+            }
+        }
+        for (const auto& [displayId, handles] : mWindowHandlesByDisplay) {
+            if (!handles.empty() && handlesPerDisplay.count(displayId) == 0) {
+                changedDisplays.emplace(displayId, std::vector<sp<InputWindowHandle>>());
+            }
+        }
+
+        mWindowHandles = std::move(windowHandles);
+        mWindowHandlesByDisplay = std::move(handlesPerDisplay);
+    }
+    if (!changedDisplays.empty()) {
+        mDispatcher->setInputWindows(changedDisplays);
+    }
+
+    if (setInputWindowsListener) {
+        setInputWindowsListener->onSetInputWindowsFinished();
+    }
+}
+
 // Used by tests only.
 void InputManager::registerInputChannel(const sp<InputChannel>& channel) {
     IPCThreadState* ipc = IPCThreadState::self();
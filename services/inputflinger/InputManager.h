@@ -36,6 +36,10 @@
 #include <utils/Timers.h>
 #include <utils/RefBase.h>
 
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 namespace android {
 class InputChannel;
 class InputDispatcherThread;
@@ -96,6 +100,9 @@ public:
 
     virtual void setInputWindows(const std::vector<InputWindowInfo>& handles,
             const sp<ISetInputWindowsListener>& setInputWindowsListener);
+    virtual void updateInputWindows(const std::vector<InputWindowInfo>& changedWindows,
+            const std::vector<int32_t>& windowIds,
+            const sp<ISetInputWindowsListener>& setInputWindowsListener);
 
     virtual void registerInputChannel(const sp<InputChannel>& channel);
     virtual void unregisterInputChannel(const sp<InputChannel>& channel);
@@ -108,6 +115,13 @@ private:
     sp<InputClassifierInterface> mClassifier;
 
     sp<InputDispatcherInterface> mDispatcher;
+
+    // The windows last sent by setInputWindows() or updateInputWindows(), by id
+    // and by display. The handles are never changed once created, so those of
+    // windows that did not change are passed to the dispatcher again as is.
+    std::mutex mWindowHandlesLock;
+    std::unordered_map<int32_t, sp<InputWindowHandle>> mWindowHandles;
+    std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> mWindowHandlesByDisplay;
 };
 
 } // namespace android
@@ -16,11 +16,15 @@
 
 #include <benchmark/benchmark.h>
 
+#include <android-base/stringprintf.h>
 #include <binder/Binder.h>
+#include <linux/input.h>
 #include "../dispatcher/InputDispatcher.h"
 
 namespace android::inputdispatcher {
 
+using android::base::StringPrintf;
+
 // An arbitrary device id.
 static const int32_t DEVICE_ID = 1;
 
@@ -105,7 +109,8 @@ public:
 
 class FakeInputReceiver {
 public:
-    void consumeEvent() {
+    // Returns nullptr if no event arrived in time.
+    InputEvent* consumeEvent() {
         uint32_t consumeSeq;
         InputEvent* event;
 
@@ -122,11 +127,24 @@ public:
         }
         if (result != OK) {
             ALOGE("Received result = %d from consume()", result);
+            return nullptr;
         }
         result = mConsumer->sendFinishedSignal(consumeSeq, true);
         if (result != OK) {
             ALOGE("Received result = %d from sendFinishedSignal", result);
         }
+        return event;
+    }
+
+    // Consume events until a motion event with the given masked action arrives. Moves that
+    // queue up are consumed as one batch, so how many events that takes isn't known up front.
+    void consumeMotionUntil(int32_t action) {
+        while (InputEvent* event = consumeEvent()) {
+            if (event->getType() == AINPUT_EVENT_TYPE_MOTION &&
+                static_cast<MotionEvent*>(event)->getActionMasked() == action) {
+                return;
+            }
+        }
     }
 
 protected:
@@ -150,18 +168,27 @@ public:
     static const int32_t HEIGHT = 200;
 
     FakeWindowHandle(const sp<InputApplicationHandle>& inputApplicationHandle,
-                     const sp<InputDispatcher>& dispatcher, const std::string name)
-          : FakeInputReceiver(dispatcher, name), mFrame(Rect(0, 0, WIDTH, HEIGHT)) {
+                     const sp<InputDispatcher>& dispatcher, const std::string name,
+                     int32_t displayId = ADISPLAY_ID_DEFAULT)
+          : FakeInputReceiver(dispatcher, name),
+            mFrame(Rect(0, 0, WIDTH, HEIGHT)),
+            mDisplayId(displayId) {
         mDispatcher->registerInputChannel(mServerChannel);
 
         inputApplicationHandle->updateInfo();
         mInfo.applicationInfo = *inputApplicationHandle->getInfo();
     }
 
+    void setFrame(const Rect& frame) { mFrame = frame; }
+
+    void setLayoutParamsFlags(int32_t flags) { mLayoutParamsFlags = flags; }
+
+    void setFocus(bool hasFocus) { mHasFocus = hasFocus; }
+
     virtual bool updateInfo() override {
         mInfo.token = mServerChannel->getConnectionToken();
         mInfo.name = "FakeWindowHandle";
-        mInfo.layoutParamsFlags = 0;
+        mInfo.layoutParamsFlags = mLayoutParamsFlags;
         mInfo.layoutParamsType = InputWindowInfo::TYPE_APPLICATION;
         mInfo.dispatchingTimeout = DISPATCHING_TIMEOUT.count();
         mInfo.frameLeft = mFrame.left;
@@ -173,21 +200,77 @@ public:
         mInfo.addTouchableRegion(mFrame);
         mInfo.visible = true;
         mInfo.canReceiveKeys = true;
-        mInfo.hasFocus = true;
+        mInfo.hasFocus = mHasFocus;
         mInfo.hasWallpaper = false;
         mInfo.paused = false;
         mInfo.ownerPid = INJECTOR_PID;
         mInfo.ownerUid = INJECTOR_UID;
         mInfo.inputFeatures = 0;
-        mInfo.displayId = ADISPLAY_ID_DEFAULT;
+        mInfo.displayId = mDisplayId;
 
         return true;
     }
 
 protected:
     Rect mFrame;
+    int32_t mDisplayId;
+    int32_t mLayoutParamsFlags = 0;
+    bool mHasFocus = true;
 };
 
+class FakeMonitorReceiver : public FakeInputReceiver {
+public:
+    FakeMonitorReceiver(const sp<InputDispatcher>& dispatcher, const std::string name,
+                        int32_t displayId, bool isGestureMonitor)
+          : FakeInputReceiver(dispatcher, name) {
+        mDispatcher->registerInputMonitor(mServerChannel, displayId, isGestureMonitor);
+    }
+};
+
+/**
+ * Create count windows on the given display, tiled in rows so that none of them overlap. The
+ * first window is the only one with focus.
+ */
+static std::vector<sp<InputWindowHandle>> createTiledWindows(
+        const sp<InputApplicationHandle>& application, const sp<InputDispatcher>& dispatcher,
+        size_t count, int32_t displayId = ADISPLAY_ID_DEFAULT) {
+    static constexpr size_t COLUMNS = 8;
+    std::vector<sp<InputWindowHandle>> windows;
+    for (size_t i = 0; i < count; i++) {
+        sp<FakeWindowHandle> window =
+                new FakeWindowHandle(application, dispatcher,
+                                     StringPrintf("Fake Window %zu", i), displayId);
+        const int32_t left = int32_t(i % COLUMNS) * FakeWindowHandle::WIDTH;
+        const int32_t top = int32_t(i / COLUMNS) * FakeWindowHandle::HEIGHT;
+        window->setFrame(
+                Rect(left, top, left + FakeWindowHandle::WIDTH, top + FakeWindowHandle::HEIGHT));
+        window->setFocus(i == 0);
+        windows.push_back(window);
+    }
+    return windows;
+}
+
+// The point in the middle of the given window's frame.
+static std::pair<float, float> centerOf(const sp<InputWindowHandle>& window) {
+    window->updateInfo();
+    const InputWindowInfo* info = window->getInfo();
+    return {(info->frameLeft + info->frameRight) / 2.0f,
+            (info->frameTop + info->frameBottom) / 2.0f};
+}
+
+/**
+ * Report the mean time spent per dispatched event, since the benchmarks below send different
+ * numbers of events per iteration.
+ */
+static void reportTimePerEvent(benchmark::State& state, nsecs_t startTime,
+                               int64_t eventsPerIteration) {
+    const int64_t events = state.iterations() * eventsPerIteration;
+    state.SetItemsProcessed(events);
+    if (events > 0) {
+        state.counters["ns/event"] = double(now() - startTime) / events;
+    }
+}
+
 static MotionEvent generateMotionEvent() {
     PointerProperties pointerProperties[1];
     PointerCoords pointerCoords[1];
@@ -215,24 +298,28 @@ static MotionEvent generateMotionEvent() {
     return event;
 }
 
-static NotifyMotionArgs generateMotionArgs() {
-    PointerProperties pointerProperties[1];
-    PointerCoords pointerCoords[1];
+static NotifyMotionArgs generateMotionArgs(
+        int32_t displayId = ADISPLAY_ID_DEFAULT,
+        const std::vector<std::pair<float, float>>& points = {{100, 100}}) {
+    PointerProperties pointerProperties[MAX_POINTERS];
+    PointerCoords pointerCoords[MAX_POINTERS];
 
-    pointerProperties[0].clear();
-    pointerProperties[0].id = 0;
-    pointerProperties[0].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+    for (size_t i = 0; i < points.size(); i++) {
+        pointerProperties[i].clear();
+        pointerProperties[i].id = i;
+        pointerProperties[i].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
 
-    pointerCoords[0].clear();
-    pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_X, 100);
-    pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_Y, 100);
+        pointerCoords[i].clear();
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_X, points[i].first);
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, points[i].second);
+    }
 
     const nsecs_t currentTime = now();
     // Define a valid motion event.
-    NotifyMotionArgs args(/* id */ 0, currentTime, DEVICE_ID, AINPUT_SOURCE_TOUCHSCREEN,
-                          ADISPLAY_ID_DEFAULT, POLICY_FLAG_PASS_TO_USER, AMOTION_EVENT_ACTION_DOWN,
+    NotifyMotionArgs args(/* id */ 0, currentTime, DEVICE_ID, AINPUT_SOURCE_TOUCHSCREEN, displayId,
+                          POLICY_FLAG_PASS_TO_USER, AMOTION_EVENT_ACTION_DOWN,
                           /* actionButton */ 0, /* flags */ 0, AMETA_NONE, /* buttonState */ 0,
-                          MotionClassification::NONE, AMOTION_EVENT_EDGE_FLAG_NONE, 1,
+                          MotionClassification::NONE, AMOTION_EVENT_EDGE_FLAG_NONE, points.size(),
                           pointerProperties, pointerCoords,
                           /* xPrecision */ 0, /* yPrecision */ 0,
                           AMOTION_EVENT_INVALID_CURSOR_POSITION,
@@ -241,6 +328,25 @@ static NotifyMotionArgs generateMotionArgs() {
     return args;
 }
 
+static NotifyKeyArgs generateKeyArgs(int32_t action) {
+    const nsecs_t currentTime = now();
+    return NotifyKeyArgs(/* id */ 0, currentTime, DEVICE_ID, AINPUT_SOURCE_KEYBOARD,
+                         ADISPLAY_ID_NONE, POLICY_FLAG_PASS_TO_USER, action, /* flags */ 0,
+                         AKEYCODE_A, KEY_A, AMETA_NONE, currentTime);
+}
+
+// Send a single pointer DOWN and UP at the given point.
+static void notifyTap(const sp<InputDispatcher>& dispatcher, int32_t displayId,
+                      std::pair<float, float> point) {
+    NotifyMotionArgs motionArgs = generateMotionArgs(displayId, {point});
+    dispatcher->notifyMotion(&motionArgs);
+
+    motionArgs.action = AMOTION_EVENT_ACTION_UP;
+    motionArgs.id = 1;
+    motionArgs.eventTime = now();
+    dispatcher->notifyMotion(&motionArgs);
+}
+
 static void benchmarkNotifyMotion(benchmark::State& state) {
     // Create dispatcher
     sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
@@ -256,6 +362,7 @@ static void benchmarkNotifyMotion(benchmark::State& state) {
 
     NotifyMotionArgs motionArgs = generateMotionArgs();
 
+    const nsecs_t startTime = now();
     for (auto _ : state) {
         // Send ACTION_DOWN
         motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
@@ -273,6 +380,7 @@ static void benchmarkNotifyMotion(benchmark::State& state) {
         window->consumeEvent();
         window->consumeEvent();
     }
+    reportTimePerEvent(state, startTime, 2);
 
     dispatcher->stop();
 }
@@ -290,6 +398,7 @@ static void benchmarkInjectMotion(benchmark::State& state) {
 
     dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
 
+    const nsecs_t startTime = now();
     for (auto _ : state) {
         MotionEvent event = generateMotionEvent();
         // Send ACTION_DOWN
@@ -306,12 +415,306 @@ static void benchmarkInjectMotion(benchmark::State& state) {
         window->consumeEvent();
         window->consumeEvent();
     }
+    reportTimePerEvent(state, startTime, 2);
+
+    dispatcher->stop();
+}
+
+/**
+ * Tap the window at the bottom of a stack of state.range(0) windows, so that the hit test has to
+ * look past all the others.
+ */
+static void benchmarkNotifyMotion_ManyWindows(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    std::vector<sp<InputWindowHandle>> windows =
+            createTiledWindows(application, dispatcher, state.range(0));
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+    static_cast<FakeWindowHandle*>(windows[0].get())->consumeEvent(); // Focus gained
+    sp<FakeWindowHandle> target = static_cast<FakeWindowHandle*>(windows.back().get());
+    const std::pair<float, float> point = centerOf(target);
+
+    const nsecs_t startTime = now();
+    for (auto _ : state) {
+        notifyTap(dispatcher, ADISPLAY_ID_DEFAULT, point);
+
+        target->consumeEvent();
+        target->consumeEvent();
+    }
+    reportTimePerEvent(state, startTime, 2);
+
+    dispatcher->stop();
+}
+
+/**
+ * Tap one window on each of state.range(0) displays in turn, every display having a few windows
+ * of its own.
+ */
+static void benchmarkNotifyMotion_MultiDisplay(benchmark::State& state) {
+    static constexpr size_t WINDOWS_PER_DISPLAY = 8;
+    const int32_t displayCount = state.range(0);
+
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> windowsPerDisplay;
+    std::vector<sp<FakeWindowHandle>> targets;
+    for (int32_t displayId = 0; displayId < displayCount; displayId++) {
+        std::vector<sp<InputWindowHandle>>& windows = windowsPerDisplay[displayId];
+        windows = createTiledWindows(application, dispatcher, WINDOWS_PER_DISPLAY, displayId);
+        targets.push_back(static_cast<FakeWindowHandle*>(windows.back().get()));
+    }
+    dispatcher->setInputWindows(windowsPerDisplay);
+    for (auto& [displayId, windows] : windowsPerDisplay) {
+        static_cast<FakeWindowHandle*>(windows[0].get())->consumeEvent(); // Focus gained
+    }
+    const std::pair<float, float> point = centerOf(targets[0]);
+
+    const nsecs_t startTime = now();
+    for (auto _ : state) {
+        for (int32_t displayId = 0; displayId < displayCount; displayId++) {
+            notifyTap(dispatcher, displayId, point);
+        }
+        for (const sp<FakeWindowHandle>& target : targets) {
+            target->consumeEvent();
+            target->consumeEvent();
+        }
+    }
+    reportTimePerEvent(state, startTime, 2 * displayCount);
+
+    dispatcher->stop();
+}
+
+/**
+ * Put one pointer down in each of two side by side windows that allow split touch, move them
+ * together and lift them, so that every event is split between the windows.
+ */
+static void benchmarkNotifyMotion_SplitTouch(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    std::vector<sp<InputWindowHandle>> windows = createTiledWindows(application, dispatcher, 2);
+    for (const sp<InputWindowHandle>& window : windows) {
+        static_cast<FakeWindowHandle*>(window.get())
+                ->setLayoutParamsFlags(InputWindowInfo::FLAG_SPLIT_TOUCH);
+    }
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+    sp<FakeWindowHandle> left = static_cast<FakeWindowHandle*>(windows[0].get());
+    sp<FakeWindowHandle> right = static_cast<FakeWindowHandle*>(windows[1].get());
+    left->consumeEvent(); // Focus gained
+
+    const std::pair<float, float> leftPoint = centerOf(left);
+    const std::pair<float, float> rightPoint = centerOf(right);
+    NotifyMotionArgs oneFinger = generateMotionArgs(ADISPLAY_ID_DEFAULT, {leftPoint});
+    NotifyMotionArgs twoFingers =
+            generateMotionArgs(ADISPLAY_ID_DEFAULT, {leftPoint, rightPoint});
+    const int32_t secondPointer = 1 << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
+
+    const nsecs_t startTime = now();
+    for (auto _ : state) {
+        oneFinger.action = AMOTION_EVENT_ACTION_DOWN;
+        oneFinger.downTime = now();
+        oneFinger.eventTime = oneFinger.downTime;
+        dispatcher->notifyMotion(&oneFinger);
+
+        twoFingers.downTime = oneFinger.downTime;
+        twoFingers.action = AMOTION_EVENT_ACTION_POINTER_DOWN | secondPointer;
+        twoFingers.eventTime = now();
+        dispatcher->notifyMotion(&twoFingers);
+
+        twoFingers.action = AMOTION_EVENT_ACTION_MOVE;
+        twoFingers.eventTime = now();
+        dispatcher->notifyMotion(&twoFingers);
+
+        twoFingers.action = AMOTION_EVENT_ACTION_POINTER_UP | secondPointer;
+        twoFingers.eventTime = now();
+        dispatcher->notifyMotion(&twoFingers);
+
+        oneFinger.action = AMOTION_EVENT_ACTION_UP;
+        oneFinger.eventTime = now();
+        dispatcher->notifyMotion(&oneFinger);
+
+        left->consumeMotionUntil(AMOTION_EVENT_ACTION_UP);
+        right->consumeMotionUntil(AMOTION_EVENT_ACTION_UP);
+    }
+    reportTimePerEvent(state, startTime, 5);
+
+    dispatcher->stop();
+}
+
+/**
+ * Tap a window while state.range(0) gesture monitors watch the display, so that every event
+ * also goes to each monitor.
+ */
+static void benchmarkNotifyMotion_GestureMonitors(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, dispatcher, "Fake Window");
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+    window->consumeEvent(); // Focus gained
+
+    std::vector<std::unique_ptr<FakeMonitorReceiver>> monitors;
+    for (int i = 0; i < state.range(0); i++) {
+        monitors.push_back(std::make_unique<FakeMonitorReceiver>(
+                dispatcher, StringPrintf("Gesture Monitor %d", i), ADISPLAY_ID_DEFAULT,
+                true /*isGestureMonitor*/));
+    }
+
+    const nsecs_t startTime = now();
+    for (auto _ : state) {
+        notifyTap(dispatcher, ADISPLAY_ID_DEFAULT, {100, 100});
+
+        window->consumeEvent();
+        window->consumeEvent();
+        for (const std::unique_ptr<FakeMonitorReceiver>& monitor : monitors) {
+            monitor->consumeEvent();
+            monitor->consumeEvent();
+        }
+    }
+    reportTimePerEvent(state, startTime, 2);
+
+    dispatcher->stop();
+}
+
+/**
+ * Move focus between two windows and then type a key into the newly focused one, so that the
+ * key has to wait behind the focus change.
+ */
+static void benchmarkNotifyKey_FocusChange(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> focused = new FakeWindowHandle(application, dispatcher, "Fake Window 0");
+    sp<FakeWindowHandle> unfocused =
+            new FakeWindowHandle(application, dispatcher, "Fake Window 1");
+    unfocused->setFocus(false);
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {focused, unfocused}}});
+    focused->consumeEvent(); // Focus gained
+
+    NotifyKeyArgs keyArgs = generateKeyArgs(AKEY_EVENT_ACTION_DOWN);
+
+    const nsecs_t startTime = now();
+    for (auto _ : state) {
+        std::swap(focused, unfocused);
+        focused->setFocus(true);
+        unfocused->setFocus(false);
+        dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {focused, unfocused}}});
+
+        keyArgs.action = AKEY_EVENT_ACTION_DOWN;
+        keyArgs.downTime = now();
+        keyArgs.eventTime = keyArgs.downTime;
+        dispatcher->notifyKey(&keyArgs);
+
+        keyArgs.action = AKEY_EVENT_ACTION_UP;
+        keyArgs.eventTime = now();
+        dispatcher->notifyKey(&keyArgs);
+
+        unfocused->consumeEvent(); // Focus lost
+        focused->consumeEvent();   // Focus gained
+        focused->consumeEvent();
+        focused->consumeEvent();
+    }
+    reportTimePerEvent(state, startTime, 2);
+
+    dispatcher->stop();
+}
+
+/**
+ * Update a display's state.range(0) windows, alternating between two orderings so that every
+ * call actually changes the window list. Focus stays where it is.
+ */
+static void benchmarkSetInputWindows(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    std::vector<sp<InputWindowHandle>> windows =
+            createTiledWindows(application, dispatcher, state.range(0));
+    std::vector<sp<InputWindowHandle>> reversedWindows(windows.rbegin(), windows.rend());
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+    static_cast<FakeWindowHandle*>(windows[0].get())->consumeEvent(); // Focus gained
+
+    bool reversed = false;
+    for (auto _ : state) {
+        reversed = !reversed;
+        dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, reversed ? reversedWindows : windows}});
+    }
+
+    dispatcher->stop();
+}
+
+/**
+ * Send a gesture of state.range(0) moves without consuming any of it until it has all been
+ * sent. Long gestures fill up the channel, so the dispatcher has to hold events back and resume
+ * as the window catches up.
+ */
+static void benchmarkNotifyMotion_SlowConsumer(benchmark::State& state) {
+    const int64_t moveCount = state.range(0);
+
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, dispatcher, "Fake Window");
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+    window->consumeEvent(); // Focus gained
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+
+    const nsecs_t startTime = now();
+    for (auto _ : state) {
+        motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        dispatcher->notifyMotion(&motionArgs);
+
+        motionArgs.action = AMOTION_EVENT_ACTION_MOVE;
+        for (int64_t i = 0; i < moveCount; i++) {
+            motionArgs.eventTime = now();
+            dispatcher->notifyMotion(&motionArgs);
+        }
+
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        motionArgs.eventTime = now();
+        dispatcher->notifyMotion(&motionArgs);
+
+        window->consumeMotionUntil(AMOTION_EVENT_ACTION_UP);
+    }
+    reportTimePerEvent(state, startTime, moveCount + 2);
 
     dispatcher->stop();
 }
 
 BENCHMARK(benchmarkNotifyMotion);
 BENCHMARK(benchmarkInjectMotion);
+BENCHMARK(benchmarkNotifyMotion_ManyWindows)->Arg(1)->Arg(16)->Arg(64);
+BENCHMARK(benchmarkNotifyMotion_MultiDisplay)->Arg(1)->Arg(4);
+BENCHMARK(benchmarkNotifyMotion_SplitTouch);
+BENCHMARK(benchmarkNotifyMotion_GestureMonitors)->Arg(1)->Arg(4);
+BENCHMARK(benchmarkNotifyKey_FocusChange);
+BENCHMARK(benchmarkSetInputWindows)->Arg(1)->Arg(16)->Arg(64);
+BENCHMARK(benchmarkNotifyMotion_SlowConsumer)->Arg(10)->Arg(1000);
 
 } // namespace android::inputdispatcher
 
@@ -0,0 +1,600 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <EventHub.h>
+#include <InputReader.h>
+#include <InputReaderBase.h>
+#include <linux/input.h>
+#include <iterator>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+
+// An arbitrary device id.
+static const int32_t DEVICE_ID = 1;
+
+static const int32_t DISPLAY_ID = 0;
+static const int32_t DISPLAY_WIDTH = 1080;
+static const int32_t DISPLAY_HEIGHT = 2340;
+
+static nsecs_t now() {
+    return systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+// --- FakeInputReaderPolicy ---
+
+class FakeInputReaderPolicy : public InputReaderPolicyInterface {
+public:
+    FakeInputReaderPolicy() {
+        DisplayViewport viewport;
+        viewport.displayId = DISPLAY_ID;
+        viewport.orientation = DISPLAY_ORIENTATION_0;
+        viewport.logicalRight = DISPLAY_WIDTH;
+        viewport.logicalBottom = DISPLAY_HEIGHT;
+        viewport.physicalRight = DISPLAY_WIDTH;
+        viewport.physicalBottom = DISPLAY_HEIGHT;
+        viewport.deviceWidth = DISPLAY_WIDTH;
+        viewport.deviceHeight = DISPLAY_HEIGHT;
+        viewport.uniqueId = "local:0";
+        viewport.type = ViewportType::VIEWPORT_INTERNAL;
+        mConfig.setDisplayViewports({viewport});
+    }
+
+protected:
+    virtual ~FakeInputReaderPolicy() {}
+
+private:
+    virtual void getReaderConfiguration(InputReaderConfiguration* outConfig) override {
+        *outConfig = mConfig;
+    }
+
+    virtual sp<PointerControllerInterface> obtainPointerController(int32_t) override {
+        return nullptr;
+    }
+
+    virtual void notifyInputDevicesChanged(const std::vector<InputDeviceInfo>&) override {}
+
+    virtual sp<KeyCharacterMap> getKeyboardLayoutOverlay(const InputDeviceIdentifier&) override {
+        return nullptr;
+    }
+
+    virtual std::string getDeviceAlias(const InputDeviceIdentifier&) override { return ""; }
+
+    virtual TouchAffineTransformation getTouchAffineTransformation(const std::string&,
+                                                                   int32_t) override {
+        return TouchAffineTransformation();
+    }
+
+    InputReaderConfiguration mConfig;
+};
+
+// --- FakeInputListener ---
+
+// Drops everything, so only the reader's own work is measured.
+class FakeInputListener : public InputListenerInterface {
+protected:
+    virtual ~FakeInputListener() {}
+
+private:
+    virtual void notifyConfigurationChanged(const NotifyConfigurationChangedArgs*) override {}
+    virtual void notifyKey(const NotifyKeyArgs*) override {}
+    virtual void notifyMotion(const NotifyMotionArgs*) override {}
+    virtual void notifySwitch(const NotifySwitchArgs*) override {}
+    virtual void notifyDeviceReset(const NotifyDeviceResetArgs*) override {}
+};
+
+// --- FakeEventHub ---
+
+/**
+ * Describes one device and replays a recorded stream of its events. Each call to getEvents
+ * returns the next frame of the stream, i.e. everything up to and including the next
+ * SYN_REPORT, like a real device read right after the kernel reports it. The stream starts over
+ * once it runs out.
+ */
+class FakeEventHub : public EventHubInterface {
+public:
+    FakeEventHub(const std::string& name, uint32_t classes) : mClasses(classes) {
+        mIdentifier.name = name;
+        mPendingEvents.push_back({0, DEVICE_ID, DEVICE_ADDED, 0, 0});
+        mPendingEvents.push_back({0, 0, FINISHED_DEVICE_SCAN, 0, 0});
+    }
+
+    virtual ~FakeEventHub() {}
+
+    void addAbsoluteAxis(int axis, int32_t minValue, int32_t maxValue, int32_t flat = 0,
+                         int32_t fuzz = 0) {
+        RawAbsoluteAxisInfo info;
+        info.valid = true;
+        info.minValue = minValue;
+        info.maxValue = maxValue;
+        info.flat = flat;
+        info.fuzz = fuzz;
+        info.resolution = 0;
+        mAbsoluteAxes[axis] = info;
+    }
+
+    void addInputProperty(int property) { mInputProperties.insert(property); }
+
+    void addKey(int32_t scanCode, int32_t keyCode) { mKeyCodesByScanCode[scanCode] = keyCode; }
+
+    void setStream(std::vector<RawEvent> stream) {
+        mStream = std::move(stream);
+        mNextEvent = 0;
+    }
+
+    // The number of frames in the stream, i.e. how many reads it takes to replay it once.
+    size_t getFrameCount() const {
+        size_t frames = 0;
+        for (const RawEvent& event : mStream) {
+            frames += event.type == EV_SYN && event.code == SYN_REPORT;
+        }
+        return frames;
+    }
+
+    size_t getEventCount() const { return mStream.size(); }
+
+    virtual size_t getEvents(int, RawEvent* buffer, size_t bufferSize) override {
+        size_t count = 0;
+        if (!mPendingEvents.empty()) {
+            for (; count < mPendingEvents.size() && count < bufferSize; count++) {
+                buffer[count] = mPendingEvents[count];
+                buffer[count].when = now();
+            }
+            mPendingEvents.erase(mPendingEvents.begin(), mPendingEvents.begin() + count);
+            return count;
+        }
+        if (mStream.empty()) {
+            return 0;
+        }
+
+        const nsecs_t when = now();
+        while (count < bufferSize) {
+            const RawEvent& event = mStream[mNextEvent];
+            mNextEvent = (mNextEvent + 1) % mStream.size();
+            buffer[count] = event;
+            buffer[count].when = when;
+            buffer[count].deviceId = DEVICE_ID;
+            count++;
+            if (event.type == EV_SYN && event.code == SYN_REPORT) {
+                break;
+            }
+        }
+        return count;
+    }
+
+private:
+    virtual uint32_t getDeviceClasses(int32_t) const override { return mClasses; }
+
+    virtual InputDeviceIdentifier getDeviceIdentifier(int32_t) const override {
+        return mIdentifier;
+    }
+
+    virtual int32_t getDeviceControllerNumber(int32_t) const override { return 0; }
+
+    virtual void getConfiguration(int32_t, PropertyMap*) const override {}
+
+    virtual status_t getAbsoluteAxisInfo(int32_t, int axis,
+                                         RawAbsoluteAxisInfo* outAxisInfo) const override {
+        auto it = mAbsoluteAxes.find(axis);
+        if (it == mAbsoluteAxes.end()) {
+            outAxisInfo->clear();
+            return -1;
+        }
+        *outAxisInfo = it->second;
+        return OK;
+    }
+
+    virtual bool hasRelativeAxis(int32_t, int) const override { return false; }
+
+    virtual bool hasInputProperty(int32_t, int property) const override {
+        return mInputProperties.count(property) != 0;
+    }
+
+    virtual status_t mapKey(int32_t, int32_t scanCode, int32_t, int32_t metaState,
+                            int32_t* outKeycode, int32_t* outMetaState,
+                            uint32_t* outFlags) const override {
+        auto it = mKeyCodesByScanCode.find(scanCode);
+        if (it == mKeyCodesByScanCode.end()) {
+            return NAME_NOT_FOUND;
+        }
+        if (outKeycode) {
+            *outKeycode = it->second;
+        }
+        if (outMetaState) {
+            *outMetaState = metaState;
+        }
+        if (outFlags) {
+            *outFlags = 0;
+        }
+        return OK;
+    }
+
+    virtual status_t mapAxis(int32_t, int32_t, AxisInfo*) const override { return NAME_NOT_FOUND; }
+
+    virtual void setExcludedDevices(const std::vector<std::string>&) override {}
+
+    virtual std::vector<TouchVideoFrame> getVideoFrames(int32_t) override { return {}; }
+
+    virtual int32_t getScanCodeState(int32_t, int32_t) const override {
+        return AKEY_STATE_UNKNOWN;
+    }
+
+    virtual int32_t getKeyCodeState(int32_t, int32_t) const override {
+        return AKEY_STATE_UNKNOWN;
+    }
+
+    virtual int32_t getSwitchState(int32_t, int32_t) const override { return AKEY_STATE_UNKNOWN; }
+
+    virtual status_t getAbsoluteAxisValue(int32_t, int32_t, int32_t* outValue) const override {
+        *outValue = 0;
+        return -1;
+    }
+
+    virtual bool markSupportedKeyCodes(int32_t, size_t numCodes, const int32_t* keyCodes,
+                                       uint8_t* outFlags) const override {
+        bool result = false;
+        for (size_t i = 0; i < numCodes; i++) {
+            for (const auto& [scanCode, keyCode] : mKeyCodesByScanCode) {
+                if (keyCode == keyCodes[i]) {
+                    outFlags[i] = 1;
+                    result = true;
+                }
+            }
+        }
+        return result;
+    }
+
+    virtual bool hasScanCode(int32_t, int32_t scanCode) const override {
+        return mKeyCodesByScanCode.count(scanCode) != 0;
+    }
+
+    virtual bool hasLed(int32_t, int32_t) const override { return false; }
+
+    virtual void setLedState(int32_t, int32_t, bool) override {}
+
+    virtual void getVirtualKeyDefinitions(int32_t,
+                                          std::vector<VirtualKeyDefinition>&) const override {}
+
+    virtual sp<KeyCharacterMap> getKeyCharacterMap(int32_t) const override { return nullptr; }
+
+    virtual bool setKeyboardLayoutOverlay(int32_t, const sp<KeyCharacterMap>&) override {
+        return false;
+    }
+
+    virtual void vibrate(int32_t, nsecs_t, nsecs_t, int32_t) override {}
+
+    virtual void cancelVibrate(int32_t) override {}
+
+    virtual void requestReopenDevices() override {}
+
+    virtual void wake() override {}
+
+    virtual void dump(std::string&) override {}
+
+    virtual void monitor() override {}
+
+    virtual bool isDeviceEnabled(int32_t) override { return true; }
+
+    virtual status_t enableDevice(int32_t) override { return OK; }
+
+    virtual status_t disableDevice(int32_t) override { return OK; }
+
+    const uint32_t mClasses;
+    InputDeviceIdentifier mIdentifier;
+    std::unordered_map<int, RawAbsoluteAxisInfo> mAbsoluteAxes;
+    std::set<int> mInputProperties;
+    std::unordered_map<int32_t, int32_t> mKeyCodesByScanCode;
+    std::vector<RawEvent> mPendingEvents;
+    std::vector<RawEvent> mStream;
+    size_t mNextEvent = 0;
+};
+
+// --- BenchmarkInputReader ---
+
+class BenchmarkInputReader : public InputReader {
+public:
+    BenchmarkInputReader(std::shared_ptr<EventHubInterface> eventHub,
+                         const sp<InputReaderPolicyInterface>& policy,
+                         const sp<InputListenerInterface>& listener)
+          : InputReader(eventHub, policy, listener) {}
+
+    virtual ~BenchmarkInputReader() {}
+
+    // Make the protected loopOnce method accessible to the benchmarks.
+    using InputReader::loopOnce;
+};
+
+// --- Recorded streams ---
+
+/**
+ * Builds a stream one frame at a time, the way getevent would show it. Timestamps are filled in
+ * when the stream is replayed.
+ */
+class StreamBuilder {
+public:
+    StreamBuilder& add(int32_t type, int32_t code, int32_t value) {
+        mEvents.push_back({0, DEVICE_ID, type, code, value});
+        return *this;
+    }
+
+    StreamBuilder& sync() { return add(EV_SYN, SYN_REPORT, 0); }
+
+    std::vector<RawEvent> build() { return std::move(mEvents); }
+
+private:
+    std::vector<RawEvent> mEvents;
+};
+
+static const int32_t MAX_SLOTS = 10;
+
+static void configureMultiTouchScreen(FakeEventHub& eventHub) {
+    eventHub.addAbsoluteAxis(ABS_MT_SLOT, 0, MAX_SLOTS - 1);
+    eventHub.addAbsoluteAxis(ABS_MT_TRACKING_ID, 0, 65535);
+    eventHub.addAbsoluteAxis(ABS_MT_POSITION_X, 0, DISPLAY_WIDTH - 1);
+    eventHub.addAbsoluteAxis(ABS_MT_POSITION_Y, 0, DISPLAY_HEIGHT - 1);
+    eventHub.addAbsoluteAxis(ABS_MT_TOUCH_MAJOR, 0, 255);
+    eventHub.addAbsoluteAxis(ABS_MT_PRESSURE, 0, 255);
+    eventHub.addInputProperty(INPUT_PROP_DIRECT);
+    eventHub.addKey(BTN_TOUCH, 0);
+}
+
+/**
+ * Ten fingers land one after the other, move together in small steps for a while, and lift one
+ * after the other, using the slot protocol.
+ */
+static std::vector<RawEvent> recordTenFingerGesture() {
+    static constexpr int32_t MOVE_FRAMES = 200;
+    StreamBuilder stream;
+    auto fingerX = [](int32_t slot, int32_t frame) { return 50 + slot * 100 + frame % 20; };
+    auto fingerY = [](int32_t slot, int32_t frame) { return 500 + slot * 20 + frame * 5; };
+
+    for (int32_t slot = 0; slot < MAX_SLOTS; slot++) {
+        stream.add(EV_ABS, ABS_MT_SLOT, slot)
+                .add(EV_ABS, ABS_MT_TRACKING_ID, slot)
+                .add(EV_ABS, ABS_MT_POSITION_X, fingerX(slot, 0))
+                .add(EV_ABS, ABS_MT_POSITION_Y, fingerY(slot, 0))
+                .add(EV_ABS, ABS_MT_TOUCH_MAJOR, 20)
+                .add(EV_ABS, ABS_MT_PRESSURE, 60);
+        if (slot == 0) {
+            stream.add(EV_KEY, BTN_TOUCH, 1);
+        }
+        stream.sync();
+    }
+    for (int32_t frame = 1; frame <= MOVE_FRAMES; frame++) {
+        for (int32_t slot = 0; slot < MAX_SLOTS; slot++) {
+            stream.add(EV_ABS, ABS_MT_SLOT, slot)
+                    .add(EV_ABS, ABS_MT_POSITION_X, fingerX(slot, frame))
+                    .add(EV_ABS, ABS_MT_POSITION_Y, fingerY(slot, frame))
+                    .add(EV_ABS, ABS_MT_PRESSURE, 60 + frame % 8);
+        }
+        stream.sync();
+    }
+    for (int32_t slot = 0; slot < MAX_SLOTS; slot++) {
+        stream.add(EV_ABS, ABS_MT_SLOT, slot).add(EV_ABS, ABS_MT_TRACKING_ID, -1);
+        if (slot == MAX_SLOTS - 1) {
+            stream.add(EV_KEY, BTN_TOUCH, 0);
+        }
+        stream.sync();
+    }
+    return stream.build();
+}
+
+static void configureStylus(FakeEventHub& eventHub) {
+    eventHub.addAbsoluteAxis(ABS_X, 0, DISPLAY_WIDTH * 10 - 1);
+    eventHub.addAbsoluteAxis(ABS_Y, 0, DISPLAY_HEIGHT * 10 - 1);
+    eventHub.addAbsoluteAxis(ABS_PRESSURE, 0, 4095);
+    eventHub.addAbsoluteAxis(ABS_DISTANCE, 0, 255);
+    eventHub.addAbsoluteAxis(ABS_TILT_X, -90, 90);
+    eventHub.addAbsoluteAxis(ABS_TILT_Y, -90, 90);
+    eventHub.addInputProperty(INPUT_PROP_DIRECT);
+    eventHub.addKey(BTN_TOUCH, 0);
+    eventHub.addKey(BTN_TOOL_PEN, 0);
+}
+
+/**
+ * A pen hovers in, draws a long stroke reporting position, pressure and tilt on every frame, as
+ * fast digitizers do, and hovers back out.
+ */
+static std::vector<RawEvent> recordStylusStroke() {
+    static constexpr int32_t HOVER_FRAMES = 20;
+    static constexpr int32_t DRAW_FRAMES = 500;
+    StreamBuilder stream;
+    auto x = [](int32_t frame) { return 1000 + frame * 13; };
+    auto y = [](int32_t frame) { return 2000 + frame * 31; };
+
+    stream.add(EV_KEY, BTN_TOOL_PEN, 1);
+    for (int32_t frame = 0; frame < HOVER_FRAMES; frame++) {
+        stream.add(EV_ABS, ABS_X, x(frame))
+                .add(EV_ABS, ABS_Y, y(frame))
+                .add(EV_ABS, ABS_DISTANCE, HOVER_FRAMES - frame)
+                .sync();
+    }
+    stream.add(EV_KEY, BTN_TOUCH, 1).add(EV_ABS, ABS_DISTANCE, 0);
+    for (int32_t frame = HOVER_FRAMES; frame < HOVER_FRAMES + DRAW_FRAMES; frame++) {
+        stream.add(EV_ABS, ABS_X, x(frame))
+                .add(EV_ABS, ABS_Y, y(frame))
+                .add(EV_ABS, ABS_PRESSURE, 1000 + frame % 2000)
+                .add(EV_ABS, ABS_TILT_X, frame % 60 - 30)
+                .add(EV_ABS, ABS_TILT_Y, 30 - frame % 60)
+                .sync();
+    }
+    stream.add(EV_KEY, BTN_TOUCH, 0).add(EV_ABS, ABS_PRESSURE, 0).sync();
+    stream.add(EV_KEY, BTN_TOOL_PEN, 0).sync();
+    return stream.build();
+}
+
+static void configureGamepad(FakeEventHub& eventHub) {
+    for (int axis : {ABS_X, ABS_Y, ABS_Z, ABS_RZ}) {
+        eventHub.addAbsoluteAxis(axis, -32768, 32767, 128, 16);
+    }
+    eventHub.addAbsoluteAxis(ABS_GAS, 0, 1023);
+    eventHub.addAbsoluteAxis(ABS_BRAKE, 0, 1023);
+    eventHub.addKey(BTN_A, AKEYCODE_BUTTON_A);
+    eventHub.addKey(BTN_B, AKEYCODE_BUTTON_B);
+}
+
+/**
+ * Both sticks sweep around while the triggers are squeezed, with the odd button press in
+ * between.
+ */
+static std::vector<RawEvent> recordGamepadPlay() {
+    static constexpr int32_t FRAMES = 500;
+    StreamBuilder stream;
+    for (int32_t frame = 0; frame < FRAMES; frame++) {
+        const int32_t value = (frame * 1024) % 65536 - 32768;
+        stream.add(EV_ABS, ABS_X, value)
+                .add(EV_ABS, ABS_Y, -value)
+                .add(EV_ABS, ABS_Z, value / 2)
+                .add(EV_ABS, ABS_RZ, -value / 2)
+                .add(EV_ABS, ABS_GAS, frame % 1024)
+                .add(EV_ABS, ABS_BRAKE, 1023 - frame % 1024);
+        if (frame % 50 == 0) {
+            stream.add(EV_KEY, frame % 100 == 0 ? BTN_A : BTN_B, 1);
+        } else if (frame % 50 == 10) {
+            stream.add(EV_KEY, frame % 100 == 10 ? BTN_A : BTN_B, 0);
+        }
+        stream.sync();
+    }
+    return stream.build();
+}
+
+static const int32_t LETTER_SCAN_CODES[] = {KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G,
+                                            KEY_H, KEY_I, KEY_J, KEY_K, KEY_L, KEY_M, KEY_N,
+                                            KEY_O, KEY_P, KEY_Q, KEY_R, KEY_S, KEY_T, KEY_U,
+                                            KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z};
+static const int32_t LETTER_KEY_CODES[] = {
+        AKEYCODE_A, AKEYCODE_B, AKEYCODE_C, AKEYCODE_D, AKEYCODE_E, AKEYCODE_F, AKEYCODE_G,
+        AKEYCODE_H, AKEYCODE_I, AKEYCODE_J, AKEYCODE_K, AKEYCODE_L, AKEYCODE_M, AKEYCODE_N,
+        AKEYCODE_O, AKEYCODE_P, AKEYCODE_Q, AKEYCODE_R, AKEYCODE_S, AKEYCODE_T, AKEYCODE_U,
+        AKEYCODE_V, AKEYCODE_W, AKEYCODE_X, AKEYCODE_Y, AKEYCODE_Z};
+
+static void configureKeyboard(FakeEventHub& eventHub) {
+    for (size_t i = 0; i < std::size(LETTER_SCAN_CODES); i++) {
+        eventHub.addKey(LETTER_SCAN_CODES[i], LETTER_KEY_CODES[i]);
+    }
+    eventHub.addKey(KEY_LEFTSHIFT, AKEYCODE_SHIFT_LEFT);
+    eventHub.addKey(KEY_SPACE, AKEYCODE_SPACE);
+}
+
+/**
+ * Typing through the alphabet a few times, capitalizing the first letter of every word with
+ * shift. Every key reports its scan code along with the key event, like USB keyboards do.
+ */
+static std::vector<RawEvent> recordTyping() {
+    static constexpr size_t WORD_LENGTH = 5;
+    static constexpr size_t LETTERS = 200;
+    StreamBuilder stream;
+    auto press = [&stream](int32_t scanCode, int32_t value) {
+        stream.add(EV_MSC, MSC_SCAN, scanCode).add(EV_KEY, scanCode, value).sync();
+    };
+    for (size_t i = 0; i < LETTERS; i++) {
+        const int32_t scanCode = LETTER_SCAN_CODES[i % std::size(LETTER_SCAN_CODES)];
+        const bool capital = i % WORD_LENGTH == 0;
+        if (capital) {
+            press(KEY_LEFTSHIFT, 1);
+        }
+        press(scanCode, 1);
+        press(scanCode, 0);
+        if (capital) {
+            press(KEY_LEFTSHIFT, 0);
+        }
+        if (i % WORD_LENGTH == WORD_LENGTH - 1) {
+            press(KEY_SPACE, 1);
+            press(KEY_SPACE, 0);
+        }
+    }
+    return stream.build();
+}
+
+// --- Benchmarks ---
+
+/**
+ * Replay the stream once per iteration through a reader that only has the one device, and
+ * report the mean time spent per raw event and per frame read.
+ */
+static void benchmarkReplay(benchmark::State& state, std::shared_ptr<FakeEventHub> eventHub,
+                            std::vector<RawEvent> stream) {
+    sp<FakeInputReaderPolicy> policy = new FakeInputReaderPolicy();
+    sp<FakeInputListener> listener = new FakeInputListener();
+    BenchmarkInputReader reader(eventHub, policy, listener);
+
+    // Add the device before the stream is set, so the first read only reports the device.
+    reader.loopOnce();
+    eventHub->setStream(std::move(stream));
+    const size_t frames = eventHub->getFrameCount();
+
+    const nsecs_t startTime = now();
+    for (auto _ : state) {
+        for (size_t i = 0; i < frames; i++) {
+            reader.loopOnce();
+        }
+    }
+    const nsecs_t elapsed = now() - startTime;
+
+    const int64_t events = state.iterations() * eventHub->getEventCount();
+    state.SetItemsProcessed(events);
+    if (events > 0) {
+        state.counters["ns/event"] = double(elapsed) / events;
+        state.counters["ns/frame"] = double(elapsed) / (state.iterations() * frames);
+    }
+}
+
+static void benchmarkMultiTouch_TenFingers(benchmark::State& state) {
+    std::shared_ptr<FakeEventHub> eventHub =
+            std::make_shared<FakeEventHub>("Touchscreen",
+                                           INPUT_DEVICE_CLASS_TOUCH | INPUT_DEVICE_CLASS_TOUCH_MT);
+    configureMultiTouchScreen(*eventHub);
+    benchmarkReplay(state, eventHub, recordTenFingerGesture());
+}
+
+static void benchmarkSingleTouch_Stylus(benchmark::State& state) {
+    std::shared_ptr<FakeEventHub> eventHub =
+            std::make_shared<FakeEventHub>("Stylus", INPUT_DEVICE_CLASS_TOUCH);
+    configureStylus(*eventHub);
+    benchmarkReplay(state, eventHub, recordStylusStroke());
+}
+
+static void benchmarkJoystick_Gamepad(benchmark::State& state) {
+    std::shared_ptr<FakeEventHub> eventHub =
+            std::make_shared<FakeEventHub>("Gamepad",
+                                           INPUT_DEVICE_CLASS_KEYBOARD |
+                                                   INPUT_DEVICE_CLASS_GAMEPAD |
+                                                   INPUT_DEVICE_CLASS_JOYSTICK);
+    configureGamepad(*eventHub);
+    benchmarkReplay(state, eventHub, recordGamepadPlay());
+}
+
+static void benchmarkKeyboard_Typing(benchmark::State& state) {
+    std::shared_ptr<FakeEventHub> eventHub =
+            std::make_shared<FakeEventHub>("Keyboard",
+                                           INPUT_DEVICE_CLASS_KEYBOARD |
+                                                   INPUT_DEVICE_CLASS_ALPHAKEY);
+    configureKeyboard(*eventHub);
+    benchmarkReplay(state, eventHub, recordTyping());
+}
+
+BENCHMARK(benchmarkMultiTouch_TenFingers);
+BENCHMARK(benchmarkSingleTouch_Stylus);
+BENCHMARK(benchmarkJoystick_Gamepad);
+BENCHMARK(benchmarkKeyboard_Typing);
+
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -20,6 +20,7 @@
 #include "InputState.h"
 
 #include <input/InputTransport.h>
+#include <input/LatencyStatistics.h>
 #include <deque>
 
 namespace android::inputdispatcher {
@@ -59,6 +60,15 @@ public:
     // yet received a "finished" response from the application.
     std::deque<DispatchEntry*> waitQueue;
 
+    // How far behind the application is, for dumpsys. Collected over the connection's lifetime.
+    // The wait queue length is sampled whenever an event is published, and the finish latency is
+    // the time from publishing an event to receiving its finished signal, in microseconds.
+    LatencyStatistics waitQueueLengthStatistics{std::chrono::hours(24)};
+    LatencyStatistics finishLatencyStatistics{std::chrono::hours(24)};
+
+    // Number of motion events that were replaced by a newer one before being published.
+    size_t coalescedMotionCount = 0;
+
     Connection(const sp<InputChannel>& inputChannel, bool monitor, const IdGenerator& idGenerator);
 
     inline const std::string getInputChannelName() const { return inputChannel->getName(); }
@@ -17,6 +17,7 @@
 #include "Entry.h"
 
 #include "Connection.h"
+#include "ObjectPool.h"
 
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
@@ -62,6 +63,7 @@ EventEntry::EventEntry(int32_t id, Type type, nsecs_t eventTime, uint32_t policy
         refCount(1),
         type(type),
         eventTime(eventTime),
+        enqueueTime(systemTime(SYSTEM_TIME_MONOTONIC)),
         policyFlags(policyFlags),
         injectionState(nullptr),
         dispatchInProgress(false) {}
@@ -236,6 +238,61 @@ void MotionEntry::appendDescription(std::string& msg) const {
     msg += StringPrintf("]), policyFlags=0x%08x", policyFlags);
 }
 
+// --- Entry pools ---
+
+// Key, motion and dispatch entries are created and destroyed for every input event. Keep enough
+// freed ones around to cover the events in flight, so the hot path doesn't go through malloc.
+// A motion entry carries its pointer coordinates inline, so those are pooled along with it.
+using KeyEntryPool = ObjectPool<KeyEntry, 16>;
+using MotionEntryPool = ObjectPool<MotionEntry, 32>;
+using DispatchEntryPool = ObjectPool<DispatchEntry, 64>;
+
+template <typename Pool>
+static Pool& getPool() {
+    // Never destroyed, since entries can still be released while statics are torn down.
+    static Pool* pool = new Pool();
+    return *pool;
+}
+
+template <typename Pool, typename T>
+static void* allocateFromPool(size_t size) {
+    // Only objects of exactly T come from the pool.
+    return size == sizeof(T) ? getPool<Pool>().allocate() : ::operator new(size);
+}
+
+template <typename Pool, typename T>
+static void deallocateToPool(void* ptr, size_t size) {
+    if (size == sizeof(T)) {
+        getPool<Pool>().deallocate(ptr);
+    } else {
+        ::operator delete(ptr);
+    }
+}
+
+void* KeyEntry::operator new(size_t size) {
+    return allocateFromPool<KeyEntryPool, KeyEntry>(size);
+}
+
+void KeyEntry::operator delete(void* ptr, size_t size) {
+    deallocateToPool<KeyEntryPool, KeyEntry>(ptr, size);
+}
+
+void* MotionEntry::operator new(size_t size) {
+    return allocateFromPool<MotionEntryPool, MotionEntry>(size);
+}
+
+void MotionEntry::operator delete(void* ptr, size_t size) {
+    deallocateToPool<MotionEntryPool, MotionEntry>(ptr, size);
+}
+
+void* DispatchEntry::operator new(size_t size) {
+    return allocateFromPool<DispatchEntryPool, DispatchEntry>(size);
+}
+
+void DispatchEntry::operator delete(void* ptr, size_t size) {
+    deallocateToPool<DispatchEntryPool, DispatchEntry>(ptr, size);
+}
+
 // --- DispatchEntry ---
 
 volatile int32_t DispatchEntry::sNextSeqAtomic;
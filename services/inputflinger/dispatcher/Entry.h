@@ -22,6 +22,7 @@
 
 #include <input/Input.h>
 #include <input/InputApplication.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <utils/Timers.h>
 #include <functional>
@@ -57,6 +58,8 @@ struct EventEntry {
     mutable int32_t refCount;
     Type type;
     nsecs_t eventTime;
+    // When the dispatcher was handed the event, for latency statistics.
+    nsecs_t enqueueTime;
     uint32_t policyFlags;
     InjectionState* injectionState;
 
@@ -149,6 +152,10 @@ struct KeyEntry : EventEntry {
     virtual void appendDescription(std::string& msg) const;
     void recycle();
 
+    // Allocated from a pool, see Entry.cpp.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+
 protected:
     virtual ~KeyEntry();
 };
@@ -183,6 +190,10 @@ struct MotionEntry : EventEntry {
                 float xOffset, float yOffset);
     virtual void appendDescription(std::string& msg) const;
 
+    // Allocated from a pool, see Entry.cpp.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+
 protected:
     virtual ~MotionEntry();
 };
@@ -213,6 +224,10 @@ struct DispatchEntry {
                   float globalScaleFactor, float windowXScale, float windowYScale);
     ~DispatchEntry();
 
+    // Allocated from a pool, see Entry.cpp.
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+
     inline bool hasForegroundTarget() const { return targetFlags & InputTarget::FLAG_FOREGROUND; }
 
     inline bool isSplit() const { return targetFlags & InputTarget::FLAG_SPLIT; }
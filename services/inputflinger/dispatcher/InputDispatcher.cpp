@@ -103,6 +103,9 @@ constexpr std::chrono::nanoseconds KEY_WAITING_FOR_EVENTS_TIMEOUT = 500ms;
 // Number of recent events to keep for debugging purposes.
 constexpr size_t RECENT_QUEUE_MAX_SIZE = 10;
 
+// Number of different interceptKeyBeforeDispatching results to keep for reuse.
+constexpr size_t KEY_INTERCEPTION_VERDICTS_MAX_SIZE = 64;
+
 static inline nsecs_t now() {
     return systemTime(SYSTEM_TIME_MONOTONIC);
 }
@@ -258,6 +261,82 @@ static bool isStaleEvent(nsecs_t currentTime, const EventEntry& entry) {
     return currentTime - entry.eventTime >= STALE_EVENT_TIMEOUT;
 }
 
+/**
+ * Returns true if 'entry' can replace 'pendingEntry', a motion that is still waiting in the
+ * outbound queue of the same connection. Only hover moves and scrolls, plus moves when
+ * 'coalesceMoves' is set, that differ in nothing but their coordinates are coalesced. Injected
+ * events are never coalesced because their injectors wait for the result of each one.
+ */
+static bool canCoalesceMotionDispatchEntries(const DispatchEntry& pendingEntry,
+                                             const DispatchEntry& entry, bool coalesceMoves) {
+    if (pendingEntry.eventEntry->type != EventEntry::Type::MOTION ||
+        entry.eventEntry->type != EventEntry::Type::MOTION) {
+        return false;
+    }
+    if (entry.resolvedAction != AMOTION_EVENT_ACTION_HOVER_MOVE &&
+        entry.resolvedAction != AMOTION_EVENT_ACTION_SCROLL &&
+        !(coalesceMoves && entry.resolvedAction == AMOTION_EVENT_ACTION_MOVE)) {
+        return false;
+    }
+    if (pendingEntry.resolvedAction != entry.resolvedAction ||
+        pendingEntry.resolvedFlags != entry.resolvedFlags ||
+        pendingEntry.targetFlags != entry.targetFlags || pendingEntry.xOffset != entry.xOffset ||
+        pendingEntry.yOffset != entry.yOffset ||
+        pendingEntry.globalScaleFactor != entry.globalScaleFactor ||
+        pendingEntry.windowXScale != entry.windowXScale ||
+        pendingEntry.windowYScale != entry.windowYScale) {
+        return false;
+    }
+
+    const MotionEntry& pendingMotion = static_cast<const MotionEntry&>(*pendingEntry.eventEntry);
+    const MotionEntry& motion = static_cast<const MotionEntry&>(*entry.eventEntry);
+    if (pendingMotion.isInjected() || motion.isInjected()) {
+        return false;
+    }
+    if (pendingMotion.deviceId != motion.deviceId || pendingMotion.source != motion.source ||
+        pendingMotion.displayId != motion.displayId ||
+        pendingMotion.metaState != motion.metaState ||
+        pendingMotion.buttonState != motion.buttonState ||
+        pendingMotion.classification != motion.classification ||
+        pendingMotion.pointerCount != motion.pointerCount) {
+        return false;
+    }
+    for (uint32_t i = 0; i < motion.pointerCount; i++) {
+        if (pendingMotion.pointerProperties[i] != motion.pointerProperties[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Creates a copy of the scroll 'motionEntry' whose scroll amounts include those of
+ * 'pendingEntry', so that coalescing the two does not lose any scrolling.
+ */
+static MotionEntry* createAccumulatedScrollEntry(const MotionEntry& pendingEntry,
+                                                 const MotionEntry& motionEntry) {
+    PointerCoords pointerCoords[motionEntry.pointerCount];
+    for (uint32_t i = 0; i < motionEntry.pointerCount; i++) {
+        pointerCoords[i].copyFrom(motionEntry.pointerCoords[i]);
+        for (int32_t axis : {AMOTION_EVENT_AXIS_VSCROLL, AMOTION_EVENT_AXIS_HSCROLL}) {
+            pointerCoords[i].setAxisValue(axis,
+                                          pointerCoords[i].getAxisValue(axis) +
+                                                  pendingEntry.pointerCoords[i].getAxisValue(
+                                                          axis));
+        }
+    }
+    return new MotionEntry(motionEntry.id, motionEntry.eventTime, motionEntry.deviceId,
+                           motionEntry.source, motionEntry.displayId, motionEntry.policyFlags,
+                           motionEntry.action, motionEntry.actionButton, motionEntry.flags,
+                           motionEntry.metaState, motionEntry.buttonState,
+                           motionEntry.classification, motionEntry.edgeFlags,
+                           motionEntry.xPrecision, motionEntry.yPrecision,
+                           motionEntry.xCursorPosition, motionEntry.yCursorPosition,
+                           motionEntry.downTime, motionEntry.pointerCount,
+                           motionEntry.pointerProperties, pointerCoords, 0 /* xOffset */,
+                           0 /* yOffset */);
+}
+
 static std::unique_ptr<DispatchEntry> createDispatchEntry(const InputTarget& inputTarget,
                                                           EventEntry* eventEntry,
                                                           int32_t inputTargetFlags) {
@@ -396,9 +475,11 @@ InputDispatcher::InputDispatcher(const sp<InputDispatcherPolicyInterface>& polic
         mAppSwitchSawKeyDown(false),
         mAppSwitchDueTime(LONG_LONG_MAX),
         mNextUnblockedEvent(nullptr),
+        mKeyInterceptionVerdictHits(0),
         mDispatchEnabled(false),
         mDispatchFrozen(false),
         mInputFilterEnabled(false),
+        mStagingInputFilterEnabled(false),
         // mInTouchMode will be initialized by the WindowManager to the default device config.
         // To avoid leaking stack in case that call never comes, and for tests,
         // initialize it here anyways.
@@ -451,6 +532,11 @@ void InputDispatcher::dispatchOnce() {
         std::scoped_lock _l(mLock);
         mDispatcherIsAlive.notify_all();
 
+        // Pick up the events that were queued without the lock.
+        if (moveStagedInboundEventsLocked()) {
+            nextWakeupTime = LONG_LONG_MIN;
+        }
+
         // Run a dispatch loop if there are no pending commands.
         // The dispatch loop might enqueue commands to run afterwards.
         if (!haveCommandsLocked()) {
@@ -742,6 +828,26 @@ bool InputDispatcher::shouldPruneInboundQueueLocked(const MotionEntry& motionEnt
 }
 
 bool InputDispatcher::enqueueInboundEventLocked(EventEntry* entry) {
+    // Anything staged came in before this event.
+    bool needWake = moveStagedInboundEventsLocked();
+    return appendInboundEventLocked(entry) || needWake;
+}
+
+bool InputDispatcher::moveStagedInboundEventsLocked() {
+    bool needWake = false;
+    mStagedInboundQueue.drain([this, &needWake](EventEntry* entry) REQUIRES(mLock) {
+        if (mInputFilterEnabled) {
+            // The event skipped the filter because it raced with the filter being enabled.
+            // Drop it like the events that were already queued at the time.
+            releaseInboundEventLocked(entry);
+            return;
+        }
+        needWake |= appendInboundEventLocked(entry);
+    });
+    return needWake;
+}
+
+bool InputDispatcher::appendInboundEventLocked(EventEntry* entry) {
     bool needWake = mInboundQueue.empty();
     mInboundQueue.push_back(entry);
     traceInboundQueueLengthLocked();
@@ -807,9 +913,15 @@ sp<InputWindowHandle> InputDispatcher::findTouchedWindowAtLocked(int32_t display
         LOG_ALWAYS_FATAL(
                 "Must provide a valid touch state if adding portal windows or outside targets");
     }
-    // Traverse windows from front to back to find touched window.
-    const std::vector<sp<InputWindowHandle>> windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& windowHandle : windowHandles) {
+    auto windowHandlesIt = mWindowHandlesByDisplay.find(displayId);
+    if (windowHandlesIt == mWindowHandlesByDisplay.end()) {
+        return nullptr;
+    }
+    const std::vector<sp<InputWindowHandle>>& windowHandles = windowHandlesIt->second;
+    const WindowIndex& windowIndex = mWindowIndexByDisplay.at(displayId);
+    // Traverse the windows that may be hit from front to back to find touched window.
+    for (size_t i : windowIndex.touchable.query(x, y)) {
+        const sp<InputWindowHandle>& windowHandle = windowHandles[i];
         const InputWindowInfo* windowInfo = windowHandle->getInfo();
         if (windowInfo->displayId == displayId) {
             int32_t flags = windowInfo->layoutParamsFlags;
@@ -974,6 +1086,7 @@ void InputDispatcher::postCommandLocked(std::unique_ptr<CommandEntry> commandEnt
 }
 
 void InputDispatcher::drainInboundQueueLocked() {
+    moveStagedInboundEventsLocked();
     while (!mInboundQueue.empty()) {
         EventEntry* entry = mInboundQueue.front();
         mInboundQueue.pop_front();
@@ -1045,6 +1158,44 @@ KeyEntry* InputDispatcher::synthesizeKeyRepeatLocked(nsecs_t currentTime) {
     return entry;
 }
 
+InputDispatcher::KeyInterception InputDispatcher::makeKeyInterception(
+        const KeyEntry& entry, const sp<IBinder>& token) {
+    return {token,         entry.displayId, entry.source,    entry.action,
+            entry.flags,   entry.keyCode,   entry.metaState, entry.policyFlags};
+}
+
+bool InputDispatcher::findKeyInterceptionVerdictLocked(KeyEntry& entry,
+                                                       const sp<IBinder>& token) {
+    if (!mConfig.cacheKeyInterceptionVerdicts) {
+        return false;
+    }
+    // The policy still sees the first press of ordinary keys, which it may act on, for example to
+    // start tracking a long press. Only repeats, and gamepad buttons, which get pressed over and
+    // over again, come out of the cache.
+    if (entry.repeatCount == 0 && (entry.source & AINPUT_SOURCE_GAMEPAD) != AINPUT_SOURCE_GAMEPAD) {
+        return false;
+    }
+    auto it = mKeyInterceptionVerdicts.find(makeKeyInterception(entry, token));
+    if (it == mKeyInterceptionVerdicts.end()) {
+        return false;
+    }
+    entry.interceptKeyResult = it->second;
+    mKeyInterceptionVerdictHits++;
+    return true;
+}
+
+void InputDispatcher::rememberKeyInterceptionVerdictLocked(const KeyEntry& entry,
+                                                           const sp<IBinder>& token) {
+    if (!mConfig.cacheKeyInterceptionVerdicts ||
+        entry.interceptKeyResult == KeyEntry::INTERCEPT_KEY_RESULT_TRY_AGAIN_LATER) {
+        return;
+    }
+    if (mKeyInterceptionVerdicts.size() >= KEY_INTERCEPTION_VERDICTS_MAX_SIZE) {
+        mKeyInterceptionVerdicts.clear();
+    }
+    mKeyInterceptionVerdicts[makeKeyInterception(entry, token)] = entry.interceptKeyResult;
+}
+
 bool InputDispatcher::dispatchConfigurationChangedLocked(nsecs_t currentTime,
                                                          ConfigurationChangedEntry* entry) {
 #if DEBUG_OUTBOUND_EVENT_DETAILS
@@ -1168,14 +1319,20 @@ bool InputDispatcher::dispatchKeyLocked(nsecs_t currentTime, KeyEntry* entry,
             if (focusedWindowHandle != nullptr) {
                 commandEntry->inputChannel = getInputChannelLocked(focusedWindowHandle->getToken());
             }
-            commandEntry->keyEntry = entry;
-            postCommandLocked(std::move(commandEntry));
-            entry->refCount += 1;
-            return false; // wait for the command to run
+            sp<IBinder> token = commandEntry->inputChannel != nullptr
+                    ? commandEntry->inputChannel->getConnectionToken()
+                    : nullptr;
+            if (!findKeyInterceptionVerdictLocked(*entry, token)) {
+                commandEntry->keyEntry = entry;
+                postCommandLocked(std::move(commandEntry));
+                entry->refCount += 1;
+                return false; // wait for the command to run
+            }
         } else {
             entry->interceptKeyResult = KeyEntry::INTERCEPT_KEY_RESULT_CONTINUE;
         }
-    } else if (entry->interceptKeyResult == KeyEntry::INTERCEPT_KEY_RESULT_SKIP) {
+    }
+    if (entry->interceptKeyResult == KeyEntry::INTERCEPT_KEY_RESULT_SKIP) {
         if (*dropReason == DropReason::NOT_DROPPED) {
             *dropReason = DropReason::POLICY;
         }
@@ -2103,13 +2260,22 @@ static bool canBeObscuredBy(const sp<InputWindowHandle>& windowHandle,
 bool InputDispatcher::isWindowObscuredAtPointLocked(const sp<InputWindowHandle>& windowHandle,
                                                     int32_t x, int32_t y) const {
     int32_t displayId = windowHandle->getInfo()->displayId;
-    const std::vector<sp<InputWindowHandle>> windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& otherHandle : windowHandles) {
-        if (windowHandle == otherHandle) {
+    auto windowHandlesIt = mWindowHandlesByDisplay.find(displayId);
+    if (windowHandlesIt == mWindowHandlesByDisplay.end()) {
+        return false;
+    }
+    const std::vector<sp<InputWindowHandle>>& windowHandles = windowHandlesIt->second;
+    const WindowIndex& windowIndex = mWindowIndexByDisplay.at(displayId);
+    auto zOrderIt = windowIndex.zOrder.find(windowHandle.get());
+    const size_t end =
+            zOrderIt != windowIndex.zOrder.end() ? zOrderIt->second : windowHandles.size();
+    for (size_t i : windowIndex.frames.query(x, y)) {
+        if (i >= end) {
             break; // All future windows are below us. Exit early.
         }
+        const sp<InputWindowHandle>& otherHandle = windowHandles[i];
         const InputWindowInfo* otherInfo = otherHandle->getInfo();
-          if (canBeObscuredBy(windowHandle, otherHandle) &&
+        if (canBeObscuredBy(windowHandle, otherHandle) &&
             otherInfo->frameContainsPoint(x, y)) {
             return true;
         }
@@ -2420,6 +2586,31 @@ void InputDispatcher::enqueueDispatchEntryLocked(const sp<Connection>& connectio
         }
     }
 
+    // While the connection is backed up, a hover move or scroll that is still waiting to be
+    // published is superseded by the newer one rather than queueing a dispatch for each report.
+    // The same goes for moves once the application is too far behind, see
+    // InputDispatcherConfiguration::moveMergingWaitQueueDepth.
+    if (!connection->outboundQueue.empty() &&
+        canCoalesceMotionDispatchEntries(*connection->outboundQueue.back(), *dispatchEntry,
+                                         shouldMergeMovesLocked(*connection))) {
+        DispatchEntry* pendingEntry = connection->outboundQueue.back();
+        connection->outboundQueue.pop_back();
+        connection->coalescedMotionCount++;
+        if (dispatchEntry->resolvedAction == AMOTION_EVENT_ACTION_SCROLL) {
+            dispatchEntry->eventEntry =
+                    createAccumulatedScrollEntry(static_cast<const MotionEntry&>(
+                                                         *pendingEntry->eventEntry),
+                                                 static_cast<const MotionEntry&>(*newEntry));
+            newEntry->release();
+            newEntry = dispatchEntry->eventEntry;
+        }
+#if DEBUG_DISPATCH_CYCLE
+        ALOGD("channel '%s' ~ enqueueDispatchEntryLocked: coalesced pending motion event",
+              connection->getInputChannelName().c_str());
+#endif
+        releaseDispatchEntry(pendingEntry);
+    }
+
     // Remember that we are waiting for this dispatch to complete.
     if (dispatchEntry->hasForegroundTarget()) {
         incrementPendingForegroundDispatches(newEntry);
@@ -2471,6 +2662,17 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
 
     while (connection->status == Connection::STATUS_NORMAL && !connection->outboundQueue.empty()) {
         DispatchEntry* dispatchEntry = connection->outboundQueue.front();
+        if (dispatchEntry->eventEntry->type == EventEntry::Type::MOTION &&
+            dispatchEntry->resolvedAction == AMOTION_EVENT_ACTION_MOVE &&
+            !dispatchEntry->eventEntry->isInjected() && shouldMergeMovesLocked(*connection)) {
+            // Hold the move back until the application catches up. Newer moves replace it in
+            // the meantime, and the dispatch cycle restarts when a finished signal arrives.
+#if DEBUG_DISPATCH_CYCLE
+            ALOGD("channel '%s' ~ Holding back move while the wait queue is too long",
+                  connection->getInputChannelName().c_str());
+#endif
+            break;
+        }
         dispatchEntry->deliveryTime = currentTime;
         const nsecs_t timeout =
                 getDispatchingTimeoutLocked(connection->inputChannel->getConnectionToken());
@@ -2610,6 +2812,7 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
                                                     dispatchEntry));
         traceOutboundQueueLength(connection);
         connection->waitQueue.push_back(dispatchEntry);
+        connection->waitQueueLengthStatistics.addValue(connection->waitQueue.size());
         if (connection->responsive) {
             mAnrTracker.insert(dispatchEntry->timeoutTime,
                                connection->inputChannel->getConnectionToken());
@@ -2618,6 +2821,11 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
     }
 }
 
+bool InputDispatcher::shouldMergeMovesLocked(const Connection& connection) const {
+    return mConfig.moveMergingWaitQueueDepth > 0 &&
+            connection.waitQueue.size() >= mConfig.moveMergingWaitQueueDepth;
+}
+
 const std::array<uint8_t, 32> InputDispatcher::getSignature(
         const MotionEntry& motionEntry, const DispatchEntry& dispatchEntry) const {
     int32_t actionMasked = dispatchEntry.resolvedAction & AMOTION_EVENT_ACTION_MASK;
@@ -3121,6 +3329,18 @@ void InputDispatcher::notifyKey(const NotifyKeyArgs* args) {
               std::to_string(t.duration().count()).c_str());
     }
 
+    if (!mStagingInputFilterEnabled) {
+        // Nothing to consult under the lock, so hand the event straight to the dispatcher thread.
+        KeyEntry* newEntry =
+                new KeyEntry(args->id, args->eventTime, args->deviceId, args->source,
+                             args->displayId, policyFlags, args->action, flags, keyCode,
+                             args->scanCode, metaState, repeatCount, args->downTime);
+        if (mStagedInboundQueue.push(newEntry)) {
+            mLooper->wake();
+        }
+        return;
+    }
+
     bool needWake;
     { // acquire lock
         mLock.lock();
@@ -3197,6 +3417,22 @@ void InputDispatcher::notifyMotion(const NotifyMotionArgs* args) {
               std::to_string(t.duration().count()).c_str());
     }
 
+    if (!mStagingInputFilterEnabled) {
+        // Nothing to consult under the lock, so hand the event straight to the dispatcher thread.
+        MotionEntry* newEntry =
+                new MotionEntry(args->id, args->eventTime, args->deviceId, args->source,
+                                args->displayId, policyFlags, args->action, args->actionButton,
+                                args->flags, args->metaState, args->buttonState,
+                                args->classification, args->edgeFlags, args->xPrecision,
+                                args->yPrecision, args->xCursorPosition, args->yCursorPosition,
+                                args->downTime, args->pointerCount, args->pointerProperties,
+                                args->pointerCoords, 0, 0);
+        if (mStagedInboundQueue.push(newEntry)) {
+            mLooper->wake();
+        }
+        return;
+    }
+
     bool needWake;
     { // acquire lock
         mLock.lock();
@@ -3621,6 +3857,7 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
     if (inputWindowHandles.empty()) {
         // Remove all handles on a display if there are no windows left.
         mWindowHandlesByDisplay.erase(displayId);
+        mWindowIndexByDisplay.erase(displayId);
         return;
     }
 
@@ -3672,6 +3909,75 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
 
     // Insert or replace
     mWindowHandlesByDisplay[displayId] = newHandles;
+    updateWindowIndexForDisplayLocked(displayId);
+}
+
+/**
+ * Bring the hit test index for a display up to date with its current window handles. The index
+ * only narrows down which windows are looked at; findTouchedWindowAtLocked and
+ * isWindowObscuredAtPointLocked still run their full checks on each candidate, so the windows
+ * left out here must be ones those checks would skip anyway.
+ *
+ * A display's windows are sent again whenever any one of them changes, and most of those
+ * updates leave the bounds of the others alone, so the index is only rebuilt when the order of
+ * the windows or what they contribute to it changed.
+ */
+void InputDispatcher::updateWindowIndexForDisplayLocked(int32_t displayId) {
+    const std::vector<sp<InputWindowHandle>>& windowHandles = mWindowHandlesByDisplay[displayId];
+    std::vector<WindowIndex::Entry> entries;
+    entries.reserve(windowHandles.size());
+    for (const sp<InputWindowHandle>& windowHandle : windowHandles) {
+        const InputWindowInfo* info = windowHandle->getInfo();
+        WindowIndex::Entry& entry = entries.emplace_back();
+        entry.handle = windowHandle.get();
+        entry.touchable = Rect::EMPTY_RECT;
+        entry.touchableUnbounded = false;
+        entry.frame = Rect::EMPTY_RECT;
+        if (!info->visible) {
+            continue;
+        }
+
+        const int32_t flags = info->layoutParamsFlags;
+        const bool isTouchable = !(flags & InputWindowInfo::FLAG_NOT_TOUCHABLE);
+        const bool isTouchModal = (flags &
+                                   (InputWindowInfo::FLAG_NOT_FOCUSABLE |
+                                    InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0;
+        if ((isTouchable && isTouchModal) || (flags & InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH)) {
+            entry.touchableUnbounded = true;
+        } else if (isTouchable) {
+            entry.touchable = info->touchableRegion.getBounds();
+        }
+        entry.frame = Rect(info->frameLeft, info->frameTop, info->frameRight, info->frameBottom);
+    }
+
+    WindowIndex& windowIndex = mWindowIndexByDisplay[displayId];
+    if (entries == windowIndex.entries) {
+        return;
+    }
+
+    windowIndex.entries = std::move(entries);
+    windowIndex.touchable.clear();
+    windowIndex.frames.clear();
+    windowIndex.zOrder.clear();
+    for (size_t i = 0; i < windowIndex.entries.size(); i++) {
+        const WindowIndex::Entry& entry = windowIndex.entries[i];
+        windowIndex.zOrder.emplace(entry.handle, i);
+        if (entry.touchableUnbounded) {
+            windowIndex.touchable.insertUnbounded();
+        } else {
+            windowIndex.touchable.insert(entry.touchable);
+        }
+        windowIndex.frames.insert(entry.frame);
+    }
+
+    windowIndex.touchable.build();
+    windowIndex.frames.build();
+}
+
+static bool containsWindow(const std::unordered_map<int32_t, sp<IBinder>>& tokensById,
+                           const sp<InputWindowHandle>& windowHandle) {
+    auto it = tokensById.find(windowHandle->getId());
+    return it != tokensById.end() && it->second == windowHandle->getToken();
 }
 
 void InputDispatcher::setInputWindows(
@@ -3708,9 +4014,18 @@ void InputDispatcher::setInputWindowsLocked(
 
     updateWindowHandlesForDisplayLocked(inputWindowHandles, displayId);
 
+    // The windows now on the display, so checking whether a window is still present doesn't
+    // have to walk every display. Windows not found here may still be on another display.
+    const std::vector<sp<InputWindowHandle>> newWindowHandles = getWindowHandlesLocked(displayId);
+    std::unordered_map<int32_t /*id*/, sp<IBinder>> newTokensById;
+    newTokensById.reserve(newWindowHandles.size());
+    for (const sp<InputWindowHandle>& windowHandle : newWindowHandles) {
+        newTokensById.emplace(windowHandle->getId(), windowHandle->getToken());
+    }
+
     sp<InputWindowHandle> newFocusedWindowHandle = nullptr;
     bool foundHoveredWindow = false;
-    for (const sp<InputWindowHandle>& windowHandle : getWindowHandlesLocked(displayId)) {
+    for (const sp<InputWindowHandle>& windowHandle : newWindowHandles) {
         // Set newFocusedWindowHandle to the top most focused window instead of the last one
         if (!newFocusedWindowHandle && windowHandle->getInfo()->hasFocus &&
             windowHandle->getInfo()->visible) {
@@ -3764,7 +4079,8 @@ void InputDispatcher::setInputWindowsLocked(
         TouchState& state = stateIt->second;
         for (size_t i = 0; i < state.windows.size();) {
             TouchedWindow& touchedWindow = state.windows[i];
-            if (!hasWindowHandleLocked(touchedWindow.windowHandle)) {
+            if (!containsWindow(newTokensById, touchedWindow.windowHandle) &&
+                !hasWindowHandleLocked(touchedWindow.windowHandle)) {
                 if (DEBUG_FOCUS) {
                     ALOGD("Touched window was removed: %s in display %" PRId32,
                           touchedWindow.windowHandle->getName().c_str(), displayId);
@@ -3788,7 +4104,8 @@ void InputDispatcher::setInputWindowsLocked(
     // Otherwise, they might stick around until the window handle is destroyed
     // which might not happen until the next GC.
     for (const sp<InputWindowHandle>& oldWindowHandle : oldWindowHandles) {
-        if (!hasWindowHandleLocked(oldWindowHandle)) {
+        if (!containsWindow(newTokensById, oldWindowHandle) &&
+            !hasWindowHandleLocked(oldWindowHandle)) {
             if (DEBUG_FOCUS) {
                 ALOGD("Window went away: %s", oldWindowHandle->getName().c_str());
             }
@@ -3937,6 +4254,7 @@ void InputDispatcher::setInputFilterEnabled(bool enabled) {
         }
 
         mInputFilterEnabled = enabled;
+        mStagingInputFilterEnabled = enabled;
         resetAndDropEverythingLocked("input filter is being enabled or disabled");
     } // release lock
 
@@ -3949,6 +4267,11 @@ void InputDispatcher::setInTouchMode(bool inTouchMode) {
     mInTouchMode = inTouchMode;
 }
 
+void InputDispatcher::invalidateKeyInterceptionVerdicts() {
+    std::scoped_lock lock(mLock);
+    mKeyInterceptionVerdicts.clear();
+}
+
 bool InputDispatcher::transferTouchFocus(const sp<IBinder>& fromToken, const sp<IBinder>& toToken) {
     if (fromToken == toToken) {
         if (DEBUG_FOCUS) {
@@ -4273,6 +4596,13 @@ void InputDispatcher::dumpDispatchStateLocked(std::string& dump) {
             } else {
                 dump += INDENT3 "WaitQueue: <empty>\n";
             }
+
+            dump += StringPrintf(INDENT3 "WaitQueueLength: %s\n",
+                                 connection->waitQueueLengthStatistics.dump().c_str());
+            dump += StringPrintf(INDENT3 "FinishLatency (us): %s\n",
+                                 connection->finishLatencyStatistics.dump().c_str());
+            dump += StringPrintf(INDENT3 "CoalescedMotions: %zu\n",
+                                 connection->coalescedMotionCount);
         }
     } else {
         dump += INDENT "Connections: <none>\n";
@@ -4285,10 +4615,27 @@ void InputDispatcher::dumpDispatchStateLocked(std::string& dump) {
         dump += INDENT "AppSwitch: not pending\n";
     }
 
+    dump += StringPrintf(INDENT "KeyInterceptionVerdicts: %zu kept, %zu reused\n",
+                         mKeyInterceptionVerdicts.size(), mKeyInterceptionVerdictHits);
+
+    dump += INDENT "TouchLatency (us):\n";
+    dump += StringPrintf(INDENT2 "EventToEnqueue: %s\n",
+                         mTouchLatencyStatistics.toEnqueue.dump().c_str());
+    dump += StringPrintf(INDENT2 "EnqueueToPublish: %s\n",
+                         mTouchLatencyStatistics.toPublish.dump().c_str());
+    dump += StringPrintf(INDENT2 "PublishToFinish: %s\n",
+                         mTouchLatencyStatistics.toFinish.dump().c_str());
+    dump += StringPrintf(INDENT2 "EventToFinish: %s\n",
+                         mTouchLatencyStatistics.total.dump().c_str());
+
     dump += INDENT "Configuration:\n";
     dump += StringPrintf(INDENT2 "KeyRepeatDelay: %" PRId64 "ms\n", ns2ms(mConfig.keyRepeatDelay));
     dump += StringPrintf(INDENT2 "KeyRepeatTimeout: %" PRId64 "ms\n",
                          ns2ms(mConfig.keyRepeatTimeout));
+    dump += StringPrintf(INDENT2 "MoveMergingWaitQueueDepth: %zu\n",
+                         mConfig.moveMergingWaitQueueDepth);
+    dump += StringPrintf(INDENT2 "CacheKeyInterceptionVerdicts: %s\n",
+                         toString(mConfig.cacheKeyInterceptionVerdicts));
 }
 
 void InputDispatcher::dumpMonitors(std::string& dump, const std::vector<Monitor>& monitors) {
@@ -4730,6 +5077,7 @@ void InputDispatcher::doInterceptKeyBeforeDispatchingLockedInterruptible(
         entry->interceptKeyResult = KeyEntry::INTERCEPT_KEY_RESULT_TRY_AGAIN_LATER;
         entry->interceptKeyWakeupTime = now() + delay;
     }
+    rememberKeyInterceptionVerdictLocked(*entry, token);
     entry->release();
 }
 
@@ -4770,7 +5118,8 @@ void InputDispatcher::doDispatchCycleFinishedLockedInterruptible(CommandEntry* c
         ALOGI("%s spent %" PRId64 "ms processing %s", connection->getWindowName().c_str(),
               ns2ms(eventDuration), dispatchEntry->eventEntry->getDescription().c_str());
     }
-    reportDispatchStatistics(std::chrono::nanoseconds(eventDuration), *connection, handled);
+    reportDispatchStatistics(*dispatchEntry, finishTime);
+    connection->finishLatencyStatistics.addValue(nanoseconds_to_microseconds(eventDuration));
 
     bool restartEvent;
     if (dispatchEntry->eventEntry->type == EventEntry::Type::KEY) {
@@ -5023,9 +5372,36 @@ KeyEvent InputDispatcher::createKeyEvent(const KeyEntry& entry) {
     return event;
 }
 
-void InputDispatcher::reportDispatchStatistics(std::chrono::nanoseconds eventDuration,
-                                               const Connection& connection, bool handled) {
-    // TODO Write some statistics about how long we spend waiting.
+/**
+ * Record the latency of each stage of a touch event once the app has finished handling it.
+ * Only events straight from a touchscreen count, and only once per event, for the foreground
+ * window.
+ */
+void InputDispatcher::reportDispatchStatistics(const DispatchEntry& dispatchEntry,
+                                               nsecs_t finishTime) {
+    const EventEntry& entry = *dispatchEntry.eventEntry;
+    if (entry.type != EventEntry::Type::MOTION || !dispatchEntry.hasForegroundTarget()) {
+        return;
+    }
+    const MotionEntry& motionEntry = static_cast<const MotionEntry&>(entry);
+    if (motionEntry.source != AINPUT_SOURCE_TOUCHSCREEN || motionEntry.isSynthesized()) {
+        return;
+    }
+
+    TouchLatencyStatistics& stats = mTouchLatencyStatistics;
+    // All of them are reset together, so checking one is enough.
+    if (stats.total.shouldReport()) {
+        stats.toEnqueue.reset();
+        stats.toPublish.reset();
+        stats.toFinish.reset();
+        stats.total.reset();
+    }
+    const nsecs_t eventTime = motionEntry.eventTime;
+    stats.toEnqueue.addValue(nanoseconds_to_microseconds(motionEntry.enqueueTime - eventTime));
+    stats.toPublish.addValue(
+            nanoseconds_to_microseconds(dispatchEntry.deliveryTime - motionEntry.enqueueTime));
+    stats.toFinish.addValue(nanoseconds_to_microseconds(finishTime - dispatchEntry.deliveryTime));
+    stats.total.addValue(nanoseconds_to_microseconds(finishTime - eventTime));
 }
 
 /**
@@ -27,7 +27,9 @@
 #include "InputState.h"
 #include "InputTarget.h"
 #include "InputThread.h"
+#include "LockFreeQueue.h"
 #include "Monitor.h"
+#include "SpatialIndex.h"
 #include "TouchState.h"
 #include "TouchedWindow.h"
 
@@ -45,6 +47,7 @@
 #include <utils/RefBase.h>
 #include <utils/Timers.h>
 #include <utils/threads.h>
+#include <atomic>
 #include <condition_variable>
 #include <deque>
 #include <optional>
@@ -119,6 +122,7 @@ public:
     virtual void setInputDispatchMode(bool enabled, bool frozen) override;
     virtual void setInputFilterEnabled(bool enabled) override;
     virtual void setInTouchMode(bool inTouchMode) override;
+    virtual void invalidateKeyInterceptionVerdicts() override;
 
     virtual bool transferTouchFocus(const sp<IBinder>& fromToken,
                                     const sp<IBinder>& toToken) override;
@@ -153,6 +157,10 @@ private:
 
     EventEntry* mPendingEvent GUARDED_BY(mLock);
     std::deque<EventEntry*> mInboundQueue GUARDED_BY(mLock);
+    // Key and motion events from the reader, handed over without taking mLock when there is no
+    // input filter to consult. The dispatcher thread moves them into mInboundQueue, as does
+    // anything else about to touch it, so they keep their order relative to locked enqueues.
+    LockFreeQueue<EventEntry*> mStagedInboundQueue;
     std::deque<EventEntry*> mRecentQueue GUARDED_BY(mLock);
     std::deque<std::unique_ptr<CommandEntry>> mCommandQueue GUARDED_BY(mLock);
 
@@ -169,6 +177,10 @@ private:
 
     // Enqueues an inbound event.  Returns true if mLooper->wake() should be called.
     bool enqueueInboundEventLocked(EventEntry* entry) REQUIRES(mLock);
+    // Moves the staged events into the inbound queue.  Returns true if any of them would have
+    // needed a wake up from enqueueInboundEventLocked.
+    bool moveStagedInboundEventsLocked() REQUIRES(mLock);
+    bool appendInboundEventLocked(EventEntry* entry) REQUIRES(mLock);
 
     // Cleans up input state when dropping an inbound event.
     void dropInboundEventLocked(const EventEntry& entry, DropReason dropReason) REQUIRES(mLock);
@@ -264,6 +276,43 @@ private:
     };
     // Maps the key code replaced, device id tuple to the key code it was replaced with
     std::unordered_map<KeyReplacement, int32_t, KeyReplacementHash> mReplacedKeys GUARDED_BY(mLock);
+
+    // interceptKeyBeforeDispatching results kept for reuse, keyed by everything about the key
+    // and its focused window that the policy gets to see.
+    struct KeyInterception {
+        sp<IBinder> token;
+        int32_t displayId;
+        int32_t source;
+        int32_t action;
+        int32_t flags;
+        int32_t keyCode;
+        int32_t metaState;
+        uint32_t policyFlags;
+        bool operator==(const KeyInterception& rhs) const {
+            return token == rhs.token && displayId == rhs.displayId && source == rhs.source &&
+                    action == rhs.action && flags == rhs.flags && keyCode == rhs.keyCode &&
+                    metaState == rhs.metaState && policyFlags == rhs.policyFlags;
+        }
+    };
+    struct KeyInterceptionHash {
+        size_t operator()(const KeyInterception& key) const {
+            size_t hash = std::hash<IBinder*>()(key.token.get());
+            for (int32_t value : {key.displayId, key.source, key.action, key.flags, key.keyCode,
+                                  key.metaState, static_cast<int32_t>(key.policyFlags)}) {
+                hash = hash * 31 + std::hash<int32_t>()(value);
+            }
+            return hash;
+        }
+    };
+    std::unordered_map<KeyInterception, KeyEntry::InterceptKeyResult, KeyInterceptionHash>
+            mKeyInterceptionVerdicts GUARDED_BY(mLock);
+    size_t mKeyInterceptionVerdictHits GUARDED_BY(mLock);
+    static KeyInterception makeKeyInterception(const KeyEntry& entry, const sp<IBinder>& token);
+    bool findKeyInterceptionVerdictLocked(KeyEntry& entry, const sp<IBinder>& token)
+            REQUIRES(mLock);
+    void rememberKeyInterceptionVerdictLocked(const KeyEntry& entry, const sp<IBinder>& token)
+            REQUIRES(mLock);
+
     // Process certain Meta + Key combinations
     void accelerateMetaShortcuts(const int32_t deviceId, const int32_t action, int32_t& keyCode,
                                  int32_t& metaState);
@@ -289,10 +338,40 @@ private:
     bool mDispatchEnabled GUARDED_BY(mLock);
     bool mDispatchFrozen GUARDED_BY(mLock);
     bool mInputFilterEnabled GUARDED_BY(mLock);
+    // Copy of mInputFilterEnabled for notifyKey and notifyMotion to check without mLock.
+    std::atomic<bool> mStagingInputFilterEnabled;
     bool mInTouchMode GUARDED_BY(mLock);
 
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> mWindowHandlesByDisplay
             GUARDED_BY(mLock);
+
+    // Lookup structures over the windows of a display, so hit tests don't have to check every
+    // window. Rebuilt when an update of mWindowHandlesByDisplay changes the order of the windows
+    // of the display or what any of them contributes to the lookups.
+    struct WindowIndex {
+        // What a window contributes to the lookups below.
+        struct Entry {
+            const InputWindowHandle* handle;
+            Rect touchable;
+            bool touchableUnbounded;
+            Rect frame;
+
+            bool operator==(const Entry& other) const {
+                return handle == other.handle && touchable == other.touchable &&
+                        touchableUnbounded == other.touchableUnbounded && frame == other.frame;
+            }
+        };
+        // One per window, in the order of mWindowHandlesByDisplay.
+        std::vector<Entry> entries;
+        // Windows that may be touched at a point, or that watch for touches outside of them.
+        SpatialIndex touchable;
+        // Visible window frames, for occlusion checks.
+        SpatialIndex frames;
+        // Position of each window in mWindowHandlesByDisplay, front to back.
+        std::unordered_map<const InputWindowHandle*, size_t> zOrder;
+    };
+    std::unordered_map<int32_t, WindowIndex> mWindowIndexByDisplay GUARDED_BY(mLock);
+    void updateWindowIndexForDisplayLocked(int32_t displayId) REQUIRES(mLock);
     void setInputWindowsLocked(const std::vector<sp<InputWindowHandle>>& inputWindowHandles,
                                int32_t displayId) REQUIRES(mLock);
     // Get window handles by display, return an empty vector if not found.
@@ -435,6 +514,7 @@ private:
             REQUIRES(mLock);
     void startDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection)
             REQUIRES(mLock);
+    bool shouldMergeMovesLocked(const Connection& connection) const REQUIRES(mLock);
     void finishDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
                                    uint32_t seq, bool handled) REQUIRES(mLock);
     void abortBrokenDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
@@ -521,9 +601,24 @@ private:
     static constexpr std::chrono::duration TOUCH_STATS_REPORT_PERIOD = 5min;
     LatencyStatistics mTouchStatistics{TOUCH_STATS_REPORT_PERIOD};
 
+    // Touch latency split at the points the dispatcher can see, in microseconds. The reader
+    // keeps the breakdown of the time before the enqueue.
+    struct TouchLatencyStatistics {
+        // From the kernel timestamp to the dispatcher being handed the event. This covers
+        // EventHub, InputReader and InputClassifier.
+        LatencyStatistics toEnqueue{TOUCH_STATS_REPORT_PERIOD};
+        // From the enqueue to InputPublisher::publishMotionEvent.
+        LatencyStatistics toPublish{TOUCH_STATS_REPORT_PERIOD};
+        // From the publish to the app's finished signal being received.
+        LatencyStatistics toFinish{TOUCH_STATS_REPORT_PERIOD};
+        // From the kernel timestamp to the app's finished signal.
+        LatencyStatistics total{TOUCH_STATS_REPORT_PERIOD};
+    };
+    TouchLatencyStatistics mTouchLatencyStatistics GUARDED_BY(mLock);
+
     void reportTouchEventForStatistics(const MotionEntry& entry);
-    void reportDispatchStatistics(std::chrono::nanoseconds eventDuration,
-                                  const Connection& connection, bool handled);
+    void reportDispatchStatistics(const DispatchEntry& dispatchEntry, nsecs_t finishTime)
+            REQUIRES(mLock);
     void traceInboundQueueLengthLocked() REQUIRES(mLock);
     void traceOutboundQueueLength(const sp<Connection>& connection);
     void traceWaitQueueLength(const sp<Connection>& connection);
@@ -16,11 +16,50 @@
 
 #include "InputDispatcherFactory.h"
 #include "InputDispatcher.h"
+#include "ShardedInputDispatcher.h"
+
+#include <android-base/parseint.h>
+#include <android-base/strings.h>
+#include <cutils/properties.h>
+#include <log/log.h>
 
 namespace android {
 
+/**
+ * Groups of displays that get their own dispatcher thread, such as "2,3;4" for one thread for
+ * displays 2 and 3 and one for display 4. All other displays share the default thread.
+ */
+static const char* PROPERTY_DISPLAY_GROUPS = "ro.input.dispatcher.display_groups";
+
+static std::vector<std::vector<int32_t>> getDisplayGroups() {
+    char value[PROPERTY_VALUE_MAX];
+    property_get(PROPERTY_DISPLAY_GROUPS, value, "");
+
+    std::vector<std::vector<int32_t>> displayGroups;
+    for (const std::string& group : android::base::Split(value, ";")) {
+        std::vector<int32_t> displayIds;
+        for (const std::string& display : android::base::Split(group, ",")) {
+            int32_t displayId;
+            if (android::base::ParseInt(android::base::Trim(display), &displayId)) {
+                displayIds.push_back(displayId);
+            } else if (!android::base::Trim(display).empty()) {
+                ALOGW("Ignoring invalid display id '%s' in %s", display.c_str(),
+                      PROPERTY_DISPLAY_GROUPS);
+            }
+        }
+        if (!displayIds.empty()) {
+            displayGroups.push_back(std::move(displayIds));
+        }
+    }
+    return displayGroups;
+}
+
 sp<InputDispatcherInterface> createInputDispatcher(
         const sp<InputDispatcherPolicyInterface>& policy) {
+    std::vector<std::vector<int32_t>> displayGroups = getDisplayGroups();
+    if (!displayGroups.empty()) {
+        return new android::inputdispatcher::ShardedInputDispatcher(policy, displayGroups);
+    }
     return new android::inputdispatcher::InputDispatcher(policy);
 }
 
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_INPUTDISPATCHER_LOCKFREEQUEUE_H
+#define _UI_INPUT_INPUTDISPATCHER_LOCKFREEQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+namespace android::inputdispatcher {
+
+/**
+ * A queue that any number of threads can push to without taking a lock, and that a single
+ * consumer empties all at once.
+ *
+ * Pushes go onto an intrusive stack with a compare-and-swap. The consumer detaches the whole
+ * stack with one exchange and reverses it, so it never races with a pusher over a node and there
+ * is no ABA problem to worry about.
+ */
+template <typename T>
+class LockFreeQueue {
+public:
+    LockFreeQueue() = default;
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    // Remaining values are destroyed, not handed to anybody, so owners of pointers must drain
+    // the queue first.
+    ~LockFreeQueue() {
+        drain([](T&&) {});
+    }
+
+    // Append a value. Returns true if the queue was empty, i.e. the consumer may need a wake up.
+    bool push(T value) {
+        Node* node = new Node{std::move(value), mHead.load(std::memory_order_relaxed)};
+        while (!mHead.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+        return node->next == nullptr;
+    }
+
+    // Remove every value pushed so far, calling consume on each one in the order they were
+    // pushed. Only one thread may drain at a time.
+    template <typename F>
+    void drain(F consume) {
+        Node* node = mHead.exchange(nullptr, std::memory_order_acquire);
+        Node* reversed = nullptr;
+        while (node != nullptr) {
+            Node* next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+        while (reversed != nullptr) {
+            Node* next = reversed->next;
+            consume(std::move(reversed->value));
+            delete reversed;
+            reversed = next;
+        }
+    }
+
+    // Only a hint when there are concurrent pushes.
+    bool empty() const { return mHead.load(std::memory_order_relaxed) == nullptr; }
+
+private:
+    struct Node {
+        T value;
+        Node* next;
+    };
+
+    std::atomic<Node*> mHead{nullptr};
+};
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_LOCKFREEQUEUE_H
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_INPUTDISPATCHER_OBJECTPOOL_H
+#define _UI_INPUT_INPUTDISPATCHER_OBJECTPOOL_H
+
+#include <android-base/thread_annotations.h>
+#include <stddef.h>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace android::inputdispatcher {
+
+/**
+ * Keeps up to CAPACITY freed blocks big enough for a T around for reuse, so that objects created
+ * and destroyed for every event don't go back to malloc each time. Past CAPACITY, blocks are
+ * allocated and freed normally, so the pool bounds how much memory it holds on to, not how many
+ * objects may be alive.
+ *
+ * Meant to back a class-specific operator new and delete. Objects may be freed on a different
+ * thread from the one that allocated them.
+ */
+template <typename T, size_t CAPACITY>
+class ObjectPool {
+public:
+    ObjectPool() { mFreeBlocks.reserve(CAPACITY); }
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    ~ObjectPool() {
+        for (void* block : mFreeBlocks) {
+            ::operator delete(block);
+        }
+    }
+
+    void* allocate() {
+        {
+            std::scoped_lock _l(mLock);
+            if (!mFreeBlocks.empty()) {
+                void* block = mFreeBlocks.back();
+                mFreeBlocks.pop_back();
+                return block;
+            }
+        }
+        return ::operator new(sizeof(T));
+    }
+
+    void deallocate(void* block) {
+        {
+            std::scoped_lock _l(mLock);
+            if (mFreeBlocks.size() < CAPACITY) {
+                mFreeBlocks.push_back(block);
+                return;
+            }
+        }
+        ::operator delete(block);
+    }
+
+    size_t freeCount() {
+        std::scoped_lock _l(mLock);
+        return mFreeBlocks.size();
+    }
+
+private:
+    std::mutex mLock;
+    // Never grows past the capacity reserved up front, so push_back doesn't allocate.
+    std::vector<void*> mFreeBlocks GUARDED_BY(mLock);
+};
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_OBJECTPOOL_H
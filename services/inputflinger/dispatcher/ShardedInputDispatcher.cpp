@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "ShardedInputDispatcher"
+
+#include "ShardedInputDispatcher.h"
+
+#include <android-base/stringprintf.h>
+#include <inttypes.h>
+#include <log/log.h>
+
+using android::base::StringPrintf;
+
+namespace android::inputdispatcher {
+
+ShardedInputDispatcher::ShardedInputDispatcher(
+        const sp<InputDispatcherPolicyInterface>& policy,
+        const std::vector<std::vector<int32_t>>& displayGroups)
+      : mFocusedDisplayId(ADISPLAY_ID_DEFAULT) {
+    mShards.push_back(new InputDispatcher(policy));
+    for (const std::vector<int32_t>& displayGroup : displayGroups) {
+        const size_t shard = mShards.size();
+        mShards.push_back(new InputDispatcher(policy));
+        for (int32_t displayId : displayGroup) {
+            if (!mShardsByDisplay.emplace(displayId, shard).second) {
+                ALOGW("Display %" PRId32 " is in more than one display group, keeping shard %zu",
+                      displayId, mShardsByDisplay[displayId]);
+            }
+        }
+    }
+}
+
+ShardedInputDispatcher::~ShardedInputDispatcher() {}
+
+size_t ShardedInputDispatcher::getShardForDisplay(int32_t displayId) const {
+    auto it = mShardsByDisplay.find(displayId);
+    return it != mShardsByDisplay.end() ? it->second : 0;
+}
+
+size_t ShardedInputDispatcher::getShardForEvent(int32_t displayId) {
+    if (displayId == ADISPLAY_ID_NONE) {
+        std::scoped_lock _l(mLock);
+        displayId = mFocusedDisplayId;
+    }
+    return getShardForDisplay(displayId);
+}
+
+void ShardedInputDispatcher::dump(std::string& dump) {
+    for (size_t i = 0; i < mShards.size(); i++) {
+        std::string displays;
+        for (const auto& [displayId, shard] : mShardsByDisplay) {
+            if (shard == i) {
+                displays += (displays.empty() ? "" : ", ") + std::to_string(displayId);
+            }
+        }
+        dump += StringPrintf("Input Dispatcher Shard %zu (displays: %s):\n", i,
+                             i == 0 ? "all others" : displays.c_str());
+        mShards[i]->dump(dump);
+    }
+}
+
+void ShardedInputDispatcher::monitor() {
+    for (const sp<InputDispatcher>& shard : mShards) {
+        shard->monitor();
+    }
+}
+
+bool ShardedInputDispatcher::waitForIdle() {
+    bool idle = true;
+    for (const sp<InputDispatcher>& shard : mShards) {
+        idle &= shard->waitForIdle();
+    }
+    return idle;
+}
+
+status_t ShardedInputDispatcher::start() {
+    for (size_t i = 0; i < mShards.size(); i++) {
+        status_t result = mShards[i]->start();
+        if (result) {
+            ALOGE("Could not start input dispatcher shard %zu due to error %d.", i, result);
+            while (i-- > 0) {
+                mShards[i]->stop();
+            }
+            return result;
+        }
+    }
+    return OK;
+}
+
+status_t ShardedInputDispatcher::stop() {
+    status_t result = OK;
+    for (const sp<InputDispatcher>& shard : mShards) {
+        status_t shardResult = shard->stop();
+        if (shardResult && !result) {
+            result = shardResult;
+        }
+    }
+    return result;
+}
+
+void ShardedInputDispatcher::notifyConfigurationChanged(
+        const NotifyConfigurationChangedArgs* args) {
+    // Only used to notify the policy, which should only hear about it once.
+    mShards[0]->notifyConfigurationChanged(args);
+}
+
+void ShardedInputDispatcher::notifyKey(const NotifyKeyArgs* args) {
+    mShards[getShardForEvent(args->displayId)]->notifyKey(args);
+}
+
+void ShardedInputDispatcher::notifyMotion(const NotifyMotionArgs* args) {
+    mShards[getShardForEvent(args->displayId)]->notifyMotion(args);
+}
+
+void ShardedInputDispatcher::notifySwitch(const NotifySwitchArgs* args) {
+    // Only used to notify the policy, which should only hear about it once.
+    mShards[0]->notifySwitch(args);
+}
+
+void ShardedInputDispatcher::notifyDeviceReset(const NotifyDeviceResetArgs* args) {
+    // The device may have streams in progress on any display.
+    for (const sp<InputDispatcher>& shard : mShards) {
+        shard->notifyDeviceReset(args);
+    }
+}
+
+int32_t ShardedInputDispatcher::injectInputEvent(const InputEvent* event, int32_t injectorPid,
+                                                 int32_t injectorUid, int32_t syncMode,
+                                                 std::chrono::milliseconds timeout,
+                                                 uint32_t policyFlags) {
+    return mShards[getShardForEvent(event->getDisplayId())]
+            ->injectInputEvent(event, injectorPid, injectorUid, syncMode, timeout, policyFlags);
+}
+
+std::unique_ptr<VerifiedInputEvent> ShardedInputDispatcher::verifyInputEvent(
+        const InputEvent& event) {
+    // Every shard signs the events it dispatches with its own key, and the event could have been
+    // signed before focus moved to another display, so ask all of them.
+    for (const sp<InputDispatcher>& shard : mShards) {
+        std::unique_ptr<VerifiedInputEvent> verifiedEvent = shard->verifyInputEvent(event);
+        if (verifiedEvent != nullptr) {
+            return verifiedEvent;
+        }
+    }
+    return nullptr;
+}
+
+void ShardedInputDispatcher::moveChannelToShardLocked(RegisteredChannel& channel, size_t shard) {
+    // Unregister first, so that the channel is never read by two dispatcher threads at once.
+    mShards[channel.shard]->unregisterInputChannel(channel.inputChannel);
+    status_t result = mShards[shard]->registerInputChannel(channel.inputChannel);
+    if (result) {
+        ALOGE("Could not move input channel '%s' to shard %zu due to error %d.",
+              channel.inputChannel->getName().c_str(), shard, result);
+    }
+    channel.shard = shard;
+}
+
+void ShardedInputDispatcher::setInputWindows(
+        const std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>>& handlesPerDisplay) {
+    std::vector<std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>>> handlesPerShard(
+            mShards.size());
+
+    std::scoped_lock _l(mLock);
+    for (const auto& [displayId, handles] : handlesPerDisplay) {
+        const size_t shard = getShardForDisplay(displayId);
+        for (const sp<InputWindowHandle>& handle : handles) {
+            auto it = mChannelsByToken.find(handle->getToken());
+            if (it != mChannelsByToken.end() && it->second.shard != shard &&
+                !it->second.monitor) {
+                moveChannelToShardLocked(it->second, shard);
+            }
+        }
+        handlesPerShard[shard].emplace(displayId, handles);
+    }
+
+    for (size_t i = 0; i < mShards.size(); i++) {
+        if (!handlesPerShard[i].empty()) {
+            mShards[i]->setInputWindows(handlesPerShard[i]);
+        }
+    }
+}
+
+void ShardedInputDispatcher::setFocusedApplication(
+        int32_t displayId, const sp<InputApplicationHandle>& inputApplicationHandle) {
+    mShards[getShardForDisplay(displayId)]->setFocusedApplication(displayId,
+                                                                  inputApplicationHandle);
+}
+
+void ShardedInputDispatcher::setFocusedDisplay(int32_t displayId) {
+    std::scoped_lock _l(mLock);
+    mFocusedDisplayId = displayId;
+    // The shard that loses the focused display has to send a focus out event to its window.
+    for (const sp<InputDispatcher>& shard : mShards) {
+        shard->setFocusedDisplay(displayId);
+    }
+}
+
+void ShardedInputDispatcher::setInputDispatchMode(bool enabled, bool frozen) {
+    for (const sp<InputDispatcher>& shard : mShards) {
+        shard->setInputDispatchMode(enabled, frozen);
+    }
+}
+
+void ShardedInputDispatcher::setInputFilterEnabled(bool enabled) {
+    for (const sp<InputDispatcher>& shard : mShards) {
+        shard->setInputFilterEnabled(enabled);
+    }
+}
+
+void ShardedInputDispatcher::setInTouchMode(bool inTouchMode) {
+    for (const sp<InputDispatcher>& shard : mShards) {
+        shard->setInTouchMode(inTouchMode);
+    }
+}
+
+void ShardedInputDispatcher::invalidateKeyInterceptionVerdicts() {
+    for (const sp<InputDispatcher>& shard : mShards) {
+        shard->invalidateKeyInterceptionVerdicts();
+    }
+}
+
+bool ShardedInputDispatcher::transferTouchFocus(const sp<IBinder>& fromToken,
+                                                const sp<IBinder>& toToken) {
+    std::scoped_lock _l(mLock);
+    auto fromIt = mChannelsByToken.find(fromToken);
+    auto toIt = mChannelsByToken.find(toToken);
+    if (fromIt == mChannelsByToken.end() || toIt == mChannelsByToken.end() ||
+        fromIt->second.shard != toIt->second.shard) {
+        return false;
+    }
+    return mShards[fromIt->second.shard]->transferTouchFocus(fromToken, toToken);
+}
+
+status_t ShardedInputDispatcher::registerInputChannel(const sp<InputChannel>& inputChannel) {
+    std::scoped_lock _l(mLock);
+    if (mChannelsByToken.count(inputChannel->getConnectionToken())) {
+        ALOGW("Attempted to register already registered input channel '%s'",
+              inputChannel->getName().c_str());
+        return BAD_VALUE;
+    }
+    // The channel moves to another shard once its window is put on one of that shard's displays.
+    status_t result = mShards[0]->registerInputChannel(inputChannel);
+    if (result == OK) {
+        mChannelsByToken[inputChannel->getConnectionToken()] = {inputChannel, 0, false /*monitor*/};
+    }
+    return result;
+}
+
+status_t ShardedInputDispatcher::registerInputMonitor(const sp<InputChannel>& inputChannel,
+                                                      int32_t displayId, bool isGestureMonitor) {
+    std::scoped_lock _l(mLock);
+    if (mChannelsByToken.count(inputChannel->getConnectionToken())) {
+        ALOGW("Attempted to register already registered input channel '%s'",
+              inputChannel->getName().c_str());
+        return BAD_VALUE;
+    }
+    const size_t shard = getShardForDisplay(displayId);
+    status_t result = mShards[shard]->registerInputMonitor(inputChannel, displayId,
+                                                           isGestureMonitor);
+    if (result == OK) {
+        mChannelsByToken[inputChannel->getConnectionToken()] = {inputChannel, shard,
+                                                                true /*monitor*/};
+    }
+    return result;
+}
+
+status_t ShardedInputDispatcher::unregisterInputChannel(const sp<InputChannel>& inputChannel) {
+    std::scoped_lock _l(mLock);
+    auto it = mChannelsByToken.find(inputChannel->getConnectionToken());
+    if (it == mChannelsByToken.end()) {
+        ALOGW("Attempted to unregister already unregistered input channel '%s'",
+              inputChannel->getName().c_str());
+        return BAD_VALUE;
+    }
+    status_t result = mShards[it->second.shard]->unregisterInputChannel(inputChannel);
+    mChannelsByToken.erase(it);
+    return result;
+}
+
+status_t ShardedInputDispatcher::pilferPointers(const sp<IBinder>& token) {
+    std::scoped_lock _l(mLock);
+    auto it = mChannelsByToken.find(token);
+    if (it == mChannelsByToken.end()) {
+        ALOGW("Attempted to pilfer pointers from an un-registered monitor or invalid token");
+        return BAD_VALUE;
+    }
+    return mShards[it->second.shard]->pilferPointers(token);
+}
+
+} // namespace android::inputdispatcher
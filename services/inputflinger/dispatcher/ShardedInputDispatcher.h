@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_INPUTDISPATCHER_SHARDEDINPUTDISPATCHER_H
+#define _UI_INPUT_INPUTDISPATCHER_SHARDEDINPUTDISPATCHER_H
+
+#include "InputDispatcher.h"
+
+#include <android-base/thread_annotations.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace android::inputdispatcher {
+
+/**
+ * Splits dispatching between several InputDispatchers, each with its own thread and lock, that
+ * each serve a group of displays. Shard 0 serves every display that is not in any of the
+ * configured groups. A busy display can then no longer hold up dispatching to the displays of
+ * other groups.
+ *
+ * Events and window updates are routed to the shard of their display. Keys and other events
+ * without a display go to the shard of the focused display, which every shard is told about so
+ * that focus leaves a shard correctly. Each input channel is registered with exactly one shard:
+ * channels start out in shard 0 and move to the shard of the display their window is put on.
+ * Touch cannot be transferred between windows of different shards.
+ */
+class ShardedInputDispatcher : public android::InputDispatcherInterface {
+protected:
+    virtual ~ShardedInputDispatcher();
+
+public:
+    ShardedInputDispatcher(const sp<InputDispatcherPolicyInterface>& policy,
+                           const std::vector<std::vector<int32_t>>& displayGroups);
+
+    virtual void dump(std::string& dump) override;
+    virtual void monitor() override;
+    virtual bool waitForIdle() override;
+    virtual status_t start() override;
+    virtual status_t stop() override;
+
+    virtual void notifyConfigurationChanged(const NotifyConfigurationChangedArgs* args) override;
+    virtual void notifyKey(const NotifyKeyArgs* args) override;
+    virtual void notifyMotion(const NotifyMotionArgs* args) override;
+    virtual void notifySwitch(const NotifySwitchArgs* args) override;
+    virtual void notifyDeviceReset(const NotifyDeviceResetArgs* args) override;
+
+    virtual int32_t injectInputEvent(const InputEvent* event, int32_t injectorPid,
+                                     int32_t injectorUid, int32_t syncMode,
+                                     std::chrono::milliseconds timeout,
+                                     uint32_t policyFlags) override;
+
+    virtual std::unique_ptr<VerifiedInputEvent> verifyInputEvent(const InputEvent& event) override;
+
+    virtual void setInputWindows(
+            const std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>>&
+                    handlesPerDisplay) override;
+    virtual void setFocusedApplication(
+            int32_t displayId, const sp<InputApplicationHandle>& inputApplicationHandle) override;
+    virtual void setFocusedDisplay(int32_t displayId) override;
+    virtual void setInputDispatchMode(bool enabled, bool frozen) override;
+    virtual void setInputFilterEnabled(bool enabled) override;
+    virtual void setInTouchMode(bool inTouchMode) override;
+    virtual void invalidateKeyInterceptionVerdicts() override;
+
+    virtual bool transferTouchFocus(const sp<IBinder>& fromToken,
+                                    const sp<IBinder>& toToken) override;
+
+    virtual status_t registerInputChannel(const sp<InputChannel>& inputChannel) override;
+    virtual status_t registerInputMonitor(const sp<InputChannel>& inputChannel, int32_t displayId,
+                                          bool isGestureMonitor) override;
+    virtual status_t unregisterInputChannel(const sp<InputChannel>& inputChannel) override;
+    virtual status_t pilferPointers(const sp<IBinder>& token) override;
+
+private:
+    struct RegisteredChannel {
+        sp<InputChannel> inputChannel;
+        size_t shard;
+        bool monitor;
+    };
+
+    std::vector<sp<InputDispatcher>> mShards;
+    // The shard of each display that is not served by shard 0.
+    std::unordered_map<int32_t, size_t> mShardsByDisplay;
+
+    struct IBinderHash {
+        std::size_t operator()(const sp<IBinder>& b) const {
+            return std::hash<IBinder*>{}(b.get());
+        }
+    };
+
+    // Serializes routing decisions with the updates that change them.
+    std::mutex mLock;
+    int32_t mFocusedDisplayId GUARDED_BY(mLock);
+    std::unordered_map<sp<IBinder>, RegisteredChannel, IBinderHash> mChannelsByToken
+            GUARDED_BY(mLock);
+
+    size_t getShardForDisplay(int32_t displayId) const;
+    // Like getShardForDisplay, but events without a display belong to the focused display.
+    size_t getShardForEvent(int32_t displayId) EXCLUDES(mLock);
+    void moveChannelToShardLocked(RegisteredChannel& channel, size_t shard) REQUIRES(mLock);
+};
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_SHARDEDINPUTDISPATCHER_H
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SpatialIndex.h"
+
+#include <algorithm>
+
+namespace android::inputdispatcher {
+
+void SpatialIndex::insert(const Rect& bounds) {
+    mEntries.push_back({bounds, false});
+}
+
+void SpatialIndex::insertUnbounded() {
+    mEntries.push_back({Rect::EMPTY_RECT, true});
+}
+
+void SpatialIndex::clear() {
+    mEntries.clear();
+    mGridBounds = Rect::EMPTY_RECT;
+    mColumns = 0;
+    mRows = 0;
+    mCells.clear();
+    mUnbounded.clear();
+}
+
+void SpatialIndex::build() {
+    mGridBounds = Rect::EMPTY_RECT;
+    mCells.clear();
+    mUnbounded.clear();
+
+    size_t boundedCount = 0;
+    for (const Entry& entry : mEntries) {
+        if (!entry.unbounded && !entry.bounds.isEmpty()) {
+            if (boundedCount == 0) {
+                mGridBounds = entry.bounds;
+            } else {
+                mGridBounds.left = std::min(mGridBounds.left, entry.bounds.left);
+                mGridBounds.top = std::min(mGridBounds.top, entry.bounds.top);
+                mGridBounds.right = std::max(mGridBounds.right, entry.bounds.right);
+                mGridBounds.bottom = std::max(mGridBounds.bottom, entry.bounds.bottom);
+            }
+            boundedCount++;
+        }
+    }
+
+    // Aim for about one bounded entry per cell, so that a query only has to look at the few
+    // rects around the point.
+    size_t gridSize = 0;
+    while (gridSize < MAX_GRID_SIZE && gridSize * gridSize < boundedCount) {
+        gridSize++;
+    }
+    mColumns = gridSize;
+    mRows = gridSize;
+    if (gridSize != 0) {
+        const int64_t width = int64_t(mGridBounds.right) - mGridBounds.left;
+        const int64_t height = int64_t(mGridBounds.bottom) - mGridBounds.top;
+        mCellWidth = (width + gridSize - 1) / gridSize;
+        mCellHeight = (height + gridSize - 1) / gridSize;
+    }
+    mCells.resize(mColumns * mRows);
+
+    // Entries are visited in order, so every cell's list comes out sorted.
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        const Entry& entry = mEntries[i];
+        if (entry.unbounded) {
+            mUnbounded.push_back(i);
+            for (std::vector<size_t>& cell : mCells) {
+                cell.push_back(i);
+            }
+            continue;
+        }
+        if (entry.bounds.isEmpty()) {
+            continue;
+        }
+        // The rects are exclusive of their right and bottom edges.
+        const size_t left = (int64_t(entry.bounds.left) - mGridBounds.left) / mCellWidth;
+        const size_t top = (int64_t(entry.bounds.top) - mGridBounds.top) / mCellHeight;
+        const size_t right = (int64_t(entry.bounds.right) - 1 - mGridBounds.left) / mCellWidth;
+        const size_t bottom = (int64_t(entry.bounds.bottom) - 1 - mGridBounds.top) / mCellHeight;
+        for (size_t row = top; row <= bottom; row++) {
+            for (size_t column = left; column <= right; column++) {
+                mCells[row * mColumns + column].push_back(i);
+            }
+        }
+    }
+}
+
+const std::vector<size_t>& SpatialIndex::query(int32_t x, int32_t y) const {
+    if (x < mGridBounds.left || x >= mGridBounds.right || y < mGridBounds.top ||
+        y >= mGridBounds.bottom) {
+        return mUnbounded;
+    }
+    const size_t column = (int64_t(x) - mGridBounds.left) / mCellWidth;
+    const size_t row = (int64_t(y) - mGridBounds.top) / mCellHeight;
+    return mCells[row * mColumns + column];
+}
+
+} // namespace android::inputdispatcher
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_INPUTDISPATCHER_SPATIALINDEX_H
+#define _UI_INPUT_INPUTDISPATCHER_SPATIALINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ui/Rect.h>
+#include <vector>
+
+namespace android::inputdispatcher {
+
+/**
+ * A uniform grid over a list of rects, which finds the rects that may contain a point without
+ * testing every one of them.
+ *
+ * Entries are numbered in the order they are inserted, and a query returns the numbers of the
+ * candidate entries in that same order, so a list of windows inserted front to back can still be
+ * walked front to back. The candidates are a superset of the entries containing the point; the
+ * caller is expected to run its own exact test on each of them.
+ */
+class SpatialIndex {
+public:
+    // Upper bound on the number of cells along each side of the grid.
+    static constexpr size_t MAX_GRID_SIZE = 16;
+
+    // Append an entry covering the given bounds. An empty rect is never a candidate.
+    void insert(const Rect& bounds);
+    // Append an entry that is a candidate for every point.
+    void insertUnbounded();
+    void clear();
+
+    // Distribute the entries over the grid. Must be called after the last insert and before
+    // the next query.
+    void build();
+
+    // Return the entries that may contain the point, in insertion order.
+    const std::vector<size_t>& query(int32_t x, int32_t y) const;
+
+    size_t size() const { return mEntries.size(); }
+
+private:
+    struct Entry {
+        Rect bounds;
+        bool unbounded;
+    };
+    std::vector<Entry> mEntries;
+
+    // The union of the bounded entries, which the grid covers.
+    Rect mGridBounds;
+    size_t mColumns = 0;
+    size_t mRows = 0;
+    int64_t mCellWidth = 1;
+    int64_t mCellHeight = 1;
+    // Row-major, each holding the entries overlapping that cell plus the unbounded ones.
+    std::vector<std::vector<size_t>> mCells;
+    // The unbounded entries alone, for points outside of the grid.
+    std::vector<size_t> mUnbounded;
+};
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_SPATIALINDEX_H
@@ -35,8 +35,24 @@ struct InputDispatcherConfiguration {
     // The key repeat inter-key delay.
     nsecs_t keyRepeatDelay;
 
+    // The number of events a connection may have awaiting a finished signal before motion
+    // moves to it are held back, with each new move replacing the one still waiting to be
+    // published. Keeps one slow window from accumulating a backlog of stale moves.
+    // 0 disables merging.
+    size_t moveMergingWaitQueueDepth;
+
+    // Whether the dispatcher may reuse what interceptKeyBeforeDispatching decided for a key,
+    // instead of asking the policy again, for key repeats and gamepad buttons that are identical
+    // down to their flags, meta state, policy flags and focused window. The policy has to call
+    // InputDispatcherInterface::invalidateKeyInterceptionVerdicts whenever its decisions about
+    // such keys may change.
+    bool cacheKeyInterceptionVerdicts;
+
     InputDispatcherConfiguration()
-          : keyRepeatTimeout(500 * 1000000LL), keyRepeatDelay(50 * 1000000LL) {}
+          : keyRepeatTimeout(500 * 1000000LL),
+            keyRepeatDelay(50 * 1000000LL),
+            moveMergingWaitQueueDepth(0),
+            cacheKeyInterceptionVerdicts(false) {}
 };
 
 } // namespace android
@@ -143,6 +143,13 @@ public:
      */
     virtual void setInTouchMode(bool inTouchMode) = 0;
 
+    /* Forgets the interceptKeyBeforeDispatching results that were kept for reuse, see
+     * InputDispatcherConfiguration::cacheKeyInterceptionVerdicts.
+     *
+     * This method may be called on any thread (usually by the input manager).
+     */
+    virtual void invalidateKeyInterceptionVerdicts() = 0;
+
     /* Transfers touch focus from one window to another window.
      *
      * Returns true on success.  False if the window did not actually have touch focus.
@@ -31,6 +31,8 @@
 #include <sys/limits.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #define LOG_TAG "EventHub"
 
 // #define LOG_NDEBUG 0
@@ -73,6 +75,10 @@ static const char* DEVICE_PATH = "/dev/input";
 // v4l2 devices go directly into /dev
 static const char* VIDEO_DEVICE_PATH = "/dev";
 
+// The fewest events a ready device may read in one go when it shares the result buffer with
+// other ready devices. Enough for a full frame from a ten finger touch screen.
+static constexpr size_t MIN_FAIR_READ_EVENTS = 64;
+
 static inline const char* toString(bool value) {
     return value ? "true" : "false";
 }
@@ -192,6 +198,7 @@ EventHub::Device::Device(int fd, int32_t id, const std::string& path,
         ffEffectPlaying(false),
         ffEffectId(-1),
         controllerNumber(0),
+        usingClockIoctl(false),
         enabled(true),
         isVirtual(fd < 0) {
     memset(keyBitmask, 0, sizeof(keyBitmask));
@@ -735,7 +742,7 @@ void EventHub::assignDescriptorLocked(InputDeviceIdentifier& identifier) {
           identifier.descriptor.c_str());
 }
 
-void EventHub::vibrate(int32_t deviceId, nsecs_t duration) {
+void EventHub::vibrate(int32_t deviceId, nsecs_t delay, nsecs_t duration, int32_t repeatCount) {
     AutoMutex _l(mLock);
     Device* device = getDeviceLocked(deviceId);
     if (device && device->hasValidFd()) {
@@ -745,8 +752,10 @@ void EventHub::vibrate(int32_t deviceId, nsecs_t duration) {
         effect.id = device->ffEffectId;
         effect.u.rumble.strong_magnitude = 0xc000;
         effect.u.rumble.weak_magnitude = 0xc000;
+        // The kernel waits for the replay delay before playing the effect, and again before
+        // each repeat, so a whole on/off cycle runs without us.
         effect.replay.length = (duration + 999999LL) / 1000000LL;
-        effect.replay.delay = 0;
+        effect.replay.delay = (delay + 999999LL) / 1000000LL;
         if (ioctl(device->fd, EVIOCSFF, &effect)) {
             ALOGW("Could not upload force feedback effect to device %s due to error %d.",
                   device->identifier.name.c_str(), errno);
@@ -759,7 +768,7 @@ void EventHub::vibrate(int32_t deviceId, nsecs_t duration) {
         ev.time.tv_usec = 0;
         ev.type = EV_FF;
         ev.code = device->ffEffectId;
-        ev.value = 1;
+        ev.value = repeatCount;
         if (write(device->fd, &ev, sizeof(ev)) != sizeof(ev)) {
             ALOGW("Could not start force feedback effect on device %s due to error %d.",
                   device->identifier.name.c_str(), errno);
@@ -918,6 +927,8 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
 
         // Grab the next input event.
         bool deviceChanged = false;
+        int revisitFds[EPOLL_MAX_EVENTS];
+        size_t revisitCount = 0;
         while (mPendingEventIndex < mPendingEventCount) {
             const struct epoll_event& eventItem = mPendingEventItems[mPendingEventIndex++];
             if (eventItem.data.fd == mINotifyFd) {
@@ -974,41 +985,24 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             }
             // This must be an input event
             if (eventItem.events & EPOLLIN) {
-                int32_t readSize =
-                        read(device->fd, readBuffer, sizeof(struct input_event) * capacity);
-                if (readSize == 0 || (readSize < 0 && errno == ENODEV)) {
-                    // Device was removed before INotify noticed.
-                    ALOGW("could not get event, removed? (fd: %d size: %" PRId32
-                          " bufferSize: %zu capacity: %zu errno: %d)\n",
-                          device->fd, readSize, bufferSize, capacity, errno);
-                    deviceChanged = true;
-                    closeDeviceLocked(device);
-                } else if (readSize < 0) {
-                    if (errno != EAGAIN && errno != EINTR) {
-                        ALOGW("could not get event (errno=%d)", errno);
-                    }
-                } else if ((readSize % sizeof(struct input_event)) != 0) {
-                    ALOGE("could not get event (wrong size: %d)", readSize);
-                } else {
-                    int32_t deviceId = device->id == mBuiltInKeyboardId ? 0 : device->id;
-
-                    size_t count = size_t(readSize) / sizeof(struct input_event);
-                    for (size_t i = 0; i < count; i++) {
-                        struct input_event& iev = readBuffer[i];
-                        event->when = processEventTimestamp(iev);
-                        event->deviceId = deviceId;
-                        event->type = iev.type;
-                        event->code = iev.code;
-                        event->value = iev.value;
-                        event += 1;
-                        capacity -= 1;
-                    }
-                    if (capacity == 0) {
-                        // The result buffer is full.  Reset the pending event index
-                        // so we will try to read the device again on the next iteration.
-                        mPendingEventIndex -= 1;
-                        break;
-                    }
+                // When several devices are ready, don't let the first one fill the whole buffer
+                // and leave the others for another round trip through the reader. Whatever a
+                // device has left over once the others are read is picked up below.
+                const size_t devicesLeft = mPendingEventCount - mPendingEventIndex + 1;
+                const size_t fairShare =
+                        std::min(capacity, std::max(capacity / devicesLeft, MIN_FAIR_READ_EVENTS));
+                size_t count = readDeviceLocked(device, readBuffer, event, fairShare, now,
+                                                &deviceChanged);
+                event += count;
+                capacity -= count;
+                if (capacity == 0) {
+                    // The result buffer is full.  Reset the pending event index
+                    // so we will try to read the device again on the next iteration.
+                    mPendingEventIndex -= 1;
+                    break;
+                }
+                if (count == fairShare && revisitCount < size_t(EPOLL_MAX_EVENTS)) {
+                    revisitFds[revisitCount++] = device->fd;
                 }
             } else if (eventItem.events & EPOLLHUP) {
                 ALOGI("Removing device %s due to epoll hang-up event.",
@@ -1021,6 +1015,21 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             }
         }
 
+        // Finish reading devices that were held to their share above, while there is room. If
+        // they still have more, epoll reports them again right away.
+        for (size_t i = 0; i < revisitCount && capacity > 0; i++) {
+            Device* device = getDeviceByFdLocked(revisitFds[i]);
+            if (device) {
+                size_t count =
+                        readDeviceLocked(device, readBuffer, event, capacity, now, &deviceChanged);
+                event += count;
+                capacity -= count;
+            }
+        }
+        if (capacity == 0) {
+            break;
+        }
+
         // readNotify() will modify the list of devices so this must be done after
         // processing all other events to ensure that we read all remaining events
         // before closing the devices.
@@ -1085,6 +1094,50 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
     return event - buffer;
 }
 
+/**
+ * Read up to maxEvents of the events queued by the device into the buffer, and return how many
+ * were read. A device that turns out to be gone is closed and *outDeviceChanged is set.
+ */
+size_t EventHub::readDeviceLocked(Device* device, struct input_event* readBuffer,
+                                  RawEvent* buffer, size_t maxEvents, nsecs_t now,
+                                  bool* outDeviceChanged) {
+    int32_t readSize = read(device->fd, readBuffer, sizeof(struct input_event) * maxEvents);
+    if (readSize == 0 || (readSize < 0 && errno == ENODEV)) {
+        // Device was removed before INotify noticed.
+        ALOGW("could not get event, removed? (fd: %d size: %" PRId32
+              " maxEvents: %zu errno: %d)\n",
+              device->fd, readSize, maxEvents, errno);
+        *outDeviceChanged = true;
+        closeDeviceLocked(device);
+        return 0;
+    }
+    if (readSize < 0) {
+        if (errno != EAGAIN && errno != EINTR) {
+            ALOGW("could not get event (errno=%d)", errno);
+        }
+        return 0;
+    }
+    if ((readSize % sizeof(struct input_event)) != 0) {
+        ALOGE("could not get event (wrong size: %d)", readSize);
+        return 0;
+    }
+
+    int32_t deviceId = device->id == mBuiltInKeyboardId ? 0 : device->id;
+    size_t count = size_t(readSize) / sizeof(struct input_event);
+    for (size_t i = 0; i < count; i++) {
+        const struct input_event& iev = readBuffer[i];
+        RawEvent* event = &buffer[i];
+        // Without the clock ioctl, the kernel stamps events with the realtime clock, which
+        // can't be compared with anything else in the input system.
+        event->when = device->usingClockIoctl ? processEventTimestamp(iev) : now;
+        event->deviceId = deviceId;
+        event->type = iev.type;
+        event->code = iev.code;
+        event->value = iev.value;
+    }
+    return count;
+}
+
 std::vector<TouchVideoFrame> EventHub::getVideoFrames(int32_t deviceId) {
     AutoMutex _l(mLock);
 
@@ -1516,8 +1569,8 @@ void EventHub::configureFd(Device* device) {
     // uses the timestamps extensively and assumes they were recorded using the monotonic
     // clock.
     int clockId = CLOCK_MONOTONIC;
-    bool usingClockIoctl = !ioctl(device->fd, EVIOCSCLOCKID, &clockId);
-    ALOGI("usingClockIoctl=%s", toString(usingClockIoctl));
+    device->usingClockIoctl = !ioctl(device->fd, EVIOCSCLOCKID, &clockId);
+    ALOGI("usingClockIoctl=%s", toString(device->usingClockIoctl));
 }
 
 void EventHub::openVideoDeviceLocked(const std::string& devicePath) {
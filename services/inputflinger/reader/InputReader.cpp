@@ -105,6 +105,7 @@ void InputReader::loopOnce() {
     } // release lock
 
     size_t count = mEventHub->getEvents(timeoutMillis, mEventBuffer, EVENT_BUFFER_SIZE);
+    const nsecs_t readTime = systemTime(SYSTEM_TIME_MONOTONIC);
 
     { // acquire lock
         AutoMutex _l(mLock);
@@ -112,6 +113,7 @@ void InputReader::loopOnce() {
 
         if (count) {
             processEventsLocked(mEventBuffer, count);
+            recordLatencyLocked(mEventBuffer, count, readTime);
         }
 
         if (mNextTimeout != LLONG_MAX) {
@@ -146,6 +148,28 @@ void InputReader::loopOnce() {
     mQueuedListener->flush();
 }
 
+void InputReader::recordLatencyLocked(const RawEvent* rawEvents, size_t count, nsecs_t readTime) {
+    // Both are reset together, so checking one is enough.
+    if (mReadLatencyStatistics.shouldReport()) {
+        mReadLatencyStatistics.reset();
+        mProcessLatencyStatistics.reset();
+    }
+
+    bool sawReport = false;
+    for (size_t i = 0; i < count; i++) {
+        const RawEvent& rawEvent = rawEvents[i];
+        // One sample per input frame. Synthetic events carry the time they were generated.
+        if (rawEvent.type == EV_SYN && rawEvent.code == SYN_REPORT) {
+            mReadLatencyStatistics.addValue(nanoseconds_to_microseconds(readTime - rawEvent.when));
+            sawReport = true;
+        }
+    }
+    if (sawReport) {
+        const nsecs_t processTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        mProcessLatencyStatistics.addValue(nanoseconds_to_microseconds(processTime - readTime));
+    }
+}
+
 void InputReader::processEventsLocked(const RawEvent* rawEvents, size_t count) {
     for (const RawEvent* rawEvent = rawEvents; count;) {
         int32_t type = rawEvent->type;
@@ -652,6 +676,11 @@ void InputReader::dump(std::string& dump) {
         device->dump(dump, eventHubDevStr);
     }
 
+    dump += INDENT "Latency (us):\n";
+    dump += StringPrintf(INDENT2 "KernelToRead: %s\n", mReadLatencyStatistics.dump().c_str());
+    dump += StringPrintf(INDENT2 "ReadToProcessed: %s\n",
+                         mProcessLatencyStatistics.dump().c_str());
+
     dump += INDENT "Configuration:\n";
     dump += INDENT2 "ExcludedDeviceNames: [";
     for (size_t i = 0; i < mConfig.excludedDeviceNames.size(); i++) {
@@ -230,8 +230,11 @@ public:
     virtual sp<KeyCharacterMap> getKeyCharacterMap(int32_t deviceId) const = 0;
     virtual bool setKeyboardLayoutOverlay(int32_t deviceId, const sp<KeyCharacterMap>& map) = 0;
 
-    /* Control the vibrator. */
-    virtual void vibrate(int32_t deviceId, nsecs_t duration) = 0;
+    /* Control the vibrator.
+     * vibrate() turns the vibrator on for duration after waiting for delay, and does so
+     * repeatCount times in a row without further calls. */
+    virtual void vibrate(int32_t deviceId, nsecs_t delay, nsecs_t duration,
+                         int32_t repeatCount) = 0;
     virtual void cancelVibrate(int32_t deviceId) = 0;
 
     /* Requests the EventHub to reopen all input devices on the next call to getEvents(). */
@@ -307,7 +310,8 @@ public:
     virtual bool setKeyboardLayoutOverlay(int32_t deviceId,
                                           const sp<KeyCharacterMap>& map) override;
 
-    virtual void vibrate(int32_t deviceId, nsecs_t duration) override;
+    virtual void vibrate(int32_t deviceId, nsecs_t delay, nsecs_t duration,
+                         int32_t repeatCount) override;
     virtual void cancelVibrate(int32_t deviceId) override;
 
     virtual void requestReopenDevices() override;
@@ -353,6 +357,9 @@ private:
 
         int32_t controllerNumber;
 
+        // Whether the kernel agreed to timestamp this device's events with CLOCK_MONOTONIC.
+        bool usingClockIoctl;
+
         Device(int fd, int32_t id, const std::string& path,
                const InputDeviceIdentifier& identifier);
         ~Device();
@@ -400,6 +407,8 @@ private:
     status_t scanVideoDirLocked(const std::string& dirname);
     void scanDevicesLocked();
     status_t readNotifyLocked();
+    size_t readDeviceLocked(Device* device, struct input_event* readBuffer, RawEvent* buffer,
+                            size_t maxEvents, nsecs_t now, bool* outDeviceChanged);
 
     Device* getDeviceByDescriptorLocked(const std::string& descriptor) const;
     Device* getDeviceLocked(int32_t deviceId) const;
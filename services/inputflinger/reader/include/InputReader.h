@@ -24,6 +24,7 @@
 #include "InputThread.h"
 
 #include <PointerControllerInterface.h>
+#include <input/LatencyStatistics.h>
 #include <utils/Condition.h>
 #include <utils/Mutex.h>
 
@@ -137,6 +138,15 @@ private:
     static const int EVENT_BUFFER_SIZE = 256;
     RawEvent mEventBuffer[EVENT_BUFFER_SIZE];
 
+    // Reader side of the touch latency breakdown, in microseconds. The dispatcher tracks the
+    // rest, from the kernel timestamp to the app finishing the event.
+    static constexpr std::chrono::duration LATENCY_STATS_RESET_PERIOD = 5min;
+    // From the kernel timestamp of each SYN_REPORT to getEvents returning it.
+    LatencyStatistics mReadLatencyStatistics{LATENCY_STATS_RESET_PERIOD};
+    // From getEvents returning to the batch being processed into notify args.
+    LatencyStatistics mProcessLatencyStatistics{LATENCY_STATS_RESET_PERIOD};
+    void recordLatencyLocked(const RawEvent* rawEvents, size_t count, nsecs_t readTime);
+
     // An input device can represent a collection of EventHub devices. This map provides a way
     // to lookup the input device instance from the EventHub device id.
     std::unordered_map<int32_t /*eventHubId*/, std::shared_ptr<InputDevice>> mDevices;
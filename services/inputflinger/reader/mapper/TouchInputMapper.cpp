@@ -1354,6 +1354,7 @@ void TouchInputMapper::dumpAffineTransformation(std::string& dump) {
 void TouchInputMapper::updateAffineTransformation() {
     mAffineTransform = getPolicy()->getTouchAffineTransformation(getDeviceContext().getDescriptor(),
                                                                  mSurfaceOrientation);
+    updateRawToSurfaceTransform();
 }
 
 void TouchInputMapper::reset(nsecs_t when) {
@@ -2031,8 +2032,23 @@ void TouchInputMapper::cookPointerData() {
         mCurrentCookedState.buttonState = mCurrentRawState.buttonState;
     }
 
-    // Walk through the the active pointers and map device coordinates onto
-    // surface coordinates and adjust for display orientation.
+    // Map device coordinates onto surface coordinates, adjusted for device calibration and
+    // display orientation, for all pointers at once. This is the part that runs for every
+    // pointer of every frame no matter the calibration, so it is kept free of branches.
+    // TODO: Adjust coverage coords?
+    float xTransformed[MAX_POINTERS];
+    float yTransformed[MAX_POINTERS];
+    const TouchAffineTransformation& transform = mRawToSurfaceTransform;
+    for (uint32_t i = 0; i < currentPointerCount; i++) {
+        const float x = mCurrentRawState.rawPointerData.pointers[i].x;
+        const float y = mCurrentRawState.rawPointerData.pointers[i].y;
+        xTransformed[i] = x * transform.x_scale + y * transform.x_ymix + transform.x_offset;
+        yTransformed[i] = x * transform.y_xmix + y * transform.y_scale + transform.y_offset;
+    }
+
+    const uint32_t touchingCount = mCurrentRawState.rawPointerData.touchingIdBits.count();
+
+    // Walk through the the active pointers and cook the remaining axes.
     for (uint32_t i = 0; i < currentPointerCount; i++) {
         const RawPointerData::Pointer& in = mCurrentRawState.rawPointerData.pointers[i];
 
@@ -2074,7 +2090,6 @@ void TouchInputMapper::cookPointerData() {
                 }
 
                 if (mCalibration.haveSizeIsSummed && mCalibration.sizeIsSummed) {
-                    uint32_t touchingCount = mCurrentRawState.rawPointerData.touchingIdBits.count();
                     if (touchingCount > 1) {
                         touchMajor /= touchingCount;
                         touchMinor /= touchingCount;
@@ -2186,12 +2201,6 @@ void TouchInputMapper::cookPointerData() {
                 break;
         }
 
-        // Adjust X,Y coords for device calibration
-        // TODO: Adjust coverage coords?
-        float xTransformed = in.x, yTransformed = in.y;
-        mAffineTransform.applyTo(xTransformed, yTransformed);
-        rotateAndScale(xTransformed, yTransformed);
-
         // Adjust X, Y, and coverage coords for surface orientation.
         float left, top, right, bottom;
 
@@ -2240,26 +2249,30 @@ void TouchInputMapper::cookPointerData() {
                 break;
         }
 
-        // Write output coords.
+        // Write output coords. Axes are set in increasing order, so that each one is appended
+        // to the values instead of shifting the ones already there.
+        const bool haveCoverage =
+                mCalibration.coverageCalibration == Calibration::COVERAGE_CALIBRATION_BOX;
         PointerCoords& out = mCurrentCookedState.cookedPointerData.pointerCoords[i];
         out.clear();
-        out.setAxisValue(AMOTION_EVENT_AXIS_X, xTransformed);
-        out.setAxisValue(AMOTION_EVENT_AXIS_Y, yTransformed);
+        out.setAxisValue(AMOTION_EVENT_AXIS_X, xTransformed[i]);
+        out.setAxisValue(AMOTION_EVENT_AXIS_Y, yTransformed[i]);
         out.setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, pressure);
         out.setAxisValue(AMOTION_EVENT_AXIS_SIZE, size);
         out.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MAJOR, touchMajor);
         out.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MINOR, touchMinor);
+        if (!haveCoverage) {
+            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MAJOR, toolMajor);
+            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MINOR, toolMinor);
+        }
         out.setAxisValue(AMOTION_EVENT_AXIS_ORIENTATION, orientation);
-        out.setAxisValue(AMOTION_EVENT_AXIS_TILT, tilt);
         out.setAxisValue(AMOTION_EVENT_AXIS_DISTANCE, distance);
-        if (mCalibration.coverageCalibration == Calibration::COVERAGE_CALIBRATION_BOX) {
+        out.setAxisValue(AMOTION_EVENT_AXIS_TILT, tilt);
+        if (haveCoverage) {
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_1, left);
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_2, top);
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_3, right);
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_4, bottom);
-        } else {
-            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MAJOR, toolMajor);
-            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MINOR, toolMinor);
         }
 
         // Write output properties.
@@ -3536,14 +3549,14 @@ void TouchInputMapper::dispatchMotion(nsecs_t when, uint32_t policyFlags, uint32
                                       const PointerCoords* coords, const uint32_t* idToIndex,
                                       BitSet32 idBits, int32_t changedId, float xPrecision,
                                       float yPrecision, nsecs_t downTime) {
-    PointerCoords pointerCoords[MAX_POINTERS];
-    PointerProperties pointerProperties[MAX_POINTERS];
+    uint32_t indices[MAX_POINTERS];
     uint32_t pointerCount = 0;
+    bool inOrder = true;
     while (!idBits.isEmpty()) {
         uint32_t id = idBits.clearFirstMarkedBit();
         uint32_t index = idToIndex[id];
-        pointerProperties[pointerCount].copyFrom(properties[index]);
-        pointerCoords[pointerCount].copyFrom(coords[index]);
+        indices[pointerCount] = index;
+        inOrder &= index == pointerCount;
 
         if (changedId >= 0 && id == uint32_t(changedId)) {
             action |= pointerCount << AMOTION_EVENT_ACTION_POINTER_INDEX_SHIFT;
@@ -3552,6 +3565,19 @@ void TouchInputMapper::dispatchMotion(nsecs_t when, uint32_t policyFlags, uint32
         pointerCount += 1;
     }
 
+    // Usually the pointers to dispatch are the first ones stored, in id order, so the arrays
+    // can be passed on as they are. Otherwise gather them in the order they are dispatched.
+    PointerCoords pointerCoords[MAX_POINTERS];
+    PointerProperties pointerProperties[MAX_POINTERS];
+    if (!inOrder) {
+        for (uint32_t i = 0; i < pointerCount; i++) {
+            pointerProperties[i].copyFrom(properties[indices[i]]);
+            pointerCoords[i].copyFrom(coords[indices[i]]);
+        }
+        properties = pointerProperties;
+        coords = pointerCoords;
+    }
+
     ALOG_ASSERT(pointerCount != 0);
 
     if (changedId >= 0 && pointerCount == 1) {
@@ -3579,9 +3605,9 @@ void TouchInputMapper::dispatchMotion(nsecs_t when, uint32_t policyFlags, uint32
                   [this](TouchVideoFrame& frame) { frame.rotate(this->mSurfaceOrientation); });
     NotifyMotionArgs args(getContext()->getNextId(), when, deviceId, source, displayId, policyFlags,
                           action, actionButton, flags, metaState, buttonState,
-                          MotionClassification::NONE, edgeFlags, pointerCount, pointerProperties,
-                          pointerCoords, xPrecision, yPrecision, xCursorPosition, yCursorPosition,
-                          downTime, std::move(frames));
+                          MotionClassification::NONE, edgeFlags, pointerCount, properties, coords,
+                          xPrecision, yPrecision, xCursorPosition, yCursorPosition, downTime,
+                          std::move(frames));
     getListener()->notifyMotion(&args);
 }
 
@@ -3620,36 +3646,40 @@ void TouchInputMapper::cancelTouch(nsecs_t when) {
     abortTouches(when, 0 /* policyFlags*/);
 }
 
-// Transform raw coordinate to surface coordinate
-void TouchInputMapper::rotateAndScale(float& x, float& y) {
-    // Scale to surface coordinate.
-    const float xScaled = float(x - mRawPointerAxes.x.minValue) * mXScale;
-    const float yScaled = float(y - mRawPointerAxes.y.minValue) * mYScale;
+// Combine the calibration with the transform from raw to surface coordinates.
+void TouchInputMapper::updateRawToSurfaceTransform() {
+    // Scale to surface coordinate, after applying the calibration.
+    const TouchAffineTransformation& calibration = mAffineTransform;
+    const float xScaled[] = {mXScale * calibration.x_scale, mXScale * calibration.x_ymix,
+                             mXScale * (calibration.x_offset - mRawPointerAxes.x.minValue)};
+    const float yScaled[] = {mYScale * calibration.y_xmix, mYScale * calibration.y_scale,
+                             mYScale * (calibration.y_offset - mRawPointerAxes.y.minValue)};
 
     // Rotate to surface coordinate.
     // 0 - no swap and reverse.
     // 90 - swap x/y and reverse y.
     // 180 - reverse x, y.
     // 270 - swap x/y and reverse x.
+    auto setTransform = [this](const float* xRow, float xSign, float xTranslate,
+                               const float* yRow, float ySign, float yTranslate) {
+        mRawToSurfaceTransform =
+                TouchAffineTransformation(xSign * xRow[0], xSign * xRow[1],
+                                          xSign * xRow[2] + xTranslate, ySign * yRow[0],
+                                          ySign * yRow[1], ySign * yRow[2] + yTranslate);
+    };
     switch (mSurfaceOrientation) {
-        case DISPLAY_ORIENTATION_0:
-            x = xScaled + mXTranslate;
-            y = yScaled + mYTranslate;
-            break;
         case DISPLAY_ORIENTATION_90:
-            y = mSurfaceRight - xScaled;
-            x = yScaled + mYTranslate;
+            setTransform(yScaled, 1, mYTranslate, xScaled, -1, mSurfaceRight);
             break;
         case DISPLAY_ORIENTATION_180:
-            x = mSurfaceRight - xScaled;
-            y = mSurfaceBottom - yScaled;
+            setTransform(xScaled, -1, mSurfaceRight, yScaled, -1, mSurfaceBottom);
             break;
         case DISPLAY_ORIENTATION_270:
-            y = xScaled + mXTranslate;
-            x = mSurfaceBottom - yScaled;
+            setTransform(yScaled, -1, mSurfaceBottom, xScaled, 1, mXTranslate);
             break;
         default:
-            assert(false);
+            setTransform(xScaled, 1, mXTranslate, yScaled, 1, mYTranslate);
+            break;
     }
 }
 
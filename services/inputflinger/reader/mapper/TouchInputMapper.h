@@ -292,6 +292,10 @@ protected:
     // Affine location transformation/calibration
     struct TouchAffineTransformation mAffineTransform;
 
+    // mAffineTransform followed by the scaling, rotation and translation into surface
+    // coordinates, so that a raw position is cooked with one multiply-add per coordinate.
+    struct TouchAffineTransformation mRawToSurfaceTransform;
+
     RawPointerAxes mRawPointerAxes;
 
     struct RawState {
@@ -761,7 +765,7 @@ private:
     static void assignPointerIds(const RawState& last, RawState& current);
 
     const char* modeToString(DeviceMode deviceMode);
-    void rotateAndScale(float& x, float& y);
+    void updateRawToSurfaceTransform();
 };
 
 } // namespace android
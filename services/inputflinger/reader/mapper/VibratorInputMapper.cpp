@@ -18,10 +18,19 @@
 
 #include "VibratorInputMapper.h"
 
+#include <algorithm>
+
 namespace android {
 
+// The longest delay or duration of a force feedback effect, which the kernel keeps in
+// milliseconds in 16 bits.
+static constexpr nsecs_t MAX_SEGMENT_TIME = ms2ns(0xffff);
+
+// The repeat count that keeps a looping segment playing until it is cancelled.
+static constexpr int32_t REPEAT_FOREVER = INT32_MAX;
+
 VibratorInputMapper::VibratorInputMapper(InputDeviceContext& deviceContext)
-      : InputMapper(deviceContext), mVibrating(false) {}
+      : InputMapper(deviceContext), mVibrating(false), mRepeatingInKernel(false) {}
 
 VibratorInputMapper::~VibratorInputMapper() {}
 
@@ -53,16 +62,66 @@ void VibratorInputMapper::vibrate(const nsecs_t* pattern, size_t patternSize, ss
           patternStr.c_str(), repeat, token);
 #endif
 
+    mSegments.clear();
+    mRepeatSegment.reset();
+    if (repeat >= 0 && size_t(repeat) < patternSize) {
+        compile(pattern, 0, repeat);
+        // A loop that never turns the vibrator on would spin, so it is dropped.
+        const size_t repeatSegment = mSegments.size();
+        compile(pattern, repeat, patternSize);
+        if (std::any_of(mSegments.begin() + repeatSegment, mSegments.end(),
+                        [](const Segment& segment) { return segment.duration > 0; })) {
+            mRepeatSegment = repeatSegment;
+        } else {
+            mSegments.resize(repeatSegment);
+        }
+    } else {
+        compile(pattern, 0, patternSize);
+    }
+
     mVibrating = true;
-    memcpy(mPattern, pattern, patternSize * sizeof(nsecs_t));
-    mPatternSize = patternSize;
-    mRepeat = repeat;
+    mRepeatingInKernel = false;
     mToken = token;
-    mIndex = -1;
+    mSegmentIndex = 0;
 
     nextStep();
 }
 
+void VibratorInputMapper::compile(const nsecs_t* pattern, size_t begin, size_t end) {
+    // Even elements of the pattern are off times and odd ones are on times. On times that
+    // are only separated by an empty off time are played as one, and so are off times.
+    nsecs_t delay = 0;
+    nsecs_t duration = 0;
+    for (size_t i = begin; i < end; i++) {
+        const nsecs_t time = std::max(pattern[i], nsecs_t(0));
+        if (i & 1) {
+            duration += time;
+        } else if (duration == 0) {
+            delay += time;
+        } else if (time > 0) {
+            appendSegment(delay, duration);
+            delay = time;
+            duration = 0;
+        }
+    }
+    if (delay > 0 || duration > 0) {
+        appendSegment(delay, duration);
+    }
+}
+
+void VibratorInputMapper::appendSegment(nsecs_t delay, nsecs_t duration) {
+    while (delay > MAX_SEGMENT_TIME) {
+        mSegments.push_back({MAX_SEGMENT_TIME, 0});
+        delay -= MAX_SEGMENT_TIME;
+    }
+    while (duration > MAX_SEGMENT_TIME) {
+        mSegments.push_back({delay, MAX_SEGMENT_TIME});
+        delay = 0;
+        duration -= MAX_SEGMENT_TIME;
+    }
+    mSegments.push_back({delay, duration});
+}
+
 void VibratorInputMapper::cancelVibrate(int32_t token) {
 #if DEBUG_VIBRATOR
     ALOGD("cancelVibrate: deviceId=%d, token=%d", getDeviceId(), token);
@@ -74,7 +133,7 @@ void VibratorInputMapper::cancelVibrate(int32_t token) {
 }
 
 void VibratorInputMapper::timeoutExpired(nsecs_t when) {
-    if (mVibrating) {
+    if (mVibrating && !mRepeatingInKernel) {
         if (when >= mNextStepTime) {
             nextStep();
         } else {
@@ -84,39 +143,48 @@ void VibratorInputMapper::timeoutExpired(nsecs_t when) {
 }
 
 void VibratorInputMapper::nextStep() {
-    mIndex += 1;
-    if (size_t(mIndex) >= mPatternSize) {
-        if (mRepeat < 0) {
+    if (mSegmentIndex >= mSegments.size()) {
+        if (!mRepeatSegment) {
             // We are done.
             stopVibrating();
             return;
         }
-        mIndex = mRepeat;
+        mSegmentIndex = *mRepeatSegment;
     }
 
-    bool vibratorOn = mIndex & 1;
-    nsecs_t duration = mPattern[mIndex];
-    if (vibratorOn) {
+    const Segment& segment = mSegments[mSegmentIndex];
+    if (mRepeatSegment == mSegmentIndex && mSegmentIndex + 1 == mSegments.size()) {
+        // The loop is a single segment, which the kernel can repeat without us.
 #if DEBUG_VIBRATOR
-        ALOGD("nextStep: sending vibrate deviceId=%d, duration=%" PRId64, getDeviceId(), duration);
+        ALOGD("nextStep: sending repeating vibrate deviceId=%d, delay=%" PRId64
+              ", duration=%" PRId64,
+              getDeviceId(), segment.delay, segment.duration);
 #endif
-        getDeviceContext().vibrate(duration);
-    } else {
+        getDeviceContext().vibrate(segment.delay, segment.duration, REPEAT_FOREVER);
+        mRepeatingInKernel = true;
+        return;
+    }
+    mSegmentIndex += 1;
+
+    if (segment.duration > 0) {
 #if DEBUG_VIBRATOR
-        ALOGD("nextStep: sending cancel vibrate deviceId=%d", getDeviceId());
+        ALOGD("nextStep: sending vibrate deviceId=%d, delay=%" PRId64 ", duration=%" PRId64,
+              getDeviceId(), segment.delay, segment.duration);
 #endif
-        getDeviceContext().cancelVibrate();
+        getDeviceContext().vibrate(segment.delay, segment.duration, 1);
     }
     nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
-    mNextStepTime = now + duration;
+    mNextStepTime = now + segment.delay + segment.duration;
     getContext()->requestTimeoutAtTime(mNextStepTime);
 #if DEBUG_VIBRATOR
-    ALOGD("nextStep: scheduled timeout in %0.3fms", duration * 0.000001f);
+    ALOGD("nextStep: scheduled timeout in %0.3fms",
+          (segment.delay + segment.duration) * 0.000001f);
 #endif
 }
 
 void VibratorInputMapper::stopVibrating() {
     mVibrating = false;
+    mRepeatingInKernel = false;
 #if DEBUG_VIBRATOR
     ALOGD("stopVibrating: sending cancel vibrate deviceId=%d", getDeviceId());
 #endif
@@ -126,6 +194,8 @@ void VibratorInputMapper::stopVibrating() {
 void VibratorInputMapper::dump(std::string& dump) {
     dump += INDENT2 "Vibrator Input Mapper:\n";
     dump += StringPrintf(INDENT3 "Vibrating: %s\n", toString(mVibrating));
+    dump += StringPrintf(INDENT3 "Segments: %zu\n", mSegments.size());
+    dump += StringPrintf(INDENT3 "RepeatingInKernel: %s\n", toString(mRepeatingInKernel));
 }
 
 } // namespace android
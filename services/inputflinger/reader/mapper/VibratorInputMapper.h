@@ -19,6 +19,9 @@
 
 #include "InputMapper.h"
 
+#include <optional>
+#include <vector>
+
 namespace android {
 
 class VibratorInputMapper : public InputMapper {
@@ -37,14 +40,25 @@ public:
     virtual void dump(std::string& dump) override;
 
 private:
+    // An off time followed by an on time, which the kernel plays as a single force feedback
+    // effect, so that the reader only wakes up once per pair rather than at every edge.
+    struct Segment {
+        nsecs_t delay;
+        nsecs_t duration;
+    };
+
     bool mVibrating;
-    nsecs_t mPattern[MAX_VIBRATE_PATTERN_SIZE];
-    size_t mPatternSize;
-    ssize_t mRepeat;
+    // The pattern compiled into segments, and the segment it repeats from, if it does.
+    std::vector<Segment> mSegments;
+    std::optional<size_t> mRepeatSegment;
     int32_t mToken;
-    ssize_t mIndex;
+    size_t mSegmentIndex;
     nsecs_t mNextStepTime;
+    // Whether the kernel is repeating the last segment by itself until cancelled.
+    bool mRepeatingInKernel;
 
+    void compile(const nsecs_t* pattern, size_t begin, size_t end);
+    void appendSegment(nsecs_t delay, nsecs_t duration);
     void nextStep();
     void stopVibrating();
 };
@@ -21,6 +21,9 @@
 
 #include <android/hardware/input/classifier/1.0/IInputClassifier.h>
 
+#include <chrono>
+#include <thread>
+
 using namespace android::hardware::input;
 using android::hardware::Return;
 using android::hardware::Void;
@@ -169,6 +172,26 @@ struct TestHal : public android::hardware::input::classifier::V1_0::IInputClassi
     Return<void> resetDevice(int32_t deviceId) override { return Void(); };
 };
 
+/**
+ * An IInputClassifier that takes a while to classify each event.
+ */
+struct SlowTestHal : public android::hardware::input::classifier::V1_0::IInputClassifier {
+    SlowTestHal(Classification classification, std::chrono::nanoseconds delay)
+          : mClassification(classification), mDelay(delay) {}
+
+    Return<Classification> classify(
+            const android::hardware::input::common::V1_0::MotionEvent& event) override {
+        std::this_thread::sleep_for(mDelay);
+        return mClassification;
+    };
+    Return<void> reset() override { return Void(); };
+    Return<void> resetDevice(int32_t deviceId) override { return Void(); };
+
+private:
+    const Classification mClassification;
+    const std::chrono::nanoseconds mDelay;
+};
+
 /**
  * An entity that will be subscribed to the HAL death.
  */
@@ -194,6 +217,14 @@ protected:
                     std::unique_ptr<MotionClassifier>(new MotionClassifier(new TestHal()));
         }
     }
+
+    static std::unique_ptr<MotionClassifierInterface> createMotionClassifier(
+            sp<android::hardware::input::classifier::V1_0::IInputClassifier> service,
+            std::chrono::nanoseconds classificationBudget) {
+        // Using 'new' to access non-public constructor
+        return std::unique_ptr<MotionClassifier>(
+                new MotionClassifier(service, classificationBudget));
+    }
 };
 
 /**
@@ -257,6 +288,33 @@ TEST_F(MotionClassifierTest, Classify_TwoVideoFrames) {
     ASSERT_NO_FATAL_FAILURE(mMotionClassifier->classify(motionArgs));
 }
 
+/**
+ * With a budget, an event gets the classification of the HAL if the HAL answers in time.
+ */
+TEST_F(MotionClassifierTest, Classify_WithinBudget_GetsHalClassification) {
+    mMotionClassifier =
+            createMotionClassifier(new SlowTestHal(Classification::DEEP_PRESS,
+                                                   std::chrono::milliseconds(0)),
+                                   std::chrono::seconds(5));
+
+    ASSERT_EQ(MotionClassification::DEEP_PRESS,
+              mMotionClassifier->classify(generateBasicMotionArgs()));
+}
+
+/**
+ * A HAL that is slower than the budget should not hold the event back for longer than that.
+ */
+TEST_F(MotionClassifierTest, Classify_SlowHal_DoesNotWaitPastBudget) {
+    mMotionClassifier =
+            createMotionClassifier(new SlowTestHal(Classification::DEEP_PRESS,
+                                                   std::chrono::milliseconds(500)),
+                                   std::chrono::milliseconds(10));
+
+    const auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(MotionClassification::NONE, mMotionClassifier->classify(generateBasicMotionArgs()));
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(400));
+}
+
 /**
  * Make sure MotionClassifier does not crash when it is reset.
  */
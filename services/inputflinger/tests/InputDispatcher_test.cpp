@@ -15,6 +15,7 @@
  */
 
 #include "../dispatcher/InputDispatcher.h"
+#include "../dispatcher/ShardedInputDispatcher.h"
 
 #include <android-base/stringprintf.h>
 #include <android-base/thread_annotations.h>
@@ -178,6 +179,15 @@ public:
         mConfig.keyRepeatDelay = delay;
     }
 
+    void setMoveMergingWaitQueueDepth(size_t depth) { mConfig.moveMergingWaitQueueDepth = depth; }
+
+    void setCacheKeyInterceptionVerdicts(bool cache) { mConfig.cacheKeyInterceptionVerdicts = cache; }
+
+    size_t getInterceptKeyBeforeDispatchingCount() {
+        std::scoped_lock lock(mLock);
+        return mInterceptKeyBeforeDispatchingCount;
+    }
+
     void setAnrTimeout(std::chrono::nanoseconds timeout) { mAnrTimeout = timeout; }
 
 private:
@@ -186,6 +196,7 @@ private:
     std::optional<nsecs_t> mConfigurationChangedTime GUARDED_BY(mLock);
     sp<IBinder> mOnPointerDownToken GUARDED_BY(mLock);
     std::optional<NotifySwitchArgs> mLastNotifySwitch GUARDED_BY(mLock);
+    size_t mInterceptKeyBeforeDispatchingCount GUARDED_BY(mLock) = 0;
 
     // ANR handling
     std::queue<sp<InputApplicationHandle>> mAnrApplications GUARDED_BY(mLock);
@@ -239,6 +250,8 @@ private:
 
     virtual nsecs_t interceptKeyBeforeDispatching(const sp<IBinder>&, const KeyEvent*,
                                                   uint32_t) override {
+        std::scoped_lock lock(mLock);
+        mInterceptKeyBeforeDispatchingCount++;
         return 0;
     }
 
@@ -748,7 +761,7 @@ public:
     static const int32_t HEIGHT = 800;
 
     FakeWindowHandle(const sp<InputApplicationHandle>& inputApplicationHandle,
-                     const sp<InputDispatcher>& dispatcher, const std::string name,
+                     const sp<InputDispatcherInterface>& dispatcher, const std::string name,
                      int32_t displayId, sp<IBinder> token = nullptr)
           : mName(name) {
         if (token == nullptr) {
@@ -910,8 +923,8 @@ private:
 
 std::atomic<int32_t> FakeWindowHandle::sId{1};
 
-static int32_t injectKey(const sp<InputDispatcher>& dispatcher, int32_t action, int32_t repeatCount,
-                         int32_t displayId = ADISPLAY_ID_NONE,
+static int32_t injectKey(const sp<InputDispatcherInterface>& dispatcher, int32_t action,
+                         int32_t repeatCount, int32_t displayId = ADISPLAY_ID_NONE,
                          int32_t syncMode = INPUT_EVENT_INJECTION_SYNC_WAIT_FOR_RESULT,
                          std::chrono::milliseconds injectionTimeout = INJECT_EVENT_TIMEOUT) {
     KeyEvent event;
@@ -928,19 +941,19 @@ static int32_t injectKey(const sp<InputDispatcher>& dispatcher, int32_t action,
                                         POLICY_FLAG_FILTERED | POLICY_FLAG_PASS_TO_USER);
 }
 
-static int32_t injectKeyDown(const sp<InputDispatcher>& dispatcher,
+static int32_t injectKeyDown(const sp<InputDispatcherInterface>& dispatcher,
                              int32_t displayId = ADISPLAY_ID_NONE) {
     return injectKey(dispatcher, AKEY_EVENT_ACTION_DOWN, /* repeatCount */ 0, displayId);
 }
 
-static int32_t injectKeyUp(const sp<InputDispatcher>& dispatcher,
+static int32_t injectKeyUp(const sp<InputDispatcherInterface>& dispatcher,
                            int32_t displayId = ADISPLAY_ID_NONE) {
     return injectKey(dispatcher, AKEY_EVENT_ACTION_UP, /* repeatCount */ 0, displayId);
 }
 
 static int32_t injectMotionEvent(
-        const sp<InputDispatcher>& dispatcher, int32_t action, int32_t source, int32_t displayId,
-        const PointF& position,
+        const sp<InputDispatcherInterface>& dispatcher, int32_t action, int32_t source,
+        int32_t displayId, const PointF& position,
         const PointF& cursorPosition = {AMOTION_EVENT_INVALID_CURSOR_POSITION,
                                         AMOTION_EVENT_INVALID_CURSOR_POSITION},
         std::chrono::milliseconds injectionTimeout = INJECT_EVENT_TIMEOUT,
@@ -974,12 +987,12 @@ static int32_t injectMotionEvent(
                                         POLICY_FLAG_FILTERED | POLICY_FLAG_PASS_TO_USER);
 }
 
-static int32_t injectMotionDown(const sp<InputDispatcher>& dispatcher, int32_t source,
+static int32_t injectMotionDown(const sp<InputDispatcherInterface>& dispatcher, int32_t source,
                                 int32_t displayId, const PointF& location = {100, 200}) {
     return injectMotionEvent(dispatcher, AMOTION_EVENT_ACTION_DOWN, source, displayId, location);
 }
 
-static int32_t injectMotionUp(const sp<InputDispatcher>& dispatcher, int32_t source,
+static int32_t injectMotionUp(const sp<InputDispatcherInterface>& dispatcher, int32_t source,
                               int32_t displayId, const PointF& location = {100, 200}) {
     return injectMotionEvent(dispatcher, AMOTION_EVENT_ACTION_UP, source, displayId, location);
 }
@@ -1094,6 +1107,42 @@ TEST_F(InputDispatcherTest, SetInputWindowTwice_SingleWindowTouch) {
     window->consumeMotionDown(ADISPLAY_ID_DEFAULT);
 }
 
+/**
+ * Moving a window without changing the window list should move where it can be touched.
+ */
+TEST_F(InputDispatcherTest, SetInputWindow_FrameChangeUpdatesTouchedWindow) {
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> windowLeft =
+            new FakeWindowHandle(application, mDispatcher, "Left", ADISPLAY_ID_DEFAULT);
+    windowLeft->setFrame(Rect(0, 0, 100, 100));
+    windowLeft->setLayoutParamFlags(InputWindowInfo::FLAG_NOT_TOUCH_MODAL);
+    sp<FakeWindowHandle> windowRight =
+            new FakeWindowHandle(application, mDispatcher, "Right", ADISPLAY_ID_DEFAULT);
+    windowRight->setFrame(Rect(100, 0, 200, 100));
+    windowRight->setLayoutParamFlags(InputWindowInfo::FLAG_NOT_TOUCH_MODAL);
+
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {windowLeft, windowRight}}});
+    // Unchanged windows sent again should keep being touchable.
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {windowLeft, windowRight}}});
+    ASSERT_EQ(INPUT_EVENT_INJECTION_SUCCEEDED,
+              injectMotionDown(mDispatcher, AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                               {150, 50}));
+    windowRight->consumeMotionDown(ADISPLAY_ID_DEFAULT);
+    ASSERT_EQ(INPUT_EVENT_INJECTION_SUCCEEDED,
+              injectMotionUp(mDispatcher, AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                             {150, 50}));
+    windowRight->consumeMotionUp(ADISPLAY_ID_DEFAULT);
+
+    windowLeft->setFrame(Rect(100, 0, 200, 100));
+    windowRight->setFrame(Rect(0, 0, 100, 100));
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {windowLeft, windowRight}}});
+    ASSERT_EQ(INPUT_EVENT_INJECTION_SUCCEEDED,
+              injectMotionDown(mDispatcher, AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                               {150, 50}));
+    windowLeft->consumeMotionDown(ADISPLAY_ID_DEFAULT);
+    windowRight->assertNoEvents();
+}
+
 // The foreground window should receive the first touch down event.
 TEST_F(InputDispatcherTest, SetInputWindow_MultiWindowsTouch) {
     sp<FakeApplicationHandle> application = new FakeApplicationHandle();
@@ -1211,6 +1260,81 @@ TEST_F(InputDispatcherTest, DispatchMouseEventsUnderCursor) {
     windowRight->assertNoEvents();
 }
 
+TEST_F(InputDispatcherTest, ScrollEvents_CoalescedWhileConnectionIsBackedUp) {
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> window =
+            new FakeWindowHandle(application, mDispatcher, "Fake Window", ADISPLAY_ID_DEFAULT);
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+
+    // Send more scrolls than the input channel can hold without the window reading any of them.
+    constexpr size_t SCROLL_COUNT = 500;
+    for (size_t i = 0; i < SCROLL_COUNT; i++) {
+        NotifyMotionArgs motionArgs =
+                generateMotionArgs(AMOTION_EVENT_ACTION_SCROLL, AINPUT_SOURCE_MOUSE,
+                                   ADISPLAY_ID_DEFAULT);
+        motionArgs.pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_VSCROLL, 1);
+        mDispatcher->notifyMotion(&motionArgs);
+    }
+
+    // The scrolls that could not be published right away are merged, but none of the scrolling
+    // is lost.
+    size_t receivedCount = 0;
+    float totalScroll = 0;
+    while (InputEvent* event = window->consume()) {
+        ASSERT_EQ(AINPUT_EVENT_TYPE_MOTION, event->getType());
+        const MotionEvent& motionEvent = static_cast<const MotionEvent&>(*event);
+        EXPECT_EQ(AMOTION_EVENT_ACTION_SCROLL, motionEvent.getAction());
+        totalScroll += motionEvent.getAxisValue(AMOTION_EVENT_AXIS_VSCROLL, 0);
+        receivedCount++;
+    }
+    EXPECT_LT(receivedCount, SCROLL_COUNT);
+    EXPECT_EQ(static_cast<float>(SCROLL_COUNT), totalScroll);
+}
+
+class InputDispatcherMoveMergingTest : public InputDispatcherTest {
+protected:
+    virtual void SetUp() override {
+        mFakePolicy = new FakeInputDispatcherPolicy();
+        mFakePolicy->setMoveMergingWaitQueueDepth(1);
+        mDispatcher = new InputDispatcher(mFakePolicy);
+        mDispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+        ASSERT_EQ(OK, mDispatcher->start());
+    }
+};
+
+TEST_F(InputDispatcherMoveMergingTest, MovesToSlowWindow_AreMerged) {
+    sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+    sp<FakeWindowHandle> window =
+            new FakeWindowHandle(application, mDispatcher, "Fake Window", ADISPLAY_ID_DEFAULT);
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+
+    NotifyMotionArgs motionArgs = generateMotionArgs(AMOTION_EVENT_ACTION_DOWN,
+                                                     AINPUT_SOURCE_TOUCHSCREEN,
+                                                     ADISPLAY_ID_DEFAULT, {PointF{50, 50}});
+    mDispatcher->notifyMotion(&motionArgs);
+    // Leave the down unfinished, so that the window has reached the wait queue depth limit.
+    std::optional<uint32_t> downSequenceNum = window->receiveEvent();
+    ASSERT_TRUE(downSequenceNum);
+
+    for (int i = 1; i <= 10; i++) {
+        motionArgs = generateMotionArgs(AMOTION_EVENT_ACTION_MOVE, AINPUT_SOURCE_TOUCHSCREEN,
+                                        ADISPLAY_ID_DEFAULT, {PointF{50.0f + i, 50}});
+        mDispatcher->notifyMotion(&motionArgs);
+    }
+    window->assertNoEvents();
+
+    // Once the window catches up, it only receives the latest move.
+    window->finishEvent(*downSequenceNum);
+    InputEvent* event = window->consume();
+    ASSERT_NE(nullptr, event);
+    ASSERT_EQ(AINPUT_EVENT_TYPE_MOTION, event->getType());
+    const MotionEvent& motionEvent = static_cast<const MotionEvent&>(*event);
+    EXPECT_EQ(AMOTION_EVENT_ACTION_MOVE, motionEvent.getAction());
+    EXPECT_EQ(0U, motionEvent.getHistorySize());
+    EXPECT_EQ(60, motionEvent.getX(0));
+    window->assertNoEvents();
+}
+
 TEST_F(InputDispatcherTest, NotifyDeviceReset_CancelsKeyStream) {
     sp<FakeApplicationHandle> application = new FakeApplicationHandle();
     sp<FakeWindowHandle> window =
@@ -1821,6 +1945,62 @@ TEST_F(InputDispatcherKeyRepeatTest, FocusedWindow_RepeatKeyEventsUseUniqueEvent
     }
 }
 
+class InputDispatcherKeyInterceptionCacheTest : public InputDispatcherTest {
+protected:
+    sp<FakeWindowHandle> mWindow;
+
+    virtual void SetUp() override {
+        mFakePolicy = new FakeInputDispatcherPolicy();
+        mFakePolicy->setCacheKeyInterceptionVerdicts(true);
+        mDispatcher = new InputDispatcher(mFakePolicy);
+        mDispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+        ASSERT_EQ(OK, mDispatcher->start());
+
+        sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+        mWindow = new FakeWindowHandle(application, mDispatcher, "Fake Window",
+                                       ADISPLAY_ID_DEFAULT);
+        mWindow->setFocus(true);
+        mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {mWindow}}});
+        mWindow->consumeFocusEvent(true);
+    }
+
+    virtual void TearDown() override {
+        mWindow.clear();
+        InputDispatcherTest::TearDown();
+    }
+
+    void pressAndRelease(int32_t source) {
+        NotifyKeyArgs keyArgs = generateKeyArgs(AKEY_EVENT_ACTION_DOWN, ADISPLAY_ID_DEFAULT);
+        keyArgs.source = source;
+        mDispatcher->notifyKey(&keyArgs);
+        mWindow->consumeKeyDown(ADISPLAY_ID_DEFAULT);
+
+        keyArgs = generateKeyArgs(AKEY_EVENT_ACTION_UP, ADISPLAY_ID_DEFAULT);
+        keyArgs.source = source;
+        mDispatcher->notifyKey(&keyArgs);
+        mWindow->consumeEvent(AINPUT_EVENT_TYPE_KEY, AKEY_EVENT_ACTION_UP, ADISPLAY_ID_DEFAULT,
+                              0 /*expectedFlags*/);
+    }
+};
+
+TEST_F(InputDispatcherKeyInterceptionCacheTest, GamepadButtons_ReusePolicyVerdict) {
+    for (int i = 0; i < 3; i++) {
+        pressAndRelease(AINPUT_SOURCE_GAMEPAD);
+    }
+    // Only the first down and up went to the policy.
+    ASSERT_EQ(2u, mFakePolicy->getInterceptKeyBeforeDispatchingCount());
+
+    mDispatcher->invalidateKeyInterceptionVerdicts();
+    pressAndRelease(AINPUT_SOURCE_GAMEPAD);
+    ASSERT_EQ(4u, mFakePolicy->getInterceptKeyBeforeDispatchingCount());
+}
+
+TEST_F(InputDispatcherKeyInterceptionCacheTest, KeyboardKeyPresses_AlwaysGoToPolicy) {
+    pressAndRelease(AINPUT_SOURCE_KEYBOARD);
+    pressAndRelease(AINPUT_SOURCE_KEYBOARD);
+    ASSERT_EQ(4u, mFakePolicy->getInterceptKeyBeforeDispatchingCount());
+}
+
 /* Test InputDispatcher for MultiDisplay */
 class InputDispatcherFocusOnTwoDisplaysTest : public InputDispatcherTest {
 public:
@@ -3031,4 +3211,80 @@ TEST_F(InputDispatcherMultiWindowAnr, SplitTouch_SingleWindowAnr) {
     mFocusedWindow->assertNoEvents();
 }
 
+class ShardedInputDispatcherTest : public testing::Test {
+protected:
+    static constexpr int32_t SECOND_DISPLAY_ID = 1;
+
+    sp<FakeInputDispatcherPolicy> mFakePolicy;
+    sp<ShardedInputDispatcher> mDispatcher;
+    sp<FakeWindowHandle> mWindowInPrimary;
+    sp<FakeWindowHandle> mWindowInSecondary;
+
+    virtual void SetUp() override {
+        mFakePolicy = new FakeInputDispatcherPolicy();
+        // The second display gets a shard of its own, the primary display stays in shard 0.
+        mDispatcher = new ShardedInputDispatcher(mFakePolicy, {{SECOND_DISPLAY_ID}});
+        mDispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+        ASSERT_EQ(OK, mDispatcher->start());
+
+        sp<FakeApplicationHandle> application = new FakeApplicationHandle();
+        mWindowInPrimary =
+                new FakeWindowHandle(application, mDispatcher, "D_1", ADISPLAY_ID_DEFAULT);
+        mWindowInSecondary =
+                new FakeWindowHandle(application, mDispatcher, "D_2", SECOND_DISPLAY_ID);
+        mWindowInPrimary->setFocus(true);
+        mWindowInSecondary->setFocus(true);
+
+        mDispatcher->setFocusedApplication(ADISPLAY_ID_DEFAULT, application);
+        mDispatcher->setFocusedApplication(SECOND_DISPLAY_ID, application);
+        mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {mWindowInPrimary}},
+                                      {SECOND_DISPLAY_ID, {mWindowInSecondary}}});
+        mWindowInPrimary->consumeFocusEvent(true);
+        mWindowInSecondary->consumeFocusEvent(true);
+    }
+
+    virtual void TearDown() override {
+        ASSERT_EQ(OK, mDispatcher->stop());
+        mWindowInPrimary.clear();
+        mWindowInSecondary.clear();
+        mFakePolicy.clear();
+        mDispatcher.clear();
+    }
+};
+
+TEST_F(ShardedInputDispatcherTest, Touch_GoesToWindowOnTouchedDisplay) {
+    ASSERT_EQ(INPUT_EVENT_INJECTION_SUCCEEDED,
+              injectMotionDown(mDispatcher, AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT))
+            << "Inject motion event should return INPUT_EVENT_INJECTION_SUCCEEDED";
+    mWindowInPrimary->consumeMotionDown(ADISPLAY_ID_DEFAULT);
+    mWindowInSecondary->assertNoEvents();
+
+    ASSERT_EQ(INPUT_EVENT_INJECTION_SUCCEEDED,
+              injectMotionDown(mDispatcher, AINPUT_SOURCE_TOUCHSCREEN, SECOND_DISPLAY_ID))
+            << "Inject motion event should return INPUT_EVENT_INJECTION_SUCCEEDED";
+    mWindowInSecondary->consumeMotionDown(SECOND_DISPLAY_ID);
+    mWindowInPrimary->assertNoEvents();
+}
+
+TEST_F(ShardedInputDispatcherTest, KeyWithoutDisplay_GoesToFocusedDisplay) {
+    mDispatcher->setFocusedDisplay(SECOND_DISPLAY_ID);
+
+    ASSERT_EQ(INPUT_EVENT_INJECTION_SUCCEEDED, injectKeyDown(mDispatcher))
+            << "Inject key event should return INPUT_EVENT_INJECTION_SUCCEEDED";
+    mWindowInSecondary->consumeKeyDown(ADISPLAY_ID_NONE);
+    mWindowInPrimary->assertNoEvents();
+}
+
+TEST_F(ShardedInputDispatcherTest, TransferTouchFocus_BetweenShards_Fails) {
+    ASSERT_EQ(INPUT_EVENT_INJECTION_SUCCEEDED,
+              injectMotionDown(mDispatcher, AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT))
+            << "Inject motion event should return INPUT_EVENT_INJECTION_SUCCEEDED";
+    mWindowInPrimary->consumeMotionDown(ADISPLAY_ID_DEFAULT);
+
+    ASSERT_FALSE(mDispatcher->transferTouchFocus(mWindowInPrimary->getToken(),
+                                                 mWindowInSecondary->getToken()));
+    mWindowInPrimary->assertNoEvents();
+    mWindowInSecondary->assertNoEvents();
+}
+
 } // namespace android::inputdispatcher
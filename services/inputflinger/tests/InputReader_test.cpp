@@ -813,7 +813,7 @@ private:
         return false;
     }
 
-    virtual void vibrate(int32_t, nsecs_t) {
+    virtual void vibrate(int32_t, nsecs_t, nsecs_t, int32_t) {
     }
 
     virtual void cancelVibrate(int32_t) {
@@ -4751,6 +4751,30 @@ TEST_F(SingleTouchInputMapperTest, Process_XYAxes_AffineCalibration) {
             x, y, 1, 0, 0, 0, 0, 0, 0, 0));
 }
 
+TEST_F(SingleTouchInputMapperTest, Process_XYAxes_AffineCalibrationWhenRotated) {
+    addConfigurationProperty("touch.deviceType", "touchScreen");
+    prepareDisplay(DISPLAY_ORIENTATION_90);
+    prepareLocationCalibration();
+    prepareButtons();
+    prepareAxes(POSITION);
+    SingleTouchInputMapper& mapper = addMapperAndConfigure<SingleTouchInputMapper>();
+
+    int32_t rawX = 100;
+    int32_t rawY = 200;
+
+    // The calibration applies to raw coordinates, before they are rotated.
+    float x = toDisplayY(toCookedY(rawX, rawY));
+    float y = DISPLAY_WIDTH - toDisplayX(toCookedX(rawX, rawY));
+
+    processDown(mapper, rawX, rawY);
+    processSync(mapper);
+
+    NotifyMotionArgs args;
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasCalled(&args));
+    ASSERT_NO_FATAL_FAILURE(assertPointerCoords(args.pointerCoords[0],
+            x, y, 1, 0, 0, 0, 0, 0, 0, 0));
+}
+
 TEST_F(SingleTouchInputMapperTest, Process_ShouldHandleAllButtons) {
     addConfigurationProperty("touch.deviceType", "touchScreen");
     prepareDisplay(DISPLAY_ORIENTATION_0);
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../LockFreeQueue.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace android {
+
+namespace inputdispatcher {
+
+// --- LockFreeQueueTest ---
+
+TEST(LockFreeQueueTest, Push_ReportsWhenEmpty) {
+    LockFreeQueue<int> queue;
+    ASSERT_TRUE(queue.empty());
+
+    ASSERT_TRUE(queue.push(1));
+    ASSERT_FALSE(queue.push(2));
+    ASSERT_FALSE(queue.empty());
+
+    queue.drain([](int) {});
+    ASSERT_TRUE(queue.empty());
+    ASSERT_TRUE(queue.push(3));
+}
+
+TEST(LockFreeQueueTest, Drain_KeepsPushOrder) {
+    LockFreeQueue<int> queue;
+    for (int i = 0; i < 10; i++) {
+        queue.push(i);
+    }
+
+    std::vector<int> values;
+    queue.drain([&values](int value) { values.push_back(value); });
+    ASSERT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), values);
+}
+
+TEST(LockFreeQueueTest, Destructor_DestroysRemainingValues) {
+    std::shared_ptr<int> value = std::make_shared<int>(0);
+    {
+        LockFreeQueue<std::shared_ptr<int>> queue;
+        queue.push(value);
+        ASSERT_EQ(2, value.use_count());
+    }
+    ASSERT_EQ(1, value.use_count());
+}
+
+/**
+ * With several producers, each one's values still come out in the order it pushed them, and
+ * none are lost while the consumer drains concurrently.
+ */
+TEST(LockFreeQueueTest, ConcurrentPushes_KeepPerProducerOrder) {
+    constexpr int PRODUCERS = 4;
+    constexpr int VALUES_PER_PRODUCER = 10000;
+    LockFreeQueue<std::pair<int, int>> queue;
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < PRODUCERS; producer++) {
+        producers.emplace_back([&queue, producer]() {
+            for (int i = 0; i < VALUES_PER_PRODUCER; i++) {
+                queue.push(std::make_pair(producer, i));
+            }
+        });
+    }
+
+    std::vector<int> next(PRODUCERS, 0);
+    int received = 0;
+    auto consume = [&](std::pair<int, int> value) {
+        ASSERT_EQ(next[value.first], value.second);
+        next[value.first]++;
+        received++;
+    };
+    while (received < PRODUCERS * VALUES_PER_PRODUCER) {
+        queue.drain(consume);
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    ASSERT_TRUE(queue.empty());
+}
+
+} // namespace inputdispatcher
+
+} // namespace android
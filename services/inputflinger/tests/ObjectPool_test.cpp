@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../ObjectPool.h"
+
+#include <gtest/gtest.h>
+#include <set>
+#include <vector>
+
+namespace android {
+
+namespace inputdispatcher {
+
+// --- ObjectPoolTest ---
+
+struct Block {
+    char data[100];
+};
+
+TEST(ObjectPoolTest, Deallocate_BlockIsReused) {
+    ObjectPool<Block, 4> pool;
+
+    void* block = pool.allocate();
+    pool.deallocate(block);
+    ASSERT_EQ(1u, pool.freeCount());
+
+    ASSERT_EQ(block, pool.allocate());
+    ASSERT_EQ(0u, pool.freeCount());
+    pool.deallocate(block);
+}
+
+/**
+ * Blocks past the capacity go back to the heap instead of piling up in the pool.
+ */
+TEST(ObjectPoolTest, DeallocatePastCapacity_KeepsOnlyCapacity) {
+    ObjectPool<Block, 4> pool;
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < 10; i++) {
+        blocks.push_back(pool.allocate());
+    }
+    ASSERT_EQ(10u, std::set<void*>(blocks.begin(), blocks.end()).size());
+
+    for (void* block : blocks) {
+        pool.deallocate(block);
+    }
+    ASSERT_EQ(4u, pool.freeCount());
+}
+
+} // namespace inputdispatcher
+
+} // namespace android
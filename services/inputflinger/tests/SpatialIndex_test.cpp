@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../SpatialIndex.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+
+namespace android {
+
+namespace inputdispatcher {
+
+// --- SpatialIndexTest ---
+
+static bool contains(const std::vector<size_t>& candidates, size_t entry) {
+    return std::find(candidates.begin(), candidates.end(), entry) != candidates.end();
+}
+
+TEST(SpatialIndexTest, Empty_NoCandidates) {
+    SpatialIndex index;
+    index.build();
+
+    ASSERT_TRUE(index.query(0, 0).empty());
+}
+
+TEST(SpatialIndexTest, Unbounded_AlwaysCandidate) {
+    SpatialIndex index;
+    index.insert(Rect(0, 0, 100, 100));
+    index.insertUnbounded();
+    index.build();
+
+    ASSERT_TRUE(contains(index.query(50, 50), 1));
+    ASSERT_TRUE(contains(index.query(-1000, 5000), 1));
+}
+
+TEST(SpatialIndexTest, EmptyRect_NeverCandidate) {
+    SpatialIndex index;
+    index.insert(Rect::EMPTY_RECT);
+    index.insert(Rect(0, 0, 100, 100));
+    index.build();
+
+    ASSERT_FALSE(contains(index.query(0, 0), 0));
+    ASSERT_TRUE(contains(index.query(0, 0), 1));
+}
+
+/**
+ * Right and bottom edges are exclusive, like InputWindowInfo::frameContainsPoint.
+ */
+TEST(SpatialIndexTest, Edges_MatchRectContains) {
+    SpatialIndex index;
+    index.insert(Rect(0, 0, 100, 100));
+    index.insert(Rect(100, 0, 200, 100));
+    index.build();
+
+    ASSERT_EQ(std::vector<size_t>({0}), index.query(99, 99));
+    ASSERT_EQ(std::vector<size_t>({1}), index.query(100, 0));
+    ASSERT_TRUE(index.query(200, 0).empty());
+    ASSERT_TRUE(index.query(0, 100).empty());
+}
+
+/**
+ * Every rect containing a point must come back, in the order it was inserted.
+ */
+TEST(SpatialIndexTest, RandomRects_CandidatesCoverContainingRects) {
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int32_t> coordinate(-200, 1200);
+    std::uniform_int_distribution<int32_t> size(0, 400);
+    std::vector<Rect> rects;
+    SpatialIndex index;
+    for (size_t i = 0; i < 200; i++) {
+        const int32_t left = coordinate(rng);
+        const int32_t top = coordinate(rng);
+        rects.emplace_back(left, top, left + size(rng), top + size(rng));
+        index.insert(rects.back());
+    }
+    index.build();
+
+    for (size_t i = 0; i < 1000; i++) {
+        const int32_t x = coordinate(rng);
+        const int32_t y = coordinate(rng);
+        const std::vector<size_t>& candidates = index.query(x, y);
+        ASSERT_TRUE(std::is_sorted(candidates.begin(), candidates.end()));
+        for (size_t entry = 0; entry < rects.size(); entry++) {
+            const Rect& rect = rects[entry];
+            if (x >= rect.left && x < rect.right && y >= rect.top && y < rect.bottom) {
+                ASSERT_TRUE(contains(candidates, entry))
+                        << "Rect " << entry << " missing at " << x << ", " << y;
+            }
+        }
+    }
+}
+
+} // namespace inputdispatcher
+
+} // namespace android
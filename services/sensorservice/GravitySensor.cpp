@@ -58,7 +58,7 @@ bool GravitySensor::process(sensors_event_t* outEvent,
         vec3_t g;
         if (!mSensorFusion.hasEstimate(FUSION_NOMAG))
             return false;
-        const mat33_t R(mSensorFusion.getRotationMatrix(FUSION_NOMAG));
+        const mat33_t& R(mSensorFusion.getRotationMatrix(FUSION_NOMAG));
         // FIXME: we need to estimate the length of gravity because
         // the accelerometer may have a small scaling error. This
         // translates to an offset in the linear-acceleration sensor.
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LatencyHistogram.h"
+
+#include <utils/String8.h>
+
+#include <algorithm>
+#include <inttypes.h>
+
+namespace android {
+namespace SensorServiceUtil {
+
+LatencyHistogram::LatencyHistogram() : mCount(0), mTotalNs(0), mMaxNs(0) {
+    mBuckets.fill(0);
+}
+
+void LatencyHistogram::record(nsecs_t latencyNs) {
+    // Timestamps from the HAL can be slightly ahead of the service's clock.
+    latencyNs = std::max(latencyNs, nsecs_t(0));
+    const uint64_t ms = uint64_t(ns2ms(latencyNs));
+    const size_t bucket =
+            ms == 0 ? 0 : std::min(size_t(64 - __builtin_clzll(ms)), NUM_BUCKETS - 1);
+    mBuckets[bucket]++;
+    mCount++;
+    mTotalNs += latencyNs;
+    mMaxNs = std::max(mMaxNs, latencyNs);
+}
+
+std::string LatencyHistogram::dump() const {
+    String8 buffer;
+    buffer.appendFormat("count %" PRIu64 " | mean %.2fms | max %.2fms |", mCount,
+                        mCount > 0 ? mTotalNs / 1e6 / mCount : 0.0, mMaxNs / 1e6);
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        if (mBuckets[i] == 0) {
+            continue;
+        }
+        if (i == NUM_BUCKETS - 1) {
+            buffer.appendFormat(" >=%dms: %" PRIu64, 1 << (i - 1), mBuckets[i]);
+        } else {
+            buffer.appendFormat(" <%dms: %" PRIu64, 1 << i, mBuckets[i]);
+        }
+    }
+    return std::string(buffer.string());
+}
+
+} // namespace SensorServiceUtil
+} // namespace android;
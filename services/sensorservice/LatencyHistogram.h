@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_SERVICE_UTIL_LATENCY_HISTOGRAM_H
+#define ANDROID_SENSOR_SERVICE_UTIL_LATENCY_HISTOGRAM_H
+
+#include "SensorServiceUtils.h"
+
+#include <utils/Timers.h>
+
+#include <array>
+#include <stdint.h>
+
+namespace android {
+namespace SensorServiceUtil {
+
+// Counts latencies in buckets of doubling width: under 1ms, [1ms, 2ms), [2ms, 4ms) and so on up to
+// 1s and over. Recording is cheap enough to be done for every event. Not thread safe, the owner
+// guards it with its own lock.
+class LatencyHistogram : public Dumpable {
+public:
+    LatencyHistogram();
+
+    void record(nsecs_t latencyNs);
+    uint64_t getCount() const { return mCount; }
+
+    // Dumpable interface
+    virtual std::string dump() const override;
+
+private:
+    static constexpr size_t NUM_BUCKETS = 12;
+
+    std::array<uint64_t, NUM_BUCKETS> mBuckets;
+    uint64_t mCount;
+    nsecs_t mTotalNs;
+    nsecs_t mMaxNs;
+};
+
+} // namespace SensorServiceUtil
+} // namespace android;
+
+#endif // ANDROID_SENSOR_SERVICE_UTIL_LATENCY_HISTOGRAM_H
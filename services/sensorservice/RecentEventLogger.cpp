@@ -21,7 +21,9 @@
 #include <frameworks/base/core/proto/android/service/sensor_service.proto.h>
 #include <utils/Timers.h>
 
+#include <algorithm>
 #include <inttypes.h>
+#include <string.h>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -34,19 +36,53 @@ namespace {
 
 RecentEventLogger::RecentEventLogger(int sensorType) :
         mSensorType(sensorType), mEventSize(eventSizeBySensorType(mSensorType)),
-        mRecentEvents(logSizeBySensorType(sensorType)), mMaskData(false),
+        mValuesPerEvent(sensorType == SENSOR_TYPE_STEP_COUNTER ? 2 : mEventSize),
+        mHistorySize(logSizeBySensorType(sensorType)), mLastEventWallTimeMs(0),
+        mHasLastEvent(false), mHistoryFront(0), mHistoryCount(0), mMaskData(false),
         mIsLastEventCurrent(false) {
-    // blank
+    memset(&mLastEvent, 0, sizeof(mLastEvent));
 }
 
 void RecentEventLogger::addEvent(const sensors_event_t& event) {
+    timespec wallTime;
+    clock_gettime(CLOCK_REALTIME, &wallTime);
+    const int64_t wallTimeMs = wallTime.tv_sec * 1000LL + ns2ms(wallTime.tv_nsec);
+
     std::lock_guard<std::mutex> lk(mLock);
-    mRecentEvents.emplace(event);
+    mLastEvent = event;
+    mLastEventWallTimeMs = wallTimeMs;
+    mHasLastEvent = true;
     mIsLastEventCurrent = true;
+
+    if (!mHistory.empty()) {
+        mHistory[mHistoryFront] = {event.timestamp, wallTimeMs};
+        // The values are the first floats of the event's data, or its step count.
+        static_assert(sizeof(event.u64.step_counter) == 2 * sizeof(float), "size mismatch");
+        memcpy(&mHistoryValues[mHistoryFront * mValuesPerEvent], event.data,
+               mValuesPerEvent * sizeof(float));
+        mHistoryFront = (mHistoryFront + 1) % mHistorySize;
+        mHistoryCount = std::min(mHistoryCount + 1, mHistorySize);
+    }
+}
+
+void RecentEventLogger::enableHistory() {
+    std::lock_guard<std::mutex> lk(mLock);
+    if (!mHistory.empty()) {
+        return;
+    }
+    mHistory.resize(mHistorySize);
+    mHistoryValues.resize(mHistorySize * mValuesPerEvent);
+    if (mHasLastEvent) {
+        mHistory[0] = {mLastEvent.timestamp, mLastEventWallTimeMs};
+        memcpy(&mHistoryValues[0], mLastEvent.data, mValuesPerEvent * sizeof(float));
+        mHistoryFront = 1 % mHistorySize;
+        mHistoryCount = 1;
+    }
 }
 
 bool RecentEventLogger::isEmpty() const {
-    return mRecentEvents.size() == 0;
+    std::lock_guard<std::mutex> lk(mLock);
+    return !mHasLastEvent;
 }
 
 void RecentEventLogger::setLastEventStale() {
@@ -54,35 +90,53 @@ void RecentEventLogger::setLastEventStale() {
     mIsLastEventCurrent = false;
 }
 
+template <typename F>
+void RecentEventLogger::forEachEventLocked(F f) const {
+    if (mHistory.empty()) {
+        if (mHasLastEvent) {
+            const SensorEventLog log = {mLastEvent.timestamp, mLastEventWallTimeMs};
+            f(log, mLastEvent.data);
+        }
+        return;
+    }
+    for (size_t i = 0; i < mHistoryCount; i++) {
+        const size_t index = (mHistoryFront + mHistorySize - 1 - i) % mHistorySize;
+        f(mHistory[index], &mHistoryValues[index * mValuesPerEvent]);
+    }
+}
+
 std::string RecentEventLogger::dump() const {
     std::lock_guard<std::mutex> lk(mLock);
 
     //TODO: replace String8 with std::string completely in this function
     String8 buffer;
 
-    buffer.appendFormat("last %zu events\n", mRecentEvents.size());
+    buffer.appendFormat("last %zu events\n", mHistory.empty() ? size_t(mHasLastEvent)
+                                                                : mHistoryCount);
     int j = 0;
-    for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
-        const auto& ev = mRecentEvents[i];
-        struct tm * timeinfo = localtime(&(ev.mWallTime.tv_sec));
+    forEachEventLocked([&](const SensorEventLog& ev, const float* values) {
+        const time_t wallTimeSec = ev.mWallTimeMs / 1000;
+        struct tm * timeinfo = localtime(&wallTimeSec);
         buffer.appendFormat("\t%2d (ts=%.9f, wall=%02d:%02d:%02d.%03d) ",
-                ++j, ev.mEvent.timestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
-                (int) ns2ms(ev.mWallTime.tv_nsec));
+                ++j, ev.mTimestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
+                (int) (ev.mWallTimeMs % 1000));
 
         // data
         if (!mMaskData) {
             if (mSensorType == SENSOR_TYPE_STEP_COUNTER) {
-                buffer.appendFormat("%" PRIu64 ", ", ev.mEvent.u64.step_counter);
+                uint64_t stepCounter;
+                memcpy(&stepCounter, values, sizeof(stepCounter));
+                buffer.appendFormat("%" PRIu64 ", ", stepCounter);
             } else {
                 for (size_t k = 0; k < mEventSize; ++k) {
-                    buffer.appendFormat("%.2f, ", ev.mEvent.data[k]);
+                    buffer.appendFormat("%.2f, ", values[k]);
                 }
             }
         } else {
             buffer.append("[value masked]");
         }
         buffer.append("\n");
-    }
+    });
     return std::string(buffer.string());
 }
 
@@ -97,27 +151,28 @@ void RecentEventLogger::dump(util::ProtoOutputStream* proto) const {
     using namespace service::SensorEventsProto;
     std::lock_guard<std::mutex> lk(mLock);
 
-    proto->write(RecentEventsLog::RECENT_EVENTS_COUNT, int(mRecentEvents.size()));
-    for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
-        const auto& ev = mRecentEvents[i];
+    proto->write(RecentEventsLog::RECENT_EVENTS_COUNT,
+                 int(mHistory.empty() ? size_t(mHasLastEvent) : mHistoryCount));
+    forEachEventLocked([&](const SensorEventLog& ev, const float* values) {
         const uint64_t token = proto->start(RecentEventsLog::EVENTS);
-        proto->write(Event::TIMESTAMP_SEC, float(ev.mEvent.timestamp) / 1e9f);
-        proto->write(Event::WALL_TIMESTAMP_MS, ev.mWallTime.tv_sec * 1000LL
-                + ns2ms(ev.mWallTime.tv_nsec));
+        proto->write(Event::TIMESTAMP_SEC, float(ev.mTimestamp) / 1e9f);
+        proto->write(Event::WALL_TIMESTAMP_MS, ev.mWallTimeMs);
 
         if (mMaskData) {
             proto->write(Event::MASKED, true);
         } else {
             if (mSensorType == SENSOR_TYPE_STEP_COUNTER) {
-                proto->write(Event::INT64_DATA, int64_t(ev.mEvent.u64.step_counter));
+                uint64_t stepCounter;
+                memcpy(&stepCounter, values, sizeof(stepCounter));
+                proto->write(Event::INT64_DATA, int64_t(stepCounter));
             } else {
                 for (size_t k = 0; k < mEventSize; ++k) {
-                    proto->write(Event::FLOAT_ARRAY, ev.mEvent.data[k]);
+                    proto->write(Event::FLOAT_ARRAY, values[k]);
                 }
             }
         }
         proto->end(token);
-    }
+    });
 }
 
 void RecentEventLogger::setFormat(std::string format) {
@@ -131,9 +186,8 @@ void RecentEventLogger::setFormat(std::string format) {
 bool RecentEventLogger::populateLastEventIfCurrent(sensors_event_t *event) const {
     std::lock_guard<std::mutex> lk(mLock);
 
-    if (mIsLastEventCurrent && mRecentEvents.size()) {
-        // Index 0 contains the latest event emplace()'ed
-        *event = mRecentEvents[0].mEvent;
+    if (mIsLastEventCurrent && mHasLastEvent) {
+        *event = mLastEvent;
         return true;
     } else {
         return false;
@@ -154,9 +208,5 @@ size_t RecentEventLogger::logSizeBySensorType(int sensorType) {
     return LOG_SIZE;
 }
 
-RecentEventLogger::SensorEventLog::SensorEventLog(const sensors_event_t& e) : mEvent(e) {
-    clock_gettime(CLOCK_REALTIME, &mWallTime);
-}
-
 } // namespace SensorServiceUtil
 } // namespace android
@@ -17,13 +17,13 @@
 #ifndef ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 #define ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 
-#include "RingBuffer.h"
 #include "SensorServiceUtils.h"
 
 #include <hardware/sensors.h>
 #include <utils/String8.h>
 
 #include <mutex>
+#include <vector>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -33,11 +33,18 @@ namespace SensorServiceUtil {
 // generated from the sensor are stored in this buffer.  The buffer is NOT cleared when the sensor
 // unregisters and as a result very old data in the dumpsys output can be seen, which is an intended
 // behavior.
+//
+// Only the last event is kept in full. The others only keep their timestamps and the values that
+// are meaningful for the sensor type, and are not kept at all until enableHistory() is called, so
+// that the sensors nobody dumps do not hold on to memory that every event touches.
 class RecentEventLogger : public Dumpable {
 public:
     explicit RecentEventLogger(int sensorType);
     void addEvent(const sensors_event_t& event);
 
+    // Starts keeping the last N events rather than only the last one.
+    void enableHistory();
+
     // Populate event with the last recorded sensor event if it is not stale. An event is
     // considered stale if the sensor has become deactivated since the event was recorded.
     // returns true on success, false if no recent event is available or the last event is stale
@@ -53,16 +60,31 @@ public:
 
 protected:
     struct SensorEventLog {
-        explicit SensorEventLog(const sensors_event_t& e);
-        timespec mWallTime;
-        sensors_event_t mEvent;
+        int64_t mTimestamp;
+        int64_t mWallTimeMs;
     };
 
+    // Calls f(log, values) for each logged event, newest first, where values points to the
+    // mValuesPerEvent values of the event.
+    template <typename F>
+    void forEachEventLocked(F f) const;
+
     const int mSensorType;
     const size_t mEventSize;
+    // A step count is a uint64_t, that takes two floats.
+    const size_t mValuesPerEvent;
+    const size_t mHistorySize;
 
     mutable std::mutex mLock;
-    RingBuffer<SensorEventLog> mRecentEvents;
+    sensors_event_t mLastEvent;
+    int64_t mLastEventWallTimeMs;
+    bool mHasLastEvent;
+    // Circular buffers of mHistorySize events once the history is enabled, empty until then.
+    // mHistoryFront is where the next event goes.
+    std::vector<SensorEventLog> mHistory;
+    std::vector<float> mHistoryValues;
+    size_t mHistoryFront;
+    size_t mHistoryCount;
 
     bool mMaskData;
     bool mIsLastEventCurrent;
@@ -29,6 +29,15 @@ namespace android {
 
 RotationVectorSensor::RotationVectorSensor(int mode) :
       mMode(mode) {
+    // SensorService writes the events into ashmem direct channels itself, as fast as the
+    // accelerometer that triggers them allows.
+    const int32_t minDelayUs = mSensorFusion.getMinDelay();
+    int directRateLevel = SENSOR_DIRECT_RATE_NORMAL;
+    if (minDelayUs > 0 && minDelayUs <= 1250) {
+        directRateLevel = SENSOR_DIRECT_RATE_VERY_FAST;
+    } else if (minDelayUs > 0 && minDelayUs <= 5000) {
+        directRateLevel = SENSOR_DIRECT_RATE_FAST;
+    }
     const sensor_t sensor = {
         .name       = getSensorName(),
         .vendor     = "AOSP",
@@ -38,9 +47,13 @@ RotationVectorSensor::RotationVectorSensor(int mode) :
         .maxRange   = 1,
         .resolution = 1.0f / (1<<24),
         .power      = mSensorFusion.getPowerUsage(),
-        .minDelay   = mSensorFusion.getMinDelay(),
+        .minDelay   = minDelayUs,
+        .flags      = static_cast<decltype(sensor_t::flags)>(
+                (directRateLevel << SENSOR_FLAG_SHIFT_DIRECT_REPORT) |
+                SENSOR_FLAG_DIRECT_CHANNEL_ASHMEM),
     };
-    mSensor = Sensor(&sensor);
+    // Direct report flags are only taken from HAL 1.3 on.
+    mSensor = Sensor(&sensor, SENSORS_DEVICE_API_VERSION_1_3);
 }
 
 bool RotationVectorSensor::process(sensors_event_t* outEvent,
@@ -589,18 +589,27 @@ ssize_t SensorDevice::pollFmq(sensors_event_t* buffer, size_t maxNumEventsToRead
         }
     }
 
-    size_t eventsToRead = std::min({availableEvents, maxNumEventsToRead, mEventBuffer.size()});
+    // The events are read straight into the tail of the caller's buffer and converted in place,
+    // front to back. As an Event is smaller than a sensors_event_t, converting an event never
+    // overwrites one that is yet to be converted.
+    static_assert(sizeof(Event) <= sizeof(sensors_event_t), "Event is larger than sensors_event_t");
+    static_assert((sizeof(sensors_event_t) - sizeof(Event)) % alignof(Event) == 0,
+                  "Events can't be read into a sensors_event_t buffer");
+    size_t eventsToRead = std::min(availableEvents, maxNumEventsToRead);
     if (eventsToRead > 0) {
-        if (mSensors->getEventQueue()->read(mEventBuffer.data(), eventsToRead)) {
+        Event* events = reinterpret_cast<Event*>(
+                reinterpret_cast<uint8_t*>(buffer + eventsToRead) - eventsToRead * sizeof(Event));
+        if (mSensors->getEventQueue()->read(events, eventsToRead)) {
             // Notify the Sensors HAL that sensor events have been read. This is required to support
             // the use of writeBlocking by the Sensors HAL.
             mEventQueueFlag->wake(asBaseType(EventQueueFlagBits::EVENTS_READ));
 
             for (size_t i = 0; i < eventsToRead; i++) {
-                convertToSensorEvent(mEventBuffer[i], &buffer[i]);
-                android::SensorDeviceUtils::quantizeSensorEventValues(&buffer[i],
-                        getResolutionForSensor(buffer[i].sensor));
+                // buffer[i] overlaps events[i], so convert from a copy.
+                const Event event = events[i];
+                convertToSensorEvent(event, &buffer[i]);
             }
+            quantizeSensorEvents(buffer, eventsToRead);
             eventsRead = eventsToRead;
         } else {
             ALOGW("Failed to read %zu events, currently %zu events available",
@@ -1181,8 +1190,21 @@ void SensorDevice::convertToSensorEventsAndQuantize(
 
     for (size_t i = 0; i < src.size(); ++i) {
         V2_1::implementation::convertToSensorEvent(src[i], &dst[i]);
-        android::SensorDeviceUtils::quantizeSensorEventValues(&dst[i],
-                getResolutionForSensor(dst[i].sensor));
+    }
+    quantizeSensorEvents(dst, src.size());
+}
+
+void SensorDevice::quantizeSensorEvents(sensors_event_t* events, size_t count) {
+    // Events mostly come in runs from the same sensor, so only look the resolution up again
+    // when the sensor changes.
+    int lastHandle = 0;
+    float resolution = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (i == 0 || events[i].sensor != lastHandle) {
+            lastHandle = events[i].sensor;
+            resolution = getResolutionForSensor(lastHandle);
+        }
+        android::SensorDeviceUtils::quantizeSensorEventValues(&events[i], resolution);
     }
 }
 
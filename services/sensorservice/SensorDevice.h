@@ -272,6 +272,7 @@ private:
             const hardware::hidl_vec<SensorInfo> &dynamicSensorsAdded,
             sensors_event_t *dst);
 
+    void quantizeSensorEvents(sensors_event_t* events, size_t count);
     float getResolutionForSensor(int sensorHandle);
 
     bool mIsDirectReportSupported;
@@ -282,8 +283,6 @@ private:
     hardware::EventFlag* mEventQueueFlag;
     hardware::EventFlag* mWakeLockQueueFlag;
 
-    std::array<Event, SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT> mEventBuffer;
-
     sp<SensorsHalDeathReceivier> mSensorsHalDeathReceiver;
     std::atomic_bool mReconnecting;
 };
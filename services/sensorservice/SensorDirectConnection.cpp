@@ -16,9 +16,14 @@
 
 #include "SensorDevice.h"
 #include "SensorDirectConnection.h"
+#include "SensorInterface.h"
 #include <android/util/ProtoOutputStream.h>
 #include <frameworks/base/core/proto/android/service/sensor_service.proto.h>
 #include <hardware/sensors.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
 
 #define UNUSED(x) (void)(x)
 
@@ -31,7 +36,8 @@ SensorService::SensorDirectConnection::SensorDirectConnection(const sp<SensorSer
         const String16& opPackageName)
         : mService(service), mUid(uid), mMem(*mem),
         mHalChannelHandle(halChannelHandle),
-        mOpPackageName(opPackageName), mDestroyed(false) {
+        mOpPackageName(opPackageName), mMemBase(nullptr), mWriteIndex(0), mReportCounter(0),
+        mDestroyed(false) {
     ALOGD_IF(DEBUG_CONNECTIONS, "Created SensorDirectConnection");
 }
 
@@ -49,6 +55,13 @@ void SensorService::SensorDirectConnection::destroy() {
 
     stopAll();
     mService->cleanupConnection(this);
+    {
+        Mutex::Autolock _cl(mConnectionLock);
+        if (mMemBase != nullptr) {
+            munmap(mMemBase, mMem.size);
+            mMemBase = nullptr;
+        }
+    }
     if (mMem.handle != nullptr) {
         native_handle_close(mMem.handle);
         native_handle_delete(const_cast<struct native_handle*>(mMem.handle));
@@ -93,9 +106,16 @@ sp<BitTube> SensorService::SensorDirectConnection::getSensorChannel() const {
     return nullptr;
 }
 
+sp<SensorEventRing> SensorService::SensorDirectConnection::enableEventRing() {
+    // Direct channels already write into memory of the app's own choosing.
+    return nullptr;
+}
+
 void SensorService::SensorDirectConnection::onSensorAccessChanged(bool hasAccess) {
+    // SensorService::mLock is already held here.
     if (!hasAccess) {
-        stopAll(true /* backupRecord */);
+        Mutex::Autolock _l(mConnectionLock);
+        stopAllLocked(true /* backupRecord */);
     } else {
         recoverAll();
     }
@@ -157,11 +177,21 @@ int32_t SensorService::SensorDirectConnection::configureChannel(int handle, int
         return INVALID_OPERATION;
     }
 
+    if (si->isVirtual()) {
+        Mutex::Autolock _sl(mService->mLock);
+        Mutex::Autolock _l(mConnectionLock);
+        return configureVirtualSensorLocked(si, rateLevel);
+    }
+
     struct sensors_direct_cfg_t config = {
         .rate_level = rateLevel
     };
 
     Mutex::Autolock _l(mConnectionLock);
+    if (getHalChannelHandle() <= 0 || !mVirtualSensorReports.empty()) {
+        // Either the HAL does not know about this channel, or SensorService writes into it.
+        return INVALID_OPERATION;
+    }
     SensorDevice& dev(SensorDevice::getInstance());
     int ret = dev.configureDirectChannel(handle, getHalChannelHandle(), &config);
 
@@ -180,7 +210,145 @@ int32_t SensorService::SensorDirectConnection::configureChannel(int handle, int
     return ret;
 }
 
+int32_t SensorService::SensorDirectConnection::configureVirtualSensorLocked(
+        const sp<SensorInterface>& si, int rateLevel) {
+    const Sensor& s = si->getSensor();
+    const int handle = s.getHandle();
+    if (rateLevel == SENSOR_DIRECT_RATE_STOP) {
+        stopVirtualSensorLocked(handle);
+        return NO_ERROR;
+    }
+
+    // The HAL would not know where SensorService writes, so they cannot share a channel.
+    if (mActivated.size() != mVirtualSensorReports.size()) {
+        return INVALID_OPERATION;
+    }
+    if (!mapMemoryLocked()) {
+        return NO_MEMORY;
+    }
+
+    nsecs_t periodNs;
+    switch (rateLevel) {
+        case SENSOR_DIRECT_RATE_NORMAL:
+            periodNs = 20000000;
+            break;
+        case SENSOR_DIRECT_RATE_FAST:
+            periodNs = 5000000;
+            break;
+        case SENSOR_DIRECT_RATE_VERY_FAST:
+            periodNs = 1250000;
+            break;
+        default:
+            return BAD_VALUE;
+    }
+    periodNs = std::max(periodNs, s.getMinDelayNs());
+
+    const bool wasActive = mVirtualSensorReports.count(handle) != 0;
+    status_t err = si->batch(this, handle, 0, periodNs, 0);
+    if (err == NO_ERROR && !wasActive) {
+        err = si->activate(this, true);
+    }
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    static_cast<VirtualSensor*>(si.get())->setRequestedPeriod(this, periodNs);
+    if (!wasActive) {
+        mService->mDirectVirtualSensorCounts[handle]++;
+    }
+    mVirtualSensorReports[handle] = {periodNs, 0};
+    mActivated[handle] = rateLevel;
+    // The sensor handle doubles as the report token.
+    return handle;
+}
+
+void SensorService::SensorDirectConnection::stopVirtualSensorLocked(int handle) {
+    if (mVirtualSensorReports.erase(handle) == 0) {
+        return;
+    }
+    mActivated.erase(handle);
+
+    sp<SensorInterface> si = mService->getSensorInterfaceFromHandle(handle);
+    if (si != nullptr && si->isVirtual()) {
+        si->activate(this, false);
+        static_cast<VirtualSensor*>(si.get())->removeRequestedPeriod(this);
+    }
+    auto it = mService->mDirectVirtualSensorCounts.find(handle);
+    if (it != mService->mDirectVirtualSensorCounts.end() && --it->second <= 0) {
+        mService->mDirectVirtualSensorCounts.erase(it);
+    }
+}
+
+bool SensorService::SensorDirectConnection::mapMemoryLocked() {
+    if (mMemBase != nullptr) {
+        return true;
+    }
+    if (mMem.type != SENSOR_DIRECT_MEM_TYPE_ASHMEM || mMem.size < sizeof(sensors_event_t)) {
+        return false;
+    }
+    void* base = mmap(nullptr, mMem.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      mMem.handle->data[0], 0);
+    if (base == MAP_FAILED) {
+        ALOGE("Cannot map direct channel memory: %s", strerror(errno));
+        return false;
+    }
+    mMemBase = base;
+    return true;
+}
+
+void SensorService::SensorDirectConnection::writeVirtualSensorEventsLocked(
+        const sensors_event_t* buffer, size_t count) {
+    Mutex::Autolock _l(mConnectionLock);
+    if (mVirtualSensorReports.empty() || mMemBase == nullptr) {
+        return;
+    }
+
+    sensors_event_t* slots = static_cast<sensors_event_t*>(mMemBase);
+    const size_t numSlots = mMem.size / sizeof(sensors_event_t);
+    for (size_t i = 0; i < count; i++) {
+        if (buffer[i].type == SENSOR_TYPE_META_DATA) {
+            continue;
+        }
+        auto it = mVirtualSensorReports.find(buffer[i].sensor);
+        if (it == mVirtualSensorReports.end()) {
+            continue;
+        }
+
+        // The sensor may be computed faster for other clients, so keep to this channel's rate,
+        // with the same slack as VirtualSensor::isEventDue().
+        VirtualSensorReport& report = it->second;
+        const nsecs_t timestamp = buffer[i].timestamp;
+        if (timestamp < report.nextTimestamp - report.periodNs / 4) {
+            continue;
+        }
+        report.nextTimestamp += report.periodNs;
+        if (report.nextTimestamp <= timestamp) {
+            report.nextTimestamp = timestamp + report.periodNs;
+        }
+
+        sensors_event_t event;
+        memset(&event, 0, sizeof(event));
+        event.version = sizeof(sensors_event_t);
+        event.sensor = buffer[i].sensor;
+        event.type = buffer[i].type;
+        event.timestamp = timestamp;
+        memcpy(event.data, buffer[i].data, sizeof(event.data));
+
+        // The reader only takes a slot once its counter moves on, so the counter is published
+        // last and the rest of the slot is written while it still holds the old value.
+        sensors_event_t& slot = slots[mWriteIndex];
+        mWriteIndex = (mWriteIndex + 1) % numSlots;
+        event.reserved0 = slot.reserved0;
+        slot = event;
+        if (++mReportCounter == 0) {
+            mReportCounter = 1;
+        }
+        __atomic_store_n(&slot.reserved0, static_cast<int32_t>(mReportCounter), __ATOMIC_RELEASE);
+    }
+}
+
 void SensorService::SensorDirectConnection::stopAll(bool backupRecord) {
+    Mutex::Autolock _sl(mService->mLock);
     Mutex::Autolock _l(mConnectionLock);
     stopAllLocked(backupRecord);
 }
@@ -190,13 +358,18 @@ void SensorService::SensorDirectConnection::stopAllLocked(bool backupRecord) {
         .rate_level = SENSOR_DIRECT_RATE_STOP
     };
 
+    if (backupRecord && mActivatedBackup.empty()) {
+        mActivatedBackup = mActivated;
+    }
+
     SensorDevice& dev(SensorDevice::getInstance());
     for (auto &i : mActivated) {
-        dev.configureDirectChannel(i.first, getHalChannelHandle(), &config);
+        if (mVirtualSensorReports.count(i.first) == 0) {
+            dev.configureDirectChannel(i.first, getHalChannelHandle(), &config);
+        }
     }
-
-    if (backupRecord && mActivatedBackup.empty()) {
-        mActivatedBackup = mActivated;
+    while (!mVirtualSensorReports.empty()) {
+        stopVirtualSensorLocked(mVirtualSensorReports.begin()->first);
     }
     mActivated.clear();
 }
@@ -211,15 +384,22 @@ void SensorService::SensorDirectConnection::recoverAll() {
         // recover list of report from backup
         ALOG_ASSERT(mActivated.empty(),
                     "mActivated must be empty if mActivatedBackup was non-empty");
-        mActivated = mActivatedBackup;
-        mActivatedBackup.clear();
+        std::unordered_map<int, int> backup;
+        backup.swap(mActivatedBackup);
 
         // re-enable them
-        for (auto &i : mActivated) {
+        for (auto &i : backup) {
+            sp<SensorInterface> si = mService->getSensorInterfaceFromHandle(i.first);
+            if (si != nullptr && si->isVirtual()) {
+                // SensorService::mLock is held by the caller of onSensorAccessChanged().
+                configureVirtualSensorLocked(si, i.second);
+                continue;
+            }
             struct sensors_direct_cfg_t config = {
                 .rate_level = i.second
             };
             dev.configureDirectChannel(i.first, getHalChannelHandle(), &config);
+            mActivated[i.first] = i.second;
         }
     }
 }
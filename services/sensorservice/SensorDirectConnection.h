@@ -51,6 +51,10 @@ public:
     // app changed to idle/active status.
     void onSensorAccessChanged(bool hasAccess);
 
+    // Writes the events of the virtual sensors configured on this channel, which the HAL knows
+    // nothing about, into the shared memory. Requires SensorService::mLock.
+    void writeVirtualSensorEventsLocked(const sensors_event_t* buffer, size_t count);
+
 protected:
     virtual ~SensorDirectConnection();
     // ISensorEventConnection functions
@@ -61,6 +65,7 @@ protected:
     virtual status_t setEventRate(int handle, nsecs_t samplingPeriodNs);
     virtual status_t flush();
     virtual int32_t configureChannel(int handle, int rateLevel);
+    virtual sp<SensorEventRing> enableEventRing();
     virtual void destroy();
 private:
     bool hasSensorAccess() const;
@@ -72,7 +77,7 @@ private:
     // sensors for sensor privacy/restrict mode or when an app becomes
     // idle).
     void stopAll(bool backupRecord = false);
-    // Same as stopAll() but with mConnectionLock held.
+    // Same as stopAll() but with SensorService::mLock and mConnectionLock held.
     void stopAllLocked(bool backupRecord);
 
     // Recover sensor requests previously stopped by stopAll(true).
@@ -82,6 +87,17 @@ private:
     // If no requests are backed up by stopAll(), this method is no-op.
     void recoverAll();
 
+    // Virtual sensor reports are computed and written by SensorService itself, so their
+    // configuration needs SensorService::mLock as well as mConnectionLock.
+    int32_t configureVirtualSensorLocked(const sp<SensorInterface>& si, int rateLevel);
+    void stopVirtualSensorLocked(int handle);
+    bool mapMemoryLocked();
+
+    struct VirtualSensorReport {
+        nsecs_t periodNs;
+        nsecs_t nextTimestamp;
+    };
+
     const sp<SensorService> mService;
     const uid_t mUid;
     const sensors_direct_mem_t mMem;
@@ -91,6 +107,11 @@ private:
     mutable Mutex mConnectionLock;
     std::unordered_map<int, int> mActivated;
     std::unordered_map<int, int> mActivatedBackup;
+    // Modified with both SensorService::mLock and mConnectionLock held.
+    std::unordered_map<int, VirtualSensorReport> mVirtualSensorReports;
+    void* mMemBase;
+    size_t mWriteIndex;
+    uint32_t mReportCounter;
 
     mutable Mutex mDestroyLock;
     bool mDestroyed;
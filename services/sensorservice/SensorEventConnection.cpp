@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
 #include <log/log.h>
 #include <sys/socket.h>
 #include <utils/threads.h>
@@ -21,6 +22,7 @@
 #include <android/util/ProtoOutputStream.h>
 #include <frameworks/base/core/proto/android/service/sensor_service.proto.h>
 #include <sensor/SensorEventQueue.h>
+#include <sensor/SensorEventRing.h>
 
 #include "vec.h"
 #include "SensorEventConnection.h"
@@ -42,6 +44,7 @@ SensorService::SensorEventConnection::SensorEventConnection(
     : mService(service), mUid(uid), mWakeLockRefCount(0), mHasLooperCallbacks(false),
       mDead(false), mDataInjectionMode(isDataInjectionMode), mEventCache(nullptr),
       mCacheSize(0), mMaxCacheSize(0), mTimeOfLastEventDrop(0), mEventsDropped(0),
+      mDeferralLatencyNs(0),
       mPackageName(packageName), mOpPackageName(opPackageName), mTargetSdk(kTargetSdkUnknown),
       mDestroyed(false) {
     mChannel = new BitTube(mService->mSocketBufferSize);
@@ -76,6 +79,7 @@ bool SensorService::SensorEventConnection::needsWakeLock() {
 void SensorService::SensorEventConnection::resetWakeLockRefCount() {
     Mutex::Autolock _l(mConnectionLock);
     mWakeLockRefCount = 0;
+    mAckPendingSince.clear();
 }
 
 void SensorService::SensorEventConnection::dump(String8& result) {
@@ -89,16 +93,24 @@ void SensorService::SensorEventConnection::dump(String8& result) {
         result.append("NORMAL\n");
     }
     result.appendFormat("\t %s | WakeLockRefCount %d | uid %d | cache size %d | "
-            "max cache size %d\n", mPackageName.string(), mWakeLockRefCount, mUid, mCacheSize,
-            mMaxCacheSize);
+            "max cache size %d | deferral %.2f ms, %zu events deferred\n", mPackageName.string(),
+            mWakeLockRefCount, mUid, mCacheSize, mMaxCacheSize, mDeferralLatencyNs / 1e6f,
+            mDeferredEvents.size());
     for (auto& it : mSensorInfo) {
         const FlushInfo& flushInfo = it.second;
-        result.appendFormat("\t %s 0x%08x | status: %s | pending flush events %d \n",
+        const auto dropped = mEventsDroppedBySensor.find(it.first);
+        result.appendFormat("\t %s 0x%08x | status: %s | pending flush events %d | "
+                            "dropped events %" PRIu64 " \n",
                             mService->getSensorName(it.first).string(),
                             it.first,
                             flushInfo.mFirstFlushPending ? "First flush pending" :
                                                            "active",
-                            flushInfo.mPendingFlushEventsToSend);
+                            flushInfo.mPendingFlushEventsToSend,
+                            dropped != mEventsDroppedBySensor.end() ? dropped->second : 0);
+    }
+    result.appendFormat("\t socket write latency: %s\n", mWriteLatency.dump().c_str());
+    if (mAckLatency.getCount() > 0) {
+        result.appendFormat("\t wake up ack latency: %s\n", mAckLatency.dump().c_str());
     }
 #if DEBUG_CONNECTIONS
     result.appendFormat("\t events recvd: %d | sent %d | cache %d | dropped %d |"
@@ -172,6 +184,7 @@ bool SensorService::SensorEventConnection::addSensor(int32_t handle) {
 bool SensorService::SensorEventConnection::removeSensor(int32_t handle) {
     Mutex::Autolock _l(mConnectionLock);
     if (mSensorInfo.erase(handle) >= 0) {
+        updateDeferralLatencyLocked();
         return true;
     }
     return false;
@@ -239,7 +252,10 @@ void SensorService::SensorEventConnection::updateLooperRegistrationLocked(
     return; }
 
     int looper_flags = 0;
-    if (mCacheSize > 0) looper_flags |= ALOOPER_EVENT_OUTPUT;
+    // With an event ring the socket is always writable, the app says when it made room instead.
+    if (mCacheSize > 0) {
+        looper_flags |= mEventRing != nullptr ? ALOOPER_EVENT_INPUT : ALOOPER_EVENT_OUTPUT;
+    }
     if (mDataInjectionMode) looper_flags |= ALOOPER_EVENT_INPUT;
     for (auto& it : mSensorInfo) {
         const int handle = it.first;
@@ -288,7 +304,8 @@ bool SensorService::SensorEventConnection::incrementPendingFlushCountIfHasAccess
 status_t SensorService::SensorEventConnection::sendEvents(
         sensors_event_t const* buffer, size_t numEvents,
         sensors_event_t* scratch,
-        wp<const SensorEventConnection> const * mapFlushEventsToConnections) {
+        wp<const SensorEventConnection> const * mapFlushEventsToConnections,
+        const std::vector<size_t>* eventIndices) {
     // filter out events not for this connection
 
     std::unique_ptr<sensors_event_t[]> sanitizedBuffer;
@@ -296,8 +313,9 @@ status_t SensorService::SensorEventConnection::sendEvents(
     int count = 0;
     Mutex::Autolock _l(mConnectionLock);
     if (scratch) {
-        size_t i=0;
-        while (i<numEvents) {
+        const size_t numCandidates = eventIndices != nullptr ? eventIndices->size() : numEvents;
+        for (size_t j = 0; j < numCandidates; ++j) {
+            const size_t i = eventIndices != nullptr ? (*eventIndices)[j] : j;
             int32_t sensor_handle = buffer[i].sensor;
             if (buffer[i].type == SENSOR_TYPE_META_DATA) {
                 ALOGD_IF(DEBUG_CONNECTIONS, "flush complete event sensor==%d ",
@@ -309,51 +327,40 @@ status_t SensorService::SensorEventConnection::sendEvents(
             }
 
             // Check if this connection has registered for this sensor. If not continue to the
-            // next sensor_event.
-            if (mSensorInfo.count(sensor_handle) == 0) {
-                ++i;
+            // next sensor_event. The sensor may have been removed since eventIndices was built.
+            auto flushInfoIt = mSensorInfo.find(sensor_handle);
+            if (flushInfoIt == mSensorInfo.end()) {
                 continue;
             }
 
-            FlushInfo& flushInfo = mSensorInfo[sensor_handle];
+            FlushInfo& flushInfo = flushInfoIt->second;
             // Check if there is a pending flush_complete event for this sensor on this connection.
             if (buffer[i].type == SENSOR_TYPE_META_DATA && flushInfo.mFirstFlushPending == true &&
                     mapFlushEventsToConnections[i] == this) {
                 flushInfo.mFirstFlushPending = false;
                 ALOGD_IF(DEBUG_CONNECTIONS, "First flush event for sensor==%d ",
                         buffer[i].meta_data.sensor);
-                ++i;
                 continue;
             }
 
             // If there is a pending flush complete event for this sensor on this connection,
             // ignore the event and proceed to the next.
             if (flushInfo.mFirstFlushPending) {
-                ++i;
                 continue;
             }
 
-            do {
-                // Keep copying events into the scratch buffer as long as they are regular
-                // sensor_events are from the same sensor_handle OR they are flush_complete_events
-                // from the same sensor_handle AND the current connection is mapped to the
-                // corresponding flush_complete_event.
-                if (buffer[i].type == SENSOR_TYPE_META_DATA) {
-                    if (mapFlushEventsToConnections[i] == this) {
-                        scratch[count++] = buffer[i];
-                    }
-                } else {
-                    // Regular sensor event, just copy it to the scratch buffer after checking
-                    // the AppOp.
-                    if (hasSensorAccess() && noteOpIfRequired(buffer[i])) {
-                        scratch[count++] = buffer[i];
-                    }
+            // Copy flush_complete_events only when the current connection is mapped to them.
+            if (buffer[i].type == SENSOR_TYPE_META_DATA) {
+                if (mapFlushEventsToConnections[i] == this) {
+                    scratch[count++] = buffer[i];
                 }
-                i++;
-            } while ((i<numEvents) && ((buffer[i].sensor == sensor_handle &&
-                                        buffer[i].type != SENSOR_TYPE_META_DATA) ||
-                                       (buffer[i].type == SENSOR_TYPE_META_DATA  &&
-                                        buffer[i].meta_data.sensor == sensor_handle)));
+            } else {
+                // Regular sensor event, just copy it to the scratch buffer after checking
+                // the AppOp.
+                if (hasSensorAccess() && noteOpIfRequired(buffer[i])) {
+                    scratch[count++] = buffer[i];
+                }
+            }
         }
     } else {
         if (hasSensorAccess()) {
@@ -386,6 +393,23 @@ status_t SensorService::SensorEventConnection::sendEvents(
         return status_t(NO_ERROR);
     }
 
+    if (deferEventsLocked(scratch, count)) {
+        return status_t(NO_ERROR);
+    }
+    if (!mDeferredEvents.empty()) {
+        // The events held back so far go first.
+        ssize_t size = sendDeferredEventsLocked();
+        if (size < 0) {
+            appendEventsToCacheLocked(scratch, count);
+            return status_t(size);
+        }
+    }
+    ssize_t size = writeOrCacheEventsLocked(scratch, count);
+    return size < 0 ? status_t(size) : status_t(NO_ERROR);
+}
+
+ssize_t SensorService::SensorEventConnection::writeOrCacheEventsLocked(sensors_event_t* scratch,
+                                                                      int count) {
     int index_wake_up_event = -1;
     if (hasSensorAccess()) {
         index_wake_up_event = findWakeUpSensorEventLocked(scratch, count);
@@ -399,8 +423,7 @@ status_t SensorService::SensorEventConnection::sendEvents(
     }
 
     // NOTE: ASensorEvent and sensors_event_t are the same type.
-    ssize_t size = SensorEventQueue::write(mChannel,
-                                    reinterpret_cast<ASensorEvent const*>(scratch), count);
+    ssize_t size = writeEventsLocked(reinterpret_cast<ASensorEvent const*>(scratch), count);
     if (size < 0) {
         // Write error, copy events to local cache.
         if (index_wake_up_event >= 0) {
@@ -433,7 +456,66 @@ status_t SensorService::SensorEventConnection::sendEvents(
     }
 #endif
 
-    return size < 0 ? status_t(size) : status_t(NO_ERROR);
+    return size;
+}
+
+bool SensorService::SensorEventConnection::deferEventsLocked(sensors_event_t const* events,
+                                                              int count) {
+    if (mDeferralLatencyNs <= 0 || mDeferredEvents.size() + count > size_t(getMaxWriteSize())) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        // Flush complete events must not overtake the events before them, nor be held back.
+        if (events[i].type == SENSOR_TYPE_META_DATA) {
+            return false;
+        }
+    }
+    // Events that the HAL batched already may be due on arrival.
+    const nsecs_t oldestTimestamp = mDeferredEvents.empty() ? events[0].timestamp
+                                                            : mDeferredEvents.front().timestamp;
+    if (systemTime(SYSTEM_TIME_BOOTTIME) - oldestTimestamp >= mDeferralLatencyNs) {
+        return false;
+    }
+    mDeferredEvents.insert(mDeferredEvents.end(), events, events + count);
+    return true;
+}
+
+ssize_t SensorService::SensorEventConnection::sendDeferredEventsLocked() {
+    ssize_t size = writeOrCacheEventsLocked(mDeferredEvents.data(), mDeferredEvents.size());
+    mDeferredEvents.clear();
+    return size;
+}
+
+void SensorService::SensorEventConnection::setMaxBatchReportLatency(
+        int32_t handle, nsecs_t maxBatchReportLatencyNs) {
+    Mutex::Autolock _l(mConnectionLock);
+    auto it = mSensorInfo.find(handle);
+    if (it == mSensorInfo.end()) {
+        return;
+    }
+    // Only continuous non wake-up events are held back: wake-up events keep SensorService's wake
+    // lock until the app acks them, and the other modes report rarely anyway.
+    sp<SensorInterface> si = mService->getSensorInterfaceFromHandle(handle);
+    const bool canDefer = !mDataInjectionMode && si != nullptr &&
+            !si->getSensor().isWakeUpSensor() &&
+            si->getSensor().getReportingMode() == AREPORTING_MODE_CONTINUOUS;
+    it->second.mMaxBatchReportLatencyNs = canDefer ? maxBatchReportLatencyNs : 0;
+    updateDeferralLatencyLocked();
+}
+
+void SensorService::SensorEventConnection::updateDeferralLatencyLocked() {
+    nsecs_t latencyNs = mSensorInfo.empty() ? 0 : INT64_MAX;
+    for (auto& it : mSensorInfo) {
+        latencyNs = std::min(latencyNs, it.second.mMaxBatchReportLatencyNs);
+    }
+    mDeferralLatencyNs = latencyNs;
+}
+
+int SensorService::SensorEventConnection::getMaxWriteSize() const {
+    // At a time write at most half the size of the receiver buffer in SensorEventQueue OR
+    // half the size of the socket buffer allocated in BitTube whichever is smaller.
+    return helpers::min(SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT/2,
+            int(mService->mSocketBufferSize/(sizeof(sensors_event_t)*2)));
 }
 
 bool SensorService::SensorEventConnection::hasSensorAccess() {
@@ -525,6 +607,8 @@ void SensorService::SensorEventConnection::appendEventsToCacheLocked(sensors_eve
         // Check for any flush complete events in the events that will be dropped
         countFlushCompleteEventsLocked(mEventCache, cachedEventsToDrop);
         countFlushCompleteEventsLocked(events, newEventsToDrop);
+        countDroppedEventsLocked(mEventCache, cachedEventsToDrop);
+        countDroppedEventsLocked(events, newEventsToDrop);
 
         // Only shift the events if they will not all be overwritten
         if (eventsToCopy != mMaxCacheSize) {
@@ -554,6 +638,11 @@ void SensorService::SensorEventConnection::sendPendingFlushEventsLocked() {
         }
 
         FlushInfo& flushInfo = it.second;
+        if (flushInfo.mPendingFlushEventsToSend > 0 && !mDeferredEvents.empty() &&
+                sendDeferredEventsLocked() < 0) {
+            // The flush complete events have to wait for the events before them.
+            return;
+        }
         while (flushInfo.mPendingFlushEventsToSend > 0) {
             flushCompleteEvent.meta_data.sensor = handle;
             bool wakeUpSensor = si->getSensor().isWakeUpSensor();
@@ -561,7 +650,7 @@ void SensorService::SensorEventConnection::sendPendingFlushEventsLocked() {
                ++mWakeLockRefCount;
                flushCompleteEvent.flags |= WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
             }
-            ssize_t size = SensorEventQueue::write(mChannel, &flushCompleteEvent, 1);
+            ssize_t size = writeEventsLocked(&flushCompleteEvent, 1);
             if (size < 0) {
                 if (wakeUpSensor) --mWakeLockRefCount;
                 return;
@@ -574,10 +663,7 @@ void SensorService::SensorEventConnection::sendPendingFlushEventsLocked() {
 }
 
 void SensorService::SensorEventConnection::writeToSocketFromCache() {
-    // At a time write at most half the size of the receiver buffer in SensorEventQueue OR
-    // half the size of the socket buffer allocated in BitTube whichever is smaller.
-    const int maxWriteSize = helpers::min(SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT/2,
-            int(mService->mSocketBufferSize/(sizeof(sensors_event_t)*2)));
+    const int maxWriteSize = getMaxWriteSize();
     Mutex::Autolock _l(mConnectionLock);
     // Send pending flush complete events (if any)
     sendPendingFlushEventsLocked();
@@ -597,7 +683,7 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
             }
         }
 
-        ssize_t size = SensorEventQueue::write(mChannel,
+        ssize_t size = writeEventsLocked(
                           reinterpret_cast<ASensorEvent const*>(mEventCache + numEventsSent),
                           numEventsToWrite);
         if (size < 0) {
@@ -654,6 +740,15 @@ void SensorService::SensorEventConnection::countFlushCompleteEventsLocked(
     return;
 }
 
+void SensorService::SensorEventConnection::countDroppedEventsLocked(
+                sensors_event_t const* events, const int numEventsDropped) {
+    for (int j = 0; j < numEventsDropped; ++j) {
+        if (events[j].type != SENSOR_TYPE_META_DATA) {
+            mEventsDroppedBySensor[events[j].sensor]++;
+        }
+    }
+}
+
 int SensorService::SensorEventConnection::findWakeUpSensorEventLocked(
                        sensors_event_t const* scratch, const int count) {
     for (int i = 0; i < count; ++i) {
@@ -669,6 +764,65 @@ sp<BitTube> SensorService::SensorEventConnection::getSensorChannel() const
     return mChannel;
 }
 
+sp<SensorEventRing> SensorService::SensorEventConnection::enableEventRing() {
+    // Every batch has to fit into an empty ring, or it could never be written.
+    static_assert(SensorEventRing::DEFAULT_CAPACITY >=
+                  SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT,
+                  "SensorEventRing can't hold a full batch of events");
+    Mutex::Autolock _l(mConnectionLock);
+    if (mEventRing == nullptr) {
+        // Switching over while events may be in flight on the socket would reorder them.
+        if (mDataInjectionMode || !mSensorInfo.empty() || mCacheSize > 0) {
+            ALOGE("Can't enable an event ring on an active connection, package=%s",
+                  mPackageName.string());
+            return nullptr;
+        }
+        mEventRing = SensorEventRing::create();
+    }
+    return mEventRing;
+}
+
+ssize_t SensorService::SensorEventConnection::writeEventsLocked(ASensorEvent const* events,
+                                                                size_t count) {
+    ssize_t size;
+    if (mEventRing == nullptr) {
+        size = SensorEventQueue::write(mChannel, events, count);
+    } else {
+        bool needsDoorbell = false;
+        size = mEventRing->write(events, count, &needsDoorbell);
+        if (needsDoorbell) {
+            // The app ignores what the doorbell says. If the socket is full, there are doorbells
+            // pending already.
+            SensorEventQueue::write(mChannel, events, 1);
+        }
+    }
+    if (size >= 0) {
+        recordWrittenEventsLocked(events, count);
+    }
+    return size;
+}
+
+void SensorService::SensorEventConnection::recordWrittenEventsLocked(ASensorEvent const* events,
+                                                                     size_t count) {
+    const nsecs_t now = systemTime(SYSTEM_TIME_BOOTTIME);
+    for (size_t i = 0; i < count; i++) {
+        if (events[i].type != SENSOR_TYPE_META_DATA) {
+            mWriteLatency.record(now - events[i].timestamp);
+        }
+        if (events[i].flags & WAKE_UP_SENSOR_EVENT_NEEDS_ACK) {
+            mAckPendingSince.push_back(now);
+        }
+    }
+}
+
+void SensorService::SensorEventConnection::recordAcksLocked(uint32_t numAcks) {
+    const nsecs_t now = systemTime(SYSTEM_TIME_BOOTTIME);
+    for (uint32_t i = 0; i < numAcks && !mAckPendingSince.empty(); i++) {
+        mAckLatency.record(now - mAckPendingSince.front());
+        mAckPendingSince.pop_front();
+    }
+}
+
 status_t SensorService::SensorEventConnection::enableDisable(
         int handle, bool enabled, nsecs_t samplingPeriodNs, nsecs_t maxBatchReportLatencyNs,
         int reservedFlags)
@@ -725,6 +879,7 @@ int SensorService::SensorEventConnection::handleEvent(int fd, int events, void*
             Mutex::Autolock _l(mConnectionLock);
             mDead = true;
             mWakeLockRefCount = 0;
+            mAckPendingSince.clear();
             updateLooperRegistrationLocked(mService->getLooper());
         }
         mService->checkWakeLockState();
@@ -740,6 +895,7 @@ int SensorService::SensorEventConnection::handleEvent(int fd, int events, void*
     if (events & ALOOPER_EVENT_INPUT) {
         unsigned char buf[sizeof(sensors_event_t)];
         ssize_t numBytesRead = ::recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        bool hasRoomInEventRing = false;
         {
             Mutex::Autolock _l(mConnectionLock);
             if (numBytesRead == sizeof(sensors_event_t)) {
@@ -771,17 +927,27 @@ int SensorService::SensorEventConnection::handleEvent(int fd, int events, void*
                 // mWakeLockRefCount to zero.
                 if (numAcks > 0 && numAcks < mWakeLockRefCount) {
                     mWakeLockRefCount -= numAcks;
+                    recordAcksLocked(numAcks);
                 } else {
                     mWakeLockRefCount = 0;
+                    recordAcksLocked(numAcks);
+                    mAckPendingSince.clear();
                 }
 #if DEBUG_CONNECTIONS
                 mTotalAcksReceived += numAcks;
 #endif
+            } else if (numBytesRead == sizeof(SensorEventRing::RoomAvailableMessage)) {
+                // The app drained an event ring that was full, see if the cache fits now.
+                hasRoomInEventRing = mEventRing != nullptr && mCacheSize > 0;
            } else {
                // Read error, reset wakelock refcount.
                mWakeLockRefCount = 0;
+               mAckPendingSince.clear();
            }
         }
+        if (hasRoomInEventRing) {
+            writeToSocketFromCache();
+        }
         // Check if wakelock can be released by sensorservice. mConnectionLock needs to be released
         // here as checkWakeLockState() will need it.
         if (mWakeLockRefCount == 0) {
@@ -18,9 +18,11 @@
 #define ANDROID_SENSOR_EVENT_CONNECTION_H
 
 #include <atomic>
+#include <deque>
 #include <stdint.h>
 #include <sys/types.h>
 #include <unordered_map>
+#include <vector>
 
 #include <utils/Vector.h>
 #include <utils/SortedVector.h>
@@ -34,9 +36,11 @@
 
 #include <sensor/Sensor.h>
 #include <sensor/BitTube.h>
+#include <sensor/SensorEventRing.h>
 #include <sensor/ISensorServer.h>
 #include <sensor/ISensorEventConnection.h>
 
+#include "LatencyHistogram.h"
 #include "SensorService.h"
 
 namespace android {
@@ -52,8 +56,11 @@ public:
     SensorEventConnection(const sp<SensorService>& service, uid_t uid, String8 packageName,
                           bool isDataInjectionMode, const String16& opPackageName);
 
+    // When eventIndices is given, only the events of buffer at those positions are candidates for
+    // this connection.
     status_t sendEvents(sensors_event_t const* buffer, size_t count, sensors_event_t* scratch,
-                        wp<const SensorEventConnection> const * mapFlushEventsToConnections = nullptr);
+                        wp<const SensorEventConnection> const * mapFlushEventsToConnections = nullptr,
+                        const std::vector<size_t>* eventIndices = nullptr);
     bool hasSensor(int32_t handle) const;
     bool hasAnySensor() const;
     bool hasOneShotSensors() const;
@@ -61,6 +68,8 @@ public:
     bool removeSensor(int32_t handle);
     std::vector<int32_t> getActiveSensorHandles() const;
     void setFirstFlushPending(int32_t handle, bool value);
+    // Sets the latency the client asked for when it enabled the sensor.
+    void setMaxBatchReportLatency(int32_t handle, nsecs_t maxBatchReportLatencyNs);
     void dump(String8& result);
     void dump(util::ProtoOutputStream* proto) const;
     bool needsWakeLock();
@@ -78,6 +87,7 @@ private:
     virtual status_t setEventRate(int handle, nsecs_t samplingPeriodNs);
     virtual status_t flush();
     virtual int32_t configureChannel(int handle, int rateLevel);
+    virtual sp<SensorEventRing> enableEventRing();
     virtual void destroy();
 
     // Count the number of flush complete events which are about to be dropped in the buffer.
@@ -85,6 +95,9 @@ private:
     // separately before the next batch of events.
     void countFlushCompleteEventsLocked(sensors_event_t const* scratch, int numEventsDropped);
 
+    // Counts the sensor events about to be dropped from a full cache in mEventsDroppedBySensor.
+    void countDroppedEventsLocked(sensors_event_t const* events, int numEventsDropped);
+
     // Check if there are any wake up events in the buffer. If yes, return the index of the first
     // wake_up sensor event in the buffer else return -1.  This wake_up sensor event will have the
     // flag WAKE_UP_SENSOR_EVENT_NEEDS_ACK set. Exactly one event per packet will have the wake_up
@@ -99,6 +112,31 @@ private:
     // Writes events from mEventCache to the socket.
     void writeToSocketFromCache();
 
+    // Writes the events and the wake-up ack request they need, or adds them to the cache if the
+    // write fails.
+    ssize_t writeOrCacheEventsLocked(sensors_event_t* scratch, int count);
+
+    // When all the sensors of this connection tolerate batching, the HAL may still report each
+    // event because another client does not. Their events are then held back in mDeferredEvents
+    // until the oldest is due, so that the app wakes up once per batch. Returns true if the events
+    // were held back, else the held back events have to be sent before them. There are no timers:
+    // deferred events go out with the next events or flush, which the HAL sends in time.
+    bool deferEventsLocked(sensors_event_t const* events, int count);
+    ssize_t sendDeferredEventsLocked();
+    // Recomputes mDeferralLatencyNs from the latencies of all the sensors.
+    void updateDeferralLatencyLocked();
+
+    // The most events to write at once.
+    int getMaxWriteSize() const;
+
+    // Writes events to the app, through mEventRing if it has been enabled, else through the
+    // socket. All events are written or the call fails.
+    ssize_t writeEventsLocked(ASensorEvent const* events, size_t count);
+    // Records the latencies of events that were just written.
+    void recordWrittenEventsLocked(ASensorEvent const* events, size_t count);
+    // Records the ack latencies of the oldest events pending an ack.
+    void recordAcksLocked(uint32_t numAcks);
+
     // Compute the approximate cache size from the FIFO sizes of various sensors registered for this
     // connection. Wake up and non-wake up sensors have separate FIFOs but FIFO may be shared
     // amongst wake-up sensors and non-wake up sensors.
@@ -140,6 +178,8 @@ private:
 
     sp<SensorService> const mService;
     sp<BitTube> mChannel;
+    // When set, events go through this ring and mChannel only rings the doorbell.
+    sp<SensorEventRing> mEventRing;
     uid_t mUid;
     mutable Mutex mConnectionLock;
     // Number of events from wake up sensors which are still pending and haven't been delivered to
@@ -166,7 +206,11 @@ private:
         // the events for the sensor are sent on that *connection*.
         bool mFirstFlushPending;
 
-        FlushInfo() : mPendingFlushEventsToSend(0), mFirstFlushPending(false) {}
+        // How long events may be held back before they are sent, 0 to send them right away.
+        nsecs_t mMaxBatchReportLatencyNs;
+
+        FlushInfo() : mPendingFlushEventsToSend(0), mFirstFlushPending(false),
+                      mMaxBatchReportLatencyNs(0) {}
     };
     // protected by SensorService::mLock. Key for this map is the sensor handle.
     std::unordered_map<int32_t, FlushInfo> mSensorInfo;
@@ -175,9 +219,19 @@ private:
     int mCacheSize, mMaxCacheSize;
     int64_t mTimeOfLastEventDrop;
     int mEventsDropped;
+    std::vector<sensors_event_t> mDeferredEvents;
+    nsecs_t mDeferralLatencyNs;
     String8 mPackageName;
     const String16 mOpPackageName;
     int mTargetSdk;
+    // The time from the HAL timestamp of each event to its write to the socket, and from the write
+    // of each event that needs an ack to the ack, with the write times of the events still to be
+    // acked in order.
+    SensorServiceUtil::LatencyHistogram mWriteLatency;
+    SensorServiceUtil::LatencyHistogram mAckLatency;
+    std::deque<nsecs_t> mAckPendingSince;
+    // Events dropped because the cache was full, by sensor handle.
+    std::unordered_map<int32_t, uint64_t> mEventsDroppedBySensor;
 #if DEBUG_CONNECTIONS
     int mEventsReceived, mEventsSent, mEventsSentFromCache;
     int mTotalAcksNeeded, mTotalAcksReceived;
@@ -38,6 +38,7 @@ SensorFusion::SensorFusion()
     mEnabled[FUSION_9AXIS] = false;
     mEnabled[FUSION_NOMAG] = false;
     mEnabled[FUSION_NOGYRO] = false;
+    invalidateRotationMatrices();
 
     if (count > 0) {
         for (size_t i=0 ; i<size_t(count) ; i++) {
@@ -71,8 +72,24 @@ SensorFusion::SensorFusion()
     }
 }
 
+void SensorFusion::process(const sensors_event_t* events, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        processEvent(events[i]);
+    }
+    invalidateRotationMatrices();
+}
+
 void SensorFusion::process(const sensors_event_t& event) {
+    process(&event, 1);
+}
+
+void SensorFusion::invalidateRotationMatrices() {
+    for (int i = 0; i < NUM_FUSION_MODE; ++i) {
+        mRotationMatrixValid[i] = false;
+    }
+}
 
+void SensorFusion::processEvent(const sensors_event_t& event) {
     if (event.type == mGyro.getType()) {
         float dT;
         if ( event.timestamp - mGyroTime> 0 &&
@@ -145,6 +162,7 @@ status_t SensorFusion::activate(int mode, void* ident, bool enabled) {
         mEnabled[mode] = newState;
         if (newState) {
             mFusions[mode].init(mode);
+            mRotationMatrixValid[mode] = false;
         }
     }
 
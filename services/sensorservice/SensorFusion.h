@@ -50,6 +50,11 @@ class SensorFusion : public Singleton<SensorFusion> {
     vec4_t &mAttitude;
     vec4_t mAttitudes[NUM_FUSION_MODE];
 
+    // The rotation matrix of each mode, computed on first use after the estimate changed, so that
+    // all the virtual sensors processing a poll's worth of events share a single computation.
+    mutable mat33_t mRotationMatrices[NUM_FUSION_MODE];
+    mutable bool mRotationMatrixValid[NUM_FUSION_MODE];
+
     SortedVector<void*> mClients[3];
 
     float mEstimatedGyroRate;
@@ -60,8 +65,12 @@ class SensorFusion : public Singleton<SensorFusion> {
 
     SensorFusion();
 
+    void processEvent(const sensors_event_t& event);
+    void invalidateRotationMatrices();
+
 public:
     void process(const sensors_event_t& event);
+    void process(const sensors_event_t* events, size_t count);
 
     bool isEnabled() const {
         return mEnabled[FUSION_9AXIS] ||
@@ -73,8 +82,12 @@ public:
         return mFusions[mode].hasEstimate();
     }
 
-    mat33_t getRotationMatrix(int mode = FUSION_9AXIS) const {
-        return mFusions[mode].getRotationMatrix();
+    const mat33_t& getRotationMatrix(int mode = FUSION_9AXIS) const {
+        if (!mRotationMatrixValid[mode]) {
+            mRotationMatrices[mode] = mFusions[mode].getRotationMatrix();
+            mRotationMatrixValid[mode] = true;
+        }
+        return mRotationMatrices[mode];
     }
 
     vec4_t getAttitude(int mode = FUSION_9AXIS) const {
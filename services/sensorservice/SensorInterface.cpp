@@ -81,7 +81,47 @@ void HardwareSensor::autoDisable(void *ident, int handle) {
 }
 
 VirtualSensor::VirtualSensor() :
-        BaseSensor(DUMMY_SENSOR), mSensorFusion(SensorFusion::getInstance()) {
+        BaseSensor(DUMMY_SENSOR), mSensorFusion(SensorFusion::getInstance()),
+        mMinRequestedPeriodNs(0), mNextEventTimestamp(0) {
+}
+
+void VirtualSensor::setRequestedPeriod(void* ident, int64_t ns) {
+    Mutex::Autolock _l(mPeriodLock);
+    mRequestedPeriodsNs[ident] = ns;
+    updateMinRequestedPeriodLocked();
+}
+
+void VirtualSensor::removeRequestedPeriod(void* ident) {
+    Mutex::Autolock _l(mPeriodLock);
+    mRequestedPeriodsNs.erase(ident);
+    updateMinRequestedPeriodLocked();
+}
+
+void VirtualSensor::updateMinRequestedPeriodLocked() {
+    int64_t minPeriodNs = 0;
+    for (const auto& iter : mRequestedPeriodsNs) {
+        if (minPeriodNs == 0 || iter.second < minPeriodNs) {
+            minPeriodNs = iter.second;
+        }
+    }
+    mMinRequestedPeriodNs = minPeriodNs;
+}
+
+bool VirtualSensor::isEventDue(int64_t timestamp) const {
+    const int64_t periodNs = mMinRequestedPeriodNs;
+    // Allow for some jitter, so that underlying events coming at the requested rate are not
+    // dropped every now and then.
+    return periodNs <= 0 || timestamp >= mNextEventTimestamp - periodNs / 4;
+}
+
+void VirtualSensor::onEventComputed(int64_t timestamp) {
+    const int64_t periodNs = mMinRequestedPeriodNs;
+    // Advancing from the previous due time rather than from this event keeps the average rate
+    // at the requested one when the underlying events are not a multiple of it.
+    mNextEventTimestamp += periodNs;
+    if (mNextEventTimestamp <= timestamp) {
+        mNextEventTimestamp = timestamp + periodNs;
+    }
 }
 
 // ---------------------------------------------------------------------------
@@ -17,7 +17,11 @@
 #ifndef ANDROID_SENSOR_INTERFACE_H
 #define ANDROID_SENSOR_INTERFACE_H
 
+#include <atomic>
+#include <unordered_map>
+
 #include <sensor/Sensor.h>
+#include <utils/Mutex.h>
 #include <utils/RefBase.h>
 
 // ---------------------------------------------------------------------------
@@ -96,8 +100,25 @@ class VirtualSensor : public BaseSensor
 public:
     VirtualSensor();
     virtual bool isVirtual() const override { return true; }
+
+    // Every connection of a sensor gets all of its events, so there is no point in computing
+    // them faster than the fastest rate one of the connections asked for.
+    void setRequestedPeriod(void* ident, int64_t ns);
+    void removeRequestedPeriod(void* ident);
+
+    // Whether the event computed from an underlying event with this timestamp is wanted at all.
+    // Only called from the SensorService thread, like onEventComputed.
+    bool isEventDue(int64_t timestamp) const;
+    void onEventComputed(int64_t timestamp);
 protected:
     SensorFusion& mSensorFusion;
+private:
+    void updateMinRequestedPeriodLocked();
+
+    Mutex mPeriodLock;
+    std::unordered_map<void*, int64_t> mRequestedPeriodsNs; // guarded by mPeriodLock
+    std::atomic<int64_t> mMinRequestedPeriodNs;
+    int64_t mNextEventTimestamp;
 };
 
 
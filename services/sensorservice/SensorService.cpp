@@ -92,6 +92,11 @@ static const String16 sDumpPermission("android.permission.DUMP");
 static const String16 sLocationHardwarePermission("android.permission.LOCATION_HARDWARE");
 static const String16 sManageSensorsPermission("android.permission.MANAGE_SENSORS");
 
+static VirtualSensor* asVirtualSensor(const sp<SensorInterface>& sensor) {
+    return sensor != nullptr && sensor->isVirtual() ? static_cast<VirtualSensor*>(sensor.get())
+                                                    : nullptr;
+}
+
 SensorService::SensorService()
     : mInitCheck(NO_INIT), mSocketBufferSize(SOCKET_BUFFER_SIZE_NON_BATCHED),
       mWakeLockAcquired(false) {
@@ -334,7 +339,12 @@ const Sensor& SensorService::registerSensor(SensorInterface* s, bool isDebug, bo
     int handle = s->getSensor().getHandle();
     int type = s->getSensor().getType();
     if (mSensors.add(handle, s, isDebug, isVirtual)){
-        mRecentEvent.emplace(handle, new SensorServiceUtil::RecentEventLogger(type));
+        auto logger = new SensorServiceUtil::RecentEventLogger(type);
+        // Otherwise the recent events are only logged once dumpsys asked for them.
+        if (property_get_bool("persist.sensors.log_recent_events", false)) {
+            logger->enableHistory();
+        }
+        mRecentEvent.emplace(handle, logger);
         return s->getSensor();
     } else {
         return mSensors.getNonSensor();
@@ -452,6 +462,7 @@ status_t SensorService::dump(int fd, const Vector<String16>& args) {
             result.append("Recent Sensor events:\n");
             for (auto&& i : mRecentEvent) {
                 sp<SensorInterface> s = mSensors.getInterface(i.first);
+                i.second->enableHistory();
                 if (!i.second->isEmpty()) {
                     if (privileged || s->getSensor().getRequiredPermission().isEmpty()) {
                         i.second->setFormat("normal");
@@ -464,6 +475,12 @@ status_t SensorService::dump(int fd, const Vector<String16>& args) {
                 }
             }
 
+            result.append("Sensor event latency (HAL timestamp to sensor service):\n");
+            for (const auto& i : mReceiveLatencies) {
+                result.appendFormat("%s (handle=0x%08x): %s\n", getSensorName(i.first).string(),
+                                    i.first, i.second.dump().c_str());
+            }
+
             result.append("Active sensors:\n");
             SensorDevice& dev = SensorDevice::getInstance();
             for (size_t i=0 ; i<mActiveSensors.size() ; i++) {
@@ -570,6 +587,7 @@ status_t SensorService::dumpProtoLocked(int fd, ConnectionSafeAutolock* connLock
     token = proto.start(SENSOR_EVENTS);
     for (auto&& i : mRecentEvent) {
         sp<SensorInterface> s = mSensors.getInterface(i.first);
+        i.second->enableHistory();
         if (!i.second->isEmpty()) {
             i.second->setFormat(privileged || s->getSensor().getRequiredPermission().isEmpty() ?
                     "normal" : "mask_data");
@@ -891,34 +909,50 @@ bool SensorService::threadLoop() {
             device.writeWakeLockHandled(wakeEvents);
         }
         recordLastValueLocked(mSensorEventBuffer, count);
+        recordReceiveLatenciesLocked(mSensorEventBuffer, count);
 
         // handle virtual sensors
         if (count && vcount) {
             sensors_event_t const * const event = mSensorEventBuffer;
-            if (!mActiveVirtualSensors.empty()) {
+            if (!mActiveVirtualSensors.empty() || !mDirectVirtualSensorCounts.empty()) {
                 size_t k = 0;
                 SensorFusion& fusion(SensorFusion::getInstance());
                 if (fusion.isEnabled()) {
-                    for (size_t i=0 ; i<size_t(count) ; i++) {
-                        fusion.process(event[i]);
+                    fusion.process(event, size_t(count));
+                }
+                mActiveVirtualSensorInterfaces.clear();
+                for (int handle : mActiveVirtualSensors) {
+                    VirtualSensor* vs = asVirtualSensor(mSensors.getInterface(handle));
+                    if (vs == nullptr) {
+                        ALOGE("handle %d is not an valid virtual sensor", handle);
+                        continue;
+                    }
+                    mActiveVirtualSensorInterfaces.push_back(vs);
+                }
+                for (const auto& [handle, numChannels] : mDirectVirtualSensorCounts) {
+                    if (mActiveVirtualSensors.count(handle) != 0) {
+                        continue;
+                    }
+                    if (VirtualSensor* vs = asVirtualSensor(mSensors.getInterface(handle))) {
+                        mActiveVirtualSensorInterfaces.push_back(vs);
                     }
                 }
                 for (size_t i=0 ; i<size_t(count) && k<minBufferSize ; i++) {
-                    for (int handle : mActiveVirtualSensors) {
+                    for (VirtualSensor* vs : mActiveVirtualSensorInterfaces) {
                         if (count + k >= minBufferSize) {
                             ALOGE("buffer too small to hold all events: "
                                     "count=%zd, k=%zu, size=%zu",
                                     count, k, minBufferSize);
                             break;
                         }
-                        sensors_event_t out;
-                        sp<SensorInterface> si = mSensors.getInterface(handle);
-                        if (si == nullptr) {
-                            ALOGE("handle %d is not an valid virtual sensor", handle);
+                        // The fusion itself has to see every event, but the virtual sensor's
+                        // own events are only computed as often as its clients want them.
+                        if (!vs->isEventDue(event[i].timestamp)) {
                             continue;
                         }
-
-                        if (si->process(&out, event[i])) {
+                        sensors_event_t out;
+                        if (vs->process(&out, event[i])) {
+                            vs->onEventComputed(event[i].timestamp);
                             mSensorEventBuffer[count + k] = out;
                             k++;
                         }
@@ -931,6 +965,12 @@ bool SensorService::threadLoop() {
                     // sort the buffer by time-stamps
                     sortEventBuffer(mSensorEventBuffer, count);
                 }
+                if (!mDirectVirtualSensorCounts.empty()) {
+                    for (const sp<SensorDirectConnection>& conn :
+                            connLock.getDirectConnections()) {
+                        conn->writeVirtualSensorEventsLocked(mSensorEventBuffer, count);
+                    }
+                }
             }
         }
 
@@ -1007,12 +1047,40 @@ bool SensorService::threadLoop() {
             }
         }
 
+        // Sort the events out by connection once, instead of having every connection go through
+        // all of them looking for the few sensors it registered for.
+        for (auto& [handle, connectionIndices] : mConnectionIndicesBySensor) {
+            connectionIndices.clear();
+        }
+        if (mEventIndicesByConnection.size() < activeConnections.size()) {
+            mEventIndicesByConnection.resize(activeConnections.size());
+        }
+        for (size_t c = 0; c < activeConnections.size(); ++c) {
+            mEventIndicesByConnection[c].clear();
+            for (int32_t handle : activeConnections[c]->getActiveSensorHandles()) {
+                mConnectionIndicesBySensor[handle].push_back(c);
+            }
+        }
+        for (int i = 0; i < count; ++i) {
+            // Flush complete events carry their sensor in meta_data.
+            const int32_t handle = mSensorEventBuffer[i].type == SENSOR_TYPE_META_DATA
+                    ? mSensorEventBuffer[i].meta_data.sensor
+                    : mSensorEventBuffer[i].sensor;
+            auto it = mConnectionIndicesBySensor.find(handle);
+            if (it != mConnectionIndicesBySensor.end()) {
+                for (size_t c : it->second) {
+                    mEventIndicesByConnection[c].push_back(i);
+                }
+            }
+        }
+
         // Send our events to clients. Check the state of wake lock for each client and release the
         // lock if none of the clients need it.
         bool needsWakeLock = false;
-        for (const sp<SensorEventConnection>& connection : activeConnections) {
+        for (size_t c = 0; c < activeConnections.size(); ++c) {
+            const sp<SensorEventConnection>& connection = activeConnections[c];
             connection->sendEvents(mSensorEventBuffer, count, mSensorEventScratch,
-                    mMapFlushEventsToConnections);
+                    mMapFlushEventsToConnections, &mEventIndicesByConnection[c]);
             needsWakeLock |= connection->needsWakeLock();
             // If the connection has one-shot sensors, it may be cleaned up after first trigger.
             // Early check for one-shot sensors.
@@ -1094,6 +1162,26 @@ void SensorService::recordLastValueLocked(
     }
 }
 
+void SensorService::recordReceiveLatenciesLocked(
+        const sensors_event_t* buffer, size_t count) {
+    const nsecs_t now = systemTime(SYSTEM_TIME_BOOTTIME);
+    SensorServiceUtil::LatencyHistogram* latencies = nullptr;
+    int32_t handle = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (buffer[i].type == SENSOR_TYPE_META_DATA ||
+            buffer[i].type == SENSOR_TYPE_DYNAMIC_SENSOR_META ||
+            buffer[i].type == SENSOR_TYPE_ADDITIONAL_INFO) {
+            continue;
+        }
+        // Events mostly come in runs from the same sensor.
+        if (latencies == nullptr || buffer[i].sensor != handle) {
+            handle = buffer[i].sensor;
+            latencies = &mReceiveLatencies[handle];
+        }
+        latencies->record(now - buffer[i].timestamp);
+    }
+}
+
 void SensorService::sortEventBuffer(sensors_event_t* buffer, size_t count) {
     struct compar {
         static int cmp(void const* lhs, void const* rhs) {
@@ -1352,9 +1440,15 @@ sp<ISensorEventConnection> SensorService::createSensorDirectConnection(
     SensorDevice& dev(SensorDevice::getInstance());
     int channelHandle = dev.registerDirectChannel(&mem);
 
-    if (channelHandle <= 0) {
+    if (channelHandle <= 0 && type != SENSOR_DIRECT_MEM_TYPE_ASHMEM) {
         ALOGE("SensorDevice::registerDirectChannel returns %d", channelHandle);
     } else {
+        if (channelHandle <= 0) {
+            // SensorService can still write the events of virtual sensors into ashmem itself.
+            ALOGD_IF(DEBUG_CONNECTIONS, "SensorDevice::registerDirectChannel returns %d, "
+                     "only virtual sensors can be reported", channelHandle);
+            channelHandle = -1;
+        }
         mem.handle = clone;
         conn = new SensorDirectConnection(this, uid, &mem, channelHandle, opPackageName);
     }
@@ -1488,6 +1582,9 @@ void SensorService::cleanupConnection(SensorEventConnection* c) {
             sp<SensorInterface> sensor = getSensorInterfaceFromHandle(handle);
             if (sensor != nullptr) {
                 sensor->activate(c, false);
+                if (VirtualSensor* vs = asVirtualSensor(sensor)) {
+                    vs->removeRequestedPeriod(c);
+                }
             } else {
                 ALOGE("sensor interface of handle=0x%08x is null!", handle);
             }
@@ -1531,8 +1628,10 @@ void SensorService::cleanupConnection(SensorEventConnection* c) {
 void SensorService::cleanupConnection(SensorDirectConnection* c) {
     Mutex::Autolock _l(mLock);
 
-    SensorDevice& dev(SensorDevice::getInstance());
-    dev.unregisterDirectChannel(c->getHalChannelHandle());
+    if (c->getHalChannelHandle() > 0) {
+        SensorDevice& dev(SensorDevice::getInstance());
+        dev.unregisterDirectChannel(c->getHalChannelHandle());
+    }
     mConnectionHolder.removeDirectConnection(c);
 }
 
@@ -1639,6 +1738,9 @@ status_t SensorService::enable(const sp<SensorEventConnection>& connection,
 
     status_t err = sensor->batch(connection.get(), handle, 0, samplingPeriodNs,
                                  maxBatchReportLatencyNs);
+    if (err == NO_ERROR) {
+        connection->setMaxBatchReportLatency(handle, maxBatchReportLatencyNs);
+    }
 
     // Call flush() before calling activate() on the sensor. Wait for a first
     // flush complete event before sending events on this connection. Ignore
@@ -1667,6 +1769,10 @@ status_t SensorService::enable(const sp<SensorEventConnection>& connection,
     if (err == NO_ERROR) {
         connection->updateLooperRegistration(mLooper);
 
+        if (VirtualSensor* vs = asVirtualSensor(sensor)) {
+            vs->setRequestedPeriod(connection.get(), samplingPeriodNs);
+        }
+
         if (sensor->getSensor().getRequiredPermission().size() > 0 &&
                 sensor->getSensor().getRequiredAppOp() >= 0) {
             connection->mHandleToAppOp[handle] = sensor->getSensor().getRequiredAppOp();
@@ -1694,7 +1800,9 @@ status_t SensorService::disable(const sp<SensorEventConnection>& connection, int
     if (err == NO_ERROR) {
         sp<SensorInterface> sensor = getSensorInterfaceFromHandle(handle);
         err = sensor != nullptr ? sensor->activate(connection.get(), false) : status_t(BAD_VALUE);
-
+        if (VirtualSensor* vs = asVirtualSensor(sensor)) {
+            vs->removeRequestedPeriod(connection.get());
+        }
     }
     if (err == NO_ERROR) {
         mLastNSensorRegistrations.editItemAt(mNextSensorRegIndex) =
@@ -1752,7 +1860,12 @@ status_t SensorService::setEventRate(const sp<SensorEventConnection>& connection
         ns = minDelayNs;
     }
 
-    return sensor->setDelay(connection.get(), handle, ns);
+    status_t err = sensor->setDelay(connection.get(), handle, ns);
+    VirtualSensor* vs = asVirtualSensor(sensor);
+    if (err == NO_ERROR && vs != nullptr && connection->hasSensor(handle)) {
+        vs->setRequestedPeriod(connection.get(), ns);
+    }
+    return err;
 }
 
 status_t SensorService::flushSensor(const sp<SensorEventConnection>& connection,
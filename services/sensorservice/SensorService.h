@@ -17,6 +17,7 @@
 #ifndef ANDROID_SENSOR_SERVICE_H
 #define ANDROID_SENSOR_SERVICE_H
 
+#include "LatencyHistogram.h"
 #include "SensorList.h"
 #include "RecentEventLogger.h"
 
@@ -64,6 +65,7 @@
 namespace android {
 // ---------------------------------------------------------------------------
 class SensorInterface;
+class VirtualSensor;
 
 class SensorService :
         public BinderService<SensorService>,
@@ -299,6 +301,7 @@ private:
     sp<SensorInterface> getSensorInterfaceFromHandle(int handle) const;
     bool isWakeUpSensor(int type) const;
     void recordLastValueLocked(sensors_event_t const* buffer, size_t count);
+    void recordReceiveLatenciesLocked(sensors_event_t const* buffer, size_t count);
     static void sortEventBuffer(sensors_event_t* buffer, size_t count);
     const Sensor& registerSensor(SensorInterface* sensor,
                                  bool isDebug = false, bool isVirtual = false);
@@ -400,13 +403,24 @@ private:
     mutable Mutex mLock;
     DefaultKeyedVector<int, SensorRecord*> mActiveSensors;
     std::unordered_set<int> mActiveVirtualSensors;
+    // How many direct channels report each virtual sensor; SensorService writes those reports.
+    std::unordered_map<int, int> mDirectVirtualSensorCounts;
     SensorConnectionHolder mConnectionHolder;
     bool mWakeLockAcquired;
     sensors_event_t *mSensorEventBuffer, *mSensorEventScratch;
     // WARNING: these SensorEventConnection instances must not be promoted to sp, except via
     // modification to add support for them in ConnectionSafeAutolock
     wp<const SensorEventConnection> * mMapFlushEventsToConnections;
+    // Rebuilt on every poll, but kept around so their storage is reused: the positions in the
+    // list of active connections of each sensor's clients, and the positions in
+    // mSensorEventBuffer of the events each active connection will be handed.
+    std::unordered_map<int32_t, std::vector<size_t>> mConnectionIndicesBySensor;
+    std::vector<std::vector<size_t>> mEventIndicesByConnection;
+    // Likewise, the interfaces of mActiveVirtualSensors, looked up once per poll.
+    std::vector<VirtualSensor*> mActiveVirtualSensorInterfaces;
     std::unordered_map<int, SensorServiceUtil::RecentEventLogger*> mRecentEvent;
+    // The time from the HAL timestamp of each sensor's events to their arrival in threadLoop.
+    std::unordered_map<int, SensorServiceUtil::LatencyHistogram> mReceiveLatencies;
     Mode mCurrentOperatingMode;
 
     // This packagaName is set when SensorService is in RESTRICTED or DATA_INJECTION mode. Only
@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <android/sensor.h>
+#include <hardware/sensors.h>
+#include <math.h>
+#include <sensor/BitTube.h>
+#include <sensor/SensorEventQueue.h>
+#include <sensor/SensorEventRing.h>
+#include <stdlib.h>
+#include <utils/Timers.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "../Fusion.h"
+
+namespace android {
+
+// Arbitrary handles for the physical sensors, the virtual ones follow.
+static const int32_t ACCELEROMETER_HANDLE = 1;
+static const int32_t GYROSCOPE_HANDLE = 2;
+static const int32_t MAGNETOMETER_HANDLE = 3;
+static const int32_t FIRST_VIRTUAL_SENSOR_HANDLE = 100;
+
+// The magnetometer keeps its usual rate whatever the rate of the IMU.
+static const int MAGNETOMETER_RATE_HZ = 50;
+static const nsecs_t STREAM_DURATION_NS = 2000000000LL;
+
+// As large as SensorService's own event buffer.
+static const size_t MAX_EVENTS_PER_POLL = 256;
+
+static nsecs_t now() {
+    return systemTime(SYSTEM_TIME_BOOTTIME);
+}
+
+// --- Recorded streams ---
+
+// Sensor noise that is the same on every run.
+class Noise {
+public:
+    float next(float amplitude) {
+        mState = mState * 1103515245u + 12345u;
+        return amplitude * (float(mState >> 8) / float(1 << 24) - 0.5f);
+    }
+
+private:
+    uint32_t mState = 1;
+};
+
+static sensors_event_t makeEvent(int32_t handle, int32_t type, nsecs_t timestamp, float x,
+                                 float y, float z) {
+    sensors_event_t event = {};
+    event.version = sizeof(sensors_event_t);
+    event.sensor = handle;
+    event.type = type;
+    event.timestamp = timestamp;
+    event.data[0] = x;
+    event.data[1] = y;
+    event.data[2] = z;
+    return event;
+}
+
+/**
+ * What the IMU of a phone that is turned around and tilted back and forth in a hand reports:
+ * accelerometer and gyroscope samples at rateHz and magnetometer samples at MAGNETOMETER_RATE_HZ,
+ * in timestamp order.
+ */
+static std::vector<sensors_event_t> recordImuStream(int rateHz) {
+    std::vector<sensors_event_t> stream;
+    Noise noise;
+    const nsecs_t periodNs = 1000000000LL / rateHz;
+    const nsecs_t magnetometerPeriodNs = 1000000000LL / MAGNETOMETER_RATE_HZ;
+    nsecs_t nextMagnetometerTimestamp = 0;
+    for (nsecs_t timestamp = 0; timestamp < STREAM_DURATION_NS; timestamp += periodNs) {
+        const float t = timestamp / 1e9f;
+        const float yaw = 1 - cosf(t);
+        const float yawRate = sinf(t);
+        const float pitch = 0.3f * sinf(2 * t);
+        const float pitchRate = 0.6f * cosf(2 * t);
+
+        stream.push_back(makeEvent(ACCELEROMETER_HANDLE, SENSOR_TYPE_ACCELEROMETER, timestamp,
+                                   noise.next(0.1f),
+                                   9.81f * sinf(pitch) + noise.next(0.1f),
+                                   9.81f * cosf(pitch) + noise.next(0.1f)));
+        stream.push_back(makeEvent(GYROSCOPE_HANDLE, SENSOR_TYPE_GYROSCOPE, timestamp,
+                                   pitchRate + noise.next(0.02f),
+                                   noise.next(0.02f),
+                                   yawRate + noise.next(0.02f)));
+        if (timestamp >= nextMagnetometerTimestamp) {
+            stream.push_back(makeEvent(MAGNETOMETER_HANDLE, SENSOR_TYPE_MAGNETIC_FIELD,
+                                       timestamp,
+                                       30 * cosf(yaw) + noise.next(1),
+                                       -30 * sinf(yaw) + noise.next(1),
+                                       -40 + noise.next(1)));
+            nextMagnetometerTimestamp += magnetometerPeriodNs;
+        }
+    }
+    return stream;
+}
+
+// --- FakeSensorDevice ---
+
+/**
+ * Replays a recorded stream like SensorDevice::poll() returns events from a HAL that does not
+ * batch: all the samples of one timestamp per poll. The stream loops, with timestamps that keep
+ * going up.
+ */
+class FakeSensorDevice {
+public:
+    explicit FakeSensorDevice(std::vector<sensors_event_t> stream)
+          : mStream(std::move(stream)), mNext(0), mTimestampOffset(0) {}
+
+    size_t poll(sensors_event_t* buffer, size_t count) {
+        if (mNext == mStream.size()) {
+            mNext = 0;
+            mTimestampOffset += STREAM_DURATION_NS;
+        }
+        const nsecs_t timestamp = mStream[mNext].timestamp;
+        size_t n = 0;
+        while (n < count && mNext < mStream.size() && mStream[mNext].timestamp == timestamp) {
+            buffer[n] = mStream[mNext++];
+            buffer[n].timestamp += mTimestampOffset;
+            n++;
+        }
+        return n;
+    }
+
+private:
+    const std::vector<sensors_event_t> mStream;
+    size_t mNext;
+    nsecs_t mTimestampOffset;
+};
+
+// --- BenchmarkSensorService ---
+
+/**
+ * Does what SensorService::threadLoop() does with each poll: it runs the fusion of the virtual
+ * sensors, appends their events, sorts the events and hands them to each connection, whose app
+ * then reads them right away. Every connection listens to every sensor.
+ */
+class BenchmarkSensorService {
+public:
+    BenchmarkSensorService(FakeSensorDevice* device, int connectionCount, int virtualSensorCount,
+                           bool useEventRings)
+          : mDevice(device), mBuffer(MAX_EVENTS_PER_POLL), mReadBuffer(MAX_EVENTS_PER_POLL),
+            mGyroTime(0), mAccelerometerTime(0) {
+        // The rotation vector, game rotation vector and geomagnetic rotation vector in turn.
+        mFusions.resize(virtualSensorCount);
+        for (int i = 0; i < virtualSensorCount; i++) {
+            mFusions[i].init(i % NUM_FUSION_MODE);
+        }
+        for (int i = 0; i < connectionCount; i++) {
+            Connection connection;
+            // The size SensorService uses when nothing batches.
+            connection.tube = new BitTube();
+            if (useEventRings) {
+                connection.ring = SensorEventRing::create();
+            }
+            mConnections.push_back(connection);
+        }
+    }
+
+    // Returns the number of events polled from the device.
+    size_t loopOnce() {
+        size_t count = mDevice->poll(mBuffer.data(), mBuffer.size() / (1 + mFusions.size()));
+        const size_t polled = count;
+        const nsecs_t pollTime = now();
+
+        if (!mFusions.empty()) {
+            const size_t physicalCount = count;
+            for (size_t i = 0; i < physicalCount; i++) {
+                if (processEvent(mBuffer[i])) {
+                    for (size_t j = 0; j < mFusions.size(); j++) {
+                        const vec4_t q(mFusions[j].getAttitude());
+                        sensors_event_t& out = mBuffer[count++];
+                        out = mBuffer[i];
+                        out.sensor = FIRST_VIRTUAL_SENSOR_HANDLE + int32_t(j);
+                        out.type = SENSOR_TYPE_ROTATION_VECTOR;
+                        out.data[0] = q.x;
+                        out.data[1] = q.y;
+                        out.data[2] = q.z;
+                        out.data[3] = q.w;
+                    }
+                }
+            }
+            qsort(mBuffer.data(), count, sizeof(sensors_event_t), compareTimestamps);
+        }
+
+        const ASensorEvent* events = reinterpret_cast<const ASensorEvent*>(mBuffer.data());
+        for (Connection& connection : mConnections) {
+            if (connection.ring != nullptr) {
+                bool needsDoorbell = false;
+                connection.ring->write(events, count, &needsDoorbell);
+                if (needsDoorbell) {
+                    SensorEventQueue::write(connection.tube, events, 1);
+                }
+            } else {
+                SensorEventQueue::write(connection.tube, events, count);
+            }
+        }
+
+        for (Connection& connection : mConnections) {
+            readEvents(connection, pollTime);
+        }
+        return polled;
+    }
+
+    nsecs_t getMeanLatency() const {
+        return mLatencySamples > 0 ? mLatencySum / mLatencySamples : 0;
+    }
+    nsecs_t getMaxLatency() const { return mMaxLatency; }
+
+private:
+    struct Connection {
+        sp<BitTube> tube;
+        sp<SensorEventRing> ring;
+    };
+
+    static int compareTimestamps(const void* lhs, const void* rhs) {
+        const nsecs_t l = static_cast<const sensors_event_t*>(lhs)->timestamp;
+        const nsecs_t r = static_cast<const sensors_event_t*>(rhs)->timestamp;
+        return l < r ? -1 : (l > r ? 1 : 0);
+    }
+
+    // Feeds the event to each fusion like SensorFusion does. Returns true if the attitudes were
+    // updated, which is when the virtual sensors report.
+    bool processEvent(const sensors_event_t& event) {
+        if (event.type == SENSOR_TYPE_GYROSCOPE) {
+            if (event.timestamp - mGyroTime > 0 && event.timestamp - mGyroTime < 50000000) {
+                const float dT = (event.timestamp - mGyroTime) / 1e9f;
+                for (Fusion& fusion : mFusions) {
+                    fusion.handleGyro(vec3_t(event.data), dT);
+                }
+            }
+            mGyroTime = event.timestamp;
+        } else if (event.type == SENSOR_TYPE_MAGNETIC_FIELD) {
+            for (Fusion& fusion : mFusions) {
+                fusion.handleMag(vec3_t(event.data));
+            }
+        } else if (event.type == SENSOR_TYPE_ACCELEROMETER) {
+            const bool hasPrevious = event.timestamp - mAccelerometerTime > 0 &&
+                    event.timestamp - mAccelerometerTime < 100000000;
+            if (hasPrevious) {
+                const float dT = (event.timestamp - mAccelerometerTime) / 1e9f;
+                for (Fusion& fusion : mFusions) {
+                    fusion.handleAcc(vec3_t(event.data), dT);
+                }
+            }
+            mAccelerometerTime = event.timestamp;
+            return hasPrevious;
+        }
+        return false;
+    }
+
+    void readEvents(Connection& connection, nsecs_t pollTime) {
+        ASensorEvent* events = reinterpret_cast<ASensorEvent*>(mReadBuffer.data());
+        ssize_t count;
+        if (connection.ring != nullptr) {
+            // Drain the doorbells, as SensorEventQueue does before reading the ring.
+            while (BitTube::recvObjects(connection.tube, events, mReadBuffer.size()) > 0) {
+            }
+            bool writerWasBlocked = false;
+            count = connection.ring->read(events, mReadBuffer.size(), &writerWasBlocked);
+        } else {
+            count = BitTube::recvObjects(connection.tube, events, mReadBuffer.size());
+        }
+        if (count > 0) {
+            const nsecs_t latency = now() - pollTime;
+            mLatencySum += latency * count;
+            mLatencySamples += count;
+            mMaxLatency = std::max(mMaxLatency, latency);
+        }
+    }
+
+    FakeSensorDevice* const mDevice;
+    std::vector<sensors_event_t> mBuffer;
+    std::vector<sensors_event_t> mReadBuffer;
+    std::vector<Fusion> mFusions;
+    std::vector<Connection> mConnections;
+    nsecs_t mGyroTime;
+    nsecs_t mAccelerometerTime;
+    nsecs_t mLatencySum = 0;
+    int64_t mLatencySamples = 0;
+    nsecs_t mMaxLatency = 0;
+};
+
+// --- Benchmarks ---
+
+/**
+ * Replay a stream at state.range(0) Hz to state.range(1) connections with state.range(2) virtual
+ * sensors, and report the time spent per polled event and the mean and worst time from poll to
+ * the app's read. The app reads on the same thread, after SensorService wrote to every
+ * connection, so the latencies include the whole fan-out.
+ */
+static void benchmarkReplay(benchmark::State& state, bool useEventRings) {
+    FakeSensorDevice device(recordImuStream(state.range(0)));
+    BenchmarkSensorService service(&device, state.range(1), state.range(2), useEventRings);
+
+    int64_t events = 0;
+    const nsecs_t startTime = now();
+    for (auto _ : state) {
+        events += service.loopOnce();
+    }
+    const nsecs_t elapsed = now() - startTime;
+
+    state.SetItemsProcessed(events);
+    if (events > 0) {
+        state.counters["ns/event"] = double(elapsed) / events;
+        state.counters["latency_us"] = service.getMeanLatency() / 1e3;
+        state.counters["max_latency_us"] = service.getMaxLatency() / 1e3;
+    }
+}
+
+static void benchmarkReplay_Socket(benchmark::State& state) {
+    benchmarkReplay(state, false /*useEventRings*/);
+}
+
+static void benchmarkReplay_EventRing(benchmark::State& state) {
+    benchmarkReplay(state, true /*useEventRings*/);
+}
+
+// Arguments are the IMU rate, the number of connections and the number of virtual sensors.
+static void replayArguments(benchmark::internal::Benchmark* benchmark) {
+    for (int rateHz : {200, 1000}) {
+        for (int connections : {1, 4, 16}) {
+            for (int virtualSensors : {0, 3}) {
+                benchmark->Args({rateHz, connections, virtualSensors});
+            }
+        }
+    }
+}
+
+BENCHMARK(benchmarkReplay_Socket)->Apply(replayArguments);
+BENCHMARK(benchmarkReplay_EventRing)->Apply(replayArguments);
+
+} // namespace android
+
+BENCHMARK_MAIN();
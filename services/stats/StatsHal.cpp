@@ -28,7 +28,64 @@ namespace stats {
 namespace V1_0 {
 namespace implementation {
 
-StatsHal::StatsHal() {}
+StatsHal::StatsHal() {
+    mPendingEvents.reserve(kMaxPendingEvents);
+    mWriterThread = std::thread(&StatsHal::writerMain, this);
+}
+
+StatsHal::~StatsHal() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mRunning = false;
+    }
+    mCondition.notify_one();
+    mWriterThread.join();
+}
+
+void StatsHal::enqueueEvent(AStatsEvent* event) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mPendingEvents.size() < kMaxPendingEvents) {
+            mPendingEvents.push_back(event);
+            event = nullptr;
+        } else {
+            mDroppedEvents++;
+        }
+    }
+    if (event) {
+        AStatsEvent_release(event);
+        return;
+    }
+    mCondition.notify_one();
+}
+
+void StatsHal::writerMain() {
+    std::vector<AStatsEvent*> events;
+    events.reserve(kMaxPendingEvents);
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this] { return !mRunning || !mPendingEvents.empty(); });
+        if (mPendingEvents.empty()) {
+            // Only stops once every queued event has been written.
+            return;
+        }
+        events.swap(mPendingEvents);
+        const size_t droppedEvents = mDroppedEvents;
+        mDroppedEvents = 0;
+        lock.unlock();
+
+        if (droppedEvents > 0) {
+            ALOGE("Dropped %zu vendor atoms while statsd was busy", droppedEvents);
+        }
+        for (AStatsEvent* event : events) {
+            AStatsEvent_write(event);
+            AStatsEvent_release(event);
+        }
+        events.clear();
+
+        lock.lock();
+    }
+}
 
 hardware::Return<void> StatsHal::reportSpeakerImpedance(
         const SpeakerImpedance& speakerImpedance) {
@@ -141,8 +198,7 @@ hardware::Return<void> StatsHal::reportVendorAtom(const VendorAtom& vendorAtom)
         }
     }
     AStatsEvent_build(event);
-    AStatsEvent_write(event);
-    AStatsEvent_release(event);
+    enqueueEvent(event);
 
     return hardware::Void();
 }
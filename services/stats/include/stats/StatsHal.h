@@ -19,6 +19,11 @@
 
 #include <stats_event.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 using namespace android::frameworks::stats::V1_0;
 
 namespace android {
@@ -35,6 +40,7 @@ using android::hardware::Return;
 class StatsHal : public IStats {
 public:
     StatsHal();
+    ~StatsHal();
 
     /**
      * Binder call to get SpeakerImpedance atom.
@@ -90,6 +96,35 @@ public:
      * Binder call to get vendor atom.
      */
     virtual Return<void> reportVendorAtom(const VendorAtom& vendorAtom) override;
+
+private:
+    /**
+     * Maximum number of vendor atoms waiting to be written to statsd. Atoms
+     * reported while the queue is full are dropped.
+     */
+    static constexpr size_t kMaxPendingEvents = 1000;
+
+    /**
+     * Queues a built event for the writer thread, which owns it from then on.
+     */
+    void enqueueEvent(AStatsEvent* event);
+
+    /**
+     * Writes the queued events to statsd, so that binder threads only build
+     * them and never wait on the statsd socket.
+     */
+    void writerMain();
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mRunning = true;
+    /**
+     * Swapped with the writer thread's own vector on each batch, and both
+     * are reserved to kMaxPendingEvents, so queueing never allocates.
+     */
+    std::vector<AStatsEvent*> mPendingEvents;
+    size_t mDroppedEvents = 0;
+    std::thread mWriterThread;
 };
 
 }  // namespace implementation
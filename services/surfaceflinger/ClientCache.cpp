@@ -21,10 +21,14 @@
 
 #include <cinttypes>
 
+#include <android-base/stringprintf.h>
+
 #include "ClientCache.h"
 
 namespace android {
 
+using base::StringAppendF;
+
 ANDROID_SINGLETON_STATIC_INSTANCE(ClientCache);
 
 ClientCache::ClientCache() : mDeathRecipient(new CacheDeathRecipient) {}
@@ -42,7 +46,7 @@ bool ClientCache::getBuffer(const client_cache_t& cacheId,
         return false;
     }
 
-    auto& processBuffers = it->second.second;
+    auto& processBuffers = it->second.buffers;
 
     auto bufItr = processBuffers.find(id);
     if (bufItr == processBuffers.end()) {
@@ -85,22 +89,21 @@ bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& bu
             ALOGE("failed to cache buffer: could not link to death");
             return false;
         }
-        auto [itr, success] =
-                mBuffers.emplace(processToken,
-                                 std::make_pair(token,
-                                                std::unordered_map<uint64_t, ClientCacheBuffer>()));
+        auto [itr, success] = mBuffers.emplace(processToken, ProcessBuffers{token, {}, {}});
         LOG_ALWAYS_FATAL_IF(!success, "failed to insert new process into client cache");
         it = itr;
     }
 
-    auto& processBuffers = it->second.second;
+    auto& processBuffers = it->second.buffers;
 
     if (processBuffers.size() > BUFFER_CACHE_MAX_SIZE) {
         ALOGE("failed to cache buffer: cache is full");
+        it->second.stats.rejected++;
         return false;
     }
 
     processBuffers[id].buffer = buffer;
+    it->second.stats.inserts++;
     return true;
 }
 
@@ -122,7 +125,9 @@ void ClientCache::erase(const client_cache_t& cacheId) {
             }
         }
 
-        mBuffers[processToken].second.erase(id);
+        ProcessBuffers& process = mBuffers[processToken];
+        process.buffers.erase(id);
+        process.stats.evictions++;
     }
 
     for (auto& recipient : pendingErase) {
@@ -136,9 +141,13 @@ sp<GraphicBuffer> ClientCache::get(const client_cache_t& cacheId) {
     ClientCacheBuffer* buf = nullptr;
     if (!getBuffer(cacheId, &buf)) {
         ALOGE("failed to get buffer, could not retrieve buffer");
+        if (auto it = mBuffers.find(cacheId.token); it != mBuffers.end()) {
+            it->second.stats.misses++;
+        }
         return nullptr;
     }
 
+    mBuffers[cacheId.token].stats.hits++;
     return buf->buffer;
 }
 
@@ -182,7 +191,7 @@ void ClientCache::removeProcess(const wp<IBinder>& processToken) {
             return;
         }
 
-        for (auto& [id, clientCacheBuffer] : itr->second.second) {
+        for (auto& [id, clientCacheBuffer] : itr->second.buffers) {
             client_cache_t cacheId = {processToken, id};
             for (auto& recipient : clientCacheBuffer.recipients) {
                 sp<ErasedRecipient> erasedRecipient = recipient.promote();
@@ -199,6 +208,23 @@ void ClientCache::removeProcess(const wp<IBinder>& processToken) {
     }
 }
 
+void ClientCache::dump(std::string& result) {
+    std::lock_guard lock(mMutex);
+    StringAppendF(&result, "Client buffer cache (%zu processes, max %d buffers each)\n",
+                  mBuffers.size(), BUFFER_CACHE_MAX_SIZE);
+    for (const auto& [processToken, process] : mBuffers) {
+        const ClientCacheStats& stats = process.stats;
+        const uint64_t lookups = stats.hits + stats.inserts;
+        StringAppendF(&result,
+                      "  process %p: cached=%zu hits=%" PRIu64 " inserts=%" PRIu64
+                      " misses=%" PRIu64 " evictions=%" PRIu64 " rejected=%" PRIu64
+                      " hit rate=%.1f%%\n",
+                      process.token.get(), process.buffers.size(), stats.hits, stats.inserts,
+                      stats.misses, stats.evictions, stats.rejected,
+                      lookups ? 100.0 * stats.hits / lookups : 0.0);
+    }
+}
+
 void ClientCache::CacheDeathRecipient::binderDied(const wp<IBinder>& who) {
     ClientCache::getInstance().removeProcess(who);
 }
@@ -26,6 +26,7 @@
 #include <map>
 #include <mutex>
 #include <set>
+#include <string>
 #include <unordered_map>
 
 #define BUFFER_CACHE_MAX_SIZE 64
@@ -53,6 +54,8 @@ public:
     void unregisterErasedRecipient(const client_cache_t& cacheId,
                                    const wp<ErasedRecipient>& recipient);
 
+    void dump(std::string& result);
+
 private:
     std::mutex mMutex;
 
@@ -60,10 +63,24 @@ private:
         sp<GraphicBuffer> buffer;
         std::set<wp<ErasedRecipient>> recipients;
     };
-    std::map<wp<IBinder> /*caching process*/,
-             std::pair<sp<IBinder> /*strong ref to caching process*/,
-                       std::unordered_map<uint64_t /*cache id*/, ClientCacheBuffer>>>
-            mBuffers GUARDED_BY(mMutex);
+
+    // Clients evict on their side and tell us through erase(), so these mirror
+    // how well each client's cache is working: a hit is a frame that didn't
+    // carry its GraphicBuffer, an insert is one that had to.
+    struct ClientCacheStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t inserts = 0;
+        uint64_t evictions = 0;
+        uint64_t rejected = 0;
+    };
+
+    struct ProcessBuffers {
+        sp<IBinder> token; // strong ref to caching process
+        std::unordered_map<uint64_t /*cache id*/, ClientCacheBuffer> buffers;
+        ClientCacheStats stats;
+    };
+    std::map<wp<IBinder> /*caching process*/, ProcessBuffers> mBuffers GUARDED_BY(mMutex);
 
     class CacheDeathRecipient : public IBinder::DeathRecipient {
     public:
@@ -26,6 +26,10 @@
 #include <math/mat4.h>
 #include <ui/Transform.h>
 
+namespace android {
+class PhaseTimings;
+} // namespace android
+
 namespace android::compositionengine {
 
 using Layers = std::vector<sp<compositionengine::LayerFE>>;
@@ -79,6 +83,37 @@ struct CompositionRefreshArgs {
 
     // If set, causes the dirty regions to flash with the delay
     std::optional<std::chrono::microseconds> devOptFlashDirtyRegionsDelay;
+
+    // If true and there are several outputs, the composition state of each
+    // output's layers is computed on worker threads before the outputs are
+    // presented one after another.
+    bool parallelOutputCompositionState{false};
+
+    // If true and there are several outputs, the layers of every output are
+    // written to the HWC before any is presented, and the displays that need
+    // validating are validated together.
+    bool batchHwcValidate{false};
+
+    // If true, each output remembers the coverage computed for its layers when
+    // its geometry is rebuilt, and the next rebuild reuses it for the front
+    // most layers that have not changed since.
+    bool incrementalVisibleRegions{false};
+
+    // If true, runs of layers that have not changed for a while are rendered
+    // once into a buffer that is then presented as a single HWC layer.
+    bool flattenStaticLayers{false};
+
+    // If true, outputs only redraw the part of the client target that changed
+    // since the buffer they are given was last drawn to.
+    bool partialClientComposition{false};
+
+    // If true, outputs whose frame is nothing but one opaque layer drawn as is
+    // over all of it may hand that layer's buffer to their consumer in place of
+    // composing a copy of it. Only virtual displays without HWC support do.
+    bool forwardSingleLayerBuffers{false};
+
+    // If set, the time spent in each phase of the refresh is recorded there.
+    PhaseTimings* phaseTimings{nullptr};
 };
 
 } // namespace android::compositionengine
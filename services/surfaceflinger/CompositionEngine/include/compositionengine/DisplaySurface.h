@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <ui/GraphicTypes.h>
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 #include <utils/StrongPointer.h>
@@ -23,6 +24,7 @@
 namespace android {
 
 class Fence;
+class GraphicBuffer;
 class IGraphicBufferProducer;
 class String8;
 
@@ -74,6 +76,12 @@ public:
     virtual void resizeBuffers(const uint32_t w, const uint32_t h) = 0;
 
     virtual const sp<Fence>& getClientTargetAcquireFence() const = 0;
+
+    // Sends a layer's buffer on to the consumer as this frame, in place of
+    // composing one. Returns false if the surface can't, in which case the
+    // frame is composed as usual.
+    virtual bool forwardBuffer(const sp<GraphicBuffer>& buffer, const sp<Fence>& acquireFence,
+                               ui::Dataspace dataspace) = 0;
 };
 
 } // namespace compositionengine
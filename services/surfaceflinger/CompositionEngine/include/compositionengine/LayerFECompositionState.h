@@ -191,6 +191,10 @@ struct LayerFECompositionState {
 
     virtual ~LayerFECompositionState();
 
+    // One is created with every layer, so they come from the layer ObjectPool.
+    static void* operator new(size_t size);
+    static void operator delete(void* block, size_t size);
+
     // Debugging
     virtual void dump(std::string& out) const;
 };
@@ -248,6 +248,25 @@ public:
     // Presents the output, finalizing all composition details
     virtual void present(const CompositionRefreshArgs&) = 0;
 
+    // present() split in three, for callers that present several outputs
+    // together. beginPresent() picks the color profile, updateCompositionState()
+    // computes the composition state of every output layer, and finishPresent()
+    // does the rest. Only updateCompositionState() may run for different
+    // outputs concurrently, as the other two talk to the HWC and RenderEngine.
+    virtual void beginPresent(const CompositionRefreshArgs&) = 0;
+    virtual void updateCompositionState(const CompositionRefreshArgs&) = 0;
+    virtual void finishPresent(const CompositionRefreshArgs&) = 0;
+
+    // finishPresent() split in two, so the HWC can validate several displays
+    // at once. writeFrame() sends the layer state and color transform to the
+    // HWC, and presentWrittenFrame() validates, composes and presents.
+    virtual void writeFrame(const CompositionRefreshArgs&) = 0;
+    virtual void presentWrittenFrame(const CompositionRefreshArgs&) = 0;
+
+    // Returns the HWC display to validate with the other outputs, if this
+    // output has one and it will not be able to skip validation this frame.
+    virtual std::optional<DisplayId> getDisplayIdToValidate() const = 0;
+
     // Latches the front-end layer state for each output layer
     virtual void updateLayerStateFromFE(const CompositionRefreshArgs&) const = 0;
 
@@ -261,12 +280,14 @@ protected:
     virtual void setReleasedLayers(const CompositionRefreshArgs&) = 0;
 
     virtual void updateAndWriteCompositionState(const CompositionRefreshArgs&) = 0;
+    virtual void writeCompositionState(const CompositionRefreshArgs&) = 0;
     virtual void setColorTransform(const CompositionRefreshArgs&) = 0;
     virtual void updateColorProfile(const CompositionRefreshArgs&) = 0;
     virtual void beginFrame() = 0;
     virtual void prepareFrame() = 0;
     virtual void devOptRepaintFlash(const CompositionRefreshArgs&) = 0;
     virtual void finishFrame(const CompositionRefreshArgs&) = 0;
+    virtual bool forwardLayerBuffer() = 0;
     virtual std::optional<base::unique_fd> composeSurfaces(
             const Region&, const compositionengine::CompositionRefreshArgs& refreshArgs) = 0;
     virtual void postFramebuffer() = 0;
@@ -82,10 +82,20 @@ public:
     // Allocates a buffer as scratch space for GPU composition
     virtual sp<GraphicBuffer> dequeueBuffer(base::unique_fd* bufferFence) = 0;
 
+    // Returns the age of the last dequeued buffer, with the same meaning as
+    // EGL_EXT_buffer_age: 1 if it holds the previous frame, N if it holds the
+    // frame N frames ago, and 0 if its contents are unknown.
+    virtual int getBufferAge() const = 0;
+
     // Queues the drawn buffer for consumption by HWC. readyFence is the fence
     // which will fire when the buffer is ready for consumption.
     virtual void queueBuffer(base::unique_fd readyFence) = 0;
 
+    // Sends a layer's buffer to the consumer as this frame instead of a
+    // composed one. Returns false if the surface can't.
+    virtual bool forwardBuffer(const sp<GraphicBuffer>& buffer, const sp<Fence>& acquireFence,
+                               ui::Dataspace dataspace) = 0;
+
     // Called after the HWC calls are made to present the display
     virtual void onPresentDisplayCompleted() = 0;
 
@@ -17,7 +17,8 @@
 #pragma once
 
 #include <cstdint>
-#include <deque>
+#include <string>
+#include <unordered_map>
 
 #include <compositionengine/LayerFE.h>
 #include <renderengine/DisplaySettings.h>
@@ -37,29 +38,47 @@ namespace compositionengine::impl {
 // the composition request. We need to make sure the request, including the order of the
 // layers, do not change from call to call. The snapshot removes strong references to the
 // client buffer id so we don't extend the lifetime of the buffer by storing it in the cache.
+//
+// Each request also keeps a digest of its contents, so a request that differs from what is in the
+// buffer is usually rejected without comparing every layer. When the cache is full, the request
+// that was least recently looked up is evicted, so a cache at least as large as the number of
+// buffers the RenderSurface rotates through keeps a hit for each of them.
 class ClientCompositionRequestCache {
 public:
     explicit ClientCompositionRequestCache(uint32_t cacheSize) : mMaxCacheSize(cacheSize){};
     ~ClientCompositionRequestCache() = default;
     bool exists(uint64_t bufferId, const renderengine::DisplaySettings& display,
-                const std::vector<LayerFE::LayerSettings>& layerSettings) const;
+                const std::vector<LayerFE::LayerSettings>& layerSettings);
     void add(uint64_t bufferId, const renderengine::DisplaySettings& display,
              const std::vector<LayerFE::LayerSettings>& layerSettings);
     void remove(uint64_t bufferId);
 
+    uint64_t getHitCount() const { return mHitCount; }
+    uint64_t getMissCount() const { return mMissCount; }
+
+    void dump(std::string& out) const;
+
 private:
     uint32_t mMaxCacheSize;
     struct ClientCompositionRequest {
+        size_t digest;
         renderengine::DisplaySettings display;
         std::vector<LayerFE::LayerSettings> layerSettings;
+        uint64_t lastUsed{0};
         ClientCompositionRequest(const renderengine::DisplaySettings& _display,
                                  const std::vector<LayerFE::LayerSettings>& _layerSettings);
-        bool equals(const renderengine::DisplaySettings& _display,
+        bool equals(size_t _digest, const renderengine::DisplaySettings& _display,
                     const std::vector<LayerFE::LayerSettings>& _layerSettings) const;
     };
 
     // Cache of requests, keyed by corresponding GraphicBuffer ID.
-    std::deque<std::pair<uint64_t /* bufferId */, ClientCompositionRequest>> mCache;
+    std::unordered_map<uint64_t /* bufferId */, ClientCompositionRequest> mCache;
+
+    // Incremented on every lookup, to order the requests by when they were last used.
+    uint64_t mUseCounter{0};
+
+    uint64_t mHitCount{0};
+    uint64_t mMissCount{0};
 };
 
 } // namespace compositionengine::impl
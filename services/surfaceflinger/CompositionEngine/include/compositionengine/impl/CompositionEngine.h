@@ -57,11 +57,19 @@ public:
     void setNeedsAnotherUpdateForTest(bool);
 
 private:
+    class OutputWorkers;
+
+    void presentOutputs(CompositionRefreshArgs&);
+    void presentOutputsInParallel(CompositionRefreshArgs&);
+    void presentOutputsWithBatchedValidate(CompositionRefreshArgs&);
+
     std::unique_ptr<HWComposer> mHwComposer;
     std::unique_ptr<renderengine::RenderEngine> mRenderEngine;
     std::shared_ptr<TimeStats> mTimeStats;
     bool mNeedsAnotherUpdate = false;
     nsecs_t mRefreshStartTime = 0;
+    // Created the first time outputs are presented in parallel.
+    std::unique_ptr<OutputWorkers> mOutputWorkers;
 };
 
 std::unique_ptr<compositionengine::CompositionEngine> createCompositionEngine();
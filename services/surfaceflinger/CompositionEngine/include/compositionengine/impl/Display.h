@@ -55,6 +55,7 @@ public:
     compositionengine::Output::FrameFences presentAndGetFrameFences() override;
     void setExpensiveRenderingExpected(bool) override;
     void finishFrame(const CompositionRefreshArgs&) override;
+    std::optional<DisplayId> getDisplayIdToValidate() const override;
 
     // compositionengine::Display overrides
     const std::optional<DisplayId>& getId() const override;
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
@@ -45,9 +46,17 @@ namespace compositionengine::impl {
 //
 // To be able to find out whether a buffer is already in the HAL's cache, we
 // use HWComposerBufferCache to mirror the cache in SF.
+//
+// A buffer already held in any slot is always reused from there. Otherwise it
+// goes to the slot its producer gave it, or, when there is none, to the least
+// recently used slot, so layers without producer slots can still keep several
+// buffers cached.
 class HwcBufferCache {
 public:
-    HwcBufferCache();
+    // slotCount is the number of buffer slots the HAL was asked to keep for
+    // the layer or client target, at most BufferQueue::NUM_BUFFER_SLOTS.
+    explicit HwcBufferCache(uint32_t slotCount = BufferQueue::NUM_BUFFER_SLOTS);
+
     // Given a buffer, return the HWC cache slot and
     // buffer to be sent to HWC.
     //
@@ -56,11 +65,26 @@ public:
     void getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uint32_t* outSlot,
                       sp<GraphicBuffer>* outBuffer);
 
+    void dump(std::string& out) const;
+
 private:
-    // an array where the index corresponds to a slot and the value corresponds to a (counter,
-    // buffer) pair. "counter" is a unique value that indicates the last time this slot was updated
-    // or used and allows us to keep track of the least-recently used buffer.
-    wp<GraphicBuffer> mBuffers[BufferQueue::NUM_BUFFER_SLOTS];
+    struct Slot {
+        wp<GraphicBuffer> buffer;
+        uint64_t bufferId{0};
+        // The value of mUseCounter when the slot was last sent or reused.
+        uint64_t lastUsed{0};
+    };
+
+    uint32_t findLeastRecentlyUsedSlot() const;
+
+    const uint32_t mSlotCount;
+    Slot mSlots[BufferQueue::NUM_BUFFER_SLOTS];
+    uint64_t mUseCounter{0};
+
+    uint64_t mHits{0};
+    uint64_t mMisses{0};
+    // Misses that replaced another buffer still in the slot.
+    uint64_t mEvictions{0};
 };
 
 } // namespace compositionengine::impl
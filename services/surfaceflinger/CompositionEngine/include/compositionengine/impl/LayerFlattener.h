@@ -0,0 +1,97 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <math/vec4.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
+
+namespace android {
+
+namespace renderengine {
+class RenderEngine;
+} // namespace renderengine
+
+namespace compositionengine {
+
+class LayerFE;
+class Output;
+class OutputLayer;
+
+namespace impl {
+
+// Finds the longest run of adjacent output layers whose content has not
+// changed for a while, renders them once into an offscreen buffer, and has the
+// bottom most of them present that buffer to the HWC in place of the whole
+// run. The others are hidden from the HWC until the group breaks up.
+//
+// Only layers the HWC is already compositing itself are considered, so the
+// group never includes secure or protected content, blurs, sideband streams
+// or anything else that needs client composition.
+class LayerFlattener {
+public:
+    // The number of consecutive frames a layer must go unchanged for before it
+    // can be flattened.
+    static constexpr uint32_t kStaticFrameThreshold = 30;
+
+    // The fewest layers worth flattening together.
+    static constexpr size_t kMinGroupSize = 2;
+
+    // Updates the flattened group for this frame, rendering a new buffer if
+    // the group changed. Returns true if any layer started or stopped being
+    // drawn from the buffer, in which case the geometry of every layer needs
+    // to be sent to the HWC again.
+    bool update(Output&, renderengine::RenderEngine&, bool geometryChanged);
+
+    // Stops drawing any layer from the buffer. Returns true if there was a
+    // group.
+    bool clear(Output&);
+
+    void dump(std::string&) const;
+
+private:
+    // What is tracked of each output layer to tell whether it changed.
+    struct LayerRecord {
+        const LayerFE* layerFE{nullptr};
+        uint64_t bufferId{0};
+        sp<Fence> acquireFence;
+        float alpha{1.f};
+        half4 color;
+        uint32_t unchangedFrames{0};
+    };
+
+    bool isEligible(const OutputLayer&, const LayerRecord&) const;
+    bool render(Output&, renderengine::RenderEngine&, const std::vector<OutputLayer*>& group);
+    void clearOverrides(Output&) const;
+
+    std::vector<LayerRecord> mRecords;
+
+    // The layers drawn from mBuffer, back to front.
+    std::vector<const LayerFE*> mGroup;
+    sp<GraphicBuffer> mBuffer;
+    sp<Fence> mBufferFence;
+
+    uint64_t mRenderCount{0};
+};
+
+} // namespace impl
+} // namespace compositionengine
+} // namespace android
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace android::compositionengine::impl {
+
+// A process wide cache of freed blocks, kept in buckets by size, for the per
+// layer objects that are created and destroyed with every surface. A class
+// opts in by routing its operator new and sized operator delete here. As
+// each class always asks for the same size, a block freed by one layer is
+// handed as is to the next, instead of churning and fragmenting the heap.
+//
+// At most kMaxFreeBytesPerBucket of freed blocks are kept per size; beyond
+// that, and for anything larger than kMaxPooledSize, blocks go back to the
+// heap.
+class ObjectPool {
+public:
+    static constexpr size_t kGranularity = 16;
+    static constexpr size_t kMaxPooledSize = 32 * 1024;
+    static constexpr size_t kMaxFreeBytesPerBucket = 128 * 1024;
+
+    struct Stats {
+        size_t liveBlocks{0};
+        size_t liveBytes{0};
+        size_t freeBlocks{0};
+        size_t freeBytes{0};
+        uint64_t hits{0};
+        uint64_t misses{0};
+    };
+
+    static void* allocate(size_t size);
+    // size must be the size the block was allocated with.
+    static void release(void* block, size_t size);
+
+    static Stats getStats();
+    static void dump(std::string& out);
+
+private:
+    ObjectPool() = delete;
+};
+
+} // namespace android::compositionengine::impl
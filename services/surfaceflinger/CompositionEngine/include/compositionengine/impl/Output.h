@@ -19,9 +19,11 @@
 #include <compositionengine/CompositionEngine.h>
 #include <compositionengine/Output.h>
 #include <compositionengine/impl/ClientCompositionRequestCache.h>
+#include <compositionengine/impl/LayerFlattener.h>
 #include <compositionengine/impl/OutputCompositionState.h>
 #include <renderengine/DisplaySettings.h>
 #include <renderengine/LayerSettings.h>
+#include <deque>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -68,6 +70,12 @@ public:
 
     void prepare(const CompositionRefreshArgs&, LayerFESet&) override;
     void present(const CompositionRefreshArgs&) override;
+    void beginPresent(const CompositionRefreshArgs&) override;
+    void updateCompositionState(const CompositionRefreshArgs&) override;
+    void finishPresent(const CompositionRefreshArgs&) override;
+    void writeFrame(const CompositionRefreshArgs&) override;
+    void presentWrittenFrame(const CompositionRefreshArgs&) override;
+    std::optional<DisplayId> getDisplayIdToValidate() const override;
 
     void rebuildLayerStacks(const CompositionRefreshArgs&, LayerFESet&) override;
     void collectVisibleLayers(const CompositionRefreshArgs&,
@@ -78,11 +86,13 @@ public:
 
     void updateLayerStateFromFE(const CompositionRefreshArgs&) const override;
     void updateAndWriteCompositionState(const compositionengine::CompositionRefreshArgs&) override;
+    void writeCompositionState(const compositionengine::CompositionRefreshArgs&) override;
     void updateColorProfile(const compositionengine::CompositionRefreshArgs&) override;
     void beginFrame() override;
     void prepareFrame() override;
     void devOptRepaintFlash(const CompositionRefreshArgs&) override;
     void finishFrame(const CompositionRefreshArgs&) override;
+    bool forwardLayerBuffer() override;
     std::optional<base::unique_fd> composeSurfaces(
             const Region&, const compositionengine::CompositionRefreshArgs& refreshArgs) override;
     void postFramebuffer() override;
@@ -116,11 +126,51 @@ protected:
     virtual void dumpState(std::string& out) const = 0;
 
 private:
+    // The inputs to ensureOutputLayerIfVisible() for a layer, besides the
+    // coverage of the layers above it.
+    struct VisibilityInputs {
+        bool belongsInOutput{false};
+        bool isVisible{false};
+        ui::Transform geomLayerTransform;
+        FloatRect geomLayerBounds;
+        float shadowRadius{0.f};
+        bool isOpaque{false};
+        Region transparentRegionHint;
+
+        bool operator==(const VisibilityInputs&) const;
+        bool operator!=(const VisibilityInputs& other) const { return !(*this == other); }
+    };
+
+    // What a layer contributed to the previous rebuild of the layer stack.
+    struct VisibilityCacheEntry {
+        wp<compositionengine::LayerFE> layerFE;
+        VisibilityInputs inputs;
+        bool hasOutputLayer{false};
+        // The coverage once this layer had been processed.
+        Region aboveCoveredLayers;
+        Region aboveOpaqueLayers;
+    };
+
+    struct VisibilityCache {
+        // The output geometry the entries were computed for.
+        ui::Transform transform;
+        Rect bounds;
+        Rect viewport;
+        // One entry per candidate layer, from front to back.
+        std::vector<VisibilityCacheEntry> entries;
+    };
+
+    VisibilityInputs getVisibilityInputs(const sp<compositionengine::LayerFE>&) const;
+    bool reuseCachedVisibility(const sp<compositionengine::LayerFE>&, const VisibilityCacheEntry&,
+                               compositionengine::Output::CoverageState&);
+    void presentFrame(const compositionengine::CompositionRefreshArgs&);
     void dirtyEntireOutput();
     compositionengine::OutputLayer* findLayerRequestingBackgroundComposition() const;
     ui::Dataspace getBestDataspace(ui::Dataspace*, bool*) const;
     compositionengine::Output::ColorProfile pickColorProfile(
             const compositionengine::CompositionRefreshArgs&) const;
+    Rect updateClientCompositionDamage(const compositionengine::CompositionRefreshArgs&,
+                                       const renderengine::DisplaySettings&);
 
     std::string mName;
 
@@ -128,8 +178,22 @@ private:
     std::unique_ptr<compositionengine::RenderSurface> mRenderSurface;
 
     ReleasedLayers mReleasedLayers;
+    // The client target acquire fence of the last frame presented, which the
+    // layers client composited in that frame are released with.
+    sp<Fence> mPreviousClientTargetAcquireFence = Fence::NO_FENCE;
     OutputLayer* mLayerRequestingBackgroundBlur = nullptr;
     std::unique_ptr<ClientCompositionRequestCache> mClientCompositionRequestCache;
+    VisibilityCache mVisibilityCache;
+    std::unique_ptr<LayerFlattener> mLayerFlattener;
+
+    // The damage of the last few client composited frames, in display space,
+    // most recent first. Only tracked while partial client composition is on.
+    static constexpr size_t kMaxClientCompositionDamageHistory = 5;
+    std::deque<Region> mClientCompositionDamageHistory;
+    // What the history is only valid for. Any change to these redraws the
+    // whole client target.
+    renderengine::DisplaySettings mLastClientCompositionDisplay;
+    std::vector<std::pair<const LayerFE*, bool>> mLastClientCompositionLayers;
 };
 
 // This template factory function standardizes the implementation details of the
@@ -37,6 +37,11 @@ class OutputLayer : public virtual compositionengine::OutputLayer {
 public:
     ~OutputLayer() override;
 
+    // One is created for each layer on each output, so they come from the
+    // layer ObjectPool.
+    static void* operator new(size_t size);
+    static void operator delete(void* block, size_t size);
+
     void setHwcLayer(std::shared_ptr<HWC2::Layer>) override;
 
     void updateCompositionState(bool includeGeometry, bool forceClientComposition,
@@ -66,13 +71,16 @@ protected:
 private:
     Rect calculateInitialCrop() const;
     void writeOutputDependentGeometryStateToHWC(HWC2::Layer*, Hwc2::IComposerClient::Composition);
-    void writeOutputIndependentGeometryStateToHWC(HWC2::Layer*, const LayerFECompositionState&);
+    void writeOutputIndependentGeometryStateToHWC(HWC2::Layer*, const LayerFECompositionState&,
+                                                  bool skipLayer);
     void writeOutputDependentPerFrameStateToHWC(HWC2::Layer*);
     void writeOutputIndependentPerFrameStateToHWC(HWC2::Layer*, const LayerFECompositionState&);
     void writeSolidColorStateToHWC(HWC2::Layer*, const LayerFECompositionState&);
     void writeSidebandStateToHWC(HWC2::Layer*, const LayerFECompositionState&);
     void writeBufferStateToHWC(HWC2::Layer*, const LayerFECompositionState&);
-    void writeCompositionTypeToHWC(HWC2::Layer*, Hwc2::IComposerClient::Composition);
+    void writeOverrideStateToHWC(HWC2::Layer*, bool includeGeometry);
+    void writeCompositionTypeToHWC(HWC2::Layer*, Hwc2::IComposerClient::Composition,
+                                   bool includeGeometry);
     void detectDisallowedCompositionTypeChange(Hwc2::IComposerClient::Composition from,
                                                Hwc2::IComposerClient::Composition to) const;
 };
@@ -22,7 +22,9 @@
 
 #include <compositionengine/impl/HwcBufferCache.h>
 #include <renderengine/Mesh.h>
+#include <ui/Fence.h>
 #include <ui/FloatRect.h>
+#include <ui/GraphicBuffer.h>
 #include <ui/GraphicTypes.h>
 #include <ui/Rect.h>
 #include <ui/Region.h>
@@ -83,6 +85,30 @@ struct OutputLayerCompositionState {
     // The Z order index of this layer on this output
     uint32_t z{0};
 
+    // If true, RenderEngine composed this layer in the last frame presented,
+    // and the release of its buffer waits for that composition to finish
+    bool clientComposedLastFrame{false};
+
+    // Set while this layer belongs to a group of static layers that is sent
+    // to the HWC as a single pre-rendered buffer. See LayerFlattener.
+    struct OverrideInfo {
+        // Only set on the bottom most layer of the group, which presents the
+        // buffer in place of its own content.
+        sp<GraphicBuffer> buffer;
+        sp<Fence> acquireFence;
+        Rect displayFrame;
+        Region visibleRegion;
+        ui::Dataspace dataspace{ui::Dataspace::UNKNOWN};
+
+        // True until the buffer has been sent to the HWC once
+        bool bufferChanged{false};
+
+        // Set on the other layers of the group, which are hidden from the HWC
+        // as their content is already in the buffer.
+        bool skip{false};
+    };
+    OverrideInfo overrideInfo;
+
     /*
      * HWC state
      */
@@ -97,6 +123,11 @@ struct OutputLayerCompositionState {
         Hwc2::IComposerClient::Composition hwcCompositionType{
                 Hwc2::IComposerClient::Composition::INVALID};
 
+        // The composition type most recently asked of the HWC, before any
+        // change the HWC made to it during validation
+        Hwc2::IComposerClient::Composition requestedCompositionType{
+                Hwc2::IComposerClient::Composition::INVALID};
+
         // The buffer cache for this layer. This is used to lower the
         // cost of sending reused buffers to the HWC.
         HwcBufferCache hwcBufferCache;
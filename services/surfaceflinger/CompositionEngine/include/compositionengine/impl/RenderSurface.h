@@ -55,7 +55,10 @@ public:
     status_t beginFrame(bool mustRecompose) override;
     void prepareFrame(bool usesClientComposition, bool usesDeviceComposition) override;
     sp<GraphicBuffer> dequeueBuffer(base::unique_fd* bufferFence) override;
+    int getBufferAge() const override;
     void queueBuffer(base::unique_fd readyFence) override;
+    bool forwardBuffer(const sp<GraphicBuffer>& buffer, const sp<Fence>& acquireFence,
+                       ui::Dataspace dataspace) override;
     void onPresentDisplayCompleted() override;
     void flip() override;
 
@@ -34,6 +34,7 @@ public:
     MOCK_CONST_METHOD1(dumpAsString, void(String8& result));
     MOCK_METHOD2(resizeBuffers, void(uint32_t, uint32_t));
     MOCK_CONST_METHOD0(getClientTargetAcquireFence, const sp<Fence>&());
+    MOCK_METHOD3(forwardBuffer, bool(const sp<GraphicBuffer>&, const sp<Fence>&, ui::Dataspace));
 };
 
 } // namespace android::compositionengine::mock
@@ -75,6 +75,12 @@ public:
 
     MOCK_METHOD2(prepare, void(const compositionengine::CompositionRefreshArgs&, LayerFESet&));
     MOCK_METHOD1(present, void(const compositionengine::CompositionRefreshArgs&));
+    MOCK_METHOD1(beginPresent, void(const compositionengine::CompositionRefreshArgs&));
+    MOCK_METHOD1(updateCompositionState, void(const compositionengine::CompositionRefreshArgs&));
+    MOCK_METHOD1(finishPresent, void(const compositionengine::CompositionRefreshArgs&));
+    MOCK_METHOD1(writeFrame, void(const compositionengine::CompositionRefreshArgs&));
+    MOCK_METHOD1(presentWrittenFrame, void(const compositionengine::CompositionRefreshArgs&));
+    MOCK_CONST_METHOD0(getDisplayIdToValidate, std::optional<DisplayId>());
 
     MOCK_METHOD2(rebuildLayerStacks,
                  void(const compositionengine::CompositionRefreshArgs&, LayerFESet&));
@@ -87,6 +93,7 @@ public:
 
     MOCK_CONST_METHOD1(updateLayerStateFromFE, void(const CompositionRefreshArgs&));
     MOCK_METHOD1(updateAndWriteCompositionState, void(const CompositionRefreshArgs&));
+    MOCK_METHOD1(writeCompositionState, void(const CompositionRefreshArgs&));
     MOCK_METHOD1(updateColorProfile, void(const compositionengine::CompositionRefreshArgs&));
 
     MOCK_METHOD0(beginFrame, void());
@@ -97,6 +104,7 @@ public:
     MOCK_METHOD1(devOptRepaintFlash, void(const compositionengine::CompositionRefreshArgs&));
 
     MOCK_METHOD1(finishFrame, void(const compositionengine::CompositionRefreshArgs&));
+    MOCK_METHOD0(forwardLayerBuffer, bool());
 
     MOCK_METHOD2(composeSurfaces,
                  std::optional<base::unique_fd>(
@@ -40,7 +40,9 @@ public:
     MOCK_METHOD1(beginFrame, status_t(bool mustRecompose));
     MOCK_METHOD2(prepareFrame, void(bool, bool));
     MOCK_METHOD1(dequeueBuffer, sp<GraphicBuffer>(base::unique_fd*));
+    MOCK_CONST_METHOD0(getBufferAge, int());
     MOCK_METHOD1(queueBuffer, void(base::unique_fd));
+    MOCK_METHOD3(forwardBuffer, bool(const sp<GraphicBuffer>&, const sp<Fence>&, ui::Dataspace));
     MOCK_METHOD0(onPresentDisplayCompleted, void());
     MOCK_METHOD0(flip, void());
     MOCK_CONST_METHOD1(dump, void(std::string& result));
@@ -15,7 +15,10 @@
  */
 
 #include <algorithm>
+#include <cinttypes>
+#include <functional>
 
+#include <android-base/stringprintf.h>
 #include <compositionengine/impl/ClientCompositionRequestCache.h>
 #include <renderengine/DisplaySettings.h>
 #include <renderengine/LayerSettings.h>
@@ -66,12 +69,54 @@ bool layerSettingsAreEqual(const LayerFE::LayerSettings& lhs, const LayerFE::Lay
             equalIgnoringBuffer(lhs, rhs);
 }
 
+template <typename T>
+inline void hashCombine(size_t& seed, const T& value) {
+    seed ^= std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+inline void hashCombine(size_t& seed, const Rect& rect) {
+    hashCombine(seed, rect.left);
+    hashCombine(seed, rect.top);
+    hashCombine(seed, rect.right);
+    hashCombine(seed, rect.bottom);
+}
+
+inline void hashCombine(size_t& seed, const FloatRect& rect) {
+    hashCombine(seed, rect.left);
+    hashCombine(seed, rect.top);
+    hashCombine(seed, rect.right);
+    hashCombine(seed, rect.bottom);
+}
+
+// Digests the settings that most often tell two requests apart. Requests with
+// equal digests are still compared in full.
+size_t getRequestDigest(const renderengine::DisplaySettings& display,
+                        const std::vector<LayerFE::LayerSettings>& layerSettings) {
+    size_t digest = 0;
+    hashCombine(digest, display.physicalDisplay);
+    hashCombine(digest, display.clip);
+    hashCombine(digest, static_cast<int32_t>(display.outputDataspace));
+    hashCombine(digest, display.orientation);
+    hashCombine(digest, layerSettings.size());
+    for (const LayerFE::LayerSettings& settings : layerSettings) {
+        hashCombine(digest, settings.bufferId);
+        hashCombine(digest, settings.frameNumber);
+        hashCombine(digest, settings.geometry.boundaries);
+        hashCombine(digest, static_cast<float>(settings.alpha));
+        hashCombine(digest, static_cast<float>(settings.source.solidColor.r));
+        hashCombine(digest, static_cast<float>(settings.source.solidColor.g));
+        hashCombine(digest, static_cast<float>(settings.source.solidColor.b));
+        hashCombine(digest, settings.backgroundBlurRadius);
+    }
+    return digest;
+}
+
 } // namespace
 
 ClientCompositionRequestCache::ClientCompositionRequest::ClientCompositionRequest(
         const renderengine::DisplaySettings& initDisplay,
         const std::vector<LayerFE::LayerSettings>& initLayerSettings)
-      : display(initDisplay) {
+      : digest(getRequestDigest(initDisplay, initLayerSettings)), display(initDisplay) {
     layerSettings.reserve(initLayerSettings.size());
     for (const LayerFE::LayerSettings& settings : initLayerSettings) {
         layerSettings.push_back(getLayerSettingsSnapshot(settings));
@@ -79,49 +124,66 @@ ClientCompositionRequestCache::ClientCompositionRequest::ClientCompositionReques
 }
 
 bool ClientCompositionRequestCache::ClientCompositionRequest::equals(
-        const renderengine::DisplaySettings& newDisplay,
+        size_t newDigest, const renderengine::DisplaySettings& newDisplay,
         const std::vector<LayerFE::LayerSettings>& newLayerSettings) const {
-    return newDisplay == display &&
+    return newDigest == digest && newDisplay == display &&
             std::equal(layerSettings.begin(), layerSettings.end(), newLayerSettings.begin(),
                        newLayerSettings.end(), layerSettingsAreEqual);
 }
 
 bool ClientCompositionRequestCache::exists(
         uint64_t bufferId, const renderengine::DisplaySettings& display,
-        const std::vector<LayerFE::LayerSettings>& layerSettings) const {
-    for (const auto& [cachedBufferId, cachedRequest] : mCache) {
-        if (cachedBufferId == bufferId) {
-            return cachedRequest.equals(display, layerSettings);
-        }
+        const std::vector<LayerFE::LayerSettings>& layerSettings) {
+    auto it = mCache.find(bufferId);
+    if (it == mCache.end()) {
+        mMissCount++;
+        return false;
+    }
+
+    it->second.lastUsed = ++mUseCounter;
+    if (!it->second.equals(getRequestDigest(display, layerSettings), display, layerSettings)) {
+        mMissCount++;
+        return false;
     }
-    return false;
+
+    mHitCount++;
+    return true;
 }
 
 void ClientCompositionRequestCache::add(uint64_t bufferId,
                                         const renderengine::DisplaySettings& display,
                                         const std::vector<LayerFE::LayerSettings>& layerSettings) {
-    const ClientCompositionRequest request(display, layerSettings);
-    for (auto& [cachedBufferId, cachedRequest] : mCache) {
-        if (cachedBufferId == bufferId) {
-            cachedRequest = std::move(request);
-            return;
-        }
+    ClientCompositionRequest request(display, layerSettings);
+    request.lastUsed = ++mUseCounter;
+    if (auto it = mCache.find(bufferId); it != mCache.end()) {
+        it->second = std::move(request);
+        return;
     }
 
     if (mCache.size() >= mMaxCacheSize) {
-        mCache.pop_front();
+        auto leastRecentlyUsed =
+                std::min_element(mCache.begin(), mCache.end(), [](const auto& lhs, const auto& rhs) {
+                    return lhs.second.lastUsed < rhs.second.lastUsed;
+                });
+        mCache.erase(leastRecentlyUsed);
     }
 
-    mCache.emplace_back(bufferId, std::move(request));
+    mCache.emplace(bufferId, std::move(request));
 }
 
 void ClientCompositionRequestCache::remove(uint64_t bufferId) {
-    for (auto it = mCache.begin(); it != mCache.end(); it++) {
-        if (it->first == bufferId) {
-            mCache.erase(it);
-            return;
-        }
-    }
+    mCache.erase(bufferId);
+}
+
+void ClientCompositionRequestCache::dump(std::string& out) const {
+    const uint64_t lookups = mHitCount + mMissCount;
+    android::base::StringAppendF(&out,
+                                 "   Client composition cache: %zu/%u requests, %" PRIu64
+                                 " hits, %" PRIu64 " misses (%.1f%% hit rate)\n",
+                                 mCache.size(), mMaxCacheSize, mHitCount, mMissCount,
+                                 lookups ? 100.0 * static_cast<double>(mHitCount) /
+                                                 static_cast<double>(lookups)
+                                         : 0.0);
 }
 
 } // namespace android::compositionengine::impl
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <TimeStats/PhaseTimings.h>
 #include <compositionengine/CompositionRefreshArgs.h>
 #include <compositionengine/LayerFE.h>
 #include <compositionengine/LayerFECompositionState.h>
@@ -21,9 +22,19 @@
 #include <compositionengine/impl/CompositionEngine.h>
 #include <compositionengine/impl/Display.h>
 
+#include <android-base/thread_annotations.h>
 #include <renderengine/RenderEngine.h>
 #include <utils/Trace.h>
 
+#include <pthread.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wconversion"
@@ -39,6 +50,84 @@ CompositionEngine::~CompositionEngine() = default;
 
 namespace impl {
 
+// A few persistent threads that help the calling thread run one batch of
+// work at a time, so that presenting outputs in parallel doesn't create
+// threads every frame.
+class CompositionEngine::OutputWorkers {
+public:
+    ~OutputWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQuit = true;
+        }
+        mWorkCondition.notify_all();
+        for (auto& thread : mThreads) {
+            thread.join();
+        }
+    }
+
+    // Calls work(i) for every i in [0, count) on the calling thread and up to
+    // kMaxThreads workers, and returns once every call has returned.
+    void run(size_t count, const std::function<void(size_t)>& work) {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            while (mThreads.size() < std::min(count - 1, kMaxThreads)) {
+                mThreads.emplace_back([this] { threadMain(); });
+                pthread_setname_np(mThreads.back().native_handle(), "OutputWorker");
+            }
+            mWork = &work;
+            mNext = 0;
+            mCount = count;
+            mRemaining = count;
+        }
+        mWorkCondition.notify_all();
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        runItemsLocked(lock);
+        mDoneCondition.wait(lock, [this]() REQUIRES(mMutex) { return mRemaining == 0; });
+        mWork = nullptr;
+    }
+
+private:
+    static constexpr size_t kMaxThreads = 3;
+
+    void threadMain() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true) {
+            mWorkCondition.wait(lock, [this]() REQUIRES(mMutex) {
+                return mQuit || (mWork != nullptr && mNext < mCount);
+            });
+            if (mQuit) {
+                return;
+            }
+            runItemsLocked(lock);
+        }
+    }
+
+    void runItemsLocked(std::unique_lock<std::mutex>& lock) REQUIRES(mMutex) {
+        while (mWork != nullptr && mNext < mCount) {
+            const size_t index = mNext++;
+            const auto& work = *mWork;
+            lock.unlock();
+            work(index);
+            lock.lock();
+            if (--mRemaining == 0) {
+                mDoneCondition.notify_all();
+            }
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mWorkCondition;
+    std::condition_variable mDoneCondition;
+    std::vector<std::thread> mThreads GUARDED_BY(mMutex);
+    const std::function<void(size_t)>* mWork GUARDED_BY(mMutex) = nullptr;
+    size_t mNext GUARDED_BY(mMutex) = 0;
+    size_t mCount GUARDED_BY(mMutex) = 0;
+    size_t mRemaining GUARDED_BY(mMutex) = 0;
+    bool mQuit GUARDED_BY(mMutex) = false;
+};
+
 std::unique_ptr<compositionengine::CompositionEngine> createCompositionEngine() {
     return std::make_unique<CompositionEngine>();
 }
@@ -95,6 +184,9 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
     preComposition(args);
 
     {
+        PhaseTimings::ScopedTimer timer(args.phaseTimings,
+                                        PhaseTimings::Phase::RebuildLayerStacks);
+
         // latchedLayers is used to track the set of front-end layer state that
         // has been latched across all outputs for the prepare step, and is not
         // needed for anything else.
@@ -107,11 +199,84 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
 
     updateLayerStateFromFE(args);
 
+    if (args.batchHwcValidate && args.outputs.size() > 1) {
+        presentOutputsWithBatchedValidate(args);
+    } else if (args.parallelOutputCompositionState && args.outputs.size() > 1) {
+        presentOutputsInParallel(args);
+    } else {
+        presentOutputs(args);
+    }
+}
+
+void CompositionEngine::presentOutputs(CompositionRefreshArgs& args) {
     for (const auto& output : args.outputs) {
         output->present(args);
     }
 }
 
+void CompositionEngine::presentOutputsInParallel(CompositionRefreshArgs& args) {
+    ATRACE_CALL();
+
+    // Only computing the layer composition state is safe to spread across
+    // threads. Everything that talks to the HWC or RenderEngine, including
+    // client composition, stays on this thread and in output order.
+    for (const auto& output : args.outputs) {
+        output->beginPresent(args);
+    }
+
+    if (!mOutputWorkers) {
+        mOutputWorkers = std::make_unique<OutputWorkers>();
+    }
+    mOutputWorkers->run(args.outputs.size(),
+                        [&args](size_t i) { args.outputs[i]->updateCompositionState(args); });
+
+    for (const auto& output : args.outputs) {
+        output->finishPresent(args);
+    }
+}
+
+void CompositionEngine::presentOutputsWithBatchedValidate(CompositionRefreshArgs& args) {
+    ATRACE_CALL();
+
+    for (const auto& output : args.outputs) {
+        output->beginPresent(args);
+    }
+
+    if (args.parallelOutputCompositionState) {
+        if (!mOutputWorkers) {
+            mOutputWorkers = std::make_unique<OutputWorkers>();
+        }
+        mOutputWorkers->run(args.outputs.size(),
+                            [&args](size_t i) { args.outputs[i]->updateCompositionState(args); });
+    } else {
+        for (const auto& output : args.outputs) {
+            output->updateCompositionState(args);
+        }
+    }
+
+    // Write every display's layers first, so the displays that need it can be
+    // validated in one HWC command submission. Each still presents on its own,
+    // as that needs the client target it composes afterwards.
+    std::vector<DisplayId> displayIds;
+    for (const auto& output : args.outputs) {
+        output->writeFrame(args);
+        if (const auto displayId = output->getDisplayIdToValidate()) {
+            displayIds.push_back(*displayId);
+        }
+    }
+
+    // If the batch fails, each display is validated on its own as usual.
+    if (displayIds.size() > 1) {
+        PhaseTimings::ScopedTimer timer(args.phaseTimings,
+                                        PhaseTimings::Phase::ChooseCompositionStrategy);
+        mHwComposer->validateDisplays(displayIds);
+    }
+
+    for (const auto& output : args.outputs) {
+        output->presentWrittenFrame(args);
+    }
+}
+
 void CompositionEngine::updateCursorAsync(CompositionRefreshArgs& args) {
     std::unordered_map<compositionengine::LayerFE*, compositionengine::LayerFECompositionState*>
             uniqueVisibleLayers;
@@ -268,6 +268,15 @@ void Display::chooseCompositionStrategy() {
     state.usesDeviceComposition = !allLayersRequireClientComposition();
 }
 
+std::optional<DisplayId> Display::getDisplayIdToValidate() const {
+    // Frames without client composition may be presented without validating
+    // them first, so leave those to presentOrValidate.
+    if (!mId || !getState().isEnabled || !anyLayersRequireClientComposition()) {
+        return {};
+    }
+    return mId;
+}
+
 bool Display::getSkipColorTransform() const {
     const auto& hwc = getCompositionEngine().getHwComposer();
     return mId ? hwc.hasDisplayCapability(*mId, hal::DisplayCapability::SKIP_CLIENT_COLOR_TRANSFORM)
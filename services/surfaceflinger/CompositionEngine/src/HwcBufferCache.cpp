@@ -16,6 +16,11 @@
 
 #include <compositionengine/impl/HwcBufferCache.h>
 
+#include <algorithm>
+#include <cinttypes>
+
+#include <android-base/stringprintf.h>
+
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wconversion"
@@ -28,31 +33,71 @@
 
 namespace android::compositionengine::impl {
 
-HwcBufferCache::HwcBufferCache() {
-    std::fill(std::begin(mBuffers), std::end(mBuffers), wp<GraphicBuffer>(nullptr));
-}
+HwcBufferCache::HwcBufferCache(uint32_t slotCount)
+      : mSlotCount(std::clamp(slotCount, 1u,
+                              static_cast<uint32_t>(BufferQueue::NUM_BUFFER_SLOTS))) {}
 
 void HwcBufferCache::getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uint32_t* outSlot,
                                   sp<GraphicBuffer>* outBuffer) {
-    // default is 0
-    if (slot == BufferQueue::INVALID_BUFFER_SLOT || slot < 0 ||
-        slot >= BufferQueue::NUM_BUFFER_SLOTS) {
-        *outSlot = 0;
-    } else {
-        *outSlot = static_cast<uint32_t>(slot);
-    }
+    const bool hasProducerSlot = slot != BufferQueue::INVALID_BUFFER_SLOT && slot >= 0 &&
+            static_cast<uint32_t>(slot) < mSlotCount;
 
-    auto& currentBuffer = mBuffers[*outSlot];
-    wp<GraphicBuffer> weakCopy(buffer);
-    if (currentBuffer == weakCopy) {
-        // already cached in HWC, skip sending the buffer
+    // Nothing is sent for a null buffer, so there is nothing to cache either.
+    if (buffer == nullptr) {
+        *outSlot = hasProducerSlot ? static_cast<uint32_t>(slot) : 0;
         *outBuffer = nullptr;
-    } else {
-        *outBuffer = buffer;
+        return;
+    }
+
+    mUseCounter++;
+
+    const wp<GraphicBuffer> weakCopy(buffer);
+    const uint64_t bufferId = buffer->getId();
+    for (uint32_t i = 0; i < mSlotCount; i++) {
+        auto& cached = mSlots[i];
+        if (cached.bufferId == bufferId && cached.buffer == weakCopy) {
+            // already cached in HWC, skip sending the buffer
+            cached.lastUsed = mUseCounter;
+            mHits++;
+            *outSlot = i;
+            *outBuffer = nullptr;
+            return;
+        }
+    }
+
+    *outSlot = hasProducerSlot ? static_cast<uint32_t>(slot) : findLeastRecentlyUsedSlot();
+    *outBuffer = buffer;
 
-        // update cache
-        currentBuffer = buffer;
+    // update cache
+    auto& replaced = mSlots[*outSlot];
+    if (replaced.buffer.promote() != nullptr) {
+        mEvictions++;
     }
+    replaced.buffer = buffer;
+    replaced.bufferId = bufferId;
+    replaced.lastUsed = mUseCounter;
+    mMisses++;
+}
+
+uint32_t HwcBufferCache::findLeastRecentlyUsedSlot() const {
+    // Slots whose buffer has been freed can be reused before anything else.
+    uint32_t leastRecentlyUsed = 0;
+    for (uint32_t i = 0; i < mSlotCount; i++) {
+        if (mSlots[i].buffer.promote() == nullptr) {
+            return i;
+        }
+        if (mSlots[i].lastUsed < mSlots[leastRecentlyUsed].lastUsed) {
+            leastRecentlyUsed = i;
+        }
+    }
+    return leastRecentlyUsed;
+}
+
+void HwcBufferCache::dump(std::string& out) const {
+    base::StringAppendF(&out,
+                        "buffer cache: slots=%u hits=%" PRIu64 " misses=%" PRIu64
+                        " evictions=%" PRIu64 " ",
+                        mSlotCount, mHits, mMisses, mEvictions);
 }
 
 } // namespace android::compositionengine::impl
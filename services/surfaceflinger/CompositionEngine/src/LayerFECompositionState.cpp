@@ -17,6 +17,7 @@
 #include <android-base/stringprintf.h>
 #include <compositionengine/LayerFECompositionState.h>
 #include <compositionengine/impl/DumpHelpers.h>
+#include <compositionengine/impl/ObjectPool.h>
 
 namespace android::compositionengine {
 
@@ -48,6 +49,14 @@ std::string GenericLayerMetadataEntry::dumpAsString() const {
 
 LayerFECompositionState::~LayerFECompositionState() = default;
 
+void* LayerFECompositionState::operator new(size_t size) {
+    return impl::ObjectPool::allocate(size);
+}
+
+void LayerFECompositionState::operator delete(void* block, size_t size) {
+    impl::ObjectPool::release(block, size);
+}
+
 void LayerFECompositionState::dump(std::string& out) const {
     out.append("      ");
     dumpVal(out, "isSecure", isSecure);
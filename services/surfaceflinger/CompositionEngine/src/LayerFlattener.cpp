@@ -0,0 +1,276 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cinttypes>
+#include <cstring>
+
+#include <android-base/stringprintf.h>
+#include <compositionengine/DisplayColorProfile.h>
+#include <compositionengine/FodExtension.h>
+#include <compositionengine/LayerFE.h>
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/Output.h>
+#include <compositionengine/OutputLayer.h>
+#include <compositionengine/impl/LayerFlattener.h>
+#include <compositionengine/impl/OutputCompositionState.h>
+#include <compositionengine/impl/OutputLayerCompositionState.h>
+
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconversion"
+
+#include <renderengine/DisplaySettings.h>
+#include <renderengine/RenderEngine.h>
+
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic pop // ignored "-Wconversion"
+
+#include <ui/HdrCapabilities.h>
+#include <utils/Trace.h>
+
+namespace android::compositionengine::impl {
+
+namespace {
+
+bool isHwcComposedType(hal::Composition type) {
+    return type == hal::Composition::DEVICE || type == hal::Composition::SOLID_COLOR;
+}
+
+} // namespace
+
+bool LayerFlattener::update(Output& output, renderengine::RenderEngine& renderEngine,
+                            bool geometryChanged) {
+    ATRACE_CALL();
+
+    // Note which layers changed since the last frame. Layers are only added,
+    // removed or reordered on geometry changes, which start every count over.
+    std::vector<OutputLayer*> layers;
+    std::vector<LayerRecord> records;
+    layers.reserve(output.getOutputLayerCount());
+    records.reserve(output.getOutputLayerCount());
+    for (auto* layer : output.getOutputLayersOrderedByZ()) {
+        LayerRecord record;
+        record.layerFE = &layer->getLayerFE();
+        if (const auto* layerFEState = layer->getLayerFE().getCompositionState()) {
+            record.bufferId = layerFEState->buffer ? layerFEState->buffer->getId() : 0;
+            record.acquireFence = layerFEState->acquireFence;
+            record.alpha = layerFEState->alpha;
+            record.color = layerFEState->color;
+        }
+
+        const size_t index = records.size();
+        if (!geometryChanged && index < mRecords.size()) {
+            const auto& previous = mRecords[index];
+            if (previous.layerFE == record.layerFE && previous.bufferId == record.bufferId &&
+                previous.acquireFence == record.acquireFence && previous.alpha == record.alpha &&
+                previous.color == record.color) {
+                record.unchangedFrames = previous.unchangedFrames + 1;
+            }
+        }
+
+        layers.push_back(layer);
+        records.push_back(std::move(record));
+    }
+    mRecords = std::move(records);
+
+    // Pick the longest run of layers that can be flattened together.
+    size_t groupBegin = 0;
+    size_t groupSize = 0;
+    for (size_t begin = 0; begin < layers.size();) {
+        size_t end = begin;
+        while (end < layers.size() && isEligible(*layers[end], mRecords[end])) {
+            end++;
+        }
+        if (end - begin > groupSize) {
+            groupBegin = begin;
+            groupSize = end - begin;
+        }
+        begin = end + 1;
+    }
+
+    std::vector<OutputLayer*> group;
+    std::vector<const LayerFE*> groupLayerFEs;
+    if (groupSize >= kMinGroupSize) {
+        for (size_t i = groupBegin; i < groupBegin + groupSize; i++) {
+            group.push_back(layers[i]);
+            groupLayerFEs.push_back(&layers[i]->getLayerFE());
+        }
+    }
+
+    if (groupLayerFEs == mGroup) {
+        return false;
+    }
+
+    const bool hadGroup = clear(output);
+    if (!group.empty() && render(output, renderEngine, group)) {
+        mGroup = std::move(groupLayerFEs);
+    }
+    return hadGroup || !mGroup.empty();
+}
+
+bool LayerFlattener::clear(Output& output) {
+    if (mGroup.empty()) {
+        return false;
+    }
+
+    clearOverrides(output);
+    mGroup.clear();
+    mBuffer = nullptr;
+    mBufferFence = nullptr;
+    return true;
+}
+
+void LayerFlattener::dump(std::string& out) const {
+    base::StringAppendF(&out, "   Layer flattener: %zu layers from buffer %" PRIx64 ", %" PRIu64
+                        " renders\n",
+                        mGroup.size(), mBuffer ? mBuffer->getId() : 0, mRenderCount);
+}
+
+bool LayerFlattener::isEligible(const OutputLayer& layer, const LayerRecord& record) const {
+    if (record.unchangedFrames < kStaticFrameThreshold) {
+        return false;
+    }
+
+    const auto& state = layer.getState();
+    if (!state.hwc || !state.hwc->hwcLayer || state.forceClientComposition ||
+        !isHwcComposedType(state.hwc->hwcCompositionType)) {
+        return false;
+    }
+
+    // These layers have their Z order adjusted when written to the HWC.
+    const char* name = layer.getLayerFE().getDebugName();
+    if (strcmp(name, FOD_LAYER_NAME) == 0 || strcmp(name, FOD_TOUCHED_LAYER_NAME) == 0) {
+        return false;
+    }
+
+    const auto* layerFEState = layer.getLayerFE().getCompositionState();
+    return layerFEState && isHwcComposedType(layerFEState->compositionType) &&
+            !layerFEState->isSecure && !layerFEState->hasProtectedContent &&
+            layerFEState->backgroundBlurRadius == 0 && !layerFEState->sidebandStream &&
+            layerFEState->hdrMetadata.validTypes == 0;
+}
+
+bool LayerFlattener::render(Output& output, renderengine::RenderEngine& renderEngine,
+                            const std::vector<OutputLayer*>& group) {
+    ATRACE_CALL();
+
+    // The buffer can't be drawn into while the protected context is in use.
+    if (renderEngine.isProtected()) {
+        return false;
+    }
+
+    const auto& outputState = output.getState();
+    const auto* displayColorProfile = output.getDisplayColorProfile();
+    const ui::Dataspace outputDataspace =
+            displayColorProfile && displayColorProfile->hasWideColorGamut()
+            ? outputState.dataspace
+            : ui::Dataspace::UNKNOWN;
+
+    // Render in output space, the same way client composition does, so the
+    // buffer lines up with the display frames of the layers.
+    renderengine::DisplaySettings displaySettings;
+    displaySettings.physicalDisplay = outputState.destinationClip;
+    displaySettings.clip = outputState.sourceClip;
+    displaySettings.orientation = outputState.orientation;
+    displaySettings.outputDataspace = outputDataspace;
+    if (displayColorProfile) {
+        displaySettings.maxLuminance =
+                displayColorProfile->getHdrCapabilities().getDesiredMaxLuminance();
+    }
+
+    const Region viewportRegion(outputState.viewport);
+    Region clearRegion;
+    Region displayFrames;
+    Region visibleRegion;
+    std::vector<LayerFE::LayerSettings> layerSettings;
+    for (auto* layer : group) {
+        const auto& layerState = layer->getState();
+        displayFrames.orSelf(layerState.displayFrame);
+        visibleRegion.orSelf(layerState.outputSpaceVisibleRegion);
+
+        const Region clip(viewportRegion.intersect(layerState.visibleRegion));
+        compositionengine::LayerFE::ClientCompositionTargetSettings targetSettings{
+                clip,
+                false, /* useIdentityTransform */
+                layer->needsFiltering() || outputState.needsFiltering,
+                false, /* isSecure */
+                false, /* supportsProtectedContent */
+                clearRegion,
+                outputState.viewport,
+                outputDataspace,
+                true,  /* realContentIsVisible */
+                false, /* clearContent */
+        };
+        std::vector<LayerFE::LayerSettings> results =
+                layer->getLayerFE().prepareClientCompositionList(targetSettings);
+        layerSettings.insert(layerSettings.end(), std::make_move_iterator(results.begin()),
+                             std::make_move_iterator(results.end()));
+    }
+
+    std::vector<const renderengine::LayerSettings*> layerSettingsPointers;
+    layerSettingsPointers.reserve(layerSettings.size());
+    for (const auto& settings : layerSettings) {
+        layerSettingsPointers.push_back(&settings);
+    }
+
+    // A new buffer each time, as the HWC may still be reading the last one.
+    const uint32_t usage =
+            GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_COMPOSER | GRALLOC_USAGE_HW_TEXTURE;
+    sp<GraphicBuffer> buffer =
+            new GraphicBuffer(static_cast<uint32_t>(outputState.bounds.getWidth()),
+                              static_cast<uint32_t>(outputState.bounds.getHeight()),
+                              HAL_PIXEL_FORMAT_RGBA_8888, 1, usage, "LayerFlattener");
+    if (buffer->initCheck() != NO_ERROR) {
+        ALOGE("Failed to allocate a buffer to flatten %zu layers of %s", group.size(),
+              output.getName().c_str());
+        return false;
+    }
+
+    base::unique_fd drawFence;
+    if (status_t status = renderEngine.drawLayers(displaySettings, layerSettingsPointers,
+                                                  buffer->getNativeBuffer(),
+                                                  /*useFramebufferCache=*/false,
+                                                  base::unique_fd(), &drawFence);
+        status != NO_ERROR) {
+        ALOGE("Failed to flatten %zu layers of %s: %d", group.size(), output.getName().c_str(),
+              status);
+        return false;
+    }
+
+    mBuffer = buffer;
+    mBufferFence = drawFence.get() >= 0 ? new Fence(drawFence.release()) : Fence::NO_FENCE;
+    mRenderCount++;
+
+    auto& overrideInfo = group.front()->editState().overrideInfo;
+    overrideInfo.buffer = mBuffer;
+    overrideInfo.acquireFence = mBufferFence;
+    overrideInfo.displayFrame = displayFrames.getBounds();
+    overrideInfo.visibleRegion = visibleRegion;
+    overrideInfo.dataspace = outputDataspace;
+    overrideInfo.bufferChanged = true;
+    for (size_t i = 1; i < group.size(); i++) {
+        group[i]->editState().overrideInfo.skip = true;
+    }
+    return true;
+}
+
+void LayerFlattener::clearOverrides(Output& output) const {
+    for (auto* layer : output.getOutputLayersOrderedByZ()) {
+        layer->editState().overrideInfo = {};
+    }
+}
+
+} // namespace android::compositionengine::impl
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/ObjectPool.h>
+
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <mutex>
+#include <new>
+
+#include <android-base/stringprintf.h>
+
+namespace android::compositionengine::impl {
+
+namespace {
+
+// Freed blocks are linked through their own first bytes.
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct Bucket {
+    FreeBlock* head{nullptr};
+    size_t count{0};
+};
+
+constexpr size_t kBucketCount = ObjectPool::kMaxPooledSize / ObjectPool::kGranularity;
+
+// Intentionally leaked so that objects destroyed during process teardown can
+// still be released safely.
+struct Pool {
+    std::mutex lock;
+    std::array<Bucket, kBucketCount> buckets;
+    ObjectPool::Stats stats;
+};
+
+Pool& pool() {
+    static Pool* pool = new Pool();
+    return *pool;
+}
+
+size_t roundUp(size_t size) {
+    return (std::max(size, sizeof(FreeBlock)) + ObjectPool::kGranularity - 1) &
+            ~(ObjectPool::kGranularity - 1);
+}
+
+} // namespace
+
+void* ObjectPool::allocate(size_t size) {
+    const size_t blockSize = roundUp(size);
+    if (blockSize > kMaxPooledSize) {
+        return ::operator new(size);
+    }
+
+    Pool& p = pool();
+    {
+        std::lock_guard<std::mutex> lock(p.lock);
+        p.stats.liveBlocks++;
+        p.stats.liveBytes += blockSize;
+
+        Bucket& bucket = p.buckets[blockSize / kGranularity - 1];
+        if (FreeBlock* block = bucket.head) {
+            bucket.head = block->next;
+            bucket.count--;
+            p.stats.freeBlocks--;
+            p.stats.freeBytes -= blockSize;
+            p.stats.hits++;
+            return block;
+        }
+        p.stats.misses++;
+    }
+    return ::operator new(blockSize);
+}
+
+void ObjectPool::release(void* block, size_t size) {
+    if (block == nullptr) {
+        return;
+    }
+
+    const size_t blockSize = roundUp(size);
+    if (blockSize > kMaxPooledSize) {
+        ::operator delete(block);
+        return;
+    }
+
+    Pool& p = pool();
+    {
+        std::lock_guard<std::mutex> lock(p.lock);
+        p.stats.liveBlocks--;
+        p.stats.liveBytes -= blockSize;
+
+        Bucket& bucket = p.buckets[blockSize / kGranularity - 1];
+        if ((bucket.count + 1) * blockSize <= kMaxFreeBytesPerBucket) {
+            auto* freeBlock = static_cast<FreeBlock*>(block);
+            freeBlock->next = bucket.head;
+            bucket.head = freeBlock;
+            bucket.count++;
+            p.stats.freeBlocks++;
+            p.stats.freeBytes += blockSize;
+            return;
+        }
+    }
+    ::operator delete(block);
+}
+
+ObjectPool::Stats ObjectPool::getStats() {
+    Pool& p = pool();
+    std::lock_guard<std::mutex> lock(p.lock);
+    return p.stats;
+}
+
+void ObjectPool::dump(std::string& out) {
+    const Stats stats = getStats();
+    base::StringAppendF(&out,
+                        "Layer object pool: %zu live (%zu bytes), %zu free (%zu bytes), "
+                        "%" PRIu64 " hits, %" PRIu64 " misses\n",
+                        stats.liveBlocks, stats.liveBytes, stats.freeBlocks, stats.freeBytes,
+                        stats.hits, stats.misses);
+}
+
+} // namespace android::compositionengine::impl
@@ -15,7 +15,9 @@
  */
 
 #include <thread>
+#include <unordered_set>
 
+#include <TimeStats/PhaseTimings.h>
 #include <android-base/stringprintf.h>
 #include <compositionengine/CompositionEngine.h>
 #include <compositionengine/CompositionRefreshArgs.h>
@@ -200,6 +202,14 @@ void Output::dumpBase(std::string& out) const {
         out.append("    No render surface!\n");
     }
 
+    if (mClientCompositionRequestCache) {
+        mClientCompositionRequestCache->dump(out);
+    }
+
+    if (mLayerFlattener) {
+        mLayerFlattener->dump(out);
+    }
+
     android::base::StringAppendF(&out, "\n   %zu Layers\n", getOutputLayerCount());
     for (const auto* outputLayer : getOutputLayersOrderedByZ()) {
         if (!outputLayer) {
@@ -310,11 +320,69 @@ void Output::present(const compositionengine::CompositionRefreshArgs& refreshArg
 
     updateColorProfile(refreshArgs);
     updateAndWriteCompositionState(refreshArgs);
+    presentFrame(refreshArgs);
+}
+
+void Output::beginPresent(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
+    updateColorProfile(refreshArgs);
+}
+
+void Output::finishPresent(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
+    writeFrame(refreshArgs);
+    presentWrittenFrame(refreshArgs);
+}
+
+void Output::writeFrame(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
+    writeCompositionState(refreshArgs);
     setColorTransform(refreshArgs);
     beginFrame();
-    prepareFrame();
+}
+
+void Output::presentWrittenFrame(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
+    {
+        PhaseTimings::ScopedTimer timer(refreshArgs.phaseTimings,
+                                        PhaseTimings::Phase::ChooseCompositionStrategy);
+        prepareFrame();
+    }
     devOptRepaintFlash(refreshArgs);
-    finishFrame(refreshArgs);
+    {
+        PhaseTimings::ScopedTimer timer(refreshArgs.phaseTimings,
+                                        PhaseTimings::Phase::ComposeSurfaces);
+        finishFrame(refreshArgs);
+    }
+    postFramebuffer();
+}
+
+std::optional<DisplayId> Output::getDisplayIdToValidate() const {
+    return {};
+}
+
+void Output::presentFrame(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    setColorTransform(refreshArgs);
+    beginFrame();
+    {
+        PhaseTimings::ScopedTimer timer(refreshArgs.phaseTimings,
+                                        PhaseTimings::Phase::ChooseCompositionStrategy);
+        prepareFrame();
+    }
+    devOptRepaintFlash(refreshArgs);
+    {
+        PhaseTimings::ScopedTimer timer(refreshArgs.phaseTimings,
+                                        PhaseTimings::Phase::ComposeSurfaces);
+        finishFrame(refreshArgs);
+    }
     postFramebuffer();
 }
 
@@ -345,12 +413,40 @@ void Output::rebuildLayerStacks(const compositionengine::CompositionRefreshArgs&
 
 void Output::collectVisibleLayers(const compositionengine::CompositionRefreshArgs& refreshArgs,
                                   compositionengine::Output::CoverageState& coverage) {
+    const auto& outputState = getState();
+    const bool incremental = refreshArgs.incrementalVisibleRegions;
+
+    // When incremental, the front most layers that have not changed since the
+    // last rebuild sit under exactly the same coverage as they did then, so
+    // their results are taken from the cache. Everything from the first
+    // changed layer down is computed as usual.
+    bool reuseCache = incremental && mVisibilityCache.transform == outputState.transform &&
+            mVisibilityCache.bounds == outputState.bounds &&
+            mVisibilityCache.viewport == outputState.viewport;
+    std::vector<VisibilityCacheEntry> cacheEntries;
+    if (incremental) {
+        cacheEntries.reserve(refreshArgs.layers.size());
+    }
+
     // Evaluate the layers from front to back to determine what is visible. This
     // also incrementally calculates the coverage information for each layer as
     // well as the entire output.
     for (auto layer : reversed(refreshArgs.layers)) {
-        // Incrementally process the coverage for each layer
-        ensureOutputLayerIfVisible(layer, coverage);
+        const size_t index = cacheEntries.size();
+        reuseCache = reuseCache && index < mVisibilityCache.entries.size() &&
+                reuseCachedVisibility(layer, mVisibilityCache.entries[index], coverage);
+
+        if (!reuseCache) {
+            // Incrementally process the coverage for each layer
+            ensureOutputLayerIfVisible(layer, coverage);
+        }
+
+        if (reuseCache) {
+            cacheEntries.push_back(mVisibilityCache.entries[index]);
+        } else if (incremental) {
+            cacheEntries.push_back({layer, getVisibilityInputs(layer), false,
+                                    coverage.aboveCoveredLayers, coverage.aboveOpaqueLayers});
+        }
 
         // TODO(b/121291683): Stop early if the output is completely covered and
         // no more layers could even be visible underneath the ones on top.
@@ -365,6 +461,90 @@ void Output::collectVisibleLayers(const compositionengine::CompositionRefreshArg
     for (auto* outputLayer : getOutputLayersOrderedByZ()) {
         outputLayer->editState().z = zOrder++;
     }
+
+    if (!incremental) {
+        mVisibilityCache = {};
+        return;
+    }
+
+    std::unordered_set<const compositionengine::LayerFE*> withOutputLayers;
+    for (auto* outputLayer : getOutputLayersOrderedByZ()) {
+        withOutputLayers.insert(&outputLayer->getLayerFE());
+    }
+    for (auto& entry : cacheEntries) {
+        entry.hasOutputLayer = withOutputLayers.count(entry.layerFE.unsafe_get()) != 0;
+    }
+
+    mVisibilityCache.transform = outputState.transform;
+    mVisibilityCache.bounds = outputState.bounds;
+    mVisibilityCache.viewport = outputState.viewport;
+    mVisibilityCache.entries = std::move(cacheEntries);
+}
+
+bool Output::VisibilityInputs::operator==(const VisibilityInputs& other) const {
+    return belongsInOutput == other.belongsInOutput && isVisible == other.isVisible &&
+            geomLayerTransform == other.geomLayerTransform &&
+            geomLayerBounds == other.geomLayerBounds && shadowRadius == other.shadowRadius &&
+            isOpaque == other.isOpaque &&
+            transparentRegionHint.hasSameRects(other.transparentRegionHint);
+}
+
+Output::VisibilityInputs Output::getVisibilityInputs(
+        const sp<compositionengine::LayerFE>& layerFE) const {
+    VisibilityInputs inputs;
+    if (!belongsInOutput(layerFE)) {
+        return inputs;
+    }
+
+    const auto* layerFEState = layerFE->getCompositionState();
+    inputs.belongsInOutput = true;
+    inputs.isVisible = layerFEState->isVisible;
+    inputs.geomLayerTransform = layerFEState->geomLayerTransform;
+    inputs.geomLayerBounds = layerFEState->geomLayerBounds;
+    inputs.shadowRadius = layerFEState->shadowRadius;
+    inputs.isOpaque = layerFEState->isOpaque;
+    inputs.transparentRegionHint = layerFEState->transparentRegionHint;
+    return inputs;
+}
+
+bool Output::reuseCachedVisibility(const sp<compositionengine::LayerFE>& layerFE,
+                                   const VisibilityCacheEntry& entry,
+                                   compositionengine::Output::CoverageState& coverage) {
+    if (entry.layerFE.promote() != layerFE) {
+        return false;
+    }
+
+    // The geometry snapshot is what the cached inputs are compared against.
+    if (!coverage.latchedLayers.count(layerFE)) {
+        coverage.latchedLayers.insert(layerFE);
+        layerFE->prepareCompositionState(compositionengine::LayerFE::StateSubset::BasicGeometry);
+    }
+
+    if (getVisibilityInputs(layerFE) != entry.inputs) {
+        return false;
+    }
+
+    if (entry.hasOutputLayer) {
+        // The regions computed last time are still held by the output layer.
+        const auto index = findCurrentOutputLayerForLayer(layerFE);
+        if (!index) {
+            return false;
+        }
+        const auto& outputLayerState = ensureOutputLayer(index, layerFE)->getState();
+
+        // This is what ensureOutputLayerIfVisible() computes when the old and
+        // new regions are the same.
+        if (layerFE->getCompositionState()->contentDirty) {
+            coverage.dirtyRegion.orSelf(outputLayerState.visibleRegion);
+        } else {
+            coverage.dirtyRegion.orSelf(
+                    outputLayerState.visibleRegion.intersect(outputLayerState.coveredRegion));
+        }
+    }
+
+    coverage.aboveCoveredLayers = entry.aboveCoveredLayers;
+    coverage.aboveOpaqueLayers = entry.aboveOpaqueLayers;
+    return true;
 }
 
 void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
@@ -578,6 +758,14 @@ void Output::updateAndWriteCompositionState(
     ATRACE_CALL();
     ALOGV(__FUNCTION__);
 
+    updateCompositionState(refreshArgs);
+    writeCompositionState(refreshArgs);
+}
+
+void Output::updateCompositionState(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
     if (!getState().isEnabled) {
         return;
     }
@@ -594,9 +782,34 @@ void Output::updateAndWriteCompositionState(
         if (mLayerRequestingBackgroundBlur == layer) {
             forceClientComposition = false;
         }
+    }
+}
+
+void Output::writeCompositionState(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
+    if (!getState().isEnabled) {
+        return;
+    }
+
+    bool includeGeometry = refreshArgs.updatingGeometryThisFrame;
+    if (refreshArgs.flattenStaticLayers) {
+        if (!mLayerFlattener) {
+            mLayerFlattener = std::make_unique<LayerFlattener>();
+        }
+        // Layers joining or leaving the flattened group change what every
+        // layer looks like to the HWC.
+        includeGeometry |= mLayerFlattener->update(*this, getCompositionEngine().getRenderEngine(),
+                                                   refreshArgs.updatingGeometryThisFrame);
+    } else if (mLayerFlattener) {
+        includeGeometry |= mLayerFlattener->clear(*this);
+        mLayerFlattener.reset();
+    }
 
-        // Send the updated state to the HWC, if appropriate.
-        layer->writeStateToHWC(refreshArgs.updatingGeometryThisFrame);
+    // Send the updated state to the HWC, if appropriate.
+    for (auto* layer : getOutputLayersOrderedByZ()) {
+        layer->writeStateToHWC(includeGeometry);
     }
 }
 
@@ -796,6 +1009,10 @@ void Output::finishFrame(const compositionengine::CompositionRefreshArgs& refres
         return;
     }
 
+    if (refreshArgs.forwardSingleLayerBuffers && forwardLayerBuffer()) {
+        return;
+    }
+
     // Repaint the framebuffer (if needed), getting the optional fence for when
     // the composition completes.
     auto optReadyFence = composeSurfaces(Region::INVALID_REGION, refreshArgs);
@@ -807,6 +1024,65 @@ void Output::finishFrame(const compositionengine::CompositionRefreshArgs& refres
     mRenderSurface->queueBuffer(std::move(*optReadyFence));
 }
 
+bool Output::forwardLayerBuffer() {
+    const auto& outputState = getState();
+    if (!outputState.usesClientComposition || outputState.usesDeviceComposition ||
+        outputState.orientation != ui::Transform::ROT_0 || outputState.needsFiltering ||
+        !(outputState.colorTransformMatrix == mat4()) ||
+        outputState.destinationClip != outputState.bounds) {
+        return false;
+    }
+
+    // Only a frame with nothing but a single layer drawn as is, over the whole
+    // output, can be replaced by that layer's buffer.
+    const OutputLayer* visibleLayer = nullptr;
+    for (const auto* layer : getOutputLayersOrderedByZ()) {
+        if (layer->getState().visibleRegion.isEmpty()) {
+            continue;
+        }
+        if (visibleLayer) {
+            return false;
+        }
+        visibleLayer = layer;
+    }
+    if (!visibleLayer) {
+        return false;
+    }
+
+    const auto& layerState = visibleLayer->getState();
+    const auto* layerFEState = visibleLayer->getLayerFE().getCompositionState();
+    if (!layerFEState || !layerFEState->buffer || layerFEState->sidebandStream ||
+        !layerFEState->isOpaque || layerFEState->alpha != 1.f ||
+        layerFEState->backgroundBlurRadius != 0 || layerFEState->shadowRadius != 0.f ||
+        !layerFEState->colorTransformIsIdentity || layerFEState->hasProtectedContent ||
+        (layerFEState->isSecure && !outputState.isSecure) ||
+        layerFEState->hdrMetadata.validTypes != 0 || layerState.overrideInfo.buffer ||
+        layerState.bufferTransform != 0 || visibleLayer->needsFiltering()) {
+        return false;
+    }
+
+    const auto& buffer = layerFEState->buffer;
+    const Rect bufferBounds(buffer->getWidth(), buffer->getHeight());
+    if (layerState.displayFrame != outputState.bounds ||
+        !(layerState.sourceCrop == bufferBounds.toFloatRect()) ||
+        bufferBounds.getWidth() != outputState.bounds.getWidth() ||
+        bufferBounds.getHeight() != outputState.bounds.getHeight()) {
+        return false;
+    }
+    if (outputState.dataspace != ui::Dataspace::UNKNOWN &&
+        layerState.dataspace != outputState.dataspace) {
+        return false;
+    }
+
+    if (!mRenderSurface->forwardBuffer(buffer, layerFEState->acquireFence, layerState.dataspace)) {
+        return false;
+    }
+
+    // The consumer's next buffer no longer follows the frames composed so far.
+    mClientCompositionDamageHistory.clear();
+    return true;
+}
+
 std::optional<base::unique_fd> Output::composeSurfaces(
         const Region& debugRegion, const compositionengine::CompositionRefreshArgs& refreshArgs) {
     ATRACE_CALL();
@@ -857,6 +1133,7 @@ std::optional<base::unique_fd> Output::composeSurfaces(
 
     base::unique_fd readyFence;
     if (!hasClientComposition) {
+        mClientCompositionDamageHistory.clear();
         setExpensiveRenderingExpected(false);
         return readyFence;
     }
@@ -894,6 +1171,7 @@ std::optional<base::unique_fd> Output::composeSurfaces(
         if (mClientCompositionRequestCache->exists(buf->getId(), clientCompositionDisplay,
                                                    clientCompositionLayers)) {
             outputCompositionState.reusedClientComposition = true;
+            mClientCompositionDamageHistory.clear();
             setExpensiveRenderingExpected(false);
             return readyFence;
         }
@@ -913,6 +1191,13 @@ std::optional<base::unique_fd> Output::composeSurfaces(
         setExpensiveRenderingExpected(true);
     }
 
+    if (refreshArgs.partialClientComposition) {
+        clientCompositionDisplay.damageRect =
+                updateClientCompositionDamage(refreshArgs, clientCompositionDisplay);
+    } else {
+        mClientCompositionDamageHistory.clear();
+    }
+
     std::vector<const renderengine::LayerSettings*> clientCompositionLayerPointers;
     clientCompositionLayerPointers.reserve(clientCompositionLayers.size());
     std::transform(clientCompositionLayers.begin(), clientCompositionLayers.end(),
@@ -927,9 +1212,13 @@ std::optional<base::unique_fd> Output::composeSurfaces(
                                     buf->getNativeBuffer(), /*useFramebufferCache=*/true,
                                     std::move(fd), &readyFence);
 
-    if (status != NO_ERROR && mClientCompositionRequestCache) {
+    if (status != NO_ERROR) {
         // If rendering was not successful, remove the request from the cache.
-        mClientCompositionRequestCache->remove(buf->getId());
+        if (mClientCompositionRequestCache) {
+            mClientCompositionRequestCache->remove(buf->getId());
+        }
+        // The buffer contents are unknown now.
+        mClientCompositionDamageHistory.clear();
     }
 
     auto& timeStats = getCompositionEngine().getTimeStats();
@@ -944,6 +1233,48 @@ std::optional<base::unique_fd> Output::composeSurfaces(
     return readyFence;
 }
 
+Rect Output::updateClientCompositionDamage(
+        const compositionengine::CompositionRefreshArgs& refreshArgs,
+        const renderengine::DisplaySettings& clientCompositionDisplay) {
+    const auto& outputState = getState();
+
+    // The damage of earlier frames only says what changed in the buffers if
+    // the same layers were client composited the same way since.
+    std::vector<std::pair<const LayerFE*, bool>> layers;
+    layers.reserve(getOutputLayerCount());
+    for (auto* layer : getOutputLayersOrderedByZ()) {
+        layers.emplace_back(&layer->getLayerFE(), layer->requiresClientComposition());
+    }
+    if (!(clientCompositionDisplay == mLastClientCompositionDisplay) ||
+        layers != mLastClientCompositionLayers) {
+        mClientCompositionDamageHistory.clear();
+        mLastClientCompositionDisplay = clientCompositionDisplay;
+        mLastClientCompositionLayers = std::move(layers);
+    }
+
+    mClientCompositionDamageHistory.push_front(
+            outputState.transform.transform(getDirtyRegion(refreshArgs.repaintEverything)));
+    if (mClientCompositionDamageHistory.size() > kMaxClientCompositionDamageHistory) {
+        mClientCompositionDamageHistory.pop_back();
+    }
+
+    // A buffer of age N last held the frame from N frames ago, so it is
+    // missing the damage of every frame since, including this one.
+    const int age = mRenderSurface->getBufferAge();
+    if (age <= 0 || static_cast<size_t>(age) > mClientCompositionDamageHistory.size()) {
+        return Rect::INVALID_RECT;
+    }
+
+    Region damage;
+    for (int i = 0; i < age; i++) {
+        damage.orSelf(mClientCompositionDamageHistory[i]);
+    }
+    const Rect damageRect = damage.getBounds();
+    Rect coveredRect;
+    damageRect.intersect(outputState.destinationClip, &coveredRect);
+    return coveredRect == outputState.destinationClip ? Rect::INVALID_RECT : damageRect;
+}
+
 std::vector<LayerFE::LayerSettings> Output::generateClientCompositionRequests(
         bool supportsProtectedContent, Region& clearRegion, ui::Dataspace outputDataspace) {
     std::vector<LayerFE::LayerSettings> clientCompositionLayers;
@@ -955,12 +1286,20 @@ std::vector<LayerFE::LayerSettings> Output::generateClientCompositionRequests(
     bool firstLayer = true;
     // Used when a layer clears part of the buffer.
     Region dummyRegion;
+    // The layers of a flattened group follow the layer presenting its buffer.
+    // They are only drawn here if that layer fell back to client composition,
+    // as otherwise their content is already in the buffer.
+    bool flattenedGroupUsesClientComposition = false;
 
     for (auto* layer : getOutputLayersOrderedByZ()) {
         const auto& layerState = layer->getState();
         const auto* layerFEState = layer->getLayerFE().getCompositionState();
         auto& layerFE = layer->getLayerFE();
 
+        if (layerState.overrideInfo.buffer) {
+            flattenedGroupUsesClientComposition = layer->requiresClientComposition();
+        }
+
         const Region clip(viewportRegion.intersect(layerState.visibleRegion));
         ALOGV("Layer: %s", layerFE.getDebugName());
         if (clip.isEmpty()) {
@@ -969,15 +1308,17 @@ std::vector<LayerFE::LayerSettings> Output::generateClientCompositionRequests(
             continue;
         }
 
-        const bool clientComposition = layer->requiresClientComposition();
+        const bool clientComposition = layerState.overrideInfo.skip
+                ? flattenedGroupUsesClientComposition
+                : layer->requiresClientComposition();
 
         // We clear the client target for non-client composed layers if
         // requested by the HWC. We skip this if the layer is not an opaque
         // rectangle, as by definition the layer must blend with whatever is
         // underneath. We also skip the first layer as the buffer target is
         // guaranteed to start out cleared.
-        const bool clearClientComposition =
-                layerState.clearClientTarget && layerFEState->isOpaque && !firstLayer;
+        const bool clearClientComposition = layerState.clearClientTarget &&
+                layerFEState->isOpaque && !firstLayer && !layerState.overrideInfo.skip;
 
         ALOGV("  Composition type: client %d clear %d", clientComposition, clearClientComposition);
 
@@ -1066,20 +1407,29 @@ void Output::postFramebuffer() {
             }
         }
 
-        // If the layer was client composited in the previous frame, we
-        // need to merge with the previous client target acquire fence.
-        // Since we do not track that, always merge with the current
-        // client target acquire fence when it is available, even though
-        // this is suboptimal.
-        // TODO(b/121291683): Track previous frame client target acquire fence.
-        if (outputState.usesClientComposition) {
+        // RenderEngine is done reading the buffer of a client composited
+        // layer once the client target acquire fence signals. Only merge
+        // with that fence for the layers it actually composed, in this or
+        // the previous frame, so that the buffers of device composited
+        // layers are not held back until client composition finishes.
+        auto& layerState = layer->editState();
+        const bool clientComposited =
+                outputState.usesClientComposition && layer->requiresClientComposition();
+        if (clientComposited) {
             releaseFence =
                     Fence::merge("LayerRelease", releaseFence, frame.clientTargetAcquireFence);
+        } else if (layerState.clientComposedLastFrame) {
+            releaseFence = Fence::merge("LayerRelease", releaseFence,
+                                        mPreviousClientTargetAcquireFence);
         }
+        layerState.clientComposedLastFrame = clientComposited;
 
         layer->getLayerFE().onLayerDisplayed(releaseFence);
     }
 
+    mPreviousClientTargetAcquireFence =
+            outputState.usesClientComposition ? frame.clientTargetAcquireFence : Fence::NO_FENCE;
+
     // We've got a list of layers needing fences, that are disjoint with
     // OutputLayersOrderedByZ.  The best we can do is to
     // supply them with the present fence.
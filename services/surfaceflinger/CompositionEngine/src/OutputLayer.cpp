@@ -20,6 +20,7 @@
 #include <compositionengine/LayerFE.h>
 #include <compositionengine/LayerFECompositionState.h>
 #include <compositionengine/Output.h>
+#include <compositionengine/impl/ObjectPool.h>
 #include <compositionengine/impl/OutputCompositionState.h>
 #include <compositionengine/impl/OutputLayer.h>
 #include <compositionengine/impl/OutputLayerCompositionState.h>
@@ -58,6 +59,14 @@ std::unique_ptr<OutputLayer> createOutputLayer(const compositionengine::Output&
 
 OutputLayer::~OutputLayer() = default;
 
+void* OutputLayer::operator new(size_t size) {
+    return ObjectPool::allocate(size);
+}
+
+void OutputLayer::operator delete(void* block, size_t size) {
+    ObjectPool::release(block, size);
+}
+
 void OutputLayer::setHwcLayer(std::shared_ptr<HWC2::Layer> hwcLayer) {
     auto& state = editState();
     if (hwcLayer) {
@@ -332,17 +341,25 @@ void OutputLayer::writeStateToHWC(bool includeGeometry) {
         return;
     }
 
+    // The layer presents a pre-rendered buffer for a group of static layers
+    // in place of its own content.
+    if (state.overrideInfo.buffer) {
+        writeOverrideStateToHWC(hwcLayer.get(), includeGeometry);
+        return;
+    }
+
     auto requestedCompositionType = outputIndependentState->compositionType;
 
     if (includeGeometry) {
         writeOutputDependentGeometryStateToHWC(hwcLayer.get(), requestedCompositionType);
-        writeOutputIndependentGeometryStateToHWC(hwcLayer.get(), *outputIndependentState);
+        writeOutputIndependentGeometryStateToHWC(hwcLayer.get(), *outputIndependentState,
+                                                 state.overrideInfo.skip);
     }
 
     writeOutputDependentPerFrameStateToHWC(hwcLayer.get());
     writeOutputIndependentPerFrameStateToHWC(hwcLayer.get(), *outputIndependentState);
 
-    writeCompositionTypeToHWC(hwcLayer.get(), requestedCompositionType);
+    writeCompositionTypeToHWC(hwcLayer.get(), requestedCompositionType, includeGeometry);
 
     // Always set the layer color after setting the composition type.
     writeSolidColorStateToHWC(hwcLayer.get(), *outputIndependentState);
@@ -396,7 +413,8 @@ void OutputLayer::writeOutputDependentGeometryStateToHWC(
 }
 
 void OutputLayer::writeOutputIndependentGeometryStateToHWC(
-        HWC2::Layer* hwcLayer, const LayerFECompositionState& outputIndependentState) {
+        HWC2::Layer* hwcLayer, const LayerFECompositionState& outputIndependentState,
+        bool skipLayer) {
     if (auto error = hwcLayer->setBlendMode(outputIndependentState.blendMode);
         error != hal::Error::NONE) {
         ALOGE("[%s] Failed to set blend mode %s: %s (%d)", getLayerFE().getDebugName(),
@@ -404,10 +422,12 @@ void OutputLayer::writeOutputIndependentGeometryStateToHWC(
               static_cast<int32_t>(error));
     }
 
-    if (auto error = hwcLayer->setPlaneAlpha(outputIndependentState.alpha);
-        error != hal::Error::NONE) {
-        ALOGE("[%s] Failed to set plane alpha %.3f: %s (%d)", getLayerFE().getDebugName(),
-              outputIndependentState.alpha, to_string(error).c_str(), static_cast<int32_t>(error));
+    // A skipped layer is drawn by another layer's override buffer, so it is
+    // made fully transparent rather than drawn twice.
+    const float alpha = skipLayer ? 0.0f : outputIndependentState.alpha;
+    if (auto error = hwcLayer->setPlaneAlpha(alpha); error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set plane alpha %.3f: %s (%d)", getLayerFE().getDebugName(), alpha,
+              to_string(error).c_str(), static_cast<int32_t>(error));
     }
 
     if (auto error = hwcLayer->setInfo(static_cast<uint32_t>(outputIndependentState.type),
@@ -539,8 +559,98 @@ void OutputLayer::writeBufferStateToHWC(HWC2::Layer* hwcLayer,
     }
 }
 
+void OutputLayer::writeOverrideStateToHWC(HWC2::Layer* hwcLayer, bool includeGeometry) {
+    auto& state = editState();
+    auto& overrideInfo = state.overrideInfo;
+
+    if (includeGeometry) {
+        if (auto error = hwcLayer->setDisplayFrame(overrideInfo.displayFrame);
+            error != hal::Error::NONE) {
+            ALOGE("[%s] Failed to set override display frame: %s (%d)",
+                  getLayerFE().getDebugName(), to_string(error).c_str(),
+                  static_cast<int32_t>(error));
+        }
+
+        // The buffer is rendered in output space, so the crop is the frame.
+        if (auto error = hwcLayer->setSourceCrop(overrideInfo.displayFrame.toFloatRect());
+            error != hal::Error::NONE) {
+            ALOGE("[%s] Failed to set override source crop: %s (%d)",
+                  getLayerFE().getDebugName(), to_string(error).c_str(),
+                  static_cast<int32_t>(error));
+        }
+
+        if (auto error = hwcLayer->setZOrder(state.z); error != hal::Error::NONE) {
+            ALOGE("[%s] Failed to set Z %u: %s (%d)", getLayerFE().getDebugName(), state.z,
+                  to_string(error).c_str(), static_cast<int32_t>(error));
+        }
+
+        if (auto error = hwcLayer->setTransform(static_cast<hal::Transform>(0));
+            error != hal::Error::NONE) {
+            ALOGE("[%s] Failed to set override transform: %s (%d)",
+                  getLayerFE().getDebugName(), to_string(error).c_str(),
+                  static_cast<int32_t>(error));
+        }
+
+        if (auto error = hwcLayer->setBlendMode(hal::BlendMode::PREMULTIPLIED);
+            error != hal::Error::NONE) {
+            ALOGE("[%s] Failed to set override blend mode: %s (%d)",
+                  getLayerFE().getDebugName(), to_string(error).c_str(),
+                  static_cast<int32_t>(error));
+        }
+
+        if (auto error = hwcLayer->setPlaneAlpha(1.0f); error != hal::Error::NONE) {
+            ALOGE("[%s] Failed to set override plane alpha: %s (%d)",
+                  getLayerFE().getDebugName(), to_string(error).c_str(),
+                  static_cast<int32_t>(error));
+        }
+    }
+
+    if (auto error = hwcLayer->setVisibleRegion(overrideInfo.visibleRegion);
+        error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override visible region: %s (%d)",
+              getLayerFE().getDebugName(), to_string(error).c_str(),
+              static_cast<int32_t>(error));
+    }
+
+    if (auto error = hwcLayer->setDataspace(overrideInfo.dataspace); error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override dataspace %d: %s (%d)", getLayerFE().getDebugName(),
+              overrideInfo.dataspace, to_string(error).c_str(), static_cast<int32_t>(error));
+    }
+
+    // Any per-layer color transform was applied when the buffer was rendered.
+    if (auto error = hwcLayer->setColorTransform(mat4()); error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override color transform: %s (%d)",
+              getLayerFE().getDebugName(), to_string(error).c_str(),
+              static_cast<int32_t>(error));
+    }
+
+    const Region& damage = overrideInfo.bufferChanged ? Region::INVALID_REGION : Region();
+    if (auto error = hwcLayer->setSurfaceDamage(damage); error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override surface damage: %s (%d)",
+              getLayerFE().getDebugName(), to_string(error).c_str(),
+              static_cast<int32_t>(error));
+    }
+
+    // Use the last slot, which producers rarely get to, so the layer's own
+    // buffers stay cached in the HWC while it is overridden.
+    uint32_t hwcSlot = 0;
+    sp<GraphicBuffer> hwcBuffer;
+    state.hwc->hwcBufferCache.getHwcBuffer(BufferQueue::NUM_BUFFER_SLOTS - 1, overrideInfo.buffer,
+                                           &hwcSlot, &hwcBuffer);
+    if (auto error = hwcLayer->setBuffer(hwcSlot, hwcBuffer, overrideInfo.acquireFence);
+        error != hal::Error::NONE) {
+        ALOGE("[%s] Failed to set override buffer %p: %s (%d)", getLayerFE().getDebugName(),
+              overrideInfo.buffer->handle, to_string(error).c_str(),
+              static_cast<int32_t>(error));
+    }
+    overrideInfo.bufferChanged = false;
+
+    writeCompositionTypeToHWC(hwcLayer, hal::Composition::DEVICE, includeGeometry);
+}
+
 void OutputLayer::writeCompositionTypeToHWC(HWC2::Layer* hwcLayer,
-                                            hal::Composition requestedCompositionType) {
+                                            hal::Composition requestedCompositionType,
+                                            bool includeGeometry) {
     auto& outputDependentState = editState();
 
     // If we are forcing client composition, we need to tell the HWC
@@ -548,8 +658,16 @@ void OutputLayer::writeCompositionTypeToHWC(HWC2::Layer* hwcLayer,
         requestedCompositionType = hal::Composition::CLIENT;
     }
 
+    // If the HWC changed the type asked for last frame, and nothing it based
+    // that decision on has changed, keep its choice. Asking again would only
+    // make it fall back to a full validate to change the type back.
+    const bool keepDeviceChoice = !includeGeometry &&
+            outputDependentState.hwc->requestedCompositionType == requestedCompositionType;
+    outputDependentState.hwc->requestedCompositionType = requestedCompositionType;
+
     // Set the requested composition type with the HWC whenever it changes
-    if (outputDependentState.hwc->hwcCompositionType != requestedCompositionType) {
+    if (!keepDeviceChoice &&
+        outputDependentState.hwc->hwcCompositionType != requestedCompositionType) {
         outputDependentState.hwc->hwcCompositionType = requestedCompositionType;
 
         if (auto error = hwcLayer->setCompositionType(requestedCompositionType);
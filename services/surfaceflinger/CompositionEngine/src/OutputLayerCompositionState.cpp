@@ -40,6 +40,10 @@ void dumpHwc(const OutputLayerCompositionState::Hwc& hwc, std::string& out) {
     }
 
     dumpVal(out, "composition", toString(hwc.hwcCompositionType), hwc.hwcCompositionType);
+    dumpVal(out, "requested", toString(hwc.requestedCompositionType),
+            hwc.requestedCompositionType);
+    out.append("\n           ");
+    hwc.hwcBufferCache.dump(out);
 }
 
 } // namespace
@@ -68,6 +72,16 @@ void OutputLayerCompositionState::dump(std::string& out) const {
     dumpVal(out, "bufferTransform", toString(bufferTransform), bufferTransform);
     dumpVal(out, "dataspace", toString(dataspace), dataspace);
     dumpVal(out, "z-index", z);
+    dumpVal(out, "clientComposedLastFrame", clientComposedLastFrame);
+
+    if (overrideInfo.buffer) {
+        out.append("\n      override: ");
+        dumpHex(out, "buffer", overrideInfo.buffer->getId());
+        dumpVal(out, "displayFrame", overrideInfo.displayFrame);
+        dumpVal(out, "dataspace", toString(overrideInfo.dataspace), overrideInfo.dataspace);
+    } else if (overrideInfo.skip) {
+        out.append("\n      override: skipped");
+    }
 
     if (hwc) {
         dumpHwc(*hwc, out);
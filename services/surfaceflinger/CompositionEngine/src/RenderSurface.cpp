@@ -169,6 +169,17 @@ sp<GraphicBuffer> RenderSurface::dequeueBuffer(base::unique_fd* bufferFence) {
     return mGraphicBuffer;
 }
 
+int RenderSurface::getBufferAge() const {
+    // The window reports the age of the buffer it handed out last. Not every
+    // window tracks buffer ages, in which case the contents are unknown.
+    int bufferAge = 0;
+    if (mNativeWindow->query(mNativeWindow.get(), NATIVE_WINDOW_BUFFER_AGE, &bufferAge) !=
+        NO_ERROR) {
+        return 0;
+    }
+    return bufferAge;
+}
+
 void RenderSurface::queueBuffer(base::unique_fd readyFence) {
     auto& state = mDisplay.getState();
 
@@ -217,6 +228,11 @@ void RenderSurface::queueBuffer(base::unique_fd readyFence) {
     }
 }
 
+bool RenderSurface::forwardBuffer(const sp<GraphicBuffer>& buffer, const sp<Fence>& acquireFence,
+                                  ui::Dataspace dataspace) {
+    return mDisplaySurface->forwardBuffer(buffer, acquireFence, dataspace);
+}
+
 void RenderSurface::onPresentDisplayCompleted() {
     mDisplaySurface->onFrameCommitted();
 }
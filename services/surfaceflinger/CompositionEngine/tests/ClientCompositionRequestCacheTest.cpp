@@ -0,0 +1,86 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/ClientCompositionRequestCache.h>
+#include <gtest/gtest.h>
+
+namespace android::compositionengine {
+namespace {
+
+class ClientCompositionRequestCacheTest : public testing::Test {
+public:
+    ClientCompositionRequestCacheTest() {
+        mDisplay.physicalDisplay = Rect(0, 0, 100, 200);
+        mDisplay.clip = Rect(0, 0, 100, 200);
+
+        LayerFE::LayerSettings layer;
+        layer.geometry.boundaries = FloatRect{1, 2, 3, 4};
+        layer.bufferId = 5;
+        layer.frameNumber = 6;
+        mLayers.push_back(layer);
+    }
+
+    impl::ClientCompositionRequestCache mCache{2};
+    renderengine::DisplaySettings mDisplay;
+    std::vector<LayerFE::LayerSettings> mLayers;
+};
+
+TEST_F(ClientCompositionRequestCacheTest, matchesRequestRenderedIntoSameBuffer) {
+    mCache.add(1, mDisplay, mLayers);
+
+    EXPECT_TRUE(mCache.exists(1, mDisplay, mLayers));
+    EXPECT_FALSE(mCache.exists(2, mDisplay, mLayers));
+    EXPECT_EQ(1u, mCache.getHitCount());
+    EXPECT_EQ(1u, mCache.getMissCount());
+}
+
+TEST_F(ClientCompositionRequestCacheTest, doesNotMatchChangedRequest) {
+    mCache.add(1, mDisplay, mLayers);
+
+    auto changedLayers = mLayers;
+    changedLayers[0].frameNumber++;
+    EXPECT_FALSE(mCache.exists(1, mDisplay, changedLayers));
+
+    auto changedDisplay = mDisplay;
+    changedDisplay.maxLuminance = 2.f;
+    EXPECT_FALSE(mCache.exists(1, changedDisplay, mLayers));
+
+    EXPECT_EQ(0u, mCache.getHitCount());
+    EXPECT_EQ(2u, mCache.getMissCount());
+}
+
+TEST_F(ClientCompositionRequestCacheTest, evictsLeastRecentlyUsedRequest) {
+    mCache.add(1, mDisplay, mLayers);
+    mCache.add(2, mDisplay, mLayers);
+
+    // Looking up the first buffer keeps it in the cache over the second.
+    EXPECT_TRUE(mCache.exists(1, mDisplay, mLayers));
+    mCache.add(3, mDisplay, mLayers);
+
+    EXPECT_TRUE(mCache.exists(1, mDisplay, mLayers));
+    EXPECT_FALSE(mCache.exists(2, mDisplay, mLayers));
+    EXPECT_TRUE(mCache.exists(3, mDisplay, mLayers));
+}
+
+TEST_F(ClientCompositionRequestCacheTest, removeDropsRequest) {
+    mCache.add(1, mDisplay, mLayers);
+    mCache.remove(1);
+
+    EXPECT_FALSE(mCache.exists(1, mDisplay, mLayers));
+}
+
+} // namespace
+} // namespace android::compositionengine
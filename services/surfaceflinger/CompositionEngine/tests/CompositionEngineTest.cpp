@@ -35,6 +35,7 @@ using ::testing::Ref;
 using ::testing::Return;
 using ::testing::ReturnRef;
 using ::testing::SaveArg;
+using ::testing::Sequence;
 using ::testing::StrictMock;
 
 struct CompositionEngineTest : public testing::Test {
@@ -122,6 +123,79 @@ TEST_F(CompositionEnginePresentTest, worksAsExpected) {
     mEngine.present(mRefreshArgs);
 }
 
+TEST_F(CompositionEnginePresentTest, updatesCompositionStateInParallelIfRequested) {
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput2, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput3, prepare(Ref(mRefreshArgs), _));
+
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput3, updateLayerStateFromFE(Ref(mRefreshArgs)));
+
+    // Each output's composition state is computed between beginning and
+    // finishing its presentation. The outputs are presented in order, but the
+    // order in which their composition state is computed is not defined.
+    Sequence s1, s2, s3, presents;
+    EXPECT_CALL(*mOutput1, beginPresent(Ref(mRefreshArgs))).InSequence(s1, presents);
+    EXPECT_CALL(*mOutput2, beginPresent(Ref(mRefreshArgs))).InSequence(s2, presents);
+    EXPECT_CALL(*mOutput3, beginPresent(Ref(mRefreshArgs))).InSequence(s3, presents);
+    EXPECT_CALL(*mOutput1, updateCompositionState(Ref(mRefreshArgs))).InSequence(s1);
+    EXPECT_CALL(*mOutput2, updateCompositionState(Ref(mRefreshArgs))).InSequence(s2);
+    EXPECT_CALL(*mOutput3, updateCompositionState(Ref(mRefreshArgs))).InSequence(s3);
+    EXPECT_CALL(*mOutput1, finishPresent(Ref(mRefreshArgs))).InSequence(s1, presents);
+    EXPECT_CALL(*mOutput2, finishPresent(Ref(mRefreshArgs))).InSequence(s2, presents);
+    EXPECT_CALL(*mOutput3, finishPresent(Ref(mRefreshArgs))).InSequence(s3, presents);
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2, mOutput3};
+    mRefreshArgs.parallelOutputCompositionState = true;
+    mEngine.present(mRefreshArgs);
+}
+
+TEST_F(CompositionEnginePresentTest, validatesDisplaysTogetherIfRequested) {
+    constexpr DisplayId kDisplayId1{123u};
+    constexpr DisplayId kDisplayId3{456u};
+    mEngine.setHwComposer(std::unique_ptr<android::HWComposer>(mHwc));
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput2, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput3, prepare(Ref(mRefreshArgs), _));
+
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput3, updateLayerStateFromFE(Ref(mRefreshArgs)));
+
+    EXPECT_CALL(*mOutput1, getDisplayIdToValidate()).WillRepeatedly(Return(kDisplayId1));
+    EXPECT_CALL(*mOutput2, getDisplayIdToValidate()).WillRepeatedly(Return(std::nullopt));
+    EXPECT_CALL(*mOutput3, getDisplayIdToValidate()).WillRepeatedly(Return(kDisplayId3));
+
+    // Every output is written before the displays that need it are validated,
+    // and none is presented until then.
+    InSequence seq;
+    EXPECT_CALL(*mOutput1, beginPresent(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, beginPresent(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput3, beginPresent(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, updateCompositionState(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, updateCompositionState(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput3, updateCompositionState(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, writeFrame(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, writeFrame(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput3, writeFrame(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mHwc,
+                validateDisplays(std::vector<DisplayId>{kDisplayId1, kDisplayId3}))
+            .WillOnce(Return(NO_ERROR));
+    EXPECT_CALL(*mOutput1, presentWrittenFrame(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, presentWrittenFrame(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput3, presentWrittenFrame(Ref(mRefreshArgs)));
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2, mOutput3};
+    mRefreshArgs.batchHwcValidate = true;
+    mEngine.present(mRefreshArgs);
+}
+
 /*
  * CompositionEngine::updateCursorAsync
  */
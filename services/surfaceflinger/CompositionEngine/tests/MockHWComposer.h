@@ -52,6 +52,7 @@ public:
     MOCK_METHOD3(getDeviceCompositionChanges,
                  status_t(DisplayId, bool,
                           std::optional<android::HWComposer::DeviceRequestedChanges>*));
+    MOCK_METHOD1(validateDisplays, status_t(const std::vector<DisplayId>&));
     MOCK_METHOD5(setClientTarget,
                  status_t(DisplayId, uint32_t, const sp<Fence>&, const sp<GraphicBuffer>&,
                           ui::Dataspace));
@@ -32,6 +32,7 @@ public:
     MOCK_METHOD0(onBootFinished, void());
     MOCK_METHOD2(setExpensiveRenderingExpected, void(DisplayId displayId, bool expected));
     MOCK_METHOD0(notifyDisplayUpdateImminent, void());
+    MOCK_METHOD2(reportFrameWorkDuration, void(nsecs_t actualDuration, nsecs_t targetDuration));
 };
 
 } // namespace mock
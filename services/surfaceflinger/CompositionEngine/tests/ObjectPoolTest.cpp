@@ -0,0 +1,90 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/impl/ObjectPool.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+namespace android::compositionengine {
+namespace {
+
+using impl::ObjectPool;
+
+// A size no other test allocates, so the pool starts with nothing free for it.
+constexpr size_t kTestSize = 1000;
+constexpr size_t kTestBlockSize = 1008;
+
+TEST(ObjectPoolTest, reusesReleasedBlockOfSameSize) {
+    void* first = ObjectPool::allocate(kTestSize);
+    ObjectPool::release(first, kTestSize);
+
+    const auto before = ObjectPool::getStats();
+    void* second = ObjectPool::allocate(kTestSize - 8);
+    const auto after = ObjectPool::getStats();
+
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(before.hits + 1, after.hits);
+    EXPECT_EQ(before.freeBlocks - 1, after.freeBlocks);
+    EXPECT_EQ(before.liveBytes + kTestBlockSize, after.liveBytes);
+
+    ObjectPool::release(second, kTestSize - 8);
+}
+
+TEST(ObjectPoolTest, keepsAtMostMaxFreeBytesPerSize) {
+    constexpr size_t kCount = ObjectPool::kMaxFreeBytesPerBucket / kTestBlockSize + 4;
+
+    std::vector<void*> blocks;
+    for (size_t i = 0; i < kCount; i++) {
+        blocks.push_back(ObjectPool::allocate(kTestSize));
+    }
+
+    const auto before = ObjectPool::getStats();
+    for (void* block : blocks) {
+        ObjectPool::release(block, kTestSize);
+    }
+    const auto after = ObjectPool::getStats();
+
+    EXPECT_EQ(before.liveBlocks - kCount, after.liveBlocks);
+    EXPECT_LE(after.freeBytes - before.freeBytes, ObjectPool::kMaxFreeBytesPerBucket);
+    EXPECT_LT(after.freeBlocks - before.freeBlocks, kCount);
+}
+
+TEST(ObjectPoolTest, doesNotPoolLargeBlocks) {
+    const auto before = ObjectPool::getStats();
+    void* block = ObjectPool::allocate(ObjectPool::kMaxPooledSize + 1);
+    ASSERT_NE(nullptr, block);
+    ObjectPool::release(block, ObjectPool::kMaxPooledSize + 1);
+    const auto after = ObjectPool::getStats();
+
+    EXPECT_EQ(before.hits, after.hits);
+    EXPECT_EQ(before.misses, after.misses);
+    EXPECT_EQ(before.freeBlocks, after.freeBlocks);
+}
+
+TEST(ObjectPoolTest, layerFECompositionStateIsPooled) {
+    auto state = std::make_unique<LayerFECompositionState>();
+    const auto before = ObjectPool::getStats();
+    state.reset();
+    const auto after = ObjectPool::getStats();
+
+    EXPECT_EQ(before.liveBlocks - 1, after.liveBlocks);
+}
+
+} // namespace
+} // namespace android::compositionengine
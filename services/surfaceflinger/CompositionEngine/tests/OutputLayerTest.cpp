@@ -925,6 +925,107 @@ TEST_F(OutputLayerWriteStateToHWCTest, compositionTypeIsNotSetIfUnchanged) {
     mOutputLayer.writeStateToHWC(false);
 }
 
+TEST_F(OutputLayerWriteStateToHWCTest, compositionTypeChangedByHwcIsKeptIfRequestUnchanged) {
+    // The HWC switched the layer to client composition when it was last
+    // validated.
+    (*mOutputLayer.editState().hwc).requestedCompositionType =
+            Hwc2::IComposerClient::Composition::DEVICE;
+    (*mOutputLayer.editState().hwc).hwcCompositionType =
+            Hwc2::IComposerClient::Composition::CLIENT;
+
+    mLayerFEState.compositionType = Hwc2::IComposerClient::Composition::DEVICE;
+
+    expectPerFrameCommonCalls();
+    expectSetHdrMetadataAndBufferCalls();
+    expectNoSetCompositionTypeCall();
+
+    mOutputLayer.writeStateToHWC(false);
+
+    EXPECT_EQ(Hwc2::IComposerClient::Composition::CLIENT,
+              (*mOutputLayer.getState().hwc).hwcCompositionType);
+}
+
+TEST_F(OutputLayerWriteStateToHWCTest, compositionTypeChangedByHwcIsRequestedAgainOnGeometryChange) {
+    (*mOutputLayer.editState().hwc).requestedCompositionType =
+            Hwc2::IComposerClient::Composition::DEVICE;
+    (*mOutputLayer.editState().hwc).hwcCompositionType =
+            Hwc2::IComposerClient::Composition::CLIENT;
+
+    mLayerFEState.compositionType = Hwc2::IComposerClient::Composition::DEVICE;
+
+    expectGeometryCommonCalls();
+    expectPerFrameCommonCalls();
+    expectSetHdrMetadataAndBufferCalls();
+    expectSetCompositionTypeCall(Hwc2::IComposerClient::Composition::DEVICE);
+
+    mOutputLayer.writeStateToHWC(true);
+}
+
+TEST_F(OutputLayerWriteStateToHWCTest, overrideBufferIsSentInPlaceOfLayerContent) {
+    const sp<GraphicBuffer> overrideBuffer = new GraphicBuffer();
+    const sp<Fence> overrideFence = new Fence();
+    const Rect overrideDisplayFrame{1, 2, 3, 4};
+    const Region overrideVisibleRegion{Rect{1, 2, 3, 4}};
+
+    auto& overrideInfo = mOutputLayer.editState().overrideInfo;
+    overrideInfo.buffer = overrideBuffer;
+    overrideInfo.acquireFence = overrideFence;
+    overrideInfo.displayFrame = overrideDisplayFrame;
+    overrideInfo.visibleRegion = overrideVisibleRegion;
+    overrideInfo.dataspace = ui::Dataspace::V0_SRGB;
+    overrideInfo.bufferChanged = true;
+
+    mLayerFEState.compositionType = Hwc2::IComposerClient::Composition::SOLID_COLOR;
+
+    EXPECT_CALL(*mHwcLayer, setDisplayFrame(overrideDisplayFrame)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setSourceCrop(overrideDisplayFrame.toFloatRect()))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setZOrder(kZOrder)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setTransform(static_cast<Hwc2::Transform>(0)))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setBlendMode(Hwc2::IComposerClient::BlendMode::PREMULTIPLIED))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setPlaneAlpha(1.0f)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setVisibleRegion(RegionEq(overrideVisibleRegion)))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setDataspace(ui::Dataspace::V0_SRGB)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setColorTransform(mat4())).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setSurfaceDamage(RegionEq(Region::INVALID_REGION)))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer,
+                setBuffer(BufferQueue::NUM_BUFFER_SLOTS - 1, overrideBuffer, overrideFence));
+    expectSetCompositionTypeCall(Hwc2::IComposerClient::Composition::DEVICE);
+
+    mOutputLayer.writeStateToHWC(true);
+
+    EXPECT_FALSE(mOutputLayer.getState().overrideInfo.bufferChanged);
+}
+
+TEST_F(OutputLayerWriteStateToHWCTest, unchangedOverrideBufferIsSentWithoutDamage) {
+    const sp<GraphicBuffer> overrideBuffer = new GraphicBuffer();
+    const Region overrideVisibleRegion{Rect{1, 2, 3, 4}};
+
+    auto& overrideInfo = mOutputLayer.editState().overrideInfo;
+    overrideInfo.buffer = overrideBuffer;
+    overrideInfo.visibleRegion = overrideVisibleRegion;
+    overrideInfo.dataspace = ui::Dataspace::V0_SRGB;
+
+    (*mOutputLayer.editState().hwc).requestedCompositionType =
+            Hwc2::IComposerClient::Composition::DEVICE;
+    (*mOutputLayer.editState().hwc).hwcCompositionType =
+            Hwc2::IComposerClient::Composition::DEVICE;
+
+    EXPECT_CALL(*mHwcLayer, setVisibleRegion(RegionEq(overrideVisibleRegion)))
+            .WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setDataspace(ui::Dataspace::V0_SRGB)).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setColorTransform(mat4())).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setSurfaceDamage(RegionEq(Region()))).WillOnce(Return(kError));
+    EXPECT_CALL(*mHwcLayer, setBuffer(BufferQueue::NUM_BUFFER_SLOTS - 1, overrideBuffer, _));
+    expectNoSetCompositionTypeCall();
+
+    mOutputLayer.writeStateToHWC(false);
+}
+
 TEST_F(OutputLayerWriteStateToHWCTest, compositionTypeIsSetToClientIfColorTransformNotSupported) {
     mLayerFEState.compositionType = Hwc2::IComposerClient::Composition::SOLID_COLOR;
 
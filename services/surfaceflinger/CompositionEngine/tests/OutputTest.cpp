@@ -986,11 +986,14 @@ struct OutputCollectVisibleLayersTest : public testing::Test {
         Layer() {
             EXPECT_CALL(outputLayer, getState()).WillRepeatedly(ReturnRef(outputLayerState));
             EXPECT_CALL(outputLayer, editState()).WillRepeatedly(ReturnRef(outputLayerState));
+            EXPECT_CALL(outputLayer, getLayerFE()).WillRepeatedly(ReturnRef(*layerFE.get()));
+            EXPECT_CALL(*layerFE, getCompositionState()).WillRepeatedly(Return(&layerFEState));
         }
 
         StrictMock<mock::OutputLayer> outputLayer;
         impl::OutputLayerCompositionState outputLayerState;
         sp<StrictMock<mock::LayerFE>> layerFE{new StrictMock<mock::LayerFE>()};
+        LayerFECompositionState layerFEState;
     };
 
     OutputCollectVisibleLayersTest() {
@@ -1046,6 +1049,53 @@ TEST_F(OutputCollectVisibleLayersTest, processesCandidateLayersReversedAndSetsOu
     EXPECT_EQ(2u, mLayer3.outputLayerState.z);
 }
 
+TEST_F(OutputCollectVisibleLayersTest, reusesCachedCoverageOfUnchangedFrontLayers) {
+    mRefreshArgs.incrementalVisibleRegions = true;
+    mOutput.mState.layerStackId = 1u;
+    for (auto* layer : {&mLayer1, &mLayer2, &mLayer3}) {
+        layer->layerFEState.layerStackId = 1u;
+        layer->layerFEState.isVisible = true;
+        layer->layerFEState.geomLayerBounds = FloatRect{0, 0, 100, 200};
+        mGeomSnapshots.insert(layer->layerFE);
+    }
+    mLayer3.outputLayerState.visibleRegion = Region(Rect(0, 0, 100, 100));
+    mLayer3.outputLayerState.coveredRegion = Region(Rect(0, 0, 100, 50));
+
+    EXPECT_CALL(mOutput, setReleasedLayers(Ref(mRefreshArgs))).Times(3);
+    EXPECT_CALL(mOutput, finalizePendingOutputLayers()).Times(3);
+
+    // Nothing is cached on the first rebuild, so every layer is evaluated.
+    Output::CoverageState firstCoverage{mGeomSnapshots};
+    EXPECT_CALL(mOutput, ensureOutputLayerIfVisible(_, Ref(firstCoverage))).Times(3);
+    mOutput.collectVisibleLayers(mRefreshArgs, firstCoverage);
+
+    // Nothing changed, so every output layer is carried over as it was.
+    Output::CoverageState secondCoverage{mGeomSnapshots};
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(std::make_optional<size_t>(2u)),
+                                           Eq(mLayer3.layerFE)))
+            .WillOnce(Return(&mLayer3.outputLayer));
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(std::make_optional<size_t>(1u)),
+                                           Eq(mLayer2.layerFE)))
+            .WillOnce(Return(&mLayer2.outputLayer));
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(std::make_optional<size_t>(0u)),
+                                           Eq(mLayer1.layerFE)))
+            .WillOnce(Return(&mLayer1.outputLayer));
+    mOutput.collectVisibleLayers(mRefreshArgs, secondCoverage);
+
+    EXPECT_THAT(secondCoverage.dirtyRegion, RegionEq(Region(Rect(0, 0, 100, 50))));
+
+    // Once the middle layer moves, it and everything below it is evaluated
+    // again.
+    mLayer2.layerFEState.geomLayerBounds = FloatRect{10, 10, 100, 200};
+    Output::CoverageState thirdCoverage{mGeomSnapshots};
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(std::make_optional<size_t>(2u)),
+                                           Eq(mLayer3.layerFE)))
+            .WillOnce(Return(&mLayer3.outputLayer));
+    EXPECT_CALL(mOutput, ensureOutputLayerIfVisible(Eq(mLayer2.layerFE), Ref(thirdCoverage)));
+    EXPECT_CALL(mOutput, ensureOutputLayerIfVisible(Eq(mLayer1.layerFE), Ref(thirdCoverage)));
+    mOutput.collectVisibleLayers(mRefreshArgs, thirdCoverage);
+}
+
 /*
  * Output::ensureOutputLayerIfVisible()
  */
@@ -1545,6 +1595,8 @@ struct OutputPresentTest : public testing::Test {
         MOCK_METHOD1(updateColorProfile, void(const compositionengine::CompositionRefreshArgs&));
         MOCK_METHOD1(updateAndWriteCompositionState,
                      void(const compositionengine::CompositionRefreshArgs&));
+        MOCK_METHOD1(writeCompositionState,
+                     void(const compositionengine::CompositionRefreshArgs&));
         MOCK_METHOD1(setColorTransform, void(const compositionengine::CompositionRefreshArgs&));
         MOCK_METHOD0(beginFrame, void());
         MOCK_METHOD0(prepareFrame, void());
@@ -1572,6 +1624,29 @@ TEST_F(OutputPresentTest, justInvokesChildFunctionsInSequence) {
     mOutput.present(args);
 }
 
+TEST_F(OutputPresentTest, beginPresentOnlyUpdatesTheColorProfile) {
+    CompositionRefreshArgs args;
+
+    EXPECT_CALL(mOutput, updateColorProfile(Ref(args)));
+
+    mOutput.beginPresent(args);
+}
+
+TEST_F(OutputPresentTest, finishPresentWritesCompositionStateThenPresents) {
+    CompositionRefreshArgs args;
+
+    InSequence seq;
+    EXPECT_CALL(mOutput, writeCompositionState(Ref(args)));
+    EXPECT_CALL(mOutput, setColorTransform(Ref(args)));
+    EXPECT_CALL(mOutput, beginFrame());
+    EXPECT_CALL(mOutput, prepareFrame());
+    EXPECT_CALL(mOutput, devOptRepaintFlash(Ref(args)));
+    EXPECT_CALL(mOutput, finishFrame(Ref(args)));
+    EXPECT_CALL(mOutput, postFramebuffer());
+
+    mOutput.finishPresent(args);
+}
+
 /*
  * Output::updateColorProfile()
  */
@@ -2549,6 +2624,7 @@ struct OutputFinishFrameTest : public testing::Test {
                      std::optional<base::unique_fd>(
                              const Region&, const compositionengine::CompositionRefreshArgs&));
         MOCK_METHOD0(postFramebuffer, void());
+        MOCK_METHOD0(forwardLayerBuffer, bool());
     };
 
     OutputFinishFrameTest() {
@@ -2589,6 +2665,29 @@ TEST_F(OutputFinishFrameTest, queuesBufferIfComposeSurfacesReturnsAFence) {
     mOutput.finishFrame(mRefreshArgs);
 }
 
+TEST_F(OutputFinishFrameTest, skipsComposeIfLayerBufferForwarded) {
+    mOutput.mState.isEnabled = true;
+    mRefreshArgs.forwardSingleLayerBuffers = true;
+
+    InSequence seq;
+    EXPECT_CALL(mOutput, forwardLayerBuffer()).WillOnce(Return(true));
+
+    mOutput.finishFrame(mRefreshArgs);
+}
+
+TEST_F(OutputFinishFrameTest, composesIfLayerBufferNotForwarded) {
+    mOutput.mState.isEnabled = true;
+    mRefreshArgs.forwardSingleLayerBuffers = true;
+
+    InSequence seq;
+    EXPECT_CALL(mOutput, forwardLayerBuffer()).WillOnce(Return(false));
+    EXPECT_CALL(mOutput, composeSurfaces(RegionEq(Region::INVALID_REGION), _))
+            .WillOnce(Return(ByMove(base::unique_fd())));
+    EXPECT_CALL(*mRenderSurface, queueBuffer(_));
+
+    mOutput.finishFrame(mRefreshArgs);
+}
+
 /*
  * Output::postFramebuffer()
  */
@@ -2604,11 +2703,14 @@ struct OutputPostFramebufferTest : public testing::Test {
         Layer() {
             EXPECT_CALL(outputLayer, getLayerFE()).WillRepeatedly(ReturnRef(layerFE));
             EXPECT_CALL(outputLayer, getHwcLayer()).WillRepeatedly(Return(&hwc2Layer));
+            EXPECT_CALL(outputLayer, editState()).WillRepeatedly(ReturnRef(outputLayerState));
+            EXPECT_CALL(outputLayer, requiresClientComposition()).WillRepeatedly(Return(false));
         }
 
         StrictMock<mock::OutputLayer> outputLayer;
         StrictMock<mock::LayerFE> layerFE;
         StrictMock<HWC2::mock::Layer> hwc2Layer;
+        impl::OutputLayerCompositionState outputLayerState;
     };
 
     OutputPostFramebufferTest() {
@@ -2707,18 +2809,59 @@ TEST_F(OutputPostFramebufferTest, releaseFencesIncludeClientTargetAcquireFence)
     frameFences.layerFences.emplace(&mLayer2.hwc2Layer, layer2Fence);
     frameFences.layerFences.emplace(&mLayer3.hwc2Layer, layer3Fence);
 
+    EXPECT_CALL(mLayer1.outputLayer, requiresClientComposition()).WillRepeatedly(Return(true));
+    EXPECT_CALL(mLayer2.outputLayer, requiresClientComposition()).WillRepeatedly(Return(true));
+
     EXPECT_CALL(*mRenderSurface, flip());
     EXPECT_CALL(mOutput, presentAndGetFrameFences()).WillOnce(Return(frameFences));
     EXPECT_CALL(*mRenderSurface, onPresentDisplayCompleted());
 
-    // Fence::merge is called, and since none of the fences are actually valid,
-    // Fence::NO_FENCE is returned and passed to each onLayerDisplayed() call.
-    // This is the best we can do without creating a real kernel fence object.
+    // Fence::merge is called for the client composited layers, and since none
+    // of the fences are actually valid, Fence::NO_FENCE is returned and passed
+    // to their onLayerDisplayed() call. This is the best we can do without
+    // creating a real kernel fence object.
     EXPECT_CALL(mLayer1.layerFE, onLayerDisplayed(Fence::NO_FENCE));
     EXPECT_CALL(mLayer2.layerFE, onLayerDisplayed(Fence::NO_FENCE));
-    EXPECT_CALL(mLayer3.layerFE, onLayerDisplayed(Fence::NO_FENCE));
+    // The device composited layer is released without waiting for the client
+    // composition.
+    EXPECT_CALL(mLayer3.layerFE,
+                onLayerDisplayed(Property(&sp<Fence>::get, Eq(layer3Fence.get()))));
 
     mOutput.postFramebuffer();
+
+    EXPECT_TRUE(mLayer1.outputLayerState.clientComposedLastFrame);
+    EXPECT_TRUE(mLayer2.outputLayerState.clientComposedLastFrame);
+    EXPECT_FALSE(mLayer3.outputLayerState.clientComposedLastFrame);
+}
+
+TEST_F(OutputPostFramebufferTest, releaseFencesIncludePreviousClientTargetAcquireFence) {
+    mOutput.mState.isEnabled = true;
+    mOutput.mState.usesClientComposition = false;
+    mLayer1.outputLayerState.clientComposedLastFrame = true;
+
+    sp<Fence> layer1Fence = new Fence();
+    sp<Fence> layer2Fence = new Fence();
+    sp<Fence> layer3Fence = new Fence();
+    Output::FrameFences frameFences;
+    frameFences.layerFences.emplace(&mLayer1.hwc2Layer, layer1Fence);
+    frameFences.layerFences.emplace(&mLayer2.hwc2Layer, layer2Fence);
+    frameFences.layerFences.emplace(&mLayer3.hwc2Layer, layer3Fence);
+
+    EXPECT_CALL(*mRenderSurface, flip());
+    EXPECT_CALL(mOutput, presentAndGetFrameFences()).WillOnce(Return(frameFences));
+    EXPECT_CALL(*mRenderSurface, onPresentDisplayCompleted());
+
+    // Only the layer client composited in the previous frame has its fence
+    // merged with that frame's client target acquire fence.
+    EXPECT_CALL(mLayer1.layerFE, onLayerDisplayed(Fence::NO_FENCE));
+    EXPECT_CALL(mLayer2.layerFE,
+                onLayerDisplayed(Property(&sp<Fence>::get, Eq(layer2Fence.get()))));
+    EXPECT_CALL(mLayer3.layerFE,
+                onLayerDisplayed(Property(&sp<Fence>::get, Eq(layer3Fence.get()))));
+
+    mOutput.postFramebuffer();
+
+    EXPECT_FALSE(mLayer1.outputLayerState.clientComposedLastFrame);
 }
 
 TEST_F(OutputPostFramebufferTest, releasedLayersSentPresentFence) {
@@ -230,6 +230,23 @@ TEST_F(RenderSurfaceTest, dequeueBufferObtainsABuffer) {
     EXPECT_EQ(buffer.get(), mSurface.mutableGraphicBufferForTest().get());
 }
 
+/*
+ * RenderSurface::getBufferAge()
+ */
+
+TEST_F(RenderSurfaceTest, getBufferAgeReturnsAgeFromNativeWindow) {
+    EXPECT_CALL(*mNativeWindow, query(NATIVE_WINDOW_BUFFER_AGE, _))
+            .WillOnce(DoAll(SetArgPointee<1>(2), Return(NO_ERROR)));
+
+    EXPECT_EQ(2, mSurface.getBufferAge());
+}
+
+TEST_F(RenderSurfaceTest, getBufferAgeReturnsZeroIfNativeWindowCannotTell) {
+    EXPECT_CALL(*mNativeWindow, query(NATIVE_WINDOW_BUFFER_AGE, _)).WillOnce(Return(BAD_VALUE));
+
+    EXPECT_EQ(0, mSurface.getBufferAge());
+}
+
 /*
  * RenderSurface::queueBuffer()
  */
@@ -326,6 +343,20 @@ TEST_F(RenderSurfaceTest, queueBufferHandlesNativeWindowQueueBufferFailureOnVirt
     EXPECT_EQ(nullptr, mSurface.mutableGraphicBufferForTest().get());
 }
 
+/*
+ * RenderSurface::forwardBuffer()
+ */
+
+TEST_F(RenderSurfaceTest, forwardBufferForwardsToDisplaySurface) {
+    sp<GraphicBuffer> buffer = new GraphicBuffer();
+    sp<Fence> fence = new Fence();
+
+    EXPECT_CALL(*mDisplaySurface, forwardBuffer(buffer, fence, ui::Dataspace::SRGB))
+            .WillOnce(Return(true));
+
+    EXPECT_TRUE(mSurface.forwardBuffer(buffer, fence, ui::Dataspace::SRGB));
+}
+
 /*
  * RenderSurface::onPresentDisplayCompleted()
  */
@@ -72,8 +72,12 @@ DisplayDevice::DisplayDevice(DisplayDeviceCreationArgs& args)
 
     if (!mFlinger->mDisableClientCompositionCache &&
         SurfaceFlinger::maxFrameBufferAcquiredBuffers > 0) {
-        mCompositionDisplay->createClientCompositionCache(
-                static_cast<uint32_t>(SurfaceFlinger::maxFrameBufferAcquiredBuffers));
+        // The RenderSurface rotates through one more buffer than can be
+        // acquired, so cache a request for each of them by default.
+        const uint32_t cacheSize = mFlinger->mClientCompositionCacheSize > 0
+                ? mFlinger->mClientCompositionCacheSize
+                : static_cast<uint32_t>(SurfaceFlinger::maxFrameBufferAcquiredBuffers) + 1;
+        mCompositionDisplay->createClientCompositionCache(cacheSize);
     }
 
     mCompositionDisplay->createDisplayColorProfile(
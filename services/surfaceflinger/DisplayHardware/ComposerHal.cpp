@@ -669,6 +669,12 @@ Error Composer::setClientTargetSlotCount(Display display)
 Error Composer::validateDisplay(Display display, uint32_t* outNumTypes,
         uint32_t* outNumRequests)
 {
+    if (mPrevalidatedDisplays.erase(display) != 0) {
+        mReader.releaseData(display);
+        mReader.hasChanges(display, outNumTypes, outNumRequests);
+        return Error::NONE;
+    }
+
     mWriter.selectDisplay(display);
     mWriter.validateDisplay();
 
@@ -684,6 +690,15 @@ Error Composer::validateDisplay(Display display, uint32_t* outNumTypes,
 
 Error Composer::presentOrValidateDisplay(Display display, uint32_t* outNumTypes,
                                uint32_t* outNumRequests, int* outPresentFence, uint32_t* state) {
+   if (mPrevalidatedDisplays.erase(display) != 0) {
+       // The display has already been validated, which the HAL may always choose to do instead
+       // of presenting.
+       mReader.releaseData(display);
+       *state = 0;
+       mReader.hasChanges(display, outNumTypes, outNumRequests);
+       return Error::NONE;
+   }
+
    mWriter.selectDisplay(display);
    mWriter.presentOrvalidateDisplay();
 
@@ -705,6 +720,30 @@ Error Composer::presentOrValidateDisplay(Display display, uint32_t* outNumTypes,
    return Error::NONE;
 }
 
+Error Composer::validateDisplays(const std::vector<Display>& displays) {
+    // Drop whatever was kept from a previous batch and never taken.
+    for (Display display : mPrevalidatedDisplays) {
+        mReader.releaseData(display);
+    }
+    mPrevalidatedDisplays.clear();
+
+    for (Display display : displays) {
+        mWriter.selectDisplay(display);
+        mWriter.validateDisplay();
+    }
+
+    Error error = execute();
+    if (error != Error::NONE) {
+        return error;
+    }
+
+    for (Display display : displays) {
+        mReader.retainData(display);
+        mPrevalidatedDisplays.insert(display);
+    }
+    return Error::NONE;
+}
+
 Error Composer::setCursorPosition(Display display, Layer layer,
         int32_t x, int32_t y)
 {
@@ -1362,6 +1401,7 @@ Error Composer::getClientTargetProperty(
 
 CommandReader::~CommandReader()
 {
+    mRetainedDisplays.clear();
     resetData();
 }
 
@@ -1553,21 +1593,34 @@ void CommandReader::resetData()
 {
     mErrors.clear();
 
-    for (auto& data : mReturnData) {
-        if (data.second.presentFence >= 0) {
-            close(data.second.presentFence);
+    for (auto it = mReturnData.begin(); it != mReturnData.end();) {
+        if (mRetainedDisplays.count(it->first) != 0) {
+            ++it;
+            continue;
+        }
+        ReturnData& data = it->second;
+        if (data.presentFence >= 0) {
+            close(data.presentFence);
         }
-        for (auto fence : data.second.releaseFences) {
+        for (auto fence : data.releaseFences) {
             if (fence >= 0) {
                 close(fence);
             }
         }
+        it = mReturnData.erase(it);
     }
 
-    mReturnData.clear();
     mCurrentReturnData = nullptr;
 }
 
+void CommandReader::retainData(Display display) {
+    mRetainedDisplays.insert(display);
+}
+
+void CommandReader::releaseData(Display display) {
+    mRetainedDisplays.erase(display);
+}
+
 std::vector<CommandReader::CommandError> CommandReader::takeErrors()
 {
     return std::move(mErrors);
@@ -20,6 +20,7 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -164,6 +165,12 @@ public:
                                            uint32_t* outNumRequests, int* outPresentFence,
                                            uint32_t* state) = 0;
 
+    // Validates several displays in a single round trip. The results are kept until the next
+    // validateDisplay or presentOrValidateDisplay call for each display, which then returns them
+    // without another round trip. On error nothing is kept, and each display is validated on its
+    // own as usual.
+    virtual Error validateDisplays(const std::vector<Display>& displays) = 0;
+
     virtual Error setCursorPosition(Display display, Layer layer, int32_t x, int32_t y) = 0;
     /* see setClientTarget for the purpose of slot */
     virtual Error setLayerBuffer(Display display, Layer layer, uint32_t slot,
@@ -288,6 +295,11 @@ public:
     void takeClientTargetProperty(Display display,
                                   IComposerClient::ClientTargetProperty* outClientTargetProperty);
 
+    // Keeps the saved data of the display when the next commands are parsed, until it is
+    // released again.
+    void retainData(Display display);
+    void releaseData(Display display);
+
 private:
     void resetData();
 
@@ -326,6 +338,7 @@ private:
 
     std::vector<CommandError> mErrors;
     std::unordered_map<Display, ReturnData> mReturnData;
+    std::unordered_set<Display> mRetainedDisplays;
 
     // When SELECT_DISPLAY is parsed, this is updated to point to the
     // display's return data in mReturnData.  We use it to avoid repeated
@@ -413,6 +426,7 @@ public:
 
     Error presentOrValidateDisplay(Display display, uint32_t* outNumTypes, uint32_t* outNumRequests,
                                    int* outPresentFence, uint32_t* state) override;
+    Error validateDisplays(const std::vector<Display>& displays) override;
 
     Error setCursorPosition(Display display, Layer layer, int32_t x, int32_t y) override;
     /* see setClientTarget for the purpose of slot */
@@ -532,6 +546,9 @@ private:
     CommandWriter mWriter;
     CommandReader mReader;
 
+    // Displays validated by validateDisplays() whose results have not been taken yet.
+    std::unordered_set<Display> mPrevalidatedDisplays;
+
     // When true, the we attach to the vr_hwcomposer service instead of the
     // hwcomposer. This allows us to redirect surfaces to 3d surfaces in vr.
     const bool mIsUsingVrComposer;
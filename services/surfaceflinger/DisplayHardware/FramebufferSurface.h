@@ -52,6 +52,10 @@ public:
     virtual void resizeBuffers(uint32_t width, uint32_t height);
 
     virtual const sp<Fence>& getClientTargetAcquireFence() const override;
+    virtual bool forwardBuffer(const sp<GraphicBuffer>&, const sp<Fence>&,
+                               ui::Dataspace) override {
+        return false;
+    }
 
 private:
     virtual ~FramebufferSurface() { }; // this class cannot be overloaded
@@ -470,6 +470,33 @@ void HWComposer::setVsyncEnabled(DisplayId displayId, hal::Vsync enabled) {
     ATRACE_INT(tag.c_str(), enabled == hal::Vsync::ENABLE ? 1 : 0);
 }
 
+status_t HWComposer::validateDisplays(const std::vector<DisplayId>& displayIds) {
+    ATRACE_CALL();
+
+    std::vector<hal::HWDisplayId> hwcDisplayIds;
+    hwcDisplayIds.reserve(displayIds.size());
+    for (const auto displayId : displayIds) {
+        RETURN_IF_INVALID_DISPLAY(displayId, BAD_INDEX);
+        const auto& hwcDisplay = mDisplayData[displayId].hwcDisplay;
+        if (hwcDisplay->isConnected()) {
+            hwcDisplayIds.push_back(hwcDisplay->getId());
+        }
+    }
+
+    // A single display gains nothing over validating it on its own.
+    if (hwcDisplayIds.size() < 2) {
+        return NO_ERROR;
+    }
+
+    auto error = static_cast<hal::Error>(mComposer->validateDisplays(hwcDisplayIds));
+    if (error != hal::Error::NONE) {
+        ALOGW("%s: batched validate of %zu displays failed: %s (%d)", __FUNCTION__,
+              hwcDisplayIds.size(), to_string(error).c_str(), static_cast<int32_t>(error));
+        return UNKNOWN_ERROR;
+    }
+    return NO_ERROR;
+}
+
 status_t HWComposer::setClientTarget(DisplayId displayId, uint32_t slot,
                                      const sp<Fence>& acquireFence, const sp<GraphicBuffer>& target,
                                      ui::Dataspace dataspace) {
@@ -111,6 +111,11 @@ public:
             DisplayId, bool frameUsesClientComposition,
             std::optional<DeviceRequestedChanges>* outChanges) = 0;
 
+    // Validates the layers already written for several displays in a single round trip to the
+    // HWC. getDeviceCompositionChanges() then returns the result for each of them without another
+    // one. The displays must all be going to use client composition this frame.
+    virtual status_t validateDisplays(const std::vector<DisplayId>& displayIds) = 0;
+
     virtual status_t setClientTarget(DisplayId displayId, uint32_t slot,
                                      const sp<Fence>& acquireFence, const sp<GraphicBuffer>& target,
                                      ui::Dataspace dataspace) = 0;
@@ -259,6 +264,8 @@ public:
             DisplayId, bool frameUsesClientComposition,
             std::optional<DeviceRequestedChanges>* outChanges) override;
 
+    status_t validateDisplays(const std::vector<DisplayId>& displayIds) override;
+
     status_t setClientTarget(DisplayId displayId, uint32_t slot, const sp<Fence>& acquireFence,
                              const sp<GraphicBuffer>& target, ui::Dataspace dataspace) override;
 
@@ -59,6 +59,14 @@ int32_t getUpdateTimeout() {
     return timeout;
 }
 
+// The workload is heavy once frames take this much of their target duration on average, and
+// stays heavy until they take less than kLightWorkloadRatio of it, so that the hint doesn't flip
+// every few frames.
+constexpr float kHeavyWorkloadRatio = 0.8f;
+constexpr float kLightWorkloadRatio = 0.5f;
+// The weight of the latest frame in mWorkloadRatio.
+constexpr float kWorkloadRatioWeight = 0.1f;
+
 } // namespace
 
 PowerAdvisor::PowerAdvisor()
@@ -83,7 +91,30 @@ void PowerAdvisor::setExpensiveRenderingExpected(DisplayId displayId, bool expec
         mExpensiveDisplays.erase(displayId);
     }
 
-    const bool expectsExpensiveRendering = !mExpensiveDisplays.empty();
+    updateExpensiveRendering();
+}
+
+void PowerAdvisor::reportFrameWorkDuration(nsecs_t actualDuration, nsecs_t targetDuration) {
+    // Like notifyDisplayUpdateImminent, don't introduce an early-boot dependency on Power HAL
+    if (!mBootFinished.load() || actualDuration <= 0 || targetDuration <= 0) {
+        return;
+    }
+
+    const float ratio = static_cast<float>(actualDuration) / static_cast<float>(targetDuration);
+    mWorkloadRatio += kWorkloadRatioWeight * (ratio - mWorkloadRatio);
+
+    const bool heavyWorkload = mHeavyWorkload ? mWorkloadRatio >= kLightWorkloadRatio
+                                              : mWorkloadRatio >= kHeavyWorkloadRatio;
+    if (heavyWorkload != mHeavyWorkload) {
+        ALOGV("Frame workload is %s (%.2f of the target duration)",
+              heavyWorkload ? "heavy" : "light", mWorkloadRatio);
+        mHeavyWorkload = heavyWorkload;
+        updateExpensiveRendering();
+    }
+}
+
+void PowerAdvisor::updateExpensiveRendering() {
+    const bool expectsExpensiveRendering = !mExpensiveDisplays.empty() || mHeavyWorkload;
     if (mNotifiedExpensiveRendering != expectsExpensiveRendering) {
         std::lock_guard lock(mPowerHalMutex);
         HalWrapper* const halWrapper = getPowerHal();
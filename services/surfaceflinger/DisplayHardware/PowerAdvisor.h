@@ -20,6 +20,7 @@
 #include <unordered_set>
 
 #include <utils/Mutex.h>
+#include <utils/Timers.h>
 
 #include "../Scheduler/OneShotTimer.h"
 #include "DisplayIdentification.h"
@@ -34,6 +35,9 @@ public:
     virtual void onBootFinished() = 0;
     virtual void setExpensiveRenderingExpected(DisplayId displayId, bool expected) = 0;
     virtual void notifyDisplayUpdateImminent() = 0;
+    // Reports how long the main thread took to compose a frame, and how long it had to make the
+    // vsync deadline.
+    virtual void reportFrameWorkDuration(nsecs_t actualDuration, nsecs_t targetDuration) = 0;
 };
 
 namespace impl {
@@ -56,8 +60,13 @@ public:
     void onBootFinished() override;
     void setExpensiveRenderingExpected(DisplayId displayId, bool expected) override;
     void notifyDisplayUpdateImminent() override;
+    void reportFrameWorkDuration(nsecs_t actualDuration, nsecs_t targetDuration) override;
 
 private:
+    // Sends EXPENSIVE_RENDERING to the HAL if any display expects it, or if the recent frames
+    // came close to missing their deadline.
+    void updateExpensiveRendering();
+
     HalWrapper* getPowerHal() REQUIRES(mPowerHalMutex);
     bool mReconnectPowerHal GUARDED_BY(mPowerHalMutex) = false;
     std::mutex mPowerHalMutex;
@@ -67,6 +76,11 @@ private:
     std::unordered_set<DisplayId> mExpensiveDisplays;
     bool mNotifiedExpensiveRendering = false;
 
+    // The smoothed ratio of the frame work durations to their targets, and whether it is high
+    // enough to ask for more performance.
+    float mWorkloadRatio = 0.0f;
+    bool mHeavyWorkload = false;
+
     const bool mUseUpdateImminentTimer;
     std::atomic_bool mSendUpdateImminent = true;
     scheduler::OneShotTimer mUpdateImminentTimer;
@@ -86,7 +86,9 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc,
         mMustRecompose(false),
         mForceHwcCopy(SurfaceFlinger::useHwcForRgbToYuv),
         mSecure(secure),
-        mSinkUsage(0) {
+        mSinkUsage(0),
+        mSinkConsumerUsage(0),
+        mForwardedSlots(0) {
     mSource[SOURCE_SINK] = sink;
     mSource[SOURCE_SCRATCH] = bqProducer;
 
@@ -105,6 +107,7 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc,
     int sinkUsage;
     sink->query(NATIVE_WINDOW_CONSUMER_USAGE_BITS, &sinkUsage);
     mSinkUsage |= (GRALLOC_USAGE_HW_COMPOSER | sinkUsage);
+    mSinkConsumerUsage = static_cast<uint32_t>(sinkUsage);
     setOutputUsage(mSinkUsage);
     if (sinkUsage & (GRALLOC_USAGE_SW_READ_MASK | GRALLOC_USAGE_SW_WRITE_MASK)) {
         int sinkFormat;
@@ -307,6 +310,50 @@ const sp<Fence>& VirtualDisplaySurface::getClientTargetAcquireFence() const {
     return mFbFence;
 }
 
+bool VirtualDisplaySurface::forwardBuffer(const sp<GraphicBuffer>& buffer,
+                                          const sp<Fence>& acquireFence, ui::Dataspace dataspace) {
+    // With HWC, the sink buffer is also the HWC output buffer, so it can't be
+    // swapped out behind the HWC's back.
+    if (mDisplayId) {
+        return false;
+    }
+
+    if (buffer->getWidth() != mSinkBufferWidth || buffer->getHeight() != mSinkBufferHeight ||
+        (buffer->getUsage() & mSinkConsumerUsage) != mSinkConsumerUsage) {
+        return false;
+    }
+    if ((mSinkConsumerUsage & (GRALLOC_USAGE_SW_READ_MASK | GRALLOC_USAGE_SW_WRITE_MASK)) &&
+        static_cast<uint32_t>(buffer->getPixelFormat()) != mDefaultOutputFormat) {
+        return false;
+    }
+
+    int sslot;
+    status_t result = mSource[SOURCE_SINK]->attachBuffer(&sslot, buffer);
+    if (result < 0) {
+        VDS_LOGV("forwardBuffer: attachBuffer failed: %d", result);
+        return false;
+    }
+
+    QueueBufferOutput qbo;
+    result = mSource[SOURCE_SINK]->queueBuffer(sslot,
+            QueueBufferInput(
+                systemTime(), false /* isAutoTimestamp */,
+                static_cast<android_dataspace>(dataspace),
+                Rect(mSinkBufferWidth, mSinkBufferHeight),
+                NATIVE_WINDOW_SCALING_MODE_FREEZE, 0 /* transform */,
+                acquireFence),
+            &qbo);
+    if (result != NO_ERROR) {
+        VDS_LOGV("forwardBuffer: queueBuffer failed: %d", result);
+        mSource[SOURCE_SINK]->detachBuffer(sslot);
+        return false;
+    }
+
+    VDS_LOGV("forwardBuffer: queued buffer %" PRIu64 " to sink sslot=%d", buffer->getId(), sslot);
+    mForwardedSlots |= (1ULL << sslot);
+    return true;
+}
+
 status_t VirtualDisplaySurface::requestBuffer(int pslot,
         sp<GraphicBuffer>* outBuf) {
     if (!mDisplayId) {
@@ -386,8 +433,19 @@ status_t VirtualDisplaySurface::dequeueBuffer(int* pslot, sp<Fence>* fence, uint
                                               uint64_t* outBufferAge,
                                               FrameEventHistoryDelta* outTimestamps) {
     if (!mDisplayId) {
-        return mSource[SOURCE_SINK]->dequeueBuffer(pslot, fence, w, h, format, usage, outBufferAge,
-                                                   outTimestamps);
+        status_t releaseAllBuffers = 0;
+        while (true) {
+            status_t result = mSource[SOURCE_SINK]->dequeueBuffer(pslot, fence, w, h, format,
+                                                                  usage, outBufferAge,
+                                                                  outTimestamps);
+            if (result < 0 || !(mForwardedSlots & (1ULL << *pslot))) {
+                return result < 0 ? result : result | releaseAllBuffers;
+            }
+            // Don't let the GPU driver draw into a layer's buffer.
+            releaseAllBuffers |= result & RELEASE_ALL_BUFFERS;
+            mForwardedSlots &= ~(1ULL << *pslot);
+            mSource[SOURCE_SINK]->detachBuffer(*pslot);
+        }
     }
 
     VDS_LOGW_IF(mDbgState != DBG_STATE_PREPARED,
@@ -571,6 +629,8 @@ status_t VirtualDisplaySurface::connect(const sp<IProducerListener>& listener,
 }
 
 status_t VirtualDisplaySurface::disconnect(int api, DisconnectMode mode) {
+    // The sink lets go of all its buffers.
+    mForwardedSlots = 0;
     return mSource[SOURCE_SINK]->disconnect(api, mode);
 }
 
@@ -93,6 +93,8 @@ public:
     virtual void dumpAsString(String8& result) const;
     virtual void resizeBuffers(const uint32_t w, const uint32_t h);
     virtual const sp<Fence>& getClientTargetAcquireFence() const override;
+    virtual bool forwardBuffer(const sp<GraphicBuffer>& buffer, const sp<Fence>& acquireFence,
+                               ui::Dataspace dataspace) override;
 
 private:
     enum Source {SOURCE_SINK = 0, SOURCE_SCRATCH = 1};
@@ -260,6 +262,15 @@ private:
     bool mForceHwcCopy;
     bool mSecure;
     int mSinkUsage;
+
+    // The usage bits the sink asked for, which forwarded buffers must have.
+    uint64_t mSinkConsumerUsage;
+
+    // Sink slots holding a buffer forwarded by forwardBuffer() rather than
+    // one of the sink's own, one bit per slot. Such a buffer still belongs to
+    // the layer it came from, so it is detached when the sink returns it
+    // instead of being handed to the GPU driver.
+    uint64_t mForwardedSlots;
 };
 
 // ---------------------------------------------------------------------------
@@ -28,12 +28,21 @@
 #include <perfetto/trace/clock_snapshot.pbzero.h>
 
 #include <algorithm>
+#include <cinttypes>
 #include <mutex>
 
 PERFETTO_DEFINE_DATA_SOURCE_STATIC_MEMBERS(android::FrameTracer::FrameTracerDataSource);
 
 namespace android {
 
+namespace {
+
+nsecs_t spanDuration(nsecs_t startTime, nsecs_t endTime) {
+    return startTime > 0 && startTime < endTime ? endTime - startTime : 0;
+}
+
+} // namespace
+
 using Clock = perfetto::protos::pbzero::ClockSnapshot::Clock;
 void FrameTracer::initialize() {
     std::call_once(mInitializationFlag, [this]() {
@@ -51,6 +60,14 @@ void FrameTracer::registerDataSource() {
 }
 
 void FrameTracer::traceNewLayer(int32_t layerId, const std::string& layerName) {
+    if (mSampleInterval > 0) {
+        std::lock_guard<std::mutex> lock(mStatsMutex);
+        auto& stats = mLayerStats[layerId];
+        if (stats.layerName.empty()) {
+            stats.layerName = layerName;
+        }
+    }
+
     FrameTracerDataSource::Trace([this, layerId, &layerName](FrameTracerDataSource::TraceContext) {
         if (mTraceTracker.find(layerId) == mTraceTracker.end()) {
             std::lock_guard<std::mutex> lock(mTraceMutex);
@@ -62,6 +79,13 @@ void FrameTracer::traceNewLayer(int32_t layerId, const std::string& layerName) {
 void FrameTracer::traceTimestamp(int32_t layerId, uint64_t bufferID, uint64_t frameNumber,
                                  nsecs_t timestamp, FrameEvent::BufferEventType type,
                                  nsecs_t duration) {
+    if (mSampleInterval > 0) {
+        aggregateTimestamp(layerId, type, duration);
+        if (!isSampled(frameNumber)) {
+            return;
+        }
+    }
+
     FrameTracerDataSource::Trace([this, layerId, bufferID, frameNumber, timestamp, type,
                                   duration](FrameTracerDataSource::TraceContext ctx) {
         std::lock_guard<std::mutex> lock(mTraceMutex);
@@ -80,6 +104,13 @@ void FrameTracer::traceTimestamp(int32_t layerId, uint64_t bufferID, uint64_t fr
 void FrameTracer::traceFence(int32_t layerId, uint64_t bufferID, uint64_t frameNumber,
                              const std::shared_ptr<FenceTime>& fence,
                              FrameEvent::BufferEventType type, nsecs_t startTime) {
+    if (mSampleInterval > 0) {
+        aggregateFence(layerId, fence, type, startTime);
+        if (!isSampled(frameNumber)) {
+            return;
+        }
+    }
+
     FrameTracerDataSource::Trace([this, layerId, bufferID, frameNumber, &fence, type,
                                   startTime](FrameTracerDataSource::TraceContext ctx) {
         const nsecs_t signalTime = fence->getSignalTime();
@@ -170,8 +201,89 @@ void FrameTracer::traceSpanLocked(FrameTracerDataSource::TraceContext& ctx, int3
 }
 
 void FrameTracer::onDestroy(int32_t layerId) {
-    std::lock_guard<std::mutex> traceLock(mTraceMutex);
-    mTraceTracker.erase(layerId);
+    {
+        std::lock_guard<std::mutex> traceLock(mTraceMutex);
+        mTraceTracker.erase(layerId);
+    }
+    std::lock_guard<std::mutex> statsLock(mStatsMutex);
+    mLayerStats.erase(layerId);
+}
+
+void FrameTracer::setSampleInterval(uint32_t sampleInterval) {
+    mSampleInterval = sampleInterval;
+    if (sampleInterval == 0) {
+        std::lock_guard<std::mutex> lock(mStatsMutex);
+        mLayerStats.clear();
+    }
+}
+
+bool FrameTracer::isSampled(uint64_t frameNumber) const {
+    const uint32_t sampleInterval = mSampleInterval;
+    if (sampleInterval <= 1) {
+        return true;
+    }
+    return frameNumber != UNSPECIFIED_FRAME_NUMBER && frameNumber % sampleInterval == 0;
+}
+
+void FrameTracer::aggregateTimestamp(int32_t layerId, FrameEvent::BufferEventType type,
+                                     nsecs_t duration) {
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    const auto it = mLayerStats.find(layerId);
+    if (it == mLayerStats.end()) {
+        return;
+    }
+
+    aggregatePendingFencesLocked(it->second);
+    aggregateEventLocked(it->second, type, duration);
+}
+
+void FrameTracer::aggregateFence(int32_t layerId, const std::shared_ptr<FenceTime>& fence,
+                                 FrameEvent::BufferEventType type, nsecs_t startTime) {
+    std::lock_guard<std::mutex> lock(mStatsMutex);
+    const auto it = mLayerStats.find(layerId);
+    if (it == mLayerStats.end()) {
+        return;
+    }
+
+    LayerStats& stats = it->second;
+    aggregatePendingFencesLocked(stats);
+
+    const nsecs_t signalTime = fence->getSignalTime();
+    if (signalTime == Fence::SIGNAL_TIME_PENDING) {
+        // Past the limit, fences are left out of the statistics rather than held onto.
+        if (stats.pendingFences.size() < kMaxPendingStatsFences) {
+            stats.pendingFences.push_back({.frameNumber = UNSPECIFIED_FRAME_NUMBER,
+                                           .type = type,
+                                           .fence = fence,
+                                           .startTime = startTime});
+        }
+    } else if (signalTime != Fence::SIGNAL_TIME_INVALID) {
+        aggregateEventLocked(stats, type, spanDuration(startTime, signalTime));
+    }
+}
+
+void FrameTracer::aggregatePendingFencesLocked(LayerStats& stats) {
+    auto& pendingFences = stats.pendingFences;
+    for (auto it = pendingFences.begin(); it != pendingFences.end();) {
+        const nsecs_t signalTime = it->fence->getSignalTime();
+        if (signalTime == Fence::SIGNAL_TIME_PENDING) {
+            ++it;
+            continue;
+        }
+
+        if (signalTime != Fence::SIGNAL_TIME_INVALID) {
+            aggregateEventLocked(stats, it->type, spanDuration(it->startTime, signalTime));
+        }
+        it = pendingFences.erase(it);
+    }
+}
+
+void FrameTracer::aggregateEventLocked(LayerStats& stats, FrameEvent::BufferEventType type,
+                                       nsecs_t duration) {
+    EventStats& event = stats.events[type];
+    event.count++;
+    event.totalDuration += duration;
+    event.maxDuration = std::max(event.maxDuration, duration);
 }
 
 std::string FrameTracer::miniDump() {
@@ -179,6 +291,27 @@ std::string FrameTracer::miniDump() {
     std::lock_guard<std::mutex> lock(mTraceMutex);
     android::base::StringAppendF(&result, "Number of layers currently being traced is %zu\n",
                                  mTraceTracker.size());
+
+    const uint32_t sampleInterval = mSampleInterval;
+    if (sampleInterval == 0) {
+        return result;
+    }
+
+    std::lock_guard<std::mutex> statsLock(mStatsMutex);
+    android::base::StringAppendF(&result, "Tracing one frame in %u, statistics of %zu layers:\n",
+                                 sampleInterval, mLayerStats.size());
+    for (const auto& [layerId, stats] : mLayerStats) {
+        android::base::StringAppendF(&result, "  %s (%d)\n", stats.layerName.c_str(), layerId);
+        for (const auto& [type, event] : stats.events) {
+            android::base::StringAppendF(&result,
+                                         "    type=%d count=%" PRIu64 " avg=%" PRId64
+                                         "us max=%" PRId64 "us\n",
+                                         static_cast<int>(type), event.count,
+                                         ns2us(event.totalDuration) /
+                                                 static_cast<int64_t>(event.count),
+                                         ns2us(event.maxDuration));
+        }
+    }
     return result;
 }
 
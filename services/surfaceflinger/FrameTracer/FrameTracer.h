@@ -20,6 +20,8 @@
 #include <perfetto/tracing.h>
 #include <ui/FenceTime.h>
 
+#include <atomic>
+#include <map>
 #include <mutex>
 #include <unordered_map>
 
@@ -63,6 +65,12 @@ public:
     // Takes care of cleanup when a layer is destroyed.
     void onDestroy(int32_t layerId);
 
+    // Switches to aggregated mode when sampleInterval is non zero: every event is folded into
+    // per layer counts and durations whether or not a trace is running, and only one frame in
+    // every sampleInterval is traced in full. Events not tied to a frame number are only traced
+    // when every frame is. Zero, the default, traces every event and keeps no statistics.
+    void setSampleInterval(uint32_t sampleInterval);
+
     std::string miniDump();
 
     static constexpr char kFrameTracerDataSource[] = "android.surfaceflinger.frame";
@@ -72,6 +80,9 @@ public:
     // Public for testing.
     static constexpr nsecs_t kFenceSignallingDeadline = 60'000'000'000; // 60 seconds
 
+    // The most fences per layer held onto for the statistics while waiting for them to signal.
+    static constexpr size_t kMaxPendingStatsFences = 8;
+
 private:
     struct PendingFence {
         uint64_t frameNumber;
@@ -86,6 +97,28 @@ private:
         std::unordered_map<BufferID, std::vector<PendingFence>> pendingFences;
     };
 
+    struct EventStats {
+        uint64_t count = 0;
+        nsecs_t totalDuration = 0;
+        nsecs_t maxDuration = 0;
+    };
+
+    struct LayerStats {
+        std::string layerName;
+        std::map<FrameEvent::BufferEventType, EventStats> events;
+        std::vector<PendingFence> pendingFences;
+    };
+
+    bool isSampled(uint64_t frameNumber) const;
+    // Folds an event into the statistics of a layer, along with any of its fences that have
+    // signalled since the last event.
+    void aggregateTimestamp(int32_t layerId, FrameEvent::BufferEventType type, nsecs_t duration);
+    void aggregateFence(int32_t layerId, const std::shared_ptr<FenceTime>& fence,
+                        FrameEvent::BufferEventType type, nsecs_t startTime);
+    void aggregatePendingFencesLocked(LayerStats& stats);
+    static void aggregateEventLocked(LayerStats& stats, FrameEvent::BufferEventType type,
+                                     nsecs_t duration);
+
     // Checks if any pending fences for a layer and buffer have signalled and, if they have, creates
     // trace points for them.
     void tracePendingFencesLocked(FrameTracerDataSource::TraceContext& ctx, int32_t layerId,
@@ -103,6 +136,10 @@ private:
     std::mutex mTraceMutex;
     std::unordered_map<int32_t, TraceRecord> mTraceTracker;
     std::once_flag mInitializationFlag;
+
+    std::atomic<uint32_t> mSampleInterval = 0;
+    std::mutex mStatsMutex;
+    std::unordered_map<int32_t, LayerStats> mLayerStats;
 };
 
 } // namespace android
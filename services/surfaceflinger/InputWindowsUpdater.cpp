@@ -0,0 +1,112 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "InputWindowsUpdater"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "InputWindowsUpdater.h"
+
+#include <pthread.h>
+
+#include <utils/Trace.h>
+
+namespace android {
+
+InputWindowsUpdater::InputWindowsUpdater(sp<IInputFlinger> inputFlinger)
+      : mInputFlinger(std::move(inputFlinger)) {
+    mThread = std::thread(&InputWindowsUpdater::threadMain, this);
+    pthread_setname_np(mThread.native_handle(), "InputWindows");
+}
+
+InputWindowsUpdater::~InputWindowsUpdater() {
+    {
+        std::lock_guard lock(mMutex);
+        mStopThread = true;
+    }
+    mCondition.notify_one();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void InputWindowsUpdater::update(std::vector<InputWindowInfo>&& windows,
+                                 const sp<ISetInputWindowsListener>& listener) {
+    {
+        std::lock_guard lock(mMutex);
+        // Keep the listener of an update this one replaces, as whoever asked
+        // for it is still waiting.
+        sp<ISetInputWindowsListener> pendingListener = listener;
+        if (mPendingUpdate && !pendingListener) {
+            pendingListener = mPendingUpdate->listener;
+        }
+        mPendingUpdate = PendingUpdate{std::move(windows), std::move(pendingListener)};
+    }
+    mCondition.notify_one();
+}
+
+InputWindowsUpdater::Diff InputWindowsUpdater::diff(
+        const std::unordered_map<int32_t, InputWindowInfo>& previous,
+        const std::vector<InputWindowInfo>& windows) {
+    Diff diff;
+    diff.windowIds.reserve(windows.size());
+    for (const auto& window : windows) {
+        diff.windowIds.push_back(window.id);
+        auto it = previous.find(window.id);
+        if (it == previous.end() || it->second != window) {
+            diff.changedWindows.push_back(window);
+        }
+    }
+    return diff;
+}
+
+void InputWindowsUpdater::threadMain() {
+    while (true) {
+        PendingUpdate update;
+        {
+            std::unique_lock lock(mMutex);
+            mCondition.wait(lock, [this]() REQUIRES(mMutex) {
+                return mStopThread || mPendingUpdate.has_value();
+            });
+            if (mStopThread) {
+                return;
+            }
+            update = std::move(*mPendingUpdate);
+            mPendingUpdate.reset();
+        }
+
+        ATRACE_NAME("updateInputWindows");
+        if (!mSentAllWindows) {
+            mInputFlinger->setInputWindows(update.windows, update.listener);
+            mSentAllWindows = true;
+        } else {
+            Diff diff = InputWindowsUpdater::diff(mSentWindows, update.windows);
+            ALOGV("Sending %zu of %zu input windows", diff.changedWindows.size(),
+                  diff.windowIds.size());
+            mInputFlinger->updateInputWindows(diff.changedWindows, diff.windowIds,
+                                              update.listener);
+        }
+
+        mSentWindows.clear();
+        for (auto& window : update.windows) {
+            const int32_t id = window.id;
+            mSentWindows.emplace(id, std::move(window));
+        }
+    }
+}
+
+} // namespace android
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <android-base/thread_annotations.h>
+#include <input/IInputFlinger.h>
+#include <input/ISetInputWindowsListener.h>
+#include <input/InputWindow.h>
+#include <utils/StrongPointer.h>
+
+namespace android {
+
+// Sends the input windows to InputFlinger from its own thread. The first time
+// every window is sent, and after that only the windows that changed along with
+// the ids of all of them, which is usually a few bytes instead of several
+// kilobytes per update.
+//
+// Updates that pile up while one is being sent are merged, as only the latest
+// set of windows matters.
+class InputWindowsUpdater {
+public:
+    struct Diff {
+        // The windows that are new or changed, in the order they were given.
+        std::vector<InputWindowInfo> changedWindows;
+        // The ids of all the windows, in the order they were given.
+        std::vector<int32_t> windowIds;
+    };
+
+    explicit InputWindowsUpdater(sp<IInputFlinger> inputFlinger);
+    ~InputWindowsUpdater();
+
+    // Queues the windows to send, in the order IInputFlinger::setInputWindows()
+    // takes them. The listener, if given, is called once they have been applied.
+    void update(std::vector<InputWindowInfo>&& windows,
+                const sp<ISetInputWindowsListener>& listener);
+
+    static Diff diff(const std::unordered_map<int32_t, InputWindowInfo>& previous,
+                     const std::vector<InputWindowInfo>& windows);
+
+private:
+    struct PendingUpdate {
+        std::vector<InputWindowInfo> windows;
+        sp<ISetInputWindowsListener> listener;
+    };
+
+    void threadMain();
+
+    const sp<IInputFlinger> mInputFlinger;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::optional<PendingUpdate> mPendingUpdate GUARDED_BY(mMutex);
+    bool mStopThread GUARDED_BY(mMutex) = false;
+
+    // Only used by mThread.
+    std::unordered_map<int32_t, InputWindowInfo> mSentWindows;
+    bool mSentAllWindows = false;
+
+    std::thread mThread;
+};
+
+} // namespace android
@@ -31,6 +31,7 @@
 #include <compositionengine/Display.h>
 #include <compositionengine/LayerFECompositionState.h>
 #include <compositionengine/OutputLayer.h>
+#include <compositionengine/impl/ObjectPool.h>
 #include <compositionengine/impl/OutputLayerCompositionState.h>
 #include <cutils/compiler.h>
 #include <cutils/native_handle.h>
@@ -38,6 +39,7 @@
 #include <gui/BufferItem.h>
 #include <gui/LayerDebugInfo.h>
 #include <gui/Surface.h>
+#include <malloc.h>
 #include <math.h>
 #include <renderengine/RenderEngine.h>
 #include <stdint.h>
@@ -62,7 +64,6 @@
 #include "DisplayHardware/HWComposer.h"
 #include "EffectLayer.h"
 #include "FrameTracer/FrameTracer.h"
-#include "LayerProtoHelper.h"
 #include "LayerRejecter.h"
 #include "MonitoredProducer.h"
 #include "SurfaceFlinger.h"
@@ -133,6 +134,8 @@ Layer::Layer(const LayerCreationArgs& args)
     args.flinger->getCompositorTiming(&compositorTiming);
     mFrameEventHistory.initializeCompositorTiming(compositorTiming);
     mFrameTracker.setDisplayRefreshPeriod(compositorTiming.interval);
+    mAcquireTimeline.setWatcher(args.flinger->mFenceWatcher);
+    mReleaseTimeline.setWatcher(args.flinger->mFenceWatcher);
 
     mCallingPid = args.callingPid;
     mCallingUid = args.callingUid;
@@ -152,6 +155,14 @@ Layer::~Layer() {
     mFlinger->onLayerDestroyed(this);
 }
 
+void* Layer::operator new(size_t size) {
+    return compositionengine::impl::ObjectPool::allocate(size);
+}
+
+void Layer::operator delete(void* block, size_t size) {
+    compositionengine::impl::ObjectPool::release(block, size);
+}
+
 LayerCreationArgs::LayerCreationArgs(SurfaceFlinger* flinger, sp<Client> client, std::string name,
                                      uint32_t w, uint32_t h, uint32_t flags, LayerMetadata metadata)
       : flinger(flinger),
@@ -818,7 +829,7 @@ void Layer::pushPendingState() {
 
 void Layer::popPendingState(State* stateToCommit) {
     ATRACE_CALL();
-    *stateToCommit = mPendingStates[0];
+    *stateToCommit = std::move(mPendingStates[0]);
 
     mPendingStates.pop_front();
     ATRACE_INT(mTransactionName.c_str(), mPendingStates.size());
@@ -976,7 +987,9 @@ uint32_t Layer::doTransaction(uint32_t flags) {
     }
 
     pushPendingState();
-    State c = getCurrentState();
+    // Only committed if a pending state is applied, which overwrites all of it,
+    // so there is no need to start from a copy of the current state.
+    State c;
     if (!applyPendingStates(&c)) {
         return flags;
     }
@@ -1006,7 +1019,7 @@ uint32_t Layer::doTransaction(uint32_t flags) {
     }
 
     // Commit the transaction
-    commitTransaction(c);
+    commitTransaction(std::move(c));
     mPendingStatesSnapshot = mPendingStates;
     mCurrentState.callbackHandles = {};
 
@@ -1017,6 +1030,10 @@ void Layer::commitTransaction(const State& stateToCommit) {
     mDrawingState = stateToCommit;
 }
 
+void Layer::commitTransaction(State&& stateToCommit) {
+    mDrawingState = std::move(stateToCommit);
+}
+
 uint32_t Layer::getTransactionFlags(uint32_t flags) {
     return mTransactionFlags.fetch_and(~flags) & flags;
 }
@@ -1680,6 +1697,16 @@ void Layer::dumpCallingUidPid(std::string& result) const {
                   mCallingPid, mCallingUid);
 }
 
+size_t Layer::getHeapUsage() const {
+    // Both are heap allocated, possibly through the ObjectPool, which takes
+    // its blocks from the heap too.
+    size_t usage = malloc_usable_size(dynamic_cast<const void*>(this));
+    if (const auto* compositionState = getCompositionState()) {
+        usage += malloc_usable_size(compositionState);
+    }
+    return usage;
+}
+
 void Layer::onDisconnect() {
     Mutex::Autolock lock(mFrameEventHistoryMutex);
     mFrameEventHistory.onDisconnect();
@@ -1692,7 +1719,8 @@ void Layer::addAndGetFrameTimestamps(const NewFrameEventsEntry* newTimestamps,
                                      FrameEventHistoryDelta* outDelta) {
     if (newTimestamps) {
         mFlinger->mTimeStats->setPostTime(getSequence(), newTimestamps->frameNumber,
-                                          getName().c_str(), newTimestamps->postedTime);
+                                          getName().c_str(), getOwnerUid(),
+                                          newTimestamps->postedTime);
         mFlinger->mTimeStats->setAcquireFence(getSequence(), newTimestamps->frameNumber,
                                               newTimestamps->acquireFence);
     }
@@ -2204,163 +2232,119 @@ void Layer::setInputInfo(const InputWindowInfo& info) {
     setTransactionFlags(eTransactionNeeded);
 }
 
-LayerProto* Layer::writeToProto(LayersProto& layersProto, uint32_t traceFlags,
-                                const DisplayDevice* display) const {
-    LayerProto* layerProto = layersProto.add_layers();
-    writeToProtoDrawingState(layerProto, traceFlags, display);
-    writeToProtoCommonState(layerProto, LayerVector::StateSet::Drawing, traceFlags);
+void Layer::snapshotForProto(std::vector<LayerProtoSnapshot>& snapshots, uint32_t traceFlags,
+                             const DisplayDevice* display) const {
+    LayerProtoSnapshot& snapshot = snapshots.emplace_back();
+    snapshot.traceFlags = traceFlags;
+    snapshotDrawingStateForProto(snapshot, display);
 
     if (traceFlags & SurfaceTracing::TRACE_COMPOSITION) {
         // Only populate for the primary display.
         if (display) {
             const Hwc2::IComposerClient::Composition compositionType = getCompositionType(*display);
-            layerProto->set_hwc_composition_type(static_cast<HwcCompositionType>(compositionType));
+            snapshot.hwcCompositionType = static_cast<int32_t>(compositionType);
         }
     }
 
+    // Adding the children may move snapshot, so it must not be used past here.
     for (const sp<Layer>& layer : mDrawingChildren) {
-        layer->writeToProto(layersProto, traceFlags, display);
+        layer->snapshotForProto(snapshots, traceFlags, display);
     }
-
-    return layerProto;
 }
 
-void Layer::writeToProtoDrawingState(LayerProto* layerInfo, uint32_t traceFlags,
-                                     const DisplayDevice* display) const {
-    ui::Transform transform = getTransform();
+void Layer::snapshotDrawingStateForProto(LayerProtoSnapshot& snapshot,
+                                         const DisplayDevice* display) const {
+    const uint32_t traceFlags = snapshot.traceFlags;
+    const State& state = mDrawingState;
+
+    snapshot.id = sequence;
 
     if (traceFlags & SurfaceTracing::TRACE_CRITICAL) {
         for (const auto& pendingState : mPendingStatesSnapshot) {
             auto barrierLayer = pendingState.barrierLayer_legacy.promote();
             if (barrierLayer != nullptr) {
-                BarrierLayerProto* barrierLayerProto = layerInfo->add_barrier_layer();
-                barrierLayerProto->set_id(barrierLayer->sequence);
-                barrierLayerProto->set_frame_number(pendingState.frameNumber_legacy);
+                snapshot.barrierLayers.emplace_back(barrierLayer->sequence,
+                                                    pendingState.frameNumber_legacy);
             }
         }
 
-        auto buffer = getBuffer();
-        if (buffer != nullptr) {
-            LayerProtoHelper::writeToProto(buffer,
-                                           [&]() { return layerInfo->mutable_active_buffer(); });
-            LayerProtoHelper::writeToProto(ui::Transform(getBufferTransform()),
-                                           layerInfo->mutable_buffer_transform());
+        snapshot.buffer = getBuffer();
+        if (snapshot.buffer != nullptr) {
+            snapshot.bufferTransform = getBufferTransform();
         }
-        layerInfo->set_invalidate(contentDirty);
-        layerInfo->set_is_protected(isProtected());
-        layerInfo->set_dataspace(dataspaceDetails(static_cast<android_dataspace>(getDataSpace())));
-        layerInfo->set_queued_frames(getQueuedFrameCount());
-        layerInfo->set_refresh_pending(isBufferLatched());
-        layerInfo->set_curr_frame(mCurrentFrameNumber);
-        layerInfo->set_effective_scaling_mode(getEffectiveScalingMode());
-
-        layerInfo->set_corner_radius(getRoundedCornerState().radius);
-        LayerProtoHelper::writeToProto(transform, layerInfo->mutable_transform());
-        LayerProtoHelper::writePositionToProto(transform.tx(), transform.ty(),
-                                               [&]() { return layerInfo->mutable_position(); });
-        LayerProtoHelper::writeToProto(mBounds, [&]() { return layerInfo->mutable_bounds(); });
+        snapshot.invalidate = contentDirty;
+        snapshot.isProtected = isProtected();
+        snapshot.dataspace = getDataSpace();
+        snapshot.queuedFrames = getQueuedFrameCount();
+        snapshot.refreshPending = isBufferLatched();
+        snapshot.currFrame = mCurrentFrameNumber;
+        snapshot.effectiveScalingMode = getEffectiveScalingMode();
+
+        snapshot.cornerRadius = getRoundedCornerState().radius;
+        snapshot.transform = getTransform();
+        snapshot.bounds = mBounds;
         if (traceFlags & SurfaceTracing::TRACE_COMPOSITION) {
-            LayerProtoHelper::writeToProto(getVisibleRegion(display),
-                                           [&]() { return layerInfo->mutable_visible_region(); });
+            snapshot.visibleRegion = getVisibleRegion(display);
         }
-        LayerProtoHelper::writeToProto(surfaceDamageRegion,
-                                       [&]() { return layerInfo->mutable_damage_region(); });
+        snapshot.damageRegion = surfaceDamageRegion;
 
         if (hasColorTransform()) {
-            LayerProtoHelper::writeToProto(getColorTransform(),
-                                           layerInfo->mutable_color_transform());
+            snapshot.colorTransform = getColorTransform();
         }
-    }
-
-    LayerProtoHelper::writeToProto(mSourceBounds,
-                                   [&]() { return layerInfo->mutable_source_bounds(); });
-    LayerProtoHelper::writeToProto(mScreenBounds,
-                                   [&]() { return layerInfo->mutable_screen_bounds(); });
-    LayerProtoHelper::writeToProto(getRoundedCornerState().cropRect,
-                                   [&]() { return layerInfo->mutable_corner_radius_crop(); });
-    layerInfo->set_shadow_radius(mEffectiveShadowRadius);
-}
-
-void Layer::writeToProtoCommonState(LayerProto* layerInfo, LayerVector::StateSet stateSet,
-                                    uint32_t traceFlags) const {
-    const bool useDrawing = stateSet == LayerVector::StateSet::Drawing;
-    const LayerVector& children = useDrawing ? mDrawingChildren : mCurrentChildren;
-    const State& state = useDrawing ? mDrawingState : mCurrentState;
 
-    ui::Transform requestedTransform = state.active_legacy.transform;
+        snapshot.name = getName();
+        snapshot.type = getType();
 
-    if (traceFlags & SurfaceTracing::TRACE_CRITICAL) {
-        layerInfo->set_id(sequence);
-        layerInfo->set_name(getName().c_str());
-        layerInfo->set_type(getType());
-
-        for (const auto& child : children) {
-            layerInfo->add_children(child->sequence);
+        snapshot.children.reserve(mDrawingChildren.size());
+        for (const auto& child : mDrawingChildren) {
+            snapshot.children.push_back(child->sequence);
         }
 
         for (const wp<Layer>& weakRelative : state.zOrderRelatives) {
             sp<Layer> strongRelative = weakRelative.promote();
             if (strongRelative != nullptr) {
-                layerInfo->add_relatives(strongRelative->sequence);
+                snapshot.relatives.push_back(strongRelative->sequence);
             }
         }
 
-        LayerProtoHelper::writeToProto(state.activeTransparentRegion_legacy,
-                                       [&]() { return layerInfo->mutable_transparent_region(); });
-
-        layerInfo->set_layer_stack(getLayerStack());
-        layerInfo->set_z(state.z);
-
-        LayerProtoHelper::writePositionToProto(requestedTransform.tx(), requestedTransform.ty(),
-                                               [&]() {
-                                                   return layerInfo->mutable_requested_position();
-                                               });
-
-        LayerProtoHelper::writeSizeToProto(state.active_legacy.w, state.active_legacy.h,
-                                           [&]() { return layerInfo->mutable_size(); });
-
-        LayerProtoHelper::writeToProto(state.crop_legacy,
-                                       [&]() { return layerInfo->mutable_crop(); });
-
-        layerInfo->set_is_opaque(isOpaque(state));
-
-
-        layerInfo->set_pixel_format(decodePixelFormat(getPixelFormat()));
-        LayerProtoHelper::writeToProto(getColor(), [&]() { return layerInfo->mutable_color(); });
-        LayerProtoHelper::writeToProto(state.color,
-                                       [&]() { return layerInfo->mutable_requested_color(); });
-        layerInfo->set_flags(state.flags);
-
-        LayerProtoHelper::writeToProto(requestedTransform,
-                                       layerInfo->mutable_requested_transform());
-
-        auto parent = useDrawing ? mDrawingParent.promote() : mCurrentParent.promote();
-        if (parent != nullptr) {
-            layerInfo->set_parent(parent->sequence);
-        } else {
-            layerInfo->set_parent(-1);
+        snapshot.transparentRegion = state.activeTransparentRegion_legacy;
+        snapshot.layerStack = getLayerStack();
+        snapshot.z = state.z;
+        snapshot.requestedTransform = state.active_legacy.transform;
+        snapshot.width = state.active_legacy.w;
+        snapshot.height = state.active_legacy.h;
+        snapshot.crop = state.crop_legacy;
+        snapshot.isOpaque = isOpaque(state);
+        snapshot.pixelFormat = getPixelFormat();
+        snapshot.color = getColor();
+        snapshot.requestedColor = state.color;
+        snapshot.flags = state.flags;
+
+        if (auto parent = mDrawingParent.promote()) {
+            snapshot.parent = parent->sequence;
         }
-
-        auto zOrderRelativeOf = state.zOrderRelativeOf.promote();
-        if (zOrderRelativeOf != nullptr) {
-            layerInfo->set_z_order_relative_of(zOrderRelativeOf->sequence);
-        } else {
-            layerInfo->set_z_order_relative_of(-1);
+        if (auto zOrderRelativeOf = state.zOrderRelativeOf.promote()) {
+            snapshot.zOrderRelativeOf = zOrderRelativeOf->sequence;
         }
-
-        layerInfo->set_is_relative_of(state.isRelativeOf);
+        snapshot.isRelativeOf = state.isRelativeOf;
     }
 
+    snapshot.sourceBounds = mSourceBounds;
+    snapshot.screenBounds = mScreenBounds;
+    snapshot.cornerRadiusCrop = getRoundedCornerState().cropRect;
+    snapshot.shadowRadius = mEffectiveShadowRadius;
+
     if (traceFlags & SurfaceTracing::TRACE_INPUT) {
-        LayerProtoHelper::writeToProto(state.inputInfo, state.touchableRegionCrop,
-                                       [&]() { return layerInfo->mutable_input_window_info(); });
+        snapshot.inputInfo = state.inputInfo;
+        if (auto cropLayer = state.touchableRegionCrop.promote()) {
+            snapshot.touchableRegionCropId = cropLayer->sequence;
+            snapshot.touchableRegionCropBounds =
+                    cropLayer->getScreenBounds(false /* reduceTransparentRegion */);
+        }
     }
 
     if (traceFlags & SurfaceTracing::TRACE_EXTRA) {
-        auto protoMap = layerInfo->mutable_metadata();
-        for (const auto& entry : state.metadata.mMap) {
-            (*protoMap)[entry.first] = std::string(entry.second.cbegin(), entry.second.cend());
-        }
+        snapshot.metadata = state.metadata;
     }
 }
 
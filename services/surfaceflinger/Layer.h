@@ -46,6 +46,7 @@
 #include "DisplayHardware/ComposerHal.h"
 #include "DisplayHardware/HWComposer.h"
 #include "FrameTracker.h"
+#include "LayerProtoSnapshot.h"
 #include "LayerVector.h"
 #include "MonitoredProducer.h"
 #include "RenderArea.h"
@@ -285,6 +286,11 @@ public:
     explicit Layer(const LayerCreationArgs& args);
     virtual ~Layer();
 
+    // Layers come and go with every surface, so they come from the layer
+    // ObjectPool.
+    static void* operator new(size_t size);
+    static void operator delete(void* block, size_t size);
+
     void onFirstRef() override;
 
     int getWindowType() const { return mWindowType; }
@@ -529,19 +535,11 @@ public:
 
     bool isRemovedFromCurrentState() const;
 
-    LayerProto* writeToProto(LayersProto& layersProto, uint32_t traceFlags,
-                             const DisplayDevice*) const;
-
-    // Write states that are modified by the main thread. This includes drawing
-    // state as well as buffer data. This should be called in the main or tracing
-    // thread.
-    void writeToProtoDrawingState(LayerProto* layerInfo, uint32_t traceFlags,
-                                  const DisplayDevice*) const;
-    // Write drawing or current state. If writing current state, the caller should hold the
-    // external mStateLock. If writing drawing state, this function should be called on the
-    // main or tracing thread.
-    void writeToProtoCommonState(LayerProto* layerInfo, LayerVector::StateSet stateSet,
-                                 uint32_t traceFlags = SurfaceTracing::TRACE_ALL) const;
+    // Captures the drawing state of this layer and of its drawing children into
+    // snapshots, in z order, for LayerProtoHelper to write to LayersProto. This
+    // should be called in the main or tracing thread.
+    void snapshotForProto(std::vector<LayerProtoSnapshot>& snapshots, uint32_t traceFlags,
+                          const DisplayDevice*) const;
 
     virtual Geometry getActiveGeometry(const Layer::State& s) const { return s.active_legacy; }
     virtual uint32_t getActiveWidth(const Layer::State& s) const { return s.active_legacy.w; }
@@ -867,6 +865,8 @@ protected:
     friend class SetFrameRateTest;
 
     virtual void commitTransaction(const State& stateToCommit);
+    // Moves the state in rather than copying it, for states that are done with.
+    void commitTransaction(State&& stateToCommit);
 
     uint32_t getEffectiveUsage(uint32_t usage) const;
 
@@ -982,6 +982,13 @@ public:
     // this to be called once.
     sp<IBinder> getHandle();
     const std::string& getName() const { return mName; }
+    // The uid of the client that created this layer.
+    uid_t getOwnerUid() const { return mCallingUid; }
+    // The pid of the client that created this layer.
+    pid_t getOwnerPid() const { return mCallingPid; }
+    // The heap memory held by the layer object and its composition state,
+    // not counting buffers.
+    size_t getHeapUsage() const;
     virtual void notifyAvailableFrames(nsecs_t /*expectedPresentTime*/) {}
     virtual PixelFormat getPixelFormat() const { return PIXEL_FORMAT_NONE; }
     bool getPremultipledAlpha() const;
@@ -1080,6 +1087,7 @@ private:
 
     Hwc2::IComposerClient::Composition getCompositionType(const DisplayDevice&) const;
     Region getVisibleRegion(const DisplayDevice*) const;
+    void snapshotDrawingStateForProto(LayerProtoSnapshot& snapshot, const DisplayDevice*) const;
 
     /**
      * Returns an unsorted vector of all layers that are part of this tree.
@@ -20,6 +20,8 @@
 
 #include "LayerProtoHelper.h"
 
+#include <ui/DebugUtils.h>
+
 namespace android {
 namespace surfaceflinger {
 
@@ -124,7 +126,7 @@ void LayerProtoHelper::writeToProto(const sp<GraphicBuffer>& buffer,
 }
 
 void LayerProtoHelper::writeToProto(
-        const InputWindowInfo& inputInfo, const wp<Layer>& touchableRegionBounds,
+        const InputWindowInfo& inputInfo, int32_t cropLayerId, const Rect& cropLayerBounds,
         std::function<InputWindowInfoProto*()> getInputWindowInfoProto) {
     if (inputInfo.token == nullptr) {
         return;
@@ -150,11 +152,9 @@ void LayerProtoHelper::writeToProto(
     proto->set_window_x_scale(inputInfo.windowXScale);
     proto->set_window_y_scale(inputInfo.windowYScale);
     proto->set_replace_touchable_region_with_crop(inputInfo.replaceTouchableRegionWithCrop);
-    auto cropLayer = touchableRegionBounds.promote();
-    if (cropLayer != nullptr) {
-        proto->set_crop_layer_id(cropLayer->sequence);
-        LayerProtoHelper::writeToProto(cropLayer->getScreenBounds(
-                                               false /* reduceTransparentRegion */),
+    if (cropLayerId >= 0) {
+        proto->set_crop_layer_id(cropLayerId);
+        LayerProtoHelper::writeToProto(cropLayerBounds,
                                        [&]() { return proto->mutable_touchable_region_crop(); });
     }
 }
@@ -167,6 +167,111 @@ void LayerProtoHelper::writeToProto(const mat4 matrix, ColorTransformProto* colo
     }
 }
 
+LayerProto* LayerProtoHelper::writeToProto(const LayerProtoSnapshot& snapshot,
+                                           LayersProto& layersProto) {
+    LayerProto* layerInfo = layersProto.add_layers();
+    const uint32_t traceFlags = snapshot.traceFlags;
+
+    if (traceFlags & SurfaceTracing::TRACE_CRITICAL) {
+        for (const auto& [id, frameNumber] : snapshot.barrierLayers) {
+            BarrierLayerProto* barrierLayerProto = layerInfo->add_barrier_layer();
+            barrierLayerProto->set_id(id);
+            barrierLayerProto->set_frame_number(frameNumber);
+        }
+
+        if (snapshot.buffer != nullptr) {
+            writeToProto(snapshot.buffer, [&]() { return layerInfo->mutable_active_buffer(); });
+            writeToProto(ui::Transform(snapshot.bufferTransform),
+                         layerInfo->mutable_buffer_transform());
+        }
+        layerInfo->set_invalidate(snapshot.invalidate);
+        layerInfo->set_is_protected(snapshot.isProtected);
+        layerInfo->set_dataspace(
+                dataspaceDetails(static_cast<android_dataspace>(snapshot.dataspace)));
+        layerInfo->set_queued_frames(snapshot.queuedFrames);
+        layerInfo->set_refresh_pending(snapshot.refreshPending);
+        layerInfo->set_curr_frame(snapshot.currFrame);
+        layerInfo->set_effective_scaling_mode(snapshot.effectiveScalingMode);
+
+        layerInfo->set_corner_radius(snapshot.cornerRadius);
+        writeToProto(snapshot.transform, layerInfo->mutable_transform());
+        writePositionToProto(snapshot.transform.tx(), snapshot.transform.ty(),
+                             [&]() { return layerInfo->mutable_position(); });
+        writeToProto(snapshot.bounds, [&]() { return layerInfo->mutable_bounds(); });
+        if (traceFlags & SurfaceTracing::TRACE_COMPOSITION) {
+            writeToProto(snapshot.visibleRegion,
+                         [&]() { return layerInfo->mutable_visible_region(); });
+        }
+        writeToProto(snapshot.damageRegion, [&]() { return layerInfo->mutable_damage_region(); });
+
+        if (snapshot.colorTransform) {
+            writeToProto(*snapshot.colorTransform, layerInfo->mutable_color_transform());
+        }
+
+        layerInfo->set_id(snapshot.id);
+        layerInfo->set_name(snapshot.name);
+        layerInfo->set_type(snapshot.type);
+
+        for (int32_t child : snapshot.children) {
+            layerInfo->add_children(child);
+        }
+        for (int32_t relative : snapshot.relatives) {
+            layerInfo->add_relatives(relative);
+        }
+
+        writeToProto(snapshot.transparentRegion,
+                     [&]() { return layerInfo->mutable_transparent_region(); });
+
+        layerInfo->set_layer_stack(snapshot.layerStack);
+        layerInfo->set_z(snapshot.z);
+
+        writePositionToProto(snapshot.requestedTransform.tx(), snapshot.requestedTransform.ty(),
+                             [&]() { return layerInfo->mutable_requested_position(); });
+        writeSizeToProto(snapshot.width, snapshot.height,
+                         [&]() { return layerInfo->mutable_size(); });
+        writeToProto(snapshot.crop, [&]() { return layerInfo->mutable_crop(); });
+
+        layerInfo->set_is_opaque(snapshot.isOpaque);
+        layerInfo->set_pixel_format(decodePixelFormat(snapshot.pixelFormat));
+        writeToProto(snapshot.color, [&]() { return layerInfo->mutable_color(); });
+        writeToProto(snapshot.requestedColor,
+                     [&]() { return layerInfo->mutable_requested_color(); });
+        layerInfo->set_flags(snapshot.flags);
+
+        writeToProto(snapshot.requestedTransform, layerInfo->mutable_requested_transform());
+
+        layerInfo->set_parent(snapshot.parent);
+        layerInfo->set_z_order_relative_of(snapshot.zOrderRelativeOf);
+        layerInfo->set_is_relative_of(snapshot.isRelativeOf);
+    }
+
+    writeToProto(snapshot.sourceBounds, [&]() { return layerInfo->mutable_source_bounds(); });
+    writeToProto(snapshot.screenBounds, [&]() { return layerInfo->mutable_screen_bounds(); });
+    writeToProto(snapshot.cornerRadiusCrop,
+                 [&]() { return layerInfo->mutable_corner_radius_crop(); });
+    layerInfo->set_shadow_radius(snapshot.shadowRadius);
+
+    if (traceFlags & SurfaceTracing::TRACE_INPUT) {
+        writeToProto(snapshot.inputInfo, snapshot.touchableRegionCropId,
+                     snapshot.touchableRegionCropBounds,
+                     [&]() { return layerInfo->mutable_input_window_info(); });
+    }
+
+    if (traceFlags & SurfaceTracing::TRACE_EXTRA) {
+        auto protoMap = layerInfo->mutable_metadata();
+        for (const auto& entry : snapshot.metadata.mMap) {
+            (*protoMap)[entry.first] = std::string(entry.second.cbegin(), entry.second.cend());
+        }
+    }
+
+    if (snapshot.hwcCompositionType) {
+        layerInfo->set_hwc_composition_type(
+                static_cast<HwcCompositionType>(*snapshot.hwcCompositionType));
+    }
+
+    return layerInfo;
+}
+
 } // namespace surfaceflinger
 } // namespace android
 
@@ -17,6 +17,7 @@
 #include <layerproto/LayerProtoHeader.h>
 
 #include <Layer.h>
+#include <LayerProtoSnapshot.h>
 #include <input/InputWindow.h>
 #include <math/vec4.h>
 #include <ui/GraphicBuffer.h>
@@ -40,10 +41,13 @@ public:
     static void writeToProto(const ui::Transform& transform, TransformProto* transformProto);
     static void writeToProto(const sp<GraphicBuffer>& buffer,
                              std::function<ActiveBufferProto*()> getActiveBufferProto);
-    static void writeToProto(const InputWindowInfo& inputInfo,
-                             const wp<Layer>& touchableRegionBounds,
+    static void writeToProto(const InputWindowInfo& inputInfo, int32_t cropLayerId,
+                             const Rect& cropLayerBounds,
                              std::function<InputWindowInfoProto*()> getInputWindowInfoProto);
     static void writeToProto(const mat4 matrix, ColorTransformProto* colorTransformProto);
+    // Adds the LayerProto of a layer captured by Layer::snapshotForProto. This
+    // doesn't touch the layer, so may be called from any thread.
+    static LayerProto* writeToProto(const LayerProtoSnapshot& snapshot, LayersProto& layersProto);
 };
 
 } // namespace surfaceflinger
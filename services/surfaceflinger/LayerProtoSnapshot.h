@@ -0,0 +1,109 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gui/LayerMetadata.h>
+#include <input/InputWindow.h>
+#include <math/mat4.h>
+#include <math/vec4.h>
+#include <ui/FloatRect.h>
+#include <ui/GraphicBuffer.h>
+#include <ui/GraphicTypes.h>
+#include <ui/PixelFormat.h>
+#include <ui/Rect.h>
+#include <ui/Region.h>
+#include <ui/Transform.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace android {
+
+// The part of a layer's drawing state that goes into its LayerProto.
+//
+// Building the proto of every layer is slow enough to make the main thread
+// miss frames, so the layer state is only copied into these, which is cheap,
+// on the main thread or with the tracing lock held. LayerProtoHelper then
+// writes the protos from them on whichever thread needs them.
+//
+// Only the fields selected by traceFlags are set.
+struct LayerProtoSnapshot {
+    uint32_t traceFlags = 0;
+
+    // TRACE_CRITICAL
+    int32_t id = 0;
+    std::string name;
+    const char* type = "";
+    int32_t parent = -1;
+    std::vector<int32_t> children;
+    std::vector<int32_t> relatives;
+    int32_t zOrderRelativeOf = -1;
+    bool isRelativeOf = false;
+    // The id and frame number of each layer the pending states wait for.
+    std::vector<std::pair<int32_t, uint64_t>> barrierLayers;
+    sp<GraphicBuffer> buffer;
+    uint32_t bufferTransform = 0;
+    bool invalidate = false;
+    bool isProtected = false;
+    ui::Dataspace dataspace = ui::Dataspace::UNKNOWN;
+    int32_t queuedFrames = 0;
+    bool refreshPending = false;
+    uint64_t currFrame = 0;
+    uint32_t effectiveScalingMode = 0;
+    float cornerRadius = 0.f;
+    ui::Transform transform;
+    FloatRect bounds;
+    Region damageRegion;
+    std::optional<mat4> colorTransform;
+    Region transparentRegion;
+    uint32_t layerStack = 0;
+    int32_t z = 0;
+    ui::Transform requestedTransform;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    Rect crop;
+    bool isOpaque = false;
+    PixelFormat pixelFormat = PIXEL_FORMAT_NONE;
+    half4 color;
+    half4 requestedColor;
+    uint32_t flags = 0;
+
+    // TRACE_CRITICAL | TRACE_COMPOSITION
+    Region visibleRegion;
+    // TRACE_COMPOSITION, and only for layers on the primary display.
+    std::optional<int32_t> hwcCompositionType;
+
+    // Always set.
+    FloatRect sourceBounds;
+    FloatRect screenBounds;
+    FloatRect cornerRadiusCrop;
+    float shadowRadius = 0.f;
+
+    // TRACE_INPUT
+    InputWindowInfo inputInfo;
+    // The layer whose bounds crop the touchable region, if any.
+    int32_t touchableRegionCropId = -1;
+    Rect touchableRegionCropBounds;
+
+    // TRACE_EXTRA
+    LayerMetadata metadata;
+};
+
+} // namespace android
@@ -24,25 +24,19 @@
 
 #include <gui/IProducerListener.h>
 
+#include <algorithm>
+#include <cstring>
+
 #undef LOG_TAG
 #define LOG_TAG "RefreshRateOverlay"
 
 namespace android {
 
-void RefreshRateOverlay::SevenSegmentDrawer::drawRect(const Rect& r, const half4& color,
-                                                      const sp<GraphicBuffer>& buffer,
-                                                      uint8_t* pixels) {
+void RefreshRateOverlay::DigitAtlas::drawRect(const Rect& r, const half4& color,
+                                              uint8_t* pixels) {
     for (int32_t j = r.top; j < r.bottom; j++) {
-        if (j >= buffer->getHeight()) {
-            break;
-        }
-
         for (int32_t i = r.left; i < r.right; i++) {
-            if (i >= buffer->getWidth()) {
-                break;
-            }
-
-            uint8_t* iter = pixels + 4 * (i + (buffer->getStride() * j));
+            uint8_t* iter = pixels + 4 * (i + (ATLAS_WIDTH * j));
             iter[0] = uint8_t(color.r * 255);
             iter[1] = uint8_t(color.g * 255);
             iter[2] = uint8_t(color.b * 255);
@@ -51,10 +45,8 @@ void RefreshRateOverlay::SevenSegmentDrawer::drawRect(const Rect& r, const half4
     }
 }
 
-void RefreshRateOverlay::SevenSegmentDrawer::drawSegment(Segment segment, int left,
-                                                         const half4& color,
-                                                         const sp<GraphicBuffer>& buffer,
-                                                         uint8_t* pixels) {
+void RefreshRateOverlay::DigitAtlas::drawSegment(Segment segment, int left, const half4& color,
+                                                 uint8_t* pixels) {
     const Rect rect = [&]() {
         switch (segment) {
             case Segment::Upper:
@@ -77,66 +69,62 @@ void RefreshRateOverlay::SevenSegmentDrawer::drawSegment(Segment segment, int le
         }
     }();
 
-    drawRect(rect, color, buffer, pixels);
+    drawRect(rect, color, pixels);
 }
 
-void RefreshRateOverlay::SevenSegmentDrawer::drawDigit(int digit, int left, const half4& color,
-                                                       const sp<GraphicBuffer>& buffer,
-                                                       uint8_t* pixels) {
+void RefreshRateOverlay::DigitAtlas::drawDigit(int digit, int left, const half4& color,
+                                               uint8_t* pixels) {
     if (digit < 0 || digit > 9) return;
 
     if (digit == 0 || digit == 2 || digit == 3 || digit == 5 || digit == 6 || digit == 7 ||
         digit == 8 || digit == 9)
-        drawSegment(Segment::Upper, left, color, buffer, pixels);
+        drawSegment(Segment::Upper, left, color, pixels);
     if (digit == 0 || digit == 4 || digit == 5 || digit == 6 || digit == 8 || digit == 9)
-        drawSegment(Segment::UpperLeft, left, color, buffer, pixels);
+        drawSegment(Segment::UpperLeft, left, color, pixels);
     if (digit == 0 || digit == 1 || digit == 2 || digit == 3 || digit == 4 || digit == 7 ||
         digit == 8 || digit == 9)
-        drawSegment(Segment::UpperRight, left, color, buffer, pixels);
+        drawSegment(Segment::UpperRight, left, color, pixels);
     if (digit == 2 || digit == 3 || digit == 4 || digit == 5 || digit == 6 || digit == 8 ||
         digit == 9)
-        drawSegment(Segment::Middle, left, color, buffer, pixels);
+        drawSegment(Segment::Middle, left, color, pixels);
     if (digit == 0 || digit == 2 || digit == 6 || digit == 8)
-        drawSegment(Segment::LowerLeft, left, color, buffer, pixels);
+        drawSegment(Segment::LowerLeft, left, color, pixels);
     if (digit == 0 || digit == 1 || digit == 3 || digit == 4 || digit == 5 || digit == 6 ||
         digit == 7 || digit == 8 || digit == 9)
-        drawSegment(Segment::LowerRight, left, color, buffer, pixels);
+        drawSegment(Segment::LowerRight, left, color, pixels);
     if (digit == 0 || digit == 2 || digit == 3 || digit == 5 || digit == 6 || digit == 8 ||
         digit == 9)
-        drawSegment(Segment::Buttom, left, color, buffer, pixels);
+        drawSegment(Segment::Buttom, left, color, pixels);
 }
 
-sp<GraphicBuffer> RefreshRateOverlay::SevenSegmentDrawer::drawNumber(int number,
-                                                                     const half4& color) {
-    if (number < 0 || number > 1000) return nullptr;
-
-    const auto hundreds = number / 100;
-    const auto tens = (number / 10) % 10;
-    const auto ones = number % 10;
+size_t RefreshRateOverlay::DigitAtlas::addColor(const half4& color) {
+    constexpr size_t colorSize = 4 * ATLAS_WIDTH * DIGIT_HEIGHT;
+    const size_t index = mPixels.size() / colorSize;
+    mPixels.resize(mPixels.size() + colorSize, 0);
 
-    sp<GraphicBuffer> buffer =
-            new GraphicBuffer(BUFFER_WIDTH, BUFFER_HEIGHT, HAL_PIXEL_FORMAT_RGBA_8888, 1,
-                              GRALLOC_USAGE_SW_WRITE_RARELY | GRALLOC_USAGE_HW_COMPOSER |
-                                      GRALLOC_USAGE_HW_TEXTURE,
-                              "RefreshRateOverlayBuffer");
-    uint8_t* pixels;
-    buffer->lock(GRALLOC_USAGE_SW_WRITE_RARELY, reinterpret_cast<void**>(&pixels));
-    // Clear buffer content
-    drawRect(Rect(BUFFER_WIDTH, BUFFER_HEIGHT), half4(0), buffer, pixels);
-    int left = 0;
-    if (hundreds != 0) {
-        drawDigit(hundreds, left, color, buffer, pixels);
-        left += DIGIT_WIDTH + DIGIT_SPACE;
+    uint8_t* pixels = mPixels.data() + index * colorSize;
+    for (int digit = 0; digit < 10; digit++) {
+        drawDigit(digit, digit * DIGIT_WIDTH, color, pixels);
     }
+    return index;
+}
+
+void RefreshRateOverlay::DigitAtlas::drawNumber(int number, size_t color, uint32_t top,
+                                                uint8_t* pixels, uint32_t stride) const {
+    number = std::clamp(number, 0, 999);
+    const int digits[] = {number / 100, (number / 10) % 10, number % 10};
+    const int firstDigit = number >= 100 ? 0 : number >= 10 ? 1 : 2;
 
-    if (tens != 0) {
-        drawDigit(tens, left, color, buffer, pixels);
+    const uint8_t* colorPixels = mPixels.data() + color * 4 * ATLAS_WIDTH * DIGIT_HEIGHT;
+    uint32_t left = 0;
+    for (int i = firstDigit; i < 3; i++) {
+        const uint8_t* src = colorPixels + 4 * digits[i] * DIGIT_WIDTH;
+        uint8_t* dst = pixels + 4 * (left + stride * top);
+        for (uint32_t j = 0; j < DIGIT_HEIGHT; j++) {
+            memcpy(dst + 4 * stride * j, src + 4 * ATLAS_WIDTH * j, 4 * DIGIT_WIDTH);
+        }
         left += DIGIT_WIDTH + DIGIT_SPACE;
     }
-
-    drawDigit(ones, left, color, buffer, pixels);
-    buffer->unlock();
-    return buffer;
 }
 
 RefreshRateOverlay::RefreshRateOverlay(SurfaceFlinger& flinger)
@@ -147,9 +135,8 @@ RefreshRateOverlay::RefreshRateOverlay(SurfaceFlinger& flinger)
 
 bool RefreshRateOverlay::createLayer() {
     const status_t ret =
-            mFlinger.createLayer(String8("RefreshRateOverlay"), mClient,
-                                 SevenSegmentDrawer::getWidth(), SevenSegmentDrawer::getHeight(),
-                                 PIXEL_FORMAT_RGBA_8888,
+            mFlinger.createLayer(String8("RefreshRateOverlay"), mClient, BUFFER_WIDTH,
+                                 BUFFER_HEIGHT, PIXEL_FORMAT_RGBA_8888,
                                  ISurfaceComposerClient::eFXSurfaceBufferState, LayerMetadata(),
                                  &mIBinder, &mGbp, nullptr);
     if (ret) {
@@ -168,6 +155,10 @@ bool RefreshRateOverlay::createLayer() {
         mFlinger.mCurrentState.layersSortedByZ.add(mLayer);
     }
 
+    // Dim the content behind the numbers with an effect layer, which the HWC
+    // composes as a solid color, rather than with the overlay buffer.
+    mLayer->setBackgroundColor(half3(0.0f), BACKGROUND_ALPHA, ui::Dataspace::V0_SRGB);
+
     return true;
 }
 
@@ -176,32 +167,69 @@ void RefreshRateOverlay::primeCache() {
     if (allRefreshRates.size() == 1) {
         auto fps = allRefreshRates.begin()->second->getFps();
         half4 color = {LOW_FPS_COLOR, ALPHA};
-        mBufferCache.emplace(fps, SevenSegmentDrawer::drawNumber(fps, color));
-        return;
+        mFpsColors.emplace(fps, mAtlas.addColor(color));
+    } else {
+        std::vector<uint32_t> supportedFps;
+        supportedFps.reserve(allRefreshRates.size());
+        for (auto& [ignored, refreshRate] : allRefreshRates) {
+            supportedFps.push_back(refreshRate->getFps());
+        }
+
+        std::sort(supportedFps.begin(), supportedFps.end());
+        const auto mLowFps = supportedFps[0];
+        const auto mHighFps = supportedFps[supportedFps.size() - 1];
+        for (auto fps : supportedFps) {
+            if (mFpsColors.count(fps)) continue;
+            const auto fpsScale = float(fps - mLowFps) / (mHighFps - mLowFps);
+            half4 color;
+            color.r = HIGH_FPS_COLOR.r * fpsScale + LOW_FPS_COLOR.r * (1 - fpsScale);
+            color.g = HIGH_FPS_COLOR.g * fpsScale + LOW_FPS_COLOR.g * (1 - fpsScale);
+            color.b = HIGH_FPS_COLOR.b * fpsScale + LOW_FPS_COLOR.b * (1 - fpsScale);
+            color.a = ALPHA;
+            mFpsColors.emplace(fps, mAtlas.addColor(color));
+        }
     }
 
-    std::vector<uint32_t> supportedFps;
-    supportedFps.reserve(allRefreshRates.size());
-    for (auto& [ignored, refreshRate] : allRefreshRates) {
-        supportedFps.push_back(refreshRate->getFps());
+    mCounterColor = mAtlas.addColor({COUNTER_COLOR, ALPHA});
+    mMissedFramesColor = mAtlas.addColor({MISSED_FRAMES_COLOR, ALPHA});
+
+    for (auto& buffer : mBuffers) {
+        buffer = new GraphicBuffer(BUFFER_WIDTH, BUFFER_HEIGHT, HAL_PIXEL_FORMAT_RGBA_8888, 1,
+                                   GRALLOC_USAGE_SW_WRITE_RARELY | GRALLOC_USAGE_HW_COMPOSER |
+                                           GRALLOC_USAGE_HW_TEXTURE,
+                                   "RefreshRateOverlayBuffer");
     }
+}
 
-    std::sort(supportedFps.begin(), supportedFps.end());
-    const auto mLowFps = supportedFps[0];
-    const auto mHighFps = supportedFps[supportedFps.size() - 1];
-    for (auto fps : supportedFps) {
-        const auto fpsScale = float(fps - mLowFps) / (mHighFps - mLowFps);
-        half4 color;
-        color.r = HIGH_FPS_COLOR.r * fpsScale + LOW_FPS_COLOR.r * (1 - fpsScale);
-        color.g = HIGH_FPS_COLOR.g * fpsScale + LOW_FPS_COLOR.g * (1 - fpsScale);
-        color.b = HIGH_FPS_COLOR.b * fpsScale + LOW_FPS_COLOR.b * (1 - fpsScale);
-        color.a = ALPHA;
-        mBufferCache.emplace(fps, SevenSegmentDrawer::drawNumber(fps, color));
+void RefreshRateOverlay::updateBuffer() {
+    const sp<GraphicBuffer>& buffer = mBuffers[mNextBuffer];
+    mNextBuffer = (mNextBuffer + 1) % NUM_BUFFERS;
+
+    uint8_t* pixels;
+    if (buffer->lock(GRALLOC_USAGE_SW_WRITE_RARELY, reinterpret_cast<void**>(&pixels)) != OK) {
+        ALOGE("failed to lock overlay buffer");
+        return;
     }
+
+    const uint32_t stride = buffer->getStride();
+    memset(pixels, 0, 4 * stride * BUFFER_HEIGHT);
+
+    const auto color = mFpsColors.find(mRefreshRate);
+    constexpr uint32_t rowHeight = DigitAtlas::DIGIT_HEIGHT + DigitAtlas::DIGIT_SPACE;
+    mAtlas.drawNumber(mRefreshRate, color != mFpsColors.end() ? color->second : mCounterColor, 0,
+                      pixels, stride);
+    mAtlas.drawNumber(mPresentRate, mCounterColor, rowHeight, pixels, stride);
+    mAtlas.drawNumber(mMissedFrames, mMissedFramesColor, 2 * rowHeight, pixels, stride);
+    buffer->unlock();
+
+    mLayer->setBuffer(buffer, Fence::NO_FENCE, 0, 0, {});
+    mFlinger.mTransactionFlags.fetch_or(eTransactionMask);
 }
 
 void RefreshRateOverlay::setViewport(ui::Size viewport) {
-    Rect frame(viewport.width >> 3, viewport.height >> 5);
+    const int32_t rowHeight = viewport.height >> 5;
+    Rect frame(viewport.width >> 3,
+               rowHeight * int32_t(BUFFER_HEIGHT) / int32_t(DigitAtlas::DIGIT_HEIGHT));
     frame.offsetBy(viewport.width >> 5, viewport.height >> 4);
     mLayer->setFrame(frame);
 
@@ -209,10 +237,38 @@ void RefreshRateOverlay::setViewport(ui::Size viewport) {
 }
 
 void RefreshRateOverlay::changeRefreshRate(const RefreshRate& refreshRate) {
-    auto buffer = mBufferCache[refreshRate.getFps()];
-    mLayer->setBuffer(buffer, Fence::NO_FENCE, 0, 0, {});
+    mRefreshRate = refreshRate.getFps();
+    updateBuffer();
+}
 
-    mFlinger.mTransactionFlags.fetch_or(eTransactionMask);
+void RefreshRateOverlay::onPostComposition(nsecs_t now, bool presented,
+                                           uint32_t missedFrameCount) {
+    if (!mInitialMissedFrameCount) {
+        mInitialMissedFrameCount = missedFrameCount;
+        mWindowStart = now;
+    }
+    if (presented) {
+        mWindowPresentCount++;
+    }
+
+    const nsecs_t elapsed = now - mWindowStart;
+    if (elapsed < s2ns(1)) {
+        return;
+    }
+
+    const int presentRate = int((mWindowPresentCount * s2ns(1) + elapsed / 2) / elapsed);
+    const int missedFrames = int(std::min(missedFrameCount - *mInitialMissedFrameCount, 999u));
+    mWindowStart = now;
+    mWindowPresentCount = 0;
+
+    if (presentRate == mPresentRate && missedFrames == mMissedFrames) {
+        return;
+    }
+
+    Mutex::Autolock lock(mFlinger.mStateLock);
+    mPresentRate = presentRate;
+    mMissedFrames = missedFrames;
+    updateBuffer();
 }
 
 } // namespace android
@@ -16,12 +16,16 @@
 
 #pragma once
 
+#include <array>
+#include <optional>
 #include <unordered_map>
+#include <vector>
 
 #include <math/vec4.h>
 #include <ui/Rect.h>
 #include <ui/Size.h>
 #include <utils/StrongPointer.h>
+#include <utils/Timers.h>
 
 #include "Scheduler/RefreshRateConfigs.h"
 
@@ -43,33 +47,57 @@ public:
     void setViewport(ui::Size);
     void changeRefreshRate(const RefreshRate&);
 
+    // Counts the frame that was just composited, and shows the measured present
+    // rate and the number of missed frames about once per second. Called on the
+    // main thread without mStateLock, which is only taken when the numbers change.
+    void onPostComposition(nsecs_t now, bool presented, uint32_t missedFrameCount);
+
 private:
-    class SevenSegmentDrawer {
+    // The digits 0 to 9 in every color of the overlay, drawn once when the
+    // overlay is created. Showing a number copies its digits out of the atlas,
+    // instead of drawing every segment of it again.
+    class DigitAtlas {
     public:
-        static sp<GraphicBuffer> drawNumber(int number, const half4& color);
-        static uint32_t getHeight() { return BUFFER_HEIGHT; }
-        static uint32_t getWidth() { return BUFFER_WIDTH; }
-
-    private:
-        enum class Segment { Upper, UpperLeft, UpperRight, Middle, LowerLeft, LowerRight, Buttom };
+        // Returns the index of the color added.
+        size_t addColor(const half4& color);
 
-        static void drawRect(const Rect& r, const half4& color, const sp<GraphicBuffer>& buffer,
-                             uint8_t* pixels);
-        static void drawSegment(Segment segment, int left, const half4& color,
-                                const sp<GraphicBuffer>& buffer, uint8_t* pixels);
-        static void drawDigit(int digit, int left, const half4& color,
-                              const sp<GraphicBuffer>& buffer, uint8_t* pixels);
+        // Copies |number| into a buffer as at most three digits starting at
+        // |top|, without leading zeros.
+        void drawNumber(int number, size_t color, uint32_t top, uint8_t* pixels,
+                        uint32_t stride) const;
 
         static constexpr uint32_t DIGIT_HEIGHT = 100;
         static constexpr uint32_t DIGIT_WIDTH = 64;
         static constexpr uint32_t DIGIT_SPACE = 16;
-        static constexpr uint32_t BUFFER_HEIGHT = DIGIT_HEIGHT;
-        static constexpr uint32_t BUFFER_WIDTH =
-                3 * DIGIT_WIDTH + 2 * DIGIT_SPACE; // Digit|Space|Digit|Space|Digit
+
+    private:
+        enum class Segment { Upper, UpperLeft, UpperRight, Middle, LowerLeft, LowerRight, Buttom };
+
+        static constexpr uint32_t ATLAS_WIDTH = 10 * DIGIT_WIDTH;
+
+        void drawRect(const Rect& r, const half4& color, uint8_t* pixels);
+        void drawSegment(Segment segment, int left, const half4& color, uint8_t* pixels);
+        void drawDigit(int digit, int left, const half4& color, uint8_t* pixels);
+
+        // ATLAS_WIDTH x DIGIT_HEIGHT RGBA_8888 pixels per color.
+        std::vector<uint8_t> mPixels;
     };
 
+    // Refresh rate, present rate and missed frames, one per row.
+    static constexpr uint32_t NUM_ROWS = 3;
+    static constexpr uint32_t BUFFER_HEIGHT =
+            NUM_ROWS * DigitAtlas::DIGIT_HEIGHT + (NUM_ROWS - 1) * DigitAtlas::DIGIT_SPACE;
+    static constexpr uint32_t BUFFER_WIDTH = 3 * DigitAtlas::DIGIT_WIDTH +
+            2 * DigitAtlas::DIGIT_SPACE; // Digit|Space|Digit|Space|Digit
+
+    // The buffers are reused in turn. The overlay changes at most a few times
+    // per second, so a buffer has long been released when it is drawn again.
+    static constexpr size_t NUM_BUFFERS = 3;
+
     bool createLayer();
     void primeCache();
+    // Draws the numbers into the next buffer. Called with mStateLock held.
+    void updateBuffer();
 
     SurfaceFlinger& mFlinger;
     const sp<Client> mClient;
@@ -77,11 +105,28 @@ private:
     sp<IBinder> mIBinder;
     sp<IGraphicBufferProducer> mGbp;
 
-    std::unordered_map<int, sp<GraphicBuffer>> mBufferCache;
+    DigitAtlas mAtlas;
+    std::unordered_map<int, size_t> mFpsColors;
+    size_t mCounterColor = 0;
+    size_t mMissedFramesColor = 0;
+
+    std::array<sp<GraphicBuffer>, NUM_BUFFERS> mBuffers;
+    size_t mNextBuffer = 0;
+
+    int mRefreshRate = 0;
+    int mPresentRate = 0;
+    int mMissedFrames = 0;
+
+    nsecs_t mWindowStart = 0;
+    uint32_t mWindowPresentCount = 0;
+    std::optional<uint32_t> mInitialMissedFrameCount;
 
     static constexpr float ALPHA = 0.8f;
+    static constexpr float BACKGROUND_ALPHA = 0.3f;
     const half3 LOW_FPS_COLOR = half3(1.0f, 0.0f, 0.0f);
     const half3 HIGH_FPS_COLOR = half3(0.0f, 1.0f, 0.0f);
+    const half3 COUNTER_COLOR = half3(1.0f, 1.0f, 1.0f);
+    const half3 MISSED_FRAMES_COLOR = half3(1.0f, 1.0f, 0.0f);
 };
 
 } // namespace android
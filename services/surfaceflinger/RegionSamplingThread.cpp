@@ -32,6 +32,7 @@
 #include <ui/DisplayStatInfo.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <string>
 
 #include "DisplayDevice.h"
@@ -62,6 +63,7 @@ constexpr auto maxRegionSamplingSkips = 10;
 constexpr auto defaultRegionSamplingOffset = -3ms;
 constexpr auto defaultRegionSamplingPeriod = 100ms;
 constexpr auto defaultRegionSamplingTimerTimeout = 100ms;
+constexpr int32_t defaultRegionSamplingDownscale = 4;
 // TODO: (b/127403193) duration to string conversion could probably be constexpr
 template <typename Rep, typename Per>
 inline std::string toNsString(std::chrono::duration<Rep, Per> t) {
@@ -168,6 +170,9 @@ RegionSamplingThread::RegionSamplingThread(SurfaceFlinger& flinger, Scheduler& s
       : mFlinger(flinger),
         mScheduler(scheduler),
         mTunables(tunables),
+        mDownscale(std::max(1,
+                            property_get_int32("debug.sf.region_sampling_downscale",
+                                               defaultRegionSamplingDownscale))),
         mIdleTimer(std::chrono::duration_cast<std::chrono::milliseconds>(
                            mTunables.mSamplingTimerTimeout),
                    [] {}, [this] { checkForStaleLuma(); }),
@@ -307,8 +312,138 @@ float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t st
     return accumulatedLuma / (255.0f * pixelCount);
 }
 
+Rect scaleSamplingArea(const Rect& area, int32_t downscale) {
+    // Round outwards so that every pixel the area touched is still sampled.
+    return Rect(area.left / downscale, area.top / downscale,
+                (area.right + downscale - 1) / downscale,
+                (area.bottom + downscale - 1) / downscale);
+}
+
+namespace {
+
+// The bits of IComposerClient::FormatColorComponent.
+constexpr uint8_t kFormatComponent0 = 1 << 0;
+constexpr uint8_t kFormatComponent1 = 1 << 1;
+constexpr uint8_t kFormatComponent2 = 1 << 2;
+constexpr uint8_t kRgbComponents = kFormatComponent0 | kFormatComponent1 | kFormatComponent2;
+
+enum class LumaComponents { None, Y, Rgb };
+
+LumaComponents lumaComponents(ui::PixelFormat format, uint8_t componentMask) {
+    switch (format) {
+        case ui::PixelFormat::RGBA_8888:
+        case ui::PixelFormat::RGBX_8888:
+        case ui::PixelFormat::RGB_888:
+        case ui::PixelFormat::RGB_565:
+        case ui::PixelFormat::RGBA_1010102:
+        case ui::PixelFormat::RGBA_FP16:
+            return (componentMask & kRgbComponents) == kRgbComponents ? LumaComponents::Rgb
+                                                                       : LumaComponents::None;
+        case ui::PixelFormat::YCBCR_420_888:
+        case ui::PixelFormat::YCBCR_422_SP:
+        case ui::PixelFormat::YCRCB_420_SP:
+        case ui::PixelFormat::YCBCR_422_I:
+        case ui::PixelFormat::YCBCR_P010:
+        case ui::PixelFormat::YV12:
+        case ui::PixelFormat::Y8:
+        case ui::PixelFormat::Y16:
+            return (componentMask & kFormatComponent0) ? LumaComponents::Y : LumaComponents::None;
+        default:
+            return LumaComponents::None;
+    }
+}
+
+// Returns the mean of a histogram of evenly weighted buckets, between 0 and 1, taking the middle
+// of each bucket as the value of its pixels.
+std::optional<float> histogramMean(const std::vector<uint64_t>& histogram) {
+    uint64_t count = 0;
+    double sum = 0.0;
+    for (size_t i = 0; i < histogram.size(); i++) {
+        count += histogram[i];
+        sum += histogram[i] * (i + 0.5);
+    }
+    if (count == 0) return std::nullopt;
+    return static_cast<float>(sum / (count * histogram.size()));
+}
+
+} // namespace
+
+std::optional<float> histogramLuma(const DisplayedFrameStats& stats, ui::PixelFormat format,
+                                   uint8_t componentMask) {
+    switch (lumaComponents(format, componentMask)) {
+        case LumaComponents::None:
+            return std::nullopt;
+        case LumaComponents::Y:
+            return histogramMean(stats.component_0_sample);
+        case LumaComponents::Rgb: {
+            const auto r = histogramMean(stats.component_0_sample);
+            const auto g = histogramMean(stats.component_1_sample);
+            const auto b = histogramMean(stats.component_2_sample);
+            if (!r || !g || !b) return std::nullopt;
+            // The same approximation of Rec. 709 primaries as sampleArea.
+            return (*r * 7 + *b * 2 + *g * 23) / 32;
+        }
+    }
+}
+
+std::optional<float> RegionSamplingThread::sampleDisplayedContent(
+        const sp<const DisplayDevice>& device, bool wanted) {
+    if (!wanted && (!mContentSampling || !mContentSampling->enabled)) return std::nullopt;
+
+    const sp<IBinder> displayToken = device->getDisplayToken().promote();
+    if (!displayToken) return std::nullopt;
+
+    if (!mContentSamplingQueried) {
+        mContentSamplingQueried = true;
+        ui::PixelFormat format;
+        ui::Dataspace dataspace;
+        uint8_t componentMask;
+        if (mFlinger.getDisplayedContentSamplingAttributes(displayToken, &format, &dataspace,
+                                                           &componentMask) == NO_ERROR &&
+            lumaComponents(format, componentMask) != LumaComponents::None) {
+            mContentSampling = ContentSampling{format, componentMask};
+        }
+    }
+    if (!mContentSampling) return std::nullopt;
+
+    if (mContentSampling->enabled != wanted) {
+        // Keep every frame until it is read, as the frames are read once per sampling period,
+        // and only those displayed since the previous read are asked for.
+        constexpr uint64_t kAllFrames = 0;
+        if (mFlinger.setDisplayContentSamplingEnabled(displayToken, wanted,
+                                                      mContentSampling->componentMask,
+                                                      kAllFrames) != NO_ERROR) {
+            ALOGW("Failed to %s displayed content sampling", wanted ? "enable" : "disable");
+            mContentSampling.reset();
+            return std::nullopt;
+        }
+        mContentSampling->enabled = wanted;
+        mContentSampling->lastSampleTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        mContentSampling->lastLuma.reset();
+    }
+    if (!wanted) return std::nullopt;
+
+    ATRACE_CALL();
+    DisplayedFrameStats stats;
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (mFlinger.getDisplayedContentSample(displayToken, 0, mContentSampling->lastSampleTime,
+                                           &stats) != NO_ERROR) {
+        return std::nullopt;
+    }
+
+    // No frame displayed since the last read leaves the luma as it was.
+    if (stats.numFrames > 0) {
+        if (const auto luma = histogramLuma(stats, mContentSampling->format,
+                                            mContentSampling->componentMask)) {
+            mContentSampling->lastLuma = luma;
+            mContentSampling->lastSampleTime = now;
+        }
+    }
+    return mContentSampling->lastLuma;
+}
+
 std::vector<float> RegionSamplingThread::sampleBuffer(
-        const sp<GraphicBuffer>& buffer, const Point& leftTop,
+        const sp<GraphicBuffer>& buffer, const Point& leftTop, int32_t downscale,
         const std::vector<RegionSamplingThread::Descriptor>& descriptors, uint32_t orientation) {
     void* data_raw = nullptr;
     buffer->lock(GRALLOC_USAGE_SW_READ_OFTEN, &data_raw);
@@ -323,7 +458,7 @@ std::vector<float> RegionSamplingThread::sampleBuffer(
     std::transform(descriptors.begin(), descriptors.end(), lumas.begin(),
                    [&](auto const& descriptor) {
                        return sampleArea(data.get(), width, height, stride, orientation,
-                                         descriptor.area - leftTop);
+                                         scaleSamplingArea(descriptor.area - leftTop, downscale));
                    });
     return lumas;
 }
@@ -339,15 +474,48 @@ void RegionSamplingThread::captureSample() {
     const auto device = mFlinger.getDefaultDisplayDevice();
     const auto orientation = ui::Transform::toRotationFlags(device->getOrientation());
 
+    // The HWC histograms cover every layer of the whole display, so they can only replace the
+    // capture of listeners that sample all of it, with no stop layer.
+    const Rect displayBounds = device->getBounds();
     std::vector<RegionSamplingThread::Descriptor> descriptors;
-    Region sampleRegion;
+    std::vector<RegionSamplingThread::Descriptor> displayDescriptors;
     for (const auto& [listener, descriptor] : mDescriptors) {
+        Rect covered;
+        if (!descriptor.stopLayer.promote() &&
+            descriptor.area.intersect(displayBounds, &covered) && covered == displayBounds) {
+            displayDescriptors.emplace_back(descriptor);
+        } else {
+            descriptors.emplace_back(descriptor);
+        }
+    }
+
+    if (const auto luma = sampleDisplayedContent(device, !displayDescriptors.empty())) {
+        for (const auto& descriptor : displayDescriptors) {
+            descriptor.listener->onSampleCollected(*luma);
+        }
+    } else {
+        descriptors.insert(descriptors.end(), displayDescriptors.begin(),
+                           displayDescriptors.end());
+    }
+
+    if (descriptors.empty()) {
+        ATRACE_INT(lumaSamplingStepTag, static_cast<int>(samplingStep::noWorkNeeded));
+        return;
+    }
+
+    Region sampleRegion;
+    for (const auto& descriptor : descriptors) {
         sampleRegion.orSelf(descriptor.area);
-        descriptors.emplace_back(descriptor);
     }
 
     const Rect sampledArea = sampleRegion.bounds();
 
+    // Every listener is sampled from a single capture of the union of their areas. The capture
+    // is scaled down as it is rendered, leaving little for the CPU to read back and average.
+    const int32_t downscale = mDownscale;
+    const int32_t captureWidth = (sampledArea.getWidth() + downscale - 1) / downscale;
+    const int32_t captureHeight = (sampledArea.getHeight() + downscale - 1) / downscale;
+
     auto dx = 0;
     auto dy = 0;
     switch (orientation) {
@@ -368,8 +536,8 @@ void RegionSamplingThread::captureSample() {
     ui::Transform t(orientation);
     auto screencapRegion = t.transform(sampleRegion);
     screencapRegion = screencapRegion.translate(dx, dy);
-    DisplayRenderArea renderArea(device, screencapRegion.bounds(), sampledArea.getWidth(),
-                                 sampledArea.getHeight(), ui::Dataspace::V0_SRGB, orientation);
+    DisplayRenderArea renderArea(device, screencapRegion.bounds(), captureWidth, captureHeight,
+                                 ui::Dataspace::V0_SRGB, orientation);
 
     std::unordered_set<sp<IRegionSamplingListener>, SpHash<IRegionSamplingListener>> listeners;
 
@@ -415,13 +583,13 @@ void RegionSamplingThread::captureSample() {
     };
 
     sp<GraphicBuffer> buffer = nullptr;
-    if (mCachedBuffer && mCachedBuffer->getWidth() == sampledArea.getWidth() &&
-        mCachedBuffer->getHeight() == sampledArea.getHeight()) {
+    if (mCachedBuffer && mCachedBuffer->getWidth() == captureWidth &&
+        mCachedBuffer->getHeight() == captureHeight) {
         buffer = mCachedBuffer;
     } else {
         const uint32_t usage = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_HW_RENDER;
-        buffer = new GraphicBuffer(sampledArea.getWidth(), sampledArea.getHeight(),
-                                   PIXEL_FORMAT_RGBA_8888, 1, usage, "RegionSamplingThread");
+        buffer = new GraphicBuffer(captureWidth, captureHeight, PIXEL_FORMAT_RGBA_8888, 1, usage,
+                                   "RegionSamplingThread");
     }
 
     bool ignored;
@@ -437,7 +605,7 @@ void RegionSamplingThread::captureSample() {
 
     ALOGV("Sampling %zu descriptors", activeDescriptors.size());
     std::vector<float> lumas =
-            sampleBuffer(buffer, sampledArea.leftTop(), activeDescriptors, orientation);
+            sampleBuffer(buffer, sampledArea.leftTop(), downscale, activeDescriptors, orientation);
     if (lumas.size() != activeDescriptors.size()) {
         ALOGW("collected %zu median luma values for %zu descriptors", lumas.size(),
               activeDescriptors.size());
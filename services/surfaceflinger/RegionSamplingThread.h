@@ -19,18 +19,22 @@
 #include <chrono>
 #include <condition_variable>
 #include <mutex>
+#include <optional>
 #include <thread>
 #include <unordered_map>
 
 #include <android-base/thread_annotations.h>
 #include <binder/IBinder.h>
+#include <ui/DisplayedFrameStats.h>
 #include <ui/GraphicBuffer.h>
+#include <ui/GraphicTypes.h>
 #include <ui/Rect.h>
 #include <utils/StrongPointer.h>
 #include "Scheduler/OneShotTimer.h"
 
 namespace android {
 
+class DisplayDevice;
 class IRegionSamplingListener;
 class Layer;
 class Scheduler;
@@ -40,6 +44,16 @@ struct SamplingOffsetCallback;
 float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t stride,
                  uint32_t orientation, const Rect& area);
 
+// Maps an area of the full size capture to the pixels that cover it in a capture scaled down by
+// the given factor in each dimension.
+Rect scaleSamplingArea(const Rect& area, int32_t downscale);
+
+// Returns the mean luma, between 0 and 1, of the frames counted in the displayed content
+// histograms of the HWC, or nothing if the histograms are empty, or if the components sampled in
+// the given format are not enough to compute luma.
+std::optional<float> histogramLuma(const DisplayedFrameStats& stats, ui::PixelFormat format,
+                                   uint8_t componentMask);
+
 class RegionSamplingThread : public IBinder::DeathRecipient {
 public:
     struct TimingTunables {
@@ -94,19 +108,28 @@ private:
         }
     };
     std::vector<float> sampleBuffer(
-            const sp<GraphicBuffer>& buffer, const Point& leftTop,
+            const sp<GraphicBuffer>& buffer, const Point& leftTop, int32_t downscale,
             const std::vector<RegionSamplingThread::Descriptor>& descriptors, uint32_t orientation);
 
     void doSample();
     void binderDied(const wp<IBinder>& who) override;
     void checkForStaleLuma();
 
+    // Enables the displayed content sampling of the HWC while it is wanted, if the HWC supports
+    // it, and returns the luma of the frames displayed since the last call.
+    std::optional<float> sampleDisplayedContent(const sp<const DisplayDevice>& device, bool wanted)
+            REQUIRES(mSamplingMutex);
+
     void captureSample();
     void threadMain();
 
     SurfaceFlinger& mFlinger;
     Scheduler& mScheduler;
     const TimingTunables mTunables;
+    // debug.sf.region_sampling_downscale
+    // The factor by which the sampled region is scaled down in each dimension when it is rendered,
+    // so the GPU does most of the averaging and only a small buffer is read back.
+    const int32_t mDownscale;
     scheduler::OneShotTimer mIdleTimer;
 
     std::unique_ptr<SamplingOffsetCallback> const mPhaseCallback;
@@ -123,6 +146,18 @@ private:
     std::mutex mSamplingMutex;
     std::unordered_map<wp<IBinder>, Descriptor, WpHash> mDescriptors GUARDED_BY(mSamplingMutex);
     sp<GraphicBuffer> mCachedBuffer GUARDED_BY(mSamplingMutex) = nullptr;
+
+    // Listeners that sample the whole display with nothing above them are given the luma of the
+    // histograms the HWC records while displaying, if it can, instead of one from a GPU capture.
+    struct ContentSampling {
+        ui::PixelFormat format;
+        uint8_t componentMask;
+        bool enabled = false;
+        nsecs_t lastSampleTime = 0;
+        std::optional<float> lastLuma;
+    };
+    bool mContentSamplingQueried GUARDED_BY(mSamplingMutex) = false;
+    std::optional<ContentSampling> mContentSampling GUARDED_BY(mSamplingMutex);
 };
 
 } // namespace android
@@ -108,6 +108,10 @@ void DispSyncSource::onDispSyncEvent(nsecs_t when, nsecs_t expectedVSyncTimestam
     }
 }
 
+nsecs_t DispSyncSource::getVsyncPeriod() const {
+    return mDispSync->getPeriod();
+}
+
 void DispSyncSource::dump(std::string& result) const {
     std::lock_guard lock(mVsyncMutex);
     StringAppendF(&result, "DispSyncSource: %s(%s)\n", mName, mEnabled ? "enabled" : "disabled");
@@ -24,6 +24,7 @@
 #include <sched.h>
 #include <sys/types.h>
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <optional>
@@ -32,6 +33,7 @@
 #include <android-base/stringprintf.h>
 
 #include <bfqio/bfqio.h>
+#include <binder/IPCThreadState.h>
 #include <cutils/compiler.h>
 #include <cutils/sched_policy.h>
 
@@ -68,7 +70,7 @@ std::string toString(VSyncRequest request) {
 }
 
 std::string toString(const EventThreadConnection& connection) {
-    return StringPrintf("Connection{%p, %s}", &connection,
+    return StringPrintf("Connection{%p, uid=%d, %s}", &connection, connection.mOwnerUid,
                         toString(connection.vsyncRequest).c_str());
 }
 
@@ -80,9 +82,13 @@ std::string toString(const DisplayEventReceiver::Event& event) {
                                 event.hotplug.connected ? "connected" : "disconnected");
         case DisplayEventReceiver::DISPLAY_EVENT_VSYNC:
             return StringPrintf("VSync{displayId=%" ANDROID_PHYSICAL_DISPLAY_ID_FORMAT
-                                ", count=%u, expectedVSyncTimestamp=%" PRId64 "}",
+                                ", count=%u, expectedVSyncTimestamp=%" PRId64
+                                ", expectedPresentTimestamp=%" PRId64 ", deadlineTimestamp=%" PRId64
+                                ", vsyncId=%" PRId64 "}",
                                 event.header.displayId, event.vsync.count,
-                                event.vsync.expectedVSyncTimestamp);
+                                event.vsync.expectedVSyncTimestamp,
+                                event.vsync.expectedPresentTimestamp,
+                                event.vsync.deadlineTimestamp, event.vsync.vsyncId);
         case DisplayEventReceiver::DISPLAY_EVENT_CONFIG_CHANGED:
             return StringPrintf("ConfigChanged{displayId=%" ANDROID_PHYSICAL_DISPLAY_ID_FORMAT
                                 ", configId=%u}",
@@ -100,12 +106,23 @@ DisplayEventReceiver::Event makeHotplug(PhysicalDisplayId displayId, nsecs_t tim
     return event;
 }
 
+// Shared by all EventThreads, so that SurfaceFlinger can tell frames apart whichever thread
+// they were started from.
+int64_t generateVsyncId() {
+    static std::atomic<int64_t> sNextVsyncId{1};
+    return sNextVsyncId.fetch_add(1, std::memory_order_relaxed);
+}
+
 DisplayEventReceiver::Event makeVSync(PhysicalDisplayId displayId, nsecs_t timestamp,
-                                      uint32_t count, nsecs_t expectedVSyncTimestamp) {
+                                      uint32_t count, nsecs_t expectedVSyncTimestamp,
+                                      nsecs_t expectedPresentTimestamp, nsecs_t deadlineTimestamp) {
     DisplayEventReceiver::Event event;
     event.header = {DisplayEventReceiver::DISPLAY_EVENT_VSYNC, displayId, timestamp};
     event.vsync.count = count;
     event.vsync.expectedVSyncTimestamp = expectedVSyncTimestamp;
+    event.vsync.expectedPresentTimestamp = expectedPresentTimestamp;
+    event.vsync.deadlineTimestamp = deadlineTimestamp;
+    event.vsync.vsyncId = generateVsyncId();
     return event;
 }
 
@@ -125,6 +142,7 @@ EventThreadConnection::EventThreadConnection(EventThread* eventThread,
                                              ISurfaceComposer::ConfigChanged configChanged)
       : resyncCallback(std::move(resyncCallback)),
         mConfigChanged(configChanged),
+        mOwnerUid(IPCThreadState::self()->getCallingUid()),
         mEventThread(eventThread),
         mChannel(gui::BitTube::DefaultSize) {}
 
@@ -154,6 +172,10 @@ void EventThreadConnection::requestNextVsync() {
     mEventThread->requestNextVsync(this);
 }
 
+status_t EventThreadConnection::getVsyncTimeline(gui::VsyncTimeline* outTimeline) {
+    return mEventThread->getVsyncTimeline(outTimeline);
+}
+
 status_t EventThreadConnection::postEvent(const DisplayEventReceiver::Event& event) {
     ssize_t size = DisplayEventReceiver::sendEvents(&mChannel, &event, 1);
     return size < 0 ? status_t(size) : status_t(NO_ERROR);
@@ -169,7 +191,8 @@ EventThread::EventThread(std::unique_ptr<VSyncSource> vsyncSource,
                          InterceptVSyncsCallback interceptVSyncsCallback)
       : mVSyncSource(std::move(vsyncSource)),
         mInterceptVSyncsCallback(std::move(interceptVSyncsCallback)),
-        mThreadName(mVSyncSource->getName()) {
+        mThreadName(mVSyncSource->getName()),
+        mVsyncTimeline(gui::VsyncTimeline::create(mThreadName)) {
     mVSyncSource->setCallback(this);
 
     mThread = std::thread([this]() NO_THREAD_SAFETY_ANALYSIS {
@@ -210,6 +233,11 @@ void EventThread::setPhaseOffset(nsecs_t phaseOffset) {
     mVSyncSource->setPhaseOffset(phaseOffset);
 }
 
+void EventThread::setSfPhaseOffset(nsecs_t sfPhaseOffset) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSfPhaseOffset = sfPhaseOffset;
+}
+
 sp<EventThreadConnection> EventThread::createEventConnection(
         ResyncCallback resyncCallback, ISurfaceComposer::ConfigChanged configChanged) const {
     return new EventThreadConnection(const_cast<EventThread*>(this), std::move(resyncCallback),
@@ -228,6 +256,14 @@ status_t EventThread::registerDisplayEventConnection(const sp<EventThreadConnect
         return ALREADY_EXISTS;
     }
 
+    // Connections that never request VSYNC are otherwise only dropped on hotplug or config events,
+    // so drop the dead ones while the list is being walked anyway.
+    mDisplayEventConnections.erase(std::remove_if(mDisplayEventConnections.begin(),
+                                                  mDisplayEventConnections.end(),
+                                                  [](const wp<EventThreadConnection>& ptr) {
+                                                      return ptr.promote() == nullptr;
+                                                  }),
+                                   mDisplayEventConnections.end());
     mDisplayEventConnections.push_back(connection);
     mCondition.notify_all();
     return NO_ERROR;
@@ -239,6 +275,25 @@ void EventThread::removeDisplayEventConnectionLocked(const wp<EventThreadConnect
     if (it != mDisplayEventConnections.cend()) {
         mDisplayEventConnections.erase(it);
     }
+    it = std::find(mVSyncConnections.cbegin(), mVSyncConnections.cend(), connection);
+    if (it != mVSyncConnections.cend()) {
+        mVSyncConnections.erase(it);
+    }
+}
+
+void EventThread::setVSyncRequestLocked(const sp<EventThreadConnection>& connection,
+                                        VSyncRequest request) {
+    const VSyncRequest previous = connection->vsyncRequest;
+    connection->vsyncRequest = request;
+    if (previous == VSyncRequest::None && request != VSyncRequest::None) {
+        mVSyncConnections.push_back(connection);
+    } else if (previous != VSyncRequest::None && request == VSyncRequest::None) {
+        const auto it = std::find(mVSyncConnections.cbegin(), mVSyncConnections.cend(),
+                                  connection);
+        if (it != mVSyncConnections.cend()) {
+            mVSyncConnections.erase(it);
+        }
+    }
 }
 
 void EventThread::setVsyncRate(uint32_t rate, const sp<EventThreadConnection>& connection) {
@@ -250,7 +305,7 @@ void EventThread::setVsyncRate(uint32_t rate, const sp<EventThreadConnection>& c
 
     const auto request = rate == 0 ? VSyncRequest::None : static_cast<VSyncRequest>(rate);
     if (connection->vsyncRequest != request) {
-        connection->vsyncRequest = request;
+        setVSyncRequestLocked(connection, request);
         mCondition.notify_all();
     }
 }
@@ -263,7 +318,7 @@ void EventThread::requestNextVsync(const sp<EventThreadConnection>& connection)
     std::lock_guard<std::mutex> lock(mMutex);
 
     if (connection->vsyncRequest == VSyncRequest::None) {
-        connection->vsyncRequest = VSyncRequest::Single;
+        setVSyncRequestLocked(connection, VSyncRequest::Single);
         mCondition.notify_all();
     }
 }
@@ -292,9 +347,26 @@ void EventThread::onVSyncEvent(nsecs_t timestamp, nsecs_t expectedVSyncTimestamp
     std::lock_guard<std::mutex> lock(mMutex);
 
     LOG_FATAL_IF(!mVSyncState);
-    mPendingEvents.push_back(makeVSync(mVSyncState->displayId, timestamp, ++mVSyncState->count,
-                                       expectedVSyncTimestamp));
+    const nsecs_t vsyncPeriod = mVSyncSource->getVsyncPeriod();
+    mPendingEvents.push_back(makeVSyncLocked(timestamp, expectedVSyncTimestamp, vsyncPeriod));
     mCondition.notify_all();
+
+    if (mVsyncTimeline) {
+        gui::VsyncTimeline::Snapshot snapshot;
+        snapshot.count = mVSyncState->count;
+        snapshot.timestamp = timestamp;
+        snapshot.expectedVsyncTimestamp = expectedVSyncTimestamp;
+        snapshot.vsyncPeriod = vsyncPeriod;
+        // The predictor models VSYNC as a fixed period from the latest expected one.
+        if (snapshot.vsyncPeriod > 0) {
+            snapshot.predictionCount = gui::VsyncTimeline::kMaxPredictions;
+            for (size_t i = 0; i < snapshot.predictionCount; i++) {
+                snapshot.predictions[i] =
+                        expectedVSyncTimestamp + static_cast<nsecs_t>(i + 1) * snapshot.vsyncPeriod;
+            }
+        }
+        mVsyncTimeline->publish(snapshot);
+    }
 }
 
 void EventThread::onHotplugReceived(PhysicalDisplayId displayId, bool connected) {
@@ -317,6 +389,13 @@ size_t EventThread::getEventThreadConnectionCount() {
     return mDisplayEventConnections.size();
 }
 
+status_t EventThread::getVsyncTimeline(gui::VsyncTimeline* outTimeline) const {
+    if (!mVsyncTimeline) {
+        return NO_INIT;
+    }
+    return mVsyncTimeline->share(outTimeline);
+}
+
 void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
     DisplayEventConsumers consumers;
 
@@ -346,21 +425,50 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
             }
         }
 
-        bool vsyncRequested = false;
-
-        // Find connections that should consume this event.
-        auto it = mDisplayEventConnections.begin();
-        while (it != mDisplayEventConnections.end()) {
-            if (const auto connection = it->promote()) {
-                vsyncRequested |= connection->vsyncRequest != VSyncRequest::None;
+        const bool isVSync =
+                event && event->header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC;
+
+        // Find connections that should consume this event. Other events than VSYNC may concern
+        // every connection, but VSYNC events and the VSYNC state only concern the connections
+        // requesting VSYNC.
+        if (event && !isVSync) {
+            auto it = mDisplayEventConnections.begin();
+            while (it != mDisplayEventConnections.end()) {
+                if (const auto connection = it->promote()) {
+                    if (shouldConsumeEvent(*event, connection)) {
+                        consumers.push_back(connection);
+                    }
+                    ++it;
+                } else {
+                    it = mDisplayEventConnections.erase(it);
+                }
+            }
+        }
 
-                if (event && shouldConsumeEvent(*event, connection)) {
-                    consumers.push_back(connection);
+        bool vsyncRequested = false;
+        auto it = mVSyncConnections.begin();
+        while (it != mVSyncConnections.end()) {
+            const auto connection = it->promote();
+            if (!connection) {
+                const auto dead = std::find(mDisplayEventConnections.cbegin(),
+                                            mDisplayEventConnections.cend(), *it);
+                if (dead != mDisplayEventConnections.cend()) {
+                    mDisplayEventConnections.erase(dead);
                 }
+                it = mVSyncConnections.erase(it);
+                continue;
+            }
 
-                ++it;
+            if (isVSync && shouldConsumeEvent(*event, connection)) {
+                consumers.push_back(connection);
+            }
+
+            // A single VSYNC request is over once consumed.
+            if (connection->vsyncRequest == VSyncRequest::None) {
+                it = mVSyncConnections.erase(it);
             } else {
-                it = mDisplayEventConnections.erase(it);
+                vsyncRequested = true;
+                ++it;
             }
         }
 
@@ -416,13 +524,42 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
                 LOG_FATAL_IF(!mVSyncState);
                 const auto now = systemTime(SYSTEM_TIME_MONOTONIC);
                 const auto expectedVSyncTime = now + timeout.count();
-                mPendingEvents.push_back(makeVSync(mVSyncState->displayId, now,
-                                                   ++mVSyncState->count, expectedVSyncTime));
+                mPendingEvents.push_back(makeVSyncLocked(now, expectedVSyncTime, timeout.count()));
             }
         }
     }
 }
 
+DisplayEventReceiver::Event EventThread::makeVSyncLocked(nsecs_t timestamp,
+                                                         nsecs_t expectedVSyncTimestamp,
+                                                         nsecs_t vsyncPeriod) {
+    // SurfaceFlinger wakes up for the VSYNC at X at X - vsyncPeriod + mSfPhaseOffset, and
+    // latches whatever was queued by then. A frame started now is presented at the first such
+    // VSYNC that SurfaceFlinger has not woken up for yet.
+    nsecs_t expectedPresentTimestamp = expectedVSyncTimestamp;
+    nsecs_t deadlineTimestamp = expectedVSyncTimestamp;
+    if (vsyncPeriod > 0) {
+        deadlineTimestamp = expectedVSyncTimestamp - vsyncPeriod + mSfPhaseOffset;
+        if (deadlineTimestamp < timestamp) {
+            const nsecs_t periods = (timestamp - deadlineTimestamp + vsyncPeriod - 1) / vsyncPeriod;
+            expectedPresentTimestamp += periods * vsyncPeriod;
+            deadlineTimestamp += periods * vsyncPeriod;
+        }
+    }
+
+    return makeVSync(mVSyncState->displayId, timestamp, ++mVSyncState->count,
+                     expectedVSyncTimestamp, expectedPresentTimestamp, deadlineTimestamp);
+}
+
+void EventThread::setFrameRateDividers(FrameRateDividers dividers) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    // A divider of 1 means no throttling, and 0 would never let a VSYNC through.
+    for (auto it = dividers.begin(); it != dividers.end();) {
+        it = it->second > 1 ? std::next(it) : dividers.erase(it);
+    }
+    mFrameRateDividers = std::move(dividers);
+}
+
 bool EventThread::shouldConsumeEvent(const DisplayEventReceiver::Event& event,
                                      const sp<EventThreadConnection>& connection) const {
     switch (event.header.type) {
@@ -434,6 +571,11 @@ bool EventThread::shouldConsumeEvent(const DisplayEventReceiver::Event& event,
         }
 
         case DisplayEventReceiver::DISPLAY_EVENT_VSYNC:
+            // A throttled connection keeps its request until a VSYNC it may get.
+            if (const auto it = mFrameRateDividers.find(connection->mOwnerUid);
+                it != mFrameRateDividers.end() && event.vsync.count % it->second != 0) {
+                return false;
+            }
             switch (connection->vsyncRequest) {
                 case VSyncRequest::None:
                     return false;
@@ -488,6 +630,14 @@ void EventThread::dump(std::string& result) const {
         StringAppendF(&result, "    %s\n", toString(event).c_str());
     }
 
+    if (!mFrameRateDividers.empty()) {
+        StringAppendF(&result, "  frame rate dividers:");
+        for (const auto& [uid, divider] : mFrameRateDividers) {
+            StringAppendF(&result, " {uid=%d, divider=%u}", uid, divider);
+        }
+        StringAppendF(&result, "\n");
+    }
+
     StringAppendF(&result, "  connections (count=%zu):\n", mDisplayEventConnections.size());
     for (const auto& ptr : mDisplayEventConnections) {
         if (const auto connection = ptr.promote()) {
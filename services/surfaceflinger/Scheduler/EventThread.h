@@ -19,6 +19,7 @@
 #include <android-base/thread_annotations.h>
 #include <gui/DisplayEventReceiver.h>
 #include <gui/IDisplayEventConnection.h>
+#include <gui/VsyncTimeline.h>
 #include <private/gui/BitTube.h>
 #include <sys/types.h>
 #include <utils/Errors.h>
@@ -29,6 +30,7 @@
 #include <mutex>
 #include <optional>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "HwcStrongTypes.h"
@@ -67,6 +69,9 @@ public:
     virtual void setCallback(Callback* callback) = 0;
     virtual void setPhaseOffset(nsecs_t phaseOffset) = 0;
 
+    // Returns the current VSYNC period, or 0 if the source doesn't track it.
+    virtual nsecs_t getVsyncPeriod() const { return 0; }
+
     virtual void dump(std::string& result) const = 0;
 };
 
@@ -81,6 +86,7 @@ public:
     status_t stealReceiveChannel(gui::BitTube* outChannel) override;
     status_t setVsyncRate(uint32_t rate) override;
     void requestNextVsync() override; // asynchronous
+    status_t getVsyncTimeline(gui::VsyncTimeline* outTimeline) override;
 
     // Called in response to requestNextVsync.
     const ResyncCallback resyncCallback;
@@ -89,6 +95,9 @@ public:
     const ISurfaceComposer::ConfigChanged mConfigChanged =
             ISurfaceComposer::ConfigChanged::eConfigChangedSuppress;
 
+    // The uid of the process that created this connection.
+    const uid_t mOwnerUid;
+
 private:
     virtual void onFirstRef();
     EventThread* const mEventThread;
@@ -118,6 +127,10 @@ public:
 
     virtual void setPhaseOffset(nsecs_t phaseOffset) = 0;
 
+    // Sets the phase offset SurfaceFlinger wakes up at to latch buffers, which the frame deadline
+    // of VSYNC events is derived from.
+    virtual void setSfPhaseOffset(nsecs_t sfPhaseOffset) = 0;
+
     virtual status_t registerDisplayEventConnection(
             const sp<EventThreadConnection>& connection) = 0;
     virtual void setVsyncRate(uint32_t rate, const sp<EventThreadConnection>& connection) = 0;
@@ -126,6 +139,14 @@ public:
 
     // Retrieves the number of event connections tracked by this EventThread.
     virtual size_t getEventThreadConnectionCount() = 0;
+
+    // Shares the timeline this EventThread publishes every VSYNC to.
+    virtual status_t getVsyncTimeline(gui::VsyncTimeline* outTimeline) const = 0;
+
+    // Throttles the VSYNC events of the connections of some uids: with a divider of 2, they only
+    // get every other VSYNC. Connections of uids without an entry get every VSYNC they ask for.
+    using FrameRateDividers = std::unordered_map<uid_t, uint32_t>;
+    virtual void setFrameRateDividers(FrameRateDividers dividers) = 0;
 };
 
 namespace impl {
@@ -159,8 +180,14 @@ public:
 
     void setPhaseOffset(nsecs_t phaseOffset) override;
 
+    void setSfPhaseOffset(nsecs_t sfPhaseOffset) override;
+
     size_t getEventThreadConnectionCount() override;
 
+    status_t getVsyncTimeline(gui::VsyncTimeline* outTimeline) const override;
+
+    void setFrameRateDividers(FrameRateDividers dividers) override;
+
 private:
     friend EventThreadTest;
 
@@ -176,6 +203,14 @@ private:
     void removeDisplayEventConnectionLocked(const wp<EventThreadConnection>& connection)
             REQUIRES(mMutex);
 
+    // Changes the VSYNC request of a connection, adding it to or removing it from
+    // mVSyncConnections.
+    void setVSyncRequestLocked(const sp<EventThreadConnection>& connection, VSyncRequest request)
+            REQUIRES(mMutex);
+
+    DisplayEventReceiver::Event makeVSyncLocked(nsecs_t timestamp, nsecs_t expectedVSyncTimestamp,
+                                                nsecs_t vsyncPeriod) REQUIRES(mMutex);
+
     // Implements VSyncSource::Callback
     void onVSyncEvent(nsecs_t timestamp, nsecs_t expectedVSyncTimestamp) override;
 
@@ -184,12 +219,22 @@ private:
     const InterceptVSyncsCallback mInterceptVSyncsCallback;
     const char* const mThreadName;
 
+    // Updated on every VSYNC from the VSyncSource, so that clients can read the latest VSYNC and
+    // the predicted next ones without being woken up. Null if the shared memory couldn't be
+    // allocated. Only written with mMutex held.
+    const std::unique_ptr<gui::VsyncTimeline> mVsyncTimeline;
+
     std::thread mThread;
     mutable std::mutex mMutex;
     mutable std::condition_variable mCondition;
 
     std::vector<wp<EventThreadConnection>> mDisplayEventConnections GUARDED_BY(mMutex);
+    // The connections of mDisplayEventConnections whose vsyncRequest is not None, which are the
+    // only ones a VSYNC event needs to visit. Most connections only ask for a VSYNC now and then.
+    std::vector<wp<EventThreadConnection>> mVSyncConnections GUARDED_BY(mMutex);
     std::deque<DisplayEventReceiver::Event> mPendingEvents GUARDED_BY(mMutex);
+    FrameRateDividers mFrameRateDividers GUARDED_BY(mMutex);
+    nsecs_t mSfPhaseOffset GUARDED_BY(mMutex) = 0;
 
     // VSYNC state of connected display.
     struct VSyncState {
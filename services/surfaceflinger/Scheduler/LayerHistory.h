@@ -22,6 +22,7 @@
 
 #include <memory>
 #include <mutex>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -115,17 +116,29 @@ private:
 
     ActiveLayers activeLayers() REQUIRES(mLock) { return {mLayerInfos, mActiveLayersEnd}; }
 
-    // Iterates over layers in a single pass, swapping pairs such that active layers precede
-    // inactive layers, and inactive layers precede expired layers. Removes expired layers by
-    // truncating after inactive layers.
+    // Iterates over active layers, swapping pairs such that active layers precede inactive
+    // layers. Only a few inactive layers are checked for expiry per call, so the cost follows the
+    // number of active layers rather than of all layers.
     void partitionLayers(nsecs_t now) REQUIRES(mLock);
 
+    // The number of inactive layers checked for expiry by each partitionLayers() call.
+    static constexpr size_t kInactiveLayersCheckedPerPartition = 8;
+
+    // Swaps two entries of mLayerInfos, keeping mLayerIndices in sync.
+    void swapLayers(size_t i, size_t j) REQUIRES(mLock);
+    // Removes the entry at i, which must be inactive.
+    void removeInactiveLayer(size_t i) REQUIRES(mLock);
+
     mutable std::mutex mLock;
 
     // Partitioned such that active layers precede inactive layers. For fast lookup, the few active
     // layers are at the front, and weak pointers are stored in contiguous memory to hit the cache.
     LayerInfos mLayerInfos GUARDED_BY(mLock);
     size_t mActiveLayersEnd GUARDED_BY(mLock) = 0;
+    // The index in mLayerInfos of each layer, so recording does not need to search for it.
+    std::unordered_map<const Layer*, size_t> mLayerIndices GUARDED_BY(mLock);
+    // Where the next partitionLayers() call resumes checking inactive layers for expiry.
+    size_t mNextInactiveLayer GUARDED_BY(mLock) = 0;
 
     // Whether to emit systrace output and debug logs.
     const bool mTraceEnabled;
@@ -173,17 +186,29 @@ private:
 
     ActiveLayers activeLayers() REQUIRES(mLock) { return {mLayerInfos, mActiveLayersEnd}; }
 
-    // Iterates over layers in a single pass, swapping pairs such that active layers precede
-    // inactive layers, and inactive layers precede expired layers. Removes expired layers by
-    // truncating after inactive layers.
+    // Iterates over active layers, swapping pairs such that active layers precede inactive
+    // layers. Only a few inactive layers are checked for expiry per call, so the cost follows the
+    // number of active layers rather than of all layers.
     void partitionLayers(nsecs_t now) REQUIRES(mLock);
 
+    // The number of inactive layers checked for expiry by each partitionLayers() call.
+    static constexpr size_t kInactiveLayersCheckedPerPartition = 8;
+
+    // Swaps two entries of mLayerInfos, keeping mLayerIndices in sync.
+    void swapLayers(size_t i, size_t j) REQUIRES(mLock);
+    // Removes the entry at i, which must be inactive.
+    void removeInactiveLayer(size_t i) REQUIRES(mLock);
+
     mutable std::mutex mLock;
 
     // Partitioned such that active layers precede inactive layers. For fast lookup, the few active
     // layers are at the front, and weak pointers are stored in contiguous memory to hit the cache.
     LayerInfos mLayerInfos GUARDED_BY(mLock);
     size_t mActiveLayersEnd GUARDED_BY(mLock) = 0;
+    // The index in mLayerInfos of each layer, so recording does not need to search for it.
+    std::unordered_map<const Layer*, size_t> mLayerIndices GUARDED_BY(mLock);
+    // Where the next partitionLayers() call resumes checking inactive layers for expiry.
+    size_t mNextInactiveLayer GUARDED_BY(mLock) = 0;
 
     uint32_t mDisplayArea = 0;
 
@@ -91,6 +91,13 @@ void LayerHistoryV2::registerLayer(Layer* layer, float /*lowRefreshRate*/, float
     const nsecs_t highRefreshRatePeriod = static_cast<nsecs_t>(1e9f / highRefreshRate);
     auto info = std::make_unique<LayerInfoV2>(layer->getName(), highRefreshRatePeriod, type);
     std::lock_guard lock(mLock);
+
+    // A new layer may get the address of one that expired but was not removed yet.
+    if (const auto it = mLayerIndices.find(layer); it != mLayerIndices.end()) {
+        mLayerInfos[it->second] = {layer, std::move(info)};
+        return;
+    }
+    mLayerIndices.emplace(layer, mLayerInfos.size());
     mLayerInfos.emplace_back(layer, std::move(info));
 }
 
@@ -98,16 +105,16 @@ void LayerHistoryV2::record(Layer* layer, nsecs_t presentTime, nsecs_t now,
                             LayerUpdateType updateType) {
     std::lock_guard lock(mLock);
 
-    const auto it = std::find_if(mLayerInfos.begin(), mLayerInfos.end(),
-                                 [layer](const auto& pair) { return pair.first == layer; });
-    LOG_FATAL_IF(it == mLayerInfos.end(), "%s: unknown layer %p", __FUNCTION__, layer);
+    const auto it = mLayerIndices.find(layer);
+    LOG_FATAL_IF(it == mLayerIndices.end(), "%s: unknown layer %p", __FUNCTION__, layer);
+    const size_t index = it->second;
 
-    const auto& info = it->second;
+    const auto& info = mLayerInfos[index].second;
     info->setLastPresentTime(presentTime, now, updateType, mConfigChangePending);
 
     // Activate layer if inactive.
-    if (const auto end = activeLayers().end(); it >= end) {
-        std::iter_swap(it, end);
+    if (index >= mActiveLayersEnd) {
+        swapLayers(index, mActiveLayersEnd);
         mActiveLayersEnd++;
     }
 }
@@ -144,7 +151,8 @@ LayerHistoryV2::Summary LayerHistoryV2::summarize(nsecs_t now) {
 
         const float layerArea = transformed.getWidth() * transformed.getHeight();
         float weight = mDisplayArea ? layerArea / mDisplayArea : 0.0f;
-        summary.push_back({strong->getName(), type, refreshRate, weight, layerFocused});
+        summary.push_back(
+                {strong->getName(), type, refreshRate, weight, layerFocused, strong->getOwnerUid()});
 
         if (CC_UNLIKELY(mTraceEnabled)) {
             trace(layer, *info, type, static_cast<int>(std::round(refreshRate)));
@@ -190,20 +198,35 @@ void LayerHistoryV2::partitionLayers(nsecs_t now) {
         }
 
         info->onLayerInactive(now);
-        std::swap(mLayerInfos[i], mLayerInfos[--mActiveLayersEnd]);
+        swapLayers(i, --mActiveLayersEnd);
     }
 
-    // Collect expired layers after inactive layers.
-    size_t end = mLayerInfos.size();
-    while (i < end) {
-        if (mLayerInfos[i].first.promote()) {
-            i++;
+    // Remove a few expired inactive layers, picking up where the last call left off.
+    for (size_t checked = 0;
+         checked < kInactiveLayersCheckedPerPartition && mActiveLayersEnd < mLayerInfos.size();
+         checked++) {
+        if (mNextInactiveLayer < mActiveLayersEnd || mNextInactiveLayer >= mLayerInfos.size()) {
+            mNextInactiveLayer = mActiveLayersEnd;
+        }
+        if (mLayerInfos[mNextInactiveLayer].first.promote()) {
+            mNextInactiveLayer++;
         } else {
-            std::swap(mLayerInfos[i], mLayerInfos[--end]);
+            removeInactiveLayer(mNextInactiveLayer);
         }
     }
+}
+
+void LayerHistoryV2::swapLayers(size_t i, size_t j) {
+    if (i == j) return;
+    std::swap(mLayerInfos[i], mLayerInfos[j]);
+    mLayerIndices[mLayerInfos[i].first.unsafe_get()] = i;
+    mLayerIndices[mLayerInfos[j].first.unsafe_get()] = j;
+}
 
-    mLayerInfos.erase(mLayerInfos.begin() + static_cast<long>(end), mLayerInfos.end());
+void LayerHistoryV2::removeInactiveLayer(size_t i) {
+    swapLayers(i, mLayerInfos.size() - 1);
+    mLayerIndices.erase(mLayerInfos.back().first.unsafe_get());
+    mLayerInfos.pop_back();
 }
 
 void LayerHistoryV2::clear() {
@@ -19,10 +19,10 @@
 #include <utils/Timers.h>
 
 #include <chrono>
-#include <deque>
 
 #include "LayerHistory.h"
 #include "RefreshRateConfigs.h"
+#include "RingBuffer.h"
 #include "SchedulerUtils.h"
 
 namespace android {
@@ -177,7 +177,7 @@ private:
 
         const std::string mName;
         mutable std::optional<HeuristicTraceTagData> mHeuristicTraceTagData;
-        std::deque<RefreshRateData> mRefreshRates;
+        RingBuffer<RefreshRateData, HISTORY_SIZE> mRefreshRates;
         static constexpr float MARGIN_FPS = 1.0;
     };
 
@@ -202,10 +202,10 @@ private:
 
     RefreshRateHeuristicData mLastRefreshRate;
 
-    std::deque<FrameTimeData> mFrameTimes;
+    static constexpr size_t HISTORY_SIZE = RefreshRateHistory::HISTORY_SIZE;
+    RingBuffer<FrameTimeData, HISTORY_SIZE> mFrameTimes;
     std::chrono::time_point<std::chrono::steady_clock> mFrameTimeValidSince =
             std::chrono::steady_clock::now();
-    static constexpr size_t HISTORY_SIZE = RefreshRateHistory::HISTORY_SIZE;
     static constexpr std::chrono::nanoseconds HISTORY_DURATION = 1s;
 
     RefreshRateHistory mRefreshRateHistory;
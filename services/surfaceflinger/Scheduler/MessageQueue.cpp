@@ -18,6 +18,7 @@
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wconversion"
 
+#include <android-base/unique_fd.h>
 #include <binder/IPCThreadState.h>
 
 #include <utils/Log.h>
@@ -112,6 +113,39 @@ void MessageQueue::refresh() {
     mHandler->dispatchRefresh();
 }
 
+namespace {
+
+// Owns a duplicate of the fence fd for as long as the looper watches it.
+class FenceSignalCallback : public LooperCallback {
+public:
+    FenceSignalCallback(MessageQueue& queue, base::unique_fd fd)
+          : mQueue(queue), mFd(std::move(fd)) {}
+
+    int handleEvent(int /*fd*/, int /*events*/, void* /*data*/) override {
+        mQueue.invalidate();
+        // Unregisters the fd, dropping the looper's reference to this callback.
+        return 0;
+    }
+
+    int getFd() const { return mFd.get(); }
+
+private:
+    MessageQueue& mQueue;
+    const base::unique_fd mFd;
+};
+
+} // namespace
+
+void MessageQueue::invalidateOnFenceSignal(const sp<Fence>& fence) {
+    base::unique_fd fd(fence->dup());
+    if (fd.get() < 0) {
+        invalidate();
+        return;
+    }
+    sp<FenceSignalCallback> callback = new FenceSignalCallback(*this, std::move(fd));
+    mLooper->addFd(callback->getFd(), 0, Looper::EVENT_INPUT, callback, nullptr);
+}
+
 int MessageQueue::cb_eventReceiver(int fd, int events, void* data) {
     MessageQueue* queue = reinterpret_cast<MessageQueue*>(data);
     return queue->eventReceiver(fd, events);
@@ -27,6 +27,7 @@
 
 #include <gui/IDisplayEventConnection.h>
 #include <private/gui/BitTube.h>
+#include <ui/Fence.h>
 
 #include "EventThread.h"
 
@@ -68,6 +69,8 @@ public:
     virtual void postMessage(sp<MessageHandler>&&) = 0;
     virtual void invalidate() = 0;
     virtual void refresh() = 0;
+    // Invalidates once the fence signals.
+    virtual void invalidateOnFenceSignal(const sp<Fence>& fence) = 0;
 };
 
 // ---------------------------------------------------------------------------
@@ -112,6 +115,8 @@ public:
 
     // sends REFRESH message at next VSYNC
     void refresh() override;
+
+    void invalidateOnFenceSignal(const sp<Fence>& fence) override;
 };
 
 } // namespace impl
@@ -35,6 +35,7 @@ void OneShotTimer::start() {
     {
         std::lock_guard<std::mutex> lock(mMutex);
         mState = TimerState::RESET;
+        mWaiting = false;
     }
     mThread = std::thread(&OneShotTimer::loop, this);
 }
@@ -43,6 +44,7 @@ void OneShotTimer::stop() {
     {
         std::lock_guard<std::mutex> lock(mMutex);
         mState = TimerState::STOPPED;
+        mWaiting = false;
     }
     mCondition.notify_all();
     if (mThread.joinable()) {
@@ -79,17 +81,31 @@ void OneShotTimer::loop() {
                 break;
             }
 
-            auto triggerTime = std::chrono::steady_clock::now() + mInterval;
+            mLastResetTime = std::chrono::steady_clock::now();
+            auto triggerTime = mLastResetTime.load() + mInterval;
             mState = TimerState::WAITING;
+            mWaiting = true;
             while (mState == TimerState::WAITING) {
                 constexpr auto zero = std::chrono::steady_clock::duration::zero();
                 auto waitTime = triggerTime - std::chrono::steady_clock::now();
                 if (waitTime > zero) mCondition.wait_for(mMutex, waitTime);
                 if (mState == TimerState::RESET) {
-                    triggerTime = std::chrono::steady_clock::now() + mInterval;
+                    triggerTime = mLastResetTime.load() + mInterval;
                     mState = TimerState::WAITING;
-                } else if (mState == TimerState::WAITING &&
-                           (triggerTime - std::chrono::steady_clock::now()) <= zero) {
+                    mWaiting = true;
+                    continue;
+                }
+                if (mState != TimerState::WAITING) {
+                    continue;
+                }
+                // Resets since the deadline was computed moved it later. Once mWaiting is
+                // cleared, reset() takes the lock, so only the resets that happened before need
+                // to be accounted for here.
+                mWaiting = false;
+                triggerTime = mLastResetTime.load() + mInterval;
+                if (triggerTime - std::chrono::steady_clock::now() > zero) {
+                    mWaiting = true;
+                } else {
                     triggerTimeout = true;
                     mState = TimerState::IDLE;
                 }
@@ -102,6 +118,10 @@ void OneShotTimer::loop() {
 }
 
 void OneShotTimer::reset() {
+    mLastResetTime = std::chrono::steady_clock::now();
+    if (mWaiting) {
+        return;
+    }
     {
         std::lock_guard<std::mutex> lock(mMutex);
         mState = TimerState::RESET;
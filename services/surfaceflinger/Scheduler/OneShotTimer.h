@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <thread>
@@ -28,6 +29,10 @@ namespace scheduler {
 /*
  * Class that sets off a timer for a given interval, and fires a callback when the
  * interval expires.
+ *
+ * Resetting a timer that is waiting for its interval to expire only records the time of
+ * the reset, without taking the lock or waking up the timer thread, which checks it once
+ * the current deadline is reached.
  */
 class OneShotTimer {
 public:
@@ -82,6 +87,13 @@ private:
     // Current timer state
     TimerState mState GUARDED_BY(mMutex) = TimerState::RESET;
 
+    // Whether the timer thread is waiting for a deadline computed from mLastResetTime, in
+    // which case reset() only needs to update mLastResetTime.
+    std::atomic<bool> mWaiting = false;
+
+    // Time of the latest reset.
+    std::atomic<std::chrono::steady_clock::time_point> mLastResetTime;
+
     // Interval after which timer expires.
     const Interval mInterval;
 
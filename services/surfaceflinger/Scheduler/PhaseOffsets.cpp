@@ -18,6 +18,8 @@
 
 #include <cutils/properties.h>
 
+#include <algorithm>
+#include <array>
 #include <optional>
 
 #include "SurfaceFlingerProperties.h"
@@ -245,29 +247,22 @@ static nsecs_t appDurationToOffset(nsecs_t appDuration, nsecs_t sfDuration, nsec
                             : vsyncDuration - (appDuration + sfDuration) % vsyncDuration;
 }
 
-PhaseDurations::Offsets PhaseDurations::constructOffsets(nsecs_t vsyncDuration) const {
-    return Offsets{
-            {
-                    mSfEarlyDuration < vsyncDuration
-                            ? sfDurationToOffset(mSfEarlyDuration, vsyncDuration)
-                            : sfDurationToOffset(mSfEarlyDuration, vsyncDuration) - vsyncDuration,
-
-                    appDurationToOffset(mAppEarlyDuration, mSfEarlyDuration, vsyncDuration),
-            },
-            {
-                    mSfEarlyGlDuration < vsyncDuration
-                            ? sfDurationToOffset(mSfEarlyGlDuration, vsyncDuration)
-                            : sfDurationToOffset(mSfEarlyGlDuration, vsyncDuration) - vsyncDuration,
+static VSyncModulator::Offsets durationsToOffsets(nsecs_t sfDuration, nsecs_t appDuration,
+                                                  nsecs_t vsyncDuration) {
+    return {
+            sfDuration < vsyncDuration
+                    ? sfDurationToOffset(sfDuration, vsyncDuration)
+                    : sfDurationToOffset(sfDuration, vsyncDuration) - vsyncDuration,
 
-                    appDurationToOffset(mAppEarlyGlDuration, mSfEarlyGlDuration, vsyncDuration),
-            },
-            {
-                    mSfDuration < vsyncDuration
-                            ? sfDurationToOffset(mSfDuration, vsyncDuration)
-                            : sfDurationToOffset(mSfDuration, vsyncDuration) - vsyncDuration,
+            appDurationToOffset(appDuration, sfDuration, vsyncDuration),
+    };
+}
 
-                    appDurationToOffset(mAppDuration, mSfDuration, vsyncDuration),
-            },
+PhaseDurations::Offsets PhaseDurations::constructOffsets(nsecs_t vsyncDuration) const {
+    return Offsets{
+            durationsToOffsets(mSfEarlyDuration, mAppEarlyDuration, vsyncDuration),
+            durationsToOffsets(mSfEarlyGlDuration, mAppEarlyGlDuration, vsyncDuration),
+            durationsToOffsets(mSfDuration, mAppDuration, vsyncDuration),
     };
 }
 
@@ -289,36 +284,75 @@ PhaseDurations::PhaseDurations(const scheduler::RefreshRateConfigs& refreshRateC
                        getProperty("debug.sf.early.sf.duration").value_or(mSfDuration),
                        getProperty("debug.sf.early.app.duration").value_or(mAppDuration),
                        getProperty("debug.sf.earlyGl.sf.duration").value_or(mSfDuration),
-                       getProperty("debug.sf.earlyGl.app.duration").value_or(mAppDuration)) {
+                       getProperty("debug.sf.earlyGl.app.duration").value_or(mAppDuration),
+                       getProperty("debug.sf.late.sf.min_duration")) {
     validateSysprops();
 }
 
 PhaseDurations::PhaseDurations(const std::vector<float>& refreshRates, float currentFps,
                                nsecs_t sfDuration, nsecs_t appDuration, nsecs_t sfEarlyDuration,
                                nsecs_t appEarlyDuration, nsecs_t sfEarlyGlDuration,
-                               nsecs_t appEarlyGlDuration)
+                               nsecs_t appEarlyGlDuration, std::optional<nsecs_t> sfMinDuration)
       : mSfDuration(sfDuration),
         mAppDuration(appDuration),
         mSfEarlyDuration(sfEarlyDuration),
         mAppEarlyDuration(appEarlyDuration),
         mSfEarlyGlDuration(sfEarlyGlDuration),
         mAppEarlyGlDuration(appEarlyGlDuration),
+        mSfMinDuration(sfMinDuration),
         mOffsets(initializeOffsets(refreshRates)),
-        mRefreshRateFps(currentFps) {}
+        mRefreshRateFps(currentFps),
+        mLateSfDuration(sfDuration) {}
+
+bool PhaseDurations::isAdaptive() const {
+    return mSfMinDuration && mSfDuration != -1 && *mSfMinDuration < mSfDuration;
+}
+
+bool PhaseDurations::onFrameComposed(nsecs_t duration) {
+    if (!isAdaptive()) {
+        return false;
+    }
+
+    mFrameDurations.push_back(duration);
+    if (mFrameDurations.size() < kMinFramesForAdaptiveDuration) {
+        return false;
+    }
+
+    std::array<nsecs_t, kFrameDurationHistorySize> durations;
+    const auto end = std::copy(mFrameDurations.begin(), mFrameDurations.end(), durations.begin());
+    const auto percentile = durations.begin() +
+            static_cast<size_t>(kAdaptiveDurationPercentile * (mFrameDurations.size() - 1));
+    std::nth_element(durations.begin(), percentile, end);
+
+    const nsecs_t target =
+            std::clamp(*percentile + kAdaptiveDurationMargin, *mSfMinDuration, mSfDuration);
+    if (std::abs(target - mLateSfDuration) < kAdaptiveDurationHysteresis) {
+        return false;
+    }
+    mLateSfDuration = target;
+    return true;
+}
 
 PhaseOffsets::Offsets PhaseDurations::getOffsetsForRefreshRate(float fps) const {
     const auto iter = std::find_if(mOffsets.begin(), mOffsets.end(), [=](const auto& candidateFps) {
         return fpsEqualsWithMargin(fps, candidateFps.first);
     });
 
+    const nsecs_t vsyncDuration = static_cast<nsecs_t>(1e9f / fps);
+    Offsets offsets;
     if (iter != mOffsets.end()) {
-        return iter->second;
+        offsets = iter->second;
+    } else {
+        // Unknown refresh rate. This might happen if we get a hotplug event for an external
+        // display. In this case just construct the offset.
+        ALOGW("Can't find offset for %.2f fps", fps);
+        offsets = constructOffsets(vsyncDuration);
     }
 
-    // Unknown refresh rate. This might happen if we get a hotplug event for an external display.
-    // In this case just construct the offset.
-    ALOGW("Can't find offset for %.2f fps", fps);
-    return constructOffsets(static_cast<nsecs_t>(1e9f / fps));
+    if (isAdaptive()) {
+        offsets.late = durationsToOffsets(mLateSfDuration, mAppDuration, vsyncDuration);
+    }
+    return offsets;
 }
 
 void PhaseDurations::dump(std::string& result) const {
@@ -336,6 +370,8 @@ void PhaseDurations::dump(std::string& result) const {
                   "  GL early app phase:    %9" PRId64 " ns\tGL early SF phase:    %9" PRId64
                   " ns\n"
                   "  GL early app duration: %9" PRId64 " ns\tGL early SF duration: %9" PRId64
+                  " ns\n"
+                  "  adaptive SF duration:  %9" PRId64 " ns\t  min SF duration:    %9" PRId64
                   " ns\n",
                   late.app,
 
@@ -351,7 +387,9 @@ void PhaseDurations::dump(std::string& result) const {
 
                   earlyGl.sf,
 
-                  mAppEarlyGlDuration, mSfEarlyGlDuration);
+                  mAppEarlyGlDuration, mSfEarlyGlDuration,
+
+                  isAdaptive() ? mLateSfDuration.load() : -1, mSfMinDuration.value_or(-1));
 }
 
 } // namespace impl
@@ -16,9 +16,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <optional>
 #include <unordered_map>
 
 #include "RefreshRateConfigs.h"
+#include "RingBuffer.h"
 #include "VSyncModulator.h"
 
 namespace android::scheduler {
@@ -40,6 +43,10 @@ public:
 
     virtual void setRefreshRateFps(float fps) = 0;
 
+    // Called with how long SurfaceFlinger took to compose a frame while on the late offsets.
+    // Returns true if the offsets changed as a result.
+    virtual bool onFrameComposed(nsecs_t duration) = 0;
+
     virtual void dump(std::string& result) const = 0;
 };
 
@@ -63,6 +70,9 @@ public:
     // refresh rates, to properly update the offsets.
     void setRefreshRateFps(float fps) override { mRefreshRateFps = fps; }
 
+    // The offsets are fixed.
+    bool onFrameComposed(nsecs_t) override { return false; }
+
     // Returns current offsets in human friendly format.
     void dump(std::string& result) const override;
 
@@ -95,6 +105,10 @@ protected:
  * Class that encapsulates the phase offsets for SurfaceFlinger and App.
  * The offsets are calculated from durations for each one of the (late, early, earlyGL)
  * offset types.
+ *
+ * If a minimum late SF duration is set, the late SF duration adapts to how long composition
+ * actually takes, between that minimum and the configured duration, so that SF and apps wake
+ * up as late as they can while SF still makes the present deadline.
  */
 class PhaseDurations : public scheduler::PhaseConfiguration {
 public:
@@ -110,18 +124,32 @@ public:
     // refresh rates, to properly update the offsets.
     void setRefreshRateFps(float fps) override { mRefreshRateFps = fps; }
 
+    bool onFrameComposed(nsecs_t duration) override;
+
     // Returns current offsets in human friendly format.
     void dump(std::string& result) const override;
 
+    // The number of frames the adaptive late SF duration is computed over, and the fewest it
+    // waits for before adapting.
+    static constexpr size_t kFrameDurationHistorySize = 64;
+    static constexpr size_t kMinFramesForAdaptiveDuration = 16;
+    // The adaptive late SF duration covers this fraction of the recent frames, plus a margin.
+    static constexpr float kAdaptiveDurationPercentile = 0.9f;
+    static constexpr nsecs_t kAdaptiveDurationMargin = 1'000'000;
+    // Changes smaller than this are ignored, so that the offsets aren't moved on every frame.
+    static constexpr nsecs_t kAdaptiveDurationHysteresis = 500'000;
+
 protected:
     // Used for unit tests
     PhaseDurations(const std::vector<float>& refreshRates, float currentFps, nsecs_t sfDuration,
                    nsecs_t appDuration, nsecs_t sfEarlyDuration, nsecs_t appEarlyDuration,
-                   nsecs_t sfEarlyGlDuration, nsecs_t appEarlyGlDuration);
+                   nsecs_t sfEarlyGlDuration, nsecs_t appEarlyGlDuration,
+                   std::optional<nsecs_t> sfMinDuration = std::nullopt);
 
 private:
     std::unordered_map<float, Offsets> initializeOffsets(const std::vector<float>&) const;
     PhaseDurations::Offsets constructOffsets(nsecs_t vsyncDuration) const;
+    bool isAdaptive() const;
 
     const nsecs_t mSfDuration;
     const nsecs_t mAppDuration;
@@ -132,9 +160,16 @@ private:
     const nsecs_t mSfEarlyGlDuration;
     const nsecs_t mAppEarlyGlDuration;
 
+    const std::optional<nsecs_t> mSfMinDuration;
+
     const std::unordered_map<float, Offsets> mOffsets;
 
     std::atomic<float> mRefreshRateFps;
+
+    // Only accessed from onFrameComposed().
+    RingBuffer<nsecs_t, kFrameDurationHistorySize> mFrameDurations;
+    // The late SF duration in use, mSfDuration unless adaptive.
+    std::atomic<nsecs_t> mLateSfDuration;
 };
 
 } // namespace impl
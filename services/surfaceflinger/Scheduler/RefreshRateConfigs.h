@@ -206,11 +206,13 @@ public:
         float weight = 0.0f;
         // Whether layer is in focus or not based on WindowManager's state
         bool focused = false;
+        // The uid of the client that owns the layer.
+        uid_t ownerUid = 0;
 
         bool operator==(const LayerRequirement& other) const {
             return name == other.name && vote == other.vote &&
                     desiredRefreshRate == other.desiredRefreshRate && weight == other.weight &&
-                    focused == other.focused;
+                    focused == other.focused && ownerUid == other.ownerUid;
         }
 
         bool operator!=(const LayerRequirement& other) const { return !(*this == other); }
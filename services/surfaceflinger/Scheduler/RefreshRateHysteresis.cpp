@@ -0,0 +1,115 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "RefreshRateHysteresis"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "RefreshRateHysteresis.h"
+
+#include <android-base/stringprintf.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+namespace android::scheduler {
+
+RefreshRateHysteresis::Config RefreshRateHysteresis::choose(nsecs_t now, const Config& current,
+                                                            const Config& proposed) {
+    ATRACE_CALL();
+
+    const nsecs_t windowStart = now - mParams.window;
+    mProposals.push_back({now, proposed.configId});
+    while (mProposals.size() > 1 && mProposals[1].time <= windowStart) {
+        mProposals.pop_front();
+    }
+    while (!mSwitchTimes.empty() && mSwitchTimes.front() <= windowStart) {
+        mSwitchTimes.pop_front();
+    }
+
+    if (proposed.configId == current.configId) {
+        mPendingSwitch = false;
+        return current;
+    }
+
+    Decision decision;
+    decision.time = now;
+    decision.current = current;
+    decision.proposed = proposed;
+    decision.currentSupport = getSupport(now, current.configId);
+    decision.proposedSupport = getSupport(now, proposed.configId);
+    decision.penalty = mParams.switchPenalty * (1 + mSwitchTimes.size());
+    if (proposed.fps > current.fps) {
+        decision.penalty += mParams.upswitchPenalty;
+    }
+    decision.switched = decision.proposedSupport - decision.currentSupport > decision.penalty;
+
+    mDecisions.push_back(decision);
+    if (mDecisions.size() > kMaxDecisions) {
+        mDecisions.pop_front();
+    }
+
+    mPendingSwitch = !decision.switched;
+    if (!decision.switched) {
+        return current;
+    }
+    mSwitchTimes.push_back(now);
+    return proposed;
+}
+
+void RefreshRateHysteresis::reset() {
+    mProposals.clear();
+    mPendingSwitch = false;
+}
+
+float RefreshRateHysteresis::getSupport(nsecs_t now, HwcConfigIndexType configId) const {
+    if (mParams.window <= 0) {
+        return 0;
+    }
+
+    // Each proposal stands until the next one is made.
+    const nsecs_t windowStart = now - mParams.window;
+    nsecs_t duration = 0;
+    for (size_t i = 0; i < mProposals.size(); i++) {
+        if (mProposals[i].configId != configId) {
+            continue;
+        }
+        const nsecs_t start = std::max(mProposals[i].time, windowStart);
+        const nsecs_t end = i + 1 < mProposals.size() ? mProposals[i + 1].time : now;
+        duration += std::max<nsecs_t>(end - start, 0);
+    }
+    return static_cast<float>(duration) / static_cast<float>(mParams.window);
+}
+
+void RefreshRateHysteresis::dump(std::string& result) const {
+    using base::StringAppendF;
+    StringAppendF(&result,
+                  "+  Refresh rate hysteresis: window=%.1fms switchPenalty=%.2f "
+                  "upswitchPenalty=%.2f pending=%s\n",
+                  ns2us(mParams.window) / 1000.f, mParams.switchPenalty, mParams.upswitchPenalty,
+                  mPendingSwitch ? "true" : "false");
+    for (const auto& decision : mDecisions) {
+        StringAppendF(&result,
+                      "   %" PRId64 ": %d (%.2ffps, %.2f) -> %d (%.2ffps, %.2f) penalty=%.2f %s\n",
+                      decision.time, decision.current.configId.value(), decision.current.fps,
+                      decision.currentSupport, decision.proposed.configId.value(),
+                      decision.proposed.fps, decision.proposedSupport, decision.penalty,
+                      decision.switched ? "switched" : "held");
+    }
+}
+
+} // namespace android::scheduler
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/Timers.h>
+
+#include <deque>
+#include <string>
+
+#include "HwcStrongTypes.h"
+
+namespace android::scheduler {
+
+/*
+ * Damps the refresh rate changes proposed from content detection. Instead of
+ * switching as soon as the content votes change, a proposal has to have been
+ * made for a larger share of a recent window than the current config, by a
+ * margin that grows with every switch already made in that window. Short
+ * bursts of content at a different cadence therefore no longer cost a switch
+ * there and another one back.
+ *
+ * The inputs and outcome of every held back or accepted proposal are kept in
+ * a decision log, so a dumped sequence can be fed through choose() again.
+ */
+class RefreshRateHysteresis {
+public:
+    struct Params {
+        // How far back proposals are weighed.
+        nsecs_t window = 0;
+        // The share of the window the proposed config must lead the current
+        // one by before switching, for each switch already in the window.
+        float switchPenalty = 0.2f;
+        // The extra share needed to switch to a higher refresh rate, which
+        // costs more power for as long as it is used.
+        float upswitchPenalty = 0.1f;
+    };
+
+    struct Config {
+        HwcConfigIndexType configId;
+        float fps = 0;
+    };
+
+    struct Decision {
+        nsecs_t time = 0;
+        Config current;
+        Config proposed;
+        // The share of the window each of them was proposed for.
+        float currentSupport = 0;
+        float proposedSupport = 0;
+        float penalty = 0;
+        bool switched = false;
+    };
+
+    // The number of decisions kept in the log.
+    static constexpr size_t kMaxDecisions = 64;
+
+    explicit RefreshRateHysteresis(const Params& params) : mParams(params) {}
+
+    // Returns the config to use at |now|, given that content detection
+    // proposes |proposed| while |current| is in use.
+    Config choose(nsecs_t now, const Config& current, const Config& proposed);
+
+    // Forgets the proposals made so far, for changes that must not be held
+    // back, such as touch boost or the idle timer.
+    void reset();
+
+    // Whether the last proposal was held back, in which case it should be
+    // proposed again even if the content did not change.
+    bool hasPendingSwitch() const { return mPendingSwitch; }
+
+    const std::deque<Decision>& getDecisions() const { return mDecisions; }
+
+    void dump(std::string& result) const;
+
+private:
+    struct Proposal {
+        nsecs_t time;
+        HwcConfigIndexType configId;
+    };
+
+    float getSupport(nsecs_t now, HwcConfigIndexType configId) const;
+
+    const Params mParams;
+    // Oldest first. The first one may have been made before the window.
+    std::deque<Proposal> mProposals;
+    std::deque<nsecs_t> mSwitchTimes;
+    std::deque<Decision> mDecisions;
+    bool mPendingSwitch = false;
+};
+
+} // namespace android::scheduler
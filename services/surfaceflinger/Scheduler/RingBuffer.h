@@ -0,0 +1,112 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+
+namespace android::scheduler {
+
+// A queue of at most N elements in fixed storage. Pushing onto a full buffer
+// drops the oldest element, so recording a sample never allocates.
+template <typename T, size_t N>
+class RingBuffer {
+    static_assert(N > 0);
+
+public:
+    template <typename Buffer, typename Value>
+    class Iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+
+        Iterator(Buffer* buffer, difference_type index) : mBuffer(buffer), mIndex(index) {}
+
+        reference operator*() const { return (*mBuffer)[mIndex]; }
+        pointer operator->() const { return &(*mBuffer)[mIndex]; }
+
+        Iterator& operator++() {
+            mIndex++;
+            return *this;
+        }
+        Iterator operator++(int) { return {mBuffer, mIndex++}; }
+        Iterator& operator--() {
+            mIndex--;
+            return *this;
+        }
+        Iterator operator+(difference_type n) const { return {mBuffer, mIndex + n}; }
+        Iterator operator-(difference_type n) const { return {mBuffer, mIndex - n}; }
+        difference_type operator-(const Iterator& other) const { return mIndex - other.mIndex; }
+
+        bool operator==(const Iterator& other) const { return mIndex == other.mIndex; }
+        bool operator!=(const Iterator& other) const { return mIndex != other.mIndex; }
+        bool operator<(const Iterator& other) const { return mIndex < other.mIndex; }
+
+    private:
+        Buffer* mBuffer;
+        difference_type mIndex;
+    };
+
+    using iterator = Iterator<RingBuffer, T>;
+    using const_iterator = Iterator<const RingBuffer, const T>;
+
+    static constexpr size_t capacity() { return N; }
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+    void push_back(const T& value) {
+        if (mSize == N) {
+            pop_front();
+        }
+        mElements[(mFront + mSize) % N] = value;
+        mSize++;
+    }
+
+    void pop_front() {
+        mFront = (mFront + 1) % N;
+        mSize--;
+    }
+
+    void clear() {
+        mFront = 0;
+        mSize = 0;
+    }
+
+    T& operator[](size_t i) { return mElements[(mFront + i) % N]; }
+    const T& operator[](size_t i) const { return mElements[(mFront + i) % N]; }
+
+    T& front() { return (*this)[0]; }
+    const T& front() const { return (*this)[0]; }
+    T& back() { return (*this)[mSize - 1]; }
+    const T& back() const { return (*this)[mSize - 1]; }
+
+    iterator begin() { return {this, 0}; }
+    iterator end() { return {this, static_cast<std::ptrdiff_t>(mSize)}; }
+    const_iterator begin() const { return {this, 0}; }
+    const_iterator end() const { return {this, static_cast<std::ptrdiff_t>(mSize)}; }
+
+private:
+    std::array<T, N> mElements{};
+    size_t mFront = 0;
+    size_t mSize = 0;
+};
+
+} // namespace android::scheduler
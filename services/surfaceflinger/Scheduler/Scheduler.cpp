@@ -33,6 +33,7 @@
 
 #include <algorithm>
 #include <cinttypes>
+#include <cmath>
 #include <cstdint>
 #include <functional>
 #include <memory>
@@ -116,6 +117,16 @@ Scheduler::Scheduler(impl::EventControlThread::SetVSyncEnabledFunction function,
         mLayerHistory = std::make_unique<scheduler::impl::LayerHistory>();
     }
 
+    mUseFrameRateDividers =
+            mUseContentDetectionV2 && property_get_bool("debug.sf.frame_rate_override", false);
+
+    if (const int millis = property_get_int32("debug.sf.refresh_rate_hysteresis_ms", 0);
+        mUseContentDetectionV2 && millis > 0) {
+        mRefreshRateHysteresis.emplace(scheduler::RefreshRateHysteresis::Params{
+                .window = ms2ns(millis),
+        });
+    }
+
     const int setIdleTimerMs = property_get_int32("debug.sf.set_idle_timer_ms", 0);
 
     if (const auto millis = setIdleTimerMs ? setIdleTimerMs : set_idle_timer_ms(0); millis > 0) {
@@ -233,9 +244,55 @@ void Scheduler::onPrimaryDisplayConfigChanged(ConnectionHandle handle, PhysicalD
     std::lock_guard<std::mutex> lock(mFeatureStateLock);
     // Cache the last reported config for primary display.
     mFeatures.cachedConfigChangedParams = {handle, displayId, configId, vsyncPeriod};
+    if (mUseFrameRateDividers && vsyncPeriod > 0) {
+        updateFrameRateDividers(1e9f / vsyncPeriod);
+    }
     onNonPrimaryDisplayConfigChanged(handle, displayId, configId, vsyncPeriod);
 }
 
+EventThread::FrameRateDividers Scheduler::computeFrameRateDividers(
+        const LayerHistory::Summary& contentRequirements, float displayFps) {
+    using LayerVoteType = scheduler::RefreshRateConfigs::LayerVoteType;
+    // How far the throttled rate may be from the one the layer voted for.
+    constexpr float MARGIN_FPS = 1.0f;
+
+    EventThread::FrameRateDividers dividers;
+    for (const auto& layer : contentRequirements) {
+        uint32_t divider = 1;
+        const bool explicitVote = layer.vote == LayerVoteType::ExplicitDefault ||
+                layer.vote == LayerVoteType::ExplicitExactOrMultiple;
+        if (explicitVote && layer.desiredRefreshRate > 0 && displayFps > 0) {
+            const auto fraction = std::round(displayFps / layer.desiredRefreshRate);
+            if (fraction > 1 &&
+                std::abs(displayFps / fraction - layer.desiredRefreshRate) <= MARGIN_FPS) {
+                divider = static_cast<uint32_t>(fraction);
+            }
+        }
+
+        // Every layer of the uid has to keep up, so the fastest one wins.
+        const auto [it, inserted] = dividers.emplace(layer.ownerUid, divider);
+        if (!inserted) {
+            it->second = std::min(it->second, divider);
+        }
+    }
+
+    for (auto it = dividers.begin(); it != dividers.end();) {
+        it = it->second > 1 ? std::next(it) : dividers.erase(it);
+    }
+    return dividers;
+}
+
+void Scheduler::updateFrameRateDividers(float displayFps) {
+    auto dividers = computeFrameRateDividers(mFeatures.contentRequirements, displayFps);
+    if (dividers == mFrameRateDividers) {
+        return;
+    }
+    mFrameRateDividers = std::move(dividers);
+    for (const auto& [handle, connection] : mConnections) {
+        connection.thread->setFrameRateDividers(mFrameRateDividers);
+    }
+}
+
 void Scheduler::dispatchCachedReportedConfig() {
     const auto configId = *mFeatures.configId;
     const auto vsyncPeriod =
@@ -277,6 +334,12 @@ void Scheduler::setPhaseOffset(ConnectionHandle handle, nsecs_t phaseOffset) {
     mConnections[handle].thread->setPhaseOffset(phaseOffset);
 }
 
+void Scheduler::setSfPhaseOffset(nsecs_t sfPhaseOffset) {
+    for (const auto& [handle, connection] : mConnections) {
+        connection.thread->setSfPhaseOffset(sfPhaseOffset);
+    }
+}
+
 void Scheduler::getDisplayStatInfo(DisplayStatInfo* stats) {
     stats->vsyncTime = mPrimaryDispSync->computeNextRefresh(0, systemTime());
     stats->vsyncPeriod = mPrimaryDispSync->getPeriod();
@@ -467,15 +530,35 @@ void Scheduler::chooseRefreshRateForContent() {
     HwcConfigIndexType newConfigId;
     {
         std::lock_guard<std::mutex> lock(mFeatureStateLock);
-        if (mFeatures.contentRequirements == summary) {
+        // A held back switch is proposed again until it is taken or dropped.
+        if (mFeatures.contentRequirements == summary &&
+            !(mRefreshRateHysteresis && mRefreshRateHysteresis->hasPendingSwitch())) {
             return;
         }
         mFeatures.contentRequirements = summary;
         mFeatures.contentDetectionV1 =
                 !summary.empty() ? ContentDetectionState::On : ContentDetectionState::Off;
+        if (mUseFrameRateDividers) {
+            updateFrameRateDividers(mRefreshRateConfigs.getCurrentRefreshRate().getFps());
+        }
 
         scheduler::RefreshRateConfigs::GlobalSignals consideredSignals;
         newConfigId = calculateRefreshRateConfigIndexType(&consideredSignals);
+        if (mRefreshRateHysteresis && mFeatures.configId) {
+            if (consideredSignals.touch || consideredSignals.idle) {
+                mRefreshRateHysteresis->reset();
+            } else {
+                const auto toConfig = [&](HwcConfigIndexType configId) {
+                    return scheduler::RefreshRateHysteresis::Config{
+                            configId,
+                            mRefreshRateConfigs.getRefreshRateFromConfigId(configId).getFps()};
+                };
+                newConfigId = mRefreshRateHysteresis
+                                      ->choose(systemTime(), toConfig(*mFeatures.configId),
+                                               toConfig(newConfigId))
+                                      .configId;
+            }
+        }
         if (mFeatures.configId == newConfigId) {
             // We don't need to change the config, but we might need to send an event
             // about a config change, since it was suppressed due to a previous idleConsidered
@@ -585,6 +668,12 @@ void Scheduler::dump(std::string& result) const {
                   mTouchTimer ? mTouchTimer->dump().c_str() : states[0]);
     StringAppendF(&result, "+  Use content detection: %s\n\n",
                   sysprop::use_content_detection_for_refresh_rate(false) ? "on" : "off");
+
+    std::lock_guard<std::mutex> lock(mFeatureStateLock);
+    if (mRefreshRateHysteresis) {
+        mRefreshRateHysteresis->dump(result);
+        result.append("\n");
+    }
 }
 
 template <class T>
@@ -34,6 +34,7 @@
 #include "LayerHistory.h"
 #include "OneShotTimer.h"
 #include "RefreshRateConfigs.h"
+#include "RefreshRateHysteresis.h"
 #include "SchedulerUtils.h"
 
 namespace android {
@@ -59,6 +60,8 @@ class IPhaseOffsetControl {
 public:
     virtual ~IPhaseOffsetControl() = default;
     virtual void setPhaseOffset(scheduler::ConnectionHandle, nsecs_t phaseOffset) = 0;
+    // Tells all event threads when SurfaceFlinger wakes up, to derive frame deadlines from.
+    virtual void setSfPhaseOffset(nsecs_t sfPhaseOffset) = 0;
 };
 
 class Scheduler : public IPhaseOffsetControl {
@@ -102,6 +105,7 @@ public:
 
     // Modifies phase offset in the event thread.
     void setPhaseOffset(ConnectionHandle, nsecs_t phaseOffset) override;
+    void setSfPhaseOffset(nsecs_t sfPhaseOffset) override;
 
     void getDisplayStatInfo(DisplayStatInfo* stats);
 
@@ -163,6 +167,11 @@ public:
 
     size_t getEventThreadConnectionCount(ConnectionHandle handle);
 
+    // Returns how much to throttle the VSYNC events of each uid whose layers all voted for an
+    // integer fraction of the display refresh rate. See EventThread::setFrameRateDividers.
+    static EventThread::FrameRateDividers computeFrameRateDividers(
+            const LayerHistory::Summary& contentRequirements, float displayFps);
+
 private:
     friend class TestableScheduler;
 
@@ -205,6 +214,10 @@ private:
 
     void dispatchCachedReportedConfig() REQUIRES(mFeatureStateLock);
 
+    // Sends the frame rate dividers for the given display refresh rate to every EventThread.
+    // Called from SF's main thread.
+    void updateFrameRateDividers(float displayFps) REQUIRES(mFeatureStateLock);
+
     // Stores EventThread associated with a given VSyncSource, and an initial EventThreadConnection.
     struct Connection {
         sp<EventThreadConnection> connection;
@@ -244,7 +257,7 @@ private:
 
     // In order to make sure that the features don't override themselves, we need a state machine
     // to keep track which feature requested the config change.
-    std::mutex mFeatureStateLock;
+    mutable std::mutex mFeatureStateLock;
 
     struct {
         ContentDetectionState contentDetectionV1 = ContentDetectionState::Off;
@@ -268,6 +281,15 @@ private:
         std::optional<ConfigChangedParams> cachedConfigChangedParams;
     } mFeatures GUARDED_BY(mFeatureStateLock);
 
+    // Whether apps that vote for a fraction of the refresh rate only get VSYNC events at that
+    // rate, and the dividers that were last sent for that.
+    bool mUseFrameRateDividers = false;
+    EventThread::FrameRateDividers mFrameRateDividers GUARDED_BY(mFeatureStateLock);
+
+    // Holds back content based refresh rate changes, if enabled.
+    std::optional<scheduler::RefreshRateHysteresis> mRefreshRateHysteresis
+            GUARDED_BY(mFeatureStateLock);
+
     const scheduler::RefreshRateConfigs& mRefreshRateConfigs;
 
     std::mutex mVsyncTimelineLock;
@@ -187,8 +187,30 @@ void VSyncDispatchTimerQueue::setTimer(nsecs_t targetTime, nsecs_t now) {
     mLastTimerSchedule = mTimeKeeper->now();
 }
 
+void VSyncDispatchTimerQueue::dequeue(CallbackToken token,
+                                      VSyncDispatchTimerQueueEntry const& callback) {
+    if (auto const wakeupTime = callback.wakeupTime()) {
+        mWakeupQueue.erase({*wakeupTime, token});
+    }
+}
+
+void VSyncDispatchTimerQueue::enqueue(CallbackToken token,
+                                      VSyncDispatchTimerQueueEntry const& callback) {
+    if (auto const wakeupTime = callback.wakeupTime()) {
+        mWakeupQueue.emplace(*wakeupTime, token);
+    }
+}
+
 void VSyncDispatchTimerQueue::rearmTimer(nsecs_t now) {
-    rearmTimerSkippingUpdateFor(now, mCallbacks.end());
+    for (auto& [token, callback] : mCallbacks) {
+        if (!callback->wakeupTime() && !callback->hasPendingWorkloadUpdate()) {
+            continue;
+        }
+        dequeue(token, *callback);
+        callback->update(mTracker, now);
+        enqueue(token, *callback);
+    }
+    armTimerForNextWakeup(now);
 }
 
 void VSyncDispatchTimerQueue::TraceBuffer::note(std::string_view name, nsecs_t alarmIn,
@@ -203,31 +225,31 @@ void VSyncDispatchTimerQueue::TraceBuffer::note(std::string_view name, nsecs_t a
 
 void VSyncDispatchTimerQueue::rearmTimerSkippingUpdateFor(
         nsecs_t now, CallbackMap::iterator const& skipUpdateIt) {
-    std::optional<nsecs_t> min;
-    std::optional<nsecs_t> targetVsync;
-    std::optional<std::string_view> nextWakeupName;
-    for (auto it = mCallbacks.begin(); it != mCallbacks.end(); it++) {
-        auto& callback = it->second;
-        if (!callback->wakeupTime() && !callback->hasPendingWorkloadUpdate()) {
-            continue;
+    // The other callbacks only need to be up to date once they are the next to wake up. An
+    // update may move a callback later in the queue, so keep going until the next one stays
+    // where it is. Each callback only needs one update, which bounds the iterations.
+    for (size_t i = 0; i < mCallbacks.size() && !mWakeupQueue.empty(); i++) {
+        auto const next = *mWakeupQueue.begin();
+        if (skipUpdateIt != mCallbacks.end() && next.second == skipUpdateIt->first) {
+            break;
         }
-
-        if (it != skipUpdateIt) {
-            callback->update(mTracker, now);
-        }
-        auto const wakeupTime = *callback->wakeupTime();
-        if (!min || (min && *min > wakeupTime)) {
-            nextWakeupName = callback->name();
-            min = wakeupTime;
-            targetVsync = callback->targetVsync();
+        auto& callback = mCallbacks.at(next.second);
+        dequeue(next.second, *callback);
+        callback->update(mTracker, now);
+        enqueue(next.second, *callback);
+        if (*mWakeupQueue.begin() == std::make_pair(*callback->wakeupTime(), next.second)) {
+            break;
         }
     }
+    armTimerForNextWakeup(now);
+}
 
-    if (min && (min < mIntendedWakeupTime)) {
-        if (targetVsync && nextWakeupName) {
-            mTraceBuffer.note(*nextWakeupName, *min - now, *targetVsync - now);
-        }
-        setTimer(*min, now);
+void VSyncDispatchTimerQueue::armTimerForNextWakeup(nsecs_t now) {
+    if (!mWakeupQueue.empty() && mWakeupQueue.begin()->first < mIntendedWakeupTime) {
+        auto const [wakeupTime, token] = *mWakeupQueue.begin();
+        auto const& callback = mCallbacks.at(token);
+        mTraceBuffer.note(callback->name(), wakeupTime - now, *callback->targetVsync() - now);
+        setTimer(wakeupTime, now);
     } else {
         ATRACE_NAME("cancel timer");
         cancelTimer();
@@ -245,19 +267,16 @@ void VSyncDispatchTimerQueue::timerCallback() {
         std::lock_guard<decltype(mMutex)> lk(mMutex);
         auto const now = mTimeKeeper->now();
         mLastTimerCallback = now;
-        for (auto it = mCallbacks.begin(); it != mCallbacks.end(); it++) {
-            auto& callback = it->second;
-            auto const wakeupTime = callback->wakeupTime();
-            if (!wakeupTime) {
-                continue;
-            }
-
-            auto const lagAllowance = std::max(now - mIntendedWakeupTime, static_cast<nsecs_t>(0));
-            if (*wakeupTime < mIntendedWakeupTime + mTimerSlack + lagAllowance) {
-                callback->executing();
-                invocations.emplace_back(
-                        Invocation{callback, *callback->lastExecutedVsyncTarget(), *wakeupTime});
-            }
+        auto const lagAllowance = std::max(now - mIntendedWakeupTime, static_cast<nsecs_t>(0));
+        auto const dispatchBefore = mIntendedWakeupTime + mTimerSlack + lagAllowance;
+        while (!mWakeupQueue.empty() && mWakeupQueue.begin()->first < dispatchBefore) {
+            auto const [wakeupTime, token] = *mWakeupQueue.begin();
+            mWakeupQueue.erase(mWakeupQueue.begin());
+
+            auto& callback = mCallbacks.at(token);
+            callback->executing();
+            invocations.emplace_back(
+                    Invocation{callback, *callback->lastExecutedVsyncTarget(), wakeupTime});
         }
 
         mIntendedWakeupTime = kInvalidTime;
@@ -288,6 +307,7 @@ void VSyncDispatchTimerQueue::unregisterCallback(CallbackToken token) {
         auto it = mCallbacks.find(token);
         if (it != mCallbacks.end()) {
             entry = it->second;
+            dequeue(token, *entry);
             mCallbacks.erase(it);
         }
     }
@@ -318,7 +338,9 @@ ScheduleResult VSyncDispatchTimerQueue::schedule(CallbackToken token, nsecs_t wo
             return ScheduleResult::Scheduled;
         }
 
+        dequeue(token, *callback);
         result = callback->schedule(workDuration, earliestVsync, mTracker, now);
+        enqueue(token, *callback);
         if (result == ScheduleResult::CannotSchedule) {
             return result;
         }
@@ -342,11 +364,12 @@ CancelResult VSyncDispatchTimerQueue::cancel(CallbackToken token) {
 
     auto const wakeupTime = callback->wakeupTime();
     if (wakeupTime) {
+        dequeue(token, *callback);
         callback->disarm();
 
         if (*wakeupTime == mIntendedWakeupTime) {
             mIntendedWakeupTime = kInvalidTime;
-            rearmTimer(mTimeKeeper->now());
+            rearmTimerSkippingUpdateFor(mTimeKeeper->now(), mCallbacks.end());
         }
         return CancelResult::Cancelled;
     }
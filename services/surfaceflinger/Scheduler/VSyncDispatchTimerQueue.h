@@ -21,6 +21,7 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -136,12 +137,24 @@ private:
     using CallbackMap =
             std::unordered_map<CallbackToken, std::shared_ptr<VSyncDispatchTimerQueueEntry>>;
 
+    // The armed callbacks, ordered by wakeup time. Each callback must be taken out of the
+    // queue before its wakeup time changes, and put back in once it is set.
+    using WakeupQueue = std::set<std::pair<nsecs_t, CallbackToken>>;
+
     void timerCallback();
     void setTimer(nsecs_t, nsecs_t) REQUIRES(mMutex);
+    // Updates all the callbacks with the latest vsync information before rearming the timer.
     void rearmTimer(nsecs_t now) REQUIRES(mMutex);
+    // Only updates the callbacks that would be the next to wake up, until the next one is up
+    // to date, and rearms the timer for it.
     void rearmTimerSkippingUpdateFor(nsecs_t now, CallbackMap::iterator const& skipUpdate)
             REQUIRES(mMutex);
+    void armTimerForNextWakeup(nsecs_t now) REQUIRES(mMutex);
     void cancelTimer() REQUIRES(mMutex);
+    void dequeue(CallbackToken token, VSyncDispatchTimerQueueEntry const& callback)
+            REQUIRES(mMutex);
+    void enqueue(CallbackToken token, VSyncDispatchTimerQueueEntry const& callback)
+            REQUIRES(mMutex);
 
     static constexpr nsecs_t kInvalidTime = std::numeric_limits<int64_t>::max();
     std::unique_ptr<TimeKeeper> const mTimeKeeper;
@@ -153,6 +166,7 @@ private:
     size_t mCallbackToken GUARDED_BY(mMutex) = 0;
 
     CallbackMap mCallbacks GUARDED_BY(mMutex);
+    WakeupQueue mWakeupQueue GUARDED_BY(mMutex);
     nsecs_t mIntendedWakeupTime GUARDED_BY(mMutex) = kInvalidTime;
 
     struct TraceBuffer {
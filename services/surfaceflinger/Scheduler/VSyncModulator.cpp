@@ -161,6 +161,7 @@ void VSyncModulator::updateOffsetsLocked() {
 
     mPhaseOffsetControl.setPhaseOffset(mSfConnectionHandle, offsets.sf);
     mPhaseOffsetControl.setPhaseOffset(mAppConnectionHandle, offsets.app);
+    mPhaseOffsetControl.setSfPhaseOffset(offsets.sf);
 
     mOffsets = offsets;
 
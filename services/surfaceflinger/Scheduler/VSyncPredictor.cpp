@@ -36,6 +36,105 @@ using base::StringAppendF;
 
 static auto constexpr kMaxPercent = 100u;
 
+// A sample is only rejected as an outlier if its residual is this many times the median residual,
+// and at least kMinOutlierResidualPercent of the ideal period.
+static constexpr int64_t kOutlierResidualFactor = 4;
+static constexpr int64_t kMinOutlierResidualPercent = 10;
+
+// TODO (b/144707443): its important that there's some precision in the mean of the ordinals
+//                     for the intercept calculation, so scale the ordinals by 1000 to continue
+//                     fixed point calculation. Explore expanding
+//                     scheduler::utils::calculate_mean to have a fixed point fractional part.
+static constexpr int64_t kScalingFactor = 1000;
+
+namespace {
+
+// This is a 'simple linear regression' calculation of Y over X, with Y being the
+// vsync timestamps, and X being the ordinal of vsync count, over the samples marked in |inliers|.
+// The calculated slope is the vsync period.
+// Formula for reference:
+// Sigma_i: means sum over all timestamps.
+// mean(variable): statistical mean of variable.
+// X: snapped ordinal of the timestamp
+// Y: vsync timestamp
+//
+//         Sigma_i( (X_i - mean(X)) * (Y_i - mean(Y) )
+// slope = -------------------------------------------
+//         Sigma_i ( X_i - mean(X) ) ^ 2
+//
+// intercept = mean(Y) - slope * mean(X)
+//
+std::optional<std::tuple<nsecs_t, nsecs_t>> fitLine(const std::vector<nsecs_t>& vsyncTS,
+                                                    const std::vector<nsecs_t>& ordinals,
+                                                    const std::vector<bool>& inliers) {
+    nsecs_t sumTS = 0;
+    nsecs_t sumOrdinal = 0;
+    nsecs_t count = 0;
+    for (auto i = 0u; i < vsyncTS.size(); i++) {
+        if (inliers[i]) {
+            sumTS += vsyncTS[i];
+            sumOrdinal += ordinals[i];
+            count++;
+        }
+    }
+    if (count == 0) {
+        return {};
+    }
+
+    auto const meanTS = sumTS / count;
+    auto const meanOrdinal = sumOrdinal / count;
+
+    auto top = 0ll;
+    auto bottom = 0ll;
+    for (auto i = 0u; i < vsyncTS.size(); i++) {
+        if (inliers[i]) {
+            top += (vsyncTS[i] - meanTS) * (ordinals[i] - meanOrdinal);
+            bottom += (ordinals[i] - meanOrdinal) * (ordinals[i] - meanOrdinal);
+        }
+    }
+
+    if (CC_UNLIKELY(bottom == 0)) {
+        return {};
+    }
+
+    nsecs_t const slope = top * kScalingFactor / bottom;
+    nsecs_t const intercept = meanTS - (slope * meanOrdinal / kScalingFactor);
+    return std::make_tuple(slope, intercept);
+}
+
+// Clears |inliers| for the samples that sit far off the fitted line. Returns whether any was
+// cleared; samples are left alone unless most of them would remain.
+bool rejectOutliers(const std::vector<nsecs_t>& vsyncTS, const std::vector<nsecs_t>& ordinals,
+                    std::tuple<nsecs_t, nsecs_t> model, std::vector<bool>* inliers) {
+    auto const [slope, intercept] = model;
+    std::vector<int64_t> residuals(vsyncTS.size());
+    for (auto i = 0u; i < vsyncTS.size(); i++) {
+        residuals[i] = std::abs(vsyncTS[i] - (slope * ordinals[i] / kScalingFactor + intercept));
+    }
+
+    std::vector<int64_t> sorted = residuals;
+    auto const threshold =
+            std::max(kOutlierResidualFactor * scheduler::calculate_median(&sorted),
+                     slope * kMinOutlierResidualPercent / static_cast<int64_t>(kMaxPercent));
+
+    size_t rejected = 0;
+    for (auto const residual : residuals) {
+        rejected += residual > threshold;
+    }
+    if (rejected == 0 || rejected * 2 >= residuals.size()) {
+        return false;
+    }
+
+    for (auto i = 0u; i < residuals.size(); i++) {
+        if (residuals[i] > threshold) {
+            (*inliers)[i] = false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
 VSyncPredictor::~VSyncPredictor() = default;
 
 VSyncPredictor::VSyncPredictor(nsecs_t idealPeriod, size_t historySize,
@@ -96,38 +195,36 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
         mTimestamps[mLastTimestampIndex] = timestamp;
     }
 
+    auto it = mRateMap.find(mIdealPeriod);
     if (mTimestamps.size() < kMinimumSamplesForPrediction) {
-        mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
+        if (mFittedPeriods.count(mIdealPeriod) == 0) {
+            it->second = {mIdealPeriod, 0};
+            return true;
+        }
+
+        // Keep the slope fitted the last time this period was used, and only find the phase
+        // from the few timestamps collected since.
+        auto const slope = std::get<0>(it->second);
+        auto const oldest_ts = *std::min_element(mTimestamps.begin(), mTimestamps.end());
+        nsecs_t offsets = 0;
+        for (auto const timestamp : mTimestamps) {
+            auto const sinceOldest = timestamp - oldest_ts;
+            offsets += sinceOldest - ((sinceOldest + (slope / 2)) / slope) * slope;
+        }
+        auto const intercept = offsets / static_cast<nsecs_t>(mTimestamps.size());
+
+        traceInt64If("VSP-period", slope);
+        traceInt64If("VSP-intercept", intercept);
+        it->second = {slope, intercept};
         return true;
     }
 
-    // This is a 'simple linear regression' calculation of Y over X, with Y being the
-    // vsync timestamps, and X being the ordinal of vsync count.
-    // The calculated slope is the vsync period.
-    // Formula for reference:
-    // Sigma_i: means sum over all timestamps.
-    // mean(variable): statistical mean of variable.
-    // X: snapped ordinal of the timestamp
-    // Y: vsync timestamp
-    //
-    //         Sigma_i( (X_i - mean(X)) * (Y_i - mean(Y) )
-    // slope = -------------------------------------------
-    //         Sigma_i ( X_i - mean(X) ) ^ 2
-    //
-    // intercept = mean(Y) - slope * mean(X)
-    //
     std::vector<nsecs_t> vsyncTS(mTimestamps.size());
     std::vector<nsecs_t> ordinals(mTimestamps.size());
 
     // normalizing to the oldest timestamp cuts down on error in calculating the intercept.
     auto const oldest_ts = *std::min_element(mTimestamps.begin(), mTimestamps.end());
-    auto it = mRateMap.find(mIdealPeriod);
     auto const currentPeriod = std::get<0>(it->second);
-    // TODO (b/144707443): its important that there's some precision in the mean of the ordinals
-    //                     for the intercept calculation, so scale the ordinals by 1000 to continue
-    //                     fixed point calculation. Explore expanding
-    //                     scheduler::utils::calculate_mean to have a fixed point fractional part.
-    static constexpr int64_t kScalingFactor = 1000;
 
     for (auto i = 0u; i < mTimestamps.size(); i++) {
         traceInt64If("VSP-ts", mTimestamps[i]);
@@ -136,32 +233,31 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
         ordinals[i] = ((vsyncTS[i] + (currentPeriod / 2)) / currentPeriod) * kScalingFactor;
     }
 
-    auto meanTS = scheduler::calculate_mean(vsyncTS);
-    auto meanOrdinal = scheduler::calculate_mean(ordinals);
-    for (auto i = 0; i < vsyncTS.size(); i++) {
-        vsyncTS[i] -= meanTS;
-        ordinals[i] -= meanOrdinal;
-    }
-
-    auto top = 0ll;
-    auto bottom = 0ll;
-    for (auto i = 0; i < vsyncTS.size(); i++) {
-        top += vsyncTS[i] * ordinals[i];
-        bottom += ordinals[i] * ordinals[i];
+    // validate() only compares a timestamp against the previous one, so a sample that is off
+    // the line can still get in, e.g. right after the ring buffer was cleared. A single such
+    // sample pulls the whole least squares fit towards it: drop the samples whose residual is
+    // far larger than the typical one and fit the rest again.
+    std::vector<bool> inliers(mTimestamps.size(), true);
+    auto model = fitLine(vsyncTS, ordinals, inliers);
+    if (model && rejectOutliers(vsyncTS, ordinals, *model, &inliers)) {
+        if (auto const refitted = fitLine(vsyncTS, ordinals, inliers)) {
+            model = refitted;
+        }
     }
 
-    if (CC_UNLIKELY(bottom == 0)) {
+    if (CC_UNLIKELY(!model)) {
         it->second = {mIdealPeriod, 0};
+        mFittedPeriods.erase(mIdealPeriod);
         clearTimestamps();
         return false;
     }
 
-    nsecs_t const anticipatedPeriod = top * kScalingFactor / bottom;
-    nsecs_t const intercept = meanTS - (anticipatedPeriod * meanOrdinal / kScalingFactor);
+    auto const [anticipatedPeriod, intercept] = *model;
 
     auto const percent = std::abs(anticipatedPeriod - mIdealPeriod) * kMaxPercent / mIdealPeriod;
     if (percent >= kOutlierTolerancePercent) {
         it->second = {mIdealPeriod, 0};
+        mFittedPeriods.erase(mIdealPeriod);
         clearTimestamps();
         return false;
     }
@@ -170,6 +266,7 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     traceInt64If("VSP-intercept", intercept);
 
     it->second = {anticipatedPeriod, intercept};
+    mFittedPeriods.insert(mIdealPeriod);
 
     ALOGV("model update ts: %" PRId64 " slope: %" PRId64 " intercept: %" PRId64, timestamp,
           anticipatedPeriod, intercept);
@@ -230,6 +327,7 @@ void VSyncPredictor::setPeriod(nsecs_t period) {
     std::lock_guard<std::mutex> lk(mMutex);
     static constexpr size_t kSizeLimit = 30;
     if (CC_UNLIKELY(mRateMap.size() == kSizeLimit)) {
+        mFittedPeriods.erase(mRateMap.begin()->first);
         mRateMap.erase(mRateMap.begin());
     }
 
@@ -255,14 +353,24 @@ void VSyncPredictor::clearTimestamps() {
     }
 }
 
+size_t VSyncPredictor::minimumSamplesForPrediction() const {
+    // The first timestamp gives the phase, the second confirms it.
+    static constexpr size_t kMinimumSamplesWithFittedModel = 2;
+    if (mFittedPeriods.count(mIdealPeriod) != 0) {
+        return std::min(kMinimumSamplesWithFittedModel, kMinimumSamplesForPrediction);
+    }
+    return kMinimumSamplesForPrediction;
+}
+
 bool VSyncPredictor::needsMoreSamples() const {
     std::lock_guard<std::mutex> lk(mMutex);
-    return mTimestamps.size() < kMinimumSamplesForPrediction;
+    return mTimestamps.size() < minimumSamplesForPrediction();
 }
 
 void VSyncPredictor::resetModel() {
     std::lock_guard<std::mutex> lk(mMutex);
     mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
+    mFittedPeriods.erase(mIdealPeriod);
     clearTimestamps();
 }
 
@@ -272,9 +380,11 @@ void VSyncPredictor::dump(std::string& result) const {
     StringAppendF(&result, "\tRefresh Rate Map:\n");
     for (const auto& [idealPeriod, periodInterceptTuple] : mRateMap) {
         StringAppendF(&result,
-                      "\t\tFor ideal period %.2fms: period = %.2fms, intercept = %" PRId64 "\n",
+                      "\t\tFor ideal period %.2fms: period = %.2fms, intercept = %" PRId64
+                      "%s\n",
                       idealPeriod / 1e6f, std::get<0>(periodInterceptTuple) / 1e6f,
-                      std::get<1>(periodInterceptTuple));
+                      std::get<1>(periodInterceptTuple),
+                      mFittedPeriods.count(idealPeriod) != 0 ? " (fitted)" : "");
     }
 }
 
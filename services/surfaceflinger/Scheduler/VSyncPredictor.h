@@ -19,6 +19,7 @@
 #include <android-base/thread_annotations.h>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "SchedulerUtils.h"
 #include "VSyncTracker.h"
@@ -53,6 +54,8 @@ public:
     void setPeriod(nsecs_t period) final;
 
     /* Query if the model is in need of more samples to make a prediction.
+     * If a model was already fitted for the current period, a couple of samples to find the
+     * phase are enough, as the slope is taken from that model until the ring buffer fills up.
      * \return  True, if model would benefit from more samples, False if not.
      */
     bool needsMoreSamples() const final;
@@ -65,6 +68,7 @@ private:
     VSyncPredictor(VSyncPredictor const&) = delete;
     VSyncPredictor& operator=(VSyncPredictor const&) = delete;
     void clearTimestamps() REQUIRES(mMutex);
+    size_t minimumSamplesForPrediction() const REQUIRES(mMutex);
 
     inline void traceInt64If(const char* name, int64_t value) const;
     bool const mTraceOn;
@@ -83,6 +87,8 @@ private:
     std::optional<nsecs_t> mKnownTimestamp GUARDED_BY(mMutex);
 
     std::unordered_map<nsecs_t, std::tuple<nsecs_t, nsecs_t>> mutable mRateMap GUARDED_BY(mMutex);
+    // The ideal periods in mRateMap whose entry was fitted from vsync timestamps.
+    std::unordered_set<nsecs_t> mFittedPeriods GUARDED_BY(mMutex);
 
     int mLastTimestampIndex GUARDED_BY(mMutex) = 0;
     std::vector<nsecs_t> mTimestamps GUARDED_BY(mMutex);
@@ -266,6 +266,12 @@ nsecs_t VSyncReactor::getPeriod() {
 }
 
 void VSyncReactor::beginResync() {
+    std::lock_guard lk(mMutex);
+    // When resyncing for a new period, the model of the old one is still good and worth keeping
+    // for when that period is used again; the tracker moves to the new one once it is confirmed.
+    if (mPeriodTransitioningTo && *mPeriodTransitioningTo != getPeriod()) {
+        return;
+    }
     mTracker->resetModel();
 }
 
@@ -41,6 +41,7 @@
 #include <compositionengine/LayerFECompositionState.h>
 #include <compositionengine/OutputLayer.h>
 #include <compositionengine/RenderSurface.h>
+#include <compositionengine/impl/ObjectPool.h>
 #include <compositionengine/impl/OutputCompositionState.h>
 #include <configstore/Utils.h>
 #include <cutils/compiler.h>
@@ -71,6 +72,7 @@
 #include <ui/DisplayInfo.h>
 #include <ui/DisplayStatInfo.h>
 #include <ui/DisplayState.h>
+#include <ui/FenceWatcher.h>
 #include <ui/GraphicBufferAllocator.h>
 #include <ui/PixelFormat.h>
 #include <ui/UiConfig.h>
@@ -86,6 +88,7 @@
 #include <cmath>
 #include <cstdint>
 #include <functional>
+#include <map>
 #include <mutex>
 #include <optional>
 #include <unordered_map>
@@ -105,7 +108,9 @@
 #include "EffectLayer.h"
 #include "Effects/Daltonizer.h"
 #include "FrameTracer/FrameTracer.h"
+#include "InputWindowsUpdater.h"
 #include "Layer.h"
+#include "LayerProtoHelper.h"
 #include "LayerVector.h"
 #include "MonitoredProducer.h"
 #include "NativeWindowSurface.h"
@@ -438,6 +443,40 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     property_get("debug.sf.disable_client_composition_cache", value, "0");
     mDisableClientCompositionCache = atoi(value);
 
+    property_get("debug.sf.client_composition_cache_size", value, "0");
+    mClientCompositionCacheSize = static_cast<uint32_t>(atoi(value));
+
+    property_get("debug.sf.parallel_output_composition_state", value, "0");
+    mParallelOutputCompositionState = atoi(value);
+
+    property_get("debug.sf.batch_hwc_validate", value, "0");
+    mBatchHwcValidate = atoi(value);
+
+    property_get("debug.sf.incremental_input_windows", value, "0");
+    mIncrementalInputWindows = atoi(value);
+
+    property_get("debug.sf.incremental_visible_regions", value, "0");
+    mIncrementalVisibleRegions = atoi(value);
+
+    property_get("debug.sf.flatten_static_layers", value, "0");
+    mFlattenStaticLayers = atoi(value);
+
+    property_get("debug.sf.partial_client_composition", value, "0");
+    mPartialClientComposition = atoi(value);
+
+    property_get("debug.sf.forward_single_layer_buffers", value, "0");
+    mForwardSingleLayerBuffers = atoi(value);
+
+    property_get("debug.sf.frame_tracer_sample_interval", value, "0");
+    mFrameTracer->setSampleInterval(static_cast<uint32_t>(std::max(atoi(value), 0)));
+
+    property_get("debug.sf.watch_fences", value, "0");
+    if (atoi(value)) {
+        mFenceWatcher = std::make_shared<FenceWatcher>();
+        mBE.mGlCompositionDoneTimeline.setWatcher(mFenceWatcher);
+        mBE.mDisplayTimeline.setWatcher(mFenceWatcher);
+    }
+
     // We should be reading 'persist.sys.sf.color_saturation' here
     // but since /data may be encrypted, we need to wait until after vold
     // comes online to attempt to read the property. The property is
@@ -629,6 +668,9 @@ void SurfaceFlinger::bootFinished()
             ALOGE("Failed to link to input service");
         } else {
             mInputFlinger = interface_cast<IInputFlinger>(input);
+            if (mIncrementalInputWindows) {
+                mInputWindowsUpdater = std::make_unique<InputWindowsUpdater>(mInputFlinger);
+            }
         }
 
         readPersistentProperties();
@@ -734,6 +776,7 @@ void SurfaceFlinger::init() {
 
     // initialize our drawing state
     mDrawingState = mCurrentState;
+    mDrawingLayersInZOrderDirty = true;
 
     // set initial conditions (e.g. unblank default device)
     initializeDisplays();
@@ -1988,7 +2031,11 @@ void SurfaceFlinger::onMessageInvalidate(nsecs_t expectedVSyncTime) {
     {
         ConditionalLockGuard<std::mutex> lock(mTracingLock, mTracingEnabled);
 
-        refreshNeeded = handleMessageTransaction();
+        {
+            PhaseTimings::ScopedTimer timer(mTimeStats->getPhaseTimings(),
+                                            PhaseTimings::Phase::TransactionFlush);
+            refreshNeeded = handleMessageTransaction();
+        }
         refreshNeeded |= handleMessageInvalidate();
         if (mTracingEnabled) {
             mAddCompositionStateToTrace =
@@ -2065,10 +2112,12 @@ void SurfaceFlinger::onMessageRefresh() {
     for (const auto& [_, display] : displays) {
         refreshArgs.outputs.push_back(display->getCompositionDisplay());
     }
-    mDrawingState.traverseInZOrder([&refreshArgs](Layer* layer) {
+    const auto& drawingLayers = getDrawingLayersInZOrder();
+    refreshArgs.layers.reserve(drawingLayers.size());
+    for (Layer* layer : drawingLayers) {
         if (auto layerFE = layer->getCompositionEngineLayerFE())
             refreshArgs.layers.push_back(layerFE);
-    });
+    }
     refreshArgs.layersWithQueuedFrames.reserve(mLayersWithQueuedFrames.size());
     for (sp<Layer> layer : mLayersWithQueuedFrames) {
         if (auto layerFE = layer->getCompositionEngineLayerFE())
@@ -2085,7 +2134,14 @@ void SurfaceFlinger::onMessageRefresh() {
     refreshArgs.updatingOutputGeometryThisFrame = mVisibleRegionsDirty;
     refreshArgs.updatingGeometryThisFrame = mGeometryInvalid || mVisibleRegionsDirty;
     refreshArgs.blursAreExpensive = mBlursAreExpensive;
+    refreshArgs.parallelOutputCompositionState = mParallelOutputCompositionState;
+    refreshArgs.batchHwcValidate = mBatchHwcValidate;
+    refreshArgs.incrementalVisibleRegions = mIncrementalVisibleRegions;
+    refreshArgs.flattenStaticLayers = mFlattenStaticLayers;
+    refreshArgs.partialClientComposition = mPartialClientComposition;
+    refreshArgs.forwardSingleLayerBuffers = mForwardSingleLayerBuffers;
     refreshArgs.internalDisplayRotationFlags = DisplayDevice::getPrimaryDisplayRotationFlags();
+    refreshArgs.phaseTimings = mTimeStats->getPhaseTimings();
 
     if (CC_UNLIKELY(mDrawingState.colorMatrixChanged)) {
         refreshArgs.colorTransformMatrix = mDrawingState.colorMatrix;
@@ -2106,14 +2162,34 @@ void SurfaceFlinger::onMessageRefresh() {
     const auto presentTime = systemTime();
 
     mCompositionEngine->present(refreshArgs);
-    mTimeStats->recordFrameDuration(mFrameStartTime, systemTime());
+    const nsecs_t frameEndTime = systemTime();
+    mTimeStats->recordFrameDuration(mFrameStartTime, frameEndTime);
+    {
+        DisplayStatInfo stats;
+        mScheduler->getDisplayStatInfo(&stats);
+        mTimeStats->setSfFrameTiming(mExpectedPresentTime, frameEndTime, stats.vsyncPeriod);
+        if (mFrameStartTime > 0) {
+            mPowerAdvisor.reportFrameWorkDuration(frameEndTime - mFrameStartTime,
+                                                  stats.vsyncPeriod);
+        }
+    }
+    // Only frames composed on the late offsets tell how late SF can wake up on them.
+    if (mFrameStartTime > 0 &&
+        mVSyncModulator->getOffsets() == mPhaseConfiguration->getCurrentOffsets().late &&
+        mPhaseConfiguration->onFrameComposed(frameEndTime - mFrameStartTime)) {
+        mVSyncModulator->setPhaseOffsets(mPhaseConfiguration->getCurrentOffsets());
+    }
     // Reset the frame start time now that we've recorded this frame.
     mFrameStartTime = 0;
 
     mScheduler->onDisplayRefreshed(presentTime);
 
     postFrame();
-    postComposition();
+    {
+        PhaseTimings::ScopedTimer timer(refreshArgs.phaseTimings,
+                                        PhaseTimings::Phase::PostComposition);
+        postComposition();
+    }
 
     const bool prevFrameHadDeviceComposition = mHadDeviceComposition;
 
@@ -2154,7 +2230,12 @@ void SurfaceFlinger::onMessageRefresh() {
 
 bool SurfaceFlinger::handleMessageInvalidate() {
     ATRACE_CALL();
-    bool refreshNeeded = handlePageFlip();
+    bool refreshNeeded;
+    {
+        PhaseTimings::ScopedTimer timer(mTimeStats->getPhaseTimings(),
+                                        PhaseTimings::Phase::PageFlip);
+        refreshNeeded = handlePageFlip();
+    }
 
     if (mVisibleRegionsDirty) {
         computeLayerBounds();
@@ -2287,6 +2368,11 @@ void SurfaceFlinger::postComposition()
         mScheduler->addPresentFence(presentFenceTime);
     }
 
+    if (const auto overlay = ON_MAIN_THREAD(mRefreshRateOverlay.get())) {
+        overlay->onPostComposition(systemTime(), presentFenceTime->isValid(),
+                                   mFrameMissedCount);
+    }
+
     const bool isDisplayConnected = display && getHwComposer().isConnected(*display->getId());
 
     if (!hasSyncFramework) {
@@ -2953,17 +3039,23 @@ void SurfaceFlinger::updateInputFlinger() {
 void SurfaceFlinger::updateInputWindowInfo() {
     std::vector<InputWindowInfo> inputHandles;
 
-    mDrawingState.traverseInReverseZOrder([&](Layer* layer) {
+    const auto& drawingLayers = getDrawingLayersInZOrder();
+    for (auto it = drawingLayers.rbegin(); it != drawingLayers.rend(); ++it) {
+        Layer* layer = *it;
         if (layer->needsInputInfo()) {
             // When calculating the screen bounds we ignore the transparent region since it may
             // result in an unwanted offset.
             inputHandles.push_back(layer->fillInputInfo());
         }
-    });
+    }
 
-    mInputFlinger->setInputWindows(inputHandles,
-                                   mInputWindowCommands.syncInputWindows ? mSetInputWindowsListener
-                                                                         : nullptr);
+    const sp<ISetInputWindowsListener> listener =
+            mInputWindowCommands.syncInputWindows ? mSetInputWindowsListener : nullptr;
+    if (mInputWindowsUpdater) {
+        mInputWindowsUpdater->update(std::move(inputHandles), listener);
+    } else {
+        mInputFlinger->setInputWindows(inputHandles, listener);
+    }
 }
 
 void SurfaceFlinger::commitInputWindowCommands() {
@@ -3094,6 +3186,7 @@ void SurfaceFlinger::commitTransactionLocked() {
 
     commitOffscreenLayers();
     mDrawingState.traverse([&](Layer* layer) { layer->updateMirrorInfo(); });
+    mDrawingLayersInZOrderDirty = true;
 }
 
 void SurfaceFlinger::commitOffscreenLayers() {
@@ -3307,15 +3400,28 @@ bool SurfaceFlinger::flushTransactionQueues() {
     {
         Mutex::Autolock _l(mStateLock);
 
+        // Queues blocked on an acquire fence are flushed again once it signals, and are not
+        // polled in between; only those waiting for their desired present time are.
+        mTransactionQueuesNeedPolling = false;
         auto it = mTransactionQueues.begin();
         while (it != mTransactionQueues.end()) {
             auto& [applyToken, transactionQueue] = *it;
 
             while (!transactionQueue.empty()) {
-                const auto& transaction = transactionQueue.front();
+                auto& transaction = transactionQueue.front();
+                if (transaction.blockingFence &&
+                    transaction.blockingFence->getStatus() == Fence::Status::Unsignaled) {
+                    break;
+                }
                 if (!transactionIsReadyToBeApplied(transaction.desiredPresentTime,
-                                                   transaction.states)) {
-                    setTransactionFlags(eTransactionFlushNeeded);
+                                                   transaction.states,
+                                                   &transaction.blockingFence)) {
+                    if (transaction.blockingFence) {
+                        mEventQueue->invalidateOnFenceSignal(transaction.blockingFence);
+                    } else {
+                        mTransactionQueuesNeedPolling = true;
+                        setTransactionFlags(eTransactionFlushNeeded);
+                    }
                     break;
                 }
                 transactions.push_back(transaction);
@@ -3340,12 +3446,16 @@ bool SurfaceFlinger::flushTransactionQueues() {
 }
 
 bool SurfaceFlinger::transactionFlushNeeded() {
-    return !mTransactionQueues.empty();
+    return mTransactionQueuesNeedPolling;
 }
 
 
 bool SurfaceFlinger::transactionIsReadyToBeApplied(int64_t desiredPresentTime,
-                                                   const Vector<ComposerState>& states) {
+                                                   const Vector<ComposerState>& states,
+                                                   sp<Fence>* outBlockingFence) {
+    if (outBlockingFence) {
+        *outBlockingFence = nullptr;
+    }
 
     const nsecs_t expectedPresentTime = mExpectedPresentTime.load();
     // Do not present if the desiredPresentTime has not passed unless it is more than one second
@@ -3361,6 +3471,9 @@ bool SurfaceFlinger::transactionIsReadyToBeApplied(int64_t desiredPresentTime,
             continue;
         }
         if (s.acquireFence && s.acquireFence->getStatus() == Fence::Status::Unsignaled) {
+            if (outBlockingFence) {
+                *outBlockingFence = s.acquireFence;
+            }
             return false;
         }
     }
@@ -4362,6 +4475,7 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args, bool asProto) {
                 {"--list"s, dumper(&SurfaceFlinger::listLayersLocked)},
                 {"--static-screen"s, dumper(&SurfaceFlinger::dumpStaticScreenStats)},
                 {"--timestats"s, protoDumper(&SurfaceFlinger::dumpTimeStats)},
+                {"--timing"s, argsDumper(&SurfaceFlinger::dumpPhaseTimings)},
                 {"--vsync"s, dumper(&SurfaceFlinger::dumpVSync)},
                 {"--wide-color"s, dumper(&SurfaceFlinger::dumpWideColorInfo)},
         };
@@ -4446,6 +4560,18 @@ void SurfaceFlinger::dumpTimeStats(const DumpArgs& args, bool asProto, std::stri
     mTimeStats->parseArgs(asProto, args, result);
 }
 
+void SurfaceFlinger::dumpPhaseTimings(const DumpArgs& args, std::string& result) const {
+    PhaseTimings* phaseTimings = mTimeStats->getPhaseTimings();
+    if (!phaseTimings) {
+        return;
+    }
+    if (args.size() > 1 && args[1] == String16("-clear")) {
+        phaseTimings->clear();
+        return;
+    }
+    phaseTimings->dump(result);
+}
+
 // This should only be called from the main thread.  Otherwise it would need
 // the lock and should use mCurrentState rather than mDrawingState.
 void SurfaceFlinger::logFrameStats() {
@@ -4656,15 +4782,25 @@ void SurfaceFlinger::dumpWideColorInfo(std::string& result) const {
     result.append("\n");
 }
 
-LayersProto SurfaceFlinger::dumpDrawingStateProto(uint32_t traceFlags) const {
+std::vector<LayerProtoSnapshot> SurfaceFlinger::snapshotDrawingStateProto(
+        uint32_t traceFlags) const {
     // If context is SurfaceTracing thread, mTracingLock blocks display transactions on main thread.
     const auto display = ON_MAIN_THREAD(getDefaultDisplayDeviceLocked());
 
-    LayersProto layersProto;
+    std::vector<LayerProtoSnapshot> snapshots;
+    snapshots.reserve(mNumLayers);
     for (const sp<Layer>& layer : mDrawingState.layersSortedByZ) {
-        layer->writeToProto(layersProto, traceFlags, display.get());
+        layer->snapshotForProto(snapshots, traceFlags, display.get());
     }
 
+    return snapshots;
+}
+
+LayersProto SurfaceFlinger::writeLayersProto(const std::vector<LayerProtoSnapshot>& snapshots) {
+    LayersProto layersProto;
+    for (const LayerProtoSnapshot& snapshot : snapshots) {
+        LayerProtoHelper::writeToProto(snapshot, layersProto);
+    }
     return layersProto;
 }
 
@@ -4672,28 +4808,44 @@ void SurfaceFlinger::dumpHwc(std::string& result) const {
     getHwComposer().dump(result);
 }
 
-void SurfaceFlinger::dumpOffscreenLayersProto(LayersProto& layersProto, uint32_t traceFlags) const {
+// The fake root layer the offscreen layers are parented to in the proto output.
+static constexpr int32_t kOffscreenRootLayerId = INT32_MAX - 2;
+
+std::vector<LayerProtoSnapshot> SurfaceFlinger::snapshotOffscreenLayersProto(
+        uint32_t traceFlags) const {
+    std::vector<LayerProtoSnapshot> snapshots;
+    for (Layer* offscreenLayer : mOffscreenLayers) {
+        const size_t index = snapshots.size();
+        offscreenLayer->snapshotForProto(snapshots, traceFlags, nullptr /*device*/);
+        snapshots[index].parent = kOffscreenRootLayerId;
+    }
+    return snapshots;
+}
+
+void SurfaceFlinger::writeOffscreenLayersProto(const std::vector<LayerProtoSnapshot>& snapshots,
+                                               LayersProto& layersProto) {
     // Add a fake invisible root layer to the proto output and parent all the offscreen layers to
     // it.
     LayerProto* rootProto = layersProto.add_layers();
-    const int32_t offscreenRootLayerId = INT32_MAX - 2;
-    rootProto->set_id(offscreenRootLayerId);
+    rootProto->set_id(kOffscreenRootLayerId);
     rootProto->set_name("Offscreen Root");
     rootProto->set_parent(-1);
 
-    for (Layer* offscreenLayer : mOffscreenLayers) {
-        // Add layer as child of the fake root
-        rootProto->add_children(offscreenLayer->sequence);
-
-        // Add layer
-        LayerProto* layerProto =
-                offscreenLayer->writeToProto(layersProto, traceFlags, nullptr /*device*/);
-        layerProto->set_parent(offscreenRootLayerId);
+    for (const LayerProtoSnapshot& snapshot : snapshots) {
+        LayerProto* layerProto = LayerProtoHelper::writeToProto(snapshot, layersProto);
+        if (snapshot.parent == kOffscreenRootLayerId) {
+            // Add layer as child of the fake root
+            rootProto->add_children(snapshot.id);
+            layerProto->set_parent(kOffscreenRootLayerId);
+        }
     }
 }
 
 LayersProto SurfaceFlinger::dumpProtoFromMainThread(uint32_t traceFlags) {
-    return schedule([=] { return dumpDrawingStateProto(traceFlags); }).get();
+    // Only copy the layer state on the main thread, and build the protos from
+    // it here, so that dumping doesn't hold up composition.
+    const auto snapshots = schedule([=] { return snapshotDrawingStateProto(traceFlags); }).get();
+    return writeLayersProto(snapshots);
 }
 
 void SurfaceFlinger::dumpOffscreenLayers(std::string& result) {
@@ -4710,6 +4862,30 @@ void SurfaceFlinger::dumpOffscreenLayers(std::string& result) {
                   }).get());
 }
 
+void SurfaceFlinger::dumpLayerMemoryLocked(std::string& result) const {
+    struct Usage {
+        size_t layers = 0;
+        size_t bytes = 0;
+    };
+    std::map<pid_t, Usage> usageByPid;
+    const auto addUsage = [&](Layer* layer) {
+        auto& usage = usageByPid[layer->getOwnerPid()];
+        usage.layers++;
+        usage.bytes += layer->getHeapUsage();
+    };
+
+    mCurrentState.traverse(addUsage);
+    for (Layer* offscreenLayer : mOffscreenLayers) {
+        offscreenLayer->traverse(LayerVector::StateSet::Drawing, addUsage);
+    }
+
+    result.append("Layer memory by client:\n");
+    for (const auto& [pid, usage] : usageByPid) {
+        StringAppendF(&result, "  pid:%d layers:%zu bytes:%zu\n", pid, usage.layers, usage.bytes);
+    }
+    compositionengine::impl::ObjectPool::dump(result);
+}
+
 void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) const {
     const bool colorize = !args.empty() && args[0] == String16("--color");
     Colorizer colorizer(colorize);
@@ -4758,6 +4934,9 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
 
     dumpBufferingStats(result);
 
+    ClientCache::getInstance().dump(result);
+    result.append("\n");
+
     /*
      * Dump the visible layer list
      */
@@ -4767,6 +4946,8 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
                   mGraphicBufferProducerList.size(), mMaxGraphicBufferProducerListSize);
     colorizer.reset(result);
 
+    dumpLayerMemoryLocked(result);
+
     {
         StringAppendF(&result, "Composition layers\n");
         mDrawingState.traverseInZOrder([&](Layer* layer) {
@@ -4884,6 +5065,9 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
 
     result.append(mTimeStats->miniDump());
     result.append("\n");
+
+    result.append(mFrameTracer->miniDump());
+    result.append("\n");
 }
 
 void SurfaceFlinger::updateColorMatrixLocked() {
@@ -5024,9 +5208,9 @@ status_t SurfaceFlinger::CheckTransactCodeCredentials(uint32_t code) {
         code == IBinder::SYSPROPS_TRANSACTION) {
         return OK;
     }
-    // Numbers from 1000 to 1036 are currently used for backdoors. The code
+    // Numbers from 1000 to 1037 are currently used for backdoors. The code
     // in onTransact verifies that the user is root, and has access to use SF.
-    if (code >= 1000 && code <= 1036) {
+    if (code >= 1000 && code <= 1037) {
         ALOGV("Accessing SurfaceFlinger through backdoor code: %u", code);
         return OK;
     }
@@ -5367,6 +5551,22 @@ status_t SurfaceFlinger::onTransact(uint32_t code, const Parcel& data, Parcel* r
                 }
                 return NO_ERROR;
             }
+            // Set layer tracing mode, applied the next time tracing is enabled:
+            // 0 to keep full entries in the ring buffer, 1 to stream incremental
+            // entries to the trace file.
+            case 1037: {
+                n = data.readInt32();
+                if (n != 0 && n != 1) {
+                    ALOGW("Invalid layer tracing mode: %d", n);
+                    reply->writeInt32(BAD_VALUE);
+                    return BAD_VALUE;
+                }
+                ALOGD("Updating layer tracing mode to %d", n);
+                mTracing.setMode(n ? SurfaceTracing::Mode::Incremental
+                                   : SurfaceTracing::Mode::RingBuffer);
+                reply->writeInt32(NO_ERROR);
+                return NO_ERROR;
+            }
         }
     }
     return err;
@@ -5802,8 +6002,14 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
     const int uid = IPCThreadState::self()->getCallingUid();
     const bool forSystem = uid == AID_GRAPHICS || uid == AID_SYSTEM;
 
+    // When RenderEngine serializes drawing itself, the main thread only gathers what to draw and
+    // the draw is issued from this thread instead.
+    const bool drawOffMainThread = getRenderEngine().canDrawFromAnyThread();
+
     status_t result;
     int syncFd;
+    bool snapshotTaken = false;
+    ScreenCaptureSnapshot snapshot;
 
     do {
         std::tie(result, syncFd) =
@@ -5818,15 +6024,41 @@ status_t SurfaceFlinger::captureScreenCommon(RenderArea& renderArea,
 
                     Mutex::Autolock lock(mStateLock);
                     renderArea.render([&] {
-                        result = captureScreenImplLocked(renderArea, traverseLayers, buffer.get(),
-                                                         useIdentityTransform, forSystem, &fd,
-                                                         regionSampling, outCapturedSecureLayers);
+                        // Content in the protected context must be drawn there, which only the
+                        // main thread may switch out of.
+                        if (!drawOffMainThread || getRenderEngine().isProtected()) {
+                            result = captureScreenImplLocked(renderArea, traverseLayers,
+                                                             buffer.get(), useIdentityTransform,
+                                                             forSystem, &fd, regionSampling,
+                                                             outCapturedSecureLayers);
+                            return;
+                        }
+                        result = checkScreenCaptureSecurityLocked(traverseLayers, forSystem,
+                                                                  outCapturedSecureLayers);
+                        if (result == NO_ERROR) {
+                            snapshotScreenLocked(renderArea, traverseLayers, useIdentityTransform,
+                                                 regionSampling, &snapshot);
+                            snapshotTaken = true;
+                        }
                     });
 
                     return std::make_pair(result, fd);
                 }).get();
     } while (result == EAGAIN);
 
+    if (result == NO_ERROR && snapshotTaken) {
+        result = drawScreenSnapshot(snapshot, buffer.get(), &syncFd);
+        if (result == NO_ERROR && syncFd >= 0) {
+            // The layers learn of the new reader of their buffers on the main thread, and drop
+            // the references held by the snapshot there.
+            static_cast<void>(schedule([this, snapshot = std::move(snapshot),
+                                        fd = dup(syncFd)]() MAIN_THREAD {
+                onScreenSnapshotDrawn(snapshot, fd);
+                close(fd);
+            }));
+        }
+    }
+
     if (result == NO_ERROR) {
         sync_wait(syncFd, -1);
         close(syncFd);
@@ -5841,6 +6073,20 @@ void SurfaceFlinger::renderScreenImplLocked(const RenderArea& renderArea,
                                             bool regionSampling, int* outSyncFd) {
     ATRACE_CALL();
 
+    ScreenCaptureSnapshot snapshot;
+    snapshotScreenLocked(renderArea, traverseLayers, useIdentityTransform, regionSampling,
+                         &snapshot);
+    getRenderEngine().useProtectedContext(false);
+    drawScreenSnapshot(snapshot, buffer, outSyncFd);
+    onScreenSnapshotDrawn(snapshot, *outSyncFd);
+}
+
+void SurfaceFlinger::snapshotScreenLocked(const RenderArea& renderArea,
+                                          TraverseLayersFunction traverseLayers,
+                                          bool useIdentityTransform, bool regionSampling,
+                                          ScreenCaptureSnapshot* outSnapshot) {
+    ATRACE_CALL();
+
     const auto reqWidth = renderArea.getReqWidth();
     const auto reqHeight = renderArea.getReqHeight();
     const auto sourceCrop = renderArea.getSourceCrop();
@@ -5848,8 +6094,9 @@ void SurfaceFlinger::renderScreenImplLocked(const RenderArea& renderArea,
     const auto rotation = renderArea.getRotationFlags();
     const auto& displayViewport = renderArea.getDisplayViewport();
 
-    renderengine::DisplaySettings clientCompositionDisplay;
-    std::vector<compositionengine::LayerFE::LayerSettings> clientCompositionLayers;
+    renderengine::DisplaySettings& clientCompositionDisplay = outSnapshot->displaySettings;
+    std::vector<compositionengine::LayerFE::LayerSettings>& clientCompositionLayers =
+            outSnapshot->layerSettings;
 
     // assume that bounds are never offset, and that they are the same as the
     // buffer bounds.
@@ -5871,7 +6118,6 @@ void SurfaceFlinger::renderScreenImplLocked(const RenderArea& renderArea,
     clientCompositionLayers.push_back(fillLayer);
 
     const auto display = renderArea.getDisplayDevice();
-    std::vector<Layer*> renderedLayers;
     Region clearRegion = Region::INVALID_REGION;
     traverseLayers([&](Layer* layer) {
         const bool supportProtectedContent = false;
@@ -5905,43 +6151,50 @@ void SurfaceFlinger::renderScreenImplLocked(const RenderArea& renderArea,
             clientCompositionLayers.insert(clientCompositionLayers.end(),
                                            std::make_move_iterator(results.begin()),
                                            std::make_move_iterator(results.end()));
-            renderedLayers.push_back(layer);
+            outSnapshot->renderedLayers.push_back(layer);
         }
     });
 
+    clientCompositionDisplay.clearRegion = clearRegion;
+}
+
+status_t SurfaceFlinger::drawScreenSnapshot(const ScreenCaptureSnapshot& snapshot,
+                                            ANativeWindowBuffer* buffer, int* outSyncFd) {
+    ATRACE_CALL();
+
     std::vector<const renderengine::LayerSettings*> clientCompositionLayerPointers(
-            clientCompositionLayers.size());
-    std::transform(clientCompositionLayers.begin(), clientCompositionLayers.end(),
+            snapshot.layerSettings.size());
+    std::transform(snapshot.layerSettings.begin(), snapshot.layerSettings.end(),
                    clientCompositionLayerPointers.begin(),
-                   std::pointer_traits<renderengine::LayerSettings*>::pointer_to);
+                   [](const compositionengine::LayerFE::LayerSettings& settings) {
+                       return &settings;
+                   });
 
-    clientCompositionDisplay.clearRegion = clearRegion;
     // Use an empty fence for the buffer fence, since we just created the buffer so
     // there is no need for synchronization with the GPU.
     base::unique_fd bufferFence;
     base::unique_fd drawFence;
-    getRenderEngine().useProtectedContext(false);
-    getRenderEngine().drawLayers(clientCompositionDisplay, clientCompositionLayerPointers, buffer,
-                                 /*useFramebufferCache=*/false, std::move(bufferFence), &drawFence);
+    const status_t result =
+            getRenderEngine().drawLayers(snapshot.displaySettings, clientCompositionLayerPointers,
+                                         buffer, /*useFramebufferCache=*/false,
+                                         std::move(bufferFence), &drawFence);
 
     *outSyncFd = drawFence.release();
+    return result;
+}
 
-    if (*outSyncFd >= 0) {
-        sp<Fence> releaseFence = new Fence(dup(*outSyncFd));
-        for (auto* layer : renderedLayers) {
+void SurfaceFlinger::onScreenSnapshotDrawn(const ScreenCaptureSnapshot& snapshot, int syncFd) {
+    if (syncFd >= 0) {
+        sp<Fence> releaseFence = new Fence(dup(syncFd));
+        for (const auto& layer : snapshot.renderedLayers) {
             layer->onLayerDisplayed(releaseFence);
         }
     }
 }
 
-status_t SurfaceFlinger::captureScreenImplLocked(const RenderArea& renderArea,
-                                                 TraverseLayersFunction traverseLayers,
-                                                 ANativeWindowBuffer* buffer,
-                                                 bool useIdentityTransform, bool forSystem,
-                                                 int* outSyncFd, bool regionSampling,
-                                                 bool& outCapturedSecureLayers) {
-    ATRACE_CALL();
-
+status_t SurfaceFlinger::checkScreenCaptureSecurityLocked(TraverseLayersFunction traverseLayers,
+                                                          bool forSystem,
+                                                          bool& outCapturedSecureLayers) {
     traverseLayers([&](Layer* layer) {
         outCapturedSecureLayers =
                 outCapturedSecureLayers || (layer->isVisible() && layer->isSecure());
@@ -5954,6 +6207,22 @@ status_t SurfaceFlinger::captureScreenImplLocked(const RenderArea& renderArea,
         ALOGW("FB is protected: PERMISSION_DENIED");
         return PERMISSION_DENIED;
     }
+    return NO_ERROR;
+}
+
+status_t SurfaceFlinger::captureScreenImplLocked(const RenderArea& renderArea,
+                                                 TraverseLayersFunction traverseLayers,
+                                                 ANativeWindowBuffer* buffer,
+                                                 bool useIdentityTransform, bool forSystem,
+                                                 int* outSyncFd, bool regionSampling,
+                                                 bool& outCapturedSecureLayers) {
+    ATRACE_CALL();
+
+    const status_t result =
+            checkScreenCaptureSecurityLocked(traverseLayers, forSystem, outCapturedSecureLayers);
+    if (result != NO_ERROR) {
+        return result;
+    }
     renderScreenImplLocked(renderArea, traverseLayers, buffer, useIdentityTransform, regionSampling,
                            outSyncFd);
     return NO_ERROR;
@@ -5981,24 +6250,29 @@ void SurfaceFlinger::State::traverseInReverseZOrder(const LayerVector::Visitor&
     layersSortedByZ.traverseInReverseZOrder(stateSet, visitor);
 }
 
+const std::vector<Layer*>& SurfaceFlinger::getDrawingLayersInZOrder() {
+    if (mDrawingLayersInZOrderDirty) {
+        ATRACE_CALL();
+        mDrawingLayersInZOrderDirty = false;
+        mDrawingLayersInZOrder.clear();
+        mDrawingState.traverseInZOrder(
+                [&](Layer* layer) { mDrawingLayersInZOrder.push_back(layer); });
+    }
+    return mDrawingLayersInZOrder;
+}
+
 void SurfaceFlinger::traverseLayersInDisplay(const sp<const DisplayDevice>& display,
                                              const LayerVector::Visitor& visitor) {
-    // We loop through the first level of layers without traversing,
-    // as we need to determine which layers belong to the requested display.
-    for (const auto& layer : mDrawingState.layersSortedByZ) {
+    // Relative layers are already placed where Layer::traverseInZOrder puts
+    // them, so each layer only needs checking against the requested display.
+    for (Layer* layer : getDrawingLayersInZOrder()) {
         if (!layer->belongsToDisplay(display->getLayerStack(), false)) {
             continue;
         }
-        // relative layers are traversed in Layer::traverseInZOrder
-        layer->traverseInZOrder(LayerVector::StateSet::Drawing, [&](Layer* layer) {
-            if (!layer->belongsToDisplay(display->getLayerStack(), false)) {
-                return;
-            }
-            if (!layer->isVisible()) {
-                return;
-            }
-            visitor(layer);
-        });
+        if (!layer->isVisible()) {
+            continue;
+        }
+        visitor(layer);
     }
 }
 
@@ -23,6 +23,7 @@
  */
 
 #include <android-base/thread_annotations.h>
+#include <compositionengine/LayerFE.h>
 #include <compositionengine/OutputColorSetting.h>
 #include <cutils/atomic.h>
 #include <cutils/compiler.h>
@@ -36,6 +37,7 @@
 #include <input/ISetInputWindowsListener.h>
 #include <layerproto/LayerProtoHeader.h>
 #include <math/mat4.h>
+#include <renderengine/DisplaySettings.h>
 #include <renderengine/LayerSettings.h>
 #include <serviceutils/PriorityDumper.h>
 #include <system/graphics.h>
@@ -55,6 +57,7 @@
 #include "DisplayHardware/PowerAdvisor.h"
 #include "Effects/Daltonizer.h"
 #include "FrameTracker.h"
+#include "LayerProtoSnapshot.h"
 #include "LayerVector.h"
 #include "Scheduler/RefreshRateConfigs.h"
 #include "Scheduler/RefreshRateStats.h"
@@ -91,6 +94,7 @@ class EventThread;
 class HWComposer;
 class IGraphicBufferProducer;
 class IInputFlinger;
+class InputWindowsUpdater;
 class Layer;
 class MessageBase;
 class RefreshRateOverlay;
@@ -335,6 +339,10 @@ public:
     // If set, disables reusing client composition buffers. This can be set by
     // debug.sf.disable_client_composition_cache
     bool mDisableClientCompositionCache = false;
+    // The number of client composition requests cached per display, or 0 to
+    // fit the number of framebuffers. This can be set by
+    // debug.sf.client_composition_cache_size
+    uint32_t mClientCompositionCacheSize = 0;
 
 private:
     friend class BufferLayer;
@@ -643,8 +651,11 @@ private:
     uint32_t setTransactionFlags(uint32_t flags, Scheduler::TransactionStart transactionStart);
     void commitTransaction() REQUIRES(mStateLock);
     void commitOffscreenLayers();
+    // If the transaction is only waiting on an acquire fence, outBlockingFence is set to
+    // that fence.
     bool transactionIsReadyToBeApplied(int64_t desiredPresentTime,
-                                       const Vector<ComposerState>& states);
+                                       const Vector<ComposerState>& states,
+                                       sp<Fence>* outBlockingFence = nullptr);
     uint32_t setDisplayStateLocked(const DisplayState& s) REQUIRES(mStateLock);
     uint32_t addInputWindowCommands(const InputWindowCommands& inputWindowCommands)
             REQUIRES(mStateLock);
@@ -719,9 +730,25 @@ private:
 
     using TraverseLayersFunction = std::function<void(const LayerVector::Visitor&)>;
 
+    // Everything a screen capture draws, gathered on the main thread so that the drawing itself
+    // can happen elsewhere.
+    struct ScreenCaptureSnapshot {
+        renderengine::DisplaySettings displaySettings;
+        std::vector<compositionengine::LayerFE::LayerSettings> layerSettings;
+        std::vector<sp<Layer>> renderedLayers;
+    };
+
     void renderScreenImplLocked(const RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                 ANativeWindowBuffer* buffer, bool useIdentityTransform,
                                 bool regionSampling, int* outSyncFd);
+    void snapshotScreenLocked(const RenderArea& renderArea, TraverseLayersFunction traverseLayers,
+                              bool useIdentityTransform, bool regionSampling,
+                              ScreenCaptureSnapshot* outSnapshot);
+    // Can be called from any thread when RenderEngine::canDrawFromAnyThread() is true.
+    status_t drawScreenSnapshot(const ScreenCaptureSnapshot& snapshot, ANativeWindowBuffer* buffer,
+                                int* outSyncFd);
+    // Can only be called from the main thread.
+    void onScreenSnapshotDrawn(const ScreenCaptureSnapshot& snapshot, int syncFd);
     status_t captureScreenCommon(RenderArea& renderArea, TraverseLayersFunction traverseLayers,
                                  sp<GraphicBuffer>* outBuffer, const ui::PixelFormat reqPixelFormat,
                                  bool useIdentityTransform, bool& outCapturedSecureLayers);
@@ -735,8 +762,12 @@ private:
                                      ANativeWindowBuffer* buffer, bool useIdentityTransform,
                                      bool forSystem, int* outSyncFd, bool regionSampling,
                                      bool& outCapturedSecureLayers);
+    status_t checkScreenCaptureSecurityLocked(TraverseLayersFunction traverseLayers,
+                                              bool forSystem, bool& outCapturedSecureLayers);
     void traverseLayersInDisplay(const sp<const DisplayDevice>& display,
                                  const LayerVector::Visitor& visitor);
+    // Can only be called from the main thread.
+    const std::vector<Layer*>& getDrawingLayersInZOrder();
 
 
     bool canAllocateHwcDisplayIdForVDS(uint64_t usage);
@@ -949,6 +980,7 @@ private:
     void dumpStatsLocked(const DumpArgs& args, std::string& result) const REQUIRES(mStateLock);
     void clearStatsLocked(const DumpArgs& args, std::string& result);
     void dumpTimeStats(const DumpArgs& args, bool asProto, std::string& result) const;
+    void dumpPhaseTimings(const DumpArgs& args, std::string& result) const;
     void logFrameStats();
 
     void dumpVSync(std::string& result) const REQUIRES(mStateLock);
@@ -959,12 +991,20 @@ private:
     void recordBufferingStats(const std::string& layerName,
                               std::vector<OccupancyTracker::Segment>&& history);
     void dumpBufferingStats(std::string& result) const;
+    void dumpLayerMemoryLocked(std::string& result) const REQUIRES(mStateLock);
     void dumpDisplayIdentificationData(std::string& result) const REQUIRES(mStateLock);
     void dumpRawDisplayIdentificationData(const DumpArgs&, std::string& result) const;
     void dumpWideColorInfo(std::string& result) const REQUIRES(mStateLock);
-    LayersProto dumpDrawingStateProto(uint32_t traceFlags) const;
-    void dumpOffscreenLayersProto(LayersProto& layersProto,
-                                  uint32_t traceFlags = SurfaceTracing::TRACE_ALL) const;
+    // Capture the drawing state of the layers, or of the offscreen layers, for
+    // writeLayersProto or writeOffscreenLayersProto to write to LayersProto.
+    // These should be called in the main or tracing thread, unlike the writes,
+    // which may happen on any thread.
+    std::vector<LayerProtoSnapshot> snapshotDrawingStateProto(uint32_t traceFlags) const;
+    std::vector<LayerProtoSnapshot> snapshotOffscreenLayersProto(
+            uint32_t traceFlags = SurfaceTracing::TRACE_ALL) const;
+    static LayersProto writeLayersProto(const std::vector<LayerProtoSnapshot>& snapshots);
+    static void writeOffscreenLayersProto(const std::vector<LayerProtoSnapshot>& snapshots,
+                                          LayersProto& layersProto);
     // Dumps state from HW Composer
     void dumpHwc(std::string& result) const;
     LayersProto dumpProtoFromMainThread(uint32_t traceFlags = SurfaceTracing::TRACE_ALL)
@@ -1036,6 +1076,12 @@ private:
     // Can only accessed from the main thread, these members
     // don't need synchronization
     State mDrawingState{LayerVector::StateSet::Drawing};
+    // mDrawingState flattened in Z order, so the passes over every layer each
+    // frame walk a contiguous array rather than the layer tree. Rebuilt on
+    // first use after the drawing state is committed; until then the drawing
+    // state keeps every layer in it alive.
+    std::vector<Layer*> mDrawingLayersInZOrder;
+    bool mDrawingLayersInZOrderDirty = true;
     bool mVisibleRegionsDirty = false;
     // Set during transaction commit stage to track if the input info for a layer has changed.
     bool mInputInfoChanged = false;
@@ -1101,6 +1147,20 @@ private:
     std::atomic<bool> mDisableBlurs = false;
     // If blurs are considered expensive and should require high GPU frequency.
     bool mBlursAreExpensive = false;
+    // If the layer composition state of each display is computed in parallel.
+    bool mParallelOutputCompositionState = false;
+    // If the displays that need it are validated by the HWC in one submission.
+    bool mBatchHwcValidate = false;
+    // If visible regions are only recomputed from the first changed layer down.
+    bool mIncrementalVisibleRegions = false;
+    // If layers that have stopped changing are composited into one HWC layer.
+    bool mFlattenStaticLayers = false;
+    // If client composition only redraws what changed since the buffer age.
+    bool mPartialClientComposition = false;
+    // If virtual displays showing a single full screen layer pass its buffer on.
+    bool mForwardSingleLayerBuffers = false;
+    // Records fence signal times for the timelines, if enabled.
+    std::shared_ptr<FenceWatcher> mFenceWatcher;
     std::atomic<uint32_t> mFrameMissedCount = 0;
     std::atomic<uint32_t> mHwcFrameMissedCount = 0;
     std::atomic<uint32_t> mGpuFrameMissedCount = 0;
@@ -1154,8 +1214,14 @@ private:
         bool privileged;
         bool hasListenerCallbacks;
         std::vector<ListenerCallbacks> listenerCallbacks;
+        // The acquire fence the transaction was last found waiting on. A flush is scheduled for
+        // when it signals, and until then the transaction is not checked again.
+        sp<Fence> blockingFence;
     };
     std::unordered_map<sp<IBinder>, std::queue<TransactionState>, IListenerHash> mTransactionQueues;
+    // Whether a queued transaction is waiting on its desired present time, and so needs to be
+    // checked again every frame rather than when a fence signals.
+    bool mTransactionQueuesNeedPolling = false;
 
     /* ------------------------------------------------------------------------
      * Feature prototyping
@@ -1256,6 +1322,10 @@ private:
     const float mEmulatedDisplayDensity;
 
     sp<IInputFlinger> mInputFlinger;
+    // If set, sends only the input windows that changed, from its own thread.
+    std::unique_ptr<InputWindowsUpdater> mInputWindowsUpdater;
+    // If input windows are sent through mInputWindowsUpdater.
+    bool mIncrementalInputWindows = false;
     InputWindowCommands mPendingInputWindowCommands GUARDED_BY(mStateLock);
     // Should only be accessed by the main thread.
     InputWindowCommands mInputWindowCommands;
@@ -25,6 +25,8 @@
 #include "SurfaceFlinger.h"
 #include "SurfaceInterceptor.h"
 
+#include <pthread.h>
+
 #include <fstream>
 
 #include <android-base/file.h>
@@ -45,6 +47,10 @@ SurfaceInterceptor::SurfaceInterceptor(SurfaceFlinger* flinger)
 {
 }
 
+SurfaceInterceptor::~SurfaceInterceptor() {
+    stopThread();
+}
+
 void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
         const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays)
 {
@@ -52,10 +58,19 @@ void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
         return;
     }
     ATRACE_CALL();
+    {
+        std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+        saveExistingDisplaysLocked(displays);
+        saveExistingSurfacesLocked(layers);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        mPendingIncrements.clear();
+        mStopThread = false;
+    }
+    mThread = std::thread(&SurfaceInterceptor::threadMain, this);
+    pthread_setname_np(mThread.native_handle(), "SurfaceInterceptor");
     mEnabled = true;
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    saveExistingDisplaysLocked(displays);
-    saveExistingSurfacesLocked(layers);
 }
 
 void SurfaceInterceptor::disable() {
@@ -63,8 +78,10 @@ void SurfaceInterceptor::disable() {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     mEnabled = false;
+    // Encodes whatever is still queued before the trace is written out.
+    stopThread();
+    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
     status_t err(writeProtoFileLocked());
     ALOGE_IF(err == PERMISSION_DENIED, "Could not save the proto file! Permission denied");
     ALOGE_IF(err == NOT_ENOUGH_DATA, "Could not save the proto file! There are missing fields");
@@ -75,6 +92,49 @@ bool SurfaceInterceptor::isEnabled() {
     return mEnabled;
 }
 
+void SurfaceInterceptor::queueIncrement(IncrementEncoder&& encode) {
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        mPendingIncrements.push_back({elapsedRealtimeNano(), std::move(encode)});
+    }
+    mQueueCondition.notify_one();
+}
+
+void SurfaceInterceptor::threadMain() {
+    std::vector<PendingIncrement> increments;
+    std::unique_lock<std::mutex> lock(mQueueMutex);
+    while (true) {
+        mQueueCondition.wait(lock, [this] { return mStopThread || !mPendingIncrements.empty(); });
+        if (mPendingIncrements.empty()) {
+            return;
+        }
+        increments.swap(mPendingIncrements);
+        lock.unlock();
+        {
+            ATRACE_NAME("SurfaceInterceptor encode");
+            std::lock_guard<std::mutex> protoGuard(mTraceMutex);
+            for (auto& pending : increments) {
+                Increment* increment(mTrace.add_increment());
+                increment->set_time_stamp(pending.timestamp);
+                pending.encode(increment);
+            }
+        }
+        increments.clear();
+        lock.lock();
+    }
+}
+
+void SurfaceInterceptor::stopThread() {
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        mStopThread = true;
+    }
+    mQueueCondition.notify_one();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
 void SurfaceInterceptor::saveExistingDisplaysLocked(
         const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays)
 {
@@ -90,7 +150,9 @@ void SurfaceInterceptor::saveExistingSurfacesLocked(const SortedVector<sp<Layer>
     ATRACE_CALL();
     for (const auto& l : layers) {
         l->traverseInZOrder(LayerVector::StateSet::Drawing, [this](Layer* layer) {
-            addSurfaceCreationLocked(createTraceIncrementLocked(), layer);
+            addSurfaceCreationLocked(createTraceIncrementLocked(), getLayerId(layer),
+                                     layer->getName(), layer->mCurrentState.active_legacy.w,
+                                     layer->mCurrentState.active_legacy.h);
             addInitialSurfaceStateLocked(createTraceIncrementLocked(), layer);
         });
     }
@@ -117,7 +179,7 @@ void SurfaceInterceptor::addInitialSurfaceStateLocked(Increment* increment,
     addBackgroundBlurRadiusLocked(transaction, layerId, layer->mCurrentState.backgroundBlurRadius);
     if (layer->mCurrentState.barrierLayer_legacy != nullptr) {
         addDeferTransactionLocked(transaction, layerId,
-                                  layer->mCurrentState.barrierLayer_legacy.promote(),
+                                  getLayerIdFromWeakRef(layer->mCurrentState.barrierLayer_legacy),
                                   layer->mCurrentState.frameNumber_legacy);
     }
     addOverrideScalingModeLocked(transaction, layerId, layer->getEffectiveScalingMode());
@@ -331,16 +393,16 @@ void SurfaceInterceptor::addBackgroundBlurRadiusLocked(Transaction* transaction,
 }
 
 void SurfaceInterceptor::addDeferTransactionLocked(Transaction* transaction, int32_t layerId,
-        const sp<const Layer>& layer, uint64_t frameNumber)
+        int32_t barrierLayerId, uint64_t frameNumber)
 {
     SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
-    if (layer == nullptr) {
+    if (barrierLayerId < 0) {
         ALOGE("An existing layer could not be retrieved with the handle"
                 " for the deferred transaction");
         return;
     }
     DeferredTransactionChange* deferTransaction(change->mutable_deferred_transaction());
-    deferTransaction->set_layer_id(getLayerId(layer));
+    deferTransaction->set_layer_id(barrierLayerId);
     deferTransaction->set_frame_number(frameNumber);
 }
 
@@ -388,17 +450,68 @@ void SurfaceInterceptor::addShadowRadiusLocked(Transaction* transaction, int32_t
     overrideChange->set_radius(shadowRadius);
 }
 
-void SurfaceInterceptor::addSurfaceChangesLocked(Transaction* transaction,
-        const layer_state_t& state)
-{
+bool SurfaceInterceptor::captureSurfaceChange(const layer_state_t& state,
+                                              SurfaceChangeSnapshot* snapshot) const {
     const sp<const Layer> layer(getLayer(state.surface));
     if (layer == nullptr) {
         ALOGE("An existing layer could not be retrieved with the surface "
                 "from the layer_state_t surface in the update transaction");
-        return;
+        return false;
+    }
+
+    snapshot->layerId = getLayerId(layer);
+    snapshot->what = state.what;
+    snapshot->x = state.x;
+    snapshot->y = state.y;
+    snapshot->z = state.z;
+    snapshot->w = state.w;
+    snapshot->h = state.h;
+    snapshot->alpha = state.alpha;
+    snapshot->matrix = state.matrix;
+    if (state.what & layer_state_t::eTransparentRegionChanged) {
+        snapshot->transparentRegion = state.transparentRegion;
+    }
+    snapshot->flags = state.flags;
+    snapshot->mask = state.mask;
+    snapshot->layerStack = state.layerStack;
+    snapshot->crop = state.crop_legacy;
+    snapshot->cornerRadius = state.cornerRadius;
+    snapshot->backgroundBlurRadius = state.backgroundBlurRadius;
+    snapshot->barrierFrameNumber = state.frameNumber_legacy;
+    snapshot->overrideScalingMode = state.overrideScalingMode;
+    snapshot->shadowRadius = state.shadowRadius;
+
+    // Handles are only resolved here, while the layers they refer to are
+    // known to still be alive.
+    if (state.what & layer_state_t::eDeferTransaction_legacy) {
+        if (state.barrierHandle_legacy != nullptr) {
+            snapshot->barrierLayerId = getLayerIdFromHandle(state.barrierHandle_legacy);
+        } else if (state.barrierGbp_legacy != nullptr) {
+            auto const& gbp = state.barrierGbp_legacy;
+            if (mFlinger->authenticateSurfaceTextureLocked(gbp)) {
+                const sp<Layer> barrier((static_cast<MonitoredProducer*>(gbp.get()))->getLayer());
+                snapshot->barrierLayerId = barrier == nullptr ? -1 : getLayerId(barrier);
+            } else {
+                ALOGE("Attempt to defer transaction to to an unrecognized GraphicBufferProducer");
+            }
+        }
+    }
+    if (state.what & layer_state_t::eReparent) {
+        snapshot->parentId = getLayerIdFromHandle(state.parentHandleForChild);
+    }
+    if (state.what & layer_state_t::eReparentChildren) {
+        snapshot->reparentChildrenId = getLayerIdFromHandle(state.reparentHandle);
     }
+    if (state.what & layer_state_t::eRelativeLayerChanged) {
+        snapshot->relativeParentId = getLayerIdFromHandle(state.relativeLayerHandle);
+    }
+    return true;
+}
 
-    const int32_t layerId(getLayerId(layer));
+void SurfaceInterceptor::addSurfaceChangesLocked(Transaction* transaction,
+        const SurfaceChangeSnapshot& state)
+{
+    const int32_t layerId(state.layerId);
 
     if (state.what & layer_state_t::ePositionChanged) {
         addPositionLocked(transaction, layerId, state.x, state.y);
@@ -425,7 +538,7 @@ void SurfaceInterceptor::addSurfaceChangesLocked(Transaction* transaction,
         addLayerStackLocked(transaction, layerId, state.layerStack);
     }
     if (state.what & layer_state_t::eCropChanged_legacy) {
-        addCropLocked(transaction, layerId, state.crop_legacy);
+        addCropLocked(transaction, layerId, state.crop);
     }
     if (state.what & layer_state_t::eCornerRadiusChanged) {
         addCornerRadiusLocked(transaction, layerId, state.cornerRadius);
@@ -434,35 +547,23 @@ void SurfaceInterceptor::addSurfaceChangesLocked(Transaction* transaction,
         addBackgroundBlurRadiusLocked(transaction, layerId, state.backgroundBlurRadius);
     }
     if (state.what & layer_state_t::eDeferTransaction_legacy) {
-        sp<Layer> otherLayer = nullptr;
-        if (state.barrierHandle_legacy != nullptr) {
-            otherLayer =
-                    static_cast<Layer::Handle*>(state.barrierHandle_legacy.get())->owner.promote();
-        } else if (state.barrierGbp_legacy != nullptr) {
-            auto const& gbp = state.barrierGbp_legacy;
-            if (mFlinger->authenticateSurfaceTextureLocked(gbp)) {
-                otherLayer = (static_cast<MonitoredProducer*>(gbp.get()))->getLayer();
-            } else {
-                ALOGE("Attempt to defer transaction to to an unrecognized GraphicBufferProducer");
-            }
-        }
-        addDeferTransactionLocked(transaction, layerId, otherLayer, state.frameNumber_legacy);
+        addDeferTransactionLocked(transaction, layerId, state.barrierLayerId,
+                                  state.barrierFrameNumber);
     }
     if (state.what & layer_state_t::eOverrideScalingModeChanged) {
         addOverrideScalingModeLocked(transaction, layerId, state.overrideScalingMode);
     }
     if (state.what & layer_state_t::eReparent) {
-        addReparentLocked(transaction, layerId, getLayerIdFromHandle(state.parentHandleForChild));
+        addReparentLocked(transaction, layerId, state.parentId);
     }
     if (state.what & layer_state_t::eReparentChildren) {
-        addReparentChildrenLocked(transaction, layerId, getLayerIdFromHandle(state.reparentHandle));
+        addReparentChildrenLocked(transaction, layerId, state.reparentChildrenId);
     }
     if (state.what & layer_state_t::eDetachChildren) {
         addDetachChildrenLocked(transaction, layerId, true);
     }
     if (state.what & layer_state_t::eRelativeLayerChanged) {
-        addRelativeParentLocked(transaction, layerId,
-                                getLayerIdFromHandle(state.relativeLayerHandle), state.z);
+        addRelativeParentLocked(transaction, layerId, state.relativeParentId, state.z);
     }
     if (state.what & layer_state_t::eShadowRadiusChanged) {
         addShadowRadiusLocked(transaction, layerId, state.shadowRadius);
@@ -488,40 +589,33 @@ void SurfaceInterceptor::addDisplayChangesLocked(Transaction* transaction,
 }
 
 void SurfaceInterceptor::addTransactionLocked(Increment* increment,
-        const Vector<ComposerState>& stateUpdates,
-        const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays,
-        const Vector<DisplayState>& changedDisplays, uint32_t transactionFlags)
+        const std::vector<SurfaceChangeSnapshot>& surfaceChanges,
+        const std::vector<DisplayChangeSnapshot>& displayChanges, uint32_t transactionFlags)
 {
     Transaction* transaction(increment->mutable_transaction());
     transaction->set_synchronous(transactionFlags & BnSurfaceComposer::eSynchronous);
     transaction->set_animation(transactionFlags & BnSurfaceComposer::eAnimation);
-    for (const auto& compState: stateUpdates) {
-        addSurfaceChangesLocked(transaction, compState.state);
+    for (const auto& surfaceChange : surfaceChanges) {
+        addSurfaceChangesLocked(transaction, surfaceChange);
     }
-    for (const auto& disp: changedDisplays) {
-        ssize_t dpyIdx = displays.indexOfKey(disp.token);
-        if (dpyIdx >= 0) {
-            const DisplayDeviceState& dispState(displays.valueAt(dpyIdx));
-            addDisplayChangesLocked(transaction, disp, dispState.sequenceId);
-        }
+    for (const auto& [disp, sequenceId] : displayChanges) {
+        addDisplayChangesLocked(transaction, disp, sequenceId);
     }
 }
 
-void SurfaceInterceptor::addSurfaceCreationLocked(Increment* increment,
-        const sp<const Layer>& layer)
+void SurfaceInterceptor::addSurfaceCreationLocked(Increment* increment, int32_t layerId,
+        const std::string& name, uint32_t w, uint32_t h)
 {
     SurfaceCreation* creation(increment->mutable_surface_creation());
-    creation->set_id(getLayerId(layer));
-    creation->set_name(layer->getName());
-    creation->set_w(layer->mCurrentState.active_legacy.w);
-    creation->set_h(layer->mCurrentState.active_legacy.h);
+    creation->set_id(layerId);
+    creation->set_name(name);
+    creation->set_w(w);
+    creation->set_h(h);
 }
 
-void SurfaceInterceptor::addSurfaceDeletionLocked(Increment* increment,
-        const sp<const Layer>& layer)
-{
+void SurfaceInterceptor::addSurfaceDeletionLocked(Increment* increment, int32_t layerId) {
     SurfaceDeletion* deletion(increment->mutable_surface_deletion());
-    deletion->set_id(getLayerId(layer));
+    deletion->set_id(layerId);
 }
 
 void SurfaceInterceptor::addBufferUpdateLocked(Increment* increment, int32_t layerId,
@@ -613,6 +707,9 @@ void SurfaceInterceptor::addPowerModeUpdateLocked(Increment* increment, int32_t
     powerModeUpdate->set_mode(mode);
 }
 
+// The save methods run on the main and binder threads, so they only copy what
+// is recorded of each event and leave the encoding to mThread.
+
 void SurfaceInterceptor::saveTransaction(const Vector<ComposerState>& stateUpdates,
         const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays,
         const Vector<DisplayState>& changedDisplays, uint32_t flags)
@@ -621,9 +718,25 @@ void SurfaceInterceptor::saveTransaction(const Vector<ComposerState>& stateUpdat
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addTransactionLocked(createTraceIncrementLocked(), stateUpdates, displays, changedDisplays,
-            flags);
+    std::vector<SurfaceChangeSnapshot> surfaceChanges;
+    surfaceChanges.reserve(stateUpdates.size());
+    for (const auto& compState : stateUpdates) {
+        SurfaceChangeSnapshot snapshot;
+        if (captureSurfaceChange(compState.state, &snapshot)) {
+            surfaceChanges.push_back(std::move(snapshot));
+        }
+    }
+    std::vector<DisplayChangeSnapshot> displayChanges;
+    for (const auto& disp : changedDisplays) {
+        ssize_t dpyIdx = displays.indexOfKey(disp.token);
+        if (dpyIdx >= 0) {
+            displayChanges.emplace_back(disp, displays.valueAt(dpyIdx).sequenceId);
+        }
+    }
+    queueIncrement([this, surfaceChanges = std::move(surfaceChanges),
+                    displayChanges = std::move(displayChanges), flags](Increment* increment) {
+        addTransactionLocked(increment, surfaceChanges, displayChanges, flags);
+    });
 }
 
 void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
@@ -631,8 +744,11 @@ void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addSurfaceCreationLocked(createTraceIncrementLocked(), layer);
+    queueIncrement([this, layerId = getLayerId(layer), name = layer->getName(),
+                    w = layer->mCurrentState.active_legacy.w,
+                    h = layer->mCurrentState.active_legacy.h](Increment* increment) {
+        addSurfaceCreationLocked(increment, layerId, name, w, h);
+    });
 }
 
 void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
@@ -640,8 +756,9 @@ void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addSurfaceDeletionLocked(createTraceIncrementLocked(), layer);
+    queueIncrement([this, layerId = getLayerId(layer)](Increment* increment) {
+        addSurfaceDeletionLocked(increment, layerId);
+    });
 }
 
 /**
@@ -658,16 +775,18 @@ void SurfaceInterceptor::saveBufferUpdate(int32_t layerId, uint32_t width,
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addBufferUpdateLocked(createTraceIncrementLocked(), layerId, width, height, frameNumber);
+    queueIncrement([this, layerId, width, height, frameNumber](Increment* increment) {
+        addBufferUpdateLocked(increment, layerId, width, height, frameNumber);
+    });
 }
 
 void SurfaceInterceptor::saveVSyncEvent(nsecs_t timestamp) {
     if (!mEnabled) {
         return;
     }
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addVSyncUpdateLocked(createTraceIncrementLocked(), timestamp);
+    queueIncrement([this, timestamp](Increment* increment) {
+        addVSyncUpdateLocked(increment, timestamp);
+    });
 }
 
 void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
@@ -675,8 +794,9 @@ void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addDisplayCreationLocked(createTraceIncrementLocked(), info);
+    queueIncrement([this, info](Increment* increment) {
+        addDisplayCreationLocked(increment, info);
+    });
 }
 
 void SurfaceInterceptor::saveDisplayDeletion(int32_t sequenceId) {
@@ -684,8 +804,9 @@ void SurfaceInterceptor::saveDisplayDeletion(int32_t sequenceId) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addDisplayDeletionLocked(createTraceIncrementLocked(), sequenceId);
+    queueIncrement([this, sequenceId](Increment* increment) {
+        addDisplayDeletionLocked(increment, sequenceId);
+    });
 }
 
 void SurfaceInterceptor::savePowerModeUpdate(int32_t sequenceId, int32_t mode) {
@@ -693,8 +814,9 @@ void SurfaceInterceptor::savePowerModeUpdate(int32_t sequenceId, int32_t mode) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addPowerModeUpdateLocked(createTraceIncrementLocked(), sequenceId, mode);
+    queueIncrement([this, sequenceId, mode](Increment* increment) {
+        addPowerModeUpdateLocked(increment, sequenceId, mode);
+    });
 }
 
 } // namespace impl
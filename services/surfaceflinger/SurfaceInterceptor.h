@@ -19,7 +19,14 @@
 
 #include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <gui/LayerState.h>
 
@@ -82,11 +89,15 @@ namespace impl {
 /*
  * SurfaceInterceptor intercepts and stores incoming streams of window
  * properties on SurfaceFlinger.
+ *
+ * The calling threads only copy what is recorded of each event, and a worker
+ * thread encodes it into the trace, so recording does not hold up the
+ * transactions being recorded.
  */
 class SurfaceInterceptor final : public android::SurfaceInterceptor {
 public:
     explicit SurfaceInterceptor(SurfaceFlinger* const flinger);
-    ~SurfaceInterceptor() override = default;
+    ~SurfaceInterceptor() override;
 
     // Both vectors are used to capture the current state of SF as the initial snapshot in the trace
     void enable(const SortedVector<sp<Layer>>& layers,
@@ -112,6 +123,48 @@ public:
     void saveVSyncEvent(nsecs_t timestamp) override;
 
 private:
+    // What is recorded of a layer_state_t, with its handles resolved to
+    // layer ids while they are still valid.
+    struct SurfaceChangeSnapshot {
+        int32_t layerId = -1;
+        uint64_t what = 0;
+        float x = 0;
+        float y = 0;
+        int32_t z = 0;
+        uint32_t w = 0;
+        uint32_t h = 0;
+        float alpha = 0;
+        layer_state_t::matrix22_t matrix;
+        Region transparentRegion;
+        uint8_t flags = 0;
+        uint8_t mask = 0;
+        uint32_t layerStack = 0;
+        Rect crop;
+        float cornerRadius = 0;
+        int32_t backgroundBlurRadius = 0;
+        int32_t barrierLayerId = -1;
+        uint64_t barrierFrameNumber = 0;
+        int32_t overrideScalingMode = -1;
+        int32_t parentId = -1;
+        int32_t reparentChildrenId = -1;
+        int32_t relativeParentId = -1;
+        float shadowRadius = 0;
+    };
+    // A display change with the sequence id of its display.
+    using DisplayChangeSnapshot = std::pair<DisplayState, int32_t>;
+
+    // Fills in an increment from a snapshot taken by the calling thread.
+    using IncrementEncoder = std::function<void(Increment*)>;
+    struct PendingIncrement {
+        nsecs_t timestamp;
+        IncrementEncoder encode;
+    };
+
+    void queueIncrement(IncrementEncoder&& encode);
+    void threadMain();
+    void stopThread();
+    bool captureSurfaceChange(const layer_state_t& state, SurfaceChangeSnapshot* snapshot) const;
+
     // The creation increments of Surfaces and Displays do not contain enough information to capture
     // the initial state of each object, so a transaction with all of the missing properties is
     // performed at the initial snapshot for each display and surface.
@@ -128,8 +181,9 @@ private:
     int32_t getLayerIdFromHandle(const sp<const IBinder>& weakHandle) const;
 
     Increment* createTraceIncrementLocked();
-    void addSurfaceCreationLocked(Increment* increment, const sp<const Layer>& layer);
-    void addSurfaceDeletionLocked(Increment* increment, const sp<const Layer>& layer);
+    void addSurfaceCreationLocked(Increment* increment, int32_t layerId, const std::string& name,
+                                  uint32_t w, uint32_t h);
+    void addSurfaceDeletionLocked(Increment* increment, int32_t layerId);
     void addBufferUpdateLocked(Increment* increment, int32_t layerId, uint32_t width,
             uint32_t height, uint64_t frameNumber);
     void addVSyncUpdateLocked(Increment* increment, nsecs_t timestamp);
@@ -155,13 +209,14 @@ private:
     void addBackgroundBlurRadiusLocked(Transaction* transaction, int32_t layerId,
                                        int32_t backgroundBlurRadius);
     void addDeferTransactionLocked(Transaction* transaction, int32_t layerId,
-            const sp<const Layer>& layer, uint64_t frameNumber);
+                                   int32_t barrierLayerId, uint64_t frameNumber);
     void addOverrideScalingModeLocked(Transaction* transaction, int32_t layerId,
             int32_t overrideScalingMode);
-    void addSurfaceChangesLocked(Transaction* transaction, const layer_state_t& state);
-    void addTransactionLocked(Increment* increment, const Vector<ComposerState>& stateUpdates,
-            const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays,
-            const Vector<DisplayState>& changedDisplays, uint32_t transactionFlags);
+    void addSurfaceChangesLocked(Transaction* transaction, const SurfaceChangeSnapshot& state);
+    void addTransactionLocked(Increment* increment,
+                              const std::vector<SurfaceChangeSnapshot>& surfaceChanges,
+                              const std::vector<DisplayChangeSnapshot>& displayChanges,
+                              uint32_t transactionFlags);
     void addReparentLocked(Transaction* transaction, int32_t layerId, int32_t parentId);
     void addReparentChildrenLocked(Transaction* transaction, int32_t layerId, int32_t parentId);
     void addDetachChildrenLocked(Transaction* transaction, int32_t layerId, bool detached);
@@ -183,11 +238,18 @@ private:
             const DisplayState& state, int32_t sequenceId);
 
 
-    bool mEnabled {false};
+    std::atomic<bool> mEnabled {false};
     std::string mOutputFileName {DEFAULT_FILENAME};
     std::mutex mTraceMutex {};
     Trace mTrace {};
     SurfaceFlinger* const mFlinger;
+
+    // Increments waiting to be encoded into mTrace by mThread.
+    std::mutex mQueueMutex;
+    std::condition_variable mQueueCondition;
+    std::vector<PendingIncrement> mPendingIncrements;
+    bool mStopThread = false;
+    std::thread mThread;
 };
 
 } // namespace impl
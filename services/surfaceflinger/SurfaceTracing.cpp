@@ -30,6 +30,8 @@
 #include <utils/SystemClock.h>
 #include <utils/Trace.h>
 
+#include <fcntl.h>
+
 namespace android {
 
 SurfaceTracing::SurfaceTracing(SurfaceFlinger& flinger)
@@ -44,11 +46,12 @@ void SurfaceTracing::mainLoop() {
 }
 
 bool SurfaceTracing::addFirstEntry() {
-    LayersTraceProto entry;
+    TraceSnapshot snapshot;
     {
         std::scoped_lock lock(mSfLock);
-        entry = traceLayersLocked("tracing.enable");
+        snapshot = snapshotLayersLocked("tracing.enable");
     }
+    LayersTraceProto entry = traceLayers(snapshot);
     return addTraceToBuffer(entry);
 }
 
@@ -56,20 +59,39 @@ LayersTraceProto SurfaceTracing::traceWhenNotified() {
     std::unique_lock<std::mutex> lock(mSfLock);
     mCanStartTrace.wait(lock);
     android::base::ScopedLockAssertion assumeLock(mSfLock);
-    LayersTraceProto entry = traceLayersLocked(mWhere);
+    const TraceSnapshot snapshot = snapshotLayersLocked(mWhere);
     mTracingInProgress = false;
     mMissedTraceEntries = 0;
     lock.unlock();
-    return entry;
+    // The main thread may go on composing while the protos are built.
+    return traceLayers(snapshot);
 }
 
 bool SurfaceTracing::addTraceToBuffer(LayersTraceProto& entry) {
-    std::scoped_lock lock(mTraceLock);
-    mBuffer.emplace(std::move(entry));
+    std::unique_lock<std::mutex> lock(mTraceLock);
+    const bool incremental = mActiveMode == Mode::Incremental;
+    if (incremental) {
+        // Only this thread touches the last layers, so don't hold up
+        // dumpsys while diffing against them.
+        lock.unlock();
+        diffLayers(&entry);
+        lock.lock();
+        appendToStreamLocked(std::move(entry));
+    } else {
+        mBuffer.emplace(std::move(entry));
+    }
+
     if (mWriteToFile) {
-        writeProtoFileLocked();
+        if (incremental) {
+            flushStreamLocked();
+        } else {
+            writeProtoFileLocked();
+        }
         mWriteToFile = false;
     }
+    if (incremental && !mEnabled) {
+        mStreamFd.reset();
+    }
     return mEnabled;
 }
 
@@ -131,6 +153,15 @@ bool SurfaceTracing::enable() {
         return false;
     }
 
+    mActiveMode = mMode;
+    if (mActiveMode == Mode::Incremental && !openStreamLocked()) {
+        ALOGW("Falling back to tracing into the ring buffer");
+        mActiveMode = Mode::RingBuffer;
+    }
+    // The tracing thread isn't running, so this is safe.
+    mLastLayers.clear();
+    mEntriesSinceKeyframe = 0;
+
     mBuffer.reset(mBufferSize);
     mEnabled = true;
     mThread = std::thread(&SurfaceTracing::mainLoop, this);
@@ -171,33 +202,57 @@ void SurfaceTracing::setBufferSize(size_t bufferSizeInByte) {
     mBuffer.setSize(bufferSizeInByte);
 }
 
+void SurfaceTracing::setMode(Mode mode) {
+    std::scoped_lock lock(mTraceLock);
+    mMode = mode;
+}
+
 void SurfaceTracing::setTraceFlags(uint32_t flags) {
     std::scoped_lock lock(mSfLock);
     mTraceFlags = flags;
 }
 
-LayersTraceProto SurfaceTracing::traceLayersLocked(const char* where) {
+SurfaceTracing::TraceSnapshot SurfaceTracing::snapshotLayersLocked(const char* where) {
     ATRACE_CALL();
 
-    LayersTraceProto entry;
-    entry.set_elapsed_realtime_nanos(elapsedRealtimeNano());
-    entry.set_where(where);
-    LayersProto layers(mFlinger.dumpDrawingStateProto(mTraceFlags));
+    TraceSnapshot snapshot;
+    snapshot.elapsedRealtimeNanos = elapsedRealtimeNano();
+    snapshot.where = where;
+    snapshot.traceFlags = mTraceFlags;
+    snapshot.layers = mFlinger.snapshotDrawingStateProto(mTraceFlags);
 
     if (flagIsSetLocked(SurfaceTracing::TRACE_EXTRA)) {
-        mFlinger.dumpOffscreenLayersProto(layers);
+        snapshot.offscreenLayers = mFlinger.snapshotOffscreenLayersProto();
     }
-    entry.mutable_layers()->Swap(&layers);
 
     if (mTraceFlags & SurfaceTracing::TRACE_HWC) {
-        std::string hwcDump;
-        mFlinger.dumpHwc(hwcDump);
-        entry.set_hwc_blob(hwcDump);
+        mFlinger.dumpHwc(snapshot.hwcDump);
+    }
+    snapshot.missedEntries = mMissedTraceEntries;
+
+    return snapshot;
+}
+
+LayersTraceProto SurfaceTracing::traceLayers(const TraceSnapshot& snapshot) {
+    ATRACE_CALL();
+
+    LayersTraceProto entry;
+    entry.set_elapsed_realtime_nanos(snapshot.elapsedRealtimeNanos);
+    entry.set_where(snapshot.where);
+    LayersProto layers(SurfaceFlinger::writeLayersProto(snapshot.layers));
+
+    if (snapshot.traceFlags & SurfaceTracing::TRACE_EXTRA) {
+        SurfaceFlinger::writeOffscreenLayersProto(snapshot.offscreenLayers, layers);
     }
-    if (!flagIsSetLocked(SurfaceTracing::TRACE_COMPOSITION)) {
+    entry.mutable_layers()->Swap(&layers);
+
+    if (snapshot.traceFlags & SurfaceTracing::TRACE_HWC) {
+        entry.set_hwc_blob(snapshot.hwcDump);
+    }
+    if (!(snapshot.traceFlags & SurfaceTracing::TRACE_COMPOSITION)) {
         entry.set_excludes_composition_state(true);
     }
-    entry.set_missed_entries(mMissedTraceEntries);
+    entry.set_missed_entries(snapshot.missedEntries);
 
     return entry;
 }
@@ -229,9 +284,98 @@ void SurfaceTracing::writeProtoFileLocked() {
     mLastErr = NO_ERROR;
 }
 
+bool SurfaceTracing::openStreamLocked() {
+    // -rw-r--r--
+    const mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+    mStreamFd.reset(open(kDefaultFileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode));
+    if (mStreamFd < 0) {
+        ALOGE("Could not open %s to stream the trace: %s", kDefaultFileName, strerror(errno));
+        return false;
+    }
+
+    LayersTraceFileProto header;
+    header.set_magic_number(uint64_t(LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_H) << 32 |
+                            LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_L);
+    mStreamChunk.clear();
+    header.AppendToString(&mStreamChunk);
+    mStreamedEntries = 0;
+    mStreamedBytes = 0;
+    mLastErr = NO_ERROR;
+    return true;
+}
+
+void SurfaceTracing::diffLayers(LayersTraceProto* entry) {
+    ATRACE_CALL();
+
+    const bool keyframe = mEntriesSinceKeyframe == 0;
+    mEntriesSinceKeyframe = (mEntriesSinceKeyframe + 1) % kEntriesPerKeyframe;
+
+    auto* layers = entry->mutable_layers()->mutable_layers();
+    std::unordered_map<int32_t, std::string> currentLayers;
+    currentLayers.reserve(layers->size());
+    LayersProto changedLayers;
+    for (LayerProto& layer : *layers) {
+        const int32_t id = layer.id();
+        std::string bytes = layer.SerializeAsString();
+        if (!keyframe) {
+            const auto last = mLastLayers.find(id);
+            if (last == mLastLayers.end() || last->second != bytes) {
+                changedLayers.add_layers()->Swap(&layer);
+            }
+        }
+        currentLayers.emplace(id, std::move(bytes));
+    }
+
+    if (!keyframe) {
+        entry->set_incremental(true);
+        for (const auto& [id, bytes] : mLastLayers) {
+            if (currentLayers.count(id) == 0) {
+                entry->add_removed_layer_ids(id);
+            }
+        }
+        entry->mutable_layers()->Swap(&changedLayers);
+    }
+    mLastLayers = std::move(currentLayers);
+}
+
+void SurfaceTracing::appendToStreamLocked(LayersTraceProto&& entry) {
+    // Serialized messages concatenate into one holding all of their repeated
+    // fields, so the file stays a single LayersTraceFileProto.
+    LayersTraceFileProto fileProto;
+    fileProto.add_entry()->Swap(&entry);
+    fileProto.AppendToString(&mStreamChunk);
+    mStreamedEntries++;
+
+    if (mStreamChunk.size() >= kStreamChunkInByte) {
+        flushStreamLocked();
+    }
+}
+
+void SurfaceTracing::flushStreamLocked() {
+    if (mStreamChunk.empty() || mStreamFd < 0) {
+        return;
+    }
+
+    ATRACE_CALL();
+    if (base::WriteFully(mStreamFd, mStreamChunk.data(), mStreamChunk.size())) {
+        mStreamedBytes += mStreamChunk.size();
+    } else {
+        ALOGE("Could not stream the trace to %s: %s", kDefaultFileName, strerror(errno));
+        mLastErr = -errno;
+    }
+    mStreamChunk.clear();
+}
+
 void SurfaceTracing::dump(std::string& result) const {
     std::scoped_lock lock(mTraceLock);
     base::StringAppendF(&result, "Tracing state: %s\n", mEnabled ? "enabled" : "disabled");
+    if (mActiveMode == Mode::Incremental) {
+        base::StringAppendF(&result, "  streaming incremental entries to %s\n", kDefaultFileName);
+        base::StringAppendF(&result, "  number of entries: %zu (%.2fMB written, %.2fMB pending)\n",
+                            mStreamedEntries, float(mStreamedBytes) / float(1_MB),
+                            float(mStreamChunk.size()) / float(1_MB));
+        return;
+    }
     base::StringAppendF(&result, "  number of entries: %zu (%.2fMB / %.2fMB)\n",
                         mBuffer.frameCount(), float(mBuffer.used()) / float(1_MB),
                         float(mBuffer.size()) / float(1_MB));
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
 #include <layerproto/LayerProtoHeader.h>
 #include <utils/Errors.h>
 #include <utils/StrongPointer.h>
@@ -25,7 +26,12 @@
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "LayerProtoSnapshot.h"
 
 using namespace android::surfaceflinger;
 
@@ -53,6 +59,18 @@ public:
     void writeToFileAsync();
     void dump(std::string& result) const;
 
+    enum class Mode {
+        // Keeps full snapshots in a ring buffer of setBufferSize() bytes,
+        // written to the trace file when tracing stops.
+        RingBuffer,
+        // Streams entries to the trace file as they are taken, each holding
+        // only the layers that changed since the one before, so the length of
+        // a trace is only bound by disk space.
+        Incremental,
+    };
+    // Takes effect the next time tracing is enabled.
+    void setMode(Mode mode);
+
     enum : uint32_t {
         TRACE_CRITICAL = 1 << 0,
         TRACE_INPUT = 1 << 1,
@@ -69,6 +87,11 @@ public:
 private:
     static constexpr auto kDefaultBufferCapInByte = 5_MB;
     static constexpr auto kDefaultFileName = "/data/misc/wmtrace/layers_trace.pb";
+    // Incremental traces start over from a full snapshot this often, so
+    // that they can be read from any keyframe.
+    static constexpr size_t kEntriesPerKeyframe = 200;
+    // Streamed entries are written out in chunks of about this size.
+    static constexpr auto kStreamChunkInByte = 256 * 1024;
 
     class LayersTraceBuffer { // ring buffer
     public:
@@ -87,15 +110,34 @@ private:
         std::queue<LayersTraceProto> mStorage;
     };
 
+    // The state of a trace entry, captured with mSfLock held so that the entry
+    // can be built once SurfaceFlinger is let go.
+    struct TraceSnapshot {
+        int64_t elapsedRealtimeNanos = 0;
+        const char* where = "";
+        uint32_t traceFlags = 0;
+        std::vector<LayerProtoSnapshot> layers;
+        std::vector<LayerProtoSnapshot> offscreenLayers;
+        std::string hwcDump;
+        uint32_t missedEntries = 0;
+    };
+
     void mainLoop();
     bool addFirstEntry();
     LayersTraceProto traceWhenNotified();
-    LayersTraceProto traceLayersLocked(const char* where) REQUIRES(mSfLock);
+    TraceSnapshot snapshotLayersLocked(const char* where) REQUIRES(mSfLock);
+    static LayersTraceProto traceLayers(const TraceSnapshot& snapshot);
 
     // Returns true if trace is enabled.
     bool addTraceToBuffer(LayersTraceProto& entry);
     void writeProtoFileLocked() REQUIRES(mTraceLock);
 
+    bool openStreamLocked() REQUIRES(mTraceLock);
+    // Drops the layers that did not change since the last entry.
+    void diffLayers(LayersTraceProto* entry);
+    void appendToStreamLocked(LayersTraceProto&& entry) REQUIRES(mTraceLock);
+    void flushStreamLocked() REQUIRES(mTraceLock);
+
     SurfaceFlinger& mFlinger;
     status_t mLastErr = NO_ERROR;
     std::thread mThread;
@@ -112,6 +154,19 @@ private:
     size_t mBufferSize GUARDED_BY(mTraceLock) = kDefaultBufferCapInByte;
     bool mEnabled GUARDED_BY(mTraceLock) = false;
     bool mWriteToFile GUARDED_BY(mTraceLock) = false;
+    Mode mMode GUARDED_BY(mTraceLock) = Mode::RingBuffer;
+    // The mode of the trace in progress.
+    Mode mActiveMode GUARDED_BY(mTraceLock) = Mode::RingBuffer;
+
+    // Incremental mode only.
+    base::unique_fd mStreamFd GUARDED_BY(mTraceLock);
+    std::string mStreamChunk GUARDED_BY(mTraceLock);
+    size_t mStreamedEntries GUARDED_BY(mTraceLock) = 0;
+    size_t mStreamedBytes GUARDED_BY(mTraceLock) = 0;
+    // Only accessed by the tracing thread. The serialized layers of the
+    // last entry, by layer id.
+    std::unordered_map<int32_t, std::string> mLastLayers;
+    size_t mEntriesSinceKeyframe = 0;
 };
 
 } // namespace android
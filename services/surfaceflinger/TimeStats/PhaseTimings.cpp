@@ -0,0 +1,132 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PhaseTimings.h"
+
+#include <android-base/stringprintf.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <limits>
+
+namespace android {
+
+using base::StringAppendF;
+
+PhaseTimings::PhaseTimings() : mStartTime(systemTime()) {}
+
+size_t PhaseTimings::bucketFor(uint32_t us) {
+    if (us == 0) {
+        return 0;
+    }
+    const size_t log2 = 31 - static_cast<size_t>(__builtin_clz(us));
+    return std::min(log2, kNumBuckets - 1);
+}
+
+void PhaseTimings::record(Phase phase, nsecs_t duration) {
+    const uint32_t us = static_cast<uint32_t>(
+            std::clamp<nsecs_t>(ns2us(duration), 0, std::numeric_limits<uint32_t>::max()));
+    PhaseHistogram& histogram = mPhases[static_cast<size_t>(phase)];
+    histogram.buckets[bucketFor(us)].fetch_add(1, std::memory_order_relaxed);
+    histogram.totalUs.fetch_add(us, std::memory_order_relaxed);
+    uint32_t max = histogram.maxUs.load(std::memory_order_relaxed);
+    while (us > max &&
+           !histogram.maxUs.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+}
+
+void PhaseTimings::clear() {
+    // Durations recorded while clearing may be partially lost, which does not
+    // matter for statistics.
+    for (PhaseHistogram& histogram : mPhases) {
+        for (auto& bucket : histogram.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        histogram.totalUs.store(0, std::memory_order_relaxed);
+        histogram.maxUs.store(0, std::memory_order_relaxed);
+    }
+    mStartTime = systemTime();
+}
+
+const char* PhaseTimings::phaseName(Phase phase) {
+    switch (phase) {
+        case Phase::TransactionFlush:
+            return "TransactionFlush";
+        case Phase::PageFlip:
+            return "PageFlip";
+        case Phase::RebuildLayerStacks:
+            return "RebuildLayerStacks";
+        case Phase::ChooseCompositionStrategy:
+            return "ChooseCompositionStrategy";
+        case Phase::ComposeSurfaces:
+            return "ComposeSurfaces";
+        case Phase::PostComposition:
+            return "PostComposition";
+        case Phase::Count:
+            break;
+    }
+    return "Unknown";
+}
+
+std::unordered_map<int32_t, int32_t> PhaseTimings::histogram(Phase phase) const {
+    std::unordered_map<int32_t, int32_t> result;
+    const PhaseHistogram& histogram = mPhases[static_cast<size_t>(phase)];
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        const uint32_t count = histogram.buckets[i].load(std::memory_order_relaxed);
+        if (count != 0) {
+            result[i == 0 ? 0 : 1 << i] = static_cast<int32_t>(count);
+        }
+    }
+    return result;
+}
+
+void PhaseTimings::dump(std::string& result) const {
+    StringAppendF(&result, "Phase timings over the last %.1f s, in us:\n",
+                  static_cast<double>(systemTime() - mStartTime) / 1e9);
+    StringAppendF(&result, "  %-26s %9s %8s %8s %8s %8s %8s\n", "phase", "count", "mean", "p50",
+                  "p95", "p99", "max");
+    for (size_t p = 0; p < kNumPhases; p++) {
+        const PhaseHistogram& histogram = mPhases[p];
+        std::array<uint32_t, kNumBuckets> buckets;
+        uint64_t count = 0;
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            buckets[i] = histogram.buckets[i].load(std::memory_order_relaxed);
+            count += buckets[i];
+        }
+        const uint32_t max = histogram.maxUs.load(std::memory_order_relaxed);
+
+        // Percentiles are only known to the bucket, and are dumped as the
+        // upper bound of the bucket they fall in.
+        const auto percentile = [&](uint64_t percent) -> uint32_t {
+            const uint64_t rank = (count * percent + 99) / 100;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kNumBuckets - 1; i++) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    return std::min(2u << i, max);
+                }
+            }
+            return max;
+        };
+
+        StringAppendF(&result, "  %-26s %9" PRIu64 " %8" PRIu64 " %8u %8u %8u %8u\n",
+                      phaseName(static_cast<Phase>(p)), count,
+                      count ? histogram.totalUs.load(std::memory_order_relaxed) / count : 0,
+                      percentile(50), percentile(95), percentile(99), max);
+    }
+}
+
+} // namespace android
@@ -0,0 +1,107 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <utils/Timers.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace android {
+
+// Histograms of how long each phase of a SurfaceFlinger frame takes.
+//
+// Unlike the rest of TimeStats these are always recorded, so that the phase
+// that regressed on a device can be told from a bug report without a trace.
+// Recording is a handful of relaxed atomic increments, and may happen from
+// any thread, e.g. the workers presenting outputs in parallel.
+class PhaseTimings {
+public:
+    enum class Phase : size_t {
+        // Flushing the transaction queues and applying the transactions.
+        TransactionFlush,
+        // Latching the buffers queued by the layers.
+        PageFlip,
+        // Computing the visible layers of every output.
+        RebuildLayerStacks,
+        // Asking the HWC how each output is to be composed.
+        ChooseCompositionStrategy,
+        // Rendering the client composited layers, and queueing the result.
+        ComposeSurfaces,
+        // Releasing the buffers and reporting the frame to the clients.
+        PostComposition,
+        Count,
+    };
+
+    static constexpr size_t kNumPhases = static_cast<size_t>(Phase::Count);
+    // Bucket i counts durations in [2^i, 2^(i+1)) microseconds, except for the
+    // first one, which also counts anything shorter than 1us, and the last one,
+    // which counts anything longer.
+    static constexpr size_t kNumBuckets = 18;
+
+    // Records the duration of |phase| between its construction and destruction.
+    // Does nothing if |timings| is null.
+    class ScopedTimer {
+    public:
+        ScopedTimer(PhaseTimings* timings, Phase phase)
+              : mTimings(timings), mPhase(phase), mStart(timings ? systemTime() : 0) {}
+        ~ScopedTimer() {
+            if (mTimings) {
+                mTimings->record(mPhase, systemTime() - mStart);
+            }
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        PhaseTimings* const mTimings;
+        const Phase mPhase;
+        const nsecs_t mStart;
+    };
+
+    PhaseTimings();
+
+    void record(Phase phase, nsecs_t duration);
+    void clear();
+
+    // Returns the name of |phase| as it is dumped.
+    static const char* phaseName(Phase phase);
+
+    // Returns the histogram of |phase|, keyed by the lower bound of each
+    // non-empty bucket in microseconds, as the TimeStats histograms are.
+    std::unordered_map<int32_t, int32_t> histogram(Phase phase) const;
+
+    void dump(std::string& result) const;
+
+private:
+    struct PhaseHistogram {
+        std::array<std::atomic<uint32_t>, kNumBuckets> buckets{};
+        std::atomic<uint64_t> totalUs{0};
+        std::atomic<uint32_t> maxUs{0};
+    };
+
+    static size_t bucketFor(uint32_t us);
+
+    std::array<PhaseHistogram, kNumPhases> mPhases;
+    std::atomic<nsecs_t> mStartTime;
+};
+
+} // namespace android
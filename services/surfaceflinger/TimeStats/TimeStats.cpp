@@ -26,6 +26,7 @@
 #include <android-base/stringprintf.h>
 #include <android/util/ProtoOutputStream.h>
 #include <log/log.h>
+#include <pthread.h>
 #include <utils/String8.h>
 #include <utils/Timers.h>
 #include <utils/Trace.h>
@@ -115,14 +116,26 @@ AStatsManager_PullAtomCallbackReturn TimeStats::populateGlobalAtom(AStatsEventLi
                                        mMaxPulledHistogramBuckets);
     mStatsDelegate->statsEventWriteByteArray(event, (const uint8_t*)renderEngineTimingBytes.c_str(),
                                              renderEngineTimingBytes.size());
+    // One histogram per PhaseTimings::Phase, in order, which are reset along
+    // with the rest of the global stats.
+    for (size_t phase = 0; phase < PhaseTimings::kNumPhases; phase++) {
+        std::string phaseTimingBytes =
+                histogramToProtoByteString(mPhaseTimings.histogram(
+                                                   static_cast<PhaseTimings::Phase>(phase)),
+                                           mMaxPulledHistogramBuckets);
+        mStatsDelegate->statsEventWriteByteArray(event, (const uint8_t*)phaseTimingBytes.c_str(),
+                                                 phaseTimingBytes.size());
+    }
     mStatsDelegate->statsEventBuild(event);
     clearGlobalLocked();
+    mPhaseTimings.clear();
 
     return AStatsManager_PULL_SUCCESS;
 }
 
 AStatsManager_PullAtomCallbackReturn TimeStats::populateLayerAtom(AStatsEventList* data) {
     std::lock_guard<std::mutex> lock(mMutex);
+    flushLayerEventsLocked();
 
     std::vector<TimeStatsHelper::TimeStatsLayer const*> dumpStats;
     for (const auto& ele : mTimeStats.stats) {
@@ -160,6 +173,12 @@ AStatsManager_PullAtomCallbackReturn TimeStats::populateLayerAtom(AStatsEventLis
 
         mStatsDelegate->statsEventWriteInt64(event, layer->lateAcquireFrames);
         mStatsDelegate->statsEventWriteInt64(event, layer->badDesiredPresentFrames);
+        mStatsDelegate->statsEventWriteInt32(event, layer->uid);
+        mStatsDelegate->statsEventWriteInt64(event, layer->appDeadlineMissedFrames);
+        mStatsDelegate->statsEventWriteInt64(event, layer->sfDeadlineMissedFrames);
+        mStatsDelegate->statsEventWriteInt64(event, layer->displayHalJankFrames);
+        mStatsDelegate->statsEventWriteInt64(event, layer->predictionErrorFrames);
+        mStatsDelegate->statsEventWriteInt64(event, layer->bufferStuffingFrames);
 
         mStatsDelegate->statsEventBuild(event);
     }
@@ -184,9 +203,21 @@ TimeStats::TimeStats(std::unique_ptr<StatsEventDelegate> statsDelegate,
     if (maxPulledHistogramBuckets) {
         mMaxPulledHistogramBuckets = *maxPulledHistogramBuckets;
     }
+
+    mPendingEvents.reserve(MAX_NUM_PENDING_EVENTS);
+    mProcessingEvents.reserve(MAX_NUM_PENDING_EVENTS);
+    mThread = std::thread(&TimeStats::threadMain, this);
+    pthread_setname_np(mThread.native_handle(), "TimeStats");
 }
 
 TimeStats::~TimeStats() {
+    {
+        std::lock_guard<std::mutex> lock(mEventMutex);
+        mStopThread = true;
+        mEventCondition.notify_one();
+    }
+    mThread.join();
+
     std::lock_guard<std::mutex> lock(mMutex);
     mStatsDelegate->clearStatsPullAtomCallback(android::util::SURFACEFLINGER_STATS_GLOBAL_INFO);
     mStatsDelegate->clearStatsPullAtomCallback(android::util::SURFACEFLINGER_STATS_LAYER_INFO);
@@ -238,6 +269,7 @@ std::string TimeStats::miniDump() {
 
     std::string result = "TimeStats miniDump:\n";
     std::lock_guard<std::mutex> lock(mMutex);
+    flushLayerEventsLocked();
     android::base::StringAppendF(&result, "Number of layers currently being tracked is %zu\n",
                                  mTimeStatsTracker.size());
     android::base::StringAppendF(&result, "Number of layers in the stats pool is %zu\n",
@@ -385,6 +417,54 @@ bool TimeStats::recordReadyLocked(int32_t layerId, TimeRecord* timeRecord) {
     return true;
 }
 
+TimeStats::JankType TimeStats::classifyJank(const LayerRecord& layerRecord,
+                                            const TimeRecord& timeRecord) {
+    const SfFrameTiming& sfFrame = timeRecord.sfFrameTiming;
+    const nsecs_t period = sfFrame.vsyncPeriod;
+    if (period <= 0 || sfFrame.expectedPresentTime <= 0) {
+        return JankType::None;
+    }
+
+    // Allow for drift the same way SurfaceFlinger does when counting missed
+    // frames.
+    const nsecs_t slop = period / 2;
+    const FrameTime& frameTime = timeRecord.frameTime;
+    if (frameTime.presentTime > sfFrame.expectedPresentTime + slop) {
+        return sfFrame.compositionEndTime > sfFrame.expectedPresentTime
+                ? JankType::SurfaceFlingerDeadlineMissed
+                : JankType::DisplayHal;
+    }
+    if (frameTime.presentTime < sfFrame.expectedPresentTime - slop) {
+        return JankType::PredictionError;
+    }
+
+    // SurfaceFlinger presented on time, so any lateness is down to the app
+    // or to its buffer queue. Frames the app timestamped for the future are
+    // presented when asked to.
+    if (frameTime.desiredTime > frameTime.postTime) {
+        return JankType::None;
+    }
+
+    // SurfaceFlinger latches a buffer on the vsync before the one it
+    // presents on, so it could have latched a buffer ready by this time for
+    // the vsync before this one.
+    const nsecs_t readyTime = std::max(frameTime.postTime, frameTime.acquireTime);
+    const nsecs_t previousLatchDeadline = sfFrame.expectedPresentTime - 2 * period;
+    const nsecs_t presentToPresent =
+            frameTime.presentTime - layerRecord.prevTimeRecord.frameTime.presentTime;
+    if (readyTime < previousLatchDeadline - period &&
+        readyTime < layerRecord.prevTimeRecord.frameTime.presentTime) {
+        return JankType::BufferStuffing;
+    }
+    // Only count a gap longer than the one before it, so that apps rendering
+    // below the refresh rate are not charged for every frame.
+    if (readyTime > previousLatchDeadline && presentToPresent > period + slop &&
+        presentToPresent > layerRecord.prevPresentToPresent + slop) {
+        return JankType::AppDeadlineMissed;
+    }
+    return JankType::None;
+}
+
 void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId) {
     ATRACE_CALL();
 
@@ -402,6 +482,7 @@ void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId) {
                 mTimeStats.stats[layerName].layerName = layerName;
             }
             TimeStatsHelper::TimeStatsLayer& timeStatsLayer = mTimeStats.stats[layerName];
+            timeStatsLayer.uid = static_cast<int32_t>(layerRecord.uid);
             timeStatsLayer.totalFrames++;
             timeStatsLayer.droppedFrames += layerRecord.droppedFrames;
             timeStatsLayer.lateAcquireFrames += layerRecord.lateAcquireFrames;
@@ -446,6 +527,28 @@ void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId) {
             ALOGV("[%d]-[%" PRIu64 "]-present2present[%d]", layerId,
                   timeRecords[0].frameTime.frameNumber, presentToPresentMs);
             timeStatsLayer.deltas["present2present"].insert(presentToPresentMs);
+
+            switch (classifyJank(layerRecord, timeRecords[0])) {
+                case JankType::None:
+                    break;
+                case JankType::AppDeadlineMissed:
+                    timeStatsLayer.appDeadlineMissedFrames++;
+                    break;
+                case JankType::SurfaceFlingerDeadlineMissed:
+                    timeStatsLayer.sfDeadlineMissedFrames++;
+                    break;
+                case JankType::DisplayHal:
+                    timeStatsLayer.displayHalJankFrames++;
+                    break;
+                case JankType::PredictionError:
+                    timeStatsLayer.predictionErrorFrames++;
+                    break;
+                case JankType::BufferStuffing:
+                    timeStatsLayer.bufferStuffingFrames++;
+                    break;
+            }
+            layerRecord.prevPresentToPresent = timeRecords[0].frameTime.presentTime -
+                    prevTimeRecord.frameTime.presentTime;
         }
         prevTimeRecord = timeRecords[0];
         timeRecords.pop_front();
@@ -462,21 +565,18 @@ static bool layerNameIsValid(const std::string& layerName) {
             layerName.compare(0, kMinLenLayerName, kPopupWindowPrefix) != 0;
 }
 
-void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::string& layerName,
-                            nsecs_t postTime) {
-    if (!mEnabled.load()) return;
-
-    ATRACE_CALL();
+void TimeStats::setPostTimeLocked(int32_t layerId, uint64_t frameNumber,
+                                  const std::string& layerName, uid_t uid, nsecs_t postTime) {
     ALOGV("[%d]-[%" PRIu64 "]-[%s]-PostTime[%" PRId64 "]", layerId, frameNumber, layerName.c_str(),
           postTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
     if (!mTimeStats.stats.count(layerName) && mTimeStats.stats.size() >= MAX_NUM_LAYER_STATS) {
         return;
     }
     if (!mTimeStatsTracker.count(layerId) && mTimeStatsTracker.size() < MAX_NUM_LAYER_RECORDS &&
         layerNameIsValid(layerName)) {
         mTimeStatsTracker[layerId].layerName = layerName;
+        mTimeStatsTracker[layerId].uid = uid;
     }
     if (!mTimeStatsTracker.count(layerId)) return;
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
@@ -505,13 +605,9 @@ void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::st
         layerRecord.waitData = layerRecord.timeRecords.size() - 1;
 }
 
-void TimeStats::setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latchTime) {
-    if (!mEnabled.load()) return;
-
-    ATRACE_CALL();
+void TimeStats::setLatchTimeLocked(int32_t layerId, uint64_t frameNumber, nsecs_t latchTime) {
     ALOGV("[%d]-[%" PRIu64 "]-LatchTime[%" PRId64 "]", layerId, frameNumber, latchTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
     if (!mTimeStatsTracker.count(layerId)) return;
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     if (layerRecord.waitData < 0 ||
@@ -523,14 +619,10 @@ void TimeStats::setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latc
     }
 }
 
-void TimeStats::incrementLatchSkipped(int32_t layerId, LatchSkipReason reason) {
-    if (!mEnabled.load()) return;
-
-    ATRACE_CALL();
+void TimeStats::incrementLatchSkippedLocked(int32_t layerId, LatchSkipReason reason) {
     ALOGV("[%d]-LatchSkipped-Reason[%d]", layerId,
           static_cast<std::underlying_type<LatchSkipReason>::type>(reason));
 
-    std::lock_guard<std::mutex> lock(mMutex);
     if (!mTimeStatsTracker.count(layerId)) return;
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
 
@@ -541,25 +633,17 @@ void TimeStats::incrementLatchSkipped(int32_t layerId, LatchSkipReason reason) {
     }
 }
 
-void TimeStats::incrementBadDesiredPresent(int32_t layerId) {
-    if (!mEnabled.load()) return;
-
-    ATRACE_CALL();
+void TimeStats::incrementBadDesiredPresentLocked(int32_t layerId) {
     ALOGV("[%d]-BadDesiredPresent", layerId);
 
-    std::lock_guard<std::mutex> lock(mMutex);
     if (!mTimeStatsTracker.count(layerId)) return;
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     layerRecord.badDesiredPresentFrames++;
 }
 
-void TimeStats::setDesiredTime(int32_t layerId, uint64_t frameNumber, nsecs_t desiredTime) {
-    if (!mEnabled.load()) return;
-
-    ATRACE_CALL();
+void TimeStats::setDesiredTimeLocked(int32_t layerId, uint64_t frameNumber, nsecs_t desiredTime) {
     ALOGV("[%d]-[%" PRIu64 "]-DesiredTime[%" PRId64 "]", layerId, frameNumber, desiredTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
     if (!mTimeStatsTracker.count(layerId)) return;
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     if (layerRecord.waitData < 0 ||
@@ -571,13 +655,9 @@ void TimeStats::setDesiredTime(int32_t layerId, uint64_t frameNumber, nsecs_t de
     }
 }
 
-void TimeStats::setAcquireTime(int32_t layerId, uint64_t frameNumber, nsecs_t acquireTime) {
-    if (!mEnabled.load()) return;
-
-    ATRACE_CALL();
+void TimeStats::setAcquireTimeLocked(int32_t layerId, uint64_t frameNumber, nsecs_t acquireTime) {
     ALOGV("[%d]-[%" PRIu64 "]-AcquireTime[%" PRId64 "]", layerId, frameNumber, acquireTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
     if (!mTimeStatsTracker.count(layerId)) return;
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     if (layerRecord.waitData < 0 ||
@@ -589,15 +669,11 @@ void TimeStats::setAcquireTime(int32_t layerId, uint64_t frameNumber, nsecs_t ac
     }
 }
 
-void TimeStats::setAcquireFence(int32_t layerId, uint64_t frameNumber,
-                                const std::shared_ptr<FenceTime>& acquireFence) {
-    if (!mEnabled.load()) return;
-
-    ATRACE_CALL();
+void TimeStats::setAcquireFenceLocked(int32_t layerId, uint64_t frameNumber,
+                                      const std::shared_ptr<FenceTime>& acquireFence) {
     ALOGV("[%d]-[%" PRIu64 "]-AcquireFenceTime[%" PRId64 "]", layerId, frameNumber,
           acquireFence->getSignalTime());
 
-    std::lock_guard<std::mutex> lock(mMutex);
     if (!mTimeStatsTracker.count(layerId)) return;
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     if (layerRecord.waitData < 0 ||
@@ -609,13 +685,9 @@ void TimeStats::setAcquireFence(int32_t layerId, uint64_t frameNumber,
     }
 }
 
-void TimeStats::setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t presentTime) {
-    if (!mEnabled.load()) return;
-
-    ATRACE_CALL();
+void TimeStats::setPresentTimeLocked(int32_t layerId, uint64_t frameNumber, nsecs_t presentTime) {
     ALOGV("[%d]-[%" PRIu64 "]-PresentTime[%" PRId64 "]", layerId, frameNumber, presentTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
     if (!mTimeStatsTracker.count(layerId)) return;
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     if (layerRecord.waitData < 0 ||
@@ -624,6 +696,7 @@ void TimeStats::setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t pr
     TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
     if (timeRecord.frameTime.frameNumber == frameNumber) {
         timeRecord.frameTime.presentTime = presentTime;
+        timeRecord.sfFrameTiming = mSfFrameTiming;
         timeRecord.ready = true;
         layerRecord.waitData++;
     }
@@ -631,15 +704,11 @@ void TimeStats::setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t pr
     flushAvailableRecordsToStatsLocked(layerId);
 }
 
-void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
-                                const std::shared_ptr<FenceTime>& presentFence) {
-    if (!mEnabled.load()) return;
-
-    ATRACE_CALL();
+void TimeStats::setPresentFenceLocked(int32_t layerId, uint64_t frameNumber,
+                                      const std::shared_ptr<FenceTime>& presentFence) {
     ALOGV("[%d]-[%" PRIu64 "]-PresentFenceTime[%" PRId64 "]", layerId, frameNumber,
           presentFence->getSignalTime());
 
-    std::lock_guard<std::mutex> lock(mMutex);
     if (!mTimeStatsTracker.count(layerId)) return;
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     if (layerRecord.waitData < 0 ||
@@ -648,6 +717,7 @@ void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
     TimeRecord& timeRecord = layerRecord.timeRecords[layerRecord.waitData];
     if (timeRecord.frameTime.frameNumber == frameNumber) {
         timeRecord.presentFence = presentFence;
+        timeRecord.sfFrameTiming = mSfFrameTiming;
         timeRecord.ready = true;
         layerRecord.waitData++;
     }
@@ -655,20 +725,14 @@ void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
     flushAvailableRecordsToStatsLocked(layerId);
 }
 
-void TimeStats::onDestroy(int32_t layerId) {
-    ATRACE_CALL();
+void TimeStats::onDestroyLocked(int32_t layerId) {
     ALOGV("[%d]-onDestroy", layerId);
-    std::lock_guard<std::mutex> lock(mMutex);
     mTimeStatsTracker.erase(layerId);
 }
 
-void TimeStats::removeTimeRecord(int32_t layerId, uint64_t frameNumber) {
-    if (!mEnabled.load()) return;
-
-    ATRACE_CALL();
+void TimeStats::removeTimeRecordLocked(int32_t layerId, uint64_t frameNumber) {
     ALOGV("[%d]-[%" PRIu64 "]-removeTimeRecord", layerId, frameNumber);
 
-    std::lock_guard<std::mutex> lock(mMutex);
     if (!mTimeStatsTracker.count(layerId)) return;
     LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     size_t removeAt = 0;
@@ -684,6 +748,209 @@ void TimeStats::removeTimeRecord(int32_t layerId, uint64_t frameNumber) {
     layerRecord.droppedFrames++;
 }
 
+void TimeStats::queueLayerEvent(LayerEvent&& event) {
+    std::lock_guard<std::mutex> lock(mEventMutex);
+    const bool presented = event.type == LayerEvent::Type::PresentTime ||
+            event.type == LayerEvent::Type::PresentFence;
+    mPendingEvents.push_back(std::move(event));
+    // Records only become ready to be aggregated once presented, so that is
+    // the only time the aggregator needs to be woken up, unless the queue is
+    // about to outgrow its preallocated size.
+    if ((presented || mPendingEvents.size() >= MAX_NUM_PENDING_EVENTS) && !mEventsReady) {
+        mEventsReady = true;
+        mEventCondition.notify_one();
+    }
+}
+
+void TimeStats::flushLayerEventsLocked() {
+    {
+        std::lock_guard<std::mutex> lock(mEventMutex);
+        mEventsReady = false;
+        // Swapping keeps the capacity of both buffers, so neither side
+        // allocates once they have grown to a frame's worth of events.
+        std::swap(mPendingEvents, mProcessingEvents);
+    }
+    if (mProcessingEvents.empty()) return;
+
+    ATRACE_CALL();
+    for (const LayerEvent& event : mProcessingEvents) {
+        applyLayerEventLocked(event);
+    }
+    mProcessingEvents.clear();
+}
+
+void TimeStats::applyLayerEventLocked(const LayerEvent& event) {
+    switch (event.type) {
+        case LayerEvent::Type::PostTime:
+            setPostTimeLocked(event.layerId, event.frameNumber, event.layerName, event.uid,
+                              event.time);
+            break;
+        case LayerEvent::Type::LatchTime:
+            setLatchTimeLocked(event.layerId, event.frameNumber, event.time);
+            break;
+        case LayerEvent::Type::LatchSkipped:
+            incrementLatchSkippedLocked(event.layerId, event.latchSkipReason);
+            break;
+        case LayerEvent::Type::BadDesiredPresent:
+            incrementBadDesiredPresentLocked(event.layerId);
+            break;
+        case LayerEvent::Type::DesiredTime:
+            setDesiredTimeLocked(event.layerId, event.frameNumber, event.time);
+            break;
+        case LayerEvent::Type::AcquireTime:
+            setAcquireTimeLocked(event.layerId, event.frameNumber, event.time);
+            break;
+        case LayerEvent::Type::AcquireFence:
+            setAcquireFenceLocked(event.layerId, event.frameNumber, event.fence);
+            break;
+        case LayerEvent::Type::PresentTime:
+            setPresentTimeLocked(event.layerId, event.frameNumber, event.time);
+            break;
+        case LayerEvent::Type::PresentFence:
+            setPresentFenceLocked(event.layerId, event.frameNumber, event.fence);
+            break;
+        case LayerEvent::Type::RemoveTimeRecord:
+            removeTimeRecordLocked(event.layerId, event.frameNumber);
+            break;
+        case LayerEvent::Type::Destroy:
+            onDestroyLocked(event.layerId);
+            break;
+        case LayerEvent::Type::SfFrameTiming:
+            mSfFrameTiming = event.sfFrameTiming;
+            break;
+    }
+}
+
+void TimeStats::threadMain() {
+    std::unique_lock<std::mutex> lock(mEventMutex);
+    while (true) {
+        mEventCondition.wait(lock, [this] { return mEventsReady || mStopThread; });
+        if (mStopThread) return;
+
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> statsLock(mMutex);
+            flushLayerEventsLocked();
+        }
+        lock.lock();
+    }
+}
+
+void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::string& layerName,
+                            uid_t uid, nsecs_t postTime) {
+    if (!mEnabled.load()) return;
+
+    queueLayerEvent({.type = LayerEvent::Type::PostTime,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .time = postTime,
+                     .layerName = layerName,
+                     .uid = uid});
+}
+
+void TimeStats::setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latchTime) {
+    if (!mEnabled.load()) return;
+
+    queueLayerEvent({.type = LayerEvent::Type::LatchTime,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .time = latchTime});
+}
+
+void TimeStats::incrementLatchSkipped(int32_t layerId, LatchSkipReason reason) {
+    if (!mEnabled.load()) return;
+
+    queueLayerEvent({.type = LayerEvent::Type::LatchSkipped,
+                     .layerId = layerId,
+                     .latchSkipReason = reason});
+}
+
+void TimeStats::incrementBadDesiredPresent(int32_t layerId) {
+    if (!mEnabled.load()) return;
+
+    queueLayerEvent({.type = LayerEvent::Type::BadDesiredPresent, .layerId = layerId});
+}
+
+void TimeStats::setDesiredTime(int32_t layerId, uint64_t frameNumber, nsecs_t desiredTime) {
+    if (!mEnabled.load()) return;
+
+    queueLayerEvent({.type = LayerEvent::Type::DesiredTime,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .time = desiredTime});
+}
+
+void TimeStats::setAcquireTime(int32_t layerId, uint64_t frameNumber, nsecs_t acquireTime) {
+    if (!mEnabled.load()) return;
+
+    queueLayerEvent({.type = LayerEvent::Type::AcquireTime,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .time = acquireTime});
+}
+
+void TimeStats::setAcquireFence(int32_t layerId, uint64_t frameNumber,
+                                const std::shared_ptr<FenceTime>& acquireFence) {
+    if (!mEnabled.load()) return;
+
+    queueLayerEvent({.type = LayerEvent::Type::AcquireFence,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .fence = acquireFence});
+}
+
+void TimeStats::setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t presentTime) {
+    if (!mEnabled.load()) return;
+
+    queueLayerEvent({.type = LayerEvent::Type::PresentTime,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .time = presentTime});
+}
+
+void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
+                                const std::shared_ptr<FenceTime>& presentFence) {
+    if (!mEnabled.load()) return;
+
+    queueLayerEvent({.type = LayerEvent::Type::PresentFence,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber,
+                     .fence = presentFence});
+}
+
+void TimeStats::setSfFrameTiming(nsecs_t expectedPresentTime, nsecs_t compositionEndTime,
+                                 nsecs_t vsyncPeriod) {
+    if (!mEnabled.load()) return;
+
+    // Queued with the layer events, so it is applied before the present
+    // fences of the layers in this frame and after those of the last one.
+    queueLayerEvent({.type = LayerEvent::Type::SfFrameTiming,
+                     .sfFrameTiming = {.expectedPresentTime = expectedPresentTime,
+                                       .compositionEndTime = compositionEndTime,
+                                       .vsyncPeriod = vsyncPeriod}});
+}
+
+void TimeStats::onDestroy(int32_t layerId) {
+    if (!mEnabled.load()) {
+        // Nothing wakes up the aggregator while disabled, so don't let these
+        // pile up.
+        std::lock_guard<std::mutex> lock(mMutex);
+        flushLayerEventsLocked();
+        onDestroyLocked(layerId);
+        return;
+    }
+
+    queueLayerEvent({.type = LayerEvent::Type::Destroy, .layerId = layerId});
+}
+
+void TimeStats::removeTimeRecord(int32_t layerId, uint64_t frameNumber) {
+    if (!mEnabled.load()) return;
+
+    queueLayerEvent({.type = LayerEvent::Type::RemoveTimeRecord,
+                     .layerId = layerId,
+                     .frameNumber = frameNumber});
+}
+
 void TimeStats::flushPowerTimeLocked() {
     if (!mEnabled.load()) return;
 
@@ -814,6 +1081,10 @@ void TimeStats::setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentF
     flushAvailableGlobalRecordsToStatsLocked();
 }
 
+PhaseTimings* TimeStats::getPhaseTimings() {
+    return &mPhaseTimings;
+}
+
 void TimeStats::enable() {
     if (mEnabled.load()) return;
 
@@ -832,6 +1103,7 @@ void TimeStats::disable() {
     ATRACE_CALL();
 
     std::lock_guard<std::mutex> lock(mMutex);
+    flushLayerEventsLocked();
     flushPowerTimeLocked();
     mEnabled.store(false);
     mTimeStats.statsEnd = static_cast<int64_t>(std::time(0));
@@ -870,6 +1142,7 @@ void TimeStats::clearGlobalLocked() {
 void TimeStats::clearLayersLocked() {
     ATRACE_CALL();
 
+    flushLayerEventsLocked();
     mTimeStatsTracker.clear();
     mTimeStats.stats.clear();
     ALOGD("Cleared layer stats");
@@ -887,6 +1160,7 @@ void TimeStats::dump(bool asProto, std::optional<uint32_t> maxLayers, std::strin
         return;
     }
 
+    flushLayerEventsLocked();
     mTimeStats.statsEnd = static_cast<int64_t>(std::time(0));
 
     flushPowerTimeLocked();
@@ -34,11 +34,16 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <condition_variable>
 #include <deque>
 #include <mutex>
 #include <optional>
+#include <thread>
 #include <unordered_map>
 #include <variant>
+#include <vector>
+
+#include "PhaseTimings.h"
 
 using namespace android::surfaceflinger;
 
@@ -85,7 +90,7 @@ public:
                                             const std::shared_ptr<FenceTime>& readyFence) = 0;
 
     virtual void setPostTime(int32_t layerId, uint64_t frameNumber, const std::string& layerName,
-                             nsecs_t postTime) = 0;
+                             uid_t uid, nsecs_t postTime) = 0;
     virtual void setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latchTime) = 0;
     // Reasons why latching a particular buffer may be skipped
     enum class LatchSkipReason {
@@ -108,6 +113,13 @@ public:
     virtual void setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t presentTime) = 0;
     virtual void setPresentFence(int32_t layerId, uint64_t frameNumber,
                                  const std::shared_ptr<FenceTime>& presentFence) = 0;
+    // Records the timing of the frame SurfaceFlinger just composed, which the
+    // present times and fences reported next for each layer belong to. Layer
+    // frames are classified against it to tell why they were presented late.
+    // expectedPresentTime is the vsync SurfaceFlinger composed the frame for,
+    // and compositionEndTime is when it finished submitting it to the HWC.
+    virtual void setSfFrameTiming(nsecs_t expectedPresentTime, nsecs_t compositionEndTime,
+                                  nsecs_t vsyncPeriod) = 0;
     // Clean up the layer record
     virtual void onDestroy(int32_t layerId) = 0;
     // If SF skips or rejects a buffer, remove the corresponding TimeRecord.
@@ -118,6 +130,10 @@ public:
     // Source of truth is RefrehRateStats.
     virtual void recordRefreshRate(uint32_t fps, nsecs_t duration) = 0;
     virtual void setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentFence) = 0;
+
+    // Returns the per-phase frame timings, which are recorded whether or not
+    // TimeStats is enabled, and pulled along with the global stats.
+    virtual PhaseTimings* getPhaseTimings() = 0;
 };
 
 namespace impl {
@@ -134,15 +150,42 @@ class TimeStats : public android::TimeStats {
         nsecs_t presentTime = 0;
     };
 
+    struct SfFrameTiming {
+        nsecs_t expectedPresentTime = 0;
+        nsecs_t compositionEndTime = 0;
+        nsecs_t vsyncPeriod = 0;
+    };
+
+    // Why a layer frame was presented later than it could have been.
+    enum class JankType {
+        None,
+        // The app did not have the buffer ready in time for the vsync after
+        // its last frame.
+        AppDeadlineMissed,
+        // SurfaceFlinger finished composing after the vsync it composed for.
+        SurfaceFlingerDeadlineMissed,
+        // SurfaceFlinger was on time, but the HWC presented a vsync late.
+        DisplayHal,
+        // The frame was presented well before the vsync SurfaceFlinger
+        // predicted for it.
+        PredictionError,
+        // The buffer waited in the queue behind earlier buffers for more
+        // than a vsync.
+        BufferStuffing,
+    };
+
     struct TimeRecord {
         bool ready = false;
         FrameTime frameTime;
+        // The SurfaceFlinger frame that presented this one.
+        SfFrameTiming sfFrameTiming;
         std::shared_ptr<FenceTime> acquireFence;
         std::shared_ptr<FenceTime> presentFence;
     };
 
     struct LayerRecord {
         std::string layerName;
+        uid_t uid = 0;
         // This is the index in timeRecords, at which the timestamps for that
         // specific frame are still not fully received. This is not waiting for
         // fences to signal, but rather waiting to receive those fences/timestamps.
@@ -151,6 +194,8 @@ class TimeStats : public android::TimeStats {
         uint32_t lateAcquireFrames = 0;
         uint32_t badDesiredPresentFrames = 0;
         TimeRecord prevTimeRecord;
+        // The interval between the last two frames presented.
+        nsecs_t prevPresentToPresent = 0;
         std::deque<TimeRecord> timeRecords;
     };
 
@@ -164,6 +209,35 @@ class TimeStats : public android::TimeStats {
         std::variant<nsecs_t, std::shared_ptr<FenceTime>> endTime;
     };
 
+    // A per-layer update, recorded by the calling thread without touching
+    // mTimeStatsTracker and applied to it later by the aggregator thread.
+    struct LayerEvent {
+        enum class Type {
+            PostTime,
+            LatchTime,
+            LatchSkipped,
+            BadDesiredPresent,
+            DesiredTime,
+            AcquireTime,
+            AcquireFence,
+            PresentTime,
+            PresentFence,
+            RemoveTimeRecord,
+            Destroy,
+            SfFrameTiming,
+        };
+
+        Type type;
+        int32_t layerId = 0;
+        uint64_t frameNumber = 0;
+        nsecs_t time = 0;
+        std::shared_ptr<FenceTime> fence;
+        std::string layerName;
+        LatchSkipReason latchSkipReason = LatchSkipReason::LateAcquire;
+        uid_t uid = 0;
+        SfFrameTiming sfFrameTiming;
+    };
+
     struct GlobalRecord {
         nsecs_t prevPresentTime = 0;
         std::deque<std::shared_ptr<FenceTime>> presentFences;
@@ -242,7 +316,7 @@ public:
                                     const std::shared_ptr<FenceTime>& readyFence) override;
 
     void setPostTime(int32_t layerId, uint64_t frameNumber, const std::string& layerName,
-                     nsecs_t postTime) override;
+                     uid_t uid, nsecs_t postTime) override;
     void setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latchTime) override;
     void incrementLatchSkipped(int32_t layerId, LatchSkipReason reason) override;
     void incrementBadDesiredPresent(int32_t layerId) override;
@@ -253,6 +327,8 @@ public:
     void setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t presentTime) override;
     void setPresentFence(int32_t layerId, uint64_t frameNumber,
                          const std::shared_ptr<FenceTime>& presentFence) override;
+    void setSfFrameTiming(nsecs_t expectedPresentTime, nsecs_t compositionEndTime,
+                          nsecs_t vsyncPeriod) override;
     // Clean up the layer record
     void onDestroy(int32_t layerId) override;
     // If SF skips or rejects a buffer, remove the corresponding TimeRecord.
@@ -263,6 +339,7 @@ public:
     // Source of truth is RefrehRateStats.
     void recordRefreshRate(uint32_t fps, nsecs_t duration) override;
     void setPresentFenceGlobal(const std::shared_ptr<FenceTime>& presentFence) override;
+    PhaseTimings* getPhaseTimings() override;
 
     static const size_t MAX_NUM_TIME_RECORDS = 64;
 
@@ -272,7 +349,29 @@ private:
                                                                  void* cookie);
     AStatsManager_PullAtomCallbackReturn populateGlobalAtom(AStatsEventList* data);
     AStatsManager_PullAtomCallbackReturn populateLayerAtom(AStatsEventList* data);
+    void queueLayerEvent(LayerEvent&& event);
+    // Applies the layer events queued so far, in order.
+    void flushLayerEventsLocked();
+    void applyLayerEventLocked(const LayerEvent& event);
+    void threadMain();
+
+    void setPostTimeLocked(int32_t layerId, uint64_t frameNumber, const std::string& layerName,
+                           uid_t uid, nsecs_t postTime);
+    void setLatchTimeLocked(int32_t layerId, uint64_t frameNumber, nsecs_t latchTime);
+    void incrementLatchSkippedLocked(int32_t layerId, LatchSkipReason reason);
+    void incrementBadDesiredPresentLocked(int32_t layerId);
+    void setDesiredTimeLocked(int32_t layerId, uint64_t frameNumber, nsecs_t desiredTime);
+    void setAcquireTimeLocked(int32_t layerId, uint64_t frameNumber, nsecs_t acquireTime);
+    void setAcquireFenceLocked(int32_t layerId, uint64_t frameNumber,
+                               const std::shared_ptr<FenceTime>& acquireFence);
+    void setPresentTimeLocked(int32_t layerId, uint64_t frameNumber, nsecs_t presentTime);
+    void setPresentFenceLocked(int32_t layerId, uint64_t frameNumber,
+                               const std::shared_ptr<FenceTime>& presentFence);
+    void onDestroyLocked(int32_t layerId);
+    void removeTimeRecordLocked(int32_t layerId, uint64_t frameNumber);
+
     bool recordReadyLocked(int32_t layerId, TimeRecord* timeRecord);
+    static JankType classifyJank(const LayerRecord& layerRecord, const TimeRecord& timeRecord);
     void flushAvailableRecordsToStatsLocked(int32_t layerId);
     void flushPowerTimeLocked();
     void flushAvailableGlobalRecordsToStatsLocked();
@@ -285,15 +384,31 @@ private:
     void dump(bool asProto, std::optional<uint32_t> maxLayers, std::string& result);
 
     std::atomic<bool> mEnabled = false;
+    PhaseTimings mPhaseTimings;
     std::mutex mMutex;
     TimeStatsHelper::TimeStatsGlobal mTimeStats;
     // Hashmap for LayerRecord with layerId as the hash key
     std::unordered_map<int32_t, LayerRecord> mTimeStatsTracker;
     PowerTime mPowerTime;
     GlobalRecord mGlobalRecord;
+    // The last SurfaceFlinger frame applied from the layer events.
+    SfFrameTiming mSfFrameTiming;
+
+    // Layer events are queued here by the threads reporting them, which never
+    // take mMutex, and drained with mMutex held by mThread once a frame is
+    // presented, or by anything about to read the layer stats.
+    std::mutex mEventMutex;
+    std::condition_variable mEventCondition;
+    std::vector<LayerEvent> mPendingEvents;
+    bool mEventsReady = false;
+    bool mStopThread = false;
+    // Only accessed with mMutex held.
+    std::vector<LayerEvent> mProcessingEvents;
+    std::thread mThread;
 
     static const size_t MAX_NUM_LAYER_RECORDS = 200;
     static const size_t MAX_NUM_LAYER_STATS = 200;
+    static const size_t MAX_NUM_PENDING_EVENTS = 1024;
     std::unique_ptr<StatsEventDelegate> mStatsDelegate = std::make_unique<StatsEventDelegate>();
     size_t mMaxPulledLayers = 8;
     size_t mMaxPulledHistogramBuckets = 6;
@@ -81,10 +81,16 @@ std::string TimeStatsHelper::TimeStatsLayer::toString() const {
     std::string result = "\n";
     StringAppendF(&result, "layerName = %s\n", layerName.c_str());
     StringAppendF(&result, "packageName = %s\n", packageName.c_str());
+    StringAppendF(&result, "uid = %d\n", uid);
     StringAppendF(&result, "totalFrames = %d\n", totalFrames);
     StringAppendF(&result, "droppedFrames = %d\n", droppedFrames);
     StringAppendF(&result, "lateAcquireFrames = %d\n", lateAcquireFrames);
     StringAppendF(&result, "badDesiredPresentFrames = %d\n", badDesiredPresentFrames);
+    StringAppendF(&result, "appDeadlineMissedFrames = %d\n", appDeadlineMissedFrames);
+    StringAppendF(&result, "sfDeadlineMissedFrames = %d\n", sfDeadlineMissedFrames);
+    StringAppendF(&result, "displayHalJankFrames = %d\n", displayHalJankFrames);
+    StringAppendF(&result, "predictionErrorFrames = %d\n", predictionErrorFrames);
+    StringAppendF(&result, "bufferStuffingFrames = %d\n", bufferStuffingFrames);
     const auto iter = deltas.find("present2present");
     if (iter != deltas.end()) {
         const float averageTime = iter->second.averageTime();
@@ -44,10 +44,17 @@ public:
     public:
         std::string layerName;
         std::string packageName;
+        int32_t uid = 0;
         int32_t totalFrames = 0;
         int32_t droppedFrames = 0;
         int32_t lateAcquireFrames = 0;
         int32_t badDesiredPresentFrames = 0;
+        // Frames presented late, by the party responsible.
+        int32_t appDeadlineMissedFrames = 0;
+        int32_t sfDeadlineMissedFrames = 0;
+        int32_t displayHalJankFrames = 0;
+        int32_t predictionErrorFrames = 0;
+        int32_t bufferStuffingFrames = 0;
         std::unordered_map<std::string, Histogram> deltas;
 
         std::string toString() const;
@@ -17,9 +17,11 @@
 #undef LOG_TAG
 #define LOG_TAG "LibSurfaceFlingerUnittests"
 
+#include <binder/Parcel.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <log/log.h>
+#include <unistd.h>
 #include <utils/Errors.h>
 
 #include "AsyncCallRecorder.h"
@@ -31,6 +33,7 @@ using namespace std::placeholders;
 
 using testing::_;
 using testing::Invoke;
+using testing::Return;
 
 namespace android {
 
@@ -47,6 +50,7 @@ public:
     MOCK_METHOD1(setVSyncEnabled, void(bool));
     MOCK_METHOD1(setCallback, void(VSyncSource::Callback*));
     MOCK_METHOD1(setPhaseOffset, void(nsecs_t));
+    MOCK_CONST_METHOD0(getVsyncPeriod, nsecs_t());
     MOCK_METHOD1(pauseVsyncCallback, void(bool));
     MOCK_CONST_METHOD1(dump, void(std::string&));
 };
@@ -274,6 +278,36 @@ TEST_F(EventThreadTest, requestNextVsyncPostsASingleVSyncEventToTheConnection) {
     expectVSyncSetEnabledCallReceived(false);
 }
 
+TEST_F(EventThreadTest, vsyncEventsArePublishedToTheTimeline) {
+    EXPECT_CALL(*mVSyncSource, getVsyncPeriod()).WillRepeatedly(Return(100));
+
+    gui::VsyncTimeline timeline;
+    gui::VsyncTimeline::Snapshot snapshot;
+    {
+        Parcel parcel;
+        gui::VsyncTimeline shared;
+        ASSERT_EQ(NO_ERROR, mConnection->getVsyncTimeline(&shared));
+        ASSERT_EQ(NO_ERROR, shared.writeToParcel(&parcel));
+        parcel.setDataPosition(0);
+        ASSERT_EQ(NO_ERROR, timeline.readFromParcel(&parcel));
+    }
+    EXPECT_EQ(NOT_ENOUGH_DATA, timeline.read(&snapshot));
+
+    mThread->requestNextVsync(mConnection);
+    expectVSyncSetEnabledCallReceived(true);
+    mCallback->onVSyncEvent(123, 456);
+    expectVsyncEventReceivedByConnection(123, 1u);
+
+    ASSERT_EQ(NO_ERROR, timeline.read(&snapshot));
+    EXPECT_EQ(1u, snapshot.count);
+    EXPECT_EQ(123, snapshot.timestamp);
+    EXPECT_EQ(456, snapshot.expectedVsyncTimestamp);
+    EXPECT_EQ(100, snapshot.vsyncPeriod);
+    ASSERT_EQ(gui::VsyncTimeline::kMaxPredictions, snapshot.predictionCount);
+    EXPECT_EQ(556, snapshot.predictions[0]);
+    EXPECT_EQ(656, snapshot.predictions[1]);
+}
+
 TEST_F(EventThreadTest, setVsyncRateZeroPostsNoVSyncEventsToThatConnection) {
     // Create a first connection, register it, and request a vsync rate of zero.
     ConnectionEventRecorder firstConnectionEventRecorder{0};
@@ -356,6 +390,86 @@ TEST_F(EventThreadTest, setVsyncRateTwoPostsEveryOtherEventToThatConnection) {
     expectVsyncEventReceivedByConnection(101112, 4u);
 }
 
+TEST_F(EventThreadTest, vsyncEventsCarryTheFrameDeadline) {
+    EXPECT_CALL(*mVSyncSource, getVsyncPeriod()).WillRepeatedly(Return(100));
+    mThread->setSfPhaseOffset(20);
+    mThread->setVsyncRate(1, mConnection);
+
+    expectVSyncSetEnabledCallReceived(true);
+
+    // SurfaceFlinger wakes up for the VSYNC at 456 at 376, after this event.
+    mCallback->onVSyncEvent(123, 456);
+    expectInterceptCallReceived(123);
+    auto args = mConnectionEventCallRecorder.waitForCall();
+    ASSERT_TRUE(args.has_value());
+    const auto first = std::get<0>(args.value()).vsync;
+    EXPECT_EQ(456, first.expectedVSyncTimestamp);
+    EXPECT_EQ(456, first.expectedPresentTimestamp);
+    EXPECT_EQ(376, first.deadlineTimestamp);
+    EXPECT_NE(0, first.vsyncId);
+
+    // Too late for the VSYNC at 456, so the frame is presented one VSYNC later.
+    mCallback->onVSyncEvent(400, 456);
+    expectInterceptCallReceived(400);
+    args = mConnectionEventCallRecorder.waitForCall();
+    ASSERT_TRUE(args.has_value());
+    const auto second = std::get<0>(args.value()).vsync;
+    EXPECT_EQ(456, second.expectedVSyncTimestamp);
+    EXPECT_EQ(556, second.expectedPresentTimestamp);
+    EXPECT_EQ(476, second.deadlineTimestamp);
+    EXPECT_GT(second.vsyncId, first.vsyncId);
+}
+
+TEST_F(EventThreadTest, frameRateDividerThrottlesVSyncOfThatUid) {
+    mThread->setFrameRateDividers({{getuid(), 2}});
+    mThread->setVsyncRate(1, mConnection);
+
+    // EventThread should enable vsync callbacks.
+    expectVSyncSetEnabledCallReceived(true);
+
+    // Only every other event is seen by the connection.
+    mCallback->onVSyncEvent(123, 456);
+    expectInterceptCallReceived(123);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+
+    mCallback->onVSyncEvent(456, 123);
+    expectInterceptCallReceived(456);
+    expectVsyncEventReceivedByConnection(456, 2u);
+
+    // Without the divider, every event is seen again.
+    mThread->setFrameRateDividers({});
+    mCallback->onVSyncEvent(789, 777);
+    expectInterceptCallReceived(789);
+    expectVsyncEventReceivedByConnection(789, 3u);
+}
+
+TEST_F(EventThreadTest, throttledSingleVSyncRequestIsKeptUntilDelivered) {
+    mThread->setFrameRateDividers({{getuid(), 2}});
+    mThread->requestNextVsync(mConnection);
+
+    // EventThread should enable vsync callbacks.
+    expectVSyncSetEnabledCallReceived(true);
+
+    mCallback->onVSyncEvent(123, 456);
+    expectInterceptCallReceived(123);
+    EXPECT_FALSE(mConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+
+    mCallback->onVSyncEvent(456, 123);
+    expectInterceptCallReceived(456);
+    expectVsyncEventReceivedByConnection(456, 2u);
+}
+
+TEST_F(EventThreadTest, frameRateDividerDoesNotThrottleOtherUids) {
+    mThread->setFrameRateDividers({{getuid() + 1, 2}});
+    mThread->setVsyncRate(1, mConnection);
+
+    expectVSyncSetEnabledCallReceived(true);
+
+    mCallback->onVSyncEvent(123, 456);
+    expectInterceptCallReceived(123);
+    expectVsyncEventReceivedByConnection(123, 1u);
+}
+
 TEST_F(EventThreadTest, connectionsRemovedIfInstanceDestroyed) {
     mThread->setVsyncRate(1, mConnection);
 
@@ -34,6 +34,7 @@ struct FakePhaseOffsets : PhaseConfiguration {
     }
 
     void setRefreshRateFps(float) override {}
+    bool onFrameComposed(nsecs_t) override { return false; }
     void dump(std::string&) const override {}
 };
 
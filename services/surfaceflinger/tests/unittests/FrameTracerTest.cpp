@@ -22,6 +22,7 @@
 #define LOG_TAG "LibSurfaceFlingerUnittests"
 
 #include <FrameTracer/FrameTracer.h>
+#include <android-base/stringprintf.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <log/log.h>
@@ -30,6 +31,7 @@
 #include "libsurfaceflinger_unittest_main.h"
 
 using namespace google::protobuf;
+using testing::HasSubstr;
 
 namespace android {
 namespace {
@@ -396,6 +398,76 @@ TEST_F(FrameTracerTest, traceFenceWithValidStartTime_ShouldHaveCorrectDuration)
     EXPECT_EQ(buffer_event2.duration_ns(), duration);
 }
 
+TEST_F(FrameTracerTest, sampleIntervalOnlyTracesSampledFrames) {
+    const std::string layerName = "co.layername#0";
+    const int32_t layerId = 5;
+    const uint32_t bufferID = 4;
+    const auto type = FrameTracer::FrameEvent::POST;
+
+    mFrameTracer->setSampleInterval(2);
+
+    auto tracingSession = getTracingSessionForTest();
+
+    tracingSession->StartBlocking();
+    // Clean up irrelevant traces.
+    tracingSession->ReadTraceBlocking();
+    mFrameTracer->traceNewLayer(layerId, layerName);
+    mFrameTracer->traceTimestamp(layerId, bufferID, 1, 1, type);
+    mFrameTracer->traceTimestamp(layerId, bufferID, 2, 2, type);
+    mFrameTracer->traceTimestamp(layerId, bufferID, 3, 3, type);
+    mFrameTracer->traceTimestamp(layerId, bufferID, FrameTracer::UNSPECIFIED_FRAME_NUMBER, 4,
+                                 FrameTracer::FrameEvent::DEQUEUE);
+    // Create second trace packet to finalize the previous one.
+    mFrameTracer->traceTimestamp(layerId, 0, 0, 0, FrameTracer::FrameEvent::UNSPECIFIED);
+    tracingSession->StopBlocking();
+
+    std::vector<char> raw_trace = tracingSession->ReadTraceBlocking();
+    ASSERT_GT(raw_trace.size(), 0);
+
+    perfetto::protos::Trace trace;
+    ASSERT_TRUE(trace.ParseFromArray(raw_trace.data(), int(raw_trace.size())));
+    ASSERT_EQ(trace.packet().size(), 1);
+
+    const auto& packet = trace.packet().Get(0);
+    ASSERT_TRUE(packet.has_graphics_frame_event());
+    ASSERT_TRUE(packet.graphics_frame_event().has_buffer_event());
+    EXPECT_EQ(packet.graphics_frame_event().buffer_event().frame_number(), 2);
+}
+
+TEST_F(FrameTracerTest, sampleIntervalAggregatesEveryEventWithoutTracing) {
+    const std::string layerName = "co.layername#0";
+    const int32_t layerId = 5;
+    const uint32_t bufferID = 4;
+
+    mFrameTracer->setSampleInterval(2);
+    mFrameTracer->traceNewLayer(layerId, layerName);
+
+    mFrameTracer->traceTimestamp(layerId, bufferID, 1, 0, FrameTracer::FrameEvent::POST, 2000);
+    mFrameTracer->traceTimestamp(layerId, bufferID, 2, 0, FrameTracer::FrameEvent::POST, 4000);
+
+    // A fence that signals after it is traced is counted on the next event.
+    const nsecs_t startTime = systemTime();
+    auto fence = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+    mFrameTracer->traceFence(layerId, bufferID, 3, fence, FrameTracer::FrameEvent::ACQUIRE_FENCE,
+                             startTime);
+    fenceFactory.signalAllForTest(Fence::NO_FENCE, startTime + 5000);
+    mFrameTracer->traceTimestamp(layerId, bufferID, 3, 0, FrameTracer::FrameEvent::LATCH);
+
+    const std::string dump = mFrameTracer->miniDump();
+    EXPECT_THAT(dump, HasSubstr("Tracing one frame in 2, statistics of 1 layers:\n"));
+    EXPECT_THAT(dump, HasSubstr("  co.layername#0 (5)\n"));
+    EXPECT_THAT(dump,
+                HasSubstr(base::StringPrintf("    type=%d count=2 avg=3us max=4us\n",
+                                             static_cast<int>(FrameTracer::FrameEvent::POST))));
+    EXPECT_THAT(dump,
+                HasSubstr(base::StringPrintf("    type=%d count=1 avg=5us max=5us\n",
+                                             static_cast<int>(
+                                                     FrameTracer::FrameEvent::ACQUIRE_FENCE))));
+
+    mFrameTracer->onDestroy(layerId);
+    EXPECT_THAT(mFrameTracer->miniDump(), HasSubstr("statistics of 0 layers"));
+}
+
 } // namespace
 } // namespace android
 
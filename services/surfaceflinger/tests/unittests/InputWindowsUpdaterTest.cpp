@@ -0,0 +1,136 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "InputWindowsUpdaterTest"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "InputWindowsUpdater.h"
+
+namespace android {
+namespace {
+
+using namespace std::chrono_literals;
+using testing::ElementsAre;
+
+InputWindowInfo makeWindow(int32_t id, int32_t frameLeft = 0) {
+    InputWindowInfo info;
+    info.id = id;
+    info.name = "window " + std::to_string(id);
+    info.frameLeft = frameLeft;
+    return info;
+}
+
+std::vector<int32_t> idsOf(const std::vector<InputWindowInfo>& windows) {
+    std::vector<int32_t> ids;
+    for (const auto& window : windows) {
+        ids.push_back(window.id);
+    }
+    return ids;
+}
+
+class FakeInputFlinger : public BnInputFlinger {
+public:
+    struct Call {
+        bool incremental;
+        std::vector<InputWindowInfo> windows;
+        std::vector<int32_t> windowIds;
+    };
+
+    void setInputWindows(const std::vector<InputWindowInfo>& windows,
+                         const sp<ISetInputWindowsListener>&) override {
+        record({false, windows, idsOf(windows)});
+    }
+
+    void updateInputWindows(const std::vector<InputWindowInfo>& changedWindows,
+                            const std::vector<int32_t>& windowIds,
+                            const sp<ISetInputWindowsListener>&) override {
+        record({true, changedWindows, windowIds});
+    }
+
+    void registerInputChannel(const sp<InputChannel>&) override {}
+    void unregisterInputChannel(const sp<InputChannel>&) override {}
+
+    bool waitForCalls(size_t count) {
+        std::unique_lock lock(mMutex);
+        return mCondition.wait_for(lock, 1s, [&] { return mCalls.size() >= count; });
+    }
+
+    std::vector<Call> calls() {
+        std::lock_guard lock(mMutex);
+        return mCalls;
+    }
+
+private:
+    void record(Call&& call) {
+        {
+            std::lock_guard lock(mMutex);
+            mCalls.push_back(std::move(call));
+        }
+        mCondition.notify_all();
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<Call> mCalls;
+};
+
+TEST(InputWindowsUpdaterTest, diffSendsAllWindowsTheFirstTime) {
+    const auto diff = InputWindowsUpdater::diff({}, {makeWindow(1), makeWindow(2)});
+
+    EXPECT_THAT(idsOf(diff.changedWindows), ElementsAre(1, 2));
+    EXPECT_THAT(diff.windowIds, ElementsAre(1, 2));
+}
+
+TEST(InputWindowsUpdaterTest, diffOnlySendsChangedWindows) {
+    const std::unordered_map<int32_t, InputWindowInfo> previous = {{1, makeWindow(1)},
+                                                                   {2, makeWindow(2)},
+                                                                   {3, makeWindow(3)}};
+
+    // Window 2 moved, window 3 went away and window 4 is new.
+    const auto diff = InputWindowsUpdater::diff(previous,
+                                                {makeWindow(4), makeWindow(2, 10), makeWindow(1)});
+
+    EXPECT_THAT(idsOf(diff.changedWindows), ElementsAre(4, 2));
+    EXPECT_THAT(diff.windowIds, ElementsAre(4, 2, 1));
+}
+
+TEST(InputWindowsUpdaterTest, sendsAllWindowsThenOnlyChanges) {
+    sp<FakeInputFlinger> inputFlinger = new FakeInputFlinger();
+    InputWindowsUpdater updater(inputFlinger);
+
+    updater.update({makeWindow(1), makeWindow(2)}, nullptr);
+    ASSERT_TRUE(inputFlinger->waitForCalls(1));
+
+    updater.update({makeWindow(1), makeWindow(2, 10)}, nullptr);
+    ASSERT_TRUE(inputFlinger->waitForCalls(2));
+
+    const auto calls = inputFlinger->calls();
+    EXPECT_FALSE(calls[0].incremental);
+    EXPECT_THAT(idsOf(calls[0].windows), ElementsAre(1, 2));
+    EXPECT_TRUE(calls[1].incremental);
+    EXPECT_THAT(idsOf(calls[1].windows), ElementsAre(2));
+    EXPECT_THAT(calls[1].windowIds, ElementsAre(1, 2));
+}
+
+} // namespace
+} // namespace android
@@ -136,6 +136,30 @@ TEST_F(OneShotTimerTest, resetBackToBackTest) {
     EXPECT_FALSE(mResetTimerCallback.waitForCall(0ms).has_value());
 }
 
+TEST_F(OneShotTimerTest, resetsWhileWaitingPostponeTimeoutTest) {
+    mIdleTimer = std::make_unique<scheduler::OneShotTimer>(20ms, mResetTimerCallback.getInvocable(),
+                                                           mExpiredTimerCallback.getInvocable());
+    mIdleTimer->start();
+    EXPECT_TRUE(mResetTimerCallback.waitForCall().has_value());
+
+    // Keep resetting for several intervals. Each reset only moves the deadline, so neither
+    // callback is fired meanwhile.
+    auto startTime = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - startTime < 100ms) {
+        mIdleTimer->reset();
+        std::this_thread::sleep_for(2ms);
+    }
+    EXPECT_FALSE(mExpiredTimerCallback.waitForCall(0ms).has_value());
+    EXPECT_FALSE(mResetTimerCallback.waitForCall(0ms).has_value());
+
+    // A single callback should be generated after the last reset.
+    EXPECT_TRUE(
+            mExpiredTimerCallback.waitForCall(waitTimeForExpected3msCallback + 20ms).has_value());
+    mIdleTimer->stop();
+    EXPECT_FALSE(mExpiredTimerCallback.waitForCall(0ms).has_value());
+    EXPECT_FALSE(mResetTimerCallback.waitForCall(0ms).has_value());
+}
+
 TEST_F(OneShotTimerTest, startNotCalledTest) {
     mIdleTimer = std::make_unique<scheduler::OneShotTimer>(3ms, mResetTimerCallback.getInvocable(),
                                                            mExpiredTimerCallback.getInvocable());
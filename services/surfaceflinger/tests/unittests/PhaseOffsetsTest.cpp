@@ -36,10 +36,11 @@ class TestablePhaseOffsetsAsDurations : public impl::PhaseDurations {
 public:
     TestablePhaseOffsetsAsDurations(float currentFps, nsecs_t sfDuration, nsecs_t appDuration,
                                     nsecs_t sfEarlyDuration, nsecs_t appEarlyDuration,
-                                    nsecs_t sfEarlyGlDuration, nsecs_t appEarlyGlDuration)
+                                    nsecs_t sfEarlyGlDuration, nsecs_t appEarlyGlDuration,
+                                    std::optional<nsecs_t> sfMinDuration = std::nullopt)
           : impl::PhaseDurations({60.0f, 90.0f}, currentFps, sfDuration, appDuration,
                                  sfEarlyDuration, appEarlyDuration, sfEarlyGlDuration,
-                                 appEarlyGlDuration) {}
+                                 appEarlyGlDuration, sfMinDuration) {}
 };
 
 class PhaseDurationTest : public testing::Test {
@@ -141,6 +142,46 @@ TEST_F(PhaseDurationTest, getOffsetsForRefreshRate_unknownRefreshRate) {
     EXPECT_EQ(offsets.earlyGl.app, 33'527'208);
 }
 
+TEST_F(PhaseDurationTest, onFrameComposed_fixedWithoutMinDuration) {
+    const auto offsets = mPhaseDurations.getCurrentOffsets();
+    for (size_t i = 0; i < impl::PhaseDurations::kFrameDurationHistorySize; i++) {
+        EXPECT_FALSE(mPhaseDurations.onFrameComposed(1'000'000));
+    }
+    EXPECT_EQ(offsets, mPhaseDurations.getCurrentOffsets());
+}
+
+TEST_F(PhaseDurationTest, onFrameComposed_adaptsLateOffsets) {
+    TestablePhaseOffsetsAsDurations adaptive(60.0f, 10'500'000, 20'500'000, 16'000'000,
+                                             16'500'000, 13'500'000, 21'000'000, 4'000'000);
+    const auto initial = adaptive.getCurrentOffsets();
+    EXPECT_EQ(initial, mPhaseDurations.getCurrentOffsets());
+
+    // Nothing changes until enough frames were measured.
+    for (size_t i = 1; i < impl::PhaseDurations::kMinFramesForAdaptiveDuration; i++) {
+        EXPECT_FALSE(adaptive.onFrameComposed(3'000'000));
+    }
+    EXPECT_EQ(initial, adaptive.getCurrentOffsets());
+
+    // 3ms frames with the 1ms margin reach the minimum duration of 4ms.
+    EXPECT_TRUE(adaptive.onFrameComposed(3'000'000));
+    auto offsets = adaptive.getCurrentOffsets();
+    EXPECT_EQ(offsets.late.sf, 12'666'667);
+    EXPECT_EQ(offsets.late.app, 8'833'334);
+    EXPECT_EQ(offsets.early, initial.early);
+    EXPECT_EQ(offsets.earlyGl, initial.earlyGl);
+
+    // Similar frames don't move the offsets again.
+    EXPECT_FALSE(adaptive.onFrameComposed(3'200'000));
+
+    // Slow frames bring it back up, but never past the configured duration.
+    bool changed = false;
+    for (size_t i = 0; i < impl::PhaseDurations::kFrameDurationHistorySize; i++) {
+        changed |= adaptive.onFrameComposed(12'000'000);
+    }
+    EXPECT_TRUE(changed);
+    EXPECT_EQ(initial, adaptive.getCurrentOffsets());
+}
+
 } // namespace
 
 class TestablePhaseOffsets : public impl::PhaseOffsets {
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "PhaseTimingsTest"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "TimeStats/PhaseTimings.h"
+
+using testing::HasSubstr;
+using testing::Pair;
+using testing::UnorderedElementsAre;
+
+namespace android {
+namespace {
+
+using Phase = PhaseTimings::Phase;
+
+TEST(PhaseTimingsTest, recordsIntoPowerOfTwoBuckets) {
+    PhaseTimings timings;
+    timings.record(Phase::PageFlip, us2ns(0));
+    timings.record(Phase::PageFlip, us2ns(1));
+    timings.record(Phase::PageFlip, us2ns(3));
+    timings.record(Phase::PageFlip, us2ns(1000));
+    timings.record(Phase::PageFlip, us2ns(1023));
+
+    EXPECT_THAT(timings.histogram(Phase::PageFlip),
+                UnorderedElementsAre(Pair(0, 2), Pair(2, 1), Pair(512, 2)));
+    EXPECT_TRUE(timings.histogram(Phase::TransactionFlush).empty());
+}
+
+TEST(PhaseTimingsTest, longDurationsGoInTheLastBucket) {
+    PhaseTimings timings;
+    timings.record(Phase::ComposeSurfaces, s2ns(10));
+    timings.record(Phase::ComposeSurfaces, -1);
+
+    constexpr int32_t kLastBucket = 1 << (PhaseTimings::kNumBuckets - 1);
+    EXPECT_THAT(timings.histogram(Phase::ComposeSurfaces),
+                UnorderedElementsAre(Pair(0, 1), Pair(kLastBucket, 1)));
+}
+
+TEST(PhaseTimingsTest, clearEmptiesEveryPhase) {
+    PhaseTimings timings;
+    for (size_t phase = 0; phase < PhaseTimings::kNumPhases; phase++) {
+        timings.record(static_cast<Phase>(phase), us2ns(100));
+    }
+    timings.clear();
+    for (size_t phase = 0; phase < PhaseTimings::kNumPhases; phase++) {
+        EXPECT_TRUE(timings.histogram(static_cast<Phase>(phase)).empty());
+    }
+}
+
+TEST(PhaseTimingsTest, scopedTimerRecordsOnce) {
+    PhaseTimings timings;
+    { PhaseTimings::ScopedTimer timer(&timings, Phase::PostComposition); }
+    { PhaseTimings::ScopedTimer timer(nullptr, Phase::PostComposition); }
+
+    int32_t count = 0;
+    for (const auto& [bucket, bucketCount] : timings.histogram(Phase::PostComposition)) {
+        count += bucketCount;
+    }
+    EXPECT_EQ(1, count);
+}
+
+TEST(PhaseTimingsTest, dumpsEveryPhase) {
+    PhaseTimings timings;
+    timings.record(Phase::ChooseCompositionStrategy, us2ns(300));
+
+    std::string result;
+    timings.dump(result);
+    for (size_t phase = 0; phase < PhaseTimings::kNumPhases; phase++) {
+        EXPECT_THAT(result, HasSubstr(PhaseTimings::phaseName(static_cast<Phase>(phase))));
+    }
+    // The percentiles are the bucket bounds, capped at the longest duration.
+    EXPECT_THAT(result, HasSubstr("ChooseCompositionStrategy          1      300      300"));
+}
+
+TEST(PhaseTimingsTest, recordsFromSeveralThreads) {
+    constexpr int kThreads = 4;
+    constexpr int kRecords = 1000;
+
+    PhaseTimings timings;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([&timings] {
+            for (int i = 0; i < kRecords; i++) {
+                timings.record(Phase::RebuildLayerStacks, us2ns(5));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_THAT(timings.histogram(Phase::RebuildLayerStacks),
+                UnorderedElementsAre(Pair(4, kThreads * kRecords)));
+}
+
+} // namespace
+} // namespace android
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gtest/gtest.h>
+
+#include "Scheduler/RefreshRateHysteresis.h"
+
+using namespace std::chrono_literals;
+
+namespace android::scheduler {
+namespace {
+
+using Config = RefreshRateHysteresis::Config;
+
+const Config kConfig60{HwcConfigIndexType(0), 60.f};
+const Config kConfig90{HwcConfigIndexType(1), 90.f};
+
+constexpr nsecs_t kWindow = std::chrono::nanoseconds(500ms).count();
+constexpr nsecs_t kFrame = std::chrono::nanoseconds(16ms).count();
+
+class RefreshRateHysteresisTest : public testing::Test {
+protected:
+    // Proposes |proposed| once a frame for |duration|, starting at mTime, and
+    // returns the config in use afterwards.
+    Config propose(const Config& proposed, nsecs_t duration) {
+        for (const nsecs_t end = mTime + duration; mTime < end; mTime += kFrame) {
+            mCurrent = mHysteresis.choose(mTime, mCurrent, proposed);
+        }
+        return mCurrent;
+    }
+
+    RefreshRateHysteresis mHysteresis{{.window = kWindow}};
+    Config mCurrent = kConfig60;
+    nsecs_t mTime = 0;
+};
+
+TEST_F(RefreshRateHysteresisTest, keepsConfigThatIsProposed) {
+    EXPECT_EQ(kConfig60.configId, propose(kConfig60, kWindow).configId);
+    EXPECT_FALSE(mHysteresis.hasPendingSwitch());
+    EXPECT_TRUE(mHysteresis.getDecisions().empty());
+}
+
+TEST_F(RefreshRateHysteresisTest, holdsBackShortBurstsOfOtherConfig) {
+    propose(kConfig60, kWindow);
+
+    EXPECT_EQ(kConfig60.configId, propose(kConfig90, 5 * kFrame).configId);
+    EXPECT_TRUE(mHysteresis.hasPendingSwitch());
+    EXPECT_EQ(kConfig60.configId, propose(kConfig60, 5 * kFrame).configId);
+    EXPECT_FALSE(mHysteresis.hasPendingSwitch());
+
+    ASSERT_FALSE(mHysteresis.getDecisions().empty());
+    for (const auto& decision : mHysteresis.getDecisions()) {
+        EXPECT_FALSE(decision.switched);
+    }
+}
+
+TEST_F(RefreshRateHysteresisTest, switchesOnceProposalIsSustained) {
+    propose(kConfig60, kWindow);
+
+    EXPECT_EQ(kConfig90.configId, propose(kConfig90, kWindow).configId);
+    ASSERT_FALSE(mHysteresis.getDecisions().empty());
+    EXPECT_TRUE(mHysteresis.getDecisions().back().switched);
+    EXPECT_FALSE(mHysteresis.hasPendingSwitch());
+}
+
+TEST_F(RefreshRateHysteresisTest, switchingDownNeedsLessSupportThanUp) {
+    propose(kConfig60, kWindow);
+    const auto& decisions = mHysteresis.getDecisions();
+
+    propose(kConfig90, kFrame);
+    const float upPenalty = decisions.back().penalty;
+
+    RefreshRateHysteresis downHysteresis{{.window = kWindow}};
+    downHysteresis.choose(0, kConfig90, kConfig60);
+    EXPECT_LT(downHysteresis.getDecisions().back().penalty, upPenalty);
+}
+
+TEST_F(RefreshRateHysteresisTest, eachSwitchRaisesThePenaltyForTheNext) {
+    propose(kConfig60, kWindow);
+    propose(kConfig90, kWindow);
+    ASSERT_EQ(kConfig90.configId, mCurrent.configId);
+
+    propose(kConfig60, kFrame);
+    const auto& decision = mHysteresis.getDecisions().back();
+    EXPECT_FLOAT_EQ(2 * RefreshRateHysteresis::Params{}.switchPenalty, decision.penalty);
+}
+
+TEST_F(RefreshRateHysteresisTest, resetForgetsProposals) {
+    propose(kConfig90, kWindow / 4);
+    mHysteresis.reset();
+    EXPECT_FALSE(mHysteresis.hasPendingSwitch());
+
+    mCurrent = mHysteresis.choose(mTime, mCurrent, kConfig90);
+    EXPECT_EQ(kConfig60.configId, mCurrent.configId);
+    EXPECT_FLOAT_EQ(0.f, mHysteresis.getDecisions().back().proposedSupport);
+}
+
+TEST_F(RefreshRateHysteresisTest, decisionLogIsBounded) {
+    for (size_t i = 0; i < 2 * RefreshRateHysteresis::kMaxDecisions; i++) {
+        mHysteresis.choose(mTime, kConfig60, kConfig90);
+        mTime += kFrame;
+    }
+    EXPECT_EQ(RefreshRateHysteresis::kMaxDecisions, mHysteresis.getDecisions().size());
+}
+
+} // namespace
+} // namespace android::scheduler
@@ -140,6 +140,52 @@ TEST_F(RegionSamplingTest, orientation_90) {
                 testing::Eq(1.0));
 }
 
+TEST_F(RegionSamplingTest, scales_area_to_covering_pixels) {
+    EXPECT_EQ(Rect(0, 0, 25, 8), scaleSamplingArea(whole_area, 4));
+    EXPECT_EQ(Rect(1, 0, 3, 2), scaleSamplingArea(Rect(5, 3, 9, 6), 4));
+    EXPECT_EQ(Rect(5, 3, 9, 6), scaleSamplingArea(Rect(5, 3, 9, 6), 1));
+}
+
+TEST_F(RegionSamplingTest, calculate_mean_of_scaled_region) {
+    std::fill(buffer.begin(), buffer.end(), kWhite);
+    Rect const scaled = scaleSamplingArea(Rect(5, 3, 9, 6), 4);
+    EXPECT_THAT(sampleArea(buffer.data(), kWidth, kHeight, kStride, kOrientation, scaled),
+                testing::FloatEq(1.0f));
+}
+
+TEST_F(RegionSamplingTest, histogram_luma_of_rgb_components) {
+    DisplayedFrameStats stats;
+    stats.numFrames = 1;
+    stats.component_0_sample = {0, 0, 0, 10};
+    stats.component_1_sample = {0, 0, 0, 10};
+    stats.component_2_sample = {0, 0, 0, 10};
+    constexpr uint8_t kRgb = 0x7;
+    EXPECT_THAT(histogramLuma(stats, ui::PixelFormat::RGBA_8888, kRgb),
+                testing::Optional(testing::FloatEq(0.875f)));
+
+    stats.component_1_sample = {10, 0, 0, 0};
+    EXPECT_THAT(histogramLuma(stats, ui::PixelFormat::RGBA_8888, kRgb),
+                testing::Optional(testing::FloatEq((0.875f * 9 + 0.125f * 23) / 32)));
+}
+
+TEST_F(RegionSamplingTest, histogram_luma_of_y_component) {
+    DisplayedFrameStats stats;
+    stats.numFrames = 1;
+    stats.component_0_sample = {5, 5};
+    EXPECT_THAT(histogramLuma(stats, ui::PixelFormat::YCBCR_420_888, 0x1),
+                testing::Optional(testing::FloatEq(0.5f)));
+}
+
+TEST_F(RegionSamplingTest, histogram_luma_needs_luma_components) {
+    DisplayedFrameStats stats;
+    stats.numFrames = 1;
+    stats.component_0_sample = {5, 5};
+    stats.component_1_sample = {5, 5};
+    EXPECT_EQ(std::nullopt, histogramLuma(stats, ui::PixelFormat::RGBA_8888, 0x3));
+    EXPECT_EQ(std::nullopt, histogramLuma(stats, ui::PixelFormat::BLOB, 0x1));
+    EXPECT_EQ(std::nullopt, histogramLuma(DisplayedFrameStats{}, ui::PixelFormat::Y8, 0x1));
+}
+
 } // namespace android
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Scheduler/RingBuffer.h"
+
+using namespace testing;
+
+namespace android::scheduler {
+namespace {
+
+template <typename T, size_t N>
+std::vector<T> toVector(const RingBuffer<T, N>& buffer) {
+    return std::vector<T>(buffer.begin(), buffer.end());
+}
+
+TEST(RingBufferTest, startsEmpty) {
+    RingBuffer<int, 3> buffer;
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(0u, buffer.size());
+    EXPECT_EQ(buffer.begin(), buffer.end());
+}
+
+TEST(RingBufferTest, keepsElementsInOrder) {
+    RingBuffer<int, 3> buffer;
+    buffer.push_back(1);
+    buffer.push_back(2);
+    EXPECT_EQ(2u, buffer.size());
+    EXPECT_EQ(1, buffer.front());
+    EXPECT_EQ(2, buffer.back());
+    EXPECT_THAT(toVector(buffer), ElementsAre(1, 2));
+}
+
+TEST(RingBufferTest, dropsOldestWhenFull) {
+    RingBuffer<int, 3> buffer;
+    for (int i = 1; i <= 5; i++) {
+        buffer.push_back(i);
+    }
+    EXPECT_EQ(3u, buffer.size());
+    EXPECT_EQ(3, buffer.front());
+    EXPECT_EQ(5, buffer.back());
+    EXPECT_THAT(toVector(buffer), ElementsAre(3, 4, 5));
+}
+
+TEST(RingBufferTest, popFrontAndClear) {
+    RingBuffer<int, 3> buffer;
+    for (int i = 1; i <= 4; i++) {
+        buffer.push_back(i);
+    }
+    buffer.pop_front();
+    EXPECT_THAT(toVector(buffer), ElementsAre(3, 4));
+
+    buffer.clear();
+    EXPECT_TRUE(buffer.empty());
+    buffer.push_back(7);
+    EXPECT_THAT(toVector(buffer), ElementsAre(7));
+}
+
+TEST(RingBufferTest, iteratorsWorkWithAlgorithms) {
+    RingBuffer<int, 4> buffer;
+    for (int value : {5, 9, 2, 7, 3}) {
+        buffer.push_back(value);
+    }
+    EXPECT_EQ(9, *std::max_element(buffer.begin(), buffer.end()));
+    EXPECT_EQ(2, *std::min_element(buffer.begin(), buffer.end()));
+    EXPECT_EQ(4, std::distance(buffer.begin(), buffer.end()));
+    EXPECT_EQ(3, *(buffer.end() - 1));
+    EXPECT_EQ(2, *(buffer.begin() + 1));
+}
+
+} // namespace
+} // namespace android::scheduler
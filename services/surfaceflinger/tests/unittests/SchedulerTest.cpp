@@ -171,6 +171,38 @@ TEST_F(SchedulerTest, validConnectionHandle) {
     EXPECT_EQ(kEventConnections, mScheduler->getEventThreadConnectionCount(mConnectionHandle));
 }
 
+TEST_F(SchedulerTest, frameRateDividersFollowExplicitVotes) {
+    using LayerVoteType = scheduler::RefreshRateConfigs::LayerVoteType;
+    const scheduler::LayerHistory::Summary summary = {
+            {"game", LayerVoteType::ExplicitExactOrMultiple, 30.f, 1.f, true, 1000},
+            {"video", LayerVoteType::ExplicitDefault, 60.f, 1.f, false, 1001},
+            {"odd", LayerVoteType::ExplicitDefault, 50.f, 1.f, false, 1002},
+            {"heuristic", LayerVoteType::Heuristic, 30.f, 1.f, false, 1003},
+    };
+
+    const auto dividers = Scheduler::computeFrameRateDividers(summary, 120.f);
+    EXPECT_EQ((EventThread::FrameRateDividers{{1000, 4}, {1001, 2}}), dividers);
+
+    // Nothing to throttle at the rate the layers voted for.
+    EXPECT_TRUE(Scheduler::computeFrameRateDividers(summary, 30.f).empty());
+}
+
+TEST_F(SchedulerTest, frameRateDividerOfUidFollowsItsFastestLayer) {
+    using LayerVoteType = scheduler::RefreshRateConfigs::LayerVoteType;
+    const scheduler::LayerHistory::Summary summary = {
+            {"game", LayerVoteType::ExplicitExactOrMultiple, 30.f, 1.f, true, 1000},
+            {"menu", LayerVoteType::ExplicitDefault, 60.f, 1.f, false, 1000},
+    };
+    EXPECT_EQ((EventThread::FrameRateDividers{{1000, 2}}),
+              Scheduler::computeFrameRateDividers(summary, 120.f));
+
+    const scheduler::LayerHistory::Summary withMax = {
+            {"game", LayerVoteType::ExplicitExactOrMultiple, 30.f, 1.f, true, 1000},
+            {"scroll", LayerVoteType::Max, 0.f, 1.f, false, 1000},
+    };
+    EXPECT_TRUE(Scheduler::computeFrameRateDividers(withMax, 120.f).empty());
+}
+
 } // namespace
 } // namespace android
 
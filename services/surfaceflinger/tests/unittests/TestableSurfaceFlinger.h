@@ -390,7 +390,11 @@ public:
     auto& mutableCurrentState() { return mFlinger->mCurrentState; }
     auto& mutableDisplayColorSetting() { return mFlinger->mDisplayColorSetting; }
     auto& mutableDisplays() { return mFlinger->mDisplays; }
-    auto& mutableDrawingState() { return mFlinger->mDrawingState; }
+    auto& mutableDrawingState() {
+        // The caller may change the layers, so flatten them again on next use.
+        mFlinger->mDrawingLayersInZOrderDirty = true;
+        return mFlinger->mDrawingState;
+    }
     auto& mutableEventQueue() { return mFlinger->mEventQueue; }
     auto& mutableGeometryInvalid() { return mFlinger->mGeometryInvalid; }
     auto& mutableInterceptor() { return mFlinger->mInterceptor; }
@@ -31,6 +31,7 @@
 
 #include <chrono>
 #include <random>
+#include <thread>
 #include <unordered_set>
 
 #include "libsurfaceflinger_unittest_main.h"
@@ -59,6 +60,7 @@ using PowerMode = hardware::graphics::composer::V2_4::IComposerClient::PowerMode
 #define LAYER_ID_0         0
 #define LAYER_ID_1         1
 #define LAYER_ID_INVALID   -1
+#define UID_0              10123
 #define NUM_LAYERS         1
 #define NUM_LAYERS_INVALID "INVALID"
 
@@ -227,7 +229,8 @@ static std::string genLayerName(int32_t layerId) {
 void TimeStatsTest::setTimeStamp(TimeStamp type, int32_t id, uint64_t frameNumber, nsecs_t ts) {
     switch (type) {
         case TimeStamp::POST:
-            ASSERT_NO_FATAL_FAILURE(mTimeStats->setPostTime(id, frameNumber, genLayerName(id), ts));
+            ASSERT_NO_FATAL_FAILURE(
+                    mTimeStats->setPostTime(id, frameNumber, genLayerName(id), UID_0, ts));
             break;
         case TimeStamp::ACQUIRE:
             ASSERT_NO_FATAL_FAILURE(mTimeStats->setAcquireTime(id, frameNumber, ts));
@@ -585,6 +588,60 @@ TEST_F(TimeStatsTest, canInsertMultipleLayersTimeStats) {
     EXPECT_EQ(2, globalProto.stats_size());
 }
 
+TEST_F(TimeStatsTest, canInsertLayerTimeStatsFromAnotherThread) {
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    std::thread thread([this] {
+        insertTimeRecord(NORMAL_SEQUENCE, LAYER_ID_0, 1, 1000000);
+        insertTimeRecord(NORMAL_SEQUENCE_2, LAYER_ID_0, 2, 2000000);
+    });
+    thread.join();
+
+    SFTimeStatsGlobalProto globalProto;
+    ASSERT_TRUE(globalProto.ParseFromString(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO)));
+
+    ASSERT_EQ(1, globalProto.stats_size());
+    EXPECT_EQ(1, globalProto.stats().Get(0).total_frames());
+}
+
+TEST_F(TimeStatsTest, canClassifyJankyFrames) {
+    // this stat is not in the proto so verify by checking the string dump
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    constexpr nsecs_t kPeriod = 10'000'000;
+    const auto presentFrame = [&](uint64_t frameNumber, nsecs_t postMs, nsecs_t acquireMs,
+                                  nsecs_t expectedPresentMs, nsecs_t compositionEndMs,
+                                  nsecs_t presentMs) {
+        mTimeStats->setPostTime(LAYER_ID_0, frameNumber, genLayerName(LAYER_ID_0), UID_0,
+                                ms2ns(postMs));
+        mTimeStats->setAcquireTime(LAYER_ID_0, frameNumber, ms2ns(acquireMs));
+        mTimeStats->setLatchTime(LAYER_ID_0, frameNumber, ms2ns(compositionEndMs) - 1);
+        mTimeStats->setDesiredTime(LAYER_ID_0, frameNumber, ms2ns(postMs));
+        mTimeStats->setSfFrameTiming(ms2ns(expectedPresentMs), ms2ns(compositionEndMs), kPeriod);
+        mTimeStats->setPresentTime(LAYER_ID_0, frameNumber, ms2ns(presentMs));
+    };
+
+    presentFrame(1, 1, 2, 20, 15, 20);
+    // Composed after the vsync it was meant for.
+    presentFrame(2, 11, 12, 30, 32, 40);
+    // Composed on time but presented a vsync late.
+    presentFrame(3, 31, 32, 50, 45, 60);
+    // Not ready for the vsync after the last frame.
+    presentFrame(4, 80, 81, 90, 85, 90);
+    // Presented before the predicted vsync.
+    presentFrame(5, 91, 92, 120, 105, 100);
+    // Queued behind the last frame long before it could be latched.
+    presentFrame(6, 96, 97, 140, 135, 140);
+
+    const std::string result(inputCommand(InputCommand::DUMP_ALL, FMT_STRING));
+    EXPECT_THAT(result, HasSubstr("uid = " + std::to_string(UID_0)));
+    EXPECT_THAT(result, HasSubstr("appDeadlineMissedFrames = 1"));
+    EXPECT_THAT(result, HasSubstr("sfDeadlineMissedFrames = 1"));
+    EXPECT_THAT(result, HasSubstr("displayHalJankFrames = 1"));
+    EXPECT_THAT(result, HasSubstr("predictionErrorFrames = 1"));
+    EXPECT_THAT(result, HasSubstr("bufferStuffingFrames = 1"));
+}
+
 TEST_F(TimeStatsTest, canInsertUnorderedLayerTimeStats) {
     EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
 
@@ -912,6 +969,7 @@ TEST_F(TimeStatsTest, globalStatsCallback) {
 
     mTimeStats->setPresentFenceGlobal(std::make_shared<FenceTime>(3000000));
     mTimeStats->setPresentFenceGlobal(std::make_shared<FenceTime>(5000000));
+    mTimeStats->getPhaseTimings()->record(PhaseTimings::Phase::PageFlip, 3000);
 
     EXPECT_THAT(mDelegate->mAtomTags,
                 UnorderedElementsAre(android::util::SURFACEFLINGER_STATS_GLOBAL_INFO,
@@ -921,6 +979,7 @@ TEST_F(TimeStatsTest, globalStatsCallback) {
 
     std::string expectedFrameDuration = buildExpectedHistogramBytestring({2}, {1});
     std::string expectedRenderEngineTiming = buildExpectedHistogramBytestring({1, 2}, {1, 1});
+    std::string expectedPageFlipTiming = buildExpectedHistogramBytestring({2}, {1});
 
     {
         InSequence seq;
@@ -944,11 +1003,22 @@ TEST_F(TimeStatsTest, globalStatsCallback) {
                                                              expectedRenderEngineTiming.c_str(),
                                                      expectedRenderEngineTiming.size()),
                                              expectedRenderEngineTiming.size()));
+        // TransactionFlush
+        EXPECT_CALL(*mDelegate, statsEventWriteByteArray(mDelegate->mEvent, _, 0));
+        EXPECT_CALL(*mDelegate,
+                    statsEventWriteByteArray(mDelegate->mEvent,
+                                             BytesEq((const uint8_t*)expectedPageFlipTiming.c_str(),
+                                                     expectedPageFlipTiming.size()),
+                                             expectedPageFlipTiming.size()));
+        // The phases after PageFlip
+        EXPECT_CALL(*mDelegate, statsEventWriteByteArray(mDelegate->mEvent, _, 0))
+                .Times(PhaseTimings::kNumPhases - 2);
         EXPECT_CALL(*mDelegate, statsEventBuild(mDelegate->mEvent));
     }
     EXPECT_EQ(AStatsManager_PULL_SUCCESS,
               mDelegate->makePullAtomCallback(android::util::SURFACEFLINGER_STATS_GLOBAL_INFO,
                                               mDelegate->mCookie));
+    EXPECT_TRUE(mTimeStats->getPhaseTimings()->histogram(PhaseTimings::Phase::PageFlip).empty());
 
     SFTimeStatsGlobalProto globalProto;
     ASSERT_TRUE(globalProto.ParseFromString(inputCommand(InputCommand::DUMP_ALL, FMT_PROTO)));
@@ -1033,6 +1103,9 @@ TEST_F(TimeStatsTest, layerStatsCallback_pullsAllAndClears) {
         EXPECT_CALL(*mDelegate, statsEventWriteInt64(mDelegate->mEvent, LATE_ACQUIRE_FRAMES));
         EXPECT_CALL(*mDelegate,
                     statsEventWriteInt64(mDelegate->mEvent, BAD_DESIRED_PRESENT_FRAMES));
+        EXPECT_CALL(*mDelegate, statsEventWriteInt32(mDelegate->mEvent, UID_0));
+        // No frame was janky, as no SurfaceFlinger frame timing was reported.
+        EXPECT_CALL(*mDelegate, statsEventWriteInt64(mDelegate->mEvent, 0)).Times(5);
         EXPECT_CALL(*mDelegate, statsEventBuild(mDelegate->mEvent));
     }
     EXPECT_EQ(AStatsManager_PULL_SUCCESS,
@@ -324,11 +324,11 @@ TEST_F(VSyncDispatchTimerQueueTest, unregisterSynchronizes) {
 }
 
 TEST_F(VSyncDispatchTimerQueueTest, basicTwoAlarmSetting) {
+    // cb0 is not the next to wake up once cb1 is scheduled, so it is only updated when cb1 fires.
     EXPECT_CALL(mStubTracker, nextAnticipatedVSyncTimeFrom(1000))
-            .Times(4)
+            .Times(3)
             .WillOnce(Return(1055))
             .WillOnce(Return(1063))
-            .WillOnce(Return(1063))
             .WillOnce(Return(1075));
 
     Sequence seq;
@@ -353,10 +353,9 @@ TEST_F(VSyncDispatchTimerQueueTest, basicTwoAlarmSetting) {
 
 TEST_F(VSyncDispatchTimerQueueTest, rearmsFaroutTimeoutWhenCancellingCloseOne) {
     EXPECT_CALL(mStubTracker, nextAnticipatedVSyncTimeFrom(_))
-            .Times(4)
+            .Times(3)
             .WillOnce(Return(10000))
             .WillOnce(Return(1000))
-            .WillOnce(Return(10000))
             .WillOnce(Return(10000));
 
     Sequence seq;
@@ -777,6 +776,35 @@ TEST_F(VSyncDispatchTimerQueueTest, laggedTimerGroupsCallbacksWithinLag) {
     EXPECT_THAT(cb2.mWakeupTime[0], Eq(610));
 }
 
+TEST_F(VSyncDispatchTimerQueueTest, schedulingEarlierCallbackDoesNotUpdateLaterOnes) {
+    CountingCallback cb0(mDispatch);
+    CountingCallback cb1(mDispatch);
+    CountingCallback cb2(mDispatch);
+
+    EXPECT_CALL(mStubTracker, nextAnticipatedVSyncTimeFrom(_)).Times(3);
+    Sequence seq;
+    EXPECT_CALL(mMockClock, alarmIn(_, 900)).InSequence(seq);
+    EXPECT_CALL(mMockClock, alarmIn(_, 800)).InSequence(seq);
+    EXPECT_CALL(mMockClock, alarmIn(_, 700)).InSequence(seq);
+    EXPECT_CALL(mMockClock, alarmIn(_, 100)).Times(2).InSequence(seq);
+
+    EXPECT_EQ(mDispatch.schedule(cb0, 100, 1000), ScheduleResult::Scheduled);
+    EXPECT_EQ(mDispatch.schedule(cb1, 200, 1000), ScheduleResult::Scheduled);
+    EXPECT_EQ(mDispatch.schedule(cb2, 300, 1000), ScheduleResult::Scheduled);
+    Mock::VerifyAndClearExpectations(&mStubTracker);
+
+    advanceToNextCallback();
+    advanceToNextCallback();
+    advanceToNextCallback();
+
+    ASSERT_THAT(cb2.mWakeupTime.size(), Eq(1));
+    EXPECT_THAT(cb2.mWakeupTime[0], Eq(700));
+    ASSERT_THAT(cb1.mWakeupTime.size(), Eq(1));
+    EXPECT_THAT(cb1.mWakeupTime[0], Eq(800));
+    ASSERT_THAT(cb0.mWakeupTime.size(), Eq(1));
+    EXPECT_THAT(cb0.mWakeupTime[0], Eq(900));
+}
+
 class VSyncDispatchTimerQueueEntryTest : public testing::Test {
 protected:
     nsecs_t const mPeriod = 1000;
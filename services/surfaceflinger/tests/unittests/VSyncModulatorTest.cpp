@@ -33,10 +33,14 @@ public:
         mPhaseOffset[handle] = phaseOffset;
     }
 
+    void setSfPhaseOffset(nsecs_t sfPhaseOffset) { mSfPhaseOffset = sfPhaseOffset; }
+
     nsecs_t getOffset(ConnectionHandle handle) { return mPhaseOffset[handle]; }
+    nsecs_t getSfOffset() const { return mSfPhaseOffset; }
 
 private:
     std::unordered_map<ConnectionHandle, nsecs_t> mPhaseOffset;
+    nsecs_t mSfPhaseOffset = 0;
 };
 
 class VSyncModulatorTest : public testing::Test {
@@ -96,6 +100,7 @@ TEST_F(VSyncModulatorTest, EarlyEnd) {
     mVSyncModulator->onTransactionHandled();
     EXPECT_EQ(APP_EARLY, mMockScheduler.getOffset(mAppConnection));
     EXPECT_EQ(SF_EARLY, mMockScheduler.getOffset(mSfConnection));
+    EXPECT_EQ(SF_EARLY, mMockScheduler.getSfOffset());
 
     for (int i = 0; i < MIN_EARLY_FRAME_COUNT_TRANSACTION - 1; i++) {
         mVSyncModulator->onRefreshed(false);
@@ -320,6 +320,63 @@ TEST_F(VSyncPredictorTest, willBeAccurateUsingPriorResultsForRate) {
     EXPECT_THAT(intercept, Eq(0));
 }
 
+TEST_F(VSyncPredictorTest, rejectsOutliersThatPassValidation) {
+    auto const idealPeriod = 10000;
+    tracker.setPeriod(idealPeriod);
+
+    // Within the outlier tolerance of its neighbours, but well off the line through the others.
+    auto const lateBy = 2000;
+    for (auto i = 0; i < kHistorySize; i++) {
+        EXPECT_TRUE(tracker.addVsyncTimestamp(i * idealPeriod + (i == 5 ? lateBy : 0)));
+    }
+
+    auto const maxRoundingError = 10;
+    auto [slope, intercept] = tracker.getVSyncPredictionModel();
+    EXPECT_THAT(slope, IsCloseTo(idealPeriod, maxRoundingError));
+    EXPECT_THAT(intercept, IsCloseTo(0, maxRoundingError));
+}
+
+TEST_F(VSyncPredictorTest, fewSamplesNeededForRateWithFittedModel) {
+    auto const fastPeriod = 10000;
+    auto const fastRealPeriod = 10100;
+    auto const slowPeriod = 20000;
+
+    tracker.setPeriod(fastPeriod);
+    for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
+        tracker.addVsyncTimestamp(mNow += fastRealPeriod);
+    }
+    EXPECT_FALSE(tracker.needsMoreSamples());
+
+    tracker.setPeriod(slowPeriod);
+    for (auto i = 0u; i < kMinimumSamplesForPrediction; i++) {
+        EXPECT_TRUE(tracker.needsMoreSamples());
+        tracker.addVsyncTimestamp(mNow += slowPeriod);
+    }
+    EXPECT_FALSE(tracker.needsMoreSamples());
+
+    // Switching back only needs the phase, the fitted slope is kept.
+    tracker.setPeriod(fastPeriod);
+    EXPECT_TRUE(tracker.needsMoreSamples());
+    auto const phase = 4000;
+    mNow += phase;
+    tracker.addVsyncTimestamp(mNow);
+    EXPECT_TRUE(tracker.needsMoreSamples());
+    tracker.addVsyncTimestamp(mNow += fastRealPeriod);
+    EXPECT_FALSE(tracker.needsMoreSamples());
+
+    auto [slope, intercept] = tracker.getVSyncPredictionModel();
+    EXPECT_THAT(slope, Eq(fastRealPeriod));
+    EXPECT_THAT(intercept, Eq(0));
+    EXPECT_THAT(tracker.nextAnticipatedVSyncTimeFrom(mNow + 100), Eq(mNow + fastRealPeriod));
+
+    // Unless the model was reset in the meantime.
+    tracker.resetModel();
+    EXPECT_TRUE(tracker.needsMoreSamples());
+    tracker.addVsyncTimestamp(mNow += fastRealPeriod);
+    tracker.addVsyncTimestamp(mNow += fastRealPeriod);
+    EXPECT_TRUE(tracker.needsMoreSamples());
+}
+
 TEST_F(VSyncPredictorTest, idealModelPredictionsBeforeRegressionModelIsBuilt) {
     auto const simulatedVsyncs =
             generateVsyncTimestamps(kMinimumSamplesForPrediction + 1, mPeriod, 0);
@@ -344,7 +401,7 @@ TEST_F(VSyncPredictorTest, idealModelPredictionsBeforeRegressionModelIsBuilt) {
 // See b/145667109, and comment in prod code under test.
 TEST_F(VSyncPredictorTest, doesNotPredictBeforeTimePointWithHigherIntercept) {
     std::vector<nsecs_t> const simulatedVsyncs{
-            158929578733000,
+            158929578733000, // half a period off the others, rejected from the fit
             158929306806205, // oldest TS in ringbuffer
             158929650879052,
             158929661969209,
@@ -353,8 +410,8 @@ TEST_F(VSyncPredictorTest, doesNotPredictBeforeTimePointWithHigherIntercept) {
             158929706370359,
     };
     auto const idealPeriod = 11111111;
-    auto const expectedPeriod = 11113919;
-    auto const expectedIntercept = -1195945;
+    auto const expectedPeriod = 11099137;
+    auto const expectedIntercept = -68;
 
     tracker.setPeriod(idealPeriod);
     for (auto const& timestamp : simulatedVsyncs) {
@@ -725,6 +725,18 @@ TEST_F(VSyncReactorTest, beginResyncResetsModel) {
     mReactor.beginResync();
 }
 
+TEST_F(VSyncReactorTest, beginResyncForNewPeriodKeepsModel) {
+    EXPECT_CALL(*mMockTracker, resetModel()).Times(0);
+    mReactor.setPeriod(period * 2);
+    mReactor.beginResync();
+}
+
+TEST_F(VSyncReactorTest, beginResyncForSamePeriodResetsModel) {
+    EXPECT_CALL(*mMockTracker, resetModel());
+    mReactor.setPeriod(period);
+    mReactor.beginResync();
+}
+
 TEST_F(VSyncReactorTest, periodChangeWithGivenVsyncPeriod) {
     bool periodFlushed = true;
     EXPECT_CALL(*mMockTracker, addVsyncTimestamp(_)).Times(2);
@@ -36,6 +36,7 @@ public:
     MOCK_METHOD3(onConfigChanged, void(PhysicalDisplayId, HwcConfigIndexType, nsecs_t));
     MOCK_CONST_METHOD1(dump, void(std::string&));
     MOCK_METHOD1(setPhaseOffset, void(nsecs_t phaseOffset));
+    MOCK_METHOD1(setSfPhaseOffset, void(nsecs_t sfPhaseOffset));
     MOCK_METHOD1(registerDisplayEventConnection,
                  status_t(const sp<android::EventThreadConnection> &));
     MOCK_METHOD2(setVsyncRate, void(uint32_t, const sp<android::EventThreadConnection> &));
@@ -43,6 +44,8 @@ public:
     MOCK_METHOD1(requestLatestConfig, void(const sp<android::EventThreadConnection> &));
     MOCK_METHOD1(pauseVsyncCallback, void(bool));
     MOCK_METHOD0(getEventThreadConnectionCount, size_t());
+    MOCK_CONST_METHOD1(getVsyncTimeline, status_t(gui::VsyncTimeline*));
+    MOCK_METHOD1(setFrameRateDividers, void(FrameRateDividers));
 };
 
 } // namespace mock
@@ -25,6 +25,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/system_properties.h>
 
 #include <algorithm>
 #include <mutex>
@@ -32,6 +33,7 @@
 #include <string>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <android-base/strings.h>
 #include <cutils/properties.h>
@@ -50,6 +52,76 @@ namespace api {
 
 namespace {
 
+// Implicit layers set with the legacy debug.vulkan.layers and
+// debug.vulkan.layer.<priority> properties, as (priority, name) pairs.
+using LegacyLayerList = std::vector<std::pair<int, std::string>>;
+
+void ParseDebugVulkanLayers(LegacyLayerList& layers) {
+    // debug.vulkan.layers specifies colon-separated layer names
+    char prop[PROPERTY_VALUE_MAX];
+    if (!property_get("debug.vulkan.layers", prop, ""))
+        return;
+
+    // assign negative/high priorities to them
+    int prio = -PROPERTY_VALUE_MAX;
+
+    const char* p = prop;
+    const char* delim;
+    while ((delim = strchr(p, ':'))) {
+        if (delim > p)
+            layers.emplace_back(prio, std::string(p, delim));
+
+        prio++;
+        p = delim + 1;
+    }
+
+    if (p[0] != '\0')
+        layers.emplace_back(prio, p);
+}
+
+void ParseDebugVulkanLayer(const char* key, const char* val, void* user_data) {
+    static const char prefix[] = "debug.vulkan.layer.";
+    const size_t prefix_len = sizeof(prefix) - 1;
+
+    if (strncmp(key, prefix, prefix_len) || val[0] == '\0')
+        return;
+    key += prefix_len;
+
+    // debug.vulkan.layer.<priority>
+    int priority = -1;
+    if (key[0] >= '0' && key[0] <= '9')
+        priority = atoi(key);
+
+    if (priority < 0) {
+        ALOGW("Ignored implicit layer %s with invalid priority %s", val, key);
+        return;
+    }
+
+    reinterpret_cast<LegacyLayerList*>(user_data)->emplace_back(priority, val);
+}
+
+// Returns the legacy implicit layers.  Finding debug.vulkan.layer.<priority>
+// means going through every system property, so the result is only computed
+// again when a property has changed since.
+LegacyLayerList GetLegacyLayers() {
+    static std::mutex lock;
+    static bool valid = false;
+    static uint32_t serial;
+    static LegacyLayerList layers;
+
+    std::lock_guard<std::mutex> guard(lock);
+    const uint32_t current_serial = __system_property_area_serial();
+    if (!valid || serial != current_serial) {
+        ATRACE_NAME("GetLegacyLayers");
+        layers.clear();
+        ParseDebugVulkanLayers(layers);
+        property_list(ParseDebugVulkanLayer, &layers);
+        serial = current_serial;
+        valid = true;
+    }
+    return layers;
+}
+
 // Provide overridden layer names when there are implicit layers.  No effect
 // otherwise.
 class OverrideLayerNames {
@@ -133,8 +205,10 @@ class OverrideLayerNames {
 
         // If no layers specified via Settings, check legacy properties
         if (implicit_layers_.count <= 0) {
-            ParseDebugVulkanLayers();
-            property_list(ParseDebugVulkanLayer, this);
+            for (const auto& layer : GetLegacyLayers()) {
+                AddImplicitLayer(layer.first, layer.second.c_str(),
+                                 layer.second.length());
+            }
 
             // sort by priorities
             auto& arr = implicit_layers_;
@@ -158,55 +232,6 @@ class OverrideLayerNames {
         }
     }
 
-    void ParseDebugVulkanLayers() {
-        // debug.vulkan.layers specifies colon-separated layer names
-        char prop[PROPERTY_VALUE_MAX];
-        if (!property_get("debug.vulkan.layers", prop, ""))
-            return;
-
-        // assign negative/high priorities to them
-        int prio = -PROPERTY_VALUE_MAX;
-
-        const char* p = prop;
-        const char* delim;
-        while ((delim = strchr(p, ':'))) {
-            if (delim > p)
-                AddImplicitLayer(prio, p, static_cast<size_t>(delim - p));
-
-            prio++;
-            p = delim + 1;
-        }
-
-        if (p[0] != '\0')
-            AddImplicitLayer(prio, p, strlen(p));
-    }
-
-    static void ParseDebugVulkanLayer(const char* key,
-                                      const char* val,
-                                      void* user_data) {
-        static const char prefix[] = "debug.vulkan.layer.";
-        const size_t prefix_len = sizeof(prefix) - 1;
-
-        if (strncmp(key, prefix, prefix_len) || val[0] == '\0')
-            return;
-        key += prefix_len;
-
-        // debug.vulkan.layer.<priority>
-        int priority = -1;
-        if (key[0] >= '0' && key[0] <= '9')
-            priority = atoi(key);
-
-        if (priority < 0) {
-            ALOGW("Ignored implicit layer %s with invalid priority %s", val,
-                  key);
-            return;
-        }
-
-        OverrideLayerNames& override_layers =
-            *reinterpret_cast<OverrideLayerNames*>(user_data);
-        override_layers.AddImplicitLayer(priority, val, strlen(val));
-    }
-
     void AddImplicitLayer(int priority, const char* name, size_t len) {
         if (!GrowImplicitLayerArray(1, 0))
             return;
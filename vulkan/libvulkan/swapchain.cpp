@@ -16,6 +16,7 @@
 
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <android-base/properties.h>
 #include <android/hardware/graphics/common/1.0/types.h>
 #include <grallocusage/GrallocUsageConversion.h>
 #include <graphicsenv/GraphicsEnv.h>
@@ -27,6 +28,8 @@
 #include <utils/Timers.h>
 #include <utils/Trace.h>
 
+#include <time.h>
+
 #include <algorithm>
 #include <unordered_set>
 #include <vector>
@@ -203,6 +206,8 @@ struct Surface {
     android::sp<ANativeWindow> window;
     VkSwapchainKHR swapchain_handle;
     uint64_t consumer_usage;
+    // The perform table of window, or nullptr if it has none.
+    const ANativeWindowPerformTable* perform_table;
 };
 
 VkSurfaceKHR HandleFromSurface(Surface* surface) {
@@ -213,11 +218,80 @@ Surface* SurfaceFromHandle(VkSurfaceKHR handle) {
     return reinterpret_cast<Surface*>(handle);
 }
 
+// Per-frame window operations, done through the surface's perform table when
+// the window has one.
+
+int SetSurfaceDamage(const Surface& surface,
+                     const android_native_rect_t* rects,
+                     size_t count) {
+    if (surface.perform_table)
+        return surface.perform_table->setSurfaceDamage(surface.window.get(),
+                                                       rects, count);
+    return native_window_set_surface_damage(surface.window.get(), rects,
+                                            count);
+}
+
+int GetNextFrameId(const Surface& surface, uint64_t* frame_id) {
+    if (surface.perform_table)
+        return surface.perform_table->getNextFrameId(surface.window.get(),
+                                                     frame_id);
+    return native_window_get_next_frame_id(surface.window.get(), frame_id);
+}
+
+int SetBuffersTimestamp(const Surface& surface, int64_t timestamp) {
+    if (surface.perform_table)
+        return surface.perform_table->setBuffersTimestamp(surface.window.get(),
+                                                          timestamp);
+    return native_window_set_buffers_timestamp(surface.window.get(),
+                                               timestamp);
+}
+
 // Maximum number of TimingInfo structs to keep per swapchain:
 enum { MAX_TIMING_INFOS = 10 };
 // Minimum number of frames to look for in the past (so we don't cause
 // syncronous requests to Surface Flinger):
 enum { MIN_NUM_FRAMES_AGO = 5 };
+// Extra time given to each frame in low-latency mode on top of the recent
+// rendering time, to absorb scheduling jitter:
+constexpr nsecs_t LOW_LATENCY_SLACK = 1000000;  // 1ms
+
+// A frame presented in low-latency mode, and when the application started
+// working on it:
+struct PacingInfo {
+    uint64_t native_frame_id;
+    nsecs_t start_time;
+};
+
+// The swapchain parameters that the native window's buffers depend on. A new
+// swapchain with the same parameters can take over the buffers of the one it
+// replaces.
+struct BufferConfig {
+    VkFormat format;
+    VkColorSpaceKHR color_space;
+    VkExtent2D extent;
+    VkImageUsageFlags usage;
+    VkSwapchainCreateFlagsKHR flags;
+    VkPresentModeKHR present_mode;
+    uint32_t min_image_count;
+};
+
+BufferConfig BufferConfigFromCreateInfo(
+    const VkSwapchainCreateInfoKHR* create_info) {
+    return BufferConfig{
+        create_info->imageFormat, create_info->imageColorSpace,
+        create_info->imageExtent, create_info->imageUsage,
+        create_info->flags,       create_info->presentMode,
+        create_info->minImageCount,
+    };
+}
+
+bool SameBufferConfig(const BufferConfig& a, const BufferConfig& b) {
+    return a.format == b.format && a.color_space == b.color_space &&
+           a.extent.width == b.extent.width &&
+           a.extent.height == b.extent.height && a.usage == b.usage &&
+           a.flags == b.flags && a.present_mode == b.present_mode &&
+           a.min_image_count == b.min_image_count;
+}
 
 struct Swapchain {
     Swapchain(Surface& surface_,
@@ -232,7 +306,14 @@ struct Swapchain {
           acquire_next_image_timeout(-1),
           shared(present_mode == VK_PRESENT_MODE_SHARED_DEMAND_REFRESH_KHR ||
                  present_mode ==
-                     VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR) {
+                     VK_PRESENT_MODE_SHARED_CONTINUOUS_REFRESH_KHR),
+          low_latency(present_mode == VK_PRESENT_MODE_FIFO_KHR &&
+                      android::base::GetBoolProperty("debug.vulkan.low_latency",
+                                                     false)),
+          frame_start_time(0),
+          frame_work_duration(0),
+          buffer_config(),
+          buffers_reused(false) {
         ANativeWindow* window = surface.window.get();
         native_window_get_refresh_cycle_duration(
             window,
@@ -256,6 +337,19 @@ struct Swapchain {
     int64_t refresh_duration;
     nsecs_t acquire_next_image_timeout;
     bool shared;
+    // In low-latency mode, AcquireNextImageKHR delays the start of each frame
+    // so that it finishes rendering just before the compositor deadline,
+    // instead of queueing up behind the frames already waiting for a vsync.
+    bool low_latency;
+    nsecs_t frame_start_time;
+    // The peak time recently taken from acquiring an image to the end of its
+    // rendering.
+    nsecs_t frame_work_duration;
+    BufferConfig buffer_config;
+    // Whether a newer swapchain took over the native window's buffers. The
+    // images still dequeued from this swapchain must then be returned to the
+    // window instead of being dropped, so that the newer one can use them.
+    bool buffers_reused;
 
     struct Image {
         Image() : image(VK_NULL_HANDLE), dequeue_fence(-1), dequeued(false) {}
@@ -270,6 +364,7 @@ struct Swapchain {
     } images[android::BufferQueueDefs::NUM_BUFFER_SLOTS];
 
     std::vector<TimingInfo> timing;
+    std::vector<PacingInfo> pacing;
 };
 
 VkSwapchainKHR HandleFromSwapchain(Swapchain* swapchain) {
@@ -342,6 +437,7 @@ void OrphanSwapchain(VkDevice device, Swapchain* swapchain) {
     }
     swapchain->surface.swapchain_handle = VK_NULL_HANDLE;
     swapchain->timing.clear();
+    swapchain->pacing.clear();
 }
 
 uint32_t get_num_ready_timings(Swapchain& swapchain) {
@@ -400,6 +496,93 @@ uint32_t get_num_ready_timings(Swapchain& swapchain) {
     return num_ready;
 }
 
+// Folds the rendering times of the recently presented frames into
+// frame_work_duration. Like get_num_ready_timings, this leaves the most recent
+// frames alone so as not to make synchronous requests to Surface Flinger.
+void update_frame_work_duration(Swapchain& swapchain) {
+    if (swapchain.pacing.size() < MIN_NUM_FRAMES_AGO) {
+        return;
+    }
+
+    const size_t num_pacings = swapchain.pacing.size() - MIN_NUM_FRAMES_AGO + 1;
+    size_t num_to_remove = 0;
+    for (size_t i = 0; i < num_pacings; i++) {
+        const PacingInfo& pi = swapchain.pacing[i];
+        int64_t render_complete_time = NATIVE_WINDOW_TIMESTAMP_PENDING;
+        int err = native_window_get_frame_timestamps(
+            swapchain.surface.window.get(), pi.native_frame_id,
+            nullptr,  //&desired_present_time,
+            &render_complete_time,
+            nullptr,  //&composition_latch_time,
+            nullptr,  //&first_composition_start_time,
+            nullptr,  //&last_composition_start_time,
+            nullptr,  //&composition_finish_time,
+            nullptr,  //&actual_present_time,
+            nullptr,  //&dequeue_ready_time,
+            nullptr /*&reads_done_time*/);
+        if (err == android::OK &&
+            render_complete_time == NATIVE_WINDOW_TIMESTAMP_PENDING) {
+            // Later frames can't have finished rendering either.
+            break;
+        }
+        num_to_remove++;
+        if (err != android::OK || render_complete_time < pi.start_time) {
+            continue;
+        }
+
+        // Rise immediately to a longer frame, but only decay slowly, so that
+        // a single short frame doesn't make the next one miss its deadline.
+        const nsecs_t work_duration = render_complete_time - pi.start_time;
+        swapchain.frame_work_duration =
+            std::max(work_duration, swapchain.frame_work_duration -
+                                        swapchain.frame_work_duration / 8);
+    }
+    swapchain.pacing.erase(swapchain.pacing.begin(),
+                           swapchain.pacing.begin() + num_to_remove);
+}
+
+// Sleeps until the latest time at which the next frame can start and still
+// make the upcoming compositor deadline, given the recent rendering times.
+void pace_frame_start(Swapchain& swapchain) {
+    update_frame_work_duration(swapchain);
+    if (swapchain.frame_work_duration == 0) {
+        return;
+    }
+
+    int64_t composite_deadline = 0;
+    int64_t composite_interval = 0;
+    int64_t composite_to_present_latency = 0;
+    int err = native_window_get_compositor_timing(
+        swapchain.surface.window.get(), &composite_deadline,
+        &composite_interval, &composite_to_present_latency);
+    if (err != android::OK || composite_interval <= 0) {
+        return;
+    }
+
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    const nsecs_t lead_time =
+        swapchain.frame_work_duration + LOW_LATENCY_SLACK;
+    nsecs_t start_time = composite_deadline - lead_time;
+    // If the upcoming deadline can't be made anymore, aim for the next one.
+    if (start_time < now) {
+        start_time += ((now - start_time) / composite_interval + 1) *
+                      composite_interval;
+    }
+    // Never hold the application back for more than a refresh cycle.
+    if (start_time <= now || start_time - now > composite_interval) {
+        return;
+    }
+
+    ATRACE_BEGIN("LowLatencyPacing");
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(start_time / 1000000000);
+    ts.tv_nsec = static_cast<long>(start_time % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) ==
+           EINTR) {
+    }
+    ATRACE_END();
+}
+
 void copy_ready_timings(Swapchain& swapchain,
                         uint32_t* count,
                         VkPastPresentationTimingGOOGLE* timings) {
@@ -532,6 +715,8 @@ VkResult CreateAndroidSurfaceKHR(
 
     surface->window = pCreateInfo->window;
     surface->swapchain_handle = VK_NULL_HANDLE;
+    native_window_get_perform_table(surface->window.get(),
+                                    &surface->perform_table);
     int err = native_window_get_consumer_usage(surface->window.get(),
                                                &surface->consumer_usage);
     if (err != android::OK) {
@@ -991,9 +1176,11 @@ static void DestroySwapchainInternal(VkDevice device,
     }
 
     bool active = swapchain->surface.swapchain_handle == swapchain_handle;
-    ANativeWindow* window = active ? swapchain->surface.window.get() : nullptr;
+    ANativeWindow* window = active || swapchain->buffers_reused
+                                ? swapchain->surface.window.get()
+                                : nullptr;
 
-    if (window && swapchain->frame_timestamps_enabled) {
+    if (active && swapchain->frame_timestamps_enabled) {
         native_window_enable_frame_timestamps(window, false);
     }
 
@@ -1073,8 +1260,26 @@ VkResult CreateSwapchainKHR(VkDevice device,
               reinterpret_cast<uint64_t>(create_info->oldSwapchain));
         return VK_ERROR_NATIVE_WINDOW_IN_USE_KHR;
     }
-    if (create_info->oldSwapchain != VK_NULL_HANDLE)
-        OrphanSwapchain(device, SwapchainFromHandle(create_info->oldSwapchain));
+
+    // -- Take over the buffers of the old swapchain if they still fit --
+    // Recreating a swapchain with the same parameters, e.g. on rotation when
+    // the app does pre-rotation, would otherwise reallocate every buffer and
+    // stall for several frames.
+    const BufferConfig buffer_config = BufferConfigFromCreateInfo(create_info);
+    std::vector<android::sp<ANativeWindowBuffer>> reused_buffers;
+    if (create_info->oldSwapchain != VK_NULL_HANDLE) {
+        Swapchain* old_swapchain =
+            SwapchainFromHandle(create_info->oldSwapchain);
+        if (!old_swapchain->shared &&
+            SameBufferConfig(old_swapchain->buffer_config, buffer_config)) {
+            for (uint32_t i = 0; i < old_swapchain->num_images; i++) {
+                reused_buffers.push_back(old_swapchain->images[i].buffer);
+            }
+            old_swapchain->buffers_reused = true;
+        }
+        OrphanSwapchain(device, old_swapchain);
+    }
+    const bool reuse_buffers = !reused_buffers.empty();
 
     // -- Reset the native window --
     // The native window might have been used previously, and had its properties
@@ -1088,14 +1293,19 @@ VkResult CreateSwapchainKHR(VkDevice device,
     // orphans the previous buffers, getting us back to the state where we can
     // dequeue all buffers.
     //
-    // TODO(http://b/134186185) recycle swapchain images more efficiently
+    // When the buffers are taken over, the window stays connected, and the
+    // buffer count is left alone since lowering it would free them.
     ANativeWindow* window = surface.window.get();
-    err = native_window_api_disconnect(window, NATIVE_WINDOW_API_EGL);
-    ALOGW_IF(err != android::OK, "native_window_api_disconnect failed: %s (%d)",
-             strerror(-err), err);
-    err = native_window_api_connect(window, NATIVE_WINDOW_API_EGL);
-    ALOGW_IF(err != android::OK, "native_window_api_connect failed: %s (%d)",
-             strerror(-err), err);
+    if (!reuse_buffers) {
+        err = native_window_api_disconnect(window, NATIVE_WINDOW_API_EGL);
+        ALOGW_IF(err != android::OK,
+                 "native_window_api_disconnect failed: %s (%d)",
+                 strerror(-err), err);
+        err = native_window_api_connect(window, NATIVE_WINDOW_API_EGL);
+        ALOGW_IF(err != android::OK,
+                 "native_window_api_connect failed: %s (%d)", strerror(-err),
+                 err);
+    }
 
     err = window->perform(window, NATIVE_WINDOW_SET_DEQUEUE_TIMEOUT, -1);
     if (err != android::OK) {
@@ -1104,11 +1314,13 @@ VkResult CreateSwapchainKHR(VkDevice device,
         return VK_ERROR_SURFACE_LOST_KHR;
     }
 
-    err = native_window_set_buffer_count(window, 0);
-    if (err != android::OK) {
-        ALOGE("native_window_set_buffer_count(0) failed: %s (%d)",
-              strerror(-err), err);
-        return VK_ERROR_SURFACE_LOST_KHR;
+    if (!reuse_buffers) {
+        err = native_window_set_buffer_count(window, 0);
+        if (err != android::OK) {
+            ALOGE("native_window_set_buffer_count(0) failed: %s (%d)",
+                  strerror(-err), err);
+            return VK_ERROR_SURFACE_LOST_KHR;
+        }
     }
 
     int swap_interval =
@@ -1224,10 +1436,16 @@ VkResult CreateSwapchainKHR(VkDevice device,
     // in place for that to work yet. Note we only lie to the lower layer-- we
     // don't want to give the app back a swapchain with extra images (which they
     // can't actually use!).
-    err = native_window_set_buffer_count(window, std::max(2u, num_images));
-    if (err != android::OK) {
-        ALOGE("native_window_set_buffer_count(%d) failed: %s (%d)", num_images,
-              strerror(-err), err);
+    if (!reuse_buffers) {
+        err = native_window_set_buffer_count(window, std::max(2u, num_images));
+        if (err != android::OK) {
+            ALOGE("native_window_set_buffer_count(%d) failed: %s (%d)",
+                  num_images, strerror(-err), err);
+            return VK_ERROR_SURFACE_LOST_KHR;
+        }
+    } else if (num_images != reused_buffers.size()) {
+        ALOGE("old swapchain has %zu images, expected %u",
+              reused_buffers.size(), num_images);
         return VK_ERROR_SURFACE_LOST_KHR;
     }
 
@@ -1288,7 +1506,9 @@ VkResult CreateSwapchainKHR(VkDevice device,
     Swapchain* swapchain = new (mem)
         Swapchain(surface, num_images, create_info->presentMode,
                   TranslateVulkanToNativeTransform(create_info->preTransform));
+    swapchain->buffer_config = buffer_config;
     // -- Dequeue all buffers and create a VkImage for each --
+    // Reused buffers don't need to be dequeued, as they are already known.
     // Any failures during or after this must cancel the dequeued buffers.
 
     VkSwapchainImageCreateInfoANDROID swapchain_image_create = {
@@ -1326,22 +1546,27 @@ VkResult CreateSwapchainKHR(VkDevice device,
     for (uint32_t i = 0; i < num_images; i++) {
         Swapchain::Image& img = swapchain->images[i];
 
-        ANativeWindowBuffer* buffer;
-        err = window->dequeueBuffer(window, &buffer, &img.dequeue_fence);
-        if (err != android::OK) {
-            ALOGE("dequeueBuffer[%u] failed: %s (%d)", i, strerror(-err), err);
-            switch (-err) {
-                case ENOMEM:
-                    result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
-                    break;
-                default:
-                    result = VK_ERROR_SURFACE_LOST_KHR;
-                    break;
+        if (reuse_buffers) {
+            img.buffer = reused_buffers[i];
+        } else {
+            ANativeWindowBuffer* buffer;
+            err = window->dequeueBuffer(window, &buffer, &img.dequeue_fence);
+            if (err != android::OK) {
+                ALOGE("dequeueBuffer[%u] failed: %s (%d)", i, strerror(-err),
+                      err);
+                switch (-err) {
+                    case ENOMEM:
+                        result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+                        break;
+                    default:
+                        result = VK_ERROR_SURFACE_LOST_KHR;
+                        break;
+                }
+                break;
             }
-            break;
+            img.buffer = buffer;
+            img.dequeued = true;
         }
-        img.buffer = buffer;
-        img.dequeued = true;
 
         image_create.extent =
             VkExtent3D{static_cast<uint32_t>(img.buffer->width),
@@ -1475,6 +1700,11 @@ VkResult AcquireNextImageKHR(VkDevice device,
         swapchain.acquire_next_image_timeout = acquire_next_image_timeout;
     }
 
+    // Don't delay applications that are only polling for an image.
+    if (swapchain.low_latency && timeout != 0) {
+        pace_frame_start(swapchain);
+    }
+
     ANativeWindowBuffer* buffer;
     int fence_fd;
     err = window->dequeueBuffer(window, &buffer, &fence_fd);
@@ -1485,6 +1715,7 @@ VkResult AcquireNextImageKHR(VkDevice device,
         ALOGE("dequeueBuffer failed: %s (%d)", strerror(-err), err);
         return VK_ERROR_SURFACE_LOST_KHR;
     }
+    swapchain.frame_start_time = systemTime(SYSTEM_TIME_MONOTONIC);
 
     uint32_t idx;
     for (idx = 0; idx < swapchain.num_images; idx++) {
@@ -1672,22 +1903,34 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
                         cur_rect->right = x + width;
                         cur_rect->bottom = y;
                     }
-                    native_window_set_surface_damage(window, rects, rcount);
+                    SetSurfaceDamage(swapchain.surface, rects, rcount);
                 }
-                if (time) {
-                    if (!swapchain.frame_timestamps_enabled) {
-                        ALOGV(
-                            "Calling "
-                            "native_window_enable_frame_timestamps(true)");
-                        native_window_enable_frame_timestamps(window, true);
-                        swapchain.frame_timestamps_enabled = true;
+                if ((time || swapchain.low_latency) &&
+                    !swapchain.frame_timestamps_enabled) {
+                    ALOGV("Calling native_window_enable_frame_timestamps(true)");
+                    native_window_enable_frame_timestamps(window, true);
+                    swapchain.frame_timestamps_enabled = true;
+                }
+                if (swapchain.low_latency) {
+                    // Record the nativeFrameId so that the rendering time of
+                    // this frame can be looked up later.
+                    uint64_t nativeFrameId = 0;
+                    err = GetNextFrameId(swapchain.surface, &nativeFrameId);
+                    if (err != android::OK) {
+                        ALOGE("Failed to get next native frame ID.");
+                    } else {
+                        swapchain.pacing.push_back(
+                            {nativeFrameId, swapchain.frame_start_time});
+                        while (swapchain.pacing.size() > MAX_TIMING_INFOS) {
+                            swapchain.pacing.erase(swapchain.pacing.begin());
+                        }
                     }
-
+                }
+                if (time) {
                     // Record the nativeFrameId so it can be later correlated to
                     // this present.
                     uint64_t nativeFrameId = 0;
-                    err = native_window_get_next_frame_id(
-                            window, &nativeFrameId);
+                    err = GetNextFrameId(swapchain.surface, &nativeFrameId);
                     if (err != android::OK) {
                         ALOGE("Failed to get next native frame ID.");
                     }
@@ -1704,8 +1947,8 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
                             "Calling "
                             "native_window_set_buffers_timestamp(%" PRId64 ")",
                             time->desiredPresentTime);
-                        native_window_set_buffers_timestamp(
-                            window,
+                        SetBuffersTimestamp(
+                            swapchain.surface,
                             static_cast<int64_t>(time->desiredPresentTime));
                     }
                 }
@@ -1763,7 +2006,11 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
                     WorstPresentResult(swapchain_result, VK_SUBOPTIMAL_KHR);
             }
         } else {
-            ReleaseSwapchainImage(device, nullptr, fence, img);
+            ReleaseSwapchainImage(device,
+                                  swapchain.buffers_reused
+                                      ? swapchain.surface.window.get()
+                                      : nullptr,
+                                  fence, img);
             swapchain_result = VK_ERROR_OUT_OF_DATE_KHR;
         }
 